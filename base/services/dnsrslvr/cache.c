@@ -17,18 +17,274 @@ static BOOL DnsCacheInitialized = FALSE;
 #define DnsCacheLock()          do { EnterCriticalSection(&DnsCache.Lock); } while (0)
 #define DnsCacheUnlock()        do { LeaveCriticalSection(&DnsCache.Lock); } while (0)
 
+/* Longest we keep an answer, whatever its TTL says */
+#define CACHE_MAX_TTL           86400
+
+/* How long a name error or an empty answer is kept (RFC 2308). The SOA
+ * minimum of the answer would be better, but Query_Main doesn't give it */
+#define CACHE_NEGATIVE_TTL      300
+
+/* How often the cache is scanned for expired and hot entries, in seconds */
+#define CACHE_SCAVENGE_INTERVAL 10
+
+/* An entry looked up this many times is refreshed before it expires... */
+#define CACHE_PREFETCH_HITS     2
+
+/* ...once it's in the last tenth of its lifetime, and at most this many
+ * of them per scan */
+#define CACHE_PREFETCH_MAX      16
+
+/* DNS_MAX_NAME_BUFFER_LENGTH, which our windns.h lacks */
+#define CACHE_MAX_NAME_LENGTH   256
+
+static
+ULONG
+DnsIntCacheHash(
+    _In_ LPCWSTR Name)
+{
+    ULONG Hash = 2166136261UL;
+
+    /* FNV-1a, case insensitive like the names */
+    while (*Name)
+    {
+        Hash ^= towlower(*Name);
+        Hash *= 16777619UL;
+        Name++;
+    }
+
+    return Hash % RESOLVER_CACHE_BUCKETS;
+}
+
+static
+BOOL
+DnsIntCacheIsExpired(
+    _In_ PRESOLVER_CACHE_ENTRY CacheEntry,
+    _In_ DWORD dwNow)
+{
+    /* Hosts file entries stay until the file is read again */
+    if (CacheEntry->bHostsFileEntry)
+        return FALSE;
+
+    return (LONG)(dwNow - CacheEntry->dwExpireTime) >= 0;
+}
+
+static
+PRESOLVER_CACHE_ENTRY
+DnsIntCacheFindEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType)
+{
+    PLIST_ENTRY Bucket, NextEntry;
+    PRESOLVER_CACHE_ENTRY CacheEntry;
+
+    Bucket = &DnsCache.Buckets[DnsIntCacheHash(Name)];
+
+    for (NextEntry = Bucket->Flink; NextEntry != Bucket; NextEntry = NextEntry->Flink)
+    {
+        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+
+        if (CacheEntry->wType == wType &&
+            _wcsicmp(CacheEntry->pszName, Name) == 0)
+        {
+            return CacheEntry;
+        }
+    }
+
+    return NULL;
+}
+
+static
+VOID
+DnsIntCacheInsertEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ DNS_STATUS Status,
+    _In_opt_ PDNS_RECORDW Record,
+    _In_ BOOL bHostsFileEntry,
+    _In_ DWORD dwTtl)
+{
+    PRESOLVER_CACHE_ENTRY Entry, OldEntry;
+    SIZE_T NameSize;
+
+    NameSize = (wcslen(Name) + 1) * sizeof(WCHAR);
+
+    Entry = (PRESOLVER_CACHE_ENTRY)HeapAlloc(GetProcessHeap(), 0, sizeof(*Entry) + NameSize);
+    if (!Entry)
+        return;
+
+    Entry->pszName = (LPWSTR)(Entry + 1);
+    CopyMemory(Entry->pszName, Name, NameSize);
+    Entry->wType = wType;
+    Entry->Status = Status;
+    Entry->bHostsFileEntry = bHostsFileEntry;
+    Entry->dwTtl = dwTtl;
+    Entry->dwHits = 0;
+    Entry->Record = NULL;
+
+    if (Record)
+    {
+        Entry->Record = DnsRecordSetCopyEx(Record, DnsCharSetUnicode, DnsCharSetUnicode);
+        if (!Entry->Record)
+        {
+            HeapFree(GetProcessHeap(), 0, Entry);
+            return;
+        }
+    }
+
+    /* Lock the cache */
+    DnsCacheLock();
+
+    Entry->dwExpireTime = GetCurrentTimeInSeconds() + dwTtl;
+
+    /* A newer answer replaces the one we had */
+    OldEntry = DnsIntCacheFindEntry(Name, wType);
+    if (OldEntry)
+        DnsIntCacheRemoveEntryItem(OldEntry);
+
+    /* Insert it to our List */
+    InsertTailList(&DnsCache.Buckets[DnsIntCacheHash(Name)], &Entry->CacheLink);
+
+    DnsCache.Statistics.dwEntries++;
+    if (!Entry->Record)
+        DnsCache.Statistics.dwNegativeEntries++;
+
+    /* Release the cache */
+    DnsCacheUnlock();
+}
+
+static
+VOID
+DnsIntCacheScavenge(VOID)
+{
+    struct
+    {
+        WORD wType;
+        WCHAR szName[CACHE_MAX_NAME_LENGTH];
+    } Prefetch[CACHE_PREFETCH_MAX];
+    PLIST_ENTRY Entry, NextEntry;
+    PRESOLVER_CACHE_ENTRY CacheEntry;
+    PDNS_RECORDW Record;
+    DNS_STATUS Status;
+    DWORD dwNow, dwRemaining;
+    ULONG i, Count = 0;
+
+    /* Lock the cache */
+    DnsCacheLock();
+
+    dwNow = GetCurrentTimeInSeconds();
+
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS; i++)
+    {
+        Entry = DnsCache.Buckets[i].Flink;
+        while (Entry != &DnsCache.Buckets[i])
+        {
+            NextEntry = Entry->Flink;
+
+            CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
+
+            if (DnsIntCacheIsExpired(CacheEntry, dwNow))
+            {
+                DnsIntCacheRemoveEntryItem(CacheEntry);
+                DnsCache.Statistics.dwExpired++;
+            }
+            else if (!CacheEntry->bHostsFileEntry &&
+                     CacheEntry->Record != NULL &&
+                     CacheEntry->dwHits >= CACHE_PREFETCH_HITS &&
+                     Count < CACHE_PREFETCH_MAX)
+            {
+                /* Names still in use get asked for again before they run out,
+                 * so lookups keep hitting the cache */
+                dwRemaining = CacheEntry->dwExpireTime - dwNow;
+                if (dwRemaining <= max(CacheEntry->dwTtl / 10, CACHE_SCAVENGE_INTERVAL) &&
+                    SUCCEEDED(StringCchCopyW(Prefetch[Count].szName,
+                                             ARRAYSIZE(Prefetch[Count].szName),
+                                             CacheEntry->pszName)))
+                {
+                    Prefetch[Count].wType = CacheEntry->wType;
+                    Count++;
+                }
+            }
+
+            Entry = NextEntry;
+        }
+    }
+
+    /* Release the cache */
+    DnsCacheUnlock();
+
+    /* Query without holding the lock, lookups go on meanwhile */
+    for (i = 0; i < Count; i++)
+    {
+        DPRINT("Prefetching %S %hu\n", Prefetch[i].szName, Prefetch[i].wType);
+
+        Status = Query_Main(Prefetch[i].szName,
+                            Prefetch[i].wType,
+                            0,
+                            (PDNS_RECORD *)&Record);
+        if (Status == ERROR_SUCCESS)
+        {
+            DnsIntCacheAddEntry(Record, FALSE);
+            DnsRecordListFree((PDNS_RECORD)Record, DnsFreeRecordList);
+
+            DnsCacheLock();
+            DnsCache.Statistics.dwPrefetches++;
+            DnsCacheUnlock();
+        }
+    }
+}
+
+static
+DWORD
+WINAPI
+DnsIntCacheScavengerThread(
+    _In_ LPVOID lpParameter)
+{
+    UNREFERENCED_PARAMETER(lpParameter);
+
+    while (WaitForSingleObject(DnsCache.hStopEvent,
+                               CACHE_SCAVENGE_INTERVAL * 1000) == WAIT_TIMEOUT)
+    {
+        DnsIntCacheScavenge();
+    }
+
+    return 0;
+}
+
 VOID
 DnsIntCacheInitialize(VOID)
 {
+    ULONG i;
+
     DPRINT("DnsIntCacheInitialize()\n");
 
     /* Check if we're initialized */
     if (DnsCacheInitialized)
         return;
 
-    /* Initialize the cache lock and namespace list */
+    /* Initialize the cache lock and the hash buckets */
     InitializeCriticalSection((LPCRITICAL_SECTION)&DnsCache.Lock);
-    InitializeListHead(&DnsCache.RecordList);
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS; i++)
+        InitializeListHead(&DnsCache.Buckets[i]);
+    ZeroMemory(&DnsCache.Statistics, sizeof(DnsCache.Statistics));
+
+    /* Start the thread that expires and refreshes entries. Without it
+     * expired entries are still dropped when they're looked up */
+    DnsCache.hScavengerThread = NULL;
+    DnsCache.hStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (DnsCache.hStopEvent)
+    {
+        DnsCache.hScavengerThread = CreateThread(NULL,
+                                                 0,
+                                                 DnsIntCacheScavengerThread,
+                                                 NULL,
+                                                 0,
+                                                 NULL);
+        if (!DnsCache.hScavengerThread)
+        {
+            DPRINT1("Can't create the cache scavenger thread (%lu)\n", GetLastError());
+        }
+    }
+
     DnsCacheInitialized = TRUE;
 }
 
@@ -41,15 +297,27 @@ DnsIntCacheFree(VOID)
     if (!DnsCacheInitialized)
         return;
 
-    if (!DnsCache.RecordList.Flink)
-        return;
+    /* Stop the scavenger before the entries go away */
+    if (DnsCache.hScavengerThread)
+    {
+        SetEvent(DnsCache.hStopEvent);
+        WaitForSingleObject(DnsCache.hScavengerThread, INFINITE);
+        CloseHandle(DnsCache.hScavengerThread);
+        DnsCache.hScavengerThread = NULL;
+    }
+
+    if (DnsCache.hStopEvent)
+    {
+        CloseHandle(DnsCache.hStopEvent);
+        DnsCache.hStopEvent = NULL;
+    }
 
     DnsIntCacheFlush(CACHE_FLUSH_ALL);
 
     DeleteCriticalSection(&DnsCache.Lock);
     DnsCacheInitialized = FALSE;
 }
- 
+
 VOID
 DnsIntCacheRemoveEntryItem(PRESOLVER_CACHE_ENTRY CacheEntry)
 {
@@ -57,9 +325,14 @@ DnsIntCacheRemoveEntryItem(PRESOLVER_CACHE_ENTRY CacheEntry)
 
     /* Remove the entry from the list */
     RemoveEntryList(&CacheEntry->CacheLink);
- 
+
+    DnsCache.Statistics.dwEntries--;
+    if (!CacheEntry->Record)
+        DnsCache.Statistics.dwNegativeEntries--;
+
     /* Free record */
-    DnsRecordListFree(CacheEntry->Record, DnsFreeRecordList);
+    if (CacheEntry->Record)
+        DnsRecordListFree(CacheEntry->Record, DnsFreeRecordList);
 
     /* Delete us */
     HeapFree(GetProcessHeap(), 0, CacheEntry);
@@ -71,6 +344,7 @@ DnsIntCacheFlush(
 {
     PLIST_ENTRY Entry, NextEntry;
     PRESOLVER_CACHE_ENTRY CacheEntry;
+    ULONG i;
 
     DPRINT("DnsIntCacheFlush(%lu)\n", ulFlags);
 
@@ -78,21 +352,24 @@ DnsIntCacheFlush(
     DnsCacheLock();
 
     /* Loop every entry */
-    Entry = DnsCache.RecordList.Flink;
-    while (Entry != &DnsCache.RecordList)
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS; i++)
     {
-        NextEntry = Entry->Flink;
+        Entry = DnsCache.Buckets[i].Flink;
+        while (Entry != &DnsCache.Buckets[i])
+        {
+            NextEntry = Entry->Flink;
 
-        /* Get this entry */
-        CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
+            /* Get this entry */
+            CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
 
-        /* Remove it from list */
-        if (((ulFlags & CACHE_FLUSH_HOSTS_FILE_ENTRIES) && (CacheEntry->bHostsFileEntry != FALSE)) ||
-            ((ulFlags & CACHE_FLUSH_NON_HOSTS_FILE_ENTRIES) && (CacheEntry->bHostsFileEntry == FALSE)))
-            DnsIntCacheRemoveEntryItem(CacheEntry);
+            /* Remove it from list */
+            if (((ulFlags & CACHE_FLUSH_HOSTS_FILE_ENTRIES) && (CacheEntry->bHostsFileEntry != FALSE)) ||
+                ((ulFlags & CACHE_FLUSH_NON_HOSTS_FILE_ENTRIES) && (CacheEntry->bHostsFileEntry == FALSE)))
+                DnsIntCacheRemoveEntryItem(CacheEntry);
 
-        /* Move to the next entry */
-        Entry = NextEntry;
+            /* Move to the next entry */
+            Entry = NextEntry;
+        }
     }
 
     /* Unlock the cache */
@@ -108,9 +385,8 @@ DnsIntCacheGetEntryByName(
     DWORD dwFlags,
     PDNS_RECORDW *Record)
 {
-    DNS_STATUS Status = DNS_INFO_NO_RECORDS;
+    DNS_STATUS Status = ERROR_NOT_FOUND;
     PRESOLVER_CACHE_ENTRY CacheEntry;
-    PLIST_ENTRY NextEntry;
 
     DPRINT("DnsIntCacheGetEntryByName(%S %hu 0x%lx %p)\n",
            Name, wType, dwFlags, Record);
@@ -121,23 +397,33 @@ DnsIntCacheGetEntryByName(
     /* Lock the cache */
     DnsCacheLock();
 
-    /* Match the Id with all the entries in the List */
-    NextEntry = DnsCache.RecordList.Flink;
-    while (NextEntry != &DnsCache.RecordList)
+    CacheEntry = DnsIntCacheFindEntry(Name, wType);
+    if (CacheEntry && DnsIntCacheIsExpired(CacheEntry, GetCurrentTimeInSeconds()))
     {
-        /* Get the Current Entry */
-        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
-
-        /* Check if this is the Catalog Entry ID we want */
-        if (_wcsicmp(CacheEntry->Record->pName, Name) == 0)
-        {
-            /* Copy the entry and return it */
-            *Record = DnsRecordSetCopyEx(CacheEntry->Record, DnsCharSetUnicode, DnsCharSetUnicode);
-            Status = ERROR_SUCCESS;
-            break;
-        }
+        /* Too old, go and ask again */
+        DnsIntCacheRemoveEntryItem(CacheEntry);
+        DnsCache.Statistics.dwExpired++;
+        CacheEntry = NULL;
+    }
 
-        NextEntry = NextEntry->Flink;
+    if (!CacheEntry)
+    {
+        DnsCache.Statistics.dwMisses++;
+    }
+    else if (CacheEntry->Record)
+    {
+        /* Copy the entry and return it */
+        *Record = DnsRecordSetCopyEx(CacheEntry->Record, DnsCharSetUnicode, DnsCharSetUnicode);
+        Status = *Record ? ERROR_SUCCESS : ERROR_OUTOFMEMORY;
+        CacheEntry->dwHits++;
+        DnsCache.Statistics.dwHits++;
+    }
+    else
+    {
+        /* We were told recently that there is nothing */
+        Status = CacheEntry->Status;
+        CacheEntry->dwHits++;
+        DnsCache.Statistics.dwNegativeHits++;
     }
 
     /* Release the cache */
@@ -151,30 +437,31 @@ DnsIntCacheRemoveEntryByName(LPCWSTR Name)
 {
     BOOL Ret = FALSE;
     PRESOLVER_CACHE_ENTRY CacheEntry;
-    PLIST_ENTRY NextEntry;
+    PLIST_ENTRY Bucket, Entry, NextEntry;
 
     DPRINT("DnsIntCacheRemoveEntryByName(%S)\n", Name);
 
     /* Lock the cache */
     DnsCacheLock();
 
-    /* Match the Id with all the entries in the List */
-    NextEntry = DnsCache.RecordList.Flink;
-    while (NextEntry != &DnsCache.RecordList)
+    /* Every type cached for the name is in the same bucket */
+    Bucket = &DnsCache.Buckets[DnsIntCacheHash(Name)];
+    Entry = Bucket->Flink;
+    while (Entry != Bucket)
     {
+        NextEntry = Entry->Flink;
+
         /* Get the Current Entry */
-        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+        CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
 
-        /* Check if this is the Catalog Entry ID we want */
-        if (_wcsicmp(CacheEntry->Record->pName, Name) == 0)
+        if (_wcsicmp(CacheEntry->pszName, Name) == 0)
         {
             /* Remove the entry */
             DnsIntCacheRemoveEntryItem(CacheEntry);
             Ret = TRUE;
-            break;
         }
 
-        NextEntry = NextEntry->Flink;
+        Entry = NextEntry;
     }
 
     /* Release the cache */
@@ -189,7 +476,7 @@ DnsIntCacheAddEntry(
     _In_ PDNS_RECORDW Record,
     _In_ BOOL bHostsFileEntry)
 {
-    PRESOLVER_CACHE_ENTRY Entry;
+    DWORD dwTtl;
 
     DPRINT("DnsIntCacheAddEntry(%p %u)\n",
            Record, bHostsFileEntry);
@@ -197,22 +484,35 @@ DnsIntCacheAddEntry(
     DPRINT("Name: %S\n", Record->pName);
     DPRINT("TTL: %lu\n", Record->dwTtl);
 
-    /* Lock the cache */
-    DnsCacheLock();
+    dwTtl = min(Record->dwTtl, CACHE_MAX_TTL);
 
-    /* Match the Id with all the entries in the List */
-    Entry = (PRESOLVER_CACHE_ENTRY)HeapAlloc(GetProcessHeap(), 0, sizeof(*Entry));
-    if (!Entry)
+    /* Nothing to keep */
+    if (dwTtl == 0 && !bHostsFileEntry)
         return;
 
-    Entry->bHostsFileEntry = bHostsFileEntry;
-    Entry->Record = DnsRecordSetCopyEx(Record, DnsCharSetUnicode, DnsCharSetUnicode);
-
-    /* Insert it to our List */
-    InsertTailList(&DnsCache.RecordList, &Entry->CacheLink);
+    DnsIntCacheInsertEntry(Record->pName,
+                           Record->wType,
+                           ERROR_SUCCESS,
+                           Record,
+                           bHostsFileEntry,
+                           dwTtl);
+}
 
-    /* Release the cache */
-    DnsCacheUnlock();
+VOID
+DnsIntCacheAddNegativeEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ DNS_STATUS Status)
+{
+    DPRINT("DnsIntCacheAddNegativeEntry(%S %hu %lu)\n",
+           Name, wType, Status);
+
+    DnsIntCacheInsertEntry(Name,
+                           wType,
+                           Status,
+                           NULL,
+                           FALSE,
+                           CACHE_NEGATIVE_TTL);
 }
 
 DNS_STATUS
@@ -222,49 +522,78 @@ DnsIntCacheGetEntries(
     PRESOLVER_CACHE_ENTRY CacheEntry;
     PLIST_ENTRY NextEntry;
     PDNS_CACHE_ENTRY pLastEntry = NULL, pNewEntry;
+    DNS_STATUS Status = ERROR_SUCCESS;
+    DWORD dwNow;
+    ULONG i;
 
     /* Lock the cache */
     DnsCacheLock();
 
     *ppCacheEntries = NULL;
 
-    NextEntry = DnsCache.RecordList.Flink;
-    while (NextEntry != &DnsCache.RecordList)
-    {
-        /* Get the Current Entry */
-        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
-
-        DPRINT("1 %S %lu\n", CacheEntry->Record->pName, CacheEntry->Record->wType);
-        if (CacheEntry->Record->pNext)
-        {
-            DPRINT("2 %S %lu\n", CacheEntry->Record->pNext->pName, CacheEntry->Record->pNext->wType);
-        }
+    dwNow = GetCurrentTimeInSeconds();
 
-        pNewEntry = midl_user_allocate(sizeof(DNS_CACHE_ENTRY));
-        if (pNewEntry == NULL)
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS && Status == ERROR_SUCCESS; i++)
+    {
+        NextEntry = DnsCache.Buckets[i].Flink;
+        while (NextEntry != &DnsCache.Buckets[i])
         {
-            return ERROR_OUTOFMEMORY;
+            /* Get the Current Entry */
+            CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+            NextEntry = NextEntry->Flink;
+
+            /* Only list the names that resolve */
+            if (!CacheEntry->Record || DnsIntCacheIsExpired(CacheEntry, dwNow))
+                continue;
+
+            DPRINT("1 %S %lu\n", CacheEntry->Record->pName, CacheEntry->Record->wType);
+            if (CacheEntry->Record->pNext)
+            {
+                DPRINT("2 %S %lu\n", CacheEntry->Record->pNext->pName, CacheEntry->Record->pNext->wType);
+            }
+
+            pNewEntry = midl_user_allocate(sizeof(DNS_CACHE_ENTRY));
+            if (pNewEntry == NULL)
+            {
+                Status = ERROR_OUTOFMEMORY;
+                break;
+            }
+
+            pNewEntry->pszName = midl_user_allocate((wcslen(CacheEntry->Record->pName) + 1) * sizeof(WCHAR));
+            if (pNewEntry->pszName == NULL)
+            {
+                midl_user_free(pNewEntry);
+                Status = ERROR_OUTOFMEMORY;
+                break;
+            }
+
+            wcscpy(pNewEntry->pszName, CacheEntry->Record->pName);
+            pNewEntry->wType1 = CacheEntry->Record->wType;
+            pNewEntry->wType2 = 0;
+            pNewEntry->wFlags = 0;
+
+            if (pLastEntry == NULL)
+                *ppCacheEntries = pNewEntry;
+            else
+                pLastEntry->pNext = pNewEntry;
+            pLastEntry = pNewEntry;
         }
+    }
 
-        pNewEntry->pszName = midl_user_allocate((wcslen(CacheEntry->Record->pName) + 1) * sizeof(WCHAR));
-        if (pNewEntry->pszName == NULL)
-        {
-            return ERROR_OUTOFMEMORY;
-        }
+    /* Release the cache */
+    DnsCacheUnlock();
 
-        wcscpy(pNewEntry->pszName, CacheEntry->Record->pName);
-        pNewEntry->wType1 = CacheEntry->Record->wType;
-        pNewEntry->wType2 = 0;
-        pNewEntry->wFlags = 0;
+    return Status;
+}
 
-        if (pLastEntry == NULL)
-            *ppCacheEntries = pNewEntry;
-        else
-            pLastEntry->pNext = pNewEntry;
-        pLastEntry = pNewEntry;
+DNS_STATUS
+DnsIntCacheGetStatistics(
+    _Out_ PDNS_CACHE_STATISTICS pStatistics)
+{
+    /* Lock the cache */
+    DnsCacheLock();
 
-        NextEntry = NextEntry->Flink;
-    }
+    *pStatistics = DnsCache.Statistics;
 
     /* Release the cache */
     DnsCacheUnlock();
@@ -27,14 +27,25 @@
 typedef struct _RESOLVER_CACHE_ENTRY
 {
     LIST_ENTRY CacheLink;
+    LPWSTR pszName;
+    WORD wType;
     BOOL bHostsFileEntry;
-    PDNS_RECORDW Record;
+    DNS_STATUS Status;      /* Answer for negative entries */
+    DWORD dwTtl;            /* Lifetime, in seconds */
+    DWORD dwExpireTime;     /* In GetCurrentTimeInSeconds() time */
+    DWORD dwHits;           /* Lookups answered by this entry */
+    PDNS_RECORDW Record;    /* NULL for negative entries */
 } RESOLVER_CACHE_ENTRY, *PRESOLVER_CACHE_ENTRY;
 
+#define RESOLVER_CACHE_BUCKETS 256
+
 typedef struct _RESOLVER_CACHE
 {
-    LIST_ENTRY RecordList;
+    LIST_ENTRY Buckets[RESOLVER_CACHE_BUCKETS];
     CRITICAL_SECTION Lock;
+    DNS_CACHE_STATISTICS Statistics;
+    HANDLE hStopEvent;
+    HANDLE hScavengerThread;
 } RESOLVER_CACHE, *PRESOLVER_CACHE;
 
 
@@ -64,6 +75,12 @@ DnsIntCacheAddEntry(
     _In_ PDNS_RECORDW Record,
     _In_ BOOL bHostsFileEntry);
 
+VOID
+DnsIntCacheAddNegativeEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ DNS_STATUS Status);
+
 BOOL
 DnsIntCacheRemoveEntryByName(
     _In_ LPCWSTR Name);
@@ -72,6 +89,10 @@ DNS_STATUS
 DnsIntCacheGetEntries(
     _Out_ DNS_CACHE_ENTRY **ppCacheEntries);
 
+DNS_STATUS
+DnsIntCacheGetStatistics(
+    _Out_ PDNS_CACHE_STATISTICS pStatistics);
+
 
 /* hostsfile.c */
 
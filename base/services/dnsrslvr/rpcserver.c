@@ -107,6 +107,8 @@ R_ResolverQuery(
                                            wType,
                                            dwFlags,
                                            ppResultRecords);
+        if (Status == ERROR_NOT_FOUND)
+            Status = DNS_INFO_NO_RECORDS;
     }
     else
     {
@@ -115,7 +117,7 @@ R_ResolverQuery(
                                            wType,
                                            dwFlags,
                                            ppResultRecords);
-        if (Status == DNS_INFO_NO_RECORDS)
+        if (Status == ERROR_NOT_FOUND)
         {
             DPRINT("DNS query!\n");
             Status = Query_Main(pszName,
@@ -127,6 +129,12 @@ R_ResolverQuery(
                 DPRINT("DNS query successful!\n");
                 DnsIntCacheAddEntry(*ppResultRecords, FALSE);
             }
+            else if (Status == DNS_ERROR_RCODE_NAME_ERROR ||
+                     Status == DNS_INFO_NO_RECORDS)
+            {
+                /* The server says there is nothing, remember that too */
+                DnsIntCacheAddNegativeEntry(pszName, wType, Status);
+            }
         }
     }
 
@@ -151,6 +159,19 @@ R_ResolverQuery(
     return Status;
 }
 
+/* ReactOS specific */
+DWORD
+__stdcall
+R_ResolverGetCacheStatistics(
+    _In_ DNSRSLVR_HANDLE pwszServerName,
+    _Out_ DNS_CACHE_STATISTICS *pStatistics)
+{
+    DPRINT("R_ResolverGetCacheStatistics(%S %p)\n",
+           pwszServerName, pStatistics);
+
+    return DnsIntCacheGetStatistics(pStatistics);
+}
+
 void __RPC_FAR * __RPC_USER midl_user_allocate(SIZE_T len)
 {
     return HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, len);
@@ -75,6 +75,9 @@ ServiceControlHandler(DWORD dwControl,
                             0,
                             EVENT_EventlogStopped, 0, NULL, 0, NULL);
 
+            /* Commit the records still pending in the logs */
+            LogfFlushAll();
+
             /* Stop listening to incoming RPC messages */
             RpcMgmtStopServerListening(NULL);
             UpdateServiceStatus(SERVICE_STOPPED);
@@ -103,6 +106,9 @@ ServiceControlHandler(DWORD dwControl,
                             0,
                             EVENT_EventlogStopped, 0, NULL, 0, NULL);
 
+            /* Commit the records still pending in the logs */
+            LogfFlushAll();
+
             UpdateServiceStatus(SERVICE_STOPPED);
             return ERROR_SUCCESS;
 
@@ -147,7 +153,7 @@ ServiceInit(VOID)
     else
         CloseHandle(hThread);
 
-    return ERROR_SUCCESS;
+    return LogfStartFlushThread();
 }
 
 
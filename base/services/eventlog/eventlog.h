@@ -102,6 +102,10 @@ LogfClose(PLOGFILE LogFile,
 
 VOID LogfCloseAll(VOID);
 
+VOID LogfFlushAll(VOID);
+
+DWORD LogfStartFlushThread(VOID);
+
 NTSTATUS
 LogfClearFile(PLOGFILE LogFile,
               PUNICODE_STRING BackupFileName);
@@ -22,6 +22,12 @@
 static LIST_ENTRY LogFileListHead;
 static CRITICAL_SECTION LogFileListCs;
 
+/* Records written since the last commit are flushed at most this late */
+#define LOGFILE_FLUSH_INTERVAL  1000 // In milliseconds
+
+static HANDLE LogFileFlushThread = NULL;
+static HANDLE LogFileFlushStopEvent = NULL;
+
 /* LOG FILE LIST - FUNCTIONS *************************************************/
 
 VOID LogfListInitialize(VOID)
@@ -449,8 +455,97 @@ LogfClose(PLOGFILE LogFile,
     return;
 }
 
+VOID LogfFlushAll(VOID)
+{
+    PLIST_ENTRY CurrentEntry;
+    PLOGFILE Item;
+    NTSTATUS Status;
+
+    EnterCriticalSection(&LogFileListCs);
+
+    CurrentEntry = LogFileListHead.Flink;
+    while (CurrentEntry != &LogFileListHead)
+    {
+        Item = CONTAINING_RECORD(CurrentEntry, LOGFILE, ListEntry);
+        CurrentEntry = CurrentEntry->Flink;
+
+        if (!(ElfGetFlags(&Item->LogFile) & ELF_LOGFILE_HEADER_DIRTY))
+            continue;
+
+        /*
+         * Do not wait for the log lock: LogfClose() acquires it before
+         * the list lock. A busy log is committed on the next pass.
+         */
+        if (!RtlAcquireResourceExclusive(&Item->Lock, FALSE))
+            continue;
+
+        Status = ElfFlushFile(&Item->LogFile);
+        if (!NT_SUCCESS(Status))
+            DPRINT1("Cannot flush log file `%S' (Status 0x%08lx)\n", Item->LogName, Status);
+
+        RtlReleaseResource(&Item->Lock);
+    }
+
+    LeaveCriticalSection(&LogFileListCs);
+}
+
+static DWORD WINAPI
+LogfFlushThreadRoutine(LPVOID lpParameter)
+{
+    UNREFERENCED_PARAMETER(lpParameter);
+
+    /* Commit all the records written during the last interval at once */
+    while (WaitForSingleObject(LogFileFlushStopEvent, LOGFILE_FLUSH_INTERVAL) == WAIT_TIMEOUT)
+        LogfFlushAll();
+
+    return 0;
+}
+
+DWORD LogfStartFlushThread(VOID)
+{
+    DWORD dwError;
+
+    LogFileFlushStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!LogFileFlushStopEvent)
+        return GetLastError();
+
+    LogFileFlushThread = CreateThread(NULL,
+                                      0,
+                                      LogfFlushThreadRoutine,
+                                      NULL,
+                                      0,
+                                      NULL);
+    if (!LogFileFlushThread)
+    {
+        dwError = GetLastError();
+        CloseHandle(LogFileFlushStopEvent);
+        LogFileFlushStopEvent = NULL;
+        return dwError;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static VOID
+LogfStopFlushThread(VOID)
+{
+    if (!LogFileFlushThread)
+        return;
+
+    SetEvent(LogFileFlushStopEvent);
+    WaitForSingleObject(LogFileFlushThread, INFINITE);
+
+    CloseHandle(LogFileFlushThread);
+    CloseHandle(LogFileFlushStopEvent);
+    LogFileFlushThread = NULL;
+    LogFileFlushStopEvent = NULL;
+}
+
 VOID LogfCloseAll(VOID)
 {
+    /* Closing the logs below commits any pending records */
+    LogfStopFlushThread();
+
     EnterCriticalSection(&LogFileListCs);
 
     while (!IsListEmpty(&LogFileListHead))
@@ -37,6 +37,39 @@ static DWORD ServiceTag = 0;
 static CRITICAL_SECTION ControlServiceCriticalSection;
 static DWORD PipeTimeout = 30000; /* 30 Seconds */
 
+/* The critical section synchronizes the creation of service images */
+static CRITICAL_SECTION ImageCriticalSection;
+
+/* Upper bound of the threads starting services in parallel at boot */
+#define AUTOSTART_MAX_WORKERS 8
+
+typedef struct _AUTOSTART_ENTRY
+{
+    PSERVICE Service;
+    DWORD dwPendingCount;   /* Dependencies which did not start yet */
+    DWORD dwStartTick;
+    BOOL bQueued;
+    BOOL bStarted;
+    BOOL bDone;
+    BOOL bReleased;         /* Dependent services may start */
+} AUTOSTART_ENTRY, *PAUTOSTART_ENTRY;
+
+typedef struct _AUTOSTART_PLAN
+{
+    CRITICAL_SECTION Lock;
+    HANDLE hReadySemaphore;
+    HANDLE hProgressEvent;
+    DWORD dwCount;
+    PAUTOSTART_ENTRY Entries;
+    /* DependsOn[i * dwCount + j] is set if entry i waits for entry j */
+    PBYTE DependsOn;
+    PDWORD ReadyQueue;
+    DWORD dwReadyHead;
+    DWORD dwReadyTail;
+    DWORD dwRunningCount;
+    DWORD dwDoneCount;
+} AUTOSTART_PLAN, *PAUTOSTART_PLAN;
+
 
 /* FUNCTIONS *****************************************************************/
 
@@ -2036,6 +2069,8 @@ ScmLoadService(PSERVICE Service,
 
     DPRINT("Service->Type: %lu\n", Service->Status.dwServiceType);
 
+    ScmBootPerfMark(BootPerfService, BOOTPERF_MARK_BEGIN, Service->lpServiceName);
+
     if (Service->Status.dwServiceType & SERVICE_DRIVER)
     {
         /* Start the driver */
@@ -2044,7 +2079,9 @@ ScmLoadService(PSERVICE Service,
     else // if (Service->Status.dwServiceType & (SERVICE_WIN32 | SERVICE_INTERACTIVE_PROCESS))
     {
         /* Start user-mode service */
+        EnterCriticalSection(&ImageCriticalSection);
         dwError = ScmCreateOrReferenceServiceImage(Service);
+        LeaveCriticalSection(&ImageCriticalSection);
         if (dwError == ERROR_SUCCESS)
         {
             dwError = ScmStartUserModeService(Service, argc, argv);
@@ -2055,18 +2092,22 @@ ScmLoadService(PSERVICE Service,
             }
             else
             {
+                EnterCriticalSection(&ImageCriticalSection);
                 Service->lpImage->dwImageRunCount--;
                 if (Service->lpImage->dwImageRunCount == 0)
                 {
                     ScmRemoveServiceImage(Service->lpImage);
                     Service->lpImage = NULL;
                 }
+                LeaveCriticalSection(&ImageCriticalSection);
             }
         }
     }
 
     DPRINT("ScmLoadService() done (Error %lu)\n", dwError);
 
+    ScmBootPerfMark(BootPerfService, BOOTPERF_MARK_END, Service->lpServiceName);
+
     if (dwError == ERROR_SUCCESS)
     {
         if (Group != NULL)
@@ -2166,6 +2207,319 @@ done:
     return dwError;
 }
 
+static VOID
+ScmAddAutoStartEntry(PAUTOSTART_PLAN Plan,
+                     PSERVICE Service)
+{
+    Service->ServiceVisited = TRUE;
+
+    /* Without a plan, start the service right away like we used to */
+    if (Plan->Entries == NULL)
+    {
+        ScmLoadService(Service, 0, NULL);
+        return;
+    }
+
+    Plan->Entries[Plan->dwCount].Service = Service;
+    Plan->dwCount++;
+}
+
+
+static VOID
+ScmAddAutoStartDependencies(PAUTOSTART_PLAN Plan,
+                            DWORD dwIndex,
+                            LPCWSTR lpDependencies)
+{
+    PBYTE DependsOn = &Plan->DependsOn[dwIndex * Plan->dwCount];
+    PSERVICE Service;
+    LPCWSTR lpName;
+    DWORD i;
+
+    for (lpName = lpDependencies; *lpName != 0; lpName += wcslen(lpName) + 1)
+    {
+        for (i = 0; i < Plan->dwCount; i++)
+        {
+            if (i == dwIndex)
+                continue;
+
+            Service = Plan->Entries[i].Service;
+
+            if (*lpName == SC_GROUP_IDENTIFIERW)
+            {
+                /* Wait for every auto-start member of the group */
+                if (Service->lpGroup != NULL &&
+                    _wcsicmp(Service->lpGroup->lpGroupName, lpName + 1) == 0)
+                {
+                    DependsOn[i] = TRUE;
+                }
+            }
+            else if (_wcsicmp(Service->lpServiceName, lpName) == 0)
+            {
+                DependsOn[i] = TRUE;
+            }
+        }
+    }
+}
+
+
+/*
+ * Turns the load order list into a dependency graph. Besides the
+ * DependOnService and DependOnGroup values:
+ * - drivers are loaded one at a time, in load order, and everything
+ *   which comes after a driver in the load order waits for it;
+ * - services sharing an image are started one at a time, in load order,
+ *   because only the first one creates the process.
+ */
+static DWORD
+ScmBuildAutoStartPlan(PAUTOSTART_PLAN Plan)
+{
+    LPWSTR *ImagePaths;
+    LPWSTR lpDependencies;
+    DWORD dwDependenciesLength;
+    PSERVICE Service;
+    HKEY hServiceKey;
+    DWORD dwBarrier = (DWORD)-1;
+    DWORD i, j;
+
+    Plan->DependsOn = HeapAlloc(GetProcessHeap(),
+                                HEAP_ZERO_MEMORY,
+                                Plan->dwCount * Plan->dwCount);
+    Plan->ReadyQueue = HeapAlloc(GetProcessHeap(),
+                                 0,
+                                 Plan->dwCount * sizeof(DWORD));
+    ImagePaths = HeapAlloc(GetProcessHeap(),
+                           HEAP_ZERO_MEMORY,
+                           Plan->dwCount * sizeof(LPWSTR));
+    if (Plan->DependsOn == NULL || Plan->ReadyQueue == NULL || ImagePaths == NULL)
+    {
+        if (ImagePaths != NULL)
+            HeapFree(GetProcessHeap(), 0, ImagePaths);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    for (i = 0; i < Plan->dwCount; i++)
+    {
+        Service = Plan->Entries[i].Service;
+
+        if (Service->Status.dwServiceType & SERVICE_DRIVER)
+        {
+            /* Wait for everything since the previous driver */
+            for (j = (dwBarrier == (DWORD)-1) ? 0 : dwBarrier; j < i; j++)
+                Plan->DependsOn[i * Plan->dwCount + j] = TRUE;
+
+            dwBarrier = i;
+            continue;
+        }
+
+        if (dwBarrier != (DWORD)-1)
+            Plan->DependsOn[i * Plan->dwCount + dwBarrier] = TRUE;
+
+        if (ScmOpenServiceKey(Service->lpServiceName,
+                              KEY_READ,
+                              &hServiceKey) != ERROR_SUCCESS)
+            continue;
+
+        if (ScmReadDependencies(hServiceKey,
+                                &lpDependencies,
+                                &dwDependenciesLength) == ERROR_SUCCESS &&
+            lpDependencies != NULL)
+        {
+            ScmAddAutoStartDependencies(Plan, i, lpDependencies);
+            HeapFree(GetProcessHeap(), 0, lpDependencies);
+        }
+
+        if (ScmReadString(hServiceKey, L"ImagePath", &ImagePaths[i]) == ERROR_SUCCESS)
+        {
+            /* Wait for the previous service living in the same image */
+            for (j = i; j-- > 0; )
+            {
+                if (ImagePaths[j] != NULL &&
+                    _wcsicmp(ImagePaths[j], ImagePaths[i]) == 0)
+                {
+                    Plan->DependsOn[i * Plan->dwCount + j] = TRUE;
+                    break;
+                }
+            }
+        }
+
+        RegCloseKey(hServiceKey);
+    }
+
+    for (i = 0; i < Plan->dwCount; i++)
+    {
+        if (ImagePaths[i] != NULL)
+            HeapFree(GetProcessHeap(), 0, ImagePaths[i]);
+
+        for (j = 0; j < Plan->dwCount; j++)
+            Plan->Entries[i].dwPendingCount += Plan->DependsOn[i * Plan->dwCount + j];
+    }
+
+    HeapFree(GetProcessHeap(), 0, ImagePaths);
+    return ERROR_SUCCESS;
+}
+
+
+/* Called with the plan lock held */
+static VOID
+ScmQueueAutoStartEntry(PAUTOSTART_PLAN Plan,
+                       DWORD dwIndex)
+{
+    if (Plan->Entries[dwIndex].bQueued)
+        return;
+
+    Plan->Entries[dwIndex].bQueued = TRUE;
+    Plan->ReadyQueue[Plan->dwReadyTail++] = dwIndex;
+    ReleaseSemaphore(Plan->hReadySemaphore, 1, NULL);
+}
+
+
+/* Called with the plan lock held */
+static VOID
+ScmReleaseAutoStartEntry(PAUTOSTART_PLAN Plan,
+                         DWORD dwIndex)
+{
+    DWORD i;
+
+    if (Plan->Entries[dwIndex].bReleased)
+        return;
+
+    Plan->Entries[dwIndex].bReleased = TRUE;
+
+    for (i = 0; i < Plan->dwCount; i++)
+    {
+        if (Plan->DependsOn[i * Plan->dwCount + dwIndex] &&
+            --Plan->Entries[i].dwPendingCount == 0)
+        {
+            ScmQueueAutoStartEntry(Plan, i);
+        }
+    }
+}
+
+
+static DWORD
+WINAPI
+ScmAutoStartWorker(LPVOID lpParameter)
+{
+    PAUTOSTART_PLAN Plan = lpParameter;
+    PAUTOSTART_ENTRY Entry;
+    DWORD dwIndex;
+
+    for (;;)
+    {
+        WaitForSingleObject(Plan->hReadySemaphore, INFINITE);
+
+        EnterCriticalSection(&Plan->Lock);
+
+        /* An empty queue means we are done */
+        if (Plan->dwReadyHead == Plan->dwReadyTail)
+        {
+            LeaveCriticalSection(&Plan->Lock);
+            break;
+        }
+
+        dwIndex = Plan->ReadyQueue[Plan->dwReadyHead++];
+        Entry = &Plan->Entries[dwIndex];
+        Entry->bStarted = TRUE;
+        Entry->dwStartTick = GetTickCount();
+        Plan->dwRunningCount++;
+
+        LeaveCriticalSection(&Plan->Lock);
+
+        ScmLoadService(Entry->Service, 0, NULL);
+
+        EnterCriticalSection(&Plan->Lock);
+        Entry->bDone = TRUE;
+        Plan->dwRunningCount--;
+        Plan->dwDoneCount++;
+        ScmReleaseAutoStartEntry(Plan, dwIndex);
+        LeaveCriticalSection(&Plan->Lock);
+
+        SetEvent(Plan->hProgressEvent);
+    }
+
+    return 0;
+}
+
+
+static VOID
+ScmRunAutoStartPlan(PAUTOSTART_PLAN Plan)
+{
+    HANDLE hWorkers[AUTOSTART_MAX_WORKERS];
+    SYSTEM_INFO SystemInfo;
+    PAUTOSTART_ENTRY Entry;
+    DWORD dwWorkerCount;
+    DWORD dwMaxWorkers;
+    DWORD i;
+
+    GetSystemInfo(&SystemInfo);
+    dwMaxWorkers = min(max(2 * SystemInfo.dwNumberOfProcessors, 2), AUTOSTART_MAX_WORKERS);
+
+    EnterCriticalSection(&Plan->Lock);
+
+    for (i = 0; i < Plan->dwCount; i++)
+    {
+        if (Plan->Entries[i].dwPendingCount == 0)
+            ScmQueueAutoStartEntry(Plan, i);
+    }
+
+    for (dwWorkerCount = 0; dwWorkerCount < dwMaxWorkers; dwWorkerCount++)
+    {
+        hWorkers[dwWorkerCount] = CreateThread(NULL, 0, ScmAutoStartWorker, Plan, 0, NULL);
+        if (hWorkers[dwWorkerCount] == NULL)
+            break;
+    }
+
+    while (dwWorkerCount > 0 && Plan->dwDoneCount < Plan->dwCount)
+    {
+        LeaveCriticalSection(&Plan->Lock);
+        WaitForSingleObject(Plan->hProgressEvent, 1000);
+        EnterCriticalSection(&Plan->Lock);
+
+        /* Do not let a service which takes too long to start hold up its dependents forever */
+        for (i = 0; i < Plan->dwCount; i++)
+        {
+            Entry = &Plan->Entries[i];
+            if (Entry->bStarted && !Entry->bDone && !Entry->bReleased &&
+                GetTickCount() - Entry->dwStartTick >= PipeTimeout)
+            {
+                DPRINT1("Service %S is taking too long to start\n", Entry->Service->lpServiceName);
+                ScmReleaseAutoStartEntry(Plan, i);
+            }
+        }
+
+        /* Nothing can make progress because of a dependency cycle: break it in load order */
+        if (Plan->dwRunningCount == 0 && Plan->dwReadyHead == Plan->dwReadyTail)
+        {
+            for (i = 0; i < Plan->dwCount; i++)
+            {
+                if (!Plan->Entries[i].bQueued)
+                {
+                    DPRINT1("Circular dependency, starting %S\n", Plan->Entries[i].Service->lpServiceName);
+                    ScmQueueAutoStartEntry(Plan, i);
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Wake up the workers with an empty queue so that they exit */
+    ReleaseSemaphore(Plan->hReadySemaphore, dwWorkerCount, NULL);
+    LeaveCriticalSection(&Plan->Lock);
+
+    if (dwWorkerCount > 0)
+    {
+        WaitForMultipleObjects(dwWorkerCount, hWorkers, TRUE, INFINITE);
+        for (i = 0; i < dwWorkerCount; i++)
+            CloseHandle(hWorkers[i]);
+    }
+    else
+    {
+        /* No worker thread, start everything from here in load order */
+        for (i = 0; i < Plan->dwCount; i++)
+            ScmLoadService(Plan->Entries[i].Service, 0, NULL);
+    }
+}
+
 
 VOID
 ScmAutoStartServices(VOID)
@@ -2179,6 +2533,8 @@ ScmAutoStartServices(VOID)
     DWORD SafeBootEnabled;
     HKEY hKey;
     DWORD dwKeySize;
+    AUTOSTART_PLAN Plan;
+    DWORD dwServiceCount = 0;
     ULONG i;
 
     /*
@@ -2278,9 +2634,26 @@ ScmAutoStartServices(VOID)
             }
         }
 
+        dwServiceCount++;
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    /*
+     * Collect the services to start in load order first, then start them
+     * in parallel as far as their dependencies allow. Without the memory
+     * for the plan, they get started one by one while being collected.
+     */
+    ZeroMemory(&Plan, sizeof(Plan));
+    InitializeCriticalSection(&Plan.Lock);
+    Plan.hReadySemaphore = CreateSemaphoreW(NULL, 0, MAXLONG, NULL);
+    Plan.hProgressEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (Plan.hReadySemaphore != NULL && Plan.hProgressEvent != NULL && dwServiceCount > 0)
+    {
+        Plan.Entries = HeapAlloc(GetProcessHeap(),
+                                 HEAP_ZERO_MEMORY,
+                                 dwServiceCount * sizeof(AUTOSTART_ENTRY));
+    }
+
     /* Start all services which are members of an existing group */
     GroupEntry = GroupListHead.Flink;
     while (GroupEntry != &GroupListHead)
@@ -2302,8 +2675,7 @@ ScmAutoStartServices(VOID)
                     (CurrentService->ServiceVisited == FALSE) &&
                     (CurrentService->dwTag == CurrentGroup->TagArray[i]))
                 {
-                    CurrentService->ServiceVisited = TRUE;
-                    ScmLoadService(CurrentService, 0, NULL);
+                    ScmAddAutoStartEntry(&Plan, CurrentService);
                 }
 
                 ServiceEntry = ServiceEntry->Flink;
@@ -2320,8 +2692,7 @@ ScmAutoStartServices(VOID)
                 (CurrentService->dwStartType == SERVICE_AUTO_START) &&
                 (CurrentService->ServiceVisited == FALSE))
             {
-                CurrentService->ServiceVisited = TRUE;
-                ScmLoadService(CurrentService, 0, NULL);
+                ScmAddAutoStartEntry(&Plan, CurrentService);
             }
 
             ServiceEntry = ServiceEntry->Flink;
@@ -2340,8 +2711,7 @@ ScmAutoStartServices(VOID)
             (CurrentService->dwStartType == SERVICE_AUTO_START) &&
             (CurrentService->ServiceVisited == FALSE))
         {
-            CurrentService->ServiceVisited = TRUE;
-            ScmLoadService(CurrentService, 0, NULL);
+            ScmAddAutoStartEntry(&Plan, CurrentService);
         }
 
         ServiceEntry = ServiceEntry->Flink;
@@ -2357,13 +2727,37 @@ ScmAutoStartServices(VOID)
             (CurrentService->dwStartType == SERVICE_AUTO_START) &&
             (CurrentService->ServiceVisited == FALSE))
         {
-            CurrentService->ServiceVisited = TRUE;
-            ScmLoadService(CurrentService, 0, NULL);
+            ScmAddAutoStartEntry(&Plan, CurrentService);
         }
 
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    if (Plan.Entries != NULL && Plan.dwCount > 0)
+    {
+        if (ScmBuildAutoStartPlan(&Plan) == ERROR_SUCCESS)
+        {
+            ScmRunAutoStartPlan(&Plan);
+        }
+        else
+        {
+            for (i = 0; i < Plan.dwCount; i++)
+                ScmLoadService(Plan.Entries[i].Service, 0, NULL);
+        }
+    }
+
+    if (Plan.ReadyQueue != NULL)
+        HeapFree(GetProcessHeap(), 0, Plan.ReadyQueue);
+    if (Plan.DependsOn != NULL)
+        HeapFree(GetProcessHeap(), 0, Plan.DependsOn);
+    if (Plan.Entries != NULL)
+        HeapFree(GetProcessHeap(), 0, Plan.Entries);
+    if (Plan.hProgressEvent != NULL)
+        CloseHandle(Plan.hProgressEvent);
+    if (Plan.hReadySemaphore != NULL)
+        CloseHandle(Plan.hReadySemaphore);
+    DeleteCriticalSection(&Plan.Lock);
+
     /* Clear 'ServiceVisited' flag again */
     ServiceEntry = ServiceListHead.Flink;
     while (ServiceEntry != &ServiceListHead)
@@ -2445,6 +2839,7 @@ ScmInitNamedPipeCriticalSection(VOID)
     DWORD dwError;
 
     InitializeCriticalSection(&ControlServiceCriticalSection);
+    InitializeCriticalSection(&ImageCriticalSection);
 
     dwError = RegOpenKeyExW(HKEY_LOCAL_MACHINE,
                             L"SYSTEM\\CurrentControlSet\\Control",
@@ -2468,6 +2863,7 @@ ScmInitNamedPipeCriticalSection(VOID)
 VOID
 ScmDeleteNamedPipeCriticalSection(VOID)
 {
+    DeleteCriticalSection(&ImageCriticalSection);
     DeleteCriticalSection(&ControlServiceCriticalSection);
 }
 
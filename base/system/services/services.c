@@ -13,6 +13,7 @@
 #include "services.h"
 
 #include <wincon.h>
+#include <strsafe.h>
 
 #define NDEBUG
 #include <debug.h>
@@ -30,6 +31,7 @@ BOOL ScmShutdown = FALSE;
 BOOL ScmLiveSetup = FALSE;
 static HANDLE hScmShutdownEvent = NULL;
 static HANDLE hScmSecurityServicesEvent = NULL;
+static BOOL ScmBootPerfActive = TRUE;
 
 
 /* FUNCTIONS *****************************************************************/
@@ -199,6 +201,33 @@ ScmWaitForLsa(VOID)
 }
 
 
+/* Adds an event to the kernel boot timeline, if one is being recorded */
+VOID
+ScmBootPerfMark(ULONG Type,
+                ULONG Flags,
+                LPCWSTR lpName)
+{
+    BOOTPERF_MARK Mark;
+    NTSTATUS Status;
+
+    if (!ScmBootPerfActive)
+        return;
+
+    Mark.Type = Type;
+    Mark.Flags = Flags;
+    StringCchCopyW(Mark.Name, ARRAYSIZE(Mark.Name), lpName);
+
+    Status = NtSetSystemInformation(SystemPerformanceTraceInformation,
+                                    &Mark,
+                                    sizeof(Mark));
+    if (!NT_SUCCESS(Status))
+    {
+        /* Not booted with /BOOTPERF, or the timeline is written already */
+        ScmBootPerfActive = FALSE;
+    }
+}
+
+
 BOOL WINAPI
 ShutdownHandlerRoutine(DWORD dwCtrlType)
 {
@@ -338,7 +367,9 @@ wWinMain(HINSTANCE hInstance,
     SetProcessShutdownParameters(480, SHUTDOWN_NORETRY);
 
     /* Start auto-start services */
+    ScmBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"AutoStartServices");
     ScmAutoStartServices();
+    ScmBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"AutoStartServices");
 
     /* Signal auto-start complete event */
     SetEvent(hScmAutoStartCompleteEvent);
@@ -20,9 +20,11 @@
 #include <netevent.h>
 #define NTOS_MODE_USER
 #include <ndk/setypes.h>
+#include <ndk/exfuncs.h>
 #include <ndk/obfuncs.h>
 #include <ndk/rtlfuncs.h>
 #include <services/services.h>
+#include <reactos/bootperf.h>
 #include <svcctl_s.h>
 
 #include "resource.h"
@@ -263,5 +265,8 @@ VOID ScmLogEvent(DWORD dwEventId,
                  WORD wStrings,
                  LPCWSTR *lpStrings);
 VOID ScmWaitForLsa(VOID);
+VOID ScmBootPerfMark(ULONG Type,
+                     ULONG Flags,
+                     LPCWSTR lpName);
 
 #endif /* _SERVICES_H */
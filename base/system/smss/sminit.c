@@ -2181,6 +2181,18 @@ Quickie:
     return Status;
 }
 
+ULONG
+NTAPI
+SmpCreatePagingFilesThread(IN PVOID Parameter)
+{
+    NTSTATUS Status;
+
+    /* Create the paging files, the descriptors are ready by now */
+    Status = SmpCreatePagingFiles();
+    RtlExitUserThread(Status);
+    return Status;
+}
+
 NTSTATUS
 NTAPI
 SmpLoadDataFromRegistry(OUT PUNICODE_STRING InitialCommand)
@@ -2192,6 +2204,7 @@ SmpLoadDataFromRegistry(OUT PUNICODE_STRING InitialCommand)
     ULONG MuSessionId = 0;
     OBJECT_ATTRIBUTES ObjectAttributes;
     HANDLE KeyHandle;
+    HANDLE PagingFileThread = NULL;
     UNICODE_STRING DestinationString;
 
     /* Initialize the keywords we'll be looking for */
@@ -2330,17 +2343,6 @@ SmpLoadDataFromRegistry(OUT PUNICODE_STRING InitialCommand)
     /* Now do any pending file rename operations... */
     if (!MiniNTBoot) SmpProcessFileRenames();
 
-    /* And initialize known DLLs... */
-    Status = SmpInitializeKnownDlls();
-    if (!NT_SUCCESS(Status))
-    {
-        /* Fail if that didn't work */
-        DPRINT1("SMSS: Unable to initialize KnownDll configuration - Status == %lx\n",
-                Status);
-        SMSS_CHECKPOINT(SmpInitializeKnownDlls, Status);
-        return Status;
-    }
-
     /* Create the needed page files */
     if (!MiniNTBoot)
     {
@@ -2361,8 +2363,46 @@ SmpLoadDataFromRegistry(OUT PUNICODE_STRING InitialCommand)
             RtlFreeHeap(RtlGetProcessHeap(), 0, RegEntry);
         }
 
-        /* Now create all the paging files for the descriptors that we have */
-        SmpCreatePagingFiles();
+        /*
+         * Now create all the paging files for the descriptors that we have.
+         * This has to wait for the volumes and may have to extend or delete
+         * files, so do it in the background while known DLLs get mapped.
+         */
+        Status = RtlCreateUserThread(NtCurrentProcess(),
+                                     NULL,
+                                     FALSE,
+                                     0,
+                                     0,
+                                     0,
+                                     SmpCreatePagingFilesThread,
+                                     NULL,
+                                     &PagingFileThread,
+                                     NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            /* No thread, do it ourselves */
+            PagingFileThread = NULL;
+            SmpCreatePagingFiles();
+        }
+    }
+
+    /* And initialize known DLLs... */
+    Status = SmpInitializeKnownDlls();
+
+    /* The paging files must be there before write access is fully enabled */
+    if (PagingFileThread)
+    {
+        NtWaitForSingleObject(PagingFileThread, FALSE, NULL);
+        NtClose(PagingFileThread);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        /* Fail if that didn't work */
+        DPRINT1("SMSS: Unable to initialize KnownDll configuration - Status == %lx\n",
+                Status);
+        SMSS_CHECKPOINT(SmpInitializeKnownDlls, Status);
+        return Status;
     }
 
     /* Tell Cm it's now safe to fully enable write access to the registry */
@@ -648,6 +648,9 @@ HandleLogon(
 
     CallNotificationDlls(Session, StartShellHandler);
 
+    /* The first shell start ends the boot timeline */
+    BootPerfMark(BOOTPERF_MARK_COMPLETE, L"ShellStarted");
+
     if (!InitializeScreenSaver(Session))
         WARN("WL: Failed to initialize screen saver\n");
 
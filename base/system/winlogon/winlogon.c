@@ -110,6 +110,22 @@ StartLsass(VOID)
 }
 
 
+/* Adds a checkpoint to the kernel boot timeline, if one is being recorded */
+VOID
+BootPerfMark(
+    IN ULONG Flags,
+    IN PCWSTR Name)
+{
+    BOOTPERF_MARK Mark;
+
+    Mark.Type = BootPerfCheckpoint;
+    Mark.Flags = Flags;
+    StringCchCopyW(Mark.Name, ARRAYSIZE(Mark.Name), Name);
+
+    NtSetSystemInformation(SystemPerformanceTraceInformation, &Mark, sizeof(Mark));
+}
+
+
 static
 VOID
 WaitForLsass(VOID)
@@ -595,6 +611,7 @@ WinMain(
     }
     else
     {
+        BootPerfMark(0, L"LogonReady");
         PostMessageW(WLSession->SASWindow, WLX_WM_SAS, WLX_SAS_TYPE_CTRL_ALT_DEL, 0);
     }
 
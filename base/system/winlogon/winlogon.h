@@ -43,6 +43,7 @@
 
 #include <reactos/undocuser.h>
 #include <reactos/undocmpr.h>
+#include <reactos/bootperf.h>
 
 BOOL
 WINAPI
@@ -353,6 +354,11 @@ DisplayStatusMessage(IN PWLSESSION Session,
 BOOL
 RemoveStatusMessage(IN PWLSESSION Session);
 
+VOID
+BootPerfMark(
+    IN ULONG Flags,
+    IN PCWSTR Name);
+
 /* wlx.c */
 VOID
 InitDialogListHead(VOID);
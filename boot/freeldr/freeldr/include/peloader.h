@@ -18,6 +18,23 @@
 
 #pragma once
 
+/*
+ * Boot images may be stored compressed, as this header followed by the
+ * LZNT1 chunks of the whole file. PeLdrLoadImage decompresses them while
+ * reading, so they can be used wherever the plain image would be.
+ */
+#define PELDR_COMPRESSED_SIGNATURE  0x315A4C46 // "FLZ1"
+
+#define TAG_PELDR_DECOMPRESS 'zCeP'
+
+typedef struct _PELDR_COMPRESSED_HEADER
+{
+    ULONG Signature;
+    USHORT CompressionFormat;
+    USHORT Reserved;
+    ULONG UncompressedSize;
+} PELDR_COMPRESSED_HEADER, *PPELDR_COMPRESSED_HEADER;
+
 BOOLEAN
 PeLdrLoadImage(
     IN PCHAR FileName,
@@ -25,11 +25,11 @@ DBG_DEFAULT_CHANNEL(CACHE);
 // Returns a pointer to a CACHE_BLOCK structure
 // Adds the block to the cache manager block list
 // in cache memory if it isn't already there
-PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
 
-    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d\n", BlockNumber);
+    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
     CacheBlock = CacheInternalFindBlock(CacheDrive, BlockNumber);
 
@@ -37,102 +37,120 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     {
         TRACE("Cache hit! BlockNumber: %d CacheBlock->BlockNumber: %d\n", BlockNumber, CacheBlock->BlockNumber);
 
+        // Keep the block list in LRU order
+        CacheBlock->AccessCount++;
+        CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
+
         return CacheBlock;
     }
 
     TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
 
-    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
-
-    // Optimize the block list so it has a LRU structure
-    CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
+    // Missing the block right after the last one we read means
+    // the caller is scanning the disk, so read ahead of it
+    if ((BlockNumber == CacheDrive->LastMissBlock + 1) &&
+        (BlockCount < CACHE_READ_AHEAD_BLOCKS))
+    {
+        BlockCount = CACHE_READ_AHEAD_BLOCKS;
+    }
 
-    return CacheBlock;
+    return CacheInternalAddBlockToCache(CacheDrive, BlockNumber, BlockCount);
 }
 
 PCACHE_BLOCK CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PLIST_ENTRY     HashListHead;
+    PLIST_ENTRY     Entry;
+    PCACHE_BLOCK    CacheBlock;
 
     TRACE("CacheInternalFindBlock() BlockNumber = %d\n", BlockNumber);
 
-    //
-    // Make sure the block list has entries before I start searching it.
-    //
-    if (!IsListEmpty(&CacheDrive->CacheBlockHead))
+    HashListHead = &CacheDrive->CacheHashTable[CACHE_HASH(BlockNumber)];
+    for (Entry = HashListHead->Flink; Entry != HashListHead; Entry = Entry->Flink)
     {
-        //
-        // Search the list and find the BIOS drive number
-        //
-        CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
-
-        while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
+        CacheBlock = CONTAINING_RECORD(Entry, CACHE_BLOCK, HashListEntry);
+        if (CacheBlock->BlockNumber == BlockNumber)
         {
-            //
-            // We found the block, so return it
-            //
-            if (CacheBlock->BlockNumber == BlockNumber)
-            {
-                //
-                // Increment the blocks access count
-                //
-                CacheBlock->AccessCount++;
-
-                return CacheBlock;
-            }
-
-            CacheBlock = CONTAINING_RECORD(CacheBlock->ListEntry.Flink, CACHE_BLOCK, ListEntry);
+            return CacheBlock;
         }
     }
 
     return NULL;
 }
 
-PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
+    ULONG           BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
+    ULONG           MaximumCount;
+    ULONG           Idx;
 
-    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d\n", BlockNumber);
-
-    // Check the size of the cache so we don't exceed our limits
-    CacheInternalCheckCacheSizeLimits(CacheDrive);
+    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
-    // We will need to add the block to the
-    // drive's list of cached blocks. So allocate
-    // the block memory.
-    CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
-    if (CacheBlock == NULL)
+    // Read as many blocks as both the disk read buffer and the cache
+    // can take in one transfer, but stop at the first one we already have
+    MaximumCount = (ULONG)min(DiskReadBufferSize, CacheSizeLimit) / BlockBytes;
+    BlockCount = min(BlockCount, MaximumCount);
+    for (Idx = 1; Idx < BlockCount; Idx++)
     {
-        return NULL;
+        if (CacheInternalFindBlock(CacheDrive, BlockNumber + Idx) != NULL)
+        {
+            break;
+        }
     }
+    BlockCount = max(Idx, 1);
 
-    // Now initialize the structure and
-    // allocate room for the block data
-    RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
-    CacheBlock->BlockNumber = BlockNumber;
-    CacheBlock->BlockData = FrLdrTempAlloc(CacheDrive->BlockSize * CacheDrive->BytesPerSector,
-                                           TAG_CACHE_DATA);
-    if (CacheBlock->BlockData ==NULL)
+    // Now try to read in the blocks
+    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber,
+                                    (ULONGLONG)BlockNumber * CacheDrive->BlockSize,
+                                    BlockCount * CacheDrive->BlockSize,
+                                    DiskReadBuffer))
     {
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
         return NULL;
     }
 
-    // Now try to read in the block
-    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+    CacheDrive->LastMissBlock = BlockNumber + BlockCount - 1;
+
+    // Add the blocks starting with the last one, so that the one
+    // that was asked for ends up as the most recently used
+    for (Idx = BlockCount; Idx-- > 0;)
     {
-        FrLdrTempFree(CacheBlock->BlockData, TAG_CACHE_DATA);
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
-    }
-    RtlCopyMemory(CacheBlock->BlockData, DiskReadBuffer, CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+        // Check the size of the cache so we don't exceed our limits
+        CacheInternalCheckCacheSizeLimits(CacheDrive);
+
+        // We will need to add the block to the
+        // drive's list of cached blocks. So allocate
+        // the block memory.
+        // The read-ahead blocks are only a bonus, so keep going
+        // without them, but give up if this is the one asked for
+        CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
+        if (CacheBlock == NULL)
+        {
+            continue;
+        }
+
+        // Now initialize the structure and
+        // allocate room for the block data
+        RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
+        CacheBlock->BlockNumber = BlockNumber + Idx;
+        CacheBlock->BlockData = FrLdrTempAlloc(BlockBytes, TAG_CACHE_DATA);
+        if (CacheBlock->BlockData == NULL)
+        {
+            FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
+            CacheBlock = NULL;
+            continue;
+        }
+        RtlCopyMemory(CacheBlock->BlockData, (PUCHAR)DiskReadBuffer + Idx * BlockBytes, BlockBytes);
 
-    // Add it to our list of blocks managed by the cache
-    InsertTailList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+        // Add it to our list of blocks managed by the cache
+        InsertHeadList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+        InsertHeadList(&CacheDrive->CacheHashTable[CACHE_HASH(CacheBlock->BlockNumber)],
+                       &CacheBlock->HashListEntry);
 
-    // Update the cache data
-    CacheBlockCount++;
-    CacheSizeCurrent = CacheBlockCount * (CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+        // Update the cache data
+        CacheBlockCount++;
+        CacheSizeCurrent = CacheBlockCount * BlockBytes;
+    }
 
     CacheInternalDumpBlockList(CacheDrive);
 
@@ -156,12 +174,13 @@ BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
 
     // No blocks left in cache that can be freed
     // so just return
-    if (IsListEmpty(&CacheDrive->CacheBlockHead))
+    if (&CacheBlockToFree->ListEntry == &CacheDrive->CacheBlockHead)
     {
         return FALSE;
     }
 
     RemoveEntryList(&CacheBlockToFree->ListEntry);
+    RemoveEntryList(&CacheBlockToFree->HashListEntry);
 
     // Free the block memory and the block structure
     FrLdrTempFree(CacheBlockToFree->BlockData, TAG_CACHE_DATA);
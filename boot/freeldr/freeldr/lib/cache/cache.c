@@ -38,6 +38,7 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
 {
     PCACHE_BLOCK    NextCacheBlock;
     GEOMETRY    DriveGeometry;
+    ULONG        Idx;
 
     // If we already have a cache for this drive then
     // by all means lets keep it, unless it is a removable
@@ -80,6 +81,11 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Initialize the structure
     RtlZeroMemory(&CacheManagerDrive, sizeof(CACHE_DRIVE));
     InitializeListHead(&CacheManagerDrive.CacheBlockHead);
+    for (Idx = 0; Idx < CACHE_HASH_BUCKETS; Idx++)
+    {
+        InitializeListHead(&CacheManagerDrive.CacheHashTable[Idx]);
+    }
+    CacheManagerDrive.LastMissBlock = MAXULONG - 1;
     CacheManagerDrive.DriveNumber = DriveNumber;
     if (!MachDiskGetDriveGeometry(DriveNumber, &DriveGeometry))
     {
@@ -148,7 +154,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -181,7 +187,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -214,7 +220,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -274,7 +280,7 @@ BOOLEAN CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector,
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
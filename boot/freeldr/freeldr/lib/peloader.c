@@ -457,6 +457,350 @@ PeLdrpScanImportAddressTable(
     return TRUE;
 }
 
+static VOID
+PeLdrpGetSectionSizes(
+    IN PIMAGE_SECTION_HEADER SectionHeader,
+    OUT PULONG VirtualSize,
+    OUT PULONG SizeOfRawData)
+{
+    *VirtualSize = SectionHeader->Misc.VirtualSize;
+    *SizeOfRawData = SectionHeader->SizeOfRawData;
+
+    /* Handle a case when VirtualSize equals 0 */
+    if (*VirtualSize == 0)
+        *VirtualSize = *SizeOfRawData;
+
+    /* If PointerToRawData is 0, then force its size to be also 0 */
+    if (SectionHeader->PointerToRawData == 0)
+    {
+        *SizeOfRawData = 0;
+    }
+    else
+    {
+        /* Cut the loaded size to the VirtualSize extents */
+        if (*SizeOfRawData > *VirtualSize)
+            *SizeOfRawData = *VirtualSize;
+    }
+}
+
+/*
+ * Moves the sections of an image that was read as a flat file into its
+ * buffer to their virtual addresses. This is only possible when no section
+ * lands on the raw data of another one that is still to be moved, which is
+ * how linkers lay out images anyway; otherwise nothing is touched and FALSE
+ * is returned, so the caller reads the sections one by one instead.
+ */
+static BOOLEAN
+PeLdrpMoveSectionsInPlace(
+    IN PVOID ImageBase,
+    IN ULONG FileSize)
+{
+    PIMAGE_NT_HEADERS NtHeaders;
+    PIMAGE_SECTION_HEADER SectionHeader;
+    ULONG VirtualSize, SizeOfRawData, NumberOfSections, SizeOfImage;
+    ULONG RawEnd, VirtualEnd, i;
+
+    NtHeaders = RtlImageNtHeader(ImageBase);
+    NumberOfSections = NtHeaders->FileHeader.NumberOfSections;
+    SectionHeader = IMAGE_FIRST_SECTION(NtHeaders);
+    SizeOfImage = NtHeaders->OptionalHeader.SizeOfImage;
+
+    /* We need the section table until the end, so it can't be overwritten */
+    RawEnd = NtHeaders->OptionalHeader.SizeOfHeaders;
+    VirtualEnd = RawEnd;
+    if ((ULONG_PTR)&SectionHeader[NumberOfSections] - (ULONG_PTR)ImageBase > RawEnd)
+        return FALSE;
+
+    /* Sections must go up in both the file and the image, never downwards */
+    for (i = 0; i < NumberOfSections; i++)
+    {
+        PeLdrpGetSectionSizes(&SectionHeader[i], &VirtualSize, &SizeOfRawData);
+
+        if ((SectionHeader[i].VirtualAddress < VirtualEnd) ||
+            (SectionHeader[i].VirtualAddress < RawEnd) ||
+            (SectionHeader[i].VirtualAddress > SizeOfImage) ||
+            (VirtualSize > SizeOfImage - SectionHeader[i].VirtualAddress))
+        {
+            return FALSE;
+        }
+
+        if (SizeOfRawData != 0)
+        {
+            if ((SectionHeader[i].PointerToRawData < RawEnd) ||
+                (SectionHeader[i].PointerToRawData > SectionHeader[i].VirtualAddress) ||
+                (SectionHeader[i].PointerToRawData > FileSize) ||
+                (SizeOfRawData > FileSize - SectionHeader[i].PointerToRawData))
+            {
+                return FALSE;
+            }
+
+            RawEnd = SectionHeader[i].PointerToRawData + SizeOfRawData;
+        }
+
+        VirtualEnd = SectionHeader[i].VirtualAddress + VirtualSize;
+    }
+
+    /* Start with the last section, the earlier ones are then never in the way */
+    for (i = NumberOfSections; i-- > 0;)
+    {
+        PeLdrpGetSectionSizes(&SectionHeader[i], &VirtualSize, &SizeOfRawData);
+
+        TRACE("SH->VA: 0x%X\n", SectionHeader[i].VirtualAddress);
+
+        if (SizeOfRawData != 0)
+        {
+            RtlMoveMemory((PUCHAR)ImageBase + SectionHeader[i].VirtualAddress,
+                          (PUCHAR)ImageBase + SectionHeader[i].PointerToRawData,
+                          SizeOfRawData);
+        }
+
+        if (SizeOfRawData < VirtualSize)
+        {
+            RtlZeroMemory((PUCHAR)ImageBase + SectionHeader[i].VirtualAddress + SizeOfRawData,
+                          VirtualSize - SizeOfRawData);
+        }
+    }
+
+    return TRUE;
+}
+
+static PVOID
+PeLdrpAllocateImageMemory(
+    IN PIMAGE_NT_HEADERS NtHeaders,
+    IN TYPE_OF_MEMORY MemoryType,
+    IN PCSTR FileName)
+{
+    PVOID PhysicalBase;
+
+    /* Try to allocate this memory, if fails - allocate somewhere else */
+    PhysicalBase = MmAllocateMemoryAtAddress(NtHeaders->OptionalHeader.SizeOfImage,
+                       (PVOID)((ULONG)NtHeaders->OptionalHeader.ImageBase & (KSEG0_BASE - 1)),
+                       MemoryType);
+
+    if (PhysicalBase == NULL)
+    {
+        /* It's ok, we don't panic - let's allocate again at any other "low" place */
+        PhysicalBase = MmAllocateMemoryWithType(NtHeaders->OptionalHeader.SizeOfImage, MemoryType);
+
+        if (PhysicalBase == NULL)
+        {
+            ERR("Failed to alloc %lu bytes for image %s\n", NtHeaders->OptionalHeader.SizeOfImage, FileName);
+            UiMessageBox("Failed to alloc pages for image.");
+            return NULL;
+        }
+    }
+
+    return PhysicalBase;
+}
+
+static BOOLEAN
+PeLdrpRelocateImage(
+    IN PVOID PhysicalBase)
+{
+    PIMAGE_NT_HEADERS NtHeaders = RtlImageNtHeader(PhysicalBase);
+    PVOID VirtualBase = PaToVa(PhysicalBase);
+
+    /* Relocate the image, if it needs it */
+    if (NtHeaders->OptionalHeader.ImageBase != (ULONG_PTR)VirtualBase)
+    {
+        WARN("Relocating %p -> %p\n", NtHeaders->OptionalHeader.ImageBase, VirtualBase);
+        return (BOOLEAN)LdrRelocateImageWithBias(PhysicalBase,
+                                                 (ULONG_PTR)VirtualBase - (ULONG_PTR)PhysicalBase,
+                                                 "FreeLdr",
+                                                 TRUE,
+                                                 TRUE, /* in case of conflict still return success */
+                                                 FALSE);
+    }
+
+    TRACE("PeLdrLoadImage() done, PA = %p\n", PhysicalBase);
+    return TRUE;
+}
+
+#define PELDR_COMPRESSED_READ_SIZE  (64 * 1024)
+#define PELDR_LZNT1_CHUNK_SIZE      0x1000
+
+/*
+ * Streams the compressed file through ReadBuffer and decompresses it one
+ * chunk at a time, straight into the image once the first chunk told us
+ * how large it is and where it wants to go. The result is the flat file,
+ * which then only has to have its sections moved into place.
+ */
+static PVOID
+PeLdrpDecompressImage(
+    IN ULONG FileId,
+    IN PCSTR FileName,
+    IN PPELDR_COMPRESSED_HEADER Header,
+    IN ULONG CompressedSize,
+    IN TYPE_OF_MEMORY MemoryType,
+    IN PUCHAR ReadBuffer,
+    IN PUCHAR FirstChunk)
+{
+    PIMAGE_NT_HEADERS NtHeaders;
+    PVOID PhysicalBase = NULL;
+    PUCHAR Output;
+    ULONG UncompressedSize = Header->UncompressedSize;
+    ULONG Offset = 0, Start = 0, End = 0;
+    ULONG ChunkHeader, ChunkSize, FinalSize, BytesRead;
+    ARC_STATUS Status;
+
+    while (Offset < UncompressedSize)
+    {
+        /* Make sure the next chunk is all in the buffer */
+        ChunkSize = sizeof(USHORT);
+        if (End - Start >= sizeof(USHORT))
+        {
+            ChunkHeader = *(PUSHORT)(ReadBuffer + Start);
+            if (ChunkHeader == 0)
+                break;
+            ChunkSize += (ChunkHeader & 0xFFF) + 1;
+        }
+
+        if (End - Start < ChunkSize)
+        {
+            if (CompressedSize == 0)
+                break;
+
+            /* Keep the part we have and fill up the buffer behind it */
+            RtlMoveMemory(ReadBuffer, ReadBuffer + Start, End - Start);
+            End -= Start;
+            Start = 0;
+
+            Status = ArcRead(FileId,
+                             ReadBuffer + End,
+                             min(CompressedSize, PELDR_COMPRESSED_READ_SIZE - End),
+                             &BytesRead);
+            if ((Status != ESUCCESS) || (BytesRead == 0))
+            {
+                ERR("ArcRead(File: '%s') failed. Status: %u\n", FileName, Status);
+                UiMessageBox("Error reading from file.");
+                return NULL;
+            }
+
+            End += BytesRead;
+            CompressedSize -= BytesRead;
+            continue;
+        }
+
+        /* Only the last chunk may be short, anything else would shift the data */
+        Output = PhysicalBase ? (PUCHAR)PhysicalBase + Offset : FirstChunk;
+        if (!NT_SUCCESS(RtlDecompressBuffer(Header->CompressionFormat,
+                                            Output,
+                                            min(PELDR_LZNT1_CHUNK_SIZE, UncompressedSize - Offset),
+                                            ReadBuffer + Start,
+                                            ChunkSize,
+                                            &FinalSize)) ||
+            (FinalSize == 0) ||
+            ((FinalSize < PELDR_LZNT1_CHUNK_SIZE) && (Offset + FinalSize < UncompressedSize)))
+        {
+            break;
+        }
+        Start += ChunkSize;
+
+        if (PhysicalBase == NULL)
+        {
+            /* The headers are in the first chunk, so now we can place the image */
+            if (!NT_SUCCESS(RtlImageNtHeaderEx(0, FirstChunk, FinalSize, &NtHeaders)) ||
+                ((NtHeaders->FileHeader.Characteristics & IMAGE_FILE_EXECUTABLE_IMAGE) == 0) ||
+                (UncompressedSize > NtHeaders->OptionalHeader.SizeOfImage) ||
+                (UncompressedSize < NtHeaders->OptionalHeader.SizeOfHeaders))
+            {
+                ERR("Not an executable image \"%s\"\n", FileName);
+                UiMessageBox("Not an executable image.");
+                return NULL;
+            }
+
+            PhysicalBase = PeLdrpAllocateImageMemory(NtHeaders, MemoryType, FileName);
+            if (PhysicalBase == NULL)
+                return NULL;
+
+            RtlCopyMemory(PhysicalBase, FirstChunk, FinalSize);
+        }
+
+        Offset += FinalSize;
+    }
+
+    if (Offset != UncompressedSize)
+    {
+        ERR("Compressed image \"%s\" is corrupt at offset 0x%lx\n", FileName, Offset);
+        UiMessageBox("Error decompressing image.");
+        return NULL;
+    }
+
+    if (!PeLdrpMoveSectionsInPlace(PhysicalBase, UncompressedSize))
+    {
+        ERR("Unsupported section layout in compressed image \"%s\"\n", FileName);
+        UiMessageBox("Error decompressing image.");
+        return NULL;
+    }
+
+    return PhysicalBase;
+}
+
+static PVOID
+PeLdrpLoadCompressedImage(
+    IN ULONG FileId,
+    IN PCSTR FileName,
+    IN PPELDR_COMPRESSED_HEADER Header,
+    IN TYPE_OF_MEMORY MemoryType)
+{
+    FILEINFORMATION FileInfo;
+    LARGE_INTEGER Position;
+    PUCHAR ReadBuffer, FirstChunk;
+    PVOID PhysicalBase = NULL;
+    ARC_STATUS Status;
+
+    TRACE("PeLdrpLoadCompressedImage(%s, format %u, size 0x%lx)\n",
+          FileName, Header->CompressionFormat, Header->UncompressedSize);
+
+    if (Header->CompressionFormat != COMPRESSION_FORMAT_LZNT1)
+    {
+        ERR("Unsupported compression format %u in \"%s\"\n", Header->CompressionFormat, FileName);
+        UiMessageBox("Unsupported image compression format.");
+        return NULL;
+    }
+
+    Status = ArcGetFileInformation(FileId, &FileInfo);
+    if ((Status != ESUCCESS) ||
+        (FileInfo.EndingAddress.HighPart != 0) ||
+        (FileInfo.EndingAddress.LowPart < sizeof(*Header)))
+    {
+        ERR("ArcGetFileInformation(File: '%s') failed. Status: %u\n", FileName, Status);
+        UiMessageBox("Error reading from file.");
+        return NULL;
+    }
+
+    Position.QuadPart = sizeof(*Header);
+    Status = ArcSeek(FileId, &Position, SeekAbsolute);
+    if (Status != ESUCCESS)
+    {
+        ERR("ArcSeek(File: '%s') failed. Status: 0x%lx\n", FileName, Status);
+        UiMessageBox("Error seeking the start of a file.");
+        return NULL;
+    }
+
+    ReadBuffer = FrLdrTempAlloc(PELDR_COMPRESSED_READ_SIZE, TAG_PELDR_DECOMPRESS);
+    FirstChunk = FrLdrTempAlloc(PELDR_LZNT1_CHUNK_SIZE, TAG_PELDR_DECOMPRESS);
+    if ((ReadBuffer != NULL) && (FirstChunk != NULL))
+    {
+        PhysicalBase = PeLdrpDecompressImage(FileId,
+                                             FileName,
+                                             Header,
+                                             FileInfo.EndingAddress.LowPart - sizeof(*Header),
+                                             MemoryType,
+                                             ReadBuffer,
+                                             FirstChunk);
+    }
+    else
+    {
+        ERR("Failed to allocate the decompression buffers for %s\n", FileName);
+        UiMessageBox("Failed to alloc memory for image decompression.");
+    }
+
+    if (FirstChunk) FrLdrTempFree(FirstChunk, TAG_PELDR_DECOMPRESS);
+    if (ReadBuffer) FrLdrTempFree(ReadBuffer, TAG_PELDR_DECOMPRESS);
+    return PhysicalBase;
+}
+
 
 /* FUNCTIONS *****************************************************************/
 
@@ -712,7 +1056,9 @@ PeLdrLoadImage(
     ULONG VirtualSize, SizeOfRawData, NumberOfSections;
     ARC_STATUS Status;
     LARGE_INTEGER Position;
-    ULONG i, BytesRead;
+    FILEINFORMATION FileInfo;
+    ULONG i, BytesRead, ReadSize;
+    BOOLEAN SectionsLoaded = FALSE;
 
     TRACE("PeLdrLoadImage(%s, %ld, *)\n", FileName, MemoryType);
 
@@ -734,6 +1080,22 @@ PeLdrLoadImage(
         return FALSE;
     }
 
+    /* Compressed images are read, and laid out, separately */
+    if ((BytesRead >= sizeof(PELDR_COMPRESSED_HEADER)) &&
+        (((PPELDR_COMPRESSED_HEADER)HeadersBuffer)->Signature == PELDR_COMPRESSED_SIGNATURE))
+    {
+        PhysicalBase = PeLdrpLoadCompressedImage(FileId,
+                                                 FileName,
+                                                 (PPELDR_COMPRESSED_HEADER)HeadersBuffer,
+                                                 MemoryType);
+        ArcClose(FileId);
+        if (PhysicalBase == NULL)
+            return FALSE;
+
+        *ImageBasePA = PhysicalBase;
+        return PeLdrpRelocateImage(PhysicalBase);
+    }
+
     /* Now read the MZ header to get the offset to the PE Header */
     NtHeaders = RtlImageNtHeader(HeadersBuffer);
     if (!NtHeaders)
@@ -757,23 +1119,11 @@ PeLdrLoadImage(
     NumberOfSections = NtHeaders->FileHeader.NumberOfSections;
     SectionHeader = IMAGE_FIRST_SECTION(NtHeaders);
 
-    /* Try to allocate this memory, if fails - allocate somewhere else */
-    PhysicalBase = MmAllocateMemoryAtAddress(NtHeaders->OptionalHeader.SizeOfImage,
-                       (PVOID)((ULONG)NtHeaders->OptionalHeader.ImageBase & (KSEG0_BASE - 1)),
-                       MemoryType);
-
+    PhysicalBase = PeLdrpAllocateImageMemory(NtHeaders, MemoryType, FileName);
     if (PhysicalBase == NULL)
     {
-        /* It's ok, we don't panic - let's allocate again at any other "low" place */
-        PhysicalBase = MmAllocateMemoryWithType(NtHeaders->OptionalHeader.SizeOfImage, MemoryType);
-
-        if (PhysicalBase == NULL)
-        {
-            ERR("Failed to alloc %lu bytes for image %s\n", NtHeaders->OptionalHeader.SizeOfImage, FileName);
-            UiMessageBox("Failed to alloc pages for image.");
-            ArcClose(FileId);
-            return FALSE;
-        }
+        ArcClose(FileId);
+        return FALSE;
     }
 
     /* This is the real image base - in form of a virtual address */
@@ -792,7 +1142,21 @@ PeLdrLoadImage(
         return FALSE;
     }
 
-    Status = ArcRead(FileId, PhysicalBase, NtHeaders->OptionalHeader.SizeOfHeaders, &BytesRead);
+    /*
+     * Read the whole file at once when it fits in the image, rather than
+     * seeking to every section: this lets the file system go through it
+     * with as few and as large disk transfers as it can.
+     */
+    ReadSize = NtHeaders->OptionalHeader.SizeOfHeaders;
+    if ((ArcGetFileInformation(FileId, &FileInfo) == ESUCCESS) &&
+        (FileInfo.EndingAddress.HighPart == 0) &&
+        (FileInfo.EndingAddress.LowPart > ReadSize) &&
+        (FileInfo.EndingAddress.LowPart <= NtHeaders->OptionalHeader.SizeOfImage))
+    {
+        ReadSize = FileInfo.EndingAddress.LowPart;
+    }
+
+    Status = ArcRead(FileId, PhysicalBase, ReadSize, &BytesRead);
     if (Status != ESUCCESS)
     {
         ERR("ArcRead(File: '%s') failed. Status: %u\n", FileName, Status);
@@ -816,28 +1180,15 @@ PeLdrLoadImage(
     /* Fill output parameters */
     *ImageBasePA = PhysicalBase;
 
+    /* If we have the whole file, the sections only have to be moved into place */
+    if (ReadSize > NtHeaders->OptionalHeader.SizeOfHeaders)
+        SectionsLoaded = PeLdrpMoveSectionsInPlace(PhysicalBase, BytesRead);
+
     /* Walk through each section and read it (check/fix any possible
        bad situations, if they arise) */
-    for (i = 0; i < NumberOfSections; i++)
+    for (i = 0; !SectionsLoaded && (i < NumberOfSections); i++)
     {
-        VirtualSize = SectionHeader->Misc.VirtualSize;
-        SizeOfRawData = SectionHeader->SizeOfRawData;
-
-        /* Handle a case when VirtualSize equals 0 */
-        if (VirtualSize == 0)
-            VirtualSize = SizeOfRawData;
-
-        /* If PointerToRawData is 0, then force its size to be also 0 */
-        if (SectionHeader->PointerToRawData == 0)
-        {
-            SizeOfRawData = 0;
-        }
-        else
-        {
-            /* Cut the loaded size to the VirtualSize extents */
-            if (SizeOfRawData > VirtualSize)
-                SizeOfRawData = VirtualSize;
-        }
+        PeLdrpGetSectionSizes(SectionHeader, &VirtualSize, &SizeOfRawData);
 
         /* Actually read the section (if its size is not 0) */
         if (SizeOfRawData != 0)
@@ -874,18 +1225,5 @@ PeLdrLoadImage(
     if (Status != ESUCCESS)
         return FALSE;
 
-    /* Relocate the image, if it needs it */
-    if (NtHeaders->OptionalHeader.ImageBase != (ULONG_PTR)VirtualBase)
-    {
-        WARN("Relocating %p -> %p\n", NtHeaders->OptionalHeader.ImageBase, VirtualBase);
-        return (BOOLEAN)LdrRelocateImageWithBias(PhysicalBase,
-                                                 (ULONG_PTR)VirtualBase - (ULONG_PTR)PhysicalBase,
-                                                 "FreeLdr",
-                                                 TRUE,
-                                                 TRUE, /* in case of conflict still return success */
-                                                 FALSE);
-    }
-
-    TRACE("PeLdrLoadImage() done, PA = %p\n", *ImageBasePA);
-    return TRUE;
+    return PeLdrpRelocateImage(PhysicalBase);
 }
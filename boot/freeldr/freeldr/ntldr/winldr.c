@@ -59,6 +59,9 @@ AllocateAndInitLPB(
     Extension->MajorVersion = (VersionToBoot & 0xFF00) >> 8;
     Extension->MinorVersion = (VersionToBoot & 0xFF);
 
+    /* The OS entry has been chosen, loading starts now */
+    WinLdrSystemBlock->LoaderPerformanceData.StartTime = WinLdrGetTimeStamp();
+
     /* Init three critical lists, used right away */
     InitializeListHead(&LoaderBlock->LoadOrderListHead);
     InitializeListHead(&LoaderBlock->MemoryDescriptorListHead);
@@ -222,6 +225,9 @@ WinLdrInitializePhase1(PLOADER_PARAMETER_BLOCK LoaderBlock,
                                                     &Extension->DrvDBSize,
                                                     LoaderRegistryData));
 
+    /* Pass the loader timestamps, EndTime is filled right before we jump to the kernel */
+    Extension->LoaderPerformanceData = PaToVa(&WinLdrSystemBlock->LoaderPerformanceData);
+
     /* Convert the extension block pointer */
     LoaderBlock->Extension = PaToVa(LoaderBlock->Extension);
 
@@ -998,6 +1004,7 @@ LoadAndBootWindowsCommon(
 #endif
 
     /* Pass control */
+    WinLdrSystemBlock->LoaderPerformanceData.EndTime = WinLdrGetTimeStamp();
     (*KiSystemStartup)(LoaderBlockVA);
     return ESUCCESS;
 }
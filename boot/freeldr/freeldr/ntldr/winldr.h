@@ -52,6 +52,7 @@ typedef struct _LOADER_SYSTEM_BLOCK
     HEADLESS_LOADER_BLOCK HeadlessLoaderBlock;
 #endif
     NLS_DATA_BLOCK NlsDataBlock;
+    LOADER_PERFORMANCE_DATA LoaderPerformanceData;
     CHAR LoadOptions[MAX_OPTIONS_LENGTH+1];
     CHAR ArcBootDeviceName[MAX_PATH+1];
     // CHAR ArcHalDeviceName[MAX_PATH];
@@ -62,6 +63,13 @@ typedef struct _LOADER_SYSTEM_BLOCK
 
 extern PLOADER_SYSTEM_BLOCK WinLdrSystemBlock;
 
+/* Loader timestamps passed to the kernel, in processor cycles */
+#if !defined(_M_ARM) && !defined(_M_PPC)
+#define WinLdrGetTimeStamp() __rdtsc()
+#else
+#define WinLdrGetTimeStamp() 0ULL
+#endif
+
 
 // conversion.c
 #if 0
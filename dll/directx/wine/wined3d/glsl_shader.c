@@ -34,6 +34,7 @@
 
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #ifdef HAVE_FLOAT_H
 # include <float.h>
 #endif
@@ -132,6 +133,8 @@ struct shader_glsl_priv
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
+
+    char program_cache_dir[MAX_PATH];
 };
 
 struct glsl_vs_program
@@ -591,6 +594,240 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* Linked programs are saved on disk through ARB_get_program_binary, so that
+ * the next run can load them instead of linking them again. The file name is
+ * a hash of the GLSL of the attached shaders, of the GL implementation, and
+ * of the bindings set up before linking. */
+#define GLSL_PROGRAM_CACHE_MAGIC    0x42503357 /* W3PB */
+#define GLSL_PROGRAM_CACHE_VERSION  1
+#define GLSL_PROGRAM_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+struct glsl_program_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    UINT64 hash;
+    GLenum format;
+    GLsizei length;
+};
+
+static UINT64 glsl_program_cache_hash(UINT64 hash, const void *data, SIZE_T size)
+{
+    const BYTE *ptr = data;
+
+    /* FNV-1a */
+    while (size--)
+    {
+        hash ^= *ptr++;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static int glsl_program_cache_compare_hashes(const void *a, const void *b)
+{
+    UINT64 x = *(const UINT64 *)a, y = *(const UINT64 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void shader_glsl_init_program_cache(struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info)
+{
+    char *dir = priv->program_cache_dir;
+    DWORD len;
+
+    dir[0] = 0;
+    if (!wined3d_settings.shader_cache || !gl_info->supported[ARB_GET_PROGRAM_BINARY])
+        return;
+
+    len = GetEnvironmentVariableA("LOCALAPPDATA", dir, MAX_PATH);
+    if (!len || len >= MAX_PATH)
+        len = GetTempPathA(MAX_PATH, dir);
+    /* Leave room for the subdirectory and the file names. */
+    if (!len || len >= MAX_PATH - 48)
+    {
+        dir[0] = 0;
+        return;
+    }
+
+    if (dir[len - 1] != '\\')
+        dir[len++] = '\\';
+    strcpy(dir + len, "wined3d");
+    if (!CreateDirectoryA(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        WARN("Failed to create program cache directory %s.\n", debugstr_a(dir));
+        dir[0] = 0;
+        return;
+    }
+    strcat(dir, "\\");
+
+    TRACE("Caching linked GLSL programs in %s.\n", debugstr_a(dir));
+}
+
+/* Context activation is done by the caller. */
+static BOOL shader_glsl_hash_program(const struct wined3d_gl_info *gl_info, GLuint program,
+        BOOL dual_blend, UINT64 *hash)
+{
+    GLint i, shader_count, source_size = 0, tmp;
+    UINT64 *shader_hashes, h = 0xcbf29ce484222325ull;
+    char *source = NULL;
+    const char *str;
+    GLuint *shaders;
+    DWORD link_state[3];
+
+    if ((str = (const char *)gl_info->gl_ops.gl.p_glGetString(GL_RENDERER)))
+        h = glsl_program_cache_hash(h, str, strlen(str) + 1);
+    if ((str = (const char *)gl_info->gl_ops.gl.p_glGetString(GL_VERSION)))
+        h = glsl_program_cache_hash(h, str, strlen(str) + 1);
+
+    link_state[0] = dual_blend;
+    link_state[1] = gl_info->limits.buffers;
+    link_state[2] = gl_info->limits.dual_buffers;
+    h = glsl_program_cache_hash(h, link_state, sizeof(link_state));
+
+    GL_EXTCALL(glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count));
+    if (shader_count <= 0)
+        return FALSE;
+    if (!(shaders = heap_calloc(shader_count, sizeof(*shaders))))
+        return FALSE;
+    if (!(shader_hashes = heap_calloc(shader_count, sizeof(*shader_hashes))))
+    {
+        heap_free(shaders);
+        return FALSE;
+    }
+
+    GL_EXTCALL(glGetAttachedShaders(program, shader_count, NULL, shaders));
+    for (i = 0; i < shader_count; ++i)
+    {
+        UINT64 shader_hash = 0xcbf29ce484222325ull;
+
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &tmp));
+        if (source_size < tmp)
+        {
+            heap_free(source);
+            if (!(source = heap_alloc(tmp)))
+            {
+                heap_free(shader_hashes);
+                heap_free(shaders);
+                return FALSE;
+            }
+            source_size = tmp;
+        }
+
+        tmp = 0;
+        if (source_size)
+            GL_EXTCALL(glGetShaderSource(shaders[i], source_size, &tmp, source));
+        shader_hash = glsl_program_cache_hash(shader_hash, source, tmp);
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_TYPE, &tmp));
+        shader_hashes[i] = glsl_program_cache_hash(shader_hash, &tmp, sizeof(tmp));
+    }
+
+    /* The order glGetAttachedShaders() returns shaders in isn't defined. */
+    qsort(shader_hashes, shader_count, sizeof(*shader_hashes), glsl_program_cache_compare_hashes);
+    *hash = glsl_program_cache_hash(h, shader_hashes, shader_count * sizeof(*shader_hashes));
+
+    heap_free(source);
+    heap_free(shader_hashes);
+    heap_free(shaders);
+    return TRUE;
+}
+
+static void shader_glsl_get_program_cache_path(const struct shader_glsl_priv *priv, UINT64 hash, char *path)
+{
+    sprintf(path, "%s%08x%08x.bin", priv->program_cache_dir, (DWORD)(hash >> 32), (DWORD)hash);
+}
+
+/* Context activation is done by the caller. */
+static BOOL shader_glsl_load_program_binary(const struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info, GLuint program, UINT64 hash)
+{
+    struct glsl_program_cache_header header;
+    char path[MAX_PATH];
+    GLint status = GL_FALSE;
+    void *data = NULL;
+    HANDLE file;
+    DWORD size;
+
+    shader_glsl_get_program_cache_path(priv, hash, path);
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    if (ReadFile(file, &header, sizeof(header), &size, NULL) && size == sizeof(header)
+            && header.magic == GLSL_PROGRAM_CACHE_MAGIC && header.version == GLSL_PROGRAM_CACHE_VERSION
+            && header.hash == hash && header.length > 0 && header.length <= GLSL_PROGRAM_CACHE_MAX_SIZE
+            && (data = heap_alloc(header.length))
+            && ReadFile(file, data, header.length, &size, NULL) && size == header.length)
+    {
+        GL_EXTCALL(glProgramBinary(program, header.format, data, header.length));
+        checkGLcall("glProgramBinary");
+        GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    }
+
+    heap_free(data);
+    CloseHandle(file);
+
+    /* Driver updates invalidate binaries, the program is linked again then. */
+    TRACE("%s program %u from %s.\n", status ? "Loaded" : "Failed to load", program, debugstr_a(path));
+    return status;
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_save_program_binary(const struct shader_glsl_priv *priv,
+        const struct wined3d_gl_info *gl_info, GLuint program, UINT64 hash)
+{
+    struct glsl_program_cache_header header;
+    char path[MAX_PATH], tmp_path[MAX_PATH];
+    GLint status, length = 0;
+    void *data;
+    HANDLE file;
+    DWORD size;
+    BOOL ret;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (!status)
+        return;
+    GL_EXTCALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0 || length > GLSL_PROGRAM_CACHE_MAX_SIZE)
+        return;
+    if (!(data = heap_alloc(length)))
+        return;
+
+    GL_EXTCALL(glGetProgramBinary(program, length, &length, &header.format, data));
+    checkGLcall("glGetProgramBinary");
+    header.magic = GLSL_PROGRAM_CACHE_MAGIC;
+    header.version = GLSL_PROGRAM_CACHE_VERSION;
+    header.hash = hash;
+    header.length = length;
+
+    /* Write to a temporary file first, another process may be reading the
+     * program at the same time. */
+    shader_glsl_get_program_cache_path(priv, hash, path);
+    sprintf(tmp_path, "%s.%x", path, GetCurrentProcessId());
+    file = CreateFileA(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        heap_free(data);
+        return;
+    }
+
+    ret = length > 0
+            && WriteFile(file, &header, sizeof(header), &size, NULL) && size == sizeof(header)
+            && WriteFile(file, data, length, &size, NULL) && size == length;
+    CloseHandle(file);
+    heap_free(data);
+
+    if (!ret || !MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("Failed to save program %u to %s.\n", program, debugstr_a(path));
+        DeleteFileA(tmp_path);
+        return;
+    }
+
+    TRACE("Saved program %u to %s.\n", program, debugstr_a(path));
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -9844,6 +10081,8 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     struct list *ps_list = NULL, *vs_list = NULL;
     WORD attribs_map;
     struct wined3d_string_buffer *tmp_name;
+    UINT64 program_hash;
+    BOOL cacheable;
 
     if (!(context->shader_update_mask & (1u << WINED3D_SHADER_TYPE_VERTEX)) && ctx_data->glsl_program)
     {
@@ -10101,10 +10340,25 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         list_add_head(ps_list, &entry->ps.shader_entry);
     }
 
+    /* Programs with tessellation or geometry shaders depend on transform
+     * feedback state that isn't part of the cache key, they aren't cached. */
+    cacheable = priv->program_cache_dir[0] && !hshader && !dshader && !gshader
+            && shader_glsl_hash_program(gl_info, program_id,
+            wined3d_dualblend_enabled(state, gl_info), &program_hash);
+
     /* Link the program */
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    if (!cacheable || !shader_glsl_load_program_binary(priv, gl_info, program_id, program_hash))
+    {
+        if (cacheable)
+            GL_EXTCALL(glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+
+        TRACE("Linking GLSL shader program %u.\n", program_id);
+        GL_EXTCALL(glLinkProgram(program_id));
+        shader_glsl_validate_link(gl_info, program_id);
+
+        if (cacheable)
+            shader_glsl_save_program_binary(priv, gl_info, program_id, program_hash);
+    }
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
@@ -10697,6 +10951,7 @@ static HRESULT shader_glsl_alloc(struct wined3d_device *device, const struct win
     fragment_pipe->get_caps(gl_info, &fragment_caps);
     priv->ffp_proj_control = fragment_caps.wined3d_caps & WINED3D_FRAGMENT_CAP_PROJ_CONTROL;
     priv->legacy_lighting = device->wined3d->flags & WINED3D_LEGACY_FFP_LIGHTING;
+    shader_glsl_init_program_cache(priv, gl_info);
 
     device->vertex_priv = vertex_priv;
     device->fragment_priv = fragment_priv;
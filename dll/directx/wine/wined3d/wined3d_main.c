@@ -92,6 +92,7 @@ struct wined3d_settings wined3d_settings =
     ~0U,            /* No PS shader model limit by default. */
     ~0u,            /* No CS shader model limit by default. */
     FALSE,          /* 3D support enabled by default. */
+    TRUE,           /* Cache linked GLSL programs on disk by default. */
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -321,6 +322,12 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Disabling 3D support.\n");
             wined3d_settings.no_3d = TRUE;
         }
+        if (!get_config_key(hkey, appkey, "ShaderCache", buffer, size)
+                && !strcmp(buffer, "disabled"))
+        {
+            TRACE("Disabling the GLSL program cache.\n");
+            wined3d_settings.shader_cache = FALSE;
+        }
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -411,6 +411,7 @@ struct wined3d_settings
     unsigned int max_sm_ps;
     unsigned int max_sm_cs;
     BOOL no_3d;
+    BOOL shader_cache;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
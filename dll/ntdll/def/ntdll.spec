@@ -333,6 +333,7 @@
 @ stdcall NtReleaseMutant(long ptr)
 @ stdcall NtReleaseSemaphore(long long ptr)
 @ stdcall NtRemoveIoCompletion(ptr ptr ptr ptr ptr)
+@ stdcall NtRemoveIoCompletionEx(ptr ptr long ptr ptr long)
 @ stdcall NtRemoveProcessDebug(ptr ptr)
 @ stdcall NtRenameKey(ptr ptr)
 @ stdcall NtReplaceKey(ptr long ptr)
@@ -772,6 +773,7 @@
 @ stdcall RtlLookupElementGenericTableAvl(ptr ptr)
 @ stdcall RtlLookupElementGenericTableFull(ptr ptr ptr long)
 @ stdcall RtlLookupElementGenericTableFullAvl(ptr ptr ptr long)
+@ stdcall RtlLookupElementGenericTableWithoutSplaying(ptr ptr)
 @ stdcall -arch=x86_64 RtlLookupFunctionEntry(long ptr ptr)
 @ stdcall RtlMakeSelfRelativeSD(ptr ptr ptr)
 @ stdcall RtlMapGenericMask(long ptr)
@@ -1179,6 +1181,7 @@
 @ stdcall ZwReleaseMutant(long ptr)
 @ stdcall ZwReleaseSemaphore(long long ptr)
 @ stdcall ZwRemoveIoCompletion(ptr ptr ptr ptr ptr)
+@ stdcall ZwRemoveIoCompletionEx(ptr ptr long ptr ptr long)
 @ stdcall ZwRemoveProcessDebug(ptr ptr)
 @ stdcall ZwRenameKey(ptr ptr)
 @ stdcall ZwReplaceKey(ptr long ptr)
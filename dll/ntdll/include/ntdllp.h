@@ -8,8 +8,9 @@
 
 #pragma once
 
-#define LDR_HASH_TABLE_ENTRIES 32
-#define LDR_GET_HASH_ENTRY(x) (RtlUpcaseUnicodeChar((x)) & (LDR_HASH_TABLE_ENTRIES - 1))
+/* Initial size of the loaded module hash table, it grows as DLLs get loaded */
+#define LDR_HASH_TABLE_ENTRIES 64
+#define LDR_GET_HASH_ENTRY(x) (((x) ^ ((x) >> 16)) & (LdrpHashTableSize - 1))
 
 /* LdrpUpdateLoadCount2 flags */
 #define LDRP_UPDATE_REFCOUNT   0x01
@@ -43,7 +44,9 @@ NTSTATUS
 extern RTL_CRITICAL_SECTION LdrpLoaderLock;
 extern BOOLEAN LdrpInLdrInit;
 extern PVOID LdrpHeap;
-extern LIST_ENTRY LdrpHashTable[LDR_HASH_TABLE_ENTRIES];
+extern LIST_ENTRY LdrpStaticHashTable[LDR_HASH_TABLE_ENTRIES];
+extern PLIST_ENTRY LdrpHashTable;
+extern ULONG LdrpHashTableSize;
 extern BOOLEAN ShowSnaps;
 extern UNICODE_STRING LdrpDefaultPath;
 extern HANDLE LdrpKnownDllObjectDirectory;
@@ -111,6 +114,12 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress);
 VOID NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+VOID NTAPI
+LdrpRemoveHashTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
+
+ULONG NTAPI
+LdrpHashDllName(IN PUNICODE_STRING DllName);
+
 NTSTATUS NTAPI
 LdrpLoadDll(IN BOOLEAN Redirected,
             IN PWSTR DllPath OPTIONAL,
@@ -158,6 +167,30 @@ LdrpFetchAddressOfEntryPoint(PVOID ImageBase);
 VOID NTAPI
 LdrpFreeUnicodeString(PUNICODE_STRING String);
 
+BOOLEAN NTAPI
+LdrpResolveDllName(PWSTR DllPath,
+                   PWSTR DllName,
+                   PUNICODE_STRING FullDllName,
+                   PUNICODE_STRING BaseDllName);
+
+/* ldrwork.c */
+VOID NTAPI
+LdrpInitializeWorkers(VOID);
+
+BOOLEAN NTAPI
+LdrpIsLoaderWorker(VOID);
+
+VOID NTAPI
+LdrpQueueDllPrefetch(IN PWSTR DllPath OPTIONAL,
+                     IN PUNICODE_STRING DllName);
+
+BOOLEAN NTAPI
+LdrpTakePrefetchedSection(IN PUNICODE_STRING NtPathName,
+                          OUT PHANDLE SectionHandle);
+
+VOID NTAPI
+LdrpFlushDllPrefetches(VOID);
+
 VOID NTAPI
 LdrpGetShimEngineInterface(VOID);
 
@@ -1422,7 +1422,7 @@ LdrUnloadDll(IN PVOID BaseAddress)
             CurrentEntry = LdrEntry;
             RemoveEntryList(&CurrentEntry->InInitializationOrderLinks);
             RemoveEntryList(&CurrentEntry->InMemoryOrderLinks);
-            RemoveEntryList(&CurrentEntry->HashLinks);
+            LdrpRemoveHashTableEntry(CurrentEntry);
 
             /* If there's more then one active unload */
             if (LdrpActiveUnloadCount > 1)
@@ -57,7 +57,9 @@ PVOID NtDllBase;
 extern LARGE_INTEGER RtlpTimeout;
 BOOLEAN RtlpTimeoutDisable;
 PVOID LdrpHeap;
-LIST_ENTRY LdrpHashTable[LDR_HASH_TABLE_ENTRIES];
+LIST_ENTRY LdrpStaticHashTable[LDR_HASH_TABLE_ENTRIES];
+PLIST_ENTRY LdrpHashTable = LdrpStaticHashTable;
+ULONG LdrpHashTableSize = LDR_HASH_TABLE_ENTRIES;
 LIST_ENTRY LdrpDllNotificationList;
 HANDLE LdrpKnownDllObjectDirectory;
 UNICODE_STRING LdrpKnownDllPath;
@@ -1935,11 +1937,14 @@ LdrpInitializeProcess(IN PCONTEXT Context,
     RtlSetBit(&TlsExpansionBitMap, 0);
 
     /* Initialize the Hash Table */
-    for (i = 0; i < LDR_HASH_TABLE_ENTRIES; i++)
+    for (i = 0; i < LdrpHashTableSize; i++)
     {
         InitializeListHead(&LdrpHashTable[i]);
     }
 
+    /* Initialize the loader workers */
+    LdrpInitializeWorkers();
+
     /* Initialize the Loader Lock */
     // FIXME: What's the point of initing it manually, if two lines lower
     //        a call to RtlInitializeCriticalSection() is being made anyway?
@@ -2552,6 +2557,9 @@ LdrpInit(PCONTEXT Context,
         Teb->DeallocationStack = MemoryBasicInfo.AllocationBase;
     }
 
+    /* Loader workers only create image sections, there is nothing to set up for them */
+    if (LdrpIsLoaderWorker()) return;
+
     /* Now check if the process is already being initialized */
     while (_InterlockedCompareExchange(&LdrpProcessInitialized,
                                       1,
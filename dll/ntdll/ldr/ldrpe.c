@@ -17,6 +17,7 @@
 
 PLDR_MANIFEST_PROBER_ROUTINE LdrpManifestProberRoutine;
 ULONG LdrpNormalSnap;
+ULONG LdrpImportWalkDepth;
 
 /* FUNCTIONS *****************************************************************/
 
@@ -390,16 +391,13 @@ LdrpHandleOneNewFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
         }
         else
         {
-            /* Show debug message */
+            /* Show debug message, but keep a stale binding stale */
             if (ShowSnaps)
             {
                 DPRINT1("LDR: %wZ has correct binding to %s\n",
                         &LdrEntry->BaseDllName,
                         ForwarderName);
             }
-
-            /* Remember it's valid */
-            Stale = FALSE;
         }
 
         /* Move to the next one */
@@ -519,7 +517,7 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
 {
     LPSTR ImportName;
     NTSTATUS Status;
-    BOOLEAN AlreadyLoaded = FALSE;
+    BOOLEAN AlreadyLoaded = FALSE, EntriesValid;
     PLDR_DATA_TABLE_ENTRY DllLdrEntry;
     PIMAGE_THUNK_DATA FirstThunk;
     PPEB Peb = NtCurrentPeb();
@@ -579,8 +577,25 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                        &DllLdrEntry->InInitializationOrderLinks);
     }
 
+    /*
+     * Old style bound imports carry the time stamp of the DLL they were
+     * bound to. If that is the one we got, and it is at its preferred
+     * base, the IAT already holds the right addresses and only the
+     * forwarders need to be snapped.
+     */
+    EntriesValid = ((*ImportEntry)->TimeDateStamp != 0 &&
+                    (*ImportEntry)->TimeDateStamp != (ULONG)-1 &&
+                    (*ImportEntry)->TimeDateStamp == DllLdrEntry->TimeDateStamp &&
+                    !(DllLdrEntry->Flags & LDRP_IMAGE_NOT_AT_BASE));
+    if (ShowSnaps && EntriesValid)
+    {
+        DPRINT1("LDR: %wZ has correct binding to %s\n",
+                &LdrEntry->BaseDllName,
+                ImportName);
+    }
+
     /* Now snap the IAT Entry */
-    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, FALSE);
+    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, EntriesValid);
     if (!NT_SUCCESS(Status))
     {
         /* Fail */
@@ -623,6 +638,90 @@ LdrpHandleOldFormatImportDescriptors(IN LPWSTR DllPath OPTIONAL,
     return STATUS_SUCCESS;
 }
 
+static
+VOID
+LdrpPrefetchImport(IN LPWSTR DllPath OPTIONAL,
+                   IN LPSTR ImportName,
+                   IN OUT PBOOLEAN First)
+{
+    ANSI_STRING AnsiString;
+    UNICODE_STRING DllName;
+    WCHAR NameBuffer[MAX_PATH];
+    PLDR_DATA_TABLE_ENTRY DllLdrEntry;
+
+    /* Leave anything with a path to LdrpMapDll */
+    if (strchr(ImportName, '\\') || strchr(ImportName, '/')) return;
+
+    /* Build the name like LdrpLoadImportModule does */
+    RtlInitAnsiString(&AnsiString, ImportName);
+    RtlInitEmptyUnicodeString(&DllName, NameBuffer, sizeof(NameBuffer));
+    if (!NT_SUCCESS(RtlAnsiStringToUnicodeString(&DllName, &AnsiString, FALSE))) return;
+
+    if (!strchr(ImportName, '.'))
+    {
+        if ((DllName.Length + LdrApiDefaultExtension.Length + sizeof(UNICODE_NULL)) >
+            sizeof(NameBuffer))
+        {
+            return;
+        }
+        RtlAppendUnicodeStringToString(&DllName, &LdrApiDefaultExtension);
+    }
+
+    /* Nothing to do if it is loaded already */
+    if (LdrpCheckForLoadedDll(DllPath, &DllName, TRUE, FALSE, &DllLdrEntry)) return;
+
+    /* We are about to map the first one ourselves */
+    if (*First)
+    {
+        *First = FALSE;
+        return;
+    }
+
+    LdrpQueueDllPrefetch(DllPath, &DllName);
+}
+
+/*
+ * LdrpPrefetchImports
+ *
+ * Lets the loader workers create the sections for the imports of LdrEntry
+ * that are not loaded yet, while we map and snap them one by one.
+ */
+static
+VOID
+LdrpPrefetchImports(IN LPWSTR DllPath OPTIONAL,
+                    IN PLDR_DATA_TABLE_ENTRY LdrEntry,
+                    IN PIMAGE_BOUND_IMPORT_DESCRIPTOR BoundEntry OPTIONAL,
+                    IN PIMAGE_IMPORT_DESCRIPTOR ImportEntry OPTIONAL)
+{
+    PIMAGE_BOUND_IMPORT_DESCRIPTOR FirstEntry = BoundEntry;
+    BOOLEAN First = TRUE;
+
+    if (BoundEntry)
+    {
+        while (BoundEntry->OffsetModuleName)
+        {
+            LdrpPrefetchImport(DllPath,
+                               (LPSTR)FirstEntry + BoundEntry->OffsetModuleName,
+                               &First);
+
+            /* Skip the forwarder references */
+            BoundEntry = (PIMAGE_BOUND_IMPORT_DESCRIPTOR)
+                ((PIMAGE_BOUND_FORWARDER_REF)(BoundEntry + 1) +
+                 BoundEntry->NumberOfModuleForwarderRefs);
+        }
+    }
+    else if (ImportEntry)
+    {
+        while ((ImportEntry->Name) && (ImportEntry->FirstThunk))
+        {
+            LdrpPrefetchImport(DllPath,
+                               (LPSTR)((ULONG_PTR)LdrEntry->DllBase + ImportEntry->Name),
+                               &First);
+            ImportEntry++;
+        }
+    }
+}
+
 USHORT
 NTAPI
 LdrpNameToOrdinal(IN LPSTR ImportName,
@@ -750,6 +849,10 @@ LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
     /* Check if we got at least one */
     if ((BoundEntry) || (ImportEntry))
     {
+        /* Let the loader workers start on the imports we don't have yet */
+        LdrpImportWalkDepth++;
+        LdrpPrefetchImports(DllPath, LdrEntry, BoundEntry, ImportEntry);
+
         /* Do we have a Bound IAT */
         if (BoundEntry)
         {
@@ -766,6 +869,9 @@ LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                                                           ImportEntry);
         }
 
+        /* Drop whatever was not used once the outermost walk is done */
+        if (--LdrpImportWalkDepth == 0) LdrpFlushDllPrefetches();
+
         /* Check the status of the handlers */
         if (NT_SUCCESS(Status))
         {
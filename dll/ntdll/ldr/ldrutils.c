@@ -17,6 +17,7 @@
 /* GLOBALS *******************************************************************/
 
 PLDR_DATA_TABLE_ENTRY LdrpLoadedDllHandleCache, LdrpGetModuleHandleCache;
+ULONG LdrpHashTableCount;
 
 BOOLEAN g_ShimsEnabled;
 PVOID g_pShimEngineModule;
@@ -554,6 +555,14 @@ LdrpCreateDllSection(IN PUNICODE_STRING FullName,
     ULONG Response;
     SECTION_IMAGE_INFORMATION SectionImageInfo;
 
+    /* Check if a loader worker already created the section */
+    if (!DllHandle && LdrpTakePrefetchedSection(FullName, SectionHandle))
+    {
+        FileHandle = NULL;
+        Status = STATUS_SUCCESS;
+        goto CheckSafer;
+    }
+
     /* Check if we don't already have a handle */
     if (!DllHandle)
     {
@@ -643,6 +652,7 @@ LdrpCreateDllSection(IN PUNICODE_STRING FullName,
         if (LdrpInLdrInit) LdrpFatalHardErrorCount++;
     }
 
+CheckSafer:
     /* Check for Safer restrictions */
     if (DllCharacteristics &&
         !(*DllCharacteristics & IMAGE_FILE_SYSTEM))
@@ -684,7 +694,7 @@ LdrpCreateDllSection(IN PUNICODE_STRING FullName,
     }
 
     /* Close the file handle, we don't need it */
-    NtClose(FileHandle);
+    if (FileHandle) NtClose(FileHandle);
 
     /* Return status */
     return Status;
@@ -1283,7 +1293,7 @@ SkipCheck:
             /* Remove the DLL from the lists */
             RemoveEntryList(&LdrEntry->InLoadOrderLinks);
             RemoveEntryList(&LdrEntry->InMemoryOrderLinks);
-            RemoveEntryList(&LdrEntry->HashLinks);
+            LdrpRemoveHashTableEntry(LdrEntry);
 
             /* Remove the LDR Entry */
             RtlFreeHeap(LdrpHeap, 0, LdrEntry );
@@ -1477,7 +1487,7 @@ FailRelocate:
                 /* Remove it from the lists */
                 RemoveEntryList(&LdrEntry->InLoadOrderLinks);
                 RemoveEntryList(&LdrEntry->InMemoryOrderLinks);
-                RemoveEntryList(&LdrEntry->HashLinks);
+                LdrpRemoveHashTableEntry(LdrEntry);
 
                 /* Unmap it, clear the entry */
                 NtUnmapViewOfSection(NtCurrentProcess(), ViewBase);
@@ -1574,6 +1584,66 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress)
     return LdrEntry;
 }
 
+ULONG
+NTAPI
+LdrpHashDllName(IN PUNICODE_STRING DllName)
+{
+    ULONG Hash;
+
+    /* Module names are compared case insensitively, so hash them that way */
+    if (!NT_SUCCESS(RtlHashUnicodeString(DllName,
+                                         TRUE,
+                                         HASH_STRING_ALGORITHM_X65599,
+                                         &Hash)))
+    {
+        Hash = 0;
+    }
+
+    return Hash;
+}
+
+static
+VOID
+LdrpGrowHashTable(VOID)
+{
+    PLIST_ENTRY NewTable, ListHead, ListEntry;
+    PLDR_DATA_TABLE_ENTRY LdrEntry;
+    ULONG NewSize, OldSize, i;
+
+    /* Allocate a table four times as large */
+    OldSize = LdrpHashTableSize;
+    NewSize = OldSize * 4;
+    NewTable = RtlAllocateHeap(LdrpHeap, 0, NewSize * sizeof(LIST_ENTRY));
+
+    /* Keep using the old one if that failed, lookups just get slower */
+    if (!NewTable) return;
+
+    for (i = 0; i < NewSize; i++)
+    {
+        InitializeListHead(&NewTable[i]);
+    }
+
+    /* Move all the entries over, using the hash values cached in them */
+    for (i = 0; i < OldSize; i++)
+    {
+        ListHead = &LdrpHashTable[i];
+        while (!IsListEmpty(ListHead))
+        {
+            ListEntry = RemoveHeadList(ListHead);
+            LdrEntry = CONTAINING_RECORD(ListEntry, LDR_DATA_TABLE_ENTRY, HashLinks);
+            InsertTailList(&NewTable[(LdrEntry->BaseNameHashValue ^
+                                      (LdrEntry->BaseNameHashValue >> 16)) & (NewSize - 1)],
+                           ListEntry);
+        }
+    }
+
+    /* Switch to the new table, and free the old one unless it is the static one */
+    ListHead = LdrpHashTable;
+    LdrpHashTable = NewTable;
+    LdrpHashTableSize = NewSize;
+    if (ListHead != LdrpStaticHashTable) RtlFreeHeap(LdrpHeap, 0, ListHead);
+}
+
 VOID
 NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
@@ -1581,8 +1651,12 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     PPEB_LDR_DATA PebData = NtCurrentPeb()->Ldr;
     ULONG i;
 
+    /* Grow the hash table once the chains get longer than two entries on average */
+    if (++LdrpHashTableCount > LdrpHashTableSize * 2) LdrpGrowHashTable();
+
     /* Insert into hash table */
-    i = LDR_GET_HASH_ENTRY(LdrEntry->BaseDllName.Buffer[0]);
+    LdrEntry->BaseNameHashValue = LdrpHashDllName(&LdrEntry->BaseDllName);
+    i = LDR_GET_HASH_ENTRY(LdrEntry->BaseNameHashValue);
     InsertTailList(&LdrpHashTable[i], &LdrEntry->HashLinks);
 
     /* Insert into other lists */
@@ -1590,6 +1664,15 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     InsertTailList(&PebData->InMemoryOrderModuleList, &LdrEntry->InMemoryOrderLinks);
 }
 
+VOID
+NTAPI
+LdrpRemoveHashTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
+{
+    /* Remove it from the hash table */
+    RemoveEntryList(&LdrEntry->HashLinks);
+    LdrpHashTableCount--;
+}
+
 VOID
 NTAPI
 LdrpFinalizeAndDeallocateDataTableEntry(IN PLDR_DATA_TABLE_ENTRY Entry)
@@ -1979,7 +2062,7 @@ LdrpCheckForLoadedDll(IN PWSTR DllPath,
                       IN BOOLEAN RedirectedDll,
                       OUT PLDR_DATA_TABLE_ENTRY *LdrEntry)
 {
-    ULONG HashIndex;
+    ULONG HashValue;
     PLIST_ENTRY ListHead, ListEntry;
     PLDR_DATA_TABLE_ENTRY CurEntry;
     BOOLEAN FullPath = FALSE;
@@ -2008,19 +2091,20 @@ lookinhash:
     {
         /* FIXME: if we get redirected dll it means that we also get a full path so we need to find its filename for the hash lookup */
 
-        /* Get hash index */
-        HashIndex = LDR_GET_HASH_ENTRY(DllName->Buffer[0]);
+        /* Hash the name */
+        HashValue = LdrpHashDllName(DllName);
 
         /* Traverse that list */
-        ListHead = &LdrpHashTable[HashIndex];
+        ListHead = &LdrpHashTable[LDR_GET_HASH_ENTRY(HashValue)];
         ListEntry = ListHead->Flink;
         while (ListEntry != ListHead)
         {
             /* Get the current entry */
             CurEntry = CONTAINING_RECORD(ListEntry, LDR_DATA_TABLE_ENTRY, HashLinks);
 
-            /* Check base name of that module */
-            if (RtlEqualUnicodeString(DllName, &CurEntry->BaseDllName, TRUE))
+            /* Only compare the names if the full hash matches */
+            if (CurEntry->BaseNameHashValue == HashValue &&
+                RtlEqualUnicodeString(DllName, &CurEntry->BaseDllName, TRUE))
             {
                 /* It matches, return it */
                 *LdrEntry = CurEntry;
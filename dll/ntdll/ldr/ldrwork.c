@@ -0,0 +1,496 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS NT User-Mode Library
+ * FILE:            dll/ntdll/ldr/ldrwork.c
+ * PURPOSE:         Loader worker threads creating image sections ahead of use
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntdll.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * While the loader walks the import table of a module, the imports it has
+ * not loaded yet are handed to a few worker threads. They search for the
+ * files, open them and create their image sections, which is where the disk
+ * I/O of loading a DLL is. When the loader gets to an import it picks up
+ * the section a worker made for it instead of creating one itself. Mapping,
+ * relocating, snapping and initialization all stay on the loading thread
+ * under the loader lock, so the load and DllMain order does not change.
+ */
+
+#define LDRP_MAX_LOADER_WORKERS 4
+#define LDRP_LOADER_WORKER_IDLE_TIMEOUT 2000
+
+typedef enum _LDRP_PREFETCH_STATE
+{
+    LdrpPrefetchQueued,
+    LdrpPrefetchRunning,
+    LdrpPrefetchDone
+} LDRP_PREFETCH_STATE;
+
+typedef struct _LDRP_PREFETCH
+{
+    LIST_ENTRY Links;
+    LDRP_PREFETCH_STATE State;
+    NTSTATUS Status;
+    PWSTR DllPath;
+    UNICODE_STRING DllName;
+    UNICODE_STRING NtPathName;
+    HANDLE SectionHandle;
+} LDRP_PREFETCH, *PLDRP_PREFETCH;
+
+/* GLOBALS *******************************************************************/
+
+RTL_CRITICAL_SECTION LdrpWorkLock;
+LIST_ENTRY LdrpWorkQueue;
+HANDLE LdrpWorkSemaphore;
+HANDLE LdrpWorkDoneEvent;
+ULONG LdrpWorkerCount;
+ULONG LdrpIdleWorkerCount;
+ULONG LdrpQueuedWorkCount;
+HANDLE LdrpWorkerThreadIds[LDRP_MAX_LOADER_WORKERS];
+
+/* FUNCTIONS *****************************************************************/
+
+VOID
+NTAPI
+LdrpInitializeWorkers(VOID)
+{
+    RtlInitializeCriticalSection(&LdrpWorkLock);
+    InitializeListHead(&LdrpWorkQueue);
+}
+
+BOOLEAN
+NTAPI
+LdrpIsLoaderWorker(VOID)
+{
+    HANDLE ThreadId = NtCurrentTeb()->ClientId.UniqueThread;
+    ULONG i;
+
+    /* Worker ids are set before the workers start and cleared before they exit */
+    for (i = 0; i < LDRP_MAX_LOADER_WORKERS; i++)
+    {
+        if (LdrpWorkerThreadIds[i] == ThreadId) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static
+VOID
+LdrpFreePrefetch(IN PLDRP_PREFETCH Prefetch)
+{
+    if (Prefetch->SectionHandle) NtClose(Prefetch->SectionHandle);
+    if (Prefetch->NtPathName.Buffer)
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Prefetch->NtPathName.Buffer);
+    if (Prefetch->DllPath) RtlFreeHeap(LdrpHeap, 0, Prefetch->DllPath);
+    RtlFreeHeap(LdrpHeap, 0, Prefetch);
+}
+
+static
+NTSTATUS
+LdrpPrefetchDll(IN PLDRP_PREFETCH Prefetch)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    UNICODE_STRING FullDllName, BaseDllName;
+    HANDLE FileHandle, SectionHandle;
+    BOOLEAN Success;
+    NTSTATUS Status;
+
+    /* Known DLLs already have a section */
+    if (LdrpKnownDllObjectDirectory)
+    {
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &Prefetch->DllName,
+                                   OBJ_CASE_INSENSITIVE,
+                                   LdrpKnownDllObjectDirectory,
+                                   NULL);
+        Status = NtOpenSection(&SectionHandle,
+                               SECTION_MAP_READ | SECTION_MAP_EXECUTE | SECTION_MAP_WRITE,
+                               &ObjectAttributes);
+        if (NT_SUCCESS(Status))
+        {
+            NtClose(SectionHandle);
+            return STATUS_OBJECT_NAME_EXISTS;
+        }
+    }
+
+    /* Search for it the way LdrpMapDll does */
+    if (!LdrpResolveDllName(Prefetch->DllPath,
+                            Prefetch->DllName.Buffer,
+                            &FullDllName,
+                            &BaseDllName))
+    {
+        return STATUS_DLL_NOT_FOUND;
+    }
+
+    Success = RtlDosPathNameToNtPathName_U(FullDllName.Buffer,
+                                           &Prefetch->NtPathName,
+                                           NULL,
+                                           NULL);
+    LdrpFreeUnicodeString(&FullDllName);
+    LdrpFreeUnicodeString(&BaseDllName);
+    if (!Success) return STATUS_OBJECT_PATH_SYNTAX_BAD;
+
+    /* Open it like LdrpCreateDllSection does, but never raise hard errors */
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &Prefetch->NtPathName,
+                               OBJ_CASE_INSENSITIVE,
+                               NULL,
+                               NULL);
+    Status = NtOpenFile(&FileHandle,
+                        SYNCHRONIZE | FILE_EXECUTE | FILE_READ_DATA,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        Status = NtOpenFile(&FileHandle,
+                            SYNCHRONIZE | FILE_EXECUTE,
+                            &ObjectAttributes,
+                            &IoStatusBlock,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+        if (!NT_SUCCESS(Status)) return Status;
+    }
+
+    Status = NtCreateSection(&SectionHandle,
+                             SECTION_MAP_READ | SECTION_MAP_EXECUTE |
+                             SECTION_MAP_WRITE | SECTION_QUERY,
+                             NULL,
+                             NULL,
+                             PAGE_EXECUTE,
+                             SEC_IMAGE,
+                             FileHandle);
+    NtClose(FileHandle);
+
+    if (NT_SUCCESS(Status)) Prefetch->SectionHandle = SectionHandle;
+    return Status;
+}
+
+static
+ULONG
+NTAPI
+LdrpWorkerThread(IN PVOID Parameter)
+{
+    PLDRP_PREFETCH Prefetch;
+    PLIST_ENTRY ListEntry;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+    ULONG i;
+
+    Timeout.QuadPart = Int32x32To64(LDRP_LOADER_WORKER_IDLE_TIMEOUT, -10000);
+
+    for (;;)
+    {
+        Status = NtWaitForSingleObject(LdrpWorkSemaphore, FALSE, &Timeout);
+
+        RtlEnterCriticalSection(&LdrpWorkLock);
+
+        /* Look for something to do */
+        Prefetch = NULL;
+        for (ListEntry = LdrpWorkQueue.Flink;
+             ListEntry != &LdrpWorkQueue;
+             ListEntry = ListEntry->Flink)
+        {
+            Prefetch = CONTAINING_RECORD(ListEntry, LDRP_PREFETCH, Links);
+            if (Prefetch->State == LdrpPrefetchQueued) break;
+            Prefetch = NULL;
+        }
+
+        if (!Prefetch)
+        {
+            /* Nothing left, leave if we have been idle for a while */
+            if (Status == STATUS_TIMEOUT) break;
+
+            RtlLeaveCriticalSection(&LdrpWorkLock);
+            continue;
+        }
+
+        Prefetch->State = LdrpPrefetchRunning;
+        LdrpQueuedWorkCount--;
+        LdrpIdleWorkerCount--;
+        RtlLeaveCriticalSection(&LdrpWorkLock);
+
+        /* The loader frees running entries only after they are done */
+        Status = LdrpPrefetchDll(Prefetch);
+
+        RtlEnterCriticalSection(&LdrpWorkLock);
+        Prefetch->Status = Status;
+        Prefetch->State = LdrpPrefetchDone;
+        LdrpIdleWorkerCount++;
+        RtlLeaveCriticalSection(&LdrpWorkLock);
+
+        NtSetEvent(LdrpWorkDoneEvent, NULL);
+    }
+
+    /* Forget about us while still holding the lock */
+    for (i = 0; i < LDRP_MAX_LOADER_WORKERS; i++)
+    {
+        if (LdrpWorkerThreadIds[i] == NtCurrentTeb()->ClientId.UniqueThread)
+        {
+            LdrpWorkerThreadIds[i] = NULL;
+            break;
+        }
+    }
+    LdrpWorkerCount--;
+    LdrpIdleWorkerCount--;
+    RtlLeaveCriticalSection(&LdrpWorkLock);
+
+    /* Loader workers are never attached to DLLs, so don't detach them either */
+    NtCurrentTeb()->FreeStackOnTermination = TRUE;
+    NtTerminateThread(NtCurrentThread(), STATUS_SUCCESS);
+    return 0;
+}
+
+/* Called with LdrpWorkLock held */
+static
+VOID
+LdrpStartWorker(VOID)
+{
+    HANDLE ThreadHandle;
+    CLIENT_ID ClientId;
+    NTSTATUS Status;
+    ULONG i;
+
+    if (!LdrpWorkSemaphore)
+    {
+        Status = NtCreateSemaphore(&LdrpWorkSemaphore,
+                                   SEMAPHORE_ALL_ACCESS,
+                                   NULL,
+                                   0,
+                                   MAXLONG);
+        if (!NT_SUCCESS(Status))
+        {
+            LdrpWorkSemaphore = NULL;
+            return;
+        }
+    }
+
+    if (!LdrpWorkDoneEvent)
+    {
+        Status = NtCreateEvent(&LdrpWorkDoneEvent,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               SynchronizationEvent,
+                               FALSE);
+        if (!NT_SUCCESS(Status))
+        {
+            LdrpWorkDoneEvent = NULL;
+            return;
+        }
+    }
+
+    for (i = 0; i < LDRP_MAX_LOADER_WORKERS; i++)
+    {
+        if (!LdrpWorkerThreadIds[i]) break;
+    }
+    if (i == LDRP_MAX_LOADER_WORKERS) return;
+
+    /* Create it suspended, so LdrpInit knows it is a worker when it runs */
+    Status = RtlCreateUserThread(NtCurrentProcess(),
+                                 NULL,
+                                 TRUE,
+                                 0,
+                                 0,
+                                 0,
+                                 LdrpWorkerThread,
+                                 NULL,
+                                 &ThreadHandle,
+                                 &ClientId);
+    if (!NT_SUCCESS(Status)) return;
+
+    LdrpWorkerThreadIds[i] = ClientId.UniqueThread;
+    LdrpWorkerCount++;
+    LdrpIdleWorkerCount++;
+
+    NtResumeThread(ThreadHandle, NULL);
+    NtClose(ThreadHandle);
+}
+
+VOID
+NTAPI
+LdrpQueueDllPrefetch(IN PWSTR DllPath OPTIONAL,
+                     IN PUNICODE_STRING DllName)
+{
+    PLDRP_PREFETCH Prefetch;
+    PLIST_ENTRY ListEntry;
+    SIZE_T PathSize = 0;
+
+    /* Don't queue the same name twice */
+    for (ListEntry = LdrpWorkQueue.Flink;
+         ListEntry != &LdrpWorkQueue;
+         ListEntry = ListEntry->Flink)
+    {
+        Prefetch = CONTAINING_RECORD(ListEntry, LDRP_PREFETCH, Links);
+        if (RtlEqualUnicodeString(DllName, &Prefetch->DllName, TRUE)) return;
+    }
+
+    Prefetch = RtlAllocateHeap(LdrpHeap,
+                               HEAP_ZERO_MEMORY,
+                               sizeof(LDRP_PREFETCH) + DllName->Length + sizeof(UNICODE_NULL));
+    if (!Prefetch) return;
+
+    /* The search path may not outlive this load, so keep a copy */
+    if (DllPath)
+    {
+        PathSize = (wcslen(DllPath) + 1) * sizeof(WCHAR);
+        Prefetch->DllPath = RtlAllocateHeap(LdrpHeap, 0, PathSize);
+        if (!Prefetch->DllPath)
+        {
+            RtlFreeHeap(LdrpHeap, 0, Prefetch);
+            return;
+        }
+        RtlCopyMemory(Prefetch->DllPath, DllPath, PathSize);
+    }
+
+    Prefetch->DllName.Buffer = (PWSTR)(Prefetch + 1);
+    Prefetch->DllName.MaximumLength = DllName->Length + sizeof(UNICODE_NULL);
+    RtlCopyUnicodeString(&Prefetch->DllName, DllName);
+    Prefetch->State = LdrpPrefetchQueued;
+
+    RtlEnterCriticalSection(&LdrpWorkLock);
+
+    /* Add a worker if the ones we have are all busy */
+    if (LdrpQueuedWorkCount >= LdrpIdleWorkerCount &&
+        LdrpWorkerCount < LDRP_MAX_LOADER_WORKERS)
+    {
+        LdrpStartWorker();
+    }
+
+    if (!LdrpWorkerCount)
+    {
+        /* No one to do it */
+        RtlLeaveCriticalSection(&LdrpWorkLock);
+        LdrpFreePrefetch(Prefetch);
+        return;
+    }
+
+    InsertTailList(&LdrpWorkQueue, &Prefetch->Links);
+    LdrpQueuedWorkCount++;
+    RtlLeaveCriticalSection(&LdrpWorkLock);
+
+    NtReleaseSemaphore(LdrpWorkSemaphore, 1, NULL);
+}
+
+/*
+ * LdrpTakePrefetchedSection
+ *
+ * Returns the image section a worker created for the file NtPathName, if
+ * there is one. Work for the same base name that did not start yet is
+ * cancelled, since the caller is about to do it anyway.
+ */
+BOOLEAN
+NTAPI
+LdrpTakePrefetchedSection(IN PUNICODE_STRING NtPathName,
+                          OUT PHANDLE SectionHandle)
+{
+    PLDRP_PREFETCH Prefetch;
+    PLIST_ENTRY ListEntry;
+    UNICODE_STRING BaseName;
+    USHORT i;
+
+    if (IsListEmpty(&LdrpWorkQueue)) return FALSE;
+
+    /* Get the base name */
+    for (i = NtPathName->Length / sizeof(WCHAR); i > 0; i--)
+    {
+        if (NtPathName->Buffer[i - 1] == L'\\') break;
+    }
+    BaseName.Buffer = NtPathName->Buffer + i;
+    BaseName.Length = NtPathName->Length - i * sizeof(WCHAR);
+    BaseName.MaximumLength = BaseName.Length;
+
+    RtlEnterCriticalSection(&LdrpWorkLock);
+
+    for (ListEntry = LdrpWorkQueue.Flink;
+         ListEntry != &LdrpWorkQueue;
+         ListEntry = ListEntry->Flink)
+    {
+        Prefetch = CONTAINING_RECORD(ListEntry, LDRP_PREFETCH, Links);
+        if (!RtlEqualUnicodeString(&BaseName, &Prefetch->DllName, TRUE)) continue;
+
+        /* Wait for a worker that is on it */
+        while (Prefetch->State == LdrpPrefetchRunning)
+        {
+            RtlLeaveCriticalSection(&LdrpWorkLock);
+            NtWaitForSingleObject(LdrpWorkDoneEvent, FALSE, NULL);
+            RtlEnterCriticalSection(&LdrpWorkLock);
+        }
+
+        if (Prefetch->State == LdrpPrefetchQueued) LdrpQueuedWorkCount--;
+        RemoveEntryList(&Prefetch->Links);
+        RtlLeaveCriticalSection(&LdrpWorkLock);
+
+        /* Only use it if the worker found the same file */
+        if (Prefetch->State == LdrpPrefetchDone &&
+            NT_SUCCESS(Prefetch->Status) &&
+            RtlEqualUnicodeString(NtPathName, &Prefetch->NtPathName, TRUE))
+        {
+            if (ShowSnaps)
+            {
+                DPRINT1("LDR: Using the section prefetched for %wZ\n", NtPathName);
+            }
+
+            *SectionHandle = Prefetch->SectionHandle;
+            Prefetch->SectionHandle = NULL;
+            LdrpFreePrefetch(Prefetch);
+            return TRUE;
+        }
+
+        LdrpFreePrefetch(Prefetch);
+        return FALSE;
+    }
+
+    RtlLeaveCriticalSection(&LdrpWorkLock);
+    return FALSE;
+}
+
+/*
+ * LdrpFlushDllPrefetches
+ *
+ * Drops all prefetches nobody picked up, e.g. because the import turned
+ * out to be redirected, once the loader is done with a load.
+ */
+VOID
+NTAPI
+LdrpFlushDllPrefetches(VOID)
+{
+    PLDRP_PREFETCH Prefetch;
+    PLIST_ENTRY ListEntry;
+
+    if (IsListEmpty(&LdrpWorkQueue)) return;
+
+    RtlEnterCriticalSection(&LdrpWorkLock);
+
+    ListEntry = LdrpWorkQueue.Flink;
+    while (ListEntry != &LdrpWorkQueue)
+    {
+        Prefetch = CONTAINING_RECORD(ListEntry, LDRP_PREFETCH, Links);
+
+        if (Prefetch->State == LdrpPrefetchRunning)
+        {
+            /* Wait for it and start over */
+            RtlLeaveCriticalSection(&LdrpWorkLock);
+            NtWaitForSingleObject(LdrpWorkDoneEvent, FALSE, NULL);
+            RtlEnterCriticalSection(&LdrpWorkLock);
+            ListEntry = LdrpWorkQueue.Flink;
+            continue;
+        }
+
+        if (Prefetch->State == LdrpPrefetchQueued) LdrpQueuedWorkCount--;
+        ListEntry = ListEntry->Flink;
+        RemoveEntryList(&Prefetch->Links);
+        LdrpFreePrefetch(Prefetch);
+    }
+
+    RtlLeaveCriticalSection(&LdrpWorkLock);
+}
+
+/* EOF */
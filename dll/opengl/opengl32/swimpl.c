@@ -231,6 +231,10 @@ struct sw_framebuffer
 
     /* BackBuffer, if any */
     BYTE* BackBuffer;
+
+    /* DIB section holding the back buffer, selected into BackDC */
+    HBITMAP BackBitmap;
+    HDC BackDC;
 };
 
 struct sw_context
@@ -596,6 +600,58 @@ static inline void PUT_PIXEL_32(ULONG* Buffer, ULONG Value)
     *Buffer = Value;
 }
 
+/* Fill n consecutive pixels, front to back so that whole words get written at once */
+static inline void FILL_PIXELS_8(BYTE* Buffer, UINT n, BYTE Value)
+{
+    memset(Buffer, Value, n);
+}
+static inline void FILL_PIXELS_16(USHORT* Buffer, UINT n, USHORT Value)
+{
+    ULONG* Buffer32;
+    ULONG Value32 = Value | ((ULONG)Value << 16);
+
+    if (n && ((ULONG_PTR)Buffer & 2))
+    {
+        *Buffer++ = Value;
+        n--;
+    }
+
+    Buffer32 = (ULONG*)Buffer;
+    for (; n >= 2; n -= 2)
+        *Buffer32++ = Value32;
+
+    if (n)
+        *(USHORT*)Buffer32 = Value;
+}
+static inline void FILL_PIXELS_24(ULONG* Buffer, UINT n, ULONG Value)
+{
+    /* Four pixels make up three whole words */
+    ULONG Word0 = (Value & 0x00FFFFFF) | (Value << 24);
+    ULONG Word1 = ((Value >> 8) & 0x0000FFFF) | (Value << 16);
+    ULONG Word2 = ((Value >> 16) & 0x000000FF) | (Value << 8);
+    BYTE* Tail;
+
+    for (; n >= 4; n -= 4)
+    {
+        Buffer[0] = Word0;
+        Buffer[1] = Word1;
+        Buffer[2] = Word2;
+        Buffer += 3;
+    }
+
+    for (Tail = (BYTE*)Buffer; n; n--, Tail += 3)
+    {
+        Tail[0] = (BYTE)Value;
+        Tail[1] = (BYTE)(Value >> 8);
+        Tail[2] = (BYTE)(Value >> 16);
+    }
+}
+static inline void FILL_PIXELS_32(ULONG* Buffer, UINT n, ULONG Value)
+{
+    while (n--)
+        *Buffer++ = Value;
+}
+
 static inline BYTE GET_PIXEL_8(BYTE* Buffer)
 {
     return *Buffer;
@@ -819,15 +875,8 @@ static void clear_##__bpp(GLcontext* ctx, GLboolean all,GLint x, GLint y, GLint
     ScanLine = fb->BackBuffer + y * WIDTH_BYTES_ALIGN32(fb->width, __bpp);                          \
     while (height--)                                                                                \
     {                                                                                               \
-        BYTE* Buffer = ScanLine + x * __pixel_size;                                                 \
-        UINT n = width;                                                                             \
-                                                                                                    \
-        while (n--)                                                                                 \
-        {                                                                                           \
-            PUT_PIXEL_##__bpp((__type*)Buffer, sw_ctx->u##__bpp.ClearColor);                        \
-            Buffer += __pixel_size;                                                                 \
-        }                                                                                           \
-                                                                                                    \
+        FILL_PIXELS_##__bpp((__type*)(ScanLine + x * __pixel_size), width,                          \
+                sw_ctx->u##__bpp.ClearColor);                                                       \
         ScanLine += WIDTH_BYTES_ALIGN32(fb->width, __bpp);                                          \
     }                                                                                               \
 }
@@ -884,6 +933,81 @@ static GLboolean set_buffer( GLcontext* ctx, GLenum mode )
     return GL_TRUE;
 }
 
+static void init_bitmap_info(struct sw_framebuffer* fb, BITMAPINFO* bmi, GLuint width, GLuint height)
+{
+    BYTE Bpp = fb->pixel_format->cColorBits;
+
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biBitCount = Bpp;
+    bmi->bmiHeader.biClrImportant = 0;
+    bmi->bmiHeader.biClrUsed = 0;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biSizeImage = WIDTH_BYTES_ALIGN32(width, Bpp) * height;
+    bmi->bmiHeader.biXPelsPerMeter = 0;
+    bmi->bmiHeader.biYPelsPerMeter = 0;
+    bmi->bmiHeader.biHeight = height;
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biCompression = Bpp == 16 ? BI_BITFIELDS : BI_RGB;
+
+    if (Bpp == 16)
+    {
+        DWORD* BitMasks = (DWORD*)(&bmi->bmiColors[0]);
+        BitMasks[0] = 0x0000F800;
+        BitMasks[1] = 0x000007E0;
+        BitMasks[2] = 0x0000001F;
+    }
+}
+
+/*
+ * Put the back buffer of RGB formats in a DIB section. Its bits are shared with
+ * win32k, so presenting it is a plain BitBlt instead of copying the whole frame
+ * through SetDIBitsToDevice. Palettized formats keep using a heap buffer.
+ */
+static BOOL alloc_back_bitmap(struct sw_framebuffer* fb, GLuint width, GLuint height)
+{
+    char Buffer[sizeof(BITMAPINFOHEADER) + 3 * sizeof(DWORD)];
+    BITMAPINFO *bmi = (BITMAPINFO*)Buffer;
+    HBITMAP Bitmap;
+    void* Bits;
+
+    if (fb->pixel_format->iPixelType != PFD_TYPE_RGBA || fb->pixel_format->cColorBits <= 8)
+        return FALSE;
+
+    /* A heap back buffer is in use already, don't switch in between */
+    if (fb->BackBuffer && !fb->BackBitmap)
+        return FALSE;
+
+    if (!fb->BackDC)
+    {
+        fb->BackDC = CreateCompatibleDC(fb->Hdc);
+        if (!fb->BackDC)
+            return FALSE;
+    }
+
+    init_bitmap_info(fb, bmi, width, height);
+    Bitmap = CreateDIBSection(fb->BackDC, bmi, DIB_RGB_COLORS, &Bits, NULL, 0);
+    if (!Bitmap)
+    {
+        ERR("CreateDIBSection failed, last error %d.\n", GetLastError());
+
+        /* Once in a DIB section, there is no heap buffer to fall back to */
+        if (fb->BackBitmap)
+        {
+            fb->BackBuffer = NULL;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    SelectObject(fb->BackDC, Bitmap);
+    if (fb->BackBitmap)
+        DeleteObject(fb->BackBitmap);
+
+    fb->BackBitmap = Bitmap;
+    fb->BackBuffer = Bits;
+    return TRUE;
+}
+
 /* Return characteristics of the output buffer. */
 static void buffer_size(GLcontext* ctx, GLuint *width, GLuint *height)
 {
@@ -919,7 +1043,15 @@ static void buffer_size(GLcontext* ctx, GLuint *width, GLuint *height)
     {
         const struct pixel_format* pixel_format = fb->pixel_format;
 
-        if (pixel_format->dwFlags & PFD_DOUBLEBUFFER)
+        if ((pixel_format->dwFlags & PFD_DOUBLEBUFFER) && alloc_back_bitmap(fb, *width, *height))
+        {
+            if (!fb->BackBuffer)
+            {
+                ERR("Failed allocating back buffer !.\n");
+                return;
+            }
+        }
+        else if (pixel_format->dwFlags & PFD_DOUBLEBUFFER)
         {
             /* Allocate a new backbuffer */
             size_t BufferSize = *height * WIDTH_BYTES_ALIGN32(*width, pixel_format->cColorBits);
@@ -1078,11 +1210,8 @@ static void write_monocolor_span_##__bpp(GLcontext* ctx,
     }                                                                                               \
     else                                                                                            \
     {                                                                                               \
-        while(n--)                                                                                  \
-        {                                                                                           \
-            Buffer -= __pixel_size;                                                                 \
-            PUT_PIXEL_##__bpp((__type*)Buffer, sw_ctx->u##__bpp.CurrentColor);                      \
-        }                                                                                           \
+        FILL_PIXELS_##__bpp((__type*)(Buffer - n * __pixel_size), n,                                \
+                sw_ctx->u##__bpp.CurrentColor);                                                     \
     }                                                                                               \
 }
 WRITE_MONOCOLOR_SPAN(8, BYTE, 1)
@@ -1494,7 +1623,7 @@ BOOL sw_SwapBuffers(HDC hdc, struct wgl_dc_data* dc_data)
     struct sw_framebuffer* fb = dc_data->sw_data;
     char Buffer[sizeof(BITMAPINFOHEADER) + 3 * sizeof(DWORD)];
     BITMAPINFO *bmi = (BITMAPINFO*)Buffer;
-    BYTE Bpp = fb->pixel_format->cColorBits;
+    BOOL ret;
 
     if (!fb->gl_visual->DBflag)
         return TRUE;
@@ -1502,26 +1631,17 @@ BOOL sw_SwapBuffers(HDC hdc, struct wgl_dc_data* dc_data)
     if (!fb->BackBuffer)
         return FALSE;
 
-    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
-    bmi->bmiHeader.biBitCount = Bpp;
-    bmi->bmiHeader.biClrImportant = 0;
-    bmi->bmiHeader.biClrUsed = 0;
-    bmi->bmiHeader.biPlanes = 1;
-    bmi->bmiHeader.biSizeImage = WIDTH_BYTES_ALIGN32(fb->width, Bpp) * fb->height;
-    bmi->bmiHeader.biXPelsPerMeter = 0;
-    bmi->bmiHeader.biYPelsPerMeter = 0;
-    bmi->bmiHeader.biHeight = fb->height;
-    bmi->bmiHeader.biWidth = fb->width;
-    bmi->bmiHeader.biCompression = Bpp == 16 ? BI_BITFIELDS : BI_RGB;
-
-    if (Bpp == 16)
+    if (fb->BackBitmap)
     {
-        DWORD* BitMasks = (DWORD*)(&bmi->bmiColors[0]);
-        BitMasks[0] = 0x0000F800;
-        BitMasks[1] = 0x000007E0;
-        BitMasks[2] = 0x0000001F;
+        ret = BitBlt(fb->Hdc, 0, 0, fb->width, fb->height, fb->BackDC, 0, 0, SRCCOPY);
+
+        /* The blit may be batched, make sure it's done before rendering to the bits again */
+        GdiFlush();
+        return ret;
     }
 
+    init_bitmap_info(fb, bmi, fb->width, fb->height);
+
     return SetDIBitsToDevice(fb->Hdc, 0, 0, fb->width, fb->height, 0, 0, 0, fb->height, fb->BackBuffer, bmi,
             fb->pixel_format->iPixelType == PFD_TYPE_COLORINDEX ? DIB_PAL_COLORS : DIB_RGB_COLORS) != 0;
 }
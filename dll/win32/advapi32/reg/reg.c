@@ -3932,6 +3932,11 @@ RegQueryMultipleValuesW(HKEY hKey,
     DWORD maxBytes = *ldwTotsize;
     LPSTR bufptr = (LPSTR)lpValueBuf;
     LONG ErrorCode;
+    HANDLE KeyHandle;
+    NTSTATUS Status;
+    PKEY_VALUE_ENTRY Entries;
+    PUNICODE_STRING Names;
+    ULONG Length, RequiredLength = 0;
 
     if (maxBytes >= (1024*1024))
         return ERROR_MORE_DATA;
@@ -3941,6 +3946,60 @@ RegQueryMultipleValuesW(HKEY hKey,
     TRACE("RegQueryMultipleValuesW(%p,%p,%ld,%p,%p=%ld)\n",
           hKey, val_list, num_vals, lpValueBuf, ldwTotsize, *ldwTotsize);
 
+    Status = MapDefaultKey(&KeyHandle, hKey);
+    if (!NT_SUCCESS(Status))
+    {
+        return RtlNtStatusToDosError(Status);
+    }
+
+    /* Query all the values in one go, unless they have to be merged from HKCR */
+    if (!IsHKCRKey(KeyHandle) && (num_vals != 0))
+    {
+        Entries = RtlAllocateHeap(RtlGetProcessHeap(),
+                                  0,
+                                  num_vals * (sizeof(KEY_VALUE_ENTRY) + sizeof(UNICODE_STRING)));
+        if (Entries == NULL)
+        {
+            ClosePredefKey(KeyHandle);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        Names = (PUNICODE_STRING)&Entries[num_vals];
+
+        for (i = 0; i < num_vals; i++)
+        {
+            RtlInitUnicodeString(&Names[i], val_list[i].ve_valuename);
+            Entries[i].ValueName = &Names[i];
+        }
+
+        Length = lpValueBuf ? maxBytes : 0;
+        Status = NtQueryMultipleValueKey(KeyHandle,
+                                         Entries,
+                                         num_vals,
+                                         lpValueBuf,
+                                         &Length,
+                                         &RequiredLength);
+        if (NT_SUCCESS(Status) || (Status == STATUS_BUFFER_OVERFLOW))
+        {
+            for (i = 0; i < num_vals; i++)
+            {
+                val_list[i].ve_valuelen = Entries[i].DataLength;
+                val_list[i].ve_type = Entries[i].Type;
+                if (NT_SUCCESS(Status))
+                    val_list[i].ve_valueptr = (DWORD_PTR)bufptr + Entries[i].DataOffset;
+            }
+            *ldwTotsize = RequiredLength;
+        }
+
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Entries);
+        ClosePredefKey(KeyHandle);
+
+        if (Status == STATUS_BUFFER_OVERFLOW) return ERROR_MORE_DATA;
+        if (!NT_SUCCESS(Status)) return RtlNtStatusToDosError(Status);
+        return (lpValueBuf != NULL) ? ERROR_SUCCESS : ERROR_MORE_DATA;
+    }
+
+    ClosePredefKey(KeyHandle);
+
     for (i = 0; i < num_vals; i++)
     {
         val_list[i].ve_valuelen = 0;
@@ -161,8 +161,17 @@ typedef struct fdi_cds_fwd {
   struct fdi_folder *firstfol; 
   struct fdi_file   *firstfile;
   struct fdi_cds_fwd *next;
+#ifdef __REACTOS__
+  cab_UBYTE *readbuf;              /* read-ahead buffer for data blocks     */
+  cab_ULONG readpos, readlen;      /* consumed / valid bytes in readbuf     */
+#endif
 } fdi_decomp_state;
 
+#ifdef __REACTOS__
+/* Data blocks are read from the cabinet in chunks of this size */
+#define FDI_READAHEAD_SIZE (256 * 1024)
+#endif
+
 #define ZIPNEEDBITS(n) {while(k<(n)){cab_LONG c=*(ZIP(inpos)++);\
     b|=((cab_ULONG)c)<<k;k+=8;}}
 #define ZIPDUMPBITS(n) {b>>=(n);k-=(n);}
@@ -1923,6 +1932,57 @@ static int LZXfdi_decomp(int inlen, int outlen, fdi_decomp_state *decomp_state)
   return DECR_OK;
 }
 
+#ifdef __REACTOS__
+/*
+ * Reads the next cb bytes of data blocks of the cabinet, going through the
+ * read-ahead buffer so that the (often tiny) block headers and the block
+ * data don't each cost a call of the read callback. Passing a NULL buf
+ * skips the bytes. Must be reset by fdi_readahead_reset() whenever the
+ * cabinet handle is seeked.
+ */
+static BOOL fdi_readahead(fdi_decomp_state *cab, FDI_Int *fdi, cab_UBYTE *buf, UINT cb)
+{
+  UINT avail, read;
+
+  if (!cab->readbuf) {
+    cab->readbuf = fdi->alloc(FDI_READAHEAD_SIZE);
+    cab->readpos = cab->readlen = 0;
+  }
+
+  while (cb) {
+    avail = cab->readlen - cab->readpos;
+    if (avail == 0) {
+      if (!cab->readbuf) {
+        /* no buffer, read straight from the cabinet */
+        if (buf)
+          return fdi->read(cab->cabhf, buf, cb) == cb;
+        return fdi->seek(cab->cabhf, cb, SEEK_CUR) != -1;
+      }
+
+      read = fdi->read(cab->cabhf, cab->readbuf, FDI_READAHEAD_SIZE);
+      if (read == 0 || read == (UINT)-1)
+        return FALSE;
+      cab->readpos = 0;
+      cab->readlen = avail = read;
+    }
+
+    if (avail > cb) avail = cb;
+    if (buf) {
+      memcpy(buf, cab->readbuf + cab->readpos, avail);
+      buf += avail;
+    }
+    cab->readpos += avail;
+    cb -= avail;
+  }
+  return TRUE;
+}
+
+static inline void fdi_readahead_reset(fdi_decomp_state *cab)
+{
+  cab->readpos = cab->readlen = 0;
+}
+#endif
+
 /**********************************************************
  * fdi_decomp (internal)
  *
@@ -1966,19 +2026,32 @@ static int fdi_decomp(const struct fdi_file *fi, int savemode, fdi_decomp_state
     inlen = outlen = 0;
     while (outlen == 0) {
       /* read the block header, skip the reserved part */
+#ifdef __REACTOS__
+      if (!fdi_readahead(cab, CAB(fdi), buf, cfdata_SIZEOF))
+        return DECR_INPUT;
+
+      if (cab->mii.block_resv && !fdi_readahead(cab, CAB(fdi), NULL, cab->mii.block_resv))
+        return DECR_INPUT;
+#else
       if (CAB(fdi)->read(cab->cabhf, buf, cfdata_SIZEOF) != cfdata_SIZEOF)
         return DECR_INPUT;
 
       if (CAB(fdi)->seek(cab->cabhf, cab->mii.block_resv, SEEK_CUR) == -1)
         return DECR_INPUT;
+#endif
 
       /* we shouldn't get blocks over CAB_INPUTMAX in size */
       data = CAB(inbuf) + inlen;
       len = EndGetI16(buf+cfdata_CompressedSize);
       inlen += len;
       if (inlen > CAB_INPUTMAX) return DECR_INPUT;
+#ifdef __REACTOS__
+      if (!fdi_readahead(cab, CAB(fdi), data, len))
+        return DECR_INPUT;
+#else
       if (CAB(fdi)->read(cab->cabhf, data, len) != len)
         return DECR_INPUT;
+#endif
 
       /* clear two bytes after read-in data */
       data[len+1] = data[len+2] = 0;
@@ -2194,6 +2267,9 @@ static int fdi_decomp(const struct fdi_file *fi, int savemode, fdi_decomp_state
               success = TRUE;
               if (CAB(fdi)->seek(cab->cabhf, cab->firstfol->offset, SEEK_SET) == -1)
                 return DECR_INPUT;
+#ifdef __REACTOS__
+              fdi_readahead_reset(cab);
+#endif
               break;
             }
           }
@@ -2241,6 +2317,10 @@ static void free_decompression_mem(FDI_Int *fdi, fdi_decomp_state *decomp_state)
 
     fdi->close(CAB(cabhf));
 
+#ifdef __REACTOS__
+    if (CAB(readbuf)) fdi->free(CAB(readbuf));
+#endif
+
     /* free the storage remembered by mii */
     if (CAB(mii).nextname) fdi->free(CAB(mii).nextname);
     if (CAB(mii).nextinfo) fdi->free(CAB(mii).nextinfo);
@@ -2711,6 +2791,9 @@ BOOL __cdecl FDICopy(
 
         CAB(decomp_cab) = NULL;
         CAB(fdi)->seek(CAB(cabhf), fol->offset, SEEK_SET);
+#ifdef __REACTOS__
+        fdi_readahead_reset(decomp_state);
+#endif
         CAB(offset) = 0;
         CAB(outlen) = 0;
 
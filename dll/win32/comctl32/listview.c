@@ -2996,19 +2996,35 @@ static INT LISTVIEW_CalculateItemWidth(const LISTVIEW_INFO *infoPtr)
     {
 	WCHAR szDispText[DISP_TEXT_SIZE] = { '\0' };
 	LVITEMW lvItem;
+	HFONT hFont, hOldFont;
+	SIZE stringSize;
+	HDC hdc;
 	INT i;
 
-	lvItem.mask = LVIF_TEXT;
-	lvItem.iSubItem = 0;
-
-	for (i = 0; i < infoPtr->nItemCount; i++)
+	/* Virtual lists keep the default width, asking the owner for the text
+	 * of every item doesn't scale to their sizes. */
+	if (!(infoPtr->dwStyle & LVS_OWNERDATA) && infoPtr->nItemCount)
 	{
-	    lvItem.iItem = i;
-	    lvItem.pszText = szDispText;
-	    lvItem.cchTextMax = DISP_TEXT_SIZE;
-	    if (LISTVIEW_GetItemW(infoPtr, &lvItem))
-		nItemWidth = max(LISTVIEW_GetStringWidthT(infoPtr, lvItem.pszText, TRUE),
-				 nItemWidth);
+	    lvItem.mask = LVIF_TEXT;
+	    lvItem.iSubItem = 0;
+
+	    /* measure all the labels with the same DC */
+	    hFont = infoPtr->hFont ? infoPtr->hFont : infoPtr->hDefaultFont;
+	    hdc = GetDC(infoPtr->hwndSelf);
+	    hOldFont = SelectObject(hdc, hFont);
+
+	    for (i = 0; i < infoPtr->nItemCount; i++)
+	    {
+		lvItem.iItem = i;
+		lvItem.pszText = szDispText;
+		lvItem.cchTextMax = DISP_TEXT_SIZE;
+		if (LISTVIEW_GetItemW(infoPtr, &lvItem) && is_text(lvItem.pszText) &&
+		    GetTextExtentPointW(hdc, lvItem.pszText, lstrlenW(lvItem.pszText), &stringSize))
+		    nItemWidth = max(stringSize.cx, nItemWidth);
+	    }
+
+	    SelectObject(hdc, hOldFont);
+	    ReleaseDC(infoPtr->hwndSelf, hdc);
 	}
 
         if (infoPtr->himlSmall) nItemWidth += infoPtr->iconSize.cx; 
@@ -671,6 +671,8 @@ Query_Main(LPCWSTR Name,
     PCHAR HostWithDomainName;
     PCHAR AnsiName;
     size_t NameLen = 0;
+    DNS_STATUS Status;
+    DWORD Now;
 
     if (Name == NULL)
         return ERROR_INVALID_PARAMETER;
@@ -749,6 +751,7 @@ Query_Main(LPCWSTR Name,
             (*QueryResultSet)->wDataLength = sizeof(DNS_A_DATA);
             (*QueryResultSet)->Flags.S.Section = DnsSectionAnswer;
             (*QueryResultSet)->Flags.S.CharSet = DnsCharSetUnicode;
+            (*QueryResultSet)->dwTtl = 0; /* Not worth caching */
             (*QueryResultSet)->Data.A.IpAddress = Address;
 
             (*QueryResultSet)->pName = (LPSTR)DnsCToW(HostWithDomainName);
@@ -844,6 +847,10 @@ Query_Main(LPCWSTR Name,
                 (*QueryResultSet)->Flags.S.CharSet = DnsCharSetUnicode;
                 (*QueryResultSet)->Data.A.IpAddress = answer->rrs.addr->addr.inet.sin_addr.s_addr;
 
+                /* adns gives the absolute time the answer goes stale */
+                Now = GetCurrentTimeInSeconds();
+                (*QueryResultSet)->dwTtl = (answer->expires > (time_t)Now) ? (DWORD)(answer->expires - Now) : 0;
+
                 adns_finish(astate);
 
                 (*QueryResultSet)->pName = (LPSTR)xstrsave(Name);
@@ -853,13 +860,21 @@ Query_Main(LPCWSTR Name,
 
             if (NULL == answer || adns_s_prohibitedcname != answer->status || NULL == answer->cname)
             {
+                /* Tell an answer from the server apart from not getting one */
+                if (answer && answer->status == adns_s_nxdomain)
+                    Status = DNS_ERROR_RCODE_NAME_ERROR;
+                else if (answer && answer->status == adns_s_nodata)
+                    Status = DNS_INFO_NO_RECORDS;
+                else
+                    Status = ERROR_FILE_NOT_FOUND;
+
                 adns_finish(astate);
 
                 if (CurrentName != AnsiName)
                     RtlFreeHeap(RtlGetProcessHeap(), 0, CurrentName);
 
                 RtlFreeHeap(RtlGetProcessHeap(), 0, AnsiName);
-                return ERROR_FILE_NOT_FOUND;
+                return Status;
             }
 
             if (CurrentName != AnsiName)
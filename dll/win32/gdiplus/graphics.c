@@ -395,6 +395,33 @@ static GpStatus alpha_blend_bmp_pixels(GpGraphics *graphics, INT dst_x, INT dst_
     GpBitmap *dst_bitmap = (GpBitmap*)graphics->image;
     INT x, y;
 
+    if (dst_bitmap->format == PixelFormat32bppARGB && dst_bitmap->bits &&
+        dst_x >= 0 && dst_y >= 0 && dst_x + src_width <= dst_bitmap->width &&
+        dst_y + src_height <= dst_bitmap->height)
+    {
+        /* Same as below, without going through Get/SetPixel for each pixel */
+        for (y=0; y<src_height; y++)
+        {
+            const ARGB *src_row = (const ARGB*)(src + src_stride * y);
+            ARGB *dst_row = (ARGB*)(dst_bitmap->bits + dst_bitmap->stride * (y+dst_y)) + dst_x;
+
+            if (fmt & PixelFormatPAlpha)
+            {
+                for (x=0; x<src_width; x++)
+                    if (src_row[x] & 0xff000000)
+                        dst_row[x] = color_over_fgpremult(dst_row[x], src_row[x]);
+            }
+            else
+            {
+                for (x=0; x<src_width; x++)
+                    if (src_row[x] & 0xff000000)
+                        dst_row[x] = color_over(dst_row[x], src_row[x]);
+            }
+        }
+
+        return Ok;
+    }
+
     for (y=0; y<src_height; y++)
     {
         for (x=0; x<src_width; x++)
@@ -561,11 +588,15 @@ static GpStatus alpha_blend_pixels(GpGraphics *graphics, INT dst_x, INT dst_y,
 static inline ARGB blend_colors_premult(ARGB start, ARGB end, REAL position)
 {
     UINT pos = position * 255.0f + 0.5f;
-    return
-        (((((start >> 24)       ) << 8) + (((end >> 24)       ) - ((start >> 24)       )) * pos) >> 8) << 24 |
-        (((((start >> 16) & 0xff) << 8) + (((end >> 16) & 0xff) - ((start >> 16) & 0xff)) * pos) >> 8) << 16 |
-        (((((start >>  8) & 0xff) << 8) + (((end >>  8) & 0xff) - ((start >>  8) & 0xff)) * pos) >> 8) <<  8 |
-        (((((start      ) & 0xff) << 8) + (((end      ) & 0xff) - ((start      ) & 0xff)) * pos) >> 8);
+    UINT inv = 256 - pos;
+    UINT rb, ag;
+
+    /* start + (end - start) * pos / 256 for each channel, two channels at a
+     * time. No lane can exceed 255 * 256, so they don't carry into each other. */
+    rb = (((start      ) & 0x00ff00ff) * inv + ((end      ) & 0x00ff00ff) * pos) >> 8;
+    ag = (((start >>  8) & 0x00ff00ff) * inv + ((end >>  8) & 0x00ff00ff) * pos) >> 8;
+
+    return (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
 }
 
 static ARGB blend_colors(ARGB start, ARGB end, REAL position)
@@ -1122,6 +1153,104 @@ static ARGB resample_bitmap_pixel_premult(GDIPCONST GpRect *src_rect, LPBYTE bit
     }
 }
 
+/* The source of resample_bitmap_span */
+struct resample_source
+{
+    GDIPCONST GpRect *rect;     /* area of the bitmap held in bits */
+    const ARGB *bits;
+    UINT width, height;         /* of the whole bitmap */
+    REAL x, y, cx, cy;          /* the part of the bitmap being drawn */
+    GDIPCONST GpImageAttributes *attributes;
+    InterpolationMode interpolation;
+    PixelOffsetMode offset_mode;
+    BOOL premult;
+};
+
+/* Resamples a row of count destination pixels. The source point of pixel i
+ * is origin + (first + i) * (x_dx, x_dy) + (row_x, row_y).
+ *
+ * Points whose samples all fall inside src->rect are read straight from the
+ * bits; only those needing the wrap mode go through resample_bitmap_pixel. */
+static void resample_bitmap_span(const struct resample_source *src, GDIPCONST GpPointF *origin,
+    INT first, REAL x_dx, REAL x_dy, REAL row_x, REAL row_y, ARGB *dst, INT count)
+{
+    GDIPCONST GpRect *rect = src->rect;
+    INT right = rect->X + rect->Width, bottom = rect->Y + rect->Height;
+    REAL delta_xx = first * x_dx, delta_xy = first * x_dy;
+    FLOAT pixel_offset;
+    GpPointF point;
+    INT i;
+
+    switch (src->offset_mode)
+    {
+    default:
+    case PixelOffsetModeNone:
+    case PixelOffsetModeHighSpeed:
+        pixel_offset = 0.5;
+        break;
+
+    case PixelOffsetModeHalf:
+    case PixelOffsetModeHighQuality:
+        pixel_offset = 0.0;
+        break;
+    }
+
+    for (i = 0; i < count; i++, delta_xx += x_dx, delta_xy += x_dy)
+    {
+        point.X = origin->X + delta_xx + row_x;
+        point.Y = origin->Y + delta_xy + row_y;
+
+        if (!(point.X >= src->x && point.X < src->x + src->cx &&
+              point.Y >= src->y && point.Y < src->y + src->cy))
+        {
+            dst[i] = 0;
+            continue;
+        }
+
+        if (src->interpolation == InterpolationModeBilinear)
+        {
+            INT leftx = (INT)point.X, topy = (INT)point.Y;
+            INT rightx = positive_ceilf(point.X), bottomy = positive_ceilf(point.Y);
+
+            if (leftx >= rect->X && topy >= rect->Y && rightx < right && bottomy < bottom)
+            {
+                const ARGB *top = src->bits + (topy - rect->Y) * rect->Width + (leftx - rect->X);
+                const ARGB *bot = top + (bottomy - topy) * rect->Width;
+                REAL x_offset = point.X - (REAL)leftx, y_offset = point.Y - (REAL)topy;
+                INT next = rightx - leftx;
+
+                if (!next && top == bot)
+                    dst[i] = top[0];
+                else if (src->premult)
+                    dst[i] = blend_colors_premult(blend_colors_premult(top[0], top[next], x_offset),
+                                                  blend_colors_premult(bot[0], bot[next], x_offset), y_offset);
+                else
+                    dst[i] = blend_colors(blend_colors(top[0], top[next], x_offset),
+                                          blend_colors(bot[0], bot[next], x_offset), y_offset);
+                continue;
+            }
+        }
+        else if (src->interpolation == InterpolationModeNearestNeighbor)
+        {
+            INT x = floorf(point.X + pixel_offset);
+            INT y = src->premult ? (INT)(point.Y + pixel_offset) : floorf(point.Y + pixel_offset);
+
+            if (x >= rect->X && y >= rect->Y && x < right && y < bottom)
+            {
+                dst[i] = src->bits[(x - rect->X) + (y - rect->Y) * rect->Width];
+                continue;
+            }
+        }
+
+        if (src->premult)
+            dst[i] = resample_bitmap_pixel_premult(rect, (LPBYTE)src->bits, src->width, src->height,
+                &point, src->attributes, src->interpolation, src->offset_mode);
+        else
+            dst[i] = resample_bitmap_pixel(rect, (LPBYTE)src->bits, src->width, src->height,
+                &point, src->attributes, src->interpolation, src->offset_mode);
+    }
+}
+
 static REAL intersect_line_scanline(const GpPointF *p1, const GpPointF *p2, REAL y)
 {
     return (p1->X - p2->X) * (p2->Y - y) / (p2->Y - p1->Y) + p2->X;
@@ -1245,9 +1374,15 @@ static GpStatus brush_fill_pixels(GpGraphics *graphics, GpBrush *brush,
     {
         int x, y;
         GpSolidFill *fill = (GpSolidFill*)brush;
+
+        if (fill_area->Width <= 0 || fill_area->Height <= 0)
+            return Ok;
+
+        /* Fill one row, then copy it to the others */
         for (x=0; x<fill_area->Width; x++)
-            for (y=0; y<fill_area->Height; y++)
-                argb_pixels[x + y*cdwStride] = fill->color;
+            argb_pixels[x] = fill->color;
+        for (y=1; y<fill_area->Height; y++)
+            memcpy(argb_pixels + y*cdwStride, argb_pixels, fill_area->Width * sizeof(DWORD));
         return Ok;
     }
     case BrushTypeHatchFill:
@@ -1259,20 +1394,26 @@ static GpStatus brush_fill_pixels(GpGraphics *graphics, GpBrush *brush,
         if (get_hatch_data(fill->hatchstyle, &hatch_data) != Ok)
             return NotImplemented;
 
-        for (x=0; x<fill_area->Width; x++)
-            for (y=0; y<fill_area->Height; y++)
-            {
-                int hx, hy;
+        for (y=0; y<fill_area->Height; y++)
+        {
+            DWORD *row = argb_pixels + y*cdwStride;
+            int hx, hy;
+            char pattern;
 
-                /* FIXME: Account for the rendering origin */
+            /* FIXME: Account for the rendering origin */
+            hy = (y + fill_area->Y) % 8;
+            pattern = hatch_data[7-hy];
+
+            for (x=0; x<fill_area->Width; x++)
+            {
                 hx = (x + fill_area->X) % 8;
-                hy = (y + fill_area->Y) % 8;
 
-                if ((hatch_data[7-hy] & (0x80 >> hx)) != 0)
-                    argb_pixels[x + y*cdwStride] = fill->forecol;
+                if ((pattern & (0x80 >> hx)) != 0)
+                    row[x] = fill->forecol;
                 else
-                    argb_pixels[x + y*cdwStride] = fill->backcol;
+                    row[x] = fill->backcol;
             }
+        }
 
         return Ok;
     }
@@ -3165,7 +3306,7 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
             RECT dst_area;
             GpRectF graphics_bounds;
             GpRect src_area;
-            int i, x, y, src_stride, dst_stride;
+            int i, y, src_stride, dst_stride;
             GpMatrix dst_to_src;
             REAL m11, m12, m21, m22, mdx, mdy;
             LPBYTE src_data, dst_data, dst_dyn_data=NULL;
@@ -3264,7 +3405,8 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
 
             if (do_resampling)
             {
-                REAL delta_xx, delta_xy, delta_yx, delta_yy;
+                REAL delta_yx, delta_yy;
+                struct resample_source source;
 
                 /* Transform the bits as needed to the destination. */
                 dst_data = dst_dyn_data = heap_alloc_zero(sizeof(ARGB) * (dst_area.right - dst_area.left) * (dst_area.bottom - dst_area.top));
@@ -3283,41 +3425,30 @@ GpStatus WINGDIPAPI GdipDrawImagePointsRect(GpGraphics *graphics, GpImage *image
                 y_dx = dst_to_src_points[2].X - dst_to_src_points[0].X;
                 y_dy = dst_to_src_points[2].Y - dst_to_src_points[0].Y;
 
+                source.rect = &src_area;
+                source.bits = (const ARGB*)src_data;
+                source.width = bitmap->width;
+                source.height = bitmap->height;
+                source.x = srcx;
+                source.y = srcy;
+                source.cx = srcwidth;
+                source.cy = srcheight;
+                source.attributes = imageAttributes;
+                source.interpolation = interpolation;
+                source.offset_mode = offset_mode;
+                source.premult = (lockeddata.PixelFormat == PixelFormat32bppPARGB);
+
                 delta_yy = dst_area.top * y_dy;
                 delta_yx = dst_area.top * y_dx;
 
                 for (y=dst_area.top; y<dst_area.bottom; y++)
                 {
-                    delta_xx = dst_area.left * x_dx;
-                    delta_xy = dst_area.left * x_dy;
-
-                    for (x=dst_area.left; x<dst_area.right; x++)
-                    {
-                        GpPointF src_pointf;
-                        ARGB *dst_color;
-
-                        src_pointf.X = dst_to_src_points[0].X + delta_xx + delta_yx;
-                        src_pointf.Y = dst_to_src_points[0].Y + delta_xy + delta_yy;
-
-                        dst_color = (ARGB*)(dst_data + dst_stride * (y - dst_area.top) + sizeof(ARGB) * (x - dst_area.left));
-
-                        if (src_pointf.X >= srcx && src_pointf.X < srcx + srcwidth && src_pointf.Y >= srcy && src_pointf.Y < srcy+srcheight)
-                        {
-                            if (lockeddata.PixelFormat != PixelFormat32bppPARGB)
-                                *dst_color = resample_bitmap_pixel(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                   imageAttributes, interpolation, offset_mode);
-                            else
-                                *dst_color = resample_bitmap_pixel_premult(&src_area, src_data, bitmap->width, bitmap->height, &src_pointf,
-                                                                           imageAttributes, interpolation, offset_mode);
-                        }
-                        else
-                            *dst_color = 0;
-
-                        delta_xx += x_dx;
-                        delta_yx += y_dx;
-                    }
+                    resample_bitmap_span(&source, &dst_to_src_points[0], dst_area.left,
+                        x_dx, x_dy, delta_yx, delta_yy,
+                        (ARGB*)(dst_data + dst_stride * (y - dst_area.top)),
+                        dst_area.right - dst_area.left);
 
-                    delta_xy += x_dy;
+                    delta_yx += y_dx;
                     delta_yy += y_dy;
                 }
             }
@@ -224,6 +224,7 @@ static unsigned push_instr(compiler_ctx_t *ctx, jsop_t op)
     }
 
     ctx->code->instrs[ctx->code_off].op = op;
+    memset(&ctx->code->instrs[ctx->code_off].u, 0, sizeof(ctx->code->instrs[ctx->code_off].u));
     return ctx->code_off++;
 }
 
@@ -352,10 +353,62 @@ static HRESULT push_instr_uint(compiler_ctx_t *ctx, jsop_t op, unsigned arg)
     return S_OK;
 }
 
+/* Evaluates arithmetic on numeric literals, so that it is not repeated at run time */
+static BOOL fold_numeric_expression(expression_t *expr, double *ret)
+{
+    binary_expression_t *binary_expr = (binary_expression_t*)expr;
+    double n1, n2;
+
+    switch(expr->type) {
+    case EXPR_LITERAL:
+        if(((literal_expression_t*)expr)->literal->type != LT_DOUBLE)
+            return FALSE;
+        *ret = ((literal_expression_t*)expr)->literal->u.dval;
+        return TRUE;
+    case EXPR_MINUS:
+        if(!fold_numeric_expression(((unary_expression_t*)expr)->expression, &n1))
+            return FALSE;
+        *ret = -n1;
+        return TRUE;
+    case EXPR_PLUS:
+        return fold_numeric_expression(((unary_expression_t*)expr)->expression, ret);
+    case EXPR_ADD:
+    case EXPR_SUB:
+    case EXPR_MUL:
+    case EXPR_DIV:
+        if(!fold_numeric_expression(binary_expr->expression1, &n1)
+           || !fold_numeric_expression(binary_expr->expression2, &n2))
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    switch(expr->type) {
+    case EXPR_ADD:
+        *ret = n1 + n2;
+        break;
+    case EXPR_SUB:
+        *ret = n1 - n2;
+        break;
+    case EXPR_MUL:
+        *ret = n1 * n2;
+        break;
+    default:
+        *ret = n1 / n2;
+        break;
+    }
+    return TRUE;
+}
+
 static HRESULT compile_binary_expression(compiler_ctx_t *ctx, binary_expression_t *expr, jsop_t op)
 {
+    double n;
     HRESULT hres;
 
+    if(fold_numeric_expression(&expr->expr, &n))
+        return push_instr_double(ctx, OP_double, n);
+
     hres = compile_expression(ctx, expr->expression1, TRUE);
     if(FAILED(hres))
         return hres;
@@ -369,8 +422,12 @@ static HRESULT compile_binary_expression(compiler_ctx_t *ctx, binary_expression_
 
 static HRESULT compile_unary_expression(compiler_ctx_t *ctx, unary_expression_t *expr, jsop_t op)
 {
+    double n;
     HRESULT hres;
 
+    if(fold_numeric_expression(&expr->expr, &n))
+        return push_instr_double(ctx, OP_double, n);
+
     hres = compile_expression(ctx, expr->expression, TRUE);
     if(FAILED(hres))
         return hres;
@@ -19,6 +19,14 @@
 DEBUG_CHANNEL(kernel32file);
 #endif
 
+/* Files at least this big go through CopyLoopLarge */
+#define COPY_LARGE_FILE_THRESHOLD   (16 * 1024 * 1024)
+#define COPY_MIN_LARGE_BUFFER       (1024 * 1024)
+#define COPY_MAX_LARGE_BUFFER       (8 * 1024 * 1024)
+/* Unbuffered writes must be a whole number of sectors, use the page size
+ * which is a multiple of every sector size we support */
+#define COPY_UNBUFFERED_ALIGNMENT   0x1000
+
 /* FUNCTIONS ****************************************************************/
 
 
@@ -162,6 +170,264 @@ CopyLoop (
     return errCode;
 }
 
+static NTSTATUS
+CopyWaitForIo(
+    HANDLE              Event,
+    NTSTATUS            Status,
+    PIO_STATUS_BLOCK    IoStatusBlock
+)
+{
+    if (Status == STATUS_PENDING)
+    {
+        Status = NtWaitForSingleObject(Event, FALSE, NULL);
+        if (NT_SUCCESS(Status))
+        {
+            Status = IoStatusBlock->Status;
+        }
+    }
+
+    return Status;
+}
+
+/*
+ * Copy engine for big files. Both handles are opened for overlapped,
+ * unbuffered I/O. Two buffers are used so that the next chunk is read
+ * from the source while the current one is written to the destination.
+ */
+static NTSTATUS
+CopyLoopLarge (
+    HANDLE			FileHandleSource,
+    HANDLE			FileHandleDest,
+    LARGE_INTEGER		SourceFileSize,
+    LPPROGRESS_ROUTINE	lpProgressRoutine,
+    LPVOID			lpData,
+    BOOL			*pbCancel,
+    BOOL                 *KeepDest
+)
+{
+    NTSTATUS errCode, ReadStatus;
+    IO_STATUS_BLOCK ReadIoStatusBlock, WriteIoStatusBlock, IoStatusBlock;
+    FILE_ALLOCATION_INFORMATION FileAllocation;
+    FILE_END_OF_FILE_INFORMATION FileEndOfFile;
+    HANDLE ReadEvent = NULL, WriteEvent = NULL;
+    UCHAR *lpBuffer = NULL;
+    UCHAR *Buffers[2];
+    ULONG Current;
+    SIZE_T RegionSize;
+    ULONG BufferSize, Length, WriteLength;
+    LARGE_INTEGER ReadOffset, WriteOffset;
+    DWORD CallbackReason;
+    DWORD ProgressResult;
+
+    *KeepDest = FALSE;
+
+    /* Aim for about 16 chunks, within 1-8 MB */
+    if (SourceFileSize.QuadPart / 16 >= COPY_MAX_LARGE_BUFFER)
+    {
+        BufferSize = COPY_MAX_LARGE_BUFFER;
+    }
+    else
+    {
+        BufferSize = ROUND_DOWN((ULONG)(SourceFileSize.QuadPart / 16), COPY_MIN_LARGE_BUFFER);
+        BufferSize = max(BufferSize, COPY_MIN_LARGE_BUFFER);
+    }
+
+    /* Let the file system lay out the destination in one go */
+    FileAllocation.AllocationSize = SourceFileSize;
+    errCode = NtSetInformationFile(FileHandleDest,
+                                   &IoStatusBlock,
+                                   &FileAllocation,
+                                   sizeof(FILE_ALLOCATION_INFORMATION),
+                                   FileAllocationInformation);
+    if (!NT_SUCCESS(errCode))
+    {
+        TRACE("Status 0x%08x preallocating dest\n", errCode);
+    }
+
+    RegionSize = 2 * BufferSize;
+    errCode = NtAllocateVirtualMemory(NtCurrentProcess(),
+                                      (PVOID *)&lpBuffer,
+                                      0,
+                                      &RegionSize,
+                                      MEM_RESERVE | MEM_COMMIT,
+                                      PAGE_READWRITE);
+    if (!NT_SUCCESS(errCode))
+    {
+        TRACE("Error 0x%08x allocating buffer of %lu bytes\n", errCode, RegionSize);
+        return errCode;
+    }
+    Buffers[0] = lpBuffer;
+    Buffers[1] = lpBuffer + BufferSize;
+
+    errCode = NtCreateEvent(&ReadEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+    if (NT_SUCCESS(errCode))
+    {
+        errCode = NtCreateEvent(&WriteEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+    }
+    if (!NT_SUCCESS(errCode))
+    {
+        WARN("Error 0x%08x creating events\n", errCode);
+        goto Cleanup;
+    }
+
+    ReadOffset.QuadPart = 0;
+    WriteOffset.QuadPart = 0;
+    Current = 0;
+    CallbackReason = CALLBACK_STREAM_SWITCH;
+
+    ReadStatus = NtReadFile(FileHandleSource,
+                            ReadEvent,
+                            NULL,
+                            NULL,
+                            &ReadIoStatusBlock,
+                            Buffers[Current],
+                            BufferSize,
+                            &ReadOffset,
+                            NULL);
+
+    for (;;)
+    {
+        if (NULL != lpProgressRoutine)
+        {
+            ProgressResult = (*lpProgressRoutine)(SourceFileSize,
+                                                  WriteOffset,
+                                                  SourceFileSize,
+                                                  WriteOffset,
+                                                  0,
+                                                  CallbackReason,
+                                                  FileHandleSource,
+                                                  FileHandleDest,
+                                                  lpData);
+            switch (ProgressResult)
+            {
+            case PROGRESS_CANCEL:
+                TRACE("Progress callback requested cancel\n");
+                errCode = STATUS_REQUEST_ABORTED;
+                break;
+            case PROGRESS_STOP:
+                TRACE("Progress callback requested stop\n");
+                errCode = STATUS_REQUEST_ABORTED;
+                *KeepDest = TRUE;
+                break;
+            case PROGRESS_QUIET:
+                lpProgressRoutine = NULL;
+                break;
+            case PROGRESS_CONTINUE:
+            default:
+                break;
+            }
+            CallbackReason = CALLBACK_CHUNK_FINISHED;
+            if (!NT_SUCCESS(errCode))
+            {
+                break;
+            }
+        }
+
+        if (NULL != pbCancel && *pbCancel)
+        {
+            TRACE("User requested cancel\n");
+            errCode = STATUS_REQUEST_ABORTED;
+            break;
+        }
+
+        ReadStatus = CopyWaitForIo(ReadEvent, ReadStatus, &ReadIoStatusBlock);
+        if (STATUS_END_OF_FILE == ReadStatus ||
+            (NT_SUCCESS(ReadStatus) && ReadIoStatusBlock.Information == 0))
+        {
+            break;
+        }
+        if (!NT_SUCCESS(ReadStatus))
+        {
+            WARN("Error 0x%08x reading from source\n", ReadStatus);
+            errCode = ReadStatus;
+            break;
+        }
+
+        Length = (ULONG)ReadIoStatusBlock.Information;
+        ReadOffset.QuadPart += Length;
+
+        /* Start reading the next chunk while this one is being written */
+        if (Length == BufferSize)
+        {
+            ReadStatus = NtReadFile(FileHandleSource,
+                                    ReadEvent,
+                                    NULL,
+                                    NULL,
+                                    &ReadIoStatusBlock,
+                                    Buffers[Current ^ 1],
+                                    BufferSize,
+                                    &ReadOffset,
+                                    NULL);
+        }
+        else
+        {
+            ReadStatus = STATUS_END_OF_FILE;
+        }
+
+        /* The padding of the last chunk is cut off again below */
+        WriteLength = ROUND_UP(Length, COPY_UNBUFFERED_ALIGNMENT);
+        RtlZeroMemory(Buffers[Current] + Length, WriteLength - Length);
+
+        errCode = NtWriteFile(FileHandleDest,
+                              WriteEvent,
+                              NULL,
+                              NULL,
+                              &WriteIoStatusBlock,
+                              Buffers[Current],
+                              WriteLength,
+                              &WriteOffset,
+                              NULL);
+        errCode = CopyWaitForIo(WriteEvent, errCode, &WriteIoStatusBlock);
+        if (!NT_SUCCESS(errCode))
+        {
+            WARN("Error 0x%08x writing to dest\n", errCode);
+            break;
+        }
+
+        WriteOffset.QuadPart += Length;
+        Current ^= 1;
+    }
+
+    /* Never free the buffers under a read still in flight */
+    if (STATUS_PENDING == ReadStatus)
+    {
+        NtCancelIoFile(FileHandleSource, &IoStatusBlock);
+        NtWaitForSingleObject(ReadEvent, FALSE, NULL);
+    }
+
+    if (NT_SUCCESS(errCode))
+    {
+        FileEndOfFile.EndOfFile = WriteOffset;
+        errCode = NtSetInformationFile(FileHandleDest,
+                                       &IoStatusBlock,
+                                       &FileEndOfFile,
+                                       sizeof(FILE_END_OF_FILE_INFORMATION),
+                                       FileEndOfFileInformation);
+        if (!NT_SUCCESS(errCode))
+        {
+            WARN("Error 0x%08x setting dest size\n", errCode);
+        }
+    }
+
+Cleanup:
+    if (WriteEvent != NULL)
+    {
+        NtClose(WriteEvent);
+    }
+    if (ReadEvent != NULL)
+    {
+        NtClose(ReadEvent);
+    }
+
+    RegionSize = 0;
+    NtFreeVirtualMemory(NtCurrentProcess(),
+                        (PVOID *)&lpBuffer,
+                        &RegionSize,
+                        MEM_RELEASE);
+
+    return errCode;
+}
+
 static NTSTATUS
 SetLastWriteTime(
     HANDLE FileHandle,
@@ -216,6 +482,7 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
     FILE_BASIC_INFORMATION FileBasic;
     BOOL RC = FALSE;
     BOOL KeepDestOnError = FALSE;
+    BOOL LargeFile;
     DWORD SystemError;
 
     FileHandleSource = CreateFileW(lpExistingFileName,
@@ -250,22 +517,61 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
             }
             else
             {
+                LargeFile = (FileStandard.EndOfFile.QuadPart >= COPY_LARGE_FILE_THRESHOLD);
+                if (LargeFile)
+                {
+                    HANDLE FileHandleOverlapped;
+
+                    /* CopyLoopLarge needs the source opened for overlapped I/O */
+                    FileHandleOverlapped = CreateFileW(lpExistingFileName,
+                                                       GENERIC_READ,
+                                                       FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                                       NULL,
+                                                       OPEN_EXISTING,
+                                                       FILE_ATTRIBUTE_NORMAL|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                                                       NULL);
+                    if (INVALID_HANDLE_VALUE != FileHandleOverlapped)
+                    {
+                        NtClose(FileHandleSource);
+                        FileHandleSource = FileHandleOverlapped;
+                    }
+                    else
+                    {
+                        TRACE("Error %lu reopening source, using the small copy loop\n", GetLastError());
+                        LargeFile = FALSE;
+                    }
+                }
+
                 FileHandleDest = CreateFileW(lpNewFileName,
                                              GENERIC_WRITE,
                                              FILE_SHARE_WRITE,
                                              NULL,
                                              dwCopyFlags ? CREATE_NEW : CREATE_ALWAYS,
-                                             FileBasic.FileAttributes,
+                                             FileBasic.FileAttributes |
+                                             (LargeFile ? FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED : 0),
                                              NULL);
                 if (INVALID_HANDLE_VALUE != FileHandleDest)
                 {
-                    errCode = CopyLoop(FileHandleSource,
-                                       FileHandleDest,
-                                       FileStandard.EndOfFile,
-                                       lpProgressRoutine,
-                                       lpData,
-                                       pbCancel,
-                                       &KeepDestOnError);
+                    if (LargeFile)
+                    {
+                        errCode = CopyLoopLarge(FileHandleSource,
+                                                FileHandleDest,
+                                                FileStandard.EndOfFile,
+                                                lpProgressRoutine,
+                                                lpData,
+                                                pbCancel,
+                                                &KeepDestOnError);
+                    }
+                    else
+                    {
+                        errCode = CopyLoop(FileHandleSource,
+                                           FileHandleDest,
+                                           FileStandard.EndOfFile,
+                                           lpProgressRoutine,
+                                           lpData,
+                                           pbCancel,
+                                           &KeepDestOnError);
+                    }
                     if (!NT_SUCCESS(errCode))
                     {
                         BaseSetLastNTError(errCode);
@@ -66,6 +66,45 @@ VirtualAllocEx(IN HANDLE hProcess,
     return lpAddress;
 }
 
+/*
+ * @implemented
+ */
+LPVOID
+WINAPI
+VirtualAllocExNuma(IN HANDLE hProcess,
+                   IN LPVOID lpAddress,
+                   IN SIZE_T dwSize,
+                   IN DWORD flAllocationType,
+                   IN DWORD flProtect,
+                   IN DWORD nndPreferred)
+{
+    /* The node bits are ours to set */
+    if (flAllocationType & MEM_PREFERRED_NODE_MASK)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    /* The kernel takes the preferred node plus one, zero meaning no preference */
+    if (nndPreferred != NUMA_NO_PREFERRED_NODE)
+    {
+        if (nndPreferred >= MEM_PREFERRED_NODE_MASK)
+        {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return NULL;
+        }
+
+        flAllocationType |= nndPreferred + 1;
+    }
+
+    /* Call the extended API */
+    return VirtualAllocEx(hProcess,
+                          lpAddress,
+                          dwSize,
+                          flAllocationType,
+                          flProtect);
+}
+
 /*
  * @implemented
  */
@@ -0,0 +1,396 @@
+
+#include "k32_vista.h"
+
+#define NDEBUG
+#include <debug.h>
+
+typedef VOID
+(NTAPI *PTP_IO_CALLBACK)(
+    IN PTP_CALLBACK_INSTANCE Instance,
+    IN PVOID Context,
+    IN PVOID ApcContext,
+    IN PIO_STATUS_BLOCK IoStatusBlock,
+    IN PTP_IO Io);
+
+NTSTATUS NTAPI TpAllocPool(OUT PTP_POOL *Pool, IN PVOID Reserved);
+VOID NTAPI TpReleasePool(IN PTP_POOL Pool);
+VOID NTAPI TpSetPoolMaxThreads(IN PTP_POOL Pool, IN LONG MaxThreads);
+NTSTATUS NTAPI TpSetPoolMinThreads(IN PTP_POOL Pool, IN LONG MinThreads);
+
+NTSTATUS NTAPI TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroup);
+VOID NTAPI TpReleaseCleanupGroup(IN PTP_CLEANUP_GROUP CleanupGroup);
+VOID NTAPI TpReleaseCleanupGroupMembers(IN PTP_CLEANUP_GROUP CleanupGroup, IN BOOLEAN CancelPending, IN PVOID CleanupParameter OPTIONAL);
+
+NTSTATUS NTAPI TpAllocWork(OUT PTP_WORK *Work, IN PTP_WORK_CALLBACK Callback, IN PVOID Context OPTIONAL, IN PTP_CALLBACK_ENVIRON Environment OPTIONAL);
+VOID NTAPI TpPostWork(IN PTP_WORK Work);
+VOID NTAPI TpWaitForWork(IN PTP_WORK Work, IN BOOLEAN CancelPending);
+VOID NTAPI TpReleaseWork(IN PTP_WORK Work);
+NTSTATUS NTAPI TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback, IN PVOID Context OPTIONAL, IN PTP_CALLBACK_ENVIRON Environment OPTIONAL);
+
+NTSTATUS NTAPI TpAllocTimer(OUT PTP_TIMER *Timer, IN PTP_TIMER_CALLBACK Callback, IN PVOID Context OPTIONAL, IN PTP_CALLBACK_ENVIRON Environment OPTIONAL);
+VOID NTAPI TpSetTimer(IN PTP_TIMER Timer, IN PLARGE_INTEGER DueTime OPTIONAL, IN LONG Period, IN LONG WindowLength);
+BOOLEAN NTAPI TpIsTimerSet(IN PTP_TIMER Timer);
+VOID NTAPI TpWaitForTimer(IN PTP_TIMER Timer, IN BOOLEAN CancelPending);
+VOID NTAPI TpReleaseTimer(IN PTP_TIMER Timer);
+
+NTSTATUS NTAPI TpAllocWait(OUT PTP_WAIT *Wait, IN PTP_WAIT_CALLBACK Callback, IN PVOID Context OPTIONAL, IN PTP_CALLBACK_ENVIRON Environment OPTIONAL);
+VOID NTAPI TpSetWait(IN PTP_WAIT Wait, IN HANDLE Handle OPTIONAL, IN PLARGE_INTEGER Timeout OPTIONAL);
+VOID NTAPI TpWaitForWait(IN PTP_WAIT Wait, IN BOOLEAN CancelPending);
+VOID NTAPI TpReleaseWait(IN PTP_WAIT Wait);
+
+NTSTATUS NTAPI TpAllocIoCompletion(OUT PTP_IO *Io, IN HANDLE File, IN PTP_IO_CALLBACK Callback, IN PVOID Context OPTIONAL, IN PTP_CALLBACK_ENVIRON Environment OPTIONAL);
+VOID NTAPI TpStartAsyncIoOperation(IN PTP_IO Io);
+VOID NTAPI TpCancelAsyncIoOperation(IN PTP_IO Io);
+VOID NTAPI TpWaitForIoCompletion(IN PTP_IO Io, IN BOOLEAN CancelPending);
+VOID NTAPI TpReleaseIoCompletion(IN PTP_IO Io);
+
+NTSTATUS NTAPI TpCallbackMayRunLong(IN PTP_CALLBACK_INSTANCE Instance);
+VOID NTAPI TpCallbackSetEventOnCompletion(IN PTP_CALLBACK_INSTANCE Instance, IN HANDLE Event);
+VOID NTAPI TpCallbackReleaseSemaphoreOnCompletion(IN PTP_CALLBACK_INSTANCE Instance, IN HANDLE Semaphore, IN LONG ReleaseCount);
+VOID NTAPI TpCallbackReleaseMutexOnCompletion(IN PTP_CALLBACK_INSTANCE Instance, IN HANDLE Mutex);
+VOID NTAPI TpCallbackLeaveCriticalSectionOnCompletion(IN PTP_CALLBACK_INSTANCE Instance, IN PRTL_CRITICAL_SECTION CriticalSection);
+VOID NTAPI TpCallbackUnloadDllOnCompletion(IN PTP_CALLBACK_INSTANCE Instance, IN PVOID DllHandle);
+VOID NTAPI TpDisassociateCallback(IN PTP_CALLBACK_INSTANCE Instance);
+
+
+FORCEINLINE
+PLARGE_INTEGER
+GetNtTime(PLARGE_INTEGER Time, PFILETIME FileTime)
+{
+    if (!FileTime) return NULL;
+    Time->LowPart = FileTime->dwLowDateTime;
+    Time->HighPart = FileTime->dwHighDateTime;
+    return Time;
+}
+
+PTP_POOL
+WINAPI
+CreateThreadpool(PVOID Reserved)
+{
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Status = TpAllocPool(&Pool, Reserved);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+    return Pool;
+}
+
+VOID
+WINAPI
+CloseThreadpool(PTP_POOL Pool)
+{
+    TpReleasePool(Pool);
+}
+
+VOID
+WINAPI
+SetThreadpoolThreadMaximum(PTP_POOL Pool, DWORD MaxThreads)
+{
+    TpSetPoolMaxThreads(Pool, MaxThreads);
+}
+
+BOOL
+WINAPI
+SetThreadpoolThreadMinimum(PTP_POOL Pool, DWORD MinThreads)
+{
+    NTSTATUS Status;
+
+    Status = TpSetPoolMinThreads(Pool, MinThreads);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+PTP_CLEANUP_GROUP
+WINAPI
+CreateThreadpoolCleanupGroup(VOID)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    Status = TpAllocCleanupGroup(&CleanupGroup);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+    return CleanupGroup;
+}
+
+VOID
+WINAPI
+CloseThreadpoolCleanupGroup(PTP_CLEANUP_GROUP CleanupGroup)
+{
+    TpReleaseCleanupGroup(CleanupGroup);
+}
+
+VOID
+WINAPI
+CloseThreadpoolCleanupGroupMembers(PTP_CLEANUP_GROUP CleanupGroup, BOOL CancelPendingCallbacks, PVOID CleanupContext)
+{
+    TpReleaseCleanupGroupMembers(CleanupGroup, CancelPendingCallbacks != FALSE, CleanupContext);
+}
+
+PTP_WORK
+WINAPI
+CreateThreadpoolWork(PTP_WORK_CALLBACK Callback, PVOID Context, PTP_CALLBACK_ENVIRON Environment)
+{
+    PTP_WORK Work;
+    NTSTATUS Status;
+
+    Status = TpAllocWork(&Work, Callback, Context, Environment);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+    return Work;
+}
+
+VOID
+WINAPI
+SubmitThreadpoolWork(PTP_WORK Work)
+{
+    TpPostWork(Work);
+}
+
+VOID
+WINAPI
+WaitForThreadpoolWorkCallbacks(PTP_WORK Work, BOOL CancelPendingCallbacks)
+{
+    TpWaitForWork(Work, CancelPendingCallbacks != FALSE);
+}
+
+VOID
+WINAPI
+CloseThreadpoolWork(PTP_WORK Work)
+{
+    TpReleaseWork(Work);
+}
+
+BOOL
+WINAPI
+TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK Callback, PVOID Context, PTP_CALLBACK_ENVIRON Environment)
+{
+    NTSTATUS Status;
+
+    Status = TpSimpleTryPost(Callback, Context, Environment);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+PTP_TIMER
+WINAPI
+CreateThreadpoolTimer(PTP_TIMER_CALLBACK Callback, PVOID Context, PTP_CALLBACK_ENVIRON Environment)
+{
+    PTP_TIMER Timer;
+    NTSTATUS Status;
+
+    Status = TpAllocTimer(&Timer, Callback, Context, Environment);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+    return Timer;
+}
+
+VOID
+WINAPI
+SetThreadpoolTimer(PTP_TIMER Timer, PFILETIME DueTime, DWORD Period, DWORD WindowLength)
+{
+    LARGE_INTEGER Time;
+
+    TpSetTimer(Timer, GetNtTime(&Time, DueTime), Period, WindowLength);
+}
+
+BOOL
+WINAPI
+IsThreadpoolTimerSet(PTP_TIMER Timer)
+{
+    return TpIsTimerSet(Timer);
+}
+
+VOID
+WINAPI
+WaitForThreadpoolTimerCallbacks(PTP_TIMER Timer, BOOL CancelPendingCallbacks)
+{
+    TpWaitForTimer(Timer, CancelPendingCallbacks != FALSE);
+}
+
+VOID
+WINAPI
+CloseThreadpoolTimer(PTP_TIMER Timer)
+{
+    TpReleaseTimer(Timer);
+}
+
+PTP_WAIT
+WINAPI
+CreateThreadpoolWait(PTP_WAIT_CALLBACK Callback, PVOID Context, PTP_CALLBACK_ENVIRON Environment)
+{
+    PTP_WAIT Wait;
+    NTSTATUS Status;
+
+    Status = TpAllocWait(&Wait, Callback, Context, Environment);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+    return Wait;
+}
+
+VOID
+WINAPI
+SetThreadpoolWait(PTP_WAIT Wait, HANDLE Handle, PFILETIME Timeout)
+{
+    LARGE_INTEGER Time;
+
+    TpSetWait(Wait, Handle, GetNtTime(&Time, Timeout));
+}
+
+VOID
+WINAPI
+WaitForThreadpoolWaitCallbacks(PTP_WAIT Wait, BOOL CancelPendingCallbacks)
+{
+    TpWaitForWait(Wait, CancelPendingCallbacks != FALSE);
+}
+
+VOID
+WINAPI
+CloseThreadpoolWait(PTP_WAIT Wait)
+{
+    TpReleaseWait(Wait);
+}
+
+static
+VOID
+NTAPI
+IntIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PVOID Overlapped, PIO_STATUS_BLOCK IoStatusBlock, PTP_IO Io)
+{
+    /* ntdll leaves the first field of the object to us */
+    PTP_WIN32_IO_CALLBACK Callback = *(PTP_WIN32_IO_CALLBACK *)Io;
+
+    Callback(Instance,
+             Context,
+             Overlapped,
+             RtlNtStatusToDosError(IoStatusBlock->Status),
+             IoStatusBlock->Information,
+             Io);
+}
+
+PTP_IO
+WINAPI
+CreateThreadpoolIo(HANDLE File, PTP_WIN32_IO_CALLBACK Callback, PVOID Context, PTP_CALLBACK_ENVIRON Environment)
+{
+    PTP_IO Io;
+    NTSTATUS Status;
+
+    Status = TpAllocIoCompletion(&Io, File, IntIoCallback, Context, Environment);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    /* No I/O can complete before StartThreadpoolIo is called */
+    *(PTP_WIN32_IO_CALLBACK *)Io = Callback;
+    return Io;
+}
+
+VOID
+WINAPI
+StartThreadpoolIo(PTP_IO Io)
+{
+    TpStartAsyncIoOperation(Io);
+}
+
+VOID
+WINAPI
+CancelThreadpoolIo(PTP_IO Io)
+{
+    TpCancelAsyncIoOperation(Io);
+}
+
+VOID
+WINAPI
+WaitForThreadpoolIoCallbacks(PTP_IO Io, BOOL CancelPendingCallbacks)
+{
+    TpWaitForIoCompletion(Io, CancelPendingCallbacks != FALSE);
+}
+
+VOID
+WINAPI
+CloseThreadpoolIo(PTP_IO Io)
+{
+    TpReleaseIoCompletion(Io);
+}
+
+BOOL
+WINAPI
+CallbackMayRunLong(PTP_CALLBACK_INSTANCE Instance)
+{
+    NTSTATUS Status;
+
+    Status = TpCallbackMayRunLong(Instance);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+VOID
+WINAPI
+SetEventWhenCallbackReturns(PTP_CALLBACK_INSTANCE Instance, HANDLE Event)
+{
+    TpCallbackSetEventOnCompletion(Instance, Event);
+}
+
+VOID
+WINAPI
+ReleaseSemaphoreWhenCallbackReturns(PTP_CALLBACK_INSTANCE Instance, HANDLE Semaphore, DWORD ReleaseCount)
+{
+    TpCallbackReleaseSemaphoreOnCompletion(Instance, Semaphore, ReleaseCount);
+}
+
+VOID
+WINAPI
+ReleaseMutexWhenCallbackReturns(PTP_CALLBACK_INSTANCE Instance, HANDLE Mutex)
+{
+    TpCallbackReleaseMutexOnCompletion(Instance, Mutex);
+}
+
+VOID
+WINAPI
+LeaveCriticalSectionWhenCallbackReturns(PTP_CALLBACK_INSTANCE Instance, PCRITICAL_SECTION CriticalSection)
+{
+    TpCallbackLeaveCriticalSectionOnCompletion(Instance, (PRTL_CRITICAL_SECTION)CriticalSection);
+}
+
+VOID
+WINAPI
+FreeLibraryWhenCallbackReturns(PTP_CALLBACK_INSTANCE Instance, HMODULE Module)
+{
+    TpCallbackUnloadDllOnCompletion(Instance, Module);
+}
+
+VOID
+WINAPI
+DisassociateCurrentThreadFromCallback(PTP_CALLBACK_INSTANCE Instance)
+{
+    TpDisassociateCallback(Instance);
+}
@@ -67,6 +67,8 @@ SamrLookupNamesInDomain(IN SAMPR_HANDLE DomainHandle,
 typedef struct _WELL_KNOWN_SID
 {
     LIST_ENTRY ListEntry;
+    LIST_ENTRY SidHashEntry;
+    LIST_ENTRY NameHashEntry;
     PSID Sid;
     UNICODE_STRING AccountName;
     UNICODE_STRING DomainName;
@@ -75,6 +77,11 @@ typedef struct _WELL_KNOWN_SID
 
 
 LIST_ENTRY WellKnownSidListHead;
+
+/* The well-known SIDs, hashed by SID and by account name */
+#define WELL_KNOWN_SID_HASH_SIZE 64
+static LIST_ENTRY WellKnownSidHashTable[WELL_KNOWN_SID_HASH_SIZE];
+static LIST_ENTRY WellKnownNameHashTable[WELL_KNOWN_SID_HASH_SIZE];
 PSID LsapWorldSid = NULL;
 PSID LsapNetworkSid = NULL;
 PSID LsapBatchSid = NULL;
@@ -86,6 +93,35 @@ PSID LsapAdministratorsSid = NULL;
 
 /* FUNCTIONS ***************************************************************/
 
+static
+ULONG
+LsapHashSid(PSID Sid)
+{
+    PUCHAR Bytes = (PUCHAR)Sid;
+    ULONG Length, i, Hash = 0;
+
+    Length = RtlLengthSid(Sid);
+    for (i = 0; i < Length; i++)
+        Hash = Hash * 31 + Bytes[i];
+
+    return Hash % WELL_KNOWN_SID_HASH_SIZE;
+}
+
+
+static
+ULONG
+LsapHashAccountName(PUNICODE_STRING AccountName)
+{
+    ULONG i, Hash = 0;
+
+    /* Names are compared case insensitively */
+    for (i = 0; i < AccountName->Length / sizeof(WCHAR); i++)
+        Hash = Hash * 31 + RtlUpcaseUnicodeChar(AccountName->Buffer[i]);
+
+    return Hash % WELL_KNOWN_SID_HASH_SIZE;
+}
+
+
 BOOLEAN
 LsapCreateSid(PSID_IDENTIFIER_AUTHORITY IdentifierAuthority,
               UCHAR SubAuthorityCount,
@@ -161,6 +197,10 @@ LsapCreateSid(PSID_IDENTIFIER_AUTHORITY IdentifierAuthority,
 
     InsertTailList(&WellKnownSidListHead,
                    &SidEntry->ListEntry);
+    InsertTailList(&WellKnownSidHashTable[LsapHashSid(SidEntry->Sid)],
+                   &SidEntry->SidHashEntry);
+    InsertTailList(&WellKnownNameHashTable[LsapHashAccountName(&SidEntry->AccountName)],
+                   &SidEntry->NameHashEntry);
 
     if (SidPtr != NULL)
         *SidPtr = SidEntry->Sid;
@@ -176,8 +216,14 @@ LsapInitSids(VOID)
     WCHAR szDomainName[80];
     ULONG SubAuthorities[8];
     HINSTANCE hInstance;
+    ULONG i;
 
     InitializeListHead(&WellKnownSidListHead);
+    for (i = 0; i < WELL_KNOWN_SID_HASH_SIZE; i++)
+    {
+        InitializeListHead(&WellKnownSidHashTable[i]);
+        InitializeListHead(&WellKnownNameHashTable[i]);
+    }
 
     hInstance = GetModuleHandleW(L"lsasrv.dll");
 
@@ -688,15 +734,16 @@ LsapInitSids(VOID)
 PWELL_KNOWN_SID
 LsapLookupWellKnownSid(PSID Sid)
 {
-    PLIST_ENTRY ListEntry;
+    PLIST_ENTRY ListHead, ListEntry;
     PWELL_KNOWN_SID Ptr;
 
-    ListEntry = WellKnownSidListHead.Flink;
-    while (ListEntry != &WellKnownSidListHead)
+    ListHead = &WellKnownSidHashTable[LsapHashSid(Sid)];
+    ListEntry = ListHead->Flink;
+    while (ListEntry != ListHead)
     {
         Ptr = CONTAINING_RECORD(ListEntry,
                                 WELL_KNOWN_SID,
-                                ListEntry);
+                                SidHashEntry);
         if (RtlEqualSid(Sid, Ptr->Sid))
         {
             return Ptr;
@@ -712,15 +759,16 @@ LsapLookupWellKnownSid(PSID Sid)
 PWELL_KNOWN_SID
 LsapLookupIsolatedWellKnownName(PUNICODE_STRING AccountName)
 {
-    PLIST_ENTRY ListEntry;
+    PLIST_ENTRY ListHead, ListEntry;
     PWELL_KNOWN_SID Ptr;
 
-    ListEntry = WellKnownSidListHead.Flink;
-    while (ListEntry != &WellKnownSidListHead)
+    ListHead = &WellKnownNameHashTable[LsapHashAccountName(AccountName)];
+    ListEntry = ListHead->Flink;
+    while (ListEntry != ListHead)
     {
         Ptr = CONTAINING_RECORD(ListEntry,
                                 WELL_KNOWN_SID,
-                                ListEntry);
+                                NameHashEntry);
         if (RtlEqualUnicodeString(AccountName, &Ptr->AccountName, TRUE))
         {
             return Ptr;
@@ -737,15 +785,16 @@ PWELL_KNOWN_SID
 LsapLookupFullyQualifiedWellKnownName(PUNICODE_STRING AccountName,
                                       PUNICODE_STRING DomainName)
 {
-    PLIST_ENTRY ListEntry;
+    PLIST_ENTRY ListHead, ListEntry;
     PWELL_KNOWN_SID Ptr;
 
-    ListEntry = WellKnownSidListHead.Flink;
-    while (ListEntry != &WellKnownSidListHead)
+    ListHead = &WellKnownNameHashTable[LsapHashAccountName(AccountName)];
+    ListEntry = ListHead->Flink;
+    while (ListEntry != ListHead)
     {
         Ptr = CONTAINING_RECORD(ListEntry,
                                 WELL_KNOWN_SID,
-                                ListEntry);
+                                NameHashEntry);
         if (RtlEqualUnicodeString(AccountName, &Ptr->AccountName, TRUE) &&
             RtlEqualUnicodeString(DomainName, &Ptr->DomainName, TRUE))
         {
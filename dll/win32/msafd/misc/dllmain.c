@@ -2486,6 +2486,8 @@ WSPIoctl(IN  SOCKET Handle,
                 GUID ConnectExGUID = WSAID_CONNECTEX;
                 GUID DisconnectExGUID = WSAID_DISCONNECTEX;
                 GUID GetAcceptExSockaddrsGUID = WSAID_GETACCEPTEXSOCKADDRS;
+                GUID TransmitFileGUID = WSAID_TRANSMITFILE;
+                GUID TransmitPacketsGUID = WSAID_TRANSMITPACKETS;
 
                 if (IsEqualGUID(&AcceptExGUID, lpvInBuffer))
                 {
@@ -2515,6 +2517,20 @@ WSPIoctl(IN  SOCKET Handle,
                     Errno = NO_ERROR;
                     Ret = NO_ERROR;
                 }
+                else if (IsEqualGUID(&TransmitFileGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPTransmitFile;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
+                else if (IsEqualGUID(&TransmitPacketsGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPTransmitPackets;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
                 else
                 {
                     ERR("Querying unknown extension function: %x\n", ((GUID*)lpvInBuffer)->Data1);
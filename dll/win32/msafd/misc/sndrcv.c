@@ -914,6 +914,303 @@ WSPSendTo(SOCKET Handle,
     return MsafdReturnWithErrno(Status, lpErrno, IOSB->Information, lpNumberOfBytesSent);
 }
 
+/* Chunk size used by TransmitFile/TransmitPackets when the caller has no preference */
+#define MSAFD_TRANSMIT_CHUNK (64 * 1024)
+
+static
+INT
+MsafdTransmitBuffer(SOCKET Handle,
+                    HANDLE SockEvent,
+                    PCHAR Buffer,
+                    DWORD Length,
+                    LPDWORD lpTotalSent)
+{
+    AFD_WSABUF AfdBuffer;
+    AFD_SEND_INFO SendInfo;
+    IO_STATUS_BLOCK IOSB;
+    NTSTATUS Status;
+
+    while (Length > 0)
+    {
+        AfdBuffer.buf = Buffer;
+        AfdBuffer.len = Length;
+
+        /* Always a blocking send, so that AFD can hand the buffer to
+           the transport as it is instead of copying it */
+        SendInfo.BufferArray = &AfdBuffer;
+        SendInfo.BufferCount = 1;
+        SendInfo.TdiFlags = 0;
+        SendInfo.AfdFlags = 0;
+
+        Status = NtDeviceIoControlFile((HANDLE)Handle,
+                                       SockEvent,
+                                       NULL,
+                                       NULL,
+                                       &IOSB,
+                                       IOCTL_AFD_SEND,
+                                       &SendInfo,
+                                       sizeof(SendInfo),
+                                       NULL,
+                                       0);
+        if (Status == STATUS_PENDING)
+        {
+            WaitForSingleObject(SockEvent, INFINITE);
+            Status = IOSB.Status;
+        }
+
+        if (!NT_SUCCESS(Status))
+            return TranslateNtStatusError(Status);
+
+        if (IOSB.Information == 0)
+            return WSAENOBUFS;
+
+        Buffer += IOSB.Information;
+        Length -= (DWORD)IOSB.Information;
+        *lpTotalSent += (DWORD)IOSB.Information;
+    }
+
+    return NO_ERROR;
+}
+
+static
+INT
+MsafdTransmitFileRange(SOCKET Handle,
+                       HANDLE SockEvent,
+                       HANDLE hFile,
+                       LARGE_INTEGER Offset,
+                       DWORD Length,
+                       PCHAR Buffer,
+                       DWORD BufferSize,
+                       LPDWORD lpTotalSent)
+{
+    OVERLAPPED Overlapped;
+    DWORD BytesRead, ToRead;
+    INT Errno;
+
+    for (;;)
+    {
+        /* A zero length means everything up to the end of the file */
+        ToRead = (Length > 0) ? min(Length, BufferSize) : BufferSize;
+
+        BytesRead = 0;
+        if (Offset.QuadPart == -1)
+        {
+            /* Read from the current file position */
+            if (!ReadFile(hFile, Buffer, ToRead, &BytesRead, NULL) &&
+                GetLastError() != ERROR_HANDLE_EOF)
+            {
+                return WSAEINVAL;
+            }
+        }
+        else
+        {
+            RtlZeroMemory(&Overlapped, sizeof(Overlapped));
+            Overlapped.Offset = Offset.LowPart;
+            Overlapped.OffsetHigh = Offset.HighPart;
+
+            if (!ReadFile(hFile, Buffer, ToRead, &BytesRead, &Overlapped))
+            {
+                if (GetLastError() == ERROR_IO_PENDING)
+                {
+                    if (!GetOverlappedResult(hFile, &Overlapped, &BytesRead, TRUE) &&
+                        GetLastError() != ERROR_HANDLE_EOF)
+                    {
+                        return WSAEINVAL;
+                    }
+                }
+                else if (GetLastError() != ERROR_HANDLE_EOF)
+                {
+                    return WSAEINVAL;
+                }
+            }
+
+            Offset.QuadPart += BytesRead;
+        }
+
+        if (BytesRead == 0)
+            break;
+
+        Errno = MsafdTransmitBuffer(Handle, SockEvent, Buffer, BytesRead, lpTotalSent);
+        if (Errno != NO_ERROR)
+            return Errno;
+
+        if (Length > 0)
+        {
+            Length -= BytesRead;
+            if (Length == 0)
+                break;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+BOOL
+WSPAPI
+WSPTransmitPackets(IN SOCKET hSocket,
+                   IN LPTRANSMIT_PACKETS_ELEMENT lpPacketArray,
+                   IN DWORD nElementCount,
+                   IN DWORD nSendSize,
+                   IN OUT LPOVERLAPPED lpOverlapped,
+                   IN DWORD dwFlags)
+{
+    PSOCKET_INFORMATION Socket;
+    HANDLE SockEvent;
+    NTSTATUS Status;
+    PCHAR Buffer = NULL;
+    DWORD BufferSize, TotalSent = 0, i;
+    INT Errno = NO_ERROR;
+
+    Socket = GetSocketStructure(hSocket);
+    if (!Socket)
+    {
+        WSASetLastError(WSAENOTSOCK);
+        return FALSE;
+    }
+
+    if (Socket->SharedData->SocketType != SOCK_STREAM ||
+        Socket->SharedData->State != SocketConnected)
+    {
+        WSASetLastError(WSAENOTCONN);
+        return FALSE;
+    }
+
+    if (nElementCount && !lpPacketArray)
+    {
+        WSASetLastError(WSAEFAULT);
+        return FALSE;
+    }
+
+    Status = NtCreateEvent(&SockEvent, EVENT_ALL_ACCESS,
+                           NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        WSASetLastError(WSAENOBUFS);
+        return FALSE;
+    }
+
+    BufferSize = nSendSize ? nSendSize : MSAFD_TRANSMIT_CHUNK;
+
+    TRACE("Called for %lu elements\n", nElementCount);
+
+    for (i = 0; Errno == NO_ERROR && i < nElementCount; i++)
+    {
+        if (lpPacketArray[i].dwElFlags & TP_ELEMENT_MEMORY)
+        {
+            /* Memory elements go out straight from the caller's buffer */
+            Errno = MsafdTransmitBuffer(hSocket,
+                                        SockEvent,
+                                        lpPacketArray[i].pBuffer,
+                                        lpPacketArray[i].cLength,
+                                        &TotalSent);
+        }
+        else if (lpPacketArray[i].dwElFlags & TP_ELEMENT_FILE)
+        {
+            if (!Buffer)
+            {
+                Buffer = HeapAlloc(GlobalHeap, 0, BufferSize);
+                if (!Buffer)
+                {
+                    Errno = WSAENOBUFS;
+                    break;
+                }
+            }
+
+            Errno = MsafdTransmitFileRange(hSocket,
+                                           SockEvent,
+                                           lpPacketArray[i].hFile,
+                                           lpPacketArray[i].nFileOffset,
+                                           lpPacketArray[i].cLength,
+                                           Buffer,
+                                           BufferSize,
+                                           &TotalSent);
+        }
+    }
+
+    if (Errno == NO_ERROR && (dwFlags & (TP_DISCONNECT | TP_REUSE_SOCKET)))
+    {
+        WSPShutdown(hSocket, SD_SEND, &Errno);
+    }
+
+    if (Buffer)
+        HeapFree(GlobalHeap, 0, Buffer);
+
+    NtClose(SockEvent);
+
+    /* Everything was done synchronously, so just report the result */
+    if (lpOverlapped)
+    {
+        lpOverlapped->Internal = (Errno == NO_ERROR) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+        lpOverlapped->InternalHigh = TotalSent;
+        if (lpOverlapped->hEvent)
+            SetEvent(lpOverlapped->hEvent);
+    }
+
+    if (Errno != NO_ERROR)
+    {
+        WSASetLastError(Errno);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL
+WSPAPI
+WSPTransmitFile(IN SOCKET hSocket,
+                IN HANDLE hFile,
+                IN DWORD nNumberOfBytesToWrite,
+                IN DWORD nNumberOfBytesPerSend,
+                IN OUT LPOVERLAPPED lpOverlapped,
+                IN LPTRANSMIT_FILE_BUFFERS lpTransmitBuffers,
+                IN DWORD dwFlags)
+{
+    TRANSMIT_PACKETS_ELEMENT Elements[3];
+    DWORD Count = 0;
+
+    if (lpTransmitBuffers && lpTransmitBuffers->HeadLength)
+    {
+        Elements[Count].dwElFlags = TP_ELEMENT_MEMORY;
+        Elements[Count].cLength = lpTransmitBuffers->HeadLength;
+        Elements[Count].pBuffer = lpTransmitBuffers->Head;
+        Count++;
+    }
+
+    if (hFile)
+    {
+        Elements[Count].dwElFlags = TP_ELEMENT_FILE;
+        Elements[Count].cLength = nNumberOfBytesToWrite;
+        Elements[Count].hFile = hFile;
+
+        /* Overlapped callers give the offset, otherwise use the file pointer */
+        if (lpOverlapped)
+        {
+            Elements[Count].nFileOffset.LowPart = lpOverlapped->Offset;
+            Elements[Count].nFileOffset.HighPart = lpOverlapped->OffsetHigh;
+        }
+        else
+        {
+            Elements[Count].nFileOffset.QuadPart = -1;
+        }
+        Count++;
+    }
+
+    if (lpTransmitBuffers && lpTransmitBuffers->TailLength)
+    {
+        Elements[Count].dwElFlags = TP_ELEMENT_MEMORY;
+        Elements[Count].cLength = lpTransmitBuffers->TailLength;
+        Elements[Count].pBuffer = lpTransmitBuffers->Tail;
+        Count++;
+    }
+
+    return WSPTransmitPackets(hSocket,
+                              Elements,
+                              Count,
+                              nNumberOfBytesPerSend,
+                              lpOverlapped,
+                              dwFlags);
+}
+
 INT
 WSPAPI
 WSPRecvDisconnect(IN  SOCKET s,
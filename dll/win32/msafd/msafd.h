@@ -469,6 +469,27 @@ WSPGetAcceptExSockaddrs(
     OUT struct sockaddr **RemoteSockaddr,
     OUT LPINT RemoteSockaddrLength);
 
+BOOL
+WSPAPI
+WSPTransmitFile(
+    IN SOCKET hSocket,
+    IN HANDLE hFile,
+    IN DWORD nNumberOfBytesToWrite,
+    IN DWORD nNumberOfBytesPerSend,
+    IN OUT LPOVERLAPPED lpOverlapped,
+    IN LPTRANSMIT_FILE_BUFFERS lpTransmitBuffers,
+    IN DWORD dwFlags);
+
+BOOL
+WSPAPI
+WSPTransmitPackets(
+    IN SOCKET hSocket,
+    IN LPTRANSMIT_PACKETS_ELEMENT lpPacketArray,
+    IN DWORD nElementCount,
+    IN DWORD nSendSize,
+    IN OUT LPOVERLAPPED lpOverlapped,
+    IN DWORD dwFlags);
+
 PSOCKET_INFORMATION GetSocketStructure(
 	SOCKET Handle
 );
@@ -262,6 +262,166 @@ static UINT copy_install_file(MSIPACKAGE *package, MSIFILE *file, LPWSTR source)
     return gle;
 }
 
+/*
+ * Uncompressed files are copied by a few threads, while ACTION_InstallFiles
+ * carries on with the rest of the File table. The queue is drained before
+ * switching to another disk, since the sources may go away with it.
+ */
+#define COPY_QUEUE_THREADS 4
+
+struct copy_job
+{
+    MSIFILE *file;
+    WCHAR *source;
+    UINT error;
+};
+
+struct copy_queue
+{
+    MSIPACKAGE *package;
+    CRITICAL_SECTION cs;
+    HANDLE semaphore;
+    HANDLE threads[COPY_QUEUE_THREADS];
+    UINT thread_count;
+    struct copy_job *jobs;
+    UINT count;
+    UINT size;
+    UINT next;
+    UINT disk_id;
+};
+
+static DWORD WINAPI copy_queue_thread( void *arg )
+{
+    struct copy_queue *queue = arg;
+    struct copy_job job;
+    UINT index, error;
+
+    for (;;)
+    {
+        WaitForSingleObject( queue->semaphore, INFINITE );
+
+        EnterCriticalSection( &queue->cs );
+        if (queue->next == queue->count)
+        {
+            /* woken up by copy_queue_finish */
+            LeaveCriticalSection( &queue->cs );
+            break;
+        }
+        index = queue->next++;
+        job = queue->jobs[index];
+        LeaveCriticalSection( &queue->cs );
+
+        error = copy_install_file( queue->package, job.file, job.source );
+
+        EnterCriticalSection( &queue->cs );
+        queue->jobs[index].error = error;
+        LeaveCriticalSection( &queue->cs );
+    }
+    return 0;
+}
+
+static void copy_queue_init( struct copy_queue *queue, MSIPACKAGE *package )
+{
+    memset( queue, 0, sizeof(*queue) );
+    queue->package = package;
+    InitializeCriticalSection( &queue->cs );
+    queue->semaphore = CreateSemaphoreW( NULL, 0, MAXLONG, NULL );
+}
+
+/* takes ownership of source */
+static UINT copy_queue_add( struct copy_queue *queue, MSIFILE *file, WCHAR *source )
+{
+    struct copy_job *jobs;
+    UINT error;
+
+    if (queue->semaphore && !queue->thread_count)
+    {
+        while (queue->thread_count < COPY_QUEUE_THREADS)
+        {
+            HANDLE thread = CreateThread( NULL, 0, copy_queue_thread, queue, 0, NULL );
+            if (!thread) break;
+            queue->threads[queue->thread_count++] = thread;
+        }
+    }
+
+    if (!queue->thread_count)
+    {
+        /* no threads, copy it right away */
+        error = copy_install_file( queue->package, file, source );
+        if (error != ERROR_SUCCESS)
+            ERR("Failed to copy %s to %s (%u)\n", debugstr_w(source), debugstr_w(file->TargetPath), error);
+        else if (!msi_is_global_assembly( file->Component ))
+            file->state = msifs_installed;
+        msi_free( source );
+        return error;
+    }
+
+    EnterCriticalSection( &queue->cs );
+    if (queue->count == queue->size)
+    {
+        UINT size = queue->size ? queue->size * 2 : 64;
+
+        if (queue->jobs) jobs = msi_realloc( queue->jobs, size * sizeof(*jobs) );
+        else jobs = msi_alloc( size * sizeof(*jobs) );
+        if (!jobs)
+        {
+            LeaveCriticalSection( &queue->cs );
+            msi_free( source );
+            return ERROR_OUTOFMEMORY;
+        }
+        queue->jobs = jobs;
+        queue->size = size;
+    }
+    queue->jobs[queue->count].file = file;
+    queue->jobs[queue->count].source = source;
+    queue->jobs[queue->count].error = ERROR_SUCCESS;
+    queue->count++;
+    queue->disk_id = file->disk_id;
+    LeaveCriticalSection( &queue->cs );
+
+    ReleaseSemaphore( queue->semaphore, 1, NULL );
+    return ERROR_SUCCESS;
+}
+
+/* waits for the queued copies, returns the error of the first failed one */
+static UINT copy_queue_finish( struct copy_queue *queue )
+{
+    UINT i, ret = ERROR_SUCCESS;
+
+    if (queue->thread_count)
+    {
+        ReleaseSemaphore( queue->semaphore, queue->thread_count, NULL );
+        WaitForMultipleObjects( queue->thread_count, queue->threads, TRUE, INFINITE );
+        for (i = 0; i < queue->thread_count; i++) CloseHandle( queue->threads[i] );
+        queue->thread_count = 0;
+    }
+
+    for (i = 0; i < queue->count; i++)
+    {
+        struct copy_job *job = &queue->jobs[i];
+
+        if (job->error != ERROR_SUCCESS)
+        {
+            ERR("Failed to copy %s to %s (%u)\n", debugstr_w(job->source),
+                debugstr_w(job->file->TargetPath), job->error);
+            if (ret == ERROR_SUCCESS) ret = job->error;
+        }
+        else if (!msi_is_global_assembly( job->file->Component ))
+            job->file->state = msifs_installed;
+        msi_free( job->source );
+    }
+    queue->count = queue->next = 0;
+    return ret;
+}
+
+static void copy_queue_destroy( struct copy_queue *queue )
+{
+    copy_queue_finish( queue );
+    msi_free( queue->jobs );
+    if (queue->semaphore) CloseHandle( queue->semaphore );
+    DeleteCriticalSection( &queue->cs );
+}
+
 static UINT msi_create_directory( MSIPACKAGE *package, const WCHAR *dir )
 {
     MSIFOLDER *folder;
@@ -356,9 +516,11 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
     MSIMEDIAINFO *mi;
     UINT rc = ERROR_SUCCESS;
     MSIFILE *file;
+    struct copy_queue queue;
 
     schedule_install_files(package);
     mi = msi_alloc_zero( sizeof(MSIMEDIAINFO) );
+    copy_queue_init( &queue, package );
 
     LIST_FOR_EACH_ENTRY( file, &package->files, MSIFILE, entry )
     {
@@ -366,6 +528,13 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
 
         msi_file_update_ui( package, file, szInstallFiles );
 
+        if (queue.count && file->disk_id != queue.disk_id &&
+            copy_queue_finish( &queue ) != ERROR_SUCCESS)
+        {
+            rc = ERROR_INSTALL_FAILURE;
+            goto done;
+        }
+
         rc = msi_load_media_info( package, file->Sequence, mi );
         if (rc != ERROR_SUCCESS)
         {
@@ -415,16 +584,12 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
             {
                 msi_create_directory(package, file->Component->Directory);
             }
-            rc = copy_install_file(package, file, source);
+            rc = copy_queue_add(&queue, file, source);
             if (rc != ERROR_SUCCESS)
             {
-                ERR("Failed to copy %s to %s (%u)\n", debugstr_w(source), debugstr_w(file->TargetPath), rc);
                 rc = ERROR_INSTALL_FAILURE;
-                msi_free(source);
                 goto done;
             }
-            if (!is_global_assembly) file->state = msifs_installed;
-            msi_free(source);
         }
         else if (!is_global_assembly && file->state != msifs_installed &&
                  !(file->Attributes & msidbFileAttributesPatchAdded))
@@ -434,6 +599,11 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
             goto done;
         }
     }
+    if (copy_queue_finish( &queue ) != ERROR_SUCCESS)
+    {
+        rc = ERROR_INSTALL_FAILURE;
+        goto done;
+    }
     LIST_FOR_EACH_ENTRY( file, &package->files, MSIFILE, entry )
     {
         MSICOMPONENT *comp = file->Component;
@@ -452,6 +622,7 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
     }
 
 done:
+    copy_queue_destroy(&queue);
     msi_free_media_info(mi);
     return rc;
 }
@@ -1346,7 +1517,8 @@ UINT ACTION_RemoveFiles( MSIPACKAGE *package )
     MSIQUERY *view;
     MSICOMPONENT *comp;
     MSIFILE *file;
-    UINT r;
+    MSIFOLDER **folders = NULL;
+    UINT r, i, folder_count = 0, folder_size = 0;
 
     r = MSI_DatabaseOpenViewW(package->db, query, &view);
     if (r == ERROR_SUCCESS)
@@ -1424,8 +1596,35 @@ UINT ACTION_RemoveFiles( MSIPACKAGE *package )
         else
         {
             MSIFOLDER *folder = msi_get_loaded_folder( package, comp->Directory );
-            remove_folder( folder );
+
+            /* many components share a folder, only try to remove it once */
+            for (i = 0; i < folder_count; i++)
+                if (folders[i] == folder) break;
+            if (i < folder_count) continue;
+
+            if (folder_count == folder_size)
+            {
+                MSIFOLDER **tmp;
+                UINT size = folder_size ? folder_size * 2 : 16;
+
+                if (folders) tmp = msi_realloc( folders, size * sizeof(*folders) );
+                else tmp = msi_alloc( size * sizeof(*folders) );
+                if (!tmp)
+                {
+                    remove_folder( folder );
+                    continue;
+                }
+                folders = tmp;
+                folder_size = size;
+            }
+            folders[folder_count++] = folder;
         }
     }
+
+    /* all the files are gone now, remove the folders in one go */
+    for (i = 0; i < folder_count; i++)
+        remove_folder( folders[i] );
+    msi_free( folders );
+
     return ERROR_SUCCESS;
 }
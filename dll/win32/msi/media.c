@@ -163,20 +163,187 @@ static UINT CDECL cabinet_read(INT_PTR hf, void *pv, UINT cb)
     return 0;
 }
 
-static UINT CDECL cabinet_write(INT_PTR hf, void *pv, UINT cb)
+/*
+ * Extracted files are written by a separate thread, so that decompressing
+ * the cabinet and writing the files to disk overlap. cabinet_write() queues
+ * a copy of the data and returns right away; a write error is reported by
+ * the next cabinet_write() and by cabinet_writer_stop().
+ */
+#define CABINET_WRITER_MAX_QUEUED (8 * 1024 * 1024)
+
+struct cabinet_write_op
+{
+    struct list entry;
+    HANDLE handle;
+    BOOL close;         /* set the file time and close the handle */
+    FILETIME time;
+    UINT size;
+    BYTE data[1];
+};
+
+static struct
+{
+    CRITICAL_SECTION cs;
+    struct list ops;
+    HANDLE thread;
+    HANDLE work_event;  /* auto-reset, an op was queued or stop was requested */
+    HANDLE space_event; /* manual-reset, set while the queue is below the limit */
+    HANDLE idle_event;  /* manual-reset, set while no op is pending */
+    UINT queued;
+    UINT pending;
+    DWORD error;
+    BOOL stop;
+} cabinet_writer;
+
+static void cabinet_writer_do_op( struct cabinet_write_op *op )
 {
-    HANDLE handle = (HANDLE)hf;
     DWORD written;
 
-    if (WriteFile(handle, pv, cb, &written, NULL))
-        return written;
+    if (op->close)
+    {
+        if (!SetFileTime( op->handle, &op->time, NULL, &op->time ) && !cabinet_writer.error)
+            cabinet_writer.error = GetLastError();
+        CloseHandle( op->handle );
+    }
+    else if (!cabinet_writer.error &&
+             (!WriteFile( op->handle, op->data, op->size, &written, NULL ) || written != op->size))
+    {
+        cabinet_writer.error = GetLastError();
+        if (!cabinet_writer.error) cabinet_writer.error = ERROR_WRITE_FAULT;
+        WARN("failed to write extracted data (error %u)\n", cabinet_writer.error);
+    }
+}
+
+static DWORD WINAPI cabinet_writer_thread( void *arg )
+{
+    struct cabinet_write_op *op;
+    struct list *entry;
+    BOOL stop;
+
+    do
+    {
+        WaitForSingleObject( cabinet_writer.work_event, INFINITE );
+
+        for (;;)
+        {
+            EnterCriticalSection( &cabinet_writer.cs );
+            stop = cabinet_writer.stop;
+            if (!(entry = list_head( &cabinet_writer.ops )))
+            {
+                LeaveCriticalSection( &cabinet_writer.cs );
+                break;
+            }
+            list_remove( entry );
+            LeaveCriticalSection( &cabinet_writer.cs );
+
+            op = LIST_ENTRY( entry, struct cabinet_write_op, entry );
+            cabinet_writer_do_op( op );
+
+            EnterCriticalSection( &cabinet_writer.cs );
+            cabinet_writer.queued -= op->size;
+            if (cabinet_writer.queued <= CABINET_WRITER_MAX_QUEUED) SetEvent( cabinet_writer.space_event );
+            if (!--cabinet_writer.pending) SetEvent( cabinet_writer.idle_event );
+            LeaveCriticalSection( &cabinet_writer.cs );
+            msi_free( op );
+        }
+    } while (!stop);
 
     return 0;
 }
 
+static BOOL cabinet_writer_start(void)
+{
+    InitializeCriticalSection( &cabinet_writer.cs );
+    list_init( &cabinet_writer.ops );
+    cabinet_writer.queued = cabinet_writer.pending = 0;
+    cabinet_writer.error = ERROR_SUCCESS;
+    cabinet_writer.stop = FALSE;
+    cabinet_writer.work_event = CreateEventW( NULL, FALSE, FALSE, NULL );
+    cabinet_writer.space_event = CreateEventW( NULL, TRUE, TRUE, NULL );
+    cabinet_writer.idle_event = CreateEventW( NULL, TRUE, TRUE, NULL );
+    cabinet_writer.thread = NULL;
+
+    if (cabinet_writer.work_event && cabinet_writer.space_event && cabinet_writer.idle_event)
+        cabinet_writer.thread = CreateThread( NULL, 0, cabinet_writer_thread, NULL, 0, NULL );
+
+    /* without the thread, cabinet_write() writes synchronously */
+    if (!cabinet_writer.thread) WARN("failed to start the writer thread\n");
+    return cabinet_writer.thread != NULL;
+}
+
+/* wait until everything queued so far has been written */
+static void cabinet_writer_flush(void)
+{
+    if (cabinet_writer.thread) WaitForSingleObject( cabinet_writer.idle_event, INFINITE );
+}
+
+static DWORD cabinet_writer_stop(void)
+{
+    if (cabinet_writer.thread)
+    {
+        EnterCriticalSection( &cabinet_writer.cs );
+        cabinet_writer.stop = TRUE;
+        SetEvent( cabinet_writer.work_event );
+        LeaveCriticalSection( &cabinet_writer.cs );
+
+        WaitForSingleObject( cabinet_writer.thread, INFINITE );
+        CloseHandle( cabinet_writer.thread );
+        cabinet_writer.thread = NULL;
+    }
+    if (cabinet_writer.work_event) CloseHandle( cabinet_writer.work_event );
+    if (cabinet_writer.space_event) CloseHandle( cabinet_writer.space_event );
+    if (cabinet_writer.idle_event) CloseHandle( cabinet_writer.idle_event );
+    DeleteCriticalSection( &cabinet_writer.cs );
+
+    return cabinet_writer.error;
+}
+
+static BOOL cabinet_writer_queue( struct cabinet_write_op *op )
+{
+    if (!cabinet_writer.thread)
+    {
+        cabinet_writer_do_op( op );
+        msi_free( op );
+        return !cabinet_writer.error;
+    }
+
+    /* don't let decompression run too far ahead of the disk */
+    WaitForSingleObject( cabinet_writer.space_event, INFINITE );
+
+    EnterCriticalSection( &cabinet_writer.cs );
+    list_add_tail( &cabinet_writer.ops, &op->entry );
+    cabinet_writer.queued += op->size;
+    if (cabinet_writer.queued > CABINET_WRITER_MAX_QUEUED) ResetEvent( cabinet_writer.space_event );
+    if (!cabinet_writer.pending++) ResetEvent( cabinet_writer.idle_event );
+    SetEvent( cabinet_writer.work_event );
+    LeaveCriticalSection( &cabinet_writer.cs );
+    return TRUE;
+}
+
+static UINT CDECL cabinet_write(INT_PTR hf, void *pv, UINT cb)
+{
+    struct cabinet_write_op *op;
+
+    if (cabinet_writer.error)
+        return 0;
+
+    if (!(op = msi_alloc( FIELD_OFFSET( struct cabinet_write_op, data[cb] ) )))
+        return 0;
+
+    op->handle = (HANDLE)hf;
+    op->close = FALSE;
+    op->size = cb;
+    memcpy( op->data, pv, cb );
+
+    return cabinet_writer_queue( op ) ? cb : 0;
+}
+
 static int CDECL cabinet_close(INT_PTR hf)
 {
     HANDLE handle = (HANDLE)hf;
+
+    /* FDI closes extracted files through here when it fails */
+    cabinet_writer_flush();
     return CloseHandle(handle) ? 0 : -1;
 }
 
@@ -500,6 +667,14 @@ static INT_PTR cabinet_copy_file(FDINOTIFICATIONTYPE fdint,
 done:
     msi_free(path);
 
+    if (handle && handle != INVALID_HANDLE_VALUE && pfdin->cb)
+    {
+        /* allocate the whole file up front, it's about to be written sequentially */
+        if (SetFilePointer( handle, pfdin->cb, NULL, FILE_BEGIN ) != INVALID_SET_FILE_POINTER)
+            SetEndOfFile( handle );
+        SetFilePointer( handle, 0, NULL, FILE_BEGIN );
+    }
+
     return (INT_PTR)handle;
 }
 
@@ -507,6 +682,7 @@ static INT_PTR cabinet_close_file_info(FDINOTIFICATIONTYPE fdint,
                                        PFDINOTIFICATION pfdin)
 {
     MSICABDATA *data = pfdin->pv;
+    struct cabinet_write_op *op;
     FILETIME ft;
     FILETIME ftLocal;
     HANDLE handle = (HANDLE)pfdin->hf;
@@ -517,10 +693,16 @@ static INT_PTR cabinet_close_file_info(FDINOTIFICATIONTYPE fdint,
         return -1;
     if (!LocalFileTimeToFileTime(&ft, &ftLocal))
         return -1;
-    if (!SetFileTime(handle, &ftLocal, 0, &ftLocal))
-        return -1;
 
-    CloseHandle(handle);
+    /* the file is closed once its data has been written */
+    if (!(op = msi_alloc( sizeof(*op) )))
+        return -1;
+    op->handle = handle;
+    op->close = TRUE;
+    op->time = ftLocal;
+    op->size = 0;
+    if (!cabinet_writer_queue( op ))
+        return -1;
 
     data->cb(data->package, data->curfile, MSICABEXTRACT_FILEEXTRACTED, NULL, NULL,
              data->user);
@@ -602,9 +784,15 @@ static BOOL extract_cabinet( MSIPACKAGE* package, MSIMEDIAINFO *mi, LPVOID data
     if (!cab_path)
         goto done;
 
+    cabinet_writer_start();
     ret = FDICopy( hfdi, cabinet, cab_path, 0, cabinet_notify, NULL, data );
     if (!ret)
         ERR("FDICopy failed\n");
+    if (cabinet_writer_stop() && ret)
+    {
+        ERR("failed to write extracted files\n");
+        ret = FALSE;
+    }
 
 done:
     FDIDestroy( hfdi );
@@ -637,8 +825,14 @@ static BOOL extract_cabinet_stream( MSIPACKAGE *package, MSIMEDIAINFO *mi, LPVOI
     package_disk.package = package;
     package_disk.id      = mi->disk_id;
 
+    cabinet_writer_start();
     ret = FDICopy( hfdi, filename, NULL, 0, cabinet_notify_stream, NULL, data );
     if (!ret) ERR("FDICopy failed\n");
+    if (cabinet_writer_stop() && ret)
+    {
+        ERR("failed to write extracted files\n");
+        ret = FALSE;
+    }
 
     FDIDestroy( hfdi );
     if (ret) mi->is_extracted = TRUE;
@@ -1974,6 +1974,9 @@ static HRESULT WINAPI domdoc_getElementsByTagName(
 
     if (!tagName || !resultList) return E_INVALIDARG;
 
+    if (*tagName && !strchrW(tagName, '/'))
+        return create_tagname_selection((xmlNodePtr)get_doc(This), tagName, resultList);
+
     XPath = This->properties->XPath;
     This->properties->XPath = TRUE;
     query = tagName_to_XPath(tagName);
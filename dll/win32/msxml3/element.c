@@ -1508,6 +1508,9 @@ static HRESULT WINAPI domelem_getElementsByTagName(
 
     if (!tagName || !resultList) return E_INVALIDARG;
 
+    if (*tagName && !strchrW(tagName, '/'))
+        return create_tagname_selection(get_element(This), tagName, resultList);
+
     XPath = is_xpathmode(get_element(This)->doc);
     set_xpathmode(get_element(This)->doc, TRUE);
     query = tagName_to_XPath(tagName);
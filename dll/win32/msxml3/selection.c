@@ -765,6 +765,18 @@ static void query_serror(void* ctx, xmlErrorPtr err)
     LIBXML2_CALLBACK_SERROR(domselection_create, err);
 }
 
+static void init_selection(domselection *This, xmlNodePtr node)
+{
+    This->IXMLDOMSelection_iface.lpVtbl = &domselection_vtbl;
+    This->ref = 1;
+    This->resultPos = 0;
+    This->node = node;
+    This->result = NULL;
+    This->enumvariant = NULL;
+    init_dispex(&This->dispex, (IUnknown*)&This->IXMLDOMSelection_iface, &domselection_dispex);
+    xmldoc_add_ref(This->node->doc);
+}
+
 HRESULT create_selection(xmlNodePtr node, xmlChar* query, IXMLDOMNodeList **out)
 {
     domselection *This = heap_alloc(sizeof(domselection));
@@ -781,13 +793,7 @@ HRESULT create_selection(xmlNodePtr node, xmlChar* query, IXMLDOMNodeList **out)
         return E_OUTOFMEMORY;
     }
 
-    This->IXMLDOMSelection_iface.lpVtbl = &domselection_vtbl;
-    This->ref = 1;
-    This->resultPos = 0;
-    This->node = node;
-    This->enumvariant = NULL;
-    init_dispex(&This->dispex, (IUnknown*)&This->IXMLDOMSelection_iface, &domselection_dispex);
-    xmldoc_add_ref(This->node->doc);
+    init_selection(This, node);
 
     ctxt->error = query_serror;
     ctxt->node = node;
@@ -837,4 +843,62 @@ cleanup:
     return hr;
 }
 
+/*
+ * Same result as create_selection() with the query tagName_to_XPath() builds
+ * for a tag name without any '/', collected straight off the descendant axis
+ * instead of having XPath evaluate a local-name() predicate on every node.
+ */
+HRESULT create_tagname_selection(xmlNodePtr node, const WCHAR *tagName, IXMLDOMNodeList **out)
+{
+    static const WCHAR starW[] = {'*',0};
+    domselection *This;
+    xmlXPathContextPtr ctxt;
+    xmlXPathParserContextPtr pctxt;
+    xmlNodePtr cur;
+    xmlChar *name = NULL;
+    HRESULT hr = E_OUTOFMEMORY;
+
+    TRACE("(%p, %s, %p)\n", node, debugstr_w(tagName), out);
+
+    *out = NULL;
+
+    /* '*' stands for any element */
+    if (strcmpW(tagName, starW) && !(name = xmlchar_from_wchar(tagName)))
+        return E_OUTOFMEMORY;
+
+    if (!(This = heap_alloc(sizeof(domselection))))
+    {
+        heap_free(name);
+        return E_OUTOFMEMORY;
+    }
+    init_selection(This, node);
+
+    ctxt = xmlXPathNewContext(node->doc);
+    pctxt = ctxt ? xmlXPathNewParserContext(BAD_CAST "", ctxt) : NULL;
+    if (!pctxt || !(This->result = xmlXPathNewNodeSet(NULL)))
+        goto cleanup;
+    ctxt->node = node;
+
+    for (cur = xmlXPathNextDescendant(pctxt, NULL); cur; cur = xmlXPathNextDescendant(pctxt, cur))
+    {
+        if (cur->type != XML_ELEMENT_NODE) continue;
+        if (name && !xmlStrEqual(cur->name, name)) continue;
+
+        if (xmlXPathNodeSetAddUnique(This->result->nodesetval, cur) < 0)
+            goto cleanup;
+    }
+
+    *out = (IXMLDOMNodeList*)&This->IXMLDOMSelection_iface;
+    hr = S_OK;
+    TRACE("found %d matches\n", xmlXPathNodeSetGetLength(This->result->nodesetval));
+
+cleanup:
+    if (FAILED(hr))
+        IXMLDOMSelection_Release( &This->IXMLDOMSelection_iface );
+    if (pctxt) xmlXPathFreeParserContext(pctxt);
+    xmlXPathFreeContext(ctxt);
+    heap_free(name);
+    return hr;
+}
+
 #endif
@@ -19,6 +19,12 @@ RtlpInitializeKeyedEvent(VOID);
 VOID
 RtlpCloseKeyedEvent(VOID);
 
+VOID
+RtlpInitializeAddressWaitTable(VOID);
+
+VOID
+RtlpInitializeThreadPool(VOID);
+
 BOOL
 WINAPI
 DllMain(HANDLE hDll,
@@ -29,6 +35,8 @@ DllMain(HANDLE hDll,
     {
         LdrDisableThreadCalloutsForDll(hDll);
         RtlpInitializeKeyedEvent();
+        RtlpInitializeAddressWaitTable();
+        RtlpInitializeThreadPool();
     }
     else if (dwReason == DLL_PROCESS_DETACH)
     {
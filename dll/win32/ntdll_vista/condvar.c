@@ -39,7 +39,7 @@ typedef struct _COND_VAR_WAIT_ENTRY
 
 /* GLOBALS *******************************************************************/
 
-static HANDLE CondVarKeyedEventHandle = NULL;
+HANDLE RtlpKeyedEventHandle = NULL;
 
 /* INTERNAL FUNCTIONS ********************************************************/
 
@@ -268,7 +268,7 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
     LARGE_INTEGER Timeout;
     PCOND_VAR_WAIT_ENTRY RemoveOnUnlockEntry;
 
-    ASSERT(CondVarKeyedEventHandle != NULL);
+    ASSERT(RtlpKeyedEventHandle != NULL);
 
     if (HeadEntry == NULL)
     {
@@ -304,7 +304,7 @@ InternalWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
 
         /* Wake the thread associated with this event. We will
            immediately return if we failed (zero timeout). */
-        Status = NtReleaseKeyedEvent(CondVarKeyedEventHandle,
+        Status = NtReleaseKeyedEvent(RtlpKeyedEventHandle,
                                      &Entry->WaitKey,
                                      FALSE,
                                      &Timeout);
@@ -377,7 +377,7 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
     COND_VAR_WAIT_ENTRY OwnEntry;
     NTSTATUS Status;
 
-    ASSERT(CondVarKeyedEventHandle != NULL);
+    ASSERT(RtlpKeyedEventHandle != NULL);
     ASSERT((CriticalSection == NULL) != (SRWLock == NULL));
 
     RtlZeroMemory(&OwnEntry, sizeof(OwnEntry));
@@ -405,7 +405,7 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
     }
 
     /* Now sleep using the caller provided timeout. */
-    Status = NtWaitForKeyedEvent(CondVarKeyedEventHandle,
+    Status = NtWaitForKeyedEvent(RtlpKeyedEventHandle,
                                  &OwnEntry.WaitKey,
                                  FALSE,
                                  (PLARGE_INTEGER)TimeOut);
@@ -458,16 +458,16 @@ InternalSleep(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
 VOID
 RtlpInitializeKeyedEvent(VOID)
 {
-    ASSERT(CondVarKeyedEventHandle == NULL);
-    NtCreateKeyedEvent(&CondVarKeyedEventHandle, EVENT_ALL_ACCESS, NULL, 0);
+    ASSERT(RtlpKeyedEventHandle == NULL);
+    NtCreateKeyedEvent(&RtlpKeyedEventHandle, EVENT_ALL_ACCESS, NULL, 0);
 }
 
 VOID
 RtlpCloseKeyedEvent(VOID)
 {
-    ASSERT(CondVarKeyedEventHandle != NULL);
-    NtClose(CondVarKeyedEventHandle);
-    CondVarKeyedEventHandle = NULL;
+    ASSERT(RtlpKeyedEventHandle != NULL);
+    NtClose(RtlpKeyedEventHandle);
+    RtlpKeyedEventHandle = NULL;
 }
 
 /* EXPORTED FUNCTIONS ********************************************************/
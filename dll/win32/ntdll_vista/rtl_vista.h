@@ -54,4 +54,34 @@
 #define InterlockedBitTestAndSet64 _interlockedbittestandset64
 #endif
 
+/* Shared by the condition variables and the address waits */
+extern HANDLE RtlpKeyedEventHandle;
+
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(IN volatile VOID *Address,
+                 IN PVOID CompareAddress,
+                 IN SIZE_T AddressSize,
+                 IN PLARGE_INTEGER Timeout OPTIONAL);
+
+VOID
+NTAPI
+RtlWakeAddressSingle(IN PVOID Address);
+
+VOID
+NTAPI
+RtlWakeAddressAll(IN PVOID Address);
+
+typedef VOID
+(NTAPI *PTP_IO_CALLBACK)(
+    IN PTP_CALLBACK_INSTANCE Instance,
+    IN PVOID Context,
+    IN PVOID ApcContext,
+    IN PIO_STATUS_BLOCK IoStatusBlock,
+    IN PTP_IO Io);
+
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN PTP_CALLBACK_INSTANCE Instance);
+
 #endif /* RTL_H */
@@ -44,6 +44,9 @@
                              RTL_SRWLOCK_SHARED | RTL_SRWLOCK_CONTENTION_LOCK)
 #define RTL_SRWLOCK_BITS    4
 
+/* How long a waiter spins before it goes to sleep */
+#define RTL_SRWLOCK_SPIN_COUNT  1024
+
 typedef struct _RTLP_SRWLOCK_SHARED_WAKE
 {
     LONG Wake;
@@ -78,6 +81,45 @@ typedef struct _RTLP_SRWLOCK_WAITBLOCK
 } volatile RTLP_SRWLOCK_WAITBLOCK, *PRTLP_SRWLOCK_WAITBLOCK;
 
 
+static VOID
+NTAPI
+RtlpWaitForSRWLockWake(IN volatile LONG *Wake)
+{
+    LONG NoWake = 0;
+    ULONG SpinCount;
+
+    /* Spin for a while first, the lock is usually not held for long.
+       There's no point in that when nobody else can run to release it. */
+    SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ? RTL_SRWLOCK_SPIN_COUNT : 0;
+
+    while (*Wake == 0)
+    {
+        if (SpinCount != 0)
+        {
+            SpinCount--;
+            YieldProcessor();
+            continue;
+        }
+
+        /* Then sleep until the releaser hands the lock over to us */
+        RtlWaitOnAddress(Wake, &NoWake, sizeof(LONG), NULL);
+    }
+}
+
+
+static VOID
+NTAPI
+RtlpWakeSRWLockWaiter(IN volatile LONG *Wake)
+{
+    /* The waiter may be gone as soon as it sees Wake set, but waking
+       an address nobody waits on anymore is harmless */
+    (void)InterlockedOr((PLONG)Wake,
+                        TRUE);
+
+    RtlWakeAddressSingle((PVOID)Wake);
+}
+
+
 static VOID
 NTAPI
 RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
@@ -125,8 +167,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
 
     if (FirstWaitBlock->Exclusive)
     {
-        (void)InterlockedOr(&FirstWaitBlock->Wake,
-                            TRUE);
+        RtlpWakeSRWLockWaiter(&FirstWaitBlock->Wake);
     }
     else
     {
@@ -139,8 +180,7 @@ RtlpReleaseWaitBlockLockExclusive(IN OUT PRTL_SRWLOCK SRWLock,
         {
             NextWake = WakeChain->Next;
 
-            (void)InterlockedOr((PLONG)&WakeChain->Wake,
-                                TRUE);
+            RtlpWakeSRWLockWaiter(&WakeChain->Wake);
 
             WakeChain = NextWake;
         } while (WakeChain != NULL);
@@ -178,8 +218,7 @@ RtlpReleaseWaitBlockLockLastShared(IN OUT PRTL_SRWLOCK SRWLock,
 
     (void)InterlockedExchangePointer(&SRWLock->Ptr, (PVOID)NewValue);
 
-    (void)InterlockedOr(&FirstWaitBlock->Wake,
-                        TRUE);
+    RtlpWakeSRWLockWaiter(&FirstWaitBlock->Wake);
 }
 
 
@@ -230,33 +269,11 @@ NTAPI
 RtlpAcquireSRWLockExclusiveWait(IN OUT PRTL_SRWLOCK SRWLock,
                                 IN PRTLP_SRWLOCK_WAITBLOCK WaitBlock)
 {
-    LONG_PTR CurrentValue;
-
-    while (1)
-    {
-        CurrentValue = *(volatile LONG_PTR *)&SRWLock->Ptr;
-        if (!(CurrentValue & RTL_SRWLOCK_SHARED))
-        {
-            if (CurrentValue & RTL_SRWLOCK_CONTENDED)
-            {
-                if (WaitBlock->Wake != 0)
-                {
-                    /* Our wait block became the first one
-                       in the chain, we own the lock now! */
-                    break;
-                }
-            }
-            else
-            {
-                /* The last wait block was removed and/or we're
-                   finally a simple exclusive lock. This means we
-                   don't need to wait anymore, we acquired the lock! */
-                break;
-            }
-        }
-
-        YieldProcessor();
-    }
+    /* Our wait block became the first one in the chain and was removed
+       when Wake is set, we own the lock then. Don't leave earlier when
+       the lock value already says so, the releaser is still going to
+       set Wake in our wait block. */
+    RtlpWaitForSRWLockWake(&WaitBlock->Wake);
 }
 
 
@@ -266,47 +283,9 @@ RtlpAcquireSRWLockSharedWait(IN OUT PRTL_SRWLOCK SRWLock,
                              IN OUT PRTLP_SRWLOCK_WAITBLOCK FirstWait  OPTIONAL,
                              IN OUT PRTLP_SRWLOCK_SHARED_WAKE WakeChain)
 {
-    if (FirstWait != NULL)
-    {
-        while (WakeChain->Wake == 0)
-        {
-            YieldProcessor();
-        }
-    }
-    else
-    {
-        LONG_PTR CurrentValue;
-
-        while (1)
-        {
-            CurrentValue = *(volatile LONG_PTR *)&SRWLock->Ptr;
-            if (CurrentValue & RTL_SRWLOCK_SHARED)
-            {
-                /* The RTL_SRWLOCK_OWNED bit always needs to be set when
-                   RTL_SRWLOCK_SHARED is set! */
-                ASSERT(CurrentValue & RTL_SRWLOCK_OWNED);
-
-                if (CurrentValue & RTL_SRWLOCK_CONTENDED)
-                {
-                    if (WakeChain->Wake != 0)
-                    {
-                        /* Our wait block became the first one
-                           in the chain, we own the lock now! */
-                        break;
-                    }
-                }
-                else
-                {
-                    /* The last wait block was removed and/or we're
-                       finally a simple shared lock. This means we
-                       don't need to wait anymore, we acquired the lock! */
-                    break;
-                }
-            }
-
-            YieldProcessor();
-        }
-    }
+    /* Whether we set up the wait block or joined it, the releaser wakes
+       every shared waiter in its chain once the lock is ours. */
+    RtlpWaitForSRWLockWake(&WakeChain->Wake);
 }
 
 
@@ -0,0 +1,1479 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Thread Pool Routines
+ */
+
+/* NOTE: Every pool has its own I/O completion port. Posted work, expired
+   timers and satisfied waits are queued to it as completion packets keyed
+   by their object, and the completions of the files bound to a TP_IO
+   arrive there directly, so worker threads only ever wait on the port.
+   The port also keeps the number of running workers at the number of
+   processors, whatever the number of threads.
+
+   Workers are added when a callback is queued and no worker is idle, up
+   to the number of processors. Beyond that, a thread is added to a pool
+   when it has callbacks queued, no idle worker, and has not completed any
+   callback since the last check, which means its workers are blocked.
+   Workers that stay idle for a while leave, down to the pool minimum.
+
+   Timers are kept in a single list sorted by due time and served by one
+   timer thread, which also does the checks above. Waits are served by
+   waiter threads, each of which waits on up to TP_WAITS_PER_WAITER
+   handles at once. */
+
+/* INCLUDES ******************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* INTERNAL TYPES ************************************************************/
+
+#define TP_DEFAULT_MAX_THREADS       500
+
+/* Relative, how long idle workers and waiter threads stay around */
+#define TP_WORKER_IDLE_TIMEOUT       (-20LL * 1000 * 10000)
+#define TP_WAITER_IDLE_TIMEOUT       (-20LL * 1000 * 10000)
+
+/* How often pools with queued callbacks are checked for progress */
+#define TP_STARVATION_INTERVAL       (500LL * 10000)
+
+/* The first handle of a waiter thread is its update event */
+#define TP_WAITS_PER_WAITER          (MAXIMUM_WAIT_OBJECTS - 1)
+
+typedef enum _TP_OBJECT_TYPE
+{
+    TpObjectWork,
+    TpObjectSimple,
+    TpObjectTimer,
+    TpObjectWait,
+    TpObjectIo
+} TP_OBJECT_TYPE;
+
+struct _TP_POOL
+{
+    /* The owner and every object of the pool */
+    LONG RefCount;
+    HANDLE CompletionPort;
+    LIST_ENTRY ListEntry;
+    RTL_CRITICAL_SECTION Lock;
+    /* Protected by Lock */
+    LONG MinThreads;
+    LONG MaxThreads;
+    LONG Threads;
+    BOOLEAN Closing;
+    volatile LONG IdleThreads;
+    volatile LONG QueuedCallbacks;
+    volatile LONG CompletedCallbacks;
+    /* CompletedCallbacks as of the last starvation check */
+    LONG LastCompletedCallbacks;
+};
+
+struct _TP_CLEANUP_GROUP
+{
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY MemberListHead;
+};
+
+typedef struct _TP_WAITER
+{
+    LIST_ENTRY ListEntry;
+    HANDLE UpdateEvent;
+    ULONG Count;
+    struct _TP_OBJECT *Waits[TP_WAITS_PER_WAITER];
+} TP_WAITER, *PTP_WAITER;
+
+typedef struct _TP_OBJECT
+{
+    /* Left to kernel32, which keeps the Win32 I/O callback here */
+    PVOID Reserved;
+    TP_OBJECT_TYPE Type;
+    volatile LONG RefCount;
+    PTP_POOL Pool;
+    PVOID Callback;
+    PVOID Context;
+    PTP_CLEANUP_GROUP CleanupGroup;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CleanupGroupCancelCallback;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PVOID RaceDll;
+    BOOLEAN LongFunction;
+    LIST_ENTRY GroupEntry;
+    volatile LONG Released;
+    /* Callbacks queued or running, and asynchronous I/O started */
+    volatile LONG Outstanding;
+    volatile LONG CancelPending;
+    union
+    {
+        struct
+        {
+            LIST_ENTRY ListEntry;
+            LONGLONG DueTime;
+            LONGLONG Period;
+            LONGLONG WindowLength;
+            BOOLEAN Set;
+        } Timer;
+        struct
+        {
+            PTP_WAITER Waiter;
+            ULONG Index;
+            HANDLE Handle;
+            LONGLONG Timeout;
+        } Wait;
+    } u;
+} TP_OBJECT, *PTP_OBJECT;
+
+struct _TP_CALLBACK_INSTANCE
+{
+    PTP_OBJECT Object;
+    BOOLEAN Associated;
+    BOOLEAN MayRunLong;
+    HANDLE Event;
+    HANDLE Semaphore;
+    LONG SemaphoreReleaseCount;
+    HANDLE Mutex;
+    PRTL_CRITICAL_SECTION CriticalSection;
+    PVOID DllHandle;
+};
+
+/* GLOBALS *******************************************************************/
+
+static RTL_CRITICAL_SECTION TppPoolListLock;
+static LIST_ENTRY TppPoolListHead;
+static PTP_POOL TppDefaultPool;
+
+static RTL_CRITICAL_SECTION TppTimerLock;
+static LIST_ENTRY TppTimerListHead;
+static HANDLE TppTimerEvent;
+static volatile LONG TppMonitorActive;
+
+static RTL_CRITICAL_SECTION TppWaitLock;
+static LIST_ENTRY TppWaiterListHead;
+
+/* INTERNAL FUNCTIONS ********************************************************/
+
+static
+NTSTATUS
+TppCreateThread(IN PTHREAD_START_ROUTINE StartAddress,
+                IN PVOID Parameter)
+{
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+
+    Status = RtlCreateUserThread(NtCurrentProcess(),
+                                 NULL,
+                                 FALSE,
+                                 0,
+                                 0,
+                                 0,
+                                 StartAddress,
+                                 Parameter,
+                                 &ThreadHandle,
+                                 NULL);
+    if (NT_SUCCESS(Status))
+    {
+        NtClose(ThreadHandle);
+    }
+
+    return Status;
+}
+
+static
+VOID
+TppFreePool(IN PTP_POOL Pool)
+{
+    RtlEnterCriticalSection(&TppPoolListLock);
+    RemoveEntryList(&Pool->ListEntry);
+    RtlLeaveCriticalSection(&TppPoolListLock);
+
+    NtClose(Pool->CompletionPort);
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static
+VOID
+TppReleasePool(IN PTP_POOL Pool)
+{
+    BOOLEAN Free;
+    LONG i;
+
+    if (InterlockedDecrement(&Pool->RefCount) != 0) return;
+
+    /* Tell the workers to leave. The last one frees the pool; holding the
+       lock keeps them from doing so before we are done. */
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->Closing = TRUE;
+    for (i = 0; i < Pool->Threads; i++)
+    {
+        NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0);
+    }
+    Free = (Pool->Threads == 0);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (Free) TppFreePool(Pool);
+}
+
+/* Returns TRUE when the calling worker is to leave the pool */
+static
+BOOLEAN
+TppWorkerLeave(IN PTP_POOL Pool,
+               IN BOOLEAN Idle)
+{
+    BOOLEAN Free;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    if (Idle && !Pool->Closing && Pool->Threads <= Pool->MinThreads)
+    {
+        RtlLeaveCriticalSection(&Pool->Lock);
+        return FALSE;
+    }
+
+    Pool->Threads--;
+    Free = (Pool->Closing && Pool->Threads == 0);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (Free) TppFreePool(Pool);
+    return TRUE;
+}
+
+static
+VOID
+TppCallbackDone(IN PTP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->Outstanding) == 0)
+    {
+        RtlWakeAddressAll((PVOID)&Object->Outstanding);
+    }
+}
+
+static
+VOID
+TppFreeObject(IN PTP_OBJECT Object)
+{
+    TP_CALLBACK_INSTANCE Instance;
+
+    if (Object->CleanupGroup)
+    {
+        RtlEnterCriticalSection(&Object->CleanupGroup->Lock);
+        RemoveEntryList(&Object->GroupEntry);
+        RtlLeaveCriticalSection(&Object->CleanupGroup->Lock);
+    }
+
+    if (Object->FinalizationCallback)
+    {
+        RtlZeroMemory(&Instance, sizeof(Instance));
+        Object->FinalizationCallback(&Instance, Object->Context);
+    }
+
+    if (Object->RaceDll) LdrUnloadDll(Object->RaceDll);
+
+    TppReleasePool(Object->Pool);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+}
+
+static
+VOID
+TppReleaseObject(IN PTP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->RefCount) == 0)
+    {
+        TppFreeObject(Object);
+    }
+}
+
+static
+BOOLEAN
+TppTryReferenceObject(IN PTP_OBJECT Object)
+{
+    LONG RefCount;
+
+    do
+    {
+        RefCount = Object->RefCount;
+        if (RefCount == 0) return FALSE;
+    } while (InterlockedCompareExchange(&Object->RefCount, RefCount + 1, RefCount) != RefCount);
+
+    return TRUE;
+}
+
+/* Drops the reference of the owner, once */
+static
+VOID
+TppReleaseOwner(IN PTP_OBJECT Object)
+{
+    if (InterlockedExchange(&Object->Released, TRUE)) return;
+    TppReleaseObject(Object);
+}
+
+static
+VOID
+TppCallbackCompleted(IN PTP_CALLBACK_INSTANCE Instance)
+{
+    if (Instance->CriticalSection) RtlLeaveCriticalSection(Instance->CriticalSection);
+    if (Instance->Mutex) NtReleaseMutant(Instance->Mutex, NULL);
+    if (Instance->Semaphore) NtReleaseSemaphore(Instance->Semaphore, Instance->SemaphoreReleaseCount, NULL);
+    if (Instance->Event) NtSetEvent(Instance->Event, NULL);
+
+    if (Instance->Associated)
+    {
+        Instance->Associated = FALSE;
+        TppCallbackDone(Instance->Object);
+    }
+
+    if (Instance->DllHandle) LdrUnloadDll(Instance->DllHandle);
+}
+
+static
+VOID
+TppRunCallback(IN PTP_POOL Pool,
+               IN PTP_OBJECT Object,
+               IN PVOID ApcContext,
+               IN PIO_STATUS_BLOCK IoStatusBlock)
+{
+    TP_CALLBACK_INSTANCE Instance;
+
+    /* I/O completions are queued by the kernel, not by us */
+    if (Object->Type != TpObjectIo) InterlockedDecrement(&Pool->QueuedCallbacks);
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    Instance.Associated = TRUE;
+
+    if (!Object->CancelPending)
+    {
+        if (Object->LongFunction) TpCallbackMayRunLong(&Instance);
+
+        switch (Object->Type)
+        {
+            case TpObjectWork:
+                ((PTP_WORK_CALLBACK)Object->Callback)(&Instance, Object->Context, (PTP_WORK)Object);
+                break;
+
+            case TpObjectSimple:
+                ((PTP_SIMPLE_CALLBACK)Object->Callback)(&Instance, Object->Context);
+                break;
+
+            case TpObjectTimer:
+                ((PTP_TIMER_CALLBACK)Object->Callback)(&Instance, Object->Context, (PTP_TIMER)Object);
+                break;
+
+            case TpObjectWait:
+                ((PTP_WAIT_CALLBACK)Object->Callback)(&Instance,
+                                                      Object->Context,
+                                                      (PTP_WAIT)Object,
+                                                      (TP_WAIT_RESULT)IoStatusBlock->Information);
+                break;
+
+            case TpObjectIo:
+                ((PTP_IO_CALLBACK)Object->Callback)(&Instance,
+                                                    Object->Context,
+                                                    ApcContext,
+                                                    IoStatusBlock,
+                                                    (PTP_IO)Object);
+                break;
+        }
+    }
+
+    TppCallbackCompleted(&Instance);
+    InterlockedIncrement(&Pool->CompletedCallbacks);
+
+    /* The reference taken when the callback was queued */
+    TppReleaseObject(Object);
+}
+
+static
+ULONG
+NTAPI
+TppWorkerThread(IN PVOID Parameter)
+{
+    PTP_POOL Pool = Parameter;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Timeout;
+    PVOID Key, ApcContext;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        Timeout.QuadPart = TP_WORKER_IDLE_TIMEOUT;
+
+        InterlockedIncrement(&Pool->IdleThreads);
+        Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                      &Key,
+                                      &ApcContext,
+                                      &IoStatusBlock,
+                                      &Timeout);
+        InterlockedDecrement(&Pool->IdleThreads);
+
+        if (Status == STATUS_TIMEOUT)
+        {
+            if (TppWorkerLeave(Pool, TRUE)) break;
+            continue;
+        }
+
+        if (!NT_SUCCESS(Status) || Key == NULL)
+        {
+            /* The pool is going away */
+            TppWorkerLeave(Pool, FALSE);
+            break;
+        }
+
+        TppRunCallback(Pool, Key, ApcContext, &IoStatusBlock);
+    }
+
+    RtlExitUserThread(STATUS_SUCCESS);
+    return 0;
+}
+
+/* Force ignores the soft limit of one worker per processor */
+static
+BOOLEAN
+TppAddWorker(IN PTP_POOL Pool,
+             IN BOOLEAN Force)
+{
+    LONG Limit;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Limit = Pool->MaxThreads;
+    if (!Force)
+    {
+        Limit = min(Limit, max(Pool->MinThreads, (LONG)NtCurrentPeb()->NumberOfProcessors));
+    }
+
+    if (Pool->Closing || Pool->Threads >= Limit)
+    {
+        RtlLeaveCriticalSection(&Pool->Lock);
+        return FALSE;
+    }
+
+    Pool->Threads++;
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (!NT_SUCCESS(TppCreateThread(TppWorkerThread, Pool)))
+    {
+        TppWorkerLeave(Pool, FALSE);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+TppQueueObject(IN PTP_OBJECT Object,
+               IN ULONG Information)
+{
+    PTP_POOL Pool = Object->Pool;
+    NTSTATUS Status;
+
+    InterlockedIncrement(&Object->RefCount);
+    InterlockedIncrement(&Object->Outstanding);
+    InterlockedIncrement(&Pool->QueuedCallbacks);
+
+    Status = NtSetIoCompletion(Pool->CompletionPort, Object, NULL, STATUS_SUCCESS, Information);
+    if (!NT_SUCCESS(Status))
+    {
+        InterlockedDecrement(&Pool->QueuedCallbacks);
+        TppCallbackDone(Object);
+        TppReleaseObject(Object);
+        return Status;
+    }
+
+    if (Pool->IdleThreads < Pool->QueuedCallbacks && !TppAddWorker(Pool, FALSE))
+    {
+        /* Have the timer thread see whether the pool makes progress */
+        if (!InterlockedExchange(&TppMonitorActive, TRUE))
+        {
+            NtSetEvent(TppTimerEvent, NULL);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+TppWaitForCallbacks(IN PTP_OBJECT Object,
+                    IN BOOLEAN CancelPending)
+{
+    LONG Outstanding;
+
+    if (CancelPending) InterlockedIncrement(&Object->CancelPending);
+
+    for (;;)
+    {
+        Outstanding = Object->Outstanding;
+        if (Outstanding == 0) break;
+
+        RtlWaitOnAddress(&Object->Outstanding, &Outstanding, sizeof(Outstanding), NULL);
+    }
+
+    if (CancelPending) InterlockedDecrement(&Object->CancelPending);
+}
+
+static
+VOID
+TppCheckStarvation(VOID)
+{
+    PLIST_ENTRY ListEntry;
+    BOOLEAN Starving = FALSE;
+    PTP_POOL Pool;
+
+    /* Cleared first, so a pool that starts starving meanwhile sets it
+       again and wakes us up. */
+    InterlockedExchange(&TppMonitorActive, FALSE);
+
+    RtlEnterCriticalSection(&TppPoolListLock);
+
+    for (ListEntry = TppPoolListHead.Flink;
+         ListEntry != &TppPoolListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Pool = CONTAINING_RECORD(ListEntry, TP_POOL, ListEntry);
+
+        if (Pool->QueuedCallbacks > 0)
+        {
+            Starving = TRUE;
+
+            /* Nothing got done since the last check, the workers are blocked */
+            if (Pool->IdleThreads == 0 &&
+                Pool->CompletedCallbacks == Pool->LastCompletedCallbacks)
+            {
+                TppAddWorker(Pool, TRUE);
+            }
+        }
+
+        Pool->LastCompletedCallbacks = Pool->CompletedCallbacks;
+    }
+
+    RtlLeaveCriticalSection(&TppPoolListLock);
+
+    if (Starving) InterlockedExchange(&TppMonitorActive, TRUE);
+}
+
+/* Returns TRUE if the timer is the first one to expire */
+static
+BOOLEAN
+TppInsertTimer(IN PTP_OBJECT Timer)
+{
+    PLIST_ENTRY ListEntry;
+    PTP_OBJECT Next;
+
+    for (ListEntry = TppTimerListHead.Flink;
+         ListEntry != &TppTimerListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Next = CONTAINING_RECORD(ListEntry, TP_OBJECT, u.Timer.ListEntry);
+        if (Next->u.Timer.DueTime > Timer->u.Timer.DueTime) break;
+    }
+
+    InsertTailList(ListEntry, &Timer->u.Timer.ListEntry);
+    Timer->u.Timer.Set = TRUE;
+
+    return (TppTimerListHead.Flink == &Timer->u.Timer.ListEntry);
+}
+
+static
+VOID
+TppCancelTimer(IN PTP_OBJECT Timer)
+{
+    RtlEnterCriticalSection(&TppTimerLock);
+    if (Timer->u.Timer.Set)
+    {
+        RemoveEntryList(&Timer->u.Timer.ListEntry);
+        Timer->u.Timer.Set = FALSE;
+    }
+    RtlLeaveCriticalSection(&TppTimerLock);
+}
+
+static
+ULONG
+NTAPI
+TppTimerThread(IN PVOID Parameter)
+{
+    LARGE_INTEGER Now, Timeout;
+    PLIST_ENTRY ListEntry;
+    LONGLONG WakeTime;
+    PTP_OBJECT Timer;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&TppTimerLock);
+
+        NtQuerySystemTime(&Now);
+
+        /* Queue the expired timers */
+        while (!IsListEmpty(&TppTimerListHead))
+        {
+            Timer = CONTAINING_RECORD(TppTimerListHead.Flink, TP_OBJECT, u.Timer.ListEntry);
+            if (Timer->u.Timer.DueTime > Now.QuadPart) break;
+
+            RemoveEntryList(&Timer->u.Timer.ListEntry);
+            Timer->u.Timer.Set = FALSE;
+
+            if (Timer->u.Timer.Period)
+            {
+                /* Don't try to catch up on the periods we missed */
+                Timer->u.Timer.DueTime += Timer->u.Timer.Period;
+                if (Timer->u.Timer.DueTime <= Now.QuadPart)
+                {
+                    Timer->u.Timer.DueTime = Now.QuadPart + Timer->u.Timer.Period;
+                }
+                TppInsertTimer(Timer);
+            }
+
+            TppQueueObject(Timer, 0);
+        }
+
+        /* Sleep as long as the windows of the next timers allow, so that
+           the timers that expire close to each other are queued together */
+        WakeTime = MAXLONGLONG;
+        for (ListEntry = TppTimerListHead.Flink;
+             ListEntry != &TppTimerListHead;
+             ListEntry = ListEntry->Flink)
+        {
+            Timer = CONTAINING_RECORD(ListEntry, TP_OBJECT, u.Timer.ListEntry);
+            if (Timer->u.Timer.DueTime >= WakeTime) break;
+
+            WakeTime = min(WakeTime, Timer->u.Timer.DueTime + Timer->u.Timer.WindowLength);
+        }
+
+        RtlLeaveCriticalSection(&TppTimerLock);
+
+        if (TppMonitorActive)
+        {
+            WakeTime = min(WakeTime, Now.QuadPart + TP_STARVATION_INTERVAL);
+        }
+
+        /* A positive timeout is an absolute system time */
+        Timeout.QuadPart = WakeTime;
+        NtWaitForSingleObject(TppTimerEvent,
+                              FALSE,
+                              (WakeTime == MAXLONGLONG) ? NULL : &Timeout);
+
+        if (TppMonitorActive) TppCheckStarvation();
+    }
+
+    return 0;
+}
+
+/* Called with TppWaitLock held */
+static
+VOID
+TppRemoveWait(IN PTP_OBJECT Wait,
+              IN BOOLEAN Notify)
+{
+    PTP_WAITER Waiter = Wait->u.Wait.Waiter;
+    PTP_OBJECT Last;
+
+    if (!Waiter) return;
+
+    Last = Waiter->Waits[--Waiter->Count];
+    Waiter->Waits[Wait->u.Wait.Index] = Last;
+    Last->u.Wait.Index = Wait->u.Wait.Index;
+    Wait->u.Wait.Waiter = NULL;
+
+    /* The waiter thread may still be waiting on the handle */
+    if (Notify) NtSetEvent(Waiter->UpdateEvent, NULL);
+}
+
+/* Called with TppWaitLock held */
+static
+BOOLEAN
+TppIsWaitRegistered(IN PTP_WAITER Waiter,
+                    IN PTP_OBJECT Wait)
+{
+    ULONG i;
+
+    /* The wait may be gone, don't look at it before we find it here */
+    for (i = 0; i < Waiter->Count; i++)
+    {
+        if (Waiter->Waits[i] == Wait) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static
+ULONG
+NTAPI
+TppWaiterThread(IN PVOID Parameter)
+{
+    PTP_WAITER Waiter = Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    PTP_OBJECT Waits[TP_WAITS_PER_WAITER];
+    LARGE_INTEGER Now, Timeout;
+    PLARGE_INTEGER pTimeout;
+    PTP_OBJECT Wait;
+    ULONG Count, i;
+    NTSTATUS Status;
+
+    Handles[0] = Waiter->UpdateEvent;
+
+    RtlEnterCriticalSection(&TppWaitLock);
+
+    for (;;)
+    {
+        Count = Waiter->Count;
+        Timeout.QuadPart = MAXLONGLONG;
+        for (i = 0; i < Count; i++)
+        {
+            Waits[i] = Waiter->Waits[i];
+            Handles[i + 1] = Waits[i]->u.Wait.Handle;
+            Timeout.QuadPart = min(Timeout.QuadPart, Waits[i]->u.Wait.Timeout);
+        }
+
+        if (Count == 0)
+        {
+            Timeout.QuadPart = TP_WAITER_IDLE_TIMEOUT;
+            pTimeout = &Timeout;
+        }
+        else
+        {
+            pTimeout = (Timeout.QuadPart == MAXLONGLONG) ? NULL : &Timeout;
+        }
+
+        RtlLeaveCriticalSection(&TppWaitLock);
+
+        Status = NtWaitForMultipleObjects(Count + 1, Handles, WaitAny, FALSE, pTimeout);
+
+        RtlEnterCriticalSection(&TppWaitLock);
+
+        if (Status == STATUS_TIMEOUT && Count == 0 && Waiter->Count == 0)
+        {
+            /* Nothing to wait for in a while, leave */
+            RemoveEntryList(&Waiter->ListEntry);
+            break;
+        }
+
+        if ((Status > STATUS_WAIT_0 && Status <= STATUS_WAIT_0 + Count) ||
+            (Status > STATUS_ABANDONED_WAIT_0 && Status <= STATUS_ABANDONED_WAIT_0 + Count))
+        {
+            i = (Status & ~STATUS_ABANDONED_WAIT_0) - 1;
+            Wait = Waits[i];
+
+            if (TppIsWaitRegistered(Waiter, Wait) && Wait->u.Wait.Handle == Handles[i + 1])
+            {
+                TppRemoveWait(Wait, FALSE);
+                TppQueueObject(Wait, WAIT_OBJECT_0);
+            }
+        }
+        else if (Status == STATUS_TIMEOUT)
+        {
+            /* Going backwards, since removing a wait moves the last one */
+            NtQuerySystemTime(&Now);
+            for (i = Waiter->Count; i-- > 0;)
+            {
+                Wait = Waiter->Waits[i];
+                if (Wait->u.Wait.Timeout <= Now.QuadPart)
+                {
+                    TppRemoveWait(Wait, FALSE);
+                    TppQueueObject(Wait, WAIT_TIMEOUT);
+                }
+            }
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            /* Some handle can't be waited on, drop it */
+            Timeout.QuadPart = 0;
+            for (i = Waiter->Count; i-- > 0;)
+            {
+                Wait = Waiter->Waits[i];
+                if (!NT_SUCCESS(NtWaitForSingleObject(Wait->u.Wait.Handle, FALSE, &Timeout)))
+                {
+                    DPRINT1("Can't wait on %p for wait %p\n", Wait->u.Wait.Handle, Wait);
+                    TppRemoveWait(Wait, FALSE);
+                }
+            }
+        }
+    }
+
+    RtlLeaveCriticalSection(&TppWaitLock);
+
+    NtClose(Waiter->UpdateEvent);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+
+    RtlExitUserThread(STATUS_SUCCESS);
+    return 0;
+}
+
+/* Called with TppWaitLock held */
+static
+NTSTATUS
+TppAddWait(IN PTP_OBJECT Wait)
+{
+    PLIST_ENTRY ListEntry;
+    PTP_WAITER Waiter;
+    NTSTATUS Status;
+
+    for (ListEntry = TppWaiterListHead.Flink;
+         ListEntry != &TppWaiterListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Waiter = CONTAINING_RECORD(ListEntry, TP_WAITER, ListEntry);
+        if (Waiter->Count < TP_WAITS_PER_WAITER) goto Found;
+    }
+
+    /* All the waiter threads are full, start another one */
+    Waiter = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Waiter));
+    if (!Waiter) return STATUS_NO_MEMORY;
+
+    Status = NtCreateEvent(&Waiter->UpdateEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+        return Status;
+    }
+
+    Status = TppCreateThread(TppWaiterThread, Waiter);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(Waiter->UpdateEvent);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+        return Status;
+    }
+
+    InsertTailList(&TppWaiterListHead, &Waiter->ListEntry);
+
+Found:
+    Wait->u.Wait.Waiter = Waiter;
+    Wait->u.Wait.Index = Waiter->Count;
+    Waiter->Waits[Waiter->Count++] = Wait;
+
+    NtSetEvent(Waiter->UpdateEvent, NULL);
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+TppCancelWait(IN PTP_OBJECT Wait)
+{
+    RtlEnterCriticalSection(&TppWaitLock);
+    TppRemoveWait(Wait, TRUE);
+    RtlLeaveCriticalSection(&TppWaitLock);
+}
+
+/* Called with TppPoolListLock held */
+static
+NTSTATUS
+TppStartTimerThread(VOID)
+{
+    NTSTATUS Status;
+
+    Status = NtCreateEvent(&TppTimerEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    Status = TppCreateThread(TppTimerThread, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(TppTimerEvent);
+        TppTimerEvent = NULL;
+    }
+
+    return Status;
+}
+
+static
+NTSTATUS
+TppCreatePool(OUT PTP_POOL *PoolReturn)
+{
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Pool));
+    if (!Pool) return STATUS_NO_MEMORY;
+
+    /* A concurrency of 0 means one running worker per processor */
+    Status = NtCreateIoCompletion(&Pool->CompletionPort, IO_COMPLETION_ALL_ACCESS, NULL, 0);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    Status = RtlInitializeCriticalSection(&Pool->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(Pool->CompletionPort);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    Pool->RefCount = 1;
+    Pool->MaxThreads = TP_DEFAULT_MAX_THREADS;
+
+    RtlEnterCriticalSection(&TppPoolListLock);
+    if (!TppTimerEvent) Status = TppStartTimerThread();
+    if (NT_SUCCESS(Status)) InsertTailList(&TppPoolListHead, &Pool->ListEntry);
+    RtlLeaveCriticalSection(&TppPoolListLock);
+
+    if (!NT_SUCCESS(Status))
+    {
+        RtlDeleteCriticalSection(&Pool->Lock);
+        NtClose(Pool->CompletionPort);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    *PoolReturn = Pool;
+    return STATUS_SUCCESS;
+}
+
+static
+PTP_POOL
+TppGetDefaultPool(VOID)
+{
+    PTP_POOL Pool;
+
+    if (TppDefaultPool) return TppDefaultPool;
+
+    if (!NT_SUCCESS(TppCreatePool(&Pool))) return NULL;
+
+    if (InterlockedCompareExchangePointer((PVOID *)&TppDefaultPool, Pool, NULL) != NULL)
+    {
+        /* Somebody else was faster */
+        TppReleasePool(Pool);
+    }
+
+    return TppDefaultPool;
+}
+
+static
+NTSTATUS
+TppAllocObject(IN TP_OBJECT_TYPE Type,
+               IN PVOID Callback,
+               IN PVOID Context,
+               IN PTP_CALLBACK_ENVIRON Environment OPTIONAL,
+               OUT PTP_OBJECT *ObjectReturn)
+{
+    PTP_OBJECT Object;
+    PTP_POOL Pool = NULL;
+
+    if (Environment)
+    {
+        if (Environment->Version != 1 && Environment->Version != 3)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+        Pool = Environment->Pool;
+    }
+
+    if (!Pool)
+    {
+        Pool = TppGetDefaultPool();
+        if (!Pool) return STATUS_NO_MEMORY;
+    }
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Object));
+    if (!Object) return STATUS_NO_MEMORY;
+
+    InterlockedIncrement(&Pool->RefCount);
+
+    Object->Type = Type;
+    Object->RefCount = 1;
+    Object->Pool = Pool;
+    Object->Callback = Callback;
+    Object->Context = Context;
+    InitializeListHead(&Object->GroupEntry);
+
+    /* The activation context and the priority are ignored */
+    if (Environment)
+    {
+        Object->CleanupGroup = Environment->CleanupGroup;
+        Object->CleanupGroupCancelCallback = Environment->CleanupGroupCancelCallback;
+        Object->FinalizationCallback = Environment->FinalizationCallback;
+        Object->LongFunction = Environment->u.s.LongFunction;
+
+        if (Environment->RaceDll && NT_SUCCESS(LdrAddRefDll(0, Environment->RaceDll)))
+        {
+            Object->RaceDll = Environment->RaceDll;
+        }
+    }
+
+    if (Object->CleanupGroup)
+    {
+        RtlEnterCriticalSection(&Object->CleanupGroup->Lock);
+        InsertTailList(&Object->CleanupGroup->MemberListHead, &Object->GroupEntry);
+        RtlLeaveCriticalSection(&Object->CleanupGroup->Lock);
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static
+LONGLONG
+TppAbsoluteTime(IN PLARGE_INTEGER Time)
+{
+    LARGE_INTEGER Now;
+
+    if (Time->QuadPart > 0) return Time->QuadPart;
+
+    NtQuerySystemTime(&Now);
+    return Now.QuadPart - Time->QuadPart;
+}
+
+VOID
+RtlpInitializeThreadPool(VOID)
+{
+    RtlInitializeCriticalSection(&TppPoolListLock);
+    InitializeListHead(&TppPoolListHead);
+    RtlInitializeCriticalSection(&TppTimerLock);
+    InitializeListHead(&TppTimerListHead);
+    RtlInitializeCriticalSection(&TppWaitLock);
+    InitializeListHead(&TppWaiterListHead);
+}
+
+/* EXPORTED FUNCTIONS ********************************************************/
+
+NTSTATUS
+NTAPI
+TpAllocPool(OUT PTP_POOL *Pool,
+            IN PVOID Reserved)
+{
+    return TppCreatePool(Pool);
+}
+
+VOID
+NTAPI
+TpReleasePool(IN PTP_POOL Pool)
+{
+    TppReleasePool(Pool);
+}
+
+VOID
+NTAPI
+TpSetPoolMaxThreads(IN PTP_POOL Pool,
+                    IN LONG MaxThreads)
+{
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MaxThreads = max(MaxThreads, 1);
+    Pool->MinThreads = min(Pool->MinThreads, Pool->MaxThreads);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+NTSTATUS
+NTAPI
+TpSetPoolMinThreads(IN PTP_POOL Pool,
+                    IN LONG MinThreads)
+{
+    BOOLEAN Missing;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MinThreads = max(MinThreads, 0);
+    Pool->MaxThreads = max(Pool->MaxThreads, Pool->MinThreads);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+        Missing = (Pool->Threads < Pool->MinThreads);
+        RtlLeaveCriticalSection(&Pool->Lock);
+
+        if (!Missing) break;
+        if (!TppAddWorker(Pool, TRUE)) return STATUS_NO_MEMORY;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    CleanupGroup = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*CleanupGroup));
+    if (!CleanupGroup) return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&CleanupGroup->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+        return Status;
+    }
+
+    InitializeListHead(&CleanupGroup->MemberListHead);
+
+    *CleanupGroupReturn = CleanupGroup;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpReleaseCleanupGroup(IN PTP_CLEANUP_GROUP CleanupGroup)
+{
+    /* The members must have been released with TpReleaseCleanupGroupMembers */
+    ASSERT(IsListEmpty(&CleanupGroup->MemberListHead));
+
+    RtlDeleteCriticalSection(&CleanupGroup->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+}
+
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(IN PTP_CLEANUP_GROUP CleanupGroup,
+                             IN BOOLEAN CancelPending,
+                             IN PVOID CleanupParameter OPTIONAL)
+{
+    PLIST_ENTRY ListEntry, NextEntry;
+    LIST_ENTRY MemberListHead;
+    PTP_OBJECT Object;
+
+    InitializeListHead(&MemberListHead);
+
+    /* Take the members out of the group. Those already being freed are
+       left alone, they remove themselves. */
+    RtlEnterCriticalSection(&CleanupGroup->Lock);
+    for (ListEntry = CleanupGroup->MemberListHead.Flink;
+         ListEntry != &CleanupGroup->MemberListHead;
+         ListEntry = NextEntry)
+    {
+        NextEntry = ListEntry->Flink;
+        Object = CONTAINING_RECORD(ListEntry, TP_OBJECT, GroupEntry);
+
+        if (!TppTryReferenceObject(Object)) continue;
+
+        RemoveEntryList(&Object->GroupEntry);
+        InsertTailList(&MemberListHead, &Object->GroupEntry);
+    }
+    RtlLeaveCriticalSection(&CleanupGroup->Lock);
+
+    while (!IsListEmpty(&MemberListHead))
+    {
+        ListEntry = RemoveHeadList(&MemberListHead);
+        InitializeListHead(ListEntry);
+        Object = CONTAINING_RECORD(ListEntry, TP_OBJECT, GroupEntry);
+        Object->CleanupGroup = NULL;
+
+        if (Object->Type == TpObjectTimer) TppCancelTimer(Object);
+        else if (Object->Type == TpObjectWait) TppCancelWait(Object);
+
+        TppWaitForCallbacks(Object, CancelPending);
+
+        if (CancelPending && !Object->Released && Object->CleanupGroupCancelCallback)
+        {
+            Object->CleanupGroupCancelCallback(Object->Context, CleanupParameter);
+        }
+
+        TppReleaseOwner(Object);
+        TppReleaseObject(Object);
+    }
+}
+
+NTSTATUS
+NTAPI
+TpAllocWork(OUT PTP_WORK *Work,
+            IN PTP_WORK_CALLBACK Callback,
+            IN PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON Environment OPTIONAL)
+{
+    return TppAllocObject(TpObjectWork, Callback, Context, Environment, (PTP_OBJECT *)Work);
+}
+
+VOID
+NTAPI
+TpPostWork(IN PTP_WORK Work)
+{
+    TppQueueObject((PTP_OBJECT)Work, 0);
+}
+
+VOID
+NTAPI
+TpWaitForWork(IN PTP_WORK Work,
+              IN BOOLEAN CancelPending)
+{
+    TppWaitForCallbacks((PTP_OBJECT)Work, CancelPending);
+}
+
+VOID
+NTAPI
+TpReleaseWork(IN PTP_WORK Work)
+{
+    TppReleaseOwner((PTP_OBJECT)Work);
+}
+
+NTSTATUS
+NTAPI
+TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback,
+                IN PVOID Context OPTIONAL,
+                IN PTP_CALLBACK_ENVIRON Environment OPTIONAL)
+{
+    PTP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocObject(TpObjectSimple, Callback, Context, Environment, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    /* The queued callback keeps the object alive */
+    Status = TppQueueObject(Object, 0);
+    TppReleaseOwner(Object);
+
+    return Status;
+}
+
+NTSTATUS
+NTAPI
+TpAllocTimer(OUT PTP_TIMER *Timer,
+             IN PTP_TIMER_CALLBACK Callback,
+             IN PVOID Context OPTIONAL,
+             IN PTP_CALLBACK_ENVIRON Environment OPTIONAL)
+{
+    return TppAllocObject(TpObjectTimer, Callback, Context, Environment, (PTP_OBJECT *)Timer);
+}
+
+VOID
+NTAPI
+TpSetTimer(IN PTP_TIMER Timer,
+           IN PLARGE_INTEGER DueTime OPTIONAL,
+           IN LONG Period,
+           IN LONG WindowLength)
+{
+    PTP_OBJECT Object = (PTP_OBJECT)Timer;
+    BOOLEAN First = FALSE;
+
+    RtlEnterCriticalSection(&TppTimerLock);
+
+    if (Object->u.Timer.Set)
+    {
+        RemoveEntryList(&Object->u.Timer.ListEntry);
+        Object->u.Timer.Set = FALSE;
+    }
+
+    if (DueTime)
+    {
+        Object->u.Timer.DueTime = TppAbsoluteTime(DueTime);
+        Object->u.Timer.Period = (LONGLONG)Period * 10000;
+        Object->u.Timer.WindowLength = (LONGLONG)WindowLength * 10000;
+        First = TppInsertTimer(Object);
+    }
+
+    RtlLeaveCriticalSection(&TppTimerLock);
+
+    if (First) NtSetEvent(TppTimerEvent, NULL);
+}
+
+BOOLEAN
+NTAPI
+TpIsTimerSet(IN PTP_TIMER Timer)
+{
+    return ((PTP_OBJECT)Timer)->u.Timer.Set;
+}
+
+VOID
+NTAPI
+TpWaitForTimer(IN PTP_TIMER Timer,
+               IN BOOLEAN CancelPending)
+{
+    TppWaitForCallbacks((PTP_OBJECT)Timer, CancelPending);
+}
+
+VOID
+NTAPI
+TpReleaseTimer(IN PTP_TIMER Timer)
+{
+    TppCancelTimer((PTP_OBJECT)Timer);
+    TppReleaseOwner((PTP_OBJECT)Timer);
+}
+
+NTSTATUS
+NTAPI
+TpAllocWait(OUT PTP_WAIT *Wait,
+            IN PTP_WAIT_CALLBACK Callback,
+            IN PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON Environment OPTIONAL)
+{
+    return TppAllocObject(TpObjectWait, Callback, Context, Environment, (PTP_OBJECT *)Wait);
+}
+
+VOID
+NTAPI
+TpSetWait(IN PTP_WAIT Wait,
+          IN HANDLE Handle OPTIONAL,
+          IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    PTP_OBJECT Object = (PTP_OBJECT)Wait;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&TppWaitLock);
+
+    TppRemoveWait(Object, TRUE);
+
+    if (Handle)
+    {
+        Object->u.Wait.Handle = Handle;
+        Object->u.Wait.Timeout = Timeout ? TppAbsoluteTime(Timeout) : MAXLONGLONG;
+
+        Status = TppAddWait(Object);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to add wait %p: 0x%lx\n", Object, Status);
+        }
+    }
+
+    RtlLeaveCriticalSection(&TppWaitLock);
+}
+
+VOID
+NTAPI
+TpWaitForWait(IN PTP_WAIT Wait,
+              IN BOOLEAN CancelPending)
+{
+    TppWaitForCallbacks((PTP_OBJECT)Wait, CancelPending);
+}
+
+VOID
+NTAPI
+TpReleaseWait(IN PTP_WAIT Wait)
+{
+    TppCancelWait((PTP_OBJECT)Wait);
+    TppReleaseOwner((PTP_OBJECT)Wait);
+}
+
+NTSTATUS
+NTAPI
+TpAllocIoCompletion(OUT PTP_IO *Io,
+                    IN HANDLE File,
+                    IN PTP_IO_CALLBACK Callback,
+                    IN PVOID Context OPTIONAL,
+                    IN PTP_CALLBACK_ENVIRON Environment OPTIONAL)
+{
+    FILE_COMPLETION_INFORMATION CompletionInformation;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PTP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocObject(TpObjectIo, Callback, Context, Environment, &Object);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    /* The completions of the file are queued to the pool as they are */
+    CompletionInformation.Port = Object->Pool->CompletionPort;
+    CompletionInformation.Key = Object;
+    Status = NtSetInformationFile(File,
+                                  &IoStatusBlock,
+                                  &CompletionInformation,
+                                  sizeof(CompletionInformation),
+                                  FileCompletionInformation);
+    if (!NT_SUCCESS(Status))
+    {
+        TppReleaseOwner(Object);
+        return Status;
+    }
+
+    *Io = (PTP_IO)Object;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+TpStartAsyncIoOperation(IN PTP_IO Io)
+{
+    PTP_OBJECT Object = (PTP_OBJECT)Io;
+
+    /* Released once the completion callback has run */
+    InterlockedIncrement(&Object->RefCount);
+    InterlockedIncrement(&Object->Outstanding);
+}
+
+VOID
+NTAPI
+TpCancelAsyncIoOperation(IN PTP_IO Io)
+{
+    PTP_OBJECT Object = (PTP_OBJECT)Io;
+
+    TppCallbackDone(Object);
+    TppReleaseObject(Object);
+}
+
+VOID
+NTAPI
+TpWaitForIoCompletion(IN PTP_IO Io,
+                      IN BOOLEAN CancelPending)
+{
+    TppWaitForCallbacks((PTP_OBJECT)Io, CancelPending);
+}
+
+VOID
+NTAPI
+TpReleaseIoCompletion(IN PTP_IO Io)
+{
+    TppReleaseOwner((PTP_OBJECT)Io);
+}
+
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN PTP_CALLBACK_INSTANCE Instance)
+{
+    PTP_POOL Pool;
+
+    if (!Instance->Object) return STATUS_TOO_MANY_THREADS;
+    if (Instance->MayRunLong) return STATUS_SUCCESS;
+
+    Instance->MayRunLong = TRUE;
+
+    /* Make sure somebody else takes care of the rest of the queue */
+    Pool = Instance->Object->Pool;
+    if (Pool->IdleThreads > 0 || TppAddWorker(Pool, TRUE)) return STATUS_SUCCESS;
+
+    return STATUS_TOO_MANY_THREADS;
+}
+
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(IN PTP_CALLBACK_INSTANCE Instance,
+                               IN HANDLE Event)
+{
+    Instance->Event = Event;
+}
+
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(IN PTP_CALLBACK_INSTANCE Instance,
+                                       IN HANDLE Semaphore,
+                                       IN LONG ReleaseCount)
+{
+    Instance->Semaphore = Semaphore;
+    Instance->SemaphoreReleaseCount = ReleaseCount;
+}
+
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(IN PTP_CALLBACK_INSTANCE Instance,
+                                   IN HANDLE Mutex)
+{
+    Instance->Mutex = Mutex;
+}
+
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(IN PTP_CALLBACK_INSTANCE Instance,
+                                           IN PRTL_CRITICAL_SECTION CriticalSection)
+{
+    Instance->CriticalSection = CriticalSection;
+}
+
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(IN PTP_CALLBACK_INSTANCE Instance,
+                                IN PVOID DllHandle)
+{
+    Instance->DllHandle = DllHandle;
+}
+
+VOID
+NTAPI
+TpDisassociateCallback(IN PTP_CALLBACK_INSTANCE Instance)
+{
+    /* Whoever waits for the callbacks of the object doesn't wait for us */
+    if (Instance->Associated)
+    {
+        Instance->Associated = FALSE;
+        TppCallbackDone(Instance->Object);
+    }
+}
+
+/* EOF */
@@ -0,0 +1,229 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Address wait Routines
+ */
+
+/* NOTE: Waiters are kept in a hashed table of lists, one entry on the
+   stack of each waiting thread, and sleep on the process keyed event
+   using that entry as the key. Nothing is allocated, and there's no
+   kernel object behind the addresses being waited on. */
+
+/* INCLUDES ******************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* INTERNAL TYPES ************************************************************/
+
+#define ADDRESS_WAIT_BUCKETS         128
+#define ADDRESS_WAIT_HASH(a)         ((((ULONG_PTR)(a)) >> 4) & (ADDRESS_WAIT_BUCKETS - 1))
+
+typedef struct _ADDRESS_WAIT_BLOCK
+{
+    LIST_ENTRY ListEntry;
+    volatile VOID *Address;
+    BOOLEAN Removed;
+} ADDRESS_WAIT_BLOCK, *PADDRESS_WAIT_BLOCK;
+
+typedef struct _ADDRESS_WAIT_BUCKET
+{
+    LONG Lock;
+    LIST_ENTRY WaitListHead;
+} ADDRESS_WAIT_BUCKET, *PADDRESS_WAIT_BUCKET;
+
+/* GLOBALS *******************************************************************/
+
+static ADDRESS_WAIT_BUCKET AddressWaitTable[ADDRESS_WAIT_BUCKETS];
+
+/* INTERNAL FUNCTIONS ********************************************************/
+
+static
+PADDRESS_WAIT_BUCKET
+InternalLockAddressWaitBucket(IN volatile VOID *Address)
+{
+    PADDRESS_WAIT_BUCKET Bucket = &AddressWaitTable[ADDRESS_WAIT_HASH(Address)];
+
+    /* The lock is only held for a few list operations, and it can't be
+       an SRW lock since those are built on top of us. */
+    while (InterlockedExchange(&Bucket->Lock, 1) != 0)
+    {
+        YieldProcessor();
+    }
+
+    return Bucket;
+}
+
+static
+VOID
+InternalUnlockAddressWaitBucket(IN PADDRESS_WAIT_BUCKET Bucket)
+{
+    InterlockedExchange(&Bucket->Lock, 0);
+}
+
+static
+BOOLEAN
+InternalCompareAddress(IN volatile VOID *Address,
+                       IN PVOID CompareAddress,
+                       IN SIZE_T AddressSize)
+{
+    switch (AddressSize)
+    {
+        case sizeof(UCHAR):
+            return *(volatile UCHAR *)Address == *(PUCHAR)CompareAddress;
+        case sizeof(USHORT):
+            return *(volatile USHORT *)Address == *(PUSHORT)CompareAddress;
+        case sizeof(ULONG):
+            return *(volatile ULONG *)Address == *(PULONG)CompareAddress;
+        default:
+            return *(volatile ULONGLONG *)Address == *(PULONGLONG)CompareAddress;
+    }
+}
+
+static
+VOID
+InternalWakeAddress(IN PVOID Address,
+                    IN BOOLEAN WakeAll)
+{
+    PADDRESS_WAIT_BUCKET Bucket = &AddressWaitTable[ADDRESS_WAIT_HASH(Address)];
+    PADDRESS_WAIT_BLOCK WaitBlock;
+    PLIST_ENTRY ListEntry, NextEntry;
+    LIST_ENTRY WakeListHead;
+
+    /* The caller changed the value before calling us, make sure the
+       waiters see it before we look for them. */
+    MemoryBarrier();
+
+    /* Nobody is waiting, which is the common case */
+    if (IsListEmpty(&Bucket->WaitListHead)) return;
+
+    InitializeListHead(&WakeListHead);
+
+    InternalLockAddressWaitBucket(Address);
+
+    /* Take the waiters off the list, in FIFO order */
+    ListEntry = Bucket->WaitListHead.Flink;
+    while (ListEntry != &Bucket->WaitListHead)
+    {
+        WaitBlock = CONTAINING_RECORD(ListEntry, ADDRESS_WAIT_BLOCK, ListEntry);
+        ListEntry = ListEntry->Flink;
+
+        if (WaitBlock->Address != Address) continue;
+
+        RemoveEntryList(&WaitBlock->ListEntry);
+        InsertTailList(&WakeListHead, &WaitBlock->ListEntry);
+        WaitBlock->Removed = TRUE;
+
+        if (!WakeAll) break;
+    }
+
+    InternalUnlockAddressWaitBucket(Bucket);
+
+    /* Now release them. A waiter we took off the list always waits for
+       its release, even when its wait timed out, so this can't block
+       for long. */
+    for (ListEntry = WakeListHead.Flink;
+         ListEntry != &WakeListHead;
+         ListEntry = NextEntry)
+    {
+        /* We may not touch the entry once its owner is awake */
+        NextEntry = ListEntry->Flink;
+        WaitBlock = CONTAINING_RECORD(ListEntry, ADDRESS_WAIT_BLOCK, ListEntry);
+
+        NtReleaseKeyedEvent(RtlpKeyedEventHandle,
+                            WaitBlock,
+                            FALSE,
+                            NULL);
+    }
+}
+
+VOID
+RtlpInitializeAddressWaitTable(VOID)
+{
+    ULONG i;
+
+    for (i = 0; i < ADDRESS_WAIT_BUCKETS; i++)
+    {
+        InitializeListHead(&AddressWaitTable[i].WaitListHead);
+    }
+}
+
+/* EXPORTED FUNCTIONS ********************************************************/
+
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(IN volatile VOID *Address,
+                 IN PVOID CompareAddress,
+                 IN SIZE_T AddressSize,
+                 IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    ADDRESS_WAIT_BLOCK WaitBlock;
+    PADDRESS_WAIT_BUCKET Bucket;
+    NTSTATUS Status;
+
+    if ((AddressSize != sizeof(UCHAR)) &&
+        (AddressSize != sizeof(USHORT)) &&
+        (AddressSize != sizeof(ULONG)) &&
+        (AddressSize != sizeof(ULONGLONG)))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    WaitBlock.Address = Address;
+    WaitBlock.Removed = FALSE;
+
+    /* Compare under the bucket lock, so a wake can't slip in between
+       the comparison and us being on the list. */
+    Bucket = InternalLockAddressWaitBucket(Address);
+    if (!InternalCompareAddress(Address, CompareAddress, AddressSize))
+    {
+        InternalUnlockAddressWaitBucket(Bucket);
+        return STATUS_SUCCESS;
+    }
+    InsertTailList(&Bucket->WaitListHead, &WaitBlock.ListEntry);
+    InternalUnlockAddressWaitBucket(Bucket);
+
+    Status = NtWaitForKeyedEvent(RtlpKeyedEventHandle,
+                                 &WaitBlock,
+                                 FALSE,
+                                 Timeout);
+    if (Status != STATUS_SUCCESS)
+    {
+        Bucket = InternalLockAddressWaitBucket(Address);
+        if (!WaitBlock.Removed)
+        {
+            /* Nobody woke us, just leave */
+            RemoveEntryList(&WaitBlock.ListEntry);
+            InternalUnlockAddressWaitBucket(Bucket);
+            return Status;
+        }
+        InternalUnlockAddressWaitBucket(Bucket);
+
+        /* We lost the race against a wake, which is now going to release
+           us. Take it, or it would wait for us forever. */
+        Status = NtWaitForKeyedEvent(RtlpKeyedEventHandle,
+                                     &WaitBlock,
+                                     FALSE,
+                                     NULL);
+    }
+
+    return Status;
+}
+
+VOID
+NTAPI
+RtlWakeAddressSingle(IN PVOID Address)
+{
+    InternalWakeAddress(Address, FALSE);
+}
+
+VOID
+NTAPI
+RtlWakeAddressAll(IN PVOID Address)
+{
+    InternalWakeAddress(Address, TRUE);
+}
+
+/* EOF */
@@ -3597,6 +3597,106 @@ ULONG ComplexStructSize(PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat)
   return size;
 }
 
+static BOOL type_has_pointers(PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, int depth);
+
+/* member layout of a bogus struct or element description of a bogus array */
+static BOOL layout_has_pointers(PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, int depth)
+{
+  while (*pFormat != FC_END) {
+    switch (*pFormat) {
+    case FC_BYTE:
+    case FC_CHAR:
+    case FC_SMALL:
+    case FC_USMALL:
+    case FC_WCHAR:
+    case FC_SHORT:
+    case FC_USHORT:
+    case FC_LONG:
+    case FC_ULONG:
+    case FC_ENUM16:
+    case FC_ENUM32:
+    case FC_FLOAT:
+    case FC_INT3264:
+    case FC_UINT3264:
+    case FC_HYPER:
+    case FC_DOUBLE:
+    case FC_ALIGNM2:
+    case FC_ALIGNM4:
+    case FC_ALIGNM8:
+    case FC_STRUCTPAD1:
+    case FC_STRUCTPAD2:
+    case FC_STRUCTPAD3:
+    case FC_STRUCTPAD4:
+    case FC_STRUCTPAD5:
+    case FC_STRUCTPAD6:
+    case FC_STRUCTPAD7:
+    case FC_PAD:
+      break;
+    case FC_EMBEDDED_COMPLEX:
+      pFormat += 2;
+      if (type_has_pointers(pStubMsg, pFormat + *(const SHORT*)pFormat, depth + 1))
+        return TRUE;
+      pFormat += 2;
+      continue;
+    default:
+      /* pointers, and anything we don't know about */
+      return TRUE;
+    }
+    pFormat++;
+  }
+
+  return FALSE;
+}
+
+/*
+ * Whether any pointer can be reached from a type. Types for which this is
+ * false don't need the PointerBufferMark, so marshalling them can skip the
+ * extra buffer sizing pass that computes it. Errs on the side of TRUE.
+ */
+static BOOL type_has_pointers(PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, int depth)
+{
+  PFORMAT_STRING desc;
+
+  /* recursive types have pointers anyway */
+  if (depth > 8) return TRUE;
+
+  switch (*pFormat) {
+  case FC_STRUCT:
+  case FC_CSTRUCT:
+  case FC_CSTRING:
+  case FC_WSTRING:
+  case FC_C_CSTRING:
+  case FC_C_WSTRING:
+  case FC_RANGE:
+    return FALSE;
+  case FC_SMFARRAY:
+    return pFormat[4] == FC_PP;
+  case FC_LGFARRAY:
+    return pFormat[6] == FC_PP;
+  case FC_SMVARRAY:
+    return *SkipVariance(pStubMsg, pFormat + 8) == FC_PP;
+  case FC_LGVARRAY:
+    return *SkipVariance(pStubMsg, pFormat + 12) == FC_PP;
+  case FC_CARRAY:
+    return *SkipConformance(pStubMsg, pFormat + 4) == FC_PP;
+  case FC_CVARRAY:
+    return *SkipVariance(pStubMsg, SkipConformance(pStubMsg, pFormat + 4)) == FC_PP;
+  case FC_BOGUS_ARRAY:
+    desc = SkipVariance(pStubMsg, SkipConformance(pStubMsg, pFormat + 4));
+    return layout_has_pointers(pStubMsg, desc, depth);
+  case FC_BOGUS_STRUCT:
+    /* pointer layout */
+    if (*(const WORD*)&pFormat[6]) return TRUE;
+    /* conformant array */
+    if (*(const SHORT*)&pFormat[4] &&
+        type_has_pointers(pStubMsg, pFormat + 4 + *(const SHORT*)&pFormat[4], depth + 1))
+      return TRUE;
+    return layout_has_pointers(pStubMsg, pFormat + 8, depth);
+  default:
+    return TRUE;
+  }
+}
+
 /***********************************************************************
  *           NdrComplexStructMarshall [RPCRT4.@]
  */
@@ -3614,7 +3714,7 @@ unsigned char * WINAPI NdrComplexStructMarshall(PMIDL_STUB_MESSAGE pStubMsg,
 
   TRACE("(%p,%p,%p)\n", pStubMsg, pMemory, pFormat);
 
-  if (!pStubMsg->PointerBufferMark)
+  if (!pStubMsg->PointerBufferMark && type_has_pointers(pStubMsg, pFormat, 0))
   {
     int saved_ignore_embedded = pStubMsg->IgnoreEmbeddedPointers;
     /* save buffer length */
@@ -4167,7 +4267,7 @@ unsigned char * WINAPI NdrComplexArrayMarshall(PMIDL_STUB_MESSAGE pStubMsg,
       return NULL;
   }
 
-  if (!pStubMsg->PointerBufferMark)
+  if (!pStubMsg->PointerBufferMark && type_has_pointers(pStubMsg, pFormat, 0))
   {
     /* save buffer fields that may be changed by buffer sizer functions
      * and that may be needed later on */
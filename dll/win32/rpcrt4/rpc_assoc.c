@@ -240,7 +240,8 @@ static RPC_STATUS RpcAssoc_BindConnection(const RpcAssoc *assoc, RpcConnection *
     TRACE("sending bind request to server\n");
 
     hdr = RPCRT4_BuildBindHeader(NDR_LOCAL_DATA_REPRESENTATION,
-                                 RPC_MAX_PACKET_SIZE, RPC_MAX_PACKET_SIZE,
+                                 rpcrt4_conn_get_max_packet_size(conn),
+                                 rpcrt4_conn_get_max_packet_size(conn),
                                  assoc->assoc_group_id,
                                  InterfaceId, TransferSyntax);
 
@@ -118,6 +118,7 @@ struct connection_ops {
   RPC_STATUS (*impersonate_client)(RpcConnection *conn);
   RPC_STATUS (*revert_to_self)(RpcConnection *conn);
   RPC_STATUS (*inquire_auth_client)(RpcConnection *, RPC_AUTHZ_HANDLE *, RPC_WSTR *, ULONG *, ULONG *, ULONG *, ULONG);
+  USHORT max_packet_size; /* 0 for RPC_MAX_PACKET_SIZE */
 };
 
 /* don't know what MS's structure looks like */
@@ -185,6 +186,11 @@ static inline const char *rpcrt4_conn_get_name(const RpcConnection *Connection)
   return Connection->ops->name;
 }
 
+static inline USHORT rpcrt4_conn_get_max_packet_size(const RpcConnection *Connection)
+{
+  return Connection->ops->max_packet_size ? Connection->ops->max_packet_size : RPC_MAX_PACKET_SIZE;
+}
+
 static inline int rpcrt4_conn_read(RpcConnection *Connection,
                      void *buffer, unsigned int len)
 {
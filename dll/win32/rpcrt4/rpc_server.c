@@ -319,15 +319,15 @@ static RPC_STATUS process_bind_packet_no_send(
   }
 
   *ack_response = RPCRT4_BuildBindAckHeader(NDR_LOCAL_DATA_REPRESENTATION,
-                                            RPC_MAX_PACKET_SIZE,
-                                            RPC_MAX_PACKET_SIZE,
+                                            rpcrt4_conn_get_max_packet_size(conn),
+                                            rpcrt4_conn_get_max_packet_size(conn),
                                             conn->server_binding->Assoc->assoc_group_id,
                                             conn->Endpoint, hdr->num_elements,
                                             results);
   HeapFree(GetProcessHeap(), 0, results);
 
   if (*ack_response)
-      conn->MaxTransmissionSize = hdr->max_tsize;
+      conn->MaxTransmissionSize = min(hdr->max_tsize, rpcrt4_conn_get_max_packet_size(conn));
   else
       status = RPC_S_OUT_OF_RESOURCES;
 
@@ -30,6 +30,21 @@
 
 #include "tomcrypt.h"
 
+#if defined(_M_IX86) || defined(_M_AMD64)
+/* aesni.s */
+int aesni_is_supported(void);
+void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const ulong32 *rk, int Nr);
+void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const ulong32 *rk, int Nr);
+
+static int aesni_state = -1;
+
+static int use_aesni(void)
+{
+    if (aesni_state < 0) aesni_state = aesni_is_supported();
+    return aesni_state;
+}
+#endif
+
 static const ulong32 TE0[256] = {
     0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL,
     0xfff2f20dUL, 0xd66b6bbdUL, 0xde6f6fb1UL, 0x91c5c554UL,
@@ -1058,6 +1073,20 @@ int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey)
     *rk++ = *rrk++;
     *rk   = *rrk;
 
+    skey->aesni = 0;
+#if defined(_M_IX86) || defined(_M_AMD64)
+    if (use_aesni()) {
+        /* The AES-NI instructions take the round keys as plain bytes */
+        for (i = 0; i < (skey->Nr + 1) * 4; i++) {
+            temp = skey->eK[i];
+            STORE32H(temp, (unsigned char *)&skey->eK[i]);
+            temp = skey->dK[i];
+            STORE32H(temp, (unsigned char *)&skey->dK[i]);
+        }
+        skey->aesni = 1;
+    }
+#endif
+
     return CRYPT_OK;
 }
 
@@ -1066,6 +1095,13 @@ void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#if defined(_M_IX86) || defined(_M_AMD64)
+    if (skey->aesni) {
+        aesni_ecb_encrypt(pt, ct, skey->eK, skey->Nr);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->eK;
 
@@ -1167,6 +1203,13 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#if defined(_M_IX86) || defined(_M_AMD64)
+    if (skey->aesni) {
+        aesni_ecb_decrypt(ct, pt, skey->dK, skey->Nr);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->dK;
 
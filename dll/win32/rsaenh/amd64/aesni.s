@@ -0,0 +1,88 @@
+/*
+ * PROJECT:     ReactOS Cryptographic Provider
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     AES block encryption using the AES-NI instructions
+ */
+
+#include <asm.inc>
+
+/*
+ * The round keys are the ones computed by aes_setup, stored in memory byte
+ * order. The decryption keys already form the equivalent inverse cipher
+ * schedule that aesdec expects.
+ */
+
+.code64
+
+PUBLIC aesni_is_supported
+PUBLIC aesni_ecb_encrypt
+PUBLIC aesni_ecb_decrypt
+
+/*
+ * int aesni_is_supported(void)
+ */
+FUNC aesni_is_supported
+    .ENDPROLOG
+
+    /* CPUID clobbers rbx, which is non-volatile */
+    mov r8, rbx
+    mov eax, 1
+    cpuid
+    mov rbx, r8
+
+    /* CPUID.1:ECX.AESNI[bit 25] */
+    mov eax, ecx
+    shr eax, 25
+    and eax, 1
+    ret
+ENDFUNC
+
+/*
+ * void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct,
+ *                        const ulong32 *rk, int Nr)
+ */
+FUNC aesni_ecb_encrypt
+    .ENDPROLOG
+    movdqu xmm0, [rcx]
+    movdqu xmm1, [r8]
+    pxor xmm0, xmm1
+    dec r9d
+
+.Lenc_loop:
+    add r8, 16
+    movdqu xmm1, [r8]
+    aesenc xmm0, xmm1
+    dec r9d
+    jnz .Lenc_loop
+
+    movdqu xmm1, [r8 + 16]
+    aesenclast xmm0, xmm1
+    movdqu [rdx], xmm0
+    ret
+ENDFUNC
+
+/*
+ * void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt,
+ *                        const ulong32 *rk, int Nr)
+ */
+FUNC aesni_ecb_decrypt
+    .ENDPROLOG
+    movdqu xmm0, [rcx]
+    movdqu xmm1, [r8]
+    pxor xmm0, xmm1
+    dec r9d
+
+.Ldec_loop:
+    add r8, 16
+    movdqu xmm1, [r8]
+    aesdec xmm0, xmm1
+    dec r9d
+    jnz .Ldec_loop
+
+    movdqu xmm1, [r8 + 16]
+    aesdeclast xmm0, xmm1
+    movdqu [rdx], xmm0
+    ret
+ENDFUNC
+
+END
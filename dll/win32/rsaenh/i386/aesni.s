@@ -0,0 +1,109 @@
+/*
+ * PROJECT:     ReactOS Cryptographic Provider
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     AES block encryption using the AES-NI instructions
+ */
+
+#include <asm.inc>
+#include <ks386.inc>
+
+/*
+ * The round keys are the ones computed by aes_setup, stored in memory byte
+ * order. The decryption keys already form the equivalent inverse cipher
+ * schedule that aesdec expects.
+ */
+
+#define PF_XMMI64_INSTRUCTIONS_AVAILABLE 10
+#define USER_SHARED_DATA HEX(7FFE0000)
+
+PUBLIC _aesni_is_supported
+PUBLIC _aesni_ecb_encrypt
+PUBLIC _aesni_ecb_decrypt
+.code
+
+/*
+ * int aesni_is_supported(void)
+ */
+FUNC _aesni_is_supported
+    FPO 0, 0, 0, 0, 0, FRAME_FPO
+
+    /* SSE2 means both CPUID and an OS saving the XMM registers */
+    xor eax, eax
+    cmp byte ptr ds:[USER_SHARED_DATA + UsProcessorFeatures + PF_XMMI64_INSTRUCTIONS_AVAILABLE], 0
+    je .Lsupported_done
+
+    push ebx
+    mov eax, 1
+    cpuid
+    pop ebx
+
+    /* CPUID.1:ECX.AESNI[bit 25] */
+    mov eax, ecx
+    shr eax, 25
+    and eax, 1
+
+.Lsupported_done:
+    ret
+ENDFUNC
+
+/*
+ * void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct,
+ *                        const ulong32 *rk, int Nr)
+ */
+FUNC _aesni_ecb_encrypt
+    FPO 0, 4, 0, 0, 0, FRAME_FPO
+    mov edx, [esp + 4]
+    mov eax, [esp + 12]
+    mov ecx, [esp + 16]
+
+    movdqu xmm0, [edx]
+    movdqu xmm1, [eax]
+    pxor xmm0, xmm1
+    dec ecx
+
+.Lenc_loop:
+    add eax, 16
+    movdqu xmm1, [eax]
+    aesenc xmm0, xmm1
+    dec ecx
+    jnz .Lenc_loop
+
+    movdqu xmm1, [eax + 16]
+    aesenclast xmm0, xmm1
+
+    mov edx, [esp + 8]
+    movdqu [edx], xmm0
+    ret
+ENDFUNC
+
+/*
+ * void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt,
+ *                        const ulong32 *rk, int Nr)
+ */
+FUNC _aesni_ecb_decrypt
+    FPO 0, 4, 0, 0, 0, FRAME_FPO
+    mov edx, [esp + 4]
+    mov eax, [esp + 12]
+    mov ecx, [esp + 16]
+
+    movdqu xmm0, [edx]
+    movdqu xmm1, [eax]
+    pxor xmm0, xmm1
+    dec ecx
+
+.Ldec_loop:
+    add eax, 16
+    movdqu xmm1, [eax]
+    aesdec xmm0, xmm1
+    dec ecx
+    jnz .Ldec_loop
+
+    movdqu xmm1, [eax + 16]
+    aesdeclast xmm0, xmm1
+
+    mov edx, [esp + 8]
+    movdqu [edx], xmm0
+    ret
+ENDFUNC
+
+END
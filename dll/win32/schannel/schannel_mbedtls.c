@@ -52,6 +52,8 @@ WINE_DEFAULT_DEBUG_CHANNEL(schannel);
 #define ROS_SCHAN_IS_BLOCKING_MARSHALL(read_len) ((read_len & 0x000FFFFF) |  0xCCC00000)
 #define ROS_SCHAN_IS_BLOCKING_RETRIEVE(read_len)  (read_len & 0x000FFFFF)
 
+static void schan_session_cache_free(void);
+
 #ifndef __REACTOS__
  /* WINE defines the back-end glue in here */
  #include "secur32_priv.h"
@@ -75,8 +77,148 @@ typedef struct
     mbedtls_entropy_context  entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
     struct schan_transport  *transport;
+    char                    *target;
+    BOOL                     session_cached;
 } MBEDTLS_SESSION, *PMBEDTLS_SESSION;
 
+/* process-wide cache of the client sessions, so that reconnecting to the same
+   server resumes the previous session (by id or ticket) instead of doing a full
+   handshake with its public key operations every time */
+#define SCHAN_SESSION_CACHE_SIZE 16
+
+typedef struct
+{
+    char                *target;
+    mbedtls_ssl_session  session;
+    DWORD                last_used;
+} SCHAN_CACHED_SESSION;
+
+static SCHAN_CACHED_SESSION session_cache[SCHAN_SESSION_CACHE_SIZE];
+
+static CRITICAL_SECTION session_cache_cs;
+static CRITICAL_SECTION_DEBUG session_cache_cs_debug =
+{
+    0, 0, &session_cache_cs,
+    { &session_cache_cs_debug.ProcessLocksList, &session_cache_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": session_cache_cs") }
+};
+static CRITICAL_SECTION session_cache_cs = { &session_cache_cs_debug, -1, 0, 0, 0, 0 };
+
+/* must be called with session_cache_cs held */
+static SCHAN_CACHED_SESSION *schan_session_cache_find(const char *target)
+{
+    unsigned int i;
+
+    for (i = 0; i < SCHAN_SESSION_CACHE_SIZE; i++)
+    {
+        if (session_cache[i].target && !strcmp(session_cache[i].target, target))
+            return &session_cache[i];
+    }
+
+    return NULL;
+}
+
+static void schan_session_cache_remove_entry(SCHAN_CACHED_SESSION *entry)
+{
+    mbedtls_ssl_session_free(&entry->session);
+    HeapFree(GetProcessHeap(), 0, entry->target);
+    entry->target = NULL;
+}
+
+static void schan_session_cache_load(MBEDTLS_SESSION *s)
+{
+    SCHAN_CACHED_SESSION *entry;
+
+    EnterCriticalSection(&session_cache_cs);
+
+    if ((entry = schan_session_cache_find(s->target)))
+    {
+        TRACE("MBEDTLS resuming the cached session for %s\n", s->target);
+
+        if (mbedtls_ssl_set_session(&s->ssl, &entry->session) == 0)
+            entry->last_used = GetTickCount();
+        else
+            schan_session_cache_remove_entry(entry);
+    }
+
+    LeaveCriticalSection(&session_cache_cs);
+}
+
+static void schan_session_cache_store(MBEDTLS_SESSION *s)
+{
+    SCHAN_CACHED_SESSION *entry;
+    mbedtls_ssl_session session;
+    char *target;
+    DWORD now = GetTickCount();
+    unsigned int i;
+
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_get_session(&s->ssl, &session) != 0)
+    {
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+
+    if (!(target = HeapAlloc(GetProcessHeap(), 0, strlen(s->target) + 1)))
+    {
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+    strcpy(target, s->target);
+
+    EnterCriticalSection(&session_cache_cs);
+
+    /* replace the previous session of this server, a free slot or the least recently used one */
+    if (!(entry = schan_session_cache_find(target)))
+    {
+        entry = &session_cache[0];
+        for (i = 0; i < SCHAN_SESSION_CACHE_SIZE && entry->target; i++)
+        {
+            if (!session_cache[i].target ||
+                (now - session_cache[i].last_used) > (now - entry->last_used))
+            {
+                entry = &session_cache[i];
+            }
+        }
+    }
+
+    if (entry->target)
+        schan_session_cache_remove_entry(entry);
+
+    entry->target    = target;
+    entry->session   = session;
+    entry->last_used = now;
+
+    LeaveCriticalSection(&session_cache_cs);
+}
+
+static void schan_session_cache_forget(MBEDTLS_SESSION *s)
+{
+    SCHAN_CACHED_SESSION *entry;
+
+    EnterCriticalSection(&session_cache_cs);
+
+    if ((entry = schan_session_cache_find(s->target)))
+        schan_session_cache_remove_entry(entry);
+
+    LeaveCriticalSection(&session_cache_cs);
+}
+
+static void schan_session_cache_free(void)
+{
+    unsigned int i;
+
+    EnterCriticalSection(&session_cache_cs);
+
+    for (i = 0; i < SCHAN_SESSION_CACHE_SIZE; i++)
+    {
+        if (session_cache[i].target)
+            schan_session_cache_remove_entry(&session_cache[i]);
+    }
+
+    LeaveCriticalSection(&session_cache_cs);
+}
+
 /* custom `net_recv` callback adapter, mbedTLS uses it in mbedtls_ssl_read for
    pulling data from the underlying win32 net stack */
 static int schan_pull_adapter(void *session, unsigned char *buff, size_t buff_len)
@@ -228,6 +370,11 @@ BOOL schan_imp_create_session(schan_imp_session *session, schan_credentials *cre
     TRACE("MBEDTLS set dbg\n");
     mbedtls_ssl_conf_dbg(&s->conf, schan_imp_debug, stdout);
 
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    TRACE("MBEDTLS enable session tickets\n");
+    mbedtls_ssl_conf_session_tickets(&s->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
     TRACE("MBEDTLS setup\n");
     mbedtls_ssl_setup(&s->ssl, &s->conf);
 
@@ -248,6 +395,8 @@ void schan_imp_dispose_session(schan_imp_session session)
     mbedtls_entropy_free(&s->entropy);
     mbedtls_ssl_config_free(&s->conf);
 
+    HeapFree(GetProcessHeap(), 0, s->target);
+
     /* safely overwrite the freed context with zeroes */
     HeapFree(GetProcessHeap(), HEAP_ZERO_MEMORY, s);
 }
@@ -273,6 +422,16 @@ void schan_imp_set_session_target(schan_imp_session session, const char *target)
      * sends a non-fatal alert which preemptively forces mbedTLS to close connection. */
 
     mbedtls_ssl_set_hostname(&s->ssl, target);
+
+    /* only clients can resume a session */
+    if (!target || s->conf.endpoint != MBEDTLS_SSL_IS_CLIENT || s->target)
+        return;
+
+    if ((s->target = HeapAlloc(GetProcessHeap(), 0, strlen(target) + 1)))
+    {
+        strcpy(s->target, target);
+        schan_session_cache_load(s);
+    }
 }
 
 SECURITY_STATUS schan_imp_handshake(schan_imp_session session)
@@ -296,12 +455,24 @@ SECURITY_STATUS schan_imp_handshake(schan_imp_session session)
     else if (err != 0)
     {
         ERR("schan_imp_handshake: Oops! mbedtls_ssl_handshake returned the following error code: -%#x...\n", -err);
+
+        /* do not try to resume a session the server may have rejected again */
+        if (s->target)
+            schan_session_cache_forget(s);
+
         return SEC_E_INTERNAL_ERROR;
     }
 
     WARN("schan_imp_handshake: Handshake completed!\n");
     WARN("schan_imp_handshake: Protocol is %s, Cipher suite is %s\n", mbedtls_ssl_get_version(&s->ssl),
                                                                       mbedtls_ssl_get_ciphersuite(&s->ssl));
+
+    if (s->target && !s->session_cached)
+    {
+        schan_session_cache_store(s);
+        s->session_cached = TRUE;
+    }
+
     return SEC_E_OK;
 }
 
@@ -720,6 +891,7 @@ BOOL schan_imp_init(void)
 void schan_imp_deinit(void)
 {
     WARN("Schannel MBEDTLS schan_imp_deinit\n");
+    schan_session_cache_free();
 }
 
 #endif /* SONAME_LIBMBEDTLS && !HAVE_SECURITY_SECURITY_H && !SONAME_LIBGNUTLS */
\ No newline at end of file
@@ -53,6 +53,11 @@ MAKE_FUNCPTR(mbedtls_ssl_config_free)
 MAKE_FUNCPTR(mbedtls_ssl_config_defaults)
 MAKE_FUNCPTR(mbedtls_ssl_conf_dbg)
 MAKE_FUNCPTR(mbedtls_ssl_setup)
+MAKE_FUNCPTR(mbedtls_ssl_conf_session_tickets)
+MAKE_FUNCPTR(mbedtls_ssl_get_session)
+MAKE_FUNCPTR(mbedtls_ssl_set_session)
+MAKE_FUNCPTR(mbedtls_ssl_session_init)
+MAKE_FUNCPTR(mbedtls_ssl_session_free)
 MAKE_FUNCPTR(mbedtls_cipher_info_from_type)
 MAKE_FUNCPTR(mbedtls_md_info_from_type)
 MAKE_FUNCPTR(mbedtls_pk_get_bitlen)
@@ -108,6 +113,11 @@ BOOL schan_imp_init(void)
     LOAD_FUNCPTR(mbedtls_ssl_config_defaults)
     LOAD_FUNCPTR(mbedtls_ssl_conf_dbg)
     LOAD_FUNCPTR(mbedtls_ssl_setup)
+    LOAD_FUNCPTR(mbedtls_ssl_conf_session_tickets)
+    LOAD_FUNCPTR(mbedtls_ssl_get_session)
+    LOAD_FUNCPTR(mbedtls_ssl_set_session)
+    LOAD_FUNCPTR(mbedtls_ssl_session_init)
+    LOAD_FUNCPTR(mbedtls_ssl_session_free)
     LOAD_FUNCPTR(mbedtls_cipher_info_from_type)
     LOAD_FUNCPTR(mbedtls_md_info_from_type)
     LOAD_FUNCPTR(mbedtls_pk_get_bitlen)
@@ -127,6 +137,7 @@ fail:
 
 void schan_imp_deinit(void)
 {
+    schan_session_cache_free();
     wine_dlclose(libmbedtls_handle, NULL, 0);
     libmbedtls_handle = NULL;
 }
@@ -168,6 +179,11 @@ void schan_imp_deinit(void)
 #define mbedtls_ssl_config_defaults     pmbedtls_ssl_config_defaults
 #define mbedtls_ssl_conf_dbg            pmbedtls_ssl_conf_dbg
 #define mbedtls_ssl_setup               pmbedtls_ssl_setup
+#define mbedtls_ssl_conf_session_tickets pmbedtls_ssl_conf_session_tickets
+#define mbedtls_ssl_get_session         pmbedtls_ssl_get_session
+#define mbedtls_ssl_set_session         pmbedtls_ssl_set_session
+#define mbedtls_ssl_session_init        pmbedtls_ssl_session_init
+#define mbedtls_ssl_session_free        pmbedtls_ssl_session_free
 #define mbedtls_cipher_info_from_type   pmbedtls_cipher_info_from_type      
 #define mbedtls_md_info_from_type       pmbedtls_md_info_from_type
 #define mbedtls_pk_get_bitlen           pmbedtls_pk_get_bitlen
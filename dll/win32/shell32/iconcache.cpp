@@ -26,17 +26,56 @@ WINE_DEFAULT_DEBUG_CHANNEL(shell);
 
 #define INVALID_INDEX -1
 
-typedef struct
+typedef struct _SIC_ENTRY
 {
     LPWSTR sSourceFile;    /* file (not path!) containing the icon */
     DWORD dwSourceIndex;    /* index within the file, if it is a resoure ID it will be negated */
     DWORD dwListIndex;    /* index within the iconlist */
     DWORD dwFlags;        /* GIL_* flags */
     DWORD dwAccessTime;
+    FILETIME ftLastWrite;   /* of the file, when the icon was extracted */
+    BOOL bUnverified;       /* loaded from the database, file not checked yet */
+    struct _SIC_ENTRY *pNext; /* next entry in the same hash bucket */
 } SIC_ENTRY, * LPSIC_ENTRY;
 
+/* sic_hdpa owns the entries, sic_hash finds them */
 static HDPA        sic_hdpa = 0;
 
+#define SIC_HASH_SIZE 512
+static LPSIC_ENTRY sic_hash[SIC_HASH_SIZE];
+
+/* The cache is saved in the icon database when a process is done with
+ * shell32, and loaded back by the next one, so that icons don't need to be
+ * extracted again from every file each session.
+ */
+#define SIC_DB_MAGIC   0x42444349 /* ICDB */
+#define SIC_DB_VERSION 1
+
+typedef struct
+{
+    DWORD dwMagic;
+    DWORD dwVersion;
+    DWORD dwCount;
+    DWORD dwIlMask;
+    INT cxSmall, cySmall;
+    INT cxLarge, cyLarge;
+} SIC_DB_HEADER;
+
+/* Followed by cchSourceFile characters, then the next entry. The small and
+ * big image lists follow the last entry.
+ */
+typedef struct
+{
+    DWORD dwSourceIndex;
+    DWORD dwListIndex;
+    DWORD dwFlags;
+    FILETIME ftLastWrite;
+    DWORD cchSourceFile;
+} SIC_DB_ENTRY;
+
+static SIC_DB_HEADER sic_dbheader;
+static BOOL sic_dirty;
+
 static HIMAGELIST ShellSmallIconList;
 static HIMAGELIST ShellBigIconList;
 
@@ -56,7 +95,7 @@ CRITICAL_SECTION SHELL32_SicCS = { &critsect_debug, -1, 0, 0, 0, 0 };
  * SIC_CompareEntries
  *
  * NOTES
- *  Callback for DPA_Search
+ *  Tells whether two entries are for the same icon
  */
 static INT CALLBACK SIC_CompareEntries( LPVOID p1, LPVOID p2, LPARAM lparam)
 {    LPSIC_ENTRY e1 = (LPSIC_ENTRY)p1, e2 = (LPSIC_ENTRY)p2;
@@ -77,6 +116,68 @@ static INT CALLBACK SIC_CompareEntries( LPVOID p1, LPVOID p2, LPARAM lparam)
     return wcsicmp(e1->sSourceFile,e2->sSourceFile);
 }
 
+/*****************************************************************************
+ * SIC_HashEntry
+ *
+ * NOTES
+ *  Hashes what SIC_CompareEntries compares, ignoring the case of the file
+ */
+static UINT SIC_HashEntry(LPSIC_ENTRY e)
+{
+    UINT hash = e->dwSourceIndex ^ ((e->dwFlags & GIL_FORSHORTCUT) ? 0x9e3779b9 : 0);
+    LPCWSTR p;
+
+    for (p = e->sSourceFile; *p; p++)
+        hash = hash * 31 + towlower(*p);
+
+    return hash % SIC_HASH_SIZE;
+}
+
+/* The cache lock MUST be held while calling the functions below */
+static LPSIC_ENTRY SIC_FindEntry(LPSIC_ENTRY key)
+{
+    LPSIC_ENTRY e;
+
+    for (e = sic_hash[SIC_HashEntry(key)]; e; e = e->pNext)
+    {
+        if (SIC_CompareEntries(e, key, 0) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void SIC_LinkEntry(LPSIC_ENTRY e)
+{
+    UINT hash = SIC_HashEntry(e);
+
+    e->pNext = sic_hash[hash];
+    sic_hash[hash] = e;
+}
+
+static void SIC_UnlinkEntry(LPSIC_ENTRY e)
+{
+    LPSIC_ENTRY *pp;
+
+    for (pp = &sic_hash[SIC_HashEntry(e)]; *pp; pp = &(*pp)->pNext)
+    {
+        if (*pp == e)
+        {
+            *pp = e->pNext;
+            break;
+        }
+    }
+}
+
+static void SIC_GetFileTime(LPCWSTR sSourceFile, FILETIME *pft)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (GetFileAttributesExW(sSourceFile, GetFileExInfoStandard, &data))
+        *pft = data.ftLastWriteTime;
+    else
+        ZeroMemory(pft, sizeof(*pft));
+}
+
 /* declare SIC_LoadOverlayIcon() */
 static int SIC_LoadOverlayIcon(int icon_idx);
 
@@ -338,11 +439,26 @@ static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallI
 
     lpsice->dwSourceIndex = dwSourceIndex;
     lpsice->dwFlags = dwFlags;
+    lpsice->bUnverified = FALSE;
+    SIC_GetFileTime(path, &lpsice->ftLastWrite);
 
     EnterCriticalSection(&SHELL32_SicCS);
 
-    indexDPA = DPA_Search (sic_hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED|DPAS_INSERTAFTER);
-    indexDPA = DPA_InsertPtr(sic_hdpa, indexDPA, lpsice);
+    /* Icons are extracted outside of the lock, another thread may have
+     * added this one in the meantime */
+    {
+        LPSIC_ENTRY existing = SIC_FindEntry(lpsice);
+        if (existing)
+        {
+            ret = existing->dwListIndex;
+            HeapFree(GetProcessHeap(), 0, lpsice->sSourceFile);
+            SHFree(lpsice);
+            LeaveCriticalSection(&SHELL32_SicCS);
+            return ret;
+        }
+    }
+
+    indexDPA = DPA_InsertPtr(sic_hdpa, DPA_GetPtrCount(sic_hdpa), lpsice);
     if ( -1 == indexDPA )
     {
         ret = INVALID_INDEX;
@@ -370,6 +486,8 @@ static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallI
     }
     lpsice->dwListIndex = index;
     ret = lpsice->dwListIndex;
+    SIC_LinkEntry(lpsice);
+    sic_dirty = TRUE;
 
 leave:
     if(ret == INVALID_INDEX)
@@ -443,8 +561,10 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
 INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
 {
     SIC_ENTRY sice;
-    INT ret, index = INVALID_INDEX;
+    LPSIC_ENTRY found;
+    INT ret = INVALID_INDEX;
     WCHAR path[MAX_PATH];
+    FILETIME ft;
 
     TRACE("%s %i\n", debugstr_w(sSourceFile), dwSourceIndex);
 
@@ -458,26 +578,254 @@ INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
 
     EnterCriticalSection(&SHELL32_SicCS);
 
-    if (NULL != DPA_GetPtr (sic_hdpa, 0))
-    {
-      /* search linear from position 0*/
-      index = DPA_Search (sic_hdpa, &sice, 0, SIC_CompareEntries, 0, DPAS_SORTED);
-    }
+    found = SIC_FindEntry(&sice);
 
-    if ( INVALID_INDEX == index )
+    /* An icon from the database is only good if its file didn't change */
+    if (found && found->bUnverified)
     {
-          ret = SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
+        SIC_GetFileTime(path, &ft);
+        if (CompareFileTime(&ft, &found->ftLastWrite) != 0)
+        {
+            TRACE("-- %s changed\n", debugstr_w(path));
+            SIC_UnlinkEntry(found);
+            DPA_DeletePtr(sic_hdpa, DPA_GetPtrIndex(sic_hdpa, found));
+            HeapFree(GetProcessHeap(), 0, found->sSourceFile);
+            SHFree(found);
+            found = NULL;
+            sic_dirty = TRUE;
+        }
+        else
+        {
+            found->bUnverified = FALSE;
+        }
     }
-    else
+
+    if (found)
     {
-      TRACE("-- found\n");
-      ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, index))->dwListIndex;
+        TRACE("-- found\n");
+        ret = found->dwListIndex;
     }
 
     LeaveCriticalSection(&SHELL32_SicCS);
+
+    /* Don't hold up the other lookups while extracting */
+    if (!found)
+        ret = SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
+
     return ret;
 }
 
+/*****************************************************************************
+ * SIC_GetDatabasePath            [internal]
+ */
+static BOOL SIC_GetDatabasePath(LPWSTR path)
+{
+    if (FAILED(SHGetFolderPathW(NULL, CSIDL_LOCAL_APPDATA, NULL, SHGFP_TYPE_CURRENT, path)))
+        return FALSE;
+
+    return PathAppendW(path, L"IconCache.db");
+}
+
+/*****************************************************************************
+ * SIC_LoadDatabase            [internal]
+ *
+ * NOTES
+ *  Loads the cache saved by SIC_SaveDatabase, if it was made for the current
+ *  icon sizes and color depth. Its entries are checked against their file
+ *  the first time they are looked up.
+ */
+static BOOL SIC_LoadDatabase(void)
+{
+    WCHAR path[MAX_PATH];
+    CComPtr<IStream> stream;
+    SIC_DB_HEADER header;
+    SIC_DB_ENTRY dbentry;
+    LPSIC_ENTRY *entries = NULL;
+    HIMAGELIST hSmall = NULL, hBig = NULL;
+    DWORD i, count = 0;
+    ULONG read;
+    BOOL result = FALSE;
+
+    if (!SIC_GetDatabasePath(path))
+        return FALSE;
+
+    if (FAILED(SHCreateStreamOnFileW(path, STGM_READ | STGM_SHARE_DENY_WRITE, &stream)))
+        return FALSE;
+
+    if (FAILED(stream->Read(&header, sizeof(header), &read)) || read != sizeof(header) ||
+        header.dwMagic != SIC_DB_MAGIC || header.dwVersion != SIC_DB_VERSION ||
+        header.dwIlMask != sic_dbheader.dwIlMask ||
+        header.cxSmall != sic_dbheader.cxSmall || header.cySmall != sic_dbheader.cySmall ||
+        header.cxLarge != sic_dbheader.cxLarge || header.cyLarge != sic_dbheader.cyLarge ||
+        header.dwCount == 0 || header.dwCount > 0x10000)
+    {
+        return FALSE;
+    }
+
+    entries = (LPSIC_ENTRY *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, header.dwCount * sizeof(*entries));
+    if (!entries)
+        return FALSE;
+
+    for (count = 0; count < header.dwCount; count++)
+    {
+        LPSIC_ENTRY e;
+
+        if (FAILED(stream->Read(&dbentry, sizeof(dbentry), &read)) || read != sizeof(dbentry) ||
+            dbentry.cchSourceFile == 0 || dbentry.cchSourceFile >= MAX_PATH)
+        {
+            goto end;
+        }
+
+        e = (LPSIC_ENTRY)SHAlloc(sizeof(SIC_ENTRY));
+        if (!e)
+            goto end;
+        e->sSourceFile = (LPWSTR)HeapAlloc(GetProcessHeap(), 0, (dbentry.cchSourceFile + 1) * sizeof(WCHAR));
+        if (!e->sSourceFile)
+        {
+            SHFree(e);
+            goto end;
+        }
+        entries[count] = e;
+
+        if (FAILED(stream->Read(e->sSourceFile, dbentry.cchSourceFile * sizeof(WCHAR), &read)) ||
+            read != dbentry.cchSourceFile * sizeof(WCHAR))
+        {
+            count++;
+            goto end;
+        }
+        e->sSourceFile[dbentry.cchSourceFile] = UNICODE_NULL;
+        e->dwSourceIndex = dbentry.dwSourceIndex;
+        e->dwListIndex = dbentry.dwListIndex;
+        e->dwFlags = dbentry.dwFlags;
+        e->dwAccessTime = 0;
+        e->ftLastWrite = dbentry.ftLastWrite;
+        e->bUnverified = TRUE;
+        e->pNext = NULL;
+    }
+
+    hSmall = ImageList_Read(stream);
+    hBig = ImageList_Read(stream);
+    if (!hSmall || !hBig ||
+        ImageList_GetImageCount(hSmall) != ImageList_GetImageCount(hBig))
+    {
+        goto end;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (entries[i]->dwListIndex >= (DWORD)ImageList_GetImageCount(hSmall))
+            goto end;
+    }
+
+    /* Everything is consistent, take it */
+    for (i = 0; i < count; i++)
+    {
+        if (DPA_InsertPtr(sic_hdpa, DPA_GetPtrCount(sic_hdpa), entries[i]) == -1)
+            goto end;
+        SIC_LinkEntry(entries[i]);
+        entries[i] = NULL;
+    }
+
+    ShellSmallIconList = hSmall;
+    ShellBigIconList = hBig;
+    hSmall = hBig = NULL;
+    result = TRUE;
+
+    TRACE("loaded %u icons from %s\n", count, debugstr_w(path));
+
+end:
+    for (i = 0; i < count; i++)
+    {
+        if (entries[i])
+        {
+            HeapFree(GetProcessHeap(), 0, entries[i]->sSourceFile);
+            SHFree(entries[i]);
+        }
+    }
+    HeapFree(GetProcessHeap(), 0, entries);
+    if (hSmall) ImageList_Destroy(hSmall);
+    if (hBig) ImageList_Destroy(hBig);
+
+    if (!result)
+    {
+        /* Undo what was taken before failing */
+        while (DPA_GetPtrCount(sic_hdpa))
+        {
+            LPSIC_ENTRY e = (LPSIC_ENTRY)DPA_DeletePtr(sic_hdpa, 0);
+            SIC_UnlinkEntry(e);
+            HeapFree(GetProcessHeap(), 0, e->sSourceFile);
+            SHFree(e);
+        }
+    }
+
+    return result;
+}
+
+/*****************************************************************************
+ * SIC_SaveDatabase            [internal]
+ *
+ * NOTES
+ *  The database is written to a temporary file first, so that a process
+ *  loading it never sees it half written.
+ */
+static void SIC_SaveDatabase(void)
+{
+    WCHAR path[MAX_PATH], temp[MAX_PATH];
+    SIC_DB_HEADER header;
+    SIC_DB_ENTRY dbentry;
+    INT i;
+    BOOL result = FALSE;
+
+    if (!SIC_GetDatabasePath(path) ||
+        FAILED(StringCchPrintfW(temp, _countof(temp), L"%s.%lx", path, GetCurrentProcessId())))
+    {
+        return;
+    }
+
+    {
+        CComPtr<IStream> stream;
+
+        if (FAILED(SHCreateStreamOnFileW(temp, STGM_WRITE | STGM_CREATE | STGM_SHARE_EXCLUSIVE, &stream)))
+            return;
+
+        header = sic_dbheader;
+        header.dwCount = DPA_GetPtrCount(sic_hdpa);
+        if (FAILED(stream->Write(&header, sizeof(header), NULL)))
+            goto end;
+
+        for (i = 0; i < DPA_GetPtrCount(sic_hdpa); i++)
+        {
+            LPSIC_ENTRY e = (LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, i);
+
+            dbentry.dwSourceIndex = e->dwSourceIndex;
+            dbentry.dwListIndex = e->dwListIndex;
+            dbentry.dwFlags = e->dwFlags;
+            dbentry.ftLastWrite = e->ftLastWrite;
+            dbentry.cchSourceFile = wcslen(e->sSourceFile);
+            if (FAILED(stream->Write(&dbentry, sizeof(dbentry), NULL)) ||
+                FAILED(stream->Write(e->sSourceFile, dbentry.cchSourceFile * sizeof(WCHAR), NULL)))
+            {
+                goto end;
+            }
+        }
+
+        if (!ImageList_Write(ShellSmallIconList, stream) ||
+            !ImageList_Write(ShellBigIconList, stream))
+        {
+            goto end;
+        }
+
+        result = TRUE;
+    }
+
+end:
+    if (!result || !MoveFileExW(temp, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("failed to save the icon cache\n");
+        DeleteFileW(temp);
+    }
+}
+
 /*****************************************************************************
  * SIC_Initialize            [internal]
  */
@@ -535,6 +883,21 @@ BOOL SIC_Initialize(void)
     cx_large = GetSystemMetrics(SM_CXICON);
     cy_large = GetSystemMetrics(SM_CYICON);
 
+    sic_dbheader.dwMagic = SIC_DB_MAGIC;
+    sic_dbheader.dwVersion = SIC_DB_VERSION;
+    sic_dbheader.dwIlMask = ilMask;
+    sic_dbheader.cxSmall = cx_small;
+    sic_dbheader.cySmall = cy_small;
+    sic_dbheader.cxLarge = cx_large;
+    sic_dbheader.cyLarge = cy_large;
+
+    /* Start from the icons of the previous session, if they are usable */
+    if (SIC_LoadDatabase())
+    {
+        result = TRUE;
+        goto end;
+    }
+
     ShellSmallIconList = ImageList_Create(cx_small,
                                           cy_small,
                                           ilMask,
@@ -604,6 +967,7 @@ end:
     /* Clean everything if something went wrong */
     if(!result)
     {
+        ZeroMemory(sic_hash, sizeof(sic_hash));
         if(sic_hdpa) DPA_Destroy(sic_hdpa);
         if(ShellSmallIconList) ImageList_Destroy(ShellSmallIconList);
         if(ShellBigIconList) ImageList_Destroy(ShellSmallIconList);
@@ -635,9 +999,13 @@ void SIC_Destroy(void)
 
     EnterCriticalSection(&SHELL32_SicCS);
 
+    if (sic_hdpa && sic_dirty) SIC_SaveDatabase();
+    sic_dirty = FALSE;
+
     if (sic_hdpa) DPA_DestroyCallback(sic_hdpa, sic_free, NULL );
 
     sic_hdpa = NULL;
+    ZeroMemory(sic_hash, sizeof(sic_hash));
     ImageList_Destroy(ShellSmallIconList);
     ShellSmallIconList = 0;
     ImageList_Destroy(ShellBigIconList);
@@ -100,6 +100,10 @@ typedef struct _TCATALOG
     HKEY CatalogKey;
     CRITICAL_SECTION Lock;
     BOOLEAN Initialized;
+    struct _TCATALOG_ENTRY *LastTripletEntry;
+    INT LastAf;
+    INT LastType;
+    INT LastProtocol;
 } TCATALOG, *PTCATALOG;
 
 typedef struct _NSPROVIDER
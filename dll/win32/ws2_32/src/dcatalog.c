@@ -495,6 +495,21 @@ WsTcGetEntryFromTriplet(IN PTCATALOG Catalog,
     /* Lock the catalog */
     WsTcLock();
 
+    /* Applications keep asking for the same triplet, check the last match */
+    if (!StartId && Catalog->LastTripletEntry &&
+        Catalog->LastAf == af &&
+        Catalog->LastType == type &&
+        Catalog->LastProtocol == protocol)
+    {
+        /* Reference the entry and return it */
+        Entry = Catalog->LastTripletEntry;
+        InterlockedIncrement(&Entry->RefCount);
+        *CatalogEntry = Entry;
+
+        WsTcUnlock();
+        return ERROR_SUCCESS;
+    }
+
     NextEntry = Catalog->ProtocolList.Flink;
 
     /* Check if we are starting past 0 */
@@ -545,6 +560,15 @@ WsTcGetEntryFromTriplet(IN PTCATALOG Catalog,
                     InterlockedIncrement(&Entry->RefCount);
                     *CatalogEntry = Entry;
                     ErrorCode = ERROR_SUCCESS;
+
+                    /* Remember it for the next lookup of this triplet */
+                    if (!StartId)
+                    {
+                        Catalog->LastTripletEntry = Entry;
+                        Catalog->LastAf = af;
+                        Catalog->LastType = type;
+                        Catalog->LastProtocol = protocol;
+                    }
                     break;
                 }
                 else
@@ -671,6 +695,9 @@ WsTcUpdateProtocolList(IN PTCATALOG Catalog,
     PTCATALOG_ENTRY CatalogEntry, OldCatalogEntry;
     PLIST_ENTRY Entry;
 
+    /* Entries may go away, forget the last triplet match */
+    Catalog->LastTripletEntry = NULL;
+
     /* First move from our list to the old one */
     InsertHeadList(&Catalog->ProtocolList, &TempList);
     RemoveEntryList(&Catalog->ProtocolList);
@@ -853,6 +880,9 @@ WsTcRemoveCatalogItem(IN PTCATALOG Catalog,
     /* Remove the entry from the list */
     RemoveEntryList(&Entry->CatalogLink);
 
+    /* Don't hand it out from the triplet cache anymore */
+    if (Catalog->LastTripletEntry == Entry) Catalog->LastTripletEntry = NULL;
+
     /* Decrease our count */
     Catalog->ItemCount--;
 }
@@ -145,12 +145,63 @@ DisplayCharacter(IN CHAR Character,
     PUCHAR FontChar, PixelPtr;
     ULONG Height;
     UCHAR Shift;
-
-    PrepareForSetPixel();
+    UCHAR Inverted;
 
     /* Calculate shift */
     Shift = Left & 7;
 
+    /*
+     * An opaque, byte aligned character covers whole bytes, so write it in
+     * write mode 0 and let set/reset supply the planes where the text and
+     * background colors agree. The remaining planes take the font bits (or
+     * their inverse) straight from the CPU, which gets rid of the bit mask
+     * programming and of the second pass over the rows.
+     */
+    if (!Shift && BackColor < 16)
+    {
+        /* Planes where the text color bit is clear but the background one is set */
+        Inverted = (UCHAR)(~TextColor & BackColor & 0xF);
+
+        ReadWriteMode(0);
+        __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, 0xFF00 | IND_BIT_MASK);
+        __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, (BackColor << 8) | IND_SET_RESET);
+        __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT,
+                ((~(TextColor ^ BackColor) & 0xF) << 8) | IND_SET_RESET_ENABLE);
+        __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, ((~Inverted & 0xF) << 8) | IND_MAP_MASK);
+
+        /* Write the font bits to every plane but the inverted ones */
+        FontChar = GetFontPtr(Character);
+        PixelPtr = (PUCHAR)(VgaBase + (Left >> 3) + (Top * (SCREEN_WIDTH / 8)));
+        for (Height = BOOTCHAR_HEIGHT; Height > 0; --Height)
+        {
+            WRITE_REGISTER_UCHAR(PixelPtr, *FontChar);
+            PixelPtr += (SCREEN_WIDTH / 8);
+            FontChar += FONT_PTR_DELTA;
+        }
+
+        /* And their inverse to the rest */
+        if (Inverted)
+        {
+            __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, (Inverted << 8) | IND_MAP_MASK);
+
+            FontChar = GetFontPtr(Character);
+            PixelPtr = (PUCHAR)(VgaBase + (Left >> 3) + (Top * (SCREEN_WIDTH / 8)));
+            for (Height = BOOTCHAR_HEIGHT; Height > 0; --Height)
+            {
+                WRITE_REGISTER_UCHAR(PixelPtr, (UCHAR)~*FontChar);
+                PixelPtr += (SCREEN_WIDTH / 8);
+                FontChar += FONT_PTR_DELTA;
+            }
+        }
+
+        /* Disable set/reset and enable all the planes again */
+        __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, 0x0000 | IND_SET_RESET_ENABLE);
+        __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, 0x0F00 | IND_MAP_MASK);
+        return;
+    }
+
+    PrepareForSetPixel();
+
     /* Get the font and pixel pointer */
     FontChar = GetFontPtr(Character);
     PixelPtr = (PUCHAR)(VgaBase + (Left >> 3) + (Top * (SCREEN_WIDTH / 8)));
@@ -400,6 +451,108 @@ PreserveRow(IN ULONG CurrentTop,
 #endif
 }
 
+static VOID
+NTAPI
+BitBltPlanar(IN ULONG Left,
+             IN ULONG Top,
+             IN ULONG Width,
+             IN ULONG Height,
+             IN PUCHAR Buffer,
+             IN ULONG Delta)
+{
+    UCHAR Planes[4][SCREEN_WIDTH / 8];
+    UCHAR lMask, rMask;
+    ULONG LeftOffset, Distance;
+    ULONG Plane, x, y, i;
+    ULONG offset = 0;
+    PUCHAR PixelPosition, Position;
+    UCHAR Color, Mask;
+
+    /* Get the byte range covered by each row and the masks of its edges */
+    LeftOffset = Left >> 3;
+    Distance = ((Left + Width - 1) >> 3) - LeftOffset;
+    lMask = lMaskTable[Left & 7];
+    rMask = rMaskTable[(Left + Width - 1) & 7];
+
+    /* If there is no distance, then combine the right and left masks */
+    if (!Distance) lMask &= rMask;
+
+    /*
+     * Use write mode 0 with set/reset disabled, so that a byte written lands
+     * unchanged in every plane enabled in the map mask. Each row is split
+     * into its four planes in memory first and then written a plane at a
+     * time, instead of programming the bit mask for every single pixel.
+     */
+    ReadWriteMode(0);
+    __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, 0x0000 | IND_SET_RESET_ENABLE);
+
+    PixelPosition = (PUCHAR)(VgaBase + (Top * (SCREEN_WIDTH / 8)) + LeftOffset);
+
+    for (y = Height; y > 0; --y)
+    {
+        /* Split the 4bpp row into the four planes */
+        RtlZeroMemory(Planes, sizeof(Planes));
+        for (x = 0; x < Width; ++x)
+        {
+            Color = Buffer[offset + (x >> 1)];
+            Color = (x & 1) ? (Color & 0x0F) : (Color >> 4);
+
+            i = ((Left + x) >> 3) - LeftOffset;
+            Mask = PixelMask[(Left + x) & 7];
+
+            if (Color & 1) Planes[0][i] |= Mask;
+            if (Color & 2) Planes[1][i] |= Mask;
+            if (Color & 4) Planes[2][i] |= Mask;
+            if (Color & 8) Planes[3][i] |= Mask;
+        }
+
+        /* Write the left edge, keeping the pixels outside of it from the latches */
+        __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, (lMask << 8) | IND_BIT_MASK);
+        READ_REGISTER_UCHAR(PixelPosition);
+        for (Plane = 0; Plane < 4; ++Plane)
+        {
+            __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, ((1 << Plane) << 8) | IND_MAP_MASK);
+            WRITE_REGISTER_UCHAR(PixelPosition, Planes[Plane][0]);
+        }
+
+        if (Distance > 0)
+        {
+            /* Write the right edge the same way */
+            Position = PixelPosition + Distance;
+            __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, (rMask << 8) | IND_BIT_MASK);
+            READ_REGISTER_UCHAR(Position);
+            for (Plane = 0; Plane < 4; ++Plane)
+            {
+                __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, ((1 << Plane) << 8) | IND_MAP_MASK);
+                WRITE_REGISTER_UCHAR(Position, Planes[Plane][Distance]);
+            }
+
+            /* Whole bytes in between need neither the latches nor a mask */
+            if (Distance > 1)
+            {
+                __outpw(VGA_BASE_IO_PORT + GRAPH_ADDRESS_PORT, 0xFF00 | IND_BIT_MASK);
+                for (Plane = 0; Plane < 4; ++Plane)
+                {
+                    __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, ((1 << Plane) << 8) | IND_MAP_MASK);
+#if defined(_M_IX86) || defined(_M_AMD64)
+                    __movsb(PixelPosition + 1, &Planes[Plane][1], Distance - 1);
+#else
+                    for (i = 1; i < Distance; ++i)
+                        WRITE_REGISTER_UCHAR(PixelPosition + i, Planes[Plane][i]);
+#endif
+                }
+            }
+        }
+
+        /* Move to the next row */
+        PixelPosition += (SCREEN_WIDTH / 8);
+        offset += Delta;
+    }
+
+    /* Enable all the planes again */
+    __outpw(VGA_BASE_IO_PORT + SEQ_ADDRESS_PORT, 0x0F00 | IND_MAP_MASK);
+}
+
 static VOID
 NTAPI
 BitBlt(IN ULONG Left,
@@ -434,6 +587,13 @@ BitBlt(IN ULONG Left,
         return;
     }
 
+    /* Use the planar path whenever the rows fit on the screen */
+    if (Right <= SCREEN_WIDTH)
+    {
+        BitBltPlanar(Left, Top, Width, Height, Buffer, Delta);
+        return;
+    }
+
     PrepareForSetPixel();
 
     /* 4bpp blitting */
@@ -106,6 +106,7 @@
                                         //  index registers 0-7
 #define IND_CR2C                0x2C    // Nordic LCD Interface Register
 #define IND_CR2D                0x2D    // Nordic LCD Display Control
+#define IND_SET_RESET           0x00    // index of Set/Reset reg in GC
 #define IND_SET_RESET_ENABLE    0x01    // index of Set/Reset Enable reg in GC
 #define IND_DATA_ROTATE         0x03    // index of Data Rotate reg in GC
 #define IND_READ_MAP            0x04    // index of Read Map reg in Graph Ctlr
@@ -1039,27 +1039,7 @@ static NTSTATUS write_metadata_items(_Requires_exclusive_lock_held_(_Curr_->tree
                 tw->data = (uint8_t*)mr->data;
                 tw->allocated = false;
 
-                if (IsListEmpty(&tree_writes))
-                    InsertTailList(&tree_writes, &tw->list_entry);
-                else {
-                    bool inserted = false;
-
-                    le2 = tree_writes.Flink;
-                    while (le2 != &tree_writes) {
-                        tree_write* tw2 = CONTAINING_RECORD(le2, tree_write, list_entry);
-
-                        if (tw2->address > tw->address) {
-                            InsertHeadList(le2->Blink, &tw->list_entry);
-                            inserted = true;
-                            break;
-                        }
-
-                        le2 = le2->Flink;
-                    }
-
-                    if (!inserted)
-                        InsertTailList(&tree_writes, &tw->list_entry);
-                }
+                InsertTailList(&tree_writes, &tw->list_entry);
             }
 
             le = le->Flink;
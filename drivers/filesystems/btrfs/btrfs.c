@@ -66,7 +66,9 @@ DEFINE_GUID(BtrfsBusInterface, 0x4d414874, 0x6865, 0x6761, 0x6d, 0x65, 0x83, 0x6
 PDRIVER_OBJECT drvobj;
 PDEVICE_OBJECT master_devobj, busobj;
 #ifndef __REACTOS__
-bool have_sse42 = false, have_sse2 = false;
+bool have_sse42 = false, have_sse2 = false, have_ssse3 = false, have_avx2 = false;
+tKeSaveExtendedProcessorState fKeSaveExtendedProcessorState;
+tKeRestoreExtendedProcessorState fKeRestoreExtendedProcessorState;
 #endif
 uint64_t num_reads = 0;
 LIST_ENTRY uid_map_list, gid_map_list;
@@ -5603,14 +5605,44 @@ static void init_serial(bool first_time) {
 #ifndef __REACTOS__
 static void check_cpu() {
     unsigned int cpuInfo[4];
+    bool have_avx;
 #ifndef _MSC_VER
     __get_cpuid(1, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3]);
     have_sse42 = cpuInfo[2] & bit_SSE4_2;
     have_sse2 = cpuInfo[3] & bit_SSE2;
+    have_ssse3 = cpuInfo[2] & bit_SSSE3;
+    have_avx = (cpuInfo[2] & bit_OSXSAVE) && (cpuInfo[2] & bit_AVX);
+
+    if (have_avx) {
+        unsigned int xcr0, xcr0_hi;
+
+        // the OS has to have enabled saving the YMM registers
+        __asm__ __volatile__("xgetbv" : "=a" (xcr0), "=d" (xcr0_hi) : "c" (0));
+        have_avx = (xcr0 & 6) == 6;
+    }
+
+    if (have_avx && __get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
+        have_avx2 = cpuInfo[1] & bit_AVX2;
+    }
 #else
    __cpuid(cpuInfo, 1);
    have_sse42 = cpuInfo[2] & (1 << 20);
    have_sse2 = cpuInfo[3] & (1 << 26);
+   have_ssse3 = cpuInfo[2] & (1 << 9);
+   have_avx = (cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28));
+
+   if (have_avx)
+       have_avx = (_xgetbv(0) & 6) == 6;
+
+   if (have_avx) {
+       __cpuid(cpuInfo, 0);
+
+       if (cpuInfo[0] >= 7) {
+           __cpuidex(cpuInfo, 7, 0);
+           have_avx2 = cpuInfo[1] & (1 << 5);
+       }
+   }
 #endif
 
     if (have_sse42)
@@ -5622,6 +5654,16 @@ static void check_cpu() {
         TRACE("SSE2 is supported\n");
     else
         TRACE("SSE2 is not supported\n");
+
+    if (have_ssse3)
+        TRACE("SSSE3 is supported\n");
+    else
+        TRACE("SSSE3 is not supported\n");
+
+    if (have_avx2)
+        TRACE("AVX2 is supported\n");
+    else
+        TRACE("AVX2 is not supported\n");
 }
 #endif
 
@@ -5942,11 +5984,29 @@ NTSTATUS __stdcall DriverEntry(_In_ PDRIVER_OBJECT DriverObject, _In_ PUNICODE_S
 
         RtlInitUnicodeString(&name, L"FsRtlAreThereCurrentOrInProgressFileLocks");
         fFsRtlAreThereCurrentOrInProgressFileLocks = (tFsRtlAreThereCurrentOrInProgressFileLocks)MmGetSystemRoutineAddress(&name);
+
+#ifndef __REACTOS__
+        RtlInitUnicodeString(&name, L"KeSaveExtendedProcessorState");
+        fKeSaveExtendedProcessorState = (tKeSaveExtendedProcessorState)MmGetSystemRoutineAddress(&name);
+
+        RtlInitUnicodeString(&name, L"KeRestoreExtendedProcessorState");
+        fKeRestoreExtendedProcessorState = (tKeRestoreExtendedProcessorState)MmGetSystemRoutineAddress(&name);
+#endif
     } else {
         fIoUnregisterPlugPlayNotificationEx = NULL;
         fFsRtlAreThereCurrentOrInProgressFileLocks = NULL;
+#ifndef __REACTOS__
+        fKeSaveExtendedProcessorState = NULL;
+        fKeRestoreExtendedProcessorState = NULL;
+#endif
     }
 
+#ifndef __REACTOS__
+    // we can't touch the YMM registers without saving them first
+    if (!fKeSaveExtendedProcessorState || !fKeRestoreExtendedProcessorState)
+        have_avx2 = false;
+#endif
+
     if (WdmlibRtlIsNtDdiVersionAvailable(NTDDI_VISTA)) {
         UNICODE_STRING name;
 
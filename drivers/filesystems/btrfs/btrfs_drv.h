@@ -617,11 +617,28 @@ typedef struct {
     LIST_ENTRY list_entry;
 } sys_chunk;
 
+typedef enum {
+    calc_thread_crc32c,
+    calc_thread_compress
+} calc_thread_type;
+
 typedef struct {
+    uint8_t* buf;
+    uint32_t outlen;
+    NTSTATUS Status;
+    KEVENT event;
+} calc_comp_part;
+
+typedef struct {
+    calc_thread_type type;
     uint8_t* data;
     uint32_t* csum;
     uint32_t sectors;
-    LONG pos, done;
+    uint8_t compression;
+    uint32_t length;
+    calc_comp_part* parts;
+    bool not_needed;
+    LONG units, pos, done;
     KEVENT event;
     LONG refcount;
     LIST_ENTRY list_entry;
@@ -1141,7 +1158,7 @@ void do_shutdown(PIRP Irp);
 #define funcname __func__
 #endif
 
-extern bool have_sse2;
+extern bool have_sse2, have_avx2;
 
 extern uint32_t mount_compress;
 extern uint32_t mount_compress_force;
@@ -1506,10 +1523,18 @@ NTSTATUS zlib_decompress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32
 NTSTATUS lzo_decompress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32_t outlen, uint32_t inpageoff);
 NTSTATUS zstd_decompress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32_t outlen);
 NTSTATUS write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, bool* compressed, PIRP Irp, LIST_ENTRY* rollback);
+uint8_t get_compression_type(fcb* fcb);
+NTSTATUS compress_data(device_extension* Vcb, uint8_t compression, uint8_t* data, uint32_t inlen, uint8_t** out, uint32_t* outlen);
+NTSTATUS write_compressed_part(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, uint8_t compression, uint8_t* comp_data,
+                               uint32_t comp_length, PIRP Irp, LIST_ENTRY* rollback);
 
 // in galois.c
 void galois_double(uint8_t* data, uint32_t len);
 void galois_divpower(uint8_t* data, uint8_t div, uint32_t readlen);
+void galois_recover2(uint8_t* qxy, uint8_t* pxy, uint8_t* p, uint8_t* q, uint8_t a, uint8_t b, uint32_t len);
+#ifndef __REACTOS__
+bool do_xor_avx2(uint8_t* buf1, uint8_t* buf2, uint32_t len);
+#endif
 uint8_t gpow2(uint8_t e);
 uint8_t gmul(uint8_t a, uint8_t b);
 uint8_t gdiv(uint8_t a, uint8_t b);
@@ -1526,6 +1551,8 @@ _Function_class_(KSTART_ROUTINE)
 void __stdcall calc_thread(void* context);
 
 NTSTATUS add_calc_job(device_extension* Vcb, uint8_t* data, uint32_t sectors, uint32_t* csum, calc_job** pcj);
+NTSTATUS add_calc_job_comp(device_extension* Vcb, uint8_t compression, uint8_t* data, uint32_t length, calc_job** pcj);
+bool do_calc_job(device_extension* Vcb, calc_job* cj);
 void free_calc_job(calc_job* cj);
 
 // in balance.c
@@ -1679,6 +1706,9 @@ static __inline void do_xor(uint8_t* buf1, uint8_t* buf2, uint32_t len) {
 #endif
 
 #ifndef __REACTOS__
+    if (have_avx2 && len >= 512 && do_xor_avx2(buf1, buf2, len))
+        return;
+
     if (have_sse2 && ((uintptr_t)buf1 & 0xf) == 0 && ((uintptr_t)buf2 & 0xf) == 0) {
         while (len >= 16) {
             x1 = _mm_load_si128((__m128i*)buf1);
@@ -1844,6 +1874,12 @@ typedef BOOLEAN (__stdcall *tFsRtlCheckLockForOplockRequest)(PFILE_LOCK FileLock
 
 typedef BOOLEAN (__stdcall *tFsRtlAreThereCurrentOrInProgressFileLocks)(PFILE_LOCK FileLock);
 
+#ifndef __REACTOS__
+typedef NTSTATUS (__stdcall *tKeSaveExtendedProcessorState)(ULONG64 Mask, PXSTATE_SAVE XStateSave);
+
+typedef VOID (__stdcall *tKeRestoreExtendedProcessorState)(PXSTATE_SAVE XStateSave);
+#endif
+
 #ifndef __REACTOS__
 #ifndef _MSC_VER
 PEPROCESS __stdcall PsGetThreadProcess(_In_ PETHREAD Thread); // not in mingw
@@ -19,6 +19,17 @@
 
 #define SECTOR_BLOCK 16
 
+static void queue_calc_job(device_extension* Vcb, calc_job* cj) {
+    ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, true);
+
+    InsertTailList(&Vcb->calcthreads.job_list, &cj->list_entry);
+
+    KeSetEvent(&Vcb->calcthreads.event, 0, false);
+    KeClearEvent(&Vcb->calcthreads.event);
+
+    ExReleaseResourceLite(&Vcb->calcthreads.lock);
+}
+
 NTSTATUS add_calc_job(device_extension* Vcb, uint8_t* data, uint32_t sectors, uint32_t* csum, calc_job** pcj) {
     calc_job* cj;
 
@@ -28,22 +39,61 @@ NTSTATUS add_calc_job(device_extension* Vcb, uint8_t* data, uint32_t sectors, ui
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
+    cj->type = calc_thread_crc32c;
     cj->data = data;
     cj->sectors = sectors;
     cj->csum = csum;
+    cj->parts = NULL;
+    cj->not_needed = false;
+    cj->units = (sectors + SECTOR_BLOCK - 1) / SECTOR_BLOCK;
     cj->pos = 0;
     cj->done = 0;
     cj->refcount = 1;
     KeInitializeEvent(&cj->event, NotificationEvent, false);
 
-    ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, true);
+    queue_calc_job(Vcb, cj);
 
-    InsertTailList(&Vcb->calcthreads.job_list, &cj->list_entry);
+    *pcj = cj;
 
-    KeSetEvent(&Vcb->calcthreads.event, 0, false);
-    KeClearEvent(&Vcb->calcthreads.event);
+    return STATUS_SUCCESS;
+}
 
-    ExReleaseResourceLite(&Vcb->calcthreads.lock);
+// Compresses length bytes of data in COMPRESSED_EXTENT_SIZE parts. The event of each
+// part is set as soon as it's done, so the caller can write it out while the threads
+// are still working on the ones after it.
+NTSTATUS add_calc_job_comp(device_extension* Vcb, uint8_t compression, uint8_t* data, uint32_t length, calc_job** pcj) {
+    calc_job* cj;
+    ULONG num_parts, i;
+
+    num_parts = (ULONG)(sector_align(length, COMPRESSED_EXTENT_SIZE) / COMPRESSED_EXTENT_SIZE);
+
+    cj = ExAllocatePoolWithTag(NonPagedPool, sizeof(calc_job) + (num_parts * sizeof(calc_comp_part)), ALLOC_TAG);
+    if (!cj) {
+        ERR("out of memory\n");
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    cj->type = calc_thread_compress;
+    cj->data = data;
+    cj->length = length;
+    cj->compression = compression;
+    cj->csum = NULL;
+    cj->parts = (calc_comp_part*)&cj[1];
+    cj->not_needed = false;
+    cj->units = num_parts;
+    cj->pos = 0;
+    cj->done = 0;
+    cj->refcount = 1;
+    KeInitializeEvent(&cj->event, NotificationEvent, false);
+
+    for (i = 0; i < num_parts; i++) {
+        cj->parts[i].buf = NULL;
+        cj->parts[i].outlen = 0;
+        cj->parts[i].Status = STATUS_SUCCESS;
+        KeInitializeEvent(&cj->parts[i].event, NotificationEvent, false);
+    }
+
+    queue_calc_job(Vcb, cj);
 
     *pcj = cj;
 
@@ -57,17 +107,11 @@ void free_calc_job(calc_job* cj) {
         ExFreePool(cj);
 }
 
-static bool do_calc(device_extension* Vcb, calc_job* cj) {
-    LONG pos, done;
+static void do_calc_crc32c(device_extension* Vcb, calc_job* cj, LONG pos) {
     uint32_t* csum;
     uint8_t* data;
     ULONG blocksize, i;
 
-    pos = InterlockedIncrement(&cj->pos) - 1;
-
-    if ((uint32_t)pos * SECTOR_BLOCK >= cj->sectors)
-        return false;
-
     csum = &cj->csum[pos * SECTOR_BLOCK];
     data = cj->data + (pos * SECTOR_BLOCK * Vcb->superblock.sector_size);
 
@@ -77,16 +121,48 @@ static bool do_calc(device_extension* Vcb, calc_job* cj) {
         csum++;
         data += Vcb->superblock.sector_size;
     }
+}
 
-    done = InterlockedIncrement(&cj->done);
+static void do_calc_compress(device_extension* Vcb, calc_job* cj, LONG pos) {
+    calc_comp_part* part = &cj->parts[pos];
+    uint32_t off = pos * COMPRESSED_EXTENT_SIZE;
 
-    if ((uint32_t)done * SECTOR_BLOCK >= cj->sectors) {
+    if (!cj->not_needed) {
+        part->Status = compress_data(Vcb, cj->compression, cj->data + off, min(COMPRESSED_EXTENT_SIZE, cj->length - off),
+                                     &part->buf, &part->outlen);
+    }
+
+    KeSetEvent(&part->event, 0, false);
+}
+
+// Does the next piece of cj, returning false if they've all been handed out. As well
+// as the calc threads, the thread which queued the job can call this rather than
+// sitting idle.
+bool do_calc_job(device_extension* Vcb, calc_job* cj) {
+    LONG pos, done;
+
+    pos = InterlockedIncrement(&cj->pos) - 1;
+
+    if (pos >= cj->units)
+        return false;
+
+    // take the job off the list as soon as the last piece is claimed, so that the
+    // threads can move on to the one after it
+    if (pos == cj->units - 1) {
         ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, true);
         RemoveEntryList(&cj->list_entry);
         ExReleaseResourceLite(&Vcb->calcthreads.lock);
+    }
+
+    if (cj->type == calc_thread_compress)
+        do_calc_compress(Vcb, cj, pos);
+    else
+        do_calc_crc32c(Vcb, cj, pos);
+
+    done = InterlockedIncrement(&cj->done);
 
+    if (done == cj->units)
         KeSetEvent(&cj->event, 0, false);
-    }
 
     return true;
 }
@@ -103,7 +179,6 @@ void __stdcall calc_thread(void* context) {
 
         while (true) {
             calc_job* cj;
-            bool b;
 
             ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, true);
 
@@ -113,16 +188,13 @@ void __stdcall calc_thread(void* context) {
             }
 
             cj = CONTAINING_RECORD(Vcb->calcthreads.job_list.Flink, calc_job, list_entry);
-            cj->refcount++;
+            InterlockedIncrement(&cj->refcount);
 
             ExReleaseResourceLite(&Vcb->calcthreads.lock);
 
-            b = do_calc(Vcb, cj);
+            do_calc_job(Vcb, cj);
 
             free_calc_job(cj);
-
-            if (!b)
-                break;
         }
 
         if (thread->quit)
@@ -379,35 +379,23 @@ NTSTATUS zlib_decompress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32
     return STATUS_SUCCESS;
 }
 
-static NTSTATUS zlib_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, bool* compressed, PIRP Irp, LIST_ENTRY* rollback) {
-    NTSTATUS Status;
-    uint8_t compression;
-    uint32_t comp_length;
+static NTSTATUS zlib_compress(device_extension* Vcb, uint8_t* data, uint32_t inlen, uint8_t** out, uint32_t* outlen) {
     uint8_t* comp_data;
-    uint32_t out_left;
-    LIST_ENTRY* le;
-    chunk* c;
+    uint32_t out_left, cl;
     z_stream c_stream;
     int ret;
 
-    comp_data = ExAllocatePoolWithTag(PagedPool, (uint32_t)(end_data - start_data), ALLOC_TAG);
+    comp_data = ExAllocatePoolWithTag(PagedPool, inlen, ALLOC_TAG);
     if (!comp_data) {
         ERR("out of memory\n");
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
-    if (!NT_SUCCESS(Status)) {
-        ERR("excise_extents returned %08x\n", Status);
-        ExFreePool(comp_data);
-        return Status;
-    }
-
     c_stream.zalloc = zlib_alloc;
     c_stream.zfree = zlib_free;
     c_stream.opaque = (voidpf)0;
 
-    ret = deflateInit(&c_stream, fcb->Vcb->options.zlib_level);
+    ret = deflateInit(&c_stream, Vcb->options.zlib_level);
 
     if (ret != Z_OK) {
         ERR("deflateInit returned %08x\n", ret);
@@ -415,9 +403,9 @@ static NTSTATUS zlib_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
         return STATUS_INTERNAL_ERROR;
     }
 
-    c_stream.avail_in = (uint32_t)(end_data - start_data);
+    c_stream.avail_in = inlen;
     c_stream.next_in = data;
-    c_stream.avail_out = (uint32_t)(end_data - start_data);
+    c_stream.avail_out = inlen;
     c_stream.next_out = comp_data;
 
     do {
@@ -425,6 +413,7 @@ static NTSTATUS zlib_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
 
         if (ret == Z_STREAM_ERROR) {
             ERR("deflate returned %x\n", ret);
+            deflateEnd(&c_stream);
             ExFreePool(comp_data);
             return STATUS_INTERNAL_ERROR;
         }
@@ -440,90 +429,20 @@ static NTSTATUS zlib_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
         return STATUS_INTERNAL_ERROR;
     }
 
-    if (out_left < fcb->Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
+    if (out_left < Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
         ExFreePool(comp_data);
-
-        comp_length = (uint32_t)(end_data - start_data);
-        comp_data = data;
-        compression = BTRFS_COMPRESSION_NONE;
-
-        *compressed = false;
-    } else {
-        uint32_t cl;
-
-        compression = BTRFS_COMPRESSION_ZLIB;
-        cl = (uint32_t)(end_data - start_data - out_left);
-        comp_length = (uint32_t)sector_align(cl, fcb->Vcb->superblock.sector_size);
-
-        RtlZeroMemory(comp_data + cl, comp_length - cl);
-
-        *compressed = true;
-    }
-
-    ExAcquireResourceSharedLite(&fcb->Vcb->chunk_lock, true);
-
-    le = fcb->Vcb->chunks.Flink;
-    while (le != &fcb->Vcb->chunks) {
-        c = CONTAINING_RECORD(le, chunk, list_entry);
-
-        if (!c->readonly && !c->reloc) {
-            acquire_chunk_lock(c, fcb->Vcb);
-
-            if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-                if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
-                    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-                    if (compression != BTRFS_COMPRESSION_NONE)
-                        ExFreePool(comp_data);
-
-                    return STATUS_SUCCESS;
-                }
-            }
-
-            release_chunk_lock(c, fcb->Vcb);
-        }
-
-        le = le->Flink;
-    }
-
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-    ExAcquireResourceExclusiveLite(&fcb->Vcb->chunk_lock, true);
-
-    Status = alloc_chunk(fcb->Vcb, fcb->Vcb->data_flags, &c, false);
-
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-    if (!NT_SUCCESS(Status)) {
-        ERR("alloc_chunk returned %08x\n", Status);
-
-        if (compression != BTRFS_COMPRESSION_NONE)
-            ExFreePool(comp_data);
-
-        return Status;
+        *out = NULL;
+        return STATUS_SUCCESS;
     }
 
-    if (c) {
-        acquire_chunk_lock(c, fcb->Vcb);
+    cl = inlen - out_left;
+    *outlen = (uint32_t)sector_align(cl, Vcb->superblock.sector_size);
 
-        if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
-                if (compression != BTRFS_COMPRESSION_NONE)
-                    ExFreePool(comp_data);
+    RtlZeroMemory(comp_data + cl, *outlen - cl);
 
-                return STATUS_SUCCESS;
-            }
-        }
+    *out = comp_data;
 
-        release_chunk_lock(c, fcb->Vcb);
-    }
-
-    WARN("couldn't find any data chunks with %I64x bytes free\n", comp_length);
-
-    if (compression != BTRFS_COMPRESSION_NONE)
-        ExFreePool(comp_data);
-
-    return STATUS_DISK_FULL;
+    return STATUS_SUCCESS;
 }
 
 static NTSTATUS lzo_do_compress(const uint8_t* in, uint32_t in_len, uint8_t* out, uint32_t* out_len, void* wrkmem) {
@@ -767,19 +686,15 @@ static __inline uint32_t lzo_max_outlen(uint32_t inlen) {
     return inlen + (inlen / 16) + 64 + 3; // formula comes from LZO.FAQ
 }
 
-static NTSTATUS lzo_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, bool* compressed, PIRP Irp, LIST_ENTRY* rollback) {
+static NTSTATUS lzo_compress(device_extension* Vcb, uint8_t* data, uint32_t inlen, uint8_t** out, uint32_t* outlen) {
     NTSTATUS Status;
-    uint8_t compression;
-    uint64_t comp_length;
     ULONG comp_data_len, num_pages, i;
     uint8_t* comp_data;
     bool skip_compression = false;
     lzo_stream stream;
     uint32_t* out_size;
-    LIST_ENTRY* le;
-    chunk* c;
 
-    num_pages = (ULONG)((sector_align(end_data - start_data, LZO_PAGE_SIZE)) / LZO_PAGE_SIZE);
+    num_pages = (ULONG)((sector_align(inlen, LZO_PAGE_SIZE)) / LZO_PAGE_SIZE);
 
     // Four-byte overall header
     // Another four-byte header page
@@ -800,14 +715,6 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
-    if (!NT_SUCCESS(Status)) {
-        ERR("excise_extents returned %08x\n", Status);
-        ExFreePool(comp_data);
-        ExFreePool(stream.wrkmem);
-        return Status;
-    }
-
     out_size = (uint32_t*)comp_data;
     *out_size = sizeof(uint32_t);
 
@@ -817,7 +724,7 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t
     for (i = 0; i < num_pages; i++) {
         uint32_t* pagelen = (uint32_t*)(stream.out - sizeof(uint32_t));
 
-        stream.inlen = (uint32_t)min(LZO_PAGE_SIZE, end_data - start_data - (i * LZO_PAGE_SIZE));
+        stream.inlen = (uint32_t)min(LZO_PAGE_SIZE, inlen - (i * LZO_PAGE_SIZE));
 
         Status = lzo1x_1_compress(&stream);
         if (!NT_SUCCESS(Status)) {
@@ -841,116 +748,36 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t
 
     ExFreePool(stream.wrkmem);
 
-    if (skip_compression || *out_size >= end_data - start_data - fcb->Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
+    if (skip_compression || *out_size >= inlen - Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
         ExFreePool(comp_data);
-
-        comp_length = end_data - start_data;
-        comp_data = data;
-        compression = BTRFS_COMPRESSION_NONE;
-
-        *compressed = false;
-    } else {
-        compression = BTRFS_COMPRESSION_LZO;
-        comp_length = sector_align(*out_size, fcb->Vcb->superblock.sector_size);
-
-        RtlZeroMemory(comp_data + *out_size, (ULONG)(comp_length - *out_size));
-
-        *compressed = true;
+        *out = NULL;
+        return STATUS_SUCCESS;
     }
 
-    ExAcquireResourceSharedLite(&fcb->Vcb->chunk_lock, true);
-
-    le = fcb->Vcb->chunks.Flink;
-    while (le != &fcb->Vcb->chunks) {
-        c = CONTAINING_RECORD(le, chunk, list_entry);
+    *outlen = (uint32_t)sector_align(*out_size, Vcb->superblock.sector_size);
 
-        if (!c->readonly && !c->reloc) {
-            acquire_chunk_lock(c, fcb->Vcb);
+    RtlZeroMemory(comp_data + *out_size, *outlen - *out_size);
 
-            if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-                if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
-                    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-                    if (compression != BTRFS_COMPRESSION_NONE)
-                        ExFreePool(comp_data);
-
-                    return STATUS_SUCCESS;
-                }
-            }
-
-            release_chunk_lock(c, fcb->Vcb);
-        }
-
-        le = le->Flink;
-    }
-
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-    ExAcquireResourceExclusiveLite(&fcb->Vcb->chunk_lock, true);
-
-    Status = alloc_chunk(fcb->Vcb, fcb->Vcb->data_flags, &c, false);
-
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
+    *out = comp_data;
 
-    if (!NT_SUCCESS(Status)) {
-        ERR("alloc_chunk returned %08x\n", Status);
-
-        if (compression != BTRFS_COMPRESSION_NONE)
-            ExFreePool(comp_data);
-
-        return Status;
-    }
-
-    if (c) {
-        acquire_chunk_lock(c, fcb->Vcb);
-
-        if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
-                if (compression != BTRFS_COMPRESSION_NONE)
-                    ExFreePool(comp_data);
-
-                return STATUS_SUCCESS;
-            }
-        }
-
-        release_chunk_lock(c, fcb->Vcb);
-    }
-
-    WARN("couldn't find any data chunks with %I64x bytes free\n", comp_length);
-
-    if (compression != BTRFS_COMPRESSION_NONE)
-        ExFreePool(comp_data);
-
-    return STATUS_DISK_FULL;
+    return STATUS_SUCCESS;
 }
 
-static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, bool* compressed, PIRP Irp, LIST_ENTRY* rollback) {
-    NTSTATUS Status;
-    uint8_t compression;
-    uint32_t comp_length;
+static NTSTATUS zstd_compress(device_extension* Vcb, uint8_t* data, uint32_t inlen, uint8_t** out, uint32_t* outlen) {
     uint8_t* comp_data;
-    uint32_t out_left;
-    LIST_ENTRY* le;
-    chunk* c;
+    uint32_t out_left, cl;
     ZSTD_CStream* stream;
     size_t init_res, written;
     ZSTD_inBuffer input;
     ZSTD_outBuffer output;
     ZSTD_parameters params;
 
-    comp_data = ExAllocatePoolWithTag(PagedPool, (uint32_t)(end_data - start_data), ALLOC_TAG);
+    comp_data = ExAllocatePoolWithTag(PagedPool, inlen, ALLOC_TAG);
     if (!comp_data) {
         ERR("out of memory\n");
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
-    if (!NT_SUCCESS(Status)) {
-        ERR("excise_extents returned %08x\n", Status);
-        ExFreePool(comp_data);
-        return Status;
-    }
-
     stream = ZSTD_createCStream_advanced(zstd_mem);
 
     if (!stream) {
@@ -959,12 +786,12 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
         return STATUS_INTERNAL_ERROR;
     }
 
-    params = ZSTD_getParams(fcb->Vcb->options.zstd_level, (uint32_t)(end_data - start_data), 0);
+    params = ZSTD_getParams(Vcb->options.zstd_level, inlen, 0);
 
     if (params.cParams.windowLog > ZSTD_BTRFS_MAX_WINDOWLOG)
         params.cParams.windowLog = ZSTD_BTRFS_MAX_WINDOWLOG;
 
-    init_res = ZSTD_initCStream_advanced(stream, NULL, 0, params, (uint32_t)(end_data - start_data));
+    init_res = ZSTD_initCStream_advanced(stream, NULL, 0, params, inlen);
 
     if (ZSTD_isError(init_res)) {
         ERR("ZSTD_initCStream_advanced failed: %s\n", ZSTD_getErrorName(init_res));
@@ -974,11 +801,11 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
     }
 
     input.src = data;
-    input.size = (uint32_t)(end_data - start_data);
+    input.size = inlen;
     input.pos = 0;
 
     output.dst = comp_data;
-    output.size = (uint32_t)(end_data - start_data);
+    output.size = inlen;
     output.pos = 0;
 
     while (input.pos < input.size && output.pos < output.size) {
@@ -1002,26 +829,82 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
 
     ZSTD_freeCStream(stream);
 
-    out_left = output.size - output.pos;
+    out_left = (uint32_t)(output.size - output.pos);
 
-    if (out_left < fcb->Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
+    if (out_left < Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
         ExFreePool(comp_data);
+        *out = NULL;
+        return STATUS_SUCCESS;
+    }
 
-        comp_length = (uint32_t)(end_data - start_data);
-        comp_data = data;
-        compression = BTRFS_COMPRESSION_NONE;
+    cl = inlen - out_left;
+    *outlen = (uint32_t)sector_align(cl, Vcb->superblock.sector_size);
 
-        *compressed = false;
-    } else {
-        uint32_t cl;
+    RtlZeroMemory(comp_data + cl, *outlen - cl);
 
-        compression = BTRFS_COMPRESSION_ZSTD;
-        cl = (uint32_t)(end_data - start_data - out_left);
-        comp_length = (uint32_t)sector_align(cl, fcb->Vcb->superblock.sector_size);
+    *out = comp_data;
 
-        RtlZeroMemory(comp_data + cl, comp_length - cl);
+    return STATUS_SUCCESS;
+}
+
+// Works out which algorithm to compress fcb's data with, and marks the superblock
+// as using it.
+uint8_t get_compression_type(fcb* fcb) {
+    uint8_t type;
 
-        *compressed = true;
+    if (fcb->Vcb->options.compress_type != 0 && fcb->prop_compression == PropCompression_None)
+        type = fcb->Vcb->options.compress_type;
+    else {
+        if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD) && fcb->prop_compression == PropCompression_ZSTD)
+            type = BTRFS_COMPRESSION_ZSTD;
+        else if (fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD && fcb->prop_compression != PropCompression_Zlib && fcb->prop_compression != PropCompression_LZO)
+            type = BTRFS_COMPRESSION_ZSTD;
+        else if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO) && fcb->prop_compression == PropCompression_LZO)
+            type = BTRFS_COMPRESSION_LZO;
+        else if (fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO && fcb->prop_compression != PropCompression_Zlib)
+            type = BTRFS_COMPRESSION_LZO;
+        else
+            type = BTRFS_COMPRESSION_ZLIB;
+    }
+
+    if (type == BTRFS_COMPRESSION_ZSTD)
+        fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD;
+    else if (type == BTRFS_COMPRESSION_LZO)
+        fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO;
+
+    return type;
+}
+
+// Compresses inlen bytes of data into a newly-allocated, sector-aligned buffer.
+// If it's not worth it, *out is set to NULL. This doesn't touch any of the
+// filesystem's structures, so the calc threads can run it in parallel.
+NTSTATUS compress_data(device_extension* Vcb, uint8_t compression, uint8_t* data, uint32_t inlen, uint8_t** out, uint32_t* outlen) {
+    if (compression == BTRFS_COMPRESSION_ZSTD)
+        return zstd_compress(Vcb, data, inlen, out, outlen);
+    else if (compression == BTRFS_COMPRESSION_LZO)
+        return lzo_compress(Vcb, data, inlen, out, outlen);
+    else
+        return zlib_compress(Vcb, data, inlen, out, outlen);
+}
+
+// Writes out the extent compressed by compress_data, or the data uncompressed if
+// comp_data is NULL.
+NTSTATUS write_compressed_part(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, uint8_t compression, uint8_t* comp_data,
+                               uint32_t comp_length, PIRP Irp, LIST_ENTRY* rollback) {
+    NTSTATUS Status;
+    LIST_ENTRY* le;
+    chunk* c;
+
+    if (!comp_data) {
+        comp_length = (uint32_t)(end_data - start_data);
+        comp_data = data;
+        compression = BTRFS_COMPRESSION_NONE;
+    }
+
+    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
+    if (!NT_SUCCESS(Status)) {
+        ERR("excise_extents returned %08x\n", Status);
+        return Status;
     }
 
     ExAcquireResourceSharedLite(&fcb->Vcb->chunk_lock, true);
@@ -1036,10 +919,6 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
             if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
                 if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
                     ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-                    if (compression != BTRFS_COMPRESSION_NONE)
-                        ExFreePool(comp_data);
-
                     return STATUS_SUCCESS;
                 }
             }
@@ -1060,10 +939,6 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
 
     if (!NT_SUCCESS(Status)) {
         ERR("alloc_chunk returned %08x\n", Status);
-
-        if (compression != BTRFS_COMPRESSION_NONE)
-            ExFreePool(comp_data);
-
         return Status;
     }
 
@@ -1071,51 +946,40 @@ static NTSTATUS zstd_write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_
         acquire_chunk_lock(c, fcb->Vcb);
 
         if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0)) {
-                if (compression != BTRFS_COMPRESSION_NONE)
-                    ExFreePool(comp_data);
-
+            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, false, comp_data, Irp, rollback, compression, end_data - start_data, false, 0))
                 return STATUS_SUCCESS;
-            }
         }
 
         release_chunk_lock(c, fcb->Vcb);
     }
 
-    WARN("couldn't find any data chunks with %I64x bytes free\n", comp_length);
-
-    if (compression != BTRFS_COMPRESSION_NONE)
-        ExFreePool(comp_data);
+    WARN("couldn't find any data chunks with %x bytes free\n", comp_length);
 
     return STATUS_DISK_FULL;
 }
 
 NTSTATUS write_compressed_bit(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, bool* compressed, PIRP Irp, LIST_ENTRY* rollback) {
+    NTSTATUS Status;
     uint8_t type;
+    uint8_t* comp_data;
+    uint32_t comp_length;
 
-    if (fcb->Vcb->options.compress_type != 0 && fcb->prop_compression == PropCompression_None)
-        type = fcb->Vcb->options.compress_type;
-    else {
-        if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD) && fcb->prop_compression == PropCompression_ZSTD)
-            type = BTRFS_COMPRESSION_ZSTD;
-        else if (fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD && fcb->prop_compression != PropCompression_Zlib && fcb->prop_compression != PropCompression_LZO)
-            type = BTRFS_COMPRESSION_ZSTD;
-        else if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO) && fcb->prop_compression == PropCompression_LZO)
-            type = BTRFS_COMPRESSION_LZO;
-        else if (fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO && fcb->prop_compression != PropCompression_Zlib)
-            type = BTRFS_COMPRESSION_LZO;
-        else
-            type = BTRFS_COMPRESSION_ZLIB;
+    type = get_compression_type(fcb);
+
+    Status = compress_data(fcb->Vcb, type, data, (uint32_t)(end_data - start_data), &comp_data, &comp_length);
+    if (!NT_SUCCESS(Status)) {
+        ERR("compress_data returned %08x\n", Status);
+        return Status;
     }
 
-    if (type == BTRFS_COMPRESSION_ZSTD) {
-        fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD;
-        return zstd_write_compressed_bit(fcb, start_data, end_data, data, compressed, Irp, rollback);
-    } else if (type == BTRFS_COMPRESSION_LZO) {
-        fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO;
-        return lzo_write_compressed_bit(fcb, start_data, end_data, data, compressed, Irp, rollback);
-    } else
-        return zlib_write_compressed_bit(fcb, start_data, end_data, data, compressed, Irp, rollback);
+    *compressed = comp_data != NULL;
+
+    Status = write_compressed_part(fcb, start_data, end_data, data, type, comp_data, comp_length, Irp, rollback);
+
+    if (comp_data)
+        ExFreePool(comp_data);
+
+    return Status;
 }
 
 static void* zstd_malloc(void* opaque, size_t size) {
@@ -1604,6 +1604,49 @@ static NTSTATUS update_root_root(device_extension* Vcb, bool no_cache, PIRP Irp,
     return STATUS_SUCCESS;
 }
 
+static void sort_tree_writes(LIST_ENTRY* tree_writes) {
+    LIST_ENTRY half, *le;
+    ULONG num = 0, i;
+
+    // merge sort - the list can run to thousands of nodes on a big commit
+
+    le = tree_writes->Flink;
+    while (le != tree_writes) {
+        num++;
+        le = le->Flink;
+    }
+
+    if (num < 2)
+        return;
+
+    le = tree_writes->Flink;
+    for (i = 0; i < num / 2; i++) {
+        le = le->Flink;
+    }
+
+    // move the second half onto its own list
+    half.Flink = le;
+    half.Blink = tree_writes->Blink;
+    tree_writes->Blink = le->Blink;
+    le->Blink->Flink = tree_writes;
+    le->Blink = &half;
+    half.Blink->Flink = &half;
+
+    sort_tree_writes(tree_writes);
+    sort_tree_writes(&half);
+
+    le = tree_writes->Flink;
+    while (!IsListEmpty(&half)) {
+        tree_write* tw = CONTAINING_RECORD(RemoveHeadList(&half), tree_write, list_entry);
+
+        while (le != tree_writes && CONTAINING_RECORD(le, tree_write, list_entry)->address <= tw->address) {
+            le = le->Flink;
+        }
+
+        InsertTailList(le, &tw->list_entry);
+    }
+}
+
 NTSTATUS do_tree_writes(device_extension* Vcb, LIST_ENTRY* tree_writes, bool no_free) {
     chunk* c;
     LIST_ENTRY* le;
@@ -1614,6 +1657,8 @@ NTSTATUS do_tree_writes(device_extension* Vcb, LIST_ENTRY* tree_writes, bool no_
     ULONG bit_num = 0;
     bool raid56 = false;
 
+    sort_tree_writes(tree_writes);
+
     // merge together runs
     c = NULL;
     le = tree_writes->Flink;
@@ -1697,7 +1742,13 @@ NTSTATUS do_tree_writes(device_extension* Vcb, LIST_ENTRY* tree_writes, bool no_
         if (!NT_SUCCESS(Status)) {
             ERR("write_data returned %08x\n", Status);
 
-            for (i = 0; i < num_bits; i++) {
+            // the earlier writes are already on their way
+            for (i = 0; i < bit_num; i++) {
+                if (wtc[i].need_wait)
+                    KeWaitForSingleObject(&wtc[i].Event, Executive, KernelMode, false, NULL);
+            }
+
+            for (i = 0; i <= bit_num; i++) {
                 free_write_data_stripes(&wtc[i]);
             }
             ExFreePool(wtc);
@@ -1705,26 +1756,22 @@ NTSTATUS do_tree_writes(device_extension* Vcb, LIST_ENTRY* tree_writes, bool no_
             return Status;
         }
 
-        bit_num++;
-
-        le = le->Flink;
-    }
-
-    for (i = 0; i < num_bits; i++) {
-        if (wtc[i].stripes.Flink != &wtc[i].stripes) {
-            // launch writes and wait
-            le = wtc[i].stripes.Flink;
-            while (le != &wtc[i].stripes) {
-                write_data_stripe* stripe = CONTAINING_RECORD(le, write_data_stripe, list_entry);
-
-                if (stripe->status != WriteDataStatus_Ignore) {
-                    wtc[i].need_wait = true;
-                    IoCallDriver(stripe->device->devobj, stripe->Irp);
-                }
+        // launch the writes now, so the devices are busy while we set up the rest
+        le = wtc[bit_num].stripes.Flink;
+        while (le != &wtc[bit_num].stripes) {
+            write_data_stripe* stripe = CONTAINING_RECORD(le, write_data_stripe, list_entry);
 
-                le = le->Flink;
+            if (stripe->status != WriteDataStatus_Ignore) {
+                wtc[bit_num].need_wait = true;
+                IoCallDriver(stripe->device->devobj, stripe->Irp);
             }
+
+            le = le->Flink;
         }
+
+        bit_num++;
+
+        le = tw->list_entry.Flink;
     }
 
     for (i = 0; i < num_bits; i++) {
@@ -2031,27 +2078,7 @@ static NTSTATUS write_trees(device_extension* Vcb, PIRP Irp) {
             tw->data = data;
             tw->allocated = false;
 
-            if (IsListEmpty(&tree_writes))
-                InsertTailList(&tree_writes, &tw->list_entry);
-            else {
-                bool inserted = false;
-
-                le2 = tree_writes.Flink;
-                while (le2 != &tree_writes) {
-                    tree_write* tw2 = CONTAINING_RECORD(le2, tree_write, list_entry);
-
-                    if (tw2->address > tw->address) {
-                        InsertHeadList(le2->Blink, &tw->list_entry);
-                        inserted = true;
-                        break;
-                    }
-
-                    le2 = le2->Flink;
-                }
-
-                if (!inserted)
-                    InsertTailList(&tree_writes, &tw->list_entry);
-            }
+            InsertTailList(&tree_writes, &tw->list_entry);
         }
 
         le = le->Flink;
@@ -303,6 +303,12 @@ static void order_space_entry(space* s, LIST_ENTRY* list_size) {
         return;
     }
 
+    // fragmented chunks have long tails of small entries, so don't walk the whole list for one
+    if (CONTAINING_RECORD(list_size->Blink, space, list_entry_size)->size >= s->size) {
+        InsertTailList(list_size, &s->list_entry_size);
+        return;
+    }
+
     le = list_size->Flink;
 
     while (le != list_size) {
@@ -319,6 +325,32 @@ static void order_space_entry(space* s, LIST_ENTRY* list_size) {
     InsertTailList(list_size, &s->list_entry_size);
 }
 
+// s has changed size but is still in the size list - move it from where it is, rather than starting again from the top
+static void reorder_space_entry(space* s, LIST_ENTRY* list_size) {
+    LIST_ENTRY* le;
+
+    le = s->list_entry_size.Blink;
+    while (le != list_size && CONTAINING_RECORD(le, space, list_entry_size)->size < s->size) {
+        le = le->Blink;
+    }
+
+    if (le != s->list_entry_size.Blink) {
+        RemoveEntryList(&s->list_entry_size);
+        InsertHeadList(le, &s->list_entry_size);
+        return;
+    }
+
+    le = s->list_entry_size.Flink;
+    while (le != list_size && CONTAINING_RECORD(le, space, list_entry_size)->size > s->size) {
+        le = le->Flink;
+    }
+
+    if (le != s->list_entry_size.Flink) {
+        RemoveEntryList(&s->list_entry_size);
+        InsertTailList(le, &s->list_entry_size);
+    }
+}
+
 typedef struct {
     uint64_t stripe;
     LIST_ENTRY list_entry;
@@ -670,8 +702,7 @@ NTSTATUS load_stored_free_space_cache(device_extension* Vcb, chunk* c, bool load
                 RemoveEntryList(&s2->list_entry_size);
                 ExFreePool(s2);
 
-                RemoveEntryList(&s->list_entry_size);
-                order_space_entry(s, &c->space_size);
+                reorder_space_entry(s, &c->space_size);
 
                 le2 = le;
             }
@@ -869,8 +900,7 @@ static NTSTATUS load_stored_free_space_tree(device_extension* Vcb, chunk* c, PIR
                 RemoveEntryList(&s2->list_entry_size);
                 ExFreePool(s2);
 
-                RemoveEntryList(&s->list_entry_size);
-                order_space_entry(s, &c->space_size);
+                reorder_space_entry(s, &c->space_size);
 
                 le2 = le;
             }
@@ -1523,8 +1553,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
-                order_space_entry(s2, list_size);
+                reorder_space_entry(s2, list_size);
             }
 
             return;
@@ -1556,8 +1585,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
-                order_space_entry(s2, list_size);
+                reorder_space_entry(s2, list_size);
             }
 
             return;
@@ -1587,8 +1615,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
             }
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
-                order_space_entry(s2, list_size);
+                reorder_space_entry(s2, list_size);
             }
 
             return;
@@ -1624,8 +1651,7 @@ void space_list_add2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t address,
         s2->size += length;
 
         if (list_size) {
-            RemoveEntryList(&s2->list_entry_size);
-            order_space_entry(s2, list_size);
+            reorder_space_entry(s2, list_size);
         }
 
         return;
@@ -2009,8 +2035,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
                 s2->address = address + length;
 
                 if (list_size) {
-                    RemoveEntryList(&s2->list_entry_size);
-                    order_space_entry(s2, list_size);
+                    reorder_space_entry(s2, list_size);
                     order_space_entry(s, list_size);
                 }
 
@@ -2023,8 +2048,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
                 s2->address = address + length;
 
                 if (list_size) {
-                    RemoveEntryList(&s2->list_entry_size);
-                    order_space_entry(s2, list_size);
+                    reorder_space_entry(s2, list_size);
                 }
             }
         } else if (address > s2->address && address < s2->address + s2->size) { // remove end of entry
@@ -2034,8 +2058,7 @@ void space_list_subtract2(LIST_ENTRY* list, LIST_ENTRY* list_size, uint64_t addr
             s2->size = address - s2->address;
 
             if (list_size) {
-                RemoveEntryList(&s2->list_entry_size);
-                order_space_entry(s2, list_size);
+                reorder_space_entry(s2, list_size);
             }
         }
 
@@ -17,6 +17,28 @@
 
 #include "btrfs_drv.h"
 
+#ifndef __REACTOS__
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE2
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Saving the YMM state isn't free, so only bother with AVX2 for buffers
+// at least this big
+#define AVX2_MIN_LEN 512
+
+extern bool have_sse2, have_ssse3, have_avx2;
+extern tKeSaveExtendedProcessorState fKeSaveExtendedProcessorState;
+extern tKeRestoreExtendedProcessorState fKeRestoreExtendedProcessorState;
+#endif
+
 static const uint8_t glog[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
                              0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
                              0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
@@ -51,21 +73,6 @@ static const uint8_t gilog[] = {0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6,
                               0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
                               0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf};
 
-// divides the bytes in data by 2^div
-void galois_divpower(uint8_t* data, uint8_t div, uint32_t len) {
-    while (len > 0) {
-        if (data[0] != 0) {
-            if (gilog[data[0]] <= div)
-                data[0] = glog[(gilog[data[0]] + (255 - div)) % 255];
-            else
-                data[0] = glog[(gilog[data[0]] - div) % 255];
-        }
-
-        data++;
-        len--;
-    }
-}
-
 uint8_t gpow2(uint8_t e) {
     return glog[e%255];
 }
@@ -94,6 +101,58 @@ uint8_t gdiv(uint8_t a, uint8_t b) {
 // "The mathematics of RAID-6", by H. Peter Anvin.
 // https://www.kernel.org/pub/linux/kernel/people/hpa/raid6.pdf
 
+#ifndef __REACTOS__
+TARGET_SSE2 static uint32_t galois_double_sse2(uint8_t* data, uint32_t len) {
+    __m128i poly = _mm_set1_epi8(0x1d), zero = _mm_setzero_si128();
+    uint32_t done = 0;
+
+    while (len - done >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)(data + done));
+        __m128i mask = _mm_cmpgt_epi8(zero, v); // 0xff for the bytes with the top bit set
+
+        v = _mm_add_epi8(v, v);
+        v = _mm_xor_si128(v, _mm_and_si128(mask, poly));
+        _mm_storeu_si128((__m128i*)(data + done), v);
+
+        done += 16;
+    }
+
+    return done;
+}
+
+TARGET_AVX2 static uint32_t galois_double_avx2_loop(uint8_t* data, uint32_t len) {
+    __m256i poly = _mm256_set1_epi8(0x1d), zero = _mm256_setzero_si256();
+    uint32_t done = 0;
+
+    while (len - done >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*)(data + done));
+        __m256i mask = _mm256_cmpgt_epi8(zero, v);
+
+        v = _mm256_add_epi8(v, v);
+        v = _mm256_xor_si256(v, _mm256_and_si256(mask, poly));
+        _mm256_storeu_si256((__m256i*)(data + done), v);
+
+        done += 32;
+    }
+
+    return done;
+}
+
+static uint32_t galois_double_avx2(uint8_t* data, uint32_t len) {
+    XSTATE_SAVE xs;
+    uint32_t done;
+
+    if (!NT_SUCCESS(fKeSaveExtendedProcessorState(XSTATE_MASK_AVX, &xs)))
+        return 0;
+
+    done = galois_double_avx2_loop(data, len);
+
+    fKeRestoreExtendedProcessorState(&xs);
+
+    return done;
+}
+#endif
+
 #ifdef _AMD64_
 __inline static uint64_t galois_double_mask64(uint64_t v) {
     v &= 0x8080808080808080;
@@ -107,7 +166,21 @@ __inline static uint32_t galois_double_mask32(uint32_t v) {
 #endif
 
 void galois_double(uint8_t* data, uint32_t len) {
-    // FIXME - SIMD?
+#ifndef __REACTOS__
+    if (have_avx2 && len >= AVX2_MIN_LEN) {
+        uint32_t done = galois_double_avx2(data, len);
+
+        data += done;
+        len -= done;
+    }
+
+    if (have_sse2 && len >= 16) {
+        uint32_t done = galois_double_sse2(data, len);
+
+        data += done;
+        len -= done;
+    }
+#endif
 
 #ifdef _AMD64_
     while (len > sizeof(uint64_t)) {
@@ -139,3 +212,266 @@ void galois_double(uint8_t* data, uint32_t len) {
         len--;
     }
 }
+
+// Multiplication by a constant, using one lookup for each nibble - the
+// same trick as Linux's raid6 and ISA-L use for PSHUFB.
+static void galois_nibble_tables(uint8_t c, uint8_t* lo, uint8_t* hi) {
+    uint8_t i;
+
+    for (i = 0; i < 16; i++) {
+        lo[i] = gmul(c, i);
+        hi[i] = gmul(c, (uint8_t)(i << 4));
+    }
+}
+
+static void galois_mul_table(uint8_t c, uint8_t* tab) {
+    unsigned int i;
+
+    tab[0] = 0;
+
+    for (i = 1; i < 256; i++) {
+        tab[i] = gmul(c, (uint8_t)i);
+    }
+}
+
+#ifndef __REACTOS__
+TARGET_SSSE3 __inline static __m128i galois_mul_sse(__m128i v, __m128i lo, __m128i hi, __m128i mask) {
+    return _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, mask)),
+                         _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+}
+
+TARGET_AVX2 __inline static __m256i galois_mul_avx(__m256i v, __m256i lo, __m256i hi, __m256i mask) {
+    return _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask)),
+                            _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(v, 4), mask)));
+}
+
+TARGET_SSSE3 static uint32_t galois_mul_ssse3(uint8_t* data, const uint8_t* tabs, uint32_t len) {
+    __m128i lo = _mm_loadu_si128((__m128i*)tabs), hi = _mm_loadu_si128((__m128i*)(tabs + 16));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    uint32_t done = 0;
+
+    while (len - done >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)(data + done));
+
+        _mm_storeu_si128((__m128i*)(data + done), galois_mul_sse(v, lo, hi, mask));
+
+        done += 16;
+    }
+
+    return done;
+}
+
+TARGET_AVX2 static uint32_t galois_mul_avx2_loop(uint8_t* data, const uint8_t* tabs, uint32_t len) {
+    __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)tabs));
+    __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(tabs + 16)));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+    uint32_t done = 0;
+
+    while (len - done >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*)(data + done));
+
+        _mm256_storeu_si256((__m256i*)(data + done), galois_mul_avx(v, lo, hi, mask));
+
+        done += 32;
+    }
+
+    return done;
+}
+
+static uint32_t galois_mul_avx2(uint8_t* data, const uint8_t* tabs, uint32_t len) {
+    XSTATE_SAVE xs;
+    uint32_t done;
+
+    if (!NT_SUCCESS(fKeSaveExtendedProcessorState(XSTATE_MASK_AVX, &xs)))
+        return 0;
+
+    done = galois_mul_avx2_loop(data, tabs, len);
+
+    fKeRestoreExtendedProcessorState(&xs);
+
+    return done;
+}
+
+TARGET_SSSE3 static uint32_t galois_recover2_ssse3(uint8_t* qxy, uint8_t* pxy, uint8_t* p, uint8_t* q, const uint8_t* tabs, uint32_t len) {
+    __m128i alo = _mm_loadu_si128((__m128i*)tabs), ahi = _mm_loadu_si128((__m128i*)(tabs + 16));
+    __m128i blo = _mm_loadu_si128((__m128i*)(tabs + 32)), bhi = _mm_loadu_si128((__m128i*)(tabs + 48));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    uint32_t done = 0;
+
+    while (len - done >= 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((__m128i*)(p + done)), _mm_loadu_si128((__m128i*)(pxy + done)));
+        __m128i y = _mm_xor_si128(_mm_loadu_si128((__m128i*)(q + done)), _mm_loadu_si128((__m128i*)(qxy + done)));
+
+        x = galois_mul_sse(x, alo, ahi, mask);
+        y = galois_mul_sse(y, blo, bhi, mask);
+        _mm_storeu_si128((__m128i*)(qxy + done), _mm_xor_si128(x, y));
+
+        done += 16;
+    }
+
+    return done;
+}
+
+TARGET_AVX2 static uint32_t galois_recover2_avx2_loop(uint8_t* qxy, uint8_t* pxy, uint8_t* p, uint8_t* q, const uint8_t* tabs, uint32_t len) {
+    __m256i alo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)tabs));
+    __m256i ahi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(tabs + 16)));
+    __m256i blo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(tabs + 32)));
+    __m256i bhi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(tabs + 48)));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+    uint32_t done = 0;
+
+    while (len - done >= 32) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((__m256i*)(p + done)), _mm256_loadu_si256((__m256i*)(pxy + done)));
+        __m256i y = _mm256_xor_si256(_mm256_loadu_si256((__m256i*)(q + done)), _mm256_loadu_si256((__m256i*)(qxy + done)));
+
+        x = galois_mul_avx(x, alo, ahi, mask);
+        y = galois_mul_avx(y, blo, bhi, mask);
+        _mm256_storeu_si256((__m256i*)(qxy + done), _mm256_xor_si256(x, y));
+
+        done += 32;
+    }
+
+    return done;
+}
+
+static uint32_t galois_recover2_avx2(uint8_t* qxy, uint8_t* pxy, uint8_t* p, uint8_t* q, const uint8_t* tabs, uint32_t len) {
+    XSTATE_SAVE xs;
+    uint32_t done;
+
+    if (!NT_SUCCESS(fKeSaveExtendedProcessorState(XSTATE_MASK_AVX, &xs)))
+        return 0;
+
+    done = galois_recover2_avx2_loop(qxy, pxy, p, q, tabs, len);
+
+    fKeRestoreExtendedProcessorState(&xs);
+
+    return done;
+}
+
+TARGET_AVX2 static void do_xor_avx2_loop(uint8_t* buf1, uint8_t* buf2, uint32_t len) {
+    while (len >= 32) {
+        __m256i x1 = _mm256_loadu_si256((__m256i*)buf1);
+        __m256i x2 = _mm256_loadu_si256((__m256i*)buf2);
+
+        _mm256_storeu_si256((__m256i*)buf1, _mm256_xor_si256(x1, x2));
+
+        buf1 += 32;
+        buf2 += 32;
+        len -= 32;
+    }
+
+    while (len > 0) {
+        *buf1 ^= *buf2;
+        buf1++;
+        buf2++;
+        len--;
+    }
+}
+
+bool do_xor_avx2(uint8_t* buf1, uint8_t* buf2, uint32_t len) {
+    XSTATE_SAVE xs;
+
+    if (!NT_SUCCESS(fKeSaveExtendedProcessorState(XSTATE_MASK_AVX, &xs)))
+        return false;
+
+    do_xor_avx2_loop(buf1, buf2, len);
+
+    fKeRestoreExtendedProcessorState(&xs);
+
+    return true;
+}
+#endif
+
+// divides the bytes in data by 2^div
+void galois_divpower(uint8_t* data, uint8_t div, uint32_t len) {
+    uint8_t c = glog[(255 - div) % 255]; // 2^-div
+
+#ifndef __REACTOS__
+    if (have_ssse3 && len >= 16) {
+        uint8_t tabs[32];
+        uint32_t done = 0;
+
+        galois_nibble_tables(c, tabs, tabs + 16);
+
+        if (have_avx2 && len >= AVX2_MIN_LEN)
+            done = galois_mul_avx2(data, tabs, len);
+
+        done += galois_mul_ssse3(data + done, tabs, len - done);
+
+        data += done;
+        len -= done;
+    }
+#endif
+
+    if (len >= 256) {
+        uint8_t tab[256];
+
+        galois_mul_table(c, tab);
+
+        while (len > 0) {
+            data[0] = tab[data[0]];
+
+            data++;
+            len--;
+        }
+    } else {
+        while (len > 0) {
+            data[0] = gmul(c, data[0]);
+
+            data++;
+            len--;
+        }
+    }
+}
+
+// The second step of recovering two data stripes from P and Q: sets qxy
+// to a * (p ^ pxy) ^ b * (q ^ qxy).
+void galois_recover2(uint8_t* qxy, uint8_t* pxy, uint8_t* p, uint8_t* q, uint8_t a, uint8_t b, uint32_t len) {
+#ifndef __REACTOS__
+    if (have_ssse3 && len >= 16) {
+        uint8_t tabs[64];
+        uint32_t done = 0;
+
+        galois_nibble_tables(a, tabs, tabs + 16);
+        galois_nibble_tables(b, tabs + 32, tabs + 48);
+
+        if (have_avx2 && len >= AVX2_MIN_LEN)
+            done = galois_recover2_avx2(qxy, pxy, p, q, tabs, len);
+
+        done += galois_recover2_ssse3(qxy + done, pxy + done, p + done, q + done, tabs, len - done);
+
+        qxy += done;
+        pxy += done;
+        p += done;
+        q += done;
+        len -= done;
+    }
+#endif
+
+    if (len >= 256) {
+        uint8_t taba[256], tabb[256];
+
+        galois_mul_table(a, taba);
+        galois_mul_table(b, tabb);
+
+        while (len > 0) {
+            *qxy = taba[*p ^ *pxy] ^ tabb[*q ^ *qxy];
+
+            p++;
+            q++;
+            pxy++;
+            qxy++;
+            len--;
+        }
+    } else {
+        while (len > 0) {
+            *qxy = gmul(a, *p ^ *pxy) ^ gmul(b, *q ^ *qxy);
+
+            p++;
+            q++;
+            pxy++;
+            qxy++;
+            len--;
+        }
+    }
+}
@@ -867,7 +867,6 @@ void raid6_recover2(uint8_t* sectors, uint16_t num_stripes, ULONG sector_size, u
     } else { // reconstruct from p and q
         uint16_t x, y, stripe;
         uint8_t gyx, gx, denom, a, b, *p, *q, *pxy, *qxy;
-        uint32_t j;
 
         stripe = num_stripes - 3;
 
@@ -911,14 +910,7 @@ void raid6_recover2(uint8_t* sectors, uint16_t num_stripes, ULONG sector_size, u
         p = sectors + ((num_stripes - 2) * sector_size);
         q = sectors + ((num_stripes - 1) * sector_size);
 
-        for (j = 0; j < sector_size; j++) {
-            *qxy = gmul(a, *p ^ *pxy) ^ gmul(b, *q ^ *qxy);
-
-            p++;
-            q++;
-            pxy++;
-            qxy++;
-        }
+        galois_recover2(qxy, pxy, p, q, a, b, sector_size);
 
         do_xor(out + sector_size, out, sector_size);
         do_xor(out + sector_size, sectors + ((num_stripes - 2) * sector_size), sector_size);
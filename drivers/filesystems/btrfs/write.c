@@ -4102,25 +4102,98 @@ nextitem:
 
 NTSTATUS write_compressed(fcb* fcb, uint64_t start_data, uint64_t end_data, void* data, PIRP Irp, LIST_ENTRY* rollback) {
     NTSTATUS Status;
-    uint64_t i;
+    uint64_t i, num_parts;
+    uint8_t type;
+    calc_job* cj;
+
+    num_parts = sector_align(end_data - start_data, COMPRESSED_EXTENT_SIZE) / COMPRESSED_EXTENT_SIZE;
+
+    if (num_parts < 2 || get_num_of_processors() < 2) {
+        for (i = 0; i < num_parts; i++) {
+            uint64_t s2, e2;
+            bool compressed;
+
+            s2 = start_data + (i * COMPRESSED_EXTENT_SIZE);
+            e2 = min(s2 + COMPRESSED_EXTENT_SIZE, end_data);
+
+            Status = write_compressed_bit(fcb, s2, e2, (uint8_t*)data + (i * COMPRESSED_EXTENT_SIZE), &compressed, Irp, rollback);
+
+            if (!NT_SUCCESS(Status)) {
+                ERR("write_compressed_bit returned %08x\n", Status);
+                return Status;
+            }
+
+            // If the first 128 KB of a file is incompressible, we set the nocompress flag so we don't
+            // bother with the rest of it.
+            if (s2 == 0 && e2 == COMPRESSED_EXTENT_SIZE && !compressed && !fcb->Vcb->options.compress_force) {
+                fcb->inode_item.flags |= BTRFS_INODE_NOCOMPRESS;
+                fcb->inode_item_changed = true;
+                mark_fcb_dirty(fcb);
+
+                // write subsequent data non-compressed
+                if (e2 < end_data) {
+                    Status = do_write_file(fcb, e2, end_data, (uint8_t*)data + e2, Irp, false, 0, rollback);
+
+                    if (!NT_SUCCESS(Status)) {
+                        ERR("do_write_file returned %08x\n", Status);
+                        return Status;
+                    }
+                }
+
+                return STATUS_SUCCESS;
+            }
+        }
+
+        return STATUS_SUCCESS;
+    }
+
+    // Hand the compression of all the parts to the calc threads, and write each one
+    // out as soon as it's ready - checksumming and writing part i overlaps with
+    // compressing the ones after it.
+
+    type = get_compression_type(fcb);
+
+    Status = add_calc_job_comp(fcb->Vcb, type, data, (uint32_t)(end_data - start_data), &cj);
+    if (!NT_SUCCESS(Status)) {
+        ERR("add_calc_job_comp returned %08x\n", Status);
+        return Status;
+    }
+
+    Status = STATUS_SUCCESS;
 
-    for (i = 0; i < sector_align(end_data - start_data, COMPRESSED_EXTENT_SIZE) / COMPRESSED_EXTENT_SIZE; i++) {
+    for (i = 0; i < num_parts; i++) {
         uint64_t s2, e2;
-        bool compressed;
+        calc_comp_part* part = &cj->parts[i];
 
         s2 = start_data + (i * COMPRESSED_EXTENT_SIZE);
         e2 = min(s2 + COMPRESSED_EXTENT_SIZE, end_data);
 
-        Status = write_compressed_bit(fcb, s2, e2, (uint8_t*)data + (i * COMPRESSED_EXTENT_SIZE), &compressed, Irp, rollback);
+        // help out rather than just waiting
+        while (KeReadStateEvent(&part->event) == 0) {
+            if (!do_calc_job(fcb->Vcb, cj)) {
+                KeWaitForSingleObject(&part->event, Executive, KernelMode, false, NULL);
+                break;
+            }
+        }
+
+        if (!NT_SUCCESS(part->Status)) {
+            ERR("compress_data returned %08x\n", part->Status);
+            Status = part->Status;
+            break;
+        }
+
+        Status = write_compressed_part(fcb, s2, e2, (uint8_t*)data + (i * COMPRESSED_EXTENT_SIZE), type, part->buf, part->outlen, Irp, rollback);
 
         if (!NT_SUCCESS(Status)) {
-            ERR("write_compressed_bit returned %08x\n", Status);
-            return Status;
+            ERR("write_compressed_part returned %08x\n", Status);
+            break;
         }
 
         // If the first 128 KB of a file is incompressible, we set the nocompress flag so we don't
         // bother with the rest of it.
-        if (s2 == 0 && e2 == COMPRESSED_EXTENT_SIZE && !compressed && !fcb->Vcb->options.compress_force) {
+        if (s2 == 0 && e2 == COMPRESSED_EXTENT_SIZE && !part->buf && !fcb->Vcb->options.compress_force) {
+            cj->not_needed = true;
+
             fcb->inode_item.flags |= BTRFS_INODE_NOCOMPRESS;
             fcb->inode_item_changed = true;
             mark_fcb_dirty(fcb);
@@ -4129,17 +4202,30 @@ NTSTATUS write_compressed(fcb* fcb, uint64_t start_data, uint64_t end_data, void
             if (e2 < end_data) {
                 Status = do_write_file(fcb, e2, end_data, (uint8_t*)data + e2, Irp, false, 0, rollback);
 
-                if (!NT_SUCCESS(Status)) {
+                if (!NT_SUCCESS(Status))
                     ERR("do_write_file returned %08x\n", Status);
-                    return Status;
-                }
             }
 
-            return STATUS_SUCCESS;
+            break;
         }
     }
 
-    return STATUS_SUCCESS;
+    // wait for anything still in flight, as it's using our buffer
+    cj->not_needed = true;
+
+    while (do_calc_job(fcb->Vcb, cj)) {
+    }
+
+    KeWaitForSingleObject(&cj->event, Executive, KernelMode, false, NULL);
+
+    for (i = 0; i < num_parts; i++) {
+        if (cj->parts[i].buf)
+            ExFreePool(cj->parts[i].buf);
+    }
+
+    free_calc_job(cj);
+
+    return Status;
 }
 
 NTSTATUS write_file2(device_extension* Vcb, PIRP Irp, LARGE_INTEGER offset, void* buf, ULONG* length, bool paging_io, bool no_cache,
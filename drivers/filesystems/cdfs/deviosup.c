@@ -95,6 +95,30 @@ typedef IO_RUN *PIO_RUN;
 
 #define MAX_PARALLEL_IOS            5
 
+//
+//  Large sequential reads are streamed to the device as a window of
+//  CD_STREAM_DEPTH reads, each no larger than the device's maximum
+//  transfer.  A new read is issued as soon as the oldest one completes
+//  so the device always has work queued.  Only reads spanning at least
+//  CD_STREAM_MIN_CHUNKS such transfers are streamed.
+//
+
+#define CD_STREAM_DEPTH             4
+#define CD_STREAM_MIN_CHUNKS        2
+
+typedef struct _CD_STREAM_SLOT {
+
+    //
+    //  Irp for this read, with the partial Mdl of the user's buffer
+    //  attached, and the event set by its completion routine.
+    //
+
+    PIRP Irp;
+    KEVENT Event;
+
+} CD_STREAM_SLOT;
+typedef CD_STREAM_SLOT *PCD_STREAM_SLOT;
+
 //
 //  Local support routines
 //
@@ -169,6 +193,12 @@ CdWaitSync (
     _In_ PIRP_CONTEXT IrpContext
     );
 
+BOOLEAN
+CdStreamingRead (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PIO_RUN Run
+    );
+
 //  Tell prefast this is a completion routine.
 IO_COMPLETION_ROUTINE CdMultiSyncCompletionRoutine;
 
@@ -457,6 +487,20 @@ Return Value:
 
             if ((RunCount == 1) && !Unaligned && FirstPass) {
 
+                //
+                //  Large synchronous reads of file data are streamed
+                //  to the device rather than sent down as a single Io.
+                //
+
+                if (FlagOn( IrpContext->Flags, IRP_CONTEXT_FLAG_WAIT ) &&
+                    (SafeNodeType( Fcb ) != CDFS_NTC_FCB_INDEX) &&
+                    CdStreamingRead( IrpContext, &IoRuns[0] )) {
+
+                    CleanupRunCount = 0;
+                    Status = IrpContext->Irp->IoStatus.Status;
+                    try_return( NOTHING );
+                }
+
                 CdSingleAsync( IrpContext,&IoRuns[0], Fcb );
 
                 //
@@ -3428,6 +3472,222 @@ Return Value:
     KeClearEvent( &IrpContext->IoContext->SyncEvent );
 }
 
+
+//
+//  Local support routine
+//
+
+BOOLEAN
+CdStreamingRead (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PIO_RUN Run
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs a large synchronous read directly into the user's
+    buffer by keeping a window of up to CD_STREAM_DEPTH reads outstanding on
+    the device, each sized to the device's maximum transfer length.  The
+    reads are retired in order and the following portion of the transfer is
+    issued in the slot freed by each one, so the device never idles waiting
+    for us to start the next transfer.  This matters for devices where each
+    request carries a large fixed latency, such as CD images exported over
+    a network.
+
+    The final status of the transfer is stored in the Irp in the IrpContext,
+    as is done by our synchronous completion routines.
+
+Arguments:
+
+    Run - The single aligned run describing the whole transfer.  The data is
+        read into the user's buffer through partial Mdls of its TransferMdl.
+
+Return Value:
+
+    BOOLEAN - TRUE if the read was performed here, FALSE if the transfer is
+        too small to benefit from streaming and the caller should issue it
+        as a single Io.
+
+--*/
+
+{
+    CD_STREAM_SLOT Slots[CD_STREAM_DEPTH];
+    PCD_STREAM_SLOT Slot;
+    PIO_STACK_LOCATION IrpSp;
+    PDEVICE_OBJECT TargetDeviceObject = IrpContext->Vcb->TargetDeviceObject;
+    PIRP MasterIrp = IrpContext->Irp;
+    PIRP Irp;
+    PMDL Mdl;
+
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG ChunkSize;
+    ULONG ThisByteCount;
+    ULONG IssuedByteCount = 0;
+    ULONG Head = 0;
+    ULONG InFlight = 0;
+
+    PAGED_CODE();
+
+    //
+    //  Size each transfer to what the device takes in a single request.
+    //  The buffer may not be page aligned, so leave room in the physical
+    //  page limit for the extra page this may cost.
+    //
+
+    ChunkSize = IrpContext->Vcb->MaximumTransferRawSectors * RAW_SECTOR_SIZE;
+
+    if ((IrpContext->Vcb->MaximumPhysicalPages > 1) &&
+        (ChunkSize > (IrpContext->Vcb->MaximumPhysicalPages - 1) * PAGE_SIZE)) {
+
+        ChunkSize = (IrpContext->Vcb->MaximumPhysicalPages - 1) * PAGE_SIZE;
+    }
+
+    ChunkSize = SectorTruncate( ChunkSize );
+
+    if ((ChunkSize == 0) ||
+        (Run->DiskByteCount / CD_STREAM_MIN_CHUNKS < ChunkSize)) {
+
+        return FALSE;
+    }
+
+    //
+    //  Loop until every read we issued has been retired.
+    //
+
+    do {
+
+        //
+        //  Fill the window, unless we already hit an error.
+        //
+
+        while (NT_SUCCESS( Status ) &&
+               (InFlight < CD_STREAM_DEPTH) &&
+               (IssuedByteCount < Run->DiskByteCount)) {
+
+            Slot = &Slots[(Head + InFlight) % CD_STREAM_DEPTH];
+
+            ThisByteCount = Run->DiskByteCount - IssuedByteCount;
+
+            if (ThisByteCount > ChunkSize) {
+
+                ThisByteCount = ChunkSize;
+            }
+
+            //
+            //  Allocate the Irp and a partial Mdl for this portion of the
+            //  user's buffer.  If we can't, stop here and report the error
+            //  once the reads in flight are done.
+            //
+
+            Irp = IoAllocateIrp( TargetDeviceObject->StackSize, FALSE );
+
+            if (Irp == NULL) {
+
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            Mdl = IoAllocateMdl( Add2Ptr( Run->TransferVirtualAddress, IssuedByteCount, PVOID ),
+                                 ThisByteCount,
+                                 FALSE,
+                                 FALSE,
+                                 Irp );
+
+            if (Mdl == NULL) {
+
+                IoFreeIrp( Irp );
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            IoBuildPartialMdl( Run->TransferMdl,
+                               Mdl,
+                               Add2Ptr( Run->TransferVirtualAddress, IssuedByteCount, PVOID ),
+                               ThisByteCount );
+
+            Irp->Flags = IRP_READ_OPERATION | IRP_NOCACHE | FlagOn( MasterIrp->Flags, IRP_PAGING_IO );
+            Irp->RequestorMode = KernelMode;
+            Irp->Tail.Overlay.Thread = MasterIrp->Tail.Overlay.Thread;
+
+            //
+            //  Setup the Stack location to do a read from the disk driver.
+            //
+
+            IrpSp = IoGetNextIrpStackLocation( Irp );
+
+            IrpSp->MajorFunction = IRP_MJ_READ;
+            IrpSp->Parameters.Read.Length = ThisByteCount;
+            IrpSp->Parameters.Read.ByteOffset.QuadPart = Run->DiskOffset + IssuedByteCount;
+
+            KeInitializeEvent( &Slot->Event, NotificationEvent, FALSE );
+
+            IoSetCompletionRoutine( Irp,
+                                    CdSyncCompletionRoutine,
+                                    &Slot->Event,
+                                    TRUE,
+                                    TRUE,
+                                    TRUE );
+
+            Slot->Irp = Irp;
+
+            //
+            //  Any error will be picked up from the Irp when we retire it.
+            //
+
+            (VOID)IoCallDriver( TargetDeviceObject, Irp );
+
+            IssuedByteCount += ThisByteCount;
+            InFlight += 1;
+        }
+
+        if (InFlight == 0) {
+
+            break;
+        }
+
+        //
+        //  Wait for the oldest read and retire it.  Remember the first
+        //  error we see.
+        //
+
+        Slot = &Slots[Head];
+
+        (VOID)KeWaitForSingleObject( &Slot->Event,
+                                     Executive,
+                                     KernelMode,
+                                     FALSE,
+                                     NULL );
+
+        if (NT_SUCCESS( Status ) && !NT_SUCCESS( Slot->Irp->IoStatus.Status )) {
+
+            Status = Slot->Irp->IoStatus.Status;
+        }
+
+        IoFreeMdl( Slot->Irp->MdlAddress );
+        IoFreeIrp( Slot->Irp );
+
+        Head = (Head + 1) % CD_STREAM_DEPTH;
+        InFlight -= 1;
+
+    } while (TRUE);
+
+    //
+    //  Update the master Irp the way the synchronous completion
+    //  routines would have.
+    //
+
+    MasterIrp->IoStatus.Status = Status;
+
+    if (!NT_SUCCESS( Status )) {
+
+        MasterIrp->IoStatus.Information = 0;
+    }
+
+    return TRUE;
+}
+
 
 //
 //  Local support routine
@@ -2665,6 +2665,9 @@ Ext2JointExtents(
 VOID
 Ext2DestroyExtentChain(IN PEXT2_EXTENT Chain);
 
+ULONG
+Ext2MergeExtents(IN PEXT2_EXTENT Chain);
+
 NTSTATUS
 Ext2BuildExtents(
     IN PEXT2_IRP_CONTEXT    IrpContext,
@@ -294,6 +294,9 @@ Ext2ReadWriteBlocks(
         }
 
 
+        /* make sure adjacent runs go down as a single request */
+        Ext2MergeExtents(Chain);
+
         if (NULL == Chain->Next && 0 == Chain->Offset) {
 
             /* we get only 1 extent to dispatch, then don't bother allocating new irps */
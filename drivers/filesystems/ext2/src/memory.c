@@ -554,6 +554,34 @@ Ext2DestroyExtentChain(IN PEXT2_EXTENT Chain)
     }
 }
 
+/* coalesce neighbours being continuous both on disk and in the
+   user buffer, so that each of them costs a single irp */
+ULONG
+Ext2MergeExtents(IN PEXT2_EXTENT Chain)
+{
+    ULONG        count = 0;
+    PEXT2_EXTENT Extent = NULL, List = Chain;
+
+    while (List) {
+
+        count += 1;
+
+        while ((Extent = List->Next) != NULL &&
+               List->Lba + List->Length == Extent->Lba &&
+               List->Offset + List->Length == Extent->Offset) {
+
+            ASSERT(Extent->Irp == NULL);
+            List->Length += Extent->Length;
+            List->Next = Extent->Next;
+            Ext2FreeExtent(Extent);
+        }
+
+        List = List->Next;
+    }
+
+    return count;
+}
+
 BOOLEAN
 Ext2ListExtents(PLARGE_MCB  Extents)
 {
@@ -1261,8 +1289,10 @@ Ext2BuildExtents(
                      &Mapped);
 
             if (!rc) {
-                /* we likely get a sparse file here */
-                Mapped = 1;
+                /* we likely get a sparse file here: nothing is mapped
+                   beyond the last run of the zone, so skip the whole
+                   tail at once unless we are to allocate it */
+                Mapped = bAlloc ? 1 : End - Start;
                 Block = 0;
             }
         }
@@ -1316,9 +1346,11 @@ Ext2BuildExtents(
 
         if (Block != 0) {
 
-            if (List && List->Lba + List->Length == Lba) {
+            if (List && List->Lba + List->Length == Lba &&
+                List->Offset + List->Length == Total) {
 
-                /* it's continuous upon previous Extent */
+                /* it's continuous upon previous Extent, both on disk
+                   and in the buffer (no sparse gap in between) */
                 List->Length += Length;
 
             } else {
@@ -176,6 +176,15 @@ FindFile(
             ExFreePoolWithTag(PathNameBuffer, TAG_NAME);
             return Status;
         }
+
+        /* then in the directory name index, if there's one */
+        Status = vfatNameIndexFind(DeviceExt, Parent, FileToFindU, DirContext);
+        if (Status != STATUS_NOT_SUPPORTED)
+        {
+            DPRINT("FindFile: index lookup of %wZ: %lx\n", FileToFindU, Status);
+            ExFreePoolWithTag(PathNameBuffer, TAG_NAME);
+            return Status;
+        }
     }
 
     /* FsRtlIsNameInExpression need the searched string to be upcase,
@@ -763,6 +763,9 @@ FATAddEntry(
     CcSetDirtyPinnedData(Context, NULL);
     CcUnpinData(Context);
 
+    /* The entry is on disk now, lookups must find it */
+    vfatNameIndexAddEntry(DeviceExt, ParentFcb, DirContext.DirIndex);
+
     if (MoveContext != NULL)
     {
         /* We're modifying an existing FCB - likely rename/move */
@@ -1023,9 +1026,12 @@ FATDelEntry(
         CcUnpinData(Context);
     }
 
+    vfatNameIndexRemoveEntry(pFcb->parentFcb, pFcb);
+
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        vfatTruncateClusterMap(pFcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
@@ -1105,6 +1111,7 @@ FATXDelEntry(
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        vfatTruncateClusterMap(pFcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
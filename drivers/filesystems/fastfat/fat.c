@@ -20,6 +20,17 @@
 #define  CACHEPAGESIZE(pDeviceExt) ((pDeviceExt)->FatInfo.BytesPerCluster > PAGE_SIZE ? \
 		   (pDeviceExt)->FatInfo.BytesPerCluster : PAGE_SIZE)
 
+/* Don't split the bitmap scan in chunks smaller than that many FAT pages */
+#define FREE_CLUSTER_BITMAP_MIN_CHUNK 64
+
+typedef struct _FREE_CLUSTER_BITMAP_CHUNK
+{
+    PDEVICE_EXTENSION DeviceExt;
+    PIO_WORKITEM WorkItem;
+    ULONG FirstCluster;
+    ULONG LastCluster;
+} FREE_CLUSTER_BITMAP_CHUNK, *PFREE_CLUSTER_BITMAP_CHUNK;
+
 /* FUNCTIONS ****************************************************************/
 
 /*
@@ -326,6 +337,40 @@ FAT32FindAndMarkAvailableCluster(
     *Cluster = 0;
     StartCluster = DeviceExt->LastAvailableCluster;
 
+    if (DeviceExt->FreeClusterBitmapValid)
+    {
+        /* Take the next free cluster after the last one, to keep files contiguous */
+        i = RtlFindClearBitsAndSet(&DeviceExt->FreeClusterBitmap, 1, StartCluster);
+        if (i == 0xFFFFFFFF)
+        {
+            return STATUS_DISK_FULL;
+        }
+
+        Offset.QuadPart = ROUND_DOWN(i * 4, ChunkSize);
+        _SEH2_TRY
+        {
+            CcPinRead(DeviceExt->FATFileObject, &Offset, ChunkSize, PIN_WAIT, &Context, &BaseAddress);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            DPRINT1("CcPinRead(Offset %x, Length %u) failed\n", (ULONG)Offset.QuadPart, ChunkSize);
+            RtlClearBits(&DeviceExt->FreeClusterBitmap, i, 1);
+            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+        }
+        _SEH2_END;
+        Block = (PULONG)((ULONG_PTR)BaseAddress + (i * 4) % ChunkSize);
+        ASSERT((*Block & 0x0fffffff) == 0);
+
+        DPRINT("Found available cluster 0x%x\n", i);
+        DeviceExt->LastAvailableCluster = *Cluster = i;
+        *Block = 0x0fffffff;
+        CcSetDirtyPinnedData(Context, NULL);
+        CcUnpinData(Context);
+        if (DeviceExt->AvailableClustersValid)
+            InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
+        return STATUS_SUCCESS;
+    }
+
     for (j = 0; j < 2; j++)
     {
         for (i = StartCluster; i < FatLength;)
@@ -354,6 +399,9 @@ FAT32FindAndMarkAvailableCluster(
                     *Block = 0x0fffffff;
                     CcSetDirtyPinnedData(Context, NULL);
                     CcUnpinData(Context);
+                    /* The bitmap may be getting built */
+                    if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                        RtlSetBits(&DeviceExt->FreeClusterBitmap, i, 1);
                     if (DeviceExt->AvailableClustersValid)
                         InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
                     return STATUS_SUCCESS;
@@ -541,6 +589,10 @@ CountAvailableClusters(
     PLARGE_INTEGER Clusters)
 {
     NTSTATUS Status = STATUS_SUCCESS;
+
+    /* If the FAT is being scanned for the bitmap, it will have the count */
+    KeWaitForSingleObject(&DeviceExt->FreeClusterBitmapEvent, Executive, KernelMode, FALSE, NULL);
+
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     if (!DeviceExt->AvailableClustersValid)
     {
@@ -717,6 +769,13 @@ WriteCluster(
         else if (OldValue == 0 && NewValue)
             InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
     }
+    if (NT_SUCCESS(Status) && DeviceExt->FreeClusterBitmap.Buffer != NULL)
+    {
+        if (NewValue == 0)
+            RtlClearBits(&DeviceExt->FreeClusterBitmap, ClusterToWrite, 1);
+        else
+            RtlSetBits(&DeviceExt->FreeClusterBitmap, ClusterToWrite, 1);
+    }
     ExReleaseResourceLite(&DeviceExt->FatResource);
     return Status;
 }
@@ -1290,4 +1349,225 @@ FAT32UpdateFreeClustersCount(
 #endif
 }
 
+/*
+ * FUNCTION: Publish the free cluster bitmap once the whole FAT was scanned,
+ *           or drop it if that failed
+ */
+static
+VOID
+FAT32CompleteFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    ExAcquireResourceExclusiveLite(&DeviceExt->FatResource, TRUE);
+    if (NT_SUCCESS(DeviceExt->FreeClusterBitmapStatus))
+    {
+        DeviceExt->AvailableClusters = RtlNumberOfClearBits(&DeviceExt->FreeClusterBitmap);
+        DeviceExt->AvailableClustersValid = TRUE;
+        DeviceExt->FreeClusterBitmapValid = TRUE;
+        DPRINT("Free cluster bitmap ready, %u clusters available\n", DeviceExt->AvailableClusters);
+    }
+    else
+    {
+        DPRINT1("Failed to build the free cluster bitmap: %lx\n", DeviceExt->FreeClusterBitmapStatus);
+        ExFreePoolWithTag(DeviceExt->FreeClusterBitmap.Buffer, TAG_BITMAP);
+        DeviceExt->FreeClusterBitmap.Buffer = NULL;
+    }
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+
+    KeSetEvent(&DeviceExt->FreeClusterBitmapEvent, IO_NO_INCREMENT, FALSE);
+}
+
+/*
+ * FUNCTION: Scan a part of the FAT32 table into the free cluster bitmap
+ */
+static
+VOID
+NTAPI
+FAT32ScanFreeClusterBitmap(
+    PDEVICE_OBJECT DeviceObject,
+    PVOID Context)
+{
+    PFREE_CLUSTER_BITMAP_CHUNK Chunk = Context;
+    PDEVICE_EXTENSION DeviceExt = Chunk->DeviceExt;
+    PULONG Bitmap = DeviceExt->FreeClusterBitmap.Buffer;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PULONG Block;
+    PULONG BlockEnd;
+    PVOID BaseAddress;
+    PVOID PinContext;
+    ULONG ChunkSize;
+    LARGE_INTEGER Offset;
+    ULONG i;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    DPRINT("Scanning clusters 0x%x to 0x%x\n", Chunk->FirstCluster, Chunk->LastCluster);
+
+    FsRtlEnterFileSystem();
+
+    ChunkSize = CACHEPAGESIZE(DeviceExt);
+    for (i = Chunk->FirstCluster; i < Chunk->LastCluster; )
+    {
+        /*
+         * Writers update the bitmap too, so hold them off while a page is
+         * processed. Chunks are made of whole FAT pages, so scans running
+         * in parallel never touch the same bitmap ULONG.
+         */
+        ExAcquireResourceSharedLite(&DeviceExt->FatResource, TRUE);
+        if (DeviceExt->FreeClusterBitmapCancel)
+        {
+            ExReleaseResourceLite(&DeviceExt->FatResource);
+            Status = STATUS_CANCELLED;
+            break;
+        }
+
+        Offset.QuadPart = ROUND_DOWN(i * 4, ChunkSize);
+        _SEH2_TRY
+        {
+            CcMapData(DeviceExt->FATFileObject, &Offset, ChunkSize, MAP_WAIT, &PinContext, &BaseAddress);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = _SEH2_GetExceptionCode();
+        }
+        _SEH2_END;
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("CcMapData(Offset %x, Length %u) failed\n", (ULONG)Offset.QuadPart, ChunkSize);
+            ExReleaseResourceLite(&DeviceExt->FatResource);
+            break;
+        }
+
+        Block = (PULONG)((ULONG_PTR)BaseAddress + (i * 4) % ChunkSize);
+        BlockEnd = (PULONG)((ULONG_PTR)BaseAddress + ChunkSize);
+
+        /* Now process the whole block */
+        while (Block < BlockEnd && i < Chunk->LastCluster)
+        {
+            if ((*Block & 0x0fffffff) == 0)
+                Bitmap[i / 32] &= ~(1 << (i % 32));
+            else
+                Bitmap[i / 32] |= 1 << (i % 32);
+            Block++;
+            i++;
+        }
+
+        CcUnpinData(PinContext);
+        ExReleaseResourceLite(&DeviceExt->FatResource);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        InterlockedCompareExchange(&DeviceExt->FreeClusterBitmapStatus, Status, STATUS_SUCCESS);
+    }
+
+    IoFreeWorkItem(Chunk->WorkItem);
+    ExFreePoolWithTag(Chunk, TAG_BITMAP);
+
+    /* The last chunk publishes the bitmap */
+    if (InterlockedDecrement(&DeviceExt->FreeClusterBitmapPending) == 0)
+    {
+        FAT32CompleteFreeClusterBitmap(DeviceExt);
+    }
+
+    FsRtlExitFileSystem();
+}
+
+/*
+ * FUNCTION: Start building the free cluster bitmap of a FAT32 volume. The
+ *           FAT is scanned in the background, by one chunk per processor,
+ *           and the old FAT scans are used until it's done.
+ */
+VOID
+FAT32BuildFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    PFREE_CLUSTER_BITMAP_CHUNK Chunk;
+    PULONG Buffer;
+    ULONG FatLength;
+    ULONG ClustersPerPage;
+    ULONG Pages, Chunks, PagesPerChunk;
+    ULONG i;
+
+    ASSERT(DeviceExt->FatInfo.FatType == FAT32 || DeviceExt->FatInfo.FatType == FATX32);
+    ASSERT(DeviceExt->FreeClusterBitmap.Buffer == NULL);
+
+    FatLength = DeviceExt->FatInfo.NumberOfClusters + 2;
+    Buffer = ExAllocatePoolWithTag(PagedPool, ROUND_UP(FatLength, 32) / 8, TAG_BITMAP);
+    if (Buffer == NULL)
+    {
+        /* CountAvailableClusters() will scan the FAT then */
+        return;
+    }
+
+    RtlInitializeBitMap(&DeviceExt->FreeClusterBitmap, Buffer, FatLength);
+    RtlClearAllBits(&DeviceExt->FreeClusterBitmap);
+    /* The two first FAT entries aren't clusters */
+    RtlSetBits(&DeviceExt->FreeClusterBitmap, 0, 2);
+
+    ClustersPerPage = CACHEPAGESIZE(DeviceExt) / sizeof(ULONG);
+    Pages = (FatLength + ClustersPerPage - 1) / ClustersPerPage;
+    Chunks = min(VfatGlobalData->NumberProcessors, Pages / FREE_CLUSTER_BITMAP_MIN_CHUNK);
+    Chunks = max(Chunks, 1);
+    PagesPerChunk = (Pages + Chunks - 1) / Chunks;
+
+    DeviceExt->FreeClusterBitmapStatus = STATUS_SUCCESS;
+    DeviceExt->FreeClusterBitmapCancel = FALSE;
+    KeClearEvent(&DeviceExt->FreeClusterBitmapEvent);
+
+    /* Hold a reference while queueing, so no chunk completes the build early */
+    DeviceExt->FreeClusterBitmapPending = 1;
+
+    for (i = 0; i < Chunks; i++)
+    {
+        Chunk = ExAllocatePoolWithTag(NonPagedPool, sizeof(FREE_CLUSTER_BITMAP_CHUNK), TAG_BITMAP);
+        if (Chunk == NULL)
+        {
+            DeviceExt->FreeClusterBitmapStatus = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        Chunk->WorkItem = IoAllocateWorkItem(DeviceExt->VolumeDevice);
+        if (Chunk->WorkItem == NULL)
+        {
+            ExFreePoolWithTag(Chunk, TAG_BITMAP);
+            DeviceExt->FreeClusterBitmapStatus = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        Chunk->DeviceExt = DeviceExt;
+        Chunk->FirstCluster = max(i * PagesPerChunk * ClustersPerPage, 2);
+        Chunk->LastCluster = min((i + 1) * PagesPerChunk * ClustersPerPage, FatLength);
+
+        InterlockedIncrement(&DeviceExt->FreeClusterBitmapPending);
+        IoQueueWorkItem(Chunk->WorkItem, FAT32ScanFreeClusterBitmap, DelayedWorkQueue, Chunk);
+    }
+
+    DPRINT("Building free cluster bitmap in %u chunks\n", i);
+
+    /* Drop our reference, completing the build if all the chunks are done */
+    if (InterlockedDecrement(&DeviceExt->FreeClusterBitmapPending) == 0)
+    {
+        FAT32CompleteFreeClusterBitmap(DeviceExt);
+    }
+}
+
+/*
+ * FUNCTION: Stop any bitmap scan and free the bitmap, before dismounting
+ */
+VOID
+FAT32DeleteFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    DeviceExt->FreeClusterBitmapCancel = TRUE;
+    KeWaitForSingleObject(&DeviceExt->FreeClusterBitmapEvent, Executive, KernelMode, FALSE, NULL);
+
+    DeviceExt->FreeClusterBitmapValid = FALSE;
+    if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+    {
+        ExFreePoolWithTag(DeviceExt->FreeClusterBitmap.Buffer, TAG_BITMAP);
+        DeviceExt->FreeClusterBitmap.Buffer = NULL;
+    }
+}
+
 /* EOF */
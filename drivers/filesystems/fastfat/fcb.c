@@ -152,6 +152,7 @@ vfatNewFCB(
     ExInitializeResourceLite(&rcFCB->MainResource);
     FsRtlInitializeFileLock(&rcFCB->FileLock, NULL, NULL);
     ExInitializeFastMutex(&rcFCB->LastMutex);
+    FsRtlInitializeLargeMcb(&rcFCB->ClusterMap, PagedPool);
     rcFCB->RFCB.PagingIoResource = &rcFCB->PagingIoResource;
     rcFCB->RFCB.Resource = &rcFCB->MainResource;
     rcFCB->RFCB.IsFastIoPossible = FastIoIsNotPossible;
@@ -277,6 +278,8 @@ vfatDestroyFCB(
 #endif
 
     FsRtlUninitializeFileLock(&pFCB->FileLock);
+    FsRtlUninitializeLargeMcb(&pFCB->ClusterMap);
+    vfatNameIndexFree(pFCB);
 
     if (!vfatFCBIsRoot(pFCB) &&
         !BooleanFlagOn(pFCB->Flags, FCB_IS_FAT) && !BooleanFlagOn(pFCB->Flags, FCB_IS_VOLUME))
@@ -824,6 +827,17 @@ vfatDirFindFile(
     DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
     DirContext.DeviceExt = pDeviceExt;
 
+    /* Large directories have an index, try it first */
+    status = vfatNameIndexFind(pDeviceExt, pDirectoryFCB, FileToFindU, &DirContext);
+    if (status == STATUS_SUCCESS)
+    {
+        return vfatMakeFCBFromDirEntry(pDeviceExt, pDirectoryFCB, &DirContext, pFoundFCB);
+    }
+    else if (status == STATUS_NO_MORE_ENTRIES)
+    {
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
     while (TRUE)
     {
         status = VfatGetNextDirEntry(pDeviceExt,
@@ -1245,6 +1245,7 @@ VfatSetAllocationSizeInformation(
         if (FirstCluster == 0)
         {
             Fcb->LastCluster = Fcb->LastOffset = 0;
+            vfatTruncateClusterMap(Fcb, 0);
             Status = NextCluster(DeviceExt, FirstCluster, &FirstCluster, TRUE);
             if (!NT_SUCCESS(Status))
             {
@@ -1310,9 +1311,9 @@ VfatSetAllocationSizeInformation(
             }
             else
             {
-                Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                         Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize,
-                                         &Cluster, FALSE);
+                Status = vfatFileOffsetToCluster(DeviceExt, Fcb, FirstCluster,
+                                                 Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize,
+                                                 &Cluster);
             }
 
             if (!NT_SUCCESS(Status))
@@ -1360,12 +1361,13 @@ VfatSetAllocationSizeInformation(
         AllocSizeChanged = TRUE;
         /* FIXME: Use the cached cluster/offset better way. */
         Fcb->LastCluster = Fcb->LastOffset = 0;
+        vfatTruncateClusterMap(Fcb, ROUND_UP(NewSize, ClusterSize) / ClusterSize);
         UpdateFileSize(FileObject, Fcb, NewSize, ClusterSize, vfatVolumeIsFatX(DeviceExt));
         if (NewSize > 0)
         {
-            Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                     ROUND_DOWN(NewSize - 1, ClusterSize),
-                                     &Cluster, FALSE);
+            Status = vfatFileOffsetToCluster(DeviceExt, Fcb, FirstCluster,
+                                             ROUND_DOWN(NewSize - 1, ClusterSize),
+                                             &Cluster);
 
             NCluster = Cluster;
             Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
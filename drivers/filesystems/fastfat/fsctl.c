@@ -733,7 +733,12 @@ VfatMount(
     _SEH2_END;
 
     DeviceExt->LastAvailableCluster = 2;
-    CountAvailableClusters(DeviceExt, NULL);
+    KeInitializeEvent(&DeviceExt->FreeClusterBitmapEvent, NotificationEvent, TRUE);
+    /* FAT32 volumes get their free clusters counted with the bitmap, below */
+    if (DeviceExt->FatInfo.FatType != FAT32 && DeviceExt->FatInfo.FatType != FATX32)
+    {
+        CountAvailableClusters(DeviceExt, NULL);
+    }
     ExInitializeResourceLite(&DeviceExt->FatResource);
 
     InitializeListHead(&DeviceExt->FcbListHead);
@@ -792,6 +797,12 @@ VfatMount(
     InitializeListHead(&DeviceExt->NotifyList);
     FsRtlNotifyInitializeSync(&DeviceExt->NotifySync);
 
+    /* Scan the FAT in the background, instead of delaying the mount */
+    if (DeviceExt->FatInfo.FatType == FAT32 || DeviceExt->FatInfo.FatType == FATX32)
+    {
+        FAT32BuildFreeClusterBitmap(DeviceExt);
+    }
+
     /* The VCB is OK for usage */
     SetFlag(DeviceExt->Flags, VCB_GOOD);
 
@@ -514,6 +514,9 @@ VfatCheckForDismount(
         /* We are uninitializing, the VCB cannot be used anymore */
         ClearFlag(DeviceExt->Flags, VCB_GOOD);
 
+        /* Stop scanning the FAT before closing it */
+        FAT32DeleteFreeClusterBitmap(DeviceExt);
+
         /* Invalidate and close the internal opened meta-files */
         if (DeviceExt->RootFcb)
         {
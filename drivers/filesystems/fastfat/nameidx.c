@@ -0,0 +1,493 @@
+/*
+ * COPYRIGHT:        See COPYING in the top level directory
+ * PROJECT:          ReactOS kernel
+ * FILE:             drivers/filesystems/fastfat/nameidx.c
+ * PURPOSE:          VFAT Filesystem : in-memory index of directory names
+ *
+ */
+
+/*
+ * Looking a name up in a directory means reading all its entries until
+ * one matches, which gets slow when a directory holds tens of thousands
+ * of files. Large directories get an index mapping the hash of each long
+ * and short name to the position of its entry.
+ *
+ * The index only gives hints: an entry found through it is always read
+ * back and compared, and hints which don't match the directory anymore
+ * are dropped. It must however never miss a name, so all the routines
+ * writing new entries have to report them, and the index gets dropped
+ * whenever it can't be kept up to date.
+ *
+ * The index lives in the directory FCB and is protected by the volume
+ * DirResource, which all callers hold exclusively.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "vfat.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* Directories smaller than that are scanned, this is cheap enough */
+#define VFAT_NAME_INDEX_MIN_SIZE (32 * 1024)
+
+/* Average number of names per bucket before growing the table */
+#define VFAT_NAME_INDEX_MAX_LOAD 4
+
+/* FUNCTIONS ****************************************************************/
+
+/*
+ * Same as vfatNameHash() in fcb.c, but names are upcased the way
+ * RtlEqualUnicodeString() does, so that equal names get equal hashes.
+ */
+static
+ULONG
+vfatNameIndexHash(
+    PUNICODE_STRING NameU)
+{
+    PWCHAR last;
+    PWCHAR curr;
+    WCHAR c;
+    ULONG hash = 0;
+
+    curr = NameU->Buffer;
+    last = NameU->Buffer + NameU->Length / sizeof(WCHAR);
+
+    while (curr < last)
+    {
+        c = RtlUpcaseUnicodeChar(*curr++);
+        hash = (hash + (c << 4) + (c >> 4)) * 11;
+    }
+    return hash;
+}
+
+static
+PVFAT_NAME_INDEX
+vfatNameIndexAllocate(
+    ULONG BucketCount)
+{
+    PVFAT_NAME_INDEX Index;
+    SIZE_T Size;
+
+    Size = FIELD_OFFSET(VFAT_NAME_INDEX, Buckets[BucketCount]);
+    Index = ExAllocatePoolWithTag(PagedPool, Size, TAG_NAME_INDEX);
+    if (Index == NULL)
+    {
+        return NULL;
+    }
+
+    RtlZeroMemory(Index, Size);
+    Index->BucketCount = BucketCount;
+    return Index;
+}
+
+/*
+ * Rehash all the names in a larger bucket array. Failing to do so
+ * isn't fatal, lookups only get longer.
+ */
+static
+VOID
+vfatNameIndexGrow(
+    PVFATFCB DirFcb)
+{
+    PVFAT_NAME_INDEX OldIndex = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX NewIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry, Next;
+    ULONG i;
+
+    NewIndex = vfatNameIndexAllocate(OldIndex->BucketCount * 2);
+    if (NewIndex == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < OldIndex->BucketCount; i++)
+    {
+        for (Entry = OldIndex->Buckets[i]; Entry != NULL; Entry = Next)
+        {
+            Next = Entry->Next;
+            Entry->Next = NewIndex->Buckets[Entry->Hash % NewIndex->BucketCount];
+            NewIndex->Buckets[Entry->Hash % NewIndex->BucketCount] = Entry;
+        }
+    }
+
+    NewIndex->EntryCount = OldIndex->EntryCount;
+    DirFcb->NameIndex = NewIndex;
+    ExFreePoolWithTag(OldIndex, TAG_NAME_INDEX);
+}
+
+static
+BOOLEAN
+vfatNameIndexInsert(
+    PVFATFCB DirFcb,
+    ULONG Hash,
+    ULONG DirIndex)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry;
+
+    Entry = ExAllocateFromPagedLookasideList(&VfatGlobalData->NameIndexLookasideList);
+    if (Entry == NULL)
+    {
+        return FALSE;
+    }
+
+    Entry->Hash = Hash;
+    Entry->DirIndex = DirIndex;
+    Entry->Next = Index->Buckets[Hash % Index->BucketCount];
+    Index->Buckets[Hash % Index->BucketCount] = Entry;
+    Index->EntryCount++;
+
+    if (Index->EntryCount > Index->BucketCount * VFAT_NAME_INDEX_MAX_LOAD)
+    {
+        vfatNameIndexGrow(DirFcb);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Add the long and short names of the entry that was read in DirContext
+ */
+static
+BOOLEAN
+vfatNameIndexInsertNames(
+    PVFATFCB DirFcb,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    ULONG LongHash, ShortHash;
+
+    LongHash = vfatNameIndexHash(&DirContext->LongNameU);
+    if (!vfatNameIndexInsert(DirFcb, LongHash, DirContext->DirIndex))
+    {
+        return FALSE;
+    }
+
+    ShortHash = vfatNameIndexHash(&DirContext->ShortNameU);
+    if (ShortHash != LongHash &&
+        !vfatNameIndexInsert(DirFcb, ShortHash, DirContext->DirIndex))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Unlink and free all the names of the entry at DirIndex with this hash
+ */
+static
+VOID
+vfatNameIndexRemove(
+    PVFATFCB DirFcb,
+    ULONG Hash,
+    ULONG DirIndex)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY *Link, Entry;
+
+    Link = &Index->Buckets[Hash % Index->BucketCount];
+    while (*Link != NULL)
+    {
+        Entry = *Link;
+        if (Entry->Hash == Hash && Entry->DirIndex == DirIndex)
+        {
+            *Link = Entry->Next;
+            Index->EntryCount--;
+            ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+        }
+        else
+        {
+            Link = &Entry->Next;
+        }
+    }
+}
+
+VOID
+vfatNameIndexFree(
+    PVFATFCB DirFcb)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry, Next;
+    ULONG i;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        for (Entry = Index->Buckets[i]; Entry != NULL; Entry = Next)
+        {
+            Next = Entry->Next;
+            ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+        }
+    }
+
+    DirFcb->NameIndex = NULL;
+    ExFreePoolWithTag(Index, TAG_NAME_INDEX);
+}
+
+/*
+ * Read the entry whose short name is at DirIndex. Fails if there is no
+ * valid entry there anymore.
+ */
+static
+NTSTATUS
+vfatNameIndexReadEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    ULONG DirIndex,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVOID Context = NULL;
+    PVOID Page;
+    NTSTATUS Status;
+
+    DirContext->DirIndex = DirIndex;
+    Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, DirContext, TRUE);
+    if (Context != NULL)
+    {
+        CcUnpinData(Context);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+
+    if (DirContext->DirIndex != DirIndex ||
+        ENTRY_VOLUME(FALSE, &DirContext->DirEntry) ||
+        DirContext->LongNameU.Length == 0 ||
+        DirContext->ShortNameU.Length == 0)
+    {
+        return STATUS_NO_MORE_ENTRIES;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+vfatNameIndexBuild(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb)
+{
+    NTSTATUS Status;
+    PVOID Context = NULL;
+    PVOID Page = NULL;
+    BOOLEAN First = TRUE;
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    /* See vfatDirFindFile() for the size */
+    WCHAR LongNameBuffer[260];
+    WCHAR ShortNameBuffer[13];
+
+    ASSERT(DirFcb->NameIndex == NULL);
+
+    /* FATX directories are always scanned */
+    if (vfatVolumeIsFatX(DeviceExt) ||
+        DirFcb->RFCB.FileSize.u.LowPart < VFAT_NAME_INDEX_MIN_SIZE)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    /* Initially, expect about one file out of two entries */
+    DirFcb->NameIndex = vfatNameIndexAllocate(DirFcb->RFCB.FileSize.u.LowPart /
+                                              sizeof(FAT_DIR_ENTRY) / 2);
+    if (DirFcb->NameIndex == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    DirContext.DirIndex = 0;
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.Length = 0;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.Length = 0;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+    DirContext.DeviceExt = DeviceExt;
+
+    while (TRUE)
+    {
+        Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, &DirContext, First);
+        First = FALSE;
+        if (Status == STATUS_NO_MORE_ENTRIES)
+        {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
+
+        /* Skip what lookups skip, see FindFile() */
+        if (!ENTRY_VOLUME(FALSE, &DirContext.DirEntry) &&
+            DirContext.LongNameU.Length != 0 &&
+            DirContext.ShortNameU.Length != 0)
+        {
+            if (!vfatNameIndexInsertNames(DirFcb, &DirContext))
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+        }
+
+        DirContext.DirIndex++;
+    }
+
+    if (Context != NULL)
+    {
+        CcUnpinData(Context);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        vfatNameIndexFree(DirFcb);
+        return Status;
+    }
+
+    DPRINT("Indexed %u names in %wZ\n", DirFcb->NameIndex->EntryCount, &DirFcb->PathNameU);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * FUNCTION: Find the first entry at or after DirContext->DirIndex whose
+ * long or short name is FileToFindU, using the directory name index.
+ * Returns STATUS_NO_MORE_ENTRIES if there is none, or STATUS_NOT_SUPPORTED
+ * if the directory has to be scanned instead.
+ */
+NTSTATUS
+vfatNameIndexFind(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVFAT_NAME_INDEX_ENTRY Entry, Candidate;
+    ULONG Hash, FirstIndex, CandidateIndex;
+    NTSTATUS Status;
+
+    ASSERT(ExIsResourceAcquiredExclusive(&DeviceExt->DirResource));
+
+    if (DirFcb->NameIndex == NULL &&
+        !NT_SUCCESS(vfatNameIndexBuild(DeviceExt, DirFcb)))
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Hash = vfatNameIndexHash(FileToFindU);
+    FirstIndex = DirContext->DirIndex;
+
+    while (TRUE)
+    {
+        /* Take the candidates in directory order, like a scan would */
+        Candidate = NULL;
+        CandidateIndex = 0;
+        Entry = DirFcb->NameIndex->Buckets[Hash % DirFcb->NameIndex->BucketCount];
+        for (; Entry != NULL; Entry = Entry->Next)
+        {
+            if (Entry->Hash == Hash && Entry->DirIndex >= FirstIndex &&
+                (Candidate == NULL || Entry->DirIndex < CandidateIndex))
+            {
+                Candidate = Entry;
+                CandidateIndex = Entry->DirIndex;
+            }
+        }
+
+        if (Candidate == NULL)
+        {
+            return STATUS_NO_MORE_ENTRIES;
+        }
+
+        Status = vfatNameIndexReadEntry(DeviceExt, DirFcb, CandidateIndex, DirContext);
+        if (NT_SUCCESS(Status))
+        {
+            if (RtlEqualUnicodeString(FileToFindU, &DirContext->LongNameU, TRUE) ||
+                RtlEqualUnicodeString(FileToFindU, &DirContext->ShortNameU, TRUE))
+            {
+                DPRINT("vfatNameIndexFind: found %wZ at %u\n", &DirContext->LongNameU, CandidateIndex);
+                return STATUS_SUCCESS;
+            }
+
+            /* Another name with the same hash, keep looking */
+            if (vfatNameIndexHash(&DirContext->LongNameU) != Hash &&
+                vfatNameIndexHash(&DirContext->ShortNameU) != Hash)
+            {
+                vfatNameIndexRemove(DirFcb, Hash, CandidateIndex);
+            }
+        }
+        else if (Status == STATUS_NO_MORE_ENTRIES)
+        {
+            /* The entry is gone, forget about it */
+            vfatNameIndexRemove(DirFcb, Hash, CandidateIndex);
+        }
+        else
+        {
+            /* Can't trust the index anymore, let the caller scan */
+            vfatNameIndexFree(DirFcb);
+            DirContext->DirIndex = FirstIndex;
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        FirstIndex = CandidateIndex + 1;
+    }
+}
+
+/*
+ * FUNCTION: Add to the index the entry just written at DirIndex
+ */
+VOID
+vfatNameIndexAddEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    ULONG DirIndex)
+{
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    WCHAR LongNameBuffer[260];
+    WCHAR ShortNameBuffer[13];
+
+    if (DirFcb->NameIndex == NULL)
+    {
+        return;
+    }
+
+    /* Read the names back, so that they are exactly what a scan would return */
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.Length = 0;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.Length = 0;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+    DirContext.DeviceExt = DeviceExt;
+
+    if (!NT_SUCCESS(vfatNameIndexReadEntry(DeviceExt, DirFcb, DirIndex, &DirContext)) ||
+        !vfatNameIndexInsertNames(DirFcb, &DirContext))
+    {
+        /* The name would be missing, drop the index instead */
+        DPRINT1("Dropping name index of %wZ\n", &DirFcb->PathNameU);
+        vfatNameIndexFree(DirFcb);
+    }
+}
+
+/*
+ * FUNCTION: Remove from the index the entry of an FCB being deleted
+ */
+VOID
+vfatNameIndexRemoveEntry(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb)
+{
+    if (DirFcb->NameIndex == NULL)
+    {
+        return;
+    }
+
+    vfatNameIndexRemove(DirFcb, vfatNameIndexHash(&Fcb->LongNameU), Fcb->dirIndex);
+    vfatNameIndexRemove(DirFcb, vfatNameIndexHash(&Fcb->ShortNameU), Fcb->dirIndex);
+}
+
+/* EOF */
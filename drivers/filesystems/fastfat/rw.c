@@ -113,6 +113,143 @@ OffsetToCluster(
    }
 }
 
+/*
+ * Append a run of contiguous clusters, starting at file cluster Vcn, to
+ * the cached extents of the FCB cluster chain
+ */
+static
+VOID
+vfatAddClusterRun(
+    PVFATFCB Fcb,
+    ULONG Vcn,
+    ULONG Cluster,
+    ULONG ClusterCount)
+{
+    ExAcquireFastMutex(&Fcb->LastMutex);
+    /* Only the known prefix of the chain is kept. Anything not directly
+     * adjacent raced with a change of the allocation, drop it */
+    if (Vcn <= Fcb->ClusterMapCount && Vcn + ClusterCount > Fcb->ClusterMapCount)
+    {
+        if (FsRtlAddLargeMcbEntry(&Fcb->ClusterMap, Vcn, Cluster, ClusterCount))
+        {
+            Fcb->ClusterMapCount = Vcn + ClusterCount;
+        }
+        else
+        {
+            FsRtlResetLargeMcb(&Fcb->ClusterMap, FALSE);
+            Fcb->ClusterMapCount = 0;
+        }
+    }
+    ExReleaseFastMutex(&Fcb->LastMutex);
+}
+
+/*
+ * Forget the cached extents past the first ClusterCount clusters of the
+ * chain. To be called whenever the chain is cut or released.
+ */
+VOID
+vfatTruncateClusterMap(
+    PVFATFCB Fcb,
+    ULONG ClusterCount)
+{
+    ExAcquireFastMutex(&Fcb->LastMutex);
+    if (Fcb->ClusterMapCount > ClusterCount)
+    {
+        FsRtlTruncateLargeMcb(&Fcb->ClusterMap, ClusterCount);
+        Fcb->ClusterMapCount = ClusterCount;
+    }
+    ExReleaseFastMutex(&Fcb->LastMutex);
+}
+
+/*
+ * Same as OffsetToCluster() without extension, but looks up the cached
+ * extents of the FCB cluster chain first. The FAT is only walked past the
+ * cached part of the chain, and what gets walked is added to the cache.
+ */
+NTSTATUS
+vfatFileOffsetToCluster(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG FileOffset,
+    PULONG Cluster)
+{
+    ULONG Vcn;
+    ULONG MappedCount;
+    ULONG CurrentCluster;
+    ULONG RunVcn;
+    ULONG RunCluster;
+    ULONG RunLength;
+    LONGLONG Lbn;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (FirstCluster == 1)
+    {
+        return OffsetToCluster(DeviceExt, FirstCluster, FileOffset, Cluster, FALSE);
+    }
+
+    Vcn = FileOffset / DeviceExt->FatInfo.BytesPerCluster;
+
+    ExAcquireFastMutex(&Fcb->LastMutex);
+    MappedCount = Fcb->ClusterMapCount;
+    ExReleaseFastMutex(&Fcb->LastMutex);
+
+    if (MappedCount == 0)
+    {
+        RunVcn = 0;
+        CurrentCluster = FirstCluster;
+    }
+    else
+    {
+        RunVcn = min(Vcn, MappedCount - 1);
+        if (!FsRtlLookupLargeMcbEntry(&Fcb->ClusterMap, RunVcn, &Lbn, NULL, NULL, NULL, NULL) ||
+            Lbn == -1)
+        {
+            /* Truncated in the meantime */
+            return OffsetToCluster(DeviceExt, FirstCluster, FileOffset, Cluster, FALSE);
+        }
+
+        CurrentCluster = (ULONG)Lbn;
+        if (RunVcn == Vcn)
+        {
+            *Cluster = CurrentCluster;
+            return STATUS_SUCCESS;
+        }
+    }
+
+    RunCluster = CurrentCluster;
+    RunLength = 1;
+    while (RunVcn + RunLength <= Vcn)
+    {
+        Status = GetNextCluster(DeviceExt, CurrentCluster, &CurrentCluster);
+        if (!NT_SUCCESS(Status) || CurrentCluster == 0xffffffff || CurrentCluster == 0)
+        {
+            break;
+        }
+
+        if (CurrentCluster == RunCluster + RunLength)
+        {
+            RunLength++;
+        }
+        else
+        {
+            vfatAddClusterRun(Fcb, RunVcn, RunCluster, RunLength);
+            RunVcn += RunLength;
+            RunCluster = CurrentCluster;
+            RunLength = 1;
+        }
+    }
+    vfatAddClusterRun(Fcb, RunVcn, RunCluster, RunLength);
+
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+
+    *Cluster = CurrentCluster;
+    return STATUS_SUCCESS;
+}
+
 /*
  * FUNCTION: Reads data from a file
  */
@@ -136,8 +273,6 @@ VfatReadFileData(
     ULONG BytesDone;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -215,36 +350,22 @@ VfatReadFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     /* Find the cluster to start the read from */
-    if (LastCluster > 0 && ReadOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
+    Status = vfatFileOffsetToCluster(DeviceExt, Fcb, FirstCluster,
+                                     ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
+                                     &CurrentCluster);
 #ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
+    /* DEBUG VERIFICATION */
+    if (NT_SUCCESS(Status))
     {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
+        ULONG CorrectCluster;
+        OffsetToCluster(DeviceExt, FirstCluster,
+                        ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
+                        &CorrectCluster, FALSE);
+        if (CorrectCluster != CurrentCluster)
+            KeBugCheck(FAT_FILE_SYSTEM);
     }
+#endif
 
     if (!NT_SUCCESS(Status))
     {
@@ -296,6 +417,8 @@ VfatReadFileData(
         Fcb->LastCluster = StartCluster + (ClusterCount - 1);
         Fcb->LastOffset = ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
         ExReleaseFastMutex(&Fcb->LastMutex);
+        vfatAddClusterRun(Fcb, ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) / BytesPerCluster,
+                          StartCluster, ClusterCount);
 
         /* Fire up the read command */
         Status = VfatReadDiskPartial (IrpContext, &StartOffset, BytesDone, *LengthRead, FALSE);
@@ -349,8 +472,6 @@ VfatWriteFileData(
     ULONG BytesPerCluster;
     LARGE_INTEGER StartOffset;
     ULONG BufferOffset;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -428,38 +549,24 @@ VfatWriteFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     /*
      * Find the cluster to start the write from
      */
-    if (LastCluster > 0 && WriteOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
+    Status = vfatFileOffsetToCluster(DeviceExt, Fcb, FirstCluster,
+                                     ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
+                                     &CurrentCluster);
 #ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
+    /* DEBUG VERIFICATION */
+    if (NT_SUCCESS(Status))
     {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
+        ULONG CorrectCluster;
+        OffsetToCluster(DeviceExt, FirstCluster,
+                        ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
+                        &CorrectCluster, FALSE);
+        if (CorrectCluster != CurrentCluster)
+            KeBugCheck(FAT_FILE_SYSTEM);
     }
+#endif
 
     if (!NT_SUCCESS(Status))
     {
@@ -511,6 +618,8 @@ VfatWriteFileData(
         Fcb->LastCluster = StartCluster + (ClusterCount - 1);
         Fcb->LastOffset = ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
         ExReleaseFastMutex(&Fcb->LastMutex);
+        vfatAddClusterRun(Fcb, ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) / BytesPerCluster,
+                          StartCluster, ClusterCount);
 
         // Fire up the write command
         Status = VfatWriteDiskPartial (IrpContext, &StartOffset, BytesDone, BufferOffset, FALSE);
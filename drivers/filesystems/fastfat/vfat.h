@@ -280,6 +280,22 @@ typedef struct _HASHENTRY
 }
 HASHENTRY;
 
+typedef struct _VFAT_NAME_INDEX_ENTRY
+{
+    ULONG Hash;
+    ULONG DirIndex;
+    struct _VFAT_NAME_INDEX_ENTRY* Next;
+}
+VFAT_NAME_INDEX_ENTRY, *PVFAT_NAME_INDEX_ENTRY;
+
+typedef struct _VFAT_NAME_INDEX
+{
+    ULONG BucketCount;
+    ULONG EntryCount;
+    PVFAT_NAME_INDEX_ENTRY Buckets[1];
+}
+VFAT_NAME_INDEX, *PVFAT_NAME_INDEX;
+
 typedef struct DEVICE_EXTENSION *PDEVICE_EXTENSION;
 
 typedef NTSTATUS (*PGET_NEXT_CLUSTER)(PDEVICE_EXTENSION,ULONG,PULONG);
@@ -325,6 +341,15 @@ typedef struct DEVICE_EXTENSION
     ULONG LastAvailableCluster;
     ULONG AvailableClusters;
     BOOLEAN AvailableClustersValid;
+
+    /* FAT32 free cluster bitmap, a set bit is a cluster in use */
+    RTL_BITMAP FreeClusterBitmap;
+    BOOLEAN FreeClusterBitmapValid;
+    BOOLEAN FreeClusterBitmapCancel;
+    LONG FreeClusterBitmapPending;
+    NTSTATUS FreeClusterBitmapStatus;
+    /* Signaled when the bitmap isn't being built */
+    KEVENT FreeClusterBitmapEvent;
     ULONG Flags;
     struct _VFATFCB *VolumeFcb;
     struct _VFATFCB *RootFcb;
@@ -412,6 +437,7 @@ typedef struct
     NPAGED_LOOKASIDE_LIST CcbLookasideList;
     NPAGED_LOOKASIDE_LIST IrpContextLookasideList;
     PAGED_LOOKASIDE_LIST CloseContextLookasideList;
+    PAGED_LOOKASIDE_LIST NameIndexLookasideList;
     FAST_IO_DISPATCH FastIoDispatch;
     CACHE_MANAGER_CALLBACKS CacheMgrCallbacks;
     FAST_MUTEX CloseMutex;
@@ -510,6 +536,9 @@ typedef struct _VFATFCB
     /* Entry into the hash table for the path + short name */
     HASHENTRY ShortHash;
 
+    /* Index of the names in this directory, built on first lookup */
+    PVFAT_NAME_INDEX NameIndex;
+
     /* List of byte-range locks for this file */
     FILE_LOCK FileLock;
 
@@ -522,6 +551,14 @@ typedef struct _VFATFCB
     ULONG LastCluster;
     ULONG LastOffset;
 
+    /*
+     * Extents of the first ClusterMapCount clusters of the chain, file
+     * cluster index to volume cluster. Guarded by LastMutex, and truncated
+     * along with the chain.
+     */
+    LARGE_MCB ClusterMap;
+    ULONG ClusterMapCount;
+
     struct _VFAT_CLOSE_CONTEXT * CloseContext;
 } VFATFCB, *PVFATFCB;
 
@@ -547,6 +584,8 @@ typedef struct _VFATCCB
 #define TAG_NAME 'ntaF'
 #define TAG_SEARCH 'LtaF'
 #define TAG_DIRENT 'DtaF'
+#define TAG_NAME_INDEX 'HtaF'
+#define TAG_BITMAP 'BtaF'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -960,6 +999,14 @@ NTSTATUS
 FAT32UpdateFreeClustersCount(
     PDEVICE_EXTENSION DeviceExt);
 
+VOID
+FAT32BuildFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+VOID
+FAT32DeleteFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
 /* fcb.c */
 
 PVFATFCB
@@ -1175,6 +1222,30 @@ VfatHandleDeferredWrite(
     IN PVOID IrpContext,
     IN PVOID Unused);
 
+/* nameidx.c */
+
+NTSTATUS
+vfatNameIndexFind(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext);
+
+VOID
+vfatNameIndexAddEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    ULONG DirIndex);
+
+VOID
+vfatNameIndexRemoveEntry(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb);
+
+VOID
+vfatNameIndexFree(
+    PVFATFCB DirFcb);
+
 /* pnp.c */
 
 NTSTATUS
@@ -1198,6 +1269,19 @@ NextCluster(
     PULONG CurrentCluster,
     BOOLEAN Extend);
 
+NTSTATUS
+vfatFileOffsetToCluster(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG FileOffset,
+    PULONG Cluster);
+
+VOID
+vfatTruncateClusterMap(
+    PVFATFCB Fcb,
+    ULONG ClusterCount);
+
 /* shutdown.c */
 
 DRIVER_DISPATCH
@@ -338,6 +338,8 @@ DECLARE_CONST_UNICODE_STRING(EMPTY_STRING, L"");
 #define MOUNT_CONFIG_RW_SIZE_MAX        1048576
 #define MAX_SEC_FLAVOR_LEN              12
 #define UPCALL_TIMEOUT_DEFAULT          50  /* in seconds */
+/* how long basic/standard info from the last open or query is trusted */
+#define ATTR_CACHE_TIMEOUT              SECONDS(3)
 
 typedef struct _NFS41_MOUNT_CONFIG {
     DWORD ReadSize;
@@ -405,6 +407,7 @@ typedef struct _NFS41_FCB {
     BOOLEAN                 DeletePending;
     DWORD                   mode;
     ULONGLONG               changeattr;
+    LARGE_INTEGER           attr_time;
 } NFS41_FCB, *PNFS41_FCB;
 #define NFS41GetFcbExtension(pFcb)      \
         (((pFcb) == NULL) ? NULL : (PNFS41_FCB)((pFcb)->Context))
@@ -3949,6 +3952,7 @@ retry_on_link:
             sizeof(entry->u.Open.sinfo));
         nfs41_fcb->mode = entry->u.Open.mode;
         nfs41_fcb->changeattr = entry->ChangeTime;
+        KeQuerySystemTime(&nfs41_fcb->attr_time);
         if (((params->CreateOptions & FILE_DELETE_ON_CLOSE) &&
                 !pVNetRootContext->read_only) || oldDeletePending)
             nfs41_fcb->StandardInfo.DeletePending = TRUE;
@@ -5506,6 +5510,39 @@ NTSTATUS nfs41_QueryFileInformation(
         goto out;
     }
 
+    /* attributes are refreshed on every open (close-to-open), so a recent
+     * copy saves an upcall for the queries that follow it */
+    if (nfs41_fcb->attr_time.QuadPart) {
+        LARGE_INTEGER current_time;
+        KeQuerySystemTime(&current_time);
+        if (current_time.QuadPart - nfs41_fcb->attr_time.QuadPart <=
+                ATTR_CACHE_TIMEOUT) {
+            if (InfoClass == FileBasicInformation &&
+                    RxContext->Info.LengthRemaining >=
+                        sizeof(FILE_BASIC_INFORMATION)) {
+                RtlCopyMemory(RxContext->Info.Buffer, &nfs41_fcb->BasicInfo,
+                    sizeof(FILE_BASIC_INFORMATION));
+                RxContext->Info.LengthRemaining -=
+                    sizeof(FILE_BASIC_INFORMATION);
+                status = STATUS_SUCCESS;
+                goto out;
+            }
+            if (InfoClass == FileStandardInformation &&
+                    RxContext->Info.LengthRemaining >=
+                        sizeof(FILE_STANDARD_INFORMATION)) {
+                PFILE_STANDARD_INFORMATION std_info =
+                    (PFILE_STANDARD_INFORMATION)RxContext->Info.Buffer;
+                RtlCopyMemory(std_info, &nfs41_fcb->StandardInfo,
+                    sizeof(FILE_STANDARD_INFORMATION));
+                std_info->DeletePending = nfs41_fcb->DeletePending;
+                RxContext->Info.LengthRemaining -=
+                    sizeof(FILE_STANDARD_INFORMATION);
+                status = STATUS_SUCCESS;
+                goto out;
+            }
+        }
+    }
+
     status = nfs41_UpcallCreate(NFS41_FILE_QUERY, &nfs41_fobx->sec_ctx,
         pVNetRootContext->session, nfs41_fobx->nfs41_open_state,
         pNetRootContext->nfs41d_version, SrvOpen->pAlreadyPrefixedName, &entry);
@@ -5534,6 +5571,7 @@ NTSTATUS nfs41_QueryFileInformation(
         case FileBasicInformation:
             RtlCopyMemory(&nfs41_fcb->BasicInfo, RxContext->Info.Buffer,
                 sizeof(nfs41_fcb->BasicInfo));
+            KeQuerySystemTime(&nfs41_fcb->attr_time);
 #ifdef DEBUG_FILE_QUERY
             print_basic_info(1, &nfs41_fcb->BasicInfo);
 #endif
@@ -5573,6 +5611,7 @@ NTSTATUS nfs41_QueryFileInformation(
             RtlCopyMemory(&nfs41_fcb->StandardInfo, RxContext->Info.Buffer,
                 sizeof(nfs41_fcb->StandardInfo));
             nfs41_fcb->StandardInfo.DeletePending = DeletePending;
+            KeQuerySystemTime(&nfs41_fcb->attr_time);
 #ifdef DEBUG_FILE_QUERY
             print_std_info(1, &nfs41_fcb->StandardInfo);
 #endif
@@ -5744,6 +5783,9 @@ NTSTATUS nfs41_SetFileInformation(
     status = check_nfs41_setattr_args(RxContext);
     if (status) goto out;
 
+    /* whatever changes, the cached attributes no longer describe the file */
+    nfs41_fcb->attr_time.QuadPart = 0;
+
     switch (InfoClass) {
     case FileDispositionInformation:
         {
@@ -6220,6 +6262,7 @@ NTSTATUS nfs41_Write(
 #endif
         nfs41_fcb->StandardInfo.EndOfFile.QuadPart = entry->buf_len +
             entry->u.ReadWrite.offset;
+        nfs41_fcb->attr_time.QuadPart = 0;
         status = RxContext->CurrentIrp->IoStatus.Status = STATUS_SUCCESS;
         RxContext->IoStatusBlock.Information = entry->buf_len;
         nfs41_fcb->changeattr = entry->ChangeTime;
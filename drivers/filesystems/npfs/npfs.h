@@ -63,6 +63,13 @@
 #define NPFS_WAIT_BLOCK_TAG     'tFpN'
 #define NPFS_WRITE_BLOCK_TAG    'wFpN'
 
+//
+// Pending reads at least this large have their buffer locked down, so that
+// the writer can copy its data straight into it instead of going through
+// an intermediate pool buffer that the I/O manager copies out again.
+//
+#define NPFS_DIRECT_READ_THRESHOLD  PAGE_SIZE
+
 //
 // NPFS bugchecking support
 //
@@ -21,6 +21,32 @@ ULONG NpFastReadFalse;
 
 /* FUNCTIONS ******************************************************************/
 
+static
+VOID
+NpLockPendingReadBuffer(IN PIRP Irp,
+                        IN ULONG BufferSize)
+{
+    PMDL Mdl;
+    PAGED_CODE();
+
+    if (BufferSize < NPFS_DIRECT_READ_THRESHOLD || Irp->MdlAddress) return;
+
+    Mdl = IoAllocateMdl(Irp->UserBuffer, BufferSize, FALSE, FALSE, Irp);
+    if (!Mdl) return;
+
+    _SEH2_TRY
+    {
+        MmProbeAndLockPages(Mdl, Irp->RequestorMode, IoWriteAccess);
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        /* Not fatal, the writer will just go through a pool buffer */
+        Irp->MdlAddress = NULL;
+        IoFreeMdl(Mdl);
+    }
+    _SEH2_END;
+}
+
 BOOLEAN
 NTAPI
 NpCommonRead(IN PFILE_OBJECT FileObject,
@@ -129,6 +155,9 @@ NpCommonRead(IN PFILE_OBJECT FileObject,
         goto Quickie;
     }
 
+    /* We are still in the reader's context, lock its buffer for the writer */
+    NpLockPendingReadBuffer(Irp, BufferSize);
+
     Status = NpAddDataQueueEntry(NamedPipeEnd,
                                  Ccb,
                                  ReadQueue,
@@ -80,16 +80,27 @@ NpWriteDataQueue(IN PNP_DATA_QUEUE WriteQueue,
         BufferSize = *BytesNotWritten;
         if (BufferSize >= DataSize) BufferSize = DataSize;
 
+        Buffer = NULL;
+        AllocatedBuffer = FALSE;
         if (DataEntry->DataEntryType != Unbuffered && BufferSize)
         {
-            Buffer = ExAllocatePoolWithTag(NonPagedPool, BufferSize, NPFS_DATA_ENTRY_TAG);
-            if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
-            AllocatedBuffer = TRUE;
+            /* The reader locked its buffer when it queued, copy right into it */
+            if (DataEntry->Irp->MdlAddress)
+            {
+                Buffer = MmGetSystemAddressForMdlSafe(DataEntry->Irp->MdlAddress,
+                                                      NormalPagePriority);
+            }
+
+            if (!Buffer)
+            {
+                Buffer = ExAllocatePoolWithTag(NonPagedPool, BufferSize, NPFS_DATA_ENTRY_TAG);
+                if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
+                AllocatedBuffer = TRUE;
+            }
         }
         else
         {
             Buffer = DataEntry->Irp->AssociatedIrp.SystemBuffer;
-            AllocatedBuffer = FALSE;
         }
 
         _SEH2_TRY
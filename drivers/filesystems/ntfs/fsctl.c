@@ -277,6 +277,8 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
     ExInitializeNPagedLookasideList(&DeviceExt->FileRecLookasideList,
                                     NULL, NULL, 0, NtfsInfo->BytesPerFileRecord, TAG_FILE_REC, 0);
 
+    InitializeFileRecordCache(DeviceExt);
+
     DeviceExt->MasterFileTable = ExAllocateFromNPagedLookasideList(&DeviceExt->FileRecLookasideList);
     if (DeviceExt->MasterFileTable == NULL)
     {
@@ -332,6 +334,7 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
         DPRINT1("Failed reading volume file\n");
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, VolumeRecord);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, DeviceExt->MasterFileTable);
+        FlushFileRecordCache(DeviceExt);
         ExDeleteNPagedLookasideList(&DeviceExt->FileRecLookasideList);
         return Status;
     }
@@ -373,6 +376,7 @@ NtfsGetVolumeData(PDEVICE_OBJECT DeviceObject,
         DPRINT1("Failed allocating volume FCB\n");
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, VolumeRecord);
         ExFreeToNPagedLookasideList(&DeviceExt->FileRecLookasideList, DeviceExt->MasterFileTable);
+        FlushFileRecordCache(DeviceExt);
         ExDeleteNPagedLookasideList(&DeviceExt->FileRecLookasideList);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
@@ -565,7 +569,10 @@ ByeBye:
             ExFreePool(Ccb);
 
         if (Lookaside)
+        {
+            FlushFileRecordCache(Vcb);
             ExDeleteNPagedLookasideList(&Vcb->FileRecLookasideList);
+        }
 
         if (NewDeviceObject)
             IoDeleteDevice(NewDeviceObject);
@@ -1627,15 +1627,216 @@ Cleanup:
     return Status;
 }
 
+#define FILE_RECORD_CACHE_BUCKET(Index) ((ULONG)((Index) % NTFS_FILE_RECORD_CACHE_BUCKETS))
+
+/**
+* @name InitializeFileRecordCache
+* @implemented
+*
+* Sets up the cache of fixed-up file records of a volume. ReadFileRecord() serves
+* recently used records from it, instead of reading them from the disk and applying
+* the fixups again. This matters most for path lookups, which read the record of
+* every directory along the way.
+*
+* The cache only ever hands out copies, as callers are free to modify the records
+* they read.
+*
+* @param Vcb
+* Pointer to the DEVICE_EXTENSION of the volume. NtfsInfo.BytesPerFileRecord must
+* be set already.
+*/
+VOID
+InitializeFileRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG i;
+
+    ExInitializeFastMutex(&Vcb->FileRecCacheLock);
+    InitializeListHead(&Vcb->FileRecCacheLruList);
+    for (i = 0; i < NTFS_FILE_RECORD_CACHE_BUCKETS; i++)
+    {
+        InitializeListHead(&Vcb->FileRecCacheHash[i]);
+    }
+    Vcb->FileRecCacheCount = 0;
+}
+
+/**
+* @name FlushFileRecordCache
+* @implemented
+*
+* Empties the file record cache of a volume, freeing all its entries.
+*/
+VOID
+FlushFileRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    PNTFS_CACHED_FILE_RECORD Cached;
+
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    while (!IsListEmpty(&Vcb->FileRecCacheLruList))
+    {
+        Cached = CONTAINING_RECORD(RemoveHeadList(&Vcb->FileRecCacheLruList), NTFS_CACHED_FILE_RECORD, LruEntry);
+        RemoveEntryList(&Cached->HashEntry);
+        ExFreePoolWithTag(Cached, TAG_FILE_REC);
+    }
+    Vcb->FileRecCacheCount = 0;
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+}
+
+/* The caller must hold FileRecCacheLock */
+static
+PNTFS_CACHED_FILE_RECORD
+FindCachedFileRecord(PDEVICE_EXTENSION Vcb,
+                     ULONGLONG MftIndex)
+{
+    PLIST_ENTRY ListHead, ListEntry;
+    PNTFS_CACHED_FILE_RECORD Cached;
+
+    ListHead = &Vcb->FileRecCacheHash[FILE_RECORD_CACHE_BUCKET(MftIndex)];
+    for (ListEntry = ListHead->Flink; ListEntry != ListHead; ListEntry = ListEntry->Flink)
+    {
+        Cached = CONTAINING_RECORD(ListEntry, NTFS_CACHED_FILE_RECORD, HashEntry);
+        if (Cached->MftIndex == MftIndex)
+        {
+            return Cached;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+* Copies the cached version of a file record into FileRecord, if there's one.
+*/
+static
+BOOLEAN
+ReadCachedFileRecord(PDEVICE_EXTENSION Vcb,
+                     ULONGLONG MftIndex,
+                     PFILE_RECORD_HEADER FileRecord)
+{
+    PNTFS_CACHED_FILE_RECORD Cached;
+
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    Cached = FindCachedFileRecord(Vcb, MftIndex);
+    if (Cached == NULL)
+    {
+        ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+        return FALSE;
+    }
+
+    RtlCopyMemory(FileRecord, Cached + 1, Vcb->NtfsInfo.BytesPerFileRecord);
+
+    RemoveEntryList(&Cached->LruEntry);
+    InsertHeadList(&Vcb->FileRecCacheLruList, &Cached->LruEntry);
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+
+    return TRUE;
+}
+
+/**
+* Stores a copy of a fixed-up file record in the cache. If Insert is FALSE, only
+* an existing entry gets refreshed; this keeps writes of records nobody reads
+* (such as the blank ones added when the MFT grows) from pushing out useful entries.
+*/
+static
+VOID
+CacheFileRecord(PDEVICE_EXTENSION Vcb,
+                ULONGLONG MftIndex,
+                PFILE_RECORD_HEADER FileRecord,
+                BOOLEAN Insert)
+{
+    PNTFS_CACHED_FILE_RECORD Cached;
+
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    Cached = FindCachedFileRecord(Vcb, MftIndex);
+    if (Cached != NULL)
+    {
+        RemoveEntryList(&Cached->LruEntry);
+    }
+    else
+    {
+        if (!Insert)
+        {
+            ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+            return;
+        }
+
+        if (Vcb->FileRecCacheCount >= NTFS_FILE_RECORD_CACHE_SIZE)
+        {
+            // Recycle the least recently used entry
+            Cached = CONTAINING_RECORD(Vcb->FileRecCacheLruList.Blink, NTFS_CACHED_FILE_RECORD, LruEntry);
+            RemoveEntryList(&Cached->LruEntry);
+            RemoveEntryList(&Cached->HashEntry);
+        }
+        else
+        {
+            Cached = ExAllocatePoolWithTag(PagedPool,
+                                           sizeof(NTFS_CACHED_FILE_RECORD) + Vcb->NtfsInfo.BytesPerFileRecord,
+                                           TAG_FILE_REC);
+            if (Cached == NULL)
+            {
+                ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+                return;
+            }
+
+            Vcb->FileRecCacheCount++;
+        }
+
+        Cached->MftIndex = MftIndex;
+        InsertHeadList(&Vcb->FileRecCacheHash[FILE_RECORD_CACHE_BUCKET(MftIndex)], &Cached->HashEntry);
+    }
+
+    InsertHeadList(&Vcb->FileRecCacheLruList, &Cached->LruEntry);
+    RtlCopyMemory(Cached + 1, FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+}
+
+/**
+* @name InvalidateCachedFileRecord
+* @implemented
+*
+* Drops a file record from the cache, if it's in there. Must be called whenever a
+* record is changed on the disk other than through UpdateFileRecord().
+*/
+VOID
+InvalidateCachedFileRecord(PDEVICE_EXTENSION Vcb,
+                           ULONGLONG MftIndex)
+{
+    PNTFS_CACHED_FILE_RECORD Cached;
+
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    Cached = FindCachedFileRecord(Vcb, MftIndex);
+    if (Cached != NULL)
+    {
+        RemoveEntryList(&Cached->LruEntry);
+        RemoveEntryList(&Cached->HashEntry);
+        ExFreePoolWithTag(Cached, TAG_FILE_REC);
+        Vcb->FileRecCacheCount--;
+    }
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+}
+
 NTSTATUS
 ReadFileRecord(PDEVICE_EXTENSION Vcb,
                ULONGLONG index,
                PFILE_RECORD_HEADER file)
 {
     ULONGLONG BytesRead;
+    NTSTATUS Status;
 
     DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
 
+    if (ReadCachedFileRecord(Vcb, index, file))
+    {
+        return STATUS_SUCCESS;
+    }
+
     BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
     if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
     {
@@ -1645,7 +1846,13 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
 
     /* Apply update sequence array fixups. */
     DPRINT("Sequence number: %u\n", file->SequenceNumber);
-    return FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    Status = FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    if (NT_SUCCESS(Status))
+    {
+        CacheFileRecord(Vcb, index, file, TRUE);
+    }
+
+    return Status;
 }
 
 
@@ -1957,6 +2164,12 @@ UpdateFileRecord(PDEVICE_EXTENSION Vcb,
     // remove the fixup array (so the file record pointer can still be used)
     FixupUpdateSequenceArray(Vcb, &FileRecord->Ntfs);
 
+    // keep the cached copy in line with what's on the disk - or drop it if we don't know what that is
+    if (NT_SUCCESS(Status))
+        CacheFileRecord(Vcb, MftIndex, FileRecord, FALSE);
+    else
+        InvalidateCachedFileRecord(Vcb, MftIndex);
+
     return Status;
 }
 
@@ -2117,6 +2330,9 @@ AddNewMftEntry(PFILE_RECORD_HEADER FileRecord,
 
     DPRINT1("Creating file record at MFT index: %I64u\n", MftIndex);
 
+    // don't let a stale copy of the free record outlive it
+    InvalidateCachedFileRecord(DeviceExt, MftIndex);
+
     // update file record with index
     FileRecord->MFTRecordNumber = MftIndex;
 
@@ -3142,6 +3358,221 @@ BrowseIndexEntries(PDEVICE_EXTENSION Vcb,
     return STATUS_OBJECT_PATH_NOT_FOUND;
 }
 
+/**
+* @name SearchIndexEntries
+* @implemented
+*
+* Looks up a single file name in a directory index by descending the index B-tree, reading only the
+* index blocks on the path from $INDEX_ROOT to the node that holds (or would hold) the name.
+*
+* @param Vcb
+* Pointer to the NTFS_VCB for the volume.
+*
+* @param MftRecord
+* Pointer to the file record of the directory being searched.
+*
+* @param IndexRoot
+* Pointer to a copy of the directory's $INDEX_ROOT attribute.
+*
+* @param IndexBlockSize
+* Size of an index block of the $INDEX_ALLOCATION, in bytes.
+*
+* @param FileName
+* Pointer to a UNICODE_STRING with the name to look up. It must not contain wildcards.
+*
+* @param CaseSensitive
+* Boolean indicating if the lookup should be case-sensitive.
+*
+* @param OutMFTIndex
+* Pointer to a ULONGLONG which will receive the index of the file record of the file that was found.
+*
+* @return
+* STATUS_SUCCESS if the name was found.
+* STATUS_OBJECT_PATH_NOT_FOUND if the name isn't in the index.
+* STATUS_NO_MATCH if the descent can't give a definitive answer and the caller should fall back to
+* BrowseIndexEntries(), e.g. because the name only matched a DOS name or an entry differing in case.
+* STATUS_INSUFFICIENT_RESOURCES if an allocation failed.
+* STATUS_DATA_ERROR if the index is corrupted.
+*
+* @remarks
+* Entries are collated by their upcased names, as done by CompareTreeKeys(), so a case-insensitive
+* comparison is used to pick the sub-node to descend into regardless of CaseSensitive. Since
+* RtlUpcaseUnicodeChar() may not agree with the volume's $UpCase table outside of ASCII, a miss on
+* a name containing other characters is reported as STATUS_NO_MATCH rather than as not found.
+*/
+NTSTATUS
+SearchIndexEntries(PNTFS_VCB Vcb,
+                   PFILE_RECORD_HEADER MftRecord,
+                   PINDEX_ROOT_ATTRIBUTE IndexRoot,
+                   ULONG IndexBlockSize,
+                   PUNICODE_STRING FileName,
+                   BOOLEAN CaseSensitive,
+                   ULONGLONG *OutMFTIndex)
+{
+    PNTFS_ATTR_CONTEXT IndexAllocationContext = NULL;
+    PINDEX_BUFFER IndexBuffer = NULL;
+    PINDEX_ENTRY_ATTRIBUTE IndexEntry;
+    PINDEX_ENTRY_ATTRIBUTE LastEntry;
+    UNICODE_STRING EntryName;
+    BOOLEAN HasSubNodes;
+    ULONG BytesRead, Depth, i;
+    LONG Comparison;
+    NTSTATUS Status;
+
+    DPRINT("SearchIndexEntries(%p, %p, %p, %lu, %wZ, %s, %p)\n",
+           Vcb,
+           MftRecord,
+           IndexRoot,
+           IndexBlockSize,
+           FileName,
+           CaseSensitive ? "TRUE" : "FALSE",
+           OutMFTIndex);
+
+    // Start with the entries of the index root
+    IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)&IndexRoot->Header + IndexRoot->Header.FirstEntryOffset);
+    LastEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)&IndexRoot->Header + IndexRoot->Header.TotalSizeOfEntries);
+    HasSubNodes = (IndexRoot->Header.Flags & INDEX_ROOT_LARGE) != 0;
+
+    // Each pass handles one node; the depth limit only protects us against loops in a corrupted index
+    for (Depth = 0; Depth < 32; Depth++)
+    {
+        // Find the first entry that doesn't collate before FileName
+        while (IndexEntry < LastEntry && !(IndexEntry->Flags & NTFS_INDEX_ENTRY_END))
+        {
+            EntryName.Buffer = IndexEntry->FileName.Name;
+            EntryName.Length =
+            EntryName.MaximumLength = IndexEntry->FileName.NameLength * sizeof(WCHAR);
+
+            Comparison = RtlCompareUnicodeString(FileName, &EntryName, TRUE);
+            if (Comparison == 0)
+            {
+                // Make sure this is an entry NtfsFindMftRecord() is allowed to return
+                if ((IndexEntry->Data.Directory.IndexedFile & NTFS_MFT_MASK) >= NTFS_FILE_FIRST_USER_FILE &&
+                    IndexEntry->FileName.NameType != NTFS_FILE_NAME_DOS &&
+                    (!CaseSensitive || RtlCompareUnicodeString(FileName, &EntryName, FALSE) == 0))
+                {
+                    *OutMFTIndex = (IndexEntry->Data.Directory.IndexedFile & NTFS_MFT_MASK);
+                    Status = STATUS_SUCCESS;
+                }
+                else
+                {
+                    Status = STATUS_NO_MATCH;
+                }
+                goto Cleanup;
+            }
+
+            if (Comparison < 0)
+                break;
+
+            // Advance to the next index entry
+            if (IndexEntry->Length < sizeof(INDEX_ENTRY_ATTRIBUTE))
+            {
+                DPRINT1("File system corruption detected, invalid index entry length!\n");
+                Status = STATUS_DATA_ERROR;
+                goto Cleanup;
+            }
+            IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((PCHAR)IndexEntry + IndexEntry->Length);
+        }
+
+        if (IndexEntry >= LastEntry)
+        {
+            DPRINT1("File system corruption detected, index node has no end entry!\n");
+            Status = STATUS_DATA_ERROR;
+            goto Cleanup;
+        }
+
+        // If the entry has no sub-node, FileName isn't in the index
+        if (!(IndexEntry->Flags & NTFS_INDEX_ENTRY_NODE))
+        {
+            Status = STATUS_OBJECT_PATH_NOT_FOUND;
+            goto Cleanup;
+        }
+
+        if (!HasSubNodes)
+        {
+            DPRINT1("Filesystem corruption detected!\n");
+            Status = STATUS_DATA_ERROR;
+            goto Cleanup;
+        }
+
+        // Find the $I30 index allocation and get a buffer for its blocks, the first time we need them
+        if (IndexAllocationContext == NULL)
+        {
+            Status = FindAttribute(Vcb, MftRecord, AttributeIndexAllocation, L"$I30", 4, &IndexAllocationContext, NULL);
+            if (!NT_SUCCESS(Status))
+            {
+                DPRINT1("Potential file system corruption detected!\n");
+                IndexAllocationContext = NULL;
+                goto Cleanup;
+            }
+
+            IndexBuffer = ExAllocatePoolWithTag(NonPagedPool, IndexBlockSize, TAG_NTFS);
+            if (!IndexBuffer)
+            {
+                DPRINT1("Unable to allocate memory for index record!\n");
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                goto Cleanup;
+            }
+        }
+
+        // Read the index block of the sub-node, overwriting the node we're done with
+        BytesRead = ReadAttribute(Vcb,
+                                  IndexAllocationContext,
+                                  GetIndexEntryVCN(IndexEntry) * Vcb->NtfsInfo.BytesPerCluster,
+                                  (PCHAR)IndexBuffer,
+                                  IndexBlockSize);
+        if (BytesRead != IndexBlockSize || IndexBuffer->Ntfs.Type != NRH_INDX_TYPE)
+        {
+            DPRINT1("Unable to read index record!\n");
+            Status = STATUS_DATA_ERROR;
+            goto Cleanup;
+        }
+
+        // Apply the fixup array to the index record
+        Status = FixupUpdateSequenceArray(Vcb, &((PFILE_RECORD_HEADER)IndexBuffer)->Ntfs);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to apply fixup array!\n");
+            goto Cleanup;
+        }
+
+        IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)&IndexBuffer->Header + IndexBuffer->Header.FirstEntryOffset);
+        LastEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)&IndexBuffer->Header + IndexBuffer->Header.TotalSizeOfEntries);
+        HasSubNodes = (IndexBuffer->Header.Flags & INDEX_NODE_LARGE) != 0;
+
+        if (LastEntry > (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)IndexBuffer + IndexBlockSize))
+        {
+            DPRINT1("File system corruption detected, index entries overflow the index record!\n");
+            Status = STATUS_DATA_ERROR;
+            goto Cleanup;
+        }
+    }
+
+    DPRINT1("File system corruption detected, index is too deep!\n");
+    Status = STATUS_DATA_ERROR;
+
+Cleanup:
+    // Our upcasing may disagree with the volume's, let the full walk have the final word
+    if (Status == STATUS_OBJECT_PATH_NOT_FOUND)
+    {
+        for (i = 0; i < FileName->Length / sizeof(WCHAR); i++)
+        {
+            if (FileName->Buffer[i] > 0x7F)
+            {
+                Status = STATUS_NO_MATCH;
+                break;
+            }
+        }
+    }
+
+    if (IndexBuffer)
+        ExFreePoolWithTag(IndexBuffer, TAG_NTFS);
+    if (IndexAllocationContext)
+        ReleaseAttributeContext(IndexAllocationContext);
+
+    return Status;
+}
+
 NTSTATUS
 NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
                   ULONGLONG MFTIndex,
@@ -3206,6 +3637,26 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
 
     DPRINT("IndexRecordSize: %x IndexBlockSize: %x\n", Vcb->NtfsInfo.BytesPerIndexRecord, IndexRoot->SizeOfEntry);
 
+    // Looking up a single name only needs the path from the root to its node
+    if (!DirSearch)
+    {
+        Status = SearchIndexEntries(Vcb,
+                                    MftRecord,
+                                    IndexRoot,
+                                    IndexRoot->SizeOfEntry,
+                                    FileName,
+                                    CaseSensitive,
+                                    OutMFTIndex);
+        if (Status != STATUS_NO_MATCH)
+        {
+            ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+            ExFreeToNPagedLookasideList(&Vcb->FileRecLookasideList, MftRecord);
+            return Status;
+        }
+
+        DPRINT("Falling back to a full walk of the index for %wZ\n", FileName);
+    }
+
     Status = BrowseIndexEntries(Vcb,
                                 MftRecord,
                                 (PINDEX_ROOT_ATTRIBUTE)IndexRecord,
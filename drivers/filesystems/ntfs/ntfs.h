@@ -96,6 +96,18 @@ typedef struct
     ULONG Size;
 } NTFSIDENTIFIER, *PNTFSIDENTIFIER;
 
+/* Bounds of the cache of fixed-up file records kept by each volume */
+#define NTFS_FILE_RECORD_CACHE_SIZE     128
+#define NTFS_FILE_RECORD_CACHE_BUCKETS  32
+
+typedef struct _NTFS_CACHED_FILE_RECORD
+{
+    LIST_ENTRY HashEntry;
+    LIST_ENTRY LruEntry;
+    ULONGLONG MftIndex;
+    /* The fixed-up file record follows */
+} NTFS_CACHED_FILE_RECORD, *PNTFS_CACHED_FILE_RECORD;
+
 typedef struct
 {
     NTFSIDENTIFIER Identifier;
@@ -118,6 +130,11 @@ typedef struct
 
     NPAGED_LOOKASIDE_LIST FileRecLookasideList;
 
+    FAST_MUTEX FileRecCacheLock;
+    LIST_ENTRY FileRecCacheLruList;
+    LIST_ENTRY FileRecCacheHash[NTFS_FILE_RECORD_CACHE_BUCKETS];
+    ULONG FileRecCacheCount;
+
     ULONG MftDataOffset;
     ULONG Flags;
     ULONG OpenHandleCount;
@@ -1106,6 +1123,16 @@ CompareFileName(PUNICODE_STRING FileName,
 NTSTATUS
 UpdateMftMirror(PNTFS_VCB Vcb);
 
+VOID
+InitializeFileRecordCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+FlushFileRecordCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+InvalidateCachedFileRecord(PDEVICE_EXTENSION Vcb,
+                           ULONGLONG MftIndex);
+
 NTSTATUS
 ReadFileRecord(PDEVICE_EXTENSION Vcb,
                ULONGLONG index,
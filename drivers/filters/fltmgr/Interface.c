@@ -474,9 +474,8 @@ FltpDispatch(_In_ PDEVICE_OBJECT DeviceObject,
         // handle shutdown request
     }
 
-    DPRINT1("Received %X from %wZ\n", StackPtr->MajorFunction, &DeviceExtension->DeviceName);
-
-    /* Just pass the IRP down the stack */
+    /* No instances are attached to volumes yet, so there are no callbacks
+     * to call: just pass the IRP down the stack */
     IoSkipCurrentIrpStackLocation(Irp);
     return IoCallDriver(DeviceExtension->AttachedToDeviceObject, Irp);
 }
@@ -515,8 +514,6 @@ FltpCreate(_In_ PDEVICE_OBJECT DeviceObject,
     FLT_ASSERT(DeviceExtension &&
                DeviceExtension->AttachedToDeviceObject);
 
-    DPRINT1("Received create from %wZ (%lu)\n", &DeviceExtension->DeviceName, PsGetCurrentProcessId());
-
     /* Just pass the IRP down the stack */
     IoSkipCurrentIrpStackLocation(Irp);
     return IoCallDriver(DeviceExtension->AttachedToDeviceObject, Irp);
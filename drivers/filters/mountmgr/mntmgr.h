@@ -37,7 +37,11 @@ typedef struct _DEVICE_EXTENSION
     ULONG OnlineNotificationWorkerActive;  // 0xA4
     ULONG OnlineNotificationCount;         // 0xA8
     KEVENT OnlineNotificationEvent;        // 0xAC
-} DEVICE_EXTENSION, *PDEVICE_EXTENSION;    // 0xBC
+    /* Online devices, hashed by device name */
+    LIST_ENTRY DeviceHashTable[64];        // 0xBC
+} DEVICE_EXTENSION, *PDEVICE_EXTENSION;    // 0x2BC
+
+#define DEVICE_HASH_TABLE_SIZE RTL_NUMBER_OF(((PDEVICE_EXTENSION)NULL)->DeviceHashTable)
 
 typedef struct _DEVICE_INFORMATION
 {
@@ -60,7 +64,8 @@ typedef struct _DEVICE_INFORMATION
     LONG MountState;                        // 0x40
     PVOID TargetDeviceNotificationEntry;    // 0x44
     PDEVICE_EXTENSION DeviceExtension;      // 0x48
-} DEVICE_INFORMATION, *PDEVICE_INFORMATION; // 0x4C
+    LIST_ENTRY DeviceHashEntry;             // 0x4C
+} DEVICE_INFORMATION, *PDEVICE_INFORMATION; // 0x54
 
 typedef struct _SYMLINK_INFORMATION
 {
@@ -199,6 +204,12 @@ MountMgrMountedDeviceRemoval(
     IN PUNICODE_STRING DeviceName
 );
 
+PDEVICE_INFORMATION
+LookupDeviceByName(
+    IN PDEVICE_EXTENSION DeviceExtension,
+    IN PUNICODE_STRING DeviceName
+);
+
 NTSTATUS
 FindDeviceInfo(
     IN PDEVICE_EXTENSION DeviceExtension,
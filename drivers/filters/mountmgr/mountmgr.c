@@ -635,6 +635,49 @@ QueryDeviceInformation(IN PUNICODE_STRING SymbolicName,
     return Status;
 }
 
+static
+ULONG
+HashDeviceName(IN PUNICODE_STRING DeviceName)
+{
+    ULONG i, Hash = 0;
+
+    /* Device names are compared case insensitively, hash them the same way */
+    for (i = 0; i < DeviceName->Length / sizeof(WCHAR); i++)
+    {
+        Hash = Hash * 31 + RtlUpcaseUnicodeChar(DeviceName->Buffer[i]);
+    }
+
+    return Hash % DEVICE_HASH_TABLE_SIZE;
+}
+
+/*
+ * @implemented
+ */
+PDEVICE_INFORMATION
+LookupDeviceByName(IN PDEVICE_EXTENSION DeviceExtension,
+                   IN PUNICODE_STRING DeviceName)
+{
+    PLIST_ENTRY BucketHead, NextEntry;
+    PDEVICE_INFORMATION DeviceInfo;
+
+    BucketHead = &(DeviceExtension->DeviceHashTable[HashDeviceName(DeviceName)]);
+    for (NextEntry = BucketHead->Flink;
+         NextEntry != BucketHead;
+         NextEntry = NextEntry->Flink)
+    {
+        DeviceInfo = CONTAINING_RECORD(NextEntry,
+                                       DEVICE_INFORMATION,
+                                       DeviceHashEntry);
+
+        if (RtlEqualUnicodeString(DeviceName, &(DeviceInfo->DeviceName), TRUE))
+        {
+            return DeviceInfo;
+        }
+    }
+
+    return NULL;
+}
+
 /*
  * @implemented
  */
@@ -645,9 +688,8 @@ FindDeviceInfo(IN PDEVICE_EXTENSION DeviceExtension,
                OUT PDEVICE_INFORMATION * DeviceInformation)
 {
     NTSTATUS Status;
-    PLIST_ENTRY NextEntry;
     UNICODE_STRING DeviceName;
-    PDEVICE_INFORMATION DeviceInfo = NULL;
+    PDEVICE_INFORMATION DeviceInfo;
 
     /* If a device name was given, use it */
     if (DeviceNameGiven)
@@ -670,19 +712,7 @@ FindDeviceInfo(IN PDEVICE_EXTENSION DeviceExtension,
     }
 
     /* Look for device information matching devive */
-    for (NextEntry = DeviceExtension->DeviceListHead.Flink;
-         NextEntry != &(DeviceExtension->DeviceListHead);
-         NextEntry = NextEntry->Flink)
-    {
-        DeviceInfo = CONTAINING_RECORD(NextEntry,
-                                       DEVICE_INFORMATION,
-                                       DeviceListEntry);
-
-        if (RtlEqualUnicodeString(&DeviceName, &(DeviceInfo->DeviceName), TRUE))
-        {
-            break;
-        }
-    }
+    DeviceInfo = LookupDeviceByName(DeviceExtension, &DeviceName);
 
     /* Release our buffer if required */
     if (!DeviceNameGiven)
@@ -691,7 +721,7 @@ FindDeviceInfo(IN PDEVICE_EXTENSION DeviceExtension,
     }
 
     /* Return found information */
-    if (NextEntry == &(DeviceExtension->DeviceListHead))
+    if (!DeviceInfo)
     {
         return STATUS_OBJECT_NAME_NOT_FOUND;
     }
@@ -1054,20 +1084,10 @@ MountMgrMountedDeviceArrival(IN PDEVICE_EXTENSION DeviceExtension,
     KeWaitForSingleObject(&(DeviceExtension->DeviceLock), Executive, KernelMode, FALSE, NULL);
 
     /* Check if we already have device in to prevent double registration */
-    for (NextEntry = DeviceExtension->DeviceListHead.Flink;
-         NextEntry != &(DeviceExtension->DeviceListHead);
-         NextEntry = NextEntry->Flink)
-    {
-        CurrentDevice = CONTAINING_RECORD(NextEntry, DEVICE_INFORMATION, DeviceListEntry);
-
-        if (RtlEqualUnicodeString(&(CurrentDevice->DeviceName), &TargetDeviceName, TRUE))
-        {
-            break;
-        }
-    }
+    CurrentDevice = LookupDeviceByName(DeviceExtension, &TargetDeviceName);
 
     /* If we found it, clear ours, and return success, all correct */
-    if (NextEntry != &(DeviceExtension->DeviceListHead))
+    if (CurrentDevice)
     {
         if (SuggestedLinkName.Buffer)
         {
@@ -1368,6 +1388,8 @@ MountMgrMountedDeviceArrival(IN PDEVICE_EXTENSION DeviceExtension,
 
     /* Finally, insert the device into our devices list */
     InsertTailList(&(DeviceExtension->DeviceListHead), &(DeviceInformation->DeviceListEntry));
+    InsertTailList(&(DeviceExtension->DeviceHashTable[HashDeviceName(&(DeviceInformation->DeviceName))]),
+                   &(DeviceInformation->DeviceHashEntry));
 
     /* Copy device unique ID */
     NewUniqueId = AllocatePool(UniqueId->UniqueIdLength + sizeof(MOUNTDEV_UNIQUE_ID));
@@ -1539,6 +1561,7 @@ MountMgrMountedDeviceRemoval(IN PDEVICE_EXTENSION DeviceExtension,
 
         /* Remove device from the device list */
         RemoveEntryList(&(DeviceInformation->DeviceListEntry));
+        RemoveEntryList(&(DeviceInformation->DeviceHashEntry));
 
         /* If there are still devices, check if some were associated with ours */
         if (!IsListEmpty(&(DeviceInformation->DeviceListEntry)))
@@ -1799,6 +1822,7 @@ NTAPI
 DriverEntry(IN PDRIVER_OBJECT DriverObject,
             IN PUNICODE_STRING RegistryPath)
 {
+    ULONG i;
     NTSTATUS Status;
     PDEVICE_OBJECT DeviceObject;
     PDEVICE_EXTENSION DeviceExtension;
@@ -1826,6 +1850,10 @@ DriverEntry(IN PDRIVER_OBJECT DriverObject,
 
     InitializeListHead(&(DeviceExtension->DeviceListHead));
     InitializeListHead(&(DeviceExtension->OfflineDeviceListHead));
+    for (i = 0; i < DEVICE_HASH_TABLE_SIZE; i++)
+    {
+        InitializeListHead(&(DeviceExtension->DeviceHashTable[i]));
+    }
 
     KeInitializeSemaphore(&(DeviceExtension->DeviceLock), 1, 1);
     KeInitializeSemaphore(&(DeviceExtension->RemoteDatabaseLock), 1, 1);
@@ -54,17 +54,7 @@ MountMgrCreatePointWorker(IN PDEVICE_EXTENSION DeviceExtension,
     }
 
     /* First of all, try to find device */
-    for (DeviceEntry = DeviceExtension->DeviceListHead.Flink;
-         DeviceEntry != &(DeviceExtension->DeviceListHead);
-         DeviceEntry = DeviceEntry->Flink)
-    {
-        DeviceInformation = CONTAINING_RECORD(DeviceEntry, DEVICE_INFORMATION, DeviceListEntry);
-
-        if (RtlEqualUnicodeString(&TargetDeviceName, &(DeviceInformation->DeviceName), TRUE))
-        {
-            break;
-        }
-    }
+    DeviceInformation = LookupDeviceByName(DeviceExtension, &TargetDeviceName);
 
     /* Copy symbolic link name and null terminate it */
     SymLink.Buffer = AllocatePool(SymbolicLinkName->Length + sizeof(UNICODE_NULL));
@@ -80,7 +70,7 @@ MountMgrCreatePointWorker(IN PDEVICE_EXTENSION DeviceExtension,
     SymLink.MaximumLength = SymbolicLinkName->Length + sizeof(UNICODE_NULL);
 
     /* If we didn't find device */
-    if (DeviceEntry == &(DeviceExtension->DeviceListHead))
+    if (!DeviceInformation)
     {
         /* Then, try with unique ID */
         Status = QueryDeviceInformation(SymbolicLinkName,
@@ -479,21 +469,11 @@ QueryPointsFromSymbolicLinkName(IN PDEVICE_EXTENSION DeviceExtension,
     if (NT_SUCCESS(Status))
     {
         /* Look for the device information */
-        for (DeviceEntry = DeviceExtension->DeviceListHead.Flink;
-             DeviceEntry != &(DeviceExtension->DeviceListHead);
-             DeviceEntry = DeviceEntry->Flink)
-        {
-            DeviceInformation = CONTAINING_RECORD(DeviceEntry, DEVICE_INFORMATION, DeviceListEntry);
-
-            if (RtlEqualUnicodeString(&DeviceName, &(DeviceInformation->DeviceName), TRUE))
-            {
-                break;
-            }
-        }
+        DeviceInformation = LookupDeviceByName(DeviceExtension, &DeviceName);
 
         FreePool(DeviceName.Buffer);
 
-        if (DeviceEntry == &(DeviceExtension->DeviceListHead))
+        if (!DeviceInformation)
         {
             return STATUS_INVALID_PARAMETER;
         }
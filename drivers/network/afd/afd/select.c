@@ -378,6 +378,67 @@ AfdEnumEvents( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
 }
 
+/* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
+static VOID SignalPollNotify( PAFD_FCB FCB, PFILE_OBJECT FileObject ) {
+    PIO_COMPLETION_CONTEXT CompletionContext = FileObject->CompletionContext;
+    ULONG Fired = FCB->PollState & FCB->PollNotifyEvents;
+
+    ASSERT( KeGetCurrentIrql() == DISPATCH_LEVEL );
+
+    if( !Fired || !CompletionContext ) return;
+
+    AFD_DbgPrint(MID_TRACE,("Posting %x for %p\n", Fired, FCB));
+
+    /* Reported once, until the owner arms it again */
+    FCB->PollNotifyEvents &= ~Fired;
+
+    IoSetIoCompletion( CompletionContext->Port,
+                       CompletionContext->Key,
+                       FCB->PollNotifyContext,
+                       STATUS_SUCCESS,
+                       Fired,
+                       FALSE );
+}
+
+NTSTATUS NTAPI
+AfdPollNotify( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+               PIO_STACK_LOCATION IrpSp ) {
+    PFILE_OBJECT FileObject = IrpSp->FileObject;
+    PAFD_POLL_NOTIFY_INFO NotifyInfo =
+        (PAFD_POLL_NOTIFY_INFO)LockRequest( Irp, IrpSp, FALSE, NULL );
+    PAFD_FCB FCB = FileObject->FsContext;
+    PAFD_DEVICE_EXTENSION DeviceExt = DeviceObject->DeviceExtension;
+    KIRQL OldIrql;
+
+    if( !SocketAcquireStateLock( FCB ) ) {
+        return LostSocket( Irp );
+    }
+
+    if ( !NotifyInfo ) {
+         return UnlockAndMaybeComplete( FCB, STATUS_NO_MEMORY, Irp, 0 );
+    }
+
+    AFD_DbgPrint(MID_TRACE,("Called (FCB %p Events %x)\n",
+                            FCB, NotifyInfo->Events));
+
+    /* Notifications go to the port the socket is associated with */
+    if( NotifyInfo->Events && !FileObject->CompletionContext ) {
+        return UnlockAndMaybeComplete( FCB, STATUS_INVALID_PARAMETER, Irp, 0 );
+    }
+
+    KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
+
+    FCB->PollNotifyContext = NotifyInfo->ApcContext;
+    FCB->PollNotifyEvents = NotifyInfo->Events & AFD_ALL_EVENTS;
+
+    /* Whatever is already pending is reported right away */
+    SignalPollNotify( FCB, FileObject );
+
+    KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
+
+    return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
+}
+
 /* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
 static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject ) {
     UINT i;
@@ -440,6 +501,9 @@ VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
             ThePollEnt = ThePollEnt->Flink;
     }
 
+    /* And sockets armed for completion port notifications */
+    SignalPollNotify( FCB, FileObject );
+
     KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
 
     if((FCB->EventSelect) &&
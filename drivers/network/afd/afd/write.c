@@ -325,6 +325,140 @@ static NTSTATUS NTAPI PacketSocketSendComplete
     return STATUS_SUCCESS;
 }
 
+static IO_COMPLETION_ROUTINE DirectSendComplete;
+
+/*
+ * Sends that are too large for the send window skip it entirely: the
+ * caller's locked pages are handed to the transport as they are and the
+ * IRP stays pending until all of it has been taken. DriverContext[2]
+ * holds the system mapping of the buffer and marks the IRP as such.
+ */
+static NTSTATUS StartDirectSend( PAFD_FCB FCB, PIRP Irp ) {
+    PAFD_SEND_INFO SendReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+    PCHAR BufferAddress = Irp->Tail.Overlay.DriverContext[2];
+    ULONG_PTR BytesSent = Irp->IoStatus.Information;
+
+    ASSERT(BufferAddress);
+    ASSERT(BytesSent < SendReq->BufferArray[0].len);
+
+    return TdiSend( &FCB->SendIrp.InFlightRequest,
+                    FCB->Connection.Object,
+                    0,
+                    BufferAddress + BytesSent,
+                    SendReq->BufferArray[0].len - BytesSent,
+                    DirectSendComplete,
+                    FCB );
+}
+
+static NTSTATUS NTAPI DirectSendComplete
+( PDEVICE_OBJECT DeviceObject,
+  PIRP Irp,
+  PVOID Context ) {
+    NTSTATUS Status = Irp->IoStatus.Status;
+    PAFD_FCB FCB = (PAFD_FCB)Context;
+    PLIST_ENTRY NextIrpEntry;
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_SEND_INFO SendReq;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    AFD_DbgPrint(MID_TRACE,("Called, status %x, %u bytes sent\n",
+                            Irp->IoStatus.Status,
+                            Irp->IoStatus.Information));
+
+    if( !SocketAcquireStateLock( FCB ) )
+        return STATUS_FILE_CLOSED;
+
+    ASSERT(FCB->SendIrp.InFlightRequest == Irp);
+    FCB->SendIrp.InFlightRequest = NULL;
+    /* Request is not in flight any longer */
+
+    if( FCB->State == SOCKET_STATE_CLOSED || !NT_SUCCESS(Status) ) {
+        if( FCB->State == SOCKET_STATE_CLOSED )
+            Status = STATUS_FILE_CLOSED;
+
+        /* Fail our IRP and everything queued up behind it */
+        while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_SEND] ) ) {
+            NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
+            NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
+            NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
+            SendReq = GetLockedData(NextIrp, NextIrpSp);
+            NextIrp->IoStatus.Status = Status;
+            NextIrp->IoStatus.Information = 0;
+            UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
+            if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, NextIrpSp );
+            (void)IoSetCancelRoutine(NextIrp, NULL);
+            IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
+        }
+
+        RetryDisconnectCompletion(FCB);
+
+        SocketStateUnlock( FCB );
+
+        return Status == STATUS_FILE_CLOSED ? STATUS_FILE_CLOSED : STATUS_SUCCESS;
+    }
+
+    /* Our IRP is at the head of the queue unless it was cancelled meanwhile */
+    NextIrpEntry = FCB->PendingIrpList[FUNCTION_SEND].Flink;
+    NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
+    if( NextIrpEntry != &FCB->PendingIrpList[FUNCTION_SEND] &&
+        NextIrp->Tail.Overlay.DriverContext[2] ) {
+        NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
+        SendReq = GetLockedData(NextIrp, NextIrpSp);
+
+        NextIrp->IoStatus.Information += Irp->IoStatus.Information;
+
+        /* The transport took part of it, hand it the rest */
+        if( Irp->IoStatus.Information != 0 &&
+            NextIrp->IoStatus.Information < SendReq->BufferArray[0].len ) {
+            Status = StartDirectSend( FCB, NextIrp );
+            if( Status == STATUS_PENDING ) {
+                SocketStateUnlock( FCB );
+                return STATUS_SUCCESS;
+            }
+        }
+
+        RemoveEntryList(NextIrpEntry);
+
+        /* Report what went out if anything did */
+        NextIrp->IoStatus.Status = NextIrp->IoStatus.Information ? STATUS_SUCCESS : Status;
+
+        (void)IoSetCancelRoutine(NextIrp, NULL);
+        UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
+        if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, NextIrpSp );
+        IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
+    }
+
+    if (FCB->Send.Size - FCB->Send.BytesUsed != 0 && !FCB->SendClosed &&
+        IsListEmpty(&FCB->PendingIrpList[FUNCTION_SEND]))
+    {
+        FCB->PollState |= AFD_EVENT_SEND;
+        FCB->PollStatus[FD_WRITE_BIT] = STATUS_SUCCESS;
+        PollReeval( FCB->DeviceExt, FCB->FileObject );
+    }
+
+    /* Anything written while we were busy went into the window */
+    if( FCB->Send.BytesUsed )
+    {
+        TdiSend( &FCB->SendIrp.InFlightRequest,
+                 FCB->Connection.Object,
+                 0,
+                 FCB->Send.Window,
+                 FCB->Send.BytesUsed,
+                 SendComplete,
+                 FCB );
+    }
+    else
+    {
+        RetryDisconnectCompletion(FCB);
+    }
+
+    SocketStateUnlock( FCB );
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS NTAPI
 AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
                             PIO_STACK_LOCATION IrpSp, BOOLEAN Short) {
@@ -334,6 +468,7 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     PAFD_SEND_INFO SendReq;
     UINT TotalBytesCopied = 0, i, SpaceAvail = 0, BytesCopied, SendLength;
     KPROCESSOR_MODE LockMode;
+    PAFD_MAPBUF Map;
 
     UNREFERENCED_PARAMETER(DeviceObject);
     UNREFERENCED_PARAMETER(Short);
@@ -472,6 +607,42 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         SendLength += SendReq->BufferArray[i].len;
     }
 
+    /* Too big for the window and nothing ahead of it: send it in place */
+    if (SendLength > FCB->Send.Size && SendReq->BufferCount == 1 &&
+        FCB->Send.BytesUsed == 0 && !FCB->SendIrp.InFlightRequest &&
+        IsListEmpty(&FCB->PendingIrpList[FUNCTION_SEND]) &&
+        !(SendReq->AfdFlags & AFD_IMMEDIATE) &&
+        (!FCB->NonBlocking || (SendReq->AfdFlags & AFD_OVERLAPPED)))
+    {
+        Map = (PAFD_MAPBUF)(SendReq->BufferArray + SendReq->BufferCount);
+
+        /* The mapping is torn down when UnlockBuffers unlocks the pages */
+        Irp->Tail.Overlay.DriverContext[2] = MmMapLockedPages( Map[0].Mdl, KernelMode );
+        Irp->IoStatus.Information = 0;
+
+        FCB->PollState &= ~AFD_EVENT_SEND;
+
+        Status = QueueUserModeIrp(FCB, Irp, FUNCTION_SEND);
+        if (Status == STATUS_PENDING)
+        {
+            Status = StartDirectSend(FCB, Irp);
+            if (Status != STATUS_PENDING)
+            {
+                NT_VERIFY(RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]) == &Irp->Tail.Overlay.ListEntry);
+                Irp->IoStatus.Status = Status;
+                Irp->IoStatus.Information = 0;
+                (void)IoSetCancelRoutine(Irp, NULL);
+                UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
+                UnlockRequest(Irp, IoGetCurrentIrpStackLocation(Irp));
+                IoCompleteRequest(Irp, IO_NETWORK_INCREMENT);
+            }
+        }
+
+        SocketStateUnlock(FCB);
+
+        return STATUS_PENDING;
+    }
+
     /* Make sure we've got the space */
     if (SendLength > SpaceAvail)
     {
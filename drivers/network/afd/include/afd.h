@@ -63,6 +63,17 @@ typedef struct IPADDR_ENTRY {
 	USHORT Pad;
 } IPADDR_ENTRY, *PIPADDR_ENTRY;
 
+/* Exported by the kernel but missing from the DDK headers */
+NTKERNELAPI
+NTSTATUS
+NTAPI
+IoSetIoCompletion(IN PVOID IoCompletion,
+                  IN PVOID KeyContext,
+                  IN PVOID ApcContext,
+                  IN NTSTATUS IoStatus,
+                  IN ULONG_PTR IoStatusInformation,
+                  IN BOOLEAN Quota);
+
 #define DN2H(dw) \
     ((((dw) & 0xFF000000L) >> 24) | \
 	 (((dw) & 0x00FF0000L) >> 8) | \
@@ -180,6 +191,8 @@ typedef struct _AFD_FCB {
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
     DWORD EventSelectDisabled;
+    PVOID PollNotifyContext;
+    DWORD PollNotifyEvents;
     UNICODE_STRING TdiDeviceName;
     PVOID Context;
     DWORD PollState;
@@ -328,6 +341,9 @@ AfdEventSelect( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 NTSTATUS NTAPI
 AfdEnumEvents( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 	       PIO_STACK_LOCATION IrpSp );
+NTSTATUS NTAPI
+AfdPollNotify( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+	       PIO_STACK_LOCATION IrpSp );
 VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceObject, PFILE_OBJECT FileObject );
 VOID KillSelectsForFCB( PAFD_DEVICE_EXTENSION DeviceExt,
                         PFILE_OBJECT FileObject, BOOLEAN ExclusiveOnly );
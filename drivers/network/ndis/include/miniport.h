@@ -96,8 +96,12 @@ typedef struct _LOGICAL_ADAPTER
     HARDWARE_ADDRESS            Address;                /* Hardware address of adapter */
     ULONG                       AddressLength;          /* Length of hardware address */
     PMINIPORT_BUGCHECK_CONTEXT  BugcheckContext;        /* Adapter's shutdown handler */
+    LONG                        WorkerQueued;           /* MiniportWorker is queued but hasn't started */
 } LOGICAL_ADAPTER, *PLOGICAL_ADAPTER;
 
+/* Most queued sends handed to the miniport in one call */
+#define MINIPORT_SEND_BATCH 16
+
 #define GET_LOGICAL_ADAPTER(Handle)((PLOGICAL_ADAPTER)Handle)
 
 extern LIST_ENTRY MiniportListHead;
@@ -182,6 +186,25 @@ MiniSendComplete(
     IN  PNDIS_PACKET    Packet,
     IN  NDIS_STATUS     Status);
 
+VOID
+MiniIndicateSendComplete(
+    PLOGICAL_ADAPTER    Adapter,
+    PNDIS_PACKET        Packet,
+    NDIS_STATUS         Status);
+
+VOID
+MiniQueueSendPackets(
+    PLOGICAL_ADAPTER    Adapter,
+    PPNDIS_PACKET       PacketArray,
+    UINT                NumberOfPackets,
+    BOOLEAN             Top);
+
+VOID
+MiniSendPackets(
+    PLOGICAL_ADAPTER    Adapter,
+    PPNDIS_PACKET       PacketArray,
+    UINT                NumberOfPackets);
+
 BOOLEAN
 MiniIsBusy(
     PLOGICAL_ADAPTER Adapter,
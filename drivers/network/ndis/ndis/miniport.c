@@ -271,6 +271,8 @@ NdisReturnPackets(
 
     NDIS_DbgPrint(MID_TRACE, ("Returning %d packets\n", NumberOfPackets));
 
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
     for (i = 0; i < NumberOfPackets; i++)
     {
         PacketsToReturn[i]->WrapperReserved[0]--;
@@ -280,13 +282,13 @@ NdisReturnPackets(
 
             NDIS_DbgPrint(MAX_TRACE, ("Freeing packet %d (adapter = 0x%p)\n", i, Adapter));
 
-            KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
             Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.ReturnPacketHandler(
                   Adapter->NdisMiniportBlock.MiniportAdapterContext,
                   PacketsToReturn[i]);
-            KeLowerIrql(OldIrql);
         }
     }
+
+    KeLowerIrql(OldIrql);
 }
 
 VOID NTAPI
@@ -374,6 +376,14 @@ MiniIndicateReceivePacket(
             }
         }
 
+        /* Tell the protocol the indication is over, like it is told after
+         * NdisMEthIndicateReceiveComplete */
+        if (AdapterBinding->ProtocolBinding->Chars.ReceiveCompleteHandler)
+        {
+            (*AdapterBinding->ProtocolBinding->Chars.ReceiveCompleteHandler)(
+                 AdapterBinding->NdisOpenBlock.ProtocolBindingContext);
+        }
+
         CurrentEntry = CurrentEntry->Flink;
     }
 
@@ -526,21 +536,22 @@ MiniRequestComplete(
     MiniWorkItemComplete(Adapter, NdisWorkItemRequest);
 }
 
-VOID NTAPI
-MiniSendComplete(
-    IN  NDIS_HANDLE     MiniportAdapterHandle,
-    IN  PNDIS_PACKET    Packet,
-    IN  NDIS_STATUS     Status)
+VOID
+MiniIndicateSendComplete(
+    PLOGICAL_ADAPTER    Adapter,
+    PNDIS_PACKET        Packet,
+    NDIS_STATUS         Status)
 /*
- * FUNCTION: Forwards a message to the initiating protocol saying
- *           that a packet was handled
+ * FUNCTION: Tells the initiating protocol that a packet was handled
  * ARGUMENTS:
- *     NdisAdapterHandle = Handle input to MiniportInitialize
- *     Packet            = Pointer to NDIS packet that was sent
- *     Status            = Status of send operation
+ *     Adapter = Pointer to the logical adapter the packet was sent on
+ *     Packet  = Pointer to NDIS packet that was sent
+ *     Status  = Status of send operation
+ * NOTES:
+ *     Unlike MiniSendComplete, this doesn't look for more work to do, so
+ *     a batch of completions can do that once at the end
  */
 {
-    PLOGICAL_ADAPTER Adapter = MiniportAdapterHandle;
     PADAPTER_BINDING AdapterBinding;
     KIRQL OldIrql;
     PSCATTER_GATHER_LIST SGList;
@@ -574,10 +585,133 @@ MiniSendComplete(
         Status);
 
     KeLowerIrql(OldIrql);
+}
+
+VOID NTAPI
+MiniSendComplete(
+    IN  NDIS_HANDLE     MiniportAdapterHandle,
+    IN  PNDIS_PACKET    Packet,
+    IN  NDIS_STATUS     Status)
+/*
+ * FUNCTION: Forwards a message to the initiating protocol saying
+ *           that a packet was handled
+ * ARGUMENTS:
+ *     NdisAdapterHandle = Handle input to MiniportInitialize
+ *     Packet            = Pointer to NDIS packet that was sent
+ *     Status            = Status of send operation
+ */
+{
+    PLOGICAL_ADAPTER Adapter = MiniportAdapterHandle;
+
+    MiniIndicateSendComplete(Adapter, Packet, Status);
 
     MiniWorkItemComplete(Adapter, NdisWorkItemSend);
 }
 
+VOID
+MiniSendPackets(
+    PLOGICAL_ADAPTER    Adapter,
+    PPNDIS_PACKET       PacketArray,
+    UINT                NumberOfPackets)
+/*
+ * FUNCTION: Hands an array of packets to the miniport
+ * ARGUMENTS:
+ *     Adapter         = Pointer to the logical adapter to send on
+ *     PacketArray     = Pointer to an array of packets, in send order
+ *     NumberOfPackets = Number of packets in the array
+ * NOTES:
+ *     Miniports with a SendPackets handler get the whole array in one
+ *     call. The packets a serialized miniport can't take yet are queued
+ *     back at the front, in order. Every packet is completed through
+ *     the protocol's SendComplete handler
+ */
+{
+    PNDIS_MINIPORT_CHARACTERISTICS Characteristics =
+        &Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics;
+    BOOLEAN Deserialized = (Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE) != 0;
+    BOOLEAN Completed = FALSE;
+    NDIS_STATUS NdisStatus;
+    KIRQL RaiseOldIrql;
+    UINT i;
+
+#if DBG
+    for (i = 0; i < NumberOfPackets; i++)
+        MiniDisplayPacket(PacketArray[i], "SEND");
+#endif
+
+    if (Characteristics->SendPacketsHandler)
+    {
+        if (Deserialized)
+        {
+            NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler with %u packets\n", NumberOfPackets));
+            (*Characteristics->SendPacketsHandler)(
+             Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
+
+            /* The miniport completes every packet itself */
+            return;
+        }
+
+        /* SendPackets is called at DISPATCH_LEVEL for all serialized miniports */
+        KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
+        NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler with %u packets\n", NumberOfPackets));
+        (*Characteristics->SendPacketsHandler)(
+         Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
+        KeLowerIrql(RaiseOldIrql);
+
+        for (i = 0; i < NumberOfPackets; i++)
+        {
+            NdisStatus = NDIS_GET_PACKET_STATUS(PacketArray[i]);
+            if (NdisStatus == NDIS_STATUS_RESOURCES)
+            {
+                /* Neither this one nor the rest were taken */
+                MiniQueueSendPackets(Adapter, &PacketArray[i], NumberOfPackets - i, TRUE);
+                break;
+            }
+
+            if (NdisStatus != NDIS_STATUS_PENDING)
+            {
+                MiniIndicateSendComplete(Adapter, PacketArray[i], NdisStatus);
+                Completed = TRUE;
+            }
+        }
+    }
+    else
+    {
+        /* Send is called at DISPATCH_LEVEL for all serialized miniports */
+        if (!Deserialized)
+            KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
+
+        for (i = 0; i < NumberOfPackets; i++)
+        {
+            NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's Send handler\n"));
+            NdisStatus = (*Characteristics->SendHandler)(
+                          Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i],
+                          PacketArray[i]->Private.Flags);
+            NDIS_DbgPrint(MAX_TRACE, ("back from miniport's send handler\n"));
+
+            if (!Deserialized && NdisStatus == NDIS_STATUS_RESOURCES)
+            {
+                MiniQueueSendPackets(Adapter, &PacketArray[i], NumberOfPackets - i, TRUE);
+                break;
+            }
+
+            if (NdisStatus != NDIS_STATUS_PENDING)
+            {
+                MiniIndicateSendComplete(Adapter, PacketArray[i], NdisStatus);
+                Completed = TRUE;
+            }
+        }
+
+        if (!Deserialized)
+            KeLowerIrql(RaiseOldIrql);
+    }
+
+    /* Once for the whole batch. If the miniport ran out of resources,
+     * it calls NdisMSendResourcesAvailable when it wants more */
+    if (Completed && i == NumberOfPackets)
+        MiniWorkItemComplete(Adapter, NdisWorkItemSend);
+}
+
 
 VOID NTAPI
 MiniSendResourcesAvailable(
@@ -971,10 +1105,107 @@ MiniWorkItemComplete(
     if (!MiniIsBusy(Adapter, WorkItemType))
         return;
 
-    /* There is, so fire the worker */
+    /* There is. A worker that hasn't started yet will see it too, so a
+     * burst of completions doesn't fire a worker each */
+    if (InterlockedExchange(&Adapter->WorkerQueued, TRUE))
+        return;
+
     IoWorkItem = IoAllocateWorkItem(Adapter->NdisMiniportBlock.DeviceObject);
     if (IoWorkItem)
         IoQueueWorkItem(IoWorkItem, MiniportWorker, DelayedWorkQueue, IoWorkItem);
+    else
+        InterlockedExchange(&Adapter->WorkerQueued, FALSE);
+}
+
+VOID
+MiniQueueSendPackets(
+    PLOGICAL_ADAPTER    Adapter,
+    PPNDIS_PACKET       PacketArray,
+    UINT                NumberOfPackets,
+    BOOLEAN             Top)
+/*
+ * FUNCTION: Queues an array of packets to be sent by the miniport worker
+ * ARGUMENTS:
+ *     Adapter         = Pointer to the logical adapter object to queue the packets on
+ *     PacketArray     = Pointer to an array of packets, in send order
+ *     NumberOfPackets = Number of packets in the array
+ *     Top             = TRUE to put them in front of everything queued, because
+ *                       the miniport turned the first one down
+ * NOTES:
+ *     The adapter lock is taken once for the whole array. Packets we can't
+ *     get a work item for are completed with NDIS_STATUS_RESOURCES
+ */
+{
+    PNDIS_MINIPORT_WORK_ITEM MiniportWorkItem, Previous = NULL;
+    UINT i = 0, Failed = NumberOfPackets;
+    KIRQL OldIrql;
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    ASSERT(Adapter);
+
+    KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
+
+    if (Top && !Adapter->NdisMiniportBlock.FirstPendingPacket)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Requeuing failed packet (%x).\n", PacketArray[0]));
+        Adapter->NdisMiniportBlock.FirstPendingPacket = PacketArray[0];
+        i = 1;
+    }
+
+    for (; i < NumberOfPackets; i++)
+    {
+        MiniportWorkItem = ExAllocatePool(NonPagedPool, sizeof(NDIS_MINIPORT_WORK_ITEM));
+        if (!MiniportWorkItem)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+            Failed = i;
+            break;
+        }
+
+        MiniportWorkItem->WorkItemType    = NdisWorkItemSend;
+        MiniportWorkItem->WorkItemContext = PacketArray[i];
+
+        /* safe due to adapter lock held */
+        if (Top)
+        {
+            /* Keep the array's order in front of what was queued */
+            if (!Previous)
+            {
+                MiniportWorkItem->Link.Next = (PSINGLE_LIST_ENTRY)Adapter->WorkQueueHead;
+                Adapter->WorkQueueHead = MiniportWorkItem;
+            }
+            else
+            {
+                MiniportWorkItem->Link.Next = Previous->Link.Next;
+                Previous->Link.Next = (PSINGLE_LIST_ENTRY)MiniportWorkItem;
+            }
+
+            if (!MiniportWorkItem->Link.Next)
+                Adapter->WorkQueueTail = MiniportWorkItem;
+
+            Previous = MiniportWorkItem;
+        }
+        else
+        {
+            MiniportWorkItem->Link.Next = NULL;
+            if (!Adapter->WorkQueueHead)
+            {
+                Adapter->WorkQueueHead = MiniportWorkItem;
+                Adapter->WorkQueueTail = MiniportWorkItem;
+            }
+            else
+            {
+                Adapter->WorkQueueTail->Link.Next = (PSINGLE_LIST_ENTRY)MiniportWorkItem;
+                Adapter->WorkQueueTail = MiniportWorkItem;
+            }
+        }
+    }
+
+    KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
+
+    for (i = Failed; i < NumberOfPackets; i++)
+        MiniIndicateSendComplete(Adapter, PacketArray[i], NDIS_STATUS_RESOURCES);
 }
 
 VOID
@@ -1223,20 +1454,40 @@ NTAPI
 MiniportWorker(IN PDEVICE_OBJECT DeviceObject, IN PVOID Context)
 {
   PLOGICAL_ADAPTER Adapter = DeviceObject->DeviceExtension;
-  KIRQL OldIrql, RaiseOldIrql;
+  KIRQL OldIrql;
   NDIS_STATUS NdisStatus;
   PVOID WorkItemContext;
   NDIS_WORK_ITEM_TYPE WorkItemType;
-  BOOLEAN AddressingReset;
+  BOOLEAN AddressingReset, MoreWork;
+  PNDIS_PACKET PacketArray[MINIPORT_SEND_BATCH];
+  UINT NumberOfPackets = 0;
 
   IoFreeWorkItem((PIO_WORKITEM)Context);
 
+  /* From here on, whatever gets queued needs another worker */
+  InterlockedExchange(&Adapter->WorkerQueued, FALSE);
+
   KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
 
   NdisStatus =
       MiniDequeueWorkItem
       (Adapter, &WorkItemType, &WorkItemContext);
 
+  /* Take the sends queued right behind this one along, so the
+   * miniport gets them in a single call */
+  if (NdisStatus == NDIS_STATUS_SUCCESS && WorkItemType == NdisWorkItemSend)
+    {
+      PacketArray[NumberOfPackets++] = WorkItemContext;
+
+      while (NumberOfPackets < MINIPORT_SEND_BATCH &&
+             Adapter->WorkQueueHead &&
+             Adapter->WorkQueueHead->WorkItemType == NdisWorkItemSend)
+        {
+          MiniDequeueWorkItem(Adapter, &WorkItemType, &WorkItemContext);
+          PacketArray[NumberOfPackets++] = WorkItemContext;
+        }
+    }
+
   KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
 
   if (NdisStatus == NDIS_STATUS_SUCCESS)
@@ -1247,65 +1498,8 @@ MiniportWorker(IN PDEVICE_OBJECT DeviceObject, IN PVOID Context)
             /*
              * called by ProSend when protocols want to send packets to the miniport
              */
-
-            if(Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)
-              {
-                if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-                {
-                    NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler\n"));
-                    (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-                     Adapter->NdisMiniportBlock.MiniportAdapterContext, (PPNDIS_PACKET)&WorkItemContext, 1);
-                    NdisStatus = NDIS_STATUS_PENDING;
-                }
-                else
-                {
-                    /* SendPackets is called at DISPATCH_LEVEL for all serialized miniports */
-                    KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-                    {
-                      NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's SendPackets handler\n"));
-                      (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-                       Adapter->NdisMiniportBlock.MiniportAdapterContext, (PPNDIS_PACKET)&WorkItemContext, 1);
-                    }
-                    KeLowerIrql(RaiseOldIrql);
-
-                    NdisStatus = NDIS_GET_PACKET_STATUS((PNDIS_PACKET)WorkItemContext);
-                    if( NdisStatus == NDIS_STATUS_RESOURCES ) {
-                        MiniQueueWorkItem(Adapter, WorkItemType, WorkItemContext, TRUE);
-                        break;
-                    }
-                }
-              }
-            else
-              {
-                if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-                {
-                  NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's Send handler\n"));
-                  NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                                Adapter->NdisMiniportBlock.MiniportAdapterContext, (PNDIS_PACKET)WorkItemContext,
-                                ((PNDIS_PACKET)WorkItemContext)->Private.Flags);
-                  NDIS_DbgPrint(MAX_TRACE, ("back from miniport's send handler\n"));
-                }
-                else
-                {
-                  /* Send is called at DISPATCH_LEVEL for all serialized miniports */
-                  KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-                  NDIS_DbgPrint(MAX_TRACE, ("Calling miniport's Send handler\n"));
-                  NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                                Adapter->NdisMiniportBlock.MiniportAdapterContext, (PNDIS_PACKET)WorkItemContext,
-                                ((PNDIS_PACKET)WorkItemContext)->Private.Flags);
-                  NDIS_DbgPrint(MAX_TRACE, ("back from miniport's send handler\n"));
-                  KeLowerIrql(RaiseOldIrql);
-                  if( NdisStatus == NDIS_STATUS_RESOURCES ) {
-                      MiniQueueWorkItem(Adapter, WorkItemType, WorkItemContext, TRUE);
-                      break;
-                  }
-                }
-              }
-
-	    if( NdisStatus != NDIS_STATUS_PENDING ) {
-		MiniSendComplete
-		    ( Adapter, (PNDIS_PACKET)WorkItemContext, NdisStatus );
-	    }
+            NDIS_DbgPrint(MAX_TRACE, ("Sending %u queued packets\n", NumberOfPackets));
+            MiniSendPackets(Adapter, PacketArray, NumberOfPackets);
             break;
 
           case NdisWorkItemSendLoopback:
@@ -1376,6 +1570,17 @@ MiniportWorker(IN PDEVICE_OBJECT DeviceObject, IN PVOID Context)
             break;
         }
     }
+
+  /* Completions that came in while we were queued only fired this one
+   * worker, so don't leave the rest of the queue behind. A packet the
+   * miniport turned down waits for NdisMSendResourcesAvailable instead */
+  KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
+  MoreWork = Adapter->WorkQueueHead != NULL &&
+             Adapter->NdisMiniportBlock.FirstPendingPacket == NULL;
+  KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
+
+  if (MoreWork)
+      MiniWorkItemComplete(Adapter, NdisMaxWorkItems);
 }
 
 
@@ -578,61 +578,35 @@ ProSendPackets(
     IN  NDIS_HANDLE     NdisBindingHandle,
     IN  PPNDIS_PACKET   PacketArray,
     IN  UINT            NumberOfPackets)
+/*
+ * FUNCTION: Forwards a request to send an array of packets to an NDIS miniport
+ * ARGUMENTS:
+ *     NdisBindingHandle = Adapter binding handle
+ *     PacketArray       = Pointer to an array of packets, in send order
+ *     NumberOfPackets   = Number of packets in the array
+ * NOTES:
+ *     Every packet is completed through the protocol's SendComplete handler
+ */
 {
     PADAPTER_BINDING AdapterBinding = NdisBindingHandle;
     PLOGICAL_ADAPTER Adapter = AdapterBinding->Adapter;
-    KIRQL RaiseOldIrql;
-    NDIS_STATUS NdisStatus;
     UINT i;
 
-    if(Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)
+    NDIS_DbgPrint(MAX_TRACE, ("Called with %u packets.\n", NumberOfPackets));
+
+    /* MiniSendComplete finds the binding there */
+    for (i = 0; i < NumberOfPackets; i++)
+        PacketArray[i]->Reserved[1] = (ULONG_PTR)NdisBindingHandle;
+
+    /* Don't overtake the sends that are already queued */
+    if (MiniIsBusy(Adapter, NdisWorkItemSend))
     {
-       if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-       {
-          (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
-       }
-       else
-       {
-          /* SendPackets is called at DISPATCH_LEVEL for all serialized miniports */
-          KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-          (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendPacketsHandler)(
-           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray, NumberOfPackets);
-          KeLowerIrql(RaiseOldIrql);
-          for (i = 0; i < NumberOfPackets; i++)
-          {
-             NdisStatus = NDIS_GET_PACKET_STATUS(PacketArray[i]);
-             if (NdisStatus != NDIS_STATUS_PENDING)
-                 MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-          }
-       }
-     }
-     else
-     {
-       if(Adapter->NdisMiniportBlock.Flags & NDIS_ATTRIBUTE_DESERIALIZE)
-       {
-          for (i = 0; i < NumberOfPackets; i++)
-          {
-             NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
-             if (NdisStatus != NDIS_STATUS_PENDING)
-                 MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-          }
-       }
-       else
-       {
-         /* Send is called at DISPATCH_LEVEL for all serialized miniports */
-         KeRaiseIrql(DISPATCH_LEVEL, &RaiseOldIrql);
-         for (i = 0; i < NumberOfPackets; i++)
-         {
-            NdisStatus = (*Adapter->NdisMiniportBlock.DriverHandle->MiniportCharacteristics.SendHandler)(
-                           Adapter->NdisMiniportBlock.MiniportAdapterContext, PacketArray[i], PacketArray[i]->Private.Flags);
-            if (NdisStatus != NDIS_STATUS_PENDING)
-                MiniSendComplete(Adapter, PacketArray[i], NdisStatus);
-         }
-         KeLowerIrql(RaiseOldIrql);
-       }
-     }
+        NDIS_DbgPrint(MID_TRACE, ("Busy: NdisWorkItemSend.\n"));
+        MiniQueueSendPackets(Adapter, PacketArray, NumberOfPackets, FALSE);
+        return;
+    }
+
+    MiniSendPackets(Adapter, PacketArray, NumberOfPackets);
 }
 
 NDIS_STATUS NTAPI
@@ -304,6 +304,75 @@ VOID NTAPI ProtocolSendComplete(
     FreeNdisPacket(Packet);
 }
 
+VOID LanGetChecksumFlags(
+    PLAN_ADAPTER Adapter,
+    PNDIS_PACKET Packet,
+    PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Flags the checksums the adapter already verified for us
+ * ARGUMENTS:
+ *     Adapter  = Pointer to LAN_ADAPTER structure
+ *     Packet   = Pointer to the received NDIS packet
+ *     IPPacket = Pointer to the IP packet to flag
+ */
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+
+    if (!Adapter->ChecksumOffload)
+        return;
+
+    ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet,
+                                                                     TcpIpChecksumPacketInfo));
+    if (ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded)
+        IPPacket->Flags |= IP_PACKET_FLAG_IP_CSUM;
+    if (ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded)
+        IPPacket->Flags |= IP_PACKET_FLAG_UDP_CSUM;
+    if (ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded)
+        IPPacket->Flags |= IP_PACKET_FLAG_TCP_CSUM;
+}
+
+BOOLEAN LanReceiveInline(
+    PLAN_ADAPTER Adapter,
+    PNDIS_PACKET Packet,
+    PVOID Data,
+    UINT Size)
+/*
+ * FUNCTION: Passes a received IPv4 datagram to IP without leaving DISPATCH_LEVEL
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ *     Packet  = NDIS packet the datagram came in (may be NULL)
+ *     Data    = Pointer to the IPv4 header
+ *     Size    = Number of contiguous bytes at Data
+ * RETURNS:
+ *     TRUE if the datagram was consumed, FALSE if it has to be queued
+ *     for the receive worker
+ * NOTES:
+ *     The datagram is used where the miniport put it, nothing is copied
+ */
+{
+    IP_PACKET IPPacket;
+    PIP_INTERFACE Interface = Adapter->Context;
+
+    IPInitializePacket(&IPPacket, IP_ADDRESS_V4);
+
+    IPPacket.Header = Data;
+    IPPacket.MappedHeader = TRUE;
+    IPPacket.TotalSize = Size;
+
+    if (Packet)
+        LanGetChecksumFlags(Adapter, Packet, &IPPacket);
+
+    if (!IPv4FastReceive(Interface, &IPPacket))
+        return FALSE;
+
+    /* Update interface stats */
+    Interface->Stats.InBytes += Size + Adapter->HeaderSize;
+
+    IPPacket.Free(&IPPacket);
+
+    return TRUE;
+}
+
 VOID LanReceiveWorker( PVOID Context ) {
     ULONG PacketType;
     PLAN_WQ_ITEM WorkItem = (PLAN_WQ_ITEM)Context;
@@ -330,6 +399,9 @@ VOID LanReceiveWorker( PVOID Context ) {
     IPPacket.NdisPacket = Packet;
     IPPacket.ReturnPacket = !LegacyReceive;
 
+    if (!LegacyReceive)
+        LanGetChecksumFlags(Adapter, Packet, &IPPacket);
+
     if (LegacyReceive)
     {
         /* Packet type is precomputed */
@@ -385,6 +457,29 @@ VOID LanReceiveWorker( PVOID Context ) {
     }
 }
 
+VOID LanReceiveQueueWorker( PVOID Context ) {
+    PLAN_ADAPTER Adapter = Context;
+    PLIST_ENTRY ListEntry;
+    KIRQL OldIrql;
+
+    /* Drain everything that was queued while we were getting scheduled */
+    for (;;) {
+        TcpipAcquireSpinLock(&Adapter->ReceiveQueueLock, &OldIrql);
+        if (IsListEmpty(&Adapter->ReceiveQueue)) {
+            Adapter->ReceiveWorkQueued = FALSE;
+            TcpipReleaseSpinLock(&Adapter->ReceiveQueueLock, OldIrql);
+            break;
+        }
+        ListEntry = RemoveHeadList(&Adapter->ReceiveQueue);
+        TcpipReleaseSpinLock(&Adapter->ReceiveQueueLock, OldIrql);
+
+        LanReceiveWorker(CONTAINING_RECORD(ListEntry, LAN_WQ_ITEM, ListEntry));
+    }
+
+    if (Adapter->Context)
+        TCPReceiveComplete(Adapter->Context);
+}
+
 VOID LanSubmitReceiveWork(
     NDIS_HANDLE BindingContext,
     PNDIS_PACKET Packet,
@@ -393,6 +488,8 @@ VOID LanSubmitReceiveWork(
     PLAN_WQ_ITEM WQItem = ExAllocatePoolWithTag(NonPagedPool, sizeof(LAN_WQ_ITEM),
                                                 WQ_CONTEXT_TAG);
     PLAN_ADAPTER Adapter = (PLAN_ADAPTER)BindingContext;
+    BOOLEAN QueueWork;
+    KIRQL OldIrql;
 
     TI_DbgPrint(DEBUG_DATALINK,("called\n"));
 
@@ -403,8 +500,20 @@ VOID LanSubmitReceiveWork(
     WQItem->BytesTransferred = BytesTransferred;
     WQItem->LegacyReceive = LegacyReceive;
 
-    if (!ChewCreate( LanReceiveWorker, WQItem ))
+    /* One work item serves every packet queued until it runs */
+    TcpipAcquireSpinLock(&Adapter->ReceiveQueueLock, &OldIrql);
+    InsertTailList(&Adapter->ReceiveQueue, &WQItem->ListEntry);
+    QueueWork = !Adapter->ReceiveWorkQueued;
+    Adapter->ReceiveWorkQueued = TRUE;
+    TcpipReleaseSpinLock(&Adapter->ReceiveQueueLock, OldIrql);
+
+    if (QueueWork && !ChewCreate( LanReceiveQueueWorker, Adapter )) {
+        TcpipAcquireSpinLock(&Adapter->ReceiveQueueLock, &OldIrql);
+        RemoveEntryList(&WQItem->ListEntry);
+        Adapter->ReceiveWorkQueued = FALSE;
+        TcpipReleaseSpinLock(&Adapter->ReceiveQueueLock, OldIrql);
         ExFreePoolWithTag(WQItem, WQ_CONTEXT_TAG);
+    }
 }
 
 VOID NTAPI ProtocolTransferDataComplete(
@@ -444,12 +553,26 @@ INT NTAPI ProtocolReceivePacket(
     PNDIS_PACKET NdisPacket)
 {
     PLAN_ADAPTER Adapter = BindingContext;
+    ULONG PacketType;
+    PCHAR Data;
+    UINT Size = 0;
 
     if (Adapter->State != LAN_STATE_STARTED) {
         TI_DbgPrint(DEBUG_DATALINK, ("Adapter is stopped.\n"));
         return 0;
     }
 
+    /* Plain IPv4 frames that sit in a single buffer don't need the worker */
+    GetDataPtr(NdisPacket, 0, &Data, &Size);
+    if (Size > Adapter->HeaderSize &&
+        GetPacketTypeFromHeaderBuffer(Adapter, Data, Size, &PacketType) == NDIS_STATUS_SUCCESS &&
+        PacketType == ETYPE_IPv4 &&
+        LanReceiveInline(Adapter, NdisPacket, Data + Adapter->HeaderSize, Size - Adapter->HeaderSize))
+    {
+        /* We're done with it already */
+        return 0;
+    }
+
     LanSubmitReceiveWork(BindingContext,
                          NdisPacket,
                          0, /* Unused */
@@ -510,6 +633,15 @@ NDIS_STATUS NTAPI ProtocolReceive(
     TI_DbgPrint(DEBUG_DATALINK, ("Adapter: %x (MTU %d)\n",
 				 Adapter, Adapter->MTU));
 
+    /* If the whole frame is in ordinary memory we can use it from there */
+    if (PacketType == ETYPE_IPv4 &&
+        LookaheadBufferSize == PacketSize &&
+        (Adapter->MacOptions & NDIS_MAC_OPTION_COPY_LOOKAHEAD_DATA) &&
+        LanReceiveInline(Adapter, NULL, LookaheadBuffer, LookaheadBufferSize))
+    {
+        return NDIS_STATUS_SUCCESS;
+    }
+
     /* Get a transfer data packet */
     NdisStatus = AllocatePacketWithBuffer( &NdisPacket, NULL,
                                            PacketSize );
@@ -562,7 +694,13 @@ VOID NTAPI ProtocolReceiveComplete(
  *     BindingContext = Pointer to a device context (LAN_ADAPTER)
  */
 {
+    PLAN_ADAPTER Adapter = (PLAN_ADAPTER)BindingContext;
+
     TI_DbgPrint(DEBUG_DATALINK, ("Called.\n"));
+
+    /* Deliver the TCP segments we were holding to coalesce */
+    if (Adapter->Context)
+        TCPReceiveComplete(Adapter->Context);
 }
 
 BOOLEAN ReadIpConfiguration(PIP_INTERFACE Interface)
@@ -1309,6 +1447,100 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+VOID LANEnableChecksumOffload(
+    PLAN_ADAPTER Adapter)
+/*
+ * FUNCTION: Asks the adapter to verify received IPv4, TCP and UDP checksums
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ * NOTES:
+ *     Only receive offload is enabled. Our transmit path copies every
+ *     datagram into a fresh NDIS packet, and lwIP has already summed
+ *     TCP segments by then, so there is nothing to gain from the
+ *     transmit side yet
+ */
+{
+    NDIS_STATUS NdisStatus;
+    PNDIS_TASK_OFFLOAD_HEADER Header;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM Checksum = NULL;
+    UCHAR Buffer[256];
+    ULONG Offset;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return;
+
+    Header = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.Flags.FixedHeaderSize = 1;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS || Header->OffsetFirstTask == 0)
+        return;
+
+    /* Look for the checksum task among the ones the adapter offers */
+    Offset = Header->OffsetFirstTask;
+    while (Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+           sizeof(NDIS_TASK_TCP_IP_CHECKSUM) <= sizeof(Buffer))
+    {
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_IP_CHECKSUM))
+        {
+            Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+            break;
+        }
+
+        if (Task->OffsetNextTask == 0)
+            break;
+        Offset += Task->OffsetNextTask;
+    }
+
+    if (!Checksum)
+        return;
+
+    TI_DbgPrint(DEBUG_DATALINK, ("Adapter receive checksums: IP %d UDP %d TCP %d\n",
+                                 Checksum->V4Receive.IpChecksum,
+                                 Checksum->V4Receive.UdpChecksum,
+                                 Checksum->V4Receive.TcpChecksum));
+
+    /* Turn on only what we can make use of */
+    RtlZeroMemory(&Checksum->V4Transmit, sizeof(Checksum->V4Transmit));
+    RtlZeroMemory(&Checksum->V6Transmit, sizeof(Checksum->V6Transmit));
+    RtlZeroMemory(&Checksum->V6Receive, sizeof(Checksum->V6Receive));
+
+    if (!Checksum->V4Receive.IpChecksum &&
+        !Checksum->V4Receive.TcpChecksum &&
+        !Checksum->V4Receive.UdpChecksum)
+        return;
+
+    /* Hand back a list with the checksum task alone */
+    Task->OffsetNextTask = 0;
+    Header->OffsetFirstTask = (ULONG)((PUCHAR)Task - Buffer);
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          Header->OffsetFirstTask + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+                          sizeof(NDIS_TASK_TCP_IP_CHECKSUM));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(DEBUG_DATALINK, ("Could not enable checksum offload (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    Adapter->ChecksumOffload = TRUE;
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,9 +1642,15 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Let the adapter verify checksums if it can */
+    LANEnableChecksumOffload(Adapter);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
+    /* We know when NDIS is done indicating, so TCP can batch what it gets */
+    TCPEnableReceiveCoalescing(IF);
+
     /* Store adapter context */
     Adapter->Context = IF;
 
@@ -1507,6 +1745,9 @@ NDIS_STATUS LANRegisterAdapter(
     /* Initialize protecting spin lock */
     KeInitializeSpinLock(&IF->Lock);
 
+    InitializeListHead(&IF->ReceiveQueue);
+    KeInitializeSpinLock(&IF->ReceiveQueueLock);
+
     KeInitializeEvent(&IF->Event, SynchronizationEvent, FALSE);
 
     /* Initialize array with media IDs we support */
@@ -91,6 +91,9 @@ typedef struct _IP_PACKET {
 } IP_PACKET, *PIP_PACKET;
 
 #define IP_PACKET_FLAG_RAW      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_IP_CSUM  0x02    /* IP header checksum verified by the adapter */
+#define IP_PACKET_FLAG_UDP_CSUM 0x04    /* UDP checksum verified by the adapter */
+#define IP_PACKET_FLAG_TCP_CSUM 0x08    /* TCP checksum verified by the adapter */
 
 
 /* Packet context */
@@ -167,6 +170,7 @@ typedef struct _IP_INTERFACE {
     UINT  Index;                  /* Index of adapter (used to add ip addr) */
     LL_TRANSMIT_ROUTINE Transmit; /* Pointer to transmit function */
     PVOID TCPContext;             /* TCP Content for this interface */
+    PVOID TCPCoalesce;            /* TCP receive coalescing state, or NULL */
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
 } IP_INTERFACE, *PIP_INTERFACE;
 
@@ -59,6 +59,10 @@ typedef struct LAN_ADAPTER {
     UINT MacOptions;                        /* MAC options for NIC driver/adapter */
     UINT Speed;                             /* Link speed */
     UINT PacketFilter;                      /* Packet filter for this adapter */
+    BOOLEAN ChecksumOffload;                /* Adapter validates received checksums */
+    BOOLEAN ReceiveWorkQueued;              /* A worker is draining ReceiveQueue */
+    LIST_ENTRY ReceiveQueue;                /* Packets waiting for the receive worker */
+    KSPIN_LOCK ReceiveQueueLock;            /* Lock for ReceiveQueue */
 } LAN_ADAPTER, *PLAN_ADAPTER;
 
 /* LAN adapter state constants */
@@ -7,7 +7,8 @@
 
 #pragma once
 
-#define NB_HASHMASK 0xF /* Hash mask for neighbor cache */
+#define NB_HASHMASK 0xFF /* Hash mask for neighbor cache */
+#define NB_WHEEL_SLOTS 16 /* Timer wheel slots per hash bucket (power of 2) */
 
 typedef VOID (*PNEIGHBOR_PACKET_COMPLETE)
     ( PVOID Context, PNDIS_PACKET Packet, NDIS_STATUS Status );
@@ -22,14 +23,17 @@ typedef struct _NEIGHBOR_PACKET {
 typedef struct NEIGHBOR_CACHE_TABLE {
     struct NEIGHBOR_CACHE_ENTRY *Cache; /* Pointer to cache */
     KSPIN_LOCK Lock;                    /* Protecting lock */
+    LIST_ENTRY Wheel[NB_WHEEL_SLOTS];   /* NCEs by tick of their next event */
 } NEIGHBOR_CACHE_TABLE, *PNEIGHBOR_CACHE_TABLE;
 
 /* Information about a neighbor */
 typedef struct NEIGHBOR_CACHE_ENTRY {
     struct NEIGHBOR_CACHE_ENTRY *Next;  /* Pointer to next entry */
     UCHAR State;                        /* State of NCE */
-    UINT EventTimer;                    /* Ticks since last event */
-    UINT EventCount;                    /* Number of events */
+    UINT EventTimer;                    /* Ticks after last event until the NCE times out (0 = never) */
+    ULONG EventTime;                    /* Tick of last event */
+    ULONG NextEvent;                    /* Tick the timeout handler has to look at the NCE again */
+    LIST_ENTRY WheelEntry;              /* Entry on timer wheel slot */
     PIP_INTERFACE Interface;            /* Pointer to interface */
     UINT LinkAddressLength;             /* Length of link address */
     PVOID LinkAddress;                  /* Pointer to link address */
@@ -63,4 +63,8 @@ VOID IPReceive(
     PIP_INTERFACE IF,
     PIP_PACKET IPPacket);
 
+BOOLEAN IPv4FastReceive(
+    PIP_INTERFACE IF,
+    PIP_PACKET IPPacket);
+
 /* EOF */
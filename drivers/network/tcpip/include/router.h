@@ -10,6 +10,17 @@
 #include <neighbor.h>
 
 
+/* Node of the route lookup trie. Only nodes where two branches meet
+   or that carry routes exist, so a lookup visits at most one node per
+   prefix length */
+typedef struct _FIB_NODE {
+    struct _FIB_NODE *Parent;     /* Parent node, NULL for the root */
+    struct _FIB_NODE *Child[2];   /* Subtrees for the bit following the prefix */
+    ULONG Prefix;                 /* Prefix bits in host order, the rest are zero */
+    UINT Length;                  /* Number of bits in Prefix */
+    LIST_ENTRY RouteListHead;     /* FIB entries for exactly this prefix */
+} FIB_NODE, *PFIB_NODE;
+
 /* Forward Information Base Entry */
 typedef struct _FIB_ENTRY {
     LIST_ENTRY ListEntry;         /* Entry on list */
@@ -18,6 +29,8 @@ typedef struct _FIB_ENTRY {
     IP_ADDRESS Netmask;           /* Netmask of network */
     PNEIGHBOR_CACHE_ENTRY Router; /* Pointer to NCE of router to use */
     UINT Metric;                  /* Cost of this route */
+    PFIB_NODE Node;               /* Trie node holding this entry (IPv4 only) */
+    LIST_ENTRY NodeListEntry;     /* Entry on the node's route list */
 } FIB_ENTRY, *PFIB_ENTRY;
 
 PFIB_ENTRY RouterAddRoute(
@@ -27,6 +27,7 @@
 #define PACKET_BUFFER_TAG 'fuBP'
 #define FRAGMENT_DATA_TAG 'taDF'
 #define FIB_TAG ' BIF'
+#define FIB_NODE_TAG 'NBIF'
 #define IFC_TAG ' CFI'
 #define TDI_BUCKET_TAG 'BidT'
 #define FBSD_TAG 'DSBF'
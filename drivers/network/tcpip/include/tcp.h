@@ -191,6 +191,12 @@ NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
+VOID
+TCPEnableReceiveCoalescing(PIP_INTERFACE IF);
+
+VOID
+TCPReceiveComplete(PIP_INTERFACE Interface);
+
 VOID
 TCPUpdateInterfaceIPInformation(PIP_INTERFACE IF);
 
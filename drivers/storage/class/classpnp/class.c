@@ -2257,18 +2257,15 @@ VOID NTAPI ServiceTransferRequest(PDEVICE_OBJECT Fdo, PIRP Irp)
     SLIST_ENTRY pktList;
     PSLIST_ENTRY slistEntry;
     ULONG numPackets;
+    ULONG pieceLen, firstPieceLen;
     //KIRQL oldIrql;
     ULONG i;
 
     /*
-     *  Compute the number of hw xfers we'll have to do.
-     *  Calculate this without allowing for an overflow condition.
+     *  Compute the number of hw xfers we'll have to do,
+     *  split along the device's optimal granularity if it has one.
      */
-    ASSERT(fdoData->HwMaxXferLen >= PAGE_SIZE);
-    numPackets = entireXferLen/fdoData->HwMaxXferLen;
-    if (entireXferLen % fdoData->HwMaxXferLen){
-        numPackets++;
-    }
+    numPackets = ComputeXferSplit(Fdo, targetLocation, entireXferLen, &pieceLen, &firstPieceLen);
 
     /*
      *  First get all the TRANSFER_PACKETs that we'll need at once.
@@ -2311,7 +2308,9 @@ VOID NTAPI ServiceTransferRequest(PDEVICE_OBJECT Fdo, PIRP Irp)
          *  Transmit the pieces of the transfer.
          */
         while (entireXferLen > 0){
-            ULONG thisPieceLen = MIN(fdoData->HwMaxXferLen, entireXferLen);
+            ULONG thisPieceLen = MIN(firstPieceLen, entireXferLen);
+
+            firstPieceLen = pieceLen;
 
             /*
              *  Set up a TRANSFER_PACKET for this piece and send it.
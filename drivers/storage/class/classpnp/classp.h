@@ -369,7 +369,8 @@ typedef struct _TRANSFER_PACKET {
  *  The absolute maximum number of packets that we will allocate is
  *  whatever is required by the current activity, up to the memory limit;
  *  as soon as stress ends, we snap down to MAX_WORKINGSET_TRANSFER_PACKETS;
- *  we then lazily work down to MIN_WORKINGSET_TRANSFER_PACKETS.
+ *  we then lazily work down to MIN_WORKINGSET_TRANSFER_PACKETS, or to the
+ *  deepest queue recently seen on the device if that is larger.
  */
 #define MIN_INITIAL_TRANSFER_PACKETS                     1
 #define MIN_WORKINGSET_TRANSFER_PACKETS_Consumer      4
@@ -437,6 +438,13 @@ struct _CLASS_PRIVATE_FDO_DATA {
     ULONG NumTotalTransferPackets;
     ULONG DbgPeakNumTransferPackets;
 
+    /*
+     *  Adaptive working set: the most packets in flight since the device
+     *  last went idle, and the number we lazily trim down to once it does.
+     */
+    ULONG PeakOutstandingTransferPackets;
+    ULONG LocalMinWorkingSetTransferPackets;
+
     /*
      *  Queue for deferred client irps
      */
@@ -447,6 +455,14 @@ struct _CLASS_PRIVATE_FDO_DATA {
      */
     ULONG HwMaxXferLen;
 
+    /*
+     *  Optimal transfer length granularity and optimal transfer length
+     *  from the Block Limits VPD page, in logical blocks (0 if not reported).
+     *  Large transfers are split along these.
+     */
+    ULONG OptimalXferGranularity;
+    ULONG OptimalXferLen;
+
     /*
      *  SCSI_REQUEST_BLOCK template preconfigured with the constant values.
      *  This is slapped into the SRB in the TRANSFER_PACKET for each transfer.
@@ -865,6 +881,8 @@ VOID NTAPI SetupDriveCapacityTransferPacket(TRANSFER_PACKET *Pkt, PVOID ReadCapa
 PMDL NTAPI BuildDeviceInputMdl(PVOID Buffer, ULONG BufferLen);
 VOID NTAPI FreeDeviceInputMdl(PMDL Mdl);
 NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo);
+VOID NTAPI InitializeXferSplitLimits(PDEVICE_OBJECT Fdo);
+ULONG NTAPI ComputeXferSplit(PDEVICE_OBJECT Fdo, LARGE_INTEGER TargetLocation, ULONG XferLen, PULONG PieceLen, PULONG FirstPieceLen);
 VOID NTAPI DestroyAllTransferPackets(PDEVICE_OBJECT Fdo);
 
 #include "debug.h"
@@ -25,6 +25,7 @@ Revision History:
 
 #ifdef ALLOC_PRAGMA
     #pragma alloc_text(PAGE, InitializeTransferPackets)
+    #pragma alloc_text(PAGE, InitializeXferSplitLimits)
     #pragma alloc_text(PAGE, DestroyAllTransferPackets)
     #pragma alloc_text(PAGE, SetupEjectionTransferPacket)
     #pragma alloc_text(PAGE, SetupModeSenseTransferPacket)
@@ -75,6 +76,7 @@ NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo)
 
     fdoData->NumTotalTransferPackets = 0;
     fdoData->NumFreeTransferPackets = 0;
+    fdoData->PeakOutstandingTransferPackets = 0;
     InitializeSListHead(&fdoData->FreeTransferPacketsList);
     InitializeListHead(&fdoData->AllTransferPacketsList);
     InitializeListHead(&fdoData->DeferredClientIrpList);
@@ -102,6 +104,7 @@ NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo)
         MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
         MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
     }
+    fdoData->LocalMinWorkingSetTransferPackets = MinWorkingSetTransferPackets;
 
     while (fdoData->NumFreeTransferPackets < MIN_INITIAL_TRANSFER_PACKETS){
         PTRANSFER_PACKET pkt = NewTransferPacket(Fdo);
@@ -128,9 +131,175 @@ NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo)
     fdoData->SrbTemplate.SenseInfoBufferLength = sizeof(SENSE_DATA);
     fdoData->SrbTemplate.CdbLength = 10;
 
+    if (NT_SUCCESS(status)){
+        InitializeXferSplitLimits(Fdo);
+    }
+
     return status;
 }
 
+/*
+ *  InitializeXferSplitLimits
+ *
+ *      Read the optimal transfer granularity and length from the
+ *      Block Limits VPD page, if the device lists that page as supported.
+ */
+VOID NTAPI InitializeXferSplitLimits(PDEVICE_OBJECT Fdo)
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
+    PSTORAGE_DEVICE_DESCRIPTOR deviceDesc = fdoExt->DeviceDescriptor;
+    PVPD_SUPPORTED_PAGES_PAGE supportedPages;
+    PVPD_BLOCK_LIMITS_PAGE blockLimits;
+    SCSI_REQUEST_BLOCK srb;
+    PCDB cdb;
+    PUCHAR buffer;
+    BOOLEAN blockLimitsSupported = FALSE;
+    NTSTATUS status;
+    ULONG i;
+
+    PAGED_CODE();
+
+    fdoData->OptimalXferGranularity = 0;
+    fdoData->OptimalXferLen = 0;
+
+    /*
+     *  Only fixed disks report block limits; USB bridges are known to
+     *  choke on vital product data inquiries, so leave them alone.
+     */
+    if ((Fdo->DeviceType != FILE_DEVICE_DISK) ||
+        !deviceDesc ||
+        deviceDesc->RemovableMedia ||
+        (deviceDesc->BusType == BusTypeUsb)){
+        return;
+    }
+
+    buffer = ExAllocatePoolWithTag(NonPagedPoolCacheAligned, VPD_MAX_BUFFER_SIZE, 'vpPC');
+    if (!buffer){
+        return;
+    }
+
+    /*
+     *  1.  Get the list of supported VPD pages.
+     */
+    RtlZeroMemory(&srb, sizeof(SCSI_REQUEST_BLOCK));
+    RtlZeroMemory(buffer, VPD_MAX_BUFFER_SIZE);
+    srb.CdbLength = 6;
+    srb.TimeOutValue = fdoExt->TimeOutValue;
+    cdb = (PCDB)srb.Cdb;
+    cdb->CDB6INQUIRY3.OperationCode = SCSIOP_INQUIRY;
+    cdb->CDB6INQUIRY3.EnableVitalProductData = 1;
+    cdb->CDB6INQUIRY3.PageCode = VPD_SUPPORTED_PAGES;
+    cdb->CDB6INQUIRY3.AllocationLength = VPD_MAX_BUFFER_SIZE;
+
+    status = ClassSendSrbSynchronous(Fdo, &srb, buffer, VPD_MAX_BUFFER_SIZE, FALSE);
+    if (NT_SUCCESS(status) || (status == STATUS_DATA_OVERRUN)){
+        supportedPages = (PVPD_SUPPORTED_PAGES_PAGE)buffer;
+        if (supportedPages->PageCode == VPD_SUPPORTED_PAGES){
+            for (i = 0; (i < supportedPages->PageLength) &&
+                        (i < VPD_MAX_BUFFER_SIZE - sizeof(VPD_SUPPORTED_PAGES_PAGE)); i++){
+                if (supportedPages->SupportedPageList[i] == VPD_BLOCK_LIMITS){
+                    blockLimitsSupported = TRUE;
+                    break;
+                }
+            }
+        }
+    }
+
+    /*
+     *  2.  Read the block limits.
+     */
+    if (blockLimitsSupported){
+        RtlZeroMemory(&srb, sizeof(SCSI_REQUEST_BLOCK));
+        RtlZeroMemory(buffer, VPD_MAX_BUFFER_SIZE);
+        srb.CdbLength = 6;
+        srb.TimeOutValue = fdoExt->TimeOutValue;
+        cdb = (PCDB)srb.Cdb;
+        cdb->CDB6INQUIRY3.OperationCode = SCSIOP_INQUIRY;
+        cdb->CDB6INQUIRY3.EnableVitalProductData = 1;
+        cdb->CDB6INQUIRY3.PageCode = VPD_BLOCK_LIMITS;
+        cdb->CDB6INQUIRY3.AllocationLength = sizeof(VPD_BLOCK_LIMITS_PAGE);
+
+        status = ClassSendSrbSynchronous(Fdo, &srb, buffer, sizeof(VPD_BLOCK_LIMITS_PAGE), FALSE);
+        blockLimits = (PVPD_BLOCK_LIMITS_PAGE)buffer;
+        if ((NT_SUCCESS(status) || (status == STATUS_DATA_OVERRUN)) &&
+            (blockLimits->PageCode == VPD_BLOCK_LIMITS) &&
+            (srb.DataTransferLength >= FIELD_OFFSET(VPD_BLOCK_LIMITS_PAGE, MaxPrefetchXDReadXDWriteTransferLength))){
+
+            fdoData->OptimalXferGranularity = (blockLimits->OptimalTransferLengthGranularity[0] << 8) |
+                                               blockLimits->OptimalTransferLengthGranularity[1];
+            REVERSE_BYTES(&fdoData->OptimalXferLen, blockLimits->OptimalTransferLength);
+
+            DBGTRACE(ClassDebugTrace, ("Fdo %p: optimal transfer granularity %d blocks, optimal transfer length %d blocks.", Fdo, fdoData->OptimalXferGranularity, fdoData->OptimalXferLen));
+        }
+    }
+
+    ExFreePool(buffer);
+}
+
+/*
+ *  ComputeXferSplit
+ *
+ *      Work out how a read/write of XferLen bytes at TargetLocation is cut
+ *      into hardware transfers.  Pieces are HwMaxXferLen long, unless the
+ *      device reported an optimal granularity: then they are trimmed to a
+ *      multiple of it (and to the optimal transfer length), and the first
+ *      piece is shortened so that all the following ones start on a
+ *      granularity boundary.
+ *      Returns the number of pieces.
+ */
+ULONG NTAPI ComputeXferSplit(PDEVICE_OBJECT Fdo, LARGE_INTEGER TargetLocation, ULONG XferLen, PULONG PieceLen, PULONG FirstPieceLen)
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
+    ULONG bytesPerSector = fdoExt->DiskGeometry.BytesPerSector;
+    ULONG pieceLen = fdoData->HwMaxXferLen;
+    ULONG firstPieceLen;
+    ULONG remainingLen;
+    ULONG numPieces;
+
+    ASSERT(fdoData->HwMaxXferLen >= PAGE_SIZE);
+
+    if (fdoData->OptimalXferGranularity && bytesPerSector){
+        ULONGLONG granularity = (ULONGLONG)fdoData->OptimalXferGranularity * bytesPerSector;
+        ULONGLONG optimalLen = (ULONGLONG)fdoData->OptimalXferLen * bytesPerSector;
+
+        if (optimalLen >= granularity){
+            pieceLen = (ULONG)MIN(pieceLen, optimalLen);
+        }
+
+        if (pieceLen >= granularity){
+            pieceLen -= (ULONG)(pieceLen % granularity);
+            firstPieceLen = pieceLen - (ULONG)(TargetLocation.QuadPart % granularity);
+        }
+        else {
+            firstPieceLen = pieceLen;
+        }
+    }
+    else {
+        firstPieceLen = pieceLen;
+    }
+
+    /*
+     *  Calculate this without allowing for an overflow condition.
+     */
+    if (XferLen <= firstPieceLen){
+        firstPieceLen = XferLen;
+        numPieces = 1;
+    }
+    else {
+        remainingLen = XferLen - firstPieceLen;
+        numPieces = 1 + remainingLen/pieceLen;
+        if (remainingLen % pieceLen){
+            numPieces++;
+        }
+    }
+
+    *PieceLen = pieceLen;
+    *FirstPieceLen = firstPieceLen;
+    return numPieces;
+}
+
 VOID NTAPI DestroyAllTransferPackets(PDEVICE_OBJECT Fdo)
 {
     PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
@@ -236,6 +405,16 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
      */
     if (fdoData->NumFreeTransferPackets >= fdoData->NumTotalTransferPackets){
 
+        /*
+         *  The device just went idle.  Keep as many packets as the queue
+         *  recently needed, and let that figure decay so a past burst is
+         *  forgotten after a few idle periods.
+         */
+        fdoData->LocalMinWorkingSetTransferPackets =
+            MIN(MAX(fdoData->PeakOutstandingTransferPackets, MinWorkingSetTransferPackets),
+                MaxWorkingSetTransferPackets);
+        fdoData->PeakOutstandingTransferPackets /= 2;
+
         /*
          *  1.  Immediately snap down to our UPPER threshold.
          */
@@ -282,7 +461,7 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
         /*
          *  2.  Lazily work down to our LOWER threshold (by only freeing one packet at a time).
          */
-        if (fdoData->NumTotalTransferPackets > MinWorkingSetTransferPackets){
+        if (fdoData->NumTotalTransferPackets > fdoData->LocalMinWorkingSetTransferPackets){
             /*
              *  Check the counter again with lock held.  This eliminates a race condition
              *  while still allowing us to not grab the spinlock in the common codepath.
@@ -294,18 +473,18 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
              */
             PTRANSFER_PACKET pktToDelete = NULL; 
 
-            DBGTRACE(ClassDebugTrace, ("Exiting stress, lazily freeing one of %d/%d packets.", fdoData->NumTotalTransferPackets, MinWorkingSetTransferPackets));
+            DBGTRACE(ClassDebugTrace, ("Exiting stress, lazily freeing one of %d/%d packets.", fdoData->NumTotalTransferPackets, fdoData->LocalMinWorkingSetTransferPackets));
             
             KeAcquireSpinLock(&fdoData->SpinLock, &oldIrql);
             if ((fdoData->NumFreeTransferPackets >= fdoData->NumTotalTransferPackets) &&
-                (fdoData->NumTotalTransferPackets > MinWorkingSetTransferPackets)){
+                (fdoData->NumTotalTransferPackets > fdoData->LocalMinWorkingSetTransferPackets)){
                 
                 pktToDelete = DequeueFreeTransferPacket(Fdo, FALSE);
                 if (pktToDelete){
                     InterlockedDecrement((PLONG)&fdoData->NumTotalTransferPackets);    
                 }
                 else {
-                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (2).", MinWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
+                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (2).", fdoData->LocalMinWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
                 }
             }
             KeReleaseSpinLock(&fdoData->SpinLock, oldIrql);
@@ -355,6 +534,17 @@ PTRANSFER_PACKET NTAPI DequeueFreeTransferPacket(PDEVICE_OBJECT Fdo, BOOLEAN All
             pkt = NULL;
         }
     }
+
+    /*
+     *  Track the queue depth for the adaptive working set.
+     *  The update is racy, but an approximate peak is good enough.
+     */
+    if (pkt && AllocIfNeeded){
+        ULONG numOutstanding = fdoData->NumTotalTransferPackets - fdoData->NumFreeTransferPackets;
+        if (numOutstanding > fdoData->PeakOutstandingTransferPackets){
+            fdoData->PeakOutstandingTransferPackets = numOutstanding;
+        }
+    }
     
     return pkt;
 }
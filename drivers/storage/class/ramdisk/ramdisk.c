@@ -40,6 +40,9 @@
 
 #define TOC_DATA_TRACK              (0x04)
 
+/* Pages of a virtual disk described by one table of its page directory */
+#define RAMDISK_PAGE_TABLE_ENTRIES  512
+
 typedef enum _RAMDISK_DEVICE_TYPE
 {
     RamdiskBus,
@@ -110,6 +113,16 @@ typedef struct _RAMDISK_DRIVE_EXTENSION
     ULONG NumberOfHeads;
     ULONG Cylinders;
     ULONG HiddenSectors;
+
+    /* Mapping of the whole image, kept as long as the disk exists */
+    PUCHAR MappedBase;
+    PVOID MappedView;
+    SIZE_T MappedViewLength;
+
+    /* Backing store of a virtual disk, pages are allocated on first write */
+    PVOID **PageDirectory;
+    ULONG PageTableCount;
+    ERESOURCE PageLock;
 } RAMDISK_DRIVE_EXTENSION, *PRAMDISK_DRIVE_EXTENSION;
 
 ULONG MaximumViewLength;
@@ -264,6 +277,70 @@ QueryParameters(IN PUNICODE_STRING RegistryPath)
     }
 }
 
+PVOID
+NTAPI
+RamdiskGetSparsePage(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                     IN ULONG PageIndex,
+                     IN BOOLEAN Allocate)
+{
+    PVOID *PageTable, *NewTable;
+    PVOID Page, NewPage;
+    ULONG TableIndex;
+
+    /* Page lock must be held, shared is enough as the tables only grow */
+    TableIndex = PageIndex / RAMDISK_PAGE_TABLE_ENTRIES;
+    ASSERT(TableIndex < DeviceExtension->PageTableCount);
+
+    /* Get the page table, building it if we have to */
+    PageTable = DeviceExtension->PageDirectory[TableIndex];
+    if (!PageTable)
+    {
+        if (!Allocate) return NULL;
+
+        NewTable = ExAllocatePoolWithTag(NonPagedPool,
+                                         RAMDISK_PAGE_TABLE_ENTRIES * sizeof(PVOID),
+                                         'tmaR');
+        if (!NewTable) return NULL;
+        RtlZeroMemory(NewTable, RAMDISK_PAGE_TABLE_ENTRIES * sizeof(PVOID));
+
+        /* Someone else may have been faster */
+        PageTable = InterlockedCompareExchangePointer((PVOID *)&DeviceExtension->PageDirectory[TableIndex],
+                                                      NewTable,
+                                                      NULL);
+        if (PageTable)
+        {
+            ExFreePoolWithTag(NewTable, 'tmaR');
+        }
+        else
+        {
+            PageTable = NewTable;
+        }
+    }
+
+    /* Same thing for the page itself, which starts zeroed */
+    Page = PageTable[PageIndex % RAMDISK_PAGE_TABLE_ENTRIES];
+    if (!Page && Allocate)
+    {
+        NewPage = ExAllocatePoolWithTag(NonPagedPool, PAGE_SIZE, 'pmaR');
+        if (!NewPage) return NULL;
+        RtlZeroMemory(NewPage, PAGE_SIZE);
+
+        Page = InterlockedCompareExchangePointer(&PageTable[PageIndex % RAMDISK_PAGE_TABLE_ENTRIES],
+                                                 NewPage,
+                                                 NULL);
+        if (Page)
+        {
+            ExFreePoolWithTag(NewPage, 'pmaR');
+        }
+        else
+        {
+            Page = NewPage;
+        }
+    }
+
+    return Page;
+}
+
 PVOID
 NTAPI
 RamdiskMapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
@@ -278,9 +355,38 @@ RamdiskMapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
     LARGE_INTEGER ActualOffset;
     LARGE_INTEGER ActualPages;
 
+    /* Virtual disks hand out their backing page, locked until unmapped */
+    if (DeviceExtension->DiskType == RAMDISK_VIRTUAL_DISK)
+    {
+        KeEnterCriticalRegion();
+        ExAcquireResourceSharedLite(&DeviceExtension->PageLock, TRUE);
+
+        MappedBase = RamdiskGetSparsePage(DeviceExtension,
+                                          (ULONG)(Offset.QuadPart >> PAGE_SHIFT),
+                                          TRUE);
+        if (!MappedBase)
+        {
+            ExReleaseResourceLite(&DeviceExtension->PageLock);
+            KeLeaveCriticalRegion();
+            return NULL;
+        }
+
+        /* The caller only gets the rest of that page */
+        PageOffset = BYTE_OFFSET(Offset.QuadPart);
+        *OutputLength = min(Length, PAGE_SIZE - PageOffset);
+        return (PVOID)((ULONG_PTR)MappedBase + PageOffset);
+    }
+
     /* We only support boot disks for now */
     ASSERT(DeviceExtension->DiskType == RAMDISK_BOOT_DISK);
 
+    /* Use the permanent mapping if the disk has one */
+    if (DeviceExtension->MappedBase)
+    {
+        *OutputLength = Length;
+        return DeviceExtension->MappedBase + Offset.QuadPart;
+    }
+
     /* Calculate the actual offset in the drive */
     ActualOffset.QuadPart = DeviceExtension->DiskOffset + Offset.QuadPart;
 
@@ -322,9 +428,20 @@ RamdiskUnmapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
     SIZE_T ActualLength;
     ULONG PageOffset;
 
+    /* Drop the page lock taken when mapping a virtual disk page */
+    if (DeviceExtension->DiskType == RAMDISK_VIRTUAL_DISK)
+    {
+        ExReleaseResourceLite(&DeviceExtension->PageLock);
+        KeLeaveCriticalRegion();
+        return;
+    }
+
     /* We only support boot disks for now */
     ASSERT(DeviceExtension->DiskType == RAMDISK_BOOT_DISK);
 
+    /* Nothing to do if this came from the permanent mapping */
+    if (DeviceExtension->MappedBase) return;
+
     /* Calculate the actual offset in the drive */
     ActualOffset.QuadPart = DeviceExtension->DiskOffset + Offset.QuadPart;
 
@@ -365,6 +482,10 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
     PVOID BaseAddress;
     LARGE_INTEGER CurrentOffset, CylinderSize, DiskLength;
     ULONG CylinderCount, SizeByCylinders;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    ULONGLONG ViewLength;
+    PVOID **PageDirectory = NULL;
+    ULONG PageTableCount = 0;
 
     /* Check if we're a boot RAM disk */
     DiskType = Input->DiskType;
@@ -385,6 +506,21 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
             Input->Options.NoDosDevice = FALSE;
             Input->Options.NoDriveLetter = IsWinPEBoot ? TRUE : FALSE;
         }
+        else if (DiskType == RAMDISK_VIRTUAL_DISK)
+        {
+            /* Every page has to be reachable through the page directory */
+            if ((Input->DiskLength.QuadPart <= 0) ||
+                ((Input->DiskLength.QuadPart >> PAGE_SHIFT) >= MAXULONG))
+            {
+                return STATUS_INVALID_PARAMETER;
+            }
+
+            /* Sanitize disk options */
+            Input->DiskOffset = 0;
+            Input->Options.ExportAsCd = FALSE;
+            Input->Options.Readonly = FALSE;
+            Input->Options.Hidden = FALSE;
+        }
         else
         {
             /* The only other possibility is a WIM disk */
@@ -408,6 +544,18 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
         /* Are we just validating and returning to the user? */
         if (ValidateOnly) return STATUS_SUCCESS;
 
+        /* A virtual disk gets its page directory, the rest comes on demand */
+        if (DiskType == RAMDISK_VIRTUAL_DISK)
+        {
+            PageTableCount = (ULONG)(((Input->DiskLength.QuadPart + PAGE_SIZE - 1) >> PAGE_SHIFT) +
+                                     RAMDISK_PAGE_TABLE_ENTRIES - 1) / RAMDISK_PAGE_TABLE_ENTRIES;
+            PageDirectory = ExAllocatePoolWithTag(NonPagedPool,
+                                                  PageTableCount * sizeof(PVOID),
+                                                  'dmaR');
+            if (!PageDirectory) return STATUS_INSUFFICIENT_RESOURCES;
+            RtlZeroMemory(PageDirectory, PageTableCount * sizeof(PVOID));
+        }
+
         /* Build the GUID string */
         Status = RtlStringFromGUID(&Input->DiskGuid, &GuidString);
         if (!(NT_SUCCESS(Status)) || !(GuidString.Buffer))
@@ -530,6 +678,36 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
         DriveExtension->SectorsPerTrack = 0;
         DriveExtension->NumberOfHeads = 0;
 
+        /* Hand the backing store over to a virtual disk */
+        if (Input->DiskType == RAMDISK_VIRTUAL_DISK)
+        {
+            ExInitializeResourceLite(&DriveExtension->PageLock);
+            DriveExtension->PageDirectory = PageDirectory;
+            DriveExtension->PageTableCount = PageTableCount;
+        }
+
+        /* Map a boot image for good if it fits the per-disk view length, so
+         * that I/O doesn't have to map and unmap it every time */
+        if (Input->DiskType == RAMDISK_BOOT_DISK)
+        {
+            ViewLength = BYTE_OFFSET(Input->DiskOffset) + DiskLength.QuadPart;
+            ViewLength = (ViewLength + PAGE_SIZE - 1) & ~((ULONGLONG)PAGE_SIZE - 1);
+            if (ViewLength <= MaximumPerDiskViewLength)
+            {
+                PhysicalAddress.QuadPart = ((ULONGLONG)Input->BasePage +
+                                            (Input->DiskOffset >> PAGE_SHIFT)) << PAGE_SHIFT;
+                DriveExtension->MappedView = MmMapIoSpace(PhysicalAddress,
+                                                          (SIZE_T)ViewLength,
+                                                          MmCached);
+                if (DriveExtension->MappedView)
+                {
+                    DriveExtension->MappedViewLength = (SIZE_T)ViewLength;
+                    DriveExtension->MappedBase = (PUCHAR)DriveExtension->MappedView +
+                                                 BYTE_OFFSET(Input->DiskOffset);
+                }
+            }
+        }
+
         /* Make sure we don't free it later */
         DeviceName.Buffer = NULL;
         SymbolicLinkName.Buffer = NULL;
@@ -934,6 +1112,77 @@ SendIrpToThread(IN PDEVICE_OBJECT DeviceObject,
     }
 }
 
+NTSTATUS
+NTAPI
+RamdiskReadWriteSparse(IN PIRP Irp,
+                       IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                       IN PVOID SystemVa,
+                       IN LARGE_INTEGER Offset,
+                       IN ULONG Length)
+{
+    PIO_STACK_LOCATION IoStackLocation;
+    PVOID Page;
+    ULONG PageIndex, PageOffset, CopyLength;
+    BOOLEAN IsWrite;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    IoStackLocation = IoGetCurrentIrpStackLocation(Irp);
+    IsWrite = (IoStackLocation->MajorFunction == IRP_MJ_WRITE);
+
+    /* Keep TRIM from freeing pages while we copy */
+    KeEnterCriticalRegion();
+    ExAcquireResourceSharedLite(&DeviceExtension->PageLock, TRUE);
+
+    while (Length)
+    {
+        PageIndex = (ULONG)(Offset.QuadPart >> PAGE_SHIFT);
+        PageOffset = BYTE_OFFSET(Offset.QuadPart);
+        CopyLength = min(Length, PAGE_SIZE - PageOffset);
+
+        if (IsWrite)
+        {
+            /* Zeroing a whole page that was never written needs no memory */
+            Page = RamdiskGetSparsePage(DeviceExtension, PageIndex, FALSE);
+            if (!Page &&
+                ((CopyLength != PAGE_SIZE) ||
+                 ((ULONG_PTR)SystemVa & (sizeof(ULONG) - 1)) ||
+                 (RtlCompareMemoryUlong(SystemVa, PAGE_SIZE, 0) != PAGE_SIZE)))
+            {
+                Page = RamdiskGetSparsePage(DeviceExtension, PageIndex, TRUE);
+                if (!Page)
+                {
+                    Status = STATUS_INSUFFICIENT_RESOURCES;
+                    break;
+                }
+            }
+
+            if (Page) RtlCopyMemory((PUCHAR)Page + PageOffset, SystemVa, CopyLength);
+        }
+        else
+        {
+            /* Holes read back as zeroes */
+            Page = RamdiskGetSparsePage(DeviceExtension, PageIndex, FALSE);
+            if (Page)
+            {
+                RtlCopyMemory(SystemVa, (PUCHAR)Page + PageOffset, CopyLength);
+            }
+            else
+            {
+                RtlZeroMemory(SystemVa, CopyLength);
+            }
+        }
+
+        Irp->IoStatus.Information += CopyLength;
+        SystemVa = (PVOID)((ULONG_PTR)SystemVa + CopyLength);
+        Offset.QuadPart += CopyLength;
+        Length -= CopyLength;
+    }
+
+    ExReleaseResourceLite(&DeviceExtension->PageLock);
+    KeLeaveCriticalRegion();
+    return Status;
+}
+
 NTSTATUS
 NTAPI
 RamdiskReadWriteReal(IN PIRP Irp,
@@ -978,6 +1227,16 @@ RamdiskReadWriteReal(IN PIRP Irp,
     BytesLeft = IoStackLocation->Parameters.Read.Length;
     if (!BytesLeft) return STATUS_INVALID_PARAMETER;
 
+    /* Virtual disks copy straight between the buffer and their pages */
+    if (DeviceExtension->DiskType == RAMDISK_VIRTUAL_DISK)
+    {
+        return RamdiskReadWriteSparse(Irp,
+                                      DeviceExtension,
+                                      SystemVa,
+                                      CurrentOffset,
+                                      BytesLeft);
+    }
+
     /* Do the copy loop */
     while (TRUE)
     {
@@ -1067,7 +1326,16 @@ RamdiskReadWrite(IN PDEVICE_OBJECT DeviceObject,
     // Length = IoStackLocation->Parameters.Read.Length;
     // ByteOffset = IoStackLocation->Parameters.Read.ByteOffset;
 
-    /* FIXME: Validate offset */
+    /* Validate offset, a virtual disk has nothing beyond its length */
+    if ((DeviceExtension->DiskType == RAMDISK_VIRTUAL_DISK) &&
+        ((IoStackLocation->Parameters.Read.ByteOffset.QuadPart < 0) ||
+         ((ULONGLONG)IoStackLocation->Parameters.Read.ByteOffset.QuadPart +
+          IoStackLocation->Parameters.Read.Length >
+          (ULONGLONG)DeviceExtension->DiskLength.QuadPart)))
+    {
+        Status = STATUS_INVALID_PARAMETER;
+        goto Complete;
+    }
 
     /* FIXME: Validate sector */
 
@@ -1106,6 +1374,86 @@ Complete:
     return ReturnStatus;
 }
 
+NTSTATUS
+NTAPI
+RamdiskManageDataSetAttributes(IN PIRP Irp,
+                               IN PRAMDISK_DRIVE_EXTENSION DeviceExtension)
+{
+    PDEVICE_MANAGE_DATA_SET_ATTRIBUTES Attributes;
+    PDEVICE_DATA_SET_RANGE Ranges;
+    DEVICE_DATA_SET_RANGE EntireDisk;
+    PIO_STACK_LOCATION IoStackLocation;
+    ULONG InputLength, RangeCount, i;
+    ULONGLONG FirstPage, EndPage, PageIndex;
+    PVOID *PageTable;
+
+    /* Validate the input */
+    IoStackLocation = IoGetCurrentIrpStackLocation(Irp);
+    InputLength = IoStackLocation->Parameters.DeviceIoControl.InputBufferLength;
+    Attributes = Irp->AssociatedIrp.SystemBuffer;
+    if ((InputLength < sizeof(DEVICE_MANAGE_DATA_SET_ATTRIBUTES)) ||
+        (Attributes->DataSetRangesOffset > InputLength) ||
+        (Attributes->DataSetRangesLength > InputLength - Attributes->DataSetRangesOffset))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* TRIM is all we know about */
+    if (Attributes->Action != DeviceDsmAction_Trim) return STATUS_INVALID_DEVICE_REQUEST;
+
+    /* Only a virtual disk has memory to give back, it's just a hint otherwise */
+    if (DeviceExtension->DiskType != RAMDISK_VIRTUAL_DISK) return STATUS_SUCCESS;
+
+    if (Attributes->Flags & DEVICE_DSM_FLAG_ENTIRE_DATA_SET_RANGE)
+    {
+        EntireDisk.StartingOffset = 0;
+        EntireDisk.LengthInBytes = DeviceExtension->DiskLength.QuadPart;
+        Ranges = &EntireDisk;
+        RangeCount = 1;
+    }
+    else
+    {
+        Ranges = (PDEVICE_DATA_SET_RANGE)((ULONG_PTR)Attributes + Attributes->DataSetRangesOffset);
+        RangeCount = Attributes->DataSetRangesLength / sizeof(DEVICE_DATA_SET_RANGE);
+    }
+
+    /* Nobody may be using a page while we free it */
+    KeEnterCriticalRegion();
+    ExAcquireResourceExclusiveLite(&DeviceExtension->PageLock, TRUE);
+
+    for (i = 0; i < RangeCount; i++)
+    {
+        if ((Ranges[i].StartingOffset < 0) ||
+            (Ranges[i].LengthInBytes > (ULONGLONG)DeviceExtension->DiskLength.QuadPart)) continue;
+
+        /* Only pages covered entirely can go, clipped to the disk */
+        FirstPage = ((ULONGLONG)Ranges[i].StartingOffset + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        EndPage = ((ULONGLONG)Ranges[i].StartingOffset + Ranges[i].LengthInBytes) >> PAGE_SHIFT;
+        EndPage = min(EndPage, (ULONGLONG)DeviceExtension->PageTableCount * RAMDISK_PAGE_TABLE_ENTRIES);
+
+        for (PageIndex = FirstPage; PageIndex < EndPage; PageIndex++)
+        {
+            PageTable = DeviceExtension->PageDirectory[PageIndex / RAMDISK_PAGE_TABLE_ENTRIES];
+            if (!PageTable)
+            {
+                /* Skip what was never written */
+                PageIndex |= RAMDISK_PAGE_TABLE_ENTRIES - 1;
+                continue;
+            }
+
+            if (PageTable[PageIndex % RAMDISK_PAGE_TABLE_ENTRIES])
+            {
+                ExFreePoolWithTag(PageTable[PageIndex % RAMDISK_PAGE_TABLE_ENTRIES], 'pmaR');
+                PageTable[PageIndex % RAMDISK_PAGE_TABLE_ENTRIES] = NULL;
+            }
+        }
+    }
+
+    ExReleaseResourceLite(&DeviceExtension->PageLock);
+    KeLeaveCriticalRegion();
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS
 NTAPI
 RamdiskDeviceControl(IN PDEVICE_OBJECT DeviceObject,
@@ -1315,6 +1663,12 @@ RamdiskDeviceControl(IN PDEVICE_OBJECT DeviceObject,
                 break;
             }
 
+            case IOCTL_STORAGE_MANAGE_DATA_SET_ATTRIBUTES:
+            {
+                Status = RamdiskManageDataSetAttributes(Irp, DriveExtension);
+                break;
+            }
+
             case IOCTL_DISK_GET_DRIVE_LAYOUT:
             case IOCTL_DISK_IS_WRITABLE:
             case IOCTL_SCSI_MINIPORT:
@@ -1122,6 +1122,14 @@ typedef struct _HW_CHANNEL {
     LONGLONG TryReorderTailCount; /* in-order requests */
 #endif //QUEUE_STATISTICS
 
+#ifdef IO_STATISTICS
+    LONGLONG DmaIoCount;
+    LONGLONG DmaByteCount;
+    LONGLONG PioIoCount;
+    LONGLONG PioByteCount;
+    LONGLONG DmaBounceCount; /* DMA through DB_IO instead of the caller's buffer */
+#endif //IO_STATISTICS
+
     //ULONG BaseMemAddress;
     //ULONG BaseMemAddressOffset;
     IORES RegTranslation[IDX_MAX_REG];
@@ -6126,6 +6126,21 @@ CompleteRequest:
             status = SRB_STATUS_DATA_OVERRUN;
         }
 
+#ifdef IO_STATISTICS
+        if((status == SRB_STATUS_SUCCESS) && srb->DataTransferLength) {
+            if(AtaReq->Flags & REQ_FLAG_DMA_OPERATION) {
+                chan->DmaIoCount++;
+                chan->DmaByteCount += srb->DataTransferLength;
+                if(AtaReq->Flags & REQ_FLAG_DMA_DBUF) {
+                    chan->DmaBounceCount++;
+                }
+            } else {
+                chan->PioIoCount++;
+                chan->PioByteCount += srb->DataTransferLength;
+            }
+        }
+#endif //IO_STATISTICS
+
         if (AtaReq->OriginalSrb) {
 
             ULONG srbStatus;
@@ -10241,6 +10256,13 @@ uata_ctl_queue:
                             ChanInfo->TryReorderHeadCount = cur_chan->TryReorderHeadCount;
                             ChanInfo->TryReorderTailCount = cur_chan->TryReorderTailCount;
                             //ChanInfo->opt_MaxTransferMode = cur_chan->opt_MaxTransferMode;
+#ifdef IO_STATISTICS
+                            ChanInfo->DmaIoCount          = cur_chan->DmaIoCount;
+                            ChanInfo->DmaByteCount        = cur_chan->DmaByteCount;
+                            ChanInfo->PioIoCount          = cur_chan->PioIoCount;
+                            ChanInfo->PioByteCount        = cur_chan->PioByteCount;
+                            ChanInfo->DmaBounceCount      = cur_chan->DmaBounceCount;
+#endif //IO_STATISTICS
                             ChanInfo++;
                         }
                         AtaCtl->AdapterInfo.ChanInfoValid = TRUE;
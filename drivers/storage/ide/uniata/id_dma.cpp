@@ -260,6 +260,7 @@ AtapiDmaSetup(
     PHW_CHANNEL chan = &(deviceExtension->chan[lChannel]);
     PATA_REQ AtaReq = (PATA_REQ)(Srb->SrbExtension);
     BOOLEAN use_DB_IO = FALSE;
+    BOOLEAN unaligned = FALSE;
     BOOLEAN use_AHCI = (deviceExtension->HwFlags & UNIATA_AHCI) ? TRUE : FALSE;
     ULONG orig_count = count;
     ULONG max_entries = use_AHCI ? ATA_AHCI_DMA_ENTRIES : ATA_DMA_ENTRIES;
@@ -295,7 +296,14 @@ AtapiDmaSetup(
     //KdPrint2((PRINT_PREFIX "  checkpoint 3\n" ));
     if((ULONG_PTR)data & deviceExtension->AlignmentMask) {
         KdPrint2((PRINT_PREFIX "AtapiDmaSetup: unaligned data: %#x (%#x)\n", data, deviceExtension->AlignmentMask));
-        return FALSE;
+        // bounce through the channel's DMA buffer rather than falling back to PIO,
+        // AtapiDmaDBSync()/AtapiDmaDBPreSync() copy the whole SRB data buffer
+        if(!chan->DB_IO ||
+           data != (PUCHAR)(AtaReq->DataBuffer) ||
+           count != Srb->DataTransferLength) {
+            return FALSE;
+        }
+        unaligned = TRUE;
     }
 
     //KdPrint2((PRINT_PREFIX "  checkpoint 4\n" ));
@@ -321,6 +329,9 @@ AtapiDmaSetup(
     }
     AtaReq->ata.dma_base = dma_base; // aliased to AtaReq->ahci.ahci_base64
 
+    if(unaligned) {
+        goto retry_DB_IO;
+    }
     KdPrint2((PRINT_PREFIX "  get Phys(data[0]=%x)\n", data ));
     dma_base = AtapiVirtToPhysAddr(HwDeviceExtension, Srb, data, &dma_count, &dma_baseu);
     if(dma_baseu && dma_count) {
@@ -329,6 +340,7 @@ AtapiDmaSetup(
 retry_DB_IO:
             use_DB_IO = TRUE;
             dma_base = chan->DB_IO_PhAddr;
+            dma_baseu = 0;
             data = (PUCHAR)(chan->DB_IO);
         } else {
             AtaReq->ahci.ahci_base64 = (ULONGLONG)dma_base | ((ULONGLONG)dma_baseu << 32);
@@ -540,7 +552,6 @@ AtapiDmaDBSync(
     if((Srb->SrbFlags & SRB_FLAGS_DATA_IN) &&
        (AtaReq->Flags & REQ_FLAG_DMA_DBUF)) {
         KdPrint2((PRINT_PREFIX "  AtapiDmaDBSync is issued.\n"));
-        ASSERT(FALSE);
         KdPrint2((PRINT_PREFIX "  DBUF (Read)\n"));
         RtlCopyMemory(AtaReq->DataBuffer, chan->DB_IO,
                               Srb->DataTransferLength);
@@ -576,7 +587,6 @@ AtapiDmaDBPreSync(
     if(!(Srb->SrbFlags & SRB_FLAGS_DATA_IN) &&
        (AtaReq->Flags & REQ_FLAG_DMA_DBUF)) {
         KdPrint2((PRINT_PREFIX "  DBUF (Write)\n"));
-        ASSERT(FALSE);
         RtlCopyMemory(chan->DB_IO, AtaReq->DataBuffer,
                               Srb->DataTransferLength);
     }
@@ -110,6 +110,12 @@ typedef struct _CHANINFO {
     LONGLONG TryReorderHeadCount;
     LONGLONG TryReorderTailCount; /* in-order requests */
 //    ULONG               opt_MaxTransferMode; // user-specified
+    // valid only if ADAPTERINFO.ChanHeaderLength covers them
+    LONGLONG DmaIoCount;
+    LONGLONG DmaByteCount;
+    LONGLONG PioIoCount;
+    LONGLONG PioByteCount;
+    LONGLONG DmaBounceCount;
 } CHANINFO, *PCHANINFO;
 
 typedef struct _ADAPTERINFO {
@@ -77,10 +77,9 @@ ScsiPortStartIo(IN PDEVICE_OBJECT DeviceObject,
 static BOOLEAN NTAPI
 ScsiPortStartPacket(IN OUT PVOID Context);
 
-IO_ALLOCATION_ACTION
-NTAPI
-SpiAdapterControl(PDEVICE_OBJECT DeviceObject, PIRP Irp,
-                  PVOID MapRegisterBase, PVOID Context);
+static VOID NTAPI
+SpiProcessScatterGatherList(PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                            PSCATTER_GATHER_LIST ScatterGather, PVOID Context);
 
 static PSCSI_PORT_LUN_EXTENSION
 SpiAllocateLunExtension(IN PSCSI_PORT_DEVICE_EXTENSION DeviceExtension);
@@ -630,7 +629,7 @@ ScsiPortGetPhysicalAddress(IN PVOID HwDeviceExtension,
     SCSI_PHYSICAL_ADDRESS PhysicalAddress;
     SIZE_T BufferLength = 0;
     ULONG_PTR Offset;
-    PSCSI_SG_ADDRESS SGList;
+    PSCATTER_GATHER_ELEMENT Element;
     PSCSI_REQUEST_BLOCK_INFO SrbInfo;
 
     DPRINT("ScsiPortGetPhysicalAddress(%p %p %p %p)\n",
@@ -640,7 +639,11 @@ ScsiPortGetPhysicalAddress(IN PVOID HwDeviceExtension,
                                         SCSI_PORT_DEVICE_EXTENSION,
                                         MiniPortDeviceExtension);
 
-    if (Srb == NULL || Srb->SenseInfoBuffer == VirtualAddress)
+    /* SRB extensions and sense buffers live in the common buffer too */
+    if (Srb == NULL || Srb->SenseInfoBuffer == VirtualAddress ||
+        (DeviceExtension->SrbExtensionBuffer != NULL &&
+         (ULONG_PTR)((PUCHAR)VirtualAddress - (PUCHAR)DeviceExtension->SrbExtensionBuffer) <
+             DeviceExtension->CommonBufferLength))
     {
         /* Simply look it up in the allocated common buffer */
         Offset = (PUCHAR)VirtualAddress - (PUCHAR)DeviceExtension->SrbExtensionBuffer;
@@ -657,19 +660,25 @@ ScsiPortGetPhysicalAddress(IN PVOID HwDeviceExtension,
                                Srb->Lun,
                                Srb->QueueTag);
 
-        SGList = SrbInfo->ScatterGather;
+        if (SrbInfo == NULL || SrbInfo->ScatterGather == NULL)
+        {
+            *Length = 0;
+            PhysicalAddress.QuadPart = (LONGLONG)(SP_UNINITIALIZED_VALUE);
+            return PhysicalAddress;
+        }
 
         /* Find needed item in the SG list */
+        Element = SrbInfo->ScatterGather->Elements;
         Offset = (PCHAR)VirtualAddress - (PCHAR)Srb->DataBuffer;
-        while (Offset >= SGList->Length)
+        while (Offset >= Element->Length)
         {
-            Offset -= SGList->Length;
-            SGList++;
+            Offset -= Element->Length;
+            Element++;
         }
 
         /* We're done, store length and physical address */
-        BufferLength = SGList->Length - Offset;
-        PhysicalAddress.QuadPart = SGList->PhysicalAddress.QuadPart + Offset;
+        BufferLength = Element->Length - Offset;
+        PhysicalAddress.QuadPart = Element->Address.QuadPart + Offset;
     }
     else
     {
@@ -3007,21 +3016,24 @@ ScsiPortStartIo(IN PDEVICE_OBJECT DeviceObject,
 
         if (DeviceExtension->MapRegisters)
         {
-            /* Calculate number of needed map registers */
-            SrbInfo->NumberOfMapRegisters = ADDRESS_AND_SIZE_TO_SPAN_PAGES(
-                    Srb->DataBuffer,
-                    Srb->DataTransferLength);
-
-            /* Allocate adapter channel */
-            Status = IoAllocateAdapterChannel(DeviceExtension->AdapterObject,
-                                              DeviceExtension->DeviceObject,
-                                              SrbInfo->NumberOfMapRegisters,
-                                              SpiAdapterControl,
-                                              SrbInfo);
+            PDMA_ADAPTER DmaAdapter = (PDMA_ADAPTER)DeviceExtension->AdapterObject;
+
+            /* Let the HAL describe the whole transfer with a scatter/gather
+               list, the request is started from the list callback */
+            Status = DmaAdapter->DmaOperations->GetScatterGatherList(
+                DmaAdapter,
+                DeviceExtension->DeviceObject,
+                Irp->MdlAddress,
+                (PUCHAR)MmGetMdlVirtualAddress(Irp->MdlAddress) +
+                    ((PCHAR)Srb->DataBuffer - SrbInfo->DataOffset),
+                Srb->DataTransferLength,
+                SpiProcessScatterGatherList,
+                SrbInfo,
+                (Srb->SrbFlags & SRB_FLAGS_DATA_OUT) ? TRUE : FALSE);
 
             if (!NT_SUCCESS(Status))
             {
-                DPRINT1("IoAllocateAdapterChannel() failed!\n");
+                DPRINT1("GetScatterGatherList() failed with Status 0x%08lx!\n", Status);
 
                 Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
                 ScsiPortNotification(RequestComplete,
@@ -3035,7 +3047,7 @@ ScsiPortStartIo(IN PDEVICE_OBJECT DeviceObject,
                 IoRequestDpc(DeviceExtension->DeviceObject, NULL, NULL);
             }
 
-            /* Control goes to SpiAdapterControl */
+            /* Control goes to SpiProcessScatterGatherList */
             return;
         }
     }
@@ -3237,78 +3249,26 @@ ScsiPortStartPacket(IN OUT PVOID Context)
     return Result;
 }
 
-IO_ALLOCATION_ACTION
-NTAPI
-SpiAdapterControl(PDEVICE_OBJECT DeviceObject,
-                  PIRP Irp,
-                  PVOID MapRegisterBase,
-                  PVOID Context)
+static VOID NTAPI
+SpiProcessScatterGatherList(PDEVICE_OBJECT DeviceObject,
+                            PIRP Irp,
+                            PSCATTER_GATHER_LIST ScatterGather,
+                            PVOID Context)
 {
-    PSCSI_REQUEST_BLOCK Srb;
-    PSCSI_SG_ADDRESS ScatterGatherList;
     KIRQL CurrentIrql;
-    PIO_STACK_LOCATION IrpStack;
-    ULONG TotalLength = 0;
     PSCSI_REQUEST_BLOCK_INFO SrbInfo;
     PSCSI_PORT_DEVICE_EXTENSION DeviceExtension;
-    PUCHAR DataVA;
-    BOOLEAN WriteToDevice;
 
     /* Get pointers to SrbInfo and DeviceExtension */
     SrbInfo = (PSCSI_REQUEST_BLOCK_INFO)Context;
     DeviceExtension = DeviceObject->DeviceExtension;
 
-    /* Get pointer to SRB */
-    IrpStack = IoGetCurrentIrpStackLocation(Irp);
-    Srb = (PSCSI_REQUEST_BLOCK)IrpStack->Parameters.Others.Argument1;
-
-    /* Depending on the map registers number, we allocate
-       either from NonPagedPool, or from our static list */
-    if (SrbInfo->NumberOfMapRegisters > MAX_SG_LIST)
-    {
-        SrbInfo->ScatterGather = ExAllocatePoolWithTag(
-            NonPagedPool, SrbInfo->NumberOfMapRegisters * sizeof(SCSI_SG_ADDRESS), TAG_SCSIPORT);
-
-        if (SrbInfo->ScatterGather == NULL)
-            ASSERT(FALSE);
-
-        Srb->SrbFlags |= SRB_FLAGS_SGLIST_FROM_POOL;
-    }
-    else
-    {
-        SrbInfo->ScatterGather = SrbInfo->ScatterGatherList;
-    }
-
-    /* Use chosen SG list source */
-    ScatterGatherList = SrbInfo->ScatterGather;
-
-    /* Save map registers base */
-    SrbInfo->BaseOfMapRegister = MapRegisterBase;
-
-    /* Determine WriteToDevice flag */
-    WriteToDevice = Srb->SrbFlags & SRB_FLAGS_DATA_OUT ? TRUE : FALSE;
-
-    /* Get virtual address of the data buffer */
-    DataVA = (PUCHAR)MmGetMdlVirtualAddress(Irp->MdlAddress) +
-                ((PCHAR)Srb->DataBuffer - SrbInfo->DataOffset);
+    /* The list is owned by the request until it completes, the HAL
+       keeps the map registers allocated until then */
+    SrbInfo->ScatterGather = ScatterGather;
 
-    /* Build the actual SG list */
-    while (TotalLength < Srb->DataTransferLength)
-    {
-        if (!ScatterGatherList)
-            break;
-
-        ScatterGatherList->Length = Srb->DataTransferLength - TotalLength;
-        ScatterGatherList->PhysicalAddress = IoMapTransfer(DeviceExtension->AdapterObject,
-                                                           Irp->MdlAddress,
-                                                           MapRegisterBase,
-                                                           DataVA + TotalLength,
-                                                           &ScatterGatherList->Length,
-                                                           WriteToDevice);
-
-        TotalLength += ScatterGatherList->Length;
-        ScatterGatherList++;
-    }
+    DPRINT("Srb %p got %lu scatter/gather elements\n",
+        SrbInfo->Srb, ScatterGather->NumberOfElements);
 
     /* Schedule an active request */
     InterlockedIncrement(&DeviceExtension->ActiveRequestCounter );
@@ -3317,8 +3277,6 @@ SpiAdapterControl(PDEVICE_OBJECT DeviceObject,
                            ScsiPortStartPacket,
                            DeviceObject);
     KeReleaseSpinLock(&DeviceExtension->SpinLock, CurrentIrql);
-
-    return DeallocateObjectKeepRegisters;
 }
 
 static PSCSI_PORT_LUN_EXTENSION
@@ -4268,11 +4226,17 @@ SpiProcessCompletedRequest(IN PSCSI_PORT_DEVICE_EXTENSION DeviceExtension,
         }
     }
 
-    /* Flush adapter if needed */
-    if (SrbInfo->BaseOfMapRegister)
+    /* Flush the adapter buffers and release the map registers */
+    if (SrbInfo->ScatterGather)
     {
-        /* TODO: Implement */
-        ASSERT(FALSE);
+        PDMA_ADAPTER DmaAdapter = (PDMA_ADAPTER)DeviceExtension->AdapterObject;
+
+        DmaAdapter->DmaOperations->PutScatterGatherList(
+            DmaAdapter,
+            SrbInfo->ScatterGather,
+            (Srb->SrbFlags & SRB_FLAGS_DATA_OUT) ? TRUE : FALSE);
+
+        SrbInfo->ScatterGather = NULL;
     }
 
     /* Clear the request */
@@ -4303,13 +4267,6 @@ SpiProcessCompletedRequest(IN PSCSI_PORT_DEVICE_EXTENSION DeviceExtension,
         }
     }
 
-    /* Scatter/gather */
-    if (Srb->SrbFlags & SRB_FLAGS_SGLIST_FROM_POOL)
-    {
-        /* TODO: Implement */
-        ASSERT(FALSE);
-    }
-
     /* Acquire spinlock (we're freeing SrbExtension) */
     KeAcquireSpinLockAtDpcLevel(&DeviceExtension->SpinLock);
 
@@ -440,33 +440,125 @@ AhciCommandCompletionDpcRoutine (
     AdapterExtension = (PAHCI_ADAPTER_EXTENSION)HwDeviceExtension;
     PortExtension = (PAHCI_PORT_EXTENSION)SystemArgument1;
 
-    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
-    Srb = RemoveQueue(&PortExtension->CompletionQueue);
-    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+    // the DPC is queued once for any number of completions,
+    // so drain everything the interrupt handler has put in the queue
+    for (;;)
+    {
+        StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+        Srb = RemoveQueue(&PortExtension->CompletionQueue);
+        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
 
-    NT_ASSERT(Srb != NULL);
+        if (Srb == NULL)
+        {
+            break;
+        }
+
+        if (Srb->SrbStatus == SRB_STATUS_PENDING)
+        {
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        }
+        else
+        {
+            continue;
+        }
+
+        SrbExtension = GetSrbExtension(Srb);
+
+        CompletionRoutine = SrbExtension->CompletionRoutine;
+        NT_ASSERT(CompletionRoutine != NULL);
+
+        // now it's completion routine responsibility to set SrbStatus
+        CompletionRoutine(PortExtension, Srb);
+
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    }
+
+    return;
+}// -- AhciCommandCompletionDpcRoutine();
+
+/**
+ * @name AhciEnableCoalescing
+ * @implemented
+ *
+ * Program Command Completion Coalescing for all the active ports, so that
+ * their completions are signaled by one interrupt per CccCompletions
+ * commands or after CccTimeout ms.
+ *
+ * @param AdapterExtension
+ *
+ */
+VOID
+AhciEnableCoalescing (
+    __in PAHCI_ADAPTER_EXTENSION AdapterExtension
+    )
+{
+    ULONG index, ports;
+    AHCI_CCC_CONTROL ccc;
+    AHCI_INTERRUPT_ENABLE ie;
+    PAHCI_PORT_EXTENSION PortExtension;
+    PAHCI_MEMORY_REGISTERS abar;
 
-    if (Srb->SrbStatus == SRB_STATUS_PENDING)
+    AhciDebugPrint("AhciEnableCoalescing()\n");
+
+    if (!IsAdapterCAPSCCC(AdapterExtension->CAP) || (AdapterExtension->CccCompletions == 0))
     {
-        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return;
     }
-    else
+
+    abar = AdapterExtension->ABAR_Address;
+
+    ports = 0;
+    for (index = 0; index < AdapterExtension->PortCount; index++)
+    {
+        if ((AdapterExtension->PortImplemented & (0x1 << index)) != 0 &&
+            AdapterExtension->PortExtension[index].DeviceParams.IsActive)
+        {
+            ports |= (1 << index);
+        }
+    }
+
+    if (ports == 0)
     {
         return;
     }
 
-    SrbExtension = GetSrbExtension(Srb);
+    // section 3.1.6
+    // Software shall only change the contents of the TV and CC fields when EN is cleared to ‘0’
+    ccc.Status = StorPortReadRegisterUlong(AdapterExtension, &abar->CCC_CTL);
+    ccc.EN = 0;
+    StorPortWriteRegisterUlong(AdapterExtension, &abar->CCC_CTL, ccc.Status);
 
-    CompletionRoutine = SrbExtension->CompletionRoutine;
-    NT_ASSERT(CompletionRoutine != NULL);
+    ccc.CC = min(AdapterExtension->CccCompletions, 0xFF);
+    ccc.TV = max(min(AdapterExtension->CccTimeout, 0xFFFF), 1);
+    StorPortWriteRegisterUlong(AdapterExtension, &abar->CCC_CTL, ccc.Status);
+    StorPortWriteRegisterUlong(AdapterExtension, &abar->CCC_PTS, ports);
 
-    // now it's completion routine responsibility to set SrbStatus
-    CompletionRoutine(PortExtension, Srb);
+    ccc.EN = 1;
+    StorPortWriteRegisterUlong(AdapterExtension, &abar->CCC_CTL, ccc.Status);
 
-    StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    ccc.Status = StorPortReadRegisterUlong(AdapterExtension, &abar->CCC_CTL);
+    AdapterExtension->CccInterrupt = ccc.INT;
+    AdapterExtension->CccPorts = ports;
+    AdapterExtension->StateFlags.CccEnabled = 1;
+
+    AhciDebugPrint("\tCCC enabled for ports %x, CC %d, TV %d, INT %d\n", ports, ccc.CC, ccc.TV, ccc.INT);
+
+    // command completions of the coalesced ports are now signaled through
+    // the CCC interrupt, errors still raise the port interrupt
+    for (index = 0; index < AdapterExtension->PortCount; index++)
+    {
+        if ((ports & (1 << index)) != 0)
+        {
+            PortExtension = &AdapterExtension->PortExtension[index];
+            ie.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->IE);
+            ie.DHRE = 0;
+            ie.SDBE = 0;
+            StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IE, ie.Status);
+        }
+    }
 
     return;
-}// -- AhciCommandCompletionDpcRoutine();
+}// -- AhciEnableCoalescing();
 
 /**
  * @name AhciHwPassiveInitialize
@@ -502,6 +594,8 @@ AhciHwPassiveInitialize (
         }
     }
 
+    AhciEnableCoalescing(AdapterExtension);
+
     return TRUE;
 }// -- AhciHwPassiveInitialize();
 
@@ -563,7 +657,8 @@ AhciCompleteIssuedSrb (
     __in ULONG CommandsToComplete
     )
 {
-    ULONG NCS, i;
+    ULONG i;
+    BOOLEAN queueDpc;
     PSCSI_REQUEST_BLOCK Srb;
     PAHCI_SRB_EXTENSION SrbExtension;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
@@ -575,36 +670,44 @@ AhciCompleteIssuedSrb (
     AhciDebugPrint("\tCompleted Commands: %d\n", CommandsToComplete);
 
     AdapterExtension = PortExtension->AdapterExtension;
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+    queueDpc = FALSE;
 
-    for (i = 0; i < NCS; i++)
+    // only walk the slots that actually completed
+    while (BitScanForward(&i, CommandsToComplete))
     {
-        if (((1 << i) & CommandsToComplete) != 0)
+        CommandsToComplete &= ~(1 << i);
+
+        Srb = PortExtension->Slot[i];
+
+        if (Srb == NULL)
         {
-            Srb = PortExtension->Slot[i];
+            continue;
+        }
 
-            if (Srb == NULL)
-            {
-                continue;
-            }
+        PortExtension->Slot[i] = NULL;
 
-            SrbExtension = GetSrbExtension(Srb);
-            NT_ASSERT(SrbExtension != NULL);
+        SrbExtension = GetSrbExtension(Srb);
+        NT_ASSERT(SrbExtension != NULL);
 
-            if (SrbExtension->CompletionRoutine != NULL)
-            {
-                AddQueue(&PortExtension->CompletionQueue, Srb);
-                StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, Srb);
-            }
-            else
-            {
-                NT_ASSERT(Srb->SrbStatus == SRB_STATUS_PENDING);
-                Srb->SrbStatus = SRB_STATUS_SUCCESS;
-                StorPortNotification(RequestComplete, AdapterExtension, Srb);
-            }
+        if (SrbExtension->CompletionRoutine != NULL)
+        {
+            AddQueue(&PortExtension->CompletionQueue, Srb);
+            queueDpc = TRUE;
+        }
+        else
+        {
+            NT_ASSERT(Srb->SrbStatus == SRB_STATUS_PENDING);
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            StorPortNotification(RequestComplete, AdapterExtension, Srb);
         }
     }
 
+    // a single DPC run takes care of the whole batch
+    if (queueDpc)
+    {
+        StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, NULL);
+    }
+
     return;
 }// -- AhciCompleteIssuedSrb();
 
@@ -622,7 +725,7 @@ AhciInterruptHandler (
     __in PAHCI_PORT_EXTENSION PortExtension
     )
 {
-    ULONG is, ci, sact, outstanding;
+    ULONG is, ci, sact, outstanding, completed;
     AHCI_INTERRUPT_STATUS PxIS;
     AHCI_INTERRUPT_STATUS PxISMasked;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
@@ -693,10 +796,15 @@ AhciInterruptHandler (
     sact = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->SACT);
 
     outstanding = ci | sact; // NOTE: Including both non-NCQ and NCQ based commands
-    if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+    completed = PortExtension->CommandIssuedSlots & (~outstanding);
+    if (completed != 0)
     {
-        AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
+        AhciCompleteIssuedSrb(PortExtension, completed);
         PortExtension->CommandIssuedSlots &= outstanding;
+        PortExtension->NcqSlots &= ~completed;
+
+        // the freed slots can take the Srbs still waiting in the queue
+        AhciStartQueuedSrbs(PortExtension);
     }
 
     return;
@@ -720,8 +828,9 @@ AhciHwInterrupt (
     __in PVOID DeviceExtension
     )
 {
+    BOOLEAN handled;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
-    ULONG portPending, nextPort, i, portCount;
+    ULONG portPending, nextPort, lastPort, i, portCount;
 
     AdapterExtension = (PAHCI_ADAPTER_EXTENSION)DeviceExtension;
 
@@ -731,6 +840,18 @@ AhciHwInterrupt (
     }
 
     portPending = StorPortReadRegisterUlong(AdapterExtension, AdapterExtension->IS);
+    handled = FALSE;
+
+    // section 11.2
+    // Coalesced completions are signaled through their own IS bit, and then any of the
+    // coalesced ports may have commands to retire
+    if (AdapterExtension->StateFlags.CccEnabled &&
+        ((portPending & (1 << AdapterExtension->CccInterrupt)) != 0))
+    {
+        StorPortWriteRegisterUlong(AdapterExtension, AdapterExtension->IS, (1 << AdapterExtension->CccInterrupt));
+        portPending |= AdapterExtension->CccPorts;
+        handled = TRUE;
+    }
 
     // we process interrupt for implemented ports only
     portCount = AdapterExtension->PortCount;
@@ -738,12 +859,15 @@ AhciHwInterrupt (
 
     if (portPending == 0)
     {
-        return FALSE;
+        return handled;
     }
 
+    // harvest every pending port in this interrupt, starting after
+    // the last serviced one so that no port gets starved
+    lastPort = AdapterExtension->LastInterruptPort;
     for (i = 1; i <= portCount; i++)
     {
-        nextPort = (AdapterExtension->LastInterruptPort + i) % portCount;
+        nextPort = (lastPort + i) % portCount;
         if ((portPending & (0x1 << nextPort)) == 0)
             continue;
 
@@ -754,19 +878,17 @@ AhciHwInterrupt (
             continue;
         }
 
-        // we can assign this interrupt to this port
         AdapterExtension->LastInterruptPort = nextPort;
         AhciInterruptHandler(&AdapterExtension->PortExtension[nextPort]);
+        handled = TRUE;
+    }
 
-        portPending &= ~(1 << nextPort);
-
-        // interrupt belongs to this device
-        // should always return TRUE
-        return TRUE;
+    if (!handled)
+    {
+        AhciDebugPrint("\tSomething went wrong");
     }
 
-    AhciDebugPrint("\tSomething went wrong");
-    return FALSE;
+    return handled;
 }// -- AhciHwInterrupt();
 
 /**
@@ -1009,13 +1131,23 @@ AhciHwFindAdapter (
 
     UNREFERENCED_PARAMETER(HwContext);
     UNREFERENCED_PARAMETER(BusInformation);
-    UNREFERENCED_PARAMETER(ArgumentString);
     UNREFERENCED_PARAMETER(Reserved3);
 
     adapterExtension = DeviceExtension;
     adapterExtension->SlotNumber = ConfigInfo->SlotNumber;
     adapterExtension->SystemIoBusNumber = ConfigInfo->SystemIoBusNumber;
 
+    // Command Completion Coalescing settings
+    if (!AhciParseArgumentString(ArgumentString, "CccCompletions", &adapterExtension->CccCompletions))
+    {
+        adapterExtension->CccCompletions = AHCI_CCC_DEFAULT_COMPLETIONS;
+    }
+
+    if (!AhciParseArgumentString(ArgumentString, "CccTimeout", &adapterExtension->CccTimeout))
+    {
+        adapterExtension->CccTimeout = AHCI_CCC_DEFAULT_TIMEOUT;
+    }
+
     // get PCI configuration header
     pci_cfg_len = StorPortGetBusData(
                         adapterExtension,
@@ -1403,6 +1535,13 @@ AhciProcessSrb (
     NT_ASSERT(SlotIndex < AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
     SrbExtension->SlotIndex = SlotIndex;
 
+    if (IsNcqCommand(SrbExtension))
+    {
+        // the slot is the NCQ tag, it goes in Sector Count 7:3
+        NT_ASSERT(SlotIndex < PortExtension->MaxPortQueueDepth);
+        SrbExtension->SectorCountLow = (UCHAR)(SlotIndex << 3);
+    }
+
     // program the CFIS in the CommandTable
     CommandHeader = &PortExtension->CommandList[SlotIndex];
 
@@ -1480,19 +1619,13 @@ AhciProcessSrb (
  * @param PortExtension
  *
  */
-
-#ifdef _MSC_VER     // avoid MSVC C4700
-    #pragma warning(push)
-    #pragma warning(disable: 4700)
-#endif
-
 VOID
 AhciActivatePort (
     __in PAHCI_PORT_EXTENSION PortExtension
     )
 {
     AHCI_PORT_CMD cmd;
-    ULONG QueueSlots, slotToActivate, tmp;
+    ULONG QueueSlots, NcqSlots;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
 
     AhciDebugPrint("AhciActivatePort()\n");
@@ -1514,30 +1647,97 @@ AhciActivatePort (
         return;
     }
 
-    // get the lowest set bit
-    tmp = QueueSlots & (QueueSlots - 1);
-
-    if (tmp == 0)
-        slotToActivate = QueueSlots;
-    else
-        slotToActivate = (QueueSlots & (~tmp));
+    // section 3.3.13
+    // This field is bit significant. Each bit corresponds to the TAG and command slot of a native queued
+    // command, where bit 0 corresponds to TAG 0 and command slot 0. This field is set by software prior
+    // to issuing a native queued command for a particular command slot.
+    NcqSlots = QueueSlots & PortExtension->NcqSlots;
+    if (NcqSlots != 0)
+    {
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SACT, NcqSlots);
+    }
 
-    // mark that bit off in QueueSlots
-    // so we can know we it is really needed to activate port or not
-    PortExtension->QueueSlots &= ~slotToActivate;
+    // all the assigned slots are issued at once
+    PortExtension->QueueSlots = 0;
     // mark this CommandIssuedSlots
     // to validate in completeIssuedCommand
-    PortExtension->CommandIssuedSlots |= slotToActivate;
+    PortExtension->CommandIssuedSlots |= QueueSlots;
 
-    // tell the HBA to issue this Command Slot to the given port
-    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotToActivate);
+    // tell the HBA to issue these Command Slots to the given port
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, QueueSlots);
 
     return;
 }// -- AhciActivatePort();
 
-#ifdef _MSC_VER     // avoid MSVC C4700
-    #pragma warning(pop)
-#endif
+/**
+ * @name AhciStartQueuedSrbs
+ * @implemented
+ *
+ * Populate free command slots with pending commands and program
+ * controller's port to process them. InterruptLock must be held.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciStartQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    BOOLEAN isNcq;
+    PSCSI_REQUEST_BLOCK tmpSrb;
+    PAHCI_SRB_EXTENSION SrbExtension;
+    ULONG occupiedSlots, slotIndex;
+
+    AhciDebugPrint("AhciStartQueuedSrbs()\n");
+
+    if (PortExtension->DeviceParams.IsActive == FALSE)
+    {
+        return; // we should wait for device to get active
+    }
+
+    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
+
+    // iterate over HBA port slots, not past the queue depth so that
+    // every slot index is also a valid NCQ tag for the device
+    for (slotIndex = 0; slotIndex < PortExtension->MaxPortQueueDepth; slotIndex++)
+    {
+        if ((occupiedSlots & (1 << slotIndex)) != 0)
+        {
+            continue;
+        }
+
+        tmpSrb = PeekQueue(&PortExtension->SrbQueue);
+        if (tmpSrb == NULL)
+        {
+            break;
+        }
+
+        // native queued and non-queued commands can't be outstanding at the same time,
+        // so let the port drain before switching from one kind to the other
+        SrbExtension = GetSrbExtension(tmpSrb);
+        isNcq = IsNcqCommand(SrbExtension) ? TRUE : FALSE;
+        if ((occupiedSlots != 0) && (isNcq != (PortExtension->NcqSlots != 0)))
+        {
+            break;
+        }
+
+        RemoveQueue(&PortExtension->SrbQueue);
+        NT_ASSERT(tmpSrb->PathId == PortExtension->PortNumber);
+        AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
+
+        occupiedSlots |= (1 << slotIndex);
+        if (isNcq)
+        {
+            PortExtension->NcqSlots |= (1 << slotIndex);
+        }
+    }
+
+    // program HBA port
+    AhciActivatePort(PortExtension);
+
+    return;
+}// -- AhciStartQueuedSrbs();
 
 /**
  * @name AhciProcessIO
@@ -1558,10 +1758,8 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     )
 {
-    PSCSI_REQUEST_BLOCK tmpSrb;
     STOR_LOCK_HANDLE lockhandle = {0};
     PAHCI_PORT_EXTENSION PortExtension;
-    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
 
     AhciDebugPrint("AhciProcessIO()\n");
     AhciDebugPrint("\tPathId: %d\n", PathId);
@@ -1576,46 +1774,7 @@ AhciProcessIO (
     // add Srb to queue
     AddQueue(&PortExtension->SrbQueue, Srb);
 
-    if (PortExtension->DeviceParams.IsActive == FALSE)
-    {
-        // Release Lock
-        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
-        return; // we should wait for device to get active
-    }
-
-    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
-    commandSlotMask = (1 << NCS) - 1; // available slots mask
-
-    commandSlotMask = (commandSlotMask & ~occupiedSlots);
-    if(commandSlotMask != 0)
-    {
-        // iterate over HBA port slots
-        for (slotIndex = 0; slotIndex < NCS; slotIndex++)
-        {
-            // find first free slot
-            if ((commandSlotMask & (1 << slotIndex)) != 0)
-            {
-                tmpSrb = RemoveQueue(&PortExtension->SrbQueue);
-                if (tmpSrb != NULL)
-                {
-                    NT_ASSERT(tmpSrb->PathId == PathId);
-                    AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
-
-    // program HBA port
-    AhciActivatePort(PortExtension);
+    AhciStartQueuedSrbs(PortExtension);
 
     // Release Lock
     StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
@@ -1735,6 +1894,25 @@ InquiryCompletion (
             PortExtension->DeviceParams.Lba48BitMode = 1;
         }
 
+        // Native Command Queuing needs support from both the HBA and the device,
+        // FPDMA QUEUED commands always carry a 48-bit LBA
+        if (IsAdapterCAPSNCQ(AdapterExtension->CAP) &&
+            PortExtension->DeviceParams.Lba48BitMode &&
+            (IdentifyDeviceData->ReservedWords76[0] & IDENTIFY_SATA_CAPABILITIES_NCQ))
+        {
+            PortExtension->DeviceParams.NcqEnabled = 1;
+
+            // QueueDepth is 0's based
+            PortExtension->MaxPortQueueDepth = min(AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP),
+                                                   IdentifyDeviceData->QueueDepth + 1U);
+            AhciDebugPrint("\tNCQ enabled, depth %d\n", PortExtension->MaxPortQueueDepth);
+        }
+        else
+        {
+            PortExtension->DeviceParams.NcqEnabled = 0;
+            PortExtension->MaxPortQueueDepth = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+        }
+
         PortExtension->DeviceParams.AccessType = DIRECT_ACCESS_DEVICE;
 
         /* Device max address lba */
@@ -1798,7 +1976,7 @@ InquiryCompletion (
     // prepare data to send
     InquiryData->Versions = 2;
     InquiryData->Wide32Bit = 1;
-    InquiryData->CommandQueue = 0; // NCQ not supported
+    InquiryData->CommandQueue = PortExtension->DeviceParams.NcqEnabled;
     InquiryData->ResponseDataFormat = 0x2;
     InquiryData->DeviceTypeModifier = 0;
     InquiryData->DeviceTypeQualifier = DEVICE_CONNECTED;
@@ -1820,7 +1998,7 @@ InquiryCompletion (
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
-                                         AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+                                         PortExtension->MaxPortQueueDepth);
 
     NT_ASSERT(status == TRUE);
     return;
@@ -2028,8 +2206,44 @@ DeviceRequestReadWrite (
 
     SrbExtension->AtaFunction = ATA_FUNCTION_ATA_READ;
     SrbExtension->Flags |= ATA_FLAGS_USE_DMA;
+    SrbExtension->Flags &= ~ATA_FLAGS_USE_NCQ;
     SrbExtension->CompletionRoutine = NULL;
 
+    if (PortExtension->DeviceParams.NcqEnabled)
+    {
+        // ATA8-ACS 7.21 READ FPDMA QUEUED, 7.61 WRITE FPDMA QUEUED
+        // The sector count moves to the Features register, the Sector Count register
+        // holds the tag, which is filled in by AhciProcessSrb once a slot is assigned
+        SrbExtension->Flags |= ATA_FLAGS_USE_NCQ | ATA_FLAGS_48BIT_COMMAND;
+
+        if (IsReading)
+        {
+            SrbExtension->Flags |= ATA_FLAGS_DATA_IN;
+            SrbExtension->CommandReg = IDE_COMMAND_READ_FPDMA_QUEUED;
+        }
+        else
+        {
+            SrbExtension->Flags |= ATA_FLAGS_DATA_OUT;
+            SrbExtension->CommandReg = IDE_COMMAND_WRITE_FPDMA_QUEUED;
+        }
+
+        SrbExtension->FeaturesLow = (SectorCount >> 0) & 0xFF;
+        SrbExtension->FeaturesHigh = (SectorCount >> 8) & 0xFF;
+        SrbExtension->LBA0 = (StartOffset >> 0) & 0xFF;
+        SrbExtension->LBA1 = (StartOffset >> 8) & 0xFF;
+        SrbExtension->LBA2 = (StartOffset >> 16) & 0xFF;
+        SrbExtension->LBA3 = (StartOffset >> 24) & 0xFF;
+        SrbExtension->LBA4 = (StartOffset >> 32) & 0xFF;
+        SrbExtension->LBA5 = (StartOffset >> 40) & 0xFF;
+        SrbExtension->Device = IDE_LBA_MODE;
+        SrbExtension->SectorCountLow = 0;
+        SrbExtension->SectorCountHigh = 0;
+
+        SrbExtension->pSgl = (PLOCAL_SCATTER_GATHER_LIST)StorPortGetScatterGatherList(AdapterExtension, Srb);
+
+        return SRB_STATUS_PENDING;
+    }
+
     if (IsReading)
     {
         SrbExtension->Flags |= ATA_FLAGS_DATA_IN;
@@ -2547,6 +2761,33 @@ RemoveQueue (
     return Srb;
 }// -- RemoveQueue();
 
+/**
+ * @name PeekQueue
+ * @implemented
+ *
+ * Return Srb at the front of Queue without removing it
+ *
+ * @param Queue
+ *
+ * @return
+ * return Srb
+ *
+ */
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    )
+{
+    NT_ASSERT(Queue->Head < MAXIMUM_QUEUE_BUFFER_SIZE);
+    NT_ASSERT(Queue->Tail < MAXIMUM_QUEUE_BUFFER_SIZE);
+
+    if (Queue->Head == Queue->Tail)
+        return NULL;
+
+    return Queue->Buffer[Queue->Tail];
+}// -- PeekQueue();
+
 /**
  * @name GetSrbExtension
  * @implemented
@@ -2615,4 +2856,94 @@ AhciGetLba (
     }
 
     return lba;
-}// -- AhciGetLba();
\ No newline at end of file
+}// -- AhciGetLba();
+
+/**
+ * @name AhciParseArgumentString
+ * @implemented
+ *
+ * Find the decimal value of KeyWord in the "KeyWord=Value;..." ArgumentString
+ *
+ * @param ArgumentString
+ * @param KeyWord
+ * @param Value
+ *
+ * @return
+ * return TRUE if KeyWord was found with a valid value
+ *
+ */
+BOOLEAN
+AhciParseArgumentString (
+    __in_opt PCHAR ArgumentString,
+    __in PCHAR KeyWord,
+    __out PULONG Value
+    )
+{
+    PCHAR cptr, kptr;
+    ULONG value;
+
+    if (ArgumentString == NULL)
+    {
+        return FALSE;
+    }
+
+#define AhciUpcase(c) ((((c) >= 'a') && ((c) <= 'z')) ? ((c) - 'a' + 'A') : (c))
+
+    cptr = ArgumentString;
+    while (*cptr != '\0')
+    {
+        // skip white space and separators
+        while ((*cptr == ' ') || (*cptr == '\t') || (*cptr == ';'))
+        {
+            cptr++;
+        }
+
+        // keywords are case insensitive
+        kptr = KeyWord;
+        while ((*kptr != '\0') && (AhciUpcase(*cptr) == AhciUpcase(*kptr)))
+        {
+            cptr++;
+            kptr++;
+        }
+
+        if (*kptr == '\0')
+        {
+            while ((*cptr == ' ') || (*cptr == '\t'))
+            {
+                cptr++;
+            }
+
+            if (*cptr == '=')
+            {
+                cptr++;
+                while ((*cptr == ' ') || (*cptr == '\t'))
+                {
+                    cptr++;
+                }
+
+                if ((*cptr >= '0') && (*cptr <= '9'))
+                {
+                    value = 0;
+                    while ((*cptr >= '0') && (*cptr <= '9'))
+                    {
+                        value = (value * 10) + (*cptr - '0');
+                        cptr++;
+                    }
+
+                    *Value = value;
+                    return TRUE;
+                }
+            }
+        }
+
+        // not this one, move to the next keyword
+        while ((*cptr != '\0') && (*cptr != ';'))
+        {
+            cptr++;
+        }
+    }
+
+#undef AhciUpcase
+
+    return FALSE;
+}// -- AhciParseArgumentString();
@@ -20,10 +20,15 @@
 
 #define MAXIMUM_AHCI_PORT_COUNT             32
 #define MAXIMUM_AHCI_PRDT_ENTRIES           32
-#define MAXIMUM_AHCI_PORT_NCS               30
+#define MAXIMUM_AHCI_PORT_NCS               32
 #define MAXIMUM_QUEUE_BUFFER_SIZE           255
 #define MAXIMUM_TRANSFER_LENGTH             (128*1024) // 128 KB
 
+// Command Completion Coalescing, can be set through the DriverParameter string.
+// i.e. "CccCompletions=8;CccTimeout=1", CccCompletions=0 leaves it disabled
+#define AHCI_CCC_DEFAULT_COMPLETIONS        0
+#define AHCI_CCC_DEFAULT_TIMEOUT            1 // ms
+
 #define DEVICE_ATA_BLOCK_SIZE               512
 
 // device type (DeviceParams)
@@ -33,6 +38,15 @@
 
 // section 3.1.2
 #define AHCI_Global_HBA_CAP_S64A            (1 << 31)
+#define AHCI_Global_HBA_CAP_SNCQ            (1 << 30)
+#define AHCI_Global_HBA_CAP_CCCS            (1 << 7)
+
+// ATA8-ACS 7.21, 7.61 -- Native Command Queuing
+#define IDE_COMMAND_READ_FPDMA_QUEUED       0x60
+#define IDE_COMMAND_WRITE_FPDMA_QUEUED      0x61
+
+// IDENTIFY DEVICE word 76 -- Serial ATA capabilities
+#define IDENTIFY_SATA_CAPABILITIES_NCQ      (1 << 8)
 
 // FIS Types : http://wiki.osdev.org/AHCI
 #define FIS_TYPE_REG_H2D        0x27 // Register FIS - host to device
@@ -71,14 +85,19 @@
 #define ATA_FLAGS_DATA_OUT                  (1 << 2)
 #define ATA_FLAGS_48BIT_COMMAND             (1 << 3)
 #define ATA_FLAGS_USE_DMA                   (1 << 4)
+#define ATA_FLAGS_USE_NCQ                   (1 << 5)
 
 #define IsAtaCommand(AtaFunction)           (AtaFunction & ATA_FUNCTION_ATA_COMMAND)
 #define IsAtapiCommand(AtaFunction)         (AtaFunction & ATA_FUNCTION_ATAPI_COMMAND)
 #define IsDataTransferNeeded(SrbExtension)  (SrbExtension->Flags & (ATA_FLAGS_DATA_IN | ATA_FLAGS_DATA_OUT))
 #define IsAdapterCAPS64(CAP)                (CAP & AHCI_Global_HBA_CAP_S64A)
+#define IsAdapterCAPSNCQ(CAP)               (CAP & AHCI_Global_HBA_CAP_SNCQ)
+#define IsAdapterCAPSCCC(CAP)               (CAP & AHCI_Global_HBA_CAP_CCCS)
+#define IsNcqCommand(SrbExtension)          (SrbExtension->Flags & ATA_FLAGS_USE_NCQ)
 
 // 3.1.1 NCS = CAP[12:08] -> Align
-#define AHCI_Global_Port_CAP_NCS(x)         (((x) & 0xF00) >> 8)
+// 0's based value, so this returns the actual number of command slots
+#define AHCI_Global_Port_CAP_NCS(x)         ((((x) & 0x1F00) >> 8) + 1)
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 //#define AhciDebugPrint(format, ...) StorPortDebugPrint(0, format, __VA_ARGS__)
@@ -247,6 +266,21 @@ typedef union _AHCI_COMMAND_HEADER_DESCRIPTION
     ULONG Status;
 } AHCI_COMMAND_HEADER_DESCRIPTION;
 
+// section 3.1.6
+typedef union _AHCI_CCC_CONTROL
+{
+    struct
+    {
+        ULONG EN : 1;        // Enable
+        ULONG RSV0 : 2;
+        ULONG INT : 5;       // Interrupt, IS bit used for CCC (read only)
+        ULONG CC : 8;        // Command Completions
+        ULONG TV : 16;       // Timeout Value, in ms
+    };
+
+    ULONG Status;
+} AHCI_CCC_CONTROL;
+
 typedef union _AHCI_GHC
 {
     struct
@@ -464,7 +498,8 @@ typedef struct _AHCI_PORT_EXTENSION
     ULONG PortNumber;
     ULONG QueueSlots;                                   // slots which we have already assigned task (Slot)
     ULONG CommandIssuedSlots;                           // slots which has been programmed
-    ULONG MaxPortQueueDepth;
+    ULONG NcqSlots;                                     // assigned or programmed slots holding FPDMA QUEUED commands
+    ULONG MaxPortQueueDepth;                            // slots usable on this port, also the NCQ tag limit
 
     struct
     {
@@ -473,6 +508,7 @@ typedef struct _AHCI_PORT_EXTENSION
         UCHAR AccessType;
         UCHAR DeviceType;
         UCHAR IsActive;
+        UCHAR NcqEnabled;
         LARGE_INTEGER MaxLba;
         ULONG BytesPerLogicalSector;
         ULONG BytesPerPhysicalSector;
@@ -514,6 +550,11 @@ typedef struct _AHCI_ADAPTER_EXTENSION
     ULONG   LastInterruptPort;
     ULONG   CurrentCommandSlot;
 
+    ULONG   CccCompletions;// completions to coalesce in one interrupt, 0 to disable
+    ULONG   CccTimeout;// ms to wait before interrupting with less completions
+    ULONG   CccInterrupt;// IS bit the HBA uses for coalesced completions
+    ULONG   CccPorts;// bit-mapping of ports with coalesced completions
+
     PVOID NonCachedExtension; // holds virtual address to noncached buffer allocated for Port Extension
 
     struct
@@ -521,7 +562,8 @@ typedef struct _AHCI_ADAPTER_EXTENSION
         // Message per port or shared port?
         ULONG MessagePerPort : 1;
         ULONG Removed : 1;
-        ULONG Reserved : 30; // not in use -- maintain 4 byte alignment
+        ULONG CccEnabled : 1;
+        ULONG Reserved : 29; // not in use -- maintain 4 byte alignment
     } StateFlags;
 
     PAHCI_MEMORY_REGISTERS ABAR_Address;
@@ -576,6 +618,16 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     );
 
+VOID
+AhciStartQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    );
+
+VOID
+AhciEnableCoalescing (
+    __in PAHCI_ADAPTER_EXTENSION AdapterExtension
+    );
+
 BOOLEAN
 AhciAdapterReset (
     __in PAHCI_ADAPTER_EXTENSION AdapterExtension
@@ -645,6 +697,12 @@ RemoveQueue (
     __inout PAHCI_QUEUE Queue
     );
 
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    );
+
 __inline
 PAHCI_SRB_EXTENSION
 GetSrbExtension(
@@ -658,6 +716,13 @@ AhciGetLba (
     __in ULONG CdbLength
     );
 
+BOOLEAN
+AhciParseArgumentString (
+    __in_opt PCHAR ArgumentString,
+    __in PCHAR KeyWord,
+    __out PULONG Value
+    );
+
 //////////////////////////////////////////////////////////////
 //                       Assertions                         //
 //////////////////////////////////////////////////////////////
@@ -704,6 +769,7 @@ C_ASSERT(FIELD_OFFSET(AHCI_PORT, Vendor) == 0x70);
 C_ASSERT((sizeof(AHCI_COMMAND_TABLE) % 128) == 0);
 
 C_ASSERT(sizeof(AHCI_GHC)                        == sizeof(ULONG));
+C_ASSERT(sizeof(AHCI_CCC_CONTROL)                == sizeof(ULONG));
 C_ASSERT(sizeof(AHCI_PORT_CMD)                   == sizeof(ULONG));
 C_ASSERT(sizeof(AHCI_TASK_FILE_DATA)             == sizeof(ULONG));
 C_ASSERT(sizeof(AHCI_INTERRUPT_ENABLE)           == sizeof(ULONG));
@@ -0,0 +1,1125 @@
+/*
+ * PROJECT:     ReactOS NVMe Storport Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     NVMe controller support with a submission/completion queue pair per processor
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "stornvme.h"
+
+#define NDEBUG
+#include <debug.h>
+
+
+/* FUNCTIONS ******************************************************************/
+
+static
+ULONGLONG
+NvmeReadCapabilities(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension)
+{
+    ULONG Low, High;
+
+    Low = StorPortReadRegisterUlong(AdapterExtension, &AdapterExtension->Registers->CapLow);
+    High = StorPortReadRegisterUlong(AdapterExtension, &AdapterExtension->Registers->CapHigh);
+
+    return ((ULONGLONG)High << 32) | Low;
+}
+
+
+static
+BOOLEAN
+NvmeWaitForReady(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ BOOLEAN Ready)
+{
+    ULONG Status;
+    ULONG Waited;
+
+    for (Waited = 0; Waited < AdapterExtension->ReadyTimeoutMs; Waited++)
+    {
+        Status = StorPortReadRegisterUlong(AdapterExtension, &AdapterExtension->Registers->Status);
+        if (Status & NVME_CSTS_FATAL)
+        {
+            DPRINT1("Controller fatal status\n");
+            return FALSE;
+        }
+
+        if (!!(Status & NVME_CSTS_READY) == Ready)
+            return TRUE;
+
+        StorPortStallExecution(1000);
+    }
+
+    DPRINT1("Timeout waiting for CSTS.RDY == %u\n", Ready);
+    return FALSE;
+}
+
+
+static
+VOID
+NvmeInitializeQueue(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PNVME_QUEUE Queue,
+    _In_ USHORT QueueId,
+    _In_ USHORT Depth,
+    _Inout_ PULONG Offset)
+{
+    PUCHAR Doorbells;
+    ULONG Length;
+
+    Queue->QueueId = QueueId;
+    Queue->Depth = Depth;
+    Queue->SqTail = 0;
+    Queue->SqHead = 0;
+    Queue->CqHead = 0;
+    Queue->Phase = NVME_STATUS_PHASE;
+    Queue->NextCommandId = 0;
+    Queue->Outstanding = 0;
+
+    /* Both rings start on a page of their own */
+    Queue->SubmissionQueue = (PNVME_COMMAND)(AdapterExtension->UncachedExtension + *Offset);
+    *Offset += ROUND_TO_PAGES(Depth * sizeof(NVME_COMMAND));
+    Queue->CompletionQueue = (PNVME_COMPLETION)(AdapterExtension->UncachedExtension + *Offset);
+    *Offset += ROUND_TO_PAGES(Depth * sizeof(NVME_COMPLETION));
+
+    Queue->SubmissionQueuePhysical = StorPortGetPhysicalAddress(AdapterExtension,
+                                                                NULL,
+                                                                Queue->SubmissionQueue,
+                                                                &Length);
+    Queue->CompletionQueuePhysical = StorPortGetPhysicalAddress(AdapterExtension,
+                                                                NULL,
+                                                                Queue->CompletionQueue,
+                                                                &Length);
+
+    StorPortZeroMemory(Queue->SubmissionQueue, Depth * sizeof(NVME_COMMAND));
+    StorPortZeroMemory(Queue->CompletionQueue, Depth * sizeof(NVME_COMPLETION));
+    StorPortZeroMemory(Queue->Requests, sizeof(Queue->Requests));
+
+    Doorbells = (PUCHAR)AdapterExtension->Registers + NVME_DOORBELL_OFFSET;
+    Queue->SubmissionDoorbell = (PULONG)(Doorbells + (2 * QueueId) * AdapterExtension->DoorbellStride);
+    Queue->CompletionDoorbell = (PULONG)(Doorbells + (2 * QueueId + 1) * AdapterExtension->DoorbellStride);
+}
+
+
+/* Called with the queue lock held (or before interrupts are enabled) */
+static
+BOOLEAN
+NvmeSubmitCommand(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PNVME_QUEUE Queue,
+    _In_ PNVME_COMMAND Command)
+{
+    USHORT NextTail;
+
+    NextTail = (Queue->SqTail + 1) % Queue->Depth;
+    if (NextTail == Queue->SqHead)
+        return FALSE;
+
+    StorPortMoveMemory(&Queue->SubmissionQueue[Queue->SqTail], Command, sizeof(NVME_COMMAND));
+    Queue->SqTail = NextTail;
+
+    StorPortWriteRegisterUlong(AdapterExtension, Queue->SubmissionDoorbell, Queue->SqTail);
+    return TRUE;
+}
+
+
+static
+BOOLEAN
+NvmeCompletionPending(
+    _In_ PNVME_QUEUE Queue)
+{
+    return (Queue->CompletionQueue[Queue->CqHead].Status & NVME_STATUS_PHASE) == Queue->Phase;
+}
+
+
+static
+VOID
+NvmeConsumeCompletion(
+    _In_ PNVME_QUEUE Queue,
+    _Out_ PNVME_COMPLETION Completion)
+{
+    *Completion = Queue->CompletionQueue[Queue->CqHead];
+    Queue->SqHead = Completion->SqHead;
+
+    Queue->CqHead++;
+    if (Queue->CqHead == Queue->Depth)
+    {
+        Queue->CqHead = 0;
+        Queue->Phase ^= NVME_STATUS_PHASE;
+    }
+}
+
+
+static
+BOOLEAN
+NvmeAdminCommand(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _Inout_ PNVME_COMMAND Command,
+    _Out_opt_ PULONG Result)
+{
+    PNVME_QUEUE Queue = &AdapterExtension->AdminQueue;
+    NVME_COMPLETION Completion;
+    ULONG Waited;
+
+    Command->CommandId = Queue->NextCommandId++;
+
+    if (!NvmeSubmitCommand(AdapterExtension, Queue, Command))
+        return FALSE;
+
+    /* Admin commands are only sent during initialization, poll for them */
+    for (Waited = 0; Waited < NVME_ADMIN_TIMEOUT_US; Waited += NVME_POLL_INTERVAL_US)
+    {
+        if (NvmeCompletionPending(Queue))
+        {
+            NvmeConsumeCompletion(Queue, &Completion);
+            StorPortWriteRegisterUlong(AdapterExtension, Queue->CompletionDoorbell, Queue->CqHead);
+
+            if (Completion.CommandId != Command->CommandId)
+                continue;
+
+            if (Result != NULL)
+                *Result = Completion.Result;
+
+            if (NVME_STATUS_CODE(Completion.Status) != 0)
+            {
+                DPRINT1("Admin command 0x%02x failed with status 0x%03x\n",
+                        Command->Opcode, NVME_STATUS_CODE(Completion.Status));
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+
+        StorPortStallExecution(NVME_POLL_INTERVAL_US);
+    }
+
+    DPRINT1("Admin command 0x%02x timed out\n", Command->Opcode);
+    return FALSE;
+}
+
+
+static
+BOOLEAN
+NvmeIdentify(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension)
+{
+    PNVME_IDENTIFY_NAMESPACE Namespace = AdapterExtension->IdentifyNamespace;
+    NVME_COMMAND Command;
+    ULONG Format;
+
+    StorPortZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_IDENTIFY;
+    Command.Prp1 = AdapterExtension->IdentifyControllerPhysical.QuadPart;
+    Command.Cdw10 = NVME_IDENTIFY_CONTROLLER;
+    if (!NvmeAdminCommand(AdapterExtension, &Command, NULL))
+        return FALSE;
+
+    if (AdapterExtension->IdentifyController->NumberOfNamespaces == 0)
+    {
+        DPRINT1("The controller has no namespace\n");
+        return FALSE;
+    }
+
+    /* Namespace 1 is exposed as the only logical unit */
+    StorPortZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_IDENTIFY;
+    Command.NamespaceId = 1;
+    Command.Prp1 = AdapterExtension->IdentifyNamespacePhysical.QuadPart;
+    Command.Cdw10 = NVME_IDENTIFY_NAMESPACE;
+    if (!NvmeAdminCommand(AdapterExtension, &Command, NULL))
+        return FALSE;
+
+    Format = Namespace->FormattedLbaSize & 0xF;
+    AdapterExtension->BlockShift = Namespace->LbaFormats[Format].DataSizeShift;
+    if (AdapterExtension->BlockShift < 9 || AdapterExtension->BlockShift > 12)
+    {
+        DPRINT1("Unsupported block size shift %lu\n", AdapterExtension->BlockShift);
+        return FALSE;
+    }
+
+    AdapterExtension->BlockSize = 1 << AdapterExtension->BlockShift;
+    AdapterExtension->NamespaceBlocks = Namespace->Size;
+
+    DPRINT1("Namespace 1: %I64u blocks of %lu bytes\n",
+            AdapterExtension->NamespaceBlocks, AdapterExtension->BlockSize);
+
+    return TRUE;
+}
+
+
+static
+BOOLEAN
+NvmeCreateIoQueues(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension)
+{
+    PNVME_QUEUE Queue;
+    NVME_COMMAND Command;
+    ULONG Granted;
+    ULONG i;
+
+    /* Ask for one queue pair per processor */
+    StorPortZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_SET_FEATURES;
+    Command.Cdw10 = NVME_FEATURE_NUMBER_OF_QUEUES;
+    Command.Cdw11 = ((AdapterExtension->IoQueueCount - 1) << 16) | (AdapterExtension->IoQueueCount - 1);
+    if (!NvmeAdminCommand(AdapterExtension, &Command, &Granted))
+        return FALSE;
+
+    Granted = min((Granted & 0xFFFF), (Granted >> 16)) + 1;
+    if (Granted < AdapterExtension->IoQueueCount)
+        AdapterExtension->IoQueueCount = Granted;
+
+    for (i = 0; i < AdapterExtension->IoQueueCount; i++)
+    {
+        Queue = &AdapterExtension->IoQueues[i];
+
+        /* Physically contiguous completion queue on interrupt vector 0 */
+        StorPortZeroMemory(&Command, sizeof(Command));
+        Command.Opcode = NVME_ADMIN_CREATE_IO_CQ;
+        Command.Prp1 = Queue->CompletionQueuePhysical.QuadPart;
+        Command.Cdw10 = ((ULONG)(Queue->Depth - 1) << 16) | Queue->QueueId;
+        Command.Cdw11 = 0x3;
+        if (!NvmeAdminCommand(AdapterExtension, &Command, NULL))
+            break;
+
+        StorPortZeroMemory(&Command, sizeof(Command));
+        Command.Opcode = NVME_ADMIN_CREATE_IO_SQ;
+        Command.Prp1 = Queue->SubmissionQueuePhysical.QuadPart;
+        Command.Cdw10 = ((ULONG)(Queue->Depth - 1) << 16) | Queue->QueueId;
+        Command.Cdw11 = ((ULONG)Queue->QueueId << 16) | 0x1;
+        if (!NvmeAdminCommand(AdapterExtension, &Command, NULL))
+            break;
+    }
+
+    /* Go on with what we got */
+    AdapterExtension->IoQueueCount = i;
+    DPRINT1("Created %lu I/O queue pairs\n", i);
+
+    return (i != 0);
+}
+
+
+static
+PNVME_QUEUE
+NvmeGetSubmissionQueue(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    STARTIO_PERFORMANCE_PARAMETERS Params;
+
+    /* Storport tells us the channel of the processor issuing the request */
+    StorPortZeroMemory(&Params, sizeof(Params));
+    Params.Version = STOR_PERF_VERSION;
+    Params.Size = sizeof(Params);
+    if (StorPortGetStartIoPerfParams(AdapterExtension, Srb, &Params) != STOR_STATUS_SUCCESS)
+        Params.ChannelNumber = 0;
+
+    return &AdapterExtension->IoQueues[Params.ChannelNumber % AdapterExtension->IoQueueCount];
+}
+
+
+static
+BOOLEAN
+NvmeBuildPrps(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Inout_ PNVME_COMMAND Command)
+{
+    PSTOR_SCATTER_GATHER_LIST SgList;
+    PNVME_SRB_EXTENSION SrbExtension = Srb->SrbExtension;
+    PULONGLONG PrpList;
+    ULONGLONG Address, End;
+    ULONG Entries = 0;
+    ULONG Length;
+    ULONG i;
+
+    SgList = StorPortGetScatterGatherList(AdapterExtension, Srb);
+    if (SgList == NULL || SgList->NumberOfElements == 0)
+        return FALSE;
+
+    PrpList = (PULONGLONG)ALIGN_UP_POINTER_BY(SrbExtension->PrpListBuffer, NVME_PRP_LIST_SIZE);
+
+    /* The first entry may start anywhere, all the others are whole pages */
+    Command->Prp1 = SgList->List[0].PhysicalAddress.QuadPart;
+    Address = ((ULONGLONG)SgList->List[0].PhysicalAddress.QuadPart & ~(ULONGLONG)(NVME_PAGE_SIZE - 1)) + NVME_PAGE_SIZE;
+
+    for (i = 0; i < SgList->NumberOfElements; i++)
+    {
+        End = SgList->List[i].PhysicalAddress.QuadPart + SgList->List[i].Length;
+
+        if (i != 0)
+        {
+            Address = SgList->List[i].PhysicalAddress.QuadPart;
+            if (Address & (NVME_PAGE_SIZE - 1))
+                return FALSE;
+        }
+
+        if (i != SgList->NumberOfElements - 1 && (End & (NVME_PAGE_SIZE - 1)))
+            return FALSE;
+
+        for (; Address < End; Address += NVME_PAGE_SIZE)
+        {
+            if (Entries == NVME_PRP_LIST_SIZE / sizeof(ULONGLONG))
+                return FALSE;
+
+            PrpList[Entries++] = Address;
+        }
+    }
+
+    if (Entries == 0)
+        Command->Prp2 = 0;
+    else if (Entries == 1)
+        Command->Prp2 = PrpList[0];
+    else
+        Command->Prp2 = StorPortGetPhysicalAddress(AdapterExtension, NULL, PrpList, &Length).QuadPart;
+
+    return TRUE;
+}
+
+
+static
+BOOLEAN
+NvmeStartCommand(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Inout_ PNVME_COMMAND Command)
+{
+    PNVME_QUEUE Queue;
+    STOR_LOCK_HANDLE LockHandle;
+    USHORT CommandId;
+    BOOLEAN Result = FALSE;
+
+    Queue = NvmeGetSubmissionQueue(AdapterExtension, Srb);
+
+    StorPortAcquireSpinLock(AdapterExtension, DpcLock, &Queue->Dpc, &LockHandle);
+
+    /* Find a free command identifier, it indexes the request table */
+    if (Queue->Outstanding < (ULONG)Queue->Depth - 1)
+    {
+        CommandId = Queue->NextCommandId;
+        while (Queue->Requests[CommandId] != NULL)
+            CommandId = (CommandId + 1) % Queue->Depth;
+
+        Command->CommandId = CommandId;
+        if (NvmeSubmitCommand(AdapterExtension, Queue, Command))
+        {
+            Queue->Requests[CommandId] = Srb;
+            Queue->NextCommandId = (CommandId + 1) % Queue->Depth;
+            Queue->Outstanding++;
+            Result = TRUE;
+        }
+    }
+
+    StorPortReleaseSpinLock(AdapterExtension, &LockHandle);
+
+    return Result;
+}
+
+
+static
+UCHAR
+NvmeReadWrite(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    NVME_COMMAND Command;
+    ULONGLONG Lba;
+    ULONG Blocks;
+    PUCHAR Cdb = Srb->Cdb;
+    BOOLEAN Write;
+
+    switch (Cdb[0])
+    {
+        case SCSIOP_READ6:
+        case SCSIOP_WRITE6:
+            Lba = ((ULONG)(Cdb[1] & 0x1F) << 16) | ((ULONG)Cdb[2] << 8) | Cdb[3];
+            Blocks = Cdb[4] ? Cdb[4] : 256;
+            break;
+
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+            Lba = ((ULONG)Cdb[2] << 24) | ((ULONG)Cdb[3] << 16) | ((ULONG)Cdb[4] << 8) | Cdb[5];
+            Blocks = ((ULONG)Cdb[7] << 8) | Cdb[8];
+            break;
+
+        case SCSIOP_READ12:
+        case SCSIOP_WRITE12:
+            Lba = ((ULONG)Cdb[2] << 24) | ((ULONG)Cdb[3] << 16) | ((ULONG)Cdb[4] << 8) | Cdb[5];
+            Blocks = ((ULONG)Cdb[6] << 24) | ((ULONG)Cdb[7] << 16) | ((ULONG)Cdb[8] << 8) | Cdb[9];
+            break;
+
+        default: /* SCSIOP_READ16, SCSIOP_WRITE16 */
+            Lba = ((ULONGLONG)Cdb[2] << 56) | ((ULONGLONG)Cdb[3] << 48) |
+                  ((ULONGLONG)Cdb[4] << 40) | ((ULONGLONG)Cdb[5] << 32) |
+                  ((ULONGLONG)Cdb[6] << 24) | ((ULONGLONG)Cdb[7] << 16) |
+                  ((ULONGLONG)Cdb[8] << 8) | Cdb[9];
+            Blocks = ((ULONG)Cdb[10] << 24) | ((ULONG)Cdb[11] << 16) | ((ULONG)Cdb[12] << 8) | Cdb[13];
+            break;
+    }
+
+    Write = (Cdb[0] == SCSIOP_WRITE6 || Cdb[0] == SCSIOP_WRITE ||
+             Cdb[0] == SCSIOP_WRITE12 || Cdb[0] == SCSIOP_WRITE16);
+
+    if (Blocks == 0)
+        return SRB_STATUS_SUCCESS;
+
+    if (Blocks > 0x10000 ||
+        Lba + Blocks > AdapterExtension->NamespaceBlocks ||
+        ((ULONGLONG)Blocks << AdapterExtension->BlockShift) != Srb->DataTransferLength)
+    {
+        return SRB_STATUS_INVALID_REQUEST;
+    }
+
+    StorPortZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = Write ? NVME_NVM_WRITE : NVME_NVM_READ;
+    Command.NamespaceId = 1;
+    Command.Cdw10 = (ULONG)Lba;
+    Command.Cdw11 = (ULONG)(Lba >> 32);
+    Command.Cdw12 = Blocks - 1;
+
+    if (!NvmeBuildPrps(AdapterExtension, Srb, &Command))
+        return SRB_STATUS_INVALID_REQUEST;
+
+    if (!NvmeStartCommand(AdapterExtension, Srb, &Command))
+        return SRB_STATUS_BUSY;
+
+    return SRB_STATUS_PENDING;
+}
+
+
+static
+UCHAR
+NvmeFlush(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    NVME_COMMAND Command;
+
+    StorPortZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_NVM_FLUSH;
+    Command.NamespaceId = 1;
+
+    if (!NvmeStartCommand(AdapterExtension, Srb, &Command))
+        return SRB_STATUS_BUSY;
+
+    return SRB_STATUS_PENDING;
+}
+
+
+static
+VOID
+NvmeCopyPadded(
+    _Out_writes_(DestinationLength) PUCHAR Destination,
+    _In_ ULONG DestinationLength,
+    _In_reads_(SourceLength) PUCHAR Source,
+    _In_ ULONG SourceLength)
+{
+    ULONG i;
+
+    for (i = 0; i < DestinationLength; i++)
+        Destination[i] = (i < SourceLength && Source[i] != 0) ? Source[i] : ' ';
+}
+
+
+static
+UCHAR
+NvmeInquiry(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_IDENTIFY_CONTROLLER Identify = AdapterExtension->IdentifyController;
+    UCHAR Buffer[sizeof(INQUIRYDATA)];
+    PINQUIRYDATA InquiryData;
+    PVPD_SUPPORTED_PAGES_PAGE SupportedPages;
+    PVPD_SERIAL_NUMBER_PAGE SerialNumber;
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    ULONG Length;
+
+    C_ASSERT(sizeof(INQUIRYDATA) >= sizeof(VPD_SERIAL_NUMBER_PAGE) + sizeof(Identify->SerialNumber));
+
+    StorPortZeroMemory(Buffer, sizeof(Buffer));
+
+    if (Cdb->CDB6INQUIRY3.EnableVitalProductData == 0)
+    {
+        InquiryData = (PINQUIRYDATA)Buffer;
+        InquiryData->DeviceType = DIRECT_ACCESS_DEVICE;
+        InquiryData->Versions = 5;
+        InquiryData->ResponseDataFormat = 2;
+        InquiryData->AdditionalLength = INQUIRYDATABUFFERSIZE - 5;
+        InquiryData->CommandQueue = 1;
+        NvmeCopyPadded(InquiryData->VendorId, sizeof(InquiryData->VendorId), (PUCHAR)"NVMe", 4);
+        NvmeCopyPadded(InquiryData->ProductId, sizeof(InquiryData->ProductId),
+                       Identify->ModelNumber, sizeof(Identify->ModelNumber));
+        NvmeCopyPadded(InquiryData->ProductRevisionLevel, sizeof(InquiryData->ProductRevisionLevel),
+                       Identify->FirmwareRevision, sizeof(Identify->FirmwareRevision));
+        Length = INQUIRYDATABUFFERSIZE;
+    }
+    else if (Cdb->CDB6INQUIRY3.PageCode == VPD_SUPPORTED_PAGES)
+    {
+        SupportedPages = (PVPD_SUPPORTED_PAGES_PAGE)Buffer;
+        SupportedPages->DeviceType = DIRECT_ACCESS_DEVICE;
+        SupportedPages->PageCode = VPD_SUPPORTED_PAGES;
+        SupportedPages->PageLength = 2;
+        SupportedPages->SupportedPageList[0] = VPD_SUPPORTED_PAGES;
+        SupportedPages->SupportedPageList[1] = VPD_SERIAL_NUMBER;
+        Length = FIELD_OFFSET(VPD_SUPPORTED_PAGES_PAGE, SupportedPageList) + 2;
+    }
+    else if (Cdb->CDB6INQUIRY3.PageCode == VPD_SERIAL_NUMBER)
+    {
+        SerialNumber = (PVPD_SERIAL_NUMBER_PAGE)Buffer;
+        SerialNumber->DeviceType = DIRECT_ACCESS_DEVICE;
+        SerialNumber->PageCode = VPD_SERIAL_NUMBER;
+        SerialNumber->PageLength = sizeof(Identify->SerialNumber);
+        NvmeCopyPadded(SerialNumber->SerialNumber, sizeof(Identify->SerialNumber),
+                       Identify->SerialNumber, sizeof(Identify->SerialNumber));
+        Length = FIELD_OFFSET(VPD_SERIAL_NUMBER_PAGE, SerialNumber) + sizeof(Identify->SerialNumber);
+    }
+    else
+    {
+        return SRB_STATUS_INVALID_REQUEST;
+    }
+
+    Length = min(Length, Srb->DataTransferLength);
+    StorPortMoveMemory(Srb->DataBuffer, Buffer, Length);
+    Srb->DataTransferLength = Length;
+
+    return SRB_STATUS_SUCCESS;
+}
+
+
+static
+UCHAR
+NvmeReadCapacity(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    ULONGLONG LastBlock = AdapterExtension->NamespaceBlocks - 1;
+    PREAD_CAPACITY_DATA_EX CapacityEx;
+    PREAD_CAPACITY_DATA Capacity;
+    ULONG Value;
+
+    if (Srb->Cdb[0] == SCSIOP_READ_CAPACITY)
+    {
+        if (Srb->DataTransferLength < sizeof(READ_CAPACITY_DATA))
+            return SRB_STATUS_DATA_OVERRUN;
+
+        Capacity = Srb->DataBuffer;
+        Value = (LastBlock > MAXULONG) ? MAXULONG : (ULONG)LastBlock;
+        REVERSE_BYTES(&Capacity->LogicalBlockAddress, &Value);
+        REVERSE_BYTES(&Capacity->BytesPerBlock, &AdapterExtension->BlockSize);
+        Srb->DataTransferLength = sizeof(READ_CAPACITY_DATA);
+    }
+    else
+    {
+        if (Srb->DataTransferLength < sizeof(READ_CAPACITY_DATA_EX))
+            return SRB_STATUS_DATA_OVERRUN;
+
+        CapacityEx = Srb->DataBuffer;
+        REVERSE_BYTES_QUAD(&CapacityEx->LogicalBlockAddress.QuadPart, &LastBlock);
+        REVERSE_BYTES(&CapacityEx->BytesPerBlock, &AdapterExtension->BlockSize);
+        Srb->DataTransferLength = sizeof(READ_CAPACITY_DATA_EX);
+    }
+
+    return SRB_STATUS_SUCCESS;
+}
+
+
+static
+UCHAR
+NvmeModeSense(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PMODE_PARAMETER_HEADER10 Header10;
+    PMODE_PARAMETER_HEADER Header;
+
+    /* No mode pages, just a header telling the device is not write protected */
+    if (Srb->Cdb[0] == SCSIOP_MODE_SENSE)
+    {
+        if (Srb->DataTransferLength < sizeof(MODE_PARAMETER_HEADER))
+            return SRB_STATUS_DATA_OVERRUN;
+
+        Header = Srb->DataBuffer;
+        StorPortZeroMemory(Header, sizeof(MODE_PARAMETER_HEADER));
+        Header->ModeDataLength = sizeof(MODE_PARAMETER_HEADER) - 1;
+        Srb->DataTransferLength = sizeof(MODE_PARAMETER_HEADER);
+    }
+    else
+    {
+        if (Srb->DataTransferLength < sizeof(MODE_PARAMETER_HEADER10))
+            return SRB_STATUS_DATA_OVERRUN;
+
+        Header10 = Srb->DataBuffer;
+        StorPortZeroMemory(Header10, sizeof(MODE_PARAMETER_HEADER10));
+        Header10->ModeDataLength[1] = sizeof(MODE_PARAMETER_HEADER10) - 2;
+        Srb->DataTransferLength = sizeof(MODE_PARAMETER_HEADER10);
+    }
+
+    return SRB_STATUS_SUCCESS;
+}
+
+
+static
+UCHAR
+NvmeExecuteScsi(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    switch (Srb->Cdb[0])
+    {
+        case SCSIOP_READ6:
+        case SCSIOP_WRITE6:
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+        case SCSIOP_READ12:
+        case SCSIOP_WRITE12:
+        case SCSIOP_READ16:
+        case SCSIOP_WRITE16:
+            return NvmeReadWrite(AdapterExtension, Srb);
+
+        case SCSIOP_SYNCHRONIZE_CACHE:
+        case SCSIOP_SYNCHRONIZE_CACHE16:
+            return NvmeFlush(AdapterExtension, Srb);
+
+        case SCSIOP_INQUIRY:
+            return NvmeInquiry(AdapterExtension, Srb);
+
+        case SCSIOP_READ_CAPACITY:
+            return NvmeReadCapacity(AdapterExtension, Srb);
+
+        case SCSIOP_SERVICE_ACTION_IN16:
+            if ((Srb->Cdb[1] & 0x1F) != NVME_SERVICE_ACTION_READ_CAPACITY16)
+                return SRB_STATUS_INVALID_REQUEST;
+            return NvmeReadCapacity(AdapterExtension, Srb);
+
+        case SCSIOP_MODE_SENSE:
+        case SCSIOP_MODE_SENSE10:
+            return NvmeModeSense(Srb);
+
+        case SCSIOP_TEST_UNIT_READY:
+        case SCSIOP_VERIFY:
+        case SCSIOP_START_STOP_UNIT:
+        case SCSIOP_MEDIUM_REMOVAL:
+            Srb->DataTransferLength = 0;
+            return SRB_STATUS_SUCCESS;
+
+        default:
+            DPRINT("Unsupported SCSI operation 0x%02x\n", Srb->Cdb[0]);
+            return SRB_STATUS_INVALID_REQUEST;
+    }
+}
+
+
+static
+VOID
+NvmeProcessCompletions(
+    _In_ PNVME_ADAPTER_EXTENSION AdapterExtension,
+    _In_ PNVME_QUEUE Queue)
+{
+    PSCSI_REQUEST_BLOCK Srb;
+    NVME_COMPLETION Completion;
+    STOR_LOCK_HANDLE LockHandle;
+    BOOLEAN Consumed = FALSE;
+
+    StorPortAcquireSpinLock(AdapterExtension, DpcLock, &Queue->Dpc, &LockHandle);
+
+    while (NvmeCompletionPending(Queue))
+    {
+        NvmeConsumeCompletion(Queue, &Completion);
+        Consumed = TRUE;
+
+        if (Completion.CommandId >= Queue->Depth ||
+            Queue->Requests[Completion.CommandId] == NULL)
+        {
+            DPRINT1("Unexpected completion of command %u on queue %u\n",
+                    Completion.CommandId, Queue->QueueId);
+            continue;
+        }
+
+        Srb = Queue->Requests[Completion.CommandId];
+        Queue->Requests[Completion.CommandId] = NULL;
+        Queue->Outstanding--;
+
+        Srb->SrbStatus = (NVME_STATUS_CODE(Completion.Status) == 0) ? SRB_STATUS_SUCCESS : SRB_STATUS_ERROR;
+
+        /* Storport completes the request on the processor which issued it */
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    }
+
+    if (Consumed)
+        StorPortWriteRegisterUlong(AdapterExtension, Queue->CompletionDoorbell, Queue->CqHead);
+
+    StorPortReleaseSpinLock(AdapterExtension, &LockHandle);
+}
+
+
+static
+VOID
+NTAPI
+NvmeQueueDpcRoutine(
+    _In_ PSTOR_DPC Dpc,
+    _In_ PVOID HwDeviceExtension,
+    _In_ PVOID SystemArgument1,
+    _In_ PVOID SystemArgument2)
+{
+    PNVME_ADAPTER_EXTENSION AdapterExtension = HwDeviceExtension;
+    PNVME_QUEUE Queue = SystemArgument1;
+
+    NvmeProcessCompletions(AdapterExtension, Queue);
+
+    /* The last DPC lets the controller interrupt again */
+    if (InterlockedDecrement(&AdapterExtension->PendingDpcs) == 0)
+        StorPortWriteRegisterUlong(AdapterExtension, &AdapterExtension->Registers->InterruptMaskClear, 1);
+}
+
+
+BOOLEAN
+NTAPI
+NvmeHwInterrupt(
+    _In_ PVOID DeviceExtension)
+{
+    PNVME_ADAPTER_EXTENSION AdapterExtension = DeviceExtension;
+    PNVME_QUEUE Queue;
+    ULONG i;
+
+    if (!AdapterExtension->NamespaceReady)
+        return FALSE;
+
+    /* A level triggered interrupt stays asserted until the queues are drained */
+    if (AdapterExtension->PendingDpcs != 0)
+        return FALSE;
+
+    for (i = 0; i < AdapterExtension->IoQueueCount; i++)
+    {
+        if (NvmeCompletionPending(&AdapterExtension->IoQueues[i]))
+            break;
+    }
+
+    if (i == AdapterExtension->IoQueueCount)
+        return FALSE;
+
+    /* Mask the interrupt and let the queue DPCs drain the completion queues */
+    StorPortWriteRegisterUlong(AdapterExtension, &AdapterExtension->Registers->InterruptMaskSet, 1);
+
+    AdapterExtension->PendingDpcs = 1;
+    for (; i < AdapterExtension->IoQueueCount; i++)
+    {
+        Queue = &AdapterExtension->IoQueues[i];
+        if (!NvmeCompletionPending(Queue))
+            continue;
+
+        InterlockedIncrement(&AdapterExtension->PendingDpcs);
+        if (!StorPortIssueDpc(AdapterExtension, &Queue->Dpc, Queue, NULL))
+            InterlockedDecrement(&AdapterExtension->PendingDpcs);
+    }
+
+    /* Drop the reference held while issuing the DPCs */
+    if (InterlockedDecrement(&AdapterExtension->PendingDpcs) == 0)
+        StorPortWriteRegisterUlong(AdapterExtension, &AdapterExtension->Registers->InterruptMaskClear, 1);
+
+    return TRUE;
+}
+
+
+BOOLEAN
+NTAPI
+NvmeHwStartIo(
+    _In_ PVOID DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_ADAPTER_EXTENSION AdapterExtension = DeviceExtension;
+    UCHAR SrbStatus;
+
+    if (Srb->PathId != 0 || Srb->TargetId != 0 || Srb->Lun != 0 ||
+        !AdapterExtension->NamespaceReady)
+    {
+        SrbStatus = SRB_STATUS_NO_DEVICE;
+    }
+    else
+    {
+        switch (Srb->Function)
+        {
+            case SRB_FUNCTION_EXECUTE_SCSI:
+                SrbStatus = NvmeExecuteScsi(AdapterExtension, Srb);
+                break;
+
+            case SRB_FUNCTION_FLUSH:
+            case SRB_FUNCTION_SHUTDOWN:
+                SrbStatus = NvmeFlush(AdapterExtension, Srb);
+                break;
+
+            default:
+                SrbStatus = SRB_STATUS_INVALID_REQUEST;
+                break;
+        }
+    }
+
+    if (SrbStatus != SRB_STATUS_PENDING)
+    {
+        Srb->SrbStatus = SrbStatus;
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    }
+
+    return TRUE;
+}
+
+
+BOOLEAN
+NTAPI
+NvmeHwResetBus(
+    _In_ PVOID DeviceExtension,
+    _In_ ULONG PathId)
+{
+    UNREFERENCED_PARAMETER(DeviceExtension);
+    UNREFERENCED_PARAMETER(PathId);
+
+    /* Outstanding commands complete through the queues, nothing to abort */
+    return TRUE;
+}
+
+
+BOOLEAN
+NTAPI
+NvmeHwInitialize(
+    _In_ PVOID DeviceExtension)
+{
+    PNVME_ADAPTER_EXTENSION AdapterExtension = DeviceExtension;
+    PERF_CONFIGURATION_DATA PerfConfig;
+    ULONG i;
+
+    DPRINT1("NvmeHwInitialize(%p)\n", DeviceExtension);
+
+    if (!NvmeIdentify(AdapterExtension))
+        return FALSE;
+
+    if (!NvmeCreateIoQueues(AdapterExtension))
+        return FALSE;
+
+    for (i = 0; i < AdapterExtension->IoQueueCount; i++)
+    {
+        StorPortInitializeDpc(AdapterExtension,
+                              &AdapterExtension->IoQueues[i].Dpc,
+                              NvmeQueueDpcRoutine);
+    }
+
+    /*
+     * Every queue pair has its own lock, so HwStartIo may run on all
+     * processors at once. Completions are handed back to the processor
+     * which submitted the request.
+     */
+    StorPortZeroMemory(&PerfConfig, sizeof(PerfConfig));
+    PerfConfig.Version = STOR_PERF_VERSION;
+    PerfConfig.Size = sizeof(PerfConfig);
+    if (StorPortInitializePerfOpts(AdapterExtension, TRUE, &PerfConfig) == STOR_STATUS_SUCCESS)
+    {
+        PerfConfig.Flags &= STOR_PERF_CONCURRENT_CHANNELS | STOR_PERF_DPC_REDIRECTION;
+        PerfConfig.ConcurrentChannels = AdapterExtension->IoQueueCount;
+        if (StorPortInitializePerfOpts(AdapterExtension, FALSE, &PerfConfig) != STOR_STATUS_SUCCESS)
+            DPRINT1("StorPortInitializePerfOpts() failed\n");
+    }
+
+    AdapterExtension->NamespaceReady = TRUE;
+
+    /* Unmask the interrupt */
+    StorPortWriteRegisterUlong(AdapterExtension, &AdapterExtension->Registers->InterruptMaskClear, 1);
+
+    return TRUE;
+}
+
+
+ULONG
+NTAPI
+NvmeHwFindAdapter(
+    _In_ PVOID DeviceExtension,
+    _In_ PVOID HwContext,
+    _In_ PVOID BusInformation,
+    _In_ PCHAR ArgumentString,
+    _Inout_ PPORT_CONFIGURATION_INFORMATION ConfigInfo,
+    _In_ PBOOLEAN Reserved3)
+{
+    PNVME_ADAPTER_EXTENSION AdapterExtension = DeviceExtension;
+    PERF_CONFIGURATION_DATA PerfConfig;
+    PACCESS_RANGE AccessRange;
+    ULONGLONG Capabilities;
+    ULONG Offset, Length;
+    ULONG Configuration;
+    ULONG Depth;
+    ULONG i;
+
+    DPRINT1("NvmeHwFindAdapter(%p)\n", DeviceExtension);
+
+    UNREFERENCED_PARAMETER(HwContext);
+    UNREFERENCED_PARAMETER(BusInformation);
+    UNREFERENCED_PARAMETER(ArgumentString);
+    UNREFERENCED_PARAMETER(Reserved3);
+
+    /* The registers live in the first memory BAR */
+    AdapterExtension->Registers = NULL;
+    AccessRange = *ConfigInfo->AccessRanges;
+    for (i = 0; i < ConfigInfo->NumberOfAccessRanges; i++)
+    {
+        if (AccessRange[i].RangeInMemory && AccessRange[i].RangeLength >= 2 * NVME_DOORBELL_OFFSET)
+        {
+            AdapterExtension->Registers = StorPortGetDeviceBase(AdapterExtension,
+                                                                ConfigInfo->AdapterInterfaceType,
+                                                                ConfigInfo->SystemIoBusNumber,
+                                                                AccessRange[i].RangeStart,
+                                                                AccessRange[i].RangeLength,
+                                                                FALSE);
+            break;
+        }
+    }
+
+    if (AdapterExtension->Registers == NULL)
+    {
+        DPRINT1("No register BAR\n");
+        return SP_RETURN_ERROR;
+    }
+
+    Capabilities = NvmeReadCapabilities(AdapterExtension);
+    AdapterExtension->DoorbellStride = 4 << NVME_CAP_DSTRD(Capabilities);
+    AdapterExtension->ReadyTimeoutMs = max(NVME_CAP_TO(Capabilities), 1) * 500;
+    AdapterExtension->MaximumQueueEntries = NVME_CAP_MQES(Capabilities) + 1;
+
+    /* One queue pair per processor, as far as we can handle */
+    AdapterExtension->IoQueueCount = 1;
+    StorPortZeroMemory(&PerfConfig, sizeof(PerfConfig));
+    PerfConfig.Version = STOR_PERF_VERSION;
+    PerfConfig.Size = sizeof(PerfConfig);
+    if (StorPortInitializePerfOpts(AdapterExtension, TRUE, &PerfConfig) == STOR_STATUS_SUCCESS &&
+        (PerfConfig.Flags & STOR_PERF_CONCURRENT_CHANNELS))
+    {
+        AdapterExtension->IoQueueCount = min(max(PerfConfig.ConcurrentChannels, 1), NVME_MAX_IO_QUEUES);
+    }
+
+    Depth = min(AdapterExtension->MaximumQueueEntries, NVME_IO_QUEUE_DEPTH);
+
+    /* Rings, identify data and queues each start on their own page */
+    Length = 2 * PAGE_SIZE +
+             ROUND_TO_PAGES(NVME_ADMIN_QUEUE_DEPTH * sizeof(NVME_COMMAND)) +
+             ROUND_TO_PAGES(NVME_ADMIN_QUEUE_DEPTH * sizeof(NVME_COMPLETION)) +
+             AdapterExtension->IoQueueCount * (ROUND_TO_PAGES(Depth * sizeof(NVME_COMMAND)) +
+                                               ROUND_TO_PAGES(Depth * sizeof(NVME_COMPLETION)));
+
+    AdapterExtension->UncachedExtension = StorPortGetUncachedExtension(AdapterExtension, ConfigInfo, Length);
+    if (AdapterExtension->UncachedExtension == NULL)
+    {
+        DPRINT1("Failed to allocate %lu bytes of uncached memory\n", Length);
+        return SP_RETURN_ERROR;
+    }
+
+    AdapterExtension->UncachedExtensionSize = Length;
+
+    Offset = 0;
+    AdapterExtension->IdentifyController = (PNVME_IDENTIFY_CONTROLLER)(AdapterExtension->UncachedExtension + Offset);
+    AdapterExtension->IdentifyControllerPhysical = StorPortGetPhysicalAddress(AdapterExtension,
+                                                                              NULL,
+                                                                              AdapterExtension->IdentifyController,
+                                                                              &Length);
+    Offset += PAGE_SIZE;
+    AdapterExtension->IdentifyNamespace = (PNVME_IDENTIFY_NAMESPACE)(AdapterExtension->UncachedExtension + Offset);
+    AdapterExtension->IdentifyNamespacePhysical = StorPortGetPhysicalAddress(AdapterExtension,
+                                                                             NULL,
+                                                                             AdapterExtension->IdentifyNamespace,
+                                                                             &Length);
+    Offset += PAGE_SIZE;
+
+    NvmeInitializeQueue(AdapterExtension, &AdapterExtension->AdminQueue, 0, NVME_ADMIN_QUEUE_DEPTH, &Offset);
+    for (i = 0; i < AdapterExtension->IoQueueCount; i++)
+        NvmeInitializeQueue(AdapterExtension, &AdapterExtension->IoQueues[i], (USHORT)(i + 1), (USHORT)Depth, &Offset);
+
+    /* Reset the controller */
+    Configuration = StorPortReadRegisterUlong(AdapterExtension, &AdapterExtension->Registers->Configuration);
+    if (Configuration & NVME_CC_ENABLE)
+    {
+        StorPortWriteRegisterUlong(AdapterExtension,
+                                   &AdapterExtension->Registers->Configuration,
+                                   Configuration & ~NVME_CC_ENABLE);
+    }
+
+    if (!NvmeWaitForReady(AdapterExtension, FALSE))
+        return SP_RETURN_ERROR;
+
+    /* Set up the admin queue pair and enable the controller with interrupts masked */
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->AdminQueueAttributes,
+                               ((NVME_ADMIN_QUEUE_DEPTH - 1) << 16) | (NVME_ADMIN_QUEUE_DEPTH - 1));
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->AdminSubmissionQueueLow,
+                               AdapterExtension->AdminQueue.SubmissionQueuePhysical.LowPart);
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->AdminSubmissionQueueHigh,
+                               AdapterExtension->AdminQueue.SubmissionQueuePhysical.HighPart);
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->AdminCompletionQueueLow,
+                               AdapterExtension->AdminQueue.CompletionQueuePhysical.LowPart);
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->AdminCompletionQueueHigh,
+                               AdapterExtension->AdminQueue.CompletionQueuePhysical.HighPart);
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->InterruptMaskSet,
+                               1);
+    StorPortWriteRegisterUlong(AdapterExtension,
+                               &AdapterExtension->Registers->Configuration,
+                               NVME_CC_IOSQES | NVME_CC_IOCQES | NVME_CC_ENABLE);
+
+    if (!NvmeWaitForReady(AdapterExtension, TRUE))
+        return SP_RETURN_ERROR;
+
+    ConfigInfo->Master = TRUE;
+    ConfigInfo->AlignmentMask = 0x3;
+    ConfigInfo->ScatterGather = TRUE;
+    ConfigInfo->DmaWidth = Width32Bits;
+    ConfigInfo->Dma32BitAddresses = TRUE;
+    ConfigInfo->Dma64BitAddresses = SCSI_DMA64_MINIPORT_SUPPORTED;
+    ConfigInfo->WmiDataProvider = FALSE;
+    ConfigInfo->NumberOfBuses = 1;
+    ConfigInfo->MaximumNumberOfTargets = 1;
+    ConfigInfo->MaximumNumberOfLogicalUnits = 1;
+    ConfigInfo->MaximumTransferLength = NVME_MAX_TRANSFER_LENGTH;
+    ConfigInfo->NumberOfPhysicalBreaks = NVME_MAX_TRANSFER_LENGTH / NVME_PAGE_SIZE;
+    ConfigInfo->SynchronizationModel = StorSynchronizeFullDuplex;
+
+    return SP_RETURN_FOUND;
+}
+
+
+ULONG
+NTAPI
+DriverEntry(
+    _In_ PVOID DriverObject,
+    _In_ PVOID RegistryPath)
+{
+    HW_INITIALIZATION_DATA HwInitializationData;
+
+    DPRINT1("StorNvme DriverEntry()\n");
+
+    StorPortZeroMemory(&HwInitializationData, sizeof(HwInitializationData));
+    HwInitializationData.HwInitializationDataSize = sizeof(HW_INITIALIZATION_DATA);
+
+    HwInitializationData.HwStartIo = NvmeHwStartIo;
+    HwInitializationData.HwResetBus = NvmeHwResetBus;
+    HwInitializationData.HwInterrupt = NvmeHwInterrupt;
+    HwInitializationData.HwInitialize = NvmeHwInitialize;
+    HwInitializationData.HwFindAdapter = NvmeHwFindAdapter;
+
+    HwInitializationData.TaggedQueuing = TRUE;
+    HwInitializationData.AutoRequestSense = TRUE;
+    HwInitializationData.MultipleRequestPerLu = TRUE;
+    HwInitializationData.NeedPhysicalAddresses = TRUE;
+
+    HwInitializationData.NumberOfAccessRanges = 6;
+    HwInitializationData.AdapterInterfaceType = PCIBus;
+    HwInitializationData.MapBuffers = STOR_MAP_NON_READ_WRITE_BUFFERS;
+
+    HwInitializationData.SrbExtensionSize = sizeof(NVME_SRB_EXTENSION);
+    HwInitializationData.DeviceExtensionSize = sizeof(NVME_ADAPTER_EXTENSION);
+
+    return StorPortInitialize(DriverObject,
+                              RegistryPath,
+                              &HwInitializationData,
+                              NULL);
+}
+
+/* EOF */
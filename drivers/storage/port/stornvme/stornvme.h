@@ -0,0 +1,213 @@
+/*
+ * PROJECT:     ReactOS NVMe Storport Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     NVMe controller definitions
+ */
+
+#ifndef _STORNVME_H_
+#define _STORNVME_H_
+
+#include <ntddk.h>
+#include <storport.h>
+
+#if defined(_MSC_VER)
+#pragma warning(disable:4201) // nameless struct/union
+#endif
+
+/* Driver limits */
+#define NVME_ADMIN_QUEUE_DEPTH          32
+#define NVME_IO_QUEUE_DEPTH             128
+#define NVME_MAX_IO_QUEUES              16
+#define NVME_MAX_TRANSFER_LENGTH        (128 * 1024)
+#define NVME_PAGE_SIZE                  0x1000
+#define NVME_PRP_LIST_SIZE              ((NVME_MAX_TRANSFER_LENGTH / NVME_PAGE_SIZE) * sizeof(ULONGLONG))
+#define NVME_ADMIN_TIMEOUT_US           (2 * 1000 * 1000)
+#define NVME_POLL_INTERVAL_US           10
+
+/* Controller Capabilities (CAP) */
+#define NVME_CAP_MQES(Cap)              ((ULONG)((Cap) & 0xFFFF))
+#define NVME_CAP_TO(Cap)                ((ULONG)(((Cap) >> 24) & 0xFF))
+#define NVME_CAP_DSTRD(Cap)             ((ULONG)(((Cap) >> 32) & 0xF))
+
+/* Controller Configuration (CC) */
+#define NVME_CC_ENABLE                  0x00000001
+#define NVME_CC_IOSQES                  (6 << 16)
+#define NVME_CC_IOCQES                  (4 << 20)
+
+/* Controller Status (CSTS) */
+#define NVME_CSTS_READY                 0x00000001
+#define NVME_CSTS_FATAL                 0x00000002
+
+/* Admin command opcodes */
+#define NVME_ADMIN_CREATE_IO_SQ         0x01
+#define NVME_ADMIN_CREATE_IO_CQ         0x05
+#define NVME_ADMIN_IDENTIFY             0x06
+#define NVME_ADMIN_SET_FEATURES         0x09
+
+/* NVM command opcodes */
+#define NVME_NVM_FLUSH                  0x00
+#define NVME_NVM_WRITE                  0x01
+#define NVME_NVM_READ                   0x02
+
+#define NVME_IDENTIFY_NAMESPACE         0x00
+#define NVME_IDENTIFY_CONTROLLER        0x01
+#define NVME_FEATURE_NUMBER_OF_QUEUES   0x07
+
+/* SERVICE ACTION IN(16) action of READ CAPACITY(16) */
+#define NVME_SERVICE_ACTION_READ_CAPACITY16 0x10
+
+/* Completion status field */
+#define NVME_STATUS_PHASE               0x0001
+#define NVME_STATUS_CODE(Status)        (((Status) >> 1) & 0x7FF)
+
+#include <pshpack1.h>
+
+typedef struct _NVME_CONTROLLER_REGISTERS
+{
+    ULONG CapLow;
+    ULONG CapHigh;
+    ULONG Version;
+    ULONG InterruptMaskSet;
+    ULONG InterruptMaskClear;
+    ULONG Configuration;
+    ULONG Reserved;
+    ULONG Status;
+    ULONG SubsystemReset;
+    ULONG AdminQueueAttributes;
+    ULONG AdminSubmissionQueueLow;
+    ULONG AdminSubmissionQueueHigh;
+    ULONG AdminCompletionQueueLow;
+    ULONG AdminCompletionQueueHigh;
+} NVME_CONTROLLER_REGISTERS, *PNVME_CONTROLLER_REGISTERS;
+
+#define NVME_DOORBELL_OFFSET            0x1000
+
+typedef struct _NVME_COMMAND
+{
+    UCHAR Opcode;
+    UCHAR Flags;
+    USHORT CommandId;
+    ULONG NamespaceId;
+    ULONG Reserved[2];
+    ULONGLONG MetadataPointer;
+    ULONGLONG Prp1;
+    ULONGLONG Prp2;
+    ULONG Cdw10;
+    ULONG Cdw11;
+    ULONG Cdw12;
+    ULONG Cdw13;
+    ULONG Cdw14;
+    ULONG Cdw15;
+} NVME_COMMAND, *PNVME_COMMAND;
+
+C_ASSERT(sizeof(NVME_COMMAND) == 64);
+
+typedef struct _NVME_COMPLETION
+{
+    ULONG Result;
+    ULONG Reserved;
+    USHORT SqHead;
+    USHORT SqId;
+    USHORT CommandId;
+    USHORT Status;
+} NVME_COMPLETION, *PNVME_COMPLETION;
+
+C_ASSERT(sizeof(NVME_COMPLETION) == 16);
+
+typedef struct _NVME_IDENTIFY_CONTROLLER
+{
+    USHORT VendorId;
+    USHORT SubsystemVendorId;
+    UCHAR SerialNumber[20];
+    UCHAR ModelNumber[40];
+    UCHAR FirmwareRevision[8];
+    UCHAR RecommendedArbitrationBurst;
+    UCHAR IeeeOui[3];
+    UCHAR Cmic;
+    UCHAR MaximumDataTransferSize;
+    UCHAR Reserved1[438];
+    ULONG NumberOfNamespaces;
+    UCHAR Reserved2[3576];
+} NVME_IDENTIFY_CONTROLLER, *PNVME_IDENTIFY_CONTROLLER;
+
+C_ASSERT(sizeof(NVME_IDENTIFY_CONTROLLER) == 4096);
+
+typedef struct _NVME_LBA_FORMAT
+{
+    USHORT MetadataSize;
+    UCHAR DataSizeShift;
+    UCHAR RelativePerformance;
+} NVME_LBA_FORMAT, *PNVME_LBA_FORMAT;
+
+typedef struct _NVME_IDENTIFY_NAMESPACE
+{
+    ULONGLONG Size;
+    ULONGLONG Capacity;
+    ULONGLONG Utilization;
+    UCHAR Features;
+    UCHAR NumberOfLbaFormats;
+    UCHAR FormattedLbaSize;
+    UCHAR Reserved1[101];
+    NVME_LBA_FORMAT LbaFormats[16];
+    UCHAR Reserved2[3904];
+} NVME_IDENTIFY_NAMESPACE, *PNVME_IDENTIFY_NAMESPACE;
+
+C_ASSERT(sizeof(NVME_IDENTIFY_NAMESPACE) == 4096);
+
+#include <poppack.h>
+
+typedef struct _NVME_QUEUE
+{
+    STOR_DPC Dpc;                   /* Also serves as the lock of the queue */
+    PNVME_COMMAND SubmissionQueue;
+    PNVME_COMPLETION CompletionQueue;
+    STOR_PHYSICAL_ADDRESS SubmissionQueuePhysical;
+    STOR_PHYSICAL_ADDRESS CompletionQueuePhysical;
+    PULONG SubmissionDoorbell;
+    PULONG CompletionDoorbell;
+    USHORT QueueId;
+    USHORT Depth;
+    USHORT SqTail;
+    USHORT SqHead;
+    USHORT CqHead;
+    USHORT Phase;
+    USHORT NextCommandId;
+    ULONG Outstanding;
+    PSCSI_REQUEST_BLOCK Requests[NVME_IO_QUEUE_DEPTH];
+} NVME_QUEUE, *PNVME_QUEUE;
+
+typedef struct _NVME_ADAPTER_EXTENSION
+{
+    PNVME_CONTROLLER_REGISTERS Registers;
+    ULONG DoorbellStride;
+    ULONG ReadyTimeoutMs;
+    ULONG MaximumQueueEntries;
+
+    PUCHAR UncachedExtension;
+    ULONG UncachedExtensionSize;
+
+    PNVME_IDENTIFY_CONTROLLER IdentifyController;
+    PNVME_IDENTIFY_NAMESPACE IdentifyNamespace;
+    STOR_PHYSICAL_ADDRESS IdentifyControllerPhysical;
+    STOR_PHYSICAL_ADDRESS IdentifyNamespacePhysical;
+
+    NVME_QUEUE AdminQueue;
+    NVME_QUEUE IoQueues[NVME_MAX_IO_QUEUES];
+    ULONG IoQueueCount;
+
+    ULONGLONG NamespaceBlocks;
+    ULONG BlockSize;
+    ULONG BlockShift;
+    BOOLEAN NamespaceReady;
+
+    /* Queue DPCs still running before the interrupt may be unmasked */
+    LONG PendingDpcs;
+} NVME_ADAPTER_EXTENSION, *PNVME_ADAPTER_EXTENSION;
+
+typedef struct _NVME_SRB_EXTENSION
+{
+    /* Room for a PRP list which does not cross a page boundary */
+    UCHAR PrpListBuffer[NVME_PRP_LIST_SIZE * 2];
+} NVME_SRB_EXTENSION, *PNVME_SRB_EXTENSION;
+
+#endif /* _STORNVME_H_ */
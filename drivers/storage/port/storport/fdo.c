@@ -24,7 +24,7 @@ PortFdoInterruptRoutine(
 {
     PFDO_DEVICE_EXTENSION DeviceExtension;
 
-    DPRINT1("PortFdoInterruptRoutine(%p %p)\n",
+    DPRINT("PortFdoInterruptRoutine(%p %p)\n",
             Interrupt, ServiceContext);
 
     DeviceExtension = (PFDO_DEVICE_EXTENSION)ServiceContext;
@@ -121,6 +121,14 @@ PortFdoStartMiniport(
     if (InitData == NULL)
         return STATUS_NO_SUCH_DEVICE;
 
+    /* Initialize the request and completion queues */
+    Status = PortInitializeRequestQueues(DeviceExtension);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("PortInitializeRequestQueues() failed (Status 0x%08lx)\n", Status);
+        return Status;
+    }
+
     /* Initialize the miniport */
     Status = MiniportInitialize(&DeviceExtension->Miniport,
                                 DeviceExtension,
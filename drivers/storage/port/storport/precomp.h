@@ -31,6 +31,8 @@
 #define TAG_ADDRESS_MAPPING 'MAtS'
 #define TAG_INQUIRY_DATA    'QItS'
 #define TAG_SENSE_DATA      'NStS'
+#define TAG_REQUEST         'QRtS'
+#define TAG_COMPLETION      'CCtS'
 
 typedef enum
 {
@@ -81,6 +83,24 @@ typedef struct _MINIPORT
     PMINIPORT_DEVICE_EXTENSION MiniportExtension;
 } MINIPORT, *PMINIPORT;
 
+/* Requests completed by the miniport, completed to the I/O manager by a per-processor DPC */
+typedef struct _PORT_COMPLETION_QUEUE
+{
+    SLIST_HEADER CompletedRequests;
+    KDPC Dpc;
+} PORT_COMPLETION_QUEUE, *PPORT_COMPLETION_QUEUE;
+
+/* Port data attached to every request passed to the miniport */
+typedef struct _PORT_REQUEST
+{
+    SLIST_ENTRY CompletionEntry;
+    PIRP Irp;
+    PSCSI_REQUEST_BLOCK Srb;
+    PVOID OriginalDataBuffer;
+    ULONG Processor;
+    PSTOR_SCATTER_GATHER_LIST ScatterGatherList;
+} PORT_REQUEST, *PPORT_REQUEST;
+
 typedef struct _UNIT_DATA
 {
     LIST_ENTRY ListEntry;
@@ -112,6 +132,12 @@ typedef struct _FDO_DEVICE_EXTENSION
     PKINTERRUPT Interrupt;
     ULONG InterruptIrql;
 
+    KSPIN_LOCK StartIoLock;
+    ULONG PerfFlags;
+    ULONG ConcurrentChannels;
+    ULONG CompletionQueueCount;
+    PPORT_COMPLETION_QUEUE CompletionQueues;
+
     KSPIN_LOCK PdoListLock;
     LIST_ENTRY PdoListHead;
     ULONG PdoCount;
@@ -261,6 +287,39 @@ PortPdoPnp(
     _In_ PIRP Irp);
 
 
+/* request.c */
+
+NTSTATUS
+PortInitializeRequestQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+NTSTATUS
+PortStartRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+ULONG
+PortInitializePerfOpts(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ BOOLEAN Query,
+    _Inout_ PPERF_CONFIGURATION_DATA PerfConfigData);
+
+ULONG
+PortGetStartIoPerfParams(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Inout_ PSTARTIO_PERFORMANCE_PARAMETERS StartIoPerfParams);
+
 /* storport.c */
 
 PHW_INITIALIZATION_DATA
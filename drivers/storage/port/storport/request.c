@@ -0,0 +1,506 @@
+/*
+ * PROJECT:     ReactOS Storport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Request submission and completion
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "precomp.h"
+
+#define NDEBUG
+#include <debug.h>
+
+#define PORT_SUPPORTED_PERF_FLAGS (STOR_PERF_DPC_REDIRECTION | \
+                                   STOR_PERF_CONCURRENT_CHANNELS | \
+                                   STOR_PERF_DPC_REDIRECTION_CURRENT_CPU)
+
+
+/* FUNCTIONS ******************************************************************/
+
+static
+BOOLEAN
+PortIsReadWriteRequest(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    if (Srb->Function != SRB_FUNCTION_EXECUTE_SCSI)
+        return FALSE;
+
+    switch (Srb->Cdb[0])
+    {
+        case SCSIOP_READ6:
+        case SCSIOP_WRITE6:
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+        case SCSIOP_READ12:
+        case SCSIOP_WRITE12:
+        case SCSIOP_READ16:
+        case SCSIOP_WRITE16:
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+static
+PPORT_REQUEST
+PortGetRequest(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PIRP Irp = Srb->OriginalRequest;
+
+    if (Irp == NULL)
+        return NULL;
+
+    return Irp->Tail.Overlay.DriverContext[0];
+}
+
+
+static
+VOID
+PortBuildScatterGatherList(
+    _In_ PPORT_REQUEST Request,
+    _In_ PMDL Mdl)
+{
+    PSTOR_SCATTER_GATHER_LIST List = Request->ScatterGatherList;
+    PSTOR_SCATTER_GATHER_ELEMENT Element = NULL;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PUCHAR VirtualAddress;
+    PPFN_NUMBER PfnArray = NULL;
+    ULONG_PTR Offset = 0;
+    ULONG Remaining, Length;
+
+    VirtualAddress = Request->OriginalDataBuffer;
+    Remaining = Request->Srb->DataTransferLength;
+
+    /* Use the pages of the MDL if the buffer is described by it */
+    if (Mdl != NULL)
+    {
+        PfnArray = MmGetMdlPfnArray(Mdl);
+        Offset = MmGetMdlByteOffset(Mdl) +
+                 ((ULONG_PTR)VirtualAddress - (ULONG_PTR)MmGetMdlVirtualAddress(Mdl));
+    }
+
+    List->NumberOfElements = 0;
+
+    while (Remaining != 0)
+    {
+        if (PfnArray != NULL)
+        {
+            PhysicalAddress.QuadPart = ((ULONGLONG)PfnArray[Offset >> PAGE_SHIFT] << PAGE_SHIFT) +
+                                       (Offset & (PAGE_SIZE - 1));
+            Length = PAGE_SIZE - (ULONG)(Offset & (PAGE_SIZE - 1));
+        }
+        else
+        {
+            PhysicalAddress = MmGetPhysicalAddress(VirtualAddress);
+            Length = PAGE_SIZE - BYTE_OFFSET(VirtualAddress);
+        }
+
+        if (Length > Remaining)
+            Length = Remaining;
+
+        /* Merge physically contiguous pages */
+        if (Element != NULL &&
+            Element->PhysicalAddress.QuadPart + Element->Length == (ULONGLONG)PhysicalAddress.QuadPart)
+        {
+            Element->Length += Length;
+        }
+        else
+        {
+            Element = &List->List[List->NumberOfElements++];
+            Element->PhysicalAddress.QuadPart = PhysicalAddress.QuadPart;
+            Element->Length = Length;
+            Element->Reserved = 0;
+        }
+
+        VirtualAddress += Length;
+        Offset += Length;
+        Remaining -= Length;
+    }
+}
+
+
+static
+PPORT_REQUEST
+PortAllocateRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PHW_INITIALIZATION_DATA InitData = DeviceExtension->Miniport.InitData;
+    PPORT_REQUEST Request;
+    PMDL Mdl = NULL;
+    ULONG_PTR MdlStart;
+    ULONG SrbExtensionOffset;
+    ULONG Pages = 0;
+    ULONG Size;
+
+    if (Srb->DataBuffer != NULL && Srb->DataTransferLength != 0)
+        Pages = ADDRESS_AND_SIZE_TO_SPAN_PAGES(Srb->DataBuffer, Srb->DataTransferLength);
+
+    /* The scatter/gather list and the SRB extension follow the request */
+    Size = sizeof(PORT_REQUEST);
+    if (Pages != 0)
+        Size += FIELD_OFFSET(STOR_SCATTER_GATHER_LIST, List[Pages]);
+    Size = ALIGN_UP_BY(Size, 16);
+    SrbExtensionOffset = Size;
+    Size += InitData->SrbExtensionSize;
+
+    Request = ExAllocatePoolWithTag(NonPagedPool, Size, TAG_REQUEST);
+    if (Request == NULL)
+        return NULL;
+
+    RtlZeroMemory(Request, Size);
+
+    Request->Irp = Irp;
+    Request->Srb = Srb;
+    Request->OriginalDataBuffer = Srb->DataBuffer;
+
+    if (InitData->SrbExtensionSize != 0)
+        Srb->SrbExtension = (PUCHAR)Request + SrbExtensionOffset;
+
+    if (Pages == 0)
+        return Request;
+
+    /* Check whether the data buffer is described by the MDL of the IRP */
+    if (Irp->MdlAddress != NULL)
+    {
+        MdlStart = (ULONG_PTR)MmGetMdlVirtualAddress(Irp->MdlAddress);
+        if ((ULONG_PTR)Srb->DataBuffer >= MdlStart &&
+            (ULONG_PTR)Srb->DataBuffer + Srb->DataTransferLength <= MdlStart + MmGetMdlByteCount(Irp->MdlAddress))
+        {
+            Mdl = Irp->MdlAddress;
+        }
+    }
+
+    Request->ScatterGatherList = (PSTOR_SCATTER_GATHER_LIST)(Request + 1);
+    PortBuildScatterGatherList(Request, Mdl);
+
+    /* Give the miniport a system address if it wants to touch the data */
+    if (Mdl != NULL &&
+        (InitData->MapBuffers == STOR_MAP_ALL_BUFFERS ||
+         (InitData->MapBuffers == STOR_MAP_NON_READ_WRITE_BUFFERS && !PortIsReadWriteRequest(Srb))))
+    {
+        MdlStart = (ULONG_PTR)MmGetSystemAddressForMdlSafe(Mdl, HighPagePriority);
+        if (MdlStart == 0)
+        {
+            ExFreePoolWithTag(Request, TAG_REQUEST);
+            return NULL;
+        }
+
+        Srb->DataBuffer = (PUCHAR)MdlStart +
+                          ((ULONG_PTR)Srb->DataBuffer - (ULONG_PTR)MmGetMdlVirtualAddress(Mdl));
+    }
+
+    return Request;
+}
+
+
+static
+VOID
+PortCompleteIrp(
+    _In_ PPORT_REQUEST Request)
+{
+    PSCSI_REQUEST_BLOCK Srb = Request->Srb;
+    PIRP Irp = Request->Irp;
+    NTSTATUS Status;
+
+    switch (SRB_STATUS(Srb->SrbStatus))
+    {
+        case SRB_STATUS_SUCCESS:
+        case SRB_STATUS_DATA_OVERRUN:
+            Status = STATUS_SUCCESS;
+            break;
+
+        case SRB_STATUS_BUSY:
+            Status = STATUS_DEVICE_BUSY;
+            break;
+
+        case SRB_STATUS_INVALID_REQUEST:
+            Status = STATUS_INVALID_DEVICE_REQUEST;
+            break;
+
+        case SRB_STATUS_NO_DEVICE:
+        case SRB_STATUS_SELECTION_TIMEOUT:
+            Status = STATUS_DEVICE_DOES_NOT_EXIST;
+            break;
+
+        default:
+            Status = STATUS_IO_DEVICE_ERROR;
+            break;
+    }
+
+    Srb->DataBuffer = Request->OriginalDataBuffer;
+    Srb->SrbExtension = NULL;
+    Irp->Tail.Overlay.DriverContext[0] = NULL;
+
+    ExFreePoolWithTag(Request, TAG_REQUEST);
+
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information = NT_SUCCESS(Status) ? Srb->DataTransferLength : 0;
+    IoCompleteRequest(Irp, IO_DISK_INCREMENT);
+}
+
+
+static
+VOID
+NTAPI
+PortCompletionDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PPORT_COMPLETION_QUEUE Queue = DeferredContext;
+    PSLIST_ENTRY Entry, NextEntry;
+
+    /* Complete everything the miniport finished since the last run */
+    Entry = InterlockedFlushSList(&Queue->CompletedRequests);
+    while (Entry != NULL)
+    {
+        NextEntry = Entry->Next;
+        PortCompleteIrp(CONTAINING_RECORD(Entry, PORT_REQUEST, CompletionEntry));
+        Entry = NextEntry;
+    }
+}
+
+
+static
+VOID
+PortQueueCompletion(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PPORT_REQUEST Request)
+{
+    PPORT_COMPLETION_QUEUE Queue;
+    ULONG Processor;
+
+    /* Complete on the processor which issued the request if asked to */
+    if (DeviceExtension->PerfFlags & STOR_PERF_DPC_REDIRECTION)
+        Processor = Request->Processor;
+    else
+        Processor = KeGetCurrentProcessorNumber();
+
+    if (Processor >= DeviceExtension->CompletionQueueCount)
+        Processor = 0;
+
+    Queue = &DeviceExtension->CompletionQueues[Processor];
+    InterlockedPushEntrySList(&Queue->CompletedRequests, &Request->CompletionEntry);
+    KeInsertQueueDpc(&Queue->Dpc, NULL, NULL);
+}
+
+
+NTSTATUS
+PortInitializeRequestQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPORT_COMPLETION_QUEUE Queue;
+    ULONG i;
+
+    DPRINT1("PortInitializeRequestQueues(%p)\n", DeviceExtension);
+
+    KeInitializeSpinLock(&DeviceExtension->StartIoLock);
+    DeviceExtension->PerfFlags = 0;
+    DeviceExtension->ConcurrentChannels = 1;
+
+    if (DeviceExtension->CompletionQueues != NULL)
+        return STATUS_SUCCESS;
+
+    DeviceExtension->CompletionQueues = ExAllocatePoolWithTag(NonPagedPool,
+                                                              KeNumberProcessors * sizeof(PORT_COMPLETION_QUEUE),
+                                                              TAG_COMPLETION);
+    if (DeviceExtension->CompletionQueues == NULL)
+        return STATUS_NO_MEMORY;
+
+    DeviceExtension->CompletionQueueCount = KeNumberProcessors;
+
+    for (i = 0; i < DeviceExtension->CompletionQueueCount; i++)
+    {
+        Queue = &DeviceExtension->CompletionQueues[i];
+        InitializeSListHead(&Queue->CompletedRequests);
+        KeInitializeDpc(&Queue->Dpc, PortCompletionDpcRoutine, Queue);
+        KeSetTargetProcessorDpc(&Queue->Dpc, (CCHAR)i);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+PortStartRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PMINIPORT Miniport = &DeviceExtension->Miniport;
+    PVOID HwDeviceExtension = &Miniport->MiniportExtension->HwDeviceExtension;
+    PPORT_REQUEST Request;
+    BOOLEAN Result = TRUE;
+    KIRQL OldIrql;
+
+    DPRINT("PortStartRequest(%p %p %p)\n", DeviceExtension, Irp, Srb);
+
+    if (DeviceExtension->PnpState != dsStarted)
+    {
+        Srb->SrbStatus = SRB_STATUS_NO_DEVICE;
+        Irp->IoStatus.Information = 0;
+        Irp->IoStatus.Status = STATUS_DEVICE_DOES_NOT_EXIST;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return STATUS_DEVICE_DOES_NOT_EXIST;
+    }
+
+    Request = PortAllocateRequest(DeviceExtension, Irp, Srb);
+    if (Request == NULL)
+    {
+        Srb->SrbStatus = SRB_STATUS_INTERNAL_ERROR;
+        Irp->IoStatus.Information = 0;
+        Irp->IoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Srb->OriginalRequest = Irp;
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+    Irp->Tail.Overlay.DriverContext[0] = Request;
+    IoMarkIrpPending(Irp);
+
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
+    Request->Processor = KeGetCurrentProcessorNumber();
+
+    /* HwBuildIo runs without any lock held and may complete the request itself */
+    if (Miniport->InitData->HwBuildIo != NULL &&
+        !Miniport->InitData->HwBuildIo(HwDeviceExtension, Srb))
+    {
+        PortQueueCompletion(DeviceExtension, Request);
+    }
+    else if (DeviceExtension->PerfFlags & STOR_PERF_CONCURRENT_CHANNELS)
+    {
+        /* The miniport synchronizes its channels itself */
+        Result = MiniportStartIo(Miniport, Srb);
+    }
+    else
+    {
+        KeAcquireSpinLockAtDpcLevel(&DeviceExtension->StartIoLock);
+        Result = MiniportStartIo(Miniport, Srb);
+        KeReleaseSpinLockFromDpcLevel(&DeviceExtension->StartIoLock);
+    }
+
+    if (!Result)
+    {
+        /* Let the class driver retry it */
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        PortQueueCompletion(DeviceExtension, Request);
+    }
+
+    KeLowerIrql(OldIrql);
+
+    return STATUS_PENDING;
+}
+
+
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request;
+
+    Request = PortGetRequest(Srb);
+    if (Request == NULL)
+    {
+        DPRINT1("Completed SRB %p was not started by the port\n", Srb);
+        return;
+    }
+
+    PortQueueCompletion(DeviceExtension, Request);
+}
+
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request;
+
+    Request = PortGetRequest(Srb);
+    if (Request == NULL)
+        return NULL;
+
+    return Request->ScatterGatherList;
+}
+
+
+ULONG
+PortInitializePerfOpts(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ BOOLEAN Query,
+    _Inout_ PPERF_CONFIGURATION_DATA PerfConfigData)
+{
+    DPRINT1("PortInitializePerfOpts(%p %u %p)\n",
+            DeviceExtension, Query, PerfConfigData);
+
+    if (PerfConfigData == NULL)
+        return STOR_STATUS_INVALID_PARAMETER;
+
+    if (PerfConfigData->Version == 0 || PerfConfigData->Version > STOR_PERF_VERSION)
+        return STOR_STATUS_UNSUPPORTED_VERSION;
+
+    if (PerfConfigData->Size < FIELD_OFFSET(PERF_CONFIGURATION_DATA, FirstRedirectionMessageNumber))
+        return STOR_STATUS_INVALID_BUFFER_SIZE;
+
+    if (Query)
+    {
+        PerfConfigData->Flags = PORT_SUPPORTED_PERF_FLAGS;
+        PerfConfigData->ConcurrentChannels = KeNumberProcessors;
+        return STOR_STATUS_SUCCESS;
+    }
+
+    if (PerfConfigData->Flags & ~PORT_SUPPORTED_PERF_FLAGS)
+        return STOR_STATUS_INVALID_PARAMETER;
+
+    if (PerfConfigData->Flags & STOR_PERF_CONCURRENT_CHANNELS)
+    {
+        if (PerfConfigData->ConcurrentChannels == 0)
+            return STOR_STATUS_INVALID_PARAMETER;
+
+        DeviceExtension->ConcurrentChannels = min(PerfConfigData->ConcurrentChannels,
+                                                  (ULONG)KeNumberProcessors);
+    }
+    else
+    {
+        DeviceExtension->ConcurrentChannels = 1;
+    }
+
+    /* Completing on the current processor is what we do anyway */
+    DeviceExtension->PerfFlags = PerfConfigData->Flags & ~STOR_PERF_DPC_REDIRECTION_CURRENT_CPU;
+
+    return STOR_STATUS_SUCCESS;
+}
+
+
+ULONG
+PortGetStartIoPerfParams(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Inout_ PSTARTIO_PERFORMANCE_PARAMETERS StartIoPerfParams)
+{
+    PPORT_REQUEST Request;
+
+    if (StartIoPerfParams == NULL ||
+        StartIoPerfParams->Size < sizeof(STARTIO_PERFORMANCE_PARAMETERS))
+        return STOR_STATUS_INVALID_PARAMETER;
+
+    Request = PortGetRequest(Srb);
+    if (Request == NULL)
+        return STOR_STATUS_INVALID_PARAMETER;
+
+    /* Message signaled interrupts are not supported, everything uses message 0 */
+    StartIoPerfParams->MessageNumber = 0;
+    StartIoPerfParams->ChannelNumber = Request->Processor % DeviceExtension->ConcurrentChannels;
+
+    return STOR_STATUS_SUCCESS;
+}
+
+/* EOF */
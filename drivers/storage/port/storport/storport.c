@@ -108,7 +108,7 @@ PortAcquireSpinLock(
     PVOID LockContext,
     PSTOR_LOCK_HANDLE LockHandle)
 {
-    DPRINT1("PortAcquireSpinLock(%p %lu %p %p)\n",
+    DPRINT("PortAcquireSpinLock(%p %lu %p %p)\n",
             DeviceExtension, SpinLock, LockContext, LockHandle);
 
     LockHandle->Lock = SpinLock;
@@ -116,15 +116,21 @@ PortAcquireSpinLock(
     switch (SpinLock)
     {
         case DpcLock: /* 1, */
-            DPRINT1("DpcLock\n");
+            DPRINT("DpcLock\n");
+            LockHandle->Context.LockQueue.Lock = &((PSTOR_DPC)LockContext)->Lock;
+            KeAcquireSpinLock((PKSPIN_LOCK)LockHandle->Context.LockQueue.Lock,
+                              &LockHandle->Context.OldIrql);
             break;
 
         case StartIoLock: /* 2 */
-            DPRINT1("StartIoLock\n");
+            DPRINT("StartIoLock\n");
+            LockHandle->Context.LockQueue.Lock = &DeviceExtension->StartIoLock;
+            KeAcquireSpinLock(&DeviceExtension->StartIoLock,
+                              &LockHandle->Context.OldIrql);
             break;
 
         case InterruptLock: /* 3 */
-            DPRINT1("InterruptLock\n");
+            DPRINT("InterruptLock\n");
             if (DeviceExtension->Interrupt == NULL)
                 LockHandle->Context.OldIrql = 0;
             else
@@ -140,21 +146,20 @@ PortReleaseSpinLock(
     PFDO_DEVICE_EXTENSION DeviceExtension,
     PSTOR_LOCK_HANDLE LockHandle)
 {
-    DPRINT1("PortReleaseSpinLock(%p %p)\n",
+    DPRINT("PortReleaseSpinLock(%p %p)\n",
             DeviceExtension, LockHandle);
 
     switch (LockHandle->Lock)
     {
         case DpcLock: /* 1, */
-            DPRINT1("DpcLock\n");
-            break;
-
         case StartIoLock: /* 2 */
-            DPRINT1("StartIoLock\n");
+            DPRINT("DpcLock/StartIoLock\n");
+            KeReleaseSpinLock((PKSPIN_LOCK)LockHandle->Context.LockQueue.Lock,
+                              LockHandle->Context.OldIrql);
             break;
 
         case InterruptLock: /* 3 */
-            DPRINT1("InterruptLock\n");
+            DPRINT("InterruptLock\n");
             if (DeviceExtension->Interrupt != NULL)
                 KeReleaseInterruptSpinLock(DeviceExtension->Interrupt,
                                            LockHandle->Context.OldIrql);
@@ -611,10 +616,57 @@ StorPortExtendedFunction(
     _In_ PVOID HwDeviceExtension,
     ...)
 {
-    DPRINT1("StorPortExtendedFunction(%d %p ...)\n",
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PPERF_CONFIGURATION_DATA PerfConfigData;
+    PSTARTIO_PERFORMANCE_PARAMETERS StartIoPerfParams;
+    PSCSI_REQUEST_BLOCK Srb;
+    BOOLEAN Query;
+    ULONG Status;
+    va_list ap;
+
+    DPRINT("StorPortExtendedFunction(%d %p ...)\n",
             FunctionCode, HwDeviceExtension);
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+
+    if (HwDeviceExtension == NULL)
+        return STOR_STATUS_INVALID_PARAMETER;
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    va_start(ap, HwDeviceExtension);
+
+    switch (FunctionCode)
+    {
+        case ExtFunctionInitializePerformanceOptimizations:
+            Query = (BOOLEAN)va_arg(ap, int);
+            PerfConfigData = (PPERF_CONFIGURATION_DATA)va_arg(ap, PPERF_CONFIGURATION_DATA);
+            Status = PortInitializePerfOpts(DeviceExtension,
+                                            Query,
+                                            PerfConfigData);
+            break;
+
+        case ExtFunctionGetStartIoPerformanceParameters:
+            Srb = (PSCSI_REQUEST_BLOCK)va_arg(ap, PSCSI_REQUEST_BLOCK);
+            StartIoPerfParams = (PSTARTIO_PERFORMANCE_PARAMETERS)va_arg(ap, PSTARTIO_PERFORMANCE_PARAMETERS);
+            Status = PortGetStartIoPerfParams(DeviceExtension,
+                                              Srb,
+                                              StartIoPerfParams);
+            break;
+
+        default:
+            DPRINT1("Unsupported extended function %d\n", FunctionCode);
+            UNIMPLEMENTED;
+            Status = STOR_STATUS_NOT_IMPLEMENTED;
+            break;
+    }
+
+    va_end(ap);
+
+    return Status;
 }
 
 
@@ -799,14 +851,14 @@ StorPortGetPhysicalAddress(
     STOR_PHYSICAL_ADDRESS PhysicalAddress;
     ULONG_PTR Offset;
 
-    DPRINT1("StorPortGetPhysicalAddress(%p %p %p %p)\n",
+    DPRINT("StorPortGetPhysicalAddress(%p %p %p %p)\n",
             HwDeviceExtension, Srb, VirtualAddress, Length);
 
     /* Get the miniport extension */
     MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
                                           MINIPORT_DEVICE_EXTENSION,
                                           HwDeviceExtension);
-    DPRINT1("HwDeviceExtension %p  MiniportExtension %p\n",
+    DPRINT("HwDeviceExtension %p  MiniportExtension %p\n",
             HwDeviceExtension, MiniportExtension);
 
     DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
@@ -823,22 +875,16 @@ StorPortGetPhysicalAddress(
         return PhysicalAddress;
     }
 
-    // FIXME
-
-
+    /* Otherwise the address is only known to be contiguous up to the end of its page */
     PhysicalAddress = MmGetPhysicalAddress(VirtualAddress);
-    *Length = 1;
-//    UNIMPLEMENTED;
-
-//    *Length = 0;
-//    PhysicalAddress.QuadPart = (LONGLONG)0;
+    *Length = PAGE_SIZE - BYTE_OFFSET(VirtualAddress);
 
     return PhysicalAddress;
 }
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 PSTOR_SCATTER_GATHER_LIST
@@ -847,9 +893,9 @@ StorPortGetScatterGatherList(
     _In_ PVOID DeviceExtension,
     _In_ PSCSI_REQUEST_BLOCK Srb)
 {
-    DPRINT1("StorPortGetScatterGatherList()\n");
-    UNIMPLEMENTED;
-    return NULL;
+    DPRINT("StorPortGetScatterGatherList(%p %p)\n", DeviceExtension, Srb);
+
+    return PortGetScatterGatherList(Srb);
 }
 
 
@@ -1102,6 +1148,8 @@ StorPortNotification(
     PBOOLEAN Result;
     PSTOR_DPC Dpc;
     PHW_DPC_ROUTINE HwDpcRoutine;
+    PVOID SystemArgument1, SystemArgument2;
+    PLONG Succ;
     va_list ap;
 
     STOR_SPINLOCK SpinLock;
@@ -1109,7 +1157,7 @@ StorPortNotification(
     PSTOR_LOCK_HANDLE LockHandle;
     PSCSI_REQUEST_BLOCK Srb;
 
-    DPRINT1("StorPortNotification(%x %p)\n",
+    DPRINT("StorPortNotification(%x %p)\n",
             NotificationType, HwDeviceExtension);
 
     /* Get the miniport extension */
@@ -1118,7 +1166,7 @@ StorPortNotification(
         MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
                                               MINIPORT_DEVICE_EXTENSION,
                                               HwDeviceExtension);
-        DPRINT1("HwDeviceExtension %p  MiniportExtension %p\n",
+        DPRINT("HwDeviceExtension %p  MiniportExtension %p\n",
                 HwDeviceExtension, MiniportExtension);
 
         DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
@@ -1129,14 +1177,11 @@ StorPortNotification(
     switch (NotificationType)
     {
         case RequestComplete:
-            DPRINT1("RequestComplete\n");
+            DPRINT("RequestComplete\n");
             Srb = (PSCSI_REQUEST_BLOCK)va_arg(ap, PSCSI_REQUEST_BLOCK);
-            DPRINT1("Srb %p\n", Srb);
-            if (Srb->OriginalRequest != NULL)
-            {
-                DPRINT1("Need to complete the IRP!\n");
-
-            }
+            DPRINT("Srb %p\n", Srb);
+            if (DeviceExtension != NULL)
+                PortRequestComplete(DeviceExtension, Srb);
             break;
 
         case GetExtendedFunctionTable:
@@ -1171,18 +1216,29 @@ StorPortNotification(
 
             KeInitializeDpc((PRKDPC)&Dpc->Dpc,
                             (PKDEFERRED_ROUTINE)HwDpcRoutine,
-                            (PVOID)DeviceExtension);
+                            HwDeviceExtension);
             KeInitializeSpinLock(&Dpc->Lock);
             break;
 
+        case IssueDpc:
+            DPRINT("IssueDpc\n");
+            Dpc = (PSTOR_DPC)va_arg(ap, PSTOR_DPC);
+            SystemArgument1 = (PVOID)va_arg(ap, PVOID);
+            SystemArgument2 = (PVOID)va_arg(ap, PVOID);
+            Succ = (PLONG)va_arg(ap, PLONG);
+            *Succ = KeInsertQueueDpc((PRKDPC)&Dpc->Dpc,
+                                     SystemArgument1,
+                                     SystemArgument2);
+            break;
+
         case AcquireSpinLock:
-            DPRINT1("AcquireSpinLock\n");
+            DPRINT("AcquireSpinLock\n");
             SpinLock = (STOR_SPINLOCK)va_arg(ap, STOR_SPINLOCK);
-            DPRINT1("SpinLock %lu\n", SpinLock);
+            DPRINT("SpinLock %lu\n", SpinLock);
             LockContext = (PVOID)va_arg(ap, PVOID);
-            DPRINT1("LockContext %p\n", LockContext);
+            DPRINT("LockContext %p\n", LockContext);
             LockHandle = (PSTOR_LOCK_HANDLE)va_arg(ap, PSTOR_LOCK_HANDLE);
-            DPRINT1("LockHandle %p\n", LockHandle);
+            DPRINT("LockHandle %p\n", LockHandle);
             PortAcquireSpinLock(DeviceExtension,
                                 SpinLock,
                                 LockContext,
@@ -1190,9 +1246,9 @@ StorPortNotification(
             break;
 
         case ReleaseSpinLock:
-            DPRINT1("ReleaseSpinLock\n");
+            DPRINT("ReleaseSpinLock\n");
             LockHandle = (PSTOR_LOCK_HANDLE)va_arg(ap, PSTOR_LOCK_HANDLE);
-            DPRINT1("LockHandle %p\n", LockHandle);
+            DPRINT("LockHandle %p\n", LockHandle);
             PortReleaseSpinLock(DeviceExtension,
                                 LockHandle);
             break;
@@ -2183,8 +2183,6 @@ EHCI_BulkTransfer(IN PEHCI_EXTENSION EhciExtension,
             TD->HwTD.AlternateNextTD = EhciEndpoint->HcdTailP->PhysicalAddress;
             TD->AltNextHcdTD = EhciEndpoint->HcdTailP;
 
-            TD->HwTD.Token.InterruptOnComplete = 1;
-
             if (TransferParameters->TransferFlags & USBD_TRANSFER_DIRECTION_IN)
                 TD->HwTD.Token.PIDCode = EHCI_TD_TOKEN_PID_IN;
             else
@@ -2203,6 +2201,10 @@ EHCI_BulkTransfer(IN PEHCI_EXTENSION EhciExtension,
 
             PrevTD = TD;
         }
+
+        /* Interrupt once for the whole chain, a short packet or an error
+           interrupts anyway (USBINT/USBERRINT) */
+        TD->HwTD.Token.InterruptOnComplete = 1;
     }
     else
     {
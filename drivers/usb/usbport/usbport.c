@@ -765,6 +765,7 @@ USBPORT_FlushDoneTransfers(IN PDEVICE_OBJECT FdoDevice)
 {
     PUSBPORT_DEVICE_EXTENSION FdoExtension;
     PLIST_ENTRY DoneTransferList;
+    LIST_ENTRY List;
     PUSBPORT_TRANSFER Transfer;
     PUSBPORT_ENDPOINT Endpoint;
     ULONG TransferCount;
@@ -783,15 +784,23 @@ USBPORT_FlushDoneTransfers(IN PDEVICE_OBJECT FdoDevice)
         if (IsListEmpty(DoneTransferList))
             break;
 
-        Transfer = CONTAINING_RECORD(DoneTransferList->Flink,
-                                     USBPORT_TRANSFER,
-                                     TransferLink);
+        /* Take all transfers completed so far at once */
+        List.Flink = DoneTransferList->Flink;
+        List.Blink = DoneTransferList->Blink;
+        List.Flink->Blink = &List;
+        List.Blink->Flink = &List;
+        InitializeListHead(DoneTransferList);
 
-        RemoveHeadList(DoneTransferList);
         KeReleaseSpinLock(&FdoExtension->DoneTransferSpinLock, OldIrql);
 
-        if (Transfer)
+        while (!IsListEmpty(&List))
         {
+            Transfer = CONTAINING_RECORD(List.Flink,
+                                         USBPORT_TRANSFER,
+                                         TransferLink);
+
+            RemoveHeadList(&List);
+
             Endpoint = Transfer->Endpoint;
 
             if ((Transfer->Flags & TRANSFER_FLAG_SPLITED))
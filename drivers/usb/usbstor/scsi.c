@@ -272,6 +272,45 @@ USBSTOR_SendCSWRequest(
 
 IO_COMPLETION_ROUTINE USBSTOR_DataCompletionRoutine;
 
+static
+NTSTATUS
+USBSTOR_IssueDataRequest(
+    IN PIRP_CONTEXT Context,
+    IN PIRP Irp,
+    IN PSCSI_REQUEST_BLOCK Request)
+{
+    ULONG TransferLength;
+    PVOID TransferBuffer = NULL;
+
+    // the next piece of the data phase
+    TransferLength = min(Request->DataTransferLength - Context->TransferOffset,
+                         USBSTOR_MAX_URB_TRANSFER_LENGTH);
+
+    if (!Context->TransferMdl)
+    {
+        // sense request, usbport allocates the mdl itself
+        TransferBuffer = (PUCHAR)Request->DataBuffer + Context->TransferOffset;
+    }
+    else if (Context->TransferMdl != Irp->MdlAddress)
+    {
+        MmPrepareMdlForReuse(Context->TransferMdl);
+        IoBuildPartialMdl(Irp->MdlAddress,
+                          Context->TransferMdl,
+                          (PUCHAR)Request->DataBuffer + Context->TransferOffset,
+                          TransferLength);
+    }
+
+    return USBSTOR_IssueBulkOrInterruptRequest(Context->FDODeviceExtension,
+                                               Irp,
+                                               Context->DataPipeHandle,
+                                               Context->DataTransferFlags,
+                                               TransferLength,
+                                               TransferBuffer,
+                                               Context->TransferMdl,
+                                               USBSTOR_DataCompletionRoutine,
+                                               Context);
+}
+
 NTSTATUS
 NTAPI
 USBSTOR_DataCompletionRoutine(
@@ -283,6 +322,7 @@ USBSTOR_DataCompletionRoutine(
     PIO_STACK_LOCATION IoStack;
     PSCSI_REQUEST_BLOCK Request;
     PPDO_DEVICE_EXTENSION PDODeviceExtension;
+    ULONG TransferLength;
 
     DPRINT("USBSTOR_DataCompletionRoutine Irp %p Ctx %p Status %x\n", Irp, Ctx, Irp->IoStatus.Status);
 
@@ -291,16 +331,35 @@ USBSTOR_DataCompletionRoutine(
     Request = IoStack->Parameters.Scsi.Srb;
     PDODeviceExtension = (PPDO_DEVICE_EXTENSION)IoStack->DeviceObject->DeviceExtension;
 
-    // for Sense Request a partial MDL was already freed (if existed)
-    if (Request == Context->FDODeviceExtension->ActiveSrb &&
-        Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferMDL != Irp->MdlAddress)
+    if (NT_SUCCESS(Irp->IoStatus.Status))
+    {
+        TransferLength = min(Request->DataTransferLength - Context->TransferOffset,
+                             USBSTOR_MAX_URB_TRANSFER_LENGTH);
+        Context->TransferOffset += Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength;
+
+        // chain the next piece, unless the device ended the data phase early
+        if (Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength == TransferLength &&
+            Context->TransferOffset < Request->DataTransferLength)
+        {
+            USBSTOR_IssueDataRequest(Context, Irp, Request);
+            return STATUS_MORE_PROCESSING_REQUIRED;
+        }
+    }
+    else
+    {
+        Context->TransferOffset += Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength;
+    }
+
+    // the data phase is over, a partial MDL isn't needed anymore
+    if (Context->TransferMdl && Context->TransferMdl != Irp->MdlAddress)
     {
-        IoFreeMdl(Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferMDL);
+        IoFreeMdl(Context->TransferMdl);
     }
+    Context->TransferMdl = NULL;
 
     if (NT_SUCCESS(Irp->IoStatus.Status))
     {
-        if (Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength < Request->DataTransferLength)
+        if (Context->TransferOffset < Request->DataTransferLength)
         {
             Request->SrbStatus = SRB_STATUS_DATA_OVERRUN;
         }
@@ -309,7 +368,7 @@ USBSTOR_DataCompletionRoutine(
             Request->SrbStatus = SRB_STATUS_SUCCESS;
         }
 
-        Request->DataTransferLength = Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength;
+        Request->DataTransferLength = Context->TransferOffset;
         USBSTOR_SendCSWRequest(Context, Irp);
     }
     else if (USBD_STATUS(Context->Urb.UrbHeader.Status) == USBD_STATUS(USBD_STATUS_STALL_PID))
@@ -317,7 +376,7 @@ USBSTOR_DataCompletionRoutine(
         ++Context->StallRetryCount;
 
         Request->SrbStatus = SRB_STATUS_DATA_OVERRUN;
-        Request->DataTransferLength = Context->Urb.UrbBulkOrInterruptTransfer.TransferBufferLength;
+        Request->DataTransferLength = Context->TransferOffset;
 
         // clear stall and resend cbw
         USBSTOR_QueueResetPipe(Context->FDODeviceExtension, Context);
@@ -351,10 +410,7 @@ USBSTOR_CBWCompletionRoutine(
     PIO_STACK_LOCATION IoStack;
     PSCSI_REQUEST_BLOCK Request;
     PPDO_DEVICE_EXTENSION PDODeviceExtension;
-    USBD_PIPE_HANDLE PipeHandle;
-    ULONG TransferFlags;
     PMDL Mdl = NULL;
-    PVOID TransferBuffer = NULL;
 
     DPRINT("USBSTOR_CBWCompletionRoutine Irp %p Ctx %p Status %x\n", Irp, Ctx, Irp->IoStatus.Status);
 
@@ -381,13 +437,13 @@ USBSTOR_CBWCompletionRoutine(
 
     if ((Request->SrbFlags & SRB_FLAGS_UNSPECIFIED_DIRECTION) == SRB_FLAGS_DATA_IN)
     {
-        PipeHandle = Context->FDODeviceExtension->InterfaceInformation->Pipes[Context->FDODeviceExtension->BulkInPipeIndex].PipeHandle;
-        TransferFlags = USBD_TRANSFER_DIRECTION_IN | USBD_SHORT_TRANSFER_OK;
+        Context->DataPipeHandle = Context->FDODeviceExtension->InterfaceInformation->Pipes[Context->FDODeviceExtension->BulkInPipeIndex].PipeHandle;
+        Context->DataTransferFlags = USBD_TRANSFER_DIRECTION_IN | USBD_SHORT_TRANSFER_OK;
     }
     else if ((Request->SrbFlags & SRB_FLAGS_UNSPECIFIED_DIRECTION) == SRB_FLAGS_DATA_OUT)
     {
-        PipeHandle = Context->FDODeviceExtension->InterfaceInformation->Pipes[Context->FDODeviceExtension->BulkOutPipeIndex].PipeHandle;
-        TransferFlags = USBD_TRANSFER_DIRECTION_OUT;
+        Context->DataPipeHandle = Context->FDODeviceExtension->InterfaceInformation->Pipes[Context->FDODeviceExtension->BulkOutPipeIndex].PipeHandle;
+        Context->DataTransferFlags = USBD_TRANSFER_DIRECTION_OUT;
     }
     else
     {
@@ -399,25 +455,20 @@ USBSTOR_CBWCompletionRoutine(
     // if it is not a Sense Request
     if (Request == Context->FDODeviceExtension->ActiveSrb)
     {
-        if (MmGetMdlVirtualAddress(Irp->MdlAddress) == Request->DataBuffer)
+        if (MmGetMdlVirtualAddress(Irp->MdlAddress) == Request->DataBuffer &&
+            Request->DataTransferLength <= USBSTOR_MAX_URB_TRANSFER_LENGTH)
         {
             Mdl = Irp->MdlAddress;
         }
         else
         {
+            // the pieces all start at the same page offset as the first one,
+            // so an MDL big enough for it fits any of them
             Mdl = IoAllocateMdl(Request->DataBuffer,
-                                Request->DataTransferLength,
+                                min(Request->DataTransferLength, USBSTOR_MAX_URB_TRANSFER_LENGTH),
                                 FALSE,
                                 FALSE,
                                 NULL);
-
-            if (Mdl)
-            {
-                IoBuildPartialMdl(Irp->MdlAddress,
-                                  Mdl,
-                                  Request->DataBuffer,
-                                  Request->DataTransferLength);
-            }
         }
 
         if (!Mdl)
@@ -429,18 +480,11 @@ USBSTOR_CBWCompletionRoutine(
     else
     {
         ASSERT(Request->DataBuffer);
-        TransferBuffer = Request->DataBuffer;
     }
 
-    USBSTOR_IssueBulkOrInterruptRequest(Context->FDODeviceExtension,
-                                        Irp,
-                                        PipeHandle,
-                                        TransferFlags,
-                                        Request->DataTransferLength,
-                                        TransferBuffer,
-                                        Mdl,
-                                        USBSTOR_DataCompletionRoutine,
-                                        Context);
+    Context->TransferMdl = Mdl;
+    Context->TransferOffset = 0;
+    USBSTOR_IssueDataRequest(Context, Irp, Request);
 
     return STATUS_MORE_PROCESSING_REQUIRED;
 
@@ -503,6 +547,8 @@ USBSTOR_SendCBWRequest(
     Context->Irp = Irp;
     Context->FDODeviceExtension = FDODeviceExtension;
     Context->StallRetryCount = 0;
+    Context->TransferMdl = NULL;
+    Context->TransferOffset = 0;
 
     return USBSTOR_IssueBulkOrInterruptRequest(
         FDODeviceExtension,
@@ -9,7 +9,8 @@
 
 #define USB_STOR_TAG 'sbsu'
 #define USB_MAXCHILDREN              (16)
-#define USBSTOR_DEFAULT_MAX_TRANSFER_LENGTH 0x10000
+#define USBSTOR_DEFAULT_MAX_TRANSFER_LENGTH 0x40000
+#define USBSTOR_MAX_URB_TRANSFER_LENGTH     0x10000 // data phase is split into bulk URBs of this size
 
 #define HTONS(n) (((((unsigned short)(n) & 0xFF)) << 8) | (((unsigned short)(n) & 0xFF00) >> 8))
 #define NTOHS(n) (((((unsigned short)(n) & 0xFF)) << 8) | (((unsigned short)(n) & 0xFF00) >> 8))
@@ -299,6 +300,10 @@ typedef struct
     PFDO_DEVICE_EXTENSION FDODeviceExtension;
     ULONG ErrorIndex;
     ULONG StallRetryCount;                                            // the number of retries after receiving USBD_STATUS_STALL_PID status
+    PMDL TransferMdl;                                                 // mdl of the data phase, NULL for a sense request
+    ULONG TransferOffset;                                             // bytes of the data phase already transferred
+    USBD_PIPE_HANDLE DataPipeHandle;                                  // pipe of the data phase
+    ULONG DataTransferFlags;                                          // transfer flags of the data phase
     union
     {
         CBW cbw;
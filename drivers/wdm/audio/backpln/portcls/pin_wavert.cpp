@@ -68,9 +68,14 @@ protected:
     MEMORY_CACHING_TYPE m_CacheType;
     PMDL m_Mdl;
 
+    PVOID m_UserMapping;
+    PEPROCESS m_UserProcess;
+
     LONG m_Ref;
 
     NTSTATUS NTAPI HandleKsProperty(IN PIRP Irp);
+    NTSTATUS NTAPI MapAudioBuffer(OUT PKSRTAUDIO_BUFFER Buffer);
+    VOID NTAPI UnmapAudioBuffer();
     NTSTATUS NTAPI HandleKsStream(IN PIRP Irp);
     VOID NTAPI SetStreamState(IN KSSTATE State);
     friend VOID NTAPI SetStreamWorkerRoutine(IN PDEVICE_OBJECT  DeviceObject, IN PVOID  Context);
@@ -108,6 +113,79 @@ CPortPinWaveRT::QueryInterface(
 
 //==================================================================================================================================
 
+NTSTATUS
+NTAPI
+CPortPinWaveRT::MapAudioBuffer(
+    OUT PKSRTAUDIO_BUFFER Buffer)
+{
+    PVOID Mapping;
+
+    if (!m_Mdl)
+        return STATUS_UNSUCCESSFUL;
+
+    if (m_UserMapping)
+    {
+        // the cyclic buffer is handed out to one client only
+        if (m_UserProcess != PsGetCurrentProcess())
+            return STATUS_DEVICE_BUSY;
+    }
+    else
+    {
+        _SEH2_TRY
+        {
+            Mapping = MmMapLockedPagesSpecifyCache(m_Mdl, UserMode, m_CacheType, NULL, FALSE, NormalPagePriority);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Mapping = NULL;
+        }
+        _SEH2_END;
+
+        if (!Mapping)
+        {
+            DPRINT("Failed to map audio buffer into the client\n");
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        m_UserMapping = Mapping;
+        m_UserProcess = PsGetCurrentProcess();
+        ObReferenceObject(m_UserProcess);
+    }
+
+    Buffer->BufferAddress = (PUCHAR)m_UserMapping + m_CommonBufferOffset;
+    Buffer->ActualBufferSize = m_CommonBufferSize;
+    Buffer->CallMemoryBarrier = (m_CacheType == MmWriteCombined);
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+CPortPinWaveRT::UnmapAudioBuffer()
+{
+    KAPC_STATE ApcState;
+
+    if (!m_UserMapping)
+        return;
+
+    // the mapping lives in the client's address space
+    if (m_UserProcess != PsGetCurrentProcess())
+    {
+        KeStackAttachProcess(m_UserProcess, &ApcState);
+        MmUnmapLockedPages(m_UserMapping, m_Mdl);
+        KeUnstackDetachProcess(&ApcState);
+    }
+    else
+    {
+        MmUnmapLockedPages(m_UserMapping, m_Mdl);
+    }
+
+    ObDereferenceObject(m_UserProcess);
+    m_UserProcess = NULL;
+    m_UserMapping = NULL;
+}
+
+//==================================================================================================================================
+
 NTSTATUS
 NTAPI
 CPortPinWaveRT::NewIrpTarget(
@@ -274,6 +352,60 @@ CPortPinWaveRT::HandleKsProperty(
         }
 
     }
+    else if (IsEqualGUIDAligned(Property->Set, KSPROPSETID_RtAudio) && (Property->Flags & KSPROPERTY_TYPE_GET))
+    {
+        if (Property->Id == KSPROPERTY_RTAUDIO_BUFFER)
+        {
+            if (IoStack->Parameters.DeviceIoControl.InputBufferLength < sizeof(KSRTAUDIO_BUFFER_PROPERTY) ||
+                IoStack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(KSRTAUDIO_BUFFER))
+            {
+                Irp->IoStatus.Information = sizeof(KSRTAUDIO_BUFFER);
+                Irp->IoStatus.Status = STATUS_BUFFER_TOO_SMALL;
+                IoCompleteRequest(Irp, IO_NO_INCREMENT);
+                return STATUS_BUFFER_TOO_SMALL;
+            }
+
+            // the buffer was sized when the stream was created, RequestedBufferSize is only a hint
+            Status = MapAudioBuffer((PKSRTAUDIO_BUFFER)Irp->UserBuffer);
+            Irp->IoStatus.Information = NT_SUCCESS(Status) ? sizeof(KSRTAUDIO_BUFFER) : 0;
+            Irp->IoStatus.Status = Status;
+            IoCompleteRequest(Irp, IO_NO_INCREMENT);
+            return Status;
+        }
+        else if (Property->Id == KSPROPERTY_RTAUDIO_HWLATENCY && m_Stream)
+        {
+            if (IoStack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(KSRTAUDIO_HWLATENCY))
+            {
+                Irp->IoStatus.Information = sizeof(KSRTAUDIO_HWLATENCY);
+                Irp->IoStatus.Status = STATUS_BUFFER_TOO_SMALL;
+                IoCompleteRequest(Irp, IO_NO_INCREMENT);
+                return STATUS_BUFFER_TOO_SMALL;
+            }
+
+            m_Stream->GetHWLatency((PKSRTAUDIO_HWLATENCY)Irp->UserBuffer);
+            Irp->IoStatus.Information = sizeof(KSRTAUDIO_HWLATENCY);
+            Irp->IoStatus.Status = STATUS_SUCCESS;
+            IoCompleteRequest(Irp, IO_NO_INCREMENT);
+            return STATUS_SUCCESS;
+        }
+    }
+    else if (IsEqualGUIDAligned(Property->Set, KSPROPSETID_Audio) && Property->Id == KSPROPERTY_AUDIO_POSITION &&
+             (Property->Flags & KSPROPERTY_TYPE_GET) && m_Stream)
+    {
+        if (IoStack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(KSAUDIO_POSITION))
+        {
+            Irp->IoStatus.Information = sizeof(KSAUDIO_POSITION);
+            Irp->IoStatus.Status = STATUS_BUFFER_TOO_SMALL;
+            IoCompleteRequest(Irp, IO_NO_INCREMENT);
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        Status = m_Stream->GetPosition((PKSAUDIO_POSITION)Irp->UserBuffer);
+        Irp->IoStatus.Information = NT_SUCCESS(Status) ? sizeof(KSAUDIO_POSITION) : 0;
+        Irp->IoStatus.Status = Status;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return Status;
+    }
     RtlStringFromGUID(Property->Set, &GuidString);
     DPRINT("Unhandled property Set |%S| Id %u Flags %x\n", GuidString.Buffer, Property->Id, Property->Flags);
     RtlFreeUnicodeString(&GuidString);
@@ -443,6 +575,9 @@ CPortPinWaveRT::Close(
 {
     PCLOSESTREAM_CONTEXT Ctx;
 
+    // still in the caller's context here, unlike the work item below
+    UnmapAudioBuffer();
+
     if (m_Stream)
     {
         Ctx = (PCLOSESTREAM_CONTEXT)AllocateItem(NonPagedPool, sizeof(CLOSESTREAM_CONTEXT), TAG_PORTCLASS);
@@ -521,7 +656,55 @@ CPortPinWaveRT::FastDeviceIoControl(
     OUT PIO_STATUS_BLOCK StatusBlock,
     IN PDEVICE_OBJECT DeviceObject)
 {
-    return FALSE;
+    KSPROPERTY Property;
+    KSAUDIO_POSITION Position;
+
+    // clients poll the position of a mapped buffer constantly, answer that without building an irp
+    if (IoControlCode != IOCTL_KS_PROPERTY || !m_Stream ||
+        InputBufferLength < sizeof(KSPROPERTY) || OutputBufferLength < sizeof(KSAUDIO_POSITION))
+    {
+        return FALSE;
+    }
+
+    _SEH2_TRY
+    {
+        if (ExGetPreviousMode() != KernelMode)
+            ProbeForRead(InputBuffer, sizeof(KSPROPERTY), sizeof(ULONG));
+
+        RtlCopyMemory(&Property, InputBuffer, sizeof(KSPROPERTY));
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        _SEH2_YIELD(return FALSE);
+    }
+    _SEH2_END;
+
+    if (!IsEqualGUIDAligned(Property.Set, KSPROPSETID_Audio) ||
+        Property.Id != KSPROPERTY_AUDIO_POSITION || Property.Flags != KSPROPERTY_TYPE_GET)
+    {
+        return FALSE;
+    }
+
+    StatusBlock->Information = 0;
+    StatusBlock->Status = m_Stream->GetPosition(&Position);
+    if (NT_SUCCESS(StatusBlock->Status))
+    {
+        _SEH2_TRY
+        {
+            if (ExGetPreviousMode() != KernelMode)
+                ProbeForWrite(OutputBuffer, sizeof(KSAUDIO_POSITION), sizeof(ULONG));
+
+            RtlCopyMemory(OutputBuffer, &Position, sizeof(KSAUDIO_POSITION));
+            StatusBlock->Information = sizeof(KSAUDIO_POSITION);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            StatusBlock->Status = _SEH2_GetExceptionCode();
+        }
+        _SEH2_END;
+    }
+
+    return TRUE;
 }
 
 BOOLEAN
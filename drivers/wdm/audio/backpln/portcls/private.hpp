@@ -18,6 +18,7 @@
 #include <portcls.h>
 #include <dmusicks.h>
 #include <kcom.h>
+#include <pseh/pseh2.h>
 
 #include "interfaces.hpp"
 
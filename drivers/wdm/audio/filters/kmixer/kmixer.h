@@ -18,6 +18,16 @@ typedef struct
 
 }SUM_NODE_CONTEXT, *PSUM_NODE_CONTEXT;
 
+typedef struct
+{
+    /* input and output format, must stay first */
+    KSDATAFORMAT_WAVEFORMATEX Formats[2];
+
+    /* resampler kept across writes, so the stream has no seams */
+    struct SRC_STATE_tag * SrcState;
+    ULONG SrcChannels;
+}PIN_CONTEXT, *PPIN_CONTEXT;
+
 
 NTSTATUS
 NTAPI
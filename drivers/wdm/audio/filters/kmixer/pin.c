@@ -17,6 +17,7 @@ const GUID KSPROPSETID_Connection              = {0x1D58C920L, 0xAC9B, 0x11CF, {
 
 NTSTATUS
 PerformSampleRateConversion(
+    PPIN_CONTEXT Context,
     PUCHAR Buffer,
     ULONG BufferLength,
     ULONG OldRate,
@@ -78,15 +79,29 @@ PerformSampleRateConversion(
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
+    /* setting up a sinc converter is expensive, reuse the pin's one */
+    State = Context->SrcState;
+    if (State && Context->SrcChannels != NumChannels)
+    {
+        src_delete(State);
+        State = Context->SrcState = NULL;
+    }
+
     if (!State)
     {
-        DPRINT1("src_new failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
+        State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
+        if (!State)
+        {
+            DPRINT1("src_new failed with %x\n", error);
+            KeRestoreFloatingPointState(&FloatSave);
+            ExFreePool(FloatIn);
+            ExFreePool(FloatOut);
+            ExFreePool(ResultOut);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        Context->SrcState = State;
+        Context->SrcChannels = NumChannels;
     }
 
     /* fixme use asm */
@@ -109,6 +124,7 @@ PerformSampleRateConversion(
     Data.input_frames = NumSamples;
     Data.output_frames = NewSamples;
     Data.src_ratio = (double)NewRate / (double)OldRate;
+    Data.end_of_input = 0;
 
     error = src_process(State, &Data);
     if (error)
@@ -146,7 +162,6 @@ PerformSampleRateConversion(
     *ResultLength = Data.output_frames_gen * BytesPerSample * NumChannels;
     ExFreePool(FloatIn);
     ExFreePool(FloatOut);
-    src_delete(State);
     KeRestoreFloatingPointState(&FloatSave);
     return STATUS_SUCCESS;
 }
@@ -441,7 +456,7 @@ Pin_fnDeviceIoControl(
                 PKSDATAFORMAT_WAVEFORMATEX Formats;
                 PKSDATAFORMAT_WAVEFORMATEX WaveFormat;
 
-                Formats = (PKSDATAFORMAT_WAVEFORMATEX)IoStack->FileObject->FsContext2;
+                Formats = (PKSDATAFORMAT_WAVEFORMATEX)IoStack->FileObject->FsContext;
                 WaveFormat = (PKSDATAFORMAT_WAVEFORMATEX)Irp->UserBuffer;
 
                 ASSERT(Property->PinId == 0 || Property->PinId == 1);
@@ -514,7 +529,20 @@ Pin_fnClose(
     PDEVICE_OBJECT DeviceObject,
     PIRP Irp)
 {
-    UNIMPLEMENTED;
+    PIO_STACK_LOCATION IoStack;
+    PPIN_CONTEXT Context;
+
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+    Context = (PPIN_CONTEXT)IoStack->FileObject->FsContext;
+
+    if (Context)
+    {
+        if (Context->SrcState)
+            src_delete(Context->SrcState);
+
+        ExFreePool(Context);
+        IoStack->FileObject->FsContext = NULL;
+    }
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
     Irp->IoStatus.Information = 0;
@@ -609,7 +637,7 @@ Pin_fnFastWrite(
 
     DPRINT("Pin_fnFastWrite called DeviceObject %p Irp %p\n", DeviceObject);
 
-    Formats = (PKSDATAFORMAT_WAVEFORMATEX)FileObject->FsContext2;
+    Formats = (PKSDATAFORMAT_WAVEFORMATEX)FileObject->FsContext;
 
     InputFormat = Formats;
     OutputFormat = (Formats + 1);
@@ -657,7 +685,8 @@ Pin_fnFastWrite(
 
     if (InputFormat->WaveFormatEx.nSamplesPerSec != OutputFormat->WaveFormatEx.nSamplesPerSec)
     {
-        Status = PerformSampleRateConversion(StreamHeader->Data,
+        Status = PerformSampleRateConversion((PPIN_CONTEXT)FileObject->FsContext,
+                                             StreamHeader->Data,
                                              StreamHeader->DataUsed,
                                              InputFormat->WaveFormatEx.nSamplesPerSec,
                                              OutputFormat->WaveFormatEx.nSamplesPerSec,
@@ -701,34 +730,41 @@ CreatePin(
 {
     NTSTATUS Status;
     KSOBJECT_HEADER ObjectHeader;
-    PKSDATAFORMAT DataFormat;
+    PPIN_CONTEXT Context;
     PIO_STACK_LOCATION IoStack;
 
 
-    DataFormat = ExAllocatePool(NonPagedPool, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
-    if (!DataFormat)
+    Context = ExAllocatePool(NonPagedPool, sizeof(PIN_CONTEXT));
+    if (!Context)
         return STATUS_INSUFFICIENT_RESOURCES;
 
-    RtlZeroMemory(DataFormat, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
+    RtlZeroMemory(Context, sizeof(PIN_CONTEXT));
 
     IoStack = IoGetCurrentIrpStackLocation(Irp);
-    IoStack->FileObject->FsContext2 = (PVOID)DataFormat;
+    IoStack->FileObject->FsContext = (PVOID)Context;
 
     /* allocate object header */
     Status = KsAllocateObjectHeader(&ObjectHeader, 0, NULL, Irp, &PinTable);
+    if (!NT_SUCCESS(Status))
+    {
+        IoStack->FileObject->FsContext = NULL;
+        ExFreePool(Context);
+    }
     return Status;
 }
 
 void * calloc(size_t Elements, size_t ElementSize)
 {
-    ULONG Index;
-    PUCHAR Block = ExAllocatePool(NonPagedPool, Elements * ElementSize);
-    if (!Block)
+    PVOID Block;
+
+    if (ElementSize && Elements > ((SIZE_T)-1) / ElementSize)
         return NULL;
 
-    for(Index = 0; Index < Elements * ElementSize; Index++)
-        Block[Index] = 0;
+    Block = ExAllocatePool(NonPagedPool, Elements * ElementSize);
+    if (!Block)
+        return NULL;
 
+    RtlZeroMemory(Block, Elements * ElementSize);
     return Block;
 }
 
@@ -129,7 +129,10 @@ HDA_DpcForIsr(
         /* store response */
         Codec->Responses[Codec->ResponseCount] = Response;
         Codec->ResponseCount++;
-        KeReleaseSemaphore(&Codec->ResponseSemaphore, IO_NO_INCREMENT, 1, FALSE);
+
+        /* wake the sender once its whole batch has been answered */
+        if (Codec->ResponseCount == Codec->ResponsesExpected)
+            KeSetEvent(&Codec->ResponseEvent, IO_NO_INCREMENT, FALSE);
     }
 }
 
@@ -143,40 +146,42 @@ HDA_SendVerbs(
     IN ULONG Count)
 {
     PHDA_FDO_DEVICE_EXTENSION DeviceExtension;
-    ULONG Sent = 0, ReadPosition, WritePosition, Queued;
+    ULONG Sent = 0, ReadPosition, WritePosition;
 
     /* get device extension */
     DeviceExtension = (PHDA_FDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
     ASSERT(DeviceExtension->IsFDO);
 
+    /* responses beyond this are dropped by the dpc */
+    ASSERT(Count <= MAX_CODEC_RESPONSES);
+
     /* reset response count */
     Codec->ResponseCount = 0;
 
     while (Sent < Count) {
         ReadPosition = READ_REGISTER_USHORT((PUSHORT)(DeviceExtension->RegBase + HDAC_CORB_READ_POS));
 
-        Queued = 0;
-
+        /* queue as many verbs as the CORB holds */
         while (Sent < Count) {
             WritePosition = (DeviceExtension->CorbWritePos + 1) % DeviceExtension->CorbLength;
 
             if (WritePosition == ReadPosition) {
                 // There is no space left in the ring buffer; execute the
-                // queued commands and wait until
+                // queued commands and wait until they are answered
                 break;
             }
 
             DeviceExtension->CorbBase[WritePosition] = Verbs[Sent++];
             DeviceExtension->CorbWritePos = WritePosition;
-            Queued++;
         }
 
+        /* hand the whole batch to the controller with a single doorbell write */
+        KeClearEvent(&Codec->ResponseEvent);
+        Codec->ResponsesExpected = Sent;
         WRITE_REGISTER_USHORT((PUSHORT)(DeviceExtension->RegBase + HDAC_CORB_WRITE_POS), DeviceExtension->CorbWritePos);
-    }
 
-    while (Queued--)
-    {
-        KeWaitForSingleObject(&Codec->ResponseSemaphore,
+        /* the dpc signals once every queued verb got its response */
+        KeWaitForSingleObject(&Codec->ResponseEvent,
                               Executive,
                               KernelMode,
                               FALSE,
@@ -212,7 +217,7 @@ HDA_InitCodec(
 
     /* init codec */
     Entry->Addr = codecAddress;
-    KeInitializeSemaphore(&Entry->ResponseSemaphore, 0, MAX_CODEC_RESPONSES);
+    KeInitializeEvent(&Entry->ResponseEvent, NotificationEvent, FALSE);
 
     /* get device extension */
     DeviceExtension = (PHDA_FDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
@@ -373,10 +378,13 @@ HDA_InitCorbRirbPos(
     WRITE_REGISTER_ULONG((PULONG)(DeviceExtension->RegBase + HDAC_RIRB_BASE_LOWER), CorbPhysicalAddress.LowPart);
     WRITE_REGISTER_ULONG((PULONG)(DeviceExtension->RegBase + HDAC_RIRB_BASE_UPPER), CorbPhysicalAddress.HighPart);
 
-    // Program DMA position update
-    DeviceExtension->StreamPositions = (PVOID)((ULONG_PTR)DeviceExtension->RirbBase + PAGE_SIZE);
+    // Program DMA position update. The controller writes the position of
+    // every running stream into this page, so position queries are served
+    // from memory instead of reading LPIB over the bus.
+    DeviceExtension->StreamPositions = (PULONG)((ULONG_PTR)DeviceExtension->RirbBase + PAGE_SIZE);
+    RtlZeroMemory(DeviceExtension->StreamPositions, PAGE_SIZE);
     CorbPhysicalAddress.QuadPart += PAGE_SIZE;
-    WRITE_REGISTER_ULONG((PULONG)(DeviceExtension->RegBase + HDAC_DMA_POSITION_BASE_LOWER), CorbPhysicalAddress.LowPart);
+    WRITE_REGISTER_ULONG((PULONG)(DeviceExtension->RegBase + HDAC_DMA_POSITION_BASE_LOWER), CorbPhysicalAddress.LowPart | DMA_POSITION_ENABLED);
     WRITE_REGISTER_ULONG((PULONG)(DeviceExtension->RegBase + HDAC_DMA_POSITION_BASE_UPPER), CorbPhysicalAddress.HighPart);
 
     value = READ_REGISTER_USHORT((PUSHORT)(DeviceExtension->RegBase + HDAC_CORB_WRITE_POS)) & ~HDAC_CORB_WRITE_POS_MASK;
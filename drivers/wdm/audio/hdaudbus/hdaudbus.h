@@ -54,7 +54,8 @@ typedef struct
 
 	ULONG Responses[MAX_CODEC_RESPONSES];
 	ULONG ResponseCount;
-	KSEMAPHORE ResponseSemaphore;
+	ULONG ResponsesExpected;
+	KEVENT ResponseEvent;
 
 	PHDA_CODEC_AUDIO_GROUP AudioGroups[HDA_MAX_AUDIO_GROUPS];
 	ULONG AudioGroupCount;
@@ -77,7 +78,7 @@ typedef struct
 	PRIRB_RESPONSE RirbBase;
 	ULONG RirbReadPos;
 	ULONG CorbWritePos;
-	PVOID StreamPositions;
+	PULONG StreamPositions;     // DMA position buffer, 2 ULONGs per stream
 
 	PHDA_CODEC_ENTRY Codecs[HDA_MAX_CODECS + 1];
 
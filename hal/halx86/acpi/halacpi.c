@@ -23,6 +23,11 @@ BOOLEAN HalpPhysicalMemoryMayAppearAbove4GB;
 FADT HalpFixedAcpiDescTable;
 PDEBUG_PORT_TABLE HalpDebugPortTable;
 PACPI_SRAT HalpAcpiSrat;
+ULONG HalpNumaNodeCount;
+ULONG HalpNumaProximityDomain[HALP_MAX_NUMA_NODES];
+UCHAR HalpNumaApicIdToNode[HALP_MAX_NUMA_PROCESSORS];
+HALP_NUMA_MEMORY_RANGE HalpNumaMemoryRange[HALP_MAX_NUMA_MEMORY_RANGES];
+ULONG HalpNumaMemoryRangeCount;
 PBOOT_TABLE HalpSimpleBootFlagTable;
 
 PHYSICAL_ADDRESS HalpMaxHotPlugMemoryAddress;
@@ -470,16 +475,181 @@ HalAcpiGetTable(IN PLOADER_PARAMETER_BLOCK LoaderBlock,
     return TableHeader;
 }
 
+static
+UCHAR
+HalpNumaGetNode(IN ULONG ProximityDomain)
+{
+    ULONG Node;
+
+    /* Proximity domains can be sparse, so give each one a dense node number */
+    for (Node = 0; Node < HalpNumaNodeCount; Node++)
+    {
+        if (HalpNumaProximityDomain[Node] == ProximityDomain) return (UCHAR)Node;
+    }
+
+    /* This is a new domain, fail if there are too many */
+    if (HalpNumaNodeCount == HALP_MAX_NUMA_NODES) return 0xFF;
+    HalpNumaProximityDomain[HalpNumaNodeCount] = ProximityDomain;
+    return (UCHAR)HalpNumaNodeCount++;
+}
+
 VOID
 NTAPI
 HalpNumaInitializeStaticConfiguration(IN PLOADER_PARAMETER_BLOCK LoaderBlock)
 {
     PACPI_SRAT SratTable;
+    PSRAT_ENTRY_HEADER Entry, EndOfTable;
+    PSRAT_PROCESSOR_ENTRY Processor;
+    PSRAT_MEMORY_ENTRY Memory;
+    PSRAT_X2APIC_ENTRY X2Apic;
+    PHALP_NUMA_MEMORY_RANGE Range;
+    UCHAR Node, BootNode;
+    ULONG i, Domain;
+    INT CpuInfo[4];
 
     /* Get the SRAT, bail out if it doesn't exist */
     SratTable = HalAcpiGetTable(LoaderBlock, SRAT_SIGNATURE);
     HalpAcpiSrat = SratTable;
     if (!SratTable) return;
+
+    /* Start with no processor described */
+    RtlFillMemory(HalpNumaApicIdToNode, sizeof(HalpNumaApicIdToNode), 0xFF);
+
+    /* Loop the affinity entries that follow the table header */
+    Entry = (PSRAT_ENTRY_HEADER)(SratTable + 1);
+    EndOfTable = (PSRAT_ENTRY_HEADER)((ULONG_PTR)SratTable + SratTable->Header.Length);
+    while ((Entry + 1 <= EndOfTable) &&
+           (Entry->Length >= sizeof(SRAT_ENTRY_HEADER)) &&
+           ((ULONG_PTR)Entry + Entry->Length <= (ULONG_PTR)EndOfTable))
+    {
+        if ((Entry->Type == SRAT_PROCESSOR_AFFINITY) &&
+            (Entry->Length >= sizeof(SRAT_PROCESSOR_ENTRY)))
+        {
+            /* Map this local APIC to its node */
+            Processor = (PSRAT_PROCESSOR_ENTRY)Entry;
+            if (Processor->Flags & SRAT_ENTRY_ENABLED)
+            {
+                Node = HalpNumaGetNode(Processor->ProximityDomainLow |
+                                       (Processor->ProximityDomainHigh[0] << 8) |
+                                       (Processor->ProximityDomainHigh[1] << 16) |
+                                       (Processor->ProximityDomainHigh[2] << 24));
+                if (Node != 0xFF) HalpNumaApicIdToNode[Processor->ApicId] = Node;
+            }
+        }
+        else if ((Entry->Type == SRAT_X2APIC_AFFINITY) &&
+                 (Entry->Length >= sizeof(SRAT_X2APIC_ENTRY)))
+        {
+            /* Only the x2APIC IDs that fit in the xAPIC range can be looked up */
+            X2Apic = (PSRAT_X2APIC_ENTRY)Entry;
+            if ((X2Apic->Flags & SRAT_ENTRY_ENABLED) &&
+                (X2Apic->X2ApicId < HALP_MAX_NUMA_PROCESSORS))
+            {
+                Node = HalpNumaGetNode(X2Apic->ProximityDomain);
+                if (Node != 0xFF) HalpNumaApicIdToNode[X2Apic->X2ApicId] = Node;
+            }
+        }
+        else if ((Entry->Type == SRAT_MEMORY_AFFINITY) &&
+                 (Entry->Length >= sizeof(SRAT_MEMORY_ENTRY)))
+        {
+            /* Remember which node the pages of this range belong to */
+            Memory = (PSRAT_MEMORY_ENTRY)Entry;
+            if ((Memory->Flags & SRAT_ENTRY_ENABLED) &&
+                (Memory->Length) &&
+                (HalpNumaMemoryRangeCount < HALP_MAX_NUMA_MEMORY_RANGES))
+            {
+                Node = HalpNumaGetNode(Memory->ProximityDomain);
+                if (Node != 0xFF)
+                {
+                    Range = &HalpNumaMemoryRange[HalpNumaMemoryRangeCount++];
+                    Range->BasePage = Memory->BaseAddress >> PAGE_SHIFT;
+                    Range->EndPage = (Memory->BaseAddress + Memory->Length) >> PAGE_SHIFT;
+                    Range->Node = Node;
+                }
+            }
+        }
+
+        /* Next entry */
+        Entry = (PSRAT_ENTRY_HEADER)((ULONG_PTR)Entry + Entry->Length);
+    }
+
+    /* A single node is no different from a machine without NUMA */
+    if (HalpNumaNodeCount < 2) return;
+    DPRINT1("SRAT describes %lu NUMA nodes and %lu memory ranges\n",
+            HalpNumaNodeCount,
+            HalpNumaMemoryRangeCount);
+
+    /* The kernel expects the boot processor on the first node, swap it there */
+    __cpuid(CpuInfo, 1);
+    BootNode = HalpNumaApicIdToNode[(ULONG)CpuInfo[1] >> 24];
+    if ((BootNode == 0xFF) || (BootNode == 0)) return;
+    for (i = 0; i < HALP_MAX_NUMA_PROCESSORS; i++)
+    {
+        if (HalpNumaApicIdToNode[i] == BootNode) HalpNumaApicIdToNode[i] = 0;
+        else if (HalpNumaApicIdToNode[i] == 0) HalpNumaApicIdToNode[i] = BootNode;
+    }
+    for (i = 0; i < HalpNumaMemoryRangeCount; i++)
+    {
+        if (HalpNumaMemoryRange[i].Node == BootNode) HalpNumaMemoryRange[i].Node = 0;
+        else if (HalpNumaMemoryRange[i].Node == 0) HalpNumaMemoryRange[i].Node = BootNode;
+    }
+    Domain = HalpNumaProximityDomain[0];
+    HalpNumaProximityDomain[0] = HalpNumaProximityDomain[BootNode];
+    HalpNumaProximityDomain[BootNode] = Domain;
+}
+
+NTSTATUS
+NTAPI
+HalpNumaQueryProcessorNode(IN ULONG ProcessorNumber,
+                           OUT PUSHORT Identifier,
+                           OUT PUCHAR Node)
+{
+    INT CpuInfo[4];
+
+    /* The APIC ID can only be read on the processor itself */
+    if (ProcessorNumber != KeGetCurrentProcessorNumber()) return STATUS_NOT_FOUND;
+
+    /* Get the initial APIC ID of this processor and its node */
+    __cpuid(CpuInfo, 1);
+    *Identifier = (USHORT)((ULONG)CpuInfo[1] >> 24);
+    *Node = HalpNumaApicIdToNode[*Identifier];
+
+    /* Processors that aren't described by the SRAT belong to the boot node */
+    if (*Node == 0xFF) *Node = 0;
+    return STATUS_SUCCESS;
+}
+
+ULONG
+NTAPI
+HalpNumaPageToNode(IN ULONGLONG PhysicalPageNumber)
+{
+    ULONG i;
+
+    /* Find the memory range of this page */
+    for (i = 0; i < HalpNumaMemoryRangeCount; i++)
+    {
+        if ((PhysicalPageNumber >= HalpNumaMemoryRange[i].BasePage) &&
+            (PhysicalPageNumber < HalpNumaMemoryRange[i].EndPage))
+        {
+            return HalpNumaMemoryRange[i].Node;
+        }
+    }
+
+    /* Pages that aren't described by the SRAT belong to the boot node */
+    return 0;
+}
+
+NTSTATUS
+NTAPI
+HalpGetNumaTopologyInterface(OUT PHAL_NUMA_TOPOLOGY_INTERFACE NumaInterface)
+{
+    /* Without at least two nodes described by the SRAT, there is no NUMA */
+    if (HalpNumaNodeCount < 2) return STATUS_INVALID_LEVEL;
+
+    /* Return our node count and the lookup routines */
+    NumaInterface->NumberOfNodes = HalpNumaNodeCount;
+    NumaInterface->QueryProcessorNode = HalpNumaQueryProcessorNode;
+    NumaInterface->PageToNode = HalpNumaPageToNode;
+    return STATUS_SUCCESS;
 }
 
 VOID
@@ -832,7 +1002,7 @@ HalpSetupAcpiPhase0(IN PLOADER_PARAMETER_BLOCK LoaderBlock)
     HalpDynamicSystemResourceConfiguration(LoaderBlock);
     if (HalpAcpiSrat)
     {
-        DPRINT1("Your machine has a SRAT, but NUMA/HotPlug are not supported!\n");
+        DPRINT1("Your machine has a SRAT, but HotPlug is not supported!\n");
     }
 
     /* Can there be memory higher than 4GB? */
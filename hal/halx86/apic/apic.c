@@ -26,6 +26,7 @@ void __cdecl HackEoi(void);
 
 ULONG ApicVersion;
 UCHAR HalpVectorToIndex[256];
+BOOLEAN HalpX2ApicEnabled;
 
 #ifndef _M_AMD64
 const UCHAR
@@ -143,6 +144,13 @@ ApicRequestInterrupt(IN UCHAR Vector, UCHAR TriggerMode)
     CommandRegister.TriggerMode = TriggerMode;
     CommandRegister.DestinationShortHand = APIC_DSH_Self;
 
+    /* The x2APIC has a dedicated register for edge triggered self IPIs */
+    if (HalpX2ApicEnabled && (TriggerMode == APIC_TGM_Edge))
+    {
+        ApicWrite(APIC_SELF_IPI, Vector);
+        return;
+    }
+
     /* Write the low dword to send the interrupt */
     ApicWrite(APIC_ICR0, CommandRegister.Long0);
 }
@@ -151,6 +159,13 @@ FORCEINLINE
 VOID
 ApicSendEOI(void)
 {
+    /* An MSR write is serializing, the VBox iret hack is only needed for MMIO */
+    if (HalpX2ApicEnabled)
+    {
+        ApicWrite(APIC_EOI, 0);
+        return;
+    }
+
     //ApicWrite(APIC_EOI, 0);
     HackEoi();
 }
@@ -261,6 +276,14 @@ ApicInitializeLocalApic(ULONG Cpu)
     APIC_BASE_ADRESS_REGISTER BaseRegister;
     APIC_SPURIOUS_INERRUPT_REGISTER SpIntRegister;
     LVT_REGISTER LvtEntry;
+    INT CpuInfo[4];
+
+    /* Use x2APIC mode when the boot CPU supports it, all others follow */
+    if (Cpu == 0)
+    {
+        __cpuid(CpuInfo, 1);
+        HalpX2ApicEnabled = (CpuInfo[2] & CPUID_X2APIC_SUPPORTED) != 0;
+    }
 
     /* Enable the APIC if it wasn't yet */
     BaseRegister.Long = __readmsr(MSR_APIC_BASE);
@@ -268,6 +291,13 @@ ApicInitializeLocalApic(ULONG Cpu)
     BaseRegister.BootStrapCPUCore = (Cpu == 0);
     __writemsr(MSR_APIC_BASE, BaseRegister.Long);
 
+    /* x2APIC mode can only be entered from enabled xAPIC mode */
+    if (HalpX2ApicEnabled && !BaseRegister.X2ApicEnable)
+    {
+        BaseRegister.X2ApicEnable = 1;
+        __writemsr(MSR_APIC_BASE, BaseRegister.Long);
+    }
+
     /* Set spurious vector and SoftwareEnable to 1 */
     SpIntRegister.Long = ApicRead(APIC_SIVR);
     SpIntRegister.Vector = APIC_SPURIOUS_VECTOR;
@@ -278,11 +308,15 @@ ApicInitializeLocalApic(ULONG Cpu)
     /* Read the version and save it globally */
     if (Cpu == 0) ApicVersion = ApicRead(APIC_VER);
 
-    /* Set the mode to flat (max 8 CPUs supported!) */
-    ApicWrite(APIC_DFR, APIC_DF_Flat);
+    /* The x2APIC has no DFR and derives the read-only LDR from its ID */
+    if (!HalpX2ApicEnabled)
+    {
+        /* Set the mode to flat (max 8 CPUs supported!) */
+        ApicWrite(APIC_DFR, APIC_DF_Flat);
 
-    /* Set logical apic ID */
-    ApicWrite(APIC_LDR, ApicLogicalId(Cpu) << 24);
+        /* Set logical apic ID */
+        ApicWrite(APIC_LDR, ApicLogicalId(Cpu) << 24);
+    }
 
     /* Set the spurious ISR */
     KeRegisterInterruptHandler(APIC_SPURIOUS_VECTOR, ApicSpuriousService);
@@ -301,10 +335,15 @@ ApicInitializeLocalApic(ULONG Cpu)
     ApicWrite(APIC_TMRLVTR, LvtEntry.Long);
     ApicWrite(APIC_THRMLVTR, LvtEntry.Long);
     ApicWrite(APIC_PCLVTR, LvtEntry.Long);
-    ApicWrite(APIC_EXT0LVTR, LvtEntry.Long);
-    ApicWrite(APIC_EXT1LVTR, LvtEntry.Long);
-    ApicWrite(APIC_EXT2LVTR, LvtEntry.Long);
-    ApicWrite(APIC_EXT3LVTR, LvtEntry.Long);
+
+    /* The extended LVTs have no MSR equivalent */
+    if (!HalpX2ApicEnabled)
+    {
+        ApicWrite(APIC_EXT0LVTR, LvtEntry.Long);
+        ApicWrite(APIC_EXT1LVTR, LvtEntry.Long);
+        ApicWrite(APIC_EXT2LVTR, LvtEntry.Long);
+        ApicWrite(APIC_EXT3LVTR, LvtEntry.Long);
+    }
 
     /* LINT0 */
     LvtEntry.Vector = APIC_SPURIOUS_VECTOR;
@@ -436,8 +475,8 @@ ApicInitializeIOApic(VOID)
     ReDirReg.DestinationMode = APIC_DM_Physical;
     ReDirReg.TriggerMode = APIC_TGM_Edge;
     ReDirReg.Mask = 0;
-    ReDirReg.Destination = ApicRead(APIC_ID);
-    IOApicWrite(IOAPIC_REDTBL + 2 * APIC_CLOCK_INDEX, ReDirReg.Long0);
+    ReDirReg.Destination = ApicGetCurrentId();
+    ApicWriteIORedirectionEntry(APIC_CLOCK_INDEX, ReDirReg);
 }
 
 VOID
@@ -630,6 +669,17 @@ HalEnableSystemInterrupt(
         ReDirReg.Destination = 0;
     }
 
+    /*
+     * Without interrupt remapping the I/O APIC cannot address x2APIC
+     * logical clusters, so steer the interrupt to the CPU enabling it.
+     */
+    if (HalpX2ApicEnabled)
+    {
+        ReDirReg.DeliveryMode = APIC_MT_Fixed;
+        ReDirReg.DestinationMode = APIC_DM_Physical;
+        ReDirReg.Destination = (UCHAR)ApicGetCurrentId();
+    }
+
     /* Check if the destination is logical */
     if (ReDirReg.DestinationMode == APIC_DM_Logical)
     {
@@ -39,6 +39,8 @@
 #endif
 
 #define MSR_APIC_BASE 0x0000001B
+#define MSR_X2APIC_BASE 0x00000800 /* x2APIC registers are MSRs 0x800 + (Offset >> 4) */
+#define CPUID_X2APIC_SUPPORTED 0x00200000 /* CPUID 1, ECX bit 21 */
 #define IOAPIC_PHYS_BASE 0xFEC00000
 #define APIC_CLOCK_INDEX 8
 
@@ -77,6 +79,7 @@
 #define APIC_EXT1LVTR 0x0510 /* Extended Interrupt 1 Local Vector Table */
 #define APIC_EXT2LVTR 0x0520 /* Extended Interrupt 2 Local Vector Table */
 #define APIC_EXT3LVTR 0x0530 /* Extended Interrupt 3 Local Vector Table */
+#define APIC_SELF_IPI 0x03F0 /* Self IPI Register, x2APIC mode only (W) */
 
 enum
 {
@@ -136,7 +139,8 @@ typedef union _APIC_BASE_ADRESS_REGISTER
     {
         ULONG64 Reserved1:8;
         ULONG64 BootStrapCPUCore:1;
-        ULONG64 Reserved2:2;
+        ULONG64 Reserved2:1;
+        ULONG64 X2ApicEnable:1;
         ULONG64 Enable:1;
         ULONG64 BaseAddress:40;
         ULONG64 ReservedMBZ:12;
@@ -260,10 +264,16 @@ typedef union _IOAPIC_REDIRECTION_REGISTER
     };
 } IOAPIC_REDIRECTION_REGISTER;
 
+extern BOOLEAN HalpX2ApicEnabled;
+
 FORCEINLINE
 ULONG
 ApicRead(ULONG Offset)
 {
+    /* In x2APIC mode the registers are only reachable through MSRs */
+    if (HalpX2ApicEnabled)
+        return (ULONG)__readmsr(MSR_X2APIC_BASE + (Offset >> 4));
+
     return *(volatile ULONG *)(APIC_BASE + Offset);
 }
 
@@ -271,9 +281,26 @@ FORCEINLINE
 VOID
 ApicWrite(ULONG Offset, ULONG Value)
 {
+    if (HalpX2ApicEnabled)
+    {
+        __writemsr(MSR_X2APIC_BASE + (Offset >> 4), Value);
+        return;
+    }
+
     *(volatile ULONG *)(APIC_BASE + Offset) = Value;
 }
 
+FORCEINLINE
+ULONG
+ApicGetCurrentId(VOID)
+{
+    /* The xAPIC keeps the 8 bit ID in the top byte, the x2APIC uses all 32 bits */
+    if (HalpX2ApicEnabled)
+        return ApicRead(APIC_ID);
+
+    return ApicRead(APIC_ID) >> 24;
+}
+
 VOID
 NTAPI
 ApicInitializeTimer(ULONG Cpu);
@@ -39,7 +39,18 @@ HaliQuerySystemInformation(IN HAL_QUERY_INFORMATION_CLASS InformationClass,
 		}
 		REPORT_THIS_CASE(HalDisplayBiosInformation);
 		REPORT_THIS_CASE(HalProcessorFeatureInformation);
-		REPORT_THIS_CASE(HalNumaTopologyInterface);
+		case HalNumaTopologyInterface:
+		{
+            /* Make sure the caller has room for the interface */
+            if (BufferSize < sizeof(HAL_NUMA_TOPOLOGY_INTERFACE))
+            {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            /* Only the ACPI HAL knows the topology, from the SRAT */
+            *ReturnedLength = sizeof(HAL_NUMA_TOPOLOGY_INTERFACE);
+            return HalpGetNumaTopologyInterface(Buffer);
+		}
 		REPORT_THIS_CASE(HalErrorInformation);
 		REPORT_THIS_CASE(HalCmcLogInformation);
 		REPORT_THIS_CASE(HalCpeLogInformation);
@@ -21,6 +21,10 @@
 
 #define PIT_LATCH  0x00
 
+/* Calibrate the TSC over 50 ms worth of PIT ticks */
+#define TSC_CALIBRATION_TICKS (PIT_FREQUENCY / 20)
+
+LARGE_INTEGER HalpTscFrequency;
 LARGE_INTEGER HalpLastPerfCounter;
 LARGE_INTEGER HalpPerfCounter;
 ULONG HalpPerfCounterCutoff;
@@ -111,6 +115,65 @@ HalpSetTimerRollOver(USHORT RollOver)
     __writeeflags(Flags);
 }
 
+#ifndef _MINIHAL_
+INIT_FUNCTION
+static
+BOOLEAN
+HalpIsTscInvariant(VOID)
+{
+    INT CpuInfo[4];
+
+    /* Check if the CPU supports RDTSC at all */
+    if (!(KeGetCurrentPrcb()->FeatureBits & KF_RDTSC)) return FALSE;
+
+    /* Check for the advanced power management leaf */
+    __cpuid(CpuInfo, 0x80000000);
+    if ((ULONG)CpuInfo[0] < 0x80000007) return FALSE;
+
+    /* The TSC runs at a constant rate in all P-, C- and T-states */
+    __cpuid(CpuInfo, 0x80000007);
+    return (CpuInfo[3] & 0x100) != 0;
+}
+
+INIT_FUNCTION
+static
+VOID
+HalpCalibrateTsc(VOID)
+{
+    ULONG_PTR Flags;
+    ULONG LastValue, CounterValue, Elapsed = 0;
+    ULONG64 StartTsc, EndTsc;
+
+    /* Disable interrupts */
+    Flags = __readeflags();
+    _disable();
+
+    /* Poll the running PIT, counting ticks across rollovers */
+    LastValue = HalpRead8254Value();
+    StartTsc = __rdtsc();
+    while (Elapsed < TSC_CALIBRATION_TICKS)
+    {
+        CounterValue = HalpRead8254Value();
+
+        /* The counter runs down and reloads with the rollover value */
+        if (CounterValue <= LastValue)
+            Elapsed += LastValue - CounterValue;
+        else
+            Elapsed += LastValue + HalpCurrentRollOver - CounterValue;
+
+        LastValue = CounterValue;
+    }
+    EndTsc = __rdtsc();
+
+    /* Restore interrupts if they were previously enabled */
+    __writeeflags(Flags);
+
+    HalpTscFrequency.QuadPart = (EndTsc - StartTsc) * PIT_FREQUENCY / Elapsed;
+    DPRINT1("Using the invariant TSC at %I64u Hz for the performance counter\n",
+            HalpTscFrequency.QuadPart);
+}
+#endif
+
 INIT_FUNCTION
 VOID
 NTAPI
@@ -134,6 +197,11 @@ HalpInitializeClock(VOID)
     /* Save rollover and increment */
     HalpCurrentRollOver = RollOver;
     HalpCurrentTimeIncrement = Increment;
+
+#ifndef _MINIHAL_
+    /* Serve the performance counter from the TSC when its rate is constant */
+    if (HalpIsTscInvariant()) HalpCalibrateTsc();
+#endif
 }
 
 #ifdef _M_IX86
@@ -272,6 +340,17 @@ KeQueryPerformanceCounter(PLARGE_INTEGER PerformanceFrequency)
     ULONG CounterValue, ClockDelta;
     KIRQL OldIrql;
 
+#ifndef _MINIHAL_
+    /* The invariant TSC needs neither port I/O nor an IRQL raise */
+    if (HalpTscFrequency.QuadPart != 0)
+    {
+        if (PerformanceFrequency) *PerformanceFrequency = HalpTscFrequency;
+
+        CurrentPerfCounter.QuadPart = __rdtsc();
+        return CurrentPerfCounter;
+    }
+#endif
+
     /* If caller wants performance frequency, return hardcoded value */
     if (PerformanceFrequency) PerformanceFrequency->QuadPart = PIT_FREQUENCY;
 
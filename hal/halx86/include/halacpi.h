@@ -11,6 +11,20 @@ typedef struct _ACPI_CACHED_TABLE
     // ...
 } ACPI_CACHED_TABLE, *PACPI_CACHED_TABLE;
 
+//
+// NUMA configuration read from the SRAT
+//
+#define HALP_MAX_NUMA_NODES             16
+#define HALP_MAX_NUMA_PROCESSORS        256
+#define HALP_MAX_NUMA_MEMORY_RANGES     32
+
+typedef struct _HALP_NUMA_MEMORY_RANGE
+{
+    ULONGLONG BasePage;
+    ULONGLONG EndPage;
+    UCHAR Node;
+} HALP_NUMA_MEMORY_RANGE, *PHALP_NUMA_MEMORY_RANGE;
+
 NTSTATUS
 NTAPI
 HalpAcpiTableCacheInit(
@@ -798,6 +798,12 @@ HalpGetDebugPortTable(
     VOID
 );
 
+NTSTATUS
+NTAPI
+HalpGetNumaTopologyInterface(
+    OUT PHAL_NUMA_TOPOLOGY_INTERFACE NumaInterface
+);
+
 INIT_FUNCTION
 VOID
 NTAPI
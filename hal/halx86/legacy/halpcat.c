@@ -65,6 +65,14 @@ HalpGetDebugPortTable(VOID)
     return FALSE;
 }
 
+NTSTATUS
+NTAPI
+HalpGetNumaTopologyInterface(OUT PHAL_NUMA_TOPOLOGY_INTERFACE NumaInterface)
+{
+    /* No SRAT, so no NUMA */
+    return STATUS_INVALID_LEVEL;
+}
+
 INIT_FUNCTION
 ULONG
 NTAPI
@@ -65,4 +65,11 @@ HalpBiosDisplayReset(VOID)
     return FALSE;
 }
 
+NTSTATUS
+NTAPI
+HalpGetNumaTopologyInterface(OUT PHAL_NUMA_TOPOLOGY_INTERFACE NumaInterface)
+{
+    return STATUS_INVALID_LEVEL;
+}
+
 /* EOF */
@@ -0,0 +1,419 @@
+/*
+ * PROJECT:     kprof
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Summarizes the profile samples of an NT Kernel Logger file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <windows.h>
+#include <dbghelp.h>
+#include <wmiklog.h>
+
+#define HASH_SIZE       4096
+#define MAX_NAME        512
+
+typedef struct _MODULE
+{
+    ULONG ProcessId;
+    ULONGLONG Base;
+    ULONG Size;
+    BOOL Loaded;
+    WCHAR Name[MAX_PATH];
+} MODULE, *PMODULE;
+
+typedef struct _SPACE
+{
+    ULONG ProcessId;
+    HANDLE Handle;
+} SPACE, *PSPACE;
+
+/* A symbol and the samples it was seen in */
+typedef struct _ENTRY
+{
+    struct _ENTRY *Next;
+    ULONG Exclusive;
+    ULONG Inclusive;
+    ULONG LastSample;
+    WCHAR Name[ANYSIZE_ARRAY];
+} ENTRY, *PENTRY;
+
+/* Remembers which symbol an address resolved to */
+typedef struct _ADDRESS
+{
+    struct _ADDRESS *Next;
+    ULONG ProcessId;
+    ULONGLONG Address;
+    PENTRY Entry;
+} ADDRESS, *PADDRESS;
+
+static PMODULE Modules;
+static ULONG ModuleCount, ModuleMax;
+static SPACE Spaces[64];
+static ULONG SpaceCount;
+static PENTRY Entries[HASH_SIZE];
+static PADDRESS Addresses[HASH_SIZE];
+static ULONG EntryCount;
+static PCWSTR SymbolPath;
+
+static void *xalloc(size_t Size)
+{
+    void *p = calloc(1, Size);
+    if (!p)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static ULONG HashString(PCWSTR String)
+{
+    ULONG Hash = 0;
+    while (*String) Hash = Hash * 31 + *String++;
+    return Hash % HASH_SIZE;
+}
+
+static void AddModule(ULONG ProcessId, PWMI_KLOG_IMAGE_LOAD Image, ULONG Available)
+{
+    PMODULE Module;
+    ULONG Length;
+
+    if (ModuleCount == ModuleMax)
+    {
+        ModuleMax = ModuleMax ? ModuleMax * 2 : 64;
+        Modules = realloc(Modules, ModuleMax * sizeof(MODULE));
+        if (!Modules)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+
+    Length = min(Image->NameLength, (Available - FIELD_OFFSET(WMI_KLOG_IMAGE_LOAD, FileName)) / sizeof(WCHAR));
+    Length = min(Length, MAX_PATH - 1);
+
+    Module = &Modules[ModuleCount++];
+    ZeroMemory(Module, sizeof(*Module));
+    Module->ProcessId = ProcessId;
+    Module->Base = Image->ImageBase;
+    Module->Size = Image->ImageSize;
+    memcpy(Module->Name, Image->FileName, Length * sizeof(WCHAR));
+}
+
+static PMODULE FindModule(ULONG ProcessId, ULONGLONG Address)
+{
+    ULONG i;
+
+    /* Later loads at the same address replace earlier ones */
+    for (i = ModuleCount; i-- > 0;)
+    {
+        if ((Modules[i].ProcessId == ProcessId) &&
+            (Address >= Modules[i].Base) &&
+            (Address < Modules[i].Base + Modules[i].Size))
+        {
+            return &Modules[i];
+        }
+    }
+    return NULL;
+}
+
+static HANDLE GetSpace(ULONG ProcessId)
+{
+    ULONG i;
+
+    for (i = 0; i < SpaceCount; i++)
+    {
+        if (Spaces[i].ProcessId == ProcessId) return Spaces[i].Handle;
+    }
+    if (SpaceCount == ARRAYSIZE(Spaces)) return NULL;
+
+    /* dbghelp only uses the handle as a key when it is not asked to invade */
+    Spaces[SpaceCount].ProcessId = ProcessId;
+    Spaces[SpaceCount].Handle = (HANDLE)(ULONG_PTR)(0x1000 + SpaceCount * 4);
+    if (!SymInitializeW(Spaces[SpaceCount].Handle, SymbolPath, FALSE))
+        return NULL;
+    return Spaces[SpaceCount++].Handle;
+}
+
+/* Turns the NT path the kernel reported into one we can open */
+static void TranslatePath(PCWSTR NtPath, PWSTR Path)
+{
+    WCHAR WindowsDirectory[MAX_PATH];
+
+    if (!_wcsnicmp(NtPath, L"\\SystemRoot\\", 12))
+    {
+        GetWindowsDirectoryW(WindowsDirectory, ARRAYSIZE(WindowsDirectory));
+        _snwprintf(Path, MAX_PATH, L"%s\\%s", WindowsDirectory, NtPath + 12);
+    }
+    else if (!wcsncmp(NtPath, L"\\??\\", 4))
+    {
+        _snwprintf(Path, MAX_PATH, L"%s", NtPath + 4);
+    }
+    else
+    {
+        _snwprintf(Path, MAX_PATH, L"%s", NtPath);
+    }
+    Path[MAX_PATH - 1] = UNICODE_NULL;
+}
+
+static PCWSTR ShortName(PCWSTR Path)
+{
+    PCWSTR p = wcsrchr(Path, L'\\');
+    return p ? p + 1 : Path;
+}
+
+static PENTRY GetEntry(PCWSTR Name)
+{
+    ULONG Hash = HashString(Name);
+    PENTRY Entry;
+
+    for (Entry = Entries[Hash]; Entry; Entry = Entry->Next)
+    {
+        if (!wcscmp(Entry->Name, Name)) return Entry;
+    }
+
+    Entry = xalloc(FIELD_OFFSET(ENTRY, Name) + (wcslen(Name) + 1) * sizeof(WCHAR));
+    wcscpy(Entry->Name, Name);
+    Entry->Next = Entries[Hash];
+    Entries[Hash] = Entry;
+    EntryCount++;
+    return Entry;
+}
+
+static PENTRY Symbolize(ULONG ProcessId, ULONGLONG Address)
+{
+    ULONG Hash = (ULONG)((Address >> 2) ^ ProcessId) % HASH_SIZE;
+    BYTE SymbolBuffer[sizeof(SYMBOL_INFOW) + MAX_NAME * sizeof(WCHAR)];
+    PSYMBOL_INFOW Symbol = (PSYMBOL_INFOW)SymbolBuffer;
+    WCHAR Name[MAX_PATH + MAX_NAME + 32], Path[MAX_PATH], Module[MAX_PATH];
+    DWORD64 Displacement;
+    PADDRESS Cached;
+    PMODULE Image;
+    HANDLE Space;
+    PWSTR Dot;
+
+    for (Cached = Addresses[Hash]; Cached; Cached = Cached->Next)
+    {
+        if ((Cached->ProcessId == ProcessId) && (Cached->Address == Address))
+            return Cached->Entry;
+    }
+
+    Image = FindModule(ProcessId, Address);
+    if (!Image)
+    {
+        _snwprintf(Name, ARRAYSIZE(Name), L"0x%I64x", Address);
+    }
+    else
+    {
+        wcscpy(Module, ShortName(Image->Name));
+        Dot = wcsrchr(Module, L'.');
+        if (Dot) *Dot = UNICODE_NULL;
+
+        Space = GetSpace(ProcessId);
+        if (Space && !Image->Loaded)
+        {
+            TranslatePath(Image->Name, Path);
+            SymLoadModuleExW(Space, NULL, Path, NULL, Image->Base, Image->Size, NULL, 0);
+            Image->Loaded = TRUE;
+        }
+
+        ZeroMemory(SymbolBuffer, sizeof(SymbolBuffer));
+        Symbol->SizeOfStruct = sizeof(SYMBOL_INFOW);
+        Symbol->MaxNameLen = MAX_NAME;
+
+        /* Samples are grouped by function, so the displacement is dropped */
+        if (Space && SymFromAddrW(Space, Address, &Displacement, Symbol))
+            _snwprintf(Name, ARRAYSIZE(Name), L"%s!%s", Module, Symbol->Name);
+        else
+            _snwprintf(Name, ARRAYSIZE(Name), L"%s+0x%I64x", Module, Address - Image->Base);
+    }
+    Name[ARRAYSIZE(Name) - 1] = UNICODE_NULL;
+
+    Cached = xalloc(sizeof(ADDRESS));
+    Cached->ProcessId = ProcessId;
+    Cached->Address = Address;
+    Cached->Entry = GetEntry(Name);
+    Cached->Next = Addresses[Hash];
+    Addresses[Hash] = Cached;
+    return Cached->Entry;
+}
+
+static int __cdecl CompareExclusive(const void *a, const void *b)
+{
+    PENTRY e1 = *(PENTRY *)a, e2 = *(PENTRY *)b;
+    return (e2->Exclusive > e1->Exclusive) - (e2->Exclusive < e1->Exclusive);
+}
+
+static int __cdecl CompareInclusive(const void *a, const void *b)
+{
+    PENTRY e1 = *(PENTRY *)a, e2 = *(PENTRY *)b;
+    return (e2->Inclusive > e1->Inclusive) - (e2->Inclusive < e1->Inclusive);
+}
+
+static void PrintTop(PENTRY *Sorted, ULONG Count, ULONG Top, ULONG Samples, BOOL Inclusive)
+{
+    ULONG i, Value;
+
+    for (i = 0; i < Count && i < Top; i++)
+    {
+        Value = Inclusive ? Sorted[i]->Inclusive : Sorted[i]->Exclusive;
+        if (!Value) break;
+        wprintf(L"%8lu %6.2f%%  %s\n", Value, Value * 100.0 / Samples, Sorted[i]->Name);
+    }
+}
+
+static void Usage(void)
+{
+    printf("Usage: kprof [-n count] [-y symbolpath] logfile\n"
+           "  Summarizes the profile samples of an NT Kernel Logger file.\n"
+           "  The logger is started at boot from the registry key\n"
+           "  HKLM\\System\\CurrentControlSet\\Control\\WMI\\Autologger\\NT Kernel Logger\n"
+           "  with Start = 1 and EnableKernelFlags including 0x01000000.\n");
+}
+
+int wmain(int argc, WCHAR **argv)
+{
+    PWMI_KLOG_FILE_HEADER FileHeader;
+    PWMI_KLOG_BUFFER_HEADER Buffer;
+    PWMI_KLOG_EVENT_HEADER Event;
+    PWMI_KLOG_PROFILE Sample;
+    PCWSTR FileName = NULL;
+    ULONG Top = 30, Samples = 0, UserSamples = 0, EventsLost = 0, SampleId = 0;
+    ULONG i, j, Offset, EventOffset, ProcessId;
+    PENTRY *Sorted, Entry;
+    DWORD Size, Read;
+    HANDLE File;
+    PUCHAR Data;
+
+    for (i = 1; i < (ULONG)argc; i++)
+    {
+        if (!wcscmp(argv[i], L"-n") && i + 1 < (ULONG)argc)
+            Top = wcstoul(argv[++i], NULL, 0);
+        else if (!wcscmp(argv[i], L"-y") && i + 1 < (ULONG)argc)
+            SymbolPath = argv[++i];
+        else if (argv[i][0] != L'-' && !FileName)
+            FileName = argv[i];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if (!FileName)
+    {
+        Usage();
+        return 1;
+    }
+
+    File = CreateFileW(FileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_EXISTING, 0, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        fwprintf(stderr, L"Cannot open %s: %lu\n", FileName, GetLastError());
+        return 1;
+    }
+    Size = GetFileSize(File, NULL);
+    Data = xalloc(Size + 1);
+    if (!ReadFile(File, Data, Size, &Read, NULL) || Read != Size)
+    {
+        fwprintf(stderr, L"Cannot read %s: %lu\n", FileName, GetLastError());
+        return 1;
+    }
+    CloseHandle(File);
+
+    FileHeader = (PWMI_KLOG_FILE_HEADER)Data;
+    if (Size < sizeof(*FileHeader) ||
+        FileHeader->Signature != WMI_KLOG_FILE_SIGNATURE ||
+        FileHeader->Version != WMI_KLOG_FILE_VERSION)
+    {
+        fwprintf(stderr, L"%s is not a kernel logger file\n", FileName);
+        return 1;
+    }
+    if (!(FileHeader->EnableFlags & 0x01000000))
+        fwprintf(stderr, L"Profiling was not enabled in %s\n", FileName);
+
+    SymSetOptions(SymGetOptions() | SYMOPT_DEFERRED_LOADS | SYMOPT_UNDNAME);
+
+    /* Images come before the samples taken in them, so one pass is enough */
+    for (Offset = sizeof(*FileHeader);
+         Offset + sizeof(WMI_KLOG_BUFFER_HEADER) <= Size;
+         Offset += Buffer->Size)
+    {
+        Buffer = (PWMI_KLOG_BUFFER_HEADER)(Data + Offset);
+        if (Buffer->Size < sizeof(*Buffer) || Buffer->Size > Size - Offset)
+        {
+            fprintf(stderr, "Truncated buffer at offset %lu\n", Offset);
+            break;
+        }
+        EventsLost += Buffer->EventsLost;
+
+        for (EventOffset = sizeof(*Buffer);
+             EventOffset + sizeof(WMI_KLOG_EVENT_HEADER) <= Buffer->Size;
+             EventOffset += Event->Size)
+        {
+            Event = (PWMI_KLOG_EVENT_HEADER)((PUCHAR)Buffer + EventOffset);
+            if (Event->Size < sizeof(*Event) || Event->Size > Buffer->Size - EventOffset)
+                break;
+
+            if (Event->Type == WMI_KLOG_EVENT_IMAGE_LOAD &&
+                Event->Size >= sizeof(*Event) + FIELD_OFFSET(WMI_KLOG_IMAGE_LOAD, FileName))
+            {
+                PWMI_KLOG_IMAGE_LOAD Image = (PWMI_KLOG_IMAGE_LOAD)(Event + 1);
+                AddModule(Image->ProcessId, Image, Event->Size - sizeof(*Event));
+            }
+            else if (Event->Type == WMI_KLOG_EVENT_PROFILE &&
+                     Event->Size >= sizeof(*Event) + FIELD_OFFSET(WMI_KLOG_PROFILE, Frames))
+            {
+                Sample = (PWMI_KLOG_PROFILE)(Event + 1);
+                if (FIELD_OFFSET(WMI_KLOG_PROFILE, Frames) + Sample->FrameCount * sizeof(ULONGLONG) >
+                    Event->Size - sizeof(*Event))
+                {
+                    continue;
+                }
+
+                Samples++;
+                SampleId++;
+                ProcessId = Sample->UserMode ? Event->ProcessId : 0;
+                if (Sample->UserMode) UserSamples++;
+
+                Entry = Symbolize(ProcessId, Sample->InstructionPointer);
+                Entry->Exclusive++;
+                Entry->Inclusive++;
+                Entry->LastSample = SampleId;
+
+                /* Count recursive functions once per sample */
+                for (j = 0; j < Sample->FrameCount; j++)
+                {
+                    Entry = Symbolize(0, Sample->Frames[j]);
+                    if (Entry->LastSample == SampleId) continue;
+                    Entry->Inclusive++;
+                    Entry->LastSample = SampleId;
+                }
+            }
+        }
+    }
+
+    printf("%lu samples (%lu in user mode), %lu events lost, %lu modules\n\n",
+           Samples, UserSamples, EventsLost, ModuleCount);
+    if (!Samples) return 0;
+
+    Sorted = xalloc(EntryCount * sizeof(PENTRY));
+    for (i = 0, j = 0; i < HASH_SIZE; i++)
+    {
+        for (Entry = Entries[i]; Entry; Entry = Entry->Next)
+            Sorted[j++] = Entry;
+    }
+
+    printf("Exclusive:\n");
+    qsort(Sorted, EntryCount, sizeof(PENTRY), CompareExclusive);
+    PrintTop(Sorted, EntryCount, Top, Samples, FALSE);
+
+    printf("\nInclusive (kernel stacks):\n");
+    qsort(Sorted, EntryCount, sizeof(PENTRY), CompareInclusive);
+    PrintTop(Sorted, EntryCount, Top, Samples, TRUE);
+
+    for (i = 0; i < SpaceCount; i++) SymCleanup(Spaces[i].Handle);
+    return 0;
+}
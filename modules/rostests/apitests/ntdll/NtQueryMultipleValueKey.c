@@ -0,0 +1,102 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for NtQueryMultipleValueKey
+ */
+
+#include "precomp.h"
+
+#include <winreg.h>
+
+START_TEST(NtQueryMultipleValueKey)
+{
+    NTSTATUS Status;
+    HANDLE ParentKeyHandle;
+    HANDLE KeyHandle;
+    UNICODE_STRING KeyName = RTL_CONSTANT_STRING(L"SOFTWARE\\ntdll-apitest-NtQueryMultipleValueKey");
+    UNICODE_STRING FirstName = RTL_CONSTANT_STRING(L"First");
+    UNICODE_STRING SecondName = RTL_CONSTANT_STRING(L"Second");
+    UNICODE_STRING MissingName = RTL_CONSTANT_STRING(L"Missing");
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    KEY_VALUE_ENTRY Entries[2];
+    WCHAR Hello[] = L"Hello";
+    ULONG Number = 0x12345678;
+    UCHAR Buffer[64];
+    ULONG BufferLength;
+    ULONG RequiredLength;
+
+    Status = RtlOpenCurrentUser(READ_CONTROL, &ParentKeyHandle);
+    ok(Status == STATUS_SUCCESS, "RtlOpenCurrentUser returned %lx\n", Status);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("No user key handle\n");
+        return;
+    }
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &KeyName,
+                               OBJ_CASE_INSENSITIVE,
+                               ParentKeyHandle,
+                               NULL);
+    Status = NtCreateKey(&KeyHandle,
+                         KEY_QUERY_VALUE | KEY_SET_VALUE | DELETE,
+                         &ObjectAttributes,
+                         0,
+                         NULL,
+                         REG_OPTION_VOLATILE,
+                         NULL);
+    ok(Status == STATUS_SUCCESS, "NtCreateKey returned %lx\n", Status);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(ParentKeyHandle);
+        skip("No key handle\n");
+        return;
+    }
+
+    Status = NtSetValueKey(KeyHandle, &FirstName, 0, REG_SZ, Hello, sizeof(Hello));
+    ok(Status == STATUS_SUCCESS, "NtSetValueKey returned %lx\n", Status);
+    Status = NtSetValueKey(KeyHandle, &SecondName, 0, REG_DWORD, &Number, sizeof(Number));
+    ok(Status == STATUS_SUCCESS, "NtSetValueKey returned %lx\n", Status);
+
+    /* Both values, packed one after the other */
+    RtlZeroMemory(Entries, sizeof(Entries));
+    Entries[0].ValueName = &FirstName;
+    Entries[1].ValueName = &SecondName;
+    BufferLength = sizeof(Buffer);
+    RequiredLength = 0x55555555;
+    Status = NtQueryMultipleValueKey(KeyHandle, Entries, 2, Buffer, &BufferLength, &RequiredLength);
+    ok(Status == STATUS_SUCCESS, "NtQueryMultipleValueKey returned %lx\n", Status);
+    ok(BufferLength == sizeof(Hello) + sizeof(Number), "BufferLength = %lu\n", BufferLength);
+    ok(RequiredLength == sizeof(Hello) + sizeof(Number), "RequiredLength = %lu\n", RequiredLength);
+    ok(Entries[0].Type == REG_SZ, "Type = %lu\n", Entries[0].Type);
+    ok(Entries[0].DataLength == sizeof(Hello), "DataLength = %lu\n", Entries[0].DataLength);
+    ok(Entries[0].DataOffset == 0, "DataOffset = %lu\n", Entries[0].DataOffset);
+    ok(Entries[1].Type == REG_DWORD, "Type = %lu\n", Entries[1].Type);
+    ok(Entries[1].DataLength == sizeof(Number), "DataLength = %lu\n", Entries[1].DataLength);
+    ok(Entries[1].DataOffset == sizeof(Hello), "DataOffset = %lu\n", Entries[1].DataOffset);
+    ok(!memcmp(Buffer, Hello, sizeof(Hello)), "First value does not match\n");
+    ok(!memcmp(Buffer + sizeof(Hello), &Number, sizeof(Number)), "Second value does not match\n");
+
+    /* Too small, but we still learn how much is needed */
+    BufferLength = sizeof(Hello);
+    RequiredLength = 0x55555555;
+    Status = NtQueryMultipleValueKey(KeyHandle, Entries, 2, Buffer, &BufferLength, &RequiredLength);
+    ok(Status == STATUS_BUFFER_OVERFLOW, "NtQueryMultipleValueKey returned %lx\n", Status);
+    ok(RequiredLength == sizeof(Hello) + sizeof(Number), "RequiredLength = %lu\n", RequiredLength);
+
+    /* A missing value fails the whole query */
+    Entries[1].ValueName = &MissingName;
+    BufferLength = sizeof(Buffer);
+    Status = NtQueryMultipleValueKey(KeyHandle, Entries, 2, Buffer, &BufferLength, &RequiredLength);
+    ok(Status == STATUS_OBJECT_NAME_NOT_FOUND, "NtQueryMultipleValueKey returned %lx\n", Status);
+
+    /* No values at all */
+    BufferLength = sizeof(Buffer);
+    Status = NtQueryMultipleValueKey(KeyHandle, Entries, 0, Buffer, &BufferLength, &RequiredLength);
+    ok(Status == STATUS_INVALID_PARAMETER, "NtQueryMultipleValueKey returned %lx\n", Status);
+
+    Status = NtDeleteKey(KeyHandle);
+    ok(Status == STATUS_SUCCESS, "NtDeleteKey returned %lx\n", Status);
+    NtClose(KeyHandle);
+    NtClose(ParentKeyHandle);
+}
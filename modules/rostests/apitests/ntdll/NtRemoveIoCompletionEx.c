@@ -0,0 +1,70 @@
+/*
+ * PROJECT:         ReactOS API tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for NtRemoveIoCompletionEx
+ */
+
+#include "precomp.h"
+
+START_TEST(NtRemoveIoCompletionEx)
+{
+    FILE_IO_COMPLETION_INFORMATION Information[8];
+    LARGE_INTEGER Timeout;
+    HANDLE Port;
+    NTSTATUS Status;
+    ULONG i, Removed;
+
+    Status = NtCreateIoCompletion(&Port, IO_COMPLETION_ALL_ACCESS, NULL, 0);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Timeout.QuadPart = 0;
+
+    /* Nothing queued */
+    Removed = 0x55555555;
+    Status = NtRemoveIoCompletionEx(Port, Information, 8, &Removed, &Timeout, FALSE);
+    ok_ntstatus(Status, STATUS_TIMEOUT);
+    ok_long(Removed, 0);
+
+    Status = NtRemoveIoCompletionEx(Port, Information, 0, &Removed, &Timeout, FALSE);
+    ok_ntstatus(Status, STATUS_INVALID_PARAMETER);
+
+    /* Everything queued comes back in order with a single call */
+    for (i = 0; i < 3; i++)
+    {
+        Status = NtSetIoCompletion(Port, (PVOID)(ULONG_PTR)(i + 1), (PVOID)(ULONG_PTR)(i + 10), STATUS_SUCCESS, i);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+    }
+
+    RtlFillMemory(Information, sizeof(Information), 0x55);
+    Removed = 0;
+    Status = NtRemoveIoCompletionEx(Port, Information, 8, &Removed, &Timeout, FALSE);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(Removed, 3);
+    for (i = 0; i < 3; i++)
+    {
+        ok(Information[i].KeyContext == (PVOID)(ULONG_PTR)(i + 1), "[%lu] KeyContext = %p\n", i, Information[i].KeyContext);
+        ok(Information[i].ApcContext == (PVOID)(ULONG_PTR)(i + 10), "[%lu] ApcContext = %p\n", i, Information[i].ApcContext);
+        ok_ntstatus(Information[i].IoStatusBlock.Status, STATUS_SUCCESS);
+        ok(Information[i].IoStatusBlock.Information == i, "[%lu] Information = %Iu\n", i, Information[i].IoStatusBlock.Information);
+    }
+
+    /* Only as many as asked for, the rest stays queued */
+    for (i = 0; i < 3; i++)
+    {
+        Status = NtSetIoCompletion(Port, (PVOID)(ULONG_PTR)(i + 1), NULL, STATUS_SUCCESS, 0);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+    }
+
+    Status = NtRemoveIoCompletionEx(Port, Information, 2, &Removed, &Timeout, FALSE);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(Removed, 2);
+
+    Status = NtRemoveIoCompletionEx(Port, Information, 8, &Removed, &Timeout, FALSE);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(Removed, 1);
+    ok(Information[0].KeyContext == (PVOID)3, "KeyContext = %p\n", Information[0].KeyContext);
+
+    NtClose(Port);
+}
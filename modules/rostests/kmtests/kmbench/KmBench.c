@@ -0,0 +1,678 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Kernel-Mode Test Suite microbenchmarks
+ */
+
+/* These are benchmarks rather than tests and are not run by default. Every
+ * result is one trace line starting with "kmbench:" followed by key=value
+ * pairs, so that runs can be collected and compared by scripts.
+ * Throughput benchmarks run on 1, 2, 4... processors at once to show how
+ * the operation scales. Cycle counts come from the time stamp counter,
+ * cross-processor latencies assume it is synchronized. */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define TAG_KMBENCH 'hBmK'
+
+#define KMBENCH_LATENCY_SAMPLES 1000
+#define KMBENCH_TIMER_SAMPLES 100
+#define KMBENCH_TIMER_DUE_TIME (-10 * 1000) /* 1ms */
+#define KMBENCH_FILE_SIZE (64 * 1024)
+#define KMBENCH_READ_SIZE 4096
+
+typedef
+VOID
+KMBENCH_ROUTINE(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations);
+typedef KMBENCH_ROUTINE *PKMBENCH_ROUTINE;
+
+typedef struct _KMBENCH_THREAD
+{
+    PKMBENCH_ROUTINE Routine;
+    PVOID Shared;
+    ULONG Iterations;
+    CCHAR Processor;
+    PKEVENT StartEvent;
+    ULONGLONG Cycles;
+    LONGLONG Elapsed;
+} KMBENCH_THREAD, *PKMBENCH_THREAD;
+
+static
+ULONGLONG
+KmBenchCycles(VOID)
+{
+#if defined(_M_IX86) || defined(_M_AMD64)
+    return __rdtsc();
+#else
+    return KeQueryPerformanceCounter(NULL).QuadPart;
+#endif
+}
+
+static KSTART_ROUTINE KmBenchThread;
+static
+VOID
+NTAPI
+KmBenchThread(
+    _In_ PVOID Parameter)
+{
+    PKMBENCH_THREAD Context = Parameter;
+    LARGE_INTEGER StartTime;
+    ULONGLONG StartCycles;
+
+    KeSetSystemAffinityThread((KAFFINITY)1 << Context->Processor);
+
+    /* Let all the threads start together */
+    KeWaitForSingleObject(Context->StartEvent, Executive, KernelMode, FALSE, NULL);
+
+    StartTime = KeQueryPerformanceCounter(NULL);
+    StartCycles = KmBenchCycles();
+    Context->Routine(Context->Shared, Context->Iterations);
+    Context->Cycles = KmBenchCycles() - StartCycles;
+    Context->Elapsed = KeQueryPerformanceCounter(NULL).QuadPart - StartTime.QuadPart;
+
+    KeRevertToUserAffinityThread();
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+KmBenchRun(
+    _In_ PCSTR Name,
+    _In_ PKMBENCH_ROUTINE Routine,
+    _In_opt_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PKMBENCH_THREAD Contexts;
+    PKTHREAD *Threads;
+    LARGE_INTEGER Frequency;
+    KEVENT StartEvent;
+    ULONGLONG Cycles, Operations;
+    LONGLONG Elapsed;
+    CCHAR Cpus, i;
+
+    Contexts = ExAllocatePoolWithTag(NonPagedPool, KeNumberProcessors * sizeof(*Contexts), TAG_KMBENCH);
+    Threads = ExAllocatePoolWithTag(NonPagedPool, KeNumberProcessors * sizeof(*Threads), TAG_KMBENCH);
+    if (skip(Contexts != NULL && Threads != NULL, "Out of memory\n"))
+    {
+        if (Contexts) ExFreePoolWithTag(Contexts, TAG_KMBENCH);
+        if (Threads) ExFreePoolWithTag(Threads, TAG_KMBENCH);
+        return;
+    }
+
+    KeQueryPerformanceCounter(&Frequency);
+
+    for (Cpus = 1; ; Cpus = min(Cpus * 2, KeNumberProcessors))
+    {
+        KeInitializeEvent(&StartEvent, NotificationEvent, FALSE);
+
+        for (i = 0; i < Cpus; i++)
+        {
+            Contexts[i].Routine = Routine;
+            Contexts[i].Shared = Shared;
+            Contexts[i].Iterations = Iterations;
+            Contexts[i].Processor = i;
+            Contexts[i].StartEvent = &StartEvent;
+            Threads[i] = KmtStartThread(KmBenchThread, &Contexts[i]);
+        }
+
+        /* Go! */
+        KeSetEvent(&StartEvent, IO_NO_INCREMENT, FALSE);
+
+        Cycles = 0;
+        Elapsed = 1;
+        for (i = 0; i < Cpus; i++)
+        {
+            KmtFinishThread(Threads[i], NULL);
+            Cycles += Contexts[i].Cycles;
+            Elapsed = max(Elapsed, Contexts[i].Elapsed);
+        }
+
+        /* Cycles are per operation on one processor, the rate is for all of them */
+        Operations = (ULONGLONG)Iterations * Cpus;
+        trace("kmbench: name=%s cpus=%d ops=%I64u cycles_per_op=%I64u ops_per_sec=%I64u\n",
+              Name,
+              Cpus,
+              Operations,
+              Cycles / Operations,
+              Operations * Frequency.QuadPart / Elapsed);
+
+        if (Cpus == KeNumberProcessors) break;
+    }
+
+    ExFreePoolWithTag(Threads, TAG_KMBENCH);
+    ExFreePoolWithTag(Contexts, TAG_KMBENCH);
+}
+
+static
+VOID
+KmBenchReportLatency(
+    _In_ PCSTR Name,
+    _In_ ULONG Samples,
+    _In_ ULONGLONG Total,
+    _In_ ULONGLONG Maximum,
+    _In_ PCSTR Unit)
+{
+    trace("kmbench: name=%s samples=%lu avg_%s=%I64u max_%s=%I64u\n",
+          Name, Samples, Unit, Total / Samples, Unit, Maximum);
+}
+
+/* Pool *********************************************************************/
+
+static KMBENCH_ROUTINE BenchNonPagedPool;
+static
+VOID
+BenchNonPagedPool(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PVOID Block;
+
+    while (Iterations--)
+    {
+        Block = ExAllocatePoolWithTag(NonPagedPool, 64, TAG_KMBENCH);
+        if (Block) ExFreePoolWithTag(Block, TAG_KMBENCH);
+    }
+}
+
+static KMBENCH_ROUTINE BenchPagedPool;
+static
+VOID
+BenchPagedPool(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PVOID Block;
+
+    while (Iterations--)
+    {
+        Block = ExAllocatePoolWithTag(PagedPool, 64, TAG_KMBENCH);
+        if (Block) ExFreePoolWithTag(Block, TAG_KMBENCH);
+    }
+}
+
+START_TEST(KmBenchPool)
+{
+    KmBenchRun("NonPagedPool64", BenchNonPagedPool, NULL, 200000);
+    KmBenchRun("PagedPool64", BenchPagedPool, NULL, 200000);
+}
+
+/* Locks ********************************************************************/
+
+static KMBENCH_ROUTINE BenchSpinLock;
+static
+VOID
+BenchSpinLock(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PKSPIN_LOCK SpinLock = Shared;
+    KIRQL OldIrql;
+
+    while (Iterations--)
+    {
+        KeAcquireSpinLock(SpinLock, &OldIrql);
+        KeReleaseSpinLock(SpinLock, OldIrql);
+    }
+}
+
+static KMBENCH_ROUTINE BenchQueuedSpinLock;
+static
+VOID
+BenchQueuedSpinLock(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PKSPIN_LOCK SpinLock = Shared;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    while (Iterations--)
+    {
+        KeAcquireInStackQueuedSpinLock(SpinLock, &LockHandle);
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+    }
+}
+
+static KMBENCH_ROUTINE BenchPushLockExclusive;
+static
+VOID
+BenchPushLockExclusive(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PEX_PUSH_LOCK PushLock = Shared;
+
+    KeEnterCriticalRegion();
+    while (Iterations--)
+    {
+        ExfAcquirePushLockExclusive(PushLock);
+        ExfReleasePushLockExclusive(PushLock);
+    }
+    KeLeaveCriticalRegion();
+}
+
+static KMBENCH_ROUTINE BenchPushLockShared;
+static
+VOID
+BenchPushLockShared(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PEX_PUSH_LOCK PushLock = Shared;
+
+    KeEnterCriticalRegion();
+    while (Iterations--)
+    {
+        ExfAcquirePushLockShared(PushLock);
+        ExfReleasePushLockShared(PushLock);
+    }
+    KeLeaveCriticalRegion();
+}
+
+static KMBENCH_ROUTINE BenchResourceExclusive;
+static
+VOID
+BenchResourceExclusive(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PERESOURCE Resource = Shared;
+
+    KeEnterCriticalRegion();
+    while (Iterations--)
+    {
+        ExAcquireResourceExclusiveLite(Resource, TRUE);
+        ExReleaseResourceLite(Resource);
+    }
+    KeLeaveCriticalRegion();
+}
+
+static KMBENCH_ROUTINE BenchResourceShared;
+static
+VOID
+BenchResourceShared(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PERESOURCE Resource = Shared;
+
+    KeEnterCriticalRegion();
+    while (Iterations--)
+    {
+        ExAcquireResourceSharedLite(Resource, TRUE);
+        ExReleaseResourceLite(Resource);
+    }
+    KeLeaveCriticalRegion();
+}
+
+START_TEST(KmBenchSync)
+{
+    PKSPIN_LOCK SpinLock;
+    PEX_PUSH_LOCK PushLock;
+    PERESOURCE Resource;
+    NTSTATUS Status;
+
+    /* The locks are shared by all the threads, so more processors means contention */
+    SpinLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(*SpinLock), TAG_KMBENCH);
+    PushLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(*PushLock), TAG_KMBENCH);
+    Resource = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Resource), TAG_KMBENCH);
+    if (!skip(SpinLock != NULL && PushLock != NULL && Resource != NULL, "Out of memory\n"))
+    {
+        KeInitializeSpinLock(SpinLock);
+        KmBenchRun("SpinLock", BenchSpinLock, SpinLock, 1000000);
+        KmBenchRun("QueuedSpinLock", BenchQueuedSpinLock, SpinLock, 1000000);
+
+        PushLock->Value = 0;
+        KmBenchRun("PushLockExclusive", BenchPushLockExclusive, PushLock, 1000000);
+        KmBenchRun("PushLockShared", BenchPushLockShared, PushLock, 1000000);
+
+        Status = ExInitializeResourceLite(Resource);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        KmBenchRun("ResourceExclusive", BenchResourceExclusive, Resource, 500000);
+        KmBenchRun("ResourceShared", BenchResourceShared, Resource, 500000);
+        ExDeleteResourceLite(Resource);
+    }
+
+    if (Resource) ExFreePoolWithTag(Resource, TAG_KMBENCH);
+    if (PushLock) ExFreePoolWithTag(PushLock, TAG_KMBENCH);
+    if (SpinLock) ExFreePoolWithTag(SpinLock, TAG_KMBENCH);
+}
+
+/* Objects, I/O and registry ************************************************/
+
+static KMBENCH_ROUTINE BenchEventHandle;
+static
+VOID
+BenchEventHandle(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE Handle;
+    NTSTATUS Status;
+
+    InitializeObjectAttributes(&ObjectAttributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL);
+    while (Iterations--)
+    {
+        Status = ZwCreateEvent(&Handle, EVENT_ALL_ACCESS, &ObjectAttributes, NotificationEvent, FALSE);
+        if (NT_SUCCESS(Status)) ZwClose(Handle);
+    }
+}
+
+static KMBENCH_ROUTINE BenchRegistryOpen;
+static
+VOID
+BenchRegistryOpen(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    UNICODE_STRING KeyName = RTL_CONSTANT_STRING(L"\\Registry\\Machine\\SYSTEM\\CurrentControlSet\\Control");
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE Handle;
+    NTSTATUS Status;
+
+    InitializeObjectAttributes(&ObjectAttributes, &KeyName, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+    while (Iterations--)
+    {
+        Status = ZwOpenKey(&Handle, KEY_READ, &ObjectAttributes);
+        if (NT_SUCCESS(Status)) ZwClose(Handle);
+    }
+}
+
+static KMBENCH_ROUTINE BenchIrpAllocate;
+static
+VOID
+BenchIrpAllocate(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    PIRP Irp;
+
+    while (Iterations--)
+    {
+        Irp = IoAllocateIrp(4, FALSE);
+        if (Irp) IoFreeIrp(Irp);
+    }
+}
+
+START_TEST(KmBenchObject)
+{
+    KmBenchRun("EventHandleCreateClose", BenchEventHandle, NULL, 100000);
+    KmBenchRun("RegistryKeyOpenClose", BenchRegistryOpen, NULL, 50000);
+    KmBenchRun("IrpAllocateFree", BenchIrpAllocate, NULL, 200000);
+}
+
+/* Cache manager ************************************************************/
+
+static UNICODE_STRING KmBenchFileName = RTL_CONSTANT_STRING(L"\\SystemRoot\\kmbench.tmp");
+
+static KMBENCH_ROUTINE BenchCachedRead;
+static
+VOID
+BenchCachedRead(
+    _In_ PVOID Shared,
+    _In_ ULONG Iterations)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatus;
+    LARGE_INTEGER Offset;
+    HANDLE Handle;
+    PVOID Buffer;
+    NTSTATUS Status;
+    ULONG i;
+
+    /* Each thread gets its own file object, synchronous ones are serialized */
+    InitializeObjectAttributes(&ObjectAttributes, &KmBenchFileName, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+    Status = ZwOpenFile(&Handle,
+                        GENERIC_READ | SYNCHRONIZE,
+                        &ObjectAttributes,
+                        &IoStatus,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE);
+    if (!NT_SUCCESS(Status)) return;
+
+    Buffer = ExAllocatePoolWithTag(PagedPool, KMBENCH_READ_SIZE, TAG_KMBENCH);
+    if (Buffer)
+    {
+        for (i = 0; i < Iterations; i++)
+        {
+            Offset.QuadPart = (i * KMBENCH_READ_SIZE) % KMBENCH_FILE_SIZE;
+            ZwReadFile(Handle, NULL, NULL, NULL, &IoStatus, Buffer, KMBENCH_READ_SIZE, &Offset, NULL);
+        }
+        ExFreePoolWithTag(Buffer, TAG_KMBENCH);
+    }
+
+    ZwClose(Handle);
+}
+
+START_TEST(KmBenchCache)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatus;
+    LARGE_INTEGER Offset;
+    HANDLE Handle;
+    PVOID Buffer;
+    NTSTATUS Status;
+
+    Buffer = ExAllocatePoolWithTag(PagedPool, KMBENCH_FILE_SIZE, TAG_KMBENCH);
+    if (skip(Buffer != NULL, "Out of memory\n"))
+        return;
+    RtlFillMemory(Buffer, KMBENCH_FILE_SIZE, 0x55);
+
+    /* The file goes away with this handle */
+    InitializeObjectAttributes(&ObjectAttributes, &KmBenchFileName, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+    Status = ZwCreateFile(&Handle,
+                          GENERIC_READ | GENERIC_WRITE | DELETE | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatus,
+                          NULL,
+                          FILE_ATTRIBUTE_TEMPORARY,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          FILE_OVERWRITE_IF,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE | FILE_DELETE_ON_CLOSE,
+                          NULL,
+                          0);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    if (!skip(NT_SUCCESS(Status), "No file to read\n"))
+    {
+        /* Writing and reading it back leaves every page in the cache */
+        Offset.QuadPart = 0;
+        Status = ZwWriteFile(Handle, NULL, NULL, NULL, &IoStatus, Buffer, KMBENCH_FILE_SIZE, &Offset, NULL);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        Status = ZwReadFile(Handle, NULL, NULL, NULL, &IoStatus, Buffer, KMBENCH_FILE_SIZE, &Offset, NULL);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+
+        KmBenchRun("CachedRead4K", BenchCachedRead, NULL, 100000);
+
+        ZwClose(Handle);
+    }
+
+    ExFreePoolWithTag(Buffer, TAG_KMBENCH);
+}
+
+/* Scheduling ***************************************************************/
+
+typedef struct _KMBENCH_PINGPONG
+{
+    KEVENT Ping;
+    KEVENT Pong;
+    CCHAR Processor;
+    ULONG Iterations;
+} KMBENCH_PINGPONG, *PKMBENCH_PINGPONG;
+
+static KSTART_ROUTINE PongThread;
+static
+VOID
+NTAPI
+PongThread(
+    _In_ PVOID Parameter)
+{
+    PKMBENCH_PINGPONG Context = Parameter;
+    ULONG i;
+
+    KeSetSystemAffinityThread((KAFFINITY)1 << Context->Processor);
+
+    for (i = 0; i < Context->Iterations; i++)
+    {
+        KeWaitForSingleObject(&Context->Ping, Executive, KernelMode, FALSE, NULL);
+        KeSetEvent(&Context->Pong, IO_NO_INCREMENT, FALSE);
+    }
+
+    KeRevertToUserAffinityThread();
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+/* On one processor every hand-off is a context switch, on two it is a wake-up of a waiting thread */
+static
+VOID
+KmBenchPingPong(
+    _In_ PCSTR Name,
+    _In_ CCHAR PongProcessor)
+{
+    KMBENCH_PINGPONG Context;
+    ULONGLONG StartCycles, Cycles;
+    PKTHREAD Thread;
+    ULONG i;
+
+    KeInitializeEvent(&Context.Ping, SynchronizationEvent, FALSE);
+    KeInitializeEvent(&Context.Pong, SynchronizationEvent, FALSE);
+    Context.Processor = PongProcessor;
+    Context.Iterations = 20000;
+
+    KeSetSystemAffinityThread((KAFFINITY)1);
+    Thread = KmtStartThread(PongThread, &Context);
+
+    StartCycles = KmBenchCycles();
+    for (i = 0; i < Context.Iterations; i++)
+    {
+        KeSetEvent(&Context.Ping, IO_NO_INCREMENT, FALSE);
+        KeWaitForSingleObject(&Context.Pong, Executive, KernelMode, FALSE, NULL);
+    }
+    Cycles = KmBenchCycles() - StartCycles;
+
+    KeRevertToUserAffinityThread();
+    KmtFinishThread(Thread, NULL);
+
+    trace("kmbench: name=%s cpus=%d ops=%lu cycles_per_op=%I64u\n",
+          Name, PongProcessor ? 2 : 1, Context.Iterations * 2, Cycles / (Context.Iterations * 2));
+}
+
+typedef struct _KMBENCH_DPC
+{
+    KDPC Dpc;
+    KTIMER Timer;
+    KEVENT Done;
+    ULONGLONG QueuedCycles;
+    ULONGLONG RunCycles;
+    ULONGLONG RunTime;
+} KMBENCH_DPC, *PKMBENCH_DPC;
+
+static KDEFERRED_ROUTINE BenchDpcRoutine;
+static
+VOID
+NTAPI
+BenchDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PKMBENCH_DPC Context = DeferredContext;
+
+    Context->RunCycles = KmBenchCycles();
+    Context->RunTime = KeQueryInterruptTime();
+    KeSetEvent(&Context->Done, IO_NO_INCREMENT, FALSE);
+}
+
+static
+VOID
+KmBenchDpcLatency(
+    _In_ PKMBENCH_DPC Context,
+    _In_ PCSTR Name,
+    _In_ CCHAR Processor)
+{
+    ULONGLONG Latency, Total = 0, Maximum = 0;
+    ULONG i;
+
+    KeInitializeDpc(&Context->Dpc, BenchDpcRoutine, Context);
+    KeSetTargetProcessorDpc(&Context->Dpc, Processor);
+
+    KeSetSystemAffinityThread((KAFFINITY)1);
+    for (i = 0; i < KMBENCH_LATENCY_SAMPLES; i++)
+    {
+        KeClearEvent(&Context->Done);
+        Context->QueuedCycles = KmBenchCycles();
+        KeInsertQueueDpc(&Context->Dpc, NULL, NULL);
+        KeWaitForSingleObject(&Context->Done, Executive, KernelMode, FALSE, NULL);
+
+        Latency = Context->RunCycles - Context->QueuedCycles;
+        Total += Latency;
+        Maximum = max(Maximum, Latency);
+    }
+    KeRevertToUserAffinityThread();
+
+    KmBenchReportLatency(Name, KMBENCH_LATENCY_SAMPLES, Total, Maximum, "cycles");
+}
+
+static
+VOID
+KmBenchTimerLatency(
+    _In_ PKMBENCH_DPC Context)
+{
+    LARGE_INTEGER DueTime;
+    ULONGLONG Expected, Late, Total = 0, Maximum = 0;
+    ULONG i;
+
+    KeInitializeDpc(&Context->Dpc, BenchDpcRoutine, Context);
+    KeInitializeTimer(&Context->Timer);
+    DueTime.QuadPart = KMBENCH_TIMER_DUE_TIME;
+
+    /* Lateness is limited by the clock tick, this shows what drivers really get */
+    for (i = 0; i < KMBENCH_TIMER_SAMPLES; i++)
+    {
+        KeClearEvent(&Context->Done);
+        Expected = KeQueryInterruptTime() - KMBENCH_TIMER_DUE_TIME;
+        KeSetTimer(&Context->Timer, DueTime, &Context->Dpc);
+        KeWaitForSingleObject(&Context->Done, Executive, KernelMode, FALSE, NULL);
+
+        Late = (Context->RunTime > Expected) ? (Context->RunTime - Expected) / 10 : 0;
+        Total += Late;
+        Maximum = max(Maximum, Late);
+    }
+
+    KmBenchReportLatency("TimerLateness", KMBENCH_TIMER_SAMPLES, Total, Maximum, "us");
+}
+
+START_TEST(KmBenchSchedule)
+{
+    PKMBENCH_DPC Context;
+
+    KmBenchPingPong("EventContextSwitch", 0);
+    if (KeNumberProcessors > 1)
+        KmBenchPingPong("EventSignalToWake", 1);
+
+    Context = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Context), TAG_KMBENCH);
+    if (skip(Context != NULL, "Out of memory\n"))
+        return;
+    KeInitializeEvent(&Context->Done, NotificationEvent, FALSE);
+
+    KmBenchDpcLatency(Context, "DpcLatencyLocal", 0);
+    if (KeNumberProcessors > 1)
+        KmBenchDpcLatency(Context, "DpcLatencyRemote", 1);
+    KmBenchTimerLatency(Context);
+
+    ExFreePoolWithTag(Context, TAG_KMBENCH);
+}
+
+START_TEST(KmBench)
+{
+    Test_KmBenchPool();
+    Test_KmBenchSync();
+    Test_KmBenchObject();
+    Test_KmBenchCache();
+    Test_KmBenchSchedule();
+}
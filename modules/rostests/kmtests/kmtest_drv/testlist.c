@@ -15,6 +15,7 @@ KMT_TESTFUNC Test_ExHardError;
 KMT_TESTFUNC Test_ExHardErrorInteractive;
 KMT_TESTFUNC Test_ExInterlocked;
 KMT_TESTFUNC Test_ExPools;
+KMT_TESTFUNC Test_ExPoolsPerf;
 KMT_TESTFUNC Test_ExResource;
 KMT_TESTFUNC Test_ExSequencedList;
 KMT_TESTFUNC Test_ExSingleList;
@@ -45,6 +46,12 @@ KMT_TESTFUNC Test_KeProcessor;
 KMT_TESTFUNC Test_KeSpinLock;
 KMT_TESTFUNC Test_KeTimer;
 KMT_TESTFUNC Test_KernelType;
+KMT_TESTFUNC Test_KmBench;
+KMT_TESTFUNC Test_KmBenchCache;
+KMT_TESTFUNC Test_KmBenchObject;
+KMT_TESTFUNC Test_KmBenchPool;
+KMT_TESTFUNC Test_KmBenchSchedule;
+KMT_TESTFUNC Test_KmBenchSync;
 KMT_TESTFUNC Test_MmMdl;
 KMT_TESTFUNC Test_MmSection;
 KMT_TESTFUNC Test_MmReservedMapping;
@@ -89,6 +96,7 @@ const KMT_TEST TestList[] =
     { "-ExHardErrorInteractive",            Test_ExHardErrorInteractive },
     { "ExInterlocked",                      Test_ExInterlocked },
     { "ExPools",                            Test_ExPools },
+    { "-ExPoolsPerf",                       Test_ExPoolsPerf },
     { "ExResource",                         Test_ExResource },
     { "ExSequencedList",                    Test_ExSequencedList },
     { "ExSingleList",                       Test_ExSingleList },
@@ -120,6 +128,12 @@ const KMT_TEST TestList[] =
     { "KeSpinLock",                         Test_KeSpinLock },
     { "KeTimer",                            Test_KeTimer },
     { "-KernelType",                        Test_KernelType },
+    { "-KmBench",                           Test_KmBench },
+    { "-KmBenchCache",                      Test_KmBenchCache },
+    { "-KmBenchObject",                     Test_KmBenchObject },
+    { "-KmBenchPool",                       Test_KmBenchPool },
+    { "-KmBenchSchedule",                   Test_KmBenchSchedule },
+    { "-KmBenchSync",                       Test_KmBenchSync },
     { "MmMdl",                              Test_MmMdl },
     { "MmSection",                          Test_MmSection },
     { "MmReservedMapping",                  Test_MmReservedMapping },
@@ -0,0 +1,133 @@
+/*
+ * PROJECT:     ReactOS kernel-mode tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Kernel-Mode Test Suite pool allocation stress benchmark
+ */
+
+/* This is a benchmark rather than a test: it reports how many small pool
+ * allocations each processor gets done per second, when all of them are
+ * allocating at once. It's not run by default. */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define TAG_POOLPERF 'fPpP'
+
+/* Run length, in 100ns units */
+#define POOL_PERF_DURATION (2 * 1000 * 1000 * 10)
+
+/* Blocks kept alive by each thread, to not only hit the top of the lookasides */
+#define POOL_PERF_BATCH 16
+
+typedef struct _POOL_PERF_CONTEXT
+{
+    POOL_TYPE PoolType;
+    CCHAR Processor;
+    PKEVENT StartEvent;
+    ULONGLONG Allocations;
+    ULONG Failures;
+} POOL_PERF_CONTEXT, *PPOOL_PERF_CONTEXT;
+
+static KSTART_ROUTINE PoolPerfThread;
+static
+VOID
+NTAPI
+PoolPerfThread(
+    _In_ PVOID Parameter)
+{
+    PPOOL_PERF_CONTEXT Context = Parameter;
+    PVOID Blocks[POOL_PERF_BATCH];
+    ULONGLONG EndTime;
+    ULONG i, Size = 0;
+
+    KeSetSystemAffinityThread((KAFFINITY)1 << Context->Processor);
+
+    /* Let all the threads start together */
+    KeWaitForSingleObject(Context->StartEvent, Executive, KernelMode, FALSE, NULL);
+
+    EndTime = KeQueryInterruptTime() + POOL_PERF_DURATION;
+    while (KeQueryInterruptTime() < EndTime)
+    {
+        for (i = 0; i < POOL_PERF_BATCH; i++)
+        {
+            /* Cycle through the sizes served by the pool lookaside lists */
+            Size = (Size + 24) % 240 + 8;
+            Blocks[i] = ExAllocatePoolWithTag(Context->PoolType, Size, TAG_POOLPERF);
+            if (!Blocks[i]) Context->Failures++;
+        }
+
+        for (i = 0; i < POOL_PERF_BATCH; i++)
+        {
+            if (Blocks[i]) ExFreePoolWithTag(Blocks[i], TAG_POOLPERF);
+        }
+
+        Context->Allocations += POOL_PERF_BATCH;
+    }
+
+    KeRevertToUserAffinityThread();
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+PoolPerfRun(
+    _In_ POOL_TYPE PoolType)
+{
+    PPOOL_PERF_CONTEXT Contexts;
+    PKTHREAD *Threads;
+    KEVENT StartEvent;
+    CCHAR i;
+    ULONGLONG Total = 0;
+
+    Contexts = ExAllocatePoolWithTag(NonPagedPool, KeNumberProcessors * sizeof(*Contexts), TAG_POOLPERF);
+    Threads = ExAllocatePoolWithTag(NonPagedPool, KeNumberProcessors * sizeof(*Threads), TAG_POOLPERF);
+    if (skip(Contexts != NULL && Threads != NULL, "Out of memory\n"))
+    {
+        if (Contexts) ExFreePoolWithTag(Contexts, TAG_POOLPERF);
+        if (Threads) ExFreePoolWithTag(Threads, TAG_POOLPERF);
+        return;
+    }
+
+    KeInitializeEvent(&StartEvent, NotificationEvent, FALSE);
+
+    for (i = 0; i < KeNumberProcessors; i++)
+    {
+        Contexts[i].PoolType = PoolType;
+        Contexts[i].Processor = i;
+        Contexts[i].StartEvent = &StartEvent;
+        Contexts[i].Allocations = 0;
+        Contexts[i].Failures = 0;
+        Threads[i] = KmtStartThread(PoolPerfThread, &Contexts[i]);
+    }
+
+    /* Go! */
+    KeSetEvent(&StartEvent, IO_NO_INCREMENT, FALSE);
+
+    for (i = 0; i < KeNumberProcessors; i++)
+    {
+        KmtFinishThread(Threads[i], NULL);
+
+        ok_eq_ulong(Contexts[i].Failures, 0UL);
+        trace("%s pool, CPU %d: %I64u allocations/s\n",
+              PoolType == PagedPool ? "Paged" : "NonPaged",
+              i,
+              Contexts[i].Allocations * 10000000 / POOL_PERF_DURATION);
+        Total += Contexts[i].Allocations;
+    }
+
+    trace("%s pool, %d CPU(s): %I64u allocations/s total\n",
+          PoolType == PagedPool ? "Paged" : "NonPaged",
+          KeNumberProcessors,
+          Total * 10000000 / POOL_PERF_DURATION);
+
+    ExFreePoolWithTag(Threads, TAG_POOLPERF);
+    ExFreePoolWithTag(Contexts, TAG_POOLPERF);
+}
+
+START_TEST(ExPoolsPerf)
+{
+    PoolPerfRun(NonPagedPool);
+    PoolPerfRun(PagedPool);
+}
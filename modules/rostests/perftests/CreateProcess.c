@@ -0,0 +1,66 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     CreateProcess latency
+ */
+
+#include "perftest.h"
+
+#define PROCESSES_PER_RUN 20
+
+/* Time from CreateProcess until the child has run to completion */
+static
+double
+TimeCreateProcess(
+    _In_ PCSTR Executable)
+{
+    CHAR CommandLine[MAX_PATH + 32];
+    STARTUPINFOA StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    ULONGLONG Start;
+    ULONG i;
+
+    Start = PerfNow();
+    for (i = 0; i < PROCESSES_PER_RUN; i++)
+    {
+        sprintf(CommandLine, "\"%s\" CreateProcess child", Executable);
+        ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+        StartupInfo.cb = sizeof(StartupInfo);
+
+        if (!CreateProcessA(NULL, CommandLine, NULL, NULL, FALSE, 0, NULL, NULL,
+                            &StartupInfo, &ProcessInfo))
+        {
+            ok(0, "CreateProcessA failed with %lu\n", GetLastError());
+            return 0;
+        }
+
+        WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        CloseHandle(ProcessInfo.hThread);
+        CloseHandle(ProcessInfo.hProcess);
+    }
+
+    return PerfElapsed(Start) * 1000.0 / PROCESSES_PER_RUN;
+}
+
+START_TEST(CreateProcess)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    char **argv;
+    int argc;
+    ULONG i;
+
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 3)
+    {
+        /* Child, exit right away */
+        return;
+    }
+
+    /* The first launch pulls the image into the cache */
+    TimeCreateProcess(argv[0]);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeCreateProcess(argv[0]);
+    PerfReport("CreateProcess", "create_wait", "ms", Values, Runs);
+}
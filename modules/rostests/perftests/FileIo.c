@@ -0,0 +1,207 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     CreateFile/ReadFile/WriteFile throughput
+ */
+
+#include "perftest.h"
+
+#define FILE_SIZE       (16 * 1024 * 1024)
+#define CHUNK_SIZE      (64 * 1024)
+#define OVERLAPPED_IOS  4
+
+static
+double
+ToMegabytesPerSecond(
+    _In_ double Seconds)
+{
+    return Seconds > 0 ? FILE_SIZE / (1024.0 * 1024.0) / Seconds : 0;
+}
+
+static
+double
+TimeWrite(
+    _In_ PCWSTR Path,
+    _In_ PVOID Buffer)
+{
+    HANDLE File;
+    ULONGLONG Start;
+    DWORD Written;
+    ULONG Offset;
+    double Seconds;
+
+    Start = PerfNow();
+    File = CreateFileW(Path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return 0;
+
+    for (Offset = 0; Offset < FILE_SIZE; Offset += CHUNK_SIZE)
+    {
+        if (!WriteFile(File, Buffer, CHUNK_SIZE, &Written, NULL) || Written != CHUNK_SIZE)
+        {
+            ok(0, "WriteFile failed with %lu\n", GetLastError());
+            break;
+        }
+    }
+    FlushFileBuffers(File);
+    CloseHandle(File);
+    Seconds = PerfElapsed(Start);
+
+    return ToMegabytesPerSecond(Seconds);
+}
+
+static
+double
+TimeRead(
+    _In_ PCWSTR Path,
+    _In_ PVOID Buffer,
+    _In_ DWORD Flags)
+{
+    HANDLE File;
+    ULONGLONG Start;
+    DWORD Read;
+    ULONG Offset;
+
+    Start = PerfNow();
+    File = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | Flags, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return 0;
+
+    for (Offset = 0; Offset < FILE_SIZE; Offset += CHUNK_SIZE)
+    {
+        if (!ReadFile(File, Buffer, CHUNK_SIZE, &Read, NULL) || Read != CHUNK_SIZE)
+        {
+            ok(0, "ReadFile failed with %lu\n", GetLastError());
+            break;
+        }
+    }
+    CloseHandle(File);
+
+    return ToMegabytesPerSecond(PerfElapsed(Start));
+}
+
+/* Keeps OVERLAPPED_IOS unbuffered reads in flight at any time */
+static
+double
+TimeOverlappedRead(
+    _In_ PCWSTR Path,
+    _In_ PUCHAR Buffer)
+{
+    HANDLE File;
+    HANDLE Events[OVERLAPPED_IOS];
+    OVERLAPPED Overlapped[OVERLAPPED_IOS];
+    ULONGLONG Start;
+    ULONG Issued = 0, Completed = 0;
+    DWORD Read, Wait;
+    ULONG i;
+    BOOL Failed = FALSE;
+
+    Start = PerfNow();
+    File = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING,
+                       NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return 0;
+
+    for (i = 0; i < OVERLAPPED_IOS; i++)
+        Events[i] = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    while (Completed < FILE_SIZE / CHUNK_SIZE && !Failed)
+    {
+        /* Refill every idle slot */
+        for (i = 0; i < OVERLAPPED_IOS && Issued < FILE_SIZE / CHUNK_SIZE; i++)
+        {
+            if (Issued - Completed >= OVERLAPPED_IOS)
+                break;
+
+            ZeroMemory(&Overlapped[Issued % OVERLAPPED_IOS], sizeof(OVERLAPPED));
+            Overlapped[Issued % OVERLAPPED_IOS].Offset = Issued * CHUNK_SIZE;
+            Overlapped[Issued % OVERLAPPED_IOS].hEvent = Events[Issued % OVERLAPPED_IOS];
+            if (!ReadFile(File,
+                          Buffer + (Issued % OVERLAPPED_IOS) * CHUNK_SIZE,
+                          CHUNK_SIZE,
+                          NULL,
+                          &Overlapped[Issued % OVERLAPPED_IOS]) &&
+                GetLastError() != ERROR_IO_PENDING)
+            {
+                ok(0, "ReadFile failed with %lu\n", GetLastError());
+                Failed = TRUE;
+                break;
+            }
+            Issued++;
+        }
+
+        if (Failed)
+            break;
+
+        /* Wait for the oldest request so its slot can be reused */
+        Wait = Completed % OVERLAPPED_IOS;
+        if (!GetOverlappedResult(File, &Overlapped[Wait], &Read, TRUE) || Read != CHUNK_SIZE)
+        {
+            ok(0, "GetOverlappedResult failed with %lu\n", GetLastError());
+            Failed = TRUE;
+        }
+        Completed++;
+    }
+
+    /* Drain whatever is still in flight before the buffers go away */
+    while (Completed < Issued)
+    {
+        GetOverlappedResult(File, &Overlapped[Completed % OVERLAPPED_IOS], &Read, TRUE);
+        Completed++;
+    }
+
+    CloseHandle(File);
+    for (i = 0; i < OVERLAPPED_IOS; i++)
+        CloseHandle(Events[i]);
+
+    return Failed ? 0 : ToMegabytesPerSecond(PerfElapsed(Start));
+}
+
+START_TEST(FileIo)
+{
+    WCHAR Path[MAX_PATH];
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    PUCHAR Buffer;
+    ULONG i;
+
+    if (!PerfGetTempFileName(Path, L"perftest_fileio.tmp"))
+    {
+        skip("No temporary directory\n");
+        return;
+    }
+
+    /* Sector aligned, large enough for every overlapped request */
+    Buffer = VirtualAlloc(NULL, OVERLAPPED_IOS * CHUNK_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    ok(Buffer != NULL, "VirtualAlloc failed\n");
+    if (!Buffer)
+        return;
+    FillMemory(Buffer, OVERLAPPED_IOS * CHUNK_SIZE, 0x5A);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeWrite(Path, Buffer);
+    PerfReport("FileIo", "write", "MB/s", Values, Runs);
+
+    /* Prime the cache, then read through it */
+    TimeRead(Path, Buffer, FILE_FLAG_SEQUENTIAL_SCAN);
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeRead(Path, Buffer, FILE_FLAG_SEQUENTIAL_SCAN);
+    PerfReport("FileIo", "read_cached", "MB/s", Values, Runs);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeRead(Path, Buffer, FILE_FLAG_NO_BUFFERING);
+    PerfReport("FileIo", "read_uncached", "MB/s", Values, Runs);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeOverlappedRead(Path, Buffer);
+    PerfReport("FileIo", "read_overlapped", "MB/s", Values, Runs);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    DeleteFileW(Path);
+}
@@ -0,0 +1,152 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     BitBlt and ExtTextOut throughput
+ */
+
+#include "perftest.h"
+
+#include <wingdi.h>
+
+#define SURFACE_SIZE     512
+#define BLTS_PER_RUN     200
+#define TEXTOUTS_PER_RUN 5000
+
+/* Memory DCs keep the numbers independent of the display driver */
+static
+HDC
+CreateSurface(
+    _In_ WORD BitCount,
+    _Out_ HBITMAP *Bitmap)
+{
+    BITMAPINFO Info = { { 0 } };
+    PVOID Bits;
+    HDC Dc;
+
+    Info.bmiHeader.biSize = sizeof(Info.bmiHeader);
+    Info.bmiHeader.biWidth = SURFACE_SIZE;
+    Info.bmiHeader.biHeight = -SURFACE_SIZE;
+    Info.bmiHeader.biPlanes = 1;
+    Info.bmiHeader.biBitCount = BitCount;
+    Info.bmiHeader.biCompression = BI_RGB;
+
+    *Bitmap = CreateDIBSection(NULL, &Info, DIB_RGB_COLORS, &Bits, NULL, 0);
+    if (!*Bitmap)
+        return NULL;
+
+    Dc = CreateCompatibleDC(NULL);
+    if (!Dc)
+    {
+        DeleteObject(*Bitmap);
+        return NULL;
+    }
+
+    SelectObject(Dc, *Bitmap);
+    return Dc;
+}
+
+/* Megapixels per second */
+static
+double
+TimeBitBlt(
+    _In_ HDC Destination,
+    _In_ HDC Source,
+    _In_ DWORD Rop)
+{
+    ULONGLONG Start;
+    double Seconds;
+    ULONG i;
+
+    Start = PerfNow();
+    for (i = 0; i < BLTS_PER_RUN; i++)
+    {
+        if (!BitBlt(Destination, 0, 0, SURFACE_SIZE, SURFACE_SIZE, Source, 0, 0, Rop))
+        {
+            ok(0, "BitBlt failed\n");
+            return 0;
+        }
+    }
+    GdiFlush();
+    Seconds = PerfElapsed(Start);
+
+    return Seconds > 0 ? (double)SURFACE_SIZE * SURFACE_SIZE * BLTS_PER_RUN / 1000000.0 / Seconds : 0;
+}
+
+/* Calls per second */
+static
+double
+TimeExtTextOut(
+    _In_ HDC Dc,
+    _In_ UINT Options)
+{
+    static const WCHAR Text[] = L"The quick brown fox jumps over the lazy dog";
+    RECT Rect = { 0, 0, SURFACE_SIZE, 20 };
+    ULONGLONG Start;
+    double Seconds;
+    ULONG i;
+
+    Start = PerfNow();
+    for (i = 0; i < TEXTOUTS_PER_RUN; i++)
+    {
+        if (!ExtTextOutW(Dc, 0, (i % 24) * 20, Options, &Rect, Text, ARRAYSIZE(Text) - 1, NULL))
+        {
+            ok(0, "ExtTextOutW failed\n");
+            return 0;
+        }
+    }
+    GdiFlush();
+    Seconds = PerfElapsed(Start);
+
+    return Seconds > 0 ? TEXTOUTS_PER_RUN / Seconds : 0;
+}
+
+START_TEST(Gdi)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    HBITMAP DestinationBitmap, SourceBitmap;
+    HDC Destination, Source;
+    HFONT Font, OldFont;
+    ULONG i;
+
+    Destination = CreateSurface(32, &DestinationBitmap);
+    Source = CreateSurface(32, &SourceBitmap);
+    ok(Destination && Source, "Failed to create the surfaces\n");
+    if (!Destination || !Source)
+        goto Cleanup;
+
+    PatBlt(Source, 0, 0, SURFACE_SIZE, SURFACE_SIZE, WHITENESS);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeBitBlt(Destination, Source, SRCCOPY);
+    PerfReport("Gdi", "bitblt_srccopy", "Mpix/s", Values, Runs);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeBitBlt(Destination, Source, SRCINVERT);
+    PerfReport("Gdi", "bitblt_srcinvert", "Mpix/s", Values, Runs);
+
+    Font = GetStockObject(DEFAULT_GUI_FONT);
+    OldFont = SelectObject(Destination, Font);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeExtTextOut(Destination, 0);
+    PerfReport("Gdi", "exttextout", "calls/s", Values, Runs);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeExtTextOut(Destination, ETO_OPAQUE | ETO_CLIPPED);
+    PerfReport("Gdi", "exttextout_opaque_clipped", "calls/s", Values, Runs);
+
+    SelectObject(Destination, OldFont);
+
+Cleanup:
+    if (Destination)
+    {
+        DeleteDC(Destination);
+        DeleteObject(DestinationBitmap);
+    }
+    if (Source)
+    {
+        DeleteDC(Source);
+        DeleteObject(SourceBitmap);
+    }
+}
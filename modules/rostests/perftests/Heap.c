@@ -0,0 +1,142 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Heap allocation scaling
+ */
+
+#include "perftest.h"
+
+#define MAX_THREADS     16
+#define OPS_PER_THREAD  200000
+#define SLOTS           64
+
+typedef struct _HEAP_WORKER
+{
+    HANDLE Heap;
+    HANDLE StartEvent;
+    ULONG Seed;
+} HEAP_WORKER, *PHEAP_WORKER;
+
+/* Keeps a ring of live blocks so the heap has to deal with fragmentation */
+static
+DWORD
+WINAPI
+HeapWorker(
+    _In_ PVOID Context)
+{
+    PHEAP_WORKER Worker = Context;
+    PVOID Blocks[SLOTS] = { NULL };
+    ULONG Seed = Worker->Seed;
+    ULONG Slot, Size;
+    ULONG i;
+
+    WaitForSingleObject(Worker->StartEvent, INFINITE);
+
+    for (i = 0; i < OPS_PER_THREAD; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Slot = (Seed >> 16) % SLOTS;
+        Size = 16 + ((Seed >> 8) & 1023);
+
+        if (Worker->Heap)
+        {
+            HeapFree(Worker->Heap, 0, Blocks[Slot]);
+            Blocks[Slot] = HeapAlloc(Worker->Heap, 0, Size);
+        }
+        else
+        {
+            free(Blocks[Slot]);
+            Blocks[Slot] = malloc(Size);
+        }
+    }
+
+    for (Slot = 0; Slot < SLOTS; Slot++)
+    {
+        if (Worker->Heap)
+            HeapFree(Worker->Heap, 0, Blocks[Slot]);
+        else
+            free(Blocks[Slot]);
+    }
+
+    return 0;
+}
+
+/* Allocations plus frees per second, summed over all threads */
+static
+double
+TimeHeap(
+    _In_opt_ HANDLE Heap,
+    _In_ ULONG ThreadCount)
+{
+    HEAP_WORKER Workers[MAX_THREADS];
+    HANDLE Threads[MAX_THREADS];
+    HANDLE StartEvent;
+    ULONGLONG Start;
+    double Seconds;
+    ULONG i;
+
+    StartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    for (i = 0; i < ThreadCount; i++)
+    {
+        Workers[i].Heap = Heap;
+        Workers[i].StartEvent = StartEvent;
+        Workers[i].Seed = i + 1;
+        Threads[i] = CreateThread(NULL, 0, HeapWorker, &Workers[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Threads[i])
+        {
+            ThreadCount = i;
+            break;
+        }
+    }
+
+    Start = PerfNow();
+    SetEvent(StartEvent);
+    WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+    Seconds = PerfElapsed(Start);
+
+    for (i = 0; i < ThreadCount; i++)
+        CloseHandle(Threads[i]);
+    CloseHandle(StartEvent);
+
+    if (!ThreadCount || Seconds <= 0)
+        return 0;
+
+    return 2.0 * OPS_PER_THREAD * ThreadCount / Seconds;
+}
+
+static
+VOID
+MeasureHeap(
+    _In_opt_ HANDLE Heap,
+    _In_ PCSTR Prefix)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    SYSTEM_INFO SystemInfo;
+    ULONG MaxThreads;
+    ULONG Threads;
+    CHAR Name[32];
+    ULONG i;
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = min(max(SystemInfo.dwNumberOfProcessors, 1), MAX_THREADS);
+
+    for (Threads = 1; ; Threads = min(Threads * 2, MaxThreads))
+    {
+        for (i = 0; i < Runs; i++)
+            Values[i] = TimeHeap(Heap, Threads);
+
+        sprintf(Name, "%s_%lu_threads", Prefix, Threads);
+        PerfReport("Heap", Name, "ops/s", Values, Runs);
+
+        if (Threads == MaxThreads)
+            break;
+    }
+}
+
+START_TEST(Heap)
+{
+    MeasureHeap(NULL, "malloc");
+    MeasureHeap(GetProcessHeap(), "process_heap");
+}
@@ -0,0 +1,79 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     LoadLibrary cold and warm times
+ */
+
+#include "perftest.h"
+
+#define LOADS_PER_RUN 50
+
+/*
+ * Cold: the DLL is not mapped in the process, so every load maps the image,
+ * applies relocations, snaps imports and runs DllMain.
+ * Warm: the DLL is already loaded, so the load only takes a reference.
+ */
+static
+double
+TimeLoadLibrary(
+    _In_ PCWSTR Name)
+{
+    HMODULE Module;
+    ULONGLONG Start;
+    ULONG i;
+
+    Start = PerfNow();
+    for (i = 0; i < LOADS_PER_RUN; i++)
+    {
+        Module = LoadLibraryW(Name);
+        if (!Module)
+        {
+            ok(0, "LoadLibraryW(%ls) failed with %lu\n", Name, GetLastError());
+            return 0;
+        }
+        FreeLibrary(Module);
+    }
+
+    return PerfElapsed(Start) * 1000000.0 / LOADS_PER_RUN;
+}
+
+static
+VOID
+MeasureDll(
+    _In_ PCWSTR Name,
+    _In_ PCSTR ColdName,
+    _In_ PCSTR WarmName)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    HMODULE Pinned;
+    ULONG i;
+
+    if (GetModuleHandleW(Name))
+    {
+        skip("%ls is already loaded, cannot measure a cold load\n", Name);
+        return;
+    }
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeLoadLibrary(Name);
+    PerfReport("LoadLibrary", ColdName, "us", Values, Runs);
+
+    Pinned = LoadLibraryW(Name);
+    ok(Pinned != NULL, "LoadLibraryW(%ls) failed with %lu\n", Name, GetLastError());
+    if (!Pinned)
+        return;
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeLoadLibrary(Name);
+    PerfReport("LoadLibrary", WarmName, "us", Values, Runs);
+
+    FreeLibrary(Pinned);
+}
+
+START_TEST(LoadLibrary)
+{
+    /* A small leaf DLL and a large one with many imports */
+    MeasureDll(L"version.dll", "version_cold", "version_warm");
+    MeasureDll(L"shell32.dll", "shell32_cold", "shell32_warm");
+}
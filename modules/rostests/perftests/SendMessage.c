@@ -0,0 +1,142 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     SendMessage round trips
+ */
+
+#include "perftest.h"
+
+#include <winuser.h>
+
+#define MESSAGES_PER_RUN 20000
+#define WM_PERFTEST (WM_APP + 1)
+
+static
+LRESULT
+CALLBACK
+PerfWndProc(
+    _In_ HWND hWnd,
+    _In_ UINT Message,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam)
+{
+    if (Message == WM_PERFTEST)
+        return wParam + 1;
+
+    return DefWindowProcW(hWnd, Message, wParam, lParam);
+}
+
+static
+HWND
+CreatePerfWindow(VOID)
+{
+    return CreateWindowExW(0, L"PerfTestWindow", NULL, WS_OVERLAPPED,
+                           0, 0, 10, 10, NULL, NULL, GetModuleHandleW(NULL), NULL);
+}
+
+typedef struct _WINDOW_THREAD
+{
+    HWND Window;
+    HANDLE ReadyEvent;
+} WINDOW_THREAD, *PWINDOW_THREAD;
+
+/* Owns a window on another thread and pumps its messages */
+static
+DWORD
+WINAPI
+WindowThread(
+    _In_ PVOID Context)
+{
+    PWINDOW_THREAD Thread = Context;
+    MSG Msg;
+
+    Thread->Window = CreatePerfWindow();
+    SetEvent(Thread->ReadyEvent);
+    if (!Thread->Window)
+        return 1;
+
+    while (GetMessageW(&Msg, NULL, 0, 0) > 0)
+        DispatchMessageW(&Msg);
+
+    DestroyWindow(Thread->Window);
+    return 0;
+}
+
+/* Microseconds per SendMessage */
+static
+double
+TimeSendMessage(
+    _In_ HWND Window)
+{
+    ULONGLONG Start;
+    LRESULT Result;
+    ULONG i;
+
+    Start = PerfNow();
+    for (i = 0; i < MESSAGES_PER_RUN; i++)
+    {
+        Result = SendMessageW(Window, WM_PERFTEST, i, 0);
+        if (Result != (LRESULT)i + 1)
+        {
+            ok(0, "SendMessageW returned %Id, expected %lu\n", Result, i + 1);
+            return 0;
+        }
+    }
+
+    return PerfElapsed(Start) * 1000000.0 / MESSAGES_PER_RUN;
+}
+
+START_TEST(SendMessage)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    WNDCLASSW WndClass = { 0 };
+    WINDOW_THREAD Thread;
+    HANDLE ThreadHandle;
+    HWND Window;
+    ULONG i;
+
+    WndClass.lpfnWndProc = PerfWndProc;
+    WndClass.hInstance = GetModuleHandleW(NULL);
+    WndClass.lpszClassName = L"PerfTestWindow";
+    if (!RegisterClassW(&WndClass))
+    {
+        ok(0, "RegisterClassW failed with %lu\n", GetLastError());
+        return;
+    }
+
+    /* Same thread: the window procedure is called directly */
+    Window = CreatePerfWindow();
+    ok(Window != NULL, "CreateWindowExW failed with %lu\n", GetLastError());
+    if (Window)
+    {
+        for (i = 0; i < Runs; i++)
+            Values[i] = TimeSendMessage(Window);
+        PerfReport("SendMessage", "same_thread", "us", Values, Runs);
+        DestroyWindow(Window);
+    }
+
+    /* Cross thread: every message is queued and needs two context switches */
+    Thread.Window = NULL;
+    Thread.ReadyEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ThreadHandle = CreateThread(NULL, 0, WindowThread, &Thread, 0, NULL);
+    ok(ThreadHandle != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (ThreadHandle)
+    {
+        WaitForSingleObject(Thread.ReadyEvent, INFINITE);
+        ok(Thread.Window != NULL, "CreateWindowExW failed\n");
+        if (Thread.Window)
+        {
+            for (i = 0; i < Runs; i++)
+                Values[i] = TimeSendMessage(Thread.Window);
+            PerfReport("SendMessage", "cross_thread", "us", Values, Runs);
+
+            PostThreadMessageW(GetWindowThreadProcessId(Thread.Window, NULL), WM_QUIT, 0, 0);
+        }
+        WaitForSingleObject(ThreadHandle, INFINITE);
+        CloseHandle(ThreadHandle);
+    }
+    CloseHandle(Thread.ReadyEvent);
+
+    UnregisterClassW(L"PerfTestWindow", GetModuleHandleW(NULL));
+}
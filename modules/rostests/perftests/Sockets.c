@@ -0,0 +1,219 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Loopback socket throughput and latency
+ */
+
+#include "perftest.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#define STREAM_SIZE     (32 * 1024 * 1024)
+#define STREAM_CHUNK    (64 * 1024)
+#define PINGS_PER_RUN   2000
+
+typedef struct _SENDER
+{
+    SOCKET Socket;
+    ULONG Mode;
+} SENDER, *PSENDER;
+
+#define SENDER_STREAM   0
+#define SENDER_ECHO     1
+
+/* Peer side: either streams STREAM_SIZE bytes or echoes single bytes back */
+static
+DWORD
+WINAPI
+SenderThread(
+    _In_ PVOID Context)
+{
+    PSENDER Sender = Context;
+    static CHAR Buffer[STREAM_CHUNK];
+    ULONG Total;
+    int Result;
+    CHAR Byte;
+    ULONG i;
+
+    if (Sender->Mode == SENDER_STREAM)
+    {
+        for (Total = 0; Total < STREAM_SIZE; Total += Result)
+        {
+            Result = send(Sender->Socket, Buffer, min(STREAM_CHUNK, STREAM_SIZE - Total), 0);
+            if (Result <= 0)
+                return 1;
+        }
+    }
+    else
+    {
+        for (i = 0; i < PINGS_PER_RUN; i++)
+        {
+            if (recv(Sender->Socket, &Byte, 1, 0) != 1 ||
+                send(Sender->Socket, &Byte, 1, 0) != 1)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static
+BOOL
+CreateConnectedPair(
+    _Out_ SOCKET *Client,
+    _Out_ SOCKET *Server)
+{
+    struct sockaddr_in Address;
+    int AddressLength = sizeof(Address);
+    SOCKET Listener;
+    BOOL NoDelay = TRUE;
+
+    *Client = *Server = INVALID_SOCKET;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Listener == INVALID_SOCKET)
+        return FALSE;
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = 0;
+
+    if (bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR ||
+        getsockname(Listener, (struct sockaddr *)&Address, &AddressLength) == SOCKET_ERROR ||
+        listen(Listener, 1) == SOCKET_ERROR)
+    {
+        closesocket(Listener);
+        return FALSE;
+    }
+
+    *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*Client == INVALID_SOCKET ||
+        connect(*Client, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR)
+    {
+        closesocket(Listener);
+        if (*Client != INVALID_SOCKET)
+            closesocket(*Client);
+        *Client = INVALID_SOCKET;
+        return FALSE;
+    }
+
+    *Server = accept(Listener, NULL, NULL);
+    closesocket(Listener);
+    if (*Server == INVALID_SOCKET)
+    {
+        closesocket(*Client);
+        *Client = INVALID_SOCKET;
+        return FALSE;
+    }
+
+    /* Latency numbers are meaningless with Nagle in the way */
+    setsockopt(*Client, IPPROTO_TCP, TCP_NODELAY, (char *)&NoDelay, sizeof(NoDelay));
+    setsockopt(*Server, IPPROTO_TCP, TCP_NODELAY, (char *)&NoDelay, sizeof(NoDelay));
+
+    return TRUE;
+}
+
+/* Throughput in MB/s, or round trip time in microseconds */
+static
+double
+TimeLoopback(
+    _In_ ULONG Mode)
+{
+    static CHAR Buffer[STREAM_CHUNK];
+    SENDER Sender;
+    SOCKET Client, Server;
+    HANDLE Thread;
+    ULONGLONG Start;
+    double Seconds = 0;
+    ULONG Total;
+    int Result;
+    CHAR Byte = 0;
+    ULONG i;
+
+    if (!CreateConnectedPair(&Client, &Server))
+    {
+        ok(0, "Failed to set up a loopback connection, error %d\n", WSAGetLastError());
+        return 0;
+    }
+
+    Sender.Socket = Server;
+    Sender.Mode = Mode;
+    Thread = CreateThread(NULL, 0, SenderThread, &Sender, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        goto Cleanup;
+
+    Start = PerfNow();
+    if (Mode == SENDER_STREAM)
+    {
+        for (Total = 0; Total < STREAM_SIZE; Total += Result)
+        {
+            Result = recv(Client, Buffer, sizeof(Buffer), 0);
+            if (Result <= 0)
+            {
+                ok(0, "recv failed with %d\n", WSAGetLastError());
+                break;
+            }
+        }
+        Seconds = PerfElapsed(Start);
+        if (Total < STREAM_SIZE)
+            Seconds = 0;
+    }
+    else
+    {
+        for (i = 0; i < PINGS_PER_RUN; i++)
+        {
+            if (send(Client, &Byte, 1, 0) != 1 || recv(Client, &Byte, 1, 0) != 1)
+            {
+                ok(0, "Ping %lu failed with %d\n", i, WSAGetLastError());
+                break;
+            }
+        }
+        Seconds = i == PINGS_PER_RUN ? PerfElapsed(Start) : 0;
+    }
+
+    /* Unblocks the peer if we bailed out early */
+    shutdown(Client, SD_BOTH);
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+
+Cleanup:
+    closesocket(Client);
+    closesocket(Server);
+
+    if (Seconds <= 0)
+        return 0;
+
+    if (Mode == SENDER_STREAM)
+        return STREAM_SIZE / (1024.0 * 1024.0) / Seconds;
+    else
+        return Seconds * 1000000.0 / PINGS_PER_RUN;
+}
+
+START_TEST(Sockets)
+{
+    double Values[PERF_MAX_RUNS];
+    ULONG Runs = PerfGetRunCount();
+    WSADATA WsaData;
+    ULONG i;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData))
+    {
+        skip("WSAStartup failed\n");
+        return;
+    }
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeLoopback(SENDER_STREAM);
+    PerfReport("Sockets", "tcp_loopback_throughput", "MB/s", Values, Runs);
+
+    for (i = 0; i < Runs; i++)
+        Values[i] = TimeLoopback(SENDER_ECHO);
+    PerfReport("Sockets", "tcp_loopback_rtt", "us", Values, Runs);
+
+    WSACleanup();
+}
@@ -0,0 +1,92 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Timing and reporting helpers
+ */
+
+#include "perftest.h"
+
+static LARGE_INTEGER PerfFrequency;
+
+ULONG
+PerfGetRunCount(VOID)
+{
+    CHAR Buffer[16];
+    ULONG Runs = PERF_DEFAULT_RUNS;
+
+    if (GetEnvironmentVariableA("PERFTESTS_RUNS", Buffer, sizeof(Buffer)) &&
+        atoi(Buffer) > 0)
+    {
+        Runs = atoi(Buffer);
+    }
+
+    return min(Runs, PERF_MAX_RUNS);
+}
+
+ULONGLONG
+PerfNow(VOID)
+{
+    LARGE_INTEGER Counter;
+
+    QueryPerformanceCounter(&Counter);
+    return Counter.QuadPart;
+}
+
+/* Seconds since Start, as returned by PerfNow */
+double
+PerfElapsed(
+    _In_ ULONGLONG Start)
+{
+    if (!PerfFrequency.QuadPart)
+        QueryPerformanceFrequency(&PerfFrequency);
+
+    return (double)(PerfNow() - Start) / (double)PerfFrequency.QuadPart;
+}
+
+VOID
+PerfReport(
+    _In_ PCSTR Suite,
+    _In_ PCSTR Name,
+    _In_ PCSTR Unit,
+    _In_reads_(Count) const double *Values,
+    _In_ ULONG Count)
+{
+    double Sorted[PERF_MAX_RUNS];
+    double Median;
+    ULONG i, j;
+
+    if (!Count || Count > PERF_MAX_RUNS)
+        return;
+
+    for (i = 0; i < Count; i++)
+    {
+        for (j = i; j > 0 && Sorted[j - 1] > Values[i]; j--)
+            Sorted[j] = Sorted[j - 1];
+        Sorted[j] = Values[i];
+    }
+
+    if (Count % 2)
+        Median = Sorted[Count / 2];
+    else
+        Median = (Sorted[Count / 2 - 1] + Sorted[Count / 2]) / 2;
+
+    printf("{\"perf\":\"%s\",\"name\":\"%s\",\"unit\":\"%s\",\"runs\":%lu,"
+           "\"median\":%.3f,\"min\":%.3f,\"max\":%.3f}\n",
+           Suite, Name, Unit, Count, Median, Sorted[0], Sorted[Count - 1]);
+    fflush(stdout);
+}
+
+BOOL
+PerfGetTempFileName(
+    _Out_writes_(MAX_PATH) PWSTR Path,
+    _In_ PCWSTR Name)
+{
+    DWORD Length;
+
+    Length = GetTempPathW(MAX_PATH, Path);
+    if (!Length || Length + wcslen(Name) >= MAX_PATH)
+        return FALSE;
+
+    wcscat(Path, Name);
+    return TRUE;
+}
@@ -0,0 +1,53 @@
+/*
+ * PROJECT:     ReactOS performance tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Shared definitions for the benchmark suite
+ */
+
+#ifndef _PERFTEST_H
+#define _PERFTEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <wine/test.h>
+
+#include <windef.h>
+#include <winbase.h>
+
+/*
+ * Every measurement is repeated PERF_DEFAULT_RUNS times (or the number in the
+ * PERFTESTS_RUNS environment variable) and reported as one line of JSON:
+ *
+ *   {"perf":"FileIo","name":"read_cached","unit":"MB/s","runs":5,
+ *    "median":812.345,"min":790.100,"max":820.002}
+ *
+ * The median is the value to track across commits.
+ */
+#define PERF_DEFAULT_RUNS 5
+#define PERF_MAX_RUNS 32
+
+ULONG
+PerfGetRunCount(VOID);
+
+ULONGLONG
+PerfNow(VOID);
+
+double
+PerfElapsed(
+    _In_ ULONGLONG Start);
+
+VOID
+PerfReport(
+    _In_ PCSTR Suite,
+    _In_ PCSTR Name,
+    _In_ PCSTR Unit,
+    _In_reads_(Count) const double *Values,
+    _In_ ULONG Count);
+
+BOOL
+PerfGetTempFileName(
+    _Out_writes_(MAX_PATH) PWSTR Path,
+    _In_ PCWSTR Name);
+
+#endif /* _PERFTEST_H */
@@ -0,0 +1,22 @@
+#define STANDALONE
+#include <wine/test.h>
+
+extern void func_CreateProcess(void);
+extern void func_FileIo(void);
+extern void func_Gdi(void);
+extern void func_Heap(void);
+extern void func_LoadLibrary(void);
+extern void func_SendMessage(void);
+extern void func_Sockets(void);
+
+const struct test winetest_testlist[] =
+{
+    { "CreateProcess", func_CreateProcess },
+    { "FileIo", func_FileIo },
+    { "Gdi", func_Gdi },
+    { "Heap", func_Heap },
+    { "LoadLibrary", func_LoadLibrary },
+    { "SendMessage", func_SendMessage },
+    { "Sockets", func_Sockets },
+    { 0, 0 }
+};
@@ -0,0 +1,119 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS crtbench.exe
+ * FILE:            modules/rostests/tests/crtbench/crtbench.c
+ * PURPOSE:         Measures the throughput of the CRT memory and string routines
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define MAX_SIZE (16 * 1024 * 1024)
+
+static const size_t Sizes[] =
+{
+    8, 31, 64, 256, 4096, 64 * 1024, 1024 * 1024, MAX_SIZE
+};
+
+static unsigned char *Source;
+static unsigned char *Dest;
+static LARGE_INTEGER Frequency;
+
+/* Keeps the compiler from dropping the calls */
+static volatile size_t Sink;
+
+typedef void (*BENCH_ROUTINE)(size_t Size);
+
+static void BenchMemcpy(size_t Size)  { memcpy(Dest, Source, Size); }
+static void BenchMemmove(size_t Size) { memmove(Dest + 1, Dest, Size - 1); }
+static void BenchMemset(size_t Size)  { memset(Dest, 0x5A, Size); }
+static void BenchMemcmp(size_t Size)  { Sink = memcmp(Dest, Source, Size); }
+static void BenchMemchr(size_t Size)  { Sink = (size_t)memchr(Source, 0xFF, Size); }
+static void BenchStrlen(size_t Size)  { Sink = strlen((char *)Source + MAX_SIZE - Size); }
+static void BenchWcslen(size_t Size)  { Sink = wcslen((wchar_t *)(Source + MAX_SIZE - Size)); }
+static void BenchStrchr(size_t Size)  { Sink = (size_t)strchr((char *)Source + MAX_SIZE - Size, 0xFF); }
+
+static const struct
+{
+    const char *Name;
+    BENCH_ROUTINE Routine;
+} Benches[] =
+{
+    { "memcpy",  BenchMemcpy },
+    { "memmove", BenchMemmove },
+    { "memset",  BenchMemset },
+    { "memcmp",  BenchMemcmp },
+    { "memchr",  BenchMemchr },
+    { "strlen",  BenchStrlen },
+    { "wcslen",  BenchWcslen },
+    { "strchr",  BenchStrchr },
+};
+
+static double
+RunBench(BENCH_ROUTINE Routine, size_t Size)
+{
+    LARGE_INTEGER Start, End;
+    ULONG Iterations, i;
+    double Seconds;
+
+    /* Aim for roughly 256 MB of traffic per measurement */
+    Iterations = (ULONG)max(256 * 1024 * 1024 / Size, 16);
+
+    Routine(Size);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Iterations; i++)
+        Routine(Size);
+    QueryPerformanceCounter(&End);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    if (Seconds <= 0)
+        return 0;
+
+    return (double)Size * Iterations / Seconds / (1024 * 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t b, s;
+
+    /* One spare page so the strings can end at MAX_SIZE - 2 */
+    Source = VirtualAlloc(NULL, MAX_SIZE + 4096, MEM_COMMIT, PAGE_READWRITE);
+    Dest = VirtualAlloc(NULL, MAX_SIZE + 4096, MEM_COMMIT, PAGE_READWRITE);
+    if (!Source || !Dest)
+    {
+        printf("Failed to allocate the buffers\n");
+        return 1;
+    }
+
+    /* Non zero bytes that never match, followed by a wide terminator */
+    memset(Source, 0x41, MAX_SIZE);
+    Source[MAX_SIZE] = 0;
+    Source[MAX_SIZE + 1] = 0;
+    memcpy(Dest, Source, MAX_SIZE);
+
+    QueryPerformanceFrequency(&Frequency);
+
+    printf("SSE2 %savailable\n\n",
+           IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) ? "" : "not ");
+
+    printf("%-10s", "size");
+    for (b = 0; b < ARRAYSIZE(Benches); b++)
+        printf("%10s", Benches[b].Name);
+    printf("\n");
+
+    for (s = 0; s < ARRAYSIZE(Sizes); s++)
+    {
+        printf("%-10lu", (ULONG)Sizes[s]);
+        for (b = 0; b < ARRAYSIZE(Benches); b++)
+            printf("%10.0f", RunBench(Benches[b].Routine, Sizes[s]));
+        printf("\n");
+    }
+
+    printf("\nThroughput in MB/s\n");
+
+    VirtualFree(Source, 0, MEM_RELEASE);
+    VirtualFree(Dest, 0, MEM_RELEASE);
+    return 0;
+}
@@ -346,7 +346,7 @@ MmpPageOutPhysicalAddress(PFN_NUMBER Page)
 {
     BOOLEAN ProcRef = FALSE, PageDirty;
     PFN_NUMBER SectionPage = 0;
-    PMM_RMAP_ENTRY entry;
+    PMM_RMAP_SLOT slot;
     PMM_SECTION_SEGMENT Segment = NULL;
     LARGE_INTEGER FileOffset;
     PMEMORY_AREA MemoryArea;
@@ -391,11 +391,11 @@ MmpPageOutPhysicalAddress(PFN_NUMBER Page)
 
     DPRINTC("Trying to unmap all instances of %x\n", Page);
     ExAcquireFastMutex(&RmapListLock);
-    entry = MmGetRmapListHeadPage(Page);
+    slot = MiGetFirstRmapSlot(MmGetRmapListHeadPage(Page), FALSE);
 
     // Entry and Segment might be null here in the case that the page
     // is new and is in the process of being swapped in
-    if (!entry && !Segment)
+    if (!slot && !Segment)
     {
         Status = STATUS_UNSUCCESSFUL;
         DPRINT1("Page %x is in transit\n", Page);
@@ -403,19 +403,13 @@ MmpPageOutPhysicalAddress(PFN_NUMBER Page)
         goto bail;
     }
 
-    while (entry != NULL && NT_SUCCESS(Status))
+    while (slot != NULL && NT_SUCCESS(Status))
     {
-        Process = entry->Process;
-        Address = entry->Address;
+        Process = slot->Process;
+        Address = slot->Address;
 
         DPRINTC("Process %p Address %p Page %x\n", Process, Address, Page);
 
-        if (RMAP_IS_SEGMENT(Address))
-        {
-            entry = entry->Next;
-            continue;
-        }
-
         if (Process && Address < MmSystemRangeStart)
         {
             /* Make sure we don't try to page out part of an exiting process */
@@ -523,9 +517,9 @@ MmpPageOutPhysicalAddress(PFN_NUMBER Page)
 
         ExAcquireFastMutex(&RmapListLock);
         ASSERT(!MM_IS_WAIT_PTE(MmGetPfnForProcess(Process, Address)));
-        entry = MmGetRmapListHeadPage(Page);
+        slot = MiGetFirstRmapSlot(MmGetRmapListHeadPage(Page), FALSE);
 
-        DPRINTC("Entry %p\n", entry);
+        DPRINTC("Slot %p\n", slot);
     }
 
     ExReleaseFastMutex(&RmapListLock);
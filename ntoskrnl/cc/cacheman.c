@@ -20,6 +20,66 @@ MM_SYSTEMSIZE CcCapturedSystemSize;
 
 static ULONG BugCheckFileId = 0x4 << 16;
 
+/* The prefetcher traces the demand reads done in the first seconds of boot
+ * and of each process launch, and saves them to \SystemRoot\Prefetch, one
+ * file per scenario. The next time the scenario starts, its trace is
+ * replayed with MmPrefetchPages, so that the scattered reads are replaced
+ * by a few large sorted ones.
+ * EnablePrefetcher: bit 0 enables application launch, bit 1 enables boot.
+ */
+ULONG CcPfEnablePrefetcherParameter = 3;
+
+#define CC_PF_ENABLE_APP_LAUNCH     0x1
+#define CC_PF_ENABLE_BOOT           0x2
+
+#define CC_PF_LAUNCH_TRACE_PERIOD   10
+#define CC_PF_BOOT_TRACE_PERIOD     60
+
+#define CC_PF_MAX_FILES             128
+#define CC_PF_MAX_ENTRIES           4096
+#define CC_PF_MAX_NAME_LENGTH       64
+
+#define CC_PF_TRACE_MAGIC           'fPcC'
+#define CC_PF_TRACE_VERSION         1
+
+/* Set in EPROCESS::PrefetchTrace once the launch of the process was handled */
+#define CC_PF_LAUNCH_SEEN           ((PVOID)1)
+
+typedef struct _CC_PF_LOG_ENTRY
+{
+    ULONG FileIndex;
+    ULONG Page;
+} CC_PF_LOG_ENTRY, *PCC_PF_LOG_ENTRY;
+
+typedef struct _CC_PF_TRACE
+{
+    LIST_ENTRY ActiveTracesLink;
+    /* NULL for the boot trace, which logs the reads of all processes */
+    PEPROCESS Process;
+    KTIMER TraceTimer;
+    KDPC TraceTimerDpc;
+    WORK_QUEUE_ITEM EndTraceWorkItem;
+    WCHAR ScenarioName[CC_PF_MAX_NAME_LENGTH];
+    ULONG NumFiles;
+    PFILE_OBJECT Files[CC_PF_MAX_FILES];
+    ULONG NumEntries;
+    CC_PF_LOG_ENTRY Entries[CC_PF_MAX_ENTRIES];
+} CC_PF_TRACE, *PCC_PF_TRACE;
+
+/* A trace file is this header, the entries sorted by file and page, and then
+ * for each file its name length in bytes (USHORT) followed by the name.
+ */
+typedef struct _CC_PF_TRACE_FILE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG Size;
+    ULONG NumFiles;
+    ULONG NumEntries;
+} CC_PF_TRACE_FILE_HEADER, *PCC_PF_TRACE_FILE_HEADER;
+
+static WORK_QUEUE_ITEM CcPfBootPrefetchWorkItem;
+
 /* FUNCTIONS *****************************************************************/
 
 INIT_FUNCTION
@@ -34,10 +94,656 @@ CcPfInitializePrefetcher(VOID)
 
     /* Setup the Prefetcher Data */
     InitializeListHead(&CcPfGlobals.ActiveTraces);
+    KeInitializeSpinLock(&CcPfGlobals.ActiveTracesLock);
     InitializeListHead(&CcPfGlobals.CompletedTraces);
     ExInitializeFastMutex(&CcPfGlobals.CompletedTracesLock);
+    CcPfGlobals.ActivePrefetches = 0;
+
+    CcPfEnablePrefetcher = (CcPfEnablePrefetcherParameter & (CC_PF_ENABLE_APP_LAUNCH | CC_PF_ENABLE_BOOT)) != 0;
+}
+
+static
+VOID
+NTAPI
+CcPfEndTrace(
+    IN PVOID Context);
 
-    /* FIXME: Setup the rest of the prefetecher */
+static
+VOID
+NTAPI
+CcPfTraceTimerDpc(
+    IN PKDPC Dpc,
+    IN PVOID DeferredContext,
+    IN PVOID SystemArgument1,
+    IN PVOID SystemArgument2)
+{
+    PCC_PF_TRACE Trace = DeferredContext;
+
+    /* Saving the trace needs file I/O */
+    ExQueueWorkItem(&Trace->EndTraceWorkItem, DelayedWorkQueue);
+}
+
+static
+VOID
+CcPfStartTrace(
+    IN PEPROCESS Process,
+    IN PCWSTR ScenarioName,
+    IN ULONG Period)
+{
+    PCC_PF_TRACE Trace;
+    LARGE_INTEGER DueTime;
+    KIRQL OldIrql;
+
+    Trace = ExAllocatePoolWithTag(NonPagedPool, sizeof(CC_PF_TRACE), 'tPcC');
+    if (Trace == NULL)
+    {
+        return;
+    }
+
+    Trace->Process = Process;
+    if (Process != NULL)
+    {
+        ObReferenceObject(Process);
+    }
+    RtlStringCbCopyW(Trace->ScenarioName, sizeof(Trace->ScenarioName), ScenarioName);
+    Trace->NumFiles = 0;
+    Trace->NumEntries = 0;
+    KeInitializeTimer(&Trace->TraceTimer);
+    KeInitializeDpc(&Trace->TraceTimerDpc, CcPfTraceTimerDpc, Trace);
+    ExInitializeWorkItem(&Trace->EndTraceWorkItem, CcPfEndTrace, Trace);
+
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    InsertTailList(&CcPfGlobals.ActiveTraces, &Trace->ActiveTracesLink);
+    InterlockedIncrement(&CcPfGlobals.ActivePrefetches);
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+
+    DueTime.QuadPart = -(LONGLONG)Period * 10 * 1000 * 1000;
+    KeSetTimer(&Trace->TraceTimer, DueTime, &Trace->TraceTimerDpc);
+}
+
+/*
+ * FUNCTION: Record a read done by the cache on behalf of the current process,
+ * in the traces which are being recorded for it.
+ */
+VOID
+NTAPI
+CcPfLogFileRead(
+    IN PFILE_OBJECT FileObject,
+    IN LONGLONG FileOffset)
+{
+    PCC_PF_TRACE Trace;
+    PLIST_ENTRY ListEntry;
+    PEPROCESS Process;
+    KIRQL OldIrql;
+    ULONG i;
+
+    if (CcPfGlobals.ActivePrefetches == 0)
+    {
+        return;
+    }
+
+    Process = PsGetCurrentProcess();
+
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    for (ListEntry = CcPfGlobals.ActiveTraces.Flink;
+         ListEntry != &CcPfGlobals.ActiveTraces;
+         ListEntry = ListEntry->Flink)
+    {
+        Trace = CONTAINING_RECORD(ListEntry, CC_PF_TRACE, ActiveTracesLink);
+        if ((Trace->Process != NULL && Trace->Process != Process) ||
+            Trace->NumEntries == CC_PF_MAX_ENTRIES)
+        {
+            continue;
+        }
+
+        /* Several file objects may be opened on the same file */
+        for (i = 0; i < Trace->NumFiles; i++)
+        {
+            if (Trace->Files[i]->SectionObjectPointer == FileObject->SectionObjectPointer)
+            {
+                break;
+            }
+        }
+
+        if (i == Trace->NumFiles)
+        {
+            if (i == CC_PF_MAX_FILES)
+            {
+                continue;
+            }
+
+            ObReferenceObject(FileObject);
+            Trace->Files[Trace->NumFiles++] = FileObject;
+        }
+
+        Trace->Entries[Trace->NumEntries].FileIndex = i;
+        Trace->Entries[Trace->NumEntries].Page = (ULONG)(FileOffset >> PAGE_SHIFT);
+        Trace->NumEntries++;
+    }
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+}
+
+static
+int
+__cdecl
+CcPfCompareLogEntries(
+    const void *x,
+    const void *y)
+{
+    const CC_PF_LOG_ENTRY *Entry1 = (const CC_PF_LOG_ENTRY *)x;
+    const CC_PF_LOG_ENTRY *Entry2 = (const CC_PF_LOG_ENTRY *)y;
+
+    if (Entry1->FileIndex != Entry2->FileIndex)
+        return Entry1->FileIndex > Entry2->FileIndex ? 1 : -1;
+    else if (Entry1->Page != Entry2->Page)
+        return Entry1->Page > Entry2->Page ? 1 : -1;
+    else
+        return 0;
+}
+
+static
+NTSTATUS
+CcPfOpenTraceFile(
+    IN PCWSTR ScenarioName,
+    IN BOOLEAN Create,
+    OUT PHANDLE FileHandle)
+{
+    UNICODE_STRING DirectoryName = RTL_CONSTANT_STRING(L"\\SystemRoot\\Prefetch");
+    WCHAR Buffer[MAX_PATH];
+    UNICODE_STRING FileName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE DirectoryHandle;
+    NTSTATUS Status;
+
+    Status = RtlStringCbPrintfW(Buffer, sizeof(Buffer), L"%wZ\\%s.pf", &DirectoryName, ScenarioName);
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+    RtlInitUnicodeString(&FileName, Buffer);
+
+    if (Create)
+    {
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &DirectoryName,
+                                   OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                                   NULL,
+                                   NULL);
+        Status = ZwCreateFile(&DirectoryHandle,
+                              FILE_LIST_DIRECTORY | SYNCHRONIZE,
+                              &ObjectAttributes,
+                              &IoStatusBlock,
+                              NULL,
+                              FILE_ATTRIBUTE_NORMAL,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              FILE_OPEN_IF,
+                              FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                              NULL,
+                              0);
+        if (!NT_SUCCESS(Status))
+        {
+            return Status;
+        }
+        ZwClose(DirectoryHandle);
+    }
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &FileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    return ZwCreateFile(FileHandle,
+                        Create ? FILE_GENERIC_WRITE : FILE_GENERIC_READ,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        NULL,
+                        FILE_ATTRIBUTE_NORMAL,
+                        Create ? 0 : FILE_SHARE_READ,
+                        Create ? FILE_OVERWRITE_IF : FILE_OPEN,
+                        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                        NULL,
+                        0);
+}
+
+static
+VOID
+CcPfSaveTrace(
+    IN PCC_PF_TRACE Trace)
+{
+    POBJECT_NAME_INFORMATION FileNames[CC_PF_MAX_FILES];
+    PCC_PF_TRACE_FILE_HEADER Header;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE FileHandle;
+    PUCHAR Current;
+    USHORT NameLength;
+    ULONG Size, ReturnLength, NumEntries, i;
+    NTSTATUS Status;
+
+    if (Trace->NumEntries == 0)
+    {
+        return;
+    }
+
+    /* Replay reads the files in order, once per page */
+    qsort(Trace->Entries, Trace->NumEntries, sizeof(Trace->Entries[0]), CcPfCompareLogEntries);
+    NumEntries = 1;
+    for (i = 1; i < Trace->NumEntries; i++)
+    {
+        if (CcPfCompareLogEntries(&Trace->Entries[i], &Trace->Entries[NumEntries - 1]) != 0)
+        {
+            Trace->Entries[NumEntries++] = Trace->Entries[i];
+        }
+    }
+    Trace->NumEntries = NumEntries;
+
+    /* Files are saved by name, so that they can be reopened on replay */
+    Size = sizeof(*Header) + Trace->NumEntries * sizeof(Trace->Entries[0]);
+    for (i = 0; i < Trace->NumFiles; i++)
+    {
+        FileNames[i] = ExAllocatePoolWithTag(PagedPool, sizeof(OBJECT_NAME_INFORMATION) + MAX_PATH * sizeof(WCHAR), 'nPcC');
+        if (FileNames[i] != NULL &&
+            !NT_SUCCESS(ObQueryNameString(Trace->Files[i],
+                                          FileNames[i],
+                                          sizeof(OBJECT_NAME_INFORMATION) + MAX_PATH * sizeof(WCHAR),
+                                          &ReturnLength)))
+        {
+            ExFreePoolWithTag(FileNames[i], 'nPcC');
+            FileNames[i] = NULL;
+        }
+
+        Size += sizeof(USHORT);
+        if (FileNames[i] != NULL)
+        {
+            Size += FileNames[i]->Name.Length;
+        }
+    }
+
+    Header = ExAllocatePoolWithTag(PagedPool, Size, 'fPcC');
+    if (Header == NULL)
+    {
+        goto Cleanup;
+    }
+
+    Header->Magic = CC_PF_TRACE_MAGIC;
+    Header->Version = CC_PF_TRACE_VERSION;
+    Header->Size = Size;
+    Header->NumFiles = Trace->NumFiles;
+    Header->NumEntries = Trace->NumEntries;
+    Current = (PUCHAR)(Header + 1);
+    RtlCopyMemory(Current, Trace->Entries, Trace->NumEntries * sizeof(Trace->Entries[0]));
+    Current += Trace->NumEntries * sizeof(Trace->Entries[0]);
+
+    /* A file without a name is saved with an empty one, and skipped on replay */
+    for (i = 0; i < Trace->NumFiles; i++)
+    {
+        NameLength = (FileNames[i] != NULL) ? FileNames[i]->Name.Length : 0;
+        RtlCopyMemory(Current, &NameLength, sizeof(USHORT));
+        Current += sizeof(USHORT);
+        if (NameLength != 0)
+        {
+            RtlCopyMemory(Current, FileNames[i]->Name.Buffer, NameLength);
+            Current += NameLength;
+        }
+    }
+
+    Status = CcPfOpenTraceFile(Trace->ScenarioName, TRUE, &FileHandle);
+    if (NT_SUCCESS(Status))
+    {
+        Status = ZwWriteFile(FileHandle, NULL, NULL, NULL, &IoStatusBlock, Header, Size, NULL, NULL);
+        ZwClose(FileHandle);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to save the trace of %S: %lx\n", Trace->ScenarioName, Status);
+    }
+
+    ExFreePoolWithTag(Header, 'fPcC');
+
+Cleanup:
+    for (i = 0; i < Trace->NumFiles; i++)
+    {
+        if (FileNames[i] != NULL)
+        {
+            ExFreePoolWithTag(FileNames[i], 'nPcC');
+        }
+    }
+}
+
+static
+VOID
+NTAPI
+CcPfEndTrace(
+    IN PVOID Context)
+{
+    PCC_PF_TRACE Trace = Context;
+    KIRQL OldIrql;
+    ULONG i;
+
+    /* Stop logging to the trace */
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    RemoveEntryList(&Trace->ActiveTracesLink);
+    InterlockedDecrement(&CcPfGlobals.ActivePrefetches);
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+
+    DPRINT("Trace of %S: %lu entries in %lu files\n", Trace->ScenarioName, Trace->NumEntries, Trace->NumFiles);
+
+    CcPfSaveTrace(Trace);
+
+    for (i = 0; i < Trace->NumFiles; i++)
+    {
+        ObDereferenceObject(Trace->Files[i]);
+    }
+    if (Trace->Process != NULL)
+    {
+        ObDereferenceObject(Trace->Process);
+    }
+    ExFreePoolWithTag(Trace, 'tPcC');
+}
+
+static
+PREAD_LIST
+CcPfOpenReadList(
+    IN PCWSTR Name,
+    IN USHORT NameLength,
+    IN PCC_PF_LOG_ENTRY Entries,
+    IN ULONG NumEntries,
+    OUT PHANDLE FileHandle)
+{
+    UNICODE_STRING FileName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PFILE_OBJECT FileObject;
+    LARGE_INTEGER ByteOffset;
+    PREAD_LIST ReadList;
+    UCHAR Byte;
+    NTSTATUS Status;
+    ULONG i;
+
+    FileName.Buffer = (PWSTR)Name;
+    FileName.Length = FileName.MaximumLength = NameLength;
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &FileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    Status = ZwCreateFile(FileHandle,
+                          FILE_READ_DATA | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          FILE_OPEN,
+                          FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                          NULL,
+                          0);
+    if (!NT_SUCCESS(Status))
+    {
+        return NULL;
+    }
+
+    Status = ObReferenceObjectByHandle(*FileHandle,
+                                       FILE_READ_DATA,
+                                       *IoFileObjectType,
+                                       KernelMode,
+                                       (PVOID*)&FileObject,
+                                       NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        ZwClose(*FileHandle);
+        return NULL;
+    }
+
+    /* The pages are read into the cache, so have the file system set it up */
+    if (FileObject->SectionObjectPointer->SharedCacheMap == NULL)
+    {
+        ByteOffset.QuadPart = 0;
+        ZwReadFile(*FileHandle, NULL, NULL, NULL, &IoStatusBlock, &Byte, sizeof(Byte), &ByteOffset, NULL);
+    }
+
+    ReadList = ExAllocatePoolWithTag(PagedPool, FIELD_OFFSET(READ_LIST, List[NumEntries]), 'lPcC');
+    if (ReadList == NULL)
+    {
+        ObDereferenceObject(FileObject);
+        ZwClose(*FileHandle);
+        return NULL;
+    }
+
+    ReadList->FileObject = FileObject;
+    ReadList->NumberOfEntries = NumEntries;
+    ReadList->IsImage = FALSE;
+    for (i = 0; i < NumEntries; i++)
+    {
+        ReadList->List[i].Alignment = (ULONGLONG)Entries[i].Page << PAGE_SHIFT;
+    }
+
+    return ReadList;
+}
+
+/*
+ * FUNCTION: Replay the saved trace of a scenario, if there is one
+ */
+static
+VOID
+CcPfPrefetchScenario(
+    IN PCWSTR ScenarioName)
+{
+    PCC_PF_TRACE_FILE_HEADER Header = NULL;
+    FILE_STANDARD_INFORMATION FileInformation;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PCC_PF_LOG_ENTRY Entries;
+    PREAD_LIST *ReadLists = NULL;
+    PHANDLE FileHandles = NULL;
+    HANDLE FileHandle;
+    PUCHAR Current, End;
+    USHORT NameLength;
+    ULONG Size, NumLists, First, Last, i;
+    NTSTATUS Status;
+
+    Status = CcPfOpenTraceFile(ScenarioName, FALSE, &FileHandle);
+    if (!NT_SUCCESS(Status))
+    {
+        return;
+    }
+
+    Status = ZwQueryInformationFile(FileHandle,
+                                    &IoStatusBlock,
+                                    &FileInformation,
+                                    sizeof(FileInformation),
+                                    FileStandardInformation);
+    if (!NT_SUCCESS(Status) ||
+        FileInformation.EndOfFile.QuadPart < sizeof(*Header) ||
+        FileInformation.EndOfFile.QuadPart > sizeof(*Header) + CC_PF_MAX_ENTRIES * sizeof(CC_PF_LOG_ENTRY) +
+                                             CC_PF_MAX_FILES * (sizeof(USHORT) + MAX_PATH * sizeof(WCHAR)))
+    {
+        ZwClose(FileHandle);
+        return;
+    }
+    Size = FileInformation.EndOfFile.LowPart;
+
+    Header = ExAllocatePoolWithTag(PagedPool, Size, 'fPcC');
+    if (Header == NULL)
+    {
+        ZwClose(FileHandle);
+        return;
+    }
+
+    Status = ZwReadFile(FileHandle, NULL, NULL, NULL, &IoStatusBlock, Header, Size, NULL, NULL);
+    ZwClose(FileHandle);
+    if (!NT_SUCCESS(Status) || IoStatusBlock.Information != Size)
+    {
+        goto Cleanup;
+    }
+
+    /* Don't trust the file */
+    if (Header->Magic != CC_PF_TRACE_MAGIC ||
+        Header->Version != CC_PF_TRACE_VERSION ||
+        Header->Size != Size ||
+        Header->NumFiles == 0 ||
+        Header->NumFiles > CC_PF_MAX_FILES ||
+        Header->NumEntries > CC_PF_MAX_ENTRIES ||
+        sizeof(*Header) + Header->NumEntries * sizeof(CC_PF_LOG_ENTRY) > Size)
+    {
+        DPRINT1("Invalid trace for %S\n", ScenarioName);
+        goto Cleanup;
+    }
+
+    Entries = (PCC_PF_LOG_ENTRY)(Header + 1);
+    for (i = 0; i < Header->NumEntries; i++)
+    {
+        if (Entries[i].FileIndex >= Header->NumFiles ||
+            (i != 0 && Entries[i].FileIndex < Entries[i - 1].FileIndex))
+        {
+            DPRINT1("Invalid trace for %S\n", ScenarioName);
+            goto Cleanup;
+        }
+    }
+
+    ReadLists = ExAllocatePoolWithTag(PagedPool, Header->NumFiles * (sizeof(PREAD_LIST) + sizeof(HANDLE)), 'lPcC');
+    if (ReadLists == NULL)
+    {
+        goto Cleanup;
+    }
+    FileHandles = (PHANDLE)(ReadLists + Header->NumFiles);
+
+    /* Reopen the files, each with the pages read from it */
+    Current = (PUCHAR)(Entries + Header->NumEntries);
+    End = (PUCHAR)Header + Size;
+    NumLists = 0;
+    First = 0;
+    for (i = 0; i < Header->NumFiles; i++)
+    {
+        if ((ULONG)(End - Current) < sizeof(USHORT))
+        {
+            break;
+        }
+        RtlCopyMemory(&NameLength, Current, sizeof(USHORT));
+        Current += sizeof(USHORT);
+        if ((ULONG)(End - Current) < NameLength)
+        {
+            break;
+        }
+
+        for (Last = First; Last < Header->NumEntries && Entries[Last].FileIndex == i; Last++);
+
+        if (NameLength != 0 && Last != First)
+        {
+            ReadLists[NumLists] = CcPfOpenReadList((PCWSTR)Current,
+                                                   NameLength,
+                                                   &Entries[First],
+                                                   Last - First,
+                                                   &FileHandles[NumLists]);
+            if (ReadLists[NumLists] != NULL)
+            {
+                NumLists++;
+            }
+        }
+
+        Current += NameLength;
+        First = Last;
+    }
+
+    DPRINT("Prefetching %S: %lu files\n", ScenarioName, NumLists);
+    MmPrefetchPages(NumLists, ReadLists);
+
+    for (i = 0; i < NumLists; i++)
+    {
+        ObDereferenceObject(ReadLists[i]->FileObject);
+        ZwClose(FileHandles[i]);
+        ExFreePoolWithTag(ReadLists[i], 'lPcC');
+    }
+
+Cleanup:
+    if (ReadLists != NULL)
+    {
+        ExFreePoolWithTag(ReadLists, 'lPcC');
+    }
+    ExFreePoolWithTag(Header, 'fPcC');
+}
+
+static
+VOID
+NTAPI
+CcPfBootPrefetchWorker(
+    IN PVOID Context)
+{
+    CcPfPrefetchScenario(L"NTOSBOOT");
+}
+
+/*
+ * FUNCTION: Replay the boot trace in the background, and record a new one
+ */
+INIT_FUNCTION
+VOID
+NTAPI
+CcPfBeginBootPhase(
+    IN ULONG Phase)
+{
+    if (!CcPfEnablePrefetcher ||
+        !(CcPfEnablePrefetcherParameter & CC_PF_ENABLE_BOOT))
+    {
+        return;
+    }
+
+    DPRINT("Boot phase %lu\n", Phase);
+
+    ExInitializeWorkItem(&CcPfBootPrefetchWorkItem, CcPfBootPrefetchWorker, NULL);
+    ExQueueWorkItem(&CcPfBootPrefetchWorkItem, DelayedWorkQueue);
+
+    CcPfStartTrace(NULL, L"NTOSBOOT", CC_PF_BOOT_TRACE_PERIOD);
+}
+
+/*
+ * FUNCTION: Called by the first thread of a process before it runs user
+ * code: replay the trace of the application, and record a new one.
+ */
+VOID
+NTAPI
+CcPfBeginAppLaunch(
+    IN PEPROCESS Process)
+{
+    WCHAR ScenarioName[CC_PF_MAX_NAME_LENGTH];
+    PUNICODE_STRING ImageName;
+    ULONG Hash = 0;
+
+    PAGED_CODE();
+
+    if (!(CcPfEnablePrefetcherParameter & CC_PF_ENABLE_APP_LAUNCH))
+    {
+        return;
+    }
+
+    /* Only once per process */
+    if (InterlockedCompareExchangePointer(&Process->PrefetchTrace.Object,
+                                          CC_PF_LAUNCH_SEEN,
+                                          NULL) != NULL)
+    {
+        return;
+    }
+
+    /* The scenario is the image name and a hash of its full path, as the
+     * same name may be used by different applications
+     */
+    if (NT_SUCCESS(SeLocateProcessImageName(Process, &ImageName)))
+    {
+        RtlHashUnicodeString(ImageName, TRUE, HASH_STRING_ALGORITHM_DEFAULT, &Hash);
+        ExFreePoolWithTag(ImageName, TAG_SEPA);
+    }
+
+    if (!NT_SUCCESS(RtlStringCbPrintfW(ScenarioName,
+                                       sizeof(ScenarioName),
+                                       L"%hs-%08lX",
+                                       Process->ImageFileName,
+                                       Hash)))
+    {
+        return;
+    }
+
+    CcPfPrefetchScenario(ScenarioName);
+    CcPfStartTrace(Process, ScenarioName, CC_PF_LAUNCH_TRACE_PERIOD);
 }
 
 INIT_FUNCTION
@@ -162,7 +868,9 @@ CcScheduleReadAhead (
 	)
 {
     KIRQL OldIrql;
-    LARGE_INTEGER NewOffset;
+    LONGLONG Stride;
+    LONGLONG ReadAheadStart, ReadAheadEnd;
+    ULONG Window;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
 
@@ -178,47 +886,104 @@ CcScheduleReadAhead (
 
     /* Round read length with read ahead mask */
     Length = ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1);
-    /* Compute the offset we'll reach */
-    NewOffset.QuadPart = FileOffset->QuadPart + Length;
 
     /* Lock read ahead spin lock */
     KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-    /* Easy case: the file is sequentially read */
-    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+
+    /* Find out how the file is read. The read history (FileOffset1 and 2)
+     * isn't updated yet with the current read.
+     * Easy case: the file is sequentially read
+     */
+    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY) ||
+        (FileOffset->QuadPart & ~(LONGLONG)PrivateCacheMap->ReadAheadMask) ==
+        (PrivateCacheMap->BeyondLastByte2.QuadPart & ~(LONGLONG)PrivateCacheMap->ReadAheadMask))
     {
-        /* If we went backward, this is no go! */
-        if (NewOffset.QuadPart < PrivateCacheMap->ReadAheadOffset[1].QuadPart)
+        Stride = Length;
+    }
+    /* Otherwise, look for a constant stride, going forward or backward */
+    else
+    {
+        Stride = FileOffset->QuadPart - PrivateCacheMap->FileOffset2.QuadPart;
+        if (Stride == 0 ||
+            Stride != PrivateCacheMap->FileOffset2.QuadPart - PrivateCacheMap->FileOffset1.QuadPart)
         {
+            /* No pattern we know about, reset the window */
+            PrivateCacheMap->ReadAheadLength[0] = 0;
+            PrivateCacheMap->ReadAheadOffset[0].QuadPart = 0;
             KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
             return;
         }
+    }
 
-        /* FIXME: hackish, but will do the job for now */
-        PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-        PrivateCacheMap->ReadAheadLength[1] = Length;
+    /* The pattern goes on, grow the window geometrically, up to the cap */
+    Window = PrivateCacheMap->ReadAheadLength[0];
+    if (Window == 0)
+    {
+        Window = Length;
     }
-    /* Other cases: try to find some logic in that mess... */
     else
     {
-        /* Let's check if we always read the same way (like going down in the file)
-         * and pretend it's enough for now
+        Window = min(Window * 2, CcMaximumReadAheadLength);
+    }
+    Window = min(max(Window, Length), CcMaximumReadAheadLength);
+    Window = ROUND_UP(Window, PAGE_SIZE);
+
+    if (Stride > 0 && Stride <= 2 * (LONGLONG)Length)
+    {
+        /* Sequential, or dense enough to read the holes: bring the window
+         * right after the current read, minus what was already brought in
          */
-        if (PrivateCacheMap->FileOffset2.QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
-            FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart)
+        ReadAheadStart = FileOffset->QuadPart + Stride;
+        ReadAheadEnd = ReadAheadStart + Window;
+        if (PrivateCacheMap->ReadAheadOffset[0].QuadPart > ReadAheadStart)
         {
-            /* FIXME: hackish, but will do the job for now */
-            PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-            PrivateCacheMap->ReadAheadLength[1] = Length;
+            ReadAheadStart = PrivateCacheMap->ReadAheadOffset[0].QuadPart;
         }
-        else
+    }
+    else if (Stride > 0)
+    {
+        /* Sparse stride: only bring in the next read */
+        ReadAheadStart = FileOffset->QuadPart + Stride;
+        ReadAheadEnd = ReadAheadStart + Length;
+    }
+    else
+    {
+        /* Going backward: bring the window just before the current read */
+        ReadAheadEnd = FileOffset->QuadPart + Stride + Length;
+        if (ReadAheadEnd <= 0)
         {
-            /* FIXME: handle the other cases */
             KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            UNIMPLEMENTED_ONCE;
             return;
         }
+        if (-Stride <= 2 * (LONGLONG)Length)
+        {
+            ReadAheadStart = max(ReadAheadEnd - (LONGLONG)Window, 0);
+            if (PrivateCacheMap->ReadAheadOffset[0].QuadPart != 0 &&
+                PrivateCacheMap->ReadAheadOffset[0].QuadPart < ReadAheadEnd)
+            {
+                ReadAheadEnd = PrivateCacheMap->ReadAheadOffset[0].QuadPart;
+            }
+        }
+        else
+        {
+            ReadAheadStart = max(ReadAheadEnd - (LONGLONG)Length, 0);
+        }
+    }
+
+    PrivateCacheMap->ReadAheadLength[0] = Window;
+
+    /* Everything we'd read ahead is already in */
+    if (ReadAheadEnd <= ReadAheadStart)
+    {
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
     }
 
+    /* ReadAheadOffset[0] is the boundary of what was already read ahead */
+    PrivateCacheMap->ReadAheadOffset[0].QuadPart = (Stride > 0 ? ReadAheadEnd : ReadAheadStart);
+    PrivateCacheMap->ReadAheadOffset[1].QuadPart = ReadAheadStart;
+    PrivateCacheMap->ReadAheadLength[1] = (ULONG)(ReadAheadEnd - ReadAheadStart);
+
     /* If read ahead isn't active yet */
     if (!PrivateCacheMap->Flags.ReadAheadActive)
     {
@@ -50,6 +50,30 @@ ULONG CcFastReadResourceMiss;
 ULONG CcDataPages = 0;
 ULONG CcDataFlushes = 0;
 
+/* Read ahead window cap, can be tuned with the ReadAheadMaximum value of
+ * the Memory Management key
+ */
+ULONG CcMaximumReadAheadLength = 8 * 1024 * 1024;
+
+/* Read ahead I/O are issued by batches of contiguous views,
+ * with up to two batches in flight
+ */
+#define CC_READ_AHEAD_BATCH_VIEWS   16
+#define CC_READ_AHEAD_BATCHES       2
+
+typedef struct _CC_READ_AHEAD_BATCH
+{
+    PROS_VACB Vacbs[CC_READ_AHEAD_BATCH_VIEWS];
+    PMDL ViewMdls[CC_READ_AHEAD_BATCH_VIEWS];
+    ULONG Count;
+    ULONG Size;
+    PMDL Mdl;
+    BOOLEAN InFlight;
+    NTSTATUS Status;
+    KEVENT Event;
+    IO_STATUS_BLOCK IoStatus;
+} CC_READ_AHEAD_BATCH, *PCC_READ_AHEAD_BATCH;
+
 /* FUNCTIONS *****************************************************************/
 
 VOID
@@ -99,6 +123,12 @@ CcReadVirtualAddress (
     ASSERT(Size <= VACB_MAPPING_GRANULARITY);
     ASSERT(Size > 0);
 
+    /* Demand reads are what the prefetcher replays on the next launch */
+    if (CcPfEnablePrefetcher)
+    {
+        CcPfLogFileRead(Vacb->SharedCacheMap->FileObject, Vacb->FileOffset.QuadPart);
+    }
+
     Mdl = IoAllocateMdl(Vacb->BaseAddress, Size, FALSE, FALSE, NULL);
     if (!Mdl)
     {
@@ -268,7 +298,7 @@ CcCopyData (
     ULONG BytesCopied;
     KIRQL OldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
-    PLIST_ENTRY ListEntry;
+    LONGLONG ViewOffset;
     PROS_VACB Vacb;
     ULONG PartialLength;
     PVOID BaseAddress;
@@ -285,25 +315,18 @@ CcCopyData (
         /* test if the requested data is available */
         KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
         /* FIXME: this loop doesn't take into account areas that don't have
-         * a VACB in the list yet */
-        ListEntry = SharedCacheMap->CacheMapVacbListHead.Flink;
-        while (ListEntry != &SharedCacheMap->CacheMapVacbListHead)
+         * a VACB yet */
+        for (ViewOffset = ROUND_DOWN(CurrentOffset, VACB_MAPPING_GRANULARITY);
+             ViewOffset < CurrentOffset + Length;
+             ViewOffset += VACB_MAPPING_GRANULARITY)
         {
-            Vacb = CONTAINING_RECORD(ListEntry,
-                                     ROS_VACB,
-                                     CacheMapVacbListEntry);
-            ListEntry = ListEntry->Flink;
-            if (!Vacb->Valid &&
-                DoRangesIntersect(Vacb->FileOffset.QuadPart,
-                                  VACB_MAPPING_GRANULARITY,
-                                  CurrentOffset, Length))
+            Vacb = CcRosVacbIndexLookup(SharedCacheMap, ViewOffset);
+            if (Vacb != NULL && !Vacb->Valid)
             {
                 KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
                 /* data not available */
                 return FALSE;
             }
-            if (Vacb->FileOffset.QuadPart >= CurrentOffset + Length)
-                break;
         }
         KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
     }
@@ -387,11 +410,10 @@ CcCopyData (
     /* If that was a successful sync read operation, let's handle read ahead */
     if (Operation == CcOperationRead && Length == 0 && Wait)
     {
-        /* If file isn't random access and next read may get us cross VACB boundary,
-         * schedule next read
+        /* If file isn't random access, let read ahead find out whether
+         * the reads follow some pattern and bring the next data in
          */
-        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS) &&
-            (CurrentOffset - 1) / VACB_MAPPING_GRANULARITY != (CurrentOffset + BytesCopied - 1) / VACB_MAPPING_GRANULARITY)
+        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
         {
             CcScheduleReadAhead(FileObject, (PLARGE_INTEGER)&FileOffset, BytesCopied);
         }
@@ -482,21 +504,173 @@ CcPostDeferredWrites(VOID)
     }
 }
 
+static
+VOID
+CcReadAheadStartBatch(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN PCC_READ_AHEAD_BATCH Batch)
+{
+    ULONG i, ViewSize, Size;
+    ULARGE_INTEGER LargeSize;
+    PPFN_NUMBER Pages;
+    NTSTATUS Status;
+
+    ASSERT(Batch->Count != 0);
+    ASSERT(!Batch->InFlight);
+
+    /* Don't read past the end of the section */
+    LargeSize.QuadPart = SharedCacheMap->SectionSize.QuadPart - Batch->Vacbs[0]->FileOffset.QuadPart;
+    if (LargeSize.QuadPart > Batch->Count * VACB_MAPPING_GRANULARITY)
+    {
+        LargeSize.QuadPart = Batch->Count * VACB_MAPPING_GRANULARITY;
+    }
+    Batch->Size = ROUND_TO_PAGES(LargeSize.LowPart);
+    Batch->Mdl = NULL;
+    RtlZeroMemory(Batch->ViewMdls, sizeof(Batch->ViewMdls));
+
+    Status = STATUS_INSUFFICIENT_RESOURCES;
+
+    /* One MDL covers the pages of all the views of the batch */
+    Batch->Mdl = IoAllocateMdl(Batch->Vacbs[0]->BaseAddress, Batch->Size, FALSE, FALSE, NULL);
+    if (Batch->Mdl == NULL)
+    {
+        goto Quit;
+    }
+    Pages = MmGetMdlPfnArray(Batch->Mdl);
+
+    Size = Batch->Size;
+    for (i = 0; i < Batch->Count; i++)
+    {
+        ASSERT(Size != 0);
+        ViewSize = min(Size, VACB_MAPPING_GRANULARITY);
+
+        /* Lock the view pages, as CcReadVirtualAddress would do */
+        Batch->ViewMdls[i] = IoAllocateMdl(Batch->Vacbs[i]->BaseAddress, ViewSize, FALSE, FALSE, NULL);
+        if (Batch->ViewMdls[i] == NULL)
+        {
+            goto Quit;
+        }
+
+        _SEH2_TRY
+        {
+            MmProbeAndLockPages(Batch->ViewMdls[i], KernelMode, IoWriteAccess);
+        }
+        _SEH2_EXCEPT (EXCEPTION_EXECUTE_HANDLER)
+        {
+            DPRINT1("MmProbeAndLockPages failed with: %lx for %p (%p)\n", _SEH2_GetExceptionCode(), Batch->ViewMdls[i], Batch->Vacbs[i]);
+            KeBugCheck(CACHE_MANAGER);
+        } _SEH2_END;
+
+        RtlCopyMemory(Pages + i * (VACB_MAPPING_GRANULARITY / PAGE_SIZE),
+                      MmGetMdlPfnArray(Batch->ViewMdls[i]),
+                      BYTES_TO_PAGES(ViewSize) * sizeof(PFN_NUMBER));
+        Size -= ViewSize;
+    }
+
+    /* Pages are locked through the view MDLs */
+    Batch->Mdl->MdlFlags |= MDL_PAGES_LOCKED | MDL_IO_PAGE_READ;
+
+    KeInitializeEvent(&Batch->Event, NotificationEvent, FALSE);
+    Status = IoPageRead(SharedCacheMap->FileObject, Batch->Mdl, &Batch->Vacbs[0]->FileOffset, &Batch->Event, &Batch->IoStatus);
+    if (Status == STATUS_PENDING)
+    {
+        Batch->InFlight = TRUE;
+        return;
+    }
+
+Quit:
+    Batch->Status = Status;
+    Batch->IoStatus.Status = Status;
+    Batch->InFlight = FALSE;
+}
+
+static
+VOID
+CcReadAheadCompleteBatch(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN PCC_READ_AHEAD_BATCH Batch)
+{
+    ULONG i, Offset;
+    NTSTATUS Status;
+
+    if (Batch->Count == 0)
+    {
+        return;
+    }
+
+    if (Batch->InFlight)
+    {
+        KeWaitForSingleObject(&Batch->Event, Executive, KernelMode, FALSE, NULL);
+        Batch->Status = Batch->IoStatus.Status;
+        Batch->InFlight = FALSE;
+    }
+
+    Status = Batch->Status;
+    if (!NT_SUCCESS(Status) && Status != STATUS_END_OF_FILE)
+    {
+        DPRINT1("Failed to read data: %lx!\n", Status);
+    }
+
+    if (Batch->Mdl != NULL)
+    {
+        if (Batch->Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+        {
+            MmUnmapLockedPages(Batch->Mdl->MappedSystemVa, Batch->Mdl);
+        }
+        Batch->Mdl->MdlFlags &= ~MDL_PAGES_LOCKED;
+        IoFreeMdl(Batch->Mdl);
+        Batch->Mdl = NULL;
+    }
+
+    for (i = 0; i < Batch->Count; i++)
+    {
+        if (Batch->ViewMdls[i] != NULL)
+        {
+            if (Batch->ViewMdls[i]->MdlFlags & MDL_PAGES_LOCKED)
+            {
+                MmUnlockPages(Batch->ViewMdls[i]);
+            }
+            IoFreeMdl(Batch->ViewMdls[i]);
+        }
+
+        if (NT_SUCCESS(Status) || Status == STATUS_END_OF_FILE)
+        {
+            /* Zero what is beyond the section, as CcReadVirtualAddress does */
+            Offset = i * VACB_MAPPING_GRANULARITY;
+            if (Offset + VACB_MAPPING_GRANULARITY > Batch->Size)
+            {
+                RtlZeroMemory((PUCHAR)Batch->Vacbs[i]->BaseAddress + (Batch->Size - Offset),
+                              VACB_MAPPING_GRANULARITY - (Batch->Size - Offset));
+            }
+
+            CcRosReleaseVacb(SharedCacheMap, Batch->Vacbs[i], TRUE, FALSE, FALSE);
+        }
+        else
+        {
+            CcRosReleaseVacb(SharedCacheMap, Batch->Vacbs[i], FALSE, FALSE, FALSE);
+        }
+    }
+
+    Batch->Count = 0;
+}
+
 VOID
 CcPerformReadAhead(
     IN PFILE_OBJECT FileObject)
 {
     NTSTATUS Status;
-    LONGLONG CurrentOffset;
+    LONGLONG CurrentOffset, EndOffset;
     KIRQL OldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
     PROS_VACB Vacb;
-    ULONG PartialLength;
     PVOID BaseAddress;
     BOOLEAN Valid;
     ULONG Length;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
     BOOLEAN Locked;
+    CC_READ_AHEAD_BATCH Batches[CC_READ_AHEAD_BATCHES];
+    PCC_READ_AHEAD_BATCH Batch;
+    ULONG Current, i;
 
     SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
 
@@ -525,6 +699,13 @@ CcPerformReadAhead(
     }
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
 
+    for (i = 0; i < CC_READ_AHEAD_BATCHES; i++)
+    {
+        Batches[i].Count = 0;
+        Batches[i].InFlight = FALSE;
+    }
+    Current = 0;
+
     /* Time to go! */
     DPRINT("Doing ReadAhead for %p\n", FileObject);
     /* Lock the file, first */
@@ -547,76 +728,57 @@ CcPerformReadAhead(
         Length = SharedCacheMap->FileSize.QuadPart - CurrentOffset;
     }
 
-    /* Next of the algorithm will lock like CcCopyData with the slight
+    /* Next of the algorithm will look like CcCopyData with the slight
      * difference that we don't copy data back to an user-backed buffer
-     * We just bring data into Cc
+     * We just bring data into Cc. Views which aren't valid yet are
+     * gathered so that contiguous ones are read with a single I/O.
      */
-    PartialLength = CurrentOffset % VACB_MAPPING_GRANULARITY;
-    if (PartialLength != 0)
+    EndOffset = CurrentOffset + Length;
+    CurrentOffset = ROUND_DOWN(CurrentOffset, VACB_MAPPING_GRANULARITY);
+    while (CurrentOffset < EndOffset)
     {
-        PartialLength = min(Length, VACB_MAPPING_GRANULARITY - PartialLength);
         Status = CcRosRequestVacb(SharedCacheMap,
-                                  ROUND_DOWN(CurrentOffset,
-                                             VACB_MAPPING_GRANULARITY),
+                                  CurrentOffset,
                                   &BaseAddress,
                                   &Valid,
                                   &Vacb);
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            break;
         }
 
-        if (!Valid)
+        Batch = &Batches[Current];
+        if (Valid)
         {
-            Status = CcReadVirtualAddress(Vacb);
-            if (!NT_SUCCESS(Status))
-            {
-                CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE, FALSE);
-                DPRINT1("Failed to read data: %lx!\n", Status);
-                goto Clear;
-            }
+            CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
         }
-
-        CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
-
-        Length -= PartialLength;
-        CurrentOffset += PartialLength;
-    }
-
-    while (Length > 0)
-    {
-        ASSERT(CurrentOffset % VACB_MAPPING_GRANULARITY == 0);
-        PartialLength = min(VACB_MAPPING_GRANULARITY, Length);
-        Status = CcRosRequestVacb(SharedCacheMap,
-                                  CurrentOffset,
-                                  &BaseAddress,
-                                  &Valid,
-                                  &Vacb);
-        if (!NT_SUCCESS(Status))
+        else
         {
-            DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            Batch->Vacbs[Batch->Count++] = Vacb;
         }
 
-        if (!Valid)
-        {
-            Status = CcReadVirtualAddress(Vacb);
-            if (!NT_SUCCESS(Status))
-            {
-                CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE, FALSE);
-                DPRINT1("Failed to read data: %lx!\n", Status);
-                goto Clear;
-            }
-        }
+        CurrentOffset += VACB_MAPPING_GRANULARITY;
 
-        CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
+        /* Issue the batch once it's full, or not contiguous any longer */
+        if (Batch->Count != 0 &&
+            (Valid || Batch->Count == CC_READ_AHEAD_BATCH_VIEWS || CurrentOffset >= EndOffset))
+        {
+            CcReadAheadStartBatch(SharedCacheMap, Batch);
 
-        Length -= PartialLength;
-        CurrentOffset += PartialLength;
+            /* And make room for the next one */
+            Current = (Current + 1) % CC_READ_AHEAD_BATCHES;
+            CcReadAheadCompleteBatch(SharedCacheMap, &Batches[Current]);
+        }
     }
 
 Clear:
+    /* Wait for the batches still in flight */
+    for (i = 0; i < CC_READ_AHEAD_BATCHES; i++)
+    {
+        CcReadAheadCompleteBatch(SharedCacheMap, &Batches[i]);
+    }
+
     /* See previous comment about private cache map */
     OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
     PrivateCacheMap = FileObject->PrivateCacheMap;
@@ -641,6 +803,119 @@ Clear:
     return;
 }
 
+/*
+ * FUNCTION: Bring into the cache the views holding the given file offsets,
+ * for MmPrefetchPages. The offsets must be sorted; views which aren't valid
+ * yet are read with one I/O per run of contiguous views.
+ */
+VOID
+NTAPI
+CcPrefetchPages(
+    IN PFILE_OBJECT FileObject,
+    IN PFILE_SEGMENT_ELEMENT Entries,
+    IN ULONG NumberOfEntries)
+{
+    NTSTATUS Status;
+    LONGLONG CurrentOffset, LastOffset;
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_VACB Vacb;
+    PVOID BaseAddress;
+    BOOLEAN Valid;
+    CC_READ_AHEAD_BATCH Batches[CC_READ_AHEAD_BATCHES];
+    PCC_READ_AHEAD_BATCH Batch;
+    ULONG Current, i;
+
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+    ASSERT(SharedCacheMap != NULL);
+
+    for (i = 0; i < CC_READ_AHEAD_BATCHES; i++)
+    {
+        Batches[i].Count = 0;
+        Batches[i].InFlight = FALSE;
+    }
+    Current = 0;
+
+    if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, TRUE))
+    {
+        return;
+    }
+
+    LastOffset = -1;
+    for (i = 0; i < NumberOfEntries; i++)
+    {
+        CurrentOffset = ROUND_DOWN((LONGLONG)Entries[i].Alignment, VACB_MAPPING_GRANULARITY);
+
+        /* Several pages of the same view only need it once */
+        if (CurrentOffset == LastOffset)
+        {
+            continue;
+        }
+        if (CurrentOffset >= SharedCacheMap->FileSize.QuadPart)
+        {
+            break;
+        }
+
+        Batch = &Batches[Current];
+
+        /* A gap ends the current batch */
+        if (Batch->Count != 0 &&
+            CurrentOffset != LastOffset + VACB_MAPPING_GRANULARITY)
+        {
+            CcReadAheadStartBatch(SharedCacheMap, Batch);
+            Current = (Current + 1) % CC_READ_AHEAD_BATCHES;
+            CcReadAheadCompleteBatch(SharedCacheMap, &Batches[Current]);
+            Batch = &Batches[Current];
+        }
+        LastOffset = CurrentOffset;
+
+        Status = CcRosRequestVacb(SharedCacheMap,
+                                  CurrentOffset,
+                                  &BaseAddress,
+                                  &Valid,
+                                  &Vacb);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to request VACB: %lx!\n", Status);
+            break;
+        }
+
+        if (Valid)
+        {
+            CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
+
+            /* Already cached, so what follows isn't contiguous with the batch */
+            if (Batch->Count != 0)
+            {
+                CcReadAheadStartBatch(SharedCacheMap, Batch);
+                Current = (Current + 1) % CC_READ_AHEAD_BATCHES;
+                CcReadAheadCompleteBatch(SharedCacheMap, &Batches[Current]);
+            }
+            continue;
+        }
+
+        Batch->Vacbs[Batch->Count++] = Vacb;
+        if (Batch->Count == CC_READ_AHEAD_BATCH_VIEWS)
+        {
+            CcReadAheadStartBatch(SharedCacheMap, Batch);
+            Current = (Current + 1) % CC_READ_AHEAD_BATCHES;
+            CcReadAheadCompleteBatch(SharedCacheMap, &Batches[Current]);
+        }
+    }
+
+    /* Issue what is left, and wait for everything still in flight */
+    Batch = &Batches[Current];
+    if (Batch->Count != 0)
+    {
+        CcReadAheadStartBatch(SharedCacheMap, Batch);
+    }
+    for (i = 0; i < CC_READ_AHEAD_BATCHES; i++)
+    {
+        CcReadAheadCompleteBatch(SharedCacheMap, &Batches[i]);
+    }
+
+    SharedCacheMap->Callbacks->ReleaseFromReadAhead(SharedCacheMap->LazyWriteContext);
+}
+
 /*
  * @unimplemented
  */
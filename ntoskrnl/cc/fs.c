@@ -113,42 +113,47 @@ CcIsThereDirtyData (
 {
     PROS_VACB Vacb;
     PLIST_ENTRY Entry;
+    PCC_VACB_LIST_SHARD Shard;
     KIRQL oldIrql;
+    ULONG i;
     /* Assume no dirty data */
     BOOLEAN Dirty = FALSE;
 
     CCTRACE(CC_API_DEBUG, "Vpb=%p\n", Vpb);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-
     /* Browse dirty VACBs */
-    for (Entry = DirtyVacbListHead.Flink; Entry != &DirtyVacbListHead; Entry = Entry->Flink)
+    for (i = 0; i < CC_VACB_LIST_SHARDS && !Dirty; i++)
     {
-        Vacb = CONTAINING_RECORD(Entry, ROS_VACB, DirtyVacbListEntry);
-        /* Look for these associated with our volume */
-        if (Vacb->SharedCacheMap->FileObject->Vpb != Vpb)
+        Shard = &CcVacbListShards[i];
+
+        KeAcquireSpinLock(&Shard->Lock, &oldIrql);
+        for (Entry = Shard->DirtyVacbListHead.Flink; Entry != &Shard->DirtyVacbListHead; Entry = Entry->Flink)
         {
-            continue;
-        }
+            Vacb = CONTAINING_RECORD(Entry, ROS_VACB, DirtyVacbListEntry);
+            /* Look for these associated with our volume */
+            if (Vacb->SharedCacheMap->FileObject->Vpb != Vpb)
+            {
+                continue;
+            }
 
-        /* From now on, we are associated with our VPB */
+            /* From now on, we are associated with our VPB */
 
-        /* Temporary files are not counted as dirty */
-        if (BooleanFlagOn(Vacb->SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
-        {
-            continue;
-        }
+            /* Temporary files are not counted as dirty */
+            if (BooleanFlagOn(Vacb->SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
+            {
+                continue;
+            }
 
-        /* A single dirty VACB is enough to have dirty data */
-        if (Vacb->Dirty)
-        {
-            Dirty = TRUE;
-            break;
+            /* A single dirty VACB is enough to have dirty data */
+            if (Vacb->Dirty)
+            {
+                Dirty = TRUE;
+                break;
+            }
         }
+        KeReleaseSpinLock(&Shard->Lock, oldIrql);
     }
 
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-
     return Dirty;
 }
 
@@ -170,6 +175,7 @@ CcPurgeCacheSection (
     KIRQL OldIrql;
     PLIST_ENTRY ListEntry;
     PROS_VACB Vacb;
+    PCC_VACB_LIST_SHARD Shard;
     LONGLONG ViewEnd;
     BOOLEAN Success;
 
@@ -220,7 +226,7 @@ CcPurgeCacheSection (
                       SharedCacheMap->SectionSize.QuadPart);
         if (ViewEnd >= EndOffset)
         {
-            break;
+            continue;
         }
 
         /* Still in use, it cannot be purged, fail
@@ -236,12 +242,16 @@ CcPurgeCacheSection (
 
         /* This VACB is in range, so unlink it and mark for free */
         ASSERT(Refs == 1 || Vacb->Dirty);
+        Shard = &CcVacbListShards[Vacb->ListShard];
+        KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
         RemoveEntryList(&Vacb->VacbLruListEntry);
         InitializeListHead(&Vacb->VacbLruListEntry);
+        KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
         if (Vacb->Dirty)
         {
             CcRosUnmarkDirtyVacb(Vacb, FALSE);
         }
+        CcRosVacbIndexRemove(Vacb);
         RemoveEntryList(&Vacb->CacheMapVacbListEntry);
         InsertHeadList(&FreeList, &Vacb->CacheMapVacbListEntry);
     }
@@ -42,8 +42,8 @@
 
 /* GLOBALS *******************************************************************/
 
-LIST_ENTRY DirtyVacbListHead;
-static LIST_ENTRY VacbLruListHead;
+CC_VACB_LIST_SHARD CcVacbListShards[CC_VACB_LIST_SHARDS];
+static ULONG CcDirtyVacbSequence;
 
 NPAGED_LOOKASIDE_LIST iBcbLookasideList;
 static NPAGED_LOOKASIDE_LIST SharedCacheMapLookasideList;
@@ -113,6 +113,132 @@ ULONG CcRosVacbGetRefCount_(PROS_VACB vacb, PCSTR file, INT line)
 
 /* FUNCTIONS *****************************************************************/
 
+/*
+ * The VACB index is a two level sparse array: the top level is an array of
+ * pointers to leaves, each leaf holding VACB_INDEX_LEAF_SIZE slots of one
+ * view each. Leaves are only allocated once a VACB lands in their range.
+ * All the operations must be performed with the CacheMapLock held.
+ */
+PROS_VACB
+CcRosVacbIndexLookup (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG Slot;
+    ULONG Leaf;
+
+    if (FileOffset < 0)
+        return NULL;
+
+    Slot = (ULONGLONG)FileOffset / VACB_MAPPING_GRANULARITY;
+    if (Slot / VACB_INDEX_LEAF_SIZE >= SharedCacheMap->VacbIndexLeaves)
+        return NULL;
+
+    Leaf = (ULONG)(Slot / VACB_INDEX_LEAF_SIZE);
+    if (SharedCacheMap->VacbIndex[Leaf] == NULL)
+        return NULL;
+
+    return SharedCacheMap->VacbIndex[Leaf][Slot % VACB_INDEX_LEAF_SIZE];
+}
+
+static
+NTSTATUS
+CcRosVacbIndexInsert (
+    PROS_VACB Vacb)
+{
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_VACB **NewIndex;
+    ULONGLONG Slot;
+    ULONG Leaf, NewLeaves;
+
+    SharedCacheMap = Vacb->SharedCacheMap;
+    Slot = (ULONGLONG)Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY;
+    if (Slot / VACB_INDEX_LEAF_SIZE >= MAXULONG)
+        return STATUS_INVALID_PARAMETER;
+    Leaf = (ULONG)(Slot / VACB_INDEX_LEAF_SIZE);
+
+    /* Grow the top level, so that we don't have to grow it too often */
+    if (Leaf >= SharedCacheMap->VacbIndexLeaves)
+    {
+        NewLeaves = max(Leaf + 1, SharedCacheMap->VacbIndexLeaves * 2);
+        NewIndex = ExAllocatePoolWithTag(NonPagedPool,
+                                         NewLeaves * sizeof(PROS_VACB *),
+                                         TAG_VACB);
+        if (NewIndex == NULL)
+            return STATUS_INSUFFICIENT_RESOURCES;
+
+        RtlZeroMemory(NewIndex, NewLeaves * sizeof(PROS_VACB *));
+        if (SharedCacheMap->VacbIndex != NULL)
+        {
+            RtlCopyMemory(NewIndex,
+                          SharedCacheMap->VacbIndex,
+                          SharedCacheMap->VacbIndexLeaves * sizeof(PROS_VACB *));
+            ExFreePoolWithTag(SharedCacheMap->VacbIndex, TAG_VACB);
+        }
+
+        SharedCacheMap->VacbIndex = NewIndex;
+        SharedCacheMap->VacbIndexLeaves = NewLeaves;
+    }
+
+    if (SharedCacheMap->VacbIndex[Leaf] == NULL)
+    {
+        SharedCacheMap->VacbIndex[Leaf] = ExAllocatePoolWithTag(NonPagedPool,
+                                                                VACB_INDEX_LEAF_SIZE * sizeof(PROS_VACB),
+                                                                TAG_VACB);
+        if (SharedCacheMap->VacbIndex[Leaf] == NULL)
+            return STATUS_INSUFFICIENT_RESOURCES;
+
+        RtlZeroMemory(SharedCacheMap->VacbIndex[Leaf], VACB_INDEX_LEAF_SIZE * sizeof(PROS_VACB));
+    }
+
+    ASSERT(SharedCacheMap->VacbIndex[Leaf][Slot % VACB_INDEX_LEAF_SIZE] == NULL);
+    SharedCacheMap->VacbIndex[Leaf][Slot % VACB_INDEX_LEAF_SIZE] = Vacb;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+CcRosVacbIndexRemove (
+    PROS_VACB Vacb)
+{
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    ULONGLONG Slot;
+    ULONG Leaf;
+
+    SharedCacheMap = Vacb->SharedCacheMap;
+    Slot = (ULONGLONG)Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY;
+    Leaf = (ULONG)(Slot / VACB_INDEX_LEAF_SIZE);
+
+    ASSERT(Leaf < SharedCacheMap->VacbIndexLeaves);
+    ASSERT(SharedCacheMap->VacbIndex[Leaf] != NULL);
+    ASSERT(SharedCacheMap->VacbIndex[Leaf][Slot % VACB_INDEX_LEAF_SIZE] == Vacb);
+
+    SharedCacheMap->VacbIndex[Leaf][Slot % VACB_INDEX_LEAF_SIZE] = NULL;
+}
+
+static
+VOID
+CcRosVacbIndexFree (
+    PROS_SHARED_CACHE_MAP SharedCacheMap)
+{
+    ULONG Leaf;
+
+    if (SharedCacheMap->VacbIndex == NULL)
+        return;
+
+    for (Leaf = 0; Leaf < SharedCacheMap->VacbIndexLeaves; Leaf++)
+    {
+        if (SharedCacheMap->VacbIndex[Leaf] != NULL)
+        {
+            ExFreePoolWithTag(SharedCacheMap->VacbIndex[Leaf], TAG_VACB);
+        }
+    }
+
+    ExFreePoolWithTag(SharedCacheMap->VacbIndex, TAG_VACB);
+    SharedCacheMap->VacbIndex = NULL;
+    SharedCacheMap->VacbIndexLeaves = 0;
+}
+
 VOID
 NTAPI
 CcRosTraceCacheMap (
@@ -178,6 +304,87 @@ CcRosFlushVacb (
     return Status;
 }
 
+FORCEINLINE
+PCC_VACB_LIST_SHARD
+CcRosVacbListShard (
+    PROS_VACB Vacb)
+{
+    return &CcVacbListShards[Vacb->ListShard];
+}
+
+/*
+ * Merge step of the sharded dirty lists: look at the first eligible
+ * dirty VACB of each shard, and return referenced the one which was
+ * made dirty first. If After is given, only VACBs made dirty after
+ * this sequence number are considered.
+ */
+static
+PROS_VACB
+CcRosGetOldestDirtyVacb (
+    BOOLEAN CalledFromLazy,
+    PULONG After)
+{
+    PLIST_ENTRY current_entry;
+    PCC_VACB_LIST_SHARD Shard;
+    PROS_VACB current, Oldest, Previous;
+    KIRQL OldIrql;
+    ULONG i;
+
+    Oldest = NULL;
+    for (i = 0; i < CC_VACB_LIST_SHARDS; i++)
+    {
+        Shard = &CcVacbListShards[i];
+        Previous = NULL;
+
+        KeAcquireSpinLock(&Shard->Lock, &OldIrql);
+        current_entry = Shard->DirtyVacbListHead.Flink;
+        while (current_entry != &Shard->DirtyVacbListHead)
+        {
+            current = CONTAINING_RECORD(current_entry,
+                                        ROS_VACB,
+                                        DirtyVacbListEntry);
+            current_entry = current_entry->Flink;
+
+            if (After != NULL && (LONG)(current->DirtySequence - *After) <= 0)
+            {
+                continue;
+            }
+
+            /* When performing lazy write, don't handle temporary files */
+            if (CalledFromLazy &&
+                BooleanFlagOn(current->SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
+            {
+                continue;
+            }
+
+            /* Don't attempt to lazy write the files that asked not to */
+            if (CalledFromLazy &&
+                BooleanFlagOn(current->SharedCacheMap->Flags, WRITEBEHIND_DISABLED))
+            {
+                continue;
+            }
+
+            /* Shard lists are kept in dirty order, so this is the oldest of the shard */
+            if (Oldest == NULL ||
+                (LONG)(current->DirtySequence - Oldest->DirtySequence) < 0)
+            {
+                CcRosVacbIncRefCount(current);
+                Previous = Oldest;
+                Oldest = current;
+            }
+            break;
+        }
+        KeReleaseSpinLock(&Shard->Lock, OldIrql);
+
+        if (Previous != NULL)
+        {
+            CcRosVacbDecRefCount(Previous);
+        }
+    }
+
+    return Oldest;
+}
+
 NTSTATUS
 NTAPI
 CcRosFlushDirtyPages (
@@ -186,59 +393,52 @@ CcRosFlushDirtyPages (
     BOOLEAN Wait,
     BOOLEAN CalledFromLazy)
 {
-    PLIST_ENTRY current_entry;
     PROS_VACB current;
     BOOLEAN Locked;
     NTSTATUS Status;
-    KIRQL OldIrql;
+    ULONG Skipped, FailedSequence;
+    BOOLEAN Skipping, Failed;
 
     DPRINT("CcRosFlushDirtyPages(Target %lu)\n", Target);
 
     (*Count) = 0;
+    Skipped = 0;
+    Skipping = FALSE;
+    FailedSequence = 0;
+    Failed = FALSE;
 
     KeEnterCriticalRegion();
-    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-
-    current_entry = DirtyVacbListHead.Flink;
-    if (current_entry == &DirtyVacbListHead)
-    {
-        DPRINT("No Dirty pages\n");
-    }
 
-    while ((current_entry != &DirtyVacbListHead) && (Target > 0))
+    while (Target > 0)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    DirtyVacbListEntry);
-        current_entry = current_entry->Flink;
-
-        CcRosVacbIncRefCount(current);
+        current = CcRosGetOldestDirtyVacb(CalledFromLazy, Skipping ? &Skipped : NULL);
+        if (current == NULL)
+        {
+            DPRINT("No Dirty pages\n");
+            break;
+        }
 
-        /* When performing lazy write, don't handle temporary files */
-        if (CalledFromLazy &&
-            BooleanFlagOn(current->SharedCacheMap->FileObject->Flags, FO_TEMPORARY_FILE))
+        /* Went through all the dirty VACBs we could flush */
+        if (Failed && current->DirtySequence == FailedSequence)
         {
             CcRosVacbDecRefCount(current);
-            continue;
+            break;
         }
 
-        /* Don't attempt to lazy write the files that asked not to */
-        if (CalledFromLazy &&
-            BooleanFlagOn(current->SharedCacheMap->Flags, WRITEBEHIND_DISABLED))
+        /* Might have been flushed by someone else in between */
+        if (!current->Dirty)
         {
             CcRosVacbDecRefCount(current);
             continue;
         }
 
-        ASSERT(current->Dirty);
-
-        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
-
         Locked = current->SharedCacheMap->Callbacks->AcquireForLazyWrite(
                      current->SharedCacheMap->LazyWriteContext, Wait);
         if (!Locked)
         {
-            OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+            /* Don't pick it again, move to the newer ones */
+            Skipped = current->DirtySequence;
+            Skipping = TRUE;
             CcRosVacbDecRefCount(current);
             continue;
         }
@@ -248,13 +448,20 @@ CcRosFlushDirtyPages (
         current->SharedCacheMap->Callbacks->ReleaseFromLazyWrite(
             current->SharedCacheMap->LazyWriteContext);
 
-        OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-        CcRosVacbDecRefCount(current);
-
         if (!NT_SUCCESS(Status) && (Status != STATUS_END_OF_FILE) &&
             (Status != STATUS_MEDIA_WRITE_PROTECTED))
         {
             DPRINT1("CC: Failed to flush VACB.\n");
+
+            /* It was made dirty again, and is now the newest of the
+             * dirty VACBs. If we get it back, we are done.
+             */
+            if (!Failed)
+            {
+                Failed = TRUE;
+                FailedSequence = current->DirtySequence;
+            }
+            CcRosVacbDecRefCount(current);
         }
         else
         {
@@ -274,12 +481,11 @@ CcRosFlushDirtyPages (
             {
                 Target -= PagesFreed;
             }
-        }
 
-        current_entry = DirtyVacbListHead.Flink;
+            CcRosVacbDecRefCount(current);
+        }
     }
 
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
     KeLeaveCriticalRegion();
 
     DPRINT("CcRosFlushDirtyPages() finished\n");
@@ -301,12 +507,13 @@ CcRosTrimCache (
  */
 {
     PLIST_ENTRY current_entry;
+    PCC_VACB_LIST_SHARD Shard;
     PROS_VACB current;
     ULONG PagesFreed;
     KIRQL oldIrql;
     LIST_ENTRY FreeList;
     PFN_NUMBER Page;
-    ULONG i;
+    ULONG i, Index;
     BOOLEAN FlushedPages = FALSE;
 
     DPRINT("CcRosTrimCache(Target %lu)\n", Target);
@@ -318,63 +525,88 @@ CcRosTrimCache (
 retry:
     oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
 
-    current_entry = VacbLruListHead.Flink;
-    while (current_entry != &VacbLruListHead)
+    /* Removing a VACB from the LRU lists requires the master lock, as we hold
+     * it, the VACBs we reference can only be moved inside their shard
+     */
+    for (Index = 0; Index < CC_VACB_LIST_SHARDS; Index++)
     {
-        ULONG Refs;
+        Shard = &CcVacbListShards[Index];
 
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    VacbLruListEntry);
-        current_entry = current_entry->Flink;
+        KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
+        current_entry = Shard->VacbLruListHead.Flink;
+        while (current_entry != &Shard->VacbLruListHead)
+        {
+            ULONG Refs;
 
-        KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
+            current = CONTAINING_RECORD(current_entry,
+                                        ROS_VACB,
+                                        VacbLruListEntry);
 
-        /* Reference the VACB */
-        CcRosVacbIncRefCount(current);
+            /* Reference the VACB */
+            CcRosVacbIncRefCount(current);
+            KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
 
-        /* Check if it's mapped and not dirty */
-        if (InterlockedCompareExchange((PLONG)&current->MappedCount, 0, 0) > 0 && !current->Dirty)
-        {
-            /* We have to break these locks because Cc sucks */
-            KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+            KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
 
-            /* Page out the VACB */
-            for (i = 0; i < VACB_MAPPING_GRANULARITY / PAGE_SIZE; i++)
+            /* Check if it's mapped and not dirty */
+            if (InterlockedCompareExchange((PLONG)&current->MappedCount, 0, 0) > 0 && !current->Dirty)
             {
-                Page = (PFN_NUMBER)(MmGetPhysicalAddress((PUCHAR)current->BaseAddress + (i * PAGE_SIZE)).QuadPart >> PAGE_SHIFT);
+                /* We have to break these locks because Cc sucks */
+                KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
+                KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-                MmPageOutPhysicalAddress(Page);
+                /* Page out the VACB */
+                for (i = 0; i < VACB_MAPPING_GRANULARITY / PAGE_SIZE; i++)
+                {
+                    Page = (PFN_NUMBER)(MmGetPhysicalAddress((PUCHAR)current->BaseAddress + (i * PAGE_SIZE)).QuadPart >> PAGE_SHIFT);
+
+                    MmPageOutPhysicalAddress(Page);
+                }
+
+                /* Reacquire the locks */
+                oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+                KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
             }
 
-            /* Reacquire the locks */
-            oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-            KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
-        }
+            /* Dereference the VACB */
+            Refs = CcRosVacbDecRefCount(current);
 
-        /* Dereference the VACB */
-        Refs = CcRosVacbDecRefCount(current);
+            KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
 
-        /* Check if we can free this entry now */
-        if (Refs < 2)
-        {
-            ASSERT(!current->Dirty);
-            ASSERT(!current->MappedCount);
-            ASSERT(Refs == 1);
+            /* It may have been removed while we didn't hold the master lock,
+             * in such case, restart with the shard
+             */
+            if (IsListEmpty(&current->VacbLruListEntry))
+            {
+                current_entry = Shard->VacbLruListHead.Flink;
+            }
+            else
+            {
+                current_entry = current->VacbLruListEntry.Flink;
+            }
 
-            RemoveEntryList(&current->CacheMapVacbListEntry);
-            RemoveEntryList(&current->VacbLruListEntry);
-            InitializeListHead(&current->VacbLruListEntry);
-            InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
+            /* Check if we can free this entry now */
+            if (Refs < 2 && !IsListEmpty(&current->VacbLruListEntry))
+            {
+                ASSERT(!current->Dirty);
+                ASSERT(!current->MappedCount);
+                ASSERT(Refs == 1);
+
+                CcRosVacbIndexRemove(current);
+                RemoveEntryList(&current->CacheMapVacbListEntry);
+                RemoveEntryList(&current->VacbLruListEntry);
+                InitializeListHead(&current->VacbLruListEntry);
+                InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
+
+                /* Calculate how many pages we freed for Mm */
+                PagesFreed = min(VACB_MAPPING_GRANULARITY / PAGE_SIZE, Target);
+                Target -= PagesFreed;
+                (*NrFreed) += PagesFreed;
+            }
 
-            /* Calculate how many pages we freed for Mm */
-            PagesFreed = min(VACB_MAPPING_GRANULARITY / PAGE_SIZE, Target);
-            Target -= PagesFreed;
-            (*NrFreed) += PagesFreed;
+            KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
         }
-
-        KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
+        KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
     }
 
     KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
@@ -452,14 +684,13 @@ CcRosReleaseVacb (
     return STATUS_SUCCESS;
 }
 
-/* Returns with VACB Lock Held! */
+/* Returns with a reference on the VACB! */
 PROS_VACB
 NTAPI
 CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
     PROS_VACB current;
     KIRQL oldIrql;
 
@@ -468,33 +699,23 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    /* The index is only altered with the CacheMapLock held, no need
+     * for the master lock here
+     */
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    current = CcRosVacbIndexLookup(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        ASSERT(IsPointInRange(current->FileOffset.QuadPart,
+                              VACB_MAPPING_GRANULARITY,
+                              FileOffset));
+        CcRosVacbIncRefCount(current);
     }
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-    return NULL;
+    return current;
 }
 
 VOID
@@ -504,33 +725,44 @@ CcRosMarkDirtyVacb (
 {
     KIRQL oldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PCC_VACB_LIST_SHARD Shard;
 
     SharedCacheMap = Vacb->SharedCacheMap;
+    Shard = CcRosVacbListShard(Vacb);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+    KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
 
     ASSERT(!Vacb->Dirty);
 
-    InsertTailList(&DirtyVacbListHead, &Vacb->DirtyVacbListEntry);
-    CcTotalDirtyPages += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+    Vacb->DirtySequence = InterlockedIncrement((PLONG)&CcDirtyVacbSequence);
+    InsertTailList(&Shard->DirtyVacbListHead, &Vacb->DirtyVacbListEntry);
+    InterlockedExchangeAdd((PLONG)&CcTotalDirtyPages, VACB_MAPPING_GRANULARITY / PAGE_SIZE);
     Vacb->SharedCacheMap->DirtyPages += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
     CcRosVacbIncRefCount(Vacb);
 
     /* Move to the tail of the LRU list */
-    RemoveEntryList(&Vacb->VacbLruListEntry);
-    InsertTailList(&VacbLruListHead, &Vacb->VacbLruListEntry);
+    if (!IsListEmpty(&Vacb->VacbLruListEntry))
+    {
+        RemoveEntryList(&Vacb->VacbLruListEntry);
+        InsertTailList(&Shard->VacbLruListHead, &Vacb->VacbLruListEntry);
+    }
 
     Vacb->Dirty = TRUE;
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+    KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
     /* Schedule a lazy writer run to now that we have dirty VACB */
     if (!LazyWriter.ScanActive)
     {
-        CcScheduleLazyWriteScan(FALSE);
+        oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+        if (!LazyWriter.ScanActive)
+        {
+            CcScheduleLazyWriteScan(FALSE);
+        }
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
     }
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 }
 
 VOID
@@ -541,29 +773,31 @@ CcRosUnmarkDirtyVacb (
 {
     KIRQL oldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PCC_VACB_LIST_SHARD Shard;
 
     SharedCacheMap = Vacb->SharedCacheMap;
+    Shard = CcRosVacbListShard(Vacb);
 
     if (LockViews)
     {
-        oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-        KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+        KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
     }
 
     ASSERT(Vacb->Dirty);
 
     Vacb->Dirty = FALSE;
 
+    KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
     RemoveEntryList(&Vacb->DirtyVacbListEntry);
     InitializeListHead(&Vacb->DirtyVacbListEntry);
-    CcTotalDirtyPages -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+    KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
+    InterlockedExchangeAdd((PLONG)&CcTotalDirtyPages, -(LONG)(VACB_MAPPING_GRANULARITY / PAGE_SIZE));
     Vacb->SharedCacheMap->DirtyPages -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
     CcRosVacbDecRefCount(Vacb);
 
     if (LockViews)
     {
-        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
     }
 }
 
@@ -698,12 +932,13 @@ BOOLEAN
 CcRosFreeUnusedVacb (
     PULONG Count)
 {
-    ULONG cFreed;
+    ULONG cFreed, Index;
     BOOLEAN Freed;
     KIRQL oldIrql;
     PROS_VACB current;
     LIST_ENTRY FreeList;
     PLIST_ENTRY current_entry;
+    PCC_VACB_LIST_SHARD Shard;
 
     cFreed = 0;
     Freed = FALSE;
@@ -712,35 +947,52 @@ CcRosFreeUnusedVacb (
     oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
 
     /* Browse all the available VACB */
-    current_entry = VacbLruListHead.Flink;
-    while (current_entry != &VacbLruListHead)
+    for (Index = 0; Index < CC_VACB_LIST_SHARDS; Index++)
     {
-        ULONG Refs;
+        Shard = &CcVacbListShards[Index];
 
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    VacbLruListEntry);
-        current_entry = current_entry->Flink;
+        KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
+        current_entry = Shard->VacbLruListHead.Flink;
+        while (current_entry != &Shard->VacbLruListHead)
+        {
+            ULONG Refs;
 
-        KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
+            current = CONTAINING_RECORD(current_entry,
+                                        ROS_VACB,
+                                        VacbLruListEntry);
+            current_entry = current_entry->Flink;
 
-        /* Only deal with unused VACB, we will free them */
-        Refs = CcRosVacbGetRefCount(current);
-        if (Refs < 2)
-        {
-            ASSERT(!current->Dirty);
-            ASSERT(!current->MappedCount);
-            ASSERT(Refs == 1);
+            /* Skip the ones in use without dropping the shard lock */
+            if (CcRosVacbGetRefCount(current) >= 2)
+            {
+                continue;
+            }
 
-            /* Reset and move to free list */
-            RemoveEntryList(&current->CacheMapVacbListEntry);
-            RemoveEntryList(&current->VacbLruListEntry);
-            InitializeListHead(&current->VacbLruListEntry);
-            InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
-        }
+            /* We hold the master lock, it cannot be removed from the LRU list */
+            KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
+            KeAcquireSpinLockAtDpcLevel(&current->SharedCacheMap->CacheMapLock);
+            KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
 
-        KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
+            /* Only deal with unused VACB, we will free them */
+            Refs = CcRosVacbGetRefCount(current);
+            current_entry = current->VacbLruListEntry.Flink;
+            if (Refs < 2)
+            {
+                ASSERT(!current->Dirty);
+                ASSERT(!current->MappedCount);
+                ASSERT(Refs == 1);
+
+                /* Reset and move to free list */
+                CcRosVacbIndexRemove(current);
+                RemoveEntryList(&current->CacheMapVacbListEntry);
+                RemoveEntryList(&current->VacbLruListEntry);
+                InitializeListHead(&current->VacbLruListEntry);
+                InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
+            }
 
+            KeReleaseSpinLockFromDpcLevel(&current->SharedCacheMap->CacheMapLock);
+        }
+        KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
     }
 
     KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
@@ -783,8 +1035,7 @@ CcRosCreateVacb (
     PROS_VACB *Vacb)
 {
     PROS_VACB current;
-    PROS_VACB previous;
-    PLIST_ENTRY current_entry;
+    PCC_VACB_LIST_SHARD Shard;
     NTSTATUS Status;
     KIRQL oldIrql;
     ULONG Refs;
@@ -815,6 +1066,8 @@ CcRosCreateVacb (
 #endif
     current->MappedCount = 0;
     current->ReferenceCount = 0;
+    current->ListShard = KeGetCurrentProcessorNumber() % CC_VACB_LIST_SHARDS;
+    current->DirtySequence = 0;
     InitializeListHead(&current->CacheMapVacbListEntry);
     InitializeListHead(&current->DirtyVacbListEntry);
     InitializeListHead(&current->VacbLruListEntry);
@@ -844,68 +1097,54 @@ Retry:
         return Status;
     }
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-
     *Vacb = current;
     /* There is window between the call to CcRosLookupVacb
      * and CcRosCreateVacb. We must check if a VACB for the
      * file offset exist. If there is a VACB, we release
      * our newly created VACB and return the existing one.
      */
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+    current = CcRosVacbIndexLookup(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
+        if (SharedCacheMap->Trace)
+        {
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
+        }
 #endif
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-            Refs = CcRosVacbDecRefCount(*Vacb);
-            ASSERT(Refs == 0);
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
 
-            *Vacb = current;
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
-        {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        *Vacb = current;
+        return STATUS_SUCCESS;
     }
+
     /* There was no existing VACB. */
     current = *Vacb;
-    if (previous)
-    {
-        InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
-    }
-    else
+    Status = CcRosVacbIndexInsert(current);
+    if (!NT_SUCCESS(Status))
     {
-        InsertHeadList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+
+        Refs = CcRosVacbDecRefCount(current);
+        ASSERT(Refs == 0);
+
+        *Vacb = NULL;
+        return Status;
     }
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    InsertTailList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
+    Shard = CcRosVacbListShard(current);
+    KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
+    InsertTailList(&Shard->VacbLruListHead, &current->VacbLruListEntry);
+    KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
     MI_SET_USAGE(MI_USAGE_CACHE);
 #if MI_TRACE_PFNS
@@ -943,6 +1182,7 @@ CcRosGetVacb (
     PROS_VACB *Vacb)
 {
     PROS_VACB current;
+    PCC_VACB_LIST_SHARD Shard;
     NTSTATUS Status;
     ULONG Refs;
     KIRQL OldIrql;
@@ -969,13 +1209,17 @@ CcRosGetVacb (
 
     Refs = CcRosVacbGetRefCount(current);
 
-    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+    Shard = CcRosVacbListShard(current);
+    KeAcquireSpinLock(&Shard->Lock, &OldIrql);
 
     /* Move to the tail of the LRU list */
-    RemoveEntryList(&current->VacbLruListEntry);
-    InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
+    if (!IsListEmpty(&current->VacbLruListEntry))
+    {
+        RemoveEntryList(&current->VacbLruListEntry);
+        InsertTailList(&Shard->VacbLruListHead, &current->VacbLruListEntry);
+    }
 
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+    KeReleaseSpinLock(&Shard->Lock, OldIrql);
 
     /*
      * Return information about the VACB to the caller.
@@ -1165,6 +1409,7 @@ CcRosDeleteFileCache (
  */
 {
     PLIST_ENTRY current_entry;
+    PCC_VACB_LIST_SHARD Shard;
     PROS_VACB current;
     LIST_ENTRY FreeList;
 
@@ -1189,11 +1434,15 @@ CcRosDeleteFileCache (
         while (!IsListEmpty(&SharedCacheMap->CacheMapVacbListHead))
         {
             current_entry = RemoveTailList(&SharedCacheMap->CacheMapVacbListHead);
+            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
+            CcRosVacbIndexRemove(current);
             KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 
-            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
+            Shard = CcRosVacbListShard(current);
+            KeAcquireSpinLockAtDpcLevel(&Shard->Lock);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
+            KeReleaseSpinLockFromDpcLevel(&Shard->Lock);
             if (current->Dirty)
             {
                 KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
@@ -1214,6 +1463,7 @@ CcRosDeleteFileCache (
 #if DBG
         SharedCacheMap->Trace = FALSE;
 #endif
+        CcRosVacbIndexFree(SharedCacheMap);
         KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 
         KeReleaseQueuedSpinLock(LockQueueMasterLock, *OldIrql);
@@ -1535,10 +1785,16 @@ NTAPI
 CcInitView (
     VOID)
 {
+    ULONG i;
+
     DPRINT("CcInitView()\n");
 
-    InitializeListHead(&DirtyVacbListHead);
-    InitializeListHead(&VacbLruListHead);
+    for (i = 0; i < CC_VACB_LIST_SHARDS; i++)
+    {
+        KeInitializeSpinLock(&CcVacbListShards[i].Lock);
+        InitializeListHead(&CcVacbListShards[i].VacbLruListHead);
+        InitializeListHead(&CcVacbListShards[i].DirtyVacbListHead);
+    }
     InitializeListHead(&CcDeferredWrites);
     InitializeListHead(&CcCleanSharedCacheMapList);
     KeInitializeSpinLock(&CcDeferredWriteSpinLock);
@@ -83,7 +83,6 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
 {
     PLIST_ENTRY NextEntry;
     PCMHIVE Hive;
-    NTSTATUS Status;
     BOOLEAN Result = TRUE;
 
     /* Make sure that the registry isn't read-only now */
@@ -101,7 +100,8 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
         Hive = CONTAINING_RECORD(NextEntry, CMHIVE, HiveList);
         if (!(Hive->Hive.HiveFlags & HIVE_NOLAZYFLUSH))
         {
-            /* Acquire the flusher lock */
+            /* Acquire the writer and flusher locks */
+            CmpLockHiveWriter(Hive);
             CmpLockHiveFlusherExclusive(Hive);
 
             /* Check for illegal state */
@@ -116,11 +116,8 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
             /* Only sync if we are forced to or if it won't cause a hive shrink */
             if ((ForceFlush) || (!HvHiveWillShrink(&Hive->Hive)))
             {
-                /* Do the sync */
-                Status = HvSyncHive(&Hive->Hive);
-
-                /* If something failed - set the flag and continue looping */
-                if (!NT_SUCCESS(Status)) Result = FALSE;
+                /* Do the sync, and if something failed - set the flag and continue looping */
+                if (!HvSyncHive(&Hive->Hive)) Result = FALSE;
             }
             else
             {
@@ -129,8 +126,9 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
                 CmpForceForceFlush = TRUE;
             }
 
-            /* Release the flusher lock */
+            /* Release the flusher and writer locks */
             CmpUnlockHiveFlusher(Hive);
+            CmpUnlockHiveWriter(Hive);
         }
 
         /* Try the next entry */
@@ -170,12 +168,12 @@ CmpSetValueKeyNew(IN PHHIVE Hive,
         }
     }
 
-    /* Allocate a value cell */
+    /* Allocate a value cell, next to the value list if there's one */
     ValueCell = HvAllocateCell(Hive,
                                FIELD_OFFSET(CM_KEY_VALUE, Name) +
                                CmpNameSize(Hive, ValueName),
                                StorageType,
-                               HCELL_NIL);
+                               Parent->ValueList.Count ? Parent->ValueList.List : HCELL_NIL);
     if (ValueCell == HCELL_NIL) return STATUS_INSUFFICIENT_RESOURCES;
 
     /* Get the actual data for it */
@@ -1187,6 +1185,137 @@ DoAgain:
     return Status;
 }
 
+NTSTATUS
+NTAPI
+CmQueryMultipleValueKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
+                        IN OUT PKEY_VALUE_ENTRY ValueEntries,
+                        IN ULONG EntryCount,
+                        IN PVOID Buffer,
+                        IN OUT PULONG BufferLength,
+                        OUT PULONG RequiredLength)
+{
+    NTSTATUS Status;
+    PCM_KEY_VALUE ValueData;
+    ULONG Index, i, DataLength, Offset;
+    BOOLEAN ValueCached, Allocated;
+    PCM_CACHED_VALUE *CachedValue;
+    HCELL_INDEX CellToRelease, DataCell;
+    VALUE_SEARCH_RETURN_TYPE Result;
+    PVOID DataPointer;
+    PHHIVE Hive;
+    PAGED_CODE();
+
+    /* Acquire hive lock */
+    CmpLockRegistry();
+
+    /* Lock the KCB shared, all the values are looked up under it */
+    CmpAcquireKcbLockShared(Kcb);
+
+    /* Don't touch deleted keys */
+DoAgain:
+    if (Kcb->Delete)
+    {
+        /* Undo everything */
+        CmpReleaseKcbLock(Kcb);
+        CmpUnlockRegistry();
+        return STATUS_KEY_DELETED;
+    }
+
+    /* Get the hive */
+    Hive = Kcb->KeyHive;
+
+    /* The data of the values goes one after the other in the buffer */
+    Status = STATUS_SUCCESS;
+    Offset = 0;
+    for (i = 0; i < EntryCount; i++)
+    {
+        /* Find the key value */
+        ValueCached = FALSE;
+        Result = CmpFindValueByNameFromCache(Kcb,
+                                             ValueEntries[i].ValueName,
+                                             &CachedValue,
+                                             &Index,
+                                             &ValueData,
+                                             &ValueCached,
+                                             &CellToRelease);
+        if (Result == SearchNeedExclusiveLock)
+        {
+            /* Start over with the exclusive KCB lock */
+            ASSERT(CellToRelease == HCELL_NIL);
+            CmpConvertKcbSharedToExclusive(Kcb);
+            goto DoAgain;
+        }
+
+        if (Result != SearchSuccess)
+        {
+            /* All of them have to be there */
+            Status = STATUS_OBJECT_NAME_NOT_FOUND;
+            break;
+        }
+
+        /* Get the data */
+        if (!CmpGetValueData(Hive,
+                             ValueData,
+                             &DataLength,
+                             &DataPointer,
+                             &Allocated,
+                             &DataCell))
+        {
+            if (CellToRelease != HCELL_NIL) HvReleaseCell(Hive, CellToRelease);
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        if (DataLength > MAXULONG - Offset)
+        {
+            Status = STATUS_INTEGER_OVERFLOW;
+        }
+        else
+        {
+            ValueEntries[i].DataLength = DataLength;
+            ValueEntries[i].DataOffset = Offset;
+            ValueEntries[i].Type = ValueData->Type;
+
+            /* Keep going once the buffer is full, for the required length */
+            if (Offset + DataLength > *BufferLength)
+            {
+                Status = STATUS_BUFFER_OVERFLOW;
+            }
+            else
+            {
+                /* User data, protect against exceptions */
+                _SEH2_TRY
+                {
+                    RtlCopyMemory((PUCHAR)Buffer + Offset, DataPointer, DataLength);
+                }
+                _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+                {
+                    Status = _SEH2_GetExceptionCode();
+                }
+                _SEH2_END;
+            }
+
+            Offset += DataLength;
+        }
+
+        /* Release the data and the value */
+        if (Allocated) CmpFree(DataPointer, 0);
+        if (DataCell != HCELL_NIL) HvReleaseCell(Hive, DataCell);
+        if (CellToRelease != HCELL_NIL) HvReleaseCell(Hive, CellToRelease);
+
+        if (!NT_SUCCESS(Status) && (Status != STATUS_BUFFER_OVERFLOW)) break;
+    }
+
+    /* Return how much was used, and how much is needed */
+    *RequiredLength = Offset;
+    if (NT_SUCCESS(Status)) *BufferLength = Offset;
+
+    /* Release locks */
+    CmpReleaseKcbLock(Kcb);
+    CmpUnlockRegistry();
+    return Status;
+}
+
 NTSTATUS
 NTAPI
 CmEnumerateValueKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
@@ -1958,6 +2087,7 @@ CmFlushKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
     else
     {
         /* Don't touch the hive */
+        CmpLockHiveWriter(CmHive);
         CmpLockHiveFlusherExclusive(CmHive);
 
         ASSERT(CmHive->ViewLock);
@@ -1991,8 +2121,9 @@ CmFlushKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
             Status = STATUS_REGISTRY_IO_FAILED;
         }
 
-        /* Release the flush lock */
+        /* Release the flush and writer locks */
         CmpUnlockHiveFlusher(CmHive);
+        CmpUnlockHiveWriter(CmHive);
     }
 
     /* Return the status */
@@ -2346,10 +2477,10 @@ CmpEnumerateOpenSubKeys(
     }
 
     /* Enumerate all hash lists */
-    for (i = 0; i < CmpHashTableSize; i++)
+    for (i = 0; i < CmpKeyHashBuckets.Size; i++)
     {
         /* Get the first cache entry */
-        Entry = CmpCacheTable[i].Entry;
+        Entry = CmpKeyHashBuckets.Buckets[i];
 
         /* Enumerate all cache entries */
         while (Entry)
@@ -2422,7 +2553,7 @@ CmpEnumerateOpenSubKeys(
                         CmpCleanUpKcbCacheWithLock(CachedKcb, TRUE);
 
                         /* Restart, because the hash list has changed */
-                        Entry = CmpCacheTable[i].Entry;
+                        Entry = CmpKeyHashBuckets.Buckets[i];
                         continue;
                     }
                 }
@@ -306,6 +306,13 @@ INIT_SECTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
         NULL,
         NULL
     },
+    {
+        L"Session Manager\\Memory Management",
+        L"ReadAheadMaximum",
+        &CcMaximumReadAheadLength,
+        NULL,
+        NULL
+    },
     {
         L"Session Manager\\Memory Management",
         L"LargeSystemCache",
@@ -481,6 +488,13 @@ INIT_SECTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
         NULL,
         NULL
     },
+    {
+        L"Session Manager\\Memory Management\\PrefetchParameters",
+        L"EnablePrefetcher",
+        &CcPfEnablePrefetcherParameter,
+        NULL,
+        NULL
+    },
     {
         L"Session Manager\\Executive",
         L"AdditionalCriticalWorkerThreads",
@@ -495,6 +509,13 @@ INIT_SECTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
         NULL,
         NULL
     },
+    {
+        L"Session Manager\\Executive",
+        L"DisableWorkerPool",
+        &ExpWorkPoolDisabled,
+        NULL,
+        NULL
+    },
     {
         L"Session Manager\\Executive",
         L"PriorityQuantumMatrix",
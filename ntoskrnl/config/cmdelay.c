@@ -16,7 +16,18 @@
 
 WORK_QUEUE_ITEM CmpDelayDerefKCBWorkItem;
 
+/*
+ * CmpDelayedCloseSize is what KCBs that aren't waiting to be closed have as
+ * their index. How many of them are kept around is CmpDelayedCloseLimit,
+ * which follows how often they get reopened before they're closed for real.
+ */
+#define CMP_DELAYED_CLOSE_MIN_LIMIT     512
+#define CMP_DELAYED_CLOSE_MAX_LIMIT     16384
+
 ULONG CmpDelayedCloseSize = 2048;
+ULONG CmpDelayedCloseLimit = 2048;
+LONG CmpDelayedCloseHits;
+static ULONG CmpDelayedCloseEvictions;
 ULONG CmpDelayedCloseElements;
 KGUARDED_MUTEX CmpDelayedCloseTableLock;
 BOOLEAN CmpDelayCloseWorkItemActive;
@@ -56,7 +67,7 @@ NTAPI
 CmpDelayCloseWorker(IN PVOID Context)
 {
     PCM_DELAYED_CLOSE_ENTRY ListEntry;
-    ULONG i, ConvKey;
+    ULONG i, ConvKey, Hits;
     PAGED_CODE();
 
     /* Sanity check */
@@ -68,11 +79,32 @@ CmpDelayCloseWorker(IN PVOID Context)
     /* Acquire the delayed close table lock */
     KeAcquireGuardedMutex(&CmpDelayedCloseTableLock);
 
+    /*
+     * Resize from how the last round went: keys reopened while they were
+     * waiting here saved a parse each, the ones we closed for real only
+     * took pool.
+     */
+    Hits = (ULONG)InterlockedExchange(&CmpDelayedCloseHits, 0);
+    if (CmpDelayedCloseEvictions)
+    {
+        if ((Hits > CmpDelayedCloseEvictions) &&
+            (CmpDelayedCloseLimit < CMP_DELAYED_CLOSE_MAX_LIMIT))
+        {
+            CmpDelayedCloseLimit *= 2;
+        }
+        else if ((Hits < CmpDelayedCloseEvictions / 8) &&
+                 (CmpDelayedCloseLimit > CMP_DELAYED_CLOSE_MIN_LIMIT))
+        {
+            CmpDelayedCloseLimit /= 2;
+        }
+    }
+    CmpDelayedCloseEvictions = 0;
+
     /* Iterate */
-    for (i = 0; i < (CmpDelayedCloseSize >> 2); i++)
+    for (i = 0; i < (CmpDelayedCloseLimit >> 2); i++)
     {
         /* Break out of the loop if there is nothing to process */
-        if (CmpDelayedCloseElements <= CmpDelayedCloseSize) break;
+        if (CmpDelayedCloseElements <= CmpDelayedCloseLimit) break;
 
         /* Sanity check */
         ASSERT(!IsListEmpty(&CmpDelayedLRUListHead));
@@ -100,7 +132,7 @@ CmpDelayCloseWorker(IN PVOID Context)
                                       DelayedLRUList);
 
         /* Is the entry we have still the first one? */
-        if (CmpDelayedCloseElements <= CmpDelayedCloseSize)
+        if (CmpDelayedCloseElements <= CmpDelayedCloseLimit)
         {
             /* No, someone already inserted an entry there */
             CmpReleaseKcbLockByKey(ConvKey);
@@ -158,6 +190,7 @@ CmpDelayCloseWorker(IN PVOID Context)
 
             /* Decrement delayed close elements count */
             InterlockedDecrement((PLONG)&CmpDelayedCloseElements);
+            CmpDelayedCloseEvictions++;
         }
 
         /* Release the KCB lock */
@@ -167,7 +200,7 @@ CmpDelayCloseWorker(IN PVOID Context)
         KeAcquireGuardedMutex(&CmpDelayedCloseTableLock);
     }
 
-    if (CmpDelayedCloseElements <= CmpDelayedCloseSize)
+    if (CmpDelayedCloseElements <= CmpDelayedCloseLimit)
     {
         /* We're not active anymore */
         CmpDelayCloseWorkItemActive = FALSE;
@@ -409,7 +442,7 @@ CmpAddToDelayedClose(IN PCM_KEY_CONTROL_BLOCK Kcb,
     InsertHeadList(&CmpDelayedLRUListHead, &Entry->DelayedLRUList);
 
     /* Check if we need to enable anything */
-    if ((CmpDelayedCloseElements > CmpDelayedCloseSize) &&
+    if ((CmpDelayedCloseElements > CmpDelayedCloseLimit) &&
         !(CmpDelayCloseWorkItemActive))
     {
         /* Yes, we have too many elements to close, and no work item */
@@ -18,6 +18,149 @@ ULONG CmpHashTableSize = 2048;
 PCM_KEY_HASH_TABLE_ENTRY CmpCacheTable;
 PCM_NAME_HASH_TABLE_ENTRY CmpNameCacheTable;
 
+/*
+ * The locks stay where they are for good, but the chains behind them grow
+ * once they get longer than CMP_HASH_CHAIN_TARGET on average, up to
+ * CMP_HASH_MAX_GROWTH times the number of locks.
+ */
+#define CMP_HASH_CHAIN_TARGET   4
+#define CMP_HASH_MAX_GROWTH     64
+
+CM_HASH_BUCKETS CmpKeyHashBuckets;
+CM_HASH_BUCKETS CmpNameHashBuckets;
+static WORK_QUEUE_ITEM CmpHashResizeWorkItem;
+static LONG CmpHashResizeActive;
+
+/* The rehash only follows the chains, which look the same for both */
+C_ASSERT(FIELD_OFFSET(CM_KEY_HASH, ConvKey) == FIELD_OFFSET(CM_NAME_HASH, ConvKey));
+C_ASSERT(FIELD_OFFSET(CM_KEY_HASH, NextHash) == FIELD_OFFSET(CM_NAME_HASH, NextHash));
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+ULONG
+CmpGetNewHashSize(IN PCM_HASH_BUCKETS Table)
+{
+    ULONG Size = Table->Size;
+
+    while (((ULONG)Table->Count > Size * CMP_HASH_CHAIN_TARGET) &&
+           (Size < CmpHashTableSize * CMP_HASH_MAX_GROWTH))
+    {
+        Size *= 2;
+    }
+
+    return (Size != Table->Size) ? Size : 0;
+}
+
+static
+PVOID*
+CmpRehashChains(IN PCM_HASH_BUCKETS Table,
+                IN PVOID *NewBuckets,
+                IN ULONG NewSize)
+{
+    PVOID *OldBuckets = Table->Buckets;
+    PCM_KEY_HASH Entry, Next;
+    ULONG i, Index;
+
+    RtlZeroMemory(NewBuckets, NewSize * sizeof(PVOID));
+
+    for (i = 0; i < Table->Size; i++)
+    {
+        for (Entry = OldBuckets[i]; Entry; Entry = Next)
+        {
+            Next = Entry->NextHash;
+            Index = GET_HASH_KEY(Entry->ConvKey) % NewSize;
+            Entry->NextHash = NewBuckets[Index];
+            NewBuckets[Index] = Entry;
+        }
+    }
+
+    Table->Buckets = NewBuckets;
+    Table->Size = NewSize;
+    Table->LongestChain = 0;
+    return OldBuckets;
+}
+
+_Function_class_(WORKER_THREAD_ROUTINE)
+static
+VOID
+NTAPI
+CmpResizeHashTablesWorker(IN PVOID Context)
+{
+    PVOID *KeyBuckets = NULL, *NameBuckets = NULL;
+    ULONG KeySize, NameSize, i;
+    PAGED_CODE();
+
+    /* Allocate outside of the locks, being slightly off doesn't matter */
+    KeySize = CmpGetNewHashSize(&CmpKeyHashBuckets);
+    if (KeySize) KeyBuckets = CmpAllocate(KeySize * sizeof(PVOID), TRUE, TAG_CM);
+    NameSize = CmpGetNewHashSize(&CmpNameHashBuckets);
+    if (NameSize) NameBuckets = CmpAllocate(NameSize * sizeof(PVOID), TRUE, TAG_CM);
+
+    if (KeyBuckets || NameBuckets)
+    {
+        /*
+         * Whoever walks a chain holds its lock, and whoever holds these
+         * locks holds the registry lock too. Take them all, in order, and
+         * NCBs after KCBs like everybody else.
+         */
+        CmpLockRegistryExclusive();
+        for (i = 0; i < CmpHashTableSize; i++) CmpAcquireKcbLockExclusiveByIndex(i);
+        for (i = 0; i < CmpHashTableSize; i++) ExAcquirePushLockExclusive(&CmpNameCacheTable[i].Lock);
+
+        if (KeyBuckets) KeyBuckets = CmpRehashChains(&CmpKeyHashBuckets, KeyBuckets, KeySize);
+        if (NameBuckets) NameBuckets = CmpRehashChains(&CmpNameHashBuckets, NameBuckets, NameSize);
+
+        for (i = CmpHashTableSize; i > 0; i--) ExReleasePushLock(&CmpNameCacheTable[i - 1].Lock);
+        for (i = CmpHashTableSize; i > 0; i--) CmpReleaseKcbLockByIndex(i - 1);
+        CmpUnlockRegistry();
+
+        /* These are the old chains now */
+        if (KeyBuckets) CmpFree(KeyBuckets, 0);
+        if (NameBuckets) CmpFree(NameBuckets, 0);
+
+        DPRINT("Hash tables resized to %lu KCB and %lu NCB chains\n",
+               CmpKeyHashBuckets.Size, CmpNameHashBuckets.Size);
+    }
+
+    InterlockedExchange(&CmpHashResizeActive, 0);
+}
+
+static
+VOID
+CmpCheckHashChains(IN PCM_HASH_BUCKETS Table,
+                   IN ULONG ChainLength)
+{
+    /* Racy, but only for the statistics */
+    if (ChainLength > Table->LongestChain) Table->LongestChain = ChainLength;
+
+    /* Grow the table when the chains get too long on average */
+    if (((ULONG)Table->Count > Table->Size * CMP_HASH_CHAIN_TARGET) &&
+        (Table->Size < CmpHashTableSize * CMP_HASH_MAX_GROWTH) &&
+        !InterlockedCompareExchange(&CmpHashResizeActive, 1, 0))
+    {
+        ExQueueWorkItem(&CmpHashResizeWorkItem, DelayedWorkQueue);
+    }
+}
+
+static
+VOID
+CmpAllocateHashChains(IN PCM_HASH_BUCKETS Table,
+                      IN ULONG BugCheckCode)
+{
+    Table->Size = CmpHashTableSize;
+    Table->Count = 0;
+    Table->LongestChain = 0;
+    Table->Buckets = CmpAllocate(Table->Size * sizeof(PVOID), TRUE, TAG_CM);
+    if (!Table->Buckets)
+    {
+        /* Take the system down */
+        KeBugCheckEx(CONFIG_INITIALIZATION_FAILED, 3, BugCheckCode, 0, 0);
+    }
+
+    RtlZeroMemory(Table->Buckets, Table->Size * sizeof(PVOID));
+}
+
 /* FUNCTIONS *****************************************************************/
 
 INIT_FUNCTION
@@ -69,6 +212,11 @@ CmpInitializeCache(VOID)
         ExInitializePushLock(&CmpNameCacheTable[i].Lock);
     }
 
+    /* Allocate the chains behind the locks */
+    CmpAllocateHashChains(&CmpKeyHashBuckets, 2);
+    CmpAllocateHashChains(&CmpNameHashBuckets, 4);
+    ExInitializeWorkItem(&CmpHashResizeWorkItem, CmpResizeHashTablesWorker, NULL);
+
     /* Setup the delayed close table */
     CmpInitializeDelayedCloseTable();
 }
@@ -82,7 +230,7 @@ CmpRemoveKeyHash(IN PCM_KEY_HASH KeyHash)
     ASSERT_VALID_HASH(KeyHash);
 
     /* Lookup all the keys in this index entry */
-    Prev = &GET_HASH_ENTRY(CmpCacheTable, KeyHash->ConvKey)->Entry;
+    Prev = GET_HASH_CHAIN(PCM_KEY_HASH, CmpKeyHashBuckets, KeyHash->ConvKey);
     while (TRUE)
     {
         /* Save the current one and make sure it's valid */
@@ -96,6 +244,7 @@ CmpRemoveKeyHash(IN PCM_KEY_HASH KeyHash)
             /* Then write the previous one */
             *Prev = Current->NextHash;
             if (*Prev) ASSERT_VALID_HASH(*Prev);
+            InterlockedDecrement(&CmpKeyHashBuckets.Count);
             break;
         }
 
@@ -109,18 +258,18 @@ NTAPI
 CmpInsertKeyHash(IN PCM_KEY_HASH KeyHash,
                  IN BOOLEAN IsFake)
 {
-    ULONG i;
-    PCM_KEY_HASH Entry;
+    ULONG ChainLength = 0;
+    PCM_KEY_HASH Entry, *Head;
     ASSERT_VALID_HASH(KeyHash);
 
-    /* Get the hash index */
-    i = GET_HASH_INDEX(KeyHash->ConvKey);
+    /* Get the hash chain */
+    Head = GET_HASH_CHAIN(PCM_KEY_HASH, CmpKeyHashBuckets, KeyHash->ConvKey);
 
     /* If this is a fake key, increase the key cell to use the parent data */
     if (IsFake) KeyHash->KeyCell++;
 
     /* Loop the hash table */
-    Entry = CmpCacheTable[i].Entry;
+    Entry = *Head;
     while (Entry)
     {
         /* Check if this matches */
@@ -135,11 +284,14 @@ CmpInsertKeyHash(IN PCM_KEY_HASH KeyHash,
 
         /* Keep looping */
         Entry = Entry->NextHash;
+        ChainLength++;
     }
 
     /* No entry found, add this one and return NULL since none existed */
-    KeyHash->NextHash = CmpCacheTable[i].Entry;
-    CmpCacheTable[i].Entry = KeyHash;
+    KeyHash->NextHash = *Head;
+    *Head = KeyHash;
+    InterlockedIncrement(&CmpKeyHashBuckets.Count);
+    CmpCheckHashChains(&CmpKeyHashBuckets, ChainLength + 1);
     return NULL;
 }
 
@@ -152,8 +304,8 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
     PWCHAR p, pp;
     ULONG i;
     BOOLEAN IsCompressed = TRUE, Found = FALSE;
-    PCM_NAME_HASH HashEntry;
-    ULONG NcbSize;
+    PCM_NAME_HASH HashEntry, *Head;
+    ULONG NcbSize, ChainLength = 0;
     USHORT Length;
 
     /* Loop the name */
@@ -189,7 +341,8 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
     CmpAcquireNcbLockExclusiveByKey(ConvKey);
 
     /* Get the hash entry */
-    HashEntry = GET_HASH_ENTRY(CmpNameCacheTable, ConvKey)->Entry;
+    Head = GET_HASH_CHAIN(PCM_NAME_HASH, CmpNameHashBuckets, ConvKey);
+    HashEntry = *Head;
     while (HashEntry)
     {
         /* Get the current NCB */
@@ -244,6 +397,7 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
 
         /* Go to the next hash */
         HashEntry = HashEntry->NextHash;
+        ChainLength++;
     }
 
     /* Check if we didn't find it */
@@ -290,8 +444,10 @@ CmpGetNameControlBlock(IN PUNICODE_STRING NodeName)
 
         /* Insert the name in the hash table */
         HashEntry = &Ncb->NameHash;
-        HashEntry->NextHash = GET_HASH_ENTRY(CmpNameCacheTable, ConvKey)->Entry;
-        GET_HASH_ENTRY(CmpNameCacheTable, ConvKey)->Entry = HashEntry;
+        HashEntry->NextHash = *Head;
+        *Head = HashEntry;
+        InterlockedIncrement(&CmpNameHashBuckets.Count);
+        CmpCheckHashChains(&CmpNameHashBuckets, ChainLength + 1);
     }
 
     /* Release NCB lock */
@@ -327,7 +483,7 @@ CmpDereferenceNameControlBlockWithLock(IN PCM_NAME_CONTROL_BLOCK Ncb)
     if (!(--Ncb->RefCount))
     {
         /* Find the NCB in the table */
-        Next = &GET_HASH_ENTRY(CmpNameCacheTable, Ncb->ConvKey)->Entry;
+        Next = GET_HASH_CHAIN(PCM_NAME_HASH, CmpNameHashBuckets, Ncb->ConvKey);
         while (TRUE)
         {
             /* Check the current entry */
@@ -337,6 +493,7 @@ CmpDereferenceNameControlBlockWithLock(IN PCM_NAME_CONTROL_BLOCK Ncb)
             {
                 /* Unlink it */
                 *Next = Current->NextHash;
+                InterlockedDecrement(&CmpNameHashBuckets.Count);
                 break;
             }
 
@@ -419,7 +576,12 @@ CmpReferenceKeyControlBlock(IN PCM_KEY_CONTROL_BLOCK Kcb)
         }
 
         /* If we're still the last entry, remove us */
-        if (!Kcb->DelayedCloseIndex) CmpRemoveFromDelayedClose(Kcb);
+        if (!Kcb->DelayedCloseIndex)
+        {
+            /* That's one key the delayed close table saved */
+            InterlockedIncrement(&CmpDelayedCloseHits);
+            CmpRemoveFromDelayedClose(Kcb);
+        }
     }
 
     /* Return success */
@@ -517,10 +679,18 @@ NTAPI
 CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
 {
     PCM_KEY_NODE KeyNode;
+    ULONG i;
 
     /* Make sure we have the exclusive lock */
     CMP_ASSERT_KCB_LOCK(Kcb);
 
+    /* Forget the recent lookups, the subkey they found may be gone */
+    InterlockedIncrement(&Kcb->SubKeyCacheGeneration);
+    for (i = 0; i < CM_KCB_SUBKEY_CACHE_SIZE; i++)
+    {
+        Kcb->SubKeyCache[i].Cell = HCELL_NIL;
+    }
+
     /* Check if there's any cached subkey */
     if (Kcb->ExtFlags & (CM_KCB_NO_SUBKEY | CM_KCB_SUBKEY_ONE | CM_KCB_SUBKEY_HINT))
     {
@@ -566,6 +736,49 @@ CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
     }
 }
 
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithCache(IN PCM_KEY_CONTROL_BLOCK Kcb,
+                             IN PCM_KEY_NODE Node,
+                             IN PCUNICODE_STRING SearchName)
+{
+    PHHIVE Hive = Kcb->KeyHive;
+    HCELL_INDEX Cell;
+    ULONG HashKey, i;
+    LONG Generation;
+
+    /* Check what was found under this key lately. Subkeys can share a
+       hash, so the name of the cell is still compared, but that is one
+       cell instead of a walk through the whole index. */
+    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
+    for (i = 0; i < CM_KCB_SUBKEY_CACHE_SIZE; i++)
+    {
+        if (Kcb->SubKeyCache[i].HashKey != HashKey) continue;
+
+        Cell = Kcb->SubKeyCache[i].Cell;
+        if ((Cell != HCELL_NIL) && !CmpDoCompareKeyName(Hive, SearchName, Cell))
+        {
+            return Cell;
+        }
+    }
+
+    /* Do the real lookup */
+    Generation = Kcb->SubKeyCacheGeneration;
+    Cell = CmpFindSubKeyByName(Hive, Node, SearchName);
+    if (Cell == HCELL_NIL) return HCELL_NIL;
+
+    /* Remember it, unless a subkey was deleted in the meantime */
+    if (Generation == Kcb->SubKeyCacheGeneration)
+    {
+        i = (ULONG)InterlockedIncrement(&Kcb->SubKeyCacheNext) % CM_KCB_SUBKEY_CACHE_SIZE;
+        Kcb->SubKeyCache[i].Cell = HCELL_NIL;
+        Kcb->SubKeyCache[i].HashKey = HashKey;
+        Kcb->SubKeyCache[i].Cell = Cell;
+    }
+
+    return Cell;
+}
+
 VOID
 NTAPI
 CmpDereferenceKeyControlBlock(IN PCM_KEY_CONTROL_BLOCK Kcb)
@@ -724,6 +937,13 @@ CmpCreateKeyControlBlock(IN PHHIVE Hive,
     Kcb->ConvKey = ConvKey;
     Kcb->DelayedCloseIndex = CmpDelayedCloseSize;
     Kcb->InDelayClose = 0;
+    Kcb->SubKeyCacheNext = 0;
+    Kcb->SubKeyCacheGeneration = 0;
+    for (i = 0; i < CM_KCB_SUBKEY_CACHE_SIZE; i++)
+    {
+        Kcb->SubKeyCache[i].HashKey = 0;
+        Kcb->SubKeyCache[i].Cell = HCELL_NIL;
+    }
     ASSERT_KCB_VALID(Kcb);
 
     /* Check if we have two hash entires */
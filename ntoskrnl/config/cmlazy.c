@@ -29,13 +29,55 @@ LONG CmpFlushStarveWriters;
 
 /* FUNCTIONS ******************************************************************/
 
+/*
+ * Writers only wait for the dirty blocks to be copied: the log and the
+ * primary file are written from the copy, with the flusher lock released.
+ * The writer lock keeps another flush of the hive from going in between.
+ */
+static
+BOOLEAN
+CmpFlushHiveIncremental(IN PCMHIVE CmHive)
+{
+    PHV_DIRTY_SNAPSHOT Snapshot;
+    BOOLEAN Success;
+
+    CmpLockHiveWriter(CmHive);
+
+    CmpLockHiveFlusherExclusive(CmHive);
+    Success = HvCaptureDirtyBlocks(&CmHive->Hive, &Snapshot);
+    CmpUnlockHiveFlusher(CmHive);
+
+    if (!Success)
+    {
+        /* No memory for a copy, do it the slow way */
+        CmpLockHiveFlusherExclusive(CmHive);
+        Success = HvSyncHive(&CmHive->Hive);
+        CmpUnlockHiveFlusher(CmHive);
+    }
+    else if (Snapshot)
+    {
+        Success = HvWriteDirtyBlocks(&CmHive->Hive, Snapshot);
+        if (!Success)
+        {
+            /* Try again next time */
+            CmpLockHiveFlusherExclusive(CmHive);
+            HvRestoreDirtyBlocks(&CmHive->Hive, Snapshot);
+            CmpUnlockHiveFlusher(CmHive);
+        }
+
+        HvFreeDirtyBlocks(&CmHive->Hive, Snapshot);
+    }
+
+    CmpUnlockHiveWriter(CmHive);
+    return Success;
+}
+
 BOOLEAN
 NTAPI
 CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                    _Out_ PBOOLEAN Error,
                    _Out_ PULONG DirtyCount)
 {
-    NTSTATUS Status;
     PLIST_ENTRY NextEntry;
     PCMHIVE CmHive;
     BOOLEAN Result;
@@ -80,12 +122,11 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                 /* Do the sync */
                 DPRINT("Flushing: %wZ\n", &CmHive->FileFullPath);
                 DPRINT("Handle: %p\n", CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
-                Status = HvSyncHive(&CmHive->Hive);
-                if(!NT_SUCCESS(Status))
+                if (!CmpFlushHiveIncremental(CmHive))
                 {
                     /* Let them know we failed */
-                    DPRINT1("Failed to flush %wZ on handle %p (status 0x%08lx)\n",
-                        &CmHive->FileFullPath,  CmHive->FileHandles[HFILE_TYPE_PRIMARY], Status);
+                    DPRINT1("Failed to flush %wZ on handle %p\n",
+                        &CmHive->FileFullPath, CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
                     *Error = TRUE;
                     Result = FALSE;
                     break;
@@ -226,12 +226,12 @@ CmpDoCreateChild(IN PHHIVE Hive,
     StorageType = Stable;
     if (ParseContext->CreateOptions & REG_OPTION_VOLATILE) StorageType = Volatile;
 
-    /* Allocate the child */
+    /* Allocate the child, close to its parent */
     *KeyCell = HvAllocateCell(Hive,
                               FIELD_OFFSET(CM_KEY_NODE, Name) +
                               CmpNameSize(Hive, Name),
                               StorageType,
-                              HCELL_NIL);
+                              ParentCell);
     if (*KeyCell == HCELL_NIL)
     {
         /* Fail */
@@ -259,7 +259,7 @@ CmpDoCreateChild(IN PHHIVE Hive,
         ClassCell = HvAllocateCell(Hive,
                                    ParseContext->Class.Length,
                                    StorageType,
-                                   HCELL_NIL);
+                                   *KeyCell);
         if (ClassCell == HCELL_NIL)
         {
             /* Fail */
@@ -412,6 +412,9 @@ CmpDoCreate(IN PHHIVE Hive,
     LARGE_INTEGER TimeStamp;
     PCM_KEY_NODE KeyNode;
 
+    /* Don't let the hive be flushed under us */
+    CmpLockHiveFlusherShared((PCMHIVE)Hive);
+
     /* Check if the parent is being deleted */
     if (ParentKcb->Delete)
     {
@@ -544,6 +547,7 @@ CmpDoCreate(IN PHHIVE Hive,
 
 Exit:
     /* Release the flusher lock and return status */
+    CmpUnlockHiveFlusher((PCMHIVE)Hive);
     return Status;
 }
 
@@ -1171,7 +1175,8 @@ CmpParseKey(IN PVOID ParseObject,
             if (!(Kcb->Flags & KEY_SYM_LINK))
             {
                 /* Find the subkey */
-                NextCell = CmpFindSubKeyByName(Hive, Node, &NextName);
+                ASSERT((Kcb->KeyHive == Hive) && (Kcb->KeyCell == Cell));
+                NextCell = CmpFindSubKeyByNameWithCache(Kcb, Node, &NextName);
                 if (NextCell != HCELL_NIL)
                 {
                     /* Get the new node */
@@ -1972,6 +1972,31 @@ CmpUnlockHiveFlusher(IN PCMHIVE Hive)
     ExReleaseResourceLite(Hive->FlusherLock);
 }
 
+/*
+ * The writer lock keeps the flushes of a hive in order. Unlike the flusher
+ * lock, it's held while the files are written, so it must be taken first.
+ */
+VOID
+NTAPI
+CmpLockHiveWriter(IN PCMHIVE Hive)
+{
+    /* Lock the writer. We should already be in a critical section */
+    CMP_ASSERT_REGISTRY_LOCK_OR_LOADING(Hive);
+    ASSERT(Hive->WriterLockOwner != KeGetCurrentThread());
+    ExAcquirePushLockExclusive(&Hive->WriterLock);
+    Hive->WriterLockOwner = KeGetCurrentThread();
+}
+
+VOID
+NTAPI
+CmpUnlockHiveWriter(IN PCMHIVE Hive)
+{
+    /* Release the lock */
+    ASSERT(Hive->WriterLockOwner == KeGetCurrentThread());
+    Hive->WriterLockOwner = NULL;
+    ExReleasePushLock(&Hive->WriterLock);
+}
+
 BOOLEAN
 NTAPI
 CmpTestHiveFlusherLockShared(IN PCMHIVE Hive)
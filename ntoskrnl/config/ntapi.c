@@ -1480,8 +1480,156 @@ NtQueryMultipleValueKey(IN HANDLE KeyHandle,
                         IN OUT PULONG Length,
                         OUT PULONG ReturnLength)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    NTSTATUS Status;
+    KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
+    PCM_KEY_BODY KeyObject;
+    REG_QUERY_MULTIPLE_VALUE_KEY_INFORMATION QueryMultipleValueKeyInfo;
+    REG_POST_OPERATION_INFORMATION PostOperationInfo;
+    PKEY_VALUE_ENTRY Entries = NULL;
+    PUNICODE_STRING Names;
+    ULONG BufferLength = 0, RequiredLength = 0, Captured = 0, i;
+
+    PAGED_CODE();
+
+    DPRINT("NtQueryMultipleValueKey() KH 0x%p, Count %lu\n", KeyHandle, NumberOfValues);
+
+    /* We need an entry and a captured name for every value */
+    if ((NumberOfValues == 0) ||
+        (NumberOfValues > MAXULONG / (sizeof(KEY_VALUE_ENTRY) + sizeof(UNICODE_STRING))))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Verify that the handle is valid and is a registry key */
+    Status = ObReferenceObjectByHandle(KeyHandle,
+                                       KEY_QUERY_VALUE,
+                                       CmpKeyObjectType,
+                                       PreviousMode,
+                                       (PVOID*)&KeyObject,
+                                       NULL);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Entries = ExAllocatePoolWithTag(PagedPool,
+                                    NumberOfValues * (sizeof(KEY_VALUE_ENTRY) + sizeof(UNICODE_STRING)),
+                                    TAG_CM);
+    if (!Entries)
+    {
+        ObDereferenceObject(KeyObject);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    Names = (PUNICODE_STRING)&Entries[NumberOfValues];
+
+    /* Capture the entries and the lengths */
+    _SEH2_TRY
+    {
+        if (PreviousMode != KernelMode)
+        {
+            ProbeForWrite(ValueList,
+                          NumberOfValues * sizeof(KEY_VALUE_ENTRY),
+                          sizeof(ULONG));
+            ProbeForWriteUlong(Length);
+            if (ReturnLength) ProbeForWriteUlong(ReturnLength);
+        }
+
+        BufferLength = *Length;
+        if (PreviousMode != KernelMode) ProbeForWrite(Buffer, BufferLength, sizeof(UCHAR));
+
+        RtlCopyMemory(Entries, ValueList, NumberOfValues * sizeof(KEY_VALUE_ENTRY));
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = _SEH2_GetExceptionCode();
+    }
+    _SEH2_END;
+    if (!NT_SUCCESS(Status))
+        goto Quit;
+
+    /* Capture the names, they are all looked up under the KCB lock */
+    for (i = 0; i < NumberOfValues; i++)
+    {
+        Status = ProbeAndCaptureUnicodeString(&Names[i], PreviousMode, Entries[i].ValueName);
+        if (!NT_SUCCESS(Status))
+            goto Quit;
+        Captured++;
+
+        /* Make sure the name is aligned properly */
+        if ((Names[i].Length & (sizeof(WCHAR) - 1)))
+        {
+            /* It isn't, so we'll fail */
+            Status = STATUS_INVALID_PARAMETER;
+            goto Quit;
+        }
+
+        /* Ignore any null characters at the end */
+        while ((Names[i].Length) &&
+               !(Names[i].Buffer[Names[i].Length / sizeof(WCHAR) - 1]))
+        {
+            /* Skip it */
+            Names[i].Length -= sizeof(WCHAR);
+        }
+
+        Entries[i].ValueName = &Names[i];
+    }
+
+    /* Setup the callback */
+    PostOperationInfo.Object = (PVOID)KeyObject;
+    QueryMultipleValueKeyInfo.Object = (PVOID)KeyObject;
+    QueryMultipleValueKeyInfo.ValueEntries = Entries;
+    QueryMultipleValueKeyInfo.EntryCount = NumberOfValues;
+    QueryMultipleValueKeyInfo.ValueBuffer = Buffer;
+    QueryMultipleValueKeyInfo.BufferLength = &BufferLength;
+    QueryMultipleValueKeyInfo.RequiredBufferLength = &RequiredLength;
+
+    /* Do the callback */
+    Status = CmiCallRegisteredCallbacks(RegNtPreQueryMultipleValueKey, &QueryMultipleValueKeyInfo);
+    if (NT_SUCCESS(Status))
+    {
+        /* Call the internal API */
+        Status = CmQueryMultipleValueKey(KeyObject->KeyControlBlock,
+                                         Entries,
+                                         NumberOfValues,
+                                         Buffer,
+                                         &BufferLength,
+                                         &RequiredLength);
+
+        /* Do the post callback */
+        PostOperationInfo.Status = Status;
+        CmiCallRegisteredCallbacks(RegNtPostQueryMultipleValueKey, &PostOperationInfo);
+    }
+
+    /* Return the results, but never the captured names */
+    if (NT_SUCCESS(Status) || (Status == STATUS_BUFFER_OVERFLOW))
+    {
+        _SEH2_TRY
+        {
+            for (i = 0; i < NumberOfValues; i++)
+            {
+                ValueList[i].DataLength = Entries[i].DataLength;
+                ValueList[i].DataOffset = Entries[i].DataOffset;
+                ValueList[i].Type = Entries[i].Type;
+            }
+
+            *Length = BufferLength;
+            if (ReturnLength) *ReturnLength = RequiredLength;
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = _SEH2_GetExceptionCode();
+        }
+        _SEH2_END;
+    }
+
+Quit:
+    for (i = 0; i < Captured; i++)
+    {
+        ReleaseCapturedUnicodeString(&Names[i], PreviousMode);
+    }
+    ExFreePoolWithTag(Entries, TAG_CM);
+
+    /* Dereference and return status */
+    ObDereferenceObject(KeyObject);
+    return Status;
 }
 
 NTSTATUS
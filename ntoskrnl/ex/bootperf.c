@@ -0,0 +1,410 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/ex/bootperf.c
+ * PURPOSE:         Boot performance timeline
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ******************************************************************/
+
+#define EXP_BOOTPERF_MAX_ENTRIES    1024
+#define TAG_BOOTPERF                'fPtB'
+
+typedef struct _EXP_BOOTPERF_ENTRY
+{
+    ULONGLONG StartTime;
+    ULONGLONG EndTime;
+    ULONG Type;
+    WCHAR Name[BOOTPERF_NAME_LENGTH];
+} EXP_BOOTPERF_ENTRY, *PEXP_BOOTPERF_ENTRY;
+
+static const PCSTR ExpBootPerfTypeNames[BootPerfMaximum] =
+{
+    "Checkpoint",
+    "Loader",
+    "Phase",
+    "DriverEntry",
+    "AddDevice",
+    "Process",
+    "Service"
+};
+
+BOOLEAN ExpBootPerfEnabled;
+static PEXP_BOOTPERF_ENTRY ExpBootPerfEntries;
+static ULONG ExpBootPerfCount;
+static ULONG ExpBootPerfDropped;
+static KGUARDED_MUTEX ExpBootPerfLock;
+
+/* Timestamp/performance counter pair taken once the HAL is up, to find the
+ * timestamp frequency when the timeline is written */
+static ULONGLONG ExpBootPerfCalibrationTime;
+static LARGE_INTEGER ExpBootPerfCalibrationCounter;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+/* Scales without overflowing for any realistic boot duration */
+static
+ULONGLONG
+ExpBootPerfScale(
+    IN ULONGLONG Value,
+    IN ULONGLONG Multiplier,
+    IN ULONGLONG Divisor)
+{
+    return (Value / Divisor) * Multiplier +
+           ((Value % Divisor) * Multiplier) / Divisor;
+}
+
+/* Keeps the tail of long names, that is where driver and service names
+ * differ */
+static
+VOID
+ExpBootPerfCopyName(
+    OUT PWCHAR Destination,
+    IN PCUNICODE_STRING Name)
+{
+    USHORT Length = Name->Length / sizeof(WCHAR);
+    PCWSTR Source = Name->Buffer;
+
+    if (Length >= BOOTPERF_NAME_LENGTH)
+    {
+        Source += Length - (BOOTPERF_NAME_LENGTH - 1);
+        Length = BOOTPERF_NAME_LENGTH - 1;
+    }
+
+    RtlCopyMemory(Destination, Source, Length * sizeof(WCHAR));
+    Destination[Length] = UNICODE_NULL;
+}
+
+static
+PEXP_BOOTPERF_ENTRY
+ExpBootPerfAllocateEntry(VOID)
+{
+    if (ExpBootPerfCount >= EXP_BOOTPERF_MAX_ENTRIES)
+    {
+        ExpBootPerfDropped++;
+        return NULL;
+    }
+
+    return &ExpBootPerfEntries[ExpBootPerfCount++];
+}
+
+static
+NTSTATUS
+ExpBootPerfWriteLine(
+    IN HANDLE FileHandle,
+    IN PCSTR Format,
+    ...)
+{
+    IO_STATUS_BLOCK IoStatusBlock;
+    CHAR Buffer[192];
+    size_t Remaining;
+    va_list Arguments;
+    NTSTATUS Status;
+
+    va_start(Arguments, Format);
+    Status = RtlStringCbVPrintfExA(Buffer,
+                                   sizeof(Buffer),
+                                   NULL,
+                                   &Remaining,
+                                   0,
+                                   Format,
+                                   Arguments);
+    va_end(Arguments);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    return ZwWriteFile(FileHandle,
+                       NULL,
+                       NULL,
+                       NULL,
+                       &IoStatusBlock,
+                       Buffer,
+                       (ULONG)(sizeof(Buffer) - Remaining),
+                       NULL,
+                       NULL);
+}
+
+/*
+ * Writes the timeline as CSV, one event per line. Times are milliseconds
+ * since the loader started, or since the kernel started if the loader did
+ * not pass its timestamps. Open intervals have an empty duration.
+ */
+static
+VOID
+ExpBootPerfSave(
+    IN PEXP_BOOTPERF_ENTRY Entries,
+    IN ULONG Count)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    UNICODE_STRING FileName = RTL_CONSTANT_STRING(L"\\SystemRoot\\bootperf.csv");
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Counter, CounterFrequency;
+    ULONGLONG Frequency, Elapsed, Origin;
+    ULONGLONG Start, Duration;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+    ULONG i;
+
+    /* Find out how fast the timestamps ticked */
+    Counter = KeQueryPerformanceCounter(&CounterFrequency);
+    Elapsed = ExpBootPerfScale(Counter.QuadPart - ExpBootPerfCalibrationCounter.QuadPart,
+                               1000000,
+                               CounterFrequency.QuadPart);
+    if (!Elapsed)
+    {
+        DPRINT1("Boot timeline too short to calibrate\n");
+        return;
+    }
+    Frequency = ExpBootPerfScale(ExpBootPerfTimeStamp() - ExpBootPerfCalibrationTime,
+                                 1000000,
+                                 Elapsed);
+
+    /* The earliest event is time zero */
+    Origin = Entries[0].StartTime;
+    for (i = 1; i < Count; i++)
+    {
+        if (Entries[i].StartTime < Origin) Origin = Entries[i].StartTime;
+    }
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &FileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    Status = ZwCreateFile(&FileHandle,
+                          FILE_GENERIC_WRITE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          0,
+                          FILE_OVERWRITE_IF,
+                          FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                          NULL,
+                          0);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to create the boot timeline (Status 0x%lx)\n", Status);
+        return;
+    }
+
+    Status = ExpBootPerfWriteLine(FileHandle, "start_ms,duration_ms,type,name\r\n");
+    for (i = 0; i < Count && NT_SUCCESS(Status); i++)
+    {
+        Start = ExpBootPerfScale(Entries[i].StartTime - Origin, 1000000, Frequency);
+
+        if (Entries[i].EndTime >= Entries[i].StartTime)
+        {
+            Duration = ExpBootPerfScale(Entries[i].EndTime - Entries[i].StartTime,
+                                        1000000,
+                                        Frequency);
+            Status = ExpBootPerfWriteLine(FileHandle,
+                                          "%I64u.%03I64u,%I64u.%03I64u,%s,\"%ws\"\r\n",
+                                          Start / 1000, Start % 1000,
+                                          Duration / 1000, Duration % 1000,
+                                          ExpBootPerfTypeNames[Entries[i].Type],
+                                          Entries[i].Name);
+        }
+        else
+        {
+            Status = ExpBootPerfWriteLine(FileHandle,
+                                          "%I64u.%03I64u,,%s,\"%ws\"\r\n",
+                                          Start / 1000, Start % 1000,
+                                          ExpBootPerfTypeNames[Entries[i].Type],
+                                          Entries[i].Name);
+        }
+    }
+
+    ZwClose(FileHandle);
+
+    if (!NT_SUCCESS(Status))
+        DPRINT1("Failed to write the boot timeline (Status 0x%lx)\n", Status);
+    else
+        DPRINT1("Boot timeline written, %lu events (%lu dropped)\n", Count, ExpBootPerfDropped);
+}
+
+/* PUBLIC FUNCTIONS **********************************************************/
+
+INIT_FUNCTION
+VOID
+NTAPI
+ExpBootPerfInitialize(IN PLOADER_PARAMETER_BLOCK LoaderBlock,
+                      IN ULONGLONG KernelStartTime)
+{
+    PLOADER_PERFORMANCE_DATA LoaderData = NULL;
+    UNICODE_STRING Name;
+
+    /* Only when asked for, the command line was upcased already */
+    if (!LoaderBlock->LoadOptions || !strstr(LoaderBlock->LoadOptions, "BOOTPERF"))
+        return;
+
+    ExpBootPerfEntries = ExAllocatePoolWithTag(NonPagedPool,
+                                               EXP_BOOTPERF_MAX_ENTRIES *
+                                               sizeof(EXP_BOOTPERF_ENTRY),
+                                               TAG_BOOTPERF);
+    if (!ExpBootPerfEntries)
+    {
+        DPRINT1("No memory for the boot timeline\n");
+        return;
+    }
+
+    KeInitializeGuardedMutex(&ExpBootPerfLock);
+    ExpBootPerfCalibrationTime = ExpBootPerfTimeStamp();
+    ExpBootPerfCalibrationCounter = KeQueryPerformanceCounter(NULL);
+    if (!KernelStartTime) KernelStartTime = ExpBootPerfCalibrationTime;
+
+    /* Pick up the loader timestamps, they use the same clock as we do */
+    if (LoaderBlock->Extension &&
+        LoaderBlock->Extension->Size >= RTL_SIZEOF_THROUGH_FIELD(LOADER_PARAMETER_EXTENSION,
+                                                                 LoaderPerformanceData))
+    {
+        LoaderData = LoaderBlock->Extension->LoaderPerformanceData;
+    }
+
+    ExpBootPerfEnabled = TRUE;
+
+    if (LoaderData &&
+        LoaderData->StartTime &&
+        LoaderData->EndTime >= LoaderData->StartTime &&
+        KernelStartTime >= LoaderData->EndTime)
+    {
+        RtlInitUnicodeString(&Name, L"FreeLdr");
+        ExpBootPerfRecord(BootPerfLoader, &Name, LoaderData->StartTime, LoaderData->EndTime);
+    }
+
+    /* Closed at the end of ExpInitializeExecutive */
+    RtlInitUnicodeString(&Name, L"Phase0");
+    ExpBootPerfRecord(BootPerfPhase, &Name, KernelStartTime, 0);
+}
+
+/*
+ * Adds an event. Checkpoints have EndTime == StartTime, intervals that are
+ * still open have an EndTime of zero.
+ */
+VOID
+NTAPI
+ExpBootPerfRecord(IN ULONG Type,
+                  IN PCUNICODE_STRING Name,
+                  IN ULONGLONG StartTime,
+                  IN ULONGLONG EndTime)
+{
+    PEXP_BOOTPERF_ENTRY Entry;
+
+    if (!ExpBootPerfEnabled) return;
+    ASSERT(Type < BootPerfMaximum);
+
+    KeAcquireGuardedMutex(&ExpBootPerfLock);
+    if (ExpBootPerfEnabled)
+    {
+        Entry = ExpBootPerfAllocateEntry();
+        if (Entry)
+        {
+            Entry->StartTime = StartTime;
+            Entry->EndTime = EndTime;
+            Entry->Type = Type;
+            ExpBootPerfCopyName(Entry->Name, Name);
+        }
+    }
+    KeReleaseGuardedMutex(&ExpBootPerfLock);
+}
+
+/*
+ * Timestamps an event now. BOOTPERF_MARK_END closes the newest open interval
+ * with the same type and name, BOOTPERF_MARK_COMPLETE writes the timeline.
+ */
+VOID
+NTAPI
+ExpBootPerfMark(IN ULONG Type,
+                IN ULONG Flags,
+                IN PCWSTR Name)
+{
+    ULONGLONG TimeStamp = ExpBootPerfTimeStamp();
+    PEXP_BOOTPERF_ENTRY Entry, Entries = NULL;
+    WCHAR Buffer[BOOTPERF_NAME_LENGTH];
+    UNICODE_STRING NameString;
+    ULONG Count = 0;
+    LONG i;
+
+    if (!ExpBootPerfEnabled) return;
+    ASSERT(Type < BootPerfMaximum);
+
+    RtlInitUnicodeString(&NameString, Name);
+    ExpBootPerfCopyName(Buffer, &NameString);
+
+    KeAcquireGuardedMutex(&ExpBootPerfLock);
+    if (!ExpBootPerfEnabled)
+    {
+        KeReleaseGuardedMutex(&ExpBootPerfLock);
+        return;
+    }
+
+    if (Flags & BOOTPERF_MARK_END)
+    {
+        for (i = ExpBootPerfCount - 1; i >= 0; i--)
+        {
+            Entry = &ExpBootPerfEntries[i];
+            if (Entry->Type == Type &&
+                Entry->EndTime == 0 &&
+                !_wcsicmp(Entry->Name, Buffer))
+            {
+                Entry->EndTime = TimeStamp;
+                break;
+            }
+        }
+    }
+    else
+    {
+        Entry = ExpBootPerfAllocateEntry();
+        if (Entry)
+        {
+            Entry->StartTime = TimeStamp;
+            Entry->EndTime = (Flags & BOOTPERF_MARK_BEGIN) ? 0 : TimeStamp;
+            Entry->Type = Type;
+            RtlCopyMemory(Entry->Name, Buffer, sizeof(Buffer));
+        }
+    }
+
+    if (Flags & BOOTPERF_MARK_COMPLETE)
+    {
+        /* Stop recording and take the buffer */
+        ExpBootPerfEnabled = FALSE;
+        Entries = ExpBootPerfEntries;
+        Count = ExpBootPerfCount;
+        ExpBootPerfEntries = NULL;
+        ExpBootPerfCount = 0;
+    }
+    KeReleaseGuardedMutex(&ExpBootPerfLock);
+
+    if (Entries)
+    {
+        if (Count) ExpBootPerfSave(Entries, Count);
+        ExFreePoolWithTag(Entries, TAG_BOOTPERF);
+    }
+}
+
+VOID
+NTAPI
+ExpBootPerfRecordProcess(IN PEPROCESS Process)
+{
+    ULONGLONG TimeStamp = ExpBootPerfTimeStamp();
+    WCHAR Buffer[sizeof(Process->ImageFileName) + 1];
+    UNICODE_STRING Name;
+    ULONG i;
+
+    if (!ExpBootPerfEnabled) return;
+
+    /* Image names are plain ASCII, widen them by hand */
+    for (i = 0; i < sizeof(Process->ImageFileName) && Process->ImageFileName[i]; i++)
+        Buffer[i] = Process->ImageFileName[i];
+    Buffer[i] = UNICODE_NULL;
+
+    RtlInitUnicodeString(&Name, Buffer);
+    ExpBootPerfRecord(BootPerfProcess, &Name, TimeStamp, TimeStamp);
+}
+
+/* EOF */
@@ -20,6 +20,36 @@ EX_PUSH_LOCK HandleTableListLock;
 #define SizeOfHandle(x) (sizeof(HANDLE) * (x))
 #define INDEX_TO_HANDLE_VALUE(x) ((x) << HANDLE_TAG_BITS)
 
+//
+// Per-processor caches of free handles. The HANDLE_TABLE layout is fixed, so
+// they live right after it in the same allocation. Each cache is a chain of
+// free entries linked through NextFreeTableEntry, like FirstFree, along with
+// its depth; both are updated together with one 64-bit compare-exchange.
+//
+#define HANDLE_FREE_CACHES          8
+#define HANDLE_FREE_CACHE_DEPTH     32
+
+typedef union _HANDLE_FREE_CACHE
+{
+    struct
+    {
+        ULONG FirstFree;
+        ULONG Depth;
+    };
+    LONGLONG Value;
+    UCHAR Padding[64];
+} HANDLE_FREE_CACHE, *PHANDLE_FREE_CACHE;
+
+typedef struct _HANDLE_TABLE_WITH_CACHES
+{
+    HANDLE_TABLE Table;
+    HANDLE_FREE_CACHE FreeCache[HANDLE_FREE_CACHES];
+} HANDLE_TABLE_WITH_CACHES, *PHANDLE_TABLE_WITH_CACHES;
+
+#define ExpGetHandleFreeCache(t) \
+    (&CONTAINING_RECORD((t), HANDLE_TABLE_WITH_CACHES, Table)-> \
+        FreeCache[KeGetCurrentProcessorNumber() % HANDLE_FREE_CACHES])
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 INIT_FUNCTION
@@ -45,14 +75,20 @@ ExpLookupHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     /* Clear the tag bits */
     Handle.TagBits = 0;
 
+    /*
+     * No lock is needed here: new levels are fully linked before being
+     * published with InterlockedExchangePointer, NextHandleNeedingPool is only
+     * raised after that, and no level is freed before the table itself.
+     */
+
     /* Check if the handle is in the allocated range */
-    if (Handle.Value >= HandleTable->NextHandleNeedingPool)
+    if (Handle.Value >= *(volatile ULONG*)&HandleTable->NextHandleNeedingPool)
     {
         return NULL;
     }
 
     /* Get the table code */
-    TableBase = HandleTable->TableCode;
+    TableBase = *(volatile ULONG_PTR*)&HandleTable->TableCode;
 
     /* Extract the table level and actual table base */
     TableLevel = (ULONG)(TableBase & 3);
@@ -67,14 +103,14 @@ ExpLookupHandleTableEntry(IN PHANDLE_TABLE HandleTable,
         case 2:
 
             /* Get the mid level pointer array */
-            PointerArray = PointerArray[Handle.HighIndex];
+            PointerArray = ((PVOID volatile *)PointerArray)[Handle.HighIndex];
             ASSERT(PointerArray != NULL);
 
             /* Fall through */
         case 1:
 
             /* Get the handle array */
-            HandleArray = PointerArray[Handle.MidIndex];
+            HandleArray = ((PVOID volatile *)PointerArray)[Handle.MidIndex];
             ASSERT(HandleArray != NULL);
 
             /* Fall through */
@@ -252,6 +288,98 @@ ExpFreeHandleTable(IN PHANDLE_TABLE HandleTable)
     }
 }
 
+static
+BOOLEAN
+ExpPushCachedHandle(IN PHANDLE_TABLE HandleTable,
+                    IN EXHANDLE Handle,
+                    IN PHANDLE_TABLE_ENTRY HandleTableEntry)
+{
+    PHANDLE_FREE_CACHE Cache = ExpGetHandleFreeCache(HandleTable);
+    HANDLE_FREE_CACHE OldCache, NewCache;
+
+    /* Start value change loop */
+    for (;;)
+    {
+        /* Give up if this processor's cache is already full */
+        OldCache.Value = *(volatile LONGLONG*)&Cache->Value;
+        if (OldCache.Depth >= HANDLE_FREE_CACHE_DEPTH) return FALSE;
+
+        /* Link the entry in front of the cached ones */
+        HandleTableEntry->NextFreeTableEntry = OldCache.FirstFree;
+        NewCache.FirstFree = Handle.AsULONG;
+        NewCache.Depth = OldCache.Depth + 1;
+        if (InterlockedCompareExchange64(&Cache->Value,
+                                         NewCache.Value,
+                                         OldCache.Value) == OldCache.Value)
+        {
+            /* Done */
+            return TRUE;
+        }
+    }
+}
+
+static
+BOOLEAN
+ExpPopCachedHandle(IN PHANDLE_TABLE HandleTable,
+                   OUT PEXHANDLE Handle,
+                   OUT PHANDLE_TABLE_ENTRY *HandleTableEntry)
+{
+    PHANDLE_FREE_CACHE Cache = ExpGetHandleFreeCache(HandleTable);
+    HANDLE_FREE_CACHE OldCache, NewCache;
+    PHANDLE_TABLE_ENTRY Entry, Last;
+    EXHANDLE Next;
+    ULONG OldValue;
+
+    /* Quick check, not to write to the cache when there's nothing in it */
+    if (!*(volatile ULONG*)&Cache->FirstFree) return FALSE;
+
+    /*
+     * Take the whole chain. Since nobody else can see it anymore, there's no
+     * ABA problem to worry about while we're walking it, unlike with FirstFree.
+     */
+    OldCache.Value = InterlockedExchange64(&Cache->Value, 0);
+    if (!OldCache.FirstFree) return FALSE;
+
+    /* Keep the first entry */
+    Handle->Value = OldCache.FirstFree;
+    Entry = ExpLookupHandleTableEntry(HandleTable, *Handle);
+    ASSERT(Entry != NULL);
+    *HandleTableEntry = Entry;
+
+    /* Check if there's anything left to give back */
+    NewCache.FirstFree = Entry->NextFreeTableEntry;
+    NewCache.Depth = OldCache.Depth - 1;
+    if (!NewCache.FirstFree) return TRUE;
+
+    /* Put the rest back, if nobody refilled the cache in the meantime */
+    if (!InterlockedCompareExchange64(&Cache->Value, NewCache.Value, 0)) return TRUE;
+
+    /* Somebody did, so find the end of our chain and move it to the free list */
+    Next.Value = NewCache.FirstFree;
+    for (;;)
+    {
+        Last = ExpLookupHandleTableEntry(HandleTable, Next);
+        ASSERT(Last != NULL);
+        if (!Last->NextFreeTableEntry) break;
+        Next.Value = Last->NextFreeTableEntry;
+    }
+
+    /* Start value change loop */
+    for (;;)
+    {
+        /* Get the current value and write */
+        OldValue = HandleTable->LastFree;
+        Last->NextFreeTableEntry = OldValue;
+        if (InterlockedCompareExchange((PLONG)&HandleTable->LastFree,
+                                       NewCache.FirstFree,
+                                       OldValue) == OldValue)
+        {
+            /* Done */
+            return TRUE;
+        }
+    }
+}
+
 VOID
 NTAPI
 ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
@@ -275,6 +403,9 @@ ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     /* Check if we're FIFO */
     if (!HandleTable->StrictFIFO)
     {
+        /* Try to keep the handle on this processor first */
+        if (ExpPushCachedHandle(HandleTable, Handle, HandleTableEntry)) return;
+
         /* Select a lock index */
         LockIndex = Handle.Index % 4;
 
@@ -314,9 +445,9 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
     ULONG i;
     PAGED_CODE();
 
-    /* Allocate the table */
+    /* Allocate the table, along with its free handle caches */
     HandleTable = ExAllocatePoolWithTag(PagedPool,
-                                        sizeof(HANDLE_TABLE),
+                                        sizeof(HANDLE_TABLE_WITH_CACHES),
                                         TAG_OBJECT_TABLE);
     if (!HandleTable) return NULL;
 
@@ -327,7 +458,7 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
     }
 
     /* Clear the table */
-    RtlZeroMemory(HandleTable, sizeof(HANDLE_TABLE));
+    RtlZeroMemory(HandleTable, sizeof(HANDLE_TABLE_WITH_CACHES));
 
     /* Now allocate the first level structures */
     HandleTableTable = ExpAllocateTablePagedPoolNoZero(Process, PAGE_SIZE);
@@ -653,6 +784,16 @@ ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     BOOLEAN Result;
     ULONG i;
 
+    /* Check if this processor has a handle cached for us */
+    if (!(HandleTable->StrictFIFO) &&
+        (ExpPopCachedHandle(HandleTable, &Handle, &Entry)))
+    {
+        /* Increase the number of handles and return it */
+        InterlockedIncrement(&HandleTable->HandleCount);
+        *NewHandle = Handle;
+        return Entry;
+    }
+
     /* Start allocation loop */
     for (;;)
     {
@@ -1039,18 +1180,38 @@ ExDupHandleTable(IN PEPROCESS Process,
                  IN ULONG_PTR Mask)
 {
     PHANDLE_TABLE NewTable;
-    EXHANDLE Handle;
+    EXHANDLE Handle, LastHandle;
     PHANDLE_TABLE_ENTRY HandleTableEntry, NewEntry;
     BOOLEAN Failed = FALSE;
     PAGED_CODE();
 
+    /*
+     * Find the last entry matching the mask. Usually only a few low handles
+     * are inherited, so the copy doesn't need to grow to the parent's size.
+     */
+    LastHandle.Value = 0;
+    Handle.Value = INDEX_TO_HANDLE_VALUE(1);
+    while ((HandleTableEntry = ExpLookupHandleTableEntry(HandleTable, Handle)))
+    {
+        do
+        {
+            /* Free entries have no object, so they never match */
+            if (HandleTableEntry->Value & Mask) LastHandle = Handle;
+
+            Handle.Value += INDEX_TO_HANDLE_VALUE(1);
+            HandleTableEntry++;
+        } while (Handle.Value % INDEX_TO_HANDLE_VALUE(LOW_LEVEL_ENTRIES));
+
+        /* Skip the reserved first entry of the next block */
+        Handle.Value += INDEX_TO_HANDLE_VALUE(1);
+    }
+
     /* Allocate the duplicated copy */
     NewTable = ExpAllocateHandleTable(Process, FALSE);
     if (!NewTable) return NULL;
 
-    /* Loop each entry */
-    while (NewTable->NextHandleNeedingPool <
-           HandleTable->NextHandleNeedingPool)
+    /* Allocate entries up to the last one we copy */
+    while (NewTable->NextHandleNeedingPool <= LastHandle.Value)
     {
         /* Insert it into the duplicated copy */
         if (!ExpAllocateHandleTableEntrySlow(NewTable, FALSE))
@@ -546,8 +546,10 @@ ExpLoadInitialProcess(IN PINIT_BUFFER InitBuffer,
     RtlAppendUnicodeStringToString(&Environment, &NtSystemRoot);
     RtlAppendUnicodeStringToString(&Environment, &NullString);
 
+#ifndef NEWCC
     /* Prepare the prefetcher */
-    //CcPfBeginBootPhase(150);
+    CcPfBeginBootPhase(150);
+#endif
 
     /* Create SMSS process */
     SmssName = ProcessParams->ImagePathName;
@@ -657,6 +659,9 @@ BOOLEAN
 NTAPI
 ExpInitSystemPhase1(VOID)
 {
+    /* Give each processor its own pool lookaside lists */
+    ExpInitPerProcessorPoolLookasideLists();
+
     /* Initialize worker threads */
     ExpInitializeWorkerThreads();
 
@@ -930,6 +935,7 @@ ExpInitializeExecutive(IN ULONG Cpu,
     size_t Remaining = 0;
     PCHAR RcEnd = NULL;
     CHAR VersionBuffer[65];
+    ULONGLONG KernelStartTime = ExpBootPerfEarlyTimeStamp();
 
     /* Validate Loader */
     if (!ExpIsLoaderValid(LoaderBlock))
@@ -1021,6 +1027,12 @@ ExpInitializeExecutive(IN ULONG Cpu,
                 if (PerfMemUsed) ExBurnMemory(LoaderBlock, PerfMemUsed, LoaderBad);
             }
         }
+
+        /* Check if the lock statistics should be collected */
+        if (strstr(CommandLine, "LOCKSTATS")) KiLockStatisticsEnabled = TRUE;
+
+        /* Check if the DPC and ISR durations should be collected */
+        if (strstr(CommandLine, "DPCSTATS")) KiDpcStatisticsEnabled = TRUE;
     }
 
     /* Setup NLS Base and offsets */
@@ -1099,6 +1111,9 @@ ExpInitializeExecutive(IN ULONG Cpu,
     /* Initialize the memory manager at phase 0 */
     if (!MmArmInitSystem(0, LoaderBlock)) KeBugCheck(PHASE0_INITIALIZATION_FAILED);
 
+    /* Start the boot timeline if requested, now that we have pool */
+    ExpBootPerfInitialize(LoaderBlock, KernelStartTime);
+
     /* Load boot symbols */
     ExpLoadBootSymbols(LoaderBlock);
 
@@ -1325,6 +1340,9 @@ ExpInitializeExecutive(IN ULONG Cpu,
     /* Set the machine type */
     SharedUserData->ImageNumberLow = IMAGE_FILE_MACHINE_NATIVE;
     SharedUserData->ImageNumberHigh = IMAGE_FILE_MACHINE_NATIVE;
+
+    /* Phase 0 is done */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"Phase0");
 }
 
 VOID
@@ -1369,6 +1387,7 @@ Phase1InitializationDiscard(IN PVOID Context)
 
     /* Set to phase 1 */
     ExpInitializationPhase = 1;
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"Phase1");
 
     /* Set us at maximum priority */
     KeSetPriorityThread(KeGetCurrentThread(), HIGH_PRIORITY);
@@ -1802,7 +1821,9 @@ Phase1InitializationDiscard(IN PVOID Context)
     InbvSetProgressBarSubset(25, 75);
 
     /* Initialize the I/O Subsystem */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"IoInitSystem");
     if (!IoInitSystem(LoaderBlock)) KeBugCheck(IO1_INITIALIZATION_FAILED);
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"IoInitSystem");
 
     /* Set maximum update to 100% */
     InbvSetProgressBarSubset(0, 100);
@@ -1968,7 +1989,8 @@ Phase1InitializationDiscard(IN PVOID Context)
     /* Allow strings to be displayed */
     InbvEnableDisplayString(TRUE);
 
-    /* Launch initial process */
+    /* Launch initial process, the rest of the boot is timed from user mode */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"Phase1");
     DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
     ProcessInfo = &InitBuffer->ProcessInfo;
     ExpLoadInitialProcess(InitBuffer, &ProcessParameters, &Environment);
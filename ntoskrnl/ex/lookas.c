@@ -14,6 +14,7 @@
 
 #if defined (ALLOC_PRAGMA)
 #pragma alloc_text(INIT, ExpInitLookasideLists)
+#pragma alloc_text(INIT, ExpInitPerProcessorPoolLookasideLists)
 #endif
 
 /* GLOBALS *******************************************************************/
@@ -24,8 +25,18 @@ LIST_ENTRY ExpPagedLookasideListHead;
 KSPIN_LOCK ExpPagedLookasideListLock;
 LIST_ENTRY ExSystemLookasideListHead;
 LIST_ENTRY ExPoolLookasideListHead;
-GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
-GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
+GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+
+/* Lookaside depth adjustment, see ExAdjustLookasideDepth */
+#define LOOKASIDE_MINIMUM_DEPTH             4
+#define LOOKASIDE_MINIMUM_ALLOCATES         75
+#define LOOKASIDE_MISS_RATIO_THRESHOLD      5       /* In 1/1000th */
+#define LOOKASIDE_IDLE_DEPTH_DECREMENT      10
+#define LOOKASIDE_BOOST                     5
+#define POOL_LOOKASIDE_MAXIMUM_DEPTH        256
+#define POOL_LOOKASIDE_PER_CPU_TAG          'lPpP'
+ULONG ExpLookasideScanCount;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
@@ -67,13 +78,13 @@ ExInitPoolLookasidePointers(VOID)
     PGENERAL_LOOKASIDE Entry;
 
     /* Loop for all pool lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
         /* Initialize the non-paged list */
         Entry = &ExpSmallNPagedPoolLookasideLists[i];
         InitializeSListHead(&Entry->ListHead);
 
-        /* Bind to PRCB */
+        /* Bind to PRCB, until per-processor lists are allocated */
         Prcb->PPNPagedLookasideList[i].P = Entry;
         Prcb->PPNPagedLookasideList[i].L = Entry;
 
@@ -103,14 +114,14 @@ ExpInitLookasideLists(VOID)
     KeInitializeSpinLock(&ExpPagedLookasideListLock);
 
     /* Initialize the system lookaside lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
         /* Initialize the non-paged list */
         ExInitializeSystemLookasideList(&ExpSmallNPagedPoolLookasideLists[i],
                                         NonPagedPool,
                                         (i + 1) * 8,
                                         'looP',
-                                        256,
+                                        POOL_LOOKASIDE_MAXIMUM_DEPTH,
                                         &ExPoolLookasideListHead);
 
         /* Initialize the paged list */
@@ -118,13 +129,207 @@ ExpInitLookasideLists(VOID)
                                         PagedPool,
                                         (i + 1) * 8,
                                         'looP',
-                                        256,
+                                        POOL_LOOKASIDE_MAXIMUM_DEPTH,
                                         &ExPoolLookasideListHead);
     }
 }
 
+INIT_FUNCTION
+VOID
+NTAPI
+ExpInitPerProcessorPoolLookasideLists(VOID)
+{
+    CCHAR Cpu;
+    ULONG i;
+    PKPRCB Prcb;
+    PGENERAL_LOOKASIDE Entry;
+
+    /* Now that all the processors are started, give each of them its own
+     * pool lookaside lists, so that small allocations and frees don't
+     * bounce the shared lists (and ExLockPool) between processors.
+     * The shared ones stay as the second level.
+     */
+    for (Cpu = 0; Cpu < KeNumberProcessors; Cpu++)
+    {
+        /* Get the PRCB for this CPU */
+        Prcb = KiProcessorBlock[(int)Cpu];
+
+        /* One block for both the non-paged and the paged lists */
+        Entry = ExAllocatePoolWithTag(NonPagedPool,
+                                      2 * NUMBER_POOL_LOOKASIDE_LISTS * sizeof(GENERAL_LOOKASIDE),
+                                      POOL_LOOKASIDE_PER_CPU_TAG);
+        if (!Entry)
+        {
+            /* Keep using the shared lists only */
+            DPRINT1("Failed to allocate pool lookaside lists for CPU %d\n", Cpu);
+            continue;
+        }
+
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            /* Initialize the non-paged list */
+            ExInitializeSystemLookasideList(Entry,
+                                            NonPagedPool,
+                                            (i + 1) * 8,
+                                            'looP',
+                                            POOL_LOOKASIDE_MAXIMUM_DEPTH,
+                                            &ExPoolLookasideListHead);
+
+            /* Link it */
+            Prcb->PPNPagedLookasideList[i].P = Entry++;
+
+            /* Initialize the paged list */
+            ExInitializeSystemLookasideList(Entry,
+                                            PagedPool,
+                                            (i + 1) * 8,
+                                            'looP',
+                                            POOL_LOOKASIDE_MAXIMUM_DEPTH,
+                                            &ExPoolLookasideListHead);
+
+            /* Link it */
+            Prcb->PPPagedLookasideList[i].P = Entry++;
+        }
+    }
+}
+
+static
+VOID
+ExpComputeLookasideDepth(IN PGENERAL_LOOKASIDE Lookaside,
+                         IN ULONG Misses,
+                         IN ULONG Allocates)
+{
+    ULONG Ratio;
+    LONG Depth;
+
+    Depth = Lookaside->Depth;
+
+    if (Allocates < LOOKASIDE_MINIMUM_ALLOCATES)
+    {
+        /* The list is barely used, let it give its entries back */
+        Depth -= LOOKASIDE_IDLE_DEPTH_DECREMENT;
+    }
+    else
+    {
+        /* Miss ratio, in 1/1000th */
+        Ratio = (ULONG)(((ULONGLONG)Misses * 1000) / Allocates);
+        if (Ratio < LOOKASIDE_MISS_RATIO_THRESHOLD)
+        {
+            /* Deep enough, slowly shrink it */
+            Depth--;
+        }
+        else
+        {
+            /* Grow it in proportion of the misses and of the room left */
+            Depth += (Ratio * (Lookaside->MaximumDepth - Depth)) / (2 * 1000) + LOOKASIDE_BOOST;
+        }
+    }
+
+    /* Stay within bounds */
+    if (Depth > Lookaside->MaximumDepth) Depth = Lookaside->MaximumDepth;
+    if (Depth < LOOKASIDE_MINIMUM_DEPTH) Depth = LOOKASIDE_MINIMUM_DEPTH;
+    Lookaside->Depth = (USHORT)Depth;
+}
+
+static
+VOID
+ExpScanGeneralLookasideList(IN PLIST_ENTRY ListHead,
+                            IN PKSPIN_LOCK Lock OPTIONAL)
+{
+    KIRQL OldIrql = PASSIVE_LEVEL;
+    PLIST_ENTRY ListEntry;
+    PGENERAL_LOOKASIDE Lookaside;
+    ULONG TotalAllocates, AllocateMisses;
+
+    if (Lock) KeAcquireSpinLock(Lock, &OldIrql);
+
+    for (ListEntry = ListHead->Flink;
+         ListEntry != ListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Lookaside = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
+
+        /* These lists count misses, snapshot the counters of the period */
+        TotalAllocates = Lookaside->TotalAllocates;
+        AllocateMisses = Lookaside->AllocateMisses;
+        ExpComputeLookasideDepth(Lookaside,
+                                 AllocateMisses - Lookaside->LastAllocateMisses,
+                                 TotalAllocates - Lookaside->LastTotalAllocates);
+        Lookaside->LastTotalAllocates = TotalAllocates;
+        Lookaside->LastAllocateMisses = AllocateMisses;
+    }
+
+    if (Lock) KeReleaseSpinLock(Lock, OldIrql);
+}
+
+static
+VOID
+ExpScanPoolLookasideList(IN PGENERAL_LOOKASIDE Lookaside)
+{
+    ULONG TotalAllocates, AllocateHits, Allocates;
+
+    /* Pool lists count hits, snapshot the counters of the period */
+    TotalAllocates = Lookaside->TotalAllocates;
+    AllocateHits = Lookaside->AllocateHits;
+    Allocates = TotalAllocates - Lookaside->LastTotalAllocates;
+    ExpComputeLookasideDepth(Lookaside,
+                             Allocates - (AllocateHits - Lookaside->LastAllocateHits),
+                             Allocates);
+    Lookaside->LastTotalAllocates = TotalAllocates;
+    Lookaside->LastAllocateHits = AllocateHits;
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
+/*
+ * @implemented
+ */
+VOID
+ExAdjustLookasideDepth(VOID)
+{
+    CCHAR Cpu;
+    ULONG i;
+    PKPRCB Prcb;
+    PGENERAL_LOOKASIDE Lookaside;
+
+    /* Called once a second by the balance set manager: adapt the pool lists
+     * of every processor, and one set of the other lists in turn
+     */
+    for (Cpu = 0; Cpu < KeNumberProcessors; Cpu++)
+    {
+        Prcb = KiProcessorBlock[(int)Cpu];
+
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            Lookaside = Prcb->PPNPagedLookasideList[i].P;
+            ExpScanPoolLookasideList(Lookaside);
+            if (Prcb->PPNPagedLookasideList[i].L != Lookaside)
+                ExpScanPoolLookasideList(Prcb->PPNPagedLookasideList[i].L);
+
+            Lookaside = Prcb->PPPagedLookasideList[i].P;
+            ExpScanPoolLookasideList(Lookaside);
+            if (Prcb->PPPagedLookasideList[i].L != Lookaside)
+                ExpScanPoolLookasideList(Prcb->PPPagedLookasideList[i].L);
+        }
+    }
+
+    switch (ExpLookasideScanCount++ % 3)
+    {
+        case 0:
+            ExpScanGeneralLookasideList(&ExSystemLookasideListHead, NULL);
+            break;
+
+        case 1:
+            ExpScanGeneralLookasideList(&ExpNonPagedLookasideListHead,
+                                        &ExpNonPagedLookasideListLock);
+            break;
+
+        case 2:
+            ExpScanGeneralLookasideList(&ExpPagedLookasideListHead,
+                                        &ExpPagedLookasideListLock);
+            break;
+    }
+}
+
 /*
  * @implemented
  */
@@ -16,6 +16,9 @@
 
 ULONG ExPushLockSpinCount = 0;
 
+/* Number of times a thread had to block on a pushlock */
+ULONG ExPushLockContentionCount = 0;
+
 #undef EX_PUSH_LOCK
 #undef PEX_PUSH_LOCK
 
@@ -51,6 +54,50 @@ ExpInitializePushLocks(VOID)
 #endif
 }
 
+#ifdef CONFIG_SMP
+/*++
+ * @name ExpSpinOnPushLock
+ *
+ *     The ExpSpinOnPushLock routine spins for a while on a busy pushlock,
+ *     hoping that it gets released before the caller has to block.
+ *
+ * @param PushLock
+ *        Pointer to the pushlock to spin on.
+ *
+ * @param Shared
+ *        TRUE if the caller wants shared access.
+ *
+ * @return The last value of the pushlock.
+ *
+ * @remarks Spinning stops as soon as other threads are waiting on the pushlock,
+ *          as the owner is then not about to release it, and, if we could
+ *          get it, we would be going ahead of them.
+ *
+ *--*/
+static
+EX_PUSH_LOCK
+ExpSpinOnPushLock(IN PEX_PUSH_LOCK PushLock,
+                  IN BOOLEAN Shared)
+{
+    EX_PUSH_LOCK Value;
+    ULONG i = ExPushLockSpinCount;
+
+    do
+    {
+        YieldProcessor();
+        Value.Value = *(volatile ULONG_PTR *)&PushLock->Value;
+
+        /* Stop if it's free, or if others are already queued */
+        if (!(Value.Locked) || (Value.Waiting)) break;
+
+        /* Sharers can also join other sharers */
+        if ((Shared) && (Value.Shared > 0)) break;
+    } while (--i);
+
+    return Value;
+}
+#endif
+
 /*++
  * @name ExfWakePushLock
  *
@@ -474,6 +521,9 @@ ExfAcquirePushLockExclusive(PEX_PUSH_LOCK PushLock)
     BOOLEAN NeedWake;
     EX_PUSH_LOCK_WAIT_BLOCK Block;
     PEX_PUSH_LOCK_WAIT_BLOCK WaitBlock = &Block;
+#ifdef CONFIG_SMP
+    BOOLEAN Spun = FALSE;
+#endif
 
     /* Start main loop */
     for (;;)
@@ -500,6 +550,16 @@ ExfAcquirePushLockExclusive(PEX_PUSH_LOCK PushLock)
         }
         else
         {
+#ifdef CONFIG_SMP
+            /* The owner may be about to release it, spin a little before queueing */
+            if ((ExPushLockSpinCount) && !(Spun) && !(OldValue.Waiting))
+            {
+                Spun = TRUE;
+                OldValue = ExpSpinOnPushLock(PushLock, FALSE);
+                continue;
+            }
+#endif
+
             /* We'll have to create a Waitblock */
             WaitBlock->Flags = EX_PUSH_LOCK_FLAGS_EXCLUSIVE |
                                EX_PUSH_LOCK_FLAGS_WAIT;
@@ -612,6 +672,7 @@ ExfAcquirePushLockExclusive(PEX_PUSH_LOCK PushLock)
             if (InterlockedBitTestAndReset(&WaitBlock->Flags, 1))
             {
                 /* Nobody removed it already, let's do a full wait */
+                InterlockedIncrement((PLONG)&ExPushLockContentionCount);
                 KeWaitForGate(&WaitBlock->WakeGate, WrPushLock, KernelMode);
                 ASSERT(WaitBlock->Signaled);
             }
@@ -648,6 +709,9 @@ ExfAcquirePushLockShared(PEX_PUSH_LOCK PushLock)
     BOOLEAN NeedWake;
     EX_PUSH_LOCK_WAIT_BLOCK Block;
     PEX_PUSH_LOCK_WAIT_BLOCK WaitBlock = &Block;
+#ifdef CONFIG_SMP
+    BOOLEAN Spun = FALSE;
+#endif
 
     /* Start main loop */
     for (;;)
@@ -687,6 +751,16 @@ ExfAcquirePushLockShared(PEX_PUSH_LOCK PushLock)
         }
         else
         {
+#ifdef CONFIG_SMP
+            /* The owner may be about to release it, spin a little before queueing */
+            if ((ExPushLockSpinCount) && !(Spun) && !(OldValue.Waiting))
+            {
+                Spun = TRUE;
+                OldValue = ExpSpinOnPushLock(PushLock, TRUE);
+                continue;
+            }
+#endif
+
             /* We'll have to create a Waitblock */
             WaitBlock->Flags = EX_PUSH_LOCK_FLAGS_WAIT;
             WaitBlock->ShareCount = 0;
@@ -779,6 +853,7 @@ ExfAcquirePushLockShared(PEX_PUSH_LOCK PushLock)
             if (InterlockedBitTestAndReset(&WaitBlock->Flags, 1))
             {
                 /* Fast-path did not work, we need to do a full wait */
+                InterlockedIncrement((PLONG)&ExPushLockContentionCount);
                 KeWaitForGate(&WaitBlock->WakeGate, WrPushLock, KernelMode);
                 ASSERT(WaitBlock->Signaled);
             }
@@ -75,6 +75,7 @@ ULONG ExpResourceTimeoutCount = 90 * 3600 / 2;
 KSPIN_LOCK ExpResourceSpinLock;
 LIST_ENTRY ExpSystemResourcesList;
 BOOLEAN ExResourceStrict = TRUE;
+ULONG ExpResourceSpinCount = 0;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
@@ -103,7 +104,7 @@ ExpVerifyResource(IN PERESOURCE Resource)
     ASSERT(!Resource->SharedWaiters ||
             Resource->SharedWaiters->Header.Size == (sizeof(KSEMAPHORE) / sizeof(ULONG)));
     ASSERT(!Resource->ExclusiveWaiters ||
-            Resource->ExclusiveWaiters->Header.Type == SynchronizationEvent);
+            (Resource->ExclusiveWaiters->Header.Type & KOBJECT_TYPE_MASK) == SynchronizationEvent);
     ASSERT(!Resource->ExclusiveWaiters ||
             Resource->ExclusiveWaiters->Header.Size == (sizeof(KEVENT) / sizeof(ULONG)));
 }
@@ -172,6 +173,11 @@ ExpResourceInitialization(VOID)
     ExpTimeout.QuadPart = Int32x32To64(4, -10000000);
     InitializeListHead(&ExpSystemResourcesList);
     KeInitializeSpinLock(&ExpResourceSpinLock);
+
+#ifdef CONFIG_SMP
+    /* Waiters may spin for an owner running on another CPU */
+    if (KeNumberProcessors > 1) ExpResourceSpinCount = 1024;
+#endif
 }
 
 /*++
@@ -597,6 +603,66 @@ ExpBoostOwnerThread(IN PKTHREAD Thread,
     }
 }
 
+FORCEINLINE
+VOID
+ExpCountResourceAcquire(IN PERESOURCE Resource,
+                        IN PVOID Caller)
+{
+    /* Only the waits are timed, this just counts the acquires */
+    if (KiLockStatisticsEnabled)
+    {
+        KiLockStatAcquired(Resource, KI_LOCK_STAT_RESOURCE, 0, Caller);
+    }
+}
+
+#ifdef CONFIG_SMP
+/*++
+ * @name ExpSpinForResource
+ *
+ *     The ExpSpinForResource routine spins for a while before a wait on the
+ *     specified resource, as long as its owner is running.
+ *
+ * @param Resource
+ *        Pointer to the resource to wait on.
+ *
+ * @param Object
+ *        Pointer to object (exclusive event or shared semaphore) to wait on.
+ *
+ * @return TRUE if the object got signaled while spinning.
+ *
+ * @remarks The release hands the resource over by signaling the object, so
+ *          the wait that follows is then satisfied without blocking.
+ *
+ *--*/
+static
+BOOLEAN
+ExpSpinForResource(IN PERESOURCE Resource,
+                   IN PVOID Object)
+{
+    PKTHREAD OwnerThread;
+    ULONG i;
+
+    for (i = ExpResourceSpinCount; i; i--)
+    {
+        /* Check if we got handed the resource already */
+        if (((volatile DISPATCHER_HEADER *)Object)->SignalState > 0) return TRUE;
+
+        /* There's no point in spinning for an owner that isn't running */
+        OwnerThread = (PKTHREAD)Resource->OwnerEntry.OwnerThread;
+        if (!(OwnerThread) ||
+            ((ULONG_PTR)OwnerThread & 0x3) ||
+            (OwnerThread->State != Running))
+        {
+            break;
+        }
+
+        YieldProcessor();
+    }
+
+    return FALSE;
+}
+#endif
+
 /*++
  * @name ExpWaitForResource
  *
@@ -608,6 +674,9 @@ ExpBoostOwnerThread(IN PKTHREAD Thread,
  * @param OwnerThread
  *        Pointer to object (exclusive event or shared semaphore) to wait on.
  *
+ * @param Caller
+ *        Caller of the acquire routine, for the lock statistics.
+ *
  * @return None.
  *
  * @remarks None.
@@ -616,7 +685,8 @@ ExpBoostOwnerThread(IN PKTHREAD Thread,
 VOID
 FASTCALL
 ExpWaitForResource(IN PERESOURCE Resource,
-                   IN PVOID Object)
+                   IN PVOID Object,
+                   IN PVOID Caller)
 {
     ULONG i;
     ULONG Size;
@@ -625,13 +695,23 @@ ExpWaitForResource(IN PERESOURCE Resource,
     NTSTATUS Status;
     LARGE_INTEGER Timeout;
     PKTHREAD Thread, OwnerThread;
+    ULONGLONG WaitStart = 0;
 #if DBG
     KLOCK_QUEUE_HANDLE LockHandle;
 #endif
 
+    /* Time the whole wait if we're keeping lock statistics */
+    if (KiLockStatisticsEnabled) WaitStart = KiLockStatTimeStamp();
+
     /* Increase contention count and use a 5 second timeout */
     Resource->ContentionCount++;
     Timeout.QuadPart = 500 * -10000;
+
+#ifdef CONFIG_SMP
+    /* The owner may be about to release it, spin a little before blocking */
+    ExpSpinForResource(Resource, Object);
+#endif
+
     for (;;)
     {
         /* Wait for ownership */
@@ -727,6 +807,9 @@ ExpWaitForResource(IN PERESOURCE Resource,
             }
         }
     }
+
+    /* We own the resource now */
+    if (WaitStart) KiLockStatContended(Resource, KI_LOCK_STAT_RESOURCE, WaitStart, Caller);
 }
 
 /* FUNCTIONS *****************************************************************/
@@ -783,6 +866,7 @@ ExAcquireResourceExclusiveLite(IN PERESOURCE Resource,
     /* Sanity check and validation */
     ASSERT(KeIsExecutingDpc() == FALSE);
     ExpVerifyResource(Resource);
+    ExpCountResourceAcquire(Resource, _ReturnAddress());
 
     /* Acquire the lock */
     ExAcquireResourceLock(Resource, &LockHandle);
@@ -824,7 +908,7 @@ TryAcquire:
                 /* Has exclusive waiters, wait on it */
                 Resource->NumberOfExclusiveWaiters++;
                 ExReleaseResourceLock(Resource, &LockHandle);
-                ExpWaitForResource(Resource, Resource->ExclusiveWaiters);
+                ExpWaitForResource(Resource, Resource->ExclusiveWaiters, _ReturnAddress());
 
                 /* Set owner and return success */
                 Resource->OwnerEntry.OwnerThread = ExGetCurrentResourceThread();
@@ -896,6 +980,7 @@ ExAcquireResourceSharedLite(IN PERESOURCE Resource,
     /* Sanity check and validation */
     ASSERT(KeIsExecutingDpc() == FALSE);
     ExpVerifyResource(Resource);
+    ExpCountResourceAcquire(Resource, _ReturnAddress());
 
     /* Acquire the lock */
     ExAcquireResourceLock(Resource, &LockHandle);
@@ -1016,7 +1101,7 @@ ExAcquireResourceSharedLite(IN PERESOURCE Resource,
 
     /* Release the lock and return */
     ExReleaseResourceLock(Resource, &LockHandle);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, _ReturnAddress());
     return TRUE;
 }
 
@@ -1073,6 +1158,7 @@ ExAcquireSharedStarveExclusive(IN PERESOURCE Resource,
     /* Sanity check and validation */
     ASSERT(KeIsExecutingDpc() == FALSE);
     ExpVerifyResource(Resource);
+    ExpCountResourceAcquire(Resource, _ReturnAddress());
 
     /* Acquire the lock */
     ExAcquireResourceLock(Resource, &LockHandle);
@@ -1177,7 +1263,7 @@ TryAcquire:
 
     /* Release the lock and return */
     ExReleaseResourceLock(Resource, &LockHandle);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, _ReturnAddress());
     return TRUE;
 }
 
@@ -1227,6 +1313,7 @@ ExAcquireSharedWaitForExclusive(IN PERESOURCE Resource,
     /* Sanity check and validation */
     ASSERT(KeIsExecutingDpc() == FALSE);
     ExpVerifyResource(Resource);
+    ExpCountResourceAcquire(Resource, _ReturnAddress());
 
     /* Acquire the lock */
     ExAcquireResourceLock(Resource, &LockHandle);
@@ -1290,7 +1377,7 @@ TryAcquire:
             /* Now wait for the resource */
             Resource->NumberOfSharedWaiters++;
             ExReleaseResourceLock(Resource, &LockHandle);
-            ExpWaitForResource(Resource, Resource->SharedWaiters);
+            ExpWaitForResource(Resource, Resource->SharedWaiters, _ReturnAddress());
 
             /* Get the lock back */
             ExAcquireResourceLock(Resource, &LockHandle);
@@ -1377,7 +1464,7 @@ TryAcquire:
 
     /* Release the lock and return */
     ExReleaseResourceLock(Resource, &LockHandle);
-    ExpWaitForResource(Resource, Resource->SharedWaiters);
+    ExpWaitForResource(Resource, Resource->SharedWaiters, _ReturnAddress());
     return TRUE;
 }
 
@@ -2141,6 +2228,7 @@ ExTryToAcquireResourceExclusiveLite(IN PERESOURCE Resource)
     /* Sanity check and validation */
     ASSERT(KeIsExecutingDpc() == FALSE);
     ExpVerifyResource(Resource);
+    ExpCountResourceAcquire(Resource, _ReturnAddress());
 
     /* Acquire the lock */
     ExAcquireResourceLock(Resource, &LockHandle);
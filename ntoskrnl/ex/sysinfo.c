@@ -761,7 +761,7 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->ResidentSystemCodePage = 0; /* FIXME */
 
     Spi->TotalSystemDriverPages = 0; /* FIXME */
-    Spi->Spare3Count = 0; /* FIXME */
+    Spi->Spare3Count = MiPfnLockContentionCount; /* PFN lock contention */
 
     Spi->ResidentSystemCachePage = MiMemoryConsumers[MC_CACHE].PagesUsed;
     Spi->ResidentPagedPoolPage = 0; /* FIXME */
@@ -1251,9 +1251,115 @@ QSI_DEF(SystemModuleInformation)
 /* Class 12 - Locks Information */
 QSI_DEF(SystemLocksInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemLocksInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PRTL_PROCESS_LOCKS LockInformation;
+    PRTL_PROCESS_LOCK_INFORMATION LockEntry;
+    PLIST_ENTRY NextEntry;
+    PERESOURCE Resource;
+    PKLOCK_STATISTICS Statistics;
+    KLOCK_STATISTICS LockStatistics;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    ERESOURCE_THREAD OwnerThread;
+    ULONG Index = 0, StatisticsIndex = 0;
+    NTSTATUS Status;
+    PMDL Mdl;
+    PAGED_CODE();
+
+    DPRINT("NtQuerySystemInformation - SystemLocksInformation\n");
+
+    /* Set initial required buffer size */
+    *ReqSize = FIELD_OFFSET(RTL_PROCESS_LOCKS, Locks);
+
+    /* Check user's buffer size */
+    if (Size < *ReqSize)
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* We need to lock down the memory, the list is walked at DISPATCH_LEVEL */
+    Status = ExLockUserBuffer(Buffer,
+                              Size,
+                              ExGetPreviousMode(),
+                              IoWriteAccess,
+                              (PVOID*)&LockInformation,
+                              &Mdl);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to lock the user buffer: 0x%lx\n", Status);
+        return Status;
+    }
+
+    /* Enumerate all the resources */
+    KeAcquireInStackQueuedSpinLock(&ExpResourceSpinLock, &LockHandle);
+    for (NextEntry = ExpSystemResourcesList.Flink;
+         NextEntry != &ExpSystemResourcesList;
+         NextEntry = NextEntry->Flink)
+    {
+        *ReqSize += sizeof(RTL_PROCESS_LOCK_INFORMATION);
+        if (*ReqSize > Size)
+        {
+            /* Keep counting, so that the caller learns the size it needs */
+            Status = STATUS_INFO_LENGTH_MISMATCH;
+            Index++;
+            continue;
+        }
+
+        Resource = CONTAINING_RECORD(NextEntry, ERESOURCE, SystemResourcesList);
+        LockEntry = &LockInformation->Locks[Index++];
+        RtlZeroMemory(LockEntry, sizeof(RTL_PROCESS_LOCK_INFORMATION));
+
+        LockEntry->Address = Resource;
+        LockEntry->Type = RTL_RESOURCE_TYPE;
+        LockEntry->ActiveCount = Resource->ActiveCount;
+        LockEntry->ContentionCount = Resource->ContentionCount;
+        LockEntry->NumberOfSharedWaiters = Resource->NumberOfSharedWaiters;
+        LockEntry->NumberOfExclusiveWaiters = Resource->NumberOfExclusiveWaiters;
+
+        /* Owner pointers with the low bits set aren't threads */
+        OwnerThread = Resource->OwnerEntry.OwnerThread;
+        if ((Resource->Flag & ResourceOwnedExclusive) && (OwnerThread) && !(OwnerThread & 3))
+        {
+            LockEntry->OwnerThreadId = HandleToUlong(((PETHREAD)OwnerThread)->Cid.UniqueThread);
+            LockEntry->RecursionCount = Resource->OwnerEntry.OwnerCount;
+        }
+
+        /* The entry count is only known with the lock statistics */
+        if (KiLockStatisticsEnabled)
+        {
+            Statistics = KiFindLockStatistics(Resource);
+            if (Statistics) LockEntry->EntryCount = Statistics->AcquireCount;
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /* And the spinlocks the kernel kept statistics for */
+    while ((KiLockStatisticsEnabled) &&
+           (KiGetNextLockStatistics(&StatisticsIndex, &LockStatistics)))
+    {
+        if (LockStatistics.Type == KI_LOCK_STAT_RESOURCE) continue;
+
+        *ReqSize += sizeof(RTL_PROCESS_LOCK_INFORMATION);
+        if (*ReqSize > Size)
+        {
+            Status = STATUS_INFO_LENGTH_MISMATCH;
+            Index++;
+            continue;
+        }
+
+        /* Spinlocks have no RTL type of their own, the kernel's is used */
+        LockEntry = &LockInformation->Locks[Index++];
+        RtlZeroMemory(LockEntry, sizeof(RTL_PROCESS_LOCK_INFORMATION));
+        LockEntry->Address = LockStatistics.Address;
+        LockEntry->Type = (USHORT)LockStatistics.Type;
+        LockEntry->ContentionCount = LockStatistics.ContentionCount;
+        LockEntry->EntryCount = LockStatistics.AcquireCount;
+    }
+
+    LockInformation->NumberOfLocks = Index;
+
+    /* Release the locked user buffer */
+    ExUnlockUserBuffer(Mdl);
+
+    return Status;
 }
 
 /* Class 13 - Stack Trace Information */
@@ -1537,9 +1643,16 @@ QSI_DEF(SystemInterruptInformation)
 }
 
 /* Class 24 - DPC Behaviour Information */
+C_ASSERT(RTL_NUMBER_OF(((PSYSTEM_DPC_ROUTINE_INFORMATION)NULL)->Histogram) == KI_DPC_STAT_BUCKETS);
+
 QSI_DEF(SystemDpcBehaviourInformation)
 {
     PSYSTEM_DPC_BEHAVIOR_INFORMATION sdbi = (PSYSTEM_DPC_BEHAVIOR_INFORMATION)Buffer;
+    PSYSTEM_DPC_BEHAVIOR_INFORMATION_EX Info = (PSYSTEM_DPC_BEHAVIOR_INFORMATION_EX)Buffer;
+    PSYSTEM_DPC_ROUTINE_INFORMATION Entry;
+    KDPC_STATISTICS Statistics;
+    ULONG Index = 0, Count = 0, i;
+    NTSTATUS Status = STATUS_SUCCESS;
 
     if (Size < sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION))
     {
@@ -1551,7 +1664,45 @@ QSI_DEF(SystemDpcBehaviourInformation)
     sdbi->AdjustDpcThreshold = KiAdjustDpcThreshold;
     sdbi->IdealDpcRate = KiIdealDpcRate;
 
-    return STATUS_SUCCESS;
+    /* Callers asking for the plain information get just that */
+    *ReqSize = sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION);
+    if ((Size == sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION)) || !(KiDpcStatisticsEnabled))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    if (Size < FIELD_OFFSET(SYSTEM_DPC_BEHAVIOR_INFORMATION_EX, Routines))
+    {
+        *ReqSize = FIELD_OFFSET(SYSTEM_DPC_BEHAVIOR_INFORMATION_EX, Routines);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* Then the routines, as many as fit */
+    *ReqSize = FIELD_OFFSET(SYSTEM_DPC_BEHAVIOR_INFORMATION_EX, Routines);
+    while (KiGetNextDpcStatistics(&Index, &Statistics))
+    {
+        *ReqSize += sizeof(SYSTEM_DPC_ROUTINE_INFORMATION);
+        if (*ReqSize > Size)
+        {
+            /* Keep counting, so that the caller learns the size it needs */
+            Status = STATUS_INFO_LENGTH_MISMATCH;
+            continue;
+        }
+
+        Entry = &Info->Routines[Count++];
+        Entry->Routine = Statistics.Routine;
+        Entry->Type = Statistics.Type;
+        Entry->Count = Statistics.Count;
+        Entry->TotalTime = Statistics.TotalTime;
+        Entry->MaximumTime = Statistics.MaximumTime;
+        for (i = 0; i < KI_DPC_STAT_BUCKETS; i++)
+        {
+            Entry->Histogram[i] = Statistics.Histogram[i];
+        }
+    }
+    Info->NumberOfRoutines = Count;
+
+    return Status;
 }
 
 SSI_DEF(SystemDpcBehaviourInformation)
@@ -1749,6 +1900,42 @@ QSI_DEF(SystemPerformanceTraceInformation)
     return STATUS_NOT_IMPLEMENTED;
 }
 
+/* Class 31 - Add an event to the boot timeline */
+SSI_DEF(SystemPerformanceTraceInformation)
+{
+    BOOTPERF_MARK Mark;
+
+    if (Size != sizeof(BOOTPERF_MARK))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeTcbPrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    /* Tell the caller to stop bothering once the timeline is written */
+    if (!ExpBootPerfEnabled)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    /* The buffer was probed by our caller */
+    RtlCopyMemory(&Mark, Buffer, sizeof(Mark));
+    Mark.Name[BOOTPERF_NAME_LENGTH - 1] = UNICODE_NULL;
+
+    if (Mark.Type != BootPerfCheckpoint &&
+        Mark.Type != BootPerfPhase &&
+        Mark.Type != BootPerfService)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    ExpBootPerfMark(Mark.Type, Mark.Flags, Mark.Name);
+    return STATUS_SUCCESS;
+}
+
 /* Class 32 - Crash Dump Information */
 QSI_DEF(SystemCrashDumpInformation)
 {
@@ -2868,7 +3055,7 @@ CallQS [] =
     SI_QS(SystemTimeAdjustmentInformation),
     SI_QX(SystemSummaryMemoryInformation), /* it should be SI_XX */
     SI_QX(SystemNextEventIdInformation), /* it should be SI_XX */
-    SI_QX(SystemPerformanceTraceInformation), /* it should be SI_XX */
+    SI_QS(SystemPerformanceTraceInformation),
     SI_QX(SystemCrashDumpInformation),
     SI_QX(SystemExceptionInformation),
     SI_QX(SystemCrashDumpStateInformation),
@@ -53,8 +53,98 @@ KEVENT ExpThreadSetManagerShutdownEvent;
 PETHREAD ExpWorkerThreadBalanceManagerPtr;
 PETHREAD ExpLastWorkerThread;
 
+/* Magic flag and shift for worker pool threads */
+#define EX_WORK_POOL_THREAD                         0x40000000
+#define EX_WORK_POOL_PROCESSOR_SHIFT                8
+
+/*
+ * On MP systems, the critical and delayed queues are backed by a pool of
+ * per-processor queues. Work is queued on the processor it comes from (or the
+ * one it asks for), where its data is likely to be hot, and processors whose
+ * workers run out of work steal from the others, those in the same node first.
+ */
+typedef struct DECLSPEC_CACHEALIGN _EX_WORK_POOL_QUEUE
+{
+    KSPIN_LOCK Lock;
+    LIST_ENTRY WorkItemListHead;
+    LONG Depth;
+    LONG IdleWorkers;
+    KEVENT WakeEvent;
+    KAFFINITY NodeMask;
+} EX_WORK_POOL_QUEUE, *PEX_WORK_POOL_QUEUE;
+
+/* The per-processor queues for each work queue type, NULL if there is no pool */
+PEX_WORK_POOL_QUEUE ExpWorkPool[MaximumWorkQueue];
+
+/* Registry setting to keep the old shared queues on MP systems */
+ULONG ExpWorkPoolDisabled;
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
+/*++
+ * @name ExpCallWorkerRoutine
+ *
+ *     The ExpCallWorkerRoutine routine calls the worker routine of a work item
+ *     and makes sure it came back in a sane state.
+ *
+ * @param Thread
+ *        The current worker thread.
+ *
+ * @param WorkItem
+ *        The work item to process.
+ *
+ * @return None.
+ *
+ * @remarks See ExpWorkerThreadEntryPoint.
+ *
+ *--*/
+static
+VOID
+ExpCallWorkerRoutine(IN PETHREAD Thread,
+                     IN PWORK_QUEUE_ITEM WorkItem)
+{
+    /* Make sure nobody is trying to play smart with us */
+    ASSERT((ULONG_PTR)WorkItem->WorkerRoutine > MmUserProbeAddress);
+
+    /* Call the Worker Routine */
+    WorkItem->WorkerRoutine(WorkItem->Parameter);
+
+    /* Make sure APCs are not disabled */
+    if (Thread->Tcb.CombinedApcDisable != 0)
+    {
+        /* We're nice and do it behind your back */
+        DPRINT1("Warning: Broken Worker Thread: %p %p %p came back "
+                "with APCs disabled!\n",
+                WorkItem->WorkerRoutine,
+                WorkItem->Parameter,
+                WorkItem);
+        ASSERT(Thread->Tcb.CombinedApcDisable == 0);
+        Thread->Tcb.CombinedApcDisable = 0;
+    }
+
+    /* Make sure it returned at right IRQL */
+    if (KeGetCurrentIrql() != PASSIVE_LEVEL)
+    {
+        /* It didn't, bugcheck! */
+        KeBugCheckEx(WORKER_THREAD_RETURNED_AT_BAD_IRQL,
+                     (ULONG_PTR)WorkItem->WorkerRoutine,
+                     KeGetCurrentIrql(),
+                     (ULONG_PTR)WorkItem->Parameter,
+                     (ULONG_PTR)WorkItem);
+    }
+
+    /* Make sure it returned with Impersionation Disabled */
+    if (Thread->ActiveImpersonationInfo)
+    {
+        /* It didn't, bugcheck! */
+        KeBugCheckEx(IMPERSONATING_WORKER_THREAD,
+                     (ULONG_PTR)WorkItem->WorkerRoutine,
+                     (ULONG_PTR)WorkItem->Parameter,
+                     (ULONG_PTR)WorkItem,
+                     0);
+    }
+}
+
 /*++
  * @name ExpWorkerThreadEntryPoint
  *
@@ -152,49 +242,9 @@ ProcessLoop:
         /* Increment Processed Work Items */
         InterlockedIncrement((PLONG)&WorkQueue->WorkItemsProcessed);
 
-        /* Get the Work Item */
+        /* Get the Work Item and call it */
         WorkItem = CONTAINING_RECORD(QueueEntry, WORK_QUEUE_ITEM, List);
-
-        /* Make sure nobody is trying to play smart with us */
-        ASSERT((ULONG_PTR)WorkItem->WorkerRoutine > MmUserProbeAddress);
-
-        /* Call the Worker Routine */
-        WorkItem->WorkerRoutine(WorkItem->Parameter);
-
-        /* Make sure APCs are not disabled */
-        if (Thread->Tcb.CombinedApcDisable != 0)
-        {
-            /* We're nice and do it behind your back */
-            DPRINT1("Warning: Broken Worker Thread: %p %p %p came back "
-                    "with APCs disabled!\n",
-                    WorkItem->WorkerRoutine,
-                    WorkItem->Parameter,
-                    WorkItem);
-            ASSERT(Thread->Tcb.CombinedApcDisable == 0);
-            Thread->Tcb.CombinedApcDisable = 0;
-        }
-
-        /* Make sure it returned at right IRQL */
-        if (KeGetCurrentIrql() != PASSIVE_LEVEL)
-        {
-            /* It didn't, bugcheck! */
-            KeBugCheckEx(WORKER_THREAD_RETURNED_AT_BAD_IRQL,
-                         (ULONG_PTR)WorkItem->WorkerRoutine,
-                         KeGetCurrentIrql(),
-                         (ULONG_PTR)WorkItem->Parameter,
-                         (ULONG_PTR)WorkItem);
-        }
-
-        /* Make sure it returned with Impersionation Disabled */
-        if (Thread->ActiveImpersonationInfo)
-        {
-            /* It didn't, bugcheck! */
-            KeBugCheckEx(IMPERSONATING_WORKER_THREAD,
-                         (ULONG_PTR)WorkItem->WorkerRoutine,
-                         (ULONG_PTR)WorkItem->Parameter,
-                         (ULONG_PTR)WorkItem,
-                         0);
-        }
+        ExpCallWorkerRoutine(Thread, WorkItem);
     }
 
     /* This is a dynamic thread. Terminate it unless IRPs are pending */
@@ -226,6 +276,294 @@ ProcessLoop:
     return;
 }
 
+/*++
+ * @name ExpRemoveWorkPoolItem
+ *
+ *     The ExpRemoveWorkPoolItem routine removes the oldest work item from a
+ *     per-processor work queue.
+ *
+ * @param Queue
+ *        The per-processor work queue.
+ *
+ * @return The work item, or NULL if the queue is empty.
+ *
+ * @remarks We only peek at the depth without the lock, since an empty queue is
+ *          checked again by the caller before it goes to sleep.
+ *
+ *--*/
+static
+PWORK_QUEUE_ITEM
+ExpRemoveWorkPoolItem(IN PEX_WORK_POOL_QUEUE Queue)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY ListEntry = NULL;
+
+    /* Don't bother with the lock if there's nothing to take */
+    if (!*(volatile LONG*)&Queue->Depth) return NULL;
+
+    /* Take the oldest item, in case someone raced us */
+    KeAcquireInStackQueuedSpinLock(&Queue->Lock, &LockHandle);
+    if (!IsListEmpty(&Queue->WorkItemListHead))
+    {
+        ListEntry = RemoveHeadList(&Queue->WorkItemListHead);
+        Queue->Depth--;
+    }
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /* Return the work item, if we got one */
+    if (!ListEntry) return NULL;
+    ListEntry->Flink = NULL;
+    return CONTAINING_RECORD(ListEntry, WORK_QUEUE_ITEM, List);
+}
+
+/*++
+ * @name ExpStealWorkPoolItem
+ *
+ *     The ExpStealWorkPoolItem routine takes a work item from the queue of
+ *     another processor.
+ *
+ * @param WorkQueueType
+ *        Type of the pool to steal from.
+ *
+ * @param Processor
+ *        The processor which ran out of work.
+ *
+ * @return The work item, or NULL if every queue is empty.
+ *
+ * @remarks Processors of the same node are tried first, starting right after
+ *          the current one, so that thieves don't all pick the same victim.
+ *
+ *--*/
+static
+PWORK_QUEUE_ITEM
+ExpStealWorkPoolItem(IN WORK_QUEUE_TYPE WorkQueueType,
+                     IN ULONG Processor)
+{
+    PEX_WORK_POOL_QUEUE Pool = ExpWorkPool[WorkQueueType];
+    KAFFINITY NodeMask = Pool[Processor].NodeMask;
+    PWORK_QUEUE_ITEM WorkItem;
+    ULONG Pass, i, Victim;
+
+    /* Try the processors of our node, then everyone else */
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        for (i = 1; i < (ULONG)KeNumberProcessors; i++)
+        {
+            /* Select the victim and check if it's one for this pass */
+            Victim = (Processor + i) % KeNumberProcessors;
+            if (((NodeMask & AFFINITY_MASK(Victim)) != 0) != (Pass == 0)) continue;
+
+            /* Try to take something */
+            WorkItem = ExpRemoveWorkPoolItem(&Pool[Victim]);
+            if (WorkItem) return WorkItem;
+        }
+    }
+
+    /* Nothing to do anywhere */
+    return NULL;
+}
+
+/*++
+ * @name ExpWorkPoolThreadEntryPoint
+ *
+ *     The ExpWorkPoolThreadEntryPoint routine is the entrypoint for worker
+ *     threads of the per-processor worker pool.
+ *
+ * @param Context
+ *        Contains the work queue type and the processor of the thread, masked
+ *        with a flag specifing whether the thread is dynamic or not.
+ *
+ * @return None.
+ *
+ * @remarks Like other worker threads, a dynamic pool thread times out after
+ *          10 minutes without work, and a static one never does.
+ *
+ *--*/
+VOID
+NTAPI
+ExpWorkPoolThreadEntryPoint(IN PVOID Context)
+{
+    PWORK_QUEUE_ITEM WorkItem;
+    WORK_QUEUE_TYPE WorkQueueType;
+    PEX_WORK_QUEUE WorkQueue;
+    PEX_WORK_POOL_QUEUE Queue;
+    ULONG Processor;
+    LARGE_INTEGER Timeout;
+    PLARGE_INTEGER TimeoutPointer = NULL;
+    PETHREAD Thread = PsGetCurrentThread();
+    NTSTATUS Status;
+
+    /* Check if this is a dyamic thread */
+    if ((ULONG_PTR)Context & EX_DYNAMIC_WORK_THREAD)
+    {
+        /* It is, which means we will eventually time out after 10 minutes */
+        Timeout.QuadPart = Int32x32To64(10, -10000000 * 60);
+        TimeoutPointer = &Timeout;
+    }
+
+    /* Get the queue type, our processor and our queues */
+    WorkQueueType = (WORK_QUEUE_TYPE)((ULONG_PTR)Context & 0xFF);
+    Processor = ((ULONG_PTR)Context & ~(EX_DYNAMIC_WORK_THREAD | EX_WORK_POOL_THREAD)) >>
+                EX_WORK_POOL_PROCESSOR_SHIFT;
+    WorkQueue = &ExWorkerQueue[WorkQueueType];
+    Queue = &ExpWorkPool[WorkQueueType][Processor];
+
+    /* Nobody should have initialized this yet */
+    ASSERT(Thread->ExWorkerCanWaitUser == 0);
+
+    /* If we shouldn't swap, disable that feature */
+    if (!ExpWorkersCanSwap) KeSetKernelStackSwapEnable(FALSE);
+
+    /* Success, you are now officially a worker thread! */
+    Thread->ActiveExWorker = TRUE;
+
+    /* Loop forever */
+    for (;;)
+    {
+        /* Do our own work first, and help the others when we're done */
+        WorkItem = ExpRemoveWorkPoolItem(Queue);
+        if (!WorkItem) WorkItem = ExpStealWorkPoolItem(WorkQueueType, Processor);
+        if (!WorkItem)
+        {
+            /*
+             * Tell everyone we're idle before checking one last time. Anything
+             * queued after this will wake us up, and anything queued before it
+             * will be seen now.
+             */
+            InterlockedIncrement(&Queue->IdleWorkers);
+            WorkItem = ExpRemoveWorkPoolItem(Queue);
+            if (!WorkItem) WorkItem = ExpStealWorkPoolItem(WorkQueueType, Processor);
+
+            /* Wait for something to happen if there's really nothing to do */
+            Status = STATUS_SUCCESS;
+            if (!WorkItem)
+            {
+                Status = KeWaitForSingleObject(&Queue->WakeEvent,
+                                               Executive,
+                                               KernelMode,
+                                               FALSE,
+                                               TimeoutPointer);
+            }
+            InterlockedDecrement(&Queue->IdleWorkers);
+
+            if (!WorkItem)
+            {
+                /* Dynamic threads quit when they timed out, unless IRPs are pending */
+                if ((Status == STATUS_TIMEOUT) && (IsListEmpty(&Thread->IrpList))) break;
+                continue;
+            }
+        }
+
+        /* Increment Processed Work Items */
+        InterlockedIncrement((PLONG)&WorkQueue->WorkItemsProcessed);
+
+        /* Call the Worker Routine */
+        ExpCallWorkerRoutine(Thread, WorkItem);
+    }
+
+    /* Decrement dynamic thread count */
+    InterlockedDecrement(&WorkQueue->DynamicThreadCount);
+
+    /* We're not a worker thread anymore */
+    Thread->ActiveExWorker = FALSE;
+
+    /* Re-enable the stack swap */
+    KeSetKernelStackSwapEnable(TRUE);
+}
+
+/*++
+ * @name ExpInsertWorkPoolItem
+ *
+ *     The ExpInsertWorkPoolItem routine queues a work item to the queue of a
+ *     processor and wakes up a worker to handle it.
+ *
+ * @param WorkItem
+ *        The work item to queue.
+ *
+ * @param WorkQueueType
+ *        Type of the pool to use.
+ *
+ * @param Processor
+ *        The processor whose queue should get the item.
+ *
+ * @return None.
+ *
+ * @remarks If the workers of that processor are all busy, an idle worker of
+ *          another processor, preferably in the same node, is woken up to
+ *          steal the item instead.
+ *
+ *--*/
+static
+VOID
+ExpInsertWorkPoolItem(IN PWORK_QUEUE_ITEM WorkItem,
+                      IN WORK_QUEUE_TYPE WorkQueueType,
+                      IN ULONG Processor)
+{
+    PEX_WORK_POOL_QUEUE Pool = ExpWorkPool[WorkQueueType];
+    PEX_WORK_POOL_QUEUE Queue = &Pool[Processor];
+    KLOCK_QUEUE_HANDLE LockHandle;
+    ULONG Pass, i, Other;
+
+    /* Insert the item */
+    KeAcquireInStackQueuedSpinLock(&Queue->Lock, &LockHandle);
+    InsertTailList(&Queue->WorkItemListHead, &WorkItem->List);
+    Queue->Depth++;
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /* Wake up one of our own workers if one is waiting */
+    if (*(volatile LONG*)&Queue->IdleWorkers)
+    {
+        KeSetEvent(&Queue->WakeEvent, IO_NO_INCREMENT, FALSE);
+        return;
+    }
+
+    /* Otherwise look for an idle worker elsewhere, in our node first */
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        for (i = 1; i < (ULONG)KeNumberProcessors; i++)
+        {
+            Other = (Processor + i) % KeNumberProcessors;
+            if (((Queue->NodeMask & AFFINITY_MASK(Other)) != 0) != (Pass == 0)) continue;
+
+            if (*(volatile LONG*)&Pool[Other].IdleWorkers)
+            {
+                KeSetEvent(&Pool[Other].WakeEvent, IO_NO_INCREMENT, FALSE);
+                return;
+            }
+        }
+    }
+
+    /* Everyone is busy, the next worker to finish will pick it up */
+}
+
+/*++
+ * @name ExpGetWorkPoolDepth
+ *
+ *     The ExpGetWorkPoolDepth routine returns the number of items waiting in
+ *     every queue of a worker pool.
+ *
+ * @param WorkQueueType
+ *        Type of the pool.
+ *
+ * @return The number of queued items.
+ *
+ * @remarks This is only a snapshot, used by the balance set manager.
+ *
+ *--*/
+static
+ULONG
+ExpGetWorkPoolDepth(IN WORK_QUEUE_TYPE WorkQueueType)
+{
+    ULONG i, Depth = 0;
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        Depth += ExpWorkPool[WorkQueueType][i].Depth;
+    }
+
+    return Depth;
+}
+
 /*++
  * @name ExpCreateWorkerThread
  *
@@ -241,6 +579,10 @@ ProcessLoop:
  * @param Dynamic
  *        Specifies whether or not this thread is a dynamic thread.
  *
+ * @param Processor
+ *        Processor of the worker pool queue this thread serves, or
+ *        EX_WORK_ANY_PROCESSOR for a thread of the shared queue.
+ *
  * @return None.
  *
  * @remarks HyperCritical work threads run at priority 7; Critical work threads
@@ -252,12 +594,14 @@ ProcessLoop:
 VOID
 NTAPI
 ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
-                      IN BOOLEAN Dynamic)
+                      IN BOOLEAN Dynamic,
+                      IN ULONG Processor)
 {
     PETHREAD Thread;
     HANDLE hThread;
     ULONG Context;
     KPRIORITY Priority;
+    PKSTART_ROUTINE StartRoutine = ExpWorkerThreadEntryPoint;
 
     /* Check if this is going to be a dynamic thread */
     Context = WorkQueueType;
@@ -265,13 +609,21 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     /* Add the dynamic mask */
     if (Dynamic) Context |= EX_DYNAMIC_WORK_THREAD;
 
+    /* Check if this is going to be a worker pool thread */
+    if (Processor != EX_WORK_ANY_PROCESSOR)
+    {
+        /* Add the pool mask and the processor */
+        Context |= EX_WORK_POOL_THREAD | (Processor << EX_WORK_POOL_PROCESSOR_SHIFT);
+        StartRoutine = ExpWorkPoolThreadEntryPoint;
+    }
+
     /* Create the System Thread */
     PsCreateSystemThread(&hThread,
                          THREAD_ALL_ACCESS,
                          NULL,
                          NULL,
                          NULL,
-                         ExpWorkerThreadEntryPoint,
+                         StartRoutine,
                          UlongToPtr(Context));
 
     /* If the thread is dynamic */
@@ -309,6 +661,12 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     /* Set the Priority */
     KeSetBasePriorityThread(&Thread->Tcb, Priority);
 
+    /* Pool threads prefer their processor, but may run elsewhere */
+    if (Processor != EX_WORK_ANY_PROCESSOR)
+    {
+        KeSetIdealProcessorThread(&Thread->Tcb, (CCHAR)Processor);
+    }
+
     /* Dereference and close handle */
     ObDereferenceObject(Thread);
     ObCloseHandle(hThread, KernelMode);
@@ -333,7 +691,7 @@ VOID
 NTAPI
 ExpDetectWorkerThreadDeadlock(VOID)
 {
-    ULONG i;
+    ULONG i, j, Processor;
     PEX_WORK_QUEUE Queue;
 
     /* Loop the 3 queues */
@@ -350,13 +708,30 @@ ExpDetectWorkerThreadDeadlock(VOID)
         {
             /* Stuff is still on the queue and nobody did anything about it */
             DPRINT1("EX: Work Queue Deadlock detected: %lu\n", i);
-            ExpCreateWorkerThread(i, TRUE);
+            if (ExpWorkPool[i])
+            {
+                /* Every pool worker is stuck, add one where the work piles up */
+                for (Processor = 0, j = 1; j < (ULONG)KeNumberProcessors; j++)
+                {
+                    if (ExpWorkPool[i][j].Depth > ExpWorkPool[i][Processor].Depth)
+                    {
+                        Processor = j;
+                    }
+                }
+                ExpCreateWorkerThread(i, TRUE, Processor);
+            }
+            else
+            {
+                ExpCreateWorkerThread(i, TRUE, EX_WORK_ANY_PROCESSOR);
+            }
             DPRINT1("Dynamic threads queued %d\n", Queue->DynamicThreadCount);
         }
 
         /* Update our data */
         Queue->WorkItemsProcessedLastPass = Queue->WorkItemsProcessed;
-        Queue->QueueDepthLastPass = KeReadStateQueue(&Queue->WorkerQueue);
+        Queue->QueueDepthLastPass = ExpWorkPool[i] ?
+                                    ExpGetWorkPoolDepth(i) :
+                                    KeReadStateQueue(&Queue->WorkerQueue);
     }
 }
 
@@ -396,7 +771,7 @@ ExpCheckDynamicThreadCount(VOID)
         {
             /* Create a new thread */
             DPRINT1("EX: Creating new dynamic thread as requested\n");
-            ExpCreateWorkerThread(i, TRUE);
+            ExpCreateWorkerThread(i, TRUE, EX_WORK_ANY_PROCESSOR);
         }
     }
 }
@@ -502,6 +877,74 @@ ExpWorkerThreadBalanceManager(IN PVOID Context)
     }
 }
 
+/*++
+ * @name ExpInitializeWorkPool
+ *
+ *     The ExpInitializeWorkPool routine creates the per-processor queues and
+ *     worker threads backing a work queue.
+ *
+ * @param WorkQueueType
+ *        Type of the queue to back with a pool.
+ *
+ * @param Threads
+ *        Number of threads the shared queue would have had.
+ *
+ * @return Number of worker threads created, or 0 if the queue is not pooled.
+ *
+ * @remarks The threads are spread evenly, and every processor gets at least
+ *          one, so there are never fewer than for the shared queue.
+ *
+ *--*/
+INIT_FUNCTION
+static
+ULONG
+ExpInitializeWorkPool(IN WORK_QUEUE_TYPE WorkQueueType,
+                      IN ULONG Threads)
+{
+    PEX_WORK_POOL_QUEUE Pool;
+    PKPRCB Prcb;
+    ULONG i, j, ThreadsPerProcessor;
+
+    /* A pool buys nothing on UP, and it can be turned off in the registry */
+    if ((KeNumberProcessors == 1) || (ExpWorkPoolDisabled)) return 0;
+
+    /* Allocate the queues, one cache line aligned entry for each processor */
+    Pool = ExAllocatePoolWithTag(NonPagedPool,
+                                 KeNumberProcessors * sizeof(EX_WORK_POOL_QUEUE) +
+                                 SYSTEM_CACHE_ALIGNMENT_SIZE,
+                                 TAG_WORKER_POOL);
+    if (!Pool) return 0;
+    Pool = ALIGN_UP_POINTER_BY(Pool, SYSTEM_CACHE_ALIGNMENT_SIZE);
+
+    /* Initialize them */
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        KeInitializeSpinLock(&Pool[i].Lock);
+        InitializeListHead(&Pool[i].WorkItemListHead);
+        Pool[i].Depth = 0;
+        Pool[i].IdleWorkers = 0;
+        KeInitializeEvent(&Pool[i].WakeEvent, SynchronizationEvent, FALSE);
+
+        /* Remember which processors share our node */
+        Prcb = KiProcessorBlock[i];
+        Pool[i].NodeMask = (Prcb && Prcb->ParentNode) ?
+                           Prcb->ParentNode->ProcessorMask : 0;
+    }
+    ExpWorkPool[WorkQueueType] = Pool;
+
+    /* Create the threads */
+    ThreadsPerProcessor = max(1, (Threads + KeNumberProcessors - 1) / KeNumberProcessors);
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        for (j = 0; j < ThreadsPerProcessor; j++)
+        {
+            ExpCreateWorkerThread(WorkQueueType, FALSE, i);
+        }
+    }
+
+    return ThreadsPerProcessor * KeNumberProcessors;
+}
+
 /*++
  * @name ExpInitializeWorkerThreads
  *
@@ -562,24 +1005,30 @@ ExpInitializeWorkerThreads(VOID)
                       NotificationEvent,
                       FALSE);
 
+    /* Back the critical and delayed queues with a worker pool if we can */
+    ExCriticalWorkerThreads = ExpInitializeWorkPool(CriticalWorkQueue,
+                                                    CriticalThreads);
+    ExDelayedWorkerThreads = ExpInitializeWorkPool(DelayedWorkQueue,
+                                                   DelayedThreads);
+
     /* Create the built-in worker threads for the critical queue */
-    for (i = 0; i < CriticalThreads; i++)
+    for (i = 0; (i < CriticalThreads) && !(ExpWorkPool[CriticalWorkQueue]); i++)
     {
         /* Create the thread */
-        ExpCreateWorkerThread(CriticalWorkQueue, FALSE);
+        ExpCreateWorkerThread(CriticalWorkQueue, FALSE, EX_WORK_ANY_PROCESSOR);
         ExCriticalWorkerThreads++;
     }
 
     /* Create the built-in worker threads for the delayed queue */
-    for (i = 0; i < DelayedThreads; i++)
+    for (i = 0; (i < DelayedThreads) && !(ExpWorkPool[DelayedWorkQueue]); i++)
     {
         /* Create the thread */
-        ExpCreateWorkerThread(DelayedWorkQueue, FALSE);
+        ExpCreateWorkerThread(DelayedWorkQueue, FALSE, EX_WORK_ANY_PROCESSOR);
         ExDelayedWorkerThreads++;
     }
 
     /* Create the built-in worker thread for the hypercritical queue */
-    ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE);
+    ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE, EX_WORK_ANY_PROCESSOR);
 
     /* Create the balance set manager thread */
     PsCreateSystemThread(&ThreadHandle,
@@ -689,11 +1138,10 @@ Next:
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*++
- * @name ExQueueWorkItem
- * @implemented NT4
+ * @name ExQueueWorkItemEx
  *
- *     The ExQueueWorkItem routine acquires rundown protection for
- *     the specified descriptor.
+ *     The ExQueueWorkItemEx routine queues a work item, with a hint about
+ *     which processor should run it.
  *
  * @param WorkItem
  *        Pointer to an initialized Work Queue Item structure. This structure
@@ -705,17 +1153,23 @@ Next:
  *          - CriticalWorkQueue
  *          - HyperCriticalWorkQueue
  *
+ * @param Processor
+ *        Processor which should preferably run the item, or
+ *        EX_WORK_ANY_PROCESSOR for the current one.
+ *
  * @return None.
  *
- * @remarks This routine is obsolete. Use IoQueueWorkItem instead.
+ * @remarks The hint is only honored when the queue is backed by the worker
+ *          pool, and the item may still be stolen by another processor.
  *
  *          Callers of this routine must be running at IRQL <= DISPATCH_LEVEL.
  *
  *--*/
 VOID
 NTAPI
-ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
-                IN WORK_QUEUE_TYPE QueueType)
+ExQueueWorkItemEx(IN PWORK_QUEUE_ITEM WorkItem,
+                  IN WORK_QUEUE_TYPE QueueType,
+                  IN ULONG Processor)
 {
     PEX_WORK_QUEUE WorkQueue = &ExWorkerQueue[QueueType];
     ASSERT(QueueType < MaximumWorkQueue);
@@ -732,6 +1186,20 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
                      0);
     }
 
+    /* Check if this queue is backed by the worker pool */
+    if (ExpWorkPool[QueueType])
+    {
+        /* Default to the current processor, which likely has the data cached */
+        if (Processor >= (ULONG)KeNumberProcessors)
+        {
+            Processor = KeGetCurrentProcessorNumber();
+        }
+
+        /* Queue it there, the pool takes care of its own threads */
+        ExpInsertWorkPoolItem(WorkItem, QueueType, Processor);
+        return;
+    }
+
     /* Insert the Queue */
     KeInsertQueue(&WorkQueue->WorkerQueue, &WorkItem->List);
     ASSERT(!WorkQueue->Info.QueueDisabled);
@@ -757,4 +1225,37 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
     }
 }
 
+/*++
+ * @name ExQueueWorkItem
+ * @implemented NT4
+ *
+ *     The ExQueueWorkItem routine acquires rundown protection for
+ *     the specified descriptor.
+ *
+ * @param WorkItem
+ *        Pointer to an initialized Work Queue Item structure. This structure
+ *        must be located in nonpaged pool memory.
+ *
+ * @param QueueType
+ *        Type of the queue to use for this item. Can be one of the following:
+ *          - DelayedWorkQueue
+ *          - CriticalWorkQueue
+ *          - HyperCriticalWorkQueue
+ *
+ * @return None.
+ *
+ * @remarks This routine is obsolete. Use IoQueueWorkItem instead.
+ *
+ *          Callers of this routine must be running at IRQL <= DISPATCH_LEVEL.
+ *
+ *--*/
+VOID
+NTAPI
+ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
+                IN WORK_QUEUE_TYPE QueueType)
+{
+    /* Queue it on the current processor */
+    ExQueueWorkItemEx(WorkItem, QueueType, EX_WORK_ANY_PROCESSOR);
+}
+
 /* EOF */
@@ -39,6 +39,9 @@ typedef struct _LOCK_INFORMATION
     PFILE_LOCK BelongsTo;
     LIST_ENTRY SharedLocks;
     ULONG Generation;
+    /* Every lock is within [LowestStart, HighestEnd), see FsRtlpNoLockInRange */
+    LARGE_INTEGER LowestStart, HighestEnd;
+    BOOLEAN BoundsStale;
 }
     LOCK_INFORMATION, *PLOCK_INFORMATION;
 
@@ -266,6 +269,72 @@ FsRtlGetNextFileLock(IN PFILE_LOCK FileLock,
     else return &Entry->Exclusive.FileLock;
 }
 
+/* Widens the bounds of all the locks for a newly inserted one */
+static
+VOID
+FsRtlpAddLockBounds(PLOCK_INFORMATION LockInfo,
+                    PCOMBINED_LOCK_ELEMENT Element)
+{
+    LARGE_INTEGER Start = Element->Exclusive.FileLock.StartingByte;
+    LARGE_INTEGER End = Element->Exclusive.FileLock.EndingByte;
+
+    /* An empty range still matches I/O starting at its offset */
+    if (End.QuadPart <= Start.QuadPart) End.QuadPart = Start.QuadPart + 1;
+
+    if (RtlNumberGenericTableElements(&LockInfo->RangeTable) == 1)
+    {
+        LockInfo->LowestStart = Start;
+        LockInfo->HighestEnd = End;
+        LockInfo->BoundsStale = FALSE;
+    }
+    else if (!LockInfo->BoundsStale)
+    {
+        if (Start.QuadPart < LockInfo->LowestStart.QuadPart) LockInfo->LowestStart = Start;
+        if (End.QuadPart > LockInfo->HighestEnd.QuadPart) LockInfo->HighestEnd = End;
+    }
+}
+
+/*
+ * Tells whether I/O on [Start, End) can't overlap any lock, without looking
+ * the range up. Unlocking only marks the bounds stale, they are computed
+ * again here the next time they are needed.
+ */
+static
+BOOLEAN
+FsRtlpNoLockInRange(PLOCK_INFORMATION LockInfo,
+                    LONGLONG Start,
+                    LONGLONG End)
+{
+    PVOID RestartKey = NULL;
+    PCOMBINED_LOCK_ELEMENT Entry;
+    LONGLONG EntryEnd;
+
+    if (!LockInfo) return TRUE;
+    if (RtlNumberGenericTableElements(&LockInfo->RangeTable) == 0) return TRUE;
+
+    if (LockInfo->BoundsStale)
+    {
+        LockInfo->LowestStart.QuadPart = MAXLONGLONG;
+        LockInfo->HighestEnd.QuadPart = -MAXLONGLONG - 1;
+        while ((Entry = RtlEnumerateGenericTableWithoutSplaying(&LockInfo->RangeTable,
+                                                                &RestartKey)))
+        {
+            EntryEnd = max(Entry->Exclusive.FileLock.EndingByte.QuadPart,
+                           Entry->Exclusive.FileLock.StartingByte.QuadPart + 1);
+            if (Entry->Exclusive.FileLock.StartingByte.QuadPart < LockInfo->LowestStart.QuadPart)
+                LockInfo->LowestStart = Entry->Exclusive.FileLock.StartingByte;
+            if (EntryEnd > LockInfo->HighestEnd.QuadPart)
+                LockInfo->HighestEnd.QuadPart = EntryEnd;
+        }
+        LockInfo->BoundsStale = FALSE;
+    }
+
+    /* Empty I/O at the start of a lock still matches it in the table */
+    return (Start >= LockInfo->HighestEnd.QuadPart) ||
+           ((End <= LockInfo->LowestStart.QuadPart) &&
+            (Start < LockInfo->LowestStart.QuadPart));
+}
+
 VOID
 NTAPI
 FsRtlpExpandLockElement
@@ -317,6 +386,7 @@ FsRtlpRebuildSharedLockRange
          sizeof(NewElement),
          &InsertedNew);
     ASSERT(InsertedNew);
+    if (Conflict) FsRtlpAddLockBounds(LockInfo, Conflict);
     return Conflict;
 }
 
@@ -393,6 +463,7 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
 
         LockInfo->BelongsTo = FileLock;
         InitializeListHead(&LockInfo->SharedLocks);
+        LockInfo->BoundsStale = TRUE;
         
         RtlInitializeGenericTable
             (&LockInfo->RangeTable,
@@ -613,6 +684,7 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
     }
     else
     {
+        FsRtlpAddLockBounds(LockInfo, Conflict);
         DPRINT("Inserted new lock %wZ %08x%08x %08x%08x exclusive %u\n",
                &FileObject->FileName,
                Conflict->Exclusive.FileLock.StartingByte.HighPart,
@@ -685,14 +757,16 @@ FsRtlCheckLockForReadAccess(IN PFILE_LOCK FileLock,
            IoStack->Parameters.Read.ByteOffset.HighPart,
            IoStack->Parameters.Read.ByteOffset.LowPart,
            IoStack->Parameters.Read.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
     ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Read.ByteOffset;
     ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
         ToFind.Exclusive.FileLock.StartingByte.QuadPart + 
         IoStack->Parameters.Read.Length;
+    if (FsRtlpNoLockInRange(FileLock->LockInformation,
+                            ToFind.Exclusive.FileLock.StartingByte.QuadPart,
+                            ToFind.Exclusive.FileLock.EndingByte.QuadPart)) {
+        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
+        return TRUE;
+    }
     Found = RtlLookupElementGenericTable
         (FileLock->LockInformation,
          &ToFind);
@@ -724,14 +798,16 @@ FsRtlCheckLockForWriteAccess(IN PFILE_LOCK FileLock,
            IoStack->Parameters.Write.ByteOffset.HighPart,
            IoStack->Parameters.Write.ByteOffset.LowPart,
            IoStack->Parameters.Write.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
     ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Write.ByteOffset;
     ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
         ToFind.Exclusive.FileLock.StartingByte.QuadPart + 
         IoStack->Parameters.Write.Length;
+    if (FsRtlpNoLockInRange(FileLock->LockInformation,
+                            ToFind.Exclusive.FileLock.StartingByte.QuadPart,
+                            ToFind.Exclusive.FileLock.EndingByte.QuadPart)) {
+        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
+        return TRUE;
+    }
     Found = RtlLookupElementGenericTable
         (FileLock->LockInformation,
          &ToFind);
@@ -769,7 +845,9 @@ FsRtlFastCheckLockForRead(IN PFILE_LOCK FileLock,
     ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
     ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
         FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) return TRUE;
+    if (FsRtlpNoLockInRange(FileLock->LockInformation,
+                            ToFind.Exclusive.FileLock.StartingByte.QuadPart,
+                            ToFind.Exclusive.FileLock.EndingByte.QuadPart)) return TRUE;
     Found = RtlLookupElementGenericTable
         (FileLock->LockInformation,
          &ToFind);
@@ -804,7 +882,9 @@ FsRtlFastCheckLockForWrite(IN PFILE_LOCK FileLock,
     ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
     ToFind.Exclusive.FileLock.EndingByte.QuadPart = 
         FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) {
+    if (FsRtlpNoLockInRange(FileLock->LockInformation,
+                            ToFind.Exclusive.FileLock.StartingByte.QuadPart,
+                            ToFind.Exclusive.FileLock.EndingByte.QuadPart)) {
         DPRINT("CheckForWrite(%wZ) => TRUE\n", &FileObject->FileName);
         return TRUE;
     }
@@ -890,6 +970,7 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
         RtlCopyMemory(&Find, Entry, sizeof(Find));
         // Remove the old exclusive lock region
         RtlDeleteElementGenericTable(&InternalInfo->RangeTable, Entry);
+        InternalInfo->BoundsStale = TRUE;
     }
     else
     {
@@ -936,6 +1017,7 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
             /* Remember what was in there and remove it from the table */
             Find = *Entry;
             RtlDeleteElementGenericTable(&InternalInfo->RangeTable, &Find);
+            InternalInfo->BoundsStale = TRUE;
             /* Put shared locks back in place */
             for (SharedEntry = InternalInfo->SharedLocks.Flink;
                  SharedEntry != &InternalInfo->SharedLocks;
@@ -32,7 +32,8 @@ typedef struct _LARGE_MCB_MAPPING_ENTRY // run
 
 typedef struct _LARGE_MCB_MAPPING // mcb_priv
 {
-    RTL_GENERIC_TABLE Table;
+    RTL_AVL_TABLE Table;
+    PLARGE_MCB_MAPPING_ENTRY LastRun; /* last run found, sequential I/O hits it again */
 } LARGE_MCB_MAPPING, *PLARGE_MCB_MAPPING;
 
 typedef struct _BASE_MCB_INTERNAL {
@@ -51,7 +52,7 @@ static LARGE_MCB_MAPPING_ENTRY StaticRunBelow0 = {
 };
 */
 
-static PVOID NTAPI McbMappingAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
+static PVOID NTAPI McbMappingAllocate(PRTL_AVL_TABLE Table, CLONG Bytes)
 {
     PVOID Result;
     PBASE_MCB Mcb = (PBASE_MCB)Table->TableContext;
@@ -60,16 +61,19 @@ static PVOID NTAPI McbMappingAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
     return Result;
 }
 
-static VOID NTAPI McbMappingFree(PRTL_GENERIC_TABLE Table, PVOID Buffer)
+static VOID NTAPI McbMappingFree(PRTL_AVL_TABLE Table, PVOID Buffer)
 {
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)Table->TableContext;
     DPRINT("McbMappingFree(%p)\n", Buffer);
+    /* Whichever run goes away, don't keep pointing to it */
+    Mcb->Mapping->LastRun = NULL;
     ExFreePoolWithTag(Buffer, 'BCML');
 }
 
 static
 RTL_GENERIC_COMPARE_RESULTS
 NTAPI
-McbMappingCompare(PRTL_GENERIC_TABLE Table,
+McbMappingCompare(PRTL_AVL_TABLE Table,
                   PVOID PtrA,
                   PVOID PtrB)
 {
@@ -94,7 +98,7 @@ McbMappingCompare(PRTL_GENERIC_TABLE Table,
     return Res;
 }
 
-static RTL_GENERIC_COMPARE_RESULTS NTAPI McbMappingIntersectCompare(PRTL_GENERIC_TABLE Table, PVOID PtrA, PVOID PtrB)
+static RTL_GENERIC_COMPARE_RESULTS NTAPI McbMappingIntersectCompare(PRTL_AVL_TABLE Table, PVOID PtrA, PVOID PtrB)
 {
     PLARGE_MCB_MAPPING_ENTRY A = PtrA, B = PtrB;
     RTL_GENERIC_COMPARE_RESULTS Res;
@@ -186,14 +190,14 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
     NeedleRun.StartingLbn.QuadPart = ~0ULL;
     Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((LowerRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
+    if ((LowerRun = RtlLookupElementGenericTableAvl(&Mcb->Mapping->Table, &NeedleRun)) &&
         (LowerRun->StartingLbn.QuadPart + (LowerRun->RunEndVbn.QuadPart - LowerRun->RunStartVbn.QuadPart) == Node.StartingLbn.QuadPart))
     {
         ASSERT(LowerRun->RunEndVbn.QuadPart == Node.RunStartVbn.QuadPart);
         Node.RunStartVbn.QuadPart = LowerRun->RunStartVbn.QuadPart;
         Node.StartingLbn.QuadPart = LowerRun->StartingLbn.QuadPart;
         Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, LowerRun);
+        RtlDeleteElementGenericTableAvl(&Mcb->Mapping->Table, LowerRun);
         --Mcb->PairCount;
         DPRINT("Intersecting lower run found (%I64d,%I64d) Lbn: %I64d\n", LowerRun->RunStartVbn.QuadPart, LowerRun->RunEndVbn.QuadPart, LowerRun->StartingLbn.QuadPart);
     }
@@ -202,20 +206,20 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     NeedleRun.RunStartVbn.QuadPart = Node.RunEndVbn.QuadPart;
     NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
     Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((HigherRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
+    if ((HigherRun = RtlLookupElementGenericTableAvl(&Mcb->Mapping->Table, &NeedleRun)) &&
         (Node.StartingLbn.QuadPart <= HigherRun->StartingLbn.QuadPart))
     {
         ASSERT(HigherRun->RunStartVbn.QuadPart == Node.RunEndVbn.QuadPart);
         Node.RunEndVbn.QuadPart = HigherRun->RunEndVbn.QuadPart;
         Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HigherRun);
+        RtlDeleteElementGenericTableAvl(&Mcb->Mapping->Table, HigherRun);
         --Mcb->PairCount;
         DPRINT("Intersecting higher run found (%I64d,%I64d) Lbn: %I64d\n", HigherRun->RunStartVbn.QuadPart, HigherRun->RunEndVbn.QuadPart, HigherRun->StartingLbn.QuadPart);
     }
     Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
 
     /* finally insert the resulting run */
-    RtlInsertElementGenericTable(&Mcb->Mapping->Table, &Node, sizeof(Node), &NewElement);
+    RtlInsertElementGenericTableAvl(&Mcb->Mapping->Table, &Node, sizeof(Node), &NewElement);
     ++Mcb->PairCount;
     ASSERT(NewElement);
 
@@ -337,9 +341,9 @@ FsRtlGetNextBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     ULONGLONG LastSectorCount = 0;
 
     // Traverse the tree 
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
+    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, TRUE);
     Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, FALSE))
     {
         // is the current index a hole?
         if (Run->RunStartVbn.QuadPart > (LastVbn + LastSectorCount))
@@ -435,11 +439,12 @@ FsRtlInitializeBaseMcb(IN PBASE_MCB OpaqueMcb,
     Mcb->PoolType = PoolType;
     Mcb->PairCount = 0;
     Mcb->MaximumPairCount = MAXIMUM_PAIR_COUNT;
-    RtlInitializeGenericTable(&Mcb->Mapping->Table,
-                              McbMappingCompare,
-                              McbMappingAllocate,
-                              McbMappingFree,
-                              Mcb);
+    Mcb->Mapping->LastRun = NULL;
+    RtlInitializeGenericTableAvl(&Mcb->Mapping->Table,
+                                 McbMappingCompare,
+                                 McbMappingAllocate,
+                                 McbMappingFree,
+                                 Mcb);
 }
 
 /*
@@ -512,34 +517,94 @@ FsRtlLookupBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     BOOLEAN Result = FALSE;
     ULONG i;
     LONGLONG LastVbn = 0, LastLbn = 0, Count = 0;   // the last values we've found during traversal
+    LONGLONG LastEndVbn;
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    LARGE_MCB_MAPPING_ENTRY NeedleRun;
+    PLARGE_MCB_MAPPING_ENTRY Run;
+    PVOID RestartKey;
 
     DPRINT("FsRtlLookupBaseMcbEntry(%p, %I64d, %p, %p, %p, %p, %p)\n", OpaqueMcb, Vbn, Lbn, SectorCountFromLbn, StartingLbn, SectorCountFromStartingLbn, Index);
 
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &LastVbn, &LastLbn, &Count); i++)
+    // unless the run index is wanted, a mapped Vbn can be searched in the tree directly
+    if (!Index && Vbn >= 0)
     {
-        // have we reached the target mapping?
-        if (Vbn < LastVbn + Count)
+        // try the run we found last time first
+        Run = Mcb->Mapping->LastRun;
+        if (!Run || Vbn < Run->RunStartVbn.QuadPart || Vbn >= Run->RunEndVbn.QuadPart)
         {
-            if (Lbn)
-            {
-                if (LastLbn == -1)
-                    *Lbn = -1;
-                else
-                    *Lbn = LastLbn + (Vbn - LastVbn);
-            }
+            NeedleRun.RunStartVbn.QuadPart = Vbn;
+            NeedleRun.RunEndVbn.QuadPart = Vbn + 1;
+            NeedleRun.StartingLbn.QuadPart = ~0ULL;
+            Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
+            Run = RtlLookupElementGenericTableAvl(&Mcb->Mapping->Table, &NeedleRun);
+            Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
+        }
 
+        if (Run)
+        {
+            Mcb->Mapping->LastRun = Run;
+
+            if (Lbn)
+                *Lbn = Run->StartingLbn.QuadPart + (Vbn - Run->RunStartVbn.QuadPart);
             if (SectorCountFromLbn)
-                *SectorCountFromLbn = LastVbn + Count - Vbn;
+                *SectorCountFromLbn = Run->RunEndVbn.QuadPart - Vbn;
             if (StartingLbn)
-                *StartingLbn = LastLbn;
+                *StartingLbn = Run->StartingLbn.QuadPart;
             if (SectorCountFromStartingLbn)
-                *SectorCountFromStartingLbn = LastVbn + Count - LastVbn;
-            if (Index)
-                *Index = i;
+                *SectorCountFromStartingLbn = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
 
             Result = TRUE;
             goto quit;
         }
+
+        // a hole or past the end, the walk below sorts it out
+    }
+
+    // walk the runs once, counting the holes between them as runs too
+    i = 0;
+    LastEndVbn = 0;
+    RestartKey = NULL;
+    while ((Run = RtlEnumerateGenericTableWithoutSplayingAvl(&Mcb->Mapping->Table, &RestartKey)))
+    {
+        if (Run->RunStartVbn.QuadPart > LastEndVbn)
+        {
+            LastVbn = LastEndVbn;
+            LastLbn = -1;
+            Count = Run->RunStartVbn.QuadPart - LastEndVbn;
+            if (Vbn < LastVbn + Count) break;
+            i++;
+        }
+
+        LastVbn = Run->RunStartVbn.QuadPart;
+        LastLbn = Run->StartingLbn.QuadPart;
+        Count = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+        if (Vbn < LastVbn + Count) break;
+        i++;
+        LastEndVbn = Run->RunEndVbn.QuadPart;
+    }
+
+    // have we reached the target mapping?
+    if (Run)
+    {
+        if (Lbn)
+        {
+            if (LastLbn == -1)
+                *Lbn = -1;
+            else
+                *Lbn = LastLbn + (Vbn - LastVbn);
+        }
+
+        if (SectorCountFromLbn)
+            *SectorCountFromLbn = LastVbn + Count - Vbn;
+        if (StartingLbn)
+            *StartingLbn = LastLbn;
+        if (SectorCountFromStartingLbn)
+            *SectorCountFromStartingLbn = LastVbn + Count - LastVbn;
+        if (Index)
+            *Index = i;
+
+        Result = TRUE;
+        goto quit;
     }
 
     if (Lbn)
@@ -602,9 +667,9 @@ FsRtlLookupLastLargeMcbEntryAndIndex_internal(IN PBASE_MCB_INTERNAL Mcb,
     PLARGE_MCB_MAPPING_ENTRY Run, RunFound = NULL;
     LONGLONG LastVbn = 0;
 
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
+    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, TRUE);
         Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, FALSE))
     {
         /* Take care when we must emulate missing 'hole' runs. */
         if (Run->RunStartVbn.QuadPart > LastVbn)
@@ -746,15 +811,21 @@ NTAPI
 FsRtlNumberOfRunsInBaseMcb(IN PBASE_MCB OpaqueMcb)
 {
     ULONG NumberOfRuns = 0;
-    LONGLONG Vbn, Lbn, Count;
-    int i;
+    LONGLONG LastEndVbn = 0;
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    PLARGE_MCB_MAPPING_ENTRY Run;
+    PVOID RestartKey = NULL;
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p)\n", OpaqueMcb);
 
-    // Count how many Mcb entries there are
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &Vbn, &Lbn, &Count); i++)
+    // Count how many Mcb entries there are, holes between runs included
+    while ((Run = RtlEnumerateGenericTableWithoutSplayingAvl(&Mcb->Mapping->Table, &RestartKey)))
     {
+        if (Run->RunStartVbn.QuadPart > LastEndVbn)
+            NumberOfRuns++;
+
         NumberOfRuns++;
+        LastEndVbn = Run->RunEndVbn.QuadPart;
     }
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p) = %d\n", OpaqueMcb, NumberOfRuns);
@@ -825,7 +896,7 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
 
     /* adjust/destroy all intersecting ranges */
     Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    while ((HaystackRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)))
+    while ((HaystackRun = RtlLookupElementGenericTableAvl(&Mcb->Mapping->Table, &NeedleRun)))
     {
         if (HaystackRun->RunStartVbn.QuadPart < NeedleRun.RunStartVbn.QuadPart)
         {
@@ -842,7 +913,7 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
             //ASSERT(NeedleRun.RunStartVbn.QuadPart >= HaystackRun->RunStartVbn.QuadPart);
             //ASSERT(NeedleRun.RunEndVbn.QuadPart <= HaystackRun->RunEndVbn.QuadPart);
             Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-            RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HaystackRun);
+            RtlDeleteElementGenericTableAvl(&Mcb->Mapping->Table, HaystackRun);
             --Mcb->PairCount;
             Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
         }
@@ -882,10 +953,9 @@ FsRtlResetBaseMcb(IN PBASE_MCB OpaqueMcb)
 
     DPRINT("FsRtlResetBaseMcb(%p)\n", OpaqueMcb);
 
-    while (RtlNumberGenericTableElements(&Mcb->Mapping->Table) &&
-           (Element = (PLARGE_MCB_MAPPING_ENTRY)RtlGetElementGenericTable(&Mcb->Mapping->Table, 0)))
+    while ((Element = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, TRUE)))
     {
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, Element);
+        RtlDeleteElementGenericTableAvl(&Mcb->Mapping->Table, Element);
     }
 
     Mcb->PairCount = 0;
@@ -927,9 +997,9 @@ FsRtlSplitBaseMcb(IN PBASE_MCB OpaqueMcb,
     DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d)\n", OpaqueMcb, Vbn, Amount);
 
     /* Traverse the tree */
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
+    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, TRUE);
         Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTableAvl(&Mcb->Mapping->Table, FALSE))
     {
         /* unaffected run? */
         /* FIXME: performance: effective skip of all 'lower' runs without traversing them */
@@ -960,7 +1030,7 @@ FsRtlSplitBaseMcb(IN PBASE_MCB OpaqueMcb,
 
     if (InsertLowerRun)
     {
-        ExistingRun = RtlInsertElementGenericTable(&Mcb->Mapping->Table, InsertLowerRun, sizeof(*InsertLowerRun), &NewElement);
+        ExistingRun = RtlInsertElementGenericTableAvl(&Mcb->Mapping->Table, InsertLowerRun, sizeof(*InsertLowerRun), &NewElement);
         ++Mcb->PairCount;
     }
 
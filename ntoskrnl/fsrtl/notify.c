@@ -63,6 +63,146 @@ FsRtlNotifyReleaseFastMutex(IN PREAL_NOTIFY_SYNC RealNotifySync)
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+static
+ULONG
+FsRtlNotifyHashName(IN PCHAR Buffer,
+                    IN USHORT Length)
+{
+    ULONG Hash = 0;
+    USHORT i;
+
+    /* Names are compared byte for byte, so hash them the same way */
+    for (i = 0; i < Length; i++)
+    {
+        Hash = Hash * 31 + (UCHAR)Buffer[i];
+    }
+
+    return Hash % FSRTL_NOTIFY_HASH_BUCKETS;
+}
+
+/*
+ * Watchers of a non-root Unicode directory go in the bucket of their name,
+ * everything else (ANSI names, root, streams) is always looked at
+ */
+static
+VOID
+FsRtlNotifyIndexChange(IN PREAL_NOTIFY_SYNC RealNotifySync,
+                       IN PNOTIFY_CHANGE NotifyChange)
+{
+    PSTRING Name = NotifyChange->FullDirectoryName;
+
+    if ((Name != NULL) &&
+        (NotifyChange->CharacterSize == sizeof(WCHAR)) &&
+        (Name->Length > sizeof(WCHAR)))
+    {
+        NotifyChange->IndexedLength = Name->Length;
+        InsertTailList(&RealNotifySync->HashBuckets[FsRtlNotifyHashName(Name->Buffer, Name->Length)],
+                       &NotifyChange->IndexLink);
+    }
+    else
+    {
+        NotifyChange->IndexedLength = 0;
+        InsertTailList(&RealNotifySync->UnindexedList, &NotifyChange->IndexLink);
+    }
+}
+
+/*
+ * The directory names belong to the FSD and follow renames, so rehash
+ * everything once a directory was renamed or deleted
+ */
+static
+VOID
+FsRtlNotifyRebuildIndex(IN PREAL_NOTIFY_SYNC RealNotifySync)
+{
+    ULONG i;
+    LIST_ENTRY Watchers;
+    PLIST_ENTRY NextEntry;
+
+    InitializeListHead(&Watchers);
+    for (i = 0; i < FSRTL_NOTIFY_HASH_BUCKETS; i++)
+    {
+        while (!IsListEmpty(&RealNotifySync->HashBuckets[i]))
+        {
+            NextEntry = RemoveHeadList(&RealNotifySync->HashBuckets[i]);
+            InsertTailList(&Watchers, NextEntry);
+        }
+    }
+    while (!IsListEmpty(&RealNotifySync->UnindexedList))
+    {
+        NextEntry = RemoveHeadList(&RealNotifySync->UnindexedList);
+        InsertTailList(&Watchers, NextEntry);
+    }
+
+    while (!IsListEmpty(&Watchers))
+    {
+        NextEntry = RemoveHeadList(&Watchers);
+        FsRtlNotifyIndexChange(RealNotifySync,
+                               CONTAINING_RECORD(NextEntry, NOTIFY_CHANGE, IndexLink));
+    }
+
+    RealNotifySync->IndexDirty = FALSE;
+}
+
+/*
+ * Finds the watchers of the list that may care about a change in ParentName:
+ * the ones on it or on one of its parents, and the unindexed ones.
+ * Returns FALSE if there are too many and the whole list must be walked.
+ */
+static
+BOOLEAN
+FsRtlNotifyFindCandidates(IN PREAL_NOTIFY_SYNC RealNotifySync,
+                          IN PLIST_ENTRY NotifyList,
+                          IN PSTRING ParentName,
+                          OUT PNOTIFY_CHANGE *Candidates,
+                          OUT PULONG CandidateCount)
+{
+    ULONG Count = 0;
+    USHORT Length;
+    PLIST_ENTRY Head, NextEntry;
+    PNOTIFY_CHANGE NotifyChange;
+
+    /* An ANSI name can't match any indexed watcher */
+    if (ParentName->Length % sizeof(WCHAR)) goto Unindexed;
+
+    /* Try every prefix ending before a separator, then the name itself */
+    for (Length = sizeof(WCHAR); Length <= ParentName->Length; Length += sizeof(WCHAR))
+    {
+        if ((Length != ParentName->Length) &&
+            (((PWSTR)ParentName->Buffer)[Length / sizeof(WCHAR)] != L'\'))
+        {
+            continue;
+        }
+
+        Head = &RealNotifySync->HashBuckets[FsRtlNotifyHashName(ParentName->Buffer, Length)];
+        for (NextEntry = Head->Flink; NextEntry != Head; NextEntry = NextEntry->Flink)
+        {
+            NotifyChange = CONTAINING_RECORD(NextEntry, NOTIFY_CHANGE, IndexLink);
+            if (NotifyChange->NotifyListHead != NotifyList ||
+                NotifyChange->IndexedLength != Length)
+            {
+                continue;
+            }
+
+            if (Count == FSRTL_NOTIFY_MAX_CANDIDATES) return FALSE;
+            Candidates[Count++] = NotifyChange;
+        }
+    }
+
+Unindexed:
+    Head = &RealNotifySync->UnindexedList;
+    for (NextEntry = Head->Flink; NextEntry != Head; NextEntry = NextEntry->Flink)
+    {
+        NotifyChange = CONTAINING_RECORD(NextEntry, NOTIFY_CHANGE, IndexLink);
+        if (NotifyChange->NotifyListHead != NotifyList) continue;
+
+        if (Count == FSRTL_NOTIFY_MAX_CANDIDATES) return FALSE;
+        Candidates[Count++] = NotifyChange;
+    }
+
+    *CandidateCount = Count;
+    return TRUE;
+}
+
 VOID
 FsRtlNotifyCompleteIrpList(IN PNOTIFY_CHANGE NotifyChange,
                            IN NTSTATUS Status);
@@ -211,6 +351,7 @@ FsRtlCancelNotify(IN PDEVICE_OBJECT DeviceObject,
 
            /* We mustn't have ANY change left anymore */
            ASSERT(NotifyChange->NotifyList.Flink == NULL);
+           RemoveEntryList(&NotifyChange->IndexLink);
            ExFreePoolWithTag(NotifyChange, 0);
        }
     }
@@ -664,8 +805,10 @@ FsRtlNotifyCleanup(IN PNOTIFY_SYNC NotifySync,
             /* Decrease reference number and if 0 is reached, it's time to do complete cleanup */
             if (!InterlockedDecrement((PLONG)&(NotifyChange->ReferenceCount)))
             {
-                /* Remove it from the notifications list */
+                /* Remove it from the notifications list and the index */
                 RemoveEntryList(&NotifyChange->NotifyList);
+                RemoveEntryList(&NotifyChange->IndexLink);
+                InitializeListHead(&NotifyChange->IndexLink);
 
                 /* In case there was an allocated buffer, free it */
                 if (NotifyChange->AllocatedBuffer)
@@ -895,8 +1038,10 @@ FsRtlNotifyFilterChangeDirectory(IN PNOTIFY_SYNC NotifySync,
 
         NotifyChange->OwningProcess = NotifyIrp->Tail.Overlay.Thread->ThreadsProcess;
 
-        /* Insert the notification into the notification list */
+        /* Insert the notification into the notification list and the index */
         InsertTailList(NotifyList, &(NotifyChange->NotifyList));
+        NotifyChange->NotifyListHead = NotifyList;
+        FsRtlNotifyIndexChange(RealNotifySync, NotifyChange);
 
         NotifyChange->ReferenceCount = 1;
 
@@ -993,6 +1138,10 @@ FsRtlNotifyFilterReportChange(IN PNOTIFY_SYNC NotifySync,
     STRING TargetDirectory, TargetName, ParentName, IntNormalizedParentName;
     ULONG NumberOfBytes, TargetNumberOfParts, FullNumberOfParts, LastPartOffset, ParentNameOffset, ParentNameLength;
     ULONG DataLength, AlignedDataLength;
+    PNOTIFY_CHANGE Candidates[FSRTL_NOTIFY_MAX_CANDIDATES];
+    ULONG CandidateCount, CandidateIndex;
+    BOOLEAN UseCandidates;
+    STRING CandidateParentName;
 
     TargetDirectory.Length = 0;
     TargetDirectory.MaximumLength = 0;
@@ -1023,12 +1172,61 @@ FsRtlNotifyFilterReportChange(IN PNOTIFY_SYNC NotifySync,
     FsRtlNotifyAcquireFastMutex(RealNotifySync);
     _SEH2_TRY
     {
-        /* Browse all the registered notifications we have */
-        for (NextEntry = NotifyList->Flink; NextEntry != NotifyList;
-             NextEntry = NextEntry->Flink)
+        /* Only look at the watchers of the parents of the target, if we can */
+        UseCandidates = FALSE;
+        if (FullTargetName != NULL)
+        {
+            if (RealNotifySync->IndexDirty)
+            {
+                FsRtlNotifyRebuildIndex(RealNotifySync);
+            }
+
+            if (NormalizedParentName != NULL)
+            {
+                CandidateParentName = *NormalizedParentName;
+            }
+            else
+            {
+                CandidateParentName.Buffer = FullTargetName->Buffer;
+                CandidateParentName.Length = TargetNameOffset;
+                if (TargetNameOffset != sizeof(WCHAR))
+                {
+                    CandidateParentName.Length -= sizeof(WCHAR);
+                }
+                CandidateParentName.MaximumLength = CandidateParentName.Length;
+            }
+
+            UseCandidates = FsRtlNotifyFindCandidates(RealNotifySync,
+                                                      NotifyList,
+                                                      &CandidateParentName,
+                                                      Candidates,
+                                                      &CandidateCount);
+
+            /* A directory may have been renamed or deleted, rehash next time */
+            if ((FilterMatch & FILE_NOTIFY_CHANGE_DIR_NAME) && Action != FILE_ACTION_ADDED)
+            {
+                RealNotifySync->IndexDirty = TRUE;
+            }
+        }
+
+        /* Browse the registered notifications that may match */
+        NextEntry = NotifyList;
+        CandidateIndex = 0;
+        while (TRUE)
         {
             /* Try to find an entry matching our change */
-            NotifyChange = CONTAINING_RECORD(NextEntry, NOTIFY_CHANGE, NotifyList);
+            if (UseCandidates)
+            {
+                if (CandidateIndex == CandidateCount) break;
+                NotifyChange = Candidates[CandidateIndex++];
+            }
+            else
+            {
+                NextEntry = NextEntry->Flink;
+                if (NextEntry == NotifyList) break;
+                NotifyChange = CONTAINING_RECORD(NextEntry, NOTIFY_CHANGE, NotifyList);
+            }
+
             if (FullTargetName != NULL)
             {
                 ASSERT(NotifyChange->FullDirectoryName != NULL);
@@ -1560,6 +1758,7 @@ VOID
 NTAPI
 FsRtlNotifyInitializeSync(IN PNOTIFY_SYNC *NotifySync)
 {
+    ULONG i;
     PREAL_NOTIFY_SYNC RealNotifySync;
 
     *NotifySync = NULL;
@@ -1569,6 +1768,12 @@ FsRtlNotifyInitializeSync(IN PNOTIFY_SYNC *NotifySync)
     ExInitializeFastMutex(&(RealNotifySync->FastMutex));
     RealNotifySync->OwningThread = 0;
     RealNotifySync->OwnerCount = 0;
+    RealNotifySync->IndexDirty = FALSE;
+    InitializeListHead(&RealNotifySync->UnindexedList);
+    for (i = 0; i < FSRTL_NOTIFY_HASH_BUCKETS; i++)
+    {
+        InitializeListHead(&RealNotifySync->HashBuckets[i]);
+    }
 
     *NotifySync = RealNotifySync;
 }
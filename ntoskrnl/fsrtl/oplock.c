@@ -308,6 +308,41 @@ FsRtlRemoveAndCompleteIrp(IN PIRP Irp)
     IoCompleteRequest(Irp, IO_DISK_INCREMENT);
 }
 
+VOID
+FsRtlCompleteOplockIIIrps(IN PLIST_ENTRY IrpList)
+{
+    PLIST_ENTRY NextEntry;
+    PIRP ListIrp;
+    KIRQL OldIrql;
+
+    DPRINT("FsRtlCompleteOplockIIIrps(%p)\n", IrpList);
+
+    /* Remove all our cancel routines at once */
+    IoAcquireCancelSpinLock(&OldIrql);
+    for (NextEntry = IrpList->Flink;
+         NextEntry != IrpList;
+         NextEntry = NextEntry->Flink)
+    {
+        ListIrp = CONTAINING_RECORD(NextEntry, IRP, Tail.Overlay.ListEntry);
+        IoSetCancelRoutine(ListIrp, NULL);
+    }
+    IoReleaseCancelSpinLock(OldIrql);
+
+    /* Then tell every holder its level 2 oplock is gone */
+    while (!IsListEmpty(IrpList))
+    {
+        NextEntry = RemoveHeadList(IrpList);
+        ListIrp = CONTAINING_RECORD(NextEntry, IRP, Tail.Overlay.ListEntry);
+
+        /* Remove our extra ref */
+        ObDereferenceObject(IoGetCurrentIrpStackLocation(ListIrp)->FileObject);
+
+        ListIrp->IoStatus.Information = FILE_OPLOCK_BROKEN_TO_NONE;
+        ListIrp->IoStatus.Status = (ListIrp->Cancel ? STATUS_CANCELLED : STATUS_SUCCESS);
+        IoCompleteRequest(ListIrp, IO_DISK_INCREMENT);
+    }
+}
+
 VOID
 NTAPI
 FsRtlCancelOplockIIIrp(IN PDEVICE_OBJECT DeviceObject,
@@ -909,7 +944,7 @@ FsRtlOplockBreakToNone(IN PINTERNAL_OPLOCK Oplock,
 {
     PLIST_ENTRY NextEntry;
     PWAIT_CONTEXT WaitCtx;
-    PIRP ListIrp;
+    LIST_ENTRY BrokenIrps;
     KEVENT WaitEvent;
 
     DPRINT("FsRtlOplockBreakToNone(%p, %p, %p, %p, %p, %p)\n", Oplock, Stack, Irp, Context, CompletionRoutine, PostIrpRoutine);
@@ -976,20 +1011,20 @@ FsRtlOplockBreakToNone(IN PINTERNAL_OPLOCK Oplock,
     /* Shared lock */
     else if (Oplock->Flags == LEVEL_2_OPLOCK)
     {
-        /* Complete any IRP in the shared lock */
-        for (NextEntry = Oplock->SharedListHead.Flink;
-             NextEntry != &Oplock->SharedListHead;
-             NextEntry = NextEntry->Flink)
+        /* Take all the IRPs of the shared lock */
+        InitializeListHead(&BrokenIrps);
+        while (!IsListEmpty(&Oplock->SharedListHead))
         {
-            ListIrp = CONTAINING_RECORD(NextEntry, IRP, Tail.Overlay.ListEntry);
-            FsRtlRemoveAndCompleteIrp(ListIrp);
+            NextEntry = RemoveHeadList(&Oplock->SharedListHead);
+            InsertTailList(&BrokenIrps, NextEntry);
         }
 
         /* No lock left */
         Oplock->Flags = NO_OPLOCK;
-
-        /* Done */
         ExReleaseFastMutexUnsafe(Oplock->IntLock);
+
+        /* And complete them together, out of the oplock lock */
+        FsRtlCompleteOplockIIIrps(&BrokenIrps);
         return STATUS_SUCCESS;
     }
     /* If it was broken to level 2, break it to none from level 2 */
@@ -1181,8 +1216,10 @@ FsRtlCheckOplock(IN POPLOCK Oplock,
     FILE_INFORMATION_CLASS FileInfo;
     ULONG CreateDisposition;
 
+    /* Only an exclusive oplock can be broken to level 2, don't lock for the others */
 #define BreakToIIIfRequired                                                               \
-    if (IntOplock->Flags != LEVEL_2_OPLOCK || IntOplock->FileObject != Stack->FileObject) \
+    if (BooleanFlagOn(IntOplock->Flags, EXCLUSIVE_LOCK) &&                                \
+        (IntOplock->Flags != LEVEL_2_OPLOCK || IntOplock->FileObject != Stack->FileObject)) \
         return FsRtlOplockBreakToII(IntOplock, Stack, Irp, Context, CompletionRoutine, PostIrpRoutine)
 
 #define BreakToNoneIfRequired                                                             \
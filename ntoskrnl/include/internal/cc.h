@@ -40,7 +40,6 @@
 // Global Cc Data
 //
 extern ULONG CcRosTraceLevel;
-extern LIST_ENTRY DirtyVacbListHead;
 extern ULONG CcDirtyPageThreshold;
 extern ULONG CcTotalDirtyPages;
 extern LIST_ENTRY CcDeferredWrites;
@@ -52,6 +51,7 @@ extern LIST_ENTRY CcRegularWorkQueue;
 extern LIST_ENTRY CcPostTickWorkQueue;
 extern NPAGED_LOOKASIDE_LIST CcTwilightLookasideList;
 extern LARGE_INTEGER CcIdleDelay;
+extern ULONG CcMaximumReadAheadLength;
 
 //
 // Counters
@@ -188,6 +188,9 @@ typedef struct _ROS_SHARED_CACHE_MAP
 
     /* ROS specific */
     LIST_ENTRY CacheMapVacbListHead;
+    /* Sparse index of the VACBs, by file offset (protected by CacheMapLock) */
+    struct _ROS_VACB ***VacbIndex;
+    ULONG VacbIndexLeaves;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
 #if DBG
@@ -198,6 +201,24 @@ typedef struct _ROS_SHARED_CACHE_MAP
 #define READAHEAD_DISABLED 0x1
 #define WRITEBEHIND_DISABLED 0x2
 
+/* Each VACB index leaf maps VACB_INDEX_LEAF_SIZE consecutive views */
+#define VACB_INDEX_LEAF_SIZE 512
+
+/* The LRU and dirty VACB lists are split in shards, each with its own lock,
+ * so that cached I/O on several processors don't serialize on a single lock.
+ * A VACB stays in the shard of the processor which created it.
+ */
+#define CC_VACB_LIST_SHARDS 16
+
+typedef struct _CC_VACB_LIST_SHARD
+{
+    KSPIN_LOCK Lock;
+    LIST_ENTRY VacbLruListHead;
+    LIST_ENTRY DirtyVacbListHead;
+} CC_VACB_LIST_SHARD, *PCC_VACB_LIST_SHARD;
+
+extern CC_VACB_LIST_SHARD CcVacbListShards[CC_VACB_LIST_SHARDS];
+
 typedef struct _ROS_VACB
 {
     /* Base address of the region where the view's data is mapped. */
@@ -223,7 +244,10 @@ typedef struct _ROS_VACB
     volatile ULONG ReferenceCount;
     /* Pointer to the shared cache map for the file which this view maps data for. */
     PROS_SHARED_CACHE_MAP SharedCacheMap;
-    /* Pointer to the next VACB in a chain. */
+    /* Shard of the LRU and dirty lists this VACB belongs to. */
+    ULONG ListShard;
+    /* Order in which the VACB was made dirty, to flush the oldest first. */
+    ULONG DirtySequence;
 } ROS_VACB, *PROS_VACB;
 
 typedef struct _INTERNAL_BCB
@@ -281,6 +305,8 @@ typedef enum _WORK_QUEUE_FUNCTIONS
 } WORK_QUEUE_FUNCTIONS, *PWORK_QUEUE_FUNCTIONS;
 
 extern LAZY_WRITER LazyWriter;
+extern BOOLEAN CcPfEnablePrefetcher;
+extern ULONG CcPfEnablePrefetcherParameter;
 
 #define NODE_TYPE_DEFERRED_WRITE 0x02FC
 #define NODE_TYPE_PRIVATE_MAP    0x02FE
@@ -293,6 +319,26 @@ CcPfInitializePrefetcher(
     VOID
 );
 
+INIT_FUNCTION
+VOID
+NTAPI
+CcPfBeginBootPhase(
+    IN ULONG Phase
+);
+
+VOID
+NTAPI
+CcPfBeginAppLaunch(
+    IN PEPROCESS Process
+);
+
+VOID
+NTAPI
+CcPfLogFileRead(
+    IN PFILE_OBJECT FileObject,
+    IN LONGLONG FileOffset
+);
+
 VOID
 NTAPI
 CcMdlReadComplete2(
@@ -470,10 +516,26 @@ VOID
 CcPerformReadAhead(
     IN PFILE_OBJECT FileObject);
 
+VOID
+NTAPI
+CcPrefetchPages(
+    IN PFILE_OBJECT FileObject,
+    IN PFILE_SEGMENT_ELEMENT Entries,
+    IN ULONG NumberOfEntries);
+
 NTSTATUS
 CcRosInternalFreeVacb(
     IN PROS_VACB Vacb);
 
+PROS_VACB
+CcRosVacbIndexLookup(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN LONGLONG FileOffset);
+
+VOID
+CcRosVacbIndexRemove(
+    IN PROS_VACB Vacb);
+
 FORCEINLINE
 BOOLEAN
 DoRangesIntersect(
@@ -60,6 +60,11 @@
 #define CM_KCB_INVALID_CACHED_INFO                      0x40
 #define CM_KCB_READ_ONLY_KEY                            0x80
 
+//
+// Number of subkey lookups remembered by a KCB
+//
+#define CM_KCB_SUBKEY_CACHE_SIZE                        4
+
 //
 // CM_KEY_BODY Types
 //
@@ -154,7 +159,6 @@ typedef struct _CM_KEY_HASH_TABLE_ENTRY
 {
     EX_PUSH_LOCK Lock;
     PKTHREAD Owner;
-    PCM_KEY_HASH Entry;
 } CM_KEY_HASH_TABLE_ENTRY, *PCM_KEY_HASH_TABLE_ENTRY;
 
 //
@@ -174,9 +178,23 @@ typedef struct _CM_NAME_HASH
 typedef struct _CM_NAME_HASH_TABLE_ENTRY
 {
     EX_PUSH_LOCK Lock;
-    PCM_NAME_HASH Entry;
 } CM_NAME_HASH_TABLE_ENTRY, *PCM_NAME_HASH_TABLE_ENTRY;
 
+//
+// Resizable Hash Chains
+//
+// The chains are spread over a multiple of CmpHashTableSize buckets, so
+// that all the entries of a bucket are still covered by a single lock of
+// CmpCacheTable or CmpNameCacheTable.
+//
+typedef struct _CM_HASH_BUCKETS
+{
+    PVOID *Buckets;
+    ULONG Size;
+    LONG Count;
+    ULONG LongestChain;
+} CM_HASH_BUCKETS, *PCM_HASH_BUCKETS;
+
 //
 // Key Security Cache
 //
@@ -220,6 +238,15 @@ typedef struct _CM_INDEX_HINT_BLOCK
     ULONG HashKey[ANYSIZE_ARRAY];
 } CM_INDEX_HINT_BLOCK, *PCM_INDEX_HINT_BLOCK;
 
+//
+// Recent Subkey Lookup
+//
+typedef struct _CM_SUBKEY_CACHE_ENTRY
+{
+    ULONG HashKey;
+    HCELL_INDEX Cell;
+} CM_SUBKEY_CACHE_ENTRY, *PCM_SUBKEY_CACHE_ENTRY;
+
 //
 // Key Body
 //
@@ -307,6 +334,9 @@ typedef struct _CM_KEY_CONTROL_BLOCK
          ULONG Flags : 16;
     };
     ULONG InDelayClose;
+    LONG SubKeyCacheNext;
+    LONG SubKeyCacheGeneration;
+    CM_SUBKEY_CACHE_ENTRY SubKeyCache[CM_KCB_SUBKEY_CACHE_SIZE];
 } CM_KEY_CONTROL_BLOCK, *PCM_KEY_CONTROL_BLOCK;
 
 //
@@ -930,6 +960,18 @@ CmpUnlockHiveFlusher(
     IN PCMHIVE Hive
 );
 
+VOID
+NTAPI
+CmpLockHiveWriter(
+    IN PCMHIVE Hive
+);
+
+VOID
+NTAPI
+CmpUnlockHiveWriter(
+    IN PCMHIVE Hive
+);
+
 //
 // Delay Functions
 //
@@ -1026,6 +1068,14 @@ CmpCleanUpSubKeyInfo(
     IN PCM_KEY_CONTROL_BLOCK Kcb
 );
 
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithCache(
+    IN PCM_KEY_CONTROL_BLOCK Kcb,
+    IN PCM_KEY_NODE Node,
+    IN PCUNICODE_STRING SearchName
+);
+
 PUNICODE_STRING
 NTAPI
 CmpConstructName(
@@ -1355,6 +1405,17 @@ CmQueryValueKey(
     IN PULONG ResultLength
 );
 
+NTSTATUS
+NTAPI
+CmQueryMultipleValueKey(
+    IN PCM_KEY_CONTROL_BLOCK Kcb,
+    IN OUT PKEY_VALUE_ENTRY ValueEntries,
+    IN ULONG EntryCount,
+    IN PVOID Buffer,
+    IN OUT PULONG BufferLength,
+    OUT PULONG RequiredLength
+);
+
 NTSTATUS
 NTAPI
 CmLoadKey(
@@ -1502,6 +1563,8 @@ extern POBJECT_TYPE CmpKeyObjectType;
 extern ERESOURCE CmpRegistryLock;
 extern PCM_KEY_HASH_TABLE_ENTRY CmpCacheTable;
 extern PCM_NAME_HASH_TABLE_ENTRY CmpNameCacheTable;
+extern CM_HASH_BUCKETS CmpKeyHashBuckets;
+extern CM_HASH_BUCKETS CmpNameHashBuckets;
 extern KGUARDED_MUTEX CmpDelayedCloseTableLock;
 extern CMHIVE CmControlHive;
 extern WCHAR CmDefaultLanguageId[];
@@ -1533,6 +1596,8 @@ extern BOOLEAN ExpInTextModeSetup;
 extern BOOLEAN InitIsWinPEMode;
 extern ULONG CmpHashTableSize;
 extern ULONG CmpDelayedCloseSize, CmpDelayedCloseIndex;
+extern ULONG CmpDelayedCloseLimit;
+extern LONG CmpDelayedCloseHits;
 extern BOOLEAN CmpNoWrite;
 extern BOOLEAN CmpForceForceFlush;
 extern BOOLEAN CmpWasSetupBoot;
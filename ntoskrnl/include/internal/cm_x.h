@@ -19,6 +19,13 @@
     GET_HASH_KEY(ConvKey) % CmpHashTableSize
 #define GET_HASH_ENTRY(Table, ConvKey)                              \
     (&Table[GET_HASH_INDEX(ConvKey)])
+
+//
+// Returns the head of the chain a convkey is on, which is protected by
+// the lock at GET_HASH_INDEX
+//
+#define GET_HASH_CHAIN(Type, Table, ConvKey)                        \
+    ((Type*)&(Table).Buckets[GET_HASH_KEY(ConvKey) % (Table).Size])
 #define ASSERT_VALID_HASH(h)                                        \
     ASSERT_KCB_VALID(CONTAINING_RECORD((h), CM_KEY_CONTROL_BLOCK, KeyHash))
 
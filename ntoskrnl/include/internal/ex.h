@@ -14,6 +14,7 @@ extern ERESOURCE ExpFirmwareTableResource;
 extern LIST_ENTRY ExpFirmwareTableProviderListHead;
 extern BOOLEAN ExpIsWinPEMode;
 extern LIST_ENTRY ExpSystemResourcesList;
+extern KSPIN_LOCK ExpResourceSpinLock;
 extern ULONG ExpAnsiCodePageDataOffset, ExpOemCodePageDataOffset;
 extern ULONG ExpUnicodeCaseTableDataOffset;
 extern PVOID ExpNlsSectionPointer;
@@ -30,6 +31,7 @@ extern KSPIN_LOCK ExpNonPagedLookasideListLock;
 extern KSPIN_LOCK ExpPagedLookasideListLock;
 extern ULONG ExCriticalWorkerThreads;
 extern ULONG ExDelayedWorkerThreads;
+extern ULONG ExpWorkPoolDisabled;
 
 extern PVOID ExpDefaultErrorPort;
 extern PEPROCESS ExpDefaultErrorPortProcess;
@@ -257,6 +259,50 @@ VOID
 NTAPI
 ExShutdownSystem(VOID);
 
+//
+// Boot Performance Timeline
+//
+extern BOOLEAN ExpBootPerfEnabled;
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+#define ExpBootPerfEarlyTimeStamp() __rdtsc()
+#define ExpBootPerfTimeStamp() __rdtsc()
+#else
+#define ExpBootPerfEarlyTimeStamp() 0ULL
+#define ExpBootPerfTimeStamp() ((ULONGLONG)KeQueryPerformanceCounter(NULL).QuadPart)
+#endif
+
+INIT_FUNCTION
+VOID
+NTAPI
+ExpBootPerfInitialize(
+    IN PLOADER_PARAMETER_BLOCK LoaderBlock,
+    IN ULONGLONG KernelStartTime
+);
+
+VOID
+NTAPI
+ExpBootPerfRecord(
+    IN ULONG Type,
+    IN PCUNICODE_STRING Name,
+    IN ULONGLONG StartTime,
+    IN ULONGLONG EndTime
+);
+
+VOID
+NTAPI
+ExpBootPerfMark(
+    IN ULONG Type,
+    IN ULONG Flags,
+    IN PCWSTR Name
+);
+
+VOID
+NTAPI
+ExpBootPerfRecordProcess(
+    IN PEPROCESS Process
+);
+
 INIT_FUNCTION
 BOOLEAN
 NTAPI
@@ -302,6 +348,11 @@ VOID
 NTAPI
 ExInitPoolLookasidePointers(VOID);
 
+INIT_FUNCTION
+VOID
+NTAPI
+ExpInitPerProcessorPoolLookasideLists(VOID);
+
 /* Callback Functions ********************************************************/
 
 VOID
@@ -59,6 +59,14 @@
 #define WATCH_ROOT         0x10
 #define DELETE_IN_PROCESS  0x20
 
+//
+// Notifications on Unicode directory names are hashed by name, so that a
+// change only visits the watchers of its parent directories. Past this many
+// of them, the change just walks the whole notify list
+//
+#define FSRTL_NOTIFY_HASH_BUCKETS   32
+#define FSRTL_NOTIFY_MAX_CANDIDATES 16
+
 //
 // Internal structure for NOTIFY_SYNC
 //
@@ -67,6 +75,9 @@ typedef struct _REAL_NOTIFY_SYNC
     FAST_MUTEX FastMutex;
     ULONG_PTR OwningThread;
     ULONG OwnerCount;
+    BOOLEAN IndexDirty;
+    LIST_ENTRY UnindexedList;
+    LIST_ENTRY HashBuckets[FSRTL_NOTIFY_HASH_BUCKETS];
 } REAL_NOTIFY_SYNC, * PREAL_NOTIFY_SYNC;
 
 //
@@ -94,6 +105,9 @@ typedef struct _NOTIFY_CHANGE
     ULONG LastEntry;
     ULONG ReferenceCount;
     PEPROCESS OwningProcess;
+    PLIST_ENTRY NotifyListHead;
+    LIST_ENTRY IndexLink;
+    USHORT IndexedLength;
 } NOTIFY_CHANGE, *PNOTIFY_CHANGE;
 
 //
@@ -57,6 +57,38 @@
 //
 #define IO_METHOD_FROM_CTL_CODE(c)                      (c & 0x00000003)
 
+//
+// Most completion packets NtRemoveIoCompletionEx returns in one call
+//
+#define IOP_MAX_COMPLETION_ENTRIES                      64
+
+//
+// IRPs come from per-processor lookaside lists in a few stack size classes:
+// the small and large IRP lists, then deeper ones in the PRCB slots after
+// the last NDK list. Only IRPs deeper than the last class use the pool.
+//
+#define IOP_IRP_CLASSES                                 5
+#define IOP_DEEP_IRP_CLASSES                            (IOP_IRP_CLASSES - 2)
+#define IOP_FIRST_DEEP_IRP_LIST                         LookasideMaximumList
+
+//
+// Deep IRPs already in the lists at boot, for each class
+//
+#define IOP_DEEP_IRP_PREALLOCATE                        4
+
+//
+// Open packets for IopCreateFile come from the PRCB slot after the deep IRPs
+//
+#define IOP_OPEN_PACKET_LIST                            (IOP_FIRST_DEEP_IRP_LIST + IOP_DEEP_IRP_CLASSES)
+
+//
+// Completion notification modes came with 2003 SP2, before our headers have
+// the information class for them
+//
+#if (NTDDI_VERSION < NTDDI_VISTA)
+#define FileIoCompletionNotificationInformation         ((FILE_INFORMATION_CLASS)(FileShortNameInformation + 1))
+#endif
+
 //
 // Bugcheck codes for RAM disk booting
 //
@@ -1418,6 +1450,9 @@ extern PDRIVER_OBJECT IopRootDriverObject;
 extern KSPIN_LOCK IopDeviceActionLock;
 extern LIST_ENTRY IopDeviceActionRequestList;
 extern RESERVE_IRP_ALLOCATOR IopReserveIrpAllocator;
+extern const CCHAR IopIrpClassStackSize[IOP_IRP_CLASSES];
+extern GENERAL_LOOKASIDE IopOpenPacketLookaside;
+extern volatile LONG IopDeviceStackGeneration;
 extern BOOLEAN IoRemoteBootClient;
 
 //
@@ -60,6 +60,100 @@ IopQueueIrpToThread(IN PIRP Irp)
     KeLowerIrql(OldIrql);
 }
 
+FORCEINLINE
+POPEN_PACKET
+IopAllocateOpenPacket(VOID)
+{
+    POPEN_PACKET OpenPacket;
+    PNPAGED_LOOKASIDE_LIST List;
+    PKPRCB Prcb = KeGetCurrentPrcb();
+
+    /* Get the P list first */
+    List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].P;
+    List->L.TotalAllocates++;
+    OpenPacket = (POPEN_PACKET)InterlockedPopEntrySList(&List->L.ListHead);
+    if (!OpenPacket)
+    {
+        /* Let the balancer know, and try the L list */
+        List->L.AllocateMisses++;
+        List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].L;
+        List->L.TotalAllocates++;
+        OpenPacket = (POPEN_PACKET)InterlockedPopEntrySList(&List->L.ListHead);
+        if (!OpenPacket)
+        {
+            /* Both lists are empty, use the pool */
+            List->L.AllocateMisses++;
+            OpenPacket = List->L.Allocate(List->L.Type, List->L.Size, List->L.Tag);
+        }
+    }
+
+    return OpenPacket;
+}
+
+FORCEINLINE
+VOID
+IopFreeOpenPacket(IN POPEN_PACKET OpenPacket)
+{
+    PNPAGED_LOOKASIDE_LIST List;
+    PKPRCB Prcb = KeGetCurrentPrcb();
+
+    /* Use the P list if it isn't full */
+    List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].P;
+    List->L.TotalFrees++;
+    if (ExQueryDepthSList(&List->L.ListHead) >= List->L.Depth)
+    {
+        /* Let the balancer know, and try the L list */
+        List->L.FreeMisses++;
+        List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].L;
+        List->L.TotalFrees++;
+        if (ExQueryDepthSList(&List->L.ListHead) >= List->L.Depth)
+        {
+            /* Both lists are full, return it to the pool */
+            List->L.FreeMisses++;
+            List->L.Free(OpenPacket);
+            return;
+        }
+    }
+
+    InterlockedPushEntrySList(&List->L.ListHead, (PSLIST_ENTRY)OpenPacket);
+}
+
+FORCEINLINE
+PDEVICE_OBJECT
+IopGetCachedAttachedDevice(IN PDEVICE_OBJECT DeviceObject)
+{
+    PEXTENDED_DEVOBJ_EXTENSION DeviceExtension = IoGetDevObjExtension(DeviceObject);
+    PDEVICE_OBJECT TopDevice;
+    LONG Generation;
+
+    /*
+     * The cached top is good as long as no device was attached or detached
+     * since it was found. Two opens can race to fill the cache, so also make
+     * sure it is still the top of a stack before using it.
+     */
+    Generation = IopDeviceStackGeneration;
+    if (DeviceExtension->CachedTopGeneration == Generation)
+    {
+        TopDevice = DeviceExtension->CachedTopDevice;
+        KeMemoryBarrier();
+        if ((TopDevice) &&
+            (DeviceExtension->CachedTopGeneration == Generation) &&
+            !(TopDevice->AttachedDevice) &&
+            ((TopDevice == DeviceObject) ||
+             (IoGetDevObjExtension(TopDevice)->AttachedTo)))
+        {
+            return TopDevice;
+        }
+    }
+
+    /* Walk the stack and remember its top for the next open */
+    TopDevice = IoGetAttachedDevice(DeviceObject);
+    DeviceExtension->CachedTopDevice = TopDevice;
+    KeMemoryBarrier();
+    DeviceExtension->CachedTopGeneration = Generation;
+    return TopDevice;
+}
+
 FORCEINLINE
 VOID
 IopUnQueueIrpFromThread(IN PIRP Irp)
@@ -63,6 +63,8 @@ typedef struct _KI_SAMPLE_MAP
 
 #define MAX_TIMER_DPCS                      16
 
+#define MAXIMUM_CCNUMA_NODES                16
+
 typedef struct _DPC_QUEUE_ENTRY
 {
     PKDPC Dpc;
@@ -78,6 +80,51 @@ typedef struct _KNMI_HANDLER_CALLBACK
     PVOID Handle;
 } KNMI_HANDLER_CALLBACK, *PKNMI_HANDLER_CALLBACK;
 
+//
+// Lock statistics, collected when booting with /LOCKSTATS
+//
+#define KI_LOCK_STAT_SPIN_LOCK              1
+#define KI_LOCK_STAT_QUEUED_LOCK            2
+#define KI_LOCK_STAT_RESOURCE               3
+
+#define KI_LOCK_STAT_CALLERS                4
+
+typedef struct _KLOCK_STATISTICS
+{
+    PVOID Address;
+    ULONG Type;
+    LONG AcquireCount;
+    LONG ContentionCount;
+    LONGLONG SpinCycles;
+    LONGLONG HoldCycles;
+    ULONGLONG AcquireTime;
+    PVOID Callers[KI_LOCK_STAT_CALLERS];
+    LONG CallerCount[KI_LOCK_STAT_CALLERS];
+} KLOCK_STATISTICS, *PKLOCK_STATISTICS;
+
+//
+// DPC and ISR durations, collected when booting with /DPCSTATS
+//
+#define KI_DPC_STAT_DPC                     1
+#define KI_DPC_STAT_THREADED_DPC            2
+#define KI_DPC_STAT_ISR                     3
+
+//
+// Bucket i counts the calls that took less than 2^i microseconds, the last
+// one everything longer
+//
+#define KI_DPC_STAT_BUCKETS                 16
+
+typedef struct _KDPC_STATISTICS
+{
+    PVOID Routine;
+    ULONG Type;
+    LONG Count;
+    LONGLONG TotalTime;
+    LONG MaximumTime;
+    LONG Histogram[KI_DPC_STAT_BUCKETS];
+} KDPC_STATISTICS, *PKDPC_STATISTICS;
+
 typedef PCHAR
 (NTAPI *PKE_BUGCHECK_UNICODE_TO_ANSI)(
     IN PUNICODE_STRING Unicode,
@@ -100,7 +147,7 @@ extern USHORT KeProcessorLevel;
 extern USHORT KeProcessorRevision;
 extern ULONG KeFeatureBits;
 extern KNODE KiNode0;
-extern PKNODE KeNodeBlock[1];
+extern PKNODE KeNodeBlock[MAXIMUM_CCNUMA_NODES];
 extern UCHAR KeNumberNodes;
 extern UCHAR KeProcessNodeSeed;
 extern ETHREAD KiInitialThread;
@@ -124,6 +171,7 @@ extern LIST_ENTRY KeBugcheckCallbackListHead, KeBugcheckReasonCallbackListHead;
 extern KSPIN_LOCK BugCheckCallbackLock;
 extern KDPC KiTimerExpireDpc;
 extern KTIMER_TABLE_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+extern const ULONGLONG KiTimerCoalescingGranularity[];
 extern FAST_MUTEX KiGenericCallDpcMutex;
 extern LIST_ENTRY KiProfileListHead, KiProfileSourceListHead;
 extern KSPIN_LOCK KiProfileLock;
@@ -148,6 +196,8 @@ extern ULONG KiDPCTimeout;
 extern PGDI_BATCHFLUSH_ROUTINE KeGdiFlushUserBatch;
 extern ULONGLONG BootCycles, BootCyclesEnd;
 extern ULONG ProcessCount;
+extern BOOLEAN KiLockStatisticsEnabled;
+extern BOOLEAN KiDpcStatisticsEnabled;
 extern VOID __cdecl KiInterruptTemplate(VOID);
 
 /* MACROS *************************************************************************/
@@ -684,6 +734,19 @@ KeFlushQueueApc(
     IN KPROCESSOR_MODE PreviousMode
 );
 
+#if (NTDDI_VERSION < NTDDI_VISTA)
+ULONG
+NTAPI
+KeRemoveQueueEx(
+    IN PKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN BOOLEAN Alertable,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    OUT PLIST_ENTRY *EntryArray,
+    IN ULONG Count
+);
+#endif
+
 VOID
 NTAPI
 KiAttachProcess(
@@ -806,6 +869,14 @@ VOID
 NTAPI
 KeFlushCurrentTb(VOID);
 
+VOID
+NTAPI
+KeFlushMultipleTb(
+    IN ULONG Number,
+    IN PVOID *Virtual,
+    IN BOOLEAN AllProcessors
+);
+
 BOOLEAN
 NTAPI
 KeInvalidateAllCaches(VOID);
@@ -815,6 +886,11 @@ FASTCALL
 KeZeroPages(IN PVOID Address,
             IN ULONG Size);
 
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size);
+
 BOOLEAN
 FASTCALL
 KeInvalidAccessAllowed(IN PVOID TrapInformation OPTIONAL);
@@ -1058,4 +1134,70 @@ KeBugCheckUnicodeToAnsi(
     IN ULONG Length
 );
 
+VOID
+FASTCALL
+KiLockStatAcquired(
+    IN PVOID Lock,
+    IN ULONG Type,
+    IN ULONGLONG SpinStart,
+    IN PVOID Caller
+);
+
+VOID
+FASTCALL
+KiLockStatContended(
+    IN PVOID Lock,
+    IN ULONG Type,
+    IN ULONGLONG WaitStart,
+    IN PVOID Caller
+);
+
+VOID
+FASTCALL
+KiLockStatReleased(
+    IN PVOID Lock
+);
+
+VOID
+FASTCALL
+KiAcquireSpinLockWithStatistics(
+    IN PKSPIN_LOCK SpinLock,
+    IN ULONG Type,
+    IN PVOID Caller
+);
+
+BOOLEAN
+NTAPI
+KiGetNextLockStatistics(
+    IN OUT PULONG Index,
+    OUT PKLOCK_STATISTICS Statistics
+);
+
+PKLOCK_STATISTICS
+NTAPI
+KiFindLockStatistics(
+    IN PVOID Lock
+);
+
+VOID
+FASTCALL
+KiDpcStatRecord(
+    IN PVOID Routine,
+    IN ULONG Type,
+    IN ULONGLONG StartTime
+);
+
+BOOLEAN
+NTAPI
+KiGetNextDpcStatistics(
+    IN OUT PULONG Index,
+    OUT PKDPC_STATISTICS Statistics
+);
+
+VOID
+NTAPI
+KiExecuteDpc(
+    IN PVOID Context
+);
+
 #include "ke_x.h"
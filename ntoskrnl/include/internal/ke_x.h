@@ -16,6 +16,20 @@ KeGetPreviousMode(VOID)
 }
 #endif
 
+//
+// Time stamp used by the lock statistics
+//
+FORCEINLINE
+ULONGLONG
+KiLockStatTimeStamp(VOID)
+{
+#if defined(_M_IX86) || defined(_M_AMD64)
+    return __rdtsc();
+#else
+    return KeQueryInterruptTime();
+#endif
+}
+
 //
 // Enters a Guarded Region
 //
@@ -343,6 +357,17 @@ FORCEINLINE
 KIRQL
 KiAcquireDispatcherLock(VOID)
 {
+    KIRQL OldIrql;
+
+    /* The HAL doesn't keep lock statistics, take the lock ourselves then */
+    if (KiLockStatisticsEnabled)
+    {
+        OldIrql = KfRaiseIrql(SYNCH_LEVEL);
+        KeAcquireQueuedSpinLockAtDpcLevel(&KeGetCurrentPrcb()->
+                                          LockQueue[LockQueueDispatcherLock]);
+        return OldIrql;
+    }
+
     /* Raise to synchronization level and acquire the dispatcher lock */
     return KeAcquireQueuedSpinLockRaiseToSynch(LockQueueDispatcherLock);
 }
@@ -597,6 +622,72 @@ KiReleaseTimerLock(IN PKSPIN_LOCK_QUEUE LockQueue)
 
 #endif
 
+//
+// Events are protected by their own object lock on top of the dispatcher lock:
+// whoever waits on them or signals them with waiters holds both, taking the
+// dispatcher lock first, so that without waiters they can be signaled, reset,
+// or acquired while only holding the object lock.
+//
+#define KiIsEventObject(Object)                                             \
+    (((Object)->Type & KOBJECT_TYPE_MASK) <= EventSynchronizationObject)
+
+FORCEINLINE
+VOID
+KiAcquireEventObject(IN DISPATCHER_HEADER* Object)
+{
+    /* Only events have their own lock */
+    if (KiIsEventObject(Object)) KiAcquireDispatcherObject(Object);
+}
+
+FORCEINLINE
+VOID
+KiReleaseEventObject(IN DISPATCHER_HEADER* Object)
+{
+    /* Only events have their own lock */
+    if (KiIsEventObject(Object)) KiReleaseDispatcherObject(Object);
+}
+
+FORCEINLINE
+VOID
+KiAcquireEventObjects(IN PVOID Object[],
+                      IN ULONG Count)
+{
+#ifdef CONFIG_SMP
+    ULONG i, j;
+
+    /* The dispatcher lock serializes us against anyone else taking several */
+    for (i = 0; i < Count; i++)
+    {
+        /* The same object can be waited on more than once, only lock it once */
+        for (j = 0; j < i; j++) if (Object[j] == Object[i]) break;
+        if (j == i) KiAcquireEventObject(Object[i]);
+    }
+#else
+    UNREFERENCED_PARAMETER(Object);
+    UNREFERENCED_PARAMETER(Count);
+#endif
+}
+
+FORCEINLINE
+VOID
+KiReleaseEventObjects(IN PVOID Object[],
+                      IN ULONG Count)
+{
+#ifdef CONFIG_SMP
+    ULONG i, j;
+
+    for (i = 0; i < Count; i++)
+    {
+        /* Release each object that was locked */
+        for (j = 0; j < i; j++) if (Object[j] == Object[i]) break;
+        if (j == i) KiReleaseEventObject(Object[i]);
+    }
+#else
+    UNREFERENCED_PARAMETER(Object);
+    UNREFERENCED_PARAMETER(Count);
+#endif
+}
+
 FORCEINLINE
 VOID
 KiAcquireApcLockRaiseToSynch(IN PKTHREAD Thread,
@@ -949,6 +1040,7 @@ KiComputeDueTime(IN PKTIMER Timer,
                  OUT PULONG Hand)
 {
     LARGE_INTEGER InterruptTime, SystemTime, DifferenceTime;
+    ULONGLONG Granularity;
 
     /* Convert to relative time if needed */
     Timer->Header.Absolute = FALSE;
@@ -982,6 +1074,15 @@ KiComputeDueTime(IN PKTIMER Timer,
     /* Recalculate due time */
     Timer->DueTime.QuadPart = InterruptTime.QuadPart - DueTime.QuadPart;
 
+    /* Check if the timer may expire late */
+    if (Timer->Header.Coalescable)
+    {
+        /* Push it to the next boundary it allows, other timers will share it */
+        Granularity = KiTimerCoalescingGranularity[Timer->Header.EncodedTolerableDelay];
+        Timer->DueTime.QuadPart += Granularity - 1;
+        Timer->DueTime.QuadPart -= Timer->DueTime.QuadPart % Granularity;
+    }
+
     /* Get the handle */
     *Hand = KiComputeTimerTableIndex(Timer->DueTime.QuadPart);
     Timer->Header.Hand = (UCHAR)*Hand;
@@ -101,13 +101,15 @@ LpcpAllocateFromPortZone(VOID)
 {
     PLPCP_MESSAGE Message;
 
-    /* Allocate a message from the port zone while holding the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /*
+     * Allocate a message from the port zone. The lookaside list is already
+     * safe to use concurrently, and the message isn't visible to anyone else
+     * until it is queued, so the global LPC lock isn't needed here.
+     */
     Message = (PLPCP_MESSAGE)ExAllocateFromPagedLookasideList(&LpcpMessagesLookaside);
     if (!Message)
     {
         /* Fail, and let caller cleanup */
-        KeReleaseGuardedMutex(&LpcpLock);
         return NULL;
     }
 
@@ -115,9 +117,6 @@ LpcpAllocateFromPortZone(VOID)
     InitializeListHead(&Message->Entry);
     Message->RepliedToThread = NULL;
     Message->Request.u2.ZeroInit = 0;
-
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
     return Message;
 }
 
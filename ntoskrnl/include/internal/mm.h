@@ -233,15 +233,25 @@ typedef struct _MEMORY_AREA
     } Data;
 } MEMORY_AREA, *PMEMORY_AREA;
 
-typedef struct _MM_RMAP_ENTRY
+typedef struct _MM_RMAP_SLOT
 {
-   struct _MM_RMAP_ENTRY* Next;
    PEPROCESS Process;
    PVOID Address;
 #if DBG
    PVOID Caller;
 #endif
 }
+MM_RMAP_SLOT, *PMM_RMAP_SLOT;
+
+/* Mappings held by each link of the rmap chain of a page mapped more than once */
+#define RMAP_CHAIN_SLOTS 4
+
+typedef struct _MM_RMAP_ENTRY
+{
+   struct _MM_RMAP_ENTRY* Next;
+   ULONG SlotCount;      /* 1, or RMAP_CHAIN_SLOTS */
+   MM_RMAP_SLOT Slot[1]; /* Unused slots have a NULL address */
+}
 MM_RMAP_ENTRY, *PMM_RMAP_ENTRY;
 
 #if MI_TRACE_PFNS
@@ -434,6 +444,7 @@ typedef struct _MMPAGING_FILE
     PFILE_OBJECT FileObject;
     UNICODE_STRING PageFileName;
     PRTL_BITMAP Bitmap;
+    ULONG HintIndex;
     HANDLE FileHandle;
 }
 MMPAGING_FILE, *PMMPAGING_FILE;
@@ -619,10 +630,17 @@ MmInitSystem(IN ULONG Phase,
 
 /* pagefile.c ****************************************************************/
 
+/* Most pages moved to or from a paging file in a single I/O */
+#define MI_PAGEFILE_CLUSTER_SIZE 16
+
 SWAPENTRY
 NTAPI
 MmAllocSwapPage(VOID);
 
+SWAPENTRY
+NTAPI
+MmAllocSwapPages(ULONG PageCount);
+
 VOID
 NTAPI
 MmFreeSwapPage(SWAPENTRY Entry);
@@ -650,6 +668,13 @@ MmWriteToSwapPage(
     PFN_NUMBER Page
 );
 
+NTSTATUS
+NTAPI
+MmWriteToSwapPages(
+    _In_ SWAPENTRY SwapEntry,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount);
+
 VOID
 NTAPI
 MmShowOutOfSpaceMessagePagingFile(VOID);
@@ -661,6 +686,43 @@ MiReadPageFile(
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset);
 
+NTSTATUS
+NTAPI
+MiReadPageFileCluster(
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount,
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset);
+
+/* pagestore.c **************************************************************/
+
+INIT_FUNCTION
+VOID
+NTAPI
+MiInitializePageStore(VOID);
+
+BOOLEAN
+NTAPI
+MiStorePages(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount);
+
+ULONG
+NTAPI
+MiLoadStoredPages(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount);
+
+VOID
+NTAPI
+MiFreeStoredPage(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset);
+
 /* process.c ****************************************************************/
 
 NTSTATUS
@@ -886,6 +948,21 @@ VOID
 NTAPI
 MmSetDirtyAllRmaps(PFN_NUMBER Page);
 
+PMM_RMAP_SLOT
+NTAPI
+MiGetFirstRmapSlot(
+    PMM_RMAP_ENTRY Entry,
+    BOOLEAN Segment
+);
+
+BOOLEAN
+NTAPI
+MmTestAndClearAccessedAllRmaps(
+    PFN_NUMBER Page,
+    PBOOLEAN BelowMinimum,
+    PBOOLEAN AboveMaximum
+);
+
 BOOLEAN
 NTAPI
 MmIsDirtyPageRmap(PFN_NUMBER Page);
@@ -896,10 +973,37 @@ MmPageOutPhysicalAddress(PFN_NUMBER Page);
 
 /* freelist.c **********************************************************/
 
+extern volatile LONG MiPfnLockContentionCount;
+
+FORCEINLINE
+VOID
+MiCountPfnLockContention(VOID)
+{
+#ifdef CONFIG_SMP
+    /* Only peek at the lock, counting shouldn't add to the contention */
+    if (*KeGetCurrentPrcb()->LockQueue[LockQueuePfnLock].Lock)
+    {
+        InterlockedIncrement(&MiPfnLockContentionCount);
+    }
+#endif
+}
+
 FORCEINLINE
 KIRQL
 MiAcquirePfnLock(VOID)
 {
+    KIRQL OldIrql;
+
+    MiCountPfnLockContention();
+
+    /* The HAL doesn't keep lock statistics, take the lock ourselves then */
+    if (KiLockStatisticsEnabled)
+    {
+        KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+        KeAcquireQueuedSpinLockAtDpcLevel(&KeGetCurrentPrcb()->LockQueue[LockQueuePfnLock]);
+        return OldIrql;
+    }
+
     return KeAcquireQueuedSpinLock(LockQueuePfnLock);
 }
 
@@ -908,6 +1012,13 @@ VOID
 MiReleasePfnLock(
     _In_ KIRQL OldIrql)
 {
+    if (KiLockStatisticsEnabled)
+    {
+        KeReleaseQueuedSpinLockFromDpcLevel(&KeGetCurrentPrcb()->LockQueue[LockQueuePfnLock]);
+        KeLowerIrql(OldIrql);
+        return;
+    }
+
     KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
 }
 
@@ -918,6 +1029,7 @@ MiAcquirePfnLockAtDpcLevel(VOID)
     PKSPIN_LOCK_QUEUE LockQueue;
 
     ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
+    MiCountPfnLockContention();
     LockQueue = &KeGetCurrentPrcb()->LockQueue[LockQueuePfnLock];
     KeAcquireQueuedSpinLockAtDpcLevel(LockQueue);
 }
@@ -981,6 +1093,10 @@ VOID
 NTAPI
 MmRemoveLRUUserPage(PFN_NUMBER Page);
 
+ULONG
+NTAPI
+MmAgeLRUUserPage(PFN_NUMBER Page, BOOLEAN Accessed, BOOLEAN Increment);
+
 VOID
 NTAPI
 MmDumpArmPfnDatabase(
@@ -1164,6 +1280,13 @@ MmSetCleanPage(
     PVOID Address
 );
 
+BOOLEAN
+NTAPI
+MmTestAndClearAccessedPage(
+    struct _EPROCESS *Process,
+    PVOID Address
+);
+
 VOID
 NTAPI
 MmDeletePageTable(
@@ -51,6 +51,7 @@
 
 #include "tag.h"
 #include "ke.h"
+#include "wmi.h"
 #include "ob.h"
 #include "mm.h"
 #include "ex.h"
@@ -122,7 +122,8 @@ typedef struct _SECURITY_DESCRIPTOR_HEADER
 {
     LIST_ENTRY Link;
     ULONG RefCount;
-    ULONG FullHash;
+    ULONG Length;
+    ULONGLONG FullHash;
     QUAD SecurityDescriptor;
 } SECURITY_DESCRIPTOR_HEADER, *PSECURITY_DESCRIPTOR_HEADER;
 
@@ -626,6 +627,7 @@ extern KGUARDED_MUTEX ObpDeviceMapLock;
 extern POBJECT_TYPE ObpTypeObjectType;
 extern POBJECT_TYPE ObpDirectoryObjectType;
 extern POBJECT_TYPE ObpSymbolicLinkObjectType;
+extern ULONG ObpNamespaceGeneration;
 extern POBJECT_DIRECTORY ObpRootDirectoryObject;
 extern POBJECT_DIRECTORY ObpTypeDirectoryObject;
 extern PHANDLE_TABLE ObpKernelHandleTable;
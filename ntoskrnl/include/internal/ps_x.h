@@ -87,6 +87,9 @@ PspRunLoadImageNotifyRoutines(PUNICODE_STRING FullImageName,
 {
     ULONG i;
 
+    /* Notify WMI */
+    WmiTraceImageLoad(FullImageName, ProcessId, ImageInfo);
+
     /* Loop the notify routines */
     for (i = 0; i < PSP_MAX_LOAD_IMAGE_NOTIFY; ++ i)
     {
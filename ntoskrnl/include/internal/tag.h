@@ -22,6 +22,9 @@
 /* formerly located in ex/handle.c */
 #define TAG_OBJECT_TABLE 'btbO'
 
+/* Executive worker pool */
+#define TAG_WORKER_POOL 'lPkW'
+
 /* formerly located in ex/init.c */
 #define TAG_INIT 'tinI'
 #define TAG_RTLI 'iltR'
@@ -132,6 +135,9 @@
 /* formerly located in mm/rmap.c */
 #define TAG_RMAP    'PAMR'
 
+/* located in mm/pagestore.c */
+#define TAG_MM_PAGE_STORE   'SPmM'
+
 /* formerly located in mm/ARM3/section.c */
 #define TAG_MM      '  mM'
 
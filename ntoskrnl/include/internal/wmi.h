@@ -0,0 +1,138 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/include/internal/wmi.h
+ * PURPOSE:         Internal header for the NT Kernel Logger
+ */
+
+#pragma once
+
+//
+// Kernel logger event classes, same values as EVENT_TRACE_FLAG_*
+//
+#define WMI_KLOG_FLAG_PROCESS                           0x00000001
+#define WMI_KLOG_FLAG_IMAGE_LOAD                        0x00000004
+#define WMI_KLOG_FLAG_CSWITCH                           0x00000010
+#define WMI_KLOG_FLAG_DISK_IO                           0x00000100
+#define WMI_KLOG_FLAG_PAGE_FAULTS                       0x00001000
+#define WMI_KLOG_FLAG_PROFILE                           0x01000000
+
+#define WMI_KLOG_SUPPORTED_FLAGS                        \
+    (WMI_KLOG_FLAG_PROCESS | WMI_KLOG_FLAG_IMAGE_LOAD | \
+     WMI_KLOG_FLAG_CSWITCH | WMI_KLOG_FLAG_DISK_IO |    \
+     WMI_KLOG_FLAG_PAGE_FAULTS | WMI_KLOG_FLAG_PROFILE)
+
+//
+// Event classes enabled in the running kernel logger, zero when it is off
+//
+extern volatile ULONG WmipKernelLoggerFlags;
+
+VOID
+NTAPI
+WmipTraceContextSwitch(
+    _In_ PKTHREAD OldThread,
+    _In_ PKTHREAD NewThread
+);
+
+VOID
+NTAPI
+WmipTraceDiskIo(
+    _In_ PIRP Irp
+);
+
+VOID
+NTAPI
+WmipTracePageFault(
+    _In_ ULONG FaultCode,
+    _In_ PVOID Address,
+    _In_ KPROCESSOR_MODE Mode
+);
+
+VOID
+NTAPI
+WmipTraceProcess(
+    _In_ PEPROCESS Process,
+    _In_ BOOLEAN Create
+);
+
+VOID
+NTAPI
+WmipTraceProfile(
+    _In_ PKTRAP_FRAME TrapFrame,
+    _In_ KPROFILE_SOURCE Source
+);
+
+VOID
+NTAPI
+WmipTraceImageLoad(
+    _In_opt_ PUNICODE_STRING FullImageName,
+    _In_opt_ HANDLE ProcessId,
+    _In_ PIMAGE_INFO ImageInfo
+);
+
+INIT_FUNCTION
+VOID
+NTAPI
+WmipStartKernelLogger(
+    VOID
+);
+
+//
+// Hooks called from the instrumented code paths. These only cost a load and
+// a test while the kernel logger is not running.
+//
+FORCEINLINE
+VOID
+WmiTraceContextSwitch(IN PKTHREAD OldThread,
+                      IN PKTHREAD NewThread)
+{
+    if (WmipKernelLoggerFlags & WMI_KLOG_FLAG_CSWITCH)
+        WmipTraceContextSwitch(OldThread, NewThread);
+}
+
+FORCEINLINE
+VOID
+WmiTraceDiskIo(IN PIRP Irp)
+{
+    if (WmipKernelLoggerFlags & WMI_KLOG_FLAG_DISK_IO)
+        WmipTraceDiskIo(Irp);
+}
+
+FORCEINLINE
+VOID
+WmiTracePageFault(IN ULONG FaultCode,
+                  IN PVOID Address,
+                  IN KPROCESSOR_MODE Mode)
+{
+    if (WmipKernelLoggerFlags & WMI_KLOG_FLAG_PAGE_FAULTS)
+        WmipTracePageFault(FaultCode, Address, Mode);
+}
+
+FORCEINLINE
+VOID
+WmiTraceProcess(IN PEPROCESS Process,
+                IN BOOLEAN Create)
+{
+    if (WmipKernelLoggerFlags & WMI_KLOG_FLAG_PROCESS)
+        WmipTraceProcess(Process, Create);
+}
+
+FORCEINLINE
+VOID
+WmiTraceProfile(IN PKTRAP_FRAME TrapFrame,
+                IN KPROFILE_SOURCE Source)
+{
+    if (WmipKernelLoggerFlags & WMI_KLOG_FLAG_PROFILE)
+        WmipTraceProfile(TrapFrame, Source);
+}
+
+FORCEINLINE
+VOID
+WmiTraceImageLoad(IN PUNICODE_STRING FullImageName OPTIONAL,
+                  IN HANDLE ProcessId OPTIONAL,
+                  IN PIMAGE_INFO ImageInfo)
+{
+    /* Profile samples need the images to be symbolized */
+    if (WmipKernelLoggerFlags & (WMI_KLOG_FLAG_IMAGE_LOAD | WMI_KLOG_FLAG_PROFILE))
+        WmipTraceImageLoad(FullImageName, ProcessId, ImageInfo);
+}
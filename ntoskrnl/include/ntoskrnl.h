@@ -93,6 +93,9 @@
 /* SRM header */
 #include <srmp.h>
 
+/* Boot timeline */
+#include <reactos/bootperf.h>
+
 #define ExRaiseStatus RtlRaiseStatus
 
 /* Also defined in fltkernel.h, but we don't want the entire header */
@@ -18,6 +18,7 @@
 /* GLOBALS ********************************************************************/
 
 ULONG IopDeviceObjectNumber = 0;
+volatile LONG IopDeviceStackGeneration = 0;
 LIST_ENTRY ShutdownListHead, LastChanceShutdownListHead;
 KSPIN_LOCK ShutdownListLock;
 extern LIST_ENTRY IopDiskFileSystemQueueHead;
@@ -113,6 +114,9 @@ IopAttachDeviceToDeviceStackSafe(IN PDEVICE_OBJECT SourceDevice,
 
         /* Set the attachment in the device extension */
         SourceDeviceExtension->AttachedTo = AttachedDevice;
+
+        /* The stack changed, drop the cached stack tops */
+        InterlockedIncrement(&IopDeviceStackGeneration);
     }
 
     /* Return the attached device */
@@ -1305,6 +1309,9 @@ IoDetachDevice(IN PDEVICE_OBJECT TargetDevice)
     DeviceExtension->AttachedTo = NULL;
     TargetDevice->AttachedDevice = NULL;
 
+    /* The stack changed, drop the cached stack tops */
+    InterlockedIncrement(&IopDeviceStackGeneration);
+
     /* Check if it's ok to delete this device */
     if ((IoGetDevObjExtension(TargetDevice)->ExtensionFlags & DOE_DELETE_PENDING) &&
         !(TargetDevice->ReferenceCount))
@@ -1499,6 +1499,7 @@ IopCreateDriver(IN PUNICODE_STRING DriverName OPTIONAL,
     UNICODE_STRING ServiceKeyName;
     HANDLE hDriver;
     ULONG i, RetryCount = 0;
+    ULONGLONG StartTime;
 
 try_again:
     /* First, create a unique name for the driver if we don't have one */
@@ -1643,7 +1644,12 @@ try_again:
     /* Finally, call its init function */
     DPRINT("RegistryKey: %wZ\n", RegistryPath);
     DPRINT("Calling driver entrypoint at %p\n", InitializationFunction);
+    StartTime = ExpBootPerfTimeStamp();
     Status = (*InitializationFunction)(DriverObject, RegistryPath);
+    ExpBootPerfRecord(BootPerfDriverEntry,
+                      &DriverObject->DriverName,
+                      StartTime,
+                      ExpBootPerfTimeStamp());
     if (!NT_SUCCESS(Status))
     {
         /* If it didn't work, then kill the object */
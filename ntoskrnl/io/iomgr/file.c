@@ -651,7 +651,7 @@ IopParseDevice(IN PVOID ParseObject,
                 DeviceObject->AttachedDevice)
             {
                 /* Get the attached device */
-                DeviceObject = IoGetAttachedDevice(DeviceObject);
+                DeviceObject = IopGetCachedAttachedDevice(DeviceObject);
             }
         }
 
@@ -2722,7 +2722,7 @@ IopCreateFile(OUT PHANDLE FileHandle,
     }
 
     /* Allocate the open packet */
-    OpenPacket = ExAllocatePoolWithTag(NonPagedPool, sizeof(*OpenPacket), 'pOoI');
+    OpenPacket = IopAllocateOpenPacket();
     if (!OpenPacket) return STATUS_INSUFFICIENT_RESOURCES;
     RtlZeroMemory(OpenPacket, sizeof(*OpenPacket));
 
@@ -2782,7 +2782,7 @@ IopCreateFile(OUT PHANDLE FileHandle,
         {
             /* Return the exception code */
             if (OpenPacket->EaBuffer != NULL) ExFreePool(OpenPacket->EaBuffer);
-            ExFreePool(OpenPacket);
+            IopFreeOpenPacket(OpenPacket);
             _SEH2_YIELD(return _SEH2_GetExceptionCode());
         }
         _SEH2_END;
@@ -2818,7 +2818,7 @@ IopCreateFile(OUT PHANDLE FileHandle,
                                                          TAG_EA);
             if (!OpenPacket->EaBuffer)
             {
-                ExFreePool(OpenPacket);
+                IopFreeOpenPacket(OpenPacket);
                 DPRINT1("Failed to allocate open packet EA buffer\n");
                 return STATUS_INSUFFICIENT_RESOURCES;
             }
@@ -2838,7 +2838,7 @@ IopCreateFile(OUT PHANDLE FileHandle,
                 ExFreePool(OpenPacket->EaBuffer);
                 IoStatusBlock->Status = Status;
                 IoStatusBlock->Information = EaErrorOffset;
-                ExFreePool(OpenPacket);
+                IopFreeOpenPacket(OpenPacket);
                 return Status;
             }
         }
@@ -2969,7 +2969,7 @@ IopCreateFile(OUT PHANDLE FileHandle,
     }
 
     /* Return status */
-    ExFreePool(OpenPacket);
+    IopFreeOpenPacket(OpenPacket);
     return Status;
 }
 
@@ -434,7 +434,10 @@ IopDeviceFsIoControl(IN HANDLE DeviceHandle,
                 /* If we had an event, signal it */
                 if (Event)
                 {
-                    KeSetEvent(EventObject, IO_NO_INCREMENT, FALSE);
+                    if (!(FileObject->Flags & FO_SKIP_SET_FAST_IO))
+                    {
+                        KeSetEvent(EventObject, IO_NO_INCREMENT, FALSE);
+                    }
                     ObDereferenceObject(EventObject);
                 }
 
@@ -444,8 +447,9 @@ IopDeviceFsIoControl(IN HANDLE DeviceHandle,
                     IopUnlockFileObject(FileObject);
                 }
 
-                /* Set completion if required */
-                if (CompletionInfo.Port != NULL && UserApcContext != NULL)
+                /* Set completion if required, unless that's skipped on success */
+                if (CompletionInfo.Port != NULL && UserApcContext != NULL &&
+                    !(FileObject->Flags & FO_SKIP_COMPLETION_PORT))
                 {
                     if (!NT_SUCCESS(IoSetIoCompletion(CompletionInfo.Port,
                                                       CompletionInfo.Key,
@@ -1134,6 +1138,77 @@ IopGetDriverPathInformation(IN PFILE_OBJECT FileObject,
     return STATUS_SUCCESS;
 }
 
+static
+NTSTATUS
+IopSetCompletionNotificationModes(IN HANDLE FileHandle,
+                                  OUT PIO_STATUS_BLOCK IoStatusBlock,
+                                  IN PVOID FileInformation,
+                                  IN ULONG Length,
+                                  IN KPROCESSOR_MODE PreviousMode)
+{
+    PFILE_OBJECT FileObject;
+    ULONG Modes, Flags = 0;
+    NTSTATUS Status;
+
+    if (Length < sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* Capture the modes */
+    _SEH2_TRY
+    {
+        if (PreviousMode != KernelMode)
+        {
+            ProbeForWriteIoStatusBlock(IoStatusBlock);
+            ProbeForRead(FileInformation, Length, sizeof(ULONG));
+        }
+
+        Modes = ((PFILE_IO_COMPLETION_NOTIFICATION_INFORMATION)FileInformation)->Flags;
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        _SEH2_YIELD(return _SEH2_GetExceptionCode());
+    }
+    _SEH2_END;
+
+    if (Modes & ~(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS |
+                  FILE_SKIP_SET_EVENT_ON_HANDLE |
+                  FILE_SKIP_SET_USER_EVENT_ON_FAST_IO))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Modes & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) Flags |= FO_SKIP_COMPLETION_PORT;
+    if (Modes & FILE_SKIP_SET_EVENT_ON_HANDLE) Flags |= FO_SKIP_SET_EVENT;
+    if (Modes & FILE_SKIP_SET_USER_EVENT_ON_FAST_IO) Flags |= FO_SKIP_SET_FAST_IO;
+
+    Status = ObReferenceObjectByHandle(FileHandle,
+                                       0,
+                                       IoFileObjectType,
+                                       PreviousMode,
+                                       (PVOID*)&FileObject,
+                                       NULL);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    /* The modes can only be turned on, the I/O paths check them unlocked */
+    InterlockedOr((PLONG)&FileObject->Flags, Flags);
+    ObDereferenceObject(FileObject);
+
+    _SEH2_TRY
+    {
+        IoStatusBlock->Status = STATUS_SUCCESS;
+        IoStatusBlock->Information = 0;
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        /* Too late to undo, and it did work */
+    }
+    _SEH2_END;
+
+    return STATUS_SUCCESS;
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -1871,12 +1946,16 @@ NtLockFile(IN HANDLE FileHandle,
             /* If we had an event, signal it */
             if (EventHandle)
             {
-                KeSetEvent(Event, IO_NO_INCREMENT, FALSE);
+                if (!(FileObject->Flags & FO_SKIP_SET_FAST_IO))
+                {
+                    KeSetEvent(Event, IO_NO_INCREMENT, FALSE);
+                }
                 ObDereferenceObject(Event);
             }
 
-            /* Set completion if required */
-            if (FileObject->CompletionContext != NULL && ApcContext != NULL)
+            /* Set completion if required, unless that's skipped on success */
+            if (FileObject->CompletionContext != NULL && ApcContext != NULL &&
+                !(FileObject->Flags & FO_SKIP_COMPLETION_PORT))
             {
                 if (!NT_SUCCESS(IoSetIoCompletion(FileObject->CompletionContext->Port,
                                                   FileObject->CompletionContext->Key,
@@ -3065,6 +3144,16 @@ NtSetInformationFile(IN HANDLE FileHandle,
     PAGED_CODE();
     IOTRACE(IO_API_DEBUG, "FileHandle: %p\n", FileHandle);
 
+    /* This one only changes the file object, the driver isn't involved */
+    if (FileInformationClass == FileIoCompletionNotificationInformation)
+    {
+        return IopSetCompletionNotificationModes(FileHandle,
+                                                 IoStatusBlock,
+                                                 FileInformation,
+                                                 Length,
+                                                 PreviousMode);
+    }
+
     /* Check if we're called from user mode */
     if (PreviousMode != KernelMode)
     {
@@ -82,6 +82,9 @@ extern PDEVICE_OBJECT IopErrorLogObject;
 
 GENERAL_LOOKASIDE IoLargeIrpLookaside;
 GENERAL_LOOKASIDE IoSmallIrpLookaside;
+GENERAL_LOOKASIDE IopDeepIrpLookaside[IOP_DEEP_IRP_CLASSES];
+GENERAL_LOOKASIDE IopOpenPacketLookaside;
+C_ASSERT(IOP_OPEN_PACKET_LIST < RTL_NUMBER_OF(((PKPRCB)NULL)->PPLookasideList));
 GENERAL_LOOKASIDE IopMdlLookasideList;
 extern GENERAL_LOOKASIDE IoCompletionPacketLookaside;
 
@@ -98,10 +101,12 @@ INIT_FUNCTION
 NTAPI
 IopInitLookasideLists(VOID)
 {
-    ULONG LargeIrpSize, SmallIrpSize, MdlSize;
+    ULONG LargeIrpSize, SmallIrpSize, MdlSize, DeepIrpSize;
     LONG i;
+    ULONG j, k;
     PKPRCB Prcb;
     PGENERAL_LOOKASIDE CurrentList = NULL;
+    PSLIST_ENTRY Irp;
 
     /* Calculate the sizes */
     LargeIrpSize = sizeof(IRP) + (8 * sizeof(IO_STACK_LOCATION));
@@ -141,9 +146,38 @@ IopInitLookasideLists(VOID)
                                     128,
                                     &ExSystemLookasideListHead);
 
+    /* Initialize the Lookaside Lists for deeper IRPs */
+    for (j = 0; j < IOP_DEEP_IRP_CLASSES; j++)
+    {
+        DeepIrpSize = IoSizeOfIrp(IopIrpClassStackSize[j + 2]);
+        ExInitializeSystemLookasideList(&IopDeepIrpLookaside[j],
+                                        NonPagedPool,
+                                        DeepIrpSize,
+                                        IO_LARGEIRP,
+                                        32,
+                                        &ExSystemLookasideListHead);
+
+        /* Those stacks are rare enough that the balancer would only find
+           them late, so have a few IRPs ready for the first requests */
+        for (k = 0; k < IOP_DEEP_IRP_PREALLOCATE; k++)
+        {
+            Irp = ExAllocatePoolWithTag(NonPagedPool, DeepIrpSize, IO_LARGEIRP);
+            if (!Irp) break;
+            InterlockedPushEntrySList(&IopDeepIrpLookaside[j].ListHead, Irp);
+        }
+    }
+
+    /* Initialize the Lookaside List for open packets */
+    ExInitializeSystemLookasideList(&IopOpenPacketLookaside,
+                                    NonPagedPool,
+                                    sizeof(OPEN_PACKET),
+                                    'pOoI',
+                                    32,
+                                    &ExSystemLookasideListHead);
+
     /* Allocate the global lookaside list buffer */
     CurrentList = ExAllocatePoolWithTag(NonPagedPool,
-                                        4 * KeNumberProcessors *
+                                        (5 + IOP_DEEP_IRP_CLASSES) * KeNumberProcessors *
                                         sizeof(GENERAL_LOOKASIDE),
                                         TAG_IO);
 
@@ -237,6 +271,47 @@ IopInitLookasideLists(VOID)
         {
             Prcb->PPLookasideList[LookasideMdlList].P = &IopMdlLookasideList;
         }
+
+        /* Set the deeper IRP Lists */
+        for (j = 0; j < IOP_DEEP_IRP_CLASSES; j++)
+        {
+            Prcb->PPLookasideList[IOP_FIRST_DEEP_IRP_LIST + j].L = &IopDeepIrpLookaside[j];
+            if (CurrentList)
+            {
+                /* Initialize the Lookaside List for these IRPs */
+                ExInitializeSystemLookasideList(CurrentList,
+                                                NonPagedPool,
+                                                IoSizeOfIrp(IopIrpClassStackSize[j + 2]),
+                                                IO_LARGEIRP_CPU,
+                                                16,
+                                                &ExSystemLookasideListHead);
+                Prcb->PPLookasideList[IOP_FIRST_DEEP_IRP_LIST + j].P = CurrentList;
+                CurrentList++;
+            }
+            else
+            {
+                Prcb->PPLookasideList[IOP_FIRST_DEEP_IRP_LIST + j].P = &IopDeepIrpLookaside[j];
+            }
+        }
+
+        /* Set the Open Packet List */
+        Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].L = &IopOpenPacketLookaside;
+        if (CurrentList)
+        {
+            /* Initialize the Lookaside List for open packets */
+            ExInitializeSystemLookasideList(CurrentList,
+                                            NonPagedPool,
+                                            sizeof(OPEN_PACKET),
+                                            'pOoI',
+                                            16,
+                                            &ExSystemLookasideListHead);
+            Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].P = CurrentList;
+            CurrentList++;
+        }
+        else
+        {
+            Prcb->PPLookasideList[IOP_OPEN_PACKET_LIST].P = &IopOpenPacketLookaside;
+        }
     }
 }
 
@@ -551,7 +626,9 @@ IoInitSystem(IN PLOADER_PARAMETER_BLOCK LoaderBlock)
     IopLoaderBlock = LoaderBlock;
 
     /* Load boot start drivers */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"BootDrivers");
     IopInitializeBootDrivers();
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"BootDrivers");
 
     /* Call back drivers that asked for */
     IopReinitializeBootDrivers();
@@ -593,10 +670,14 @@ IoInitSystem(IN PLOADER_PARAMETER_BLOCK LoaderBlock)
 #endif
 
     /* Load services for devices found by PnP manager */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"PnpServices");
     IopInitializePnpServices(IopRootDeviceNode);
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"PnpServices");
 
     /* Load system start drivers */
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_BEGIN, L"SystemDrivers");
     IopInitializeSystemDrivers();
+    ExpBootPerfMark(BootPerfPhase, BOOTPERF_MARK_END, L"SystemDrivers");
     PnpSystemInit = TRUE;
 
     /* Reinitialize drivers that requested it */
@@ -18,8 +18,36 @@
 PIRP IopDeadIrp;
 RESERVE_IRP_ALLOCATOR IopReserveIrpAllocator;
 
+/* Stack locations of the IRPs in each lookaside class, smallest first */
+const CCHAR IopIrpClassStackSize[IOP_IRP_CLASSES] = { 1, 8, 12, 20, 32 };
+
 /* PRIVATE FUNCTIONS  ********************************************************/
 
+static
+ULONG
+IopGetIrpClass(IN CCHAR StackSize)
+{
+    ULONG Class;
+
+    /* Find the smallest class the IRP fits in, if any */
+    for (Class = 0; Class < IOP_IRP_CLASSES; Class++)
+    {
+        if (StackSize <= IopIrpClassStackSize[Class]) break;
+    }
+
+    return Class;
+}
+
+static
+ULONG
+IopGetIrpClassListType(IN ULONG Class)
+{
+    /* The two first classes are the NDK lists */
+    if (Class == 0) return LookasideSmallIrpList;
+    if (Class == 1) return LookasideLargeIrpList;
+    return IOP_FIRST_DEEP_IRP_LIST + Class - 2;
+}
+
 VOID
 NTAPI
 IopFreeIrpKernelApc(IN PKAPC Apc,
@@ -399,8 +427,12 @@ IopCompleteRequest(IN PKAPC Apc,
         }
         else if (FileObject)
         {
-            /* Signal the file object and set the status */
-            KeSetEvent(&FileObject->Event, 0, FALSE);
+            /* Signal the file object, unless asked not to, and set the status */
+            if (!(FileObject->Flags & FO_SKIP_SET_EVENT) ||
+                (FileObject->Flags & FO_SYNCHRONOUS_IO))
+            {
+                KeSetEvent(&FileObject->Event, 0, FALSE);
+            }
             FileObject->FinalStatus = Irp->IoStatus.Status;
 
             /*
@@ -460,8 +492,14 @@ IopCompleteRequest(IN PKAPC Apc,
             KeInsertQueueApc(&Irp->Tail.Apc, Irp->UserIosb, NULL, 2);
         }
         else if ((Port) &&
-                 (Irp->Overlay.AsynchronousParameters.UserApcContext))
+                 (Irp->Overlay.AsynchronousParameters.UserApcContext) &&
+                 ((Irp->PendingReturned) ||
+                  !(FileObject->Flags & FO_SKIP_COMPLETION_PORT)))
         {
+            /*
+             * Requests that didn't pend had their status returned directly,
+             * the caller asked not to get a packet for those.
+             */
             /* We have an I/O Completion setup... create the special Overlay */
             Irp->Tail.CompletionKey = Key;
             Irp->Tail.Overlay.PacketType = IopCompletionPacketIrp;
@@ -620,7 +658,7 @@ IoAllocateIrp(IN CCHAR StackSize,
     PKPRCB Prcb;
     UCHAR Flags = 0;
     PNPAGED_LOOKASIDE_LIST List = NULL;
-    PP_NPAGED_LOOKASIDE_NUMBER ListType = LookasideSmallIrpList;
+    ULONG Class, ListType;
 
     /* Set Charge Quota Flag */
     if (ChargeQuota) Flags |= IRP_QUOTA_CHARGED;
@@ -629,17 +667,15 @@ IoAllocateIrp(IN CCHAR StackSize,
     Prcb = KeGetCurrentPrcb();
 
     /* Figure out which Lookaside List to use */
-    if ((StackSize <= 8) && (ChargeQuota == FALSE || Prcb->LookasideIrpFloat > 0))
+    Class = IopGetIrpClass(StackSize);
+    if ((Class < IOP_IRP_CLASSES) && (ChargeQuota == FALSE || Prcb->LookasideIrpFloat > 0))
     {
         /* Set Fixed Size Flag */
         Flags |= IRP_ALLOCATED_FIXED_SIZE;
 
-        /* See if we should use big list */
-        if (StackSize != 1)
-        {
-            Size = IoSizeOfIrp(8);
-            ListType = LookasideLargeIrpList;
-        }
+        /* All the IRPs of a class have its size */
+        Size = IoSizeOfIrp(IopIrpClassStackSize[Class]);
+        ListType = IopGetIrpClassListType(Class);
 
         /* Get the P List First */
         List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[ListType].P;
@@ -1345,6 +1381,9 @@ IofCompleteRequest(IN PIRP Irp,
         ErrorCode = PtrToUlong(LastStackPtr->Parameters.Others.Argument4);
     }
 
+    /* Notify WMI */
+    WmiTraceDiskIo(Irp);
+
     /*
      * Start the loop with the current stack and point the IRP to the next stack
      * and then keep incrementing the stack as we loop through. The IRP should
@@ -1666,7 +1705,7 @@ NTAPI
 IoFreeIrp(IN PIRP Irp)
 {
     PNPAGED_LOOKASIDE_LIST List;
-    PP_NPAGED_LOOKASIDE_NUMBER ListType = LookasideSmallIrpList;
+    ULONG ListType;
     PKPRCB Prcb;
     IOTRACE(IO_IRP_DEBUG,
             "%s - Freeing IRPs %p\n",
@@ -1696,8 +1735,8 @@ IoFreeIrp(IN PIRP Irp)
     }
     else
     {
-        /* Check if this was a Big IRP */
-        if (Irp->StackCount != 1) ListType = LookasideLargeIrpList;
+        /* Go back to the list of its class */
+        ListType = IopGetIrpClassListType(IopGetIrpClass(Irp->StackCount));
 
         /* Use the P List */
         List = (PNPAGED_LOOKASIDE_LIST)Prcb->PPLookasideList[ListType].P;
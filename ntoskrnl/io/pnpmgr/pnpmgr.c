@@ -436,6 +436,7 @@ IopInitializeDevice(PDEVICE_NODE DeviceNode,
 {
     PDEVICE_OBJECT Fdo;
     NTSTATUS Status;
+    ULONGLONG StartTime;
 
     if (!DriverObject)
     {
@@ -462,8 +463,13 @@ IopInitializeDevice(PDEVICE_NODE DeviceNode,
     DPRINT("Calling %wZ->AddDevice(%wZ)\n",
            &DriverObject->DriverName,
            &DeviceNode->InstancePath);
+    StartTime = ExpBootPerfTimeStamp();
     Status = DriverObject->DriverExtension->AddDevice(DriverObject,
                                                       DeviceNode->PhysicalDeviceObject);
+    ExpBootPerfRecord(BootPerfAddDevice,
+                      &DriverObject->DriverName,
+                      StartTime,
+                      ExpBootPerfTimeStamp());
     if (!NT_SUCCESS(Status))
     {
         DPRINT1("%wZ->AddDevice(%wZ) failed with status 0x%x\n",
@@ -428,6 +428,29 @@ KeFlushEntireTb(IN BOOLEAN Invalid,
 
 }
 
+VOID
+NTAPI
+KeFlushMultipleTb(IN ULONG Number,
+                  IN PVOID *Virtual,
+                  IN BOOLEAN AllProcessors)
+{
+    KIRQL OldIrql;
+    ULONG i;
+
+    // FIXME: halfplemented
+    /* Raise the IRQL for the TB Flush */
+    OldIrql = KeRaiseIrqlToSynchLevel();
+
+    /* Flush the TB entries for the Current CPU */
+    for (i = 0; i < Number; i++)
+    {
+        KeInvalidateTlbEntry(Virtual[i]);
+    }
+
+    /* Return to original IRQL */
+    KeLowerIrql(OldIrql);
+}
+
 KAFFINITY
 NTAPI
 KeQueryActiveProcessors(VOID)
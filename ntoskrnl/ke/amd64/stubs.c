@@ -86,6 +86,31 @@ KeZeroPages(IN PVOID Address,
     RtlZeroMemory(Address, Size);
 }
 
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size)
+{
+    PULONG64 Current, End;
+
+    ASSERT(((ULONG_PTR)Address & (PAGE_SIZE - 1)) == 0);
+    ASSERT((Size & (PAGE_SIZE - 1)) == 0);
+
+    /* Nobody is going to touch these pages soon, so write around the caches */
+    End = (PULONG64)((ULONG_PTR)Address + Size);
+    for (Current = Address; Current < End; Current++)
+    {
+#ifdef _MSC_VER
+        _mm_stream_si64x((__int64*)Current, 0);
+#else
+        __asm__ __volatile__("movnti %1, %0" : "=m"(*Current) : "r"((ULONG64)0));
+#endif
+    }
+
+    /* Make the stores visible before the pages get handed out */
+    _mm_sfence();
+}
+
 PVOID
 NTAPI
 KeSwitchKernelStack(PVOID StackBase, PVOID StackLimit)
@@ -136,6 +161,16 @@ KiIdleLoop(VOID)
             KiRetireDpcList(Prcb);
         }
 
+#ifdef CONFIG_SMP
+        /* Check if we should look for work on the other processors */
+        if (Prcb->IdleSchedule)
+        {
+            _enable();
+            KiIdleSchedule(Prcb);
+            _disable();
+        }
+#endif
+
         /* Check if a new thread is scheduled for execution */
         if (Prcb->NextThread)
         {
@@ -60,6 +60,15 @@ KeZeroPages(IN PVOID Address,
     RtlZeroMemory(Address, Size);
 }
 
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size)
+{
+    /* No non-temporal stores here */
+    RtlZeroMemory(Address, Size);
+}
+
 VOID
 NTAPI
 KiSaveProcessorControlState(OUT PKPROCESSOR_STATE ProcessorState)
@@ -140,6 +149,34 @@ KeFlushEntireTb(IN BOOLEAN Invalid,
     KeLowerIrql(OldIrql);
 }
 
+VOID
+NTAPI
+KeFlushMultipleTb(IN ULONG Number,
+                  IN PVOID *Virtual,
+                  IN BOOLEAN AllProcessors)
+{
+    KIRQL OldIrql;
+    ULONG i;
+
+    //
+    // Raise the IRQL for the TB Flush
+    //
+    OldIrql = KeRaiseIrqlToSynchLevel();
+
+    //
+    // Flush the TB entries for the Current CPU
+    //
+    for (i = 0; i < Number; i++)
+    {
+        KeInvalidateTlbEntry(Virtual[i]);
+    }
+
+    //
+    // Return to Original IRQL
+    //
+    KeLowerIrql(OldIrql);
+}
+
 /*
  * @implemented
  */
@@ -20,7 +20,7 @@ ULONG KiMaximumDpcQueueDepth = 4;
 ULONG KiMinimumDpcRate = 3;
 ULONG KiAdjustDpcThreshold = 20;
 ULONG KiIdealDpcRate = 20;
-BOOLEAN KeThreadDpcEnable;
+BOOLEAN KeThreadDpcEnable = TRUE;
 FAST_MUTEX KiGenericCallDpcMutex;
 KDPC KiTimerExpireDpc;
 ULONG KiTimeLimitIsrMicroseconds;
@@ -28,6 +28,30 @@ ULONG KiDPCTimeout = 110;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+FORCEINLINE
+VOID
+KiCallDpcRoutine(IN PKDEFERRED_ROUTINE DeferredRoutine,
+                 IN PKDPC Dpc,
+                 IN PVOID DeferredContext,
+                 IN PVOID SystemArgument1,
+                 IN PVOID SystemArgument2,
+                 IN ULONG Type)
+{
+    ULONGLONG StartTime;
+
+    /* Time the call if DPC statistics are being collected */
+    if (KiDpcStatisticsEnabled)
+    {
+        StartTime = KiLockStatTimeStamp();
+        DeferredRoutine(Dpc, DeferredContext, SystemArgument1, SystemArgument2);
+        KiDpcStatRecord(DeferredRoutine, Type, StartTime);
+    }
+    else
+    {
+        DeferredRoutine(Dpc, DeferredContext, SystemArgument1, SystemArgument2);
+    }
+}
+
 VOID
 NTAPI
 KiCheckTimerTable(IN ULARGE_INTEGER CurrentTime)
@@ -185,8 +209,7 @@ KiTimerExpiration(IN PKDPC Dpc,
                 /* Check if we have a DPC */
                 if (TimerDpc)
                 {
-#ifdef CONFIG_SMP
-                    /* 
+                    /*
                      * If the DPC is targeted to another processor,
                      * then insert it into that processor's DPC queue
                      * instead of delivering it now.
@@ -195,8 +218,11 @@ KiTimerExpiration(IN PKDPC Dpc,
                      * then also insert it into the DPC queue for threaded delivery,
                      * instead of doing it here.
                      */
-                    if (((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
+                    if (
+#ifdef CONFIG_SMP
+                        ((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
                         ((TimerDpc->Number - MAXIMUM_PROCESSORS) != Prcb->Number)) ||
+#endif
                         ((TimerDpc->Type == ThreadedDpcObject) && (Prcb->ThreadDpcEnable)))
                     {
                         /* Queue it */
@@ -205,7 +231,6 @@ KiTimerExpiration(IN PKDPC Dpc,
                                          UlongToPtr(SystemTime.HighPart));
                     }
                     else
-#endif
                     {
                         /* Setup the DPC Entry */
                         DpcEntry[DpcCalls].Dpc = TimerDpc;
@@ -231,10 +256,12 @@ KiTimerExpiration(IN PKDPC Dpc,
 #endif
 
                         /* Call the DPC */
-                        DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                            DpcEntry[i].Context,
-                                            UlongToPtr(SystemTime.LowPart),
-                                            UlongToPtr(SystemTime.HighPart));
+                        KiCallDpcRoutine(DpcEntry[i].Routine,
+                                         DpcEntry[i].Dpc,
+                                         DpcEntry[i].Context,
+                                         UlongToPtr(SystemTime.LowPart),
+                                         UlongToPtr(SystemTime.HighPart),
+                                         KI_DPC_STAT_DPC);
                     }
 
                     /* Reset accounting */
@@ -279,10 +306,12 @@ KiTimerExpiration(IN PKDPC Dpc,
 #endif
 
                         /* Call the DPC */
-                        DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                            DpcEntry[i].Context,
-                                            UlongToPtr(SystemTime.LowPart),
-                                            UlongToPtr(SystemTime.HighPart));
+                        KiCallDpcRoutine(DpcEntry[i].Routine,
+                                         DpcEntry[i].Dpc,
+                                         DpcEntry[i].Context,
+                                         UlongToPtr(SystemTime.LowPart),
+                                         UlongToPtr(SystemTime.HighPart),
+                                         KI_DPC_STAT_DPC);
                     }
 
                     /* Reset accounting */
@@ -317,10 +346,12 @@ KiTimerExpiration(IN PKDPC Dpc,
 #endif
 
             /* Call the DPC */
-            DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                DpcEntry[i].Context,
-                                UlongToPtr(SystemTime.LowPart),
-                                UlongToPtr(SystemTime.HighPart));
+            KiCallDpcRoutine(DpcEntry[i].Routine,
+                             DpcEntry[i].Dpc,
+                             DpcEntry[i].Context,
+                             UlongToPtr(SystemTime.LowPart),
+                             UlongToPtr(SystemTime.HighPart),
+                             KI_DPC_STAT_DPC);
         }
 
         /* Lower IRQL if we need to */
@@ -397,8 +428,7 @@ KiTimerListExpire(IN PLIST_ENTRY ExpiredListHead,
         /* Check if we have a DPC */
         if (TimerDpc)
         {
-#ifdef CONFIG_SMP
-            /* 
+            /*
              * If the DPC is targeted to another processor,
              * then insert it into that processor's DPC queue
              * instead of delivering it now.
@@ -407,8 +437,11 @@ KiTimerListExpire(IN PLIST_ENTRY ExpiredListHead,
              * then also insert it into the DPC queue for threaded delivery,
              * instead of doing it here.
              */
-            if (((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
+            if (
+#ifdef CONFIG_SMP
+                ((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
                 ((TimerDpc->Number - MAXIMUM_PROCESSORS) != Prcb->Number)) ||
+#endif
                 ((TimerDpc->Type == ThreadedDpcObject) && (Prcb->ThreadDpcEnable)))
             {
                 /* Queue it */
@@ -417,7 +450,6 @@ KiTimerListExpire(IN PLIST_ENTRY ExpiredListHead,
                                  UlongToPtr(SystemTime.HighPart));
             }
             else
-#endif
             {
                 /* Setup the DPC Entry */
                 DpcEntry[DpcCalls].Dpc = TimerDpc;
@@ -444,10 +476,12 @@ KiTimerListExpire(IN PLIST_ENTRY ExpiredListHead,
 #endif
 
             /* Call the DPC */
-            DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                DpcEntry[i].Context,
-                                UlongToPtr(SystemTime.LowPart),
-                                UlongToPtr(SystemTime.HighPart));
+            KiCallDpcRoutine(DpcEntry[i].Routine,
+                             DpcEntry[i].Dpc,
+                             DpcEntry[i].Context,
+                             UlongToPtr(SystemTime.LowPart),
+                             UlongToPtr(SystemTime.HighPart),
+                             KI_DPC_STAT_DPC);
         }
         
         /* Lower IRQL */
@@ -629,10 +663,12 @@ KiRetireDpcList(IN PKPRCB Prcb)
                 _enable();
 
                 /* Call the DPC */
-                DeferredRoutine(Dpc,
-                                DeferredContext,
-                                SystemArgument1,
-                                SystemArgument2);
+                KiCallDpcRoutine(DeferredRoutine,
+                                 Dpc,
+                                 DeferredContext,
+                                 SystemArgument1,
+                                 SystemArgument2,
+                                 KI_DPC_STAT_DPC);
                 ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
 
                 /* Disable interrupts and keep looping */
@@ -672,6 +708,89 @@ KiRetireDpcList(IN PKPRCB Prcb)
     } while (DpcData->DpcQueueDepth != 0);
 }
 
+VOID
+NTAPI
+KiExecuteDpc(IN PVOID Context)
+{
+    PKPRCB Prcb = Context;
+    PKDPC_DATA DpcData = &Prcb->DpcData[DPC_THREADED];
+    PLIST_ENTRY ListHead = &DpcData->DpcListHead, DpcEntry;
+    PKDPC Dpc;
+    PKDEFERRED_ROUTINE DeferredRoutine;
+    PVOID DeferredContext, SystemArgument1, SystemArgument2;
+    KIRQL OldIrql;
+
+    /* Stay on our processor, above everything but the real-time threads */
+    KeSetSystemAffinityThread(AFFINITY_MASK(Prcb->Number));
+    KeSetPriorityThread(KeGetCurrentThread(), HIGH_PRIORITY);
+
+    /* We're ready, threaded DPCs can now be queued to us */
+    Prcb->ThreadDpcEnable = TRUE;
+
+    for (;;)
+    {
+        /* Wait for KeInsertQueueDpc to ask for us */
+        KeWaitForSingleObject(&Prcb->DpcEvent,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+        /* The list is also used at HIGH_LEVEL, by KeInsertQueueDpc */
+        KeRaiseIrql(HIGH_LEVEL, &OldIrql);
+        KiAcquireSpinLock(&DpcData->DpcLock);
+        Prcb->DpcThreadActive = TRUE;
+        Prcb->DpcThreadRequested = FALSE;
+
+        /* Loop while we have entries in the queue */
+        for (;;)
+        {
+            DpcEntry = ListHead->Flink;
+            if (DpcEntry == ListHead)
+            {
+                /* Done, new DPCs will have to wake us up again */
+                ASSERT(DpcData->DpcQueueDepth == 0);
+                Prcb->DpcThreadActive = FALSE;
+                break;
+            }
+
+            /* Remove the DPC from the list */
+            RemoveEntryList(DpcEntry);
+            Dpc = CONTAINING_RECORD(DpcEntry, KDPC, DpcListEntry);
+
+            /* Clear its DPC data and save its parameters */
+            Dpc->DpcData = NULL;
+            DeferredRoutine = Dpc->DeferredRoutine;
+            DeferredContext = Dpc->DeferredContext;
+            SystemArgument1 = Dpc->SystemArgument1;
+            SystemArgument2 = Dpc->SystemArgument2;
+
+            /* Decrease the queue depth */
+            DpcData->DpcQueueDepth--;
+
+            /* Release the lock and go back to PASSIVE_LEVEL */
+            KiReleaseSpinLock(&DpcData->DpcLock);
+            KeLowerIrql(OldIrql);
+
+            /* Call the DPC */
+            KiCallDpcRoutine(DeferredRoutine,
+                             Dpc,
+                             DeferredContext,
+                             SystemArgument1,
+                             SystemArgument2,
+                             KI_DPC_STAT_THREADED_DPC);
+            ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
+
+            /* Lock the list again and keep looping */
+            KeRaiseIrql(HIGH_LEVEL, &OldIrql);
+            KiAcquireSpinLock(&DpcData->DpcLock);
+        }
+
+        KiReleaseSpinLock(&DpcData->DpcLock);
+        KeLowerIrql(OldIrql);
+    }
+}
+
 VOID
 NTAPI
 KiInitializeDpc(IN PKDPC Dpc,
@@ -796,8 +915,17 @@ KeInsertQueueDpc(IN PKDPC Dpc,
             /* Make sure a threaded DPC isn't already active */
             if (!(Prcb->DpcThreadActive) && !(Prcb->DpcThreadRequested))
             {
-                /* FIXME: Setup Threaded DPC */
-                UNIMPLEMENTED_FATAL("Threaded DPC not supported\n");
+                /*
+                 * The DPC thread can't be readied from here, so have the
+                 * quantum end code signal its event on the next dispatch
+                 * interrupt instead.
+                 */
+                InterlockedExchange(&Prcb->DpcSetEventRequest, TRUE);
+                Prcb->DpcThreadRequested = TRUE;
+                Prcb->QuantumEnd = TRUE;
+
+                /* Set DPC inserted */
+                DpcInserted = TRUE;
             }
         }
         else
@@ -0,0 +1,233 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/ke/dpcstat.c
+ * PURPOSE:         DPC and ISR Duration Statistics
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * When booting with /DPCSTATS, every DPC routine, threaded DPC routine and
+ * ISR the kernel calls keeps a record here: how often it ran, for how long
+ * in total and at most, and a histogram of its durations. This is what
+ * finds the few routines that ruin the latency for everybody else.
+ *
+ * Like the lock statistics, the records are found by the address of the
+ * routine in a fixed table that is never cleaned up, so a routine that
+ * doesn't fit isn't tracked, and a driver that is unloaded keeps its entries.
+ */
+
+/* GLOBALS *******************************************************************/
+
+#define KI_DPC_STAT_TABLE_SIZE      512
+#define KI_DPC_STAT_MAX_PROBES      16
+#define KI_DPC_STAT_HASH(a)         ((((ULONG_PTR)(a)) >> 4) & (KI_DPC_STAT_TABLE_SIZE - 1))
+
+BOOLEAN KiDpcStatisticsEnabled;
+static KDPC_STATISTICS KiDpcStatistics[KI_DPC_STAT_TABLE_SIZE];
+static LONG KiDpcStatisticsOverflow;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+PKDPC_STATISTICS
+KiLookupDpcStatistics(IN PVOID Routine,
+                      IN ULONG Type)
+{
+    PKDPC_STATISTICS Entry;
+    PVOID Address;
+    ULONG Hash, i;
+
+    Hash = KI_DPC_STAT_HASH(Routine);
+    for (i = 0; i < KI_DPC_STAT_MAX_PROBES; i++)
+    {
+        Entry = &KiDpcStatistics[(Hash + i) & (KI_DPC_STAT_TABLE_SIZE - 1)];
+        Address = Entry->Routine;
+        if (Address == Routine) return Entry;
+
+        if (Address == NULL)
+        {
+            /* Claim the free slot, unless someone was faster */
+            Address = InterlockedCompareExchangePointer(&Entry->Routine, Routine, NULL);
+            if ((Address == NULL) || (Address == Routine))
+            {
+                Entry->Type = Type;
+                return Entry;
+            }
+        }
+    }
+
+    InterlockedIncrement(&KiDpcStatisticsOverflow);
+    return NULL;
+}
+
+static
+LONG
+KiDpcStatMicroseconds(IN ULONGLONG Ticks)
+{
+#if defined(_M_IX86) || defined(_M_AMD64)
+    ULONG MHz = KeGetCurrentPrcb()->MHz;
+
+    /* These are cycles, assume 1GHz if the speed wasn't measured */
+    Ticks /= MHz ? MHz : 1000;
+#else
+    /* This is interrupt time, in 100ns units */
+    Ticks /= 10;
+#endif
+
+    return (Ticks > MAXLONG) ? MAXLONG : (LONG)Ticks;
+}
+
+/* FUNCTIONS *****************************************************************/
+
+VOID
+FASTCALL
+KiDpcStatRecord(IN PVOID Routine,
+                IN ULONG Type,
+                IN ULONGLONG StartTime)
+{
+    PKDPC_STATISTICS Entry;
+    LONG Time, Maximum, OldMaximum;
+    ULONG Bucket;
+
+    Time = KiDpcStatMicroseconds(KiLockStatTimeStamp() - StartTime);
+
+    Entry = KiLookupDpcStatistics(Routine, Type);
+    if (!Entry) return;
+
+    InterlockedIncrement(&Entry->Count);
+    InterlockedExchangeAdd64(&Entry->TotalTime, Time);
+
+    /* Under 1us is the first bucket, then one per power of two */
+    if (!BitScanReverse(&Bucket, (ULONG)Time))
+    {
+        Bucket = 0;
+    }
+    else
+    {
+        Bucket = min(Bucket + 1, KI_DPC_STAT_BUCKETS - 1);
+    }
+    InterlockedIncrement(&Entry->Histogram[Bucket]);
+
+    /* Keep the longest call, other processors may be racing us for it */
+    Maximum = Entry->MaximumTime;
+    while (Time > Maximum)
+    {
+        OldMaximum = InterlockedCompareExchange(&Entry->MaximumTime, Time, Maximum);
+        if (OldMaximum == Maximum) break;
+        Maximum = OldMaximum;
+    }
+}
+
+BOOLEAN
+NTAPI
+KiGetNextDpcStatistics(IN OUT PULONG Index,
+                       OUT PKDPC_STATISTICS Statistics)
+{
+    /* Skip the free slots */
+    while (*Index < KI_DPC_STAT_TABLE_SIZE)
+    {
+        if (KiDpcStatistics[*Index].Routine)
+        {
+            *Statistics = KiDpcStatistics[*Index];
+            (*Index)++;
+            return TRUE;
+        }
+
+        (*Index)++;
+    }
+
+    return FALSE;
+}
+
+#if DBG && defined(KDBG)
+BOOLEAN
+ExpKdbgExtDpcs(ULONG Argc, PCHAR Argv[])
+{
+    PKDPC_STATISTICS Entry;
+    ULONG i, j;
+    PCSTR Name;
+
+    if (!KiDpcStatisticsEnabled)
+    {
+        KdbpPrint("DPC statistics are disabled, boot with /DPCSTATS to collect them.\n");
+        return TRUE;
+    }
+
+    if ((Argc > 1) && !_stricmp(Argv[1], "reset"))
+    {
+        /* Keep the slots, the routines are still there */
+        for (i = 0; i < KI_DPC_STAT_TABLE_SIZE; i++)
+        {
+            Entry = &KiDpcStatistics[i];
+            Entry->Count = 0;
+            Entry->TotalTime = 0;
+            Entry->MaximumTime = 0;
+            RtlZeroMemory(Entry->Histogram, sizeof(Entry->Histogram));
+        }
+        KiDpcStatisticsOverflow = 0;
+        return TRUE;
+    }
+
+    KdbpPrint("Routine\t\tType\t\tCalls\t\tAverage\t\tMaximum (us)\n");
+    for (i = 0; i < KI_DPC_STAT_TABLE_SIZE; i++)
+    {
+        Entry = &KiDpcStatistics[i];
+        if (!(Entry->Routine) || !(Entry->Count)) continue;
+
+        switch (Entry->Type)
+        {
+            case KI_DPC_STAT_THREADED_DPC:
+                Name = "Threaded DPC";
+                break;
+
+            case KI_DPC_STAT_ISR:
+                Name = "ISR";
+                break;
+
+            default:
+                Name = "DPC";
+                break;
+        }
+
+        KdbpPrint("%p\t%-12s\t%ld\t\t%I64d\t\t%ld\n",
+                  Entry->Routine,
+                  Name,
+                  Entry->Count,
+                  Entry->TotalTime / Entry->Count,
+                  Entry->MaximumTime);
+
+        KdbpPrint("\t\t");
+        if (!KdbSymPrintAddress(Entry->Routine, NULL)) KdbpPrint("<%p>", Entry->Routine);
+        KdbpPrint("\n");
+
+        for (j = 0; j < KI_DPC_STAT_BUCKETS; j++)
+        {
+            if (!Entry->Histogram[j]) continue;
+
+            if (j == KI_DPC_STAT_BUCKETS - 1)
+            {
+                KdbpPrint("\t\t>= %lu us: %ld\n", 1UL << (j - 1), Entry->Histogram[j]);
+            }
+            else
+            {
+                KdbpPrint("\t\t<  %lu us: %ld\n", 1UL << j, Entry->Histogram[j]);
+            }
+        }
+    }
+
+    if (KiDpcStatisticsOverflow)
+    {
+        KdbpPrint("%ld routines didn't fit in the table and weren't tracked.\n", KiDpcStatisticsOverflow);
+    }
+
+    return TRUE;
+}
+#endif
+
+/* EOF */
@@ -75,8 +75,9 @@ KePulseEvent(IN PKEVENT Event,
     ASSERT_EVENT(Event);
     ASSERT_IRQL_LESS_OR_EQUAL(DISPATCH_LEVEL);
 
-    /* Lock the Dispatcher Database */
+    /* Lock the Dispatcher Database and the event */
     OldIrql = KiAcquireDispatcherLock();
+    KiAcquireDispatcherObject(&Event->Header);
 
     /* Save the Old State */
     PreviousState = Event->Header.SignalState;
@@ -93,6 +94,7 @@ KePulseEvent(IN PKEVENT Event,
 
     /* Unsignal it */
     Event->Header.SignalState = 0;
+    KiReleaseDispatcherObject(&Event->Header);
 
     /* Check what wait state was requested */
     if (Wait == FALSE)
@@ -137,8 +139,9 @@ KeResetEvent(IN PKEVENT Event)
     ASSERT_EVENT(Event);
     ASSERT_IRQL_LESS_OR_EQUAL(DISPATCH_LEVEL);
 
-    /* Lock the Dispatcher Database */
-    OldIrql = KiAcquireDispatcherLock();
+    /* Nobody gets woken up by this, so the event lock is enough */
+    OldIrql = KeRaiseIrqlToSynchLevel();
+    KiAcquireDispatcherObject(&Event->Header);
 
     /* Save the Previous State */
     PreviousState = Event->Header.SignalState;
@@ -146,8 +149,9 @@ KeResetEvent(IN PKEVENT Event)
     /* Set it to zero */
     Event->Header.SignalState = 0;
 
-    /* Release Dispatcher Database and return previous state */
-    KiReleaseDispatcherLock(OldIrql);
+    /* Release the event and return previous state */
+    KiReleaseDispatcherObject(&Event->Header);
+    KeLowerIrql(OldIrql);
     return PreviousState;
 }
 
@@ -178,8 +182,37 @@ KeSetEvent(IN PKEVENT Event,
         return TRUE;
     }
 
-    /* Lock the Dispathcer Database */
-    OldIrql = KiAcquireDispatcherLock();
+    /* Raise to synch level, where all the locks below are taken */
+    OldIrql = KeRaiseIrqlToSynchLevel();
+
+    /*
+     * Check if nobody is waiting for the event and we don't need to return
+     * with the dispatcher lock held. Waiters only queue themselves with the
+     * event lock held, so it is enough to just set the event.
+     */
+    if (!Wait)
+    {
+        /* Lock the event and check for waiters */
+        KiAcquireDispatcherObject(&Event->Header);
+        if (IsListEmpty(&Event->Header.WaitListHead))
+        {
+            /* Set the Event to Signaled */
+            PreviousState = Event->Header.SignalState;
+            Event->Header.SignalState = 1;
+
+            /* Release the event and return the previous state */
+            KiReleaseDispatcherObject(&Event->Header);
+            KeLowerIrql(OldIrql);
+            return PreviousState;
+        }
+
+        /* There are waiters, the dispatcher lock must come first */
+        KiReleaseDispatcherObject(&Event->Header);
+    }
+
+    /* Lock the Dispatcher Database and the event */
+    KiAcquireDispatcherLockAtSynchLevel();
+    KiAcquireDispatcherObject(&Event->Header);
 
     /* Save the Previous State */
     PreviousState = Event->Header.SignalState;
@@ -191,7 +224,7 @@ KeSetEvent(IN PKEVENT Event,
     if (!(PreviousState) && !(IsListEmpty(&Event->Header.WaitListHead)))
     {
         /* Check the type of event */
-        if (Event->Header.Type == EventNotificationObject)
+        if ((Event->Header.Type & KOBJECT_TYPE_MASK) == EventNotificationObject)
         {
             /* Unwait the thread */
             KxUnwaitThread(&Event->Header, Increment);
@@ -203,6 +236,9 @@ KeSetEvent(IN PKEVENT Event,
         }
     }
 
+    /* Release the event */
+    KiReleaseDispatcherObject(&Event->Header);
+
     /* Check what wait state was requested */
     if (!Wait)
     {
@@ -232,11 +268,12 @@ KeSetEventBoostPriority(IN PKEVENT Event,
     KIRQL OldIrql;
     PKWAIT_BLOCK WaitBlock;
     PKTHREAD Thread = KeGetCurrentThread(), WaitThread;
-    ASSERT(Event->Header.Type == EventSynchronizationObject);
+    ASSERT((Event->Header.Type & KOBJECT_TYPE_MASK) == EventSynchronizationObject);
     ASSERT_IRQL_LESS_OR_EQUAL(DISPATCH_LEVEL);
 
-    /* Acquire Dispatcher Database Lock */
+    /* Acquire Dispatcher Database Lock and the event */
     OldIrql = KiAcquireDispatcherLock();
+    KiAcquireDispatcherObject(&Event->Header);
 
     /* Check if the list is empty */
     if (IsListEmpty(&Event->Header.WaitListHead))
@@ -245,6 +282,7 @@ KeSetEventBoostPriority(IN PKEVENT Event,
         Event->Header.SignalState = 1;
 
         /* Return */
+        KiReleaseDispatcherObject(&Event->Header);
         KiReleaseDispatcherLock(OldIrql);
         return;
     }
@@ -283,7 +321,8 @@ KeSetEventBoostPriority(IN PKEVENT Event,
         KiReadyThread(WaitThread);
     }
 
-    /* Release the Dispatcher Database Lock */
+    /* Release the event and the Dispatcher Database Lock */
+    KiReleaseDispatcherObject(&Event->Header);
     KiReleaseDispatcherLock(OldIrql);
 }
 
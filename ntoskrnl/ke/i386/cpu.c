@@ -1138,6 +1138,38 @@ KeZeroPages(IN PVOID Address,
     RtlZeroMemory(Address, Size);
 }
 
+VOID
+FASTCALL
+KeZeroPagesFromIdleThread(IN PVOID Address,
+                          IN ULONG Size)
+{
+    PULONG Current, End;
+
+    ASSERT(((ULONG_PTR)Address & (PAGE_SIZE - 1)) == 0);
+    ASSERT((Size & (PAGE_SIZE - 1)) == 0);
+
+    /* movnti came with SSE2, which not every processor we run on has */
+    if (!(KeFeatureBits & KF_XMMI64))
+    {
+        RtlZeroMemory(Address, Size);
+        return;
+    }
+
+    /* Nobody is going to touch these pages soon, so write around the caches */
+    End = (PULONG)((ULONG_PTR)Address + Size);
+    for (Current = Address; Current < End; Current++)
+    {
+#ifdef _MSC_VER
+        _mm_stream_si32((int*)Current, 0);
+#else
+        __asm__ __volatile__("movnti %1, %0" : "=m"(*Current) : "r"((ULONG)0));
+#endif
+    }
+
+    /* Make the stores visible before the pages get handed out */
+    _mm_sfence();
+}
+
 VOID
 NTAPI
 KiSaveProcessorState(IN PKTRAP_FRAME TrapFrame,
@@ -1443,6 +1475,26 @@ KiFlushTargetEntireTb(IN PKIPI_CONTEXT PacketContext,
     KeFlushCurrentTb();
 }
 
+VOID
+NTAPI
+KiFlushTargetMultipleTb(IN PKIPI_CONTEXT PacketContext,
+                        IN PVOID Ignored,
+                        IN PVOID Virtual,
+                        IN PVOID Number)
+{
+    PVOID *VirtualAddresses = Virtual;
+    ULONG i, Count = *(PULONG)Number;
+
+    /* Flush the TB entries for the Current CPU */
+    for (i = 0; i < Count; i++)
+    {
+        KeInvalidateTlbEntry(VirtualAddresses[i]);
+    }
+
+    /* Signal this packet as done, the list belongs to the sender */
+    KiIpiSignalPacketDone(PacketContext);
+}
+
 /*
  * @implemented
  */
@@ -1463,8 +1515,17 @@ KeFlushEntireTb(IN BOOLEAN Invalid,
 #ifdef CONFIG_SMP
     /* FIXME: Use KiTbFlushTimeStamp to synchronize TB flush */
 
-    /* Get the current processor affinity, and exclude ourselves */
-    TargetAffinity = KeActiveProcessors;
+    /* Only the processors running this address space need it, unless asked otherwise */
+    if (AllProcessors)
+    {
+        TargetAffinity = KeActiveProcessors;
+    }
+    else
+    {
+        TargetAffinity = KeGetCurrentThread()->ApcState.Process->ActiveProcessors;
+    }
+
+    /* Exclude ourselves */
     TargetAffinity &= ~Prcb->SetMember;
 
     /* Make sure this is MP */
@@ -1499,6 +1560,70 @@ KeFlushEntireTb(IN BOOLEAN Invalid,
     KeLowerIrql(OldIrql);
 }
 
+VOID
+NTAPI
+KeFlushMultipleTb(IN ULONG Number,
+                  IN PVOID *Virtual,
+                  IN BOOLEAN AllProcessors)
+{
+    KIRQL OldIrql;
+    ULONG i;
+#ifdef CONFIG_SMP
+    KAFFINITY TargetAffinity;
+    PKPRCB Prcb = KeGetCurrentPrcb();
+#endif
+
+    /* Raise the IRQL for the TB Flush */
+    OldIrql = KeRaiseIrqlToSynchLevel();
+
+#ifdef CONFIG_SMP
+    /* Only the processors running this address space need it, unless asked otherwise */
+    if (AllProcessors)
+    {
+        TargetAffinity = KeActiveProcessors;
+    }
+    else
+    {
+        TargetAffinity = KeGetCurrentThread()->ApcState.Process->ActiveProcessors;
+    }
+
+    /* Exclude ourselves */
+    TargetAffinity &= ~Prcb->SetMember;
+
+    /* Make sure this is MP */
+    if (TargetAffinity)
+    {
+        /* The whole batch goes out in a single IPI */
+        KiIpiSendPacket(TargetAffinity,
+                        KiFlushTargetMultipleTb,
+                        NULL,
+                        (ULONG_PTR)Virtual,
+                        &Number);
+    }
+#endif
+
+    /* Flush the TB entries for the Current CPU */
+    for (i = 0; i < Number; i++)
+    {
+        KeInvalidateTlbEntry(Virtual[i]);
+    }
+
+#ifdef CONFIG_SMP
+    /* If this is MP, wait for the other processors to finish */
+    if (TargetAffinity)
+    {
+        /* Sanity check */
+        ASSERT(Prcb == KeGetCurrentPrcb());
+
+        /* FIXME: TODO */
+        ASSERTMSG("Not yet implemented\n", FALSE);
+    }
+#endif
+
+    /* Return to original IRQL */
+    KeLowerIrql(OldIrql);
+}
+
 /*
  * @implemented
  */
@@ -198,6 +198,7 @@ KiInterruptDispatch(IN PKTRAP_FRAME TrapFrame,
                     IN PKINTERRUPT Interrupt)
 {
     KIRQL OldIrql;
+    ULONGLONG StartTime = 0;
 
     /* Increase interrupt count */
     KeGetCurrentPrcb()->InterruptCount++;
@@ -211,7 +212,9 @@ KiInterruptDispatch(IN PKTRAP_FRAME TrapFrame,
         KxAcquireSpinLock(Interrupt->ActualLock);
 
         /* Call the ISR */
+        if (KiDpcStatisticsEnabled) StartTime = KiLockStatTimeStamp();
         Interrupt->ServiceRoutine(Interrupt, Interrupt->ServiceContext);
+        if (StartTime) KiDpcStatRecord(Interrupt->ServiceRoutine, KI_DPC_STAT_ISR, StartTime);
 
         /* Release interrupt lock */
         KxReleaseSpinLock(Interrupt->ActualLock);
@@ -234,6 +237,7 @@ KiChainedDispatch(IN PKTRAP_FRAME TrapFrame,
     KIRQL OldIrql, OldInterruptIrql = 0;
     BOOLEAN Handled;
     PLIST_ENTRY NextEntry, ListHead;
+    ULONGLONG StartTime = 0;
 
     /* Increase interrupt count */
     KeGetCurrentPrcb()->InterruptCount++;
@@ -259,8 +263,10 @@ KiChainedDispatch(IN PKTRAP_FRAME TrapFrame,
             KxAcquireSpinLock(Interrupt->ActualLock);
 
             /* Call the ISR */
+            if (KiDpcStatisticsEnabled) StartTime = KiLockStatTimeStamp();
             Handled = Interrupt->ServiceRoutine(Interrupt,
                                                 Interrupt->ServiceContext);
+            if (StartTime) KiDpcStatRecord(Interrupt->ServiceRoutine, KI_DPC_STAT_ISR, StartTime);
 
             /* Release interrupt lock */
             KxReleaseSpinLock(Interrupt->ActualLock);
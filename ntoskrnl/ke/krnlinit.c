@@ -36,7 +36,7 @@ CCHAR KeNumberProcessors = 0;
 
 /* NUMA Node Support */
 KNODE KiNode0;
-PKNODE KeNodeBlock[1];
+PKNODE KeNodeBlock[MAXIMUM_CCNUMA_NODES];
 UCHAR KeNumberNodes = 1;
 UCHAR KeProcessNodeSeed;
 
@@ -204,6 +204,11 @@ KiInitSpinLocks(IN PKPRCB Prcb,
     KeInitializeSpinLock(&Prcb->DpcData[DPC_NORMAL].DpcLock);
     Prcb->DpcData[DPC_NORMAL].DpcQueueDepth = 0;
     Prcb->DpcData[DPC_NORMAL].DpcCount = 0;
+    InitializeListHead(&Prcb->DpcData[DPC_THREADED].DpcListHead);
+    KeInitializeSpinLock(&Prcb->DpcData[DPC_THREADED].DpcLock);
+    Prcb->DpcData[DPC_THREADED].DpcQueueDepth = 0;
+    Prcb->DpcData[DPC_THREADED].DpcCount = 0;
+    KeInitializeEvent(&Prcb->DpcEvent, SynchronizationEvent, FALSE);
     Prcb->DpcRoutineActive = FALSE;
     Prcb->MaximumDpcQueueDepth = KiMaximumDpcQueueDepth;
     Prcb->MinimumDpcRate = KiMinimumDpcRate;
@@ -292,11 +297,35 @@ BOOLEAN
 NTAPI
 KeInitSystem(VOID)
 {
+    HANDLE ThreadHandle;
+    PKPRCB Prcb;
+    NTSTATUS Status;
+    LONG i;
+
     /* Check if Threaded DPCs are enabled */
     if (KeThreadDpcEnable)
     {
-        /* FIXME: TODO */
-        DPRINT1("Threaded DPCs not yet supported\n");
+        /* Create the DPC thread of each processor */
+        for (i = 0; i < KeNumberProcessors; i++)
+        {
+            Prcb = KiProcessorBlock[i];
+            Status = PsCreateSystemThread(&ThreadHandle,
+                                          THREAD_ALL_ACCESS,
+                                          NULL,
+                                          NULL,
+                                          NULL,
+                                          KiExecuteDpc,
+                                          Prcb);
+            if (!NT_SUCCESS(Status))
+            {
+                /* Its threaded DPCs will run as normal ones */
+                DPRINT1("No DPC thread for CPU %ld (0x%lx)\n", i, Status);
+                continue;
+            }
+
+            /* It never goes away */
+            ObCloseHandle(ThreadHandle, KernelMode);
+        }
     }
 
     /* Initialize non-portable parts of the kernel */
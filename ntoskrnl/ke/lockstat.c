@@ -0,0 +1,284 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/ke/lockstat.c
+ * PURPOSE:         Lock Contention Statistics
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * When booting with /LOCKSTATS, the spinlocks, queued spinlocks and
+ * resources taken through the kernel keep a record here: how often they
+ * were acquired and contended, how long was spent spinning or waiting for
+ * them, how long the spinlocks were held, and who hit them while they were
+ * busy. Locks the HAL takes directly for its callers aren't seen.
+ *
+ * The records are found by the address of the lock, in a fixed table that
+ * is never cleaned up: a lock that doesn't fit is simply not tracked.
+ */
+
+/* GLOBALS *******************************************************************/
+
+#define KI_LOCK_STAT_TABLE_SIZE     1024
+#define KI_LOCK_STAT_MAX_PROBES     16
+#define KI_LOCK_STAT_HASH(a)        ((((ULONG_PTR)(a)) >> 3) & (KI_LOCK_STAT_TABLE_SIZE - 1))
+
+BOOLEAN KiLockStatisticsEnabled;
+static KLOCK_STATISTICS KiLockStatistics[KI_LOCK_STAT_TABLE_SIZE];
+static LONG KiLockStatisticsOverflow;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+PKLOCK_STATISTICS
+KiLookupLockStatistics(IN PVOID Lock,
+                       IN ULONG Type,
+                       IN BOOLEAN Create)
+{
+    PKLOCK_STATISTICS Entry;
+    PVOID Address;
+    ULONG Hash, i;
+
+    Hash = KI_LOCK_STAT_HASH(Lock);
+    for (i = 0; i < KI_LOCK_STAT_MAX_PROBES; i++)
+    {
+        Entry = &KiLockStatistics[(Hash + i) & (KI_LOCK_STAT_TABLE_SIZE - 1)];
+        Address = Entry->Address;
+        if (Address == Lock) return Entry;
+
+        if (Address == NULL)
+        {
+            if (!Create) return NULL;
+
+            /* Claim the free slot, unless someone was faster */
+            Address = InterlockedCompareExchangePointer(&Entry->Address, Lock, NULL);
+            if ((Address == NULL) || (Address == Lock))
+            {
+                Entry->Type = Type;
+                return Entry;
+            }
+        }
+    }
+
+    if (Create) InterlockedIncrement(&KiLockStatisticsOverflow);
+    return NULL;
+}
+
+static
+VOID
+KiRecordLockCaller(IN PKLOCK_STATISTICS Entry,
+                   IN PVOID Caller)
+{
+    ULONG i;
+
+    for (i = 0; i < KI_LOCK_STAT_CALLERS; i++)
+    {
+        /* Keep the first callers we see, the others are only counted */
+        if ((Entry->Callers[i] == Caller) ||
+            (InterlockedCompareExchangePointer(&Entry->Callers[i], Caller, NULL) == NULL))
+        {
+            InterlockedIncrement(&Entry->CallerCount[i]);
+            return;
+        }
+    }
+}
+
+/* FUNCTIONS *****************************************************************/
+
+VOID
+FASTCALL
+KiLockStatContended(IN PVOID Lock,
+                    IN ULONG Type,
+                    IN ULONGLONG WaitStart,
+                    IN PVOID Caller)
+{
+    PKLOCK_STATISTICS Entry;
+
+    Entry = KiLookupLockStatistics(Lock, Type, TRUE);
+    if (!Entry) return;
+
+    InterlockedIncrement(&Entry->ContentionCount);
+    InterlockedExchangeAdd64(&Entry->SpinCycles, KiLockStatTimeStamp() - WaitStart);
+    KiRecordLockCaller(Entry, Caller);
+}
+
+VOID
+FASTCALL
+KiLockStatAcquired(IN PVOID Lock,
+                   IN ULONG Type,
+                   IN ULONGLONG SpinStart,
+                   IN PVOID Caller)
+{
+    PKLOCK_STATISTICS Entry;
+    ULONGLONG Now;
+
+    Entry = KiLookupLockStatistics(Lock, Type, TRUE);
+    if (!Entry) return;
+
+    InterlockedIncrement(&Entry->AcquireCount);
+
+    Now = KiLockStatTimeStamp();
+    if (SpinStart)
+    {
+        InterlockedIncrement(&Entry->ContentionCount);
+        InterlockedExchangeAdd64(&Entry->SpinCycles, Now - SpinStart);
+        KiRecordLockCaller(Entry, Caller);
+    }
+
+    /* Spinlocks have a single owner, which is who keeps the hold time */
+    if (Type != KI_LOCK_STAT_RESOURCE) Entry->AcquireTime = Now;
+}
+
+VOID
+FASTCALL
+KiLockStatReleased(IN PVOID Lock)
+{
+    PKLOCK_STATISTICS Entry;
+
+    Entry = KiLookupLockStatistics(Lock, 0, FALSE);
+    if (!(Entry) || !(Entry->AcquireTime)) return;
+
+    /* We still own the lock, so nobody else is touching these */
+    Entry->HoldCycles += KiLockStatTimeStamp() - Entry->AcquireTime;
+    Entry->AcquireTime = 0;
+}
+
+VOID
+FASTCALL
+KiAcquireSpinLockWithStatistics(IN PKSPIN_LOCK SpinLock,
+                                IN ULONG Type,
+                                IN PVOID Caller)
+{
+    ULONGLONG SpinStart = 0;
+
+#ifdef CONFIG_SMP
+    /* Only peek at the lock, this is about telling whether we'll spin */
+    if (*(volatile KSPIN_LOCK *)SpinLock & 1) SpinStart = KiLockStatTimeStamp();
+#endif
+
+    KxAcquireSpinLock(SpinLock);
+    KiLockStatAcquired(SpinLock, Type, SpinStart, Caller);
+}
+
+PKLOCK_STATISTICS
+NTAPI
+KiFindLockStatistics(IN PVOID Lock)
+{
+    return KiLookupLockStatistics(Lock, 0, FALSE);
+}
+
+BOOLEAN
+NTAPI
+KiGetNextLockStatistics(IN OUT PULONG Index,
+                        OUT PKLOCK_STATISTICS Statistics)
+{
+    /* Skip the free slots */
+    while (*Index < KI_LOCK_STAT_TABLE_SIZE)
+    {
+        if (KiLockStatistics[*Index].Address)
+        {
+            *Statistics = KiLockStatistics[*Index];
+            (*Index)++;
+            return TRUE;
+        }
+
+        (*Index)++;
+    }
+
+    return FALSE;
+}
+
+#if DBG && defined(KDBG)
+BOOLEAN
+ExpKdbgExtLocks(ULONG Argc, PCHAR Argv[])
+{
+    PKLOCK_STATISTICS Entry;
+    PKPRCB Prcb = KeGetCurrentPrcb();
+    ULONG i, j;
+    PCSTR Name;
+    CHAR Buffer[16];
+
+    if (!KiLockStatisticsEnabled)
+    {
+        KdbpPrint("Lock statistics are disabled, boot with /LOCKSTATS to collect them.\n");
+        return TRUE;
+    }
+
+    if ((Argc > 1) && !_stricmp(Argv[1], "reset"))
+    {
+        /* Keep the slots, there may be owners about to release them */
+        for (i = 0; i < KI_LOCK_STAT_TABLE_SIZE; i++)
+        {
+            Entry = &KiLockStatistics[i];
+            Entry->AcquireCount = 0;
+            Entry->ContentionCount = 0;
+            Entry->SpinCycles = 0;
+            Entry->HoldCycles = 0;
+            RtlZeroMemory(Entry->Callers, sizeof(Entry->Callers));
+            RtlZeroMemory(Entry->CallerCount, sizeof(Entry->CallerCount));
+        }
+        KiLockStatisticsOverflow = 0;
+        return TRUE;
+    }
+
+    KdbpPrint("Lock\t\tType\t\tAcquires\tContended\tSpin/wait\tHold (avg cycles)\n");
+    for (i = 0; i < KI_LOCK_STAT_TABLE_SIZE; i++)
+    {
+        Entry = &KiLockStatistics[i];
+        if (!(Entry->Address) || !(Entry->AcquireCount)) continue;
+
+        switch (Entry->Type)
+        {
+            case KI_LOCK_STAT_QUEUED_LOCK:
+                /* Name queued locks by their index, which is what they're known by */
+                Name = "Queued";
+                for (j = 0; j < LockQueueMaximumLock; j++)
+                {
+                    if (Prcb->LockQueue[j].Lock == Entry->Address)
+                    {
+                        sprintf(Buffer, "Queued[%lu]", j);
+                        Name = Buffer;
+                        break;
+                    }
+                }
+                break;
+
+            case KI_LOCK_STAT_RESOURCE:
+                Name = "Resource";
+                break;
+
+            default:
+                Name = "Spinlock";
+                break;
+        }
+
+        KdbpPrint("%p\t%-12s\t%ld\t\t%ld\t\t%I64u\t\t%I64u\n",
+                  Entry->Address,
+                  Name,
+                  Entry->AcquireCount,
+                  Entry->ContentionCount,
+                  Entry->ContentionCount ? Entry->SpinCycles / Entry->ContentionCount : 0,
+                  (Entry->Type != KI_LOCK_STAT_RESOURCE) ? Entry->HoldCycles / Entry->AcquireCount : 0);
+
+        for (j = 0; j < KI_LOCK_STAT_CALLERS; j++)
+        {
+            if (!Entry->Callers[j]) break;
+            KdbpPrint("\t\tContended from %p (%ld)\n", Entry->Callers[j], Entry->CallerCount[j]);
+        }
+    }
+
+    if (KiLockStatisticsOverflow)
+    {
+        KdbpPrint("%ld locks didn't fit in the table and weren't tracked.\n", KiLockStatisticsOverflow);
+    }
+
+    return TRUE;
+}
+#endif
+
+/* EOF */
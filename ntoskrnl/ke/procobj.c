@@ -154,14 +154,14 @@ KeInitializeProcess(IN OUT PKPROCESS Process,
     if (KeNumberNodes > 1)
     {
         /* Set the new seed */
-        KeProcessNodeSeed = (KeProcessNodeSeed + 1) / KeNumberNodes;
+        KeProcessNodeSeed = (KeProcessNodeSeed + 1) % KeNumberNodes;
         IdealNode = KeProcessNodeSeed;
 
         /* Loop every node */
         do
         {
             /* Check if the affinity matches */
-            if (KeNodeBlock[IdealNode]->ProcessorMask != Affinity) break;
+            if (KeNodeBlock[IdealNode]->ProcessorMask & Affinity) break;
 
             /* No match, try next Ideal Node and increase node loop index */
             IdealNode++;
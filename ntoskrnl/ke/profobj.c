@@ -356,6 +356,9 @@ KeProfileInterruptWithSource(IN PKTRAP_FRAME TrapFrame,
 {
     PKPROCESS Process = KeGetCurrentThread()->ApcState.Process;
 
+    /* Notify WMI */
+    WmiTraceProfile(TrapFrame, Source);
+
     /* We have to parse 2 lists. Per-Process and System-Wide */
     KiParseProfileList(TrapFrame, Source, &Process->ProfileListHead);
     KiParseProfileList(TrapFrame, Source, &KiProfileListHead);
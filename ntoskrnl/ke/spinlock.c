@@ -15,6 +15,34 @@
 #define LQ_WAIT     1
 #define LQ_OWN      2
 
+FORCEINLINE
+VOID
+KiAcquireTrackedSpinLock(IN PKSPIN_LOCK SpinLock,
+                         IN ULONG Type,
+                         IN PVOID Caller)
+{
+    /* Keep statistics if we were asked to */
+    if (KiLockStatisticsEnabled)
+    {
+        KiAcquireSpinLockWithStatistics(SpinLock, Type, Caller);
+        return;
+    }
+
+    /* Otherwise it's just the inlined function */
+    KxAcquireSpinLock(SpinLock);
+}
+
+FORCEINLINE
+VOID
+KiReleaseTrackedSpinLock(IN PKSPIN_LOCK SpinLock)
+{
+    /* Account for the hold time before anyone else can get the lock */
+    if (KiLockStatisticsEnabled) KiLockStatReleased(SpinLock);
+
+    /* Then it's just the inlined function */
+    KxReleaseSpinLock(SpinLock);
+}
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 #if 0
@@ -111,7 +139,7 @@ KeAcquireQueuedSpinLockAtDpcLevel(IN PKSPIN_LOCK_QUEUE LockHandle)
     }
 
     /* Do the inlined function */
-    KxAcquireSpinLock(LockHandle->Lock);
+    KiAcquireTrackedSpinLock(LockHandle->Lock, KI_LOCK_STAT_QUEUED_LOCK, _ReturnAddress());
 #endif
 }
 
@@ -132,7 +160,7 @@ KeReleaseQueuedSpinLockFromDpcLevel(IN PKSPIN_LOCK_QUEUE LockHandle)
     }
 
     /* Do the inlined function */
-    KxReleaseSpinLock(LockHandle->Lock);
+    KiReleaseTrackedSpinLock(LockHandle->Lock);
 #endif
 }
 
@@ -203,7 +231,7 @@ KeAcquireSpinLockAtDpcLevel(IN PKSPIN_LOCK SpinLock)
     }
 
     /* Do the inlined function */
-    KxAcquireSpinLock(SpinLock);
+    KiAcquireTrackedSpinLock(SpinLock, KI_LOCK_STAT_SPIN_LOCK, _ReturnAddress());
 }
 
 /*
@@ -226,7 +254,7 @@ KeReleaseSpinLockFromDpcLevel(IN PKSPIN_LOCK SpinLock)
     }
 
     /* Do the inlined function */
-    KxReleaseSpinLock(SpinLock);
+    KiReleaseTrackedSpinLock(SpinLock);
 }
 
 /*
@@ -248,7 +276,7 @@ KefAcquireSpinLockAtDpcLevel(IN PKSPIN_LOCK SpinLock)
     }
 
     /* Do the inlined function */
-    KxAcquireSpinLock(SpinLock);
+    KiAcquireTrackedSpinLock(SpinLock, KI_LOCK_STAT_SPIN_LOCK, _ReturnAddress());
 }
 
 /*
@@ -270,7 +298,7 @@ KefReleaseSpinLockFromDpcLevel(IN PKSPIN_LOCK SpinLock)
     }
 
     /* Do the inlined function */
-    KxReleaseSpinLock(SpinLock);
+    KiReleaseTrackedSpinLock(SpinLock);
 }
 
 /*
@@ -281,7 +309,7 @@ FASTCALL
 KiAcquireSpinLock(IN PKSPIN_LOCK SpinLock)
 {
     /* Do the inlined function */
-    KxAcquireSpinLock(SpinLock);
+    KiAcquireTrackedSpinLock(SpinLock, KI_LOCK_STAT_SPIN_LOCK, _ReturnAddress());
 }
 
 /*
@@ -292,7 +320,7 @@ FASTCALL
 KiReleaseSpinLock(IN PKSPIN_LOCK SpinLock)
 {
     /* Do the inlined function */
-    KxReleaseSpinLock(SpinLock);
+    KiReleaseTrackedSpinLock(SpinLock);
 }
 
 /*
@@ -356,7 +384,7 @@ KeAcquireInStackQueuedSpinLockAtDpcLevel(IN PKSPIN_LOCK SpinLock,
     }
 
     /* Acquire the lock */
-    KxAcquireSpinLock(LockHandle->LockQueue.Lock); // HACK
+    KiAcquireTrackedSpinLock(LockHandle->LockQueue.Lock, KI_LOCK_STAT_SPIN_LOCK, _ReturnAddress()); // HACK
 #endif
 #endif
 }
@@ -385,7 +413,7 @@ KeReleaseInStackQueuedSpinLockFromDpcLevel(IN PKLOCK_QUEUE_HANDLE LockHandle)
     }
 
     /* Release the lock */
-    KxReleaseSpinLock(LockHandle->LockQueue.Lock); // HACK
+    KiReleaseTrackedSpinLock(LockHandle->LockQueue.Lock); // HACK
 #endif
 #endif
 }
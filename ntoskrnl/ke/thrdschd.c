@@ -15,9 +15,13 @@
 #ifdef _WIN64
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr64((PLONG64)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd64((PLONG64)Destination, SetMember);
 #else
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr((PLONG)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd((PLONG)Destination, SetMember);
 #endif
 
 /* GLOBALS *******************************************************************/
@@ -27,13 +31,158 @@ ULONG_PTR KiIdleSMTSummary;
 
 /* FUNCTIONS *****************************************************************/
 
+static
+VOID
+KiSetIdleProcessor(IN PKPRCB Prcb)
+{
+    KAFFINITY SmtSet = (KAFFINITY)Prcb->MultiThreadProcessorSet;
+
+    /* Mark this processor idle */
+    InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+
+    /* If its SMT siblings are idle too, the whole core is */
+    if ((KiIdleSummary & SmtSet) == SmtSet)
+    {
+        InterlockedOrSetMember(&KiIdleSMTSummary, SmtSet);
+    }
+}
+
+#ifdef CONFIG_SMP
+static
+VOID
+KiClearIdleProcessor(IN PKPRCB Prcb)
+{
+    /* This processor is getting work, and so is its core */
+    InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+    InterlockedAndSetMember(&KiIdleSMTSummary, ~(KAFFINITY)Prcb->MultiThreadProcessorSet);
+}
+
+static
+ULONG
+KiSelectIdleProcessor(IN PKTHREAD Thread,
+                      IN KAFFINITY IdleSet)
+{
+    KAFFINITY SmtSet;
+    ULONG Processor;
+
+    /* The ideal processor is the best choice if it's idle */
+    Processor = Thread->IdealProcessor;
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    /* Otherwise rather take a whole idle core than the sibling of a busy one */
+    SmtSet = IdleSet & KiIdleSMTSummary;
+    if (SmtSet) IdleSet = SmtSet;
+
+    /* The processor it last ran on may still have a warm cache */
+    Processor = Thread->NextProcessor;
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    /* This one saves an IPI */
+    Processor = KeGetCurrentProcessorNumber();
+    if (IdleSet & AFFINITY_MASK(Processor)) return Processor;
+
+    /* Anything else will do */
+    return KeFindNextRightSetAffinity(Thread->IdealProcessor, (ULONG)IdleSet);
+}
+
+static
+PKTHREAD
+KiStealReadyThread(IN PKPRCB SourcePrcb,
+                   IN PKPRCB Prcb)
+{
+    ULONG Summary;
+    LONG Priority;
+    PLIST_ENTRY ListHead, ListEntry;
+    PKTHREAD Thread;
+
+    /* Go through the ready queues from the highest priority down */
+    Summary = SourcePrcb->ReadySummary;
+    while (Summary)
+    {
+        BitScanReverse((PULONG)&Priority, Summary);
+        Summary ^= PRIORITY_MASK(Priority);
+
+        ListHead = &SourcePrcb->DispatcherReadyListHead[Priority];
+        for (ListEntry = ListHead->Flink;
+             ListEntry != ListHead;
+             ListEntry = ListEntry->Flink)
+        {
+            /* Only take a thread that is allowed to run here */
+            Thread = CONTAINING_RECORD(ListEntry, KTHREAD, WaitListEntry);
+            if (!(Thread->Affinity & Prcb->SetMember)) continue;
+
+            /* Remove it from the other processor's queue */
+            ASSERT(Thread->NextProcessor == SourcePrcb->Number);
+            if (RemoveEntryList(&Thread->WaitListEntry))
+            {
+                /* The list is empty now, reset the ready summary */
+                SourcePrcb->ReadySummary ^= PRIORITY_MASK(Priority);
+            }
+            return Thread;
+        }
+    }
+
+    /* Nothing this processor can run */
+    return NULL;
+}
+#endif
+
 PKTHREAD
 FASTCALL
 KiIdleSchedule(IN PKPRCB Prcb)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("SMP: Not yet implemented\n", FALSE);
-    return NULL;
+    PKTHREAD Thread = NULL;
+#ifdef CONFIG_SMP
+    PKPRCB SourcePrcb;
+    ULONG i;
+
+    /* We're looking now, don't come back unless we go idle again */
+    Prcb->IdleSchedule = FALSE;
+
+    /* Look through the other processors' ready queues, starting with the next one */
+    for (i = 1; (i < (ULONG)KeNumberProcessors) && !(Thread); i++)
+    {
+        SourcePrcb = KiProcessorBlock[(Prcb->Number + i) % KeNumberProcessors];
+        if (!SourcePrcb->ReadySummary) continue;
+
+        /* Both PRCBs get locked, always in address order to not deadlock */
+        if (SourcePrcb < Prcb)
+        {
+            KiAcquirePrcbLock(SourcePrcb);
+            KiAcquirePrcbLock(Prcb);
+        }
+        else
+        {
+            KiAcquirePrcbLock(Prcb);
+            KiAcquirePrcbLock(SourcePrcb);
+        }
+
+        /* Someone may have given us work in the meantime */
+        if (!Prcb->NextThread)
+        {
+            Thread = KiStealReadyThread(SourcePrcb, Prcb);
+            if (Thread)
+            {
+                /* Move it over and make it the next thread here */
+                Thread->NextProcessor = Prcb->Number;
+                Thread->State = Standby;
+                Prcb->NextThread = Thread;
+                KiClearIdleProcessor(Prcb);
+            }
+        }
+        else
+        {
+            /* Stop looking */
+            i = KeNumberProcessors;
+        }
+
+        KiReleasePrcbLock(SourcePrcb);
+        KiReleasePrcbLock(Prcb);
+    }
+#endif
+
+    /* Return what we found, if anything */
+    return Thread;
 }
 
 VOID
@@ -83,6 +232,9 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     ULONG Processor = 0;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+#ifdef CONFIG_SMP
+    KAFFINITY IdleSet;
+#endif
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,6 +380,55 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
+#ifdef CONFIG_SMP
+    /* Check if there's an idle processor this thread can run on */
+    IdleSet = KiIdleSummary & Thread->Affinity;
+    if (IdleSet)
+    {
+        /* Pick one and lock its PRCB */
+        Processor = KiSelectIdleProcessor(Thread, IdleSet);
+        Prcb = KiProcessorBlock[Processor];
+        KiAcquirePrcbLock(Prcb);
+
+        /* Make sure nobody else gave it work in the meantime */
+        if ((KiIdleSummary & AFFINITY_MASK(Processor)) && !(Prcb->NextThread))
+        {
+            /* Set this thread as the next one */
+            KiClearIdleProcessor(Prcb);
+            Thread->NextProcessor = (UCHAR)Processor;
+            Thread->State = Standby;
+            Prcb->NextThread = Thread;
+
+            /* Unlock the PRCB and wake the processor up if it's another one */
+            KiReleasePrcbLock(Prcb);
+            if (KeGetCurrentProcessorNumber() != Processor)
+            {
+                KiIpiSend(AFFINITY_MASK(Processor), IPI_DPC);
+            }
+            return;
+        }
+
+        /* Too late, queue it the usual way */
+        KiReleasePrcbLock(Prcb);
+    }
+
+    /* Go back to the ideal processor, or else to the one it last ran on */
+    Processor = Thread->IdealProcessor;
+    if (!(Thread->Affinity & AFFINITY_MASK(Processor)))
+    {
+        Processor = Thread->NextProcessor;
+        if (!(Thread->Affinity & AFFINITY_MASK(Processor)))
+        {
+            /* Neither is allowed anymore, take any that is */
+            Processor = KeFindNextRightSetAffinity(Thread->IdealProcessor,
+                                                   (ULONG)Thread->Affinity);
+        }
+    }
+
+    /* Get the PRCB and lock it */
+    Prcb = KiProcessorBlock[Processor];
+    KiAcquirePrcbLock(Prcb);
+#else
     /* Queue the thread on CPU 0 and get the PRCB and lock it */
     Thread->NextProcessor = 0;
     Prcb = KiProcessorBlock[0];
@@ -245,6 +446,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         KiReleasePrcbLock(Prcb);
         return;
     }
+#endif
 
     /* Set the CPU number */
     Thread->NextProcessor = (UCHAR)Processor;
@@ -336,12 +538,9 @@ KiSelectNextThread(IN PKPRCB Prcb)
         /* Didn't find any, get the current idle thread */
         Thread = Prcb->IdleThread;
 
-        /* Enable idle scheduling */
-        InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+        /* Enable idle scheduling, other processors may have work for us */
+        KiSetIdleProcessor(Prcb);
         Prcb->IdleSchedule = TRUE;
-
-        /* FIXME: SMT support */
-        ASSERTMSG("SMP: Not yet implemented\n", FALSE);
     }
 
     /* Sanity checks and return the thread */
@@ -385,8 +584,9 @@ KiSwapThread(IN PKTHREAD CurrentThread,
         }
         else
         {
-            /* Set the idle summary */
-            InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+            /* Set the idle summary and look for work when idle */
+            KiSetIdleProcessor(Prcb);
+            Prcb->IdleSchedule = TRUE;
 
             /* Schedule the idle thread */
             NextThread = Prcb->IdleThread;
@@ -402,6 +602,9 @@ KiSwapThread(IN PKTHREAD CurrentThread,
     /* Save the wait IRQL */
     WaitIrql = CurrentThread->WaitIrql;
 
+    /* Notify WMI */
+    WmiTraceContextSwitch(CurrentThread, NextThread);
+
     /* Swap contexts */
     ApcState = KiSwapContext(WaitIrql, CurrentThread);
 
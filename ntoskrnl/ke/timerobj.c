@@ -19,6 +19,15 @@ LARGE_INTEGER KiTimeIncrementReciprocal;
 UCHAR KiTimeIncrementShiftCount;
 BOOLEAN KiEnableTimerWatchdog = FALSE;
 
+/* Boundaries coalescable timers get aligned to, in 100ns units, largest first */
+const ULONGLONG KiTimerCoalescingGranularity[] =
+{
+    1000 * 10000,
+    250 * 10000,
+    100 * 10000,
+    50 * 10000
+};
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 BOOLEAN
@@ -295,15 +304,31 @@ KeSetTimerEx(IN OUT PKTIMER Timer,
              IN LARGE_INTEGER DueTime,
              IN LONG Period,
              IN PKDPC Dpc OPTIONAL)
+{
+    /* Call the coalescing function and don't allow any delay */
+    return KeSetCoalescableTimer(Timer, DueTime, Period, 0, Dpc);
+}
+
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+KeSetCoalescableTimer(IN OUT PKTIMER Timer,
+                      IN LARGE_INTEGER DueTime,
+                      IN ULONG Period,
+                      IN ULONG TolerableDelay,
+                      IN PKDPC Dpc OPTIONAL)
 {
     KIRQL OldIrql;
     BOOLEAN Inserted;
-    ULONG Hand = 0;
+    ULONG Hand = 0, i;
     BOOLEAN RequestInterrupt = FALSE;
     ASSERT_TIMER(Timer);
     ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
-    DPRINT("KeSetTimerEx(): Timer %p, DueTime %I64d, Period %d, Dpc %p\n",
-           Timer, DueTime.QuadPart, Period, Dpc);
+    DPRINT("KeSetCoalescableTimer(): Timer %p, DueTime %I64d, Period %lu, "
+           "TolerableDelay %lu, Dpc %p\n",
+           Timer, DueTime.QuadPart, Period, TolerableDelay, Dpc);
 
     /* Lock the Database and Raise IRQL */
     OldIrql = KiAcquireDispatcherLock();
@@ -315,28 +340,45 @@ KeSetTimerEx(IN OUT PKTIMER Timer,
     /* Set Default Timer Data */
     Timer->Dpc = Dpc;
     Timer->Period = Period;
+
+    /*
+     * Find the largest boundary the timer can be delayed to. Don't go past
+     * the period either, or a periodic timer would expire less often.
+     */
+    Timer->Header.Coalescable = FALSE;
+    for (i = 0; i < RTL_NUMBER_OF(KiTimerCoalescingGranularity); i++)
+    {
+        if ((KiTimerCoalescingGranularity[i] <= UInt32x32To64(TolerableDelay, 10000)) &&
+            (!(Period) || (KiTimerCoalescingGranularity[i] <= UInt32x32To64(Period, 10000))))
+        {
+            /* This one works, KiComputeDueTime will do the rounding */
+            Timer->Header.Coalescable = TRUE;
+            Timer->Header.EncodedTolerableDelay = i;
+            break;
+        }
+    }
+
     if (!KiComputeDueTime(Timer, DueTime, &Hand))
     {
         /* Signal the timer */
         RequestInterrupt = KiSignalTimer(Timer);
-        
+
         /* Release the dispatcher lock */
         KiReleaseDispatcherLockFromSynchLevel();
-        
+
         /* Check if we need to do an interrupt */
-        if (RequestInterrupt) HalRequestSoftwareInterrupt(DISPATCH_LEVEL);        
+        if (RequestInterrupt) HalRequestSoftwareInterrupt(DISPATCH_LEVEL);
     }
     else
     {
         /* Insert the timer */
         Timer->Header.SignalState = FALSE;
-        KxInsertTimer(Timer, Hand);        
+        KxInsertTimer(Timer, Hand);
     }
-    
+
     /* Exit the dispatcher */
     KiExitDispatcher(OldIrql);
 
     /* Return old state */
     return Inserted;
 }
-
@@ -462,6 +462,9 @@ KeWaitForSingleObject(IN PVOID Object,
             /* Sanity check */
             ASSERT(CurrentObject->Header.Type != QueueObject);
 
+            /* Lock the object if it's an event */
+            KiAcquireEventObject(&CurrentObject->Header);
+
             /* Check if it's a mutant */
             if (CurrentObject->Header.Type == MutantObject)
             {
@@ -480,6 +483,7 @@ KeWaitForSingleObject(IN PVOID Object,
                     else
                     {
                         /* Raise an exception */
+                        KiReleaseEventObject(&CurrentObject->Header);
                         KiReleaseDispatcherLock(Thread->WaitIrql);
                         ExRaiseStatus(STATUS_MUTANT_LIMIT_EXCEEDED);
                    }
@@ -495,7 +499,12 @@ KeWaitForSingleObject(IN PVOID Object,
 
             /* Make sure we can satisfy the Alertable request */
             WaitStatus = KiCheckAlertability(Thread, Alertable, WaitMode);
-            if (WaitStatus != STATUS_WAIT_0) break;
+            if (WaitStatus != STATUS_WAIT_0)
+            {
+                /* We can't, unlock the object and get out */
+                KiReleaseEventObject(&CurrentObject->Header);
+                break;
+            }
 
             /* Enable the Timeout Timer if there was any specified */
             if (Timeout)
@@ -514,9 +523,10 @@ KeWaitForSingleObject(IN PVOID Object,
                 Timer->Header.Inserted = TRUE;
             }
 
-            /* Link the Object to this Wait Block */
+            /* Link the Object to this Wait Block, and unlock the object */
             InsertTailList(&CurrentObject->Header.WaitListHead,
                            &WaitBlock->WaitListEntry);
+            KiReleaseEventObject(&CurrentObject->Header);
 
             /* Handle Kernel Queues */
             if (Thread->Queue) KiActivateWaiterQueue(Thread->Queue);
@@ -561,6 +571,28 @@ KeWaitForSingleObject(IN PVOID Object,
 WaitStart:
         /* Setup a new wait */
         Thread->WaitIrql = KeRaiseIrqlToSynchLevel();
+
+        /*
+         * Check if this is an event, and we don't have to deliver an APC
+         * first. If it's signaled already, its own lock is enough to take it.
+         */
+        if ((KiIsEventObject(&CurrentObject->Header)) &&
+            !((Thread->ApcState.KernelApcPending) &&
+              !(Thread->SpecialApcDisable) &&
+              (Thread->WaitIrql < APC_LEVEL)))
+        {
+            KiAcquireDispatcherObject(&CurrentObject->Header);
+            if (CurrentObject->Header.SignalState > 0)
+            {
+                /* Satisfy it and return */
+                KiSatisfyNonMutantWait(CurrentObject);
+                KiReleaseDispatcherObject(&CurrentObject->Header);
+                WaitStatus = STATUS_WAIT_0;
+                goto DontWaitUnlocked;
+            }
+            KiReleaseDispatcherObject(&CurrentObject->Header);
+        }
+
         KxSingleThreadWait();
         KiAcquireDispatcherLockAtSynchLevel();
     }
@@ -570,9 +602,11 @@ WaitStart:
     return WaitStatus;
 
 DontWait:
-    /* Release dispatcher lock but maintain high IRQL */
+    /* Release the object and dispatcher locks but maintain high IRQL */
+    KiReleaseEventObject(&CurrentObject->Header);
     KiReleaseDispatcherLockFromSynchLevel();
 
+DontWaitUnlocked:
     /* Adjust the Quantum and return the wait status */
     KiAdjustQuantumThread(Thread);
     return WaitStatus;
@@ -669,6 +703,9 @@ KeWaitForMultipleObjects(IN ULONG Count,
         }
         else
         {
+            /* Lock the events we're waiting on */
+            KiAcquireEventObjects(Object, Count);
+
             /* Check what kind of wait this is */
             Index = 0;
             if (WaitType == WaitAny)
@@ -699,6 +736,7 @@ KeWaitForMultipleObjects(IN ULONG Count,
                             else
                             {
                                 /* Raise an exception (see wasm.ru) */
+                                KiReleaseEventObjects(Object, Count);
                                 KiReleaseDispatcherLock(Thread->WaitIrql);
                                 ExRaiseStatus(STATUS_MUTANT_LIMIT_EXCEEDED);
                             }
@@ -733,6 +771,7 @@ KeWaitForMultipleObjects(IN ULONG Count,
                             (CurrentObject->Header.SignalState == (LONG)MINLONG))
                         {
                             /* Raise an exception */
+                            KiReleaseEventObjects(Object, Count);
                             KiReleaseDispatcherLock(Thread->WaitIrql);
                             ExRaiseStatus(STATUS_MUTANT_LIMIT_EXCEEDED);
                         }
@@ -776,7 +815,12 @@ KeWaitForMultipleObjects(IN ULONG Count,
 
             /* Make sure we can satisfy the Alertable request */
             WaitStatus = KiCheckAlertability(Thread, Alertable, WaitMode);
-            if (WaitStatus != STATUS_WAIT_0) break;
+            if (WaitStatus != STATUS_WAIT_0)
+            {
+                /* We can't, unlock the events and get out */
+                KiReleaseEventObjects(Object, Count);
+                break;
+            }
 
             /* Enable the Timeout Timer if there was any specified */
             if (Timeout)
@@ -813,6 +857,9 @@ KeWaitForMultipleObjects(IN ULONG Count,
                 WaitBlock = WaitBlock->NextWaitBlock;
             } while (WaitBlock != WaitBlockArray);
 
+            /* Now that we're queued, the events can be unlocked */
+            KiReleaseEventObjects(Object, Count);
+
             /* Handle Kernel Queues */
             if (Thread->Queue) KiActivateWaiterQueue(Thread->Queue);
 
@@ -866,7 +913,8 @@ WaitStart:
     return WaitStatus;
 
 DontWait:
-    /* Release dispatcher lock but maintain high IRQL */
+    /* Release the event and dispatcher locks but maintain high IRQL */
+    KiReleaseEventObjects(Object, Count);
     KiReleaseDispatcherLockFromSynchLevel();
 
     /* Adjust the Quantum and return the wait status */
@@ -25,6 +25,7 @@ WCHAR MmLargePageDriverBuffer[512] = {0};
 ULONG MmLargePageDriverBufferLength = -1;
 LIST_ENTRY MiLargePageDriverList;
 BOOLEAN MiLargePageAllDrivers;
+SIZE_T MmLargePageMinimum;
 
 /* FUNCTIONS ******************************************************************/
 
@@ -45,6 +46,9 @@ MiInitializeLargePageSupport(VOID)
     /* Initialize the process tracking list, and insert the system process */
     InitializeListHead(&MmProcessList);
     InsertTailList(&MmProcessList, &PsGetCurrentProcess()->MmProcessLinks);
+
+    /* User mode can have large pages if the CPU does 4MB PDEs */
+    if (KeFeatureBits & KF_LARGE_PAGE) MmLargePageMinimum = PDE_MAPPED_VA;
 #endif
 }
 
@@ -101,4 +105,133 @@ MiInitializeDriverLargePageList(VOID)
     }
 }
 
+NTSTATUS
+NTAPI
+MiMapLargePages(IN PEPROCESS Process,
+                IN PMMVAD Vad)
+{
+    PETHREAD Thread = PsGetCurrentThread();
+    ULONG_PTR Va, StartingAddress, EndingAddress;
+    PFN_NUMBER PageFrameIndex, i;
+    PMMPDE PointerPde;
+    MMPDE TempPde;
+    KIRQL OldIrql;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* The caller already made sure the VAD is made of whole large pages */
+    ASSERT(Vad->u.VadFlags.VadType == VadLargePages);
+    ASSERT(MmLargePageMinimum == PDE_MAPPED_VA);
+    StartingAddress = Vad->StartingVpn << PAGE_SHIFT;
+    EndingAddress = (Vad->EndingVpn << PAGE_SHIFT) | (PAGE_SIZE - 1);
+    ASSERT((StartingAddress & (PDE_MAPPED_VA - 1)) == 0);
+    ASSERT(((EndingAddress + 1) & (PDE_MAPPED_VA - 1)) == 0);
+
+    /* Lock the working set */
+    MiLockProcessWorkingSetUnsafe(Process, Thread);
+
+    for (Va = StartingAddress; Va < EndingAddress; Va += PDE_MAPPED_VA)
+    {
+        /* There can be an empty page table left in there, get rid of it */
+        PointerPde = MiAddressToPde(Va);
+        if (PointerPde->u.Hard.Valid)
+        {
+            if ((PointerPde->u.Hard.LargePage) ||
+                (MiQueryPageTableReferences((PVOID)Va) != 0))
+            {
+                DPRINT1("Range at %p is already in use\n", (PVOID)Va);
+                Status = STATUS_CONFLICTING_ADDRESSES;
+                break;
+            }
+
+            OldIrql = MiAcquirePfnLock();
+            MiDeletePte(PointerPde, MiPteToAddress(PointerPde), Process, NULL);
+            MiReleasePfnLock(OldIrql);
+        }
+        ASSERT(PointerPde->u.Long == 0);
+
+        /* Grab a physically contiguous run that is aligned like the large page */
+        PageFrameIndex = MiFindContiguousPages(0,
+                                               MmHighestPhysicalPage,
+                                               PTE_PER_PAGE,
+                                               PTE_PER_PAGE,
+                                               MmCached);
+        if (!PageFrameIndex)
+        {
+            DPRINT1("No physically contiguous memory for a large page\n");
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+        ASSERT((PageFrameIndex & (PTE_PER_PAGE - 1)) == 0);
+
+        /* Nobody else has seen these pages yet, so they can be zeroed one by one */
+        for (i = 0; i < PTE_PER_PAGE; i++)
+        {
+            MI_PFN_ELEMENT(PageFrameIndex + i)->PteAddress = PointerPde;
+            MiZeroPhysicalPage(PageFrameIndex + i);
+        }
+
+        /* Map the whole run with a single PDE */
+        MI_MAKE_HARDWARE_PTE_USER(&TempPde,
+                                  MiAddressToPte(Va),
+                                  Vad->u.VadFlags.Protection,
+                                  PageFrameIndex);
+        TempPde.u.Hard.LargePage = 1;
+        MI_WRITE_VALID_PDE(PointerPde, TempPde);
+    }
+
+    /* Undo what we could map if we couldn't map everything */
+    if (!NT_SUCCESS(Status) && (Va != StartingAddress))
+    {
+        MiDeleteLargePages(StartingAddress, Va - 1);
+    }
+
+    /* Release the working set */
+    MiUnlockProcessWorkingSetUnsafe(Process, Thread);
+    return Status;
+}
+
+VOID
+NTAPI
+MiDeleteLargePages(IN ULONG_PTR Va,
+                   IN ULONG_PTR EndingAddress)
+{
+    PFN_NUMBER PageFrameIndex, LastPage;
+    PMMPDE PointerPde;
+    PMMPFN Pfn1;
+    KIRQL OldIrql;
+
+    ASSERT((Va & (PDE_MAPPED_VA - 1)) == 0);
+
+    for (; Va < EndingAddress; Va += PDE_MAPPED_VA)
+    {
+        /* Ranges that failed to be mapped have nothing to free */
+        PointerPde = MiAddressToPde(Va);
+        if (!PointerPde->u.Hard.Valid) continue;
+        ASSERT(PointerPde->u.Hard.LargePage == 1);
+
+        /* Unmap the large page, and make sure nobody has it cached anymore */
+        PageFrameIndex = PFN_FROM_PTE(PointerPde);
+        PointerPde->u.Long = 0;
+        KeFlushCurrentTb();
+
+        /* Now give the run back, the same way contiguous memory is freed */
+        Pfn1 = MI_PFN_ELEMENT(PageFrameIndex);
+        ASSERT(Pfn1->u3.e1.StartOfAllocation == 1);
+        Pfn1->u3.e1.StartOfAllocation = 0;
+        (Pfn1 + PTE_PER_PAGE - 1)->u3.e1.EndOfAllocation = 0;
+
+        OldIrql = MiAcquirePfnLock();
+        LastPage = PageFrameIndex + PTE_PER_PAGE;
+        do
+        {
+            ASSERT(Pfn1->u3.e2.ReferenceCount == 1);
+            ASSERT(Pfn1->u2.ShareCount == 1);
+            ASSERT(Pfn1->PteAddress == PointerPde);
+            MI_SET_PFN_DELETED(Pfn1);
+            MiDecrementShareCount(Pfn1++, PageFrameIndex++);
+        } while (PageFrameIndex < LastPage);
+        MiReleasePfnLock(OldIrql);
+    }
+}
+
 /* EOF */
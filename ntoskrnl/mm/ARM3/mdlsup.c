@@ -1651,16 +1651,70 @@ MmUnmapReservedMapping(IN PVOID BaseAddress,
     UNIMPLEMENTED;
 }
 
+#ifndef NEWCC
+static
+int
+__cdecl
+MiCompareReadListEntries(const void * x,
+                         const void * y)
+{
+    const FILE_SEGMENT_ELEMENT *Entry1 = (const FILE_SEGMENT_ELEMENT *)x;
+    const FILE_SEGMENT_ELEMENT *Entry2 = (const FILE_SEGMENT_ELEMENT *)y;
+
+    if (Entry1->Alignment > Entry2->Alignment)
+        return 1;
+    else if (Entry1->Alignment < Entry2->Alignment)
+        return -1;
+    else
+        return 0;
+}
+#endif
+
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS
 NTAPI
 MmPrefetchPages(IN ULONG NumberOfLists,
                 IN PREAD_LIST *ReadLists)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    PREAD_LIST ReadList;
+    PFILE_OBJECT FileObject;
+    ULONG i;
+    PAGED_CODE();
+
+    for (i = 0; i < NumberOfLists; i++)
+    {
+        ReadList = ReadLists[i];
+        FileObject = ReadList->FileObject;
+        if (ReadList->NumberOfEntries == 0) continue;
+
+#ifndef NEWCC
+        //
+        // Both data and image section pages are read from the cache views of
+        // the file, so bringing the views in is all there is to do. A file
+        // that isn't cached can't be prefetched.
+        //
+        if ((FileObject->SectionObjectPointer == NULL) ||
+            (FileObject->SectionObjectPointer->SharedCacheMap == NULL))
+        {
+            DPRINT("File %p isn't cached, skipping it\n", FileObject);
+            continue;
+        }
+
+        //
+        // Read the file in ascending offset order, so that neighbouring
+        // pages are coalesced into a few large reads
+        //
+        qsort(ReadList->List,
+              ReadList->NumberOfEntries,
+              sizeof(ReadList->List[0]),
+              MiCompareReadListEntries);
+        CcPrefetchPages(FileObject, ReadList->List, ReadList->NumberOfEntries);
+#endif
+    }
+
+    return STATUS_SUCCESS;
 }
 
 /*
@@ -235,11 +235,17 @@ extern const ULONG MmProtectToValue[32];
 #define MM_NOIRQL (KIRQL)0xFFFFFFFF
 
 //
-// Returns the color of a page
+// Returns the color of a page. On NUMA machines, the colors above the L2 cache
+// ones select the node, so allocations start on the node of the processor (or
+// of the process' ideal node) before falling back to the other nodes.
 //
-#define MI_GET_PAGE_COLOR(x)                ((x) & MmSecondaryColorMask)
-#define MI_GET_NEXT_COLOR()                 (MI_GET_PAGE_COLOR(++MmSystemPageColor))
-#define MI_GET_NEXT_PROCESS_COLOR(x)        (MI_GET_PAGE_COLOR(++(x)->NextPageColor))
+#define MI_CACHE_COLOR_MASK                 ((1 << MmSecondaryColorNodeShift) - 1)
+#define MI_GET_COLOR_NODE(c)                ((c) >> MmSecondaryColorNodeShift)
+#define MI_GET_PAGE_COLOR(x)                MiGetPfnColor(x)
+#define MI_GET_NEXT_COLOR()                 ((++MmSystemPageColor & MI_CACHE_COLOR_MASK) | \
+                                             KeGetCurrentPrcb()->NodeShiftedColor)
+#define MI_GET_NEXT_PROCESS_COLOR(x)        ((++(x)->NextPageColor & MI_CACHE_COLOR_MASK) | \
+                                             KeNodeBlock[(x)->Pcb.IdealNode]->MmShiftedColor)
 
 //
 // Prototype PTEs that don't yet have a pagefile association
@@ -552,6 +558,7 @@ extern WCHAR MmVerifyDriverBuffer[512];
 extern WCHAR MmLargePageDriverBuffer[512];
 extern LIST_ENTRY MiLargePageDriverList;
 extern BOOLEAN MiLargePageAllDrivers;
+extern SIZE_T MmLargePageMinimum;
 extern ULONG MmVerifyDriverBufferLength;
 extern ULONG MmLargePageDriverBufferLength;
 extern SIZE_T MmSizeOfNonPagedPoolInBytes;
@@ -607,6 +614,8 @@ extern SIZE_T MmDefaultMaximumNonPagedPool;
 extern ULONG MmMaxAdditionNonPagedPoolPerMb;
 extern ULONG MmSecondaryColors;
 extern ULONG MmSecondaryColorMask;
+extern ULONG MmSecondaryColorNodeShift;
+extern HAL_NUMA_TOPOLOGY_INTERFACE MiNumaTopology;
 extern ULONG MmNumberOfSystemPtes;
 extern ULONG MmMaximumNonPagedPoolPercent;
 extern ULONG MmLargeStackSize;
@@ -993,6 +1002,49 @@ MI_ERASE_PTE(IN PMMPTE PointerPte)
     PointerPte->u.Long = 0;
 }
 
+//
+// TB flushes for PTEs that were changed together, done in one batch. Past
+// MM_MAXIMUM_FLUSH_COUNT entries the whole TB gets flushed instead.
+//
+#define MM_MAXIMUM_FLUSH_COUNT 32
+
+typedef struct _MMPTE_FLUSH_LIST
+{
+    ULONG Count;
+    PVOID FlushVa[MM_MAXIMUM_FLUSH_COUNT];
+} MMPTE_FLUSH_LIST, *PMMPTE_FLUSH_LIST;
+
+FORCEINLINE
+VOID
+MiInsertFlushVa(IN PMMPTE_FLUSH_LIST FlushList,
+                IN PVOID VirtualAddress)
+{
+    /* Only remember the address while we can flush them one by one */
+    if (FlushList->Count < MM_MAXIMUM_FLUSH_COUNT)
+    {
+        FlushList->FlushVa[FlushList->Count] = VirtualAddress;
+    }
+    FlushList->Count++;
+}
+
+FORCEINLINE
+VOID
+MiFlushPteList(IN PMMPTE_FLUSH_LIST FlushList,
+               IN BOOLEAN AllProcessors)
+{
+    /* AllProcessors is for system addresses, otherwise only the current process is affected */
+    if (FlushList->Count > MM_MAXIMUM_FLUSH_COUNT)
+    {
+        KeFlushEntireTb(TRUE, AllProcessors);
+    }
+    else if (FlushList->Count)
+    {
+        KeFlushMultipleTb(FlushList->Count, FlushList->FlushVa, AllProcessors);
+    }
+
+    FlushList->Count = 0;
+}
+
 //
 // Writes a valid PDE
 //
@@ -2041,6 +2093,20 @@ MiInitializeLargePageSupport(
     VOID
 );
 
+NTSTATUS
+NTAPI
+MiMapLargePages(
+    IN PEPROCESS Process,
+    IN PMMVAD Vad
+);
+
+VOID
+NTAPI
+MiDeleteLargePages(
+    IN ULONG_PTR Va,
+    IN ULONG_PTR EndingAddress
+);
+
 INIT_FUNCTION
 VOID
 NTAPI
@@ -2229,6 +2295,16 @@ MiDeletePte(
     IN PMMPTE PrototypePte
 );
 
+VOID
+NTAPI
+MiDeletePteDeferFlush(
+    IN PMMPTE PointerPte,
+    IN PVOID VirtualAddress,
+    IN PEPROCESS CurrentProcess,
+    IN PMMPTE PrototypePte,
+    IN PMMPTE_FLUSH_LIST FlushList
+);
+
 ULONG
 NTAPI
 MiMakeSystemAddressValid(
@@ -2298,6 +2374,19 @@ NTAPI
 MiWriteProtectSystemImage(
     _In_ PVOID ImageBase);
 
+//
+// Returns the color lists a free page goes on. On NUMA machines, the upper
+// color bits are the node holding the page.
+//
+FORCEINLINE
+ULONG
+MiGetPfnColor(IN PFN_NUMBER PageFrameIndex)
+{
+    if (KeNumberNodes == 1) return (ULONG)PageFrameIndex & MmSecondaryColorMask;
+    return ((ULONG)PageFrameIndex & MI_CACHE_COLOR_MASK) |
+           (MiNumaTopology.PageToNode(PageFrameIndex) << MmSecondaryColorNodeShift);
+}
+
 //
 // MiRemoveZeroPage will use inline code to zero out the page manually if only
 // free pages are available. In some scenarios, we don't/can't run that piece of
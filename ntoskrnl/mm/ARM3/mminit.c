@@ -256,6 +256,14 @@ PVOID MmHyperSpaceEnd;
 ULONG MmSecondaryColors;
 ULONG MmSecondaryColorMask;
 
+//
+// On NUMA machines, the node of a page is stored in the color bits above this
+// shift, and its physical page to node lookup is provided by the HAL
+//
+ULONG MmSecondaryColorNodeShift;
+HAL_NUMA_TOPOLOGY_INTERFACE MiNumaTopology;
+KNODE MiNodeBlock[MAXIMUM_CCNUMA_NODES - 1];
+
 //
 // Actual (registry-configurable) size of a GUI thread's stack
 //
@@ -502,12 +510,51 @@ MxGetNextPage(IN PFN_NUMBER PageCount)
     return Pfn;
 }
 
+INIT_FUNCTION
+VOID
+NTAPI
+MiInitializeNodeInformation(VOID)
+{
+    HAL_NUMA_TOPOLOGY_INTERFACE NumaTopology;
+    ULONG ReturnedLength, Node;
+    NTSTATUS Status;
+
+    /* Ask the HAL if the firmware describes more than one node */
+    Status = HalQuerySystemInformation(HalNumaTopologyInterface,
+                                       sizeof(NumaTopology),
+                                       &NumaTopology,
+                                       &ReturnedLength);
+    if (!NT_SUCCESS(Status)) return;
+
+    /* Ignore topologies that are too big for the kernel */
+    if ((NumaTopology.NumberOfNodes < 2) ||
+        (NumaTopology.NumberOfNodes > MAXIMUM_CCNUMA_NODES))
+    {
+        DPRINT1("Ignoring NUMA topology with %lu nodes\n", NumaTopology.NumberOfNodes);
+        return;
+    }
+
+    /* The kernel already built the boot processor's node, build the others */
+    for (Node = 1; Node < NumaTopology.NumberOfNodes; Node++)
+    {
+        KeNodeBlock[Node] = &MiNodeBlock[Node - 1];
+        KeNodeBlock[Node]->NodeNumber = (UCHAR)Node;
+        KeNodeBlock[Node]->Color = (UCHAR)Node;
+    }
+
+    /* The HAL numbers the nodes so that the boot processor is on the first one */
+    KeNumberNodes = (UCHAR)NumaTopology.NumberOfNodes;
+    MiNumaTopology = NumaTopology;
+    DPRINT1("Using %u NUMA nodes\n", KeNumberNodes);
+}
+
 INIT_FUNCTION
 VOID
 NTAPI
 MiComputeColorInformation(VOID)
 {
-    ULONG L2Associativity;
+    ULONG L2Associativity, NodeColors, Node;
+    PKPRCB Prcb = KeGetCurrentPrcb();
 
     /* Check if no setting was provided already */
     if (!MmSecondaryColors)
@@ -551,9 +598,25 @@ MiComputeColorInformation(VOID)
         }
     }
 
+    /* The node colors go right above the cache colors */
+    MmSecondaryColorNodeShift = 0;
+    while ((1UL << MmSecondaryColorNodeShift) < MmSecondaryColors) MmSecondaryColorNodeShift++;
+
+    /* So each node gets its own copy of the cache colors */
+    for (NodeColors = 1; NodeColors < KeNumberNodes; NodeColors <<= 1);
+    MmSecondaryColors *= NodeColors;
+    for (Node = 0; Node < KeNumberNodes; Node++)
+    {
+        KeNodeBlock[Node]->MmShiftedColor = Node << MmSecondaryColorNodeShift;
+    }
+
     /* Compute the mask and store it */
     MmSecondaryColorMask = MmSecondaryColors - 1;
-    KeGetCurrentPrcb()->SecondaryColorMask = MmSecondaryColorMask;
+    Prcb->SecondaryColorMask = MmSecondaryColorMask;
+
+    /* Allocations made on this processor come from its node first */
+    Prcb->NodeColor = Prcb->ParentNode->Color;
+    Prcb->NodeShiftedColor = Prcb->ParentNode->MmShiftedColor;
 }
 
 INIT_FUNCTION
@@ -2181,8 +2244,8 @@ MmArmInitSystem(IN ULONG Phase,
         /* Initialize the Loader Lock */
         KeInitializeMutant(&MmSystemLoadLock, FALSE);
 
-        /* Set the zero page event */
-        KeInitializeEvent(&MmZeroingPageEvent, SynchronizationEvent, FALSE);
+        /* Set the zero page event, it wakes up all the zeroing threads */
+        KeInitializeEvent(&MmZeroingPageEvent, NotificationEvent, FALSE);
         MmZeroingPageThreadActive = FALSE;
 
         /* Initialize the dead stack S-LIST */
@@ -2312,7 +2375,10 @@ MmArmInitSystem(IN ULONG Phase,
             if (MmLargeStackSize < KERNEL_STACK_SIZE) MmLargeStackSize = KERNEL_STACK_SIZE;
         }
 
-        /* Compute color information (L2 cache-separated paging lists) */
+        /* Find out about NUMA nodes */
+        MiInitializeNodeInformation();
+
+        /* Compute color information (L2 cache and node-separated paging lists) */
         MiComputeColorInformation();
 
         // Calculate the number of bytes for the PFN database
@@ -2469,7 +2535,7 @@ MmArmInitSystem(IN ULONG Phase,
         /* Now setup the shared user data fields */
         ASSERT(SharedUserData->NumberOfPhysicalPages == 0);
         SharedUserData->NumberOfPhysicalPages = MmNumberOfPhysicalPages;
-        SharedUserData->LargePageMinimum = 0;
+        SharedUserData->LargePageMinimum = MmLargePageMinimum;
 
         /* Check for workstation (Wi for WinNT) */
         if (MmProductType == '\0i\0W')
@@ -603,6 +603,7 @@ MiResolveDemandZeroFault(IN PVOID Address,
     BOOLEAN NeedZero = FALSE, HaveLock = FALSE;
     ULONG Color;
     PMMPFN Pfn1;
+    PMMVAD_LONG Vad;
     DPRINT("ARM3 Demand Zero Page Fault Handler for address: %p in process: %p\n",
             Address,
             Process);
@@ -620,6 +621,21 @@ MiResolveDemandZeroFault(IN PVOID Address,
         Color = MI_GET_NEXT_PROCESS_COLOR(Process);
         ASSERT(Color != 0xFFFFFFFF);
 
+        /* Private allocations can ask for their pages to come from another node */
+        if ((KeNumberNodes > 1) && (Address <= MM_HIGHEST_USER_ADDRESS))
+        {
+            Vad = (PMMVAD_LONG)MiLocateAddress(Address);
+            if ((Vad) &&
+                (Vad->u.VadFlags.PrivateMemory) &&
+                (Vad->u.VadFlags.VadType == VadNone) &&
+                (Vad->u4.PreferredNode) &&
+                (Vad->u4.PreferredNode <= KeNumberNodes))
+            {
+                Color = (Color & MI_CACHE_COLOR_MASK) |
+                        KeNodeBlock[Vad->u4.PreferredNode - 1]->MmShiftedColor;
+            }
+        }
+
         /* We'll need a zero page */
         NeedZero = TRUE;
     }
@@ -887,13 +903,15 @@ MiResolvePageFileFault(_In_ BOOLEAN StoreInstruction,
                        _Inout_ KIRQL *OldIrql)
 {
     ULONG Color;
-    PFN_NUMBER Page;
+    PFN_NUMBER Pages[MI_PAGEFILE_CLUSTER_SIZE];
+    ULONG Protections[MI_PAGEFILE_CLUSTER_SIZE];
+    ULONG i, Count;
     NTSTATUS Status;
     MMPTE TempPte = *PointerPte;
+    PMMPTE NextPte;
     PMMPFN Pfn1;
     ULONG PageFileIndex = TempPte.u.Soft.PageFileLow;
     ULONG_PTR PageFileOffset = TempPte.u.Soft.PageFileHigh;
-    ULONG Protection = TempPte.u.Soft.Protection;
 
     /* Things we don't support yet */
     ASSERT(CurrentProcess > HYDRA_PROCESS);
@@ -907,56 +925,90 @@ MiResolvePageFileFault(_In_ BOOLEAN StoreInstruction,
     ASSERT(TempPte.u.Soft.PageFileHigh != 0);
     ASSERT(TempPte.u.Soft.PageFileHigh != MI_PTE_LOOKUP_NEEDED);
 
-    /* Get any page, it will be overwritten */
-    Color = MI_GET_NEXT_PROCESS_COLOR(CurrentProcess);
-    Page = MiRemoveAnyPage(Color);
+    /*
+     * Bring in the following PTEs of this page table as well, as long as
+     * they were paged out right after this one in the same paging file.
+     * Pages that were paged out together tend to be used together.
+     */
+    NextPte = PointerPte;
+    for (Count = 0; Count < MI_PAGEFILE_CLUSTER_SIZE; Count++, NextPte++)
+    {
+        if (Count != 0)
+        {
+            /* Don't read ahead when memory is tight, or past the page table */
+            if ((MmAvailablePages < MmMinimumFreePages) ||
+                (MiIsPteOnPdeBoundary(NextPte)))
+            {
+                break;
+            }
+
+            TempPte = *NextPte;
+            if ((TempPte.u.Soft.Valid) ||
+                (TempPte.u.Soft.Prototype) ||
+                (TempPte.u.Soft.Transition) ||
+                (TempPte.u.Soft.PageFileLow != PageFileIndex) ||
+                (TempPte.u.Soft.PageFileHigh != PageFileOffset + Count))
+            {
+                break;
+            }
+        }
+
+        /* Get any page, it will be overwritten */
+        Color = MI_GET_NEXT_PROCESS_COLOR(CurrentProcess);
+        Pages[Count] = MiRemoveAnyPage(Color);
+        Protections[Count] = TempPte.u.Soft.Protection;
 
-    /* Initialize this PFN */
-    MiInitializePfn(Page, PointerPte, StoreInstruction);
+        /* Initialize this PFN */
+        MiInitializePfn(Pages[Count], NextPte, (Count == 0) ? StoreInstruction : FALSE);
 
-    /* Sets the PFN as being in IO operation */
-    Pfn1 = MI_PFN_ELEMENT(Page);
-    ASSERT(Pfn1->u1.Event == NULL);
-    ASSERT(Pfn1->u3.e1.ReadInProgress == 0);
-    ASSERT(Pfn1->u3.e1.WriteInProgress == 0);
-    Pfn1->u3.e1.ReadInProgress = 1;
+        /* Sets the PFN as being in IO operation */
+        Pfn1 = MI_PFN_ELEMENT(Pages[Count]);
+        ASSERT(Pfn1->u1.Event == NULL);
+        ASSERT(Pfn1->u3.e1.ReadInProgress == 0);
+        ASSERT(Pfn1->u3.e1.WriteInProgress == 0);
+        Pfn1->u3.e1.ReadInProgress = 1;
 
-    /* We must write the PTE now as the PFN lock will be released while performing the IO operation */
-    MI_MAKE_TRANSITION_PTE(&TempPte, Page, Protection);
+        /* We must write the PTE now as the PFN lock will be released while performing the IO operation */
+        MI_MAKE_TRANSITION_PTE(&TempPte, Pages[Count], Protections[Count]);
 
-    MI_WRITE_INVALID_PTE(PointerPte, TempPte);
+        MI_WRITE_INVALID_PTE(NextPte, TempPte);
+    }
 
     /* Release the PFN lock while we proceed */
     MiReleasePfnLock(*OldIrql);
 
-    /* Do the paging IO */
-    Status = MiReadPageFile(Page, PageFileIndex, PageFileOffset);
+    /* Do the paging IO, for the whole cluster at once */
+    Status = MiReadPageFileCluster(Pages, Count, PageFileIndex, PageFileOffset);
 
     /* Lock the PFN database again */
     *OldIrql = MiAcquirePfnLock();
 
-    /* Nobody should have changed that while we were not looking */
-    ASSERT(Pfn1->u3.e1.ReadInProgress == 1);
-    ASSERT(Pfn1->u3.e1.WriteInProgress == 0);
-
-    if (!NT_SUCCESS(Status))
+    for (i = 0, NextPte = PointerPte; i < Count; i++, NextPte++)
     {
-        /* Malheur! */
-        ASSERT(FALSE);
-        Pfn1->u4.InPageError = 1;
-        Pfn1->u1.ReadStatus = Status;
-    }
+        /* Nobody should have changed that while we were not looking */
+        Pfn1 = MI_PFN_ELEMENT(Pages[i]);
+        ASSERT(Pfn1->u3.e1.ReadInProgress == 1);
+        ASSERT(Pfn1->u3.e1.WriteInProgress == 0);
 
-    /* And the PTE can finally be valid */
-    MI_MAKE_HARDWARE_PTE(&TempPte, PointerPte, Protection, Page);
-    MI_WRITE_VALID_PTE(PointerPte, TempPte);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Malheur! */
+            ASSERT(FALSE);
+            Pfn1->u4.InPageError = 1;
+            Pfn1->u1.ReadStatus = Status;
+        }
 
-    Pfn1->u3.e1.ReadInProgress = 0;
-    /* Did someone start to wait on us while we proceeded ? */
-    if (Pfn1->u1.Event)
-    {
-        /* Tell them we're done */
-        KeSetEvent(Pfn1->u1.Event, IO_NO_INCREMENT, FALSE);
+        /* And the PTE can finally be valid */
+        MI_MAKE_HARDWARE_PTE(&TempPte, NextPte, Protections[i], Pages[i]);
+        MI_WRITE_VALID_PTE(NextPte, TempPte);
+
+        Pfn1->u3.e1.ReadInProgress = 0;
+        /* Did someone start to wait on us while we proceeded ? */
+        if (Pfn1->u1.Event)
+        {
+            /* Tell them we're done */
+            KeSetEvent(Pfn1->u1.Event, IO_NO_INCREMENT, FALSE);
+        }
     }
 
     return Status;
@@ -2185,10 +2237,16 @@ UserFault:
         ASSERT(KeAreAllApcsDisabled() == TRUE);
         ASSERT(PointerPde->u.Hard.Valid == 1);
     }
-    else
+    else if (MI_IS_PAGE_LARGE(PointerPde))
     {
-        /* Not yet implemented in ReactOS */
-        ASSERT(MI_IS_PAGE_LARGE(PointerPde) == FALSE);
+        /*
+         * Large pages are always resident, so this is either a write to a
+         * read-only one, or another thread got here first.
+         */
+        Status = (MI_IS_WRITE_ACCESS(FaultCode) && !(PointerPde->u.Hard.Write)) ?
+                 STATUS_ACCESS_VIOLATION : STATUS_SUCCESS;
+        MiUnlockProcessWorkingSet(CurrentProcess, CurrentThread);
+        return Status;
     }
 
     /* Now capture the PTE. */
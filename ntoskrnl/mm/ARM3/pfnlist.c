@@ -191,7 +191,7 @@ MiUnlinkFreeOrZeroedPage(IN PMMPFN Entry)
 
     /* Get the page color */
     OldBlink = MiGetPfnEntryIndex(Entry);
-    Color = OldBlink & MmSecondaryColorMask;
+    Color = MI_GET_PAGE_COLOR(OldBlink);
 
     /* Get the first page on the color list */
     ColorTable = &MmFreePagesByColor[ListName][Color];
@@ -239,6 +239,7 @@ MiUnlinkFreeOrZeroedPage(IN PMMPFN Entry)
     /* One less colored page */
     ASSERT(ColorTable->Count >= 1);
     ColorTable->Count--;
+    KeNodeBlock[MI_GET_COLOR_NODE(Color)]->FreeCount[ListName]--;
 
     /* ReactOS Hack */
     Entry->OriginalPte.u.Long = 0;
@@ -358,6 +359,34 @@ MiUnlinkPageFromList(IN PMMPFN Pfn)
     ASSERT_LIST_INVARIANT(ListHead);
 }
 
+static
+PFN_NUMBER
+MiFindNodeLocalPage(IN MMLISTS ListName,
+                    IN OUT PULONG Color)
+{
+    ULONG NodeColor, CacheColor;
+    PFN_NUMBER PageIndex;
+
+    /* Without NUMA, every color is as good as any other one */
+    if (KeNumberNodes == 1) return LIST_HEAD;
+
+    /* Look for a page of any color on the node of the requested color */
+    NodeColor = *Color & ~MI_CACHE_COLOR_MASK;
+    for (CacheColor = 0; CacheColor <= MI_CACHE_COLOR_MASK; CacheColor++)
+    {
+        PageIndex = MmFreePagesByColor[ListName][NodeColor | CacheColor].Flink;
+        if (PageIndex != LIST_HEAD)
+        {
+            /* Found one, return its color too */
+            *Color = NodeColor | CacheColor;
+            return PageIndex;
+        }
+    }
+
+    /* This node has no pages left on this list */
+    return LIST_HEAD;
+}
+
 PFN_NUMBER
 NTAPI
 MiRemovePageByColor(IN PFN_NUMBER PageIndex,
@@ -451,6 +480,7 @@ MiRemovePageByColor(IN PFN_NUMBER PageIndex,
 
     /* One less page */
     ColorTable->Count--;
+    KeNodeBlock[MI_GET_COLOR_NODE(Color)]->FreeCount[ListName]--;
 
     /* ReactOS Hack */
     Pfn1->OriginalPte.u.Long = 0;
@@ -489,17 +519,23 @@ MiRemoveAnyPage(IN ULONG Color)
         /* Check the colored zero list */
         PageIndex = MmFreePagesByColor[ZeroedPageList][Color].Flink;
         if (PageIndex == LIST_HEAD)
+        {
+            /* Check the other colors of this node before going remote */
+            PageIndex = MiFindNodeLocalPage(FreePageList, &Color);
+            if (PageIndex == LIST_HEAD) PageIndex = MiFindNodeLocalPage(ZeroedPageList, &Color);
+        }
+        if (PageIndex == LIST_HEAD)
         {
             /* Check the free list */
             ASSERT_LIST_INVARIANT(&MmFreePageListHead);
             PageIndex = MmFreePageListHead.Flink;
-            Color = PageIndex & MmSecondaryColorMask;
+            Color = MI_GET_PAGE_COLOR(PageIndex);
             if (PageIndex == LIST_HEAD)
             {
                 /* Check the zero list */
                 ASSERT_LIST_INVARIANT(&MmZeroedPageListHead);
                 PageIndex = MmZeroedPageListHead.Flink;
-                Color = PageIndex & MmSecondaryColorMask;
+                Color = MI_GET_PAGE_COLOR(PageIndex);
                 ASSERT(PageIndex != LIST_HEAD);
                 if (PageIndex == LIST_HEAD)
                 {
@@ -539,8 +575,9 @@ MiRemoveZeroPage(IN ULONG Color)
     ASSERT(MmAvailablePages != 0);
     ASSERT(Color < MmSecondaryColors);
 
-    /* Check the colored zero list */
+    /* Check the colored zero list, then the other zero lists of this node */
     PageIndex = MmFreePagesByColor[ZeroedPageList][Color].Flink;
+    if (PageIndex == LIST_HEAD) PageIndex = MiFindNodeLocalPage(ZeroedPageList, &Color);
     if (PageIndex == LIST_HEAD)
     {
         /* Check the zero list */
@@ -552,14 +589,15 @@ MiRemoveZeroPage(IN ULONG Color)
             ASSERT(MmZeroedPageListHead.Total == 0);
             Zero = TRUE;
 
-            /* Check the colored free list */
+            /* Check the colored free list, then the other free lists of this node */
             PageIndex = MmFreePagesByColor[FreePageList][Color].Flink;
+            if (PageIndex == LIST_HEAD) PageIndex = MiFindNodeLocalPage(FreePageList, &Color);
             if (PageIndex == LIST_HEAD)
             {
                 /* Check the free list */
                 ASSERT_LIST_INVARIANT(&MmFreePageListHead);
                 PageIndex = MmFreePageListHead.Flink;
-                Color = PageIndex & MmSecondaryColorMask;
+                Color = MI_GET_PAGE_COLOR(PageIndex);
                 ASSERT(PageIndex != LIST_HEAD);
                 if (PageIndex == LIST_HEAD)
                 {
@@ -570,7 +608,7 @@ MiRemoveZeroPage(IN ULONG Color)
         }
         else
         {
-            Color = PageIndex & MmSecondaryColorMask;
+            Color = MI_GET_PAGE_COLOR(PageIndex);
         }
     }
 
@@ -671,7 +709,7 @@ MiInsertPageInFreeList(IN PFN_NUMBER PageFrameIndex)
     MiIncrementAvailablePages();
 
     /* Get the page color */
-    Color = PageFrameIndex & MmSecondaryColorMask;
+    Color = MI_GET_PAGE_COLOR(PageFrameIndex);
 
     /* Get the first page on the color list */
     ColorTable = &MmFreePagesByColor[FreePageList][Color];
@@ -699,6 +737,7 @@ MiInsertPageInFreeList(IN PFN_NUMBER PageFrameIndex)
 
     /* And increase the count in the colored list */
     ColorTable->Count++;
+    KeNodeBlock[MI_GET_COLOR_NODE(Color)]->FreeCount[FreePageList]++;
 
     /* Notify zero page thread if enough pages are on the free list now */
     if ((ListHead->Total >= 8) && !(MmZeroingPageThreadActive))
@@ -905,7 +944,7 @@ MiInsertPageInList(IN PMMPFNLIST ListHead,
         ASSERT(Pfn1->u4.InPageError == 0);
 
         /* Get the page color */
-        Color = PageFrameIndex & MmSecondaryColorMask;
+        Color = MI_GET_PAGE_COLOR(PageFrameIndex);
 
         /* Get the list for this color */
         ColorHead = &MmFreePagesByColor[ZeroedPageList][Color];
@@ -935,6 +974,7 @@ MiInsertPageInList(IN PMMPFNLIST ListHead,
 
         /* One more paged on the colored list */
         ColorHead->Count++;
+        KeNodeBlock[MI_GET_COLOR_NODE(Color)]->FreeCount[ZeroedPageList]++;
 
 #if MI_TRACE_PFNS
             //ASSERT(MI_PFN_CURRENT_USAGE == MI_USAGE_NOT_SET);
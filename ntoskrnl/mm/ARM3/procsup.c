@@ -57,6 +57,7 @@ MiCreatePebOrTeb(IN PEPROCESS Process,
 
     Vad->ControlArea = NULL; // For Memory-Area hack
     Vad->FirstPrototypePte = NULL;
+    Vad->u4.PreferredNode = 0;
 
     /* Check if this is a PEB creation */
     ASSERT(sizeof(TEB) != sizeof(PEB));
@@ -1274,8 +1275,9 @@ MmCleanProcessAddressSpace(IN PEPROCESS Process)
         ASSERT(VadTree->NumberGenericTableElements >= 1);
         MiRemoveNode((PMMADDRESS_NODE)Vad, VadTree);
 
-        /* Only regular VADs supported for now */
-        ASSERT(Vad->u.VadFlags.VadType == VadNone);
+        /* Only regular and large page VADs supported for now */
+        ASSERT((Vad->u.VadFlags.VadType == VadNone) ||
+               (Vad->u.VadFlags.VadType == VadLargePages));
 
         /* Check if this is a section VAD */
         if (!(Vad->u.VadFlags.PrivateMemory) && (Vad->ControlArea))
@@ -1283,6 +1285,15 @@ MmCleanProcessAddressSpace(IN PEPROCESS Process)
             /* Remove the view */
             MiRemoveMappedView(Process, Vad);
         }
+        else if (Vad->u.VadFlags.VadType == VadLargePages)
+        {
+            /* Give the large pages back */
+            MiDeleteLargePages(Vad->StartingVpn << PAGE_SHIFT,
+                               (Vad->EndingVpn << PAGE_SHIFT) | (PAGE_SIZE - 1));
+
+            /* Release the working set */
+            MiUnlockProcessWorkingSetUnsafe(Process, Thread);
+        }
         else
         {
             /* Delete the addresses */
@@ -392,6 +392,22 @@ MiDeletePte(IN PMMPTE PointerPte,
             IN PVOID VirtualAddress,
             IN PEPROCESS CurrentProcess,
             IN PMMPTE PrototypePte)
+{
+    MMPTE_FLUSH_LIST FlushList;
+
+    /* Delete it and flush it right away, from the processors using this address space */
+    FlushList.Count = 0;
+    MiDeletePteDeferFlush(PointerPte, VirtualAddress, CurrentProcess, PrototypePte, &FlushList);
+    MiFlushPteList(&FlushList, FALSE);
+}
+
+VOID
+NTAPI
+MiDeletePteDeferFlush(IN PMMPTE PointerPte,
+                      IN PVOID VirtualAddress,
+                      IN PEPROCESS CurrentProcess,
+                      IN PMMPTE PrototypePte,
+                      IN PMMPTE_FLUSH_LIST FlushList)
 {
     PMMPFN Pfn1;
     MMPTE TempPte;
@@ -531,8 +547,8 @@ MiDeletePte(IN PMMPTE PointerPte,
         //CurrentProcess->NumberOfPrivatePages--;
     }
 
-    /* Flush the TLB */
-    KeFlushCurrentTb();
+    /* The TLB may still have it, the caller flushes the whole batch */
+    MiInsertFlushVa(FlushList, VirtualAddress);
 }
 
 VOID
@@ -548,6 +564,7 @@ MiDeleteVirtualAddresses(IN ULONG_PTR Va,
     KIRQL OldIrql;
     BOOLEAN AddressGap = FALSE;
     PSUBSECTION Subsection;
+    MMPTE_FLUSH_LIST FlushList;
 
     /* Get out if this is a fake VAD, RosMm will free the marea pages */
     if ((Vad) && (Vad->u.VadFlags.Spare == 1)) return;
@@ -627,6 +644,7 @@ MiDeleteVirtualAddresses(IN ULONG_PTR Va,
 
         /* Lock the PFN Database while we delete the PTEs */
         OldIrql = MiAcquirePfnLock();
+        FlushList.Count = 0;
         do
         {
             /* Capture the PDE and make sure it exists */
@@ -668,10 +686,11 @@ MiDeleteVirtualAddresses(IN ULONG_PTR Va,
                     else
                     {
                         /* Delete the PTE proper */
-                        MiDeletePte(PointerPte,
-                                    (PVOID)Va,
-                                    CurrentProcess,
-                                    PrototypePte);
+                        MiDeletePteDeferFlush(PointerPte,
+                                              (PVOID)Va,
+                                              CurrentProcess,
+                                              PrototypePte,
+                                              &FlushList);
                     }
                 }
                 else
@@ -700,13 +719,17 @@ MiDeleteVirtualAddresses(IN ULONG_PTR Va,
             if (PointerPde->u.Long != 0)
             {
                 /* Delete the PTE proper */
-                MiDeletePte(PointerPde,
-                            MiPteToAddress(PointerPde),
-                            CurrentProcess,
-                            NULL);
+                MiDeletePteDeferFlush(PointerPde,
+                                      MiPteToAddress(PointerPde),
+                                      CurrentProcess,
+                                      NULL,
+                                      &FlushList);
             }
         }
 
+        /* Flush the whole run at once, before the pages can be reused */
+        MiFlushPteList(&FlushList, FALSE);
+
         /* Release the lock and get out if we're done */
         MiReleasePfnLock(OldIrql);
         if (Va > EndingAddress) return;
@@ -1462,6 +1485,14 @@ MiQueryAddressState(IN PVOID Va,
     ASSERT((Vad->StartingVpn <= ((ULONG_PTR)Va >> PAGE_SHIFT)) &&
            (Vad->EndingVpn >= ((ULONG_PTR)Va >> PAGE_SHIFT)));
 
+    /* Large pages are all committed, with the VAD's protection */
+    if (Vad->u.VadFlags.VadType == VadLargePages)
+    {
+        *ReturnedProtect = MmProtectToValue[Vad->u.VadFlags.Protection];
+        *NextVa = (PVOID)((Vad->EndingVpn + 1) << PAGE_SHIFT);
+        return MEM_COMMIT;
+    }
+
     /* Only normal VADs supported */
     ASSERT(Vad->u.VadFlags.VadType == VadNone);
 
@@ -4383,7 +4414,7 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
     KPROCESSOR_MODE PreviousMode = KeGetPreviousMode();
     PETHREAD CurrentThread = PsGetCurrentThread();
     KAPC_STATE ApcState;
-    ULONG ProtectionMask, QuotaCharge = 0, QuotaFree = 0;
+    ULONG ProtectionMask, QuotaCharge = 0, QuotaFree = 0, PreferredNode;
     BOOLEAN Attached = FALSE, ChangeProtection = FALSE;
     MMPTE TempPte;
     PMMPTE PointerPte, LastPte;
@@ -4398,6 +4429,15 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
         return STATUS_INVALID_PARAMETER_3;
     }
 
+    /* Take out the preferred node of the allocation, if there is one */
+    PreferredNode = AllocationType & MEM_PREFERRED_NODE_MASK;
+    AllocationType &= ~MEM_PREFERRED_NODE_MASK;
+    if (PreferredNode > KeNumberNodes)
+    {
+        DPRINT1("Invalid preferred node\n");
+        return STATUS_INVALID_PARAMETER_5;
+    }
+
     /* Check for valid Allocation Types */
     if ((AllocationType & ~(MEM_COMMIT | MEM_RESERVE | MEM_RESET | MEM_PHYSICAL |
                     MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_LARGE_PAGES)))
@@ -4436,6 +4476,13 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
             DPRINT1("Using illegal flags with MEM_LARGE_PAGES\n");
             return STATUS_INVALID_PARAMETER_5;
         }
+
+        /* They cannot be committed into an existing reservation either */
+        if (!(AllocationType & MEM_RESERVE))
+        {
+            DPRINT1("Must supply MEM_RESERVE with MEM_LARGE_PAGES\n");
+            return STATUS_INVALID_PARAMETER_5;
+        }
     }
 
     /* MEM_WRITE_WATCH can only be used if MEM_RESERVE is also used */
@@ -4567,14 +4614,38 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
     }
 
     //
-    // Fail on the things we don't yet support
+    // Large page allocations need processor support, and have to be made of
+    // whole large pages with a plain protection
     //
     if ((AllocationType & MEM_LARGE_PAGES) == MEM_LARGE_PAGES)
     {
-        DPRINT1("MEM_LARGE_PAGES not supported\n");
-        Status = STATUS_INVALID_PARAMETER;
-        goto FailPathNoLock;
+        if (!(MmLargePageMinimum) || !(__readcr4() & CR4_PSE))
+        {
+            DPRINT1("MEM_LARGE_PAGES not supported\n");
+            Status = STATUS_INVALID_PARAMETER;
+            goto FailPathNoLock;
+        }
+
+        if (!(PRegionSize) ||
+            (PRegionSize & (MmLargePageMinimum - 1)) ||
+            ((ULONG_PTR)PBaseAddress & (MmLargePageMinimum - 1)))
+        {
+            DPRINT1("Unaligned MEM_LARGE_PAGES allocation\n");
+            Status = STATUS_INVALID_PARAMETER;
+            goto FailPathNoLock;
+        }
+
+        if (ProtectionMask & ~MM_PROTECT_ACCESS)
+        {
+            DPRINT1("Invalid protection for MEM_LARGE_PAGES\n");
+            Status = STATUS_INVALID_PAGE_PROTECTION;
+            goto FailPathNoLock;
+        }
     }
+
+    //
+    // Fail on the things we don't yet support
+    //
     if ((AllocationType & MEM_PHYSICAL) == MEM_PHYSICAL)
     {
         DPRINT1("MEM_PHYSICAL not supported\n");
@@ -4657,9 +4728,11 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
 
         RtlZeroMemory(Vad, sizeof(MMVAD_LONG));
         if (AllocationType & MEM_COMMIT) Vad->u.VadFlags.MemCommit = 1;
+        if (AllocationType & MEM_LARGE_PAGES) Vad->u.VadFlags.VadType = VadLargePages;
         Vad->u.VadFlags.Protection = ProtectionMask;
         Vad->u.VadFlags.PrivateMemory = 1;
         Vad->ControlArea = NULL; // For Memory-Area hack
+        ((PMMVAD_LONG)Vad)->u4.PreferredNode = PreferredNode;
 
         //
         // Insert the VAD
@@ -4668,7 +4741,8 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
                                &StartingAddress,
                                PRegionSize,
                                HighestAddress,
-                               MM_VIRTMEM_GRANULARITY,
+                               (AllocationType & MEM_LARGE_PAGES) ?
+                               MmLargePageMinimum : MM_VIRTMEM_GRANULARITY,
                                AllocationType);
         if (!NT_SUCCESS(Status))
         {
@@ -4676,6 +4750,28 @@ NtAllocateVirtualMemory(IN HANDLE ProcessHandle,
             goto FailPathNoLock;
         }
 
+        //
+        // Large pages are never faulted in, so back the whole VAD right away
+        //
+        if (AllocationType & MEM_LARGE_PAGES)
+        {
+            AddressSpace = MmGetCurrentAddressSpace();
+            MmLockAddressSpace(AddressSpace);
+            Status = MiMapLargePages(Process, Vad);
+            if (!NT_SUCCESS(Status))
+            {
+                DPRINT1("Failed to map the large pages!\n");
+                MiLockProcessWorkingSetUnsafe(Process, CurrentThread);
+                MiRemoveNode((PMMADDRESS_NODE)Vad, &Process->VadRoot);
+                MiUnlockProcessWorkingSetUnsafe(Process, CurrentThread);
+                Process->VirtualSize -= PRegionSize;
+                MmUnlockAddressSpace(AddressSpace);
+                ExFreePoolWithTag(Vad, 'SdaV');
+                goto FailPathNoLock;
+            }
+            MmUnlockAddressSpace(AddressSpace);
+        }
+
         //
         // Detach and dereference the target process if
         // it was different from the current process
@@ -5105,7 +5201,7 @@ NtFreeVirtualMemory(IN HANDLE ProcessHandle,
     PEPROCESS CurrentProcess = PsGetCurrentProcess();
     KPROCESSOR_MODE PreviousMode = KeGetPreviousMode();
     KAPC_STATE ApcState;
-    BOOLEAN Attached = FALSE;
+    BOOLEAN Attached = FALSE, LargePages = FALSE;
     PAGED_CODE();
 
     //
@@ -5266,9 +5362,20 @@ NtFreeVirtualMemory(IN HANDLE ProcessHandle,
     if (FreeType & MEM_RELEASE)
     {
         //
-        // ARM3 only supports this VAD in this path
+        // ARM3 only supports these VADs in this path, and large pages can only
+        // go away all at once
         //
-        ASSERT(Vad->u.VadFlags.VadType == VadNone);
+        ASSERT((Vad->u.VadFlags.VadType == VadNone) ||
+               (Vad->u.VadFlags.VadType == VadLargePages));
+        LargePages = (Vad->u.VadFlags.VadType == VadLargePages);
+        if ((LargePages) &&
+            (((StartingAddress >> PAGE_SHIFT) != Vad->StartingVpn) ||
+             ((PRegionSize) && ((EndingAddress >> PAGE_SHIFT) != Vad->EndingVpn))))
+        {
+            DPRINT1("Trying to release part of a large page allocation\n");
+            Status = STATUS_FREE_VM_NOT_AT_BASE;
+            goto FailPath;
+        }
 
         //
         // Is the caller trying to remove the whole VAD, or remove only a portion
@@ -5407,7 +5514,14 @@ NtFreeVirtualMemory(IN HANDLE ProcessHandle,
         // to do that and then release the working set, since we're done messing
         // around with process pages.
         //
-        MiDeleteVirtualAddresses(StartingAddress, EndingAddress, NULL);
+        if (LargePages)
+        {
+            MiDeleteLargePages(StartingAddress, EndingAddress);
+        }
+        else
+        {
+            MiDeleteVirtualAddresses(StartingAddress, EndingAddress, NULL);
+        }
         MiUnlockProcessWorkingSetUnsafe(Process, CurrentThread);
         Status = STATUS_SUCCESS;
 
@@ -20,6 +20,15 @@
 BOOLEAN MmZeroingPageThreadActive;
 KEVENT MmZeroingPageEvent;
 
+/* Periodically wakes up the zeroing threads, so that they get to use idle time */
+KTIMER MiZeroingIdleTimer;
+
+/* How many free pages a zeroing thread takes per PFN lock acquisition */
+#define MI_ZERO_PAGE_BATCH      16
+
+/* How often (in ms) the zeroing threads look at the free list on their own */
+#define MI_ZERO_PAGE_IDLE_TIME  1000
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
 VOID
@@ -32,34 +41,44 @@ NTAPI
 MiFreeInitializationCode(IN PVOID StartVa,
 IN PVOID EndVa);
 
+static
 VOID
-NTAPI
-MmZeroPageThread(VOID)
+MiZeroFreePages(IN CCHAR Processor)
 {
-    PKTHREAD Thread = KeGetCurrentThread();
-    PVOID StartAddress, EndAddress;
     PVOID WaitObjects[2];
     KIRQL OldIrql;
     PVOID ZeroAddress;
+    PMMPTE ZeroPtes;
+    MMPTE TempPte;
     PFN_NUMBER PageIndex, FreePage;
-    PMMPFN Pfn1;
-
-    /* Get the discardable sections to free them */
-    MiFindInitializationCode(&StartAddress, &EndAddress);
-    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
-    DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
-
-    /* Set our priority to 0 */
-    Thread->BasePriority = 0;
-    KeSetPriorityThread(Thread, 0);
+    PFN_NUMBER Pages[MI_ZERO_PAGE_BATCH];
+    ULONG i, Count;
+
+    /*
+     * Each zeroing thread gets its own mapping window, and stays on its own
+     * processor, so that it only ever has to flush its local TB.
+     */
+    ZeroPtes = MiReserveSystemPtes(MI_ZERO_PAGE_BATCH, SystemPteSpace);
+    if (!ZeroPtes)
+    {
+        DPRINT1("No system PTEs for the zeroing thread on CPU %d\n", Processor);
+        return;
+    }
+    ZeroAddress = MiPteToAddress(ZeroPtes);
+    TempPte = ValidKernelPte;
+    KeSetSystemAffinityThread(AFFINITY_MASK(Processor));
 
     /* Setup the wait objects */
     WaitObjects[0] = &MmZeroingPageEvent;
-//    WaitObjects[1] = &PoSystemIdleTimer; FIXME: Implement idle timer
+    WaitObjects[1] = &MiZeroingIdleTimer;
 
     while (TRUE)
     {
-        KeWaitForMultipleObjects(1, // 2
+        /*
+         * We run at priority 0, so coming back from the idle timer means we
+         * only get the CPU when nothing else wants it.
+         */
+        KeWaitForMultipleObjects(2,
                                  WaitObjects,
                                  WaitAny,
                                  WrFreePage,
@@ -74,41 +93,123 @@ MmZeroPageThread(VOID)
         {
             if (!MmFreePageListHead.Total)
             {
+                /* Nothing left; the next freed pages will wake us up again */
                 MmZeroingPageThreadActive = FALSE;
+                KeClearEvent(&MmZeroingPageEvent);
                 MiReleasePfnLock(OldIrql);
                 break;
             }
 
-            PageIndex = MmFreePageListHead.Flink;
-            ASSERT(PageIndex != LIST_HEAD);
-            Pfn1 = MiGetPfnEntry(PageIndex);
-            MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
-            MI_SET_PROCESS2("Kernel 0 Loop");
-            FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
-
-            /* The first global free page should also be the first on its own list */
-            if (FreePage != PageIndex)
+            /* Take a batch of free pages at once */
+            for (Count = 0;
+                 (Count < MI_ZERO_PAGE_BATCH) && (MmFreePageListHead.Total);
+                 Count++)
             {
-                KeBugCheckEx(PFN_LIST_CORRUPT,
-                             0x8F,
-                             FreePage,
-                             PageIndex,
-                             0);
+                PageIndex = MmFreePageListHead.Flink;
+                ASSERT(PageIndex != LIST_HEAD);
+                MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
+                MI_SET_PROCESS2("Kernel 0 Loop");
+                FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
+
+                /* The first global free page should also be the first on its own list */
+                if (FreePage != PageIndex)
+                {
+                    KeBugCheckEx(PFN_LIST_CORRUPT,
+                                 0x8F,
+                                 FreePage,
+                                 PageIndex,
+                                 0);
+                }
+
+                Pages[Count] = PageIndex;
             }
-
-            Pfn1->u1.Flink = LIST_HEAD;
             MiReleasePfnLock(OldIrql);
 
-            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, 1);
-            ASSERT(ZeroAddress);
-            RtlZeroMemory(ZeroAddress, PAGE_SIZE);
-            MiUnmapPagesInZeroSpace(ZeroAddress, 1);
+            /* Map the whole batch, and zero it without going through the caches */
+            for (i = 0; i < Count; i++)
+            {
+                TempPte.u.Hard.PageFrameNumber = Pages[i];
+                MI_WRITE_VALID_PTE(&ZeroPtes[i], TempPte);
+            }
+            KeZeroPagesFromIdleThread(ZeroAddress, Count * PAGE_SIZE);
+            for (i = 0; i < Count; i++)
+            {
+                MI_ERASE_PTE(&ZeroPtes[i]);
+                KeInvalidateTlbEntry((PVOID)((ULONG_PTR)ZeroAddress + i * PAGE_SIZE));
+            }
 
             OldIrql = MiAcquirePfnLock();
 
-            MiInsertPageInList(&MmZeroedPageListHead, PageIndex);
+            for (i = 0; i < Count; i++)
+            {
+                MiInsertPageInList(&MmZeroedPageListHead, Pages[i]);
+            }
         }
     }
 }
 
+static KSTART_ROUTINE MiZeroPageWorkerThread;
+static
+VOID
+NTAPI
+MiZeroPageWorkerThread(IN PVOID Context)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+
+    /* Set our priority to 0 */
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    MiZeroFreePages((CCHAR)(ULONG_PTR)Context);
+}
+
+VOID
+NTAPI
+MmZeroPageThread(VOID)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+    PVOID StartAddress, EndAddress;
+    LARGE_INTEGER DueTime;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+    CCHAR i;
+
+    /* Get the discardable sections to free them */
+    MiFindInitializationCode(&StartAddress, &EndAddress);
+    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
+    DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
+
+    /* Set our priority to 0 */
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    /* Start the idle timer, in place of the power manager's one */
+    KeInitializeTimerEx(&MiZeroingIdleTimer, SynchronizationTimer);
+    DueTime.QuadPart = Int32x32To64(MI_ZERO_PAGE_IDLE_TIME, -10000);
+    KeSetTimerEx(&MiZeroingIdleTimer, DueTime, MI_ZERO_PAGE_IDLE_TIME, NULL);
+
+    /* Every other processor gets its own zeroing thread */
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    for (i = 1; i < KeNumberProcessors; i++)
+    {
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      &ObjectAttributes,
+                                      NULL,
+                                      NULL,
+                                      MiZeroPageWorkerThread,
+                                      (PVOID)(ULONG_PTR)i);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to create the zeroing thread for CPU %d: 0x%lx\n", i, Status);
+            continue;
+        }
+        ZwClose(ThreadHandle);
+    }
+
+    /* And this one zeroes on the boot processor */
+    MiZeroFreePages(0);
+}
+
 /* EOF */
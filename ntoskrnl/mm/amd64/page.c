@@ -426,6 +426,31 @@ MmSetCleanPage(PEPROCESS Process, PVOID Address)
     MiFlushTlb(Pte, Address);
 }
 
+BOOLEAN
+NTAPI
+MmTestAndClearAccessedPage(PEPROCESS Process, PVOID Address)
+{
+    PMMPTE Pte;
+    BOOLEAN Accessed = FALSE;
+
+    Pte = MiGetPteForProcess(Process, Address, FALSE);
+    if (!Pte)
+    {
+        return FALSE;
+    }
+
+    /* Clear the accessed bit */
+    if (Pte->u.Hard.Valid && InterlockedBitTestAndReset64((PVOID)Pte, 5))
+    {
+        if (!MiIsHyperspaceAddress(Pte))
+            __invlpg(Address);
+        Accessed = TRUE;
+    }
+
+    MiFlushTlb(Pte, Address);
+    return Accessed;
+}
+
 VOID
 NTAPI
 MmSetDirtyPage(PEPROCESS Process, PVOID Address)
@@ -573,6 +573,18 @@ MmSetCleanPage(IN PEPROCESS Process,
     UNIMPLEMENTED_DBGBREAK();
 }
 
+BOOLEAN
+NTAPI
+MmTestAndClearAccessedPage(IN PEPROCESS Process,
+                           IN PVOID Address)
+{
+    //
+    // TODO
+    //
+    UNIMPLEMENTED_DBGBREAK();
+    return TRUE;
+}
+
 VOID
 NTAPI
 MmSetDirtyPage(IN PEPROCESS Process,
@@ -45,6 +45,9 @@ static HANDLE MiBalancerThreadHandle = NULL;
 static KEVENT MiBalancerEvent;
 static KTIMER MiBalancerTimer;
 
+/* Trimmer passes a page must go unaccessed before it is paged out first */
+#define MI_MAX_PAGE_AGE 3
+
 /* FUNCTIONS ****************************************************************/
 
 VOID
@@ -180,27 +183,50 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
     PFN_NUMBER CurrentPage;
     PFN_NUMBER NextPage;
     NTSTATUS Status;
+    ULONG Pass, MinimumAge, Age;
+    BOOLEAN Accessed, BelowMinimum, AboveMaximum;
 
     (*NrFreedPages) = 0;
 
-    CurrentPage = MmGetLRUFirstUserPage();
-    while (CurrentPage != 0 && Target > 0)
+    /*
+     * Each pass over the user pages samples and clears their accessed bits.
+     * The first pass also ages the pages that weren't touched since the last
+     * trim, and the following ones lower the age required for paging out,
+     * until the target is met. Pages of processes above their maximum
+     * working set go as soon as they aged once, while processes at or below
+     * their minimum working set are only trimmed in the last pass.
+     */
+    for (Pass = 0; Pass <= MI_MAX_PAGE_AGE && Target > 0; Pass++)
     {
-        Status = MmPageOutPhysicalAddress(CurrentPage);
-        if (NT_SUCCESS(Status))
-        {
-            DPRINT("Succeeded\n");
-            Target--;
-            (*NrFreedPages)++;
-        }
+        MinimumAge = MI_MAX_PAGE_AGE - Pass;
 
-        NextPage = MmGetLRUNextUserPage(CurrentPage);
-        if (NextPage <= CurrentPage)
+        CurrentPage = MmGetLRUFirstUserPage();
+        while (CurrentPage != 0 && Target > 0)
         {
-            /* We wrapped around, so we're done */
-            break;
+            Accessed = MmTestAndClearAccessedAllRmaps(CurrentPage, &BelowMinimum, &AboveMaximum);
+            Age = MmAgeLRUUserPage(CurrentPage, Accessed, Pass == 0);
+
+            if (!Accessed &&
+                (!BelowMinimum || Pass == MI_MAX_PAGE_AGE) &&
+                (Age >= MinimumAge || (AboveMaximum && Age >= 1)))
+            {
+                Status = MmPageOutPhysicalAddress(CurrentPage);
+                if (NT_SUCCESS(Status))
+                {
+                    DPRINT("Succeeded\n");
+                    Target--;
+                    (*NrFreedPages)++;
+                }
+            }
+
+            NextPage = MmGetLRUNextUserPage(CurrentPage);
+            if (NextPage <= CurrentPage)
+            {
+                /* We wrapped around, so we're done */
+                break;
+            }
+            CurrentPage = NextPage;
         }
-        CurrentPage = NextPage;
     }
 
     return STATUS_SUCCESS;
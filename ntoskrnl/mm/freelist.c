@@ -21,6 +21,9 @@
 
 /* GLOBALS ****************************************************************/
 
+/* PFN lock acquisitions that found it already held by another processor */
+volatile LONG MiPfnLockContentionCount;
+
 PMMPFN MmPfnDatabase;
 
 PFN_NUMBER MmAvailablePages;
@@ -89,7 +92,34 @@ MmInsertLRULastUserPage(PFN_NUMBER Pfn)
     ASSERT(!RtlCheckBit(&MiUserPfnBitMap, (ULONG)Pfn));
     OldIrql = MiAcquirePfnLock();
     RtlSetBit(&MiUserPfnBitMap, (ULONG)Pfn);
+    MiGetPfnEntry(Pfn)->Wsle.u1.e1.Age = 0;
+    MiReleasePfnLock(OldIrql);
+}
+
+ULONG
+NTAPI
+MmAgeLRUUserPage(PFN_NUMBER Pfn, BOOLEAN Accessed, BOOLEAN Increment)
+{
+    PMMPFN Pfn1;
+    ULONG Age;
+    KIRQL OldIrql;
+
+    /* The age counts the trimmer passes that found the page not accessed */
+    OldIrql = MiAcquirePfnLock();
+    Pfn1 = MiGetPfnEntry(Pfn);
+    ASSERT_IS_ROS_PFN(Pfn1);
+    if (Accessed)
+    {
+        Pfn1->Wsle.u1.e1.Age = 0;
+    }
+    else if (Increment && Pfn1->Wsle.u1.e1.Age < 3)
+    {
+        Pfn1->Wsle.u1.e1.Age++;
+    }
+    Age = Pfn1->Wsle.u1.e1.Age;
     MiReleasePfnLock(OldIrql);
+
+    return Age;
 }
 
 PFN_NUMBER
@@ -388,14 +418,18 @@ MiAllocatePagesForMdl(IN PHYSICAL_ADDRESS LowAddress,
     return Mdl;
 }
 
+/*
+ * The rmap list head, the saved swap entry and the reference count reads below
+ * don't take the PFN lock: the rmap list is serialized by RmapListLock, the
+ * swap entry only changes under the locks of the page's owner, and a reference
+ * count read is stale as soon as any lock is dropped anyway.
+ */
 VOID
 NTAPI
 MmSetRmapListHeadPage(PFN_NUMBER Pfn, PMM_RMAP_ENTRY ListHead)
 {
-    KIRQL oldIrql;
     PMMPFN Pfn1;
 
-    oldIrql = MiAcquirePfnLock();
     Pfn1 = MiGetPfnEntry(Pfn);
     ASSERT(Pfn1);
     ASSERT_IS_ROS_PFN(Pfn1);
@@ -418,21 +452,15 @@ MmSetRmapListHeadPage(PFN_NUMBER Pfn, PMM_RMAP_ENTRY ListHead)
 
         /* ReactOS semantics will now release the page, which will make it free and enter a colored list */
     }
-
-    MiReleasePfnLock(oldIrql);
 }
 
 PMM_RMAP_ENTRY
 NTAPI
 MmGetRmapListHeadPage(PFN_NUMBER Pfn)
 {
-    KIRQL oldIrql;
     PMM_RMAP_ENTRY ListHead;
     PMMPFN Pfn1;
 
-    /* Lock PFN database */
-    oldIrql = MiAcquirePfnLock();
-
     /* Get the entry */
     Pfn1 = MiGetPfnEntry(Pfn);
     ASSERT(Pfn1);
@@ -444,8 +472,7 @@ MmGetRmapListHeadPage(PFN_NUMBER Pfn)
     /* Should not have an RMAP for a non-active page */
     ASSERT(MiIsPfnInUse(Pfn1) == TRUE);
 
-    /* Release PFN database and return rmap list head */
-    MiReleasePfnLock(oldIrql);
+    /* Return rmap list head */
     return ListHead;
 }
 
@@ -453,35 +480,26 @@ VOID
 NTAPI
 MmSetSavedSwapEntryPage(PFN_NUMBER Pfn,  SWAPENTRY SwapEntry)
 {
-    KIRQL oldIrql;
     PMMPFN Pfn1;
 
     Pfn1 = MiGetPfnEntry(Pfn);
     ASSERT(Pfn1);
     ASSERT_IS_ROS_PFN(Pfn1);
 
-    oldIrql = MiAcquirePfnLock();
     Pfn1->u1.SwapEntry = SwapEntry;
-    MiReleasePfnLock(oldIrql);
 }
 
 SWAPENTRY
 NTAPI
 MmGetSavedSwapEntryPage(PFN_NUMBER Pfn)
 {
-    SWAPENTRY SwapEntry;
-    KIRQL oldIrql;
     PMMPFN Pfn1;
 
     Pfn1 = MiGetPfnEntry(Pfn);
     ASSERT(Pfn1);
     ASSERT_IS_ROS_PFN(Pfn1);
 
-    oldIrql = MiAcquirePfnLock();
-    SwapEntry = Pfn1->u1.SwapEntry;
-    MiReleasePfnLock(oldIrql);
-
-    return(SwapEntry);
+    return Pfn1->u1.SwapEntry;
 }
 
 VOID
@@ -508,21 +526,15 @@ ULONG
 NTAPI
 MmGetReferenceCountPage(PFN_NUMBER Pfn)
 {
-    KIRQL oldIrql;
-    ULONG RCount;
     PMMPFN Pfn1;
 
     DPRINT("MmGetReferenceCountPage(PhysicalAddress %x)\n", Pfn << PAGE_SHIFT);
 
-    oldIrql = MiAcquirePfnLock();
     Pfn1 = MiGetPfnEntry(Pfn);
     ASSERT(Pfn1);
     ASSERT_IS_ROS_PFN(Pfn1);
 
-    RCount = Pfn1->u3.e2.ReferenceCount;
-
-    MiReleasePfnLock(oldIrql);
-    return(RCount);
+    return *(volatile USHORT *)&Pfn1->u3.e2.ReferenceCount;
 }
 
 BOOLEAN
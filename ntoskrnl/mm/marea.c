@@ -72,10 +72,20 @@ MmLocateMemoryAreaByAddress(
     Process = MmGetAddressSpaceOwner(AddressSpace);
     Table = (Process != NULL) ? &Process->VadRoot : &MiRosKernelVadRoot;
 
-    Result = MiCheckForConflictingNode(StartVpn, StartVpn, Table, &Node);
-    if (Result != TableFoundNode)
+    /* Try the last hit first, faults tend to come in the same area */
+    Node = Table->NodeHint;
+    if ((Node == NULL) ||
+        (StartVpn < Node->StartingVpn) ||
+        (StartVpn > Node->EndingVpn))
     {
-        return NULL;
+        Result = MiCheckForConflictingNode(StartVpn, StartVpn, Table, &Node);
+        if (Result != TableFoundNode)
+        {
+            return NULL;
+        }
+
+        /* Remember it for the next lookup */
+        Table->NodeHint = Node;
     }
 
     Vad = (PMMVAD_LONG)Node;
@@ -120,10 +130,17 @@ MmLocateMemoryAreaByRegion(
     Process = MmGetAddressSpaceOwner(AddressSpace);
     Table = (Process != NULL) ? &Process->VadRoot : &MiRosKernelVadRoot;
 
-    Result = MiCheckForConflictingNode(StartVpn, EndVpn, Table, &Node);
-    if (Result != TableFoundNode)
+    /* Try the last hit first, if it covers the whole region */
+    Node = Table->NodeHint;
+    if ((Node == NULL) ||
+        (StartVpn < Node->StartingVpn) ||
+        (EndVpn > Node->EndingVpn))
     {
-        return NULL;
+        Result = MiCheckForConflictingNode(StartVpn, EndVpn, Table, &Node);
+        if (Result != TableFoundNode)
+        {
+            return NULL;
+        }
     }
 
     Vad = (PMMVAD_LONG)Node;
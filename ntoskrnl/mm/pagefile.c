@@ -135,6 +135,16 @@ MmShowOutOfSpaceMessagePagingFile(VOID)
 NTSTATUS
 NTAPI
 MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+{
+    return MmWriteToSwapPages(SwapEntry, &Page, 1);
+}
+
+NTSTATUS
+NTAPI
+MmWriteToSwapPages(
+    _In_ SWAPENTRY SwapEntry,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount)
 {
     ULONG i;
     ULONG_PTR offset;
@@ -142,10 +152,10 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
     IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
+    UCHAR MdlBase[sizeof(MDL) + MI_PAGEFILE_CLUSTER_SIZE * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
 
-    DPRINT("MmWriteToSwapPage\n");
+    DPRINT("MmWriteToSwapPages\n");
 
     if (SwapEntry == 0)
     {
@@ -153,6 +163,8 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         return(STATUS_UNSUCCESSFUL);
     }
 
+    ASSERT((PageCount != 0) && (PageCount <= MI_PAGEFILE_CLUSTER_SIZE));
+
     i = FILE_FROM_ENTRY(SwapEntry);
     offset = OFFSET_FROM_ENTRY(SwapEntry) - 1;
 
@@ -163,8 +175,15 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
+    /* Keep it compressed in memory if we can, that's no write at all */
+    if (MiStorePages(i, offset, Pages, PageCount))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    /* The whole run goes out in a single write */
+    MmInitializeMdl(Mdl, NULL, PageCount * PAGE_SIZE);
+    MmBuildMdlFromPages(Mdl, Pages);
     Mdl->MdlFlags |= MDL_PAGES_LOCKED;
 
     file_offset.QuadPart = offset * PAGE_SIZE;
@@ -202,14 +221,26 @@ MiReadPageFile(
     _In_ PFN_NUMBER Page,
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset)
+{
+    return MiReadPageFileCluster(&Page, 1, PageFileIndex, PageFileOffset);
+}
+
+NTSTATUS
+NTAPI
+MiReadPageFileCluster(
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount,
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
 {
     LARGE_INTEGER file_offset;
     IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
+    UCHAR MdlBase[sizeof(MDL) + MI_PAGEFILE_CLUSTER_SIZE * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
     PMMPAGING_FILE PagingFile;
+    ULONG Loaded;
 
     DPRINT("MiReadSwapFile\n");
 
@@ -220,6 +251,7 @@ MiReadPageFile(
     }
 
     ASSERT(PageFileIndex < MAX_PAGING_FILES);
+    ASSERT((PageCount != 0) && (PageCount <= MI_PAGEFILE_CLUSTER_SIZE));
 
     PagingFile = MmPagingFile[PageFileIndex];
 
@@ -229,8 +261,16 @@ MiReadPageFile(
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
+    /* Pages kept compressed in memory don't need the disk */
+    Loaded = MiLoadStoredPages(PageFileIndex, PageFileOffset, Pages, PageCount);
+    if (Loaded == PageCount)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    /* Pages are given in paging file order, so that's one read */
+    MmInitializeMdl(Mdl, NULL, PageCount * PAGE_SIZE);
+    MmBuildMdlFromPages(Mdl, Pages);
     Mdl->MdlFlags |= MDL_PAGES_LOCKED;
 
     file_offset.QuadPart = PageFileOffset * PAGE_SIZE;
@@ -250,6 +290,12 @@ MiReadPageFile(
     {
         MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
     }
+
+    /* The read went over the stored ones too, with what the disk never got */
+    if (Loaded && NT_SUCCESS(Status))
+    {
+        MiLoadStoredPages(PageFileIndex, PageFileOffset, Pages, PageCount);
+    }
     return(Status);
 }
 
@@ -271,6 +317,8 @@ MmInitPagingFile(VOID)
         MmPagingFile[i] = NULL;
     }
     MmNumberOfPagingFiles = 0;
+
+    MiInitializePageStore();
 }
 
 VOID
@@ -284,6 +332,8 @@ MmFreeSwapPage(SWAPENTRY Entry)
     i = FILE_FROM_ENTRY(Entry);
     off = OFFSET_FROM_ENTRY(Entry) - 1;
 
+    MiFreeStoredPage(i, off);
+
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
 
     PagingFile = MmPagingFile[i];
@@ -292,7 +342,7 @@ MmFreeSwapPage(SWAPENTRY Entry)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    RtlClearBit(PagingFile->Bitmap, off >> 5);
+    RtlClearBit(PagingFile->Bitmap, (ULONG)off);
 
     PagingFile->FreeSpace++;
     PagingFile->CurrentUsage--;
@@ -306,14 +356,24 @@ MmFreeSwapPage(SWAPENTRY Entry)
 SWAPENTRY
 NTAPI
 MmAllocSwapPage(VOID)
+{
+    return MmAllocSwapPages(1);
+}
+
+SWAPENTRY
+NTAPI
+MmAllocSwapPages(ULONG PageCount)
 {
     ULONG i;
     ULONG off;
     SWAPENTRY entry;
+    PMMPAGING_FILE PagingFile;
+
+    ASSERT((PageCount != 0) && (PageCount <= MI_PAGEFILE_CLUSTER_SIZE));
 
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
 
-    if (MiFreeSwapPages == 0)
+    if (MiFreeSwapPages < PageCount)
     {
         KeReleaseGuardedMutex(&MmPageFileCreationLock);
         return(0);
@@ -321,27 +381,37 @@ MmAllocSwapPage(VOID)
 
     for (i = 0; i < MAX_PAGING_FILES; i++)
     {
-        if (MmPagingFile[i] != NULL &&
-                MmPagingFile[i]->FreeSpace >= 1)
+        PagingFile = MmPagingFile[i];
+        if (PagingFile == NULL || PagingFile->FreeSpace < PageCount)
         {
-            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, 0);
-            if (off == 0xFFFFFFFF)
-            {
-                KeBugCheck(MEMORY_MANAGEMENT);
-                KeReleaseGuardedMutex(&MmPageFileCreationLock);
-                return(STATUS_UNSUCCESSFUL);
-            }
-            MiUsedSwapPages++;
-            MiFreeSwapPages--;
-            KeReleaseGuardedMutex(&MmPageFileCreationLock);
+            continue;
+        }
 
-            entry = ENTRY_FROM_FILE_OFFSET(i, off + 1);
-            return(entry);
+        /*
+         * Go on from where the last allocation ended, so that pages written
+         * out one after the other end up next to each other in the file, and
+         * can be read back in one go.
+         */
+        off = RtlFindClearBitsAndSet(PagingFile->Bitmap, PageCount, PagingFile->HintIndex);
+        if (off == 0xFFFFFFFF)
+        {
+            /* Too fragmented for this run, try another file */
+            continue;
         }
+        PagingFile->HintIndex = off + PageCount;
+
+        PagingFile->FreeSpace -= PageCount;
+        PagingFile->CurrentUsage += PageCount;
+
+        MiUsedSwapPages += PageCount;
+        MiFreeSwapPages -= PageCount;
+        KeReleaseGuardedMutex(&MmPageFileCreationLock);
+
+        entry = ENTRY_FROM_FILE_OFFSET(i, off + 1);
+        return(entry);
     }
 
     KeReleaseGuardedMutex(&MmPageFileCreationLock);
-    KeBugCheck(MEMORY_MANAGEMENT);
     return(0);
 }
 
@@ -788,6 +858,10 @@ NtCreatePagingFile(IN PUNICODE_STRING FileName,
                         (ULONG)(PagingFile->MaximumSize));
     RtlClearAllBits(PagingFile->Bitmap);
 
+    /* Keep the header out of the allocator's way */
+    RtlSetBit(PagingFile->Bitmap, 0);
+    PagingFile->HintIndex = 1;
+
     /* FIXME: should be calling unsafe instead,
      * we should already be in a guarded region
      */
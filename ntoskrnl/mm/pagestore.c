@@ -0,0 +1,272 @@
+/*
+ * COPYRIGHT:       See COPYING in the top directory
+ * PROJECT:         ReactOS kernel
+ * FILE:            ntoskrnl/mm/pagestore.c
+ * PURPOSE:         Compressed in-memory store in front of the paging files
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+#if defined (ALLOC_PRAGMA)
+#pragma alloc_text(INIT, MiInitializePageStore)
+#endif
+
+/*
+ * Pages on their way to a paging file are compressed and kept in nonpaged
+ * pool instead, when they compress well enough and the store isn't full.
+ * They keep their paging file slot, so nothing changes for the callers or
+ * for commit accounting: a stored page is only read from memory rather
+ * than from the disk, and it goes away with its slot in MmFreeSwapPage.
+ */
+
+/* TYPES *********************************************************************/
+
+typedef struct _MI_STORED_PAGE
+{
+    struct _MI_STORED_PAGE *Next;
+    ULONG_PTR PageFileOffset;
+    USHORT PageFileIndex;
+    USHORT Size;
+    UCHAR Data[ANYSIZE_ARRAY];
+} MI_STORED_PAGE, *PMI_STORED_PAGE;
+
+/* GLOBALS *******************************************************************/
+
+#define MI_PAGE_STORE_BUCKETS 1024
+#define MI_PAGE_STORE_HASH(i, o) (((o) + ((ULONG_PTR)(i) << 10)) & (MI_PAGE_STORE_BUCKETS - 1))
+
+/* Pages that compress worse than that aren't worth the pool, they go to disk */
+#define MI_PAGE_STORE_MAX_SIZE (PAGE_SIZE * 3 / 4)
+
+static PMI_STORED_PAGE MiPageStoreHash[MI_PAGE_STORE_BUCKETS];
+static KGUARDED_MUTEX MiPageStoreLock;
+static PVOID MiPageStoreWorkSpace;
+static PUCHAR MiPageStoreBuffer;
+
+/* Pool used by the stored pages, and how much of it they can take */
+SIZE_T MiPageStoreSize;
+SIZE_T MiPageStoreLimit;
+ULONG MiPageStoreCount;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static
+PMI_STORED_PAGE*
+MiFindStoredPage(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    PMI_STORED_PAGE *Link;
+
+    Link = &MiPageStoreHash[MI_PAGE_STORE_HASH(PageFileIndex, PageFileOffset)];
+    while (*Link != NULL)
+    {
+        if (((*Link)->PageFileOffset == PageFileOffset) &&
+            ((*Link)->PageFileIndex == PageFileIndex))
+        {
+            break;
+        }
+        Link = &(*Link)->Next;
+    }
+
+    return Link;
+}
+
+static
+VOID
+MiDropStoredPages(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ ULONG PageCount)
+{
+    PMI_STORED_PAGE *Link, Entry;
+    ULONG i;
+
+    for (i = 0; (i < PageCount) && (MiPageStoreCount != 0); i++)
+    {
+        Link = MiFindStoredPage(PageFileIndex, PageFileOffset + i);
+        Entry = *Link;
+        if (Entry == NULL) continue;
+
+        *Link = Entry->Next;
+        MiPageStoreSize -= Entry->Size;
+        MiPageStoreCount--;
+        ExFreePoolWithTag(Entry, TAG_MM_PAGE_STORE);
+    }
+}
+
+/* PUBLIC FUNCTIONS **********************************************************/
+
+VOID
+INIT_FUNCTION
+NTAPI
+MiInitializePageStore(VOID)
+{
+    ULONG WorkSpaceSize, FragmentSize;
+    NTSTATUS Status;
+
+    KeInitializeGuardedMutex(&MiPageStoreLock);
+
+    /* Take at most 1/32th of the memory */
+    MiPageStoreLimit = (MmNumberOfPhysicalPages / 32) * PAGE_SIZE;
+
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD,
+                                            &WorkSpaceSize,
+                                            &FragmentSize);
+    if (!NT_SUCCESS(Status)) return;
+
+    MiPageStoreWorkSpace = ExAllocatePoolWithTag(NonPagedPool, WorkSpaceSize, TAG_MM_PAGE_STORE);
+    MiPageStoreBuffer = ExAllocatePoolWithTag(NonPagedPool, MI_PAGE_STORE_MAX_SIZE, TAG_MM_PAGE_STORE);
+    if ((MiPageStoreWorkSpace == NULL) || (MiPageStoreBuffer == NULL))
+    {
+        /* Not a big deal, everything goes to the paging files as before */
+        DPRINT1("No memory for the page store, it is disabled\n");
+        if (MiPageStoreWorkSpace) ExFreePoolWithTag(MiPageStoreWorkSpace, TAG_MM_PAGE_STORE);
+        if (MiPageStoreBuffer) ExFreePoolWithTag(MiPageStoreBuffer, TAG_MM_PAGE_STORE);
+        MiPageStoreWorkSpace = NULL;
+        MiPageStoreBuffer = NULL;
+    }
+}
+
+BOOLEAN
+NTAPI
+MiStorePages(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount)
+{
+    PMI_STORED_PAGE Entries[MI_PAGEFILE_CLUSTER_SIZE];
+    PMI_STORED_PAGE *Link;
+    PEPROCESS Process = PsGetCurrentProcess();
+    PVOID PageAddress;
+    ULONG i, Size;
+    SIZE_T TotalSize = 0;
+    NTSTATUS Status;
+    KIRQL Irql;
+
+    ASSERT((PageCount != 0) && (PageCount <= MI_PAGEFILE_CLUSTER_SIZE));
+
+    if (MiPageStoreWorkSpace == NULL) return FALSE;
+
+    KeAcquireGuardedMutex(&MiPageStoreLock);
+
+    /* Whatever we had for these slots is about to be stale, stored or not */
+    MiDropStoredPages(PageFileIndex, PageFileOffset, PageCount);
+
+    /* The run is either kept in memory or written out as a whole */
+    for (i = 0; i < PageCount; i++)
+    {
+        if (MiPageStoreSize + TotalSize >= MiPageStoreLimit) break;
+
+        PageAddress = MiMapPageInHyperSpace(Process, Pages[i], &Irql);
+        Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD,
+                                   PageAddress,
+                                   PAGE_SIZE,
+                                   MiPageStoreBuffer,
+                                   MI_PAGE_STORE_MAX_SIZE,
+                                   PAGE_SIZE,
+                                   &Size,
+                                   MiPageStoreWorkSpace);
+        MiUnmapPageInHyperSpace(Process, PageAddress, Irql);
+
+        /* Too big to fit MI_PAGE_STORE_MAX_SIZE is the usual failure */
+        if (!NT_SUCCESS(Status)) break;
+
+        Entries[i] = ExAllocatePoolWithTag(NonPagedPool,
+                                           FIELD_OFFSET(MI_STORED_PAGE, Data[Size]),
+                                           TAG_MM_PAGE_STORE);
+        if (Entries[i] == NULL) break;
+
+        Entries[i]->PageFileOffset = PageFileOffset + i;
+        Entries[i]->PageFileIndex = (USHORT)PageFileIndex;
+        Entries[i]->Size = (USHORT)Size;
+        RtlCopyMemory(Entries[i]->Data, MiPageStoreBuffer, Size);
+        TotalSize += Size;
+    }
+
+    if (i < PageCount)
+    {
+        while (i--) ExFreePoolWithTag(Entries[i], TAG_MM_PAGE_STORE);
+        KeReleaseGuardedMutex(&MiPageStoreLock);
+        return FALSE;
+    }
+
+    for (i = 0; i < PageCount; i++)
+    {
+        Link = &MiPageStoreHash[MI_PAGE_STORE_HASH(PageFileIndex, PageFileOffset + i)];
+        Entries[i]->Next = *Link;
+        *Link = Entries[i];
+    }
+    MiPageStoreSize += TotalSize;
+    MiPageStoreCount += PageCount;
+
+    KeReleaseGuardedMutex(&MiPageStoreLock);
+    return TRUE;
+}
+
+ULONG
+NTAPI
+MiLoadStoredPages(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount)
+{
+    PMI_STORED_PAGE Entry;
+    PEPROCESS Process = PsGetCurrentProcess();
+    PVOID PageAddress;
+    ULONG i, Size, Loaded = 0;
+    NTSTATUS Status;
+    KIRQL Irql;
+
+    if (MiPageStoreCount == 0) return 0;
+
+    KeAcquireGuardedMutex(&MiPageStoreLock);
+
+    for (i = 0; i < PageCount; i++)
+    {
+        Entry = *MiFindStoredPage(PageFileIndex, PageFileOffset + i);
+        if (Entry == NULL) continue;
+
+        PageAddress = MiMapPageInHyperSpace(Process, Pages[i], &Irql);
+        Status = RtlDecompressBuffer(COMPRESSION_FORMAT_LZNT1,
+                                     PageAddress,
+                                     PAGE_SIZE,
+                                     Entry->Data,
+                                     Entry->Size,
+                                     &Size);
+        MiUnmapPageInHyperSpace(Process, PageAddress, Irql);
+
+        /* We compressed it ourselves, and there's no other copy of it */
+        if (!NT_SUCCESS(Status) || (Size != PAGE_SIZE))
+        {
+            DPRINT1("Stored page %lu:%Iu is corrupt (0x%lx)\n", PageFileIndex, PageFileOffset + i, Status);
+            KeBugCheck(MEMORY_MANAGEMENT);
+        }
+
+        Loaded++;
+    }
+
+    KeReleaseGuardedMutex(&MiPageStoreLock);
+    return Loaded;
+}
+
+VOID
+NTAPI
+MiFreeStoredPage(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    if (MiPageStoreCount == 0) return;
+
+    KeAcquireGuardedMutex(&MiPageStoreLock);
+    MiDropStoredPages(PageFileIndex, PageFileOffset, 1);
+    KeReleaseGuardedMutex(&MiPageStoreLock);
+}
+
+/* EOF */
@@ -23,6 +23,7 @@
 /* GLOBALS ******************************************************************/
 
 static NPAGED_LOOKASIDE_LIST RmapLookasideList;
+static NPAGED_LOOKASIDE_LIST RmapChainLookasideList;
 FAST_MUTEX RmapListLock;
 
 /* FUNCTIONS ****************************************************************/
@@ -50,6 +51,44 @@ MmInitializeRmapList(VOID)
                                      sizeof(MM_RMAP_ENTRY),
                                      TAG_RMAP,
                                      50);
+    ExInitializeNPagedLookasideList (&RmapChainLookasideList,
+                                     NULL,
+                                     RmapListFree,
+                                     0,
+                                     FIELD_OFFSET(MM_RMAP_ENTRY, Slot[RMAP_CHAIN_SLOTS]),
+                                     TAG_RMAP,
+                                     50);
+}
+
+static
+VOID
+MiFreeRmapEntry(PMM_RMAP_ENTRY Entry)
+{
+    if (Entry->SlotCount == 1)
+        ExFreeToNPagedLookasideList(&RmapLookasideList, Entry);
+    else
+        ExFreeToNPagedLookasideList(&RmapChainLookasideList, Entry);
+}
+
+PMM_RMAP_SLOT
+NTAPI
+MiGetFirstRmapSlot(PMM_RMAP_ENTRY Entry, BOOLEAN Segment)
+{
+    ULONG i;
+
+    /* Find the first mapping, either of a process or of a segment */
+    for (; Entry != NULL; Entry = Entry->Next)
+    {
+        for (i = 0; i < Entry->SlotCount; i++)
+        {
+            if (Entry->Slot[i].Address != NULL &&
+                RMAP_IS_SEGMENT(Entry->Slot[i].Address) == Segment)
+            {
+                return &Entry->Slot[i];
+            }
+        }
+    }
+    return NULL;
 }
 
 NTSTATUS
@@ -57,6 +96,7 @@ NTAPI
 MmPageOutPhysicalAddress(PFN_NUMBER Page)
 {
     PMM_RMAP_ENTRY entry;
+    PMM_RMAP_SLOT slot;
     PMEMORY_AREA MemoryArea;
     PMMSUPPORT AddressSpace;
     ULONG Type;
@@ -67,11 +107,12 @@ MmPageOutPhysicalAddress(PFN_NUMBER Page)
 
     ExAcquireFastMutex(&RmapListLock);
     entry = MmGetRmapListHeadPage(Page);
+    slot = MiGetFirstRmapSlot(entry, FALSE);
 
 #ifdef NEWCC
     // Special case for NEWCC: we can have a page that's only in a segment
     // page table
-    if (entry && RMAP_IS_SEGMENT(entry->Address) && entry->Next == NULL)
+    if (slot == NULL && MiGetFirstRmapSlot(entry, TRUE) != NULL)
     {
         /* NEWCC does locking itself */
         ExReleaseFastMutex(&RmapListLock);
@@ -79,18 +120,15 @@ MmPageOutPhysicalAddress(PFN_NUMBER Page)
     }
 #endif
 
-    while (entry && RMAP_IS_SEGMENT(entry->Address))
-        entry = entry->Next;
-
-    if (entry == NULL)
+    if (slot == NULL)
     {
         ExReleaseFastMutex(&RmapListLock);
         return(STATUS_UNSUCCESSFUL);
     }
 
-    Process = entry->Process;
+    Process = slot->Process;
 
-    Address = entry->Address;
+    Address = slot->Address;
 
     if ((((ULONG_PTR)Address) & 0xFFF) != 0)
     {
@@ -195,6 +233,8 @@ NTAPI
 MmSetCleanAllRmaps(PFN_NUMBER Page)
 {
     PMM_RMAP_ENTRY current_entry;
+    PMM_RMAP_SLOT slot;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     current_entry = MmGetRmapListHeadPage(Page);
@@ -205,8 +245,12 @@ MmSetCleanAllRmaps(PFN_NUMBER Page)
     }
     while (current_entry != NULL)
     {
-        if (!RMAP_IS_SEGMENT(current_entry->Address))
-            MmSetCleanPage(current_entry->Process, current_entry->Address);
+        for (i = 0; i < current_entry->SlotCount; i++)
+        {
+            slot = &current_entry->Slot[i];
+            if (slot->Address != NULL && !RMAP_IS_SEGMENT(slot->Address))
+                MmSetCleanPage(slot->Process, slot->Address);
+        }
         current_entry = current_entry->Next;
     }
     ExReleaseFastMutex(&RmapListLock);
@@ -217,6 +261,8 @@ NTAPI
 MmSetDirtyAllRmaps(PFN_NUMBER Page)
 {
     PMM_RMAP_ENTRY current_entry;
+    PMM_RMAP_SLOT slot;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     current_entry = MmGetRmapListHeadPage(Page);
@@ -227,18 +273,72 @@ MmSetDirtyAllRmaps(PFN_NUMBER Page)
     }
     while (current_entry != NULL)
     {
-        if (!RMAP_IS_SEGMENT(current_entry->Address))
-            MmSetDirtyPage(current_entry->Process, current_entry->Address);
+        for (i = 0; i < current_entry->SlotCount; i++)
+        {
+            slot = &current_entry->Slot[i];
+            if (slot->Address != NULL && !RMAP_IS_SEGMENT(slot->Address))
+                MmSetDirtyPage(slot->Process, slot->Address);
+        }
         current_entry = current_entry->Next;
     }
     ExReleaseFastMutex(&RmapListLock);
 }
 
+BOOLEAN
+NTAPI
+MmTestAndClearAccessedAllRmaps(PFN_NUMBER Page,
+                               PBOOLEAN BelowMinimum,
+                               PBOOLEAN AboveMaximum)
+{
+    PMM_RMAP_ENTRY current_entry;
+    PMM_RMAP_SLOT slot;
+    PEPROCESS Process;
+    SIZE_T WorkingSetPages;
+    BOOLEAN Accessed = FALSE;
+    ULONG i;
+
+    *BelowMinimum = FALSE;
+    *AboveMaximum = FALSE;
+
+    ExAcquireFastMutex(&RmapListLock);
+    current_entry = MmGetRmapListHeadPage(Page);
+    while (current_entry != NULL)
+    {
+        for (i = 0; i < current_entry->SlotCount; i++)
+        {
+            slot = &current_entry->Slot[i];
+            if (slot->Address == NULL || RMAP_IS_SEGMENT(slot->Address))
+                continue;
+
+            /* Check every mapping, so that all the accessed bits start over */
+            if (MmTestAndClearAccessedPage(slot->Process, slot->Address))
+                Accessed = TRUE;
+
+            /* Compare the working set of the owner against its quota limits */
+            Process = slot->Process;
+            if (Process != NULL && slot->Address < MmSystemRangeStart)
+            {
+                WorkingSetPages = Process->Vm.WorkingSetSize >> PAGE_SHIFT;
+                if (WorkingSetPages <= Process->Vm.MinimumWorkingSetSize)
+                    *BelowMinimum = TRUE;
+                else if (WorkingSetPages > Process->Vm.MaximumWorkingSetSize)
+                    *AboveMaximum = TRUE;
+            }
+        }
+        current_entry = current_entry->Next;
+    }
+    ExReleaseFastMutex(&RmapListLock);
+
+    return Accessed;
+}
+
 BOOLEAN
 NTAPI
 MmIsDirtyPageRmap(PFN_NUMBER Page)
 {
     PMM_RMAP_ENTRY current_entry;
+    PMM_RMAP_SLOT slot;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     current_entry = MmGetRmapListHeadPage(Page);
@@ -249,12 +349,16 @@ MmIsDirtyPageRmap(PFN_NUMBER Page)
     }
     while (current_entry != NULL)
     {
-        if (
-            !RMAP_IS_SEGMENT(current_entry->Address) &&
-            MmIsDirtyPage(current_entry->Process, current_entry->Address))
+        for (i = 0; i < current_entry->SlotCount; i++)
         {
-            ExReleaseFastMutex(&RmapListLock);
-            return(TRUE);
+            slot = &current_entry->Slot[i];
+            if (slot->Address != NULL &&
+                !RMAP_IS_SEGMENT(slot->Address) &&
+                MmIsDirtyPage(slot->Process, slot->Address))
+            {
+                ExReleaseFastMutex(&RmapListLock);
+                return(TRUE);
+            }
         }
         current_entry = current_entry->Next;
     }
@@ -269,24 +373,19 @@ MmInsertRmap(PFN_NUMBER Page, PEPROCESS Process,
 {
     PMM_RMAP_ENTRY current_entry;
     PMM_RMAP_ENTRY new_entry;
+    PMM_RMAP_SLOT slot = NULL;
     ULONG PrevSize;
-    if (!RMAP_IS_SEGMENT(Address))
-        Address = (PVOID)PAGE_ROUND_DOWN(Address);
-
-    new_entry = ExAllocateFromNPagedLookasideList(&RmapLookasideList);
-    if (new_entry == NULL)
-    {
-        KeBugCheck(MEMORY_MANAGEMENT);
-    }
-    new_entry->Address = Address;
-    new_entry->Process = (PEPROCESS)Process;
+    ULONG i;
 #if DBG
+    PVOID Caller;
 #ifdef __GNUC__
-    new_entry->Caller = __builtin_return_address(0);
+    Caller = __builtin_return_address(0);
 #else
-    new_entry->Caller = _ReturnAddress();
+    Caller = _ReturnAddress();
 #endif
 #endif
+    if (!RMAP_IS_SEGMENT(Address))
+        Address = (PVOID)PAGE_ROUND_DOWN(Address);
 
     if (
         !RMAP_IS_SEGMENT(Address) &&
@@ -302,24 +401,84 @@ MmInsertRmap(PFN_NUMBER Page, PEPROCESS Process,
 
     ExAcquireFastMutex(&RmapListLock);
     current_entry = MmGetRmapListHeadPage(Page);
-    new_entry->Next = current_entry;
 #if DBG
-    while (current_entry)
+    for (new_entry = current_entry; new_entry != NULL; new_entry = new_entry->Next)
     {
-        if (current_entry->Address == new_entry->Address && current_entry->Process == new_entry->Process)
+        for (i = 0; i < new_entry->SlotCount; i++)
+        {
+            if (new_entry->Slot[i].Address == Address && new_entry->Slot[i].Process == Process)
+            {
+                DbgPrint("MmInsertRmap tries to add a second rmap entry for address %p\n    current caller ",
+                         Address);
+                DbgPrint("%p", Caller);
+                DbgPrint("\n    previous caller ");
+                DbgPrint("%p", new_entry->Slot[i].Caller);
+                DbgPrint("\n");
+                KeBugCheck(MEMORY_MANAGEMENT);
+            }
+        }
+    }
+#endif
+
+    if (current_entry == NULL)
+    {
+        /* Most pages are mapped only once, keep these small */
+        new_entry = ExAllocateFromNPagedLookasideList(&RmapLookasideList);
+        if (new_entry == NULL)
         {
-            DbgPrint("MmInsertRmap tries to add a second rmap entry for address %p\n    current caller ",
-                     current_entry->Address);
-            DbgPrint("%p", new_entry->Caller);
-            DbgPrint("\n    previous caller ");
-            DbgPrint("%p", current_entry->Caller);
-            DbgPrint("\n");
             KeBugCheck(MEMORY_MANAGEMENT);
         }
-        current_entry = current_entry->Next;
+        new_entry->Next = NULL;
+        new_entry->SlotCount = 1;
+        slot = &new_entry->Slot[0];
+        MmSetRmapListHeadPage(Page, new_entry);
     }
+    else
+    {
+        /* Reuse a free slot of the chain, if there's one */
+        for (new_entry = current_entry; new_entry != NULL && slot == NULL; new_entry = new_entry->Next)
+        {
+            for (i = 0; i < new_entry->SlotCount; i++)
+            {
+                if (new_entry->Slot[i].Address == NULL)
+                {
+                    slot = &new_entry->Slot[i];
+                    break;
+                }
+            }
+        }
+
+        if (slot == NULL)
+        {
+            new_entry = ExAllocateFromNPagedLookasideList(&RmapChainLookasideList);
+            if (new_entry == NULL)
+            {
+                KeBugCheck(MEMORY_MANAGEMENT);
+            }
+            new_entry->SlotCount = RMAP_CHAIN_SLOTS;
+            RtlZeroMemory(new_entry->Slot, RMAP_CHAIN_SLOTS * sizeof(MM_RMAP_SLOT));
+            slot = &new_entry->Slot[0];
+
+            /* A page mapped once has a single small entry: fold it into the chain */
+            if (current_entry->SlotCount == 1)
+            {
+                new_entry->Slot[1] = current_entry->Slot[0];
+                new_entry->Next = current_entry->Next;
+                MiFreeRmapEntry(current_entry);
+            }
+            else
+            {
+                new_entry->Next = current_entry;
+            }
+            MmSetRmapListHeadPage(Page, new_entry);
+        }
+    }
+
+    slot->Address = Address;
+    slot->Process = (PEPROCESS)Process;
+#if DBG
+    slot->Caller = Caller;
 #endif
-    MmSetRmapListHeadPage(Page, new_entry);
     ExReleaseFastMutex(&RmapListLock);
     if (!RMAP_IS_SEGMENT(Address))
     {
@@ -346,7 +505,9 @@ MmDeleteAllRmaps(PFN_NUMBER Page, PVOID Context,
 {
     PMM_RMAP_ENTRY current_entry;
     PMM_RMAP_ENTRY previous_entry;
+    PMM_RMAP_SLOT slot;
     PEPROCESS Process;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     current_entry = MmGetRmapListHeadPage(Page);
@@ -362,15 +523,17 @@ MmDeleteAllRmaps(PFN_NUMBER Page, PVOID Context,
     {
         previous_entry = current_entry;
         current_entry = current_entry->Next;
-        if (!RMAP_IS_SEGMENT(previous_entry->Address))
+        for (i = 0; i < previous_entry->SlotCount; i++)
         {
+            slot = &previous_entry->Slot[i];
+            if (slot->Address == NULL || RMAP_IS_SEGMENT(slot->Address))
+                continue;
+
             if (DeleteMapping)
             {
-                DeleteMapping(Context, previous_entry->Process,
-                              previous_entry->Address);
+                DeleteMapping(Context, slot->Process, slot->Address);
             }
-            Process = previous_entry->Process;
-            ExFreeToNPagedLookasideList(&RmapLookasideList, previous_entry);
+            Process = slot->Process;
             if (Process == NULL)
             {
                 Process = PsInitialSystemProcess;
@@ -380,11 +543,39 @@ MmDeleteAllRmaps(PFN_NUMBER Page, PVOID Context,
                 (void)InterlockedExchangeAddUL(&Process->Vm.WorkingSetSize, -PAGE_SIZE);
             }
         }
-        else
-        {
-            ExFreeToNPagedLookasideList(&RmapLookasideList, previous_entry);
-        }
+        MiFreeRmapEntry(previous_entry);
+    }
+}
+
+static
+BOOLEAN
+MiRemoveRmapSlot(PFN_NUMBER Page, PMM_RMAP_ENTRY Entry, PMM_RMAP_ENTRY PreviousEntry, PMM_RMAP_SLOT Slot)
+/*
+ * FUNCTION: Clear a slot of the rmap chain of a page, unlinking its entry
+ * when that was the last mapping it held. The rmap list lock must be held.
+ * RETURNS: TRUE if the entry must be freed once the lock is released.
+ */
+{
+    ULONG i;
+
+    Slot->Address = NULL;
+    Slot->Process = NULL;
+
+    for (i = 0; i < Entry->SlotCount; i++)
+    {
+        if (Entry->Slot[i].Address != NULL)
+            return FALSE;
     }
+
+    if (PreviousEntry == NULL)
+    {
+        MmSetRmapListHeadPage(Page, Entry->Next);
+    }
+    else
+    {
+        PreviousEntry->Next = Entry->Next;
+    }
+    return TRUE;
 }
 
 VOID
@@ -393,6 +584,8 @@ MmDeleteRmap(PFN_NUMBER Page, PEPROCESS Process,
              PVOID Address)
 {
     PMM_RMAP_ENTRY current_entry, previous_entry;
+    BOOLEAN FreeEntry;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     previous_entry = NULL;
@@ -400,31 +593,30 @@ MmDeleteRmap(PFN_NUMBER Page, PEPROCESS Process,
 
     while (current_entry != NULL)
     {
-        if (current_entry->Process == (PEPROCESS)Process &&
-                current_entry->Address == Address)
+        for (i = 0; i < current_entry->SlotCount; i++)
         {
-            if (previous_entry == NULL)
-            {
-                MmSetRmapListHeadPage(Page, current_entry->Next);
-            }
-            else
+            if (current_entry->Slot[i].Process == (PEPROCESS)Process &&
+                    current_entry->Slot[i].Address == Address)
             {
-                previous_entry->Next = current_entry->Next;
-            }
-            ExReleaseFastMutex(&RmapListLock);
-            ExFreeToNPagedLookasideList(&RmapLookasideList, current_entry);
-            if (!RMAP_IS_SEGMENT(Address))
-            {
-                if (Process == NULL)
+                FreeEntry = MiRemoveRmapSlot(Page, current_entry, previous_entry, &current_entry->Slot[i]);
+                ExReleaseFastMutex(&RmapListLock);
+                if (FreeEntry)
                 {
-                    Process = PsInitialSystemProcess;
+                    MiFreeRmapEntry(current_entry);
                 }
-                if (Process)
+                if (!RMAP_IS_SEGMENT(Address))
                 {
-                    (void)InterlockedExchangeAddUL(&Process->Vm.WorkingSetSize, -PAGE_SIZE);
+                    if (Process == NULL)
+                    {
+                        Process = PsInitialSystemProcess;
+                    }
+                    if (Process)
+                    {
+                        (void)InterlockedExchangeAddUL(&Process->Vm.WorkingSetSize, -PAGE_SIZE);
+                    }
                 }
+                return;
             }
-            return;
         }
         previous_entry = current_entry;
         current_entry = current_entry->Next;
@@ -451,26 +643,18 @@ NTAPI
 MmGetSegmentRmap(PFN_NUMBER Page, PULONG RawOffset)
 {
     PCACHE_SECTION_PAGE_TABLE Result = NULL;
-    PMM_RMAP_ENTRY current_entry;//, previous_entry;
+    PMM_RMAP_SLOT slot;
 
     ExAcquireFastMutex(&RmapListLock);
-    //previous_entry = NULL;
-    current_entry = MmGetRmapListHeadPage(Page);
-    while (current_entry != NULL)
+    slot = MiGetFirstRmapSlot(MmGetRmapListHeadPage(Page), TRUE);
+    if (slot != NULL)
     {
-        if (RMAP_IS_SEGMENT(current_entry->Address))
-        {
-            Result = (PCACHE_SECTION_PAGE_TABLE)current_entry->Process;
-            *RawOffset = (ULONG_PTR)current_entry->Address & ~RMAP_SEGMENT_MASK;
-            InterlockedIncrementUL(&Result->Segment->ReferenceCount);
-            ExReleaseFastMutex(&RmapListLock);
-            return Result;
-        }
-        //previous_entry = current_entry;
-        current_entry = current_entry->Next;
+        Result = (PCACHE_SECTION_PAGE_TABLE)slot->Process;
+        *RawOffset = (ULONG_PTR)slot->Address & ~RMAP_SEGMENT_MASK;
+        InterlockedIncrementUL(&Result->Segment->ReferenceCount);
     }
     ExReleaseFastMutex(&RmapListLock);
-    return NULL;
+    return Result;
 }
 
 /*
@@ -484,25 +668,27 @@ NTAPI
 MmDeleteSectionAssociation(PFN_NUMBER Page)
 {
     PMM_RMAP_ENTRY current_entry, previous_entry;
+    ULONG i;
 
     ExAcquireFastMutex(&RmapListLock);
     previous_entry = NULL;
     current_entry = MmGetRmapListHeadPage(Page);
     while (current_entry != NULL)
     {
-        if (RMAP_IS_SEGMENT(current_entry->Address))
+        for (i = 0; i < current_entry->SlotCount; i++)
         {
-            if (previous_entry == NULL)
-            {
-                MmSetRmapListHeadPage(Page, current_entry->Next);
-            }
-            else
+            if (current_entry->Slot[i].Address != NULL &&
+                RMAP_IS_SEGMENT(current_entry->Slot[i].Address))
             {
-                previous_entry->Next = current_entry->Next;
+                if (MiRemoveRmapSlot(Page, current_entry, previous_entry, &current_entry->Slot[i]))
+                {
+                    ExReleaseFastMutex(&RmapListLock);
+                    MiFreeRmapEntry(current_entry);
+                    return;
+                }
+                ExReleaseFastMutex(&RmapListLock);
+                return;
             }
-            ExReleaseFastMutex(&RmapListLock);
-            ExFreeToNPagedLookasideList(&RmapLookasideList, current_entry);
-            return;
         }
         previous_entry = current_entry;
         current_entry = current_entry->Next;
@@ -1278,6 +1278,178 @@ MiReadPage(PMEMORY_AREA MemoryArea,
 }
 #endif
 
+/* Resident section pages mapped around a faulting address */
+#define MI_SECTION_FAULT_AROUND 16
+
+/* Section pages read ahead of a faulting address, when access looks sequential */
+#define MI_SECTION_READ_AHEAD 8
+
+static
+VOID
+MiMapResidentSectionPages(PEPROCESS Process,
+                          PMEMORY_AREA MemoryArea,
+                          PVOID RegionBase,
+                          PMM_REGION Region,
+                          PVOID PAddress,
+                          ULONG Attributes)
+/*
+ * FUNCTION: Map the pages of the section segment that are already in memory,
+ * around a page that was just faulted in, so that touching them doesn't
+ * fault again. The segment and the address space must be locked.
+ */
+{
+    PMM_SECTION_SEGMENT Segment = MemoryArea->Data.SectionData.Segment;
+    ULONG_PTR Start, End, Current;
+    LARGE_INTEGER Offset;
+    ULONG_PTR Entry;
+    PFN_NUMBER Page;
+    NTSTATUS Status;
+
+    /* Stay within the aligned window around the fault, and within its region */
+    Start = (ULONG_PTR)PAddress & ~((MI_SECTION_FAULT_AROUND * PAGE_SIZE) - 1);
+    End = Start + MI_SECTION_FAULT_AROUND * PAGE_SIZE;
+    Start = max(Start, (ULONG_PTR)RegionBase);
+    End = min(End, (ULONG_PTR)RegionBase + Region->Length);
+
+    for (Current = Start; Current < End; Current += PAGE_SIZE)
+    {
+        if (Current == (ULONG_PTR)PAddress ||
+            MmIsPagePresent(Process, (PVOID)Current) ||
+            MmIsPageSwapEntry(Process, (PVOID)Current) ||
+            MmIsDisabledPage(Process, (PVOID)Current))
+        {
+            continue;
+        }
+
+        Offset.QuadPart = Current - MA_GetStartingAddress(MemoryArea)
+                          + MemoryArea->Data.SectionData.ViewOffset.QuadPart;
+        if (Offset.QuadPart >= Segment->Length.QuadPart)
+        {
+            break;
+        }
+
+        Entry = MmGetPageEntrySectionSegment(Segment, &Offset);
+        if (Entry == 0 || IS_SWAP_FROM_SSE(Entry) ||
+            SHARE_COUNT_FROM_SSE(Entry) == MAX_SHARE_COUNT)
+        {
+            continue;
+        }
+
+        Page = PFN_FROM_SSE(Entry);
+        Status = MmCreateVirtualMapping(Process,
+                                        (PVOID)Current,
+                                        Attributes,
+                                        &Page,
+                                        1);
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
+        MmInsertRmap(Page, Process, (PVOID)Current);
+        MmSharePageEntrySectionSegment(Segment, &Offset);
+    }
+}
+
+static
+ULONG
+MiClaimSectionReadAhead(PEPROCESS Process,
+                        PMEMORY_AREA MemoryArea,
+                        PVOID RegionBase,
+                        PMM_REGION Region,
+                        PVOID PAddress)
+/*
+ * FUNCTION: Find the pages following a faulting address that can be read
+ * from the file along with it, and mark them as being read in. The segment
+ * and the address space must be locked.
+ * RETURNS: The number of pages claimed.
+ */
+{
+    PMM_SECTION_SEGMENT Segment = MemoryArea->Data.SectionData.Segment;
+    PROS_SECTION_OBJECT Section = MemoryArea->Data.SectionData.Section;
+    ULONG_PTR Current;
+    LARGE_INTEGER Offset;
+    ULONG Count;
+
+    for (Count = 0; Count < MI_SECTION_READ_AHEAD; Count++)
+    {
+        Current = (ULONG_PTR)PAddress + (Count + 1) * PAGE_SIZE;
+        if (Current >= (ULONG_PTR)RegionBase + Region->Length ||
+            MmIsPagePresent(Process, (PVOID)Current) ||
+            MmIsPageSwapEntry(Process, (PVOID)Current) ||
+            MmIsDisabledPage(Process, (PVOID)Current))
+        {
+            break;
+        }
+
+        Offset.QuadPart = Current - MA_GetStartingAddress(MemoryArea)
+                          + MemoryArea->Data.SectionData.ViewOffset.QuadPart;
+        if (Offset.QuadPart >= Segment->Length.QuadPart ||
+            ((Section->AllocationAttributes & SEC_IMAGE) &&
+             Offset.QuadPart >= (LONGLONG)PAGE_ROUND_UP(Segment->RawLength.QuadPart)))
+        {
+            break;
+        }
+
+        if (MmGetPageEntrySectionSegment(Segment, &Offset) != 0)
+        {
+            break;
+        }
+
+        MmSetPageEntrySectionSegment(Segment, &Offset, MAKE_SWAP_SSE(MM_WAIT_ENTRY));
+        MmCreatePageFileMapping(Process, (PVOID)Current, MM_WAIT_ENTRY);
+    }
+
+    return Count;
+}
+
+static
+VOID
+MiFinishSectionReadAhead(PEPROCESS Process,
+                         PMEMORY_AREA MemoryArea,
+                         PVOID PAddress,
+                         ULONG Attributes,
+                         PPFN_NUMBER Pages,
+                         ULONG Count)
+/*
+ * FUNCTION: Map the pages read ahead by a fault, or drop the claim on those
+ * that couldn't be read. The segment and the address space must be locked.
+ */
+{
+    PMM_SECTION_SEGMENT Segment = MemoryArea->Data.SectionData.Segment;
+    SWAPENTRY FakeSwapEntry;
+    PVOID Current;
+    LARGE_INTEGER Offset;
+    NTSTATUS Status;
+    ULONG i;
+
+    for (i = 0; i < Count; i++)
+    {
+        Current = (PVOID)((ULONG_PTR)PAddress + (i + 1) * PAGE_SIZE);
+        Offset.QuadPart = (ULONG_PTR)Current - MA_GetStartingAddress(MemoryArea)
+                          + MemoryArea->Data.SectionData.ViewOffset.QuadPart;
+
+        MmDeletePageFileMapping(Process, Current, &FakeSwapEntry);
+        if (Pages[i] == 0)
+        {
+            MmSetPageEntrySectionSegment(Segment, &Offset, 0);
+            continue;
+        }
+
+        Status = MmCreateVirtualMapping(Process,
+                                        Current,
+                                        Attributes,
+                                        &Pages[i],
+                                        1);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Unable to create virtual mapping\n");
+            KeBugCheck(MEMORY_MANAGEMENT);
+        }
+        MmInsertRmap(Pages[i], Process, Current);
+        MmSetPageEntrySectionSegment(Segment, &Offset, MAKE_SSE(Pages[i] << PAGE_SHIFT, 1));
+    }
+}
+
 static VOID
 MmAlterViewAttributes(PMMSUPPORT AddressSpace,
                       PVOID BaseAddress,
@@ -1377,6 +1549,7 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
     PMM_REGION Region;
     BOOLEAN HasSwapEntry;
     PVOID PAddress;
+    PVOID RegionBase;
     PEPROCESS Process = MmGetAddressSpaceOwner(AddressSpace);
     SWAPENTRY SwapEntry;
 
@@ -1411,7 +1584,7 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
     Section = MemoryArea->Data.SectionData.Section;
     Region = MmFindRegion((PVOID)MA_GetStartingAddress(MemoryArea),
                           &MemoryArea->Data.SectionData.RegionListHead,
-                          Address, NULL);
+                          Address, &RegionBase);
     ASSERT(Region != NULL);
 
     /* Check for a NOACCESS mapping */
@@ -1602,23 +1775,40 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
     if (Entry == 0)
     {
         SWAPENTRY FakeSwapEntry;
+        PFN_NUMBER ReadAheadPages[MI_SECTION_READ_AHEAD];
+        ULONG ReadAhead = 0;
+        ULONG i;
+        BOOLEAN ReadFile;
 
         /*
          * If the entry is zero (and it can't change because we have
          * locked the segment) then we need to load the page.
          */
+        ReadFile = !(Segment->Flags & MM_PAGEFILE_SEGMENT) &&
+                   !(Offset.QuadPart >= (LONGLONG)PAGE_ROUND_UP(Segment->RawLength.QuadPart) &&
+                     (Section->AllocationAttributes & SEC_IMAGE));
 
         /*
          * Release all our locks and read in the page from disk
          */
         MmSetPageEntrySectionSegment(Segment, &Offset, MAKE_SWAP_SSE(MM_WAIT_ENTRY));
+
+        /*
+         * If the previous page of the view is in, this looks like a sequential
+         * access: read the following pages along with this one.
+         */
+        if (ReadFile &&
+            (ULONG_PTR)PAddress > MA_GetStartingAddress(MemoryArea) &&
+            MmIsPagePresent(Process, (PVOID)((ULONG_PTR)PAddress - PAGE_SIZE)))
+        {
+            ReadAhead = MiClaimSectionReadAhead(Process, MemoryArea, RegionBase, Region, PAddress);
+        }
+
         MmUnlockSectionSegment(Segment);
         MmCreatePageFileMapping(Process, PAddress, MM_WAIT_ENTRY);
         MmUnlockAddressSpace(AddressSpace);
 
-        if ((Segment->Flags & MM_PAGEFILE_SEGMENT) ||
-                ((Offset.QuadPart >= (LONGLONG)PAGE_ROUND_UP(Segment->RawLength.QuadPart) &&
-                  (Section->AllocationAttributes & SEC_IMAGE))))
+        if (!ReadFile)
         {
             MI_SET_USAGE(MI_USAGE_SECTION);
             if (Process) MI_SET_PROCESS2(Process->ImageFileName);
@@ -1638,6 +1828,23 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
                 DPRINT1("MiReadPage failed (Status %x)\n", Status);
             }
         }
+
+        /*
+         * The pages read ahead come from the same cache view as this one,
+         * so they don't cost another trip to the file system
+         */
+        for (i = 0; i < ReadAhead; i++)
+        {
+            ReadAheadPages[i] = 0;
+            if (NT_SUCCESS(Status) &&
+                !NT_SUCCESS(MiReadPage(MemoryArea,
+                                       Offset.QuadPart + (i + 1) * PAGE_SIZE,
+                                       &ReadAheadPages[i])))
+            {
+                ReadAheadPages[i] = 0;
+            }
+        }
+
         if (!NT_SUCCESS(Status))
         {
             /*
@@ -1647,6 +1854,13 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
              * Cleanup and release locks
              */
             MmLockAddressSpace(AddressSpace);
+            if (ReadAhead)
+            {
+                MmLockSectionSegment(Segment);
+                MiFinishSectionReadAhead(Process, MemoryArea, PAddress, Attributes,
+                                         ReadAheadPages, ReadAhead);
+                MmUnlockSectionSegment(Segment);
+            }
             MiSetPageEvent(Process, Address);
             DPRINT("Address 0x%p\n", Address);
             return(Status);
@@ -1675,6 +1889,10 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
         /* Set this section offset has being backed by our new page. */
         Entry = MAKE_SSE(Page << PAGE_SHIFT, 1);
         MmSetPageEntrySectionSegment(Segment, &Offset, Entry);
+
+        MiFinishSectionReadAhead(Process, MemoryArea, PAddress, Attributes,
+                                 ReadAheadPages, ReadAhead);
+        MiMapResidentSectionPages(Process, MemoryArea, RegionBase, Region, PAddress, Attributes);
         MmUnlockSectionSegment(Segment);
 
         MiSetPageEvent(Process, Address);
@@ -1784,6 +2002,8 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
 
         /* Take a reference on it */
         MmSharePageEntrySectionSegment(Segment, &Offset);
+
+        MiMapResidentSectionPages(Process, MemoryArea, RegionBase, Region, PAddress, Attributes);
         MmUnlockSectionSegment(Segment);
 
         MiSetPageEvent(Process, Address);
@@ -73,6 +73,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/dbgk/dbgkobj.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/dbgk/dbgkutil.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/atom.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/bootperf.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/callback.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/dbgctrl.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ex/efi.c
@@ -167,6 +168,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/config.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/devqueue.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/dpc.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/dpcstat.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/eventobj.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/except.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/freeze.c
@@ -174,6 +176,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/gmutex.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/ipi.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/krnlinit.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/lockstat.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/mutex.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/procobj.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/ke/profobj.c
@@ -224,6 +227,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/mmfault.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/mminit.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/pagefile.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/pagestore.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/region.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/rmap.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/mm/section.c
@@ -271,6 +275,7 @@ list(APPEND SOURCE
     ${REACTOS_SOURCE_DIR}/ntoskrnl/se/token.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/vf/driver.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/guidobj.c
+    ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/kernlog.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/smbios.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/wmi.c
     ${REACTOS_SOURCE_DIR}/ntoskrnl/wmi/wmidrv.c)
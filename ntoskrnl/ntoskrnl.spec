@@ -123,6 +123,7 @@
 @ stdcall -arch=x86_64,arm ExQueryDepthSList(ptr) RtlQueryDepthSList
 @ stdcall ExQueryPoolBlockSize(ptr ptr)
 @ stdcall ExQueueWorkItem(ptr long)
+@ stdcall ExQueueWorkItemEx(ptr long long)
 @ stdcall ExRaiseAccessViolation()
 @ stdcall ExRaiseDatatypeMisalignment()
 @ stdcall ExRaiseException(ptr) RtlRaiseException
@@ -686,6 +687,7 @@
 @ extern KeServiceDescriptorTable
 @ stdcall KeSetAffinityThread(ptr long)
 @ stdcall KeSetBasePriorityThread(ptr long)
+@ stdcall KeSetCoalescableTimer(ptr long long long long ptr)
 @ stdcall KeSetDmaIoCoherency(long)
 @ stdcall KeSetEvent(ptr long long)
 @ stdcall KeSetEventBoostPriority(ptr ptr)
@@ -1226,6 +1228,7 @@
 @ stdcall RtlLookupElementGenericTableAvl(ptr ptr)
 @ stdcall RtlLookupElementGenericTableFull(ptr ptr ptr ptr)
 @ stdcall RtlLookupElementGenericTableFullAvl(ptr ptr ptr ptr)
+@ stdcall RtlLookupElementGenericTableWithoutSplaying(ptr ptr)
 @ cdecl -arch=x86_64 RtlLookupFunctionEntry(double ptr ptr)
 @ stdcall RtlMapGenericMask(ptr ptr)
 @ stdcall RtlMapSecurityErrorToNtStatus(long)
@@ -19,6 +19,9 @@
 
 POBJECT_TYPE ObpDirectoryObjectType = NULL;
 
+/* Changes whenever a name that symbolic links can be bound through goes away */
+ULONG ObpNamespaceGeneration;
+
 /* PRIVATE FUNCTIONS ******************************************************/
 
 /*++
@@ -367,6 +370,19 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     *AllocatedEntry = CurrentEntry->ChainLink;
     CurrentEntry->ChainLink = NULL;
 
+    /*
+     * Symbolic links are never bound through the DOS devices directories,
+     * anything else that could be on the path to a bound object makes the
+     * bindings stale.
+     */
+    if (!(Directory->DeviceMap) &&
+        ((OBJECT_TO_OBJECT_HEADER(CurrentEntry->Object)->Type == ObpDirectoryObjectType) ||
+         (OBJECT_TO_OBJECT_HEADER(CurrentEntry->Object)->Type == ObpSymbolicLinkObjectType) ||
+         (OBJECT_TO_OBJECT_HEADER(CurrentEntry->Object)->Type == IoDeviceObjectType)))
+    {
+        InterlockedIncrement((PLONG)&ObpNamespaceGeneration);
+    }
+
     /* Free it */
     ExFreePoolWithTag(CurrentEntry, OB_DIR_TAG);
 
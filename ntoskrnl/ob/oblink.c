@@ -32,7 +32,8 @@ ObpProcessDosDeviceSymbolicLink(IN POBJECT_SYMBOLIC_LINK SymbolicLink,
     ULONG DriveType;
     POBJECT_HEADER ObjectHeader;
     POBJECT_HEADER_NAME_INFO ObjectNameInfo;
-    BOOLEAN DirectoryLocked;
+    BOOLEAN DirectoryLocked, Bindable;
+    ULONG Generation;
     PVOID Object;
 
     /*
@@ -41,6 +42,9 @@ ObpProcessDosDeviceSymbolicLink(IN POBJECT_SYMBOLIC_LINK SymbolicLink,
      */
     MaxReparse = 32;
     NameDirectory = NULL;
+    Object = NULL;
+    Bindable = FALSE;
+    Generation = 0;
 
     /* Get header data */
     ObjectHeader = OBJECT_TO_OBJECT_HEADER(SymbolicLink);
@@ -67,6 +71,10 @@ ObpProcessDosDeviceSymbolicLink(IN POBJECT_SYMBOLIC_LINK SymbolicLink,
         /* Keep track of our progress while parsing the name */
         LocalTarget = SymbolicLink->LinkTarget;
 
+        /* Anything removed while we walk the target makes the binding stale */
+        Generation = ObpNamespaceGeneration;
+        Bindable = TRUE;
+
         /* If LUID mappings are enabled, use system map */
         if (ObpLUIDDeviceMapsEnabled != 0)
         {
@@ -182,6 +190,12 @@ ReparseTargetPath:
                 break;
             }
 
+            /* What's found through a device map depends on who is looking */
+            if (DirectoryObject->DeviceMap != NULL)
+            {
+                Bindable = FALSE;
+            }
+
             /* If we don't have a directory object, we'll have to handle the object */
             if (OBJECT_TO_OBJECT_HEADER(Object)->Type != ObpDirectoryObjectType)
             {
@@ -201,6 +215,12 @@ ReparseTargetPath:
 
                 --MaxReparse;
 
+                /* The rest of our target is dropped, so don't bind to what we find */
+                if (LocalTarget.Length != 0)
+                {
+                    Bindable = FALSE;
+                }
+
                 /* Symlink points to another initialized symlink, ask caller to reparse */
                 DirectoryObject = ObpRootDirectoryObject;
 
@@ -301,6 +321,20 @@ ReparseTargetPath:
             }
         }
 
+        /*
+         * If the whole target names a device, bind the link to it: opening
+         * names through the link then goes straight to the device, instead
+         * of parsing the target again from the root every time.
+         */
+        if (Object != NULL && Bindable && LocalTarget.Length == 0 &&
+            SymbolicLink->LinkTargetObject == NULL &&
+            OBJECT_TO_OBJECT_HEADER(Object)->Type == IoDeviceObjectType)
+        {
+            ObReferenceObject(Object);
+            SymbolicLink->LinkTargetGeneration = Generation;
+            SymbolicLink->LinkTargetObject = Object;
+        }
+
         /* Add a new drive entry */
         if (DeviceMap != NULL)
         {
@@ -479,8 +513,15 @@ ObpParseSymbolicLink(IN PVOID ParsedObject,
         return STATUS_OBJECT_TYPE_MISMATCH;
     }
 
-    /* Check if this symlink is bound to a specific object */
-    if (SymlinkObject->LinkTargetObject)
+    /*
+     * Check if this symlink is bound to a specific object. Don't use the
+     * binding when something on the way to it went away, or when the
+     * caller would need traverse checks on the directories we skip.
+     */
+    if ((SymlinkObject->LinkTargetObject) &&
+        (SymlinkObject->LinkTargetGeneration == ObpNamespaceGeneration) &&
+        ((AccessMode == KernelMode) ||
+         (AccessState->Flags & TOKEN_HAS_TRAVERSE_PRIVILEGE)))
     {
         /* No name to reparse, directly reparse the object */
         if (!SymlinkObject->LinkTargetRemaining.Length)
@@ -776,6 +817,7 @@ NtCreateSymbolicLinkObject(OUT PHANDLE LinkHandle,
 
         /* Initialize the remaining name, dos drive index and target object */
         SymbolicLink->LinkTargetObject = NULL;
+        SymbolicLink->LinkTargetGeneration = 0;
         SymbolicLink->DosDeviceDriveIndex = 0;
         RtlInitUnicodeString(&SymbolicLink->LinkTargetRemaining, NULL);
 
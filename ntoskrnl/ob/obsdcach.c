@@ -74,14 +74,14 @@ ObpInitSdCache(VOID)
     return STATUS_SUCCESS;
 }
 
-ULONG
+ULONGLONG
 NTAPI
 ObpHash(IN PVOID Buffer,
         IN ULONG Length)
 {
     PULONG p, pp;
     PUCHAR pb, ppb;
-    ULONG Hash = 0;
+    ULONGLONG Hash = 0xCBF29CE484222325ULL ^ Length;
 
     /* Setup aligned and byte buffers */
     p = Buffer;
@@ -92,25 +92,34 @@ ObpHash(IN PVOID Buffer,
     /* Loop aligned data */
     while (p < pp)
     {
-        /* XOR-rotate */
+        /* XOR-rotate-multiply */
         Hash ^= *p++;
-        Hash = _rotl(Hash, 3);
+        Hash = _rotl64(Hash, 29) * 0x100000001B3ULL;
     }
 
     /* Loop non-aligned data */
     pb = (PUCHAR)p;
     while (pb < ppb)
     {
-        /* XOR-rotate */
+        /* XOR-rotate-multiply */
         Hash ^= *pb++;
-        Hash = _rotl(Hash, 3);
+        Hash = _rotl64(Hash, 29) * 0x100000001B3ULL;
     }
 
+    /*
+     * Mix the high bits back in. Descriptors that only differ by a SID
+     * mostly differ in the last words, and the bucket is picked from the
+     * low bits.
+     */
+    Hash ^= Hash >> 33;
+    Hash *= 0xFF51AFD7ED558CCDULL;
+    Hash ^= Hash >> 33;
+
     /* Return the hash */
     return Hash;
 }
 
-ULONG
+ULONGLONG
 NTAPI
 ObpHashSecurityDescriptor(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
                           IN ULONG Length)
@@ -123,7 +132,7 @@ PSECURITY_DESCRIPTOR_HEADER
 NTAPI
 ObpCreateCacheEntry(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
                     IN ULONG Length,
-                    IN ULONG FullHash,
+                    IN ULONGLONG FullHash,
                     IN ULONG RefCount)
 {
     ULONG CacheSize;
@@ -137,6 +146,7 @@ ObpCreateCacheEntry(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
     
     /* Setup the header */
     SdHeader->RefCount = RefCount;
+    SdHeader->Length = Length;
     SdHeader->FullHash = FullHash;
     
     /* Copy the descriptor */
@@ -150,19 +160,16 @@ BOOLEAN
 NTAPI
 ObpCompareSecurityDescriptors(IN PSECURITY_DESCRIPTOR Sd1,
                               IN ULONG Length1,
-                              IN PSECURITY_DESCRIPTOR Sd2)
+                              IN PSECURITY_DESCRIPTOR_HEADER SdHeader)
 {
-    ULONG Length2;
     ASSERT(Length1 == RtlLengthSecurityDescriptor(Sd1));
-    
-    /* Get the length of the second SD */
-    Length2 = RtlLengthSecurityDescriptor(Sd2);
-    
-    /* Compare lengths */
-    if (Length1 != Length2) return FALSE;
+    ASSERT(SdHeader->Length == RtlLengthSecurityDescriptor(&SdHeader->SecurityDescriptor));
+
+    /* Compare lengths, the cached one was computed when the entry was created */
+    if (Length1 != SdHeader->Length) return FALSE;
     
     /* Compare contents */
-    return RtlEqualMemory(Sd1, Sd2, Length1);
+    return RtlEqualMemory(Sd1, &SdHeader->SecurityDescriptor, Length1);
 }
 
 PVOID
@@ -312,7 +319,7 @@ ObDereferenceSecurityDescriptor(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
     }
     
     /* At this point, we need the lock, so choose an entry */
-    Index = SdHeader->FullHash % SD_CACHE_ENTRIES;
+    Index = (ULONG)(SdHeader->FullHash % SD_CACHE_ENTRIES);
     CacheEntry = &ObsSecurityDescriptorCache[Index];
     
     /* Acquire the lock for it */
@@ -366,7 +373,8 @@ ObLogSecurityDescriptor(IN PSECURITY_DESCRIPTOR InputSecurityDescriptor,
                         IN ULONG RefBias)
 {
     PSECURITY_DESCRIPTOR_HEADER SdHeader = NULL, NewHeader  = NULL;
-    ULONG Length, Hash, Index;
+    ULONG Length, Index;
+    ULONGLONG Hash;
     POB_SD_CACHE_LIST CacheEntry;
     BOOLEAN Result;
     PLIST_ENTRY NextEntry;
@@ -378,7 +386,7 @@ ObLogSecurityDescriptor(IN PSECURITY_DESCRIPTOR InputSecurityDescriptor,
     Hash = ObpHashSecurityDescriptor(InputSecurityDescriptor, Length);
     
     /* Now select the appropriate cache entry */
-    Index = Hash % SD_CACHE_ENTRIES;
+    Index = (ULONG)(Hash % SD_CACHE_ENTRIES);
     CacheEntry = &ObsSecurityDescriptorCache[Index];
     
     /* Lock it shared */
@@ -400,13 +408,17 @@ ObLogSecurityDescriptor(IN PSECURITY_DESCRIPTOR InputSecurityDescriptor,
             /* Our hashes are ordered, so quickly check if we should stop now */
             if (SdHeader->FullHash > Hash) break;
             
-            /* We survived the quick hash check, now check for equalness */
+            /*
+             * We survived the quick hash check, now check for equalness.
+             * With 64 bits of hash, this is almost always the descriptor
+             * we're looking for, and the only compare we do.
+             */
             if (SdHeader->FullHash == Hash)
             {
                 /* Hashes match, now compare descriptors */
                 Result = ObpCompareSecurityDescriptors(InputSecurityDescriptor,
                                                        Length,
-                                                       &SdHeader->SecurityDescriptor);
+                                                       SdHeader);
                 if (Result) break;
             }
             
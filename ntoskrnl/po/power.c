@@ -382,12 +382,153 @@ PopPerfIdleDpc(IN PKDPC Dpc,
     PopPerfIdle(&((PKPRCB)DeferredContext)->PowerState);
 }
 
+#if defined(_M_IX86) || defined(_M_AMD64)
+
+/* MWAIT extension: wake up on interrupts even when they are masked */
+#define MWAIT_ECX_INTERRUPT_BREAK   0x1
+
+typedef struct _POP_IDLE_STATE
+{
+    ULONG MwaitHint;
+    ULONG TargetResidency; // In microseconds
+} POP_IDLE_STATE, *PPOP_IDLE_STATE;
+
+/* C1, C2 and C3, matching the PROCESSOR_POWER_STATE idle statistics */
+static POP_IDLE_STATE PopIdleStates[3];
+static ULONG PopIdleStateCount = 0;
+
+INIT_FUNCTION
+static
+VOID
+PopInitializeIdleStates(VOID)
+{
+    CPU_INFO CpuInfo;
+    ULONG MaxLeaf, SubStates;
+    BOOLEAN DeepStatesUsable = FALSE;
+
+    KiCpuId(&CpuInfo, 0);
+    MaxLeaf = CpuInfo.Eax;
+    if (MaxLeaf < 5)
+        return;
+
+    /* MONITOR/MWAIT must be there, with breaks on masked interrupts */
+    KiCpuId(&CpuInfo, 1);
+    if (!(CpuInfo.Ecx & (1 << 3)))
+        return;
+    KiCpuId(&CpuInfo, 5);
+    if ((CpuInfo.Ecx & 0x3) != 0x3)
+        return;
+    SubStates = CpuInfo.Edx;
+
+    /*
+     * Deeper states stop the TSC and the local APIC timer unless they are
+     * invariant (CPUID 0x80000007 EDX bit 8) and always running (CPUID 6
+     * EAX bit 2, ARAT). Without that, stick to C1.
+     */
+    if (MaxLeaf >= 6)
+    {
+        KiCpuId(&CpuInfo, 6);
+        if (CpuInfo.Eax & (1 << 2))
+        {
+            KiCpuId(&CpuInfo, 0x80000000);
+            if (CpuInfo.Eax >= 0x80000007)
+            {
+                KiCpuId(&CpuInfo, 0x80000007);
+                DeepStatesUsable = !!(CpuInfo.Edx & (1 << 8));
+            }
+        }
+    }
+
+    /* C1 is always there */
+    PopIdleStates[0].MwaitHint = 0x00;
+    PopIdleStates[0].TargetResidency = 0;
+    PopIdleStateCount = 1;
+
+    if (!DeepStatesUsable)
+        return;
+
+    /* EDX reports the number of MWAIT sub-states of each C-state, 4 bits each */
+    if ((SubStates >> 8) & 0xF)
+    {
+        PopIdleStates[PopIdleStateCount].MwaitHint = 0x10;
+        PopIdleStates[PopIdleStateCount].TargetResidency = 50;
+        PopIdleStateCount++;
+    }
+    if ((SubStates >> 12) & 0xF)
+    {
+        PopIdleStates[PopIdleStateCount].MwaitHint = 0x20;
+        PopIdleStates[PopIdleStateCount].TargetResidency = 400;
+        PopIdleStateCount++;
+    }
+}
+
+#endif /* _M_IX86 || _M_AMD64 */
+
 VOID
 FASTCALL
 PopIdle0(IN PPROCESSOR_POWER_STATE PowerState)
 {
+#if defined(_M_IX86) || defined(_M_AMD64)
+    PKPRCB Prcb;
+    PPOP_IDLE_STATE IdleStates, State;
+    ULONG Index, Predicted, Elapsed;
+    ULONGLONG Start, Cycles;
+
+    /* Without MWAIT, just halt */
+    if (PowerState->IdleHandlersCount == 0)
+    {
+        HalProcessorIdle();
+        return;
+    }
+
+    Prcb = CONTAINING_RECORD(PowerState, KPRCB, PowerState);
+    IdleStates = PowerState->IdleHandlers;
+
+    /*
+     * Pick the deepest state worth entering for the predicted idle time,
+     * kept in IdleTime1 (in microseconds).
+     */
+    Predicted = PowerState->IdleTime1;
+    Index = PowerState->IdleHandlersCount - 1;
+    while (Index > 0 && IdleStates[Index].TargetResidency > Predicted)
+        Index--;
+    State = &IdleStates[Index];
+
+    if (State != PowerState->IdleState)
+    {
+        if (State > (PPOP_IDLE_STATE)PowerState->IdleState)
+            PowerState->PromotionCount++;
+        else
+            PowerState->DemotionCount++;
+        PowerState->IdleState = State;
+    }
+
+    /*
+     * Monitor NextThread, so that another processor scheduling a thread
+     * here wakes us up right away. Interrupts are still disabled: they
+     * break the wait and are serviced once we enable them.
+     */
+    Start = __rdtsc();
+    _mm_monitor(&Prcb->NextThread, 0, 0);
+    if (!Prcb->NextThread)
+        _mm_mwait(MWAIT_ECX_INTERRUPT_BREAK, State->MwaitHint);
+    Cycles = __rdtsc() - Start;
+
+    /* Like HalProcessorIdle, return with interrupts on */
+    _enable();
+
+    PowerState->TotalIdleStateTime[Index] += Cycles;
+    PowerState->TotalIdleTransitions[Index]++;
+
+    /* Update the prediction with a 1/4 weighted moving average */
+    Elapsed = MAXULONG;
+    if (Prcb->MHz && (Cycles / Prcb->MHz) < MAXULONG)
+        Elapsed = (ULONG)(Cycles / Prcb->MHz);
+    PowerState->IdleTime1 = Predicted - (Predicted / 4) + (Elapsed / 4);
+#else
     /* FIXME: Extremly naive implementation */
     HalProcessorIdle();
+#endif
 }
 
 INIT_FUNCTION
@@ -402,6 +543,15 @@ PoInitializePrcb(IN PKPRCB Prcb)
     Prcb->PowerState.CurrentThrottleIndex = 0;
     Prcb->PowerState.IdleFunction = PopIdle0;
 
+#if defined(_M_IX86) || defined(_M_AMD64)
+    /* Select the MWAIT idle states on the boot processor, used by all */
+    if (Prcb->Number == 0)
+        PopInitializeIdleStates();
+    Prcb->PowerState.IdleHandlers = PopIdleStates;
+    Prcb->PowerState.IdleHandlersCount = PopIdleStateCount;
+    Prcb->PowerState.IdleState = &PopIdleStates[0];
+#endif
+
     /* Initialize the Perf DPC and Timer */
     KeInitializeDpc(&Prcb->PowerState.PerfDpc, PopPerfIdleDpc, Prcb);
     KeSetTargetProcessorDpc(&Prcb->PowerState.PerfDpc, Prcb->Number);
@@ -758,8 +908,21 @@ NtPowerInformation(IN POWER_INFORMATION_LEVEL PowerInformationLevel,
                 PowerInformation->MaxMhz = 1000;
                 PowerInformation->CurrentMhz = 1000;
                 PowerInformation->MhzLimit = 1000;
-                PowerInformation->MaxIdleState = 0;
-                PowerInformation->CurrentIdleState = 0;
+#if defined(_M_IX86) || defined(_M_AMD64)
+                if (PopIdleStateCount)
+                {
+                    PKPRCB Prcb = KeGetCurrentPrcb();
+
+                    PowerInformation->MaxIdleState = PopIdleStateCount;
+                    PowerInformation->CurrentIdleState =
+                        (PPOP_IDLE_STATE)Prcb->PowerState.IdleState - PopIdleStates + 1;
+                }
+                else
+#endif
+                {
+                    PowerInformation->MaxIdleState = 0;
+                    PowerInformation->CurrentIdleState = 0;
+                }
 
                 Status = STATUS_SUCCESS;
             }
@@ -1087,7 +1087,7 @@ PspExitProcess(IN BOOLEAN LastThread,
     if (LastThread)
     {
         /* Notify the WMI Process Callback */
-        //WmiTraceProcess(Process, FALSE);
+        WmiTraceProcess(Process, FALSE);
 
         /* Run the Notification Routines */
         PspRunCreateProcessNotifyRoutines(Process, FALSE);
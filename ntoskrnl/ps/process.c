@@ -866,6 +866,10 @@ PspCreateProcess(OUT PHANDLE ProcessHandle,
     }
     _SEH2_END;
 
+    /* Notify WMI and the boot timeline */
+    WmiTraceProcess(Process, TRUE);
+    ExpBootPerfRecordProcess(Process);
+
     /* Run the Notification Routines */
     PspRunCreateProcessNotifyRoutines(Process, TRUE);
 
@@ -65,7 +65,10 @@ PspUserThreadStartup(IN PKSTART_ROUTINE StartRoutine,
         /* Check if the Prefetcher is enabled */
         if (CcPfEnablePrefetcher)
         {
-            /* FIXME: Prepare to prefetch this process */
+#ifndef NEWCC
+            /* Prefetch what this process read the last time it started */
+            CcPfBeginAppLaunch(PsGetCurrentProcess());
+#endif
         }
 
         /* Raise to APC */
@@ -406,7 +409,6 @@ PspCreateThread(OUT PHANDLE ThreadHandle,
     ExReleaseRundownProtection(&Process->RundownProtect);
 
     /* Notify WMI */
-    //WmiTraceProcess(Process, TRUE);
     //WmiTraceThread(Thread, InitialTeb, TRUE);
 
     /* Notify Thread Creation */
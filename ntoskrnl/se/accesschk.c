@@ -15,9 +15,146 @@
 
 /* GLOBALS ********************************************************************/
 
+/* Small DACLs are cached verbatim, so a hit never relies on the hash alone */
+#define SEP_ACCESS_CACHE_ENTRIES    64
+#define SEP_ACCESS_CACHE_MAX_ACL    256
+
+typedef struct _SEP_ACCESS_CACHE_ENTRY
+{
+    LUID TokenId;
+    LUID ModifiedId;
+    ULONG Hash;
+    GENERIC_MAPPING GenericMapping;
+    ACCESS_MASK GrantedAccess;
+    USHORT AclSize;
+    UCHAR Acl[SEP_ACCESS_CACHE_MAX_ACL];
+} SEP_ACCESS_CACHE_ENTRY, *PSEP_ACCESS_CACHE_ENTRY;
+
+static SEP_ACCESS_CACHE_ENTRY SepAccessCache[SEP_ACCESS_CACHE_ENTRIES];
+static KSPIN_LOCK SepAccessCacheLock;
 
 /* PRIVATE FUNCTIONS **********************************************************/
 
+static
+ULONG
+SepHashAccessCheck(IN PTOKEN Token,
+                   IN PACL Dacl)
+{
+    PUCHAR Byte, End;
+    ULONG Hash;
+
+    /* FNV-1a over the token identity and the DACL */
+    Hash = 2166136261u ^ Token->TokenId.LowPart ^ Token->ModifiedId.LowPart;
+    End = (PUCHAR)Dacl + Dacl->AclSize;
+    for (Byte = (PUCHAR)Dacl; Byte < End; Byte++)
+    {
+        Hash = (Hash ^ *Byte) * 16777619u;
+    }
+
+    return Hash;
+}
+
+/*
+ * Returns the rights the DACL grants to the token, where each right is
+ * decided by the first ACE that mentions it. A desired access is granted by
+ * an ordered walk of the DACL exactly when it is a subset of this mask.
+ * The result only depends on the token's groups, which are versioned by its
+ * ModifiedId, so it is cached per token and DACL.
+ */
+static
+ACCESS_MASK
+SepGetDaclGrantedAccess(IN PACCESS_TOKEN _Token,
+                        IN PACL Dacl,
+                        IN PGENERIC_MAPPING GenericMapping)
+{
+    PTOKEN Token = (PTOKEN)_Token;
+    PSEP_ACCESS_CACHE_ENTRY Entry = NULL;
+    ACCESS_MASK TempAccess;
+    ACCESS_MASK TempGrantedAccess = 0;
+    ACCESS_MASK TempDeniedAccess = 0;
+    PACE CurrentAce;
+    PSID Sid;
+    ULONG i, Hash = 0;
+    KIRQL OldIrql;
+
+    /* Look for a cached result */
+    if (Dacl->AclSize <= SEP_ACCESS_CACHE_MAX_ACL)
+    {
+        Hash = SepHashAccessCheck(Token, Dacl);
+        Entry = &SepAccessCache[Hash % SEP_ACCESS_CACHE_ENTRIES];
+
+        KeAcquireSpinLock(&SepAccessCacheLock, &OldIrql);
+        if ((Entry->Hash == Hash) &&
+            (Entry->AclSize == Dacl->AclSize) &&
+            RtlEqualLuid(&Entry->TokenId, &Token->TokenId) &&
+            RtlEqualLuid(&Entry->ModifiedId, &Token->ModifiedId) &&
+            RtlEqualMemory(&Entry->GenericMapping, GenericMapping, sizeof(GENERIC_MAPPING)) &&
+            RtlEqualMemory(Entry->Acl, Dacl, Dacl->AclSize))
+        {
+            TempGrantedAccess = Entry->GrantedAccess;
+            KeReleaseSpinLock(&SepAccessCacheLock, OldIrql);
+            return TempGrantedAccess;
+        }
+        KeReleaseSpinLock(&SepAccessCacheLock, OldIrql);
+    }
+
+    CurrentAce = (PACE)(Dacl + 1);
+    for (i = 0; i < Dacl->AceCount; i++)
+    {
+        if (!(CurrentAce->Header.AceFlags & INHERIT_ONLY_ACE))
+        {
+            Sid = (PSID)(CurrentAce + 1);
+            if (CurrentAce->Header.AceType == ACCESS_DENIED_ACE_TYPE)
+            {
+                if (SepSidInToken(Token, Sid))
+                {
+                    /* Map access rights from the ACE */
+                    TempAccess = CurrentAce->AccessMask;
+                    RtlMapGenericMask(&TempAccess, GenericMapping);
+
+                    /* Deny access rights that have not been granted yet */
+                    TempDeniedAccess |= (TempAccess & ~TempGrantedAccess);
+                }
+            }
+            else if (CurrentAce->Header.AceType == ACCESS_ALLOWED_ACE_TYPE)
+            {
+                if (SepSidInToken(Token, Sid))
+                {
+                    /* Map access rights from the ACE */
+                    TempAccess = CurrentAce->AccessMask;
+                    RtlMapGenericMask(&TempAccess, GenericMapping);
+
+                    /* Grant access rights that have not been denied yet */
+                    TempGrantedAccess |= (TempAccess & ~TempDeniedAccess);
+                }
+            }
+            else
+            {
+                DPRINT1("Unsupported ACE type 0x%lx\n", CurrentAce->Header.AceType);
+            }
+        }
+
+        /* Get the next ACE */
+        CurrentAce = (PACE)((ULONG_PTR)CurrentAce + CurrentAce->Header.AceSize);
+    }
+
+    /* Remember the result */
+    if (Entry)
+    {
+        KeAcquireSpinLock(&SepAccessCacheLock, &OldIrql);
+        Entry->TokenId = Token->TokenId;
+        Entry->ModifiedId = Token->ModifiedId;
+        Entry->Hash = Hash;
+        Entry->GenericMapping = *GenericMapping;
+        Entry->GrantedAccess = TempGrantedAccess;
+        Entry->AclSize = Dacl->AclSize;
+        RtlCopyMemory(Entry->Acl, Dacl, Dacl->AclSize);
+        KeReleaseSpinLock(&SepAccessCacheLock, OldIrql);
+    }
+
+    return TempGrantedAccess;
+}
+
 /*
  * FIXME: Incomplete!
  */
@@ -36,16 +173,12 @@ SepAccessCheck(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
                IN BOOLEAN UseResultList)
 {
     ACCESS_MASK RemainingAccess;
-    ACCESS_MASK TempAccess;
-    ACCESS_MASK TempGrantedAccess = 0;
-    ACCESS_MASK TempDeniedAccess = 0;
+    ACCESS_MASK TempGrantedAccess;
     PACCESS_TOKEN Token;
     ULONG i, ResultListLength;
     PACL Dacl;
     BOOLEAN Present;
     BOOLEAN Defaulted;
-    PACE CurrentAce;
-    PSID Sid;
     NTSTATUS Status;
     PAGED_CODE();
 
@@ -137,49 +270,12 @@ SepAccessCheck(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
         goto ReturnCommonStatus;
     }
 
+    /* Get the rights the DACL grants to this token */
+    TempGrantedAccess = SepGetDaclGrantedAccess(Token, Dacl, GenericMapping);
+
     /* Determine the MAXIMUM_ALLOWED access rights according to the DACL */
     if (DesiredAccess & MAXIMUM_ALLOWED)
     {
-        CurrentAce = (PACE)(Dacl + 1);
-        for (i = 0; i < Dacl->AceCount; i++)
-        {
-            if (!(CurrentAce->Header.AceFlags & INHERIT_ONLY_ACE))
-            {
-                Sid = (PSID)(CurrentAce + 1);
-                if (CurrentAce->Header.AceType == ACCESS_DENIED_ACE_TYPE)
-                {
-                    if (SepSidInToken(Token, Sid))
-                    {
-                        /* Map access rights from the ACE */
-                        TempAccess = CurrentAce->AccessMask;
-                        RtlMapGenericMask(&TempAccess, GenericMapping);
-
-                        /* Deny access rights that have not been granted yet */
-                        TempDeniedAccess |= (TempAccess & ~TempGrantedAccess);
-                    }
-                }
-                else if (CurrentAce->Header.AceType == ACCESS_ALLOWED_ACE_TYPE)
-                {
-                    if (SepSidInToken(Token, Sid))
-                    {
-                        /* Map access rights from the ACE */
-                        TempAccess = CurrentAce->AccessMask;
-                        RtlMapGenericMask(&TempAccess, GenericMapping);
-
-                        /* Grant access rights that have not been denied yet */
-                        TempGrantedAccess |= (TempAccess & ~TempDeniedAccess);
-                    }
-                }
-                else
-                {
-                    DPRINT1("Unsupported ACE type 0x%lx\n", CurrentAce->Header.AceType);
-                }
-            }
-
-            /* Get the next ACE */
-            CurrentAce = (PACE)((ULONG_PTR)CurrentAce + CurrentAce->Header.AceSize);
-        }
-
         /* Fail if some rights have not been granted */
         RemainingAccess &= ~(MAXIMUM_ALLOWED | TempGrantedAccess);
         if (RemainingAccess != 0)
@@ -203,49 +299,8 @@ SepAccessCheck(IN PSECURITY_DESCRIPTOR SecurityDescriptor,
     }
 
     /* RULE 4: Grant rights according to the DACL */
-    CurrentAce = (PACE)(Dacl + 1);
-    for (i = 0; i < Dacl->AceCount; i++)
-    {
-        if (!(CurrentAce->Header.AceFlags & INHERIT_ONLY_ACE))
-        {
-            Sid = (PSID)(CurrentAce + 1);
-            if (CurrentAce->Header.AceType == ACCESS_DENIED_ACE_TYPE)
-            {
-                if (SepSidInToken(Token, Sid))
-                {
-                    /* Map access rights from the ACE */
-                    TempAccess = CurrentAce->AccessMask;
-                    RtlMapGenericMask(&TempAccess, GenericMapping);
-
-                    /* Leave if a remaining right must be denied */
-                    if (RemainingAccess & TempAccess)
-                        break;
-                }
-            }
-            else if (CurrentAce->Header.AceType == ACCESS_ALLOWED_ACE_TYPE)
-            {
-                if (SepSidInToken(Token, Sid))
-                {
-                    /* Map access rights from the ACE */
-                    TempAccess = CurrentAce->AccessMask;
-                    DPRINT("TempAccess 0x%08lx\n", TempAccess);
-                    RtlMapGenericMask(&TempAccess, GenericMapping);
-
-                    /* Remove granted rights */
-                    DPRINT("RemainingAccess 0x%08lx  TempAccess 0x%08lx\n", RemainingAccess, TempAccess);
-                    RemainingAccess &= ~TempAccess;
-                    DPRINT("RemainingAccess 0x%08lx\n", RemainingAccess);
-                }
-            }
-            else
-            {
-                DPRINT1("Unsupported ACE type 0x%lx\n", CurrentAce->Header.AceType);
-            }
-        }
-
-        /* Get the next ACE */
-        CurrentAce = (PACE)((ULONG_PTR)CurrentAce + CurrentAce->Header.AceSize);
-    }
+    DPRINT("RemainingAccess 0x%08lx  TempGrantedAccess 0x%08lx\n", RemainingAccess, TempGrantedAccess);
+    RemainingAccess &= ~TempGrantedAccess;
 
     DPRINT("DesiredAccess %08lx\nPreviouslyGrantedAccess %08lx\nRemainingAccess %08lx\n",
            DesiredAccess, PreviouslyGrantedAccess, RemainingAccess);
@@ -0,0 +1,775 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/wmi/kernlog.c
+ * PURPOSE:         NT Kernel Logger
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#include "wmip.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * Every processor writes its events into a buffer of its own at HIGH_LEVEL,
+ * so events are appended without locks or interlocked operations. Full
+ * buffers go to an SLIST, which the flush thread drains to the log file.
+ * Partially filled buffers are collected once a second with an IPI.
+ */
+
+#define TAG_WMI_KLOG                    'gLmW'
+
+#define WMIP_KLOG_DEFAULT_BUFFER_SIZE   64      /* KB */
+#define WMIP_KLOG_MIN_BUFFER_SIZE       16
+#define WMIP_KLOG_MAX_BUFFER_SIZE       1024
+#define WMIP_KLOG_BUFFERS_PER_CPU       4
+#define WMIP_KLOG_MAX_NAME_LENGTH       MAX_PATH
+
+typedef struct _WMIP_KLOG_BUFFER
+{
+    SLIST_ENTRY ListEntry;
+    WMI_KLOG_BUFFER_HEADER Header;
+    /* Events follow, up to WmipKlogBufferSize */
+} WMIP_KLOG_BUFFER, *PWMIP_KLOG_BUFFER;
+
+typedef struct _WMIP_KLOG_PROCESSOR
+{
+    PWMIP_KLOG_BUFFER Current;
+    ULONG EventsLost;
+} WMIP_KLOG_PROCESSOR, *PWMIP_KLOG_PROCESSOR;
+
+/* GLOBALS *******************************************************************/
+
+volatile ULONG WmipKernelLoggerFlags;
+
+PWMIP_KLOG_PROCESSOR WmipKlogProcessors;
+ULONG WmipKlogProcessorCount;
+ULONG WmipKlogBufferSize;
+ULONG WmipKlogBufferCapacity;
+LONG WmipKlogSequence;
+SLIST_HEADER WmipKlogFreeList;
+SLIST_HEADER WmipKlogFlushList;
+KDPC WmipKlogFlushDpc;
+KEVENT WmipKlogFlushEvent;
+
+KPROFILE_SOURCE WmipKlogProfileSource;
+
+UNICODE_STRING WmipKlogFileName;
+HANDLE WmipKlogFileHandle;
+LARGE_INTEGER WmipKlogFileOffset;
+WMI_KLOG_FILE_HEADER WmipKlogFileHeader;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+FORCEINLINE
+ULONGLONG
+WmipKlogTimeStamp(VOID)
+{
+#if defined(_M_IX86) || defined(_M_AMD64)
+    return __rdtsc();
+#else
+    return KeQueryInterruptTime();
+#endif
+}
+
+static
+VOID
+WmipKlogTakeBuffer(IN PWMIP_KLOG_PROCESSOR Processor,
+                   IN ULONG Number,
+                   IN PWMIP_KLOG_BUFFER Buffer)
+{
+    Buffer->Header.Size = sizeof(WMI_KLOG_BUFFER_HEADER);
+    Buffer->Header.ProcessorNumber = (USHORT)Number;
+    Buffer->Header.Reserved = 0;
+    Buffer->Header.EventsLost = Processor->EventsLost;
+    Buffer->Header.Sequence = InterlockedIncrement(&WmipKlogSequence);
+    Buffer->Header.TimeStamp = WmipKlogTimeStamp();
+    Buffer->Header.InterruptTime = KeQueryInterruptTime();
+
+    Processor->EventsLost = 0;
+    Processor->Current = Buffer;
+}
+
+/*
+ * Reserves an event in the buffer of the current processor and returns its
+ * payload. On success the caller is left at HIGH_LEVEL and must fill in the
+ * payload and then lower back to OldIrql.
+ */
+static
+PVOID
+WmipKlogReserveEvent(IN USHORT Type,
+                     IN ULONG PayloadSize,
+                     OUT PKIRQL OldIrql)
+{
+    PWMIP_KLOG_PROCESSOR Processor;
+    PWMIP_KLOG_BUFFER Buffer, NewBuffer;
+    PWMI_KLOG_EVENT_HEADER Event;
+    ULONG Number, Size;
+
+    Size = ALIGN_UP_BY(sizeof(WMI_KLOG_EVENT_HEADER) + PayloadSize, 8);
+
+    KeRaiseIrql(HIGH_LEVEL, OldIrql);
+
+    Number = KeGetCurrentProcessorNumber();
+    if (Number >= WmipKlogProcessorCount)
+    {
+        KeLowerIrql(*OldIrql);
+        return NULL;
+    }
+    Processor = &WmipKlogProcessors[Number];
+
+    /* Hand a full buffer to the flush thread and continue in a free one */
+    Buffer = Processor->Current;
+    if (Buffer->Header.Size + Size > WmipKlogBufferCapacity)
+    {
+        NewBuffer = (PWMIP_KLOG_BUFFER)InterlockedPopEntrySList(&WmipKlogFreeList);
+        if (!NewBuffer)
+        {
+            /* The flush thread is behind, drop the event */
+            Processor->EventsLost++;
+            KeLowerIrql(*OldIrql);
+            return NULL;
+        }
+
+        InterlockedPushEntrySList(&WmipKlogFlushList, &Buffer->ListEntry);
+        KeInsertQueueDpc(&WmipKlogFlushDpc, NULL, NULL);
+
+        WmipKlogTakeBuffer(Processor, Number, NewBuffer);
+        Buffer = NewBuffer;
+    }
+
+    Event = (PWMI_KLOG_EVENT_HEADER)((PUCHAR)&Buffer->Header + Buffer->Header.Size);
+    Buffer->Header.Size += Size;
+
+    Event->Size = (USHORT)Size;
+    Event->Type = Type;
+    Event->ThreadId = HandleToUlong(PsGetCurrentThreadId());
+    Event->ProcessId = HandleToUlong(PsGetCurrentProcessId());
+    Event->Reserved = 0;
+    Event->TimeStamp = WmipKlogTimeStamp();
+
+    RtlZeroMemory(Event + 1, Size - sizeof(WMI_KLOG_EVENT_HEADER));
+    return Event + 1;
+}
+
+static
+VOID
+NTAPI
+WmipKlogFlushDpcRoutine(IN PKDPC Dpc,
+                        IN PVOID DeferredContext,
+                        IN PVOID SystemArgument1,
+                        IN PVOID SystemArgument2)
+{
+    /* Events cannot wait for the dispatcher lock, so they wake the thread from here */
+    KeSetEvent(&WmipKlogFlushEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+ULONG_PTR
+NTAPI
+WmipKlogSwapBuffer(IN ULONG_PTR Argument)
+{
+    PWMIP_KLOG_PROCESSOR Processor;
+    PWMIP_KLOG_BUFFER Buffer, NewBuffer;
+    ULONG Number;
+
+    /* Running at IPI_LEVEL, so no event can be half written here */
+    Number = KeGetCurrentProcessorNumber();
+    if (Number >= WmipKlogProcessorCount) return 0;
+    Processor = &WmipKlogProcessors[Number];
+
+    Buffer = Processor->Current;
+    if (Buffer->Header.Size == sizeof(WMI_KLOG_BUFFER_HEADER)) return 0;
+
+    NewBuffer = (PWMIP_KLOG_BUFFER)InterlockedPopEntrySList(&WmipKlogFreeList);
+    if (!NewBuffer) return 0;
+
+    InterlockedPushEntrySList(&WmipKlogFlushList, &Buffer->ListEntry);
+    WmipKlogTakeBuffer(Processor, Number, NewBuffer);
+    return 0;
+}
+
+static
+BOOLEAN
+WmipKlogOpenFile(VOID)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Offset;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &WmipKlogFileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+
+    /* This fails until the boot volume is mounted, the caller retries later */
+    Status = ZwCreateFile(&FileHandle,
+                          FILE_WRITE_DATA | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          FILE_SHARE_READ,
+                          FILE_OVERWRITE_IF,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+                          NULL,
+                          0);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT("Cannot open %wZ yet: 0x%lx\n", &WmipKlogFileName, Status);
+        return FALSE;
+    }
+
+    Offset.QuadPart = 0;
+    Status = ZwWriteFile(FileHandle,
+                         NULL,
+                         NULL,
+                         NULL,
+                         &IoStatusBlock,
+                         &WmipKlogFileHeader,
+                         sizeof(WmipKlogFileHeader),
+                         &Offset,
+                         NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to write the kernel logger header: 0x%lx\n", Status);
+        ZwClose(FileHandle);
+        return FALSE;
+    }
+
+    WmipKlogFileOffset.QuadPart = sizeof(WmipKlogFileHeader);
+    WmipKlogFileHandle = FileHandle;
+    return TRUE;
+}
+
+static
+VOID
+NTAPI
+WmipKlogFlushThread(IN PVOID Context)
+{
+    PSLIST_ENTRY ListEntry, NextEntry, Head = NULL, *Tail = &Head;
+    PSLIST_ENTRY Queued;
+    PWMIP_KLOG_BUFFER Buffer;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+
+    Timeout.QuadPart = -10 * 1000 * 1000;
+
+    for (;;)
+    {
+        Status = KeWaitForSingleObject(&WmipKlogFlushEvent,
+                                       Executive,
+                                       KernelMode,
+                                       FALSE,
+                                       &Timeout);
+
+        /* Nothing filled up for a while, collect the partial buffers */
+        if (Status == STATUS_TIMEOUT)
+            KeIpiGenericCall(WmipKlogSwapBuffer, 0);
+
+        /* The list is LIFO, put the buffers back in the order they were queued */
+        Queued = NULL;
+        for (ListEntry = InterlockedFlushSList(&WmipKlogFlushList);
+             ListEntry;
+             ListEntry = NextEntry)
+        {
+            NextEntry = ListEntry->Next;
+            ListEntry->Next = Queued;
+            Queued = ListEntry;
+        }
+
+        /* Append them to the ones still waiting for the file */
+        if (Queued)
+        {
+            *Tail = Queued;
+            while (Queued->Next) Queued = Queued->Next;
+            Tail = &Queued->Next;
+        }
+
+        if (!Head) continue;
+        if (!WmipKlogFileHandle && !WmipKlogOpenFile()) continue;
+
+        while (Head)
+        {
+            Buffer = CONTAINING_RECORD(Head, WMIP_KLOG_BUFFER, ListEntry);
+            Head = Head->Next;
+
+            Status = ZwWriteFile(WmipKlogFileHandle,
+                                 NULL,
+                                 NULL,
+                                 NULL,
+                                 &IoStatusBlock,
+                                 &Buffer->Header,
+                                 Buffer->Header.Size,
+                                 &WmipKlogFileOffset,
+                                 NULL);
+            if (NT_SUCCESS(Status))
+                WmipKlogFileOffset.QuadPart += Buffer->Header.Size;
+            else
+                DPRINT1("Failed to write kernel logger buffer: 0x%lx\n", Status);
+
+            InterlockedPushEntrySList(&WmipKlogFreeList, &Buffer->ListEntry);
+        }
+        Tail = &Head;
+    }
+}
+
+static
+ULONG
+WmipKlogQueryValue(IN HANDLE KeyHandle,
+                   IN PWSTR ValueName,
+                   IN ULONG Default)
+{
+    PKEY_VALUE_FULL_INFORMATION Information;
+    ULONG Value = Default;
+    NTSTATUS Status;
+
+    Status = IopGetRegistryValue(KeyHandle, ValueName, &Information);
+    if (!NT_SUCCESS(Status)) return Default;
+
+    /* EnableKernelFlags is a binary array on Windows, take its first ULONG */
+    if (((Information->Type == REG_DWORD) || (Information->Type == REG_BINARY)) &&
+        (Information->DataLength >= sizeof(ULONG)))
+    {
+        Value = *(PULONG)((ULONG_PTR)Information + Information->DataOffset);
+    }
+
+    ExFreePool(Information);
+    return Value;
+}
+
+#ifdef _M_IX86
+static
+USHORT
+WmipKlogWalkFrames(IN PKTRAP_FRAME TrapFrame,
+                   OUT PULONGLONG Frames)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+    ULONG_PTR Frame, NextFrame, Low, High, DpcStack;
+    USHORT Count = 0;
+
+    /* The interrupted code ran either on the thread stack or on the DPC stack */
+    Frame = TrapFrame->Ebp;
+    DpcStack = (ULONG_PTR)KeGetCurrentPrcb()->DpcStack;
+    if ((Frame >= (ULONG_PTR)Thread->StackLimit) && (Frame < (ULONG_PTR)Thread->InitialStack))
+    {
+        Low = (ULONG_PTR)Thread->StackLimit;
+        High = (ULONG_PTR)Thread->InitialStack;
+    }
+    else if (DpcStack && (Frame >= DpcStack - KERNEL_STACK_SIZE) && (Frame < DpcStack))
+    {
+        Low = DpcStack - KERNEL_STACK_SIZE;
+        High = DpcStack;
+    }
+    else
+    {
+        return 0;
+    }
+
+    /* Only read frames that are inside the stack, the chain may be broken by FPO code */
+    while ((Count < WMI_KLOG_MAX_PROFILE_FRAMES) &&
+           (Frame >= Low) &&
+           (Frame + 2 * sizeof(ULONG_PTR) <= High) &&
+           !(Frame & (sizeof(ULONG_PTR) - 1)))
+    {
+        if (!((PULONG_PTR)Frame)[1]) break;
+        Frames[Count++] = ((PULONG_PTR)Frame)[1];
+
+        NextFrame = ((PULONG_PTR)Frame)[0];
+        if (NextFrame <= Frame) break;
+        Frame = NextFrame;
+    }
+
+    return Count;
+}
+#endif
+
+static
+VOID
+WmipKlogImageRundown(VOID)
+{
+    PLDR_DATA_TABLE_ENTRY LdrEntry;
+    PLIST_ENTRY NextEntry;
+    IMAGE_INFO ImageInfo;
+
+    /* Report the drivers loaded before the logger started */
+    KeEnterCriticalRegion();
+    ExAcquireResourceSharedLite(&PsLoadedModuleResource, TRUE);
+
+    for (NextEntry = PsLoadedModuleList.Flink;
+         NextEntry != &PsLoadedModuleList;
+         NextEntry = NextEntry->Flink)
+    {
+        LdrEntry = CONTAINING_RECORD(NextEntry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
+
+        RtlZeroMemory(&ImageInfo, sizeof(ImageInfo));
+        ImageInfo.SystemModeImage = TRUE;
+        ImageInfo.ImageBase = LdrEntry->DllBase;
+        ImageInfo.ImageSize = LdrEntry->SizeOfImage;
+        WmipTraceImageLoad(&LdrEntry->FullDllName, NULL, &ImageInfo);
+    }
+
+    ExReleaseResourceLite(&PsLoadedModuleResource);
+    KeLeaveCriticalRegion();
+}
+
+/* FUNCTIONS *****************************************************************/
+
+VOID
+NTAPI
+WmipTraceContextSwitch(IN PKTHREAD OldThread,
+                       IN PKTHREAD NewThread)
+{
+    PWMI_KLOG_CSWITCH Data;
+    KIRQL OldIrql;
+
+    Data = WmipKlogReserveEvent(WMI_KLOG_EVENT_CSWITCH, sizeof(*Data), &OldIrql);
+    if (!Data) return;
+
+    Data->NewThreadId = HandleToUlong(CONTAINING_RECORD(NewThread, ETHREAD, Tcb)->Cid.UniqueThread);
+    Data->OldThreadId = HandleToUlong(CONTAINING_RECORD(OldThread, ETHREAD, Tcb)->Cid.UniqueThread);
+    Data->NewThreadPriority = NewThread->Priority;
+    Data->OldThreadPriority = OldThread->Priority;
+    Data->OldThreadWaitReason = OldThread->WaitReason;
+    Data->OldThreadState = OldThread->State;
+
+    KeLowerIrql(OldIrql);
+}
+
+VOID
+NTAPI
+WmipTraceDiskIo(IN PIRP Irp)
+{
+    PIO_STACK_LOCATION StackPtr;
+    PWMI_KLOG_DISK_IO Data;
+    CCHAR Location;
+    KIRQL OldIrql;
+
+    /*
+     * Lower drivers usually see the transfer as IRP_MJ_SCSI or the like, so
+     * record it at the lowest disk device that got it as a read or write.
+     */
+    StackPtr = IoGetCurrentIrpStackLocation(Irp);
+    for (Location = Irp->CurrentLocation;
+         Location <= Irp->StackCount;
+         Location++, StackPtr++)
+    {
+        if (((StackPtr->MajorFunction == IRP_MJ_READ) ||
+             (StackPtr->MajorFunction == IRP_MJ_WRITE)) &&
+            (StackPtr->DeviceObject) &&
+            (StackPtr->DeviceObject->DeviceType == FILE_DEVICE_DISK))
+        {
+            break;
+        }
+    }
+    if (Location > Irp->StackCount) return;
+
+    Data = WmipKlogReserveEvent(WMI_KLOG_EVENT_DISK_IO, sizeof(*Data), &OldIrql);
+    if (!Data) return;
+
+    /* Read and write parameters share the same layout */
+    Data->Irp = (ULONG_PTR)Irp;
+    Data->DeviceObject = (ULONG_PTR)StackPtr->DeviceObject;
+    Data->ByteOffset = StackPtr->Parameters.Read.ByteOffset.QuadPart;
+    Data->Length = StackPtr->Parameters.Read.Length;
+    Data->TransferSize = (ULONG)Irp->IoStatus.Information;
+    Data->Status = Irp->IoStatus.Status;
+    Data->MajorFunction = StackPtr->MajorFunction;
+
+    KeLowerIrql(OldIrql);
+}
+
+VOID
+NTAPI
+WmipTracePageFault(IN ULONG FaultCode,
+                   IN PVOID Address,
+                   IN KPROCESSOR_MODE Mode)
+{
+    PWMI_KLOG_PAGE_FAULT Data;
+    KIRQL OldIrql;
+
+    Data = WmipKlogReserveEvent(WMI_KLOG_EVENT_PAGE_FAULT, sizeof(*Data), &OldIrql);
+    if (!Data) return;
+
+    Data->VirtualAddress = (ULONG_PTR)Address;
+    Data->FaultCode = FaultCode;
+    Data->PreviousMode = Mode;
+
+    KeLowerIrql(OldIrql);
+}
+
+VOID
+NTAPI
+WmipTraceProcess(IN PEPROCESS Process,
+                 IN BOOLEAN Create)
+{
+    PWMI_KLOG_PROCESS Data;
+    ULONG SessionId;
+    KIRQL OldIrql;
+
+    SessionId = PsGetProcessSessionId(Process);
+
+    Data = WmipKlogReserveEvent(Create ? WMI_KLOG_EVENT_PROCESS_START :
+                                         WMI_KLOG_EVENT_PROCESS_END,
+                                sizeof(*Data),
+                                &OldIrql);
+    if (!Data) return;
+
+    Data->UniqueProcessId = HandleToUlong(Process->UniqueProcessId);
+    Data->ParentId = HandleToUlong(Process->InheritedFromUniqueProcessId);
+    Data->SessionId = SessionId;
+    Data->ExitStatus = Create ? STATUS_SUCCESS : Process->ExitStatus;
+    RtlCopyMemory(Data->ImageFileName,
+                  Process->ImageFileName,
+                  sizeof(Data->ImageFileName));
+
+    KeLowerIrql(OldIrql);
+}
+
+VOID
+NTAPI
+WmipTraceProfile(IN PKTRAP_FRAME TrapFrame,
+                 IN KPROFILE_SOURCE Source)
+{
+    ULONGLONG Frames[WMI_KLOG_MAX_PROFILE_FRAMES];
+    PWMI_KLOG_PROFILE Data;
+    ULONG_PTR ProgramCounter;
+    USHORT FrameCount = 0;
+    BOOLEAN UserMode;
+    KIRQL OldIrql;
+
+    if (Source != WmipKlogProfileSource) return;
+
+    /* User stacks could be paged out, which cannot be handled at this IRQL */
+    ProgramCounter = KeGetTrapFramePc(TrapFrame);
+    UserMode = (ProgramCounter <= (ULONG_PTR)MM_HIGHEST_USER_ADDRESS);
+#ifdef _M_IX86
+    if (!UserMode && !(TrapFrame->EFlags & EFLAGS_V86_MASK))
+        FrameCount = WmipKlogWalkFrames(TrapFrame, Frames);
+#endif
+
+    Data = WmipKlogReserveEvent(WMI_KLOG_EVENT_PROFILE,
+                                FIELD_OFFSET(WMI_KLOG_PROFILE, Frames) + FrameCount * sizeof(ULONGLONG),
+                                &OldIrql);
+    if (!Data) return;
+
+    Data->InstructionPointer = ProgramCounter;
+    Data->Source = Source;
+    Data->FrameCount = FrameCount;
+    Data->UserMode = UserMode;
+    RtlCopyMemory(Data->Frames, Frames, FrameCount * sizeof(ULONGLONG));
+
+    KeLowerIrql(OldIrql);
+}
+
+VOID
+NTAPI
+WmipTraceImageLoad(IN PUNICODE_STRING FullImageName OPTIONAL,
+                   IN HANDLE ProcessId OPTIONAL,
+                   IN PIMAGE_INFO ImageInfo)
+{
+    WCHAR Name[WMIP_KLOG_MAX_NAME_LENGTH];
+    PWMI_KLOG_IMAGE_LOAD Data;
+    USHORT Length = 0;
+    KIRQL OldIrql;
+
+    /* The name may be paged, copy it while we still can; keep the file part of long paths */
+    if (FullImageName && FullImageName->Buffer)
+    {
+        Length = FullImageName->Length / sizeof(WCHAR);
+        if (Length > WMIP_KLOG_MAX_NAME_LENGTH) Length = WMIP_KLOG_MAX_NAME_LENGTH;
+        RtlCopyMemory(Name,
+                      FullImageName->Buffer + FullImageName->Length / sizeof(WCHAR) - Length,
+                      Length * sizeof(WCHAR));
+    }
+
+    Data = WmipKlogReserveEvent(WMI_KLOG_EVENT_IMAGE_LOAD,
+                                FIELD_OFFSET(WMI_KLOG_IMAGE_LOAD, FileName) + Length * sizeof(WCHAR),
+                                &OldIrql);
+    if (!Data) return;
+
+    Data->ImageBase = (ULONG_PTR)ImageInfo->ImageBase;
+    Data->ImageSize = (ULONG)ImageInfo->ImageSize;
+    Data->ProcessId = HandleToUlong(ProcessId);
+    Data->NameLength = Length;
+    RtlCopyMemory(Data->FileName, Name, Length * sizeof(WCHAR));
+
+    KeLowerIrql(OldIrql);
+}
+
+/*
+ * Starts the NT Kernel Logger when it is configured as an autologger:
+ * HKLM\System\CurrentControlSet\Control\WMI\Autologger\NT Kernel Logger
+ * with Start, EnableKernelFlags, FileName, BufferSize (KB) and MinimumBuffers.
+ * Profile samples are taken from ProfileSource at ProfileInterval, in the
+ * units KeSetIntervalProfile uses for that source.
+ */
+INIT_FUNCTION
+VOID
+NTAPI
+WmipStartKernelLogger(VOID)
+{
+    UNICODE_STRING KeyName =
+        RTL_CONSTANT_STRING(L"\\Registry\\Machine\\System\\CurrentControlSet\\Control\\WMI\\Autologger\\NT Kernel Logger");
+    UNICODE_STRING DefaultFileName = RTL_CONSTANT_STRING(L"\\SystemRoot\\KernelLogger.log");
+    PKEY_VALUE_FULL_INFORMATION Information;
+    UNICODE_STRING FileName;
+    PWMIP_KLOG_BUFFER Buffer;
+    ULONG Flags, BufferSize, BufferCount, ProfileInterval, i;
+    HANDLE KeyHandle, ThreadHandle;
+    NTSTATUS Status;
+
+    Status = IopOpenRegistryKeyEx(&KeyHandle, NULL, &KeyName, KEY_READ);
+    if (!NT_SUCCESS(Status)) return;
+
+    Flags = 0;
+    if (WmipKlogQueryValue(KeyHandle, L"Start", 0))
+        Flags = WmipKlogQueryValue(KeyHandle, L"EnableKernelFlags", 0) & WMI_KLOG_SUPPORTED_FLAGS;
+    if (!Flags)
+    {
+        ZwClose(KeyHandle);
+        return;
+    }
+
+    /* Sampling works with whatever profile sources the HAL can drive */
+    WmipKlogProfileSource = (KPROFILE_SOURCE)WmipKlogQueryValue(KeyHandle, L"ProfileSource", ProfileTime);
+    ProfileInterval = WmipKlogQueryValue(KeyHandle, L"ProfileInterval", 0);
+    if ((Flags & WMI_KLOG_FLAG_PROFILE) &&
+        (WmipKlogProfileSource != ProfileTime) &&
+        !KeQueryIntervalProfile(WmipKlogProfileSource))
+    {
+        DPRINT1("Profile source %lu is not supported\n", WmipKlogProfileSource);
+        Flags &= ~WMI_KLOG_FLAG_PROFILE;
+        if (!Flags)
+        {
+            ZwClose(KeyHandle);
+            return;
+        }
+    }
+
+    BufferSize = WmipKlogQueryValue(KeyHandle, L"BufferSize", WMIP_KLOG_DEFAULT_BUFFER_SIZE);
+    if (BufferSize < WMIP_KLOG_MIN_BUFFER_SIZE) BufferSize = WMIP_KLOG_MIN_BUFFER_SIZE;
+    if (BufferSize > WMIP_KLOG_MAX_BUFFER_SIZE) BufferSize = WMIP_KLOG_MAX_BUFFER_SIZE;
+
+    /* Each processor holds one buffer, the rest absorb flush latency */
+    BufferCount = WmipKlogQueryValue(KeyHandle, L"MinimumBuffers", 0);
+    if (BufferCount < (ULONG)KeNumberProcessors * WMIP_KLOG_BUFFERS_PER_CPU)
+        BufferCount = (ULONG)KeNumberProcessors * WMIP_KLOG_BUFFERS_PER_CPU;
+
+    FileName = DefaultFileName;
+    Status = IopGetRegistryValue(KeyHandle, L"FileName", &Information);
+    if (NT_SUCCESS(Status))
+    {
+        if (((Information->Type == REG_SZ) || (Information->Type == REG_EXPAND_SZ)) &&
+            (Information->DataLength > sizeof(WCHAR)))
+        {
+            FileName.Buffer = (PWCHAR)((ULONG_PTR)Information + Information->DataOffset);
+            FileName.Length = (USHORT)(Information->DataLength - sizeof(UNICODE_NULL));
+            FileName.MaximumLength = FileName.Length;
+        }
+
+        Status = RtlDuplicateUnicodeString(0, &FileName, &WmipKlogFileName);
+        ExFreePool(Information);
+    }
+    else
+    {
+        Status = RtlDuplicateUnicodeString(0, &FileName, &WmipKlogFileName);
+    }
+    ZwClose(KeyHandle);
+    if (!NT_SUCCESS(Status)) return;
+
+    WmipKlogProcessorCount = KeNumberProcessors;
+    WmipKlogProcessors = ExAllocatePoolWithTag(NonPagedPool,
+                                               WmipKlogProcessorCount * sizeof(WMIP_KLOG_PROCESSOR),
+                                               TAG_WMI_KLOG);
+    if (!WmipKlogProcessors)
+    {
+        DPRINT1("Failed to allocate the kernel logger processor state\n");
+        RtlFreeUnicodeString(&WmipKlogFileName);
+        return;
+    }
+    RtlZeroMemory(WmipKlogProcessors, WmipKlogProcessorCount * sizeof(WMIP_KLOG_PROCESSOR));
+
+    WmipKlogBufferSize = BufferSize * 1024;
+    WmipKlogBufferCapacity = WmipKlogBufferSize - FIELD_OFFSET(WMIP_KLOG_BUFFER, Header);
+    InitializeSListHead(&WmipKlogFreeList);
+    InitializeSListHead(&WmipKlogFlushList);
+
+    for (i = 0; i < BufferCount; i++)
+    {
+        Buffer = ExAllocatePoolWithTag(NonPagedPool, WmipKlogBufferSize, TAG_WMI_KLOG);
+        if (!Buffer) break;
+        InterlockedPushEntrySList(&WmipKlogFreeList, &Buffer->ListEntry);
+    }
+    BufferCount = i;
+
+    /* Every processor needs a buffer, plus one to swap in */
+    if (BufferCount <= WmipKlogProcessorCount)
+    {
+        DPRINT1("Failed to allocate kernel logger buffers\n");
+        while ((Buffer = (PWMIP_KLOG_BUFFER)InterlockedPopEntrySList(&WmipKlogFreeList)))
+            ExFreePoolWithTag(Buffer, TAG_WMI_KLOG);
+        ExFreePoolWithTag(WmipKlogProcessors, TAG_WMI_KLOG);
+        WmipKlogProcessors = NULL;
+        RtlFreeUnicodeString(&WmipKlogFileName);
+        return;
+    }
+
+    for (i = 0; i < WmipKlogProcessorCount; i++)
+    {
+        Buffer = (PWMIP_KLOG_BUFFER)InterlockedPopEntrySList(&WmipKlogFreeList);
+        WmipKlogTakeBuffer(&WmipKlogProcessors[i], i, Buffer);
+    }
+
+    WmipKlogFileHeader.Signature = WMI_KLOG_FILE_SIGNATURE;
+    WmipKlogFileHeader.Version = WMI_KLOG_FILE_VERSION;
+    WmipKlogFileHeader.NumberOfProcessors = (USHORT)WmipKlogProcessorCount;
+    WmipKlogFileHeader.BufferSize = WmipKlogBufferSize;
+    WmipKlogFileHeader.EnableFlags = Flags;
+    KeQuerySystemTime(&WmipKlogFileHeader.StartTime);
+
+    KeInitializeDpc(&WmipKlogFlushDpc, WmipKlogFlushDpcRoutine, NULL);
+    KeInitializeEvent(&WmipKlogFlushEvent, SynchronizationEvent, FALSE);
+
+    Status = PsCreateSystemThread(&ThreadHandle,
+                                  THREAD_ALL_ACCESS,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  WmipKlogFlushThread,
+                                  NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        /* The buffers stay allocated but unused, the logger is simply off */
+        DPRINT1("Failed to create the kernel logger thread: 0x%lx\n", Status);
+        return;
+    }
+    ObCloseHandle(ThreadHandle, KernelMode);
+
+    /* Image loads are only reported while someone asked for them */
+    if (Flags & (WMI_KLOG_FLAG_IMAGE_LOAD | WMI_KLOG_FLAG_PROFILE))
+        PsImageNotifyEnabled = TRUE;
+
+    /* Everything is in place, let the events in */
+    KeMemoryBarrier();
+    WmipKernelLoggerFlags = Flags;
+
+    if (Flags & (WMI_KLOG_FLAG_IMAGE_LOAD | WMI_KLOG_FLAG_PROFILE))
+        WmipKlogImageRundown();
+
+    if (Flags & WMI_KLOG_FLAG_PROFILE)
+    {
+        if (ProfileInterval) KeSetIntervalProfile(ProfileInterval, WmipKlogProfileSource);
+        HalStartProfileInterrupt(WmipKlogProfileSource);
+    }
+
+    DPRINT1("NT Kernel Logger started, flags 0x%lx, %lu buffers of %lu KB to %wZ\n",
+            Flags, BufferCount, BufferSize, &WmipKlogFileName);
+}
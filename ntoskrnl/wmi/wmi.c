@@ -57,6 +57,9 @@ WmiInitialize(
         return FALSE;
     }
 
+    /* Start the kernel logger if it is set up to run at boot */
+    WmipStartKernelLogger();
+
     return TRUE;
 }
 
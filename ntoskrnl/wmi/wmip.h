@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <wmiklog.h>
+
 extern POBJECT_TYPE WmipGuidObjectType;
 
 #define GUID_STRING_LENGTH 36
@@ -1936,6 +1936,20 @@ __INTRIN_INLINE void _mm_pause(void)
 }
 #endif
 
+#if !HAS_BUILTIN(_mm_monitor)
+__INTRIN_INLINE void _mm_monitor(void const *p, unsigned int extensions, unsigned int hints)
+{
+	__asm__ __volatile__("monitor" : : "a"(p), "c"(extensions), "d"(hints));
+}
+#endif
+
+#if !HAS_BUILTIN(_mm_mwait)
+__INTRIN_INLINE void _mm_mwait(unsigned int extensions, unsigned int hints)
+{
+	__asm__ __volatile__("mwait" : : "c"(extensions), "a"(hints) : "memory");
+}
+#endif
+
 __INTRIN_INLINE void __nop(void)
 {
 	__asm__ __volatile__("nop");
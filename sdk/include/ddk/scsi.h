@@ -501,6 +501,7 @@ extern "C" {
 #define VPD_EXTENDED_INQUIRY_DATA           0x86
 #define VPD_MODE_PAGE_POLICY                0x87
 #define VPD_SCSI_PORTS                      0x88
+#define VPD_BLOCK_LIMITS                    0xB0
 
 #define RESERVATION_ACTION_READ_KEYS                    0x00
 #define RESERVATION_ACTION_READ_RESERVATIONS            0x01
@@ -2143,6 +2144,24 @@ typedef struct _VPD_SUPPORTED_PAGES_PAGE {
   UCHAR SupportedPageList[0];
 } VPD_SUPPORTED_PAGES_PAGE, *PVPD_SUPPORTED_PAGES_PAGE;
 
+typedef struct _VPD_BLOCK_LIMITS_PAGE {
+  UCHAR DeviceType:5;
+  UCHAR DeviceTypeQualifier:3;
+  UCHAR PageCode;
+  UCHAR PageLength[2];
+  UCHAR Reserved0;
+  UCHAR MaximumCompareAndWriteLength;
+  UCHAR OptimalTransferLengthGranularity[2];
+  UCHAR MaximumTransferLength[4];
+  UCHAR OptimalTransferLength[4];
+  UCHAR MaxPrefetchXDReadXDWriteTransferLength[4];
+  UCHAR MaximumUnmapLBACount[4];
+  UCHAR MaximumUnmapBlockDescriptorCount[4];
+  UCHAR OptimalUnmapGranularity[4];
+  UCHAR UnmapGranularityAlignment[4];
+  UCHAR Reserved1[28];
+} VPD_BLOCK_LIMITS_PAGE, *PVPD_BLOCK_LIMITS_PAGE;
+
 typedef struct _PRI_REGISTRATION_LIST {
   UCHAR Generation[4];
   UCHAR AdditionalLength[4];
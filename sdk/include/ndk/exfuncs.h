@@ -113,6 +113,18 @@ ExEnumHandleTable(
     _Out_opt_ PHANDLE Handle
 );
 
+//
+// Work Item Functions
+//
+NTKERNELAPI
+VOID
+NTAPI
+ExQueueWorkItemEx(
+    _Inout_ PWORK_QUEUE_ITEM WorkItem,
+    _In_ WORK_QUEUE_TYPE QueueType,
+    _In_ ULONG Processor
+);
+
 //
 // HardError Functions
 //
@@ -391,6 +391,11 @@ typedef BOOLEAN
     _In_ PVOID Context
 );
 
+//
+// Processor hint for ExQueueWorkItemEx meaning the current processor
+//
+#define EX_WORK_ANY_PROCESSOR                   ((ULONG)-1)
+
 //
 // Executive Work Queue Structures
 //
@@ -1161,6 +1166,33 @@ typedef struct _SYSTEM_DPC_BEHAVIOR_INFORMATION
     ULONG IdealDpcRate;
 } SYSTEM_DPC_BEHAVIOR_INFORMATION, *PSYSTEM_DPC_BEHAVIOR_INFORMATION;
 
+#ifdef __REACTOS__
+//
+// Given a larger buffer, ReactOS returns the durations it collected with
+// /DPCSTATS after the behavior information, all times in microseconds
+//
+#define SYSTEM_DPC_ROUTINE_DPC          1
+#define SYSTEM_DPC_ROUTINE_THREADED_DPC 2
+#define SYSTEM_DPC_ROUTINE_ISR          3
+
+typedef struct _SYSTEM_DPC_ROUTINE_INFORMATION
+{
+    PVOID Routine;
+    ULONG Type;
+    ULONG Count;
+    ULONGLONG TotalTime;
+    ULONG MaximumTime;
+    ULONG Histogram[16];
+} SYSTEM_DPC_ROUTINE_INFORMATION, *PSYSTEM_DPC_ROUTINE_INFORMATION;
+
+typedef struct _SYSTEM_DPC_BEHAVIOR_INFORMATION_EX
+{
+    SYSTEM_DPC_BEHAVIOR_INFORMATION Behavior;
+    ULONG NumberOfRoutines;
+    SYSTEM_DPC_ROUTINE_INFORMATION Routines[1];
+} SYSTEM_DPC_BEHAVIOR_INFORMATION_EX, *PSYSTEM_DPC_BEHAVIOR_INFORMATION_EX;
+#endif
+
 // Class 25
 typedef struct _SYSTEM_MEMORY_INFO
 {
@@ -152,6 +152,30 @@ BOOLEAN
     _Out_ PPHYSICAL_ADDRESS TranslatedAddress
 );
 
+//
+// HAL NUMA Topology Interface Types
+//
+typedef
+NTSTATUS
+(NTAPI *PHALNUMAQUERYPROCESSORNODE)(
+    _In_ ULONG ProcessorNumber,
+    _Out_ PUSHORT Identifier,
+    _Out_ PUCHAR Node
+);
+
+typedef
+ULONG
+(NTAPI *PHALNUMAPAGETONODE)(
+    _In_ ULONGLONG PhysicalPageNumber
+);
+
+typedef struct _HAL_NUMA_TOPOLOGY_INTERFACE
+{
+    ULONG NumberOfNodes;
+    PHALNUMAQUERYPROCESSORNODE QueryProcessorNode;
+    PHALNUMAPAGETONODE PageToNode;
+} HAL_NUMA_TOPOLOGY_INTERFACE, *PHAL_NUMA_TOPOLOGY_INTERFACE;
+
 //
 // Hal Private dispatch Table
 //
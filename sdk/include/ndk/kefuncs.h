@@ -316,6 +316,19 @@ KeSetTimeIncrement(
     _In_ ULONG MinIncrement
 );
 
+#if (NTDDI_VERSION < NTDDI_WIN7)
+NTKERNELAPI
+BOOLEAN
+NTAPI
+KeSetCoalescableTimer(
+    _Inout_ PKTIMER Timer,
+    _In_ LARGE_INTEGER DueTime,
+    _In_ ULONG Period,
+    _In_ ULONG TolerableDelay,
+    _In_opt_ PKDPC Dpc
+);
+#endif
+
 NTSTATUS
 NTAPI
 Ke386CallBios(
@@ -162,6 +162,7 @@ typedef struct _LDR_DATA_TABLE_ENTRY
     };
     PACTIVATION_CONTEXT EntryPointActivationContext;
     PVOID PatchInformation;
+    ULONG BaseNameHashValue;
 } LDR_DATA_TABLE_ENTRY, *PLDR_DATA_TABLE_ENTRY;
 
 //
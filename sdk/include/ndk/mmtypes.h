@@ -67,6 +67,11 @@ extern "C" {
 #define MAP_PROCESS                                         1
 #define MAP_SYSTEM                                          2
 
+//
+// Preferred NUMA node of an allocation, plus one, in NtAllocateVirtualMemory
+//
+#define MEM_PREFERRED_NODE_MASK                             0x3F
+
 //
 // Flags for ProcessExecutionOptions
 //
@@ -779,6 +784,7 @@ typedef struct _MMVAD_LONG
     {
         PVOID Banked;
         PMMEXTEND_INFO ExtendedInfo;
+        ULONG_PTR PreferredNode;
     } u4;
 } MMVAD_LONG, *PMMVAD_LONG;
 
@@ -539,6 +539,7 @@ typedef struct _OBJECT_SYMBOLIC_LINK
     UNICODE_STRING LinkTargetRemaining;
     PVOID LinkTargetObject;
     ULONG DosDeviceDriveIndex;
+    ULONG LinkTargetGeneration;
 } OBJECT_SYMBOLIC_LINK, *POBJECT_SYMBOLIC_LINK;
 
 //
@@ -316,6 +316,16 @@ RtlLookupElementGenericTableFull(
     _Out_ TABLE_SEARCH_RESULT *SearchResult
 );
 
+/* Doesn't restructure the table, so it is safe under a shared lock */
+_Must_inspect_result_
+NTSYSAPI
+PVOID
+NTAPI
+RtlLookupElementGenericTableWithoutSplaying(
+    _In_ PRTL_GENERIC_TABLE Table,
+    _In_ PVOID Buffer
+);
+
 _Must_inspect_result_
 NTSYSAPI
 PVOID
@@ -600,6 +610,7 @@ RtlIsGenericTableEmptyAvl(
 #define RtlDeleteElementGenericTable            RtlDeleteElementGenericTableAvl
 #define RtlLookupElementGenericTable            RtlLookupElementGenericTableAvl
 #define RtlLookupElementGenericTableFull        RtlLookupElementGenericTableFullAvl
+#define RtlLookupElementGenericTableWithoutSplaying RtlLookupElementGenericTableAvl
 #define RtlEnumerateGenericTable                RtlEnumerateGenericTableAvl
 #define RtlEnumerateGenericTableWithoutSplaying RtlEnumerateGenericTableWithoutSplayingAvl
 #define RtlGetElementGenericTable               RtlGetElementGenericTableAvl
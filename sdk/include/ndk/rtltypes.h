@@ -135,6 +135,11 @@ extern "C" {
 #define HEAP_CREATE_ENABLE_EXECUTE                          0x00040000
 #endif
 
+//
+// ReactOS Heap Creation Flags
+//
+#define HEAP_CREATE_ENABLE_LFH                              0x00080000
+
 //
 // User-Defined Heap Flags and Classes
 //
@@ -0,0 +1,47 @@
+/*
+ * PROJECT:     ReactOS Kernel
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Boot performance timeline definitions shared with user mode
+ */
+
+#ifndef _BOOTPERF_H
+#define _BOOTPERF_H
+
+/*
+ * The kernel records a boot timeline when booted with /BOOTPERF. User-mode
+ * components add their own events by calling NtSetSystemInformation with
+ * SystemPerformanceTraceInformation and a BOOTPERF_MARK, which requires
+ * SeTcbPrivilege; only checkpoint, phase and service events are accepted.
+ * The call fails with STATUS_NOT_SUPPORTED when no timeline is being
+ * recorded. The timeline is written to \SystemRoot\bootperf.csv once a mark
+ * with BOOTPERF_MARK_COMPLETE arrives.
+ */
+
+#define BOOTPERF_NAME_LENGTH 40
+
+typedef enum _BOOTPERF_EVENT_TYPE
+{
+    BootPerfCheckpoint,
+    BootPerfLoader,
+    BootPerfPhase,
+    BootPerfDriverEntry,
+    BootPerfAddDevice,
+    BootPerfProcess,
+    BootPerfService,
+    BootPerfMaximum
+} BOOTPERF_EVENT_TYPE;
+
+/* Opens an interval, closed by an END mark with the same type and name */
+#define BOOTPERF_MARK_BEGIN     0x00000001
+#define BOOTPERF_MARK_END       0x00000002
+/* Boot is done, write the timeline and stop recording */
+#define BOOTPERF_MARK_COMPLETE  0x00000004
+
+typedef struct _BOOTPERF_MARK
+{
+    ULONG Type;
+    ULONG Flags;
+    WCHAR Name[BOOTPERF_NAME_LENGTH];
+} BOOTPERF_MARK, *PBOOTPERF_MARK;
+
+#endif /* _BOOTPERF_H */
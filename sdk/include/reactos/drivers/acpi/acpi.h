@@ -238,6 +238,60 @@ typedef struct _ACPI_SRAT
     ULONG Reserved[2];
 } ACPI_SRAT, *PACPI_SRAT;
 
+//
+// SRAT Entry Types and Flags
+//
+#define SRAT_PROCESSOR_AFFINITY 0
+#define SRAT_MEMORY_AFFINITY    1
+#define SRAT_X2APIC_AFFINITY    2
+
+#define SRAT_ENTRY_ENABLED      0x01
+
+//
+// SRAT Entries (packed)
+//
+#include <pshpack1.h>
+typedef struct _SRAT_ENTRY_HEADER
+{
+    UCHAR Type;
+    UCHAR Length;
+} SRAT_ENTRY_HEADER, *PSRAT_ENTRY_HEADER;
+
+typedef struct _SRAT_PROCESSOR_ENTRY
+{
+    SRAT_ENTRY_HEADER Header;
+    UCHAR ProximityDomainLow;
+    UCHAR ApicId;
+    ULONG Flags;
+    UCHAR SapicEid;
+    UCHAR ProximityDomainHigh[3];
+    ULONG ClockDomain;
+} SRAT_PROCESSOR_ENTRY, *PSRAT_PROCESSOR_ENTRY;
+
+typedef struct _SRAT_MEMORY_ENTRY
+{
+    SRAT_ENTRY_HEADER Header;
+    ULONG ProximityDomain;
+    USHORT Reserved;
+    ULONGLONG BaseAddress;
+    ULONGLONG Length;
+    ULONG Reserved2;
+    ULONG Flags;
+    ULONGLONG Reserved3;
+} SRAT_MEMORY_ENTRY, *PSRAT_MEMORY_ENTRY;
+
+typedef struct _SRAT_X2APIC_ENTRY
+{
+    SRAT_ENTRY_HEADER Header;
+    USHORT Reserved;
+    ULONG ProximityDomain;
+    ULONG X2ApicId;
+    ULONG Flags;
+    ULONG ClockDomain;
+    ULONG Reserved2;
+} SRAT_X2APIC_ENTRY, *PSRAT_X2APIC_ENTRY;
+#include <poppack.h>
+
 typedef struct _BGRT_TABLE
 {
     DESCRIPTION_HEADER Header;
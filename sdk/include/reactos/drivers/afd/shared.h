@@ -132,6 +132,14 @@ typedef struct _AFD_ENUM_NETWORK_EVENTS_INFO {
     NTSTATUS EventStatus[AFD_MAX_EVENTS];
 } AFD_ENUM_NETWORK_EVENTS_INFO, *PAFD_ENUM_NETWORK_EVENTS_INFO;
 
+/* Arms readiness notifications for a socket associated with a completion
+ * port. Each armed event is posted to the port once when it becomes
+ * pending (Information holds the events) and must be armed again after. */
+typedef struct _AFD_POLL_NOTIFY_INFO {
+    PVOID				ApcContext;
+    ULONG				Events;
+} AFD_POLL_NOTIFY_INFO, *PAFD_POLL_NOTIFY_INFO;
+
 typedef struct _AFD_DISCONNECT_INFO {
     ULONG				DisconnectType;
     LARGE_INTEGER			Timeout;
@@ -261,6 +269,7 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_DEFER_ACCEPT		35
 #define AFD_GET_PENDING_CONNECT_DATA	41
 #define AFD_VALIDATE_GROUP		42
+#define AFD_POLL_NOTIFY                 43
 
 /* AFD IOCTLs */
 
@@ -336,6 +345,8 @@ typedef struct _AFD_TDI_HANDLE_DATA
   _AFD_CONTROL_CODE(AFD_ENUM_NETWORK_EVENTS, METHOD_NEITHER)
 #define IOCTL_AFD_VALIDATE_GROUP \
   _AFD_CONTROL_CODE(AFD_VALIDATE_GROUP, METHOD_NEITHER)
+#define IOCTL_AFD_POLL_NOTIFY \
+  _AFD_CONTROL_CODE(AFD_POLL_NOTIFY, METHOD_NEITHER)
 
 typedef struct _AFD_SOCKET_INFORMATION {
     BOOL CommandChannel;
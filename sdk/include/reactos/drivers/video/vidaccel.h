@@ -0,0 +1,45 @@
+#ifndef _VIDACCEL_H_INCLUDED_
+#define _VIDACCEL_H_INCLUDED_
+
+/*
+ * Private 2D acceleration interface between ReactOS display drivers and
+ * video miniports that have a command queue (e.g. VMware SVGA II).
+ */
+
+#define IOCTL_VIDEO_QUERY_ACCEL_CAPS    CTL_CODE(FILE_DEVICE_VIDEO, 0x900, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_VIDEO_ACCEL_COMMANDS      CTL_CODE(FILE_DEVICE_VIDEO, 0x901, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/* VIDEO_ACCEL_CAPS.Flags, also VIDEO_ACCEL_COMMAND.Command */
+#define VIDEO_ACCEL_UPDATE              0x00000001
+#define VIDEO_ACCEL_RECT_FILL           0x00000002
+#define VIDEO_ACCEL_RECT_COPY           0x00000004
+
+/* Maximum number of commands in one IOCTL_VIDEO_ACCEL_COMMANDS request */
+#define VIDEO_ACCEL_MAX_COMMANDS        64
+
+/* TYPEDEFS **************************************************************/
+
+typedef struct _VIDEO_ACCEL_CAPS
+{
+    ULONG Flags;
+} VIDEO_ACCEL_CAPS, *PVIDEO_ACCEL_CAPS;
+
+typedef struct _VIDEO_ACCEL_COMMAND
+{
+    ULONG Command;
+    ULONG Color;    /* RECT_FILL, in device pixel format */
+    LONG SrcX;      /* RECT_COPY */
+    LONG SrcY;
+    LONG DestX;
+    LONG DestY;
+    ULONG Width;
+    ULONG Height;
+} VIDEO_ACCEL_COMMAND, *PVIDEO_ACCEL_COMMAND;
+
+/*
+ * The commands of an IOCTL_VIDEO_ACCEL_COMMANDS request are executed in
+ * order and have completed when the request returns, so the caller may
+ * touch the frame buffer right after it.
+ */
+
+#endif /* _VIDACCEL_H_INCLUDED_ */
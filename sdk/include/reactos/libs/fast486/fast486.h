@@ -106,15 +106,18 @@
 
 #define FAST486_PAGE_SIZE 4096
 #define FAST486_CACHE_SIZE 32
+#define FAST486_CACHE_LINES 64
 
 /*
  * These are condiciones sine quibus non that should be respected, because
  * otherwise when fetching DWORDs you would read extra garbage bytes
  * (by reading outside of the prefetch buffer). The prefetch cache must
- * also not cross a page boundary.
+ * also not cross a page boundary, which is why the lines are aligned
+ * blocks of a power-of-two size.
  */
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(ULONG))
-         && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
+         && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE)
+         && ((FAST486_CACHE_SIZE & (FAST486_CACHE_SIZE - 1)) == 0));
 
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
@@ -511,6 +514,14 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+typedef struct _FAST486_PREFETCH_LINE
+{
+    ULONG Address;
+    UCHAR Cpl;
+    BOOLEAN Valid;
+    UCHAR Data[FAST486_CACHE_SIZE];
+} FAST486_PREFETCH_LINE, *PFAST486_PREFETCH_LINE;
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
@@ -539,10 +550,13 @@ struct _FAST486_STATE
     BOOLEAN DoNotInterrupt;
     PULONG Tlb;
     BOOLEAN TlbEmpty;
+    PUCHAR *MemoryMap;
+    ULONG MemoryMapPages;
 #ifndef FAST486_NO_PREFETCH
     BOOLEAN PrefetchValid;
     ULONG PrefetchAddress;
     UCHAR PrefetchCache[FAST486_CACHE_SIZE];
+    FAST486_PREFETCH_LINE PrefetchLines[FAST486_CACHE_LINES];
 #endif
 #ifndef FAST486_NO_FPU
     FAST486_FPU_DATA_REG FpuRegisters[FAST486_NUM_FPU_REGS];
@@ -619,6 +633,10 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+VOID
+NTAPI
+Fast486SetMemoryMap(PFAST486_STATE State, PUCHAR *MemoryMap, ULONG NumPages);
+
 #endif // _FAST486_H_
 
 /* EOF */
@@ -18,6 +18,17 @@ typedef struct _DNS_CACHE_ENTRY
     unsigned short wFlags;          /* DNS Record Flags */
 } DNS_CACHE_ENTRY, *PDNS_CACHE_ENTRY;
 
+typedef struct _DNS_CACHE_STATISTICS
+{
+    unsigned long dwEntries;        /* Entries in the cache */
+    unsigned long dwNegativeEntries;/* Of those, name errors and empty answers */
+    unsigned long dwHits;           /* Lookups answered with records */
+    unsigned long dwNegativeHits;   /* Lookups answered with a cached error */
+    unsigned long dwMisses;         /* Lookups not found in the cache */
+    unsigned long dwExpired;        /* Entries dropped when their TTL ran out */
+    unsigned long dwPrefetches;     /* Entries refreshed before they expired */
+} DNS_CACHE_STATISTICS, *PDNS_CACHE_STATISTICS;
+
 
 #ifndef __WIDL__
 // Hack
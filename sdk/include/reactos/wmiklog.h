@@ -0,0 +1,124 @@
+/*
+ * PROJECT:     ReactOS Kernel
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     NT Kernel Logger file format, shared with the tools reading it
+ */
+
+#pragma once
+
+/*
+ * NT Kernel Logger file format. The file starts with a WMI_KLOG_FILE_HEADER
+ * and is followed by buffers, each a WMI_KLOG_BUFFER_HEADER followed by
+ * 8-byte aligned events until Header.Size. Events of one processor appear
+ * in order; buffers of different processors are interleaved.
+ */
+#define WMI_KLOG_FILE_SIGNATURE         'GOLK'
+#define WMI_KLOG_FILE_VERSION           1
+
+#define WMI_KLOG_EVENT_PROCESS_START    1
+#define WMI_KLOG_EVENT_PROCESS_END      2
+#define WMI_KLOG_EVENT_IMAGE_LOAD       3
+#define WMI_KLOG_EVENT_CSWITCH          4
+#define WMI_KLOG_EVENT_DISK_IO          5
+#define WMI_KLOG_EVENT_PAGE_FAULT       6
+#define WMI_KLOG_EVENT_PROFILE          7
+
+typedef struct _WMI_KLOG_FILE_HEADER
+{
+    ULONG Signature;
+    USHORT Version;
+    USHORT NumberOfProcessors;
+    ULONG BufferSize;
+    ULONG EnableFlags;
+    LARGE_INTEGER StartTime;
+} WMI_KLOG_FILE_HEADER, *PWMI_KLOG_FILE_HEADER;
+
+/*
+ * TimeStamp and InterruptTime are sampled together when a processor takes
+ * the buffer, which lets a reader convert event time stamps. EventsLost is
+ * the number of events the processor dropped before it got this buffer.
+ */
+typedef struct _WMI_KLOG_BUFFER_HEADER
+{
+    ULONG Size;
+    USHORT ProcessorNumber;
+    USHORT Reserved;
+    ULONG EventsLost;
+    ULONG Sequence;
+    ULONGLONG TimeStamp;
+    ULONGLONG InterruptTime;
+} WMI_KLOG_BUFFER_HEADER, *PWMI_KLOG_BUFFER_HEADER;
+
+/* The time stamp is the cycle counter where there is one */
+typedef struct _WMI_KLOG_EVENT_HEADER
+{
+    USHORT Size;
+    USHORT Type;
+    ULONG ThreadId;
+    ULONG ProcessId;
+    ULONG Reserved;
+    ULONGLONG TimeStamp;
+} WMI_KLOG_EVENT_HEADER, *PWMI_KLOG_EVENT_HEADER;
+
+typedef struct _WMI_KLOG_PROCESS
+{
+    ULONG UniqueProcessId;
+    ULONG ParentId;
+    ULONG SessionId;
+    LONG ExitStatus;
+    UCHAR ImageFileName[16];
+} WMI_KLOG_PROCESS, *PWMI_KLOG_PROCESS;
+
+typedef struct _WMI_KLOG_IMAGE_LOAD
+{
+    ULONGLONG ImageBase;
+    ULONG ImageSize;
+    ULONG ProcessId;
+    USHORT NameLength;
+    WCHAR FileName[ANYSIZE_ARRAY];
+} WMI_KLOG_IMAGE_LOAD, *PWMI_KLOG_IMAGE_LOAD;
+
+typedef struct _WMI_KLOG_CSWITCH
+{
+    ULONG NewThreadId;
+    ULONG OldThreadId;
+    CHAR NewThreadPriority;
+    CHAR OldThreadPriority;
+    UCHAR OldThreadWaitReason;
+    UCHAR OldThreadState;
+} WMI_KLOG_CSWITCH, *PWMI_KLOG_CSWITCH;
+
+typedef struct _WMI_KLOG_DISK_IO
+{
+    ULONGLONG Irp;
+    ULONGLONG DeviceObject;
+    ULONGLONG ByteOffset;
+    ULONG Length;
+    ULONG TransferSize;
+    LONG Status;
+    UCHAR MajorFunction;
+} WMI_KLOG_DISK_IO, *PWMI_KLOG_DISK_IO;
+
+typedef struct _WMI_KLOG_PAGE_FAULT
+{
+    ULONGLONG VirtualAddress;
+    ULONG FaultCode;
+    UCHAR PreviousMode;
+} WMI_KLOG_PAGE_FAULT, *PWMI_KLOG_PAGE_FAULT;
+
+/*
+ * A profile interrupt sample. Frames holds the return addresses found by
+ * following the frame pointer chain of the interrupted kernel code, the
+ * innermost first. User mode samples only carry the instruction pointer.
+ */
+#define WMI_KLOG_MAX_PROFILE_FRAMES     32
+
+typedef struct _WMI_KLOG_PROFILE
+{
+    ULONGLONG InstructionPointer;
+    ULONG Source;
+    USHORT FrameCount;
+    UCHAR UserMode;
+    UCHAR Reserved;
+    ULONGLONG Frames[ANYSIZE_ARRAY];
+} WMI_KLOG_PROFILE, *PWMI_KLOG_PROFILE;
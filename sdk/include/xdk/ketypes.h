@@ -185,8 +185,8 @@ $if(_WDMDDK_)
     NT_ASSERT((Object)->Header.Type == SemaphoreObject)
 
 #define ASSERT_EVENT(Object) \
-    NT_ASSERT(((Object)->Header.Type == NotificationEvent) || \
-              ((Object)->Header.Type == SynchronizationEvent))
+    NT_ASSERT((((Object)->Header.Type & KOBJECT_TYPE_MASK) == NotificationEvent) || \
+              (((Object)->Header.Type & KOBJECT_TYPE_MASK) == SynchronizationEvent))
 
 #define DPC_NORMAL 0
 #define DPC_THREADED 1
@@ -1135,6 +1135,15 @@ RtlLookupElementGenericTableFull(
   _Out_ PVOID *NodeOrParent,
   _Out_ TABLE_SEARCH_RESULT *SearchResult);
 
+/* Doesn't restructure the table, so it is safe under a shared lock */
+_Must_inspect_result_
+NTSYSAPI
+PVOID
+NTAPI
+RtlLookupElementGenericTableWithoutSplaying(
+  _In_ PRTL_GENERIC_TABLE Table,
+  _In_ PVOID Buffer);
+
 _Must_inspect_result_
 NTSYSAPI
 PVOID
@@ -3466,6 +3475,7 @@ $if (_NTDDK_)
 #define RtlDeleteElementGenericTable            RtlDeleteElementGenericTableAvl
 #define RtlLookupElementGenericTable            RtlLookupElementGenericTableAvl
 #define RtlLookupElementGenericTableFull        RtlLookupElementGenericTableFullAvl
+#define RtlLookupElementGenericTableWithoutSplaying RtlLookupElementGenericTableAvl
 #define RtlEnumerateGenericTable                RtlEnumerateGenericTableAvl
 #define RtlEnumerateGenericTableWithoutSplaying RtlEnumerateGenericTableWithoutSplayingAvl
 #define RtlGetElementGenericTable               RtlGetElementGenericTableAvl
@@ -110,6 +110,12 @@
         IN ULONG NumberToFind,
         IN ULONG HintIndex);
 
+    ULONG NTAPI
+    RtlFindNextForwardRunSet(
+        IN PRTL_BITMAP BitMapHeader,
+        IN ULONG FromIndex,
+        IN PULONG StartingRunIndex);
+
     VOID NTAPI
     RtlSetBits(
         IN PRTL_BITMAP BitMapHeader,
@@ -120,6 +126,8 @@
     RtlClearAllBits(
         IN PRTL_BITMAP BitMapHeader);
 
+    unsigned char BitScanForward(ULONG * Index, unsigned long Mask);
+
     #define RtlCheckBit(BMH,BP) (((((PLONG)(BMH)->Buffer)[(BP) / 32]) >> ((BP) % 32)) & 0x1)
     #define UNREFERENCED_PARAMETER(P) {(P)=(P);}
 
@@ -170,6 +178,13 @@
     #include <ntifs.h>
     #include <bugcodes.h>
     #undef PAGED_CODE
+
+    /* Not in the kernel headers, but it is in the RTL we are linked with */
+    ULONG NTAPI
+    RtlFindNextForwardRunSet(
+        IN PRTL_BITMAP BitMapHeader,
+        IN ULONG FromIndex,
+        IN PULONG StartingRunIndex);
     #define PAGED_CODE()
 
     /* Prevent inclusion of Windows headers through <wine/unicode.h> */
@@ -307,6 +322,34 @@ typedef struct _HV_TRACK_CELL_REF
     USHORT StaticCount;
 } HV_TRACK_CELL_REF, *PHV_TRACK_CELL_REF;
 
+//
+// Copy of the dirty blocks of a hive, so that they can be written out
+// while the hive keeps changing. The blocks follow each other in Blocks,
+// in the order of the set bits of DirtyVector.
+//
+typedef struct _HV_DIRTY_SNAPSHOT
+{
+    HBASE_BLOCK BaseBlock;
+    RTL_BITMAP DirtyVector;
+    ULONG BlockCount;
+    PUCHAR Blocks;
+} HV_DIRTY_SNAPSHOT, *PHV_DIRTY_SNAPSHOT;
+
+//
+// The log file has the base block header, the dirty vector of the flush,
+// then the dirty blocks themselves, back to back
+//
+#define HV_LOG_DIRTY_SIGNATURE          0x54524944  // "DIRT"
+#define HV_LOG_VECTOR_SIZE(Length)      (ROUND_UP((Length) / HBLOCK_SIZE, 32) / 8)
+#define HV_LOG_DATA_OFFSET(Length)      \
+    ROUND_UP(HV_LOG_HEADER_SIZE + sizeof(ULONG) + HV_LOG_VECTOR_SIZE(Length), HBLOCK_SIZE)
+
+#if (NTDDI_VERSION < NTDDI_VISTA)
+#define HvHasLog(Hive)                  ((Hive)->Log)
+#else
+#define HvHasLog(Hive)                  FALSE
+#endif
+
 extern ULONG CmlibTraceLevel;
 
 //
@@ -444,6 +487,26 @@ BOOLEAN CMAPI
 HvSyncHive(
    PHHIVE RegistryHive);
 
+BOOLEAN CMAPI
+HvCaptureDirtyBlocks(
+   PHHIVE RegistryHive,
+   PHV_DIRTY_SNAPSHOT *Snapshot);
+
+BOOLEAN CMAPI
+HvWriteDirtyBlocks(
+   PHHIVE RegistryHive,
+   PHV_DIRTY_SNAPSHOT Snapshot);
+
+VOID CMAPI
+HvRestoreDirtyBlocks(
+   PHHIVE RegistryHive,
+   PHV_DIRTY_SNAPSHOT Snapshot);
+
+VOID CMAPI
+HvFreeDirtyBlocks(
+   PHHIVE RegistryHive,
+   PHV_DIRTY_SNAPSHOT Snapshot);
+
 BOOLEAN CMAPI
 HvWriteHive(
    PHHIVE RegistryHive);
@@ -498,6 +561,14 @@ CmPrepareHive(
 //
 // Cell Index Routines
 //
+LONG
+NTAPI
+CmpDoCompareKeyName(
+    IN PHHIVE Hive,
+    IN PCUNICODE_STRING SearchName,
+    IN HCELL_INDEX Cell
+);
+
 HCELL_INDEX
 NTAPI
 CmpFindSubKeyByName(
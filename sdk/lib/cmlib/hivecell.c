@@ -190,6 +190,7 @@ HvpAddFree(
     FreeBlockData = (PHCELL_INDEX)(FreeBlock + 1);
     *FreeBlockData = RegistryHive->Storage[Storage].FreeDisplay[Index];
     RegistryHive->Storage[Storage].FreeDisplay[Index] = FreeIndex;
+    RegistryHive->Storage[Storage].FreeSummary |= (1 << Index);
 
     /* FIXME: Eventually get rid of free bins. */
 
@@ -219,6 +220,8 @@ HvpRemoveFree(
         if (*pFreeCellOffset == CellIndex)
         {
             *pFreeCellOffset = *FreeCellData;
+            if (RegistryHive->Storage[Storage].FreeDisplay[Index] == HCELL_NIL)
+                RegistryHive->Storage[Storage].FreeSummary &= ~(1 << Index);
             return;
         }
         pFreeCellOffset = FreeCellData;
@@ -245,31 +248,90 @@ HvpRemoveFree(
     ASSERT(FALSE);
 }
 
+static __inline BOOLEAN CMAPI
+HvpIsCellInBin(
+    PHHIVE RegistryHive,
+    HCELL_INDEX CellIndex,
+    HCELL_INDEX BinCellIndex)
+{
+    PHMAP_ENTRY BlockList;
+
+    if ((HvGetCellType(CellIndex) != HvGetCellType(BinCellIndex)) ||
+        (HvGetCellBlock(BinCellIndex) >= RegistryHive->Storage[HvGetCellType(BinCellIndex)].Length))
+    {
+        return FALSE;
+    }
+
+    BlockList = RegistryHive->Storage[HvGetCellType(CellIndex)].BlockList;
+    return BlockList[HvGetCellBlock(CellIndex)].BinAddress ==
+           BlockList[HvGetCellBlock(BinCellIndex)].BinAddress;
+}
+
+/* How far down a free list we look for a cell in the bin of the vicinity */
+#define HV_VICINITY_PROBES  8
+
 static HCELL_INDEX CMAPI
 HvpFindFree(
     PHHIVE RegistryHive,
     ULONG Size,
-    HSTORAGE_TYPE Storage)
+    HSTORAGE_TYPE Storage,
+    HCELL_INDEX Vicinity)
 {
     PHCELL_INDEX FreeCellData;
     HCELL_INDEX FreeCellOffset;
     PHCELL_INDEX pFreeCellOffset;
-    ULONG Index;
+    PHCELL_INDEX pFoundOffset;
+    ULONG Index, Probes;
+    ULONG Summary;
 
-    for (Index = HvpComputeFreeListIndex(Size); Index < 24; Index++)
+    /* Only the lists that have something are worth looking at */
+    Index = HvpComputeFreeListIndex(Size);
+    Summary = RegistryHive->Storage[Storage].FreeSummary & ~((1 << Index) - 1);
+
+    while (BitScanForward(&Index, Summary))
     {
+        Summary &= ~(1 << Index);
+
+        /*
+         * The lists below 16 hold a single size, and any cell of the lists
+         * after ours is big enough, so only our own list may have to be
+         * walked. Take the first cell that fits, unless there's one in
+         * the bin of the vicinity a little further.
+         */
+        pFoundOffset = NULL;
+        Probes = 0;
         pFreeCellOffset = &RegistryHive->Storage[Storage].FreeDisplay[Index];
         while (*pFreeCellOffset != HCELL_NIL)
         {
             FreeCellData = (PHCELL_INDEX)HvGetCell(RegistryHive, *pFreeCellOffset);
             if ((ULONG)HvpGetCellFullSize(RegistryHive, FreeCellData) >= Size)
             {
-                FreeCellOffset = *pFreeCellOffset;
-                *pFreeCellOffset = *FreeCellData;
-                return FreeCellOffset;
+                if (pFoundOffset == NULL)
+                    pFoundOffset = pFreeCellOffset;
+
+                if ((Vicinity == HCELL_NIL) ||
+                    HvpIsCellInBin(RegistryHive, *pFreeCellOffset, Vicinity))
+                {
+                    pFoundOffset = pFreeCellOffset;
+                    break;
+                }
             }
+
+            if ((pFoundOffset != NULL) && (++Probes >= HV_VICINITY_PROBES))
+                break;
+
             pFreeCellOffset = FreeCellData;
         }
+
+        if (pFoundOffset != NULL)
+        {
+            FreeCellOffset = *pFoundOffset;
+            FreeCellData = (PHCELL_INDEX)HvGetCell(RegistryHive, FreeCellOffset);
+            *pFoundOffset = *FreeCellData;
+            if (RegistryHive->Storage[Storage].FreeDisplay[Index] == HCELL_NIL)
+                RegistryHive->Storage[Storage].FreeSummary &= ~(1 << Index);
+            return FreeCellOffset;
+        }
     }
 
     return HCELL_NIL;
@@ -293,6 +355,8 @@ HvpCreateHiveFreeCellList(
         Hive->Storage[Stable].FreeDisplay[Index] = HCELL_NIL;
         Hive->Storage[Volatile].FreeDisplay[Index] = HCELL_NIL;
     }
+    Hive->Storage[Stable].FreeSummary = 0;
+    Hive->Storage[Volatile].FreeSummary = 0;
 
     BlockOffset = 0;
     BlockIndex = 0;
@@ -346,8 +410,8 @@ HvAllocateCell(
     /* Round to 16 bytes multiple. */
     Size = ROUND_UP(Size + sizeof(HCELL), 16);
 
-    /* First search in free blocks. */
-    FreeCellOffset = HvpFindFree(RegistryHive, Size, Storage);
+    /* First search in free blocks, preferably in the bin of the vicinity */
+    FreeCellOffset = HvpFindFree(RegistryHive, Size, Storage, Vicinity);
 
     /* If no free cell was found we need to extend the hive file. */
     if (FreeCellOffset == HCELL_NIL)
@@ -390,6 +454,65 @@ HvAllocateCell(
     return FreeCellOffset;
 }
 
+static BOOLEAN CMAPI
+HvpGrowCell(
+    PHHIVE RegistryHive,
+    HCELL_INDEX CellIndex,
+    ULONG Size)
+{
+    PHCELL Cell;
+    PHCELL Neighbor;
+    PHCELL NewCell;
+    PHBIN Bin;
+    ULONG CellType;
+    ULONG OldSize, CellSize, Offset;
+
+    CellType = HvGetCellType(CellIndex);
+    Bin = (PHBIN)RegistryHive->Storage[CellType].BlockList[HvGetCellBlock(CellIndex)].BinAddress;
+
+    /* Round to 16 bytes multiple, like HvAllocateCell */
+    Size = ROUND_UP(Size + sizeof(HCELL), 16);
+
+    Cell = HvpGetCellHeader(RegistryHive, CellIndex);
+    ASSERT(Cell->Size < 0);
+    OldSize = (ULONG)-Cell->Size;
+
+    /* The cell that follows has to be free, in the same bin, and big enough */
+    if ((CellIndex & ~HCELL_TYPE_MASK) + OldSize >= Bin->FileOffset + Bin->Size)
+        return FALSE;
+
+    Neighbor = (PHCELL)((ULONG_PTR)Cell + OldSize);
+    if ((Neighbor->Size <= 0) || (OldSize + (ULONG)Neighbor->Size < Size))
+        return FALSE;
+
+    HvpRemoveFree(RegistryHive, Neighbor, CellIndex + OldSize);
+    CellSize = OldSize + Neighbor->Size;
+
+    /* Give back what we don't need */
+    if (CellSize > Size + 16)
+    {
+        NewCell = (PHCELL)((ULONG_PTR)Cell + Size);
+        NewCell->Size = CellSize - Size;
+        HvpAddFree(RegistryHive, NewCell, CellIndex + Size);
+        if (CellType == Stable)
+            HvMarkCellDirty(RegistryHive, CellIndex + Size, FALSE);
+        CellSize = Size;
+    }
+
+    /* The cell now covers what was the free cell's header and link */
+    RtlZeroMemory((PUCHAR)Cell + OldSize, CellSize - OldSize);
+    Cell->Size = -(LONG)CellSize;
+
+    if (CellType == Stable)
+    {
+        for (Offset = 0; Offset < CellSize; Offset += HBLOCK_SIZE)
+            HvMarkCellDirty(RegistryHive, CellIndex + Offset, FALSE);
+        HvMarkCellDirty(RegistryHive, CellIndex + CellSize - 1, FALSE);
+    }
+
+    return TRUE;
+}
+
 HCELL_INDEX CMAPI
 HvReallocateCell(
     PHHIVE RegistryHive,
@@ -414,15 +537,18 @@ HvReallocateCell(
     ASSERT(OldCellSize > 0);
 
     /*
-     * If new data size is larger than the current, destroy current
-     * data block and allocate a new one.
+     * If new data size is larger than the current, grow into the free
+     * cell that follows, or else destroy current data block and allocate
+     * a new one, as close as possible.
      *
-     * FIXME: Merge with adjacent free cell if possible.
      * FIXME: Implement shrinking.
      */
     if (Size > (ULONG)OldCellSize)
     {
-        NewCellIndex = HvAllocateCell(RegistryHive, Size, Storage, HCELL_NIL);
+        if (HvpGrowCell(RegistryHive, CellIndex, Size))
+            return CellIndex;
+
+        NewCellIndex = HvAllocateCell(RegistryHive, Size, Storage, CellIndex);
         if (NewCellIndex == HCELL_NIL)
             return HCELL_NIL;
 
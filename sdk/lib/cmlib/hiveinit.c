@@ -208,6 +208,46 @@ HvpCreateHive(
     return STATUS_SUCCESS;
 }
 
+/**
+ * @name HvpInitializeHiveBins
+ *
+ * Internal helper function to finish the initialization of a hive once
+ * its bins are in the stable storage: builds the free cell list and the
+ * dirty vector. On failure, the bins and the base block are freed.
+ */
+static NTSTATUS CMAPI
+HvpInitializeHiveBins(
+    PHHIVE Hive,
+    IN PCUNICODE_STRING FileName OPTIONAL)
+{
+    ULONG BitmapSize;
+    PULONG BitmapBuffer;
+
+    if (HvpCreateHiveFreeCellList(Hive))
+    {
+        HvpFreeHiveBins(Hive);
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        return STATUS_NO_MEMORY;
+    }
+
+    BitmapSize = ROUND_UP(Hive->Storage[Stable].Length,
+                          sizeof(ULONG) * 8) / 8;
+    BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
+    if (BitmapBuffer == NULL)
+    {
+        HvpFreeHiveBins(Hive);
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        return STATUS_NO_MEMORY;
+    }
+
+    RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
+    RtlClearAllBits(&Hive->DirtyVector);
+
+    HvpInitFileName(Hive->BaseBlock, FileName);
+
+    return STATUS_SUCCESS;
+}
+
 /**
  * @name HvpInitializeMemoryHive
  *
@@ -226,8 +266,6 @@ HvpInitializeMemoryHive(
     SIZE_T BlockIndex;
     PHBIN Bin, NewBin;
     ULONG i;
-    ULONG BitmapSize;
-    PULONG BitmapBuffer;
     SIZE_T ChunkSize;
 
     ChunkSize = ChunkBase->Length;
@@ -306,29 +344,7 @@ HvpInitializeMemoryHive(
         BlockIndex += Bin->Size / HBLOCK_SIZE;
     }
 
-    if (HvpCreateHiveFreeCellList(Hive))
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
-
-    BitmapSize = ROUND_UP(Hive->Storage[Stable].Length,
-                          sizeof(ULONG) * 8) / 8;
-    BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
-    if (BitmapBuffer == NULL)
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
-
-    RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
-    RtlClearAllBits(&Hive->DirtyVector);
-
-    HvpInitFileName(Hive->BaseBlock, FileName);
-
-    return STATUS_SUCCESS;
+    return HvpInitializeHiveBins(Hive, FileName);
 }
 
 /**
@@ -400,10 +416,29 @@ HvpGetHiveHeader(IN PHHIVE Hive,
                             Hive->Cluster * HSECTOR_SIZE);
 
     /* Couldn't read: assume it's not a hive */
-    if (!Result) return NotHive;
+    if (!Result)
+    {
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        return NotHive;
+    }
 
     /* Do validation */
-    if (!HvpVerifyHiveHeader(BaseBlock)) return NotHive;
+    if (!HvpVerifyHiveHeader(BaseBlock))
+    {
+        /* A flush that didn't complete can be finished from the log */
+        if ((HvHasLog(Hive)) &&
+            (BaseBlock->Signature == HV_HBLOCK_SIGNATURE) &&
+            (BaseBlock->Type == HFILE_TYPE_PRIMARY) &&
+            (BaseBlock->Sequence1 != BaseBlock->Sequence2) &&
+            (HvpHiveHeaderChecksum(BaseBlock) == BaseBlock->CheckSum))
+        {
+            *HiveBaseBlock = BaseBlock;
+            return RecoverData;
+        }
+
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        return NotHive;
+    }
 
     /* Return information */
     *HiveBaseBlock = BaseBlock;
@@ -411,6 +446,191 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     return HiveSuccess;
 }
 
+/**
+ * @name HvpReadHiveBins
+ *
+ * Internal helper function to read the bins of a hive from its primary
+ * file. Each bin is read straight into its own allocation, so the hive
+ * is never in memory twice while it is being loaded.
+ */
+static NTSTATUS CMAPI
+HvpReadHiveBins(
+    PHHIVE Hive)
+{
+    HBIN BinHeader;
+    PHBIN Bin;
+    ULONG BlockIndex, BlockCount;
+    ULONG Offset;
+    ULONG i;
+
+    Hive->Storage[Stable].Length = Hive->BaseBlock->Length / HBLOCK_SIZE;
+    Hive->Storage[Stable].BlockList =
+        Hive->Allocate(Hive->Storage[Stable].Length *
+                       sizeof(HMAP_ENTRY), FALSE, TAG_CM);
+    if (Hive->Storage[Stable].BlockList == NULL)
+    {
+        DPRINT1("Allocating block list failed\n");
+        Hive->Storage[Stable].Length = 0;
+        return STATUS_NO_MEMORY;
+    }
+
+    /* HvpFreeHiveBins stops at the first bin that wasn't read */
+    RtlZeroMemory(Hive->Storage[Stable].BlockList,
+                  Hive->Storage[Stable].Length * sizeof(HMAP_ENTRY));
+
+    for (BlockIndex = 0; BlockIndex < Hive->Storage[Stable].Length; )
+    {
+        /* The bin header tells how much to read */
+        Offset = (BlockIndex + 1) * HBLOCK_SIZE;
+        if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset,
+                            &BinHeader, sizeof(BinHeader)))
+        {
+            HvpFreeHiveBins(Hive);
+            return STATUS_NOT_REGISTRY_FILE;
+        }
+
+        BlockCount = BinHeader.Size / HBLOCK_SIZE;
+        if (BinHeader.Signature != HV_HBIN_SIGNATURE ||
+            (BinHeader.Size % HBLOCK_SIZE) != 0 ||
+            BlockCount == 0 ||
+            BlockCount > Hive->Storage[Stable].Length - BlockIndex)
+        {
+            DPRINT1("Invalid bin at BlockIndex %lu, Signature 0x%x, Size 0x%x\n",
+                    BlockIndex, (unsigned)BinHeader.Signature, (unsigned)BinHeader.Size);
+            HvpFreeHiveBins(Hive);
+            return STATUS_REGISTRY_CORRUPT;
+        }
+
+        Bin = Hive->Allocate(BinHeader.Size, TRUE, TAG_CM);
+        if (Bin == NULL)
+        {
+            HvpFreeHiveBins(Hive);
+            return STATUS_NO_MEMORY;
+        }
+
+        Offset = (BlockIndex + 1) * HBLOCK_SIZE;
+        if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset,
+                            Bin, BinHeader.Size))
+        {
+            Hive->Free(Bin, 0);
+            HvpFreeHiveBins(Hive);
+            return STATUS_NOT_REGISTRY_FILE;
+        }
+
+        for (i = 0; i < BlockCount; i++)
+        {
+            Hive->Storage[Stable].BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)Bin;
+            Hive->Storage[Stable].BlockList[BlockIndex + i].BlockAddress =
+                ((ULONG_PTR)Bin + (i * HBLOCK_SIZE));
+        }
+
+        BlockIndex += BlockCount;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @name HvpRecoverData
+ *
+ * Internal function to finish a flush of the primary file that was
+ * interrupted, from the blocks it had written to the log beforehand.
+ * The primary file is fixed up in place, so it can be loaded as usual.
+ */
+static NTSTATUS CMAPI
+HvpRecoverData(
+    PHHIVE Hive,
+    PHBASE_BLOCK BaseBlock)
+{
+    PHBASE_BLOCK LogHeader;
+    RTL_BITMAP DirtyVector;
+    PUCHAR Buffer;
+    PUCHAR Block;
+    ULONG DataOffset;
+    ULONG BlockIndex;
+    ULONG Offset;
+    NTSTATUS Status = STATUS_REGISTRY_CORRUPT;
+
+    LogHeader = Hive->Allocate(HBLOCK_SIZE, TRUE, TAG_CM);
+    if (LogHeader == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    /* The log must be complete, and for the flush that was interrupted */
+    Offset = 0;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, LogHeader, HV_LOG_HEADER_SIZE) ||
+        (LogHeader->Signature != HV_HBLOCK_SIGNATURE) ||
+        (LogHeader->Type != HFILE_TYPE_LOG) ||
+        (LogHeader->Sequence1 != LogHeader->Sequence2) ||
+        (LogHeader->Sequence1 != BaseBlock->Sequence1) ||
+        (HvpHiveHeaderChecksum(LogHeader) != LogHeader->CheckSum) ||
+        (LogHeader->Length % HBLOCK_SIZE) != 0)
+    {
+        DPRINT1("The log can't recover the hive\n");
+        Hive->Free(LogHeader, 0);
+        return STATUS_REGISTRY_CORRUPT;
+    }
+
+    DataOffset = HV_LOG_DATA_OFFSET(LogHeader->Length);
+    Buffer = Hive->Allocate(DataOffset, TRUE, TAG_CM);
+    if (Buffer == NULL)
+    {
+        Hive->Free(LogHeader, 0);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Offset = 0;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, Buffer, DataOffset) ||
+        (*(PULONG)(Buffer + HV_LOG_HEADER_SIZE) != HV_LOG_DIRTY_SIGNATURE))
+    {
+        goto Quit;
+    }
+
+    /* The blocks follow each other in the log, in the order of the dirty vector */
+    RtlInitializeBitMap(&DirtyVector,
+                        (PULONG)(Buffer + HV_LOG_HEADER_SIZE + sizeof(ULONG)),
+                        LogHeader->Length / HBLOCK_SIZE);
+
+    Block = (PUCHAR)LogHeader;
+    for (BlockIndex = 0; BlockIndex < DirtyVector.SizeOfBitMap; BlockIndex++)
+    {
+        if (!RtlCheckBit(&DirtyVector, BlockIndex)) continue;
+
+        if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &DataOffset, Block, HBLOCK_SIZE))
+        {
+            goto Quit;
+        }
+        DataOffset += HBLOCK_SIZE;
+
+        Offset = (BlockIndex + 1) * HBLOCK_SIZE;
+        if (!Hive->FileWrite(Hive, HFILE_TYPE_PRIMARY, &Offset, Block, HBLOCK_SIZE))
+        {
+            goto Quit;
+        }
+    }
+
+    /* The base block is the one the log was written with */
+    RtlCopyMemory(BaseBlock, Buffer, HV_LOG_HEADER_SIZE);
+    BaseBlock->Type = HFILE_TYPE_PRIMARY;
+    BaseBlock->CheckSum = HvpHiveHeaderChecksum(BaseBlock);
+
+    Offset = 0;
+    if (!Hive->FileWrite(Hive, HFILE_TYPE_PRIMARY, &Offset, BaseBlock, sizeof(HBASE_BLOCK)) ||
+        !Hive->FileFlush(Hive, HFILE_TYPE_PRIMARY, NULL, 0))
+    {
+        goto Quit;
+    }
+
+    DPRINT1("Hive recovered from its log\n");
+    Status = STATUS_SUCCESS;
+
+Quit:
+    Hive->Free(Buffer, 0);
+    Hive->Free(LogHeader, 0);
+    return Status;
+}
+
 NTSTATUS CMAPI
 HvLoadHive(IN PHHIVE Hive,
            IN PCUNICODE_STRING FileName OPTIONAL)
@@ -420,11 +640,28 @@ HvLoadHive(IN PHHIVE Hive,
     ULONG Result;
     LARGE_INTEGER TimeStamp;
     ULONG Offset = 0;
-    PVOID HiveData;
-    ULONG FileSize;
 
     /* Get the hive header */
     Result = HvpGetHiveHeader(Hive, &BaseBlock, &TimeStamp);
+    if (Result == RecoverData)
+    {
+        /* Finish the interrupted flush, then start over */
+        if (Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset, BaseBlock, sizeof(HBASE_BLOCK)))
+            Status = HvpRecoverData(Hive, BaseBlock);
+        else
+            Status = STATUS_REGISTRY_CORRUPT;
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        if (!NT_SUCCESS(Status)) return Status;
+
+        Offset = 0;
+        Result = HvpGetHiveHeader(Hive, &BaseBlock, &TimeStamp);
+        if (Result == RecoverData)
+        {
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            return STATUS_REGISTRY_CORRUPT;
+        }
+    }
+
     switch (Result)
     {
         /* Out of memory */
@@ -447,45 +684,34 @@ HvLoadHive(IN PHHIVE Hive,
             return STATUS_REGISTRY_CORRUPT;
     }
 
-    /* Set default boot type */
-    BaseBlock->BootType = 0;
-
-    /* Setup hive data */
-    Hive->BaseBlock = BaseBlock;
-    Hive->Version = BaseBlock->Minor;
-
-    /* Allocate a buffer large enough to hold the hive */
-    FileSize = HBLOCK_SIZE + BaseBlock->Length; // == sizeof(HBASE_BLOCK) + BaseBlock->Length;
-    HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
-    if (!HiveData)
-    {
-        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_INSUFFICIENT_RESOURCES;
-    }
-
-    /* Now read the whole hive */
+    /* Only the first sector was validated, read the whole base block */
     Result = Hive->FileRead(Hive,
                             HFILE_TYPE_PRIMARY,
                             &Offset,
-                            HiveData,
-                            FileSize);
-    if (!Result)
+                            BaseBlock,
+                            sizeof(HBASE_BLOCK));
+    if (!Result || !HvpVerifyHiveHeader(BaseBlock))
     {
-        Hive->Free(HiveData, FileSize);
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
         return STATUS_NOT_REGISTRY_FILE;
     }
 
-    // This is a HACK!
-    /* Free our base block... it's usless in this implementation */
-    Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+    /* Set default boot type */
+    BaseBlock->BootType = 0;
 
-    /* Initialize the hive directly from memory */
-    Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
+    /* Setup hive data */
+    Hive->BaseBlock = BaseBlock;
+    Hive->Version = BaseBlock->Minor;
+
+    /* Read the bins */
+    Status = HvpReadHiveBins(Hive);
     if (!NT_SUCCESS(Status))
-        Hive->Free(HiveData, FileSize);
+    {
+        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+        return Status;
+    }
 
-    return Status;
+    return HvpInitializeHiveBins(Hive, FileName);
 }
 
 /**
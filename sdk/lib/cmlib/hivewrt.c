@@ -9,68 +9,164 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Largest write put together out of blocks that aren't contiguous in memory */
+#define HV_GATHER_BLOCKS    16
+
+static ULONG CMAPI
+HvpFindDirtyRun(
+    PHHIVE RegistryHive,
+    ULONG FromIndex,
+    PULONG BlockIndex)
+{
+    ULONG Length;
+
+    /* The dirty vector may cover more than the stable storage */
+    if (FromIndex >= RegistryHive->Storage[Stable].Length)
+    {
+        return 0;
+    }
+
+    Length = RtlFindNextForwardRunSet(&RegistryHive->DirtyVector, FromIndex, BlockIndex);
+    if (Length == 0 || *BlockIndex >= RegistryHive->Storage[Stable].Length)
+    {
+        return 0;
+    }
+
+    return min(Length, RegistryHive->Storage[Stable].Length - *BlockIndex);
+}
+
 static BOOLEAN CMAPI
-HvpWriteLog(
-    PHHIVE RegistryHive)
+HvpWriteBlocks(
+    PHHIVE RegistryHive,
+    ULONG FileType,
+    ULONG FileOffset,
+    ULONG BlockIndex,
+    ULONG BlockCount,
+    PUCHAR GatherBuffer)
 {
-    ULONG FileOffset;
-    UINT32 BufferSize;
-    UINT32 BitmapSize;
-    PUCHAR Buffer;
-    PUCHAR Ptr;
-    ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    PUCHAR BlockPtr;
+    ULONG Length, i;
     BOOLEAN Success;
-    static ULONG PrintCount = 0;
 
-    if (PrintCount++ == 0)
+    while (BlockCount != 0)
     {
-        UNIMPLEMENTED;
+        BlockPtr = (PUCHAR)BlockList[BlockIndex].BlockAddress;
+
+        /* Blocks of the same bin follow each other in memory */
+        for (Length = 1; Length < BlockCount; Length++)
+        {
+            if ((PUCHAR)BlockList[BlockIndex + Length].BlockAddress !=
+                BlockPtr + Length * HBLOCK_SIZE)
+            {
+                break;
+            }
+        }
+
+        /* Otherwise, copy them together so that they go in one write */
+        if ((GatherBuffer != NULL) && (Length < BlockCount) && (Length < HV_GATHER_BLOCKS))
+        {
+            Length = min(BlockCount, HV_GATHER_BLOCKS);
+            for (i = 0; i < Length; i++)
+            {
+                RtlCopyMemory(GatherBuffer + i * HBLOCK_SIZE,
+                              (PVOID)BlockList[BlockIndex + i].BlockAddress,
+                              HBLOCK_SIZE);
+            }
+            BlockPtr = GatherBuffer;
+        }
+
+        Success = RegistryHive->FileWrite(RegistryHive, FileType, &FileOffset,
+                                          BlockPtr, Length * HBLOCK_SIZE);
+        if (!Success)
+        {
+            return FALSE;
+        }
+
+        BlockIndex += Length;
+        BlockCount -= Length;
+        FileOffset += Length * HBLOCK_SIZE;
     }
+
     return TRUE;
+}
 
-    ASSERT(RegistryHive->ReadOnly == FALSE);
-    ASSERT(RegistryHive->BaseBlock->Length ==
-           RegistryHive->Storage[Stable].Length * HBLOCK_SIZE);
+static BOOLEAN CMAPI
+HvpWriteLog(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT Snapshot)
+{
+    PHBASE_BLOCK Header;
+    ULONG FileOffset;
+    ULONG DataOffset;
+    ULONG DataSize;
+    PUCHAR Buffer;
+    BOOLEAN Success;
 
     DPRINT("HvpWriteLog called\n");
 
-    if (RegistryHive->BaseBlock->Sequence1 !=
-        RegistryHive->BaseBlock->Sequence2)
+    DataOffset = HV_LOG_DATA_OFFSET(Snapshot->BaseBlock.Length);
+    DataSize = Snapshot->BlockCount * HBLOCK_SIZE;
+
+    Buffer = RegistryHive->Allocate(DataOffset, TRUE, TAG_CM);
+    if (Buffer == NULL)
     {
         return FALSE;
     }
 
-    BitmapSize = RegistryHive->DirtyVector.SizeOfBitMap;
-    BufferSize = HV_LOG_HEADER_SIZE + sizeof(ULONG) + BitmapSize;
-    BufferSize = ROUND_UP(BufferSize, HBLOCK_SIZE);
+    /* The log isn't valid until its header is written again at the end */
+    Header = (PHBASE_BLOCK)Buffer;
+    RtlCopyMemory(Header, &Snapshot->BaseBlock, HV_LOG_HEADER_SIZE);
+    Header->Type = HFILE_TYPE_LOG;
+    Header->Sequence2 = Header->Sequence1 - 1;
+    Header->CheckSum = HvpHiveHeaderChecksum(Header);
 
-    DPRINT("Bitmap size %u  buffer size: %u\n", BitmapSize, BufferSize);
+    *(PULONG)(Buffer + HV_LOG_HEADER_SIZE) = HV_LOG_DIRTY_SIGNATURE;
+    RtlCopyMemory(Buffer + HV_LOG_HEADER_SIZE + sizeof(ULONG),
+                  Snapshot->DirtyVector.Buffer,
+                  HV_LOG_VECTOR_SIZE(Snapshot->BaseBlock.Length));
 
-    Buffer = RegistryHive->Allocate(BufferSize, TRUE, TAG_CM);
-    if (Buffer == NULL)
+    /* Write the header and the dirty vector, then all the blocks at once */
+    FileOffset = 0;
+    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
+                                      &FileOffset, Buffer, DataOffset);
+    if (Success)
+    {
+        FileOffset = DataOffset;
+        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
+                                          &FileOffset, Snapshot->Blocks, DataSize);
+    }
+
+    if (Success)
+    {
+        Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG,
+                                            DataOffset + DataSize, DataOffset + DataSize);
+        if (!Success)
+        {
+            DPRINT("FileSetSize failed\n");
+        }
+    }
+
+    if (!Success)
     {
+        RegistryHive->Free(Buffer, 0);
         return FALSE;
     }
 
-    /* Update first update counter and CheckSum */
-    RegistryHive->BaseBlock->Type = HFILE_TYPE_LOG;
-    RegistryHive->BaseBlock->Sequence1++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
+    /* Flush the log file */
+    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
+    if (!Success)
+    {
+        DPRINT("FileFlush failed\n");
+    }
 
-    /* Copy hive header */
-    RtlCopyMemory(Buffer, RegistryHive->BaseBlock, HV_LOG_HEADER_SIZE);
-    Ptr = Buffer + HV_LOG_HEADER_SIZE;
-    RtlCopyMemory(Ptr, "DIRT", 4);
-    Ptr += 4;
-    RtlCopyMemory(Ptr, RegistryHive->DirtyVector.Buffer, BitmapSize);
+    /* Now the log can replay the flush, if the primary doesn't make it */
+    Header->Sequence2 = Header->Sequence1;
+    Header->CheckSum = HvpHiveHeaderChecksum(Header);
 
-    /* Write hive block and block bitmap */
     FileOffset = 0;
     Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, Buffer, BufferSize);
+                                      &FileOffset, Header, HV_LOG_HEADER_SIZE);
     RegistryHive->Free(Buffer, 0);
 
     if (!Success)
@@ -78,63 +174,82 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Write dirty blocks */
-    FileOffset = BufferSize;
-    BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    /* Flush the log file */
+    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
+    if (!Success)
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
-        {
-            break;
-        }
+        DPRINT("FileFlush failed\n");
+    }
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+    return TRUE;
+}
 
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
-        {
-            return FALSE;
-        }
+static BOOLEAN CMAPI
+HvpWriteDirtyBlocks(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT Snapshot)
+{
+    PHBASE_BLOCK BaseBlock = &Snapshot->BaseBlock;
+    ULONG FileOffset;
+    ULONG BlockIndex;
+    ULONG BlockCount;
+    ULONG RunIndex;
+    PUCHAR Ptr;
+    BOOLEAN Success;
 
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
-    }
+    DPRINT("HvpWriteDirtyBlocks called\n");
+
+    /* The primary is being updated until both counters match again */
+    BaseBlock->Sequence2 = BaseBlock->Sequence1 - 1;
+    BaseBlock->CheckSum = HvpHiveHeaderChecksum(BaseBlock);
 
-    Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
+    FileOffset = 0;
+    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
+                                      &FileOffset, BaseBlock, sizeof(HBASE_BLOCK));
     if (!Success)
     {
-        DPRINT("FileSetSize failed\n");
         return FALSE;
     }
 
-    /* Flush the log file */
-    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
+    /* Each run of dirty blocks is together in the snapshot */
+    Ptr = Snapshot->Blocks;
+    BlockIndex = 0;
+    while ((BlockIndex < Snapshot->DirtyVector.SizeOfBitMap) &&
+           ((BlockCount = RtlFindNextForwardRunSet(&Snapshot->DirtyVector,
+                                                   BlockIndex, &RunIndex)) != 0))
+    {
+        FileOffset = (RunIndex + 1) * HBLOCK_SIZE;
+        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
+                                          &FileOffset, Ptr, BlockCount * HBLOCK_SIZE);
+        if (!Success)
+        {
+            return FALSE;
+        }
+
+        Ptr += BlockCount * HBLOCK_SIZE;
+        BlockIndex = RunIndex + BlockCount;
+    }
+
+    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
         DPRINT("FileFlush failed\n");
     }
 
     /* Update second update counter and CheckSum */
-    RegistryHive->BaseBlock->Sequence2++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
+    BaseBlock->Sequence2 = BaseBlock->Sequence1;
+    BaseBlock->CheckSum = HvpHiveHeaderChecksum(BaseBlock);
 
-    /* Write hive header again with updated sequence counter. */
+    /* Write hive block */
     FileOffset = 0;
-    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, RegistryHive->BaseBlock,
-                                      HV_LOG_HEADER_SIZE);
+    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
+                                      &FileOffset, BaseBlock, sizeof(HBASE_BLOCK));
     if (!Success)
     {
         return FALSE;
     }
 
-    /* Flush the log file */
-    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
+    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
         DPRINT("FileFlush failed\n");
@@ -145,13 +260,11 @@ HvpWriteLog(
 
 static BOOLEAN CMAPI
 HvpWriteHive(
-    PHHIVE RegistryHive,
-    BOOLEAN OnlyDirty)
+    PHHIVE RegistryHive)
 {
     ULONG FileOffset;
-    ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG BlockCount;
+    PUCHAR GatherBuffer;
     BOOLEAN Success;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
@@ -182,33 +295,21 @@ HvpWriteHive(
         return FALSE;
     }
 
-    BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
-    {
-        if (OnlyDirty)
-        {
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~0U || BlockIndex < LastIndex)
-            {
-                break;
-            }
-        }
-
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
-        FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
-
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
-        {
-            return FALSE;
-        }
+    /* Not having it only means more writes */
+    GatherBuffer = RegistryHive->Allocate(HV_GATHER_BLOCKS * HBLOCK_SIZE, TRUE, TAG_CM);
 
-        BlockIndex++;
+    /* Write all the blocks */
+    BlockCount = RegistryHive->Storage[Stable].Length;
+    Success = HvpWriteBlocks(RegistryHive, HFILE_TYPE_PRIMARY, HBLOCK_SIZE,
+                             0, BlockCount, GatherBuffer);
+    if (!Success)
+    {
+        if (GatherBuffer != NULL) RegistryHive->Free(GatherBuffer, 0);
+        return FALSE;
     }
 
+    if (GatherBuffer != NULL) RegistryHive->Free(GatherBuffer, 0);
+
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
@@ -240,36 +341,166 @@ HvpWriteHive(
 }
 
 BOOLEAN CMAPI
-HvSyncHive(
-    PHHIVE RegistryHive)
+HvCaptureDirtyBlocks(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT *Snapshot)
 {
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    PHV_DIRTY_SNAPSHOT Copy;
+    ULONG Length;
+    ULONG BlockIndex;
+    ULONG BlockCount;
+    ULONG RunIndex;
+    ULONG TotalCount;
+    PUCHAR Ptr;
+
     ASSERT(RegistryHive->ReadOnly == FALSE);
+    ASSERT(RegistryHive->BaseBlock->Length ==
+           RegistryHive->Storage[Stable].Length * HBLOCK_SIZE);
 
-    if (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) == ~0U)
+    *Snapshot = NULL;
+
+    /* Count what we have to copy */
+    TotalCount = 0;
+    BlockIndex = 0;
+    while ((BlockCount = HvpFindDirtyRun(RegistryHive, BlockIndex, &RunIndex)) != 0)
+    {
+        TotalCount += BlockCount;
+        BlockIndex = RunIndex + BlockCount;
+    }
+
+    if (TotalCount == 0)
     {
         return TRUE;
     }
 
-    /* Update hive header modification time */
+    Length = RegistryHive->Storage[Stable].Length;
+    Copy = RegistryHive->Allocate(sizeof(HV_DIRTY_SNAPSHOT) +
+                                  HV_LOG_VECTOR_SIZE(Length * HBLOCK_SIZE),
+                                  TRUE, TAG_CM);
+    if (Copy == NULL)
+    {
+        return FALSE;
+    }
+
+    Copy->Blocks = RegistryHive->Allocate(TotalCount * HBLOCK_SIZE, TRUE, TAG_CM);
+    if (Copy->Blocks == NULL)
+    {
+        RegistryHive->Free(Copy, 0);
+        return FALSE;
+    }
+    Copy->BlockCount = TotalCount;
+
+    /* Update hive header modification time and update counters */
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
+    RegistryHive->BaseBlock->Type = HFILE_TYPE_PRIMARY;
+    RegistryHive->BaseBlock->Sequence1++;
+    RegistryHive->BaseBlock->Sequence2 = RegistryHive->BaseBlock->Sequence1;
+    RegistryHive->BaseBlock->CheckSum =
+        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
+    RtlCopyMemory(&Copy->BaseBlock, RegistryHive->BaseBlock, sizeof(HBASE_BLOCK));
+
+    RtlInitializeBitMap(&Copy->DirtyVector, (PULONG)(Copy + 1), Length);
+    RtlClearAllBits(&Copy->DirtyVector);
+
+    Ptr = Copy->Blocks;
+    BlockIndex = 0;
+    while ((BlockCount = HvpFindDirtyRun(RegistryHive, BlockIndex, &RunIndex)) != 0)
+    {
+        RtlSetBits(&Copy->DirtyVector, RunIndex, BlockCount);
+        for (BlockIndex = RunIndex; BlockIndex < RunIndex + BlockCount; BlockIndex++)
+        {
+            RtlCopyMemory(Ptr, (PVOID)BlockList[BlockIndex].BlockAddress, HBLOCK_SIZE);
+            Ptr += HBLOCK_SIZE;
+        }
+    }
+
+    /* From now on, the hive is only dirty with what changes after us */
+    RtlClearAllBits(&RegistryHive->DirtyVector);
+    RegistryHive->DirtyCount = 0;
 
+    *Snapshot = Copy;
+    return TRUE;
+}
+
+BOOLEAN CMAPI
+HvWriteDirtyBlocks(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT Snapshot)
+{
     /* Update log file */
-    if (!HvpWriteLog(RegistryHive))
+    if (HvHasLog(RegistryHive) && !HvpWriteLog(RegistryHive, Snapshot))
     {
         return FALSE;
     }
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, TRUE))
+    return HvpWriteDirtyBlocks(RegistryHive, Snapshot);
+}
+
+VOID CMAPI
+HvRestoreDirtyBlocks(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT Snapshot)
+{
+    ULONG BlockIndex;
+    ULONG BlockCount;
+    ULONG RunIndex;
+
+    /* Whatever didn't make it to the disk is still to be written */
+    BlockIndex = 0;
+    while ((BlockIndex < Snapshot->DirtyVector.SizeOfBitMap) &&
+           ((BlockCount = RtlFindNextForwardRunSet(&Snapshot->DirtyVector,
+                                                   BlockIndex, &RunIndex)) != 0))
+    {
+        for (BlockIndex = RunIndex; BlockIndex < RunIndex + BlockCount; BlockIndex++)
+        {
+            /* It may have been changed again since */
+            if (RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex)) continue;
+
+            RtlSetBits(&RegistryHive->DirtyVector, BlockIndex, 1);
+            RegistryHive->DirtyCount++;
+        }
+    }
+}
+
+VOID CMAPI
+HvFreeDirtyBlocks(
+    PHHIVE RegistryHive,
+    PHV_DIRTY_SNAPSHOT Snapshot)
+{
+    RegistryHive->Free(Snapshot->Blocks, 0);
+    RegistryHive->Free(Snapshot, 0);
+}
+
+BOOLEAN CMAPI
+HvSyncHive(
+    PHHIVE RegistryHive)
+{
+    PHV_DIRTY_SNAPSHOT Snapshot;
+    BOOLEAN Success;
+
+    ASSERT(RegistryHive->ReadOnly == FALSE);
+
+    if (!HvCaptureDirtyBlocks(RegistryHive, &Snapshot))
     {
         return FALSE;
     }
 
-    /* Clear dirty bitmap. */
-    RtlClearAllBits(&RegistryHive->DirtyVector);
-    RegistryHive->DirtyCount = 0;
+    /* Nothing is dirty */
+    if (Snapshot == NULL)
+    {
+        return TRUE;
+    }
 
-    return TRUE;
+    Success = HvWriteDirtyBlocks(RegistryHive, Snapshot);
+    if (!Success)
+    {
+        HvRestoreDirtyBlocks(RegistryHive, Snapshot);
+    }
+
+    HvFreeDirtyBlocks(RegistryHive, Snapshot);
+    return Success;
 }
 
 BOOLEAN
@@ -291,7 +522,7 @@ HvWriteHive(
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, FALSE))
+    if (!HvpWriteHive(RegistryHive))
     {
         return FALSE;
     }
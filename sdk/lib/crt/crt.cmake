@@ -114,7 +114,6 @@ list(APPEND CRT_SOURCE
     mbstring/mbstok.c
     mbstring/mbstrlen.c
     mbstring/mbsupr.c
-    mem/memcmp.c
     mem/memccpy.c
     mem/memicmp.c
     misc/__crt_MessageBoxA.c
@@ -397,7 +396,9 @@ if(ARCH STREQUAL "i386")
         math/i386/exp_asm.s
         math/i386/fmod_asm.s
         math/i386/fmodf_asm.s
+        mem/i386/mem_sse2_asm.s
         mem/i386/memchr_asm.s
+        mem/i386/memcmp_asm.s
         mem/i386/memmove_asm.s
         mem/i386/memset_asm.s
         misc/i386/readcr4.S
@@ -412,6 +413,7 @@ if(ARCH STREQUAL "i386")
         string/i386/strncpy_asm.s
         string/i386/strnlen_asm.s
         string/i386/strrchr_asm.s
+        string/i386/str_sse2_asm.s
         string/i386/wcscat_asm.s
         string/i386/wcschr_asm.s
         string/i386/wcscmp_asm.s
@@ -565,6 +567,7 @@ if(NOT ARCH STREQUAL "i386")
         math/tanhf.c
         math/stubs.c
         mem/memchr.c
+        mem/memcmp.c
         mem/memcpy.c
         mem/memmove.c
         mem/memset.c
@@ -0,0 +1,341 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS CRT library
+ * FILE:            sdk/lib/crt/mem/i386/mem_sse2_asm.s
+ * PURPOSE:         SSE2 implementations of memmove, memset, memchr and memcmp
+ */
+
+#include <asm.inc>
+#include <ks386.inc>
+#include "sse2.inc"
+
+/*
+ * These are jumped to from the plain implementations once SSE2 is known to
+ * be usable (see sse2.inc), with the caller's stack frame left untouched.
+ */
+
+PUBLIC __memmove_sse2
+PUBLIC __memset_sse2
+PUBLIC __memchr_sse2
+PUBLIC __memcmp_sse2
+.code
+
+/*
+ * void *memmove(void *to, const void *from, size_t count)
+ *
+ * Sizes up to 32 bytes load everything before storing anything, which
+ * makes them safe for overlapping buffers. Bigger copies save the first
+ * and the last 16 bytes, move the aligned middle part of the destination
+ * in the direction the overlap allows and store the saved ends last.
+ */
+FUNC __memmove_sse2
+	FPO 0, 3, 2, 2, 0, FRAME_FPO
+	push esi
+	push edi
+	mov edi, [esp + 12]
+	mov esi, [esp + 16]
+	mov ecx, [esp + 20]
+
+	cmp ecx, 16
+	jb .Lmove_small
+	movdqu xmm1, [esi]
+	movdqu xmm2, [esi + ecx - 16]
+	cmp ecx, 32
+	ja .Lmove_large
+	movdqu [edi], xmm1
+	movdqu [edi + ecx - 16], xmm2
+	jmp .Lmove_done
+
+.Lmove_large:
+	/* eax = where the saved tail goes */
+	lea eax, [edi + ecx - 16]
+
+	/* Copy down if the destination starts inside the source */
+	mov edx, edi
+	sub edx, esi
+	cmp edx, ecx
+	jb .Lmove_down
+
+	/* edx = from - to, [esi, ecx) = aligned middle part of the destination */
+	neg edx
+	lea esi, [edi + 16]
+	and esi, -16
+	add ecx, edi
+	and ecx, -16
+
+	/* Big copies of buffers that do not overlap bypass the cache */
+	cmp dword ptr [esp + 20], SSE2_NONTEMPORAL_THRESHOLD
+	jb .Lmove_up
+	cmp edx, [esp + 20]
+	jb .Lmove_up
+
+	sub ecx, 48
+.Lmove_up_nt:
+	prefetchnta [esi + edx + 512]
+	movdqu xmm0, [esi + edx]
+	movdqu xmm3, [esi + edx + 16]
+	movdqu xmm4, [esi + edx + 32]
+	movdqu xmm5, [esi + edx + 48]
+	movntdq [esi], xmm0
+	movntdq [esi + 16], xmm3
+	movntdq [esi + 32], xmm4
+	movntdq [esi + 48], xmm5
+	add esi, 64
+	cmp esi, ecx
+	jb .Lmove_up_nt
+	sfence
+	add ecx, 48
+	cmp esi, ecx
+	jae .Lmove_ends
+
+.Lmove_up:
+	movdqu xmm0, [esi + edx]
+	movdqa [esi], xmm0
+	add esi, 16
+	cmp esi, ecx
+	jb .Lmove_up
+	jmp .Lmove_ends
+
+.Lmove_down:
+	neg edx
+	lea esi, [edi + 16]
+	and esi, -16
+	add ecx, edi
+	and ecx, -16
+.Lmove_down_loop:
+	sub ecx, 16
+	movdqu xmm0, [ecx + edx]
+	movdqa [ecx], xmm0
+	cmp ecx, esi
+	ja .Lmove_down_loop
+
+.Lmove_ends:
+	movdqu [edi], xmm1
+	movdqu [eax], xmm2
+	jmp .Lmove_done
+
+.Lmove_small:
+	cmp ecx, 8
+	jb .Lmove_small4
+	movq xmm1, qword ptr [esi]
+	movq xmm2, qword ptr [esi + ecx - 8]
+	movq qword ptr [edi], xmm1
+	movq qword ptr [edi + ecx - 8], xmm2
+	jmp .Lmove_done
+
+.Lmove_small4:
+	cmp ecx, 4
+	jb .Lmove_small1
+	mov eax, [esi]
+	mov edx, [esi + ecx - 4]
+	mov [edi], eax
+	mov [edi + ecx - 4], edx
+	jmp .Lmove_done
+
+.Lmove_small1:
+	test ecx, ecx
+	jz .Lmove_done
+	mov al, [esi]
+	mov dl, [esi + ecx - 1]
+	cmp ecx, 2
+	jbe .Lmove_small2
+	mov ah, [esi + 1]
+	mov [edi + 1], ah
+.Lmove_small2:
+	mov [edi], al
+	mov [edi + ecx - 1], dl
+
+.Lmove_done:
+	mov eax, [esp + 12]
+	pop edi
+	pop esi
+	ret
+ENDFUNC
+
+/*
+ * void *memset(void *src, int val, size_t count)
+ */
+FUNC __memset_sse2
+	FPO 0, 3, 0, 0, 0, FRAME_FPO
+	mov edx, [esp + 4]
+	movzx eax, byte ptr [esp + 8]
+	mov ecx, [esp + 12]
+	imul eax, eax, HEX(01010101)
+
+	cmp ecx, 16
+	jb .Lset_small
+
+	movd xmm0, eax
+	pshufd xmm0, xmm0, 0
+	movdqu [edx], xmm0
+	movdqu [edx + ecx - 16], xmm0
+	cmp ecx, 32
+	jbe .Lset_done
+
+	/* The unaligned stores above took care of both ends, [edx, ecx) is
+	   the aligned part in between */
+	add ecx, edx
+	and ecx, -16
+	add edx, 16
+	and edx, -16
+
+	mov eax, ecx
+	sub eax, edx
+	cmp eax, SSE2_NONTEMPORAL_THRESHOLD
+	jae .Lset_nt
+
+.Lset_loop:
+	movdqa [edx], xmm0
+	add edx, 16
+	cmp edx, ecx
+	jb .Lset_loop
+	jmp .Lset_done
+
+.Lset_nt:
+	movntdq [edx], xmm0
+	add edx, 16
+	cmp edx, ecx
+	jb .Lset_nt
+	sfence
+	jmp .Lset_done
+
+.Lset_small:
+	cmp ecx, 4
+	jb .Lset_small1
+	mov [edx], eax
+	mov [edx + ecx - 4], eax
+	cmp ecx, 8
+	jbe .Lset_done
+	mov [edx + 4], eax
+	mov [edx + ecx - 8], eax
+	jmp .Lset_done
+
+.Lset_small1:
+	test ecx, ecx
+	jz .Lset_done
+	mov [edx], al
+	mov [edx + ecx - 1], al
+	cmp ecx, 2
+	jbe .Lset_done
+	mov [edx + 1], al
+
+.Lset_done:
+	mov eax, [esp + 4]
+	ret
+ENDFUNC
+
+/*
+ * void *memchr(const void *s, int c, size_t n)
+ *
+ * Only aligned blocks are read, so the scan never touches a page the
+ * buffer does not extend into.
+ */
+FUNC __memchr_sse2
+	FPO 0, 3, 1, 1, 0, FRAME_FPO
+	push esi
+	mov edx, [esp + 8]
+	mov eax, [esp + 16]
+	test eax, eax
+	jz .Lchr_notfound
+
+	movzx ecx, byte ptr [esp + 12]
+	imul ecx, ecx, HEX(01010101)
+	movd xmm1, ecx
+	pshufd xmm1, xmm1, 0
+
+	/* eax = bytes left, counted from the start of the aligned block */
+	mov ecx, edx
+	and ecx, 15
+	and edx, -16
+	add eax, ecx
+	jnc .Lchr_first
+	or eax, -1
+
+.Lchr_first:
+	movdqa xmm0, [edx]
+	pcmpeqb xmm0, xmm1
+	pmovmskb esi, xmm0
+	shr esi, cl
+	shl esi, cl
+	test esi, esi
+	jnz .Lchr_found
+
+.Lchr_loop:
+	cmp eax, 16
+	jbe .Lchr_notfound
+	sub eax, 16
+	add edx, 16
+	movdqa xmm0, [edx]
+	pcmpeqb xmm0, xmm1
+	pmovmskb esi, xmm0
+	test esi, esi
+	jz .Lchr_loop
+
+.Lchr_found:
+	bsf ecx, esi
+	cmp ecx, eax
+	jae .Lchr_notfound
+	lea eax, [edx + ecx]
+	pop esi
+	ret
+
+.Lchr_notfound:
+	xor eax, eax
+	pop esi
+	ret
+ENDFUNC
+
+/*
+ * int memcmp(const void *s1, const void *s2, size_t n)
+ */
+FUNC __memcmp_sse2
+	FPO 0, 3, 2, 2, 0, FRAME_FPO
+	push esi
+	push edi
+	mov esi, [esp + 12]
+	mov edi, [esp + 16]
+	mov ecx, [esp + 20]
+
+	cmp ecx, 16
+	jb .Lcmp_bytes
+.Lcmp_loop:
+	movdqu xmm0, [esi]
+	movdqu xmm1, [edi]
+	pcmpeqb xmm0, xmm1
+	pmovmskb eax, xmm0
+	xor eax, HEX(FFFF)
+	jnz .Lcmp_diff
+	add esi, 16
+	add edi, 16
+	sub ecx, 16
+	cmp ecx, 16
+	jae .Lcmp_loop
+
+.Lcmp_bytes:
+	xor eax, eax
+	test ecx, ecx
+	jz .Lcmp_done
+.Lcmp_byte_loop:
+	movzx eax, byte ptr [esi]
+	movzx edx, byte ptr [edi]
+	sub eax, edx
+	jnz .Lcmp_done
+	inc esi
+	inc edi
+	dec ecx
+	jnz .Lcmp_byte_loop
+	jmp .Lcmp_done
+
+.Lcmp_diff:
+	bsf ecx, eax
+	movzx eax, byte ptr [esi + ecx]
+	movzx edx, byte ptr [edi + ecx]
+	sub eax, edx
+
+.Lcmp_done:
+	pop edi
+	pop esi
+	ret
+ENDFUNC
+
+END
@@ -6,16 +6,24 @@
 
 #include <asm.inc>
 #include <ks386.inc>
+#include "sse2.inc"
 
 /*
  * void* memchr(const void* s, int c, size_t n)
  */
 
 PUBLIC	_memchr
+#ifdef CRT_USE_SSE2
+EXTERN __memchr_sse2:PROC
+#endif
 .code
 
 FUNC _memchr
 	FPO 0, 3, 4, 1, 1, FRAME_NONFPO
+#ifdef CRT_USE_SSE2
+	cmp SSE2_AVAILABLE, 0
+	jne __memchr_sse2
+#endif
 	push ebp
 	mov ebp, esp
 	push edi
@@ -0,0 +1,46 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS CRT library
+ * FILE:            sdk/lib/crt/mem/i386/memcmp_asm.s
+ */
+
+#include <asm.inc>
+#include <ks386.inc>
+#include "sse2.inc"
+
+/*
+ * int memcmp(const void *s1, const void *s2, size_t n)
+ */
+
+PUBLIC _memcmp
+#ifdef CRT_USE_SSE2
+EXTERN __memcmp_sse2:PROC
+#endif
+.code
+
+FUNC _memcmp
+	FPO 0, 3, 2, 2, 0, FRAME_FPO
+#ifdef CRT_USE_SSE2
+	cmp SSE2_AVAILABLE, 0
+	jne __memcmp_sse2
+#endif
+	push esi
+	push edi
+	mov esi, [esp + 12]
+	mov edi, [esp + 16]
+	mov ecx, [esp + 20]
+	xor eax, eax
+	cld
+	jecxz .Ldone
+	repe cmpsb
+	je .Ldone
+	movzx eax, byte ptr [esi - 1]
+	movzx edx, byte ptr [edi - 1]
+	sub eax, edx
+.Ldone:
+	pop edi
+	pop esi
+	ret
+ENDFUNC
+
+END
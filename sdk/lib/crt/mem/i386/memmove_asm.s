@@ -5,14 +5,22 @@
 
 #include <asm.inc>
 #include <ks386.inc>
+#include "sse2.inc"
 
 PUBLIC _memcpy
 PUBLIC _memmove
+#ifdef CRT_USE_SSE2
+EXTERN __memmove_sse2:PROC
+#endif
 .code
 
 _memcpy:
 FUNC _memmove
 	FPO 0, 3, 5, 2, 1, FRAME_NONFPO
+#ifdef CRT_USE_SSE2
+	cmp SSE2_AVAILABLE, 0
+	jne __memmove_sse2
+#endif
 	push ebp
 	mov ebp, esp
 	
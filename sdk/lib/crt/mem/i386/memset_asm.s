@@ -1,16 +1,24 @@
 
 #include <asm.inc>
 #include <ks386.inc>
+#include "sse2.inc"
 
 /*
  * void *memset (void *src, int val, size_t count)
  */
 
 PUBLIC _memset
+#ifdef CRT_USE_SSE2
+EXTERN __memset_sse2:PROC
+#endif
 .code
 
 FUNC _memset
 	FPO 0, 3, 4, 1, 1, FRAME_NONFPO
+#ifdef CRT_USE_SSE2
+	cmp SSE2_AVAILABLE, 0
+	jne __memset_sse2
+#endif
 	push ebp
 	mov ebp, esp
 	push edi
@@ -0,0 +1,158 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS CRT library
+ * FILE:            sdk/lib/crt/string/i386/str_sse2_asm.s
+ * PURPOSE:         SSE2 implementations of strlen, wcslen and strchr
+ */
+
+#include <asm.inc>
+#include <ks386.inc>
+#include "../../mem/i386/sse2.inc"
+
+/*
+ * Like the memory routines in mem_sse2_asm.s these are jumped to from the
+ * plain implementations. Only aligned blocks are read, so the scan for the
+ * terminator never touches a page the string does not extend into.
+ */
+
+PUBLIC __strlen_sse2
+PUBLIC __wcslen_sse2
+PUBLIC __strchr_sse2
+.code
+
+/*
+ * size_t strlen(const char *s)
+ */
+FUNC __strlen_sse2
+	FPO 0, 1, 0, 0, 0, FRAME_FPO
+	mov eax, [esp + 4]
+	mov ecx, eax
+	and ecx, 15
+	and eax, -16
+	pxor xmm1, xmm1
+
+	movdqa xmm0, [eax]
+	pcmpeqb xmm0, xmm1
+	pmovmskb edx, xmm0
+	shr edx, cl
+	test edx, edx
+	jz .Llen_loop
+	bsf eax, edx
+	ret
+
+.Llen_loop:
+	add eax, 16
+	movdqa xmm0, [eax]
+	pcmpeqb xmm0, xmm1
+	pmovmskb edx, xmm0
+	test edx, edx
+	jz .Llen_loop
+
+	bsf edx, edx
+	add eax, edx
+	sub eax, [esp + 4]
+	ret
+ENDFUNC
+
+/*
+ * size_t wcslen(const wchar_t *s)
+ */
+FUNC __wcslen_sse2
+	FPO 0, 1, 0, 0, 0, FRAME_FPO
+	mov eax, [esp + 4]
+
+	/* Aligned blocks would split the characters of an odd aligned string */
+	test eax, 1
+	jnz .Lwlen_odd
+
+	mov ecx, eax
+	and ecx, 15
+	and eax, -16
+	pxor xmm1, xmm1
+
+	movdqa xmm0, [eax]
+	pcmpeqw xmm0, xmm1
+	pmovmskb edx, xmm0
+	shr edx, cl
+	test edx, edx
+	jz .Lwlen_loop
+	bsf eax, edx
+	shr eax, 1
+	ret
+
+.Lwlen_loop:
+	add eax, 16
+	movdqa xmm0, [eax]
+	pcmpeqw xmm0, xmm1
+	pmovmskb edx, xmm0
+	test edx, edx
+	jz .Lwlen_loop
+
+	bsf edx, edx
+	add eax, edx
+	sub eax, [esp + 4]
+	shr eax, 1
+	ret
+
+.Lwlen_odd:
+	cmp word ptr [eax], 0
+	je .Lwlen_odd_done
+	add eax, 2
+	jmp .Lwlen_odd
+.Lwlen_odd_done:
+	sub eax, [esp + 4]
+	shr eax, 1
+	ret
+ENDFUNC
+
+/*
+ * char *strchr(const char *s, int c)
+ */
+FUNC __strchr_sse2
+	FPO 0, 2, 0, 0, 0, FRAME_FPO
+	movzx ecx, byte ptr [esp + 8]
+	imul ecx, ecx, HEX(01010101)
+	movd xmm2, ecx
+	pshufd xmm2, xmm2, 0
+	pxor xmm3, xmm3
+
+	mov eax, [esp + 4]
+	mov ecx, eax
+	and ecx, 15
+	and eax, -16
+
+	/* Look for either the character or the terminator */
+	movdqa xmm0, [eax]
+	movdqa xmm1, xmm0
+	pcmpeqb xmm0, xmm2
+	pcmpeqb xmm1, xmm3
+	por xmm0, xmm1
+	pmovmskb edx, xmm0
+	shr edx, cl
+	shl edx, cl
+	test edx, edx
+	jnz .Lchr_found
+
+.Lchr_loop:
+	add eax, 16
+	movdqa xmm0, [eax]
+	movdqa xmm1, xmm0
+	pcmpeqb xmm0, xmm2
+	pcmpeqb xmm1, xmm3
+	por xmm0, xmm1
+	pmovmskb edx, xmm0
+	test edx, edx
+	jz .Lchr_loop
+
+.Lchr_found:
+	bsf edx, edx
+	add eax, edx
+	mov cl, [esp + 8]
+	cmp [eax], cl
+	je .Lchr_done
+	xor eax, eax
+.Lchr_done:
+	ret
+ENDFUNC
+
+END
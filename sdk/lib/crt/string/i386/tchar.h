@@ -10,6 +10,7 @@
 #define _tcscpy _wcscpy
 #define tcscpy wcscpy
 #define _tcslen _wcslen
+#define _tcslen_sse2 __wcslen_sse2
 #define _tcsncat _wcsncat
 #define _tcsncmp _wcsncmp
 #define _tcsncpy _wcsncpy
@@ -31,10 +32,12 @@
 
 #define _tcscat _strcat
 #define _tcschr _strchr
+#define _tcschr_sse2 __strchr_sse2
 #define _tcscmp _strcmp
 #define _tcscpy _strcpy
 #define tcscpy strcpy
 #define _tcslen _strlen
+#define _tcslen_sse2 __strlen_sse2
 #define _tcsncat _strncat
 #define _tcsncmp _strncmp
 #define _tcsncpy _strncpy
@@ -61,6 +61,34 @@ static struct
 
 #define NTOHS(n) (((((unsigned short)(n) & 0xFF)) << 8) | (((unsigned short)(n) & 0xFF00) >> 8))
 
+static
+ULONG
+HidParser_ExtractItemData(
+    IN PHID_REPORT_ITEM ReportItem,
+    IN PCHAR ReportDescriptor,
+    IN ULONG ReportDescriptorLength)
+{
+    PUCHAR Source;
+    ULONG Data = 0, Index, Length;
+
+    //
+    // one extra shift for skipping the prepended report id
+    //
+    Source = (PUCHAR)&ReportDescriptor[ReportItem->ByteOffset + 1];
+    Length = min(sizeof(ULONG), ReportDescriptorLength - (ReportItem->ByteOffset + 1));
+
+    //
+    // assemble the little endian value in place instead of copying it out
+    //
+    for (Index = 0; Index < Length; Index++)
+        Data |= (ULONG)Source[Index] << (Index * 8);
+
+    //
+    // shift data and clear unwanted bits
+    //
+    return (Data >> ReportItem->Shift) & ReportItem->Mask;
+}
+
 HIDPARSER_STATUS
 HidParser_GetCollectionUsagePage(
     IN PVOID CollectionContext,
@@ -631,21 +659,7 @@ HidParser_GetUsageValueWithReport(
         //
         ASSERT(ReportItem->ByteOffset < ReportDescriptorLength);
 
-        //
-        // one extra shift for skipping the prepended report id
-        //
-        Data = 0;
-        Parser->Copy(&Data, &ReportDescriptor[ReportItem->ByteOffset + 1], min(sizeof(ULONG), ReportDescriptorLength - (ReportItem->ByteOffset + 1)));
-
-        //
-        // shift data
-        //
-        Data >>= ReportItem->Shift;
-
-        //
-        // clear unwanted bits
-        //
-        Data &= ReportItem->Mask;
+        Data = HidParser_ExtractItemData(ReportItem, ReportDescriptor, ReportDescriptorLength);
 
         //
         // store result
@@ -728,21 +742,7 @@ HidParser_GetScaledUsageValueWithReport(
         //
         ASSERT(ReportItem->ByteOffset < ReportDescriptorLength);
 
-        //
-        // one extra shift for skipping the prepended report id
-        //
-        Data = 0;
-        Parser->Copy(&Data, &ReportDescriptor[ReportItem->ByteOffset + 1], min(sizeof(ULONG), ReportDescriptorLength - (ReportItem->ByteOffset + 1)));
-
-        //
-        // shift data
-        //
-        Data >>= ReportItem->Shift;
-
-        //
-        // clear unwanted bits
-        //
-        Data &= ReportItem->Mask;
+        Data = HidParser_ExtractItemData(ReportItem, ReportDescriptor, ReportDescriptorLength);
 
         if (ReportItem->Minimum > ReportItem->Maximum)
         {
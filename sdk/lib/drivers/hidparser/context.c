@@ -13,15 +13,34 @@
 #define NDEBUG
 #include <debug.h>
 
+//
+// report types are 1, 2 and 4, the table is indexed by their bit position
+//
+#define HID_REPORT_TYPE_INDEX(Type) ((Type) >> 1)
+#define HID_REPORT_TYPE_COUNT 3
+#define HID_REPORT_NOT_PRESENT MAXULONG
+
 typedef struct
 {
     ULONG Size;
+
+    //
+    // offset of the first report of each type, resolved once when the context is built
+    //
+    ULONG ReportOffsets[HID_REPORT_TYPE_COUNT];
+
     union
     {
         UCHAR RawData[1];
     };
 }HID_COLLECTION_CONTEXT, *PHID_COLLECTION_CONTEXT;
 
+PHID_REPORT
+HidParser_SearchReportInCollection(
+    IN PHID_COLLECTION_CONTEXT CollectionContext,
+    IN PHID_COLLECTION Collection,
+    IN UCHAR ReportType);
+
 ULONG
 HidParser_CalculateCollectionSize(
     IN PHID_COLLECTION Collection)
@@ -191,6 +210,8 @@ HidParser_BuildCollectionContext(
 {
     PHID_COLLECTION_CONTEXT CollectionContext;
     ULONG CollectionSize;
+    ULONG Index;
+    PHID_REPORT Report;
 
     //
     // init context
@@ -208,6 +229,18 @@ HidParser_BuildCollectionContext(
     //
     ASSERT(CollectionSize + sizeof(HID_COLLECTION_CONTEXT) == ContextSize);
 
+    //
+    // resolve the reports now, so that the per report lookups do not walk the collection tree
+    //
+    for(Index = 0; Index < HID_REPORT_TYPE_COUNT; Index++)
+    {
+        Report = HidParser_SearchReportInCollection(CollectionContext, (PHID_COLLECTION)CollectionContext->RawData, (UCHAR)(1 << Index));
+        if (Report)
+            CollectionContext->ReportOffsets[Index] = (ULONG)((PUCHAR)Report - CollectionContext->RawData);
+        else
+            CollectionContext->ReportOffsets[Index] = HID_REPORT_NOT_PRESENT;
+    }
+
     DPRINT("CollectionContext %p\n", CollectionContext);
     DPRINT("CollectionContext RawData %p\n", CollectionContext->RawData);
     DPRINT("CollectionContext Size %lu\n", CollectionContext->Size);
@@ -281,11 +314,28 @@ HidParser_GetReportInCollection(
     IN UCHAR ReportType)
 {
     PHID_COLLECTION_CONTEXT CollectionContext = (PHID_COLLECTION_CONTEXT)Context;
+    ULONG Index = HID_REPORT_TYPE_INDEX(ReportType);
+
+    if (Index >= HID_REPORT_TYPE_COUNT || ReportType != (1 << Index))
+    {
+        //
+        // not a single report type
+        //
+        return HidParser_SearchReportInCollection(CollectionContext, (PHID_COLLECTION)&CollectionContext->RawData, ReportType);
+    }
+
+    if (CollectionContext->ReportOffsets[Index] == HID_REPORT_NOT_PRESENT)
+    {
+        //
+        // no such report
+        //
+        return NULL;
+    }
 
     //
     // done
     //
-    return HidParser_SearchReportInCollection(CollectionContext, (PHID_COLLECTION)&CollectionContext->RawData, ReportType);
+    return (PHID_REPORT)(CollectionContext->RawData + CollectionContext->ReportOffsets[Index]);
 }
 
 PHID_COLLECTION
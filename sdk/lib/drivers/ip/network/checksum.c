@@ -36,70 +36,130 @@ ULONG ChecksumCompute(
  *     Seed  = Previously calculated checksum (if any)
  * RETURNS:
  *     Checksum of buffer
+ * NOTES:
+ *     The buffer is summed as 32-bit words into a 64-bit accumulator, so
+ *     carries only need to be folded back in once at the end. A buffer
+ *     starting on an odd address is summed from the next byte with its
+ *     bytes swapped, and the result swapped back (RFC 1071, section 2(B))
  */
 {
-  register ULONG Sum = Seed;
+  PUCHAR Buffer = Data;
+  ULONGLONG Sum = 0;
+  ULONG Result;
+  BOOLEAN Odd = ((ULONG_PTR)Buffer & 1) != 0;
 
-  while (Count > 1)
+  if (Odd && Count > 0)
     {
-      Sum += *(PUSHORT)Data;
+      Sum = (ULONG)*Buffer << 8;
+      Buffer++;
+      Count--;
+    }
+
+  /* Get 32-bit aligned */
+  if (((ULONG_PTR)Buffer & 2) && Count > 1)
+    {
+      Sum += *(PUSHORT)Buffer;
+      Buffer += 2;
+      Count -= 2;
+    }
+
+  while (Count >= 32)
+    {
+      Sum += (ULONGLONG)((PULONG)Buffer)[0] + ((PULONG)Buffer)[1] +
+             (ULONGLONG)((PULONG)Buffer)[2] + ((PULONG)Buffer)[3] +
+             (ULONGLONG)((PULONG)Buffer)[4] + ((PULONG)Buffer)[5] +
+             (ULONGLONG)((PULONG)Buffer)[6] + ((PULONG)Buffer)[7];
+      Buffer += 32;
+      Count -= 32;
+    }
+
+  while (Count >= 4)
+    {
+      Sum += *(PULONG)Buffer;
+      Buffer += 4;
+      Count -= 4;
+    }
+
+  if (Count >= 2)
+    {
+      Sum += *(PUSHORT)Buffer;
+      Buffer += 2;
       Count -= 2;
-      Data = (PVOID)((ULONG_PTR) Data + 2);
     }
 
   /* Add left-over byte, if any */
   if (Count > 0)
     {
-      Sum += *(PUCHAR)Data;
+      Sum += *Buffer;
     }
 
-  return Sum;
+  /* Fold 64-bit sum to 32 bits */
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+  Result = (ULONG)Sum;
+
+  if (Odd)
+    {
+      Result = ChecksumFold(Result);
+      Result = ((Result & 0xFF) << 8) | (Result >> 8);
+    }
+
+  /* Add the seed, with end-around carry */
+  Result += Seed;
+  if (Result < Seed)
+    Result++;
+
+  return Result;
 }
 
-ULONG
-UDPv4ChecksumCalculate(
+unsigned int
+csum_partial(
+  const unsigned char * buff,
+  int len,
+  unsigned int sum)
+{
+  return ChecksumCompute((PVOID)buff, len, sum);
+}
+
+static ULONG
+IPv4PseudoChecksumCalculate(
   PIPv4_HEADER IPHeader,
+  UCHAR Protocol,
   PUCHAR PacketBuffer,
   ULONG DataLength)
 {
-  ULONG Sum = 0;
-  USHORT TmpSum;
-  ULONG i;
-  BOOLEAN Pad;
-
-  /* Pad the data if needed */
-  Pad = (DataLength & 1);
-  if (Pad)
-      DataLength++;
-
-  /* Add from the UDP header and data */
-  for (i = 0; i < DataLength; i += 2)
-  {
-       TmpSum = ((PacketBuffer[i] << 8) & 0xFF00) +
-                ((Pad && i == DataLength - 2) ? 0 : (PacketBuffer[i+1] & 0x00FF));
-       Sum += TmpSum;
-  }
-
-  /* Add the source address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->SrcAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->SrcAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
-
-  /* Add the destination address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->DstAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->DstAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
+  ULONG Sum;
+
+  /* Sum the transport header and data, then the source and destination
+     addresses, which follow each other in the IP header */
+  Sum = ChecksumCompute(PacketBuffer, DataLength, 0);
+  Sum = ChecksumCompute(&IPHeader->SrcAddr, 2 * sizeof(IPv4_RAW_ADDRESS), Sum);
+
+  /* That was summed in network byte order, swap it to host order */
+  Sum = ChecksumFold(Sum);
+  Sum = ((Sum & 0xFF) << 8) | (Sum >> 8);
 
   /* Add the proto number and length */
-  Sum += IPPROTO_UDP + (DataLength - (Pad ? 1 : 0));
+  Sum += Protocol + DataLength;
 
   /* Fold the checksum and return the one's complement */
   return ~ChecksumFold(Sum);
 }
 
+ULONG
+UDPv4ChecksumCalculate(
+  PIPv4_HEADER IPHeader,
+  PUCHAR PacketBuffer,
+  ULONG DataLength)
+{
+  return IPv4PseudoChecksumCalculate(IPHeader, IPPROTO_UDP, PacketBuffer, DataLength);
+}
+
+ULONG
+TCPv4ChecksumCalculate(
+  PIPv4_HEADER IPHeader,
+  PUCHAR PacketBuffer,
+  ULONG DataLength)
+{
+  return IPv4PseudoChecksumCalculate(IPHeader, IPPROTO_TCP, PacketBuffer, DataLength);
+}
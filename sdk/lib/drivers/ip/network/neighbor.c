@@ -12,6 +12,78 @@
 
 NEIGHBOR_CACHE_TABLE NeighborCache[NB_HASHMASK + 1];
 
+/* Number of times NBTimeout has run */
+ULONG NBTicks = 0;
+
+static __inline UINT NBHashAddress(
+    PIP_ADDRESS Address)
+{
+    /* Multiplicative hashing spreads hosts of the same subnet well */
+    return ((*(PULONG)&Address->Address) * 2654435761UL >> 24) & NB_HASHMASK;
+}
+
+/* Must be called with table lock acquired */
+static VOID NBScheduleEvent(
+    PNEIGHBOR_CACHE_TABLE Table,
+    PNEIGHBOR_CACHE_ENTRY NCE)
+/*
+ * FUNCTION: Puts an NCE on the timer wheel slot of its next event
+ * ARGUMENTS:
+ *     Table = Hash bucket the NCE lives in
+ *     NCE   = Pointer to NCE
+ * NOTES:
+ *     Received traffic only moves EventTime forward and leaves the NCE
+ *     where it is. NBTimeout notices that and reschedules it when the
+ *     slot comes around
+ */
+{
+    ULONG Age = NBTicks - NCE->EventTime;
+    ULONG NextAge;
+
+    RemoveEntryList(&NCE->WheelEntry);
+    InitializeListHead(&NCE->WheelEntry);
+
+    if (NCE->State & NUD_INCOMPLETE) {
+        /* Solicit every tick until we get an answer */
+        NCE->NextEvent = NBTicks + 1;
+    } else if (NCE->EventTimer == 0) {
+        /* Nothing is ever going to happen to it */
+        return;
+    } else {
+        /* Solicit after ARP_RATE ticks of silence, then every
+         * ARP_TIMEOUT_RETRANSMISSION ticks until it times out */
+        if (Age < ARP_RATE)
+            NextAge = ARP_RATE;
+        else
+            NextAge = Age + ARP_TIMEOUT_RETRANSMISSION - Age % ARP_TIMEOUT_RETRANSMISSION;
+
+        if (NextAge > NCE->EventTimer)
+            NextAge = NCE->EventTimer;
+
+        NCE->NextEvent = NCE->EventTime + NextAge;
+    }
+
+    InsertTailList(&Table->Wheel[NCE->NextEvent & (NB_WHEEL_SLOTS - 1)],
+                   &NCE->WheelEntry);
+}
+
+/* Must be called with table lock acquired */
+static VOID NBUnlinkNeighbor(
+    PNEIGHBOR_CACHE_TABLE Table,
+    PNEIGHBOR_CACHE_ENTRY NCE)
+{
+    PNEIGHBOR_CACHE_ENTRY *PrevNCE;
+
+    for (PrevNCE = &Table->Cache; *PrevNCE != NULL; PrevNCE = &(*PrevNCE)->Next) {
+        if (*PrevNCE == NCE) {
+            *PrevNCE = NCE->Next;
+            break;
+        }
+    }
+
+    RemoveEntryList(&NCE->WheelEntry);
+}
+
 VOID NBCompleteSend( PVOID Context,
 		     PNDIS_PACKET NdisPacket,
 		     NDIS_STATUS Status ) {
@@ -32,11 +104,7 @@ VOID NBSendPackets( PNEIGHBOR_CACHE_ENTRY NCE ) {
 
     ASSERT(!(NCE->State & NUD_INCOMPLETE));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(&NCE->Address);
 
     /* Send any waiting packets */
     while ((PacketEntry = ExInterlockedRemoveHeadList(&NCE->PacketQueue,
@@ -93,73 +161,88 @@ VOID NBTimeout(VOID)
  * FUNCTION: Neighbor address cache timeout handler
  * NOTES:
  *     This routine is called by IPTimeout to remove outdated cache
- *     entries.
+ *     entries. Only the NCEs on the timer wheel slot for this tick
+ *     are looked at
  */
 {
     UINT i;
-    PNEIGHBOR_CACHE_ENTRY *PrevNCE;
+    ULONG Now, Age;
+    PLIST_ENTRY Slot, CurrentEntry, NextEntry;
     PNEIGHBOR_CACHE_ENTRY NCE;
     NDIS_STATUS Status;
+    LIST_ENTRY DueList;
+
+    Now = ++NBTicks;
 
     for (i = 0; i <= NB_HASHMASK; i++) {
         TcpipAcquireSpinLockAtDpcLevel(&NeighborCache[i].Lock);
 
-        for (PrevNCE = &NeighborCache[i].Cache;
-             (NCE = *PrevNCE) != NULL;) {
-            if (NCE->State & NUD_INCOMPLETE)
-            {
-                /* Solicit for an address */
-                NBSendSolicit(NCE);
-                if (NCE->EventTimer == 0)
-                {
-                    NCE->EventCount++;
-                    if (NCE->EventCount == ARP_INCOMPLETE_TIMEOUT)
-                    {
-                        NBFlushPacketQueue(NCE, NDIS_STATUS_NETWORK_UNREACHABLE);
-                        NCE->EventCount = 0;
-                    }
-                }
+        /* Take out what is due, rescheduling may put it back on this slot */
+        InitializeListHead(&DueList);
+        Slot = &NeighborCache[i].Wheel[Now & (NB_WHEEL_SLOTS - 1)];
+        for (CurrentEntry = Slot->Flink; CurrentEntry != Slot; CurrentEntry = NextEntry) {
+            NextEntry = CurrentEntry->Flink;
+            NCE = CONTAINING_RECORD(CurrentEntry, NEIGHBOR_CACHE_ENTRY, WheelEntry);
+
+            if ((LONG)(Now - NCE->NextEvent) >= 0) {
+                RemoveEntryList(CurrentEntry);
+                InsertTailList(&DueList, CurrentEntry);
             }
+        }
 
-            /* Check if event timer is running */
-            if (NCE->EventTimer > 0)  {
+        while (!IsListEmpty(&DueList)) {
+            CurrentEntry = RemoveHeadList(&DueList);
+            InitializeListHead(CurrentEntry);
+            NCE = CONTAINING_RECORD(CurrentEntry, NEIGHBOR_CACHE_ENTRY, WheelEntry);
+            Age = Now - NCE->EventTime;
+
+            if (NCE->EventTimer > 0 && Age >= NCE->EventTimer) {
                 ASSERT(!(NCE->State & NUD_PERMANENT));
-                NCE->EventCount++;
 
-                if ((NCE->EventCount > ARP_RATE &&
-                     NCE->EventCount % ARP_TIMEOUT_RETRANSMISSION == 0) ||
-                    (NCE->EventCount == ARP_RATE))
+                /* Unlink and destroy the NCE */
+                NBUnlinkNeighbor(&NeighborCache[i], NCE);
+
+                /* Choose the proper failure status */
+                if (NCE->State & NUD_INCOMPLETE)
                 {
-                    /* We haven't gotten a packet from them in
-                     * EventCount seconds so we mark them as stale
-                     * and solicit now */
-                    NCE->State |= NUD_STALE;
-                    NBSendSolicit(NCE);
+                    /* We couldn't get an address to this IP at all */
+                    Status = NDIS_STATUS_HOST_UNREACHABLE;
                 }
-                if (NCE->EventTimer - NCE->EventCount == 0) {
-                    /* Unlink and destroy the NCE */
-                    *PrevNCE = NCE->Next;
-                    
-                    /* Choose the proper failure status */
-                    if (NCE->State & NUD_INCOMPLETE)
-                    {
-                        /* We couldn't get an address to this IP at all */
-                        Status = NDIS_STATUS_HOST_UNREACHABLE;
-                    }
-                    else
-                    {
-                        /* This guy was stale for way too long */
-                        Status = NDIS_STATUS_REQUEST_ABORTED;
-                    }
-                    
-                    NBFlushPacketQueue(NCE, Status);
-
-                    ExFreePoolWithTag(NCE, NCE_TAG);
-
-                    continue;
+                else
+                {
+                    /* This guy was stale for way too long */
+                    Status = NDIS_STATUS_REQUEST_ABORTED;
+                }
+
+                NBFlushPacketQueue(NCE, Status);
+
+                ExFreePoolWithTag(NCE, NCE_TAG);
+
+                continue;
+            }
+
+            if (NCE->State & NUD_INCOMPLETE)
+            {
+                /* Solicit for an address */
+                NBSendSolicit(NCE);
+                if (NCE->EventTimer == 0 && Age >= ARP_INCOMPLETE_TIMEOUT)
+                {
+                    NBFlushPacketQueue(NCE, NDIS_STATUS_NETWORK_UNREACHABLE);
+                    NCE->EventTime = Now;
                 }
             }
-            PrevNCE = &NCE->Next;
+            else if (NCE->EventTimer > 0 &&
+                     (Age == ARP_RATE ||
+                      (Age > ARP_RATE && Age % ARP_TIMEOUT_RETRANSMISSION == 0)))
+            {
+                /* We haven't gotten a packet from them in
+                 * Age seconds so we mark them as stale
+                 * and solicit now */
+                NCE->State |= NUD_STALE;
+                NBSendSolicit(NCE);
+            }
+
+            NBScheduleEvent(&NeighborCache[i], NCE);
         }
 
         TcpipReleaseSpinLockFromDpcLevel(&NeighborCache[i].Lock);
@@ -171,13 +254,15 @@ VOID NBStartup(VOID)
  * FUNCTION: Starts the neighbor cache
  */
 {
-    UINT i;
+    UINT i, j;
 
     TI_DbgPrint(DEBUG_NCACHE, ("Called.\n"));
 
     for (i = 0; i <= NB_HASHMASK; i++) {
 	NeighborCache[i].Cache = NULL;
 	TcpipInitializeSpinLock(&NeighborCache[i].Lock);
+	for (j = 0; j < NB_WHEEL_SLOTS; j++)
+	    InitializeListHead(&NeighborCache[i].Wheel[j]);
     }
 }
 
@@ -189,7 +274,7 @@ VOID NBShutdown(VOID)
   PNEIGHBOR_CACHE_ENTRY NextNCE;
   PNEIGHBOR_CACHE_ENTRY CurNCE;
   KIRQL OldIrql;
-  UINT i;
+  UINT i, j;
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called.\n"));
 
@@ -211,6 +296,8 @@ VOID NBShutdown(VOID)
       }
 
     NeighborCache[i].Cache = NULL;
+    for (j = 0; j < NB_WHEEL_SLOTS; j++)
+      InitializeListHead(&NeighborCache[i].Wheel[j]);
 
     TcpipReleaseSpinLock(&NeighborCache[i].Lock, OldIrql);
   }
@@ -253,6 +340,7 @@ VOID NBDestroyNeighborsForInterface(PIP_INTERFACE Interface)
             {
                 /* Unlink and destroy the NCE */
                 *PrevNCE = NCE->Next;
+                RemoveEntryList(&NCE->WheelEntry);
 
                 NBFlushPacketQueue(NCE, NDIS_STATUS_REQUEST_ABORTED);
                 ExFreePoolWithTag(NCE, NCE_TAG);
@@ -322,22 +410,21 @@ PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
       memset(NCE->LinkAddress, 0xff, LinkAddressLength);
   NCE->State = State;
   NCE->EventTimer = EventTimer;
-  NCE->EventCount = 0;
+  NCE->EventTime = NBTicks;
+  InitializeListHead( &NCE->WheelEntry );
   InitializeListHead( &NCE->PacketQueue );
 
   TI_DbgPrint(MID_TRACE,("NCE: %x\n", NCE));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
   NCE->Next = NeighborCache[HashValue].Cache;
   NeighborCache[HashValue].Cache = NCE;
 
+  NBScheduleEvent(&NeighborCache[HashValue], NCE);
+
   TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
 
   return NCE;
@@ -362,25 +449,22 @@ VOID NBUpdateNeighbor(
 
     TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X)  LinkAddress (0x%X)  State (0x%X).\n", NCE, LinkAddress, State));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(&NCE->Address);
 
     TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
     RtlCopyMemory(NCE->LinkAddress, LinkAddress, NCE->LinkAddressLength);
     NCE->State = State;
-    NCE->EventCount = 0;
+    NCE->EventTime = NBTicks;
+    if (!(NCE->State & NUD_INCOMPLETE) && NCE->EventTimer)
+        NCE->EventTimer = ARP_COMPLETE_TIMEOUT;
+
+    NBScheduleEvent(&NeighborCache[HashValue], NCE);
 
     TcpipReleaseSpinLock(&NeighborCache[HashValue].Lock, OldIrql);
 
     if( !(NCE->State & NUD_INCOMPLETE) )
-    {
-        if (NCE->EventTimer) NCE->EventTimer = ARP_COMPLETE_TIMEOUT;
         NBSendPackets( NCE );
-    }
 }
 
 VOID
@@ -392,11 +476,7 @@ NBResetNeighborTimeout(PIP_ADDRESS Address)
 
     TI_DbgPrint(DEBUG_NCACHE, ("Resetting NCE timout for 0x%s\n", A2S(Address)));
 
-    HashValue  = *(PULONG)(&Address->Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(Address);
 
     TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -406,7 +486,8 @@ NBResetNeighborTimeout(PIP_ADDRESS Address)
     {
          if (AddrIsEqual(Address, &NCE->Address))
          {
-             NCE->EventCount = 0;
+             /* NBTimeout catches up with this lazily */
+             NCE->EventTime = NBTicks;
              break;
          }
     }
@@ -436,11 +517,7 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. Address (0x%X).\n", Address));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -566,11 +643,7 @@ BOOLEAN NBQueuePacket(
 
   /* FIXME: Should we limit the number of queued packets? */
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(&NCE->Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -604,11 +677,7 @@ VOID NBRemoveNeighbor(
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X).\n", NCE));
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(&NCE->Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -621,6 +690,7 @@ VOID NBRemoveNeighbor(
         {
           /* Found it, now unlink it from the list */
           *PrevNCE = CurNCE->Next;
+          RemoveEntryList(&CurNCE->WheelEntry);
 
 	  NBFlushPacketQueue( CurNCE, NDIS_STATUS_REQUEST_ABORTED );
           ExFreePoolWithTag(CurNCE, NCE_TAG);
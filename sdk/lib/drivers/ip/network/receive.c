@@ -611,8 +611,9 @@ VOID IPv4Receive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
         return;
     }
 
-    /* Checksum IPv4 header */
-    if (!IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
+    /* Checksum IPv4 header, unless the adapter did it already */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_IP_CSUM) &&
+        !IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
         TI_DbgPrint(MIN_TRACE, ("Datagram received with bad checksum. Checksum field (0x%X)\n",
 	      WN2H(((PIPv4_HEADER)IPPacket->Header)->Checksum)));
         /* Discard packet */
@@ -635,6 +636,70 @@ VOID IPv4Receive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
 }
 
 
+BOOLEAN IPv4FastReceive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Receives a complete IPv4 TCP or UDP datagram in place
+ * ARGUMENTS:
+ *     IF       = Interface
+ *     IPPacket = Pointer to IP packet. Header points to the IPv4 header
+ *                in the received frame and TotalSize is the number of
+ *                contiguous bytes available there
+ * RETURNS:
+ *     TRUE if the datagram was consumed (or discarded), FALSE if it
+ *     has to go through IPReceive instead
+ * NOTES:
+ *     This is called at DISPATCH_LEVEL straight from the miniport
+ *     indication. Anything needing reassembly or an answer from us
+ *     (fragments, ICMP, options we don't handle here) is refused so the
+ *     caller can queue it. The packet is not freed
+ */
+{
+    PIPv4_HEADER IPv4Header = IPPacket->Header;
+    UINT HeaderSize, TotalLength;
+
+    if (IPPacket->TotalSize < sizeof(IPv4_HEADER))
+        return FALSE;
+
+    if ((IPv4Header->VerIHL >> 4) != 4 ||
+        (IPv4Header->Protocol != IPPROTO_TCP && IPv4Header->Protocol != IPPROTO_UDP))
+        return FALSE;
+
+    /* Fragments go through reassembly */
+    if (WN2H(IPv4Header->FlagsFragOfs) & (IPv4_MF_MASK | IPv4_FRAGOFS_MASK))
+        return FALSE;
+
+    HeaderSize = (IPv4Header->VerIHL & 0x0F) << 2;
+    TotalLength = WN2H(IPv4Header->TotalLength);
+    if (HeaderSize < sizeof(IPv4_HEADER) ||
+        TotalLength < HeaderSize ||
+        TotalLength > IPPacket->TotalSize)
+        return FALSE;
+
+    /* Checksum IPv4 header, unless the adapter did it already */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_IP_CSUM) &&
+        !IPv4CorrectChecksum(IPv4Header, HeaderSize)) {
+        TI_DbgPrint(MIN_TRACE, ("Datagram received with bad checksum. Checksum field (0x%X)\n",
+	      WN2H(IPv4Header->Checksum)));
+        /* Discard packet */
+        return TRUE;
+    }
+
+    /* Make it look like a reassembled datagram */
+    IPPacket->Type       = IP_ADDRESS_V4;
+    IPPacket->HeaderSize = HeaderSize;
+    IPPacket->TotalSize  = TotalLength;
+    IPPacket->Data       = (PVOID)((ULONG_PTR)IPv4Header + HeaderSize);
+    IPPacket->Position   = 0;
+
+    AddrInitIPv4(&IPPacket->SrcAddr, IPv4Header->SrcAddr);
+    AddrInitIPv4(&IPPacket->DstAddr, IPv4Header->DstAddr);
+
+    IPDispatchProtocol(IF, IPPacket);
+
+    return TRUE;
+}
+
+
 VOID IPReceive( PIP_INTERFACE IF, PIP_PACKET IPPacket )
 /*
  * FUNCTION: Receives an IP datagram (or fragment)
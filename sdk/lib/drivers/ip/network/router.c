@@ -17,6 +17,162 @@
 LIST_ENTRY FIBListHead;
 KSPIN_LOCK FIBLock;
 
+/* Lookup trie over FIBListHead, protected by FIBLock as well */
+PFIB_NODE FIBRoot = NULL;
+
+#define FIBMask(Length) ((Length) ? 0xFFFFFFFF << (32 - (Length)) : 0)
+#define FIBBit(Key, Index) (((Key) >> (31 - (Index))) & 1)
+
+static UINT FIBCommonLength(
+    ULONG Key1,
+    ULONG Key2,
+    UINT MaxLength)
+/*
+ * FUNCTION: Counts the leading bits two keys have in common
+ * ARGUMENTS:
+ *     Key1, Key2 = Keys to compare, in host order
+ *     MaxLength  = Don't count beyond this many bits
+ * RETURNS:
+ *     Number of common leading bits
+ */
+{
+    ULONG Difference = Key1 ^ Key2;
+    UINT Length = 0;
+
+    while (Length < MaxLength && !(Difference & 0x80000000)) {
+        Difference <<= 1;
+        Length++;
+    }
+
+    return Length;
+}
+
+
+static PFIB_NODE FIBAllocateNode(
+    ULONG Prefix,
+    UINT Length)
+{
+    PFIB_NODE Node;
+
+    Node = ExAllocatePoolWithTag(NonPagedPool, sizeof(FIB_NODE), FIB_NODE_TAG);
+    if (!Node)
+        return NULL;
+
+    Node->Parent = Node->Child[0] = Node->Child[1] = NULL;
+    Node->Prefix = Prefix & FIBMask(Length);
+    Node->Length = Length;
+    InitializeListHead(&Node->RouteListHead);
+
+    return Node;
+}
+
+
+static PFIB_NODE FIBInsertNode(
+    ULONG Prefix,
+    UINT Length)
+/*
+ * FUNCTION: Finds or creates the trie node for a prefix
+ * ARGUMENTS:
+ *     Prefix = Network prefix in host order
+ *     Length = Prefix length in bits
+ * RETURNS:
+ *     Pointer to the node, NULL if there was not enough free resources
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE *Link = &FIBRoot;
+    PFIB_NODE Parent = NULL, Node, New, Glue;
+    UINT Common;
+
+    Prefix &= FIBMask(Length);
+
+    while ((Node = *Link) != NULL) {
+        Common = FIBCommonLength(Node->Prefix, Prefix, min(Node->Length, Length));
+
+        if (Common == Node->Length) {
+            if (Node->Length == Length)
+                return Node;
+
+            /* Prefix is below this node */
+            Parent = Node;
+            Link = &Node->Child[FIBBit(Prefix, Node->Length)];
+            continue;
+        }
+
+        New = FIBAllocateNode(Prefix, Length);
+        if (!New)
+            return NULL;
+
+        if (Common == Length) {
+            /* Prefix is above this node */
+            New->Child[FIBBit(Node->Prefix, Length)] = Node;
+            New->Parent = Parent;
+            Node->Parent = New;
+            *Link = New;
+            return New;
+        }
+
+        /* The two diverge, join them under a new branch node */
+        Glue = FIBAllocateNode(Prefix, Common);
+        if (!Glue) {
+            ExFreePoolWithTag(New, FIB_NODE_TAG);
+            return NULL;
+        }
+
+        Glue->Child[FIBBit(Prefix, Common)] = New;
+        Glue->Child[FIBBit(Node->Prefix, Common)] = Node;
+        Glue->Parent = Parent;
+        New->Parent = Node->Parent = Glue;
+        *Link = Glue;
+        return New;
+    }
+
+    New = FIBAllocateNode(Prefix, Length);
+    if (!New)
+        return NULL;
+
+    New->Parent = Parent;
+    *Link = New;
+    return New;
+}
+
+
+static VOID FIBPruneNode(
+    PFIB_NODE Node)
+/*
+ * FUNCTION: Removes a node and its ancestors once they're no longer needed
+ * ARGUMENTS:
+ *     Node = Node that just lost a route
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE Parent, Child;
+
+    while (Node && IsListEmpty(&Node->RouteListHead) &&
+           !(Node->Child[0] && Node->Child[1])) {
+        Child = Node->Child[0] ? Node->Child[0] : Node->Child[1];
+        Parent = Node->Parent;
+
+        if (!Parent)
+            FIBRoot = Child;
+        else
+            Parent->Child[Parent->Child[1] == Node] = Child;
+
+        if (Child)
+            Child->Parent = Parent;
+
+        ExFreePoolWithTag(Node, FIB_NODE_TAG);
+
+        /* The parent keeps as many branches as before */
+        if (Child)
+            break;
+
+        Node = Parent;
+    }
+}
+
 void RouterDumpRoutes() {
     PLIST_ENTRY CurrentEntry;
     PLIST_ENTRY NextEntry;
@@ -69,6 +225,12 @@ VOID DestroyFIBE(
     /* Unlink the FIB entry from the list */
     RemoveEntryList(&FIBE->ListEntry);
 
+    /* And from the lookup trie */
+    if (FIBE->Node) {
+        RemoveEntryList(&FIBE->NodeListEntry);
+        FIBPruneNode(FIBE->Node);
+    }
+
     /* And free the FIB entry */
     FreeFIB(FIBE);
 }
@@ -207,6 +369,7 @@ PFIB_ENTRY RouterAddRoute(
  */
 {
     PFIB_ENTRY FIBE;
+    KIRQL OldIrql;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. NetworkAddress (0x%X)  Netmask (0x%X) "
         "Router (0x%X)  Metric (%d).\n", NetworkAddress, Netmask, Router, Metric));
@@ -228,9 +391,28 @@ PFIB_ENTRY RouterAddRoute(
 		   sizeof(FIBE->Netmask) );
     FIBE->Router         = Router;
     FIBE->Metric         = Metric;
+    FIBE->Node           = NULL;
+
+    TcpipAcquireSpinLock(&FIBLock, &OldIrql);
+
+    /* Index it for lookups */
+    if (NetworkAddress->Type == IP_ADDRESS_V4) {
+        FIBE->Node = FIBInsertNode(IPv4NToHl(NetworkAddress->Address.IPv4Address),
+                                   AddrCountPrefixBits(Netmask));
+        if (!FIBE->Node) {
+            TcpipReleaseSpinLock(&FIBLock, OldIrql);
+            TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+            FreeFIB(FIBE);
+            return NULL;
+        }
+
+        InsertTailList(&FIBE->Node->RouteListHead, &FIBE->NodeListEntry);
+    }
 
     /* Add FIB to the forward information base */
-    TcpipInterlockedInsertTailList(&FIBListHead, &FIBE->ListEntry, &FIBLock);
+    InsertTailList(&FIBListHead, &FIBE->ListEntry);
+
+    TcpipReleaseSpinLock(&FIBLock, OldIrql);
 
     return FIBE;
 }
@@ -244,50 +426,68 @@ PNEIGHBOR_CACHE_ENTRY RouterGetRoute(PIP_ADDRESS Destination)
  * RETURNS:
  *     Pointer to NCE for router, NULL if none was found
  * NOTES:
+ *     The longest matching prefix whose router is reachable wins. If no
+ *     matching router is reachable, the longest matching prefix is used
+ *     anyway
  *     If found the NCE is referenced
  */
 {
     KIRQL OldIrql;
     PLIST_ENTRY CurrentEntry;
-    PLIST_ENTRY NextEntry;
     PFIB_ENTRY Current;
+    PFIB_NODE Node;
+    ULONG Key;
     UCHAR State;
-    UINT Length, BestLength = 0, MaskLength;
-    PNEIGHBOR_CACHE_ENTRY NCE, BestNCE = NULL;
+    PNEIGHBOR_CACHE_ENTRY NCE, BestNCE = NULL, FallbackNCE = NULL;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. Destination (0x%X)\n", Destination));
 
     TI_DbgPrint(DEBUG_ROUTER, ("Destination (%s)\n", A2S(Destination)));
 
-    TcpipAcquireSpinLock(&FIBLock, &OldIrql);
-
-    CurrentEntry = FIBListHead.Flink;
-    while (CurrentEntry != &FIBListHead) {
-        NextEntry = CurrentEntry->Flink;
-	    Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, ListEntry);
+    if (Destination->Type != IP_ADDRESS_V4)
+        return NULL;
 
-        NCE   = Current->Router;
-        State = NCE->State;
+    Key = IPv4NToHl(Destination->Address.IPv4Address);
 
-	Length = CommonPrefixLength(Destination, &Current->NetworkAddress);
-	MaskLength = AddrCountPrefixBits(&Current->Netmask);
+    TcpipAcquireSpinLock(&FIBLock, &OldIrql);
 
-	TI_DbgPrint(DEBUG_ROUTER,("This-Route: %s (Sharing %d bits)\n",
-				  A2S(&NCE->Address), Length));
+    /* Walk down the trie, every node on the way is a shorter match */
+    Node = FIBRoot;
+    while (Node && (Key & FIBMask(Node->Length)) == Node->Prefix) {
+        for (CurrentEntry = Node->RouteListHead.Flink;
+             CurrentEntry != &Node->RouteListHead;
+             CurrentEntry = CurrentEntry->Flink) {
+            Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeListEntry);
+
+            NCE   = Current->Router;
+            State = NCE->State;
+
+            TI_DbgPrint(DEBUG_ROUTER,("This-Route: %s (Prefix %d bits)\n",
+                                      A2S(&NCE->Address), Node->Length));
+
+            /* Longest match so far, in case no router is reachable */
+            if (CurrentEntry == Node->RouteListHead.Flink)
+                FallbackNCE = NCE;
+
+            if (!(State & NUD_STALE) && !(State & NUD_INCOMPLETE)) {
+                /* This seems to be a better router */
+                BestNCE = NCE;
+                TI_DbgPrint(DEBUG_ROUTER,("Route selected\n"));
+                break;
+            }
+        }
 
-	if(Length >= MaskLength && (Length > BestLength || !BestNCE) &&
-           ((!(State & NUD_STALE) && !(State & NUD_INCOMPLETE)) || !BestNCE)) {
-	    /* This seems to be a better router */
-	    BestNCE    = NCE;
-	    BestLength = Length;
-	    TI_DbgPrint(DEBUG_ROUTER,("Route selected\n"));
-	}
+        if (Node->Length == 32)
+            break;
 
-        CurrentEntry = NextEntry;
+        Node = Node->Child[FIBBit(Key, Node->Length)];
     }
 
     TcpipReleaseSpinLock(&FIBLock, OldIrql);
 
+    if (!BestNCE)
+        BestNCE = FallbackNCE;
+
     if( BestNCE ) {
 	TI_DbgPrint(DEBUG_ROUTER,("Routing to %s\n", A2S(&BestNCE->Address)));
     } else {
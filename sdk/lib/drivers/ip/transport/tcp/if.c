@@ -7,6 +7,8 @@
 #include "lwip/api.h"
 #include "lwip/tcpip.h"
 
+#include "rosip.h"
+
 err_t
 TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
 {
@@ -135,9 +137,23 @@ TCPRegisterInterface(PIP_INTERFACE IF)
                                tcpip_input);
 }
 
+VOID
+TCPEnableReceiveCoalescing(PIP_INTERFACE IF)
+{
+    /* Only for interfaces that call TCPReceiveComplete after each batch */
+    if (!IF->TCPCoalesce)
+        IF->TCPCoalesce = LibIPCoalesceCreate(IF->TCPContext);
+}
+
 VOID
 TCPUnregisterInterface(PIP_INTERFACE IF)
 {
+    if (IF->TCPCoalesce)
+    {
+        LibIPCoalesceDestroy(IF->TCPCoalesce);
+        IF->TCPCoalesce = NULL;
+    }
+
     netif_remove(IF->TCPContext);
 }
 
@@ -173,11 +173,44 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
  *     This is the low level interface for receiving TCP data
  */
 {
+    ULONG DataLength;
+
     TI_DbgPrint(DEBUG_TCP,("Sending packet %d (%d) to lwIP\n",
                            IPPacket->TotalSize,
                            IPPacket->HeaderSize));
-    
-    LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
+
+    /* lwIP doesn't check it, see lwipopts.h */
+    if (IPPacket->Type == IP_ADDRESS_V4 &&
+        !(IPPacket->Flags & IP_PACKET_FLAG_TCP_CSUM))
+    {
+        DataLength = IPPacket->TotalSize - IPPacket->HeaderSize;
+        if (DataLength < sizeof(TCPv4_HEADER) ||
+            TCPv4ChecksumCalculate(IPPacket->Header,
+                                   IPPacket->Data,
+                                   DataLength) != DH2N(0x0000FFFF))
+        {
+            TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+            return;
+        }
+    }
+
+    if (Interface->TCPCoalesce)
+        LibIPCoalescePacket(Interface->TCPCoalesce, IPPacket->Header, IPPacket->TotalSize);
+    else
+        LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
+}
+
+VOID TCPReceiveComplete(PIP_INTERFACE Interface)
+/*
+ * FUNCTION: Ends a batch of received TCP segments
+ * ARGUMENTS:
+ *     Interface = Pointer to the interface the batch arrived on
+ * NOTES:
+ *     Hands lwIP whatever TCPReceive held back for coalescing
+ */
+{
+    if (Interface->TCPCoalesce)
+        LibIPCoalesceFlush(Interface->TCPCoalesce);
 }
 
 NTSTATUS TCPStartup(VOID)
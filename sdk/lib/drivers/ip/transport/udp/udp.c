@@ -279,14 +279,17 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
 
   UDPHeader = (PUDP_HEADER)IPPacket->Data;
 
-  /* Calculate and validate UDP checksum */
-  i = UDPv4ChecksumCalculate(IPv4Header,
-                             (PUCHAR)UDPHeader,
-                             WH2N(UDPHeader->Length));
-  if (i != DH2N(0x0000FFFF) && UDPHeader->Checksum != 0)
+  /* Calculate and validate UDP checksum, unless the adapter did it already */
+  if (!(IPPacket->Flags & IP_PACKET_FLAG_UDP_CSUM) && UDPHeader->Checksum != 0)
   {
-      TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
-      return;
+      i = UDPv4ChecksumCalculate(IPv4Header,
+                                 (PUCHAR)UDPHeader,
+                                 WH2N(UDPHeader->Length));
+      if (i != DH2N(0x0000FFFF))
+      {
+          TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+          return;
+      }
   }
 
   /* Sanity checks */
@@ -43,8 +43,9 @@ typedef ULONG_PTR mem_ptr_t;
 /* Endianness */
 #define BYTE_ORDER LITTLE_ENDIAN
 
-/* Checksum calculation algorithm choice */
-#define LWIP_CHKSUM_ALGORITHM 3
+/* Checksum calculation, shared with the rest of the stack */
+#define LWIP_CHKSUM LibIPChecksum
+u16_t LibIPChecksum(void *dataptr, int len);
 
 /* Diagnostics */
 #define LWIP_PLATFORM_DIAG(x) (DbgPrint x)
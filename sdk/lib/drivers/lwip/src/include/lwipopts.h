@@ -28,6 +28,12 @@
 
 #define IP_SOF_BROADCAST                1
 
+/* IP and TCP verify these before lwIP gets the packet, and
+ * coalesced TCP segments don't carry a valid TCP checksum */
+#define CHECKSUM_CHECK_IP               0
+
+#define CHECKSUM_CHECK_TCP              0
+
 #define IP_SOF_BROADCAST_RECV           1
 
 #define LWIP_ICMP                       0
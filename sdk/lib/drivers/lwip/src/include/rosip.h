@@ -10,6 +10,7 @@
     #define LWIP_TAG         'PIwl'
     #define LWIP_MESSAGE_TAG 'sMwl'
     #define LWIP_QUEUE_TAG   'uQwl'
+    #define LWIP_MBOX_TAG    'bMwl'
 #endif
 
 typedef struct tcp_pcb* PTCP_PCB;
@@ -43,7 +44,7 @@ struct lwip_callback_msg
         struct {
             PCONNECTION_ENDPOINT Connection;
             void *Data;
-            u16_t DataLength;
+            u32_t DataLength;
         } Send;
         struct {
             PCONNECTION_ENDPOINT Connection;
@@ -101,7 +102,7 @@ extern void TCPRecvEventHandler(void *arg);
 PTCP_PCB    LibTCPSocket(void *arg);
 err_t       LibTCPBind(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 PTCP_PCB    LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog);
-err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, u32_t *sent, const int safe);
+err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u32_t len, u32_t *sent, const int safe);
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
@@ -114,6 +115,11 @@ void        LibTCPGetSocketStatus(PTCP_PCB pcb, PULONG State);
 
 /* IP functions */
 void LibIPInsertPacket(void *ifarg, const void *const data, const u32_t size);
+void *LibIPCoalesceCreate(void *ifarg);
+void LibIPCoalesceDestroy(void *context);
+void LibIPCoalescePacket(void *context, const void *const data, const u32_t size);
+void LibIPCoalesceFlush(void *context);
+u16_t LibIPChecksum(void *dataptr, int len);
 void LibIPInitialize(void);
 void LibIPShutdown(void);
 
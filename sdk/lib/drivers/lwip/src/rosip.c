@@ -1,13 +1,25 @@
 #include "lwip/sys.h"
 #include "lwip/netif.h"
 #include "lwip/tcpip.h"
+#include "lwip/ip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/inet_chksum.h"
 
 #include "rosip.h"
 
+#include <checksum.h>
+
 #include <debug.h>
 
 typedef struct netif* PNETIF;
 
+u16_t
+LibIPChecksum(void *dataptr, int len)
+{
+    /* Folded but not complemented, the way inet_chksum.c wants it */
+    return (u16_t)ChecksumFold(ChecksumCompute(dataptr, len, 0));
+}
+
 void
 LibIPInsertPacket(void *ifarg,
                   const void *const data,
@@ -31,6 +43,243 @@ LibIPInsertPacket(void *ifarg,
     }
 }
 
+/* Limits for a coalesced segment. The total has to fit in IPH_LEN */
+#define COALESCE_MAX_SEGMENTS 16
+#define COALESCE_MAX_LENGTH   0xFFFF
+
+typedef struct _COALESCE_CONTEXT
+{
+    KSPIN_LOCK Lock;
+    PNETIF Netif;
+    struct pbuf *Pending;   /* Segment being grown, with its headers */
+    u32_t NextSeq;          /* Sequence number the next segment must have */
+    u16_t Segments;         /* Number of wire segments in Pending */
+} COALESCE_CONTEXT, *PCOALESCE_CONTEXT;
+
+void *
+LibIPCoalesceCreate(void *ifarg)
+{
+    PCOALESCE_CONTEXT Context;
+
+    ASSERT(ifarg);
+
+    Context = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Context), LWIP_TAG);
+    if (!Context)
+        return NULL;
+
+    KeInitializeSpinLock(&Context->Lock);
+    Context->Netif = ifarg;
+    Context->Pending = NULL;
+    Context->NextSeq = 0;
+    Context->Segments = 0;
+
+    return Context;
+}
+
+void
+LibIPCoalesceDestroy(void *context)
+{
+    PCOALESCE_CONTEXT Context = context;
+
+    LibIPCoalesceFlush(Context);
+
+    ExFreePoolWithTag(Context, LWIP_TAG);
+}
+
+static
+struct pbuf *
+LibIPCoalesceTake(PCOALESCE_CONTEXT Context)
+{
+    struct pbuf *p = Context->Pending;
+    struct ip_hdr *iphdr;
+
+    if (!p)
+        return NULL;
+
+    Context->Pending = NULL;
+
+    /* lwIP leaves the checksums to us, but keep the IP header consistent anyway.
+     * The TCP checksum was verified per segment and isn't looked at again */
+    if (Context->Segments > 1)
+    {
+        iphdr = p->payload;
+        IPH_LEN_SET(iphdr, htons(p->tot_len));
+        IPH_CHKSUM_SET(iphdr, 0);
+        IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+    }
+
+    return p;
+}
+
+static
+BOOLEAN
+LibIPCanCoalesce(const struct ip_hdr *iphdr,
+                 const u32_t size,
+                 u16_t *hdrlen,
+                 u16_t *datalen)
+{
+    const struct tcp_hdr *tcphdr;
+    u16_t iplen;
+
+    /* Plain IPv4 with no options, not a fragment */
+    if (size < IP_HLEN + TCP_HLEN ||
+        IPH_V(iphdr) != 4 ||
+        IPH_HL(iphdr) != IP_HLEN / 4 ||
+        IPH_PROTO(iphdr) != IP_PROTO_TCP ||
+        (ntohs(IPH_OFFSET(iphdr)) & (IP_MF | IP_OFFMASK)) != 0)
+    {
+        return FALSE;
+    }
+
+    iplen = ntohs(IPH_LEN(iphdr));
+    if (iplen > size)
+        return FALSE;
+
+    tcphdr = (const struct tcp_hdr *)((const u8_t *)iphdr + IP_HLEN);
+
+    /* Only pure data segments, anything else has to be seen on its own */
+    if ((TCPH_FLAGS(tcphdr) & ~TCP_PSH) != TCP_ACK)
+        return FALSE;
+
+    *hdrlen = IP_HLEN + TCPH_HDRLEN(tcphdr) * 4;
+    if (*hdrlen < IP_HLEN + TCP_HLEN || *hdrlen >= iplen)
+        return FALSE;
+
+    *datalen = iplen - *hdrlen;
+
+    return TRUE;
+}
+
+void
+LibIPCoalescePacket(void *context,
+                    const void *const data,
+                    const u32_t size)
+/*
+ * Receive path of interfaces that tell us where a batch of frames ends.
+ * In-order data segments of one connection that arrive in the same batch
+ * are joined into a single segment before lwIP sees them, so its per
+ * segment work (pcb lookup, ACK handling, receive callback) is done once
+ * per batch instead of once per frame. LibIPCoalesceFlush must be called
+ * at the end of the batch.
+ */
+{
+    PCOALESCE_CONTEXT Context = context;
+    const struct ip_hdr *iphdr = data;
+    const struct tcp_hdr *tcphdr;
+    struct ip_hdr *pendiphdr;
+    struct tcp_hdr *pendtcphdr;
+    struct pbuf *flush = NULL, *q;
+    u16_t hdrlen, datalen;
+    BOOLEAN push;
+    KIRQL OldIrql;
+
+    ASSERT(Context);
+    ASSERT(data);
+    ASSERT(size > 0);
+
+    if (!LibIPCanCoalesce(iphdr, size, &hdrlen, &datalen))
+    {
+        /* Keep the order: what we were holding goes first */
+        KeAcquireSpinLock(&Context->Lock, &OldIrql);
+        flush = LibIPCoalesceTake(Context);
+        KeReleaseSpinLock(&Context->Lock, OldIrql);
+
+        if (flush)
+            Context->Netif->input(flush, Context->Netif);
+
+        LibIPInsertPacket(Context->Netif, data, size);
+        return;
+    }
+
+    tcphdr = (const struct tcp_hdr *)((const u8_t *)iphdr + IP_HLEN);
+    push = (TCPH_FLAGS(tcphdr) & TCP_PSH) != 0;
+
+    KeAcquireSpinLock(&Context->Lock, &OldIrql);
+
+    if (Context->Pending)
+    {
+        pendiphdr = Context->Pending->payload;
+        pendtcphdr = (struct tcp_hdr *)((u8_t *)pendiphdr + IP_HLEN);
+
+        if (pendiphdr->src.addr == iphdr->src.addr &&
+            pendiphdr->dest.addr == iphdr->dest.addr &&
+            pendtcphdr->src == tcphdr->src &&
+            pendtcphdr->dest == tcphdr->dest &&
+            ntohl(tcphdr->seqno) == Context->NextSeq &&
+            pendtcphdr->ackno == tcphdr->ackno &&
+            pendtcphdr->wnd == tcphdr->wnd &&
+            TCPH_HDRLEN(pendtcphdr) == TCPH_HDRLEN(tcphdr) &&
+            RtlEqualMemory(pendtcphdr + 1, tcphdr + 1, hdrlen - IP_HLEN - TCP_HLEN) &&
+            Context->Pending->tot_len + datalen <= COALESCE_MAX_LENGTH)
+        {
+            q = pbuf_alloc(PBUF_RAW, datalen, PBUF_RAM);
+            if (q)
+            {
+                ASSERT(q->tot_len == q->len);
+
+                RtlCopyMemory(q->payload, (const u8_t *)data + hdrlen, datalen);
+                pbuf_cat(Context->Pending, q);
+
+                if (push)
+                    TCPH_SET_FLAG(pendtcphdr, TCP_PSH);
+
+                Context->NextSeq += datalen;
+                Context->Segments++;
+
+                if (push || Context->Segments == COALESCE_MAX_SEGMENTS)
+                    flush = LibIPCoalesceTake(Context);
+
+                KeReleaseSpinLock(&Context->Lock, OldIrql);
+
+                if (flush)
+                    Context->Netif->input(flush, Context->Netif);
+                return;
+            }
+        }
+
+        flush = LibIPCoalesceTake(Context);
+    }
+
+    /* Nothing can be added after a push, so don't hold on to that one */
+    if (!push)
+    {
+        q = pbuf_alloc(PBUF_RAW, hdrlen + datalen, PBUF_RAM);
+        if (q)
+        {
+            ASSERT(q->tot_len == q->len);
+
+            RtlCopyMemory(q->payload, data, q->len);
+
+            Context->Pending = q;
+            Context->NextSeq = ntohl(tcphdr->seqno) + datalen;
+            Context->Segments = 1;
+        }
+    }
+
+    KeReleaseSpinLock(&Context->Lock, OldIrql);
+
+    if (flush)
+        Context->Netif->input(flush, Context->Netif);
+
+    if (push)
+        LibIPInsertPacket(Context->Netif, data, size);
+}
+
+void
+LibIPCoalesceFlush(void *context)
+{
+    PCOALESCE_CONTEXT Context = context;
+    struct pbuf *p;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&Context->Lock, &OldIrql);
+    p = LibIPCoalesceTake(Context);
+    KeReleaseSpinLock(&Context->Lock, OldIrql);
+
+    if (p)
+        Context->Netif->input(p, Context->Netif);
+}
+
 void
 LibIPInitialize(void)
 {
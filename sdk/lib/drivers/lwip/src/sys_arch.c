@@ -14,6 +14,7 @@ static KSPIN_LOCK ThreadListLock;
 KEVENT TerminationEvent;
 NPAGED_LOOKASIDE_LIST MessageLookasideList;
 NPAGED_LOOKASIDE_LIST QueueEntryLookasideList;
+static NPAGED_LOOKASIDE_LIST MboxContainerLookasideList;
 
 static LARGE_INTEGER StartTime;
 
@@ -166,7 +167,7 @@ sys_mbox_post(sys_mbox_t *mbox, void *msg)
 {
     PLWIP_MESSAGE_CONTAINER Container;
     
-    Container = ExAllocatePool(NonPagedPool, sizeof(*Container));
+    Container = ExAllocateFromNPagedLookasideList(&MboxContainerLookasideList);
     ASSERT(Container);
     
     Container->Message = msg;
@@ -178,18 +179,46 @@ sys_mbox_post(sys_mbox_t *mbox, void *msg)
     KeSetEvent(&mbox->Event, IO_NO_INCREMENT, FALSE);
 }
 
+static
+BOOLEAN
+sys_arch_mbox_dequeue(sys_mbox_t *mbox, void **msg)
+{
+    PLWIP_MESSAGE_CONTAINER Container;
+    PLIST_ENTRY Entry;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&mbox->Lock, &OldIrql);
+    if (IsListEmpty(&mbox->ListHead))
+    {
+        KeReleaseSpinLock(&mbox->Lock, OldIrql);
+        return FALSE;
+    }
+    Entry = RemoveHeadList(&mbox->ListHead);
+    if (IsListEmpty(&mbox->ListHead))
+        KeClearEvent(&mbox->Event);
+    KeReleaseSpinLock(&mbox->Lock, OldIrql);
+
+    Container = CONTAINING_RECORD(Entry, LWIP_MESSAGE_CONTAINER, ListEntry);
+    if (msg)
+        *msg = Container->Message;
+    ExFreeToNPagedLookasideList(&MboxContainerLookasideList, Container);
+
+    return TRUE;
+}
+
 u32_t
 sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
 {
     LARGE_INTEGER LargeTimeout, PreWaitTime, PostWaitTime;
     UINT64 TimeDiff;
     NTSTATUS Status;
-    PVOID Message;
-    PLWIP_MESSAGE_CONTAINER Container;
-    PLIST_ENTRY Entry;
-    KIRQL OldIrql;
     PVOID WaitObjects[] = {&mbox->Event, &TerminationEvent};
     
+    /* The lwIP thread is busiest when messages are already queued up,
+     * so don't go through the dispatcher (or time the wait) for those */
+    if (sys_arch_mbox_dequeue(mbox, msg))
+        return 0;
+
     LargeTimeout.QuadPart = Int32x32To64(timeout, -10000);
     
     KeQuerySystemTime(&PreWaitTime);
@@ -205,19 +234,7 @@ sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
 
     if (Status == STATUS_WAIT_0)
     {
-        KeAcquireSpinLock(&mbox->Lock, &OldIrql);
-        Entry = RemoveHeadList(&mbox->ListHead);
-        ASSERT(Entry);
-        if (IsListEmpty(&mbox->ListHead))
-            KeClearEvent(&mbox->Event);
-        KeReleaseSpinLock(&mbox->Lock, OldIrql);
-        
-        Container = CONTAINING_RECORD(Entry, LWIP_MESSAGE_CONTAINER, ListEntry);
-        Message = Container->Message;
-        ExFreePool(Container);
-        
-        if (msg)
-            *msg = Message;
+        NT_VERIFY(sys_arch_mbox_dequeue(mbox, msg));
 
         KeQuerySystemTime(&PostWaitTime);
         TimeDiff = PostWaitTime.QuadPart - PreWaitTime.QuadPart;
@@ -242,7 +259,7 @@ sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
 u32_t
 sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
 {
-    if (sys_arch_mbox_fetch(mbox, msg, 1) != SYS_ARCH_TIMEOUT)
+    if (sys_arch_mbox_dequeue(mbox, msg))
         return 0;
     else
         return SYS_MBOX_EMPTY;
@@ -331,6 +348,14 @@ sys_init(void)
                                     sizeof(QUEUE_ENTRY),
                                     LWIP_QUEUE_TAG,
                                     0);
+
+    ExInitializeNPagedLookasideList(&MboxContainerLookasideList,
+                                    NULL,
+                                    NULL,
+                                    0,
+                                    sizeof(LWIP_MESSAGE_CONTAINER),
+                                    LWIP_MBOX_TAG,
+                                    0);
 }
 
 void
@@ -361,4 +386,5 @@ sys_shutdown(void)
     
     ExDeleteNPagedLookasideList(&MessageLookasideList);
     ExDeleteNPagedLookasideList(&QueueEntryLookasideList);
+    ExDeleteNPagedLookasideList(&MboxContainerLookasideList);
 }
@@ -531,7 +531,7 @@ WCHAR RxStarForTemplate = '*';
 WCHAR Rx8QMdot3QM[] = L">>>>>>>>.>>>*";
 BOOLEAN DisableByteRangeLockingOnReadOnlyFiles = FALSE;
 BOOLEAN DisableFlushOnCleanup = FALSE;
-ULONG ReadAheadGranularity = 1 << PAGE_SHIFT;
+ULONG ReadAheadGranularity = 16 << PAGE_SHIFT;
 LIST_ENTRY RxActiveContexts;
 NPAGED_LOOKASIDE_LIST RxContextLookasideList;
 RDBSS_DATA RxData;
@@ -8442,6 +8442,16 @@ RxReadRegistryParameters(
         {
             Granularity = 16;
         }
+        else if (Granularity == 0)
+        {
+            Granularity = 1;
+        }
+
+        /* Cc wants a power of two */
+        while (Granularity & (Granularity - 1))
+        {
+            Granularity &= Granularity - 1;
+        }
 
         ReadAheadGranularity = Granularity << PAGE_SHIFT;
     }
@@ -1298,7 +1298,29 @@ ElfWriteRecord(
     else // if (LogFile->Header.StartOffset > LogFile->Header.EndOffset)
         FreeSpace = LogFile->Header.StartOffset - LogFile->Header.EndOffset;
 
-    LogFile->Header.Flags |= ELF_LOGFILE_HEADER_DIRTY;
+    /*
+     * Mark the log dirty on disk before the first record of a batch goes out,
+     * so that an interrupted batch is detected and recovered when the log is
+     * reopened. The log becomes clean again at the next ElfFlushFile().
+     */
+    if (!(LogFile->Header.Flags & ELF_LOGFILE_HEADER_DIRTY))
+    {
+        LogFile->Header.Flags |= ELF_LOGFILE_HEADER_DIRTY;
+
+        FileOffset.QuadPart = 0LL;
+        Status = LogFile->FileWrite(LogFile,
+                                    &FileOffset,
+                                    &LogFile->Header,
+                                    sizeof(EVENTLOGHEADER),
+                                    &WrittenLength);
+        if (NT_SUCCESS(Status))
+            Status = LogFile->FileFlush(LogFile, NULL, 0);
+        if (!NT_SUCCESS(Status))
+        {
+            EVTLTRACE1("Cannot mark the log dirty (Status 0x%08lx)\n", Status);
+            return Status;
+        }
+    }
 
     /* If the event log was empty, it will now contain one record */
     if (LogFile->Header.OldestRecordNumber == 0)
@@ -1573,14 +1595,10 @@ ElfWriteRecord(
     }
     FileOffset = NextOffset;
 
-    /* Flush the log file */
-    Status = ElfFlushFile(LogFile);
-    if (!NT_SUCCESS(Status))
-    {
-        EVTLTRACE1("ElfFlushFile() failed (Status 0x%08lx)\n", Status);
-        return STATUS_EVENTLOG_FILE_CORRUPT; // Status;
-    }
-
+    /*
+     * The log file is not flushed here: the caller commits a whole batch
+     * of records at once with ElfFlushFile().
+     */
     return Status;
 }
 
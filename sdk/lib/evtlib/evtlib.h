@@ -269,6 +269,11 @@ ElfReadRecord(
     OUT PSIZE_T BytesRead OPTIONAL,
     OUT PSIZE_T BytesNeeded OPTIONAL);
 
+/*
+ * Records written with ElfWriteRecord() are only durable once the
+ * log has been committed with ElfFlushFile(), which callers should
+ * invoke once for a batch of records rather than after each record.
+ */
 NTSTATUS
 NTAPI
 ElfWriteRecord(
@@ -29,6 +29,47 @@
 #include <fast486.h>
 #include "common.h"
 
+/* PRIVATE FUNCTIONS **********************************************************/
+
+#ifndef FAST486_NO_PREFETCH
+
+static
+BOOLEAN
+FASTCALL
+Fast486Prefetch(PFAST486_STATE State, ULONG LineAddress)
+{
+    UCHAR Cpl = (UCHAR)Fast486GetCurrentPrivLevel(State);
+    PFAST486_PREFETCH_LINE Line = &State->PrefetchLines[(LineAddress / FAST486_CACHE_SIZE)
+                                                        % FAST486_CACHE_LINES];
+
+    /*
+     * Jumps back into recently executed code find their instructions here
+     * instead of going through the memory callbacks again. Writes to the
+     * line invalidate it (see Fast486InvalidatePrefetch).
+     */
+    if (!Line->Valid || (Line->Address != LineAddress) || (Line->Cpl != Cpl))
+    {
+        Line->Valid = FALSE;
+
+        if (!Fast486ReadLinearMemory(State, LineAddress, Line->Data, FAST486_CACHE_SIZE, TRUE))
+        {
+            State->PrefetchValid = FALSE;
+            return FALSE;
+        }
+
+        Line->Address = LineAddress;
+        Line->Cpl = Cpl;
+        Line->Valid = TRUE;
+    }
+
+    RtlCopyMemory(State->PrefetchCache, Line->Data, FAST486_CACHE_SIZE);
+    State->PrefetchAddress = LineAddress;
+    State->PrefetchValid = TRUE;
+    return TRUE;
+}
+
+#endif
+
 /* PUBLIC FUNCTIONS ***********************************************************/
 
 BOOLEAN
@@ -111,51 +152,34 @@ Fast486ReadMemory(PFAST486_STATE State,
     LinearAddress = CachedDescriptor->Base + Offset;
 
 #ifndef FAST486_NO_PREFETCH
-    if (InstFetch && ((Offset + FAST486_CACHE_SIZE - 1) <= CachedDescriptor->Limit))
+    if (InstFetch)
     {
-        State->PrefetchAddress = LinearAddress;
+        ULONG LineOffset = LinearAddress & (FAST486_CACHE_SIZE - 1);
 
-        if ((State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
-            && (PAGE_OFFSET(State->PrefetchAddress) > (FAST486_PAGE_SIZE - FAST486_CACHE_SIZE)))
+        /*
+         * Prefetch the aligned line containing the address, which never
+         * crosses a page boundary, as long as it lies within CS entirely.
+         */
+        if ((LineOffset <= Offset)
+            && ((Offset - LineOffset + FAST486_CACHE_SIZE - 1) <= CachedDescriptor->Limit)
+            && ((LineOffset + Size) <= FAST486_CACHE_SIZE))
         {
-            /* We mustn't prefetch across a page boundary */
-            State->PrefetchAddress = PAGE_ALIGN(State->PrefetchAddress)
-                                     | (FAST486_PAGE_SIZE - FAST486_CACHE_SIZE);
-
-            if ((LinearAddress - State->PrefetchAddress + Size) >= FAST486_CACHE_SIZE)
+            if (!Fast486Prefetch(State, LinearAddress - LineOffset))
             {
-                /* We can't prefetch without possibly violating page permissions */
-                State->PrefetchValid = FALSE;
-                return Fast486ReadLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
+                /* Exception occurred */
+                return FALSE;
             }
-        }
 
-        /* Prefetch */
-        if (Fast486ReadLinearMemory(State,
-                                    State->PrefetchAddress,
-                                    State->PrefetchCache,
-                                    FAST486_CACHE_SIZE,
-                                    TRUE))
-        {
-            State->PrefetchValid = TRUE;
-
-            RtlMoveMemory(Buffer,
-                          &State->PrefetchCache[LinearAddress - State->PrefetchAddress],
-                          Size);
+            RtlMoveMemory(Buffer, &State->PrefetchCache[LineOffset], Size);
             return TRUE;
         }
-        else
-        {
-            State->PrefetchValid = FALSE;
-            return FALSE;
-        }
+
+        State->PrefetchValid = FALSE;
     }
-    else
 #endif
-    {
-        /* Read from the linear address */
-        return Fast486ReadLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
-    }
+
+    /* Read from the linear address */
+    return Fast486ReadLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
 }
 
 BOOLEAN
@@ -230,18 +254,6 @@ Fast486WriteMemory(PFAST486_STATE State,
     /* Find the linear address */
     LinearAddress = CachedDescriptor->Base + Offset;
 
-#ifndef FAST486_NO_PREFETCH
-    if (State->PrefetchValid
-        && (LinearAddress >= State->PrefetchAddress)
-        && ((LinearAddress + Size) <= (State->PrefetchAddress + FAST486_CACHE_SIZE)))
-    {
-        /* Update the prefetch */
-        RtlMoveMemory(&State->PrefetchCache[LinearAddress - State->PrefetchAddress],
-                      Buffer,
-                      min(Size, FAST486_CACHE_SIZE + State->PrefetchAddress - LinearAddress));
-    }
-#endif
-
     /* Write to the linear address */
     return Fast486WriteLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
 }
@@ -909,7 +921,7 @@ Fast486TaskSwitch(PFAST486_STATE State, FAST486_TASK_SWITCH_TYPE Type, USHORT Se
 
 #ifndef FAST486_NO_PREFETCH
     /* Context switching invalidates the prefetch */
-    State->PrefetchValid = FALSE;
+    Fast486FlushPrefetch(State);
 #endif
 
     /* Load the registers */
@@ -155,6 +155,137 @@ Fast486FlushTlb(PFAST486_STATE State)
     State->TlbEmpty = TRUE;
 }
 
+#ifndef FAST486_NO_PREFETCH
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushPrefetch(PFAST486_STATE State)
+{
+    ULONG i;
+
+    State->PrefetchValid = FALSE;
+    for (i = 0; i < FAST486_CACHE_LINES; i++) State->PrefetchLines[i].Valid = FALSE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486InvalidatePrefetch(PFAST486_STATE State,
+                          ULONG LinearAddress,
+                          ULONG Size)
+{
+    ULONG Address = LinearAddress & ~(FAST486_CACHE_SIZE - 1);
+    ULONG LastAddress = (LinearAddress + Size - 1) & ~(FAST486_CACHE_SIZE - 1);
+
+    if (((LastAddress - Address) / FAST486_CACHE_SIZE) >= FAST486_CACHE_LINES)
+    {
+        /* The write covers every line */
+        Fast486FlushPrefetch(State);
+        return;
+    }
+
+    while (TRUE)
+    {
+        PFAST486_PREFETCH_LINE Line = &State->PrefetchLines[(Address / FAST486_CACHE_SIZE)
+                                                            % FAST486_CACHE_LINES];
+
+        if (Line->Address == Address)
+        {
+            /* Self-modifying code, fetch these instructions again */
+            Line->Valid = FALSE;
+            if (State->PrefetchAddress == Address) State->PrefetchValid = FALSE;
+        }
+
+        if (Address == LastAddress) break;
+        Address += FAST486_CACHE_SIZE;
+    }
+}
+
+#endif
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486ReadPhysicalMemory(PFAST486_STATE State,
+                          ULONG Address,
+                          PVOID Buffer,
+                          ULONG Size)
+{
+    ULONG Page = Address >> 12;
+    PUCHAR Pointer;
+
+    if ((Page >= State->MemoryMapPages)
+        || ((PAGE_OFFSET(Address) + Size) > FAST486_PAGE_SIZE)
+        || ((Pointer = State->MemoryMap[Page]) == NULL))
+    {
+        State->MemReadCallback(State, Address, Buffer, Size);
+        return;
+    }
+
+    /* Plain memory, bypass the callback */
+    Pointer += PAGE_OFFSET(Address);
+    switch (Size)
+    {
+        case sizeof(UCHAR):
+            *(PUCHAR)Buffer = *Pointer;
+            break;
+
+        case sizeof(USHORT):
+            *(USHORT UNALIGNED*)Buffer = *(USHORT UNALIGNED*)Pointer;
+            break;
+
+        case sizeof(ULONG):
+            *(ULONG UNALIGNED*)Buffer = *(ULONG UNALIGNED*)Pointer;
+            break;
+
+        default:
+            RtlMoveMemory(Buffer, Pointer, Size);
+            break;
+    }
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486WritePhysicalMemory(PFAST486_STATE State,
+                           ULONG Address,
+                           PVOID Buffer,
+                           ULONG Size)
+{
+    ULONG Page = Address >> 12;
+    PUCHAR Pointer;
+
+    if ((Page >= State->MemoryMapPages)
+        || ((PAGE_OFFSET(Address) + Size) > FAST486_PAGE_SIZE)
+        || ((Pointer = State->MemoryMap[Page]) == NULL))
+    {
+        State->MemWriteCallback(State, Address, Buffer, Size);
+        return;
+    }
+
+    /* Plain memory, bypass the callback */
+    Pointer += PAGE_OFFSET(Address);
+    switch (Size)
+    {
+        case sizeof(UCHAR):
+            *Pointer = *(PUCHAR)Buffer;
+            break;
+
+        case sizeof(USHORT):
+            *(USHORT UNALIGNED*)Pointer = *(USHORT UNALIGNED*)Buffer;
+            break;
+
+        case sizeof(ULONG):
+            *(ULONG UNALIGNED*)Pointer = *(ULONG UNALIGNED*)Buffer;
+            break;
+
+        default:
+            RtlMoveMemory(Pointer, Buffer, Size);
+            break;
+    }
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -208,10 +339,10 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
             }
 
             /* Read the memory */
-            State->MemReadCallback(State,
-                                   (TableEntry.Address << 12) | PageOffset,
-                                   (PVOID)((ULONG_PTR)Buffer + BufferOffset),
-                                   PageLength);
+            Fast486ReadPhysicalMemory(State,
+                                      (TableEntry.Address << 12) | PageOffset,
+                                      (PVOID)((ULONG_PTR)Buffer + BufferOffset),
+                                      PageLength);
 
             BufferOffset += PageLength;
         }
@@ -219,7 +350,7 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
     else
     {
         /* Read the memory */
-        State->MemReadCallback(State, LinearAddress, Buffer, Size);
+        Fast486ReadPhysicalMemory(State, LinearAddress, Buffer, Size);
     }
 
     return TRUE;
@@ -234,6 +365,10 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                          ULONG Size,
                          BOOLEAN CheckPrivilege)
 {
+#ifndef FAST486_NO_PREFETCH
+    Fast486InvalidatePrefetch(State, LinearAddress, Size);
+#endif
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -281,10 +416,10 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
             }
 
             /* Write the memory */
-            State->MemWriteCallback(State,
-                                    (TableEntry.Address << 12) | PageOffset,
-                                    (PVOID)((ULONG_PTR)Buffer + BufferOffset),
-                                    PageLength);
+            Fast486WritePhysicalMemory(State,
+                                       (TableEntry.Address << 12) | PageOffset,
+                                       (PVOID)((ULONG_PTR)Buffer + BufferOffset),
+                                       PageLength);
 
             BufferOffset += PageLength;
         }
@@ -292,7 +427,7 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
     else
     {
         /* Write the memory */
-        State->MemWriteCallback(State, LinearAddress, Buffer, Size);
+        Fast486WritePhysicalMemory(State, LinearAddress, Buffer, Size);
     }
 
     return TRUE;
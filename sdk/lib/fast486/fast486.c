@@ -122,6 +122,10 @@ Fast486Initialize(PFAST486_STATE         State,
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
+    /* Everything goes through the memory callbacks until a map is set */
+    State->MemoryMap = NULL;
+    State->MemoryMapPages = 0;
+
     /* Reset the CPU */
     Fast486Reset(State);
 }
@@ -132,7 +136,7 @@ Fast486Reset(PFAST486_STATE State)
 {
     FAST486_SEG_REGS i;
 
-    /* Save the callbacks and TLB */
+    /* Save the callbacks, TLB and memory map */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
@@ -141,6 +145,8 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
     PULONG                 Tlb              = State->Tlb;
+    PUCHAR                *MemoryMap        = State->MemoryMap;
+    ULONG                  MemoryMapPages   = State->MemoryMapPages;
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -186,7 +192,7 @@ Fast486Reset(PFAST486_STATE State)
     State->FpuTag = 0xFFFF;
 #endif
 
-    /* Restore the callbacks and TLB */
+    /* Restore the callbacks, TLB and memory map */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
     State->IoReadCallback   = IoReadCallback;
@@ -195,6 +201,8 @@ Fast486Reset(PFAST486_STATE State)
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
     State->Tlb              = Tlb;
+    State->MemoryMap        = MemoryMap;
+    State->MemoryMapPages   = MemoryMapPages;
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
@@ -260,4 +268,17 @@ Fast486Rewind(PFAST486_STATE State)
 #endif
 }
 
+VOID
+NTAPI
+Fast486SetMemoryMap(PFAST486_STATE State, PUCHAR *MemoryMap, ULONG NumPages)
+{
+    /*
+     * Each entry of the map points to the host memory backing one physical
+     * page, or is NULL if the page must go through the memory callbacks.
+     * The map belongs to the caller, which keeps it up to date.
+     */
+    State->MemoryMap = MemoryMap;
+    State->MemoryMapPages = MemoryMap ? NumPages : 0;
+}
+
 /* EOF */
@@ -2261,7 +2261,7 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
         {
 #ifndef FAST486_NO_PREFETCH
             /* Invalidate the prefetch */
-            State->PrefetchValid = FALSE;
+            Fast486FlushPrefetch(State);
 #endif
 
             /* This is a privileged instruction */
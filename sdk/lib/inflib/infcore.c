@@ -82,6 +82,31 @@ static const parser_state_func parser_funcs[NB_PARSER_STATES] =
 
 /* PRIVATE FUNCTIONS ********************************************************/
 
+/*
+ * Case-insensitive hash of a section name or key. Only ASCII letters are
+ * folded; other characters all hash alike, so names that strcmpiW considers
+ * equal always end up in the same bucket.
+ */
+static ULONG
+InfpHashName(PCWSTR Name)
+{
+  ULONG Hash = 0;
+  WCHAR Char;
+
+  for (; *Name != 0; Name++)
+    {
+      Char = *Name;
+      if (Char >= L'A' && Char <= L'Z')
+        Char += L'a' - L'A';
+      else if (Char >= 0x80)
+        Char = 0x80;
+
+      Hash = Hash * 31 + Char;
+    }
+
+  return Hash;
+}
+
 static PINFCACHELINE
 InfpFreeLine (PINFCACHELINE Line)
 {
@@ -133,12 +158,30 @@ InfpFreeSection (PINFCACHESECTION Section)
     }
   Section->LastLine = NULL;
 
+  if (Section->LineIndex != NULL)
+    FREE (Section->LineIndex);
+  if (Section->KeyHash != NULL)
+    FREE (Section->KeyHash);
+
   FREE (Section);
 
   return Next;
 }
 
 
+VOID
+InfpFreeSectionIndex(PINFCACHE Cache)
+{
+  if (Cache->SectionIndex != NULL)
+    {
+      FREE (Cache->SectionIndex);
+      Cache->SectionIndex = NULL;
+    }
+  Cache->SectionIndexCount = 0;
+  Cache->SectionIndexSize = 0;
+}
+
+
 PINFCACHESECTION
 InfpFindSection(PINFCACHE Cache,
                 PCWSTR Name)
@@ -150,8 +193,8 @@ InfpFindSection(PINFCACHE Cache,
       return NULL;
     }
 
-  /* iterate through list of sections */
-  Section = Cache->FirstSection;
+  /* iterate through the sections with the same hash */
+  Section = Cache->SectionHash[InfpHashName(Name) % INF_SECTION_HASH_SIZE];
   while (Section != NULL)
     {
       if (strcmpiW(Section->Name, Name) == 0)
@@ -160,7 +203,7 @@ InfpFindSection(PINFCACHE Cache,
         }
 
       /* get the next section*/
-      Section = Section->Next;
+      Section = Section->HashNext;
     }
 
   return NULL;
@@ -173,6 +216,7 @@ InfpAddSection(PINFCACHE Cache,
 {
   PINFCACHESECTION Section = NULL;
   ULONG Size;
+  ULONG Bucket;
 
   if (Cache == NULL || Name == NULL)
     {
@@ -209,6 +253,11 @@ InfpAddSection(PINFCACHE Cache,
       Cache->LastSection = Section;
     }
 
+  /* Add it to the name hash table */
+  Bucket = InfpHashName(Name) % INF_SECTION_HASH_SIZE;
+  Section->HashNext = Cache->SectionHash[Bucket];
+  Cache->SectionHash[Bucket] = Section;
+
   return Section;
 }
 
@@ -251,11 +300,99 @@ InfpAddLine(PINFCACHESECTION Section)
   return Line;
 }
 
+/*
+ * Sections and lines are only ever appended and get consecutive Ids, so the
+ * one with Id N is the Nth of its list. The indexes are extended from the
+ * lists whenever an Id beyond their end is looked up.
+ */
+static VOID
+InfpUpdateSectionIndex(PINFCACHE Cache)
+{
+    PINFCACHESECTION Section;
+    PINFCACHESECTION *Index;
+    UINT Size;
+
+    if (Cache->NextSectionId > Cache->SectionIndexSize)
+    {
+        Size = Cache->SectionIndexSize * 2;
+        if (Size < Cache->NextSectionId)
+            Size = Cache->NextSectionId;
+        Index = (PINFCACHESECTION *)MALLOC(Size * sizeof(PINFCACHESECTION));
+        if (Index == NULL)
+            return;
+
+        if (Cache->SectionIndex != NULL)
+        {
+            MEMCPY(Index, Cache->SectionIndex, Cache->SectionIndexCount * sizeof(PINFCACHESECTION));
+            FREE(Cache->SectionIndex);
+        }
+
+        Cache->SectionIndex = Index;
+        Cache->SectionIndexSize = Size;
+    }
+
+    Section = (Cache->SectionIndexCount != 0) ? Cache->SectionIndex[Cache->SectionIndexCount - 1]->Next
+                                              : Cache->FirstSection;
+    for (; Section != NULL && Cache->SectionIndexCount < Cache->SectionIndexSize; Section = Section->Next)
+    {
+        Cache->SectionIndex[Cache->SectionIndexCount++] = Section;
+    }
+}
+
+static VOID
+InfpUpdateLineIndex(PINFCACHESECTION Section)
+{
+    PINFCACHELINE Line;
+    PINFCACHELINE *Index;
+    UINT Size;
+
+    if (Section->NextLineId > Section->LineIndexSize)
+    {
+        Size = Section->LineIndexSize * 2;
+        if (Size < Section->NextLineId)
+            Size = Section->NextLineId;
+        Index = (PINFCACHELINE *)MALLOC(Size * sizeof(PINFCACHELINE));
+        if (Index == NULL)
+            return;
+
+        if (Section->LineIndex != NULL)
+        {
+            MEMCPY(Index, Section->LineIndex, Section->LineIndexCount * sizeof(PINFCACHELINE));
+            FREE(Section->LineIndex);
+        }
+
+        Section->LineIndex = Index;
+        Section->LineIndexSize = Size;
+    }
+
+    Line = (Section->LineIndexCount != 0) ? Section->LineIndex[Section->LineIndexCount - 1]->Next
+                                          : Section->FirstLine;
+    for (; Line != NULL && Section->LineIndexCount < Section->LineIndexSize; Line = Line->Next)
+    {
+        Section->LineIndex[Section->LineIndexCount++] = Line;
+    }
+}
+
 PINFCACHESECTION
 InfpFindSectionById(PINFCACHE Cache, UINT Id)
 {
     PINFCACHESECTION Section;
 
+    if (Id == 0 || Id > Cache->NextSectionId)
+    {
+        return NULL;
+    }
+
+    if (Id > Cache->SectionIndexCount)
+    {
+        InfpUpdateSectionIndex(Cache);
+    }
+
+    if (Id <= Cache->SectionIndexCount && Cache->SectionIndex[Id - 1]->Id == Id)
+    {
+        return Cache->SectionIndex[Id - 1];
+    }
+
     for (Section = Cache->FirstSection;
          Section != NULL;
          Section = Section->Next)
@@ -293,6 +430,21 @@ InfpFindLineById(PINFCACHESECTION Section, UINT Id)
 {
     PINFCACHELINE Line;
 
+    if (Id == 0 || Id > Section->NextLineId)
+    {
+        return NULL;
+    }
+
+    if (Id > Section->LineIndexCount)
+    {
+        InfpUpdateLineIndex(Section);
+    }
+
+    if (Id <= Section->LineIndexCount && Section->LineIndex[Id - 1]->Id == Id)
+    {
+        return Section->LineIndex[Id - 1];
+    }
+
     for (Line = Section->FirstLine;
          Line != NULL;
          Line = Line->Next)
@@ -386,6 +538,67 @@ InfpAddFieldToLine(PINFCACHELINE Line,
 }
 
 
+/*
+ * Enters the keyed lines into the key hash table of the section, growing it
+ * as the section grows. The last line is left out since its key may not have
+ * been set yet, and only the first line of duplicate keys is entered.
+ */
+static BOOLEAN
+InfpUpdateKeyHash(PINFCACHESECTION Section)
+{
+  PINFCACHELINE Line;
+  PINFCACHELINE Other;
+  ULONG Bucket;
+  UINT Size;
+
+  if (Section->KeyHash == NULL || (UINT)Section->LineCount > Section->KeyHashSize * 2)
+    {
+      for (Size = INF_KEY_HASH_MIN_LINES; Size < (UINT)Section->LineCount; Size *= 2)
+        ;
+
+      if (Section->KeyHash != NULL)
+        {
+          FREE (Section->KeyHash);
+          Section->KeyHash = NULL;
+        }
+
+      Section->KeyHash = (PINFCACHELINE *)MALLOC(Size * sizeof(PINFCACHELINE));
+      if (Section->KeyHash == NULL)
+        {
+          return FALSE;
+        }
+      ZEROMEMORY (Section->KeyHash,
+                  Size * sizeof(PINFCACHELINE));
+      Section->KeyHashSize = Size;
+      Section->KeyHashLast = NULL;
+    }
+
+  Line = (Section->KeyHashLast != NULL) ? Section->KeyHashLast->Next : Section->FirstLine;
+  for (; Line != NULL && Line != Section->LastLine; Line = Line->Next)
+    {
+      Section->KeyHashLast = Line;
+
+      if (Line->Key == NULL)
+        continue;
+
+      Bucket = InfpHashName(Line->Key) & (Section->KeyHashSize - 1);
+      for (Other = Section->KeyHash[Bucket]; Other != NULL; Other = Other->HashNext)
+        {
+          if (strcmpiW(Other->Key, Line->Key) == 0)
+            break;
+        }
+
+      if (Other == NULL)
+        {
+          Line->HashNext = Section->KeyHash[Bucket];
+          Section->KeyHash[Bucket] = Line;
+        }
+    }
+
+  return TRUE;
+}
+
+
 PINFCACHELINE
 InfpFindKeyLine(PINFCACHESECTION Section,
                 PCWSTR Key)
@@ -393,6 +606,24 @@ InfpFindKeyLine(PINFCACHESECTION Section,
   PINFCACHELINE Line;
 
   Line = Section->FirstLine;
+
+  if (Section->LineCount >= INF_KEY_HASH_MIN_LINES && InfpUpdateKeyHash(Section))
+    {
+      Line = Section->KeyHash[InfpHashName(Key) & (Section->KeyHashSize - 1)];
+      while (Line != NULL)
+        {
+          if (strcmpiW(Line->Key, Key) == 0)
+            {
+              return Line;
+            }
+
+          Line = Line->HashNext;
+        }
+
+      /* Only the lines after the hashed ones are left to check */
+      Line = (Section->KeyHashLast != NULL) ? Section->KeyHashLast->Next : Section->FirstLine;
+    }
+
   while (Line != NULL)
     {
       if (Line->Key != NULL && strcmpiW(Line->Key, Key) == 0)
@@ -296,6 +296,7 @@ InfHostCloseFile(HINF InfHandle)
       Cache->FirstSection = InfpFreeSection(Cache->FirstSection);
     }
   Cache->LastSection = NULL;
+  InfpFreeSectionIndex(Cache);
 
   FREE(Cache);
 }
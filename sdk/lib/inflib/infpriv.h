@@ -18,6 +18,12 @@
 #define INF_STATUS_WRONG_INF_STYLE         ((INFSTATUS)0xC0700003)
 #define INF_STATUS_NOT_ENOUGH_MEMORY       ((INFSTATUS)0xC0700004)
 
+/* Number of buckets of the section name hash table */
+#define INF_SECTION_HASH_SIZE  256
+
+/* Sections with fewer lines are searched for a key without the hash table */
+#define INF_KEY_HASH_MIN_LINES 16
+
 typedef struct _INFCACHEFIELD
 {
   struct _INFCACHEFIELD *Next;
@@ -30,6 +36,7 @@ typedef struct _INFCACHELINE
 {
   struct _INFCACHELINE *Next;
   struct _INFCACHELINE *Prev;
+  struct _INFCACHELINE *HashNext;   /* next line in the same key hash bucket */
   UINT Id;
 
   LONG FieldCount;
@@ -53,6 +60,18 @@ typedef struct _INFCACHESECTION
   LONG LineCount;
   UINT NextLineId;
 
+  struct _INFCACHESECTION *HashNext; /* next section in the same name hash bucket */
+
+  /* Lines by Id, built on demand */
+  PINFCACHELINE *LineIndex;
+  UINT LineIndexCount;
+  UINT LineIndexSize;
+
+  /* Lines by key, built on demand for large sections */
+  PINFCACHELINE *KeyHash;
+  UINT KeyHashSize;
+  PINFCACHELINE KeyHashLast;        /* last line entered into KeyHash */
+
   WCHAR Name[1];
 } INFCACHESECTION, *PINFCACHESECTION;
 
@@ -64,6 +83,13 @@ typedef struct _INFCACHE
   UINT NextSectionId;
 
   PINFCACHESECTION StringsSection;
+
+  PINFCACHESECTION SectionHash[INF_SECTION_HASH_SIZE];
+
+  /* Sections by Id, built on demand */
+  PINFCACHESECTION *SectionIndex;
+  UINT SectionIndexCount;
+  UINT SectionIndexSize;
 } INFCACHE, *PINFCACHE;
 
 typedef struct _INFCONTEXT
@@ -83,6 +109,7 @@ extern INFSTATUS InfpParseBuffer(PINFCACHE file,
                                  const WCHAR *end,
                                  PULONG error_line);
 extern PINFCACHESECTION InfpFreeSection(PINFCACHESECTION Section);
+extern VOID InfpFreeSectionIndex(PINFCACHE Cache);
 extern PINFCACHESECTION InfpAddSection(PINFCACHE Cache,
                                        PCWSTR Name);
 extern PINFCACHELINE InfpAddLine(PINFCACHESECTION Section);
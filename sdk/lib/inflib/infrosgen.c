@@ -347,6 +347,7 @@ InfCloseFile(HINF InfHandle)
       Cache->FirstSection = InfpFreeSection(Cache->FirstSection);
     }
   Cache->LastSection = NULL;
+  InfpFreeSectionIndex(Cache);
 
   FREE(Cache);
 
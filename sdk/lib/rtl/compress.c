@@ -20,6 +20,13 @@
 #define COMPRESSION_FORMAT_MASK  0x00FF
 #define COMPRESSION_ENGINE_MASK  0xFF00
 
+#ifndef COMPRESSION_FORMAT_XPRESS
+#define COMPRESSION_FORMAT_XPRESS       (0x0003)
+#endif
+#ifndef COMPRESSION_FORMAT_XPRESS_HUFF
+#define COMPRESSION_FORMAT_XPRESS_HUFF  (0x0004)
+#endif
+
 
 
 
@@ -216,18 +223,146 @@ out:
 }
 
 
+/* LZNT1 compressor hash chains: one head per hashed 3-byte prefix, one link
+ * per position of the current chunk. Both live in the caller's workspace. */
+#define LZNT1_HASH_SIZE     0x1000
+#define LZNT1_HASH(p)       ((((p)[0] << 8) ^ ((p)[1] << 4) ^ (p)[2]) & (LZNT1_HASH_SIZE - 1))
+#define LZNT1_NO_POSITION   0xFFFF
+
+/* Longest hash chain walked per position, for each engine */
+#define LZNT1_CHAIN_STANDARD    16
+#define LZNT1_CHAIN_MAXIMUM     256
+
+/* compress a single LZNT1 chunk, returns 0 if it doesn't fit dst_size */
+static ULONG lznt1_compress_chunk(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                  USHORT *workspace, ULONG max_chain)
+{
+    USHORT *head = workspace, *prev = workspace + LZNT1_HASH_SIZE;
+    ULONG displacement_bits, length_bits;
+    ULONG pos = 0, dst_pos = 0, flags_pos = 0, flag = 0;
+    ULONG max_length, max_displacement, chain;
+    ULONG length, best_length, best_displacement, candidate, hash;
+    WORD code;
+
+    for (hash = 0; hash < LZNT1_HASH_SIZE; hash++)
+        head[hash] = LZNT1_NO_POSITION;
+
+    while (pos < src_size)
+    {
+        /* start a new group of 8 entities */
+        if (!flag)
+        {
+            if (dst_pos >= dst_size) return 0;
+            flags_pos = dst_pos++;
+            dst[flags_pos] = 0;
+        }
+
+        /* the split of a backwards reference depends on the position, same as in
+         * lznt1_decompress_chunk */
+        for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+            if ((1 << (displacement_bits - 1)) < pos) break;
+        length_bits      = 16 - displacement_bits;
+        max_length       = min((1 << length_bits) + 2, src_size - pos);
+        max_displacement = 1 << displacement_bits;
+
+        /* look for the longest earlier match, most recent positions first */
+        best_length = best_displacement = 0;
+        if (max_length >= 3)
+        {
+            candidate = head[LZNT1_HASH(src + pos)];
+            for (chain = max_chain; chain && candidate != LZNT1_NO_POSITION; chain--)
+            {
+                if (pos - candidate > max_displacement) break;
+
+                for (length = 0; length < max_length; length++)
+                    if (src[candidate + length] != src[pos + length]) break;
+
+                if (length > best_length)
+                {
+                    best_length       = length;
+                    best_displacement = pos - candidate;
+                    if (length == max_length) break;
+                }
+
+                candidate = prev[candidate];
+            }
+        }
+
+        if (best_length >= 3)
+        {
+            /* backwards reference */
+            if (dst_pos + sizeof(WORD) > dst_size) return 0;
+            code = ((best_displacement - 1) << length_bits) | (best_length - 3);
+            dst[dst_pos++] = code & 0xFF;
+            dst[dst_pos++] = code >> 8;
+            dst[flags_pos] |= 1 << flag;
+            length = best_length;
+        }
+        else
+        {
+            /* uncompressed data */
+            if (dst_pos >= dst_size) return 0;
+            dst[dst_pos++] = src[pos];
+            length = 1;
+        }
+
+        /* add every position we've passed to the hash chains */
+        while (length--)
+        {
+            if (pos + 3 <= src_size)
+            {
+                hash = LZNT1_HASH(src + pos);
+                prev[pos] = head[hash];
+                head[hash] = (USHORT)pos;
+            }
+            pos++;
+        }
+
+        flag = (flag + 1) & 7;
+    }
+
+    return dst_pos;
+}
+
 static NTSTATUS
 RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
-                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
+                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace,
+                        USHORT Engine)
 {
         UCHAR *src_cur = src, *src_end = src + src_size;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        ULONG block_size, compressed_size;
+        ULONG max_chain;
+
+        max_chain = (Engine == COMPRESSION_ENGINE_MAXIMUM) ? LZNT1_CHAIN_MAXIMUM
+                                                           : LZNT1_CHAIN_STANDARD;
 
         while (src_cur < src_end)
         {
             /* determine size of current chunk */
             block_size = min(0x1000, src_end - src_cur);
+            if (dst_cur + sizeof(WORD) > dst_end)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            /* only keep the compressed form when it is actually smaller */
+            compressed_size = 0;
+            if (workspace)
+            {
+                compressed_size = lznt1_compress_chunk(src_cur, block_size,
+                                                       dst_cur + sizeof(WORD),
+                                                       min(block_size - 1, dst_end - dst_cur - sizeof(WORD)),
+                                                       (USHORT *)workspace, max_chain);
+            }
+
+            if (compressed_size)
+            {
+                /* write compressed chunk header, the content is already there */
+                *(WORD *)dst_cur = 0xB000 | (compressed_size - 1);
+                dst_cur += sizeof(WORD) + compressed_size;
+                src_cur += block_size;
+                continue;
+            }
+
             if (dst_cur + sizeof(WORD) + block_size > dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
@@ -248,6 +383,454 @@ RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
 }
 
 
+/* XPRESS (plain LZ77) streams: 32 flag bits precede each group of 32 entities,
+ * a set flag being a match with a 13 bit offset and a variable length. */
+#define XPRESS_WINDOW_SIZE      0x2000
+#define XPRESS_HASH_SIZE        0x1000
+#define XPRESS_HASH(p)          LZNT1_HASH(p)
+#define XPRESS_NO_POSITION      0xFFFFFFFF
+#define XPRESS_MAX_MATCH        0xFFFF
+
+/* Longest hash chain walked per position, for each engine */
+#define XPRESS_CHAIN_STANDARD   16
+#define XPRESS_CHAIN_MAXIMUM    256
+
+static NTSTATUS
+RtlpCompressBufferXpress(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                         ULONG *final_size, ULONG *workspace, USHORT Engine)
+{
+    ULONG *head = workspace, *prev = workspace + XPRESS_HASH_SIZE;
+    ULONG pos = 0, dst_pos, flags_pos, flags = 0, flag_count = 0, nibble_pos = 0;
+    ULONG max_length, max_chain, chain;
+    ULONG length, best_length, best_offset, candidate, hash, code;
+
+    if (!workspace) return STATUS_ACCESS_VIOLATION;
+
+    max_chain = (Engine == COMPRESSION_ENGINE_MAXIMUM) ? XPRESS_CHAIN_MAXIMUM
+                                                       : XPRESS_CHAIN_STANDARD;
+
+    for (hash = 0; hash < XPRESS_HASH_SIZE; hash++)
+        head[hash] = XPRESS_NO_POSITION;
+
+    /* room for the first flags */
+    if (dst_size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+    flags_pos = 0;
+    dst_pos = sizeof(ULONG);
+
+    while (pos < src_size)
+    {
+        /* look for the longest earlier match in the window, most recent positions first */
+        max_length = min(src_size - pos, XPRESS_MAX_MATCH);
+        best_length = best_offset = 0;
+        if (max_length >= 3)
+        {
+            candidate = head[XPRESS_HASH(src + pos)];
+            for (chain = max_chain; chain && candidate != XPRESS_NO_POSITION; chain--)
+            {
+                if (pos - candidate > XPRESS_WINDOW_SIZE) break;
+
+                for (length = 0; length < max_length; length++)
+                    if (src[candidate + length] != src[pos + length]) break;
+
+                if (length > best_length)
+                {
+                    best_length = length;
+                    best_offset = pos - candidate;
+                    if (length == max_length) break;
+                }
+
+                candidate = prev[candidate % XPRESS_WINDOW_SIZE];
+            }
+        }
+
+        if (best_length >= 3)
+        {
+            /* match, the length goes in 3 bits, then shared nibbles, then extra bytes */
+            if (dst_pos + sizeof(WORD) > dst_size) return STATUS_BUFFER_TOO_SMALL;
+            length = best_length - 3;
+            code = ((best_offset - 1) << 3) | min(length, 7);
+            dst[dst_pos++] = code & 0xFF;
+            dst[dst_pos++] = (code >> 8) & 0xFF;
+
+            if (length >= 7)
+            {
+                length -= 7;
+                if (!nibble_pos)
+                {
+                    if (dst_pos >= dst_size) return STATUS_BUFFER_TOO_SMALL;
+                    nibble_pos = dst_pos;
+                    dst[dst_pos++] = (UCHAR)min(length, 15);
+                }
+                else
+                {
+                    dst[nibble_pos] |= (UCHAR)(min(length, 15) << 4);
+                    nibble_pos = 0;
+                }
+
+                if (length >= 15)
+                {
+                    length -= 15;
+                    if (length < 255)
+                    {
+                        if (dst_pos >= dst_size) return STATUS_BUFFER_TOO_SMALL;
+                        dst[dst_pos++] = (UCHAR)length;
+                    }
+                    else
+                    {
+                        /* the whole length, XPRESS_MAX_MATCH keeps it within a WORD */
+                        if (dst_pos + 1 + sizeof(WORD) > dst_size) return STATUS_BUFFER_TOO_SMALL;
+                        dst[dst_pos++] = 255;
+                        dst[dst_pos++] = (best_length - 3) & 0xFF;
+                        dst[dst_pos++] = (best_length - 3) >> 8;
+                    }
+                }
+            }
+
+            flags = (flags << 1) | 1;
+            length = best_length;
+        }
+        else
+        {
+            /* literal */
+            if (dst_pos >= dst_size) return STATUS_BUFFER_TOO_SMALL;
+            dst[dst_pos++] = src[pos];
+            flags <<= 1;
+            length = 1;
+        }
+
+        /* flush the flags once 32 entities used them up */
+        if (++flag_count == 32)
+        {
+            *(ULONG *)(dst + flags_pos) = flags;
+            if (dst_pos + sizeof(ULONG) > dst_size) return STATUS_BUFFER_TOO_SMALL;
+            flags_pos = dst_pos;
+            dst_pos += sizeof(ULONG);
+            flags = flag_count = 0;
+        }
+
+        /* add every position we've passed to the hash chains */
+        while (length--)
+        {
+            if (pos + 3 <= src_size)
+            {
+                hash = XPRESS_HASH(src + pos);
+                prev[pos % XPRESS_WINDOW_SIZE] = head[hash];
+                head[hash] = pos;
+            }
+            pos++;
+        }
+    }
+
+    /* pad the last flags with matches, the end of input stops the decompressor at the first one */
+    if (flag_count)
+        flags = (flags << (32 - flag_count)) | ((1UL << (32 - flag_count)) - 1);
+    else
+        flags = 0xFFFFFFFF;
+    *(ULONG *)(dst + flags_pos) = flags;
+
+    if (final_size)
+        *final_size = dst_pos;
+
+    return STATUS_SUCCESS;
+}
+
+/* copy a match, overlapping ones have to go byte per byte */
+static __inline void lz_copy_match(UCHAR *dst, ULONG offset, ULONG length)
+{
+    if (offset >= length)
+    {
+        memcpy(dst, dst - offset, length);
+        return;
+    }
+
+    while (length--)
+    {
+        *dst = *(dst - offset);
+        dst++;
+    }
+}
+
+/* decompress data encoded with XPRESS (plain LZ77) */
+static NTSTATUS xpress_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                  ULONG *final_size)
+{
+    ULONG src_pos = 0, dst_pos = 0, nibble_pos = 0;
+    ULONG flags = 0, flag_count = 0;
+    ULONG code, length, offset;
+
+    while (dst_pos < dst_size)
+    {
+        if (!flag_count)
+        {
+            if (src_pos + sizeof(ULONG) > src_size) break;
+            flags = *(ULONG *)(src + src_pos);
+            src_pos += sizeof(ULONG);
+            flag_count = 32;
+        }
+        flag_count--;
+
+        if (!((flags >> flag_count) & 1))
+        {
+            /* literal */
+            if (src_pos >= src_size) break;
+            dst[dst_pos++] = src[src_pos++];
+            continue;
+        }
+
+        /* match, the end of input is only allowed here */
+        if (src_pos == src_size) break;
+        if (src_pos + sizeof(WORD) > src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+        code = *(WORD *)(src + src_pos);
+        src_pos += sizeof(WORD);
+
+        length = code & 7;
+        offset = (code >> 3) + 1;
+        if (length == 7)
+        {
+            /* two consecutive long matches share a length byte, one nibble each */
+            if (!nibble_pos)
+            {
+                if (src_pos >= src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                nibble_pos = src_pos;
+                length = src[src_pos++] & 0xF;
+            }
+            else
+            {
+                length = src[nibble_pos] >> 4;
+                nibble_pos = 0;
+            }
+
+            if (length == 15)
+            {
+                if (src_pos >= src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                length = src[src_pos++];
+                if (length == 255)
+                {
+                    if (src_pos + sizeof(WORD) > src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                    length = *(WORD *)(src + src_pos);
+                    src_pos += sizeof(WORD);
+                    if (!length)
+                    {
+                        if (src_pos + sizeof(ULONG) > src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                        length = *(ULONG *)(src + src_pos);
+                        src_pos += sizeof(ULONG);
+                    }
+                    if (length < 15 + 7) return STATUS_BAD_COMPRESSION_BUFFER;
+                    length -= 15 + 7;
+                }
+                length += 15;
+            }
+            length += 7;
+        }
+        length += 3;
+
+        if (offset > dst_pos) return STATUS_BAD_COMPRESSION_BUFFER;
+        length = min(length, dst_size - dst_pos);
+        lz_copy_match(dst + dst_pos, offset, length);
+        dst_pos += length;
+    }
+
+    if (final_size)
+        *final_size = dst_pos;
+
+    return STATUS_SUCCESS;
+}
+
+/* XPRESS Huffman streams: blocks of 64K output bytes, each one starting with the
+ * 4 bit code lengths of its 512 symbols (256 literals, then 256 match headers). */
+#define XPRESS_HUFF_SYMBOLS     512
+#define XPRESS_HUFF_MAX_BITS    15
+#define XPRESS_HUFF_FAST_BITS   9
+#define XPRESS_HUFF_BLOCK_SIZE  0x10000
+
+typedef struct _XPRESS_HUFF_TABLE
+{
+    USHORT Fast[1 << XPRESS_HUFF_FAST_BITS];    /* (symbol << 4) | length, 0 for longer codes */
+    USHORT Count[XPRESS_HUFF_MAX_BITS + 1];     /* number of codes of each length */
+    USHORT Sorted[XPRESS_HUFF_SYMBOLS];         /* symbols in canonical code order */
+} XPRESS_HUFF_TABLE;
+
+/* build the canonical decoding table, FALSE if the code lengths are invalid */
+static BOOLEAN xpress_huff_build_table(XPRESS_HUFF_TABLE *table, UCHAR *lengths)
+{
+    USHORT offsets[XPRESS_HUFF_MAX_BITS + 1];
+    ULONG symbol, length, index, code, fill, first;
+    LONG left;
+
+    RtlZeroMemory(table, sizeof(*table));
+
+    for (symbol = 0; symbol < XPRESS_HUFF_SYMBOLS; symbol++)
+        table->Count[(lengths[symbol / 2] >> ((symbol & 1) * 4)) & 0xF]++;
+    table->Count[0] = 0;
+
+    /* reject over-subscribed and empty codes */
+    left = 1;
+    for (length = 1; length <= XPRESS_HUFF_MAX_BITS; length++)
+    {
+        left <<= 1;
+        left -= table->Count[length];
+        if (left < 0) return FALSE;
+    }
+    if (left == (1 << XPRESS_HUFF_MAX_BITS)) return FALSE;
+
+    /* sort the symbols by code length, then by value */
+    offsets[1] = 0;
+    for (length = 1; length < XPRESS_HUFF_MAX_BITS; length++)
+        offsets[length + 1] = offsets[length] + table->Count[length];
+    for (symbol = 0; symbol < XPRESS_HUFF_SYMBOLS; symbol++)
+    {
+        length = (lengths[symbol / 2] >> ((symbol & 1) * 4)) & 0xF;
+        if (length) table->Sorted[offsets[length]++] = (USHORT)symbol;
+    }
+
+    /* resolve the short codes with a single lookup */
+    code = index = 0;
+    for (length = 1; length <= XPRESS_HUFF_FAST_BITS; length++)
+    {
+        for (fill = 0; fill < table->Count[length]; fill++, index++, code++)
+        {
+            first = code << (XPRESS_HUFF_FAST_BITS - length);
+            for (symbol = 0; symbol < (1UL << (XPRESS_HUFF_FAST_BITS - length)); symbol++)
+                table->Fast[first + symbol] = (USHORT)((table->Sorted[index] << 4) | length);
+        }
+        code <<= 1;
+    }
+
+    return TRUE;
+}
+
+/* decode the symbol at the top of the 15 given bits, -1 if there is none */
+static LONG xpress_huff_decode(XPRESS_HUFF_TABLE *table, ULONG bits, ULONG *bit_length)
+{
+    LONG code = 0, first = 0, index = 0, count;
+    ULONG length, entry;
+
+    entry = table->Fast[bits >> (XPRESS_HUFF_MAX_BITS - XPRESS_HUFF_FAST_BITS)];
+    if (entry)
+    {
+        *bit_length = entry & 0xF;
+        return entry >> 4;
+    }
+
+    /* walk the canonical code one bit at a time */
+    for (length = 1; length <= XPRESS_HUFF_MAX_BITS; length++)
+    {
+        code |= (bits >> (XPRESS_HUFF_MAX_BITS - length)) & 1;
+        count = table->Count[length];
+        if (code - count < first)
+        {
+            *bit_length = length;
+            return table->Sorted[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    return -1;
+}
+
+/* read the next 16 bits of the stream, past its end reads zeroes */
+static __inline ULONG xpress_huff_read_word(UCHAR *src, ULONG src_size, ULONG pos)
+{
+    if (pos + sizeof(WORD) > src_size) return 0;
+    return *(WORD *)(src + pos);
+}
+
+/* decompress data encoded with XPRESS Huffman */
+static NTSTATUS xpress_huff_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                       ULONG *final_size)
+{
+    XPRESS_HUFF_TABLE table;
+    ULONG src_pos = 0, dst_pos = 0, block_end;
+    ULONG next_bits, bit_length, length, offset_bits, offset;
+    LONG extra_bits, symbol;
+
+    while (dst_pos < dst_size)
+    {
+        /* each block comes with its own code lengths */
+        if (src_pos + XPRESS_HUFF_SYMBOLS / 2 + sizeof(ULONG) > src_size) break;
+        if (!xpress_huff_build_table(&table, src + src_pos))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        src_pos += XPRESS_HUFF_SYMBOLS / 2;
+
+        /* keep 16 to 32 bits of the stream, most significant first */
+        next_bits = (xpress_huff_read_word(src, src_size, src_pos) << 16) |
+                    xpress_huff_read_word(src, src_size, src_pos + sizeof(WORD));
+        src_pos += sizeof(ULONG);
+        extra_bits = 16;
+
+        block_end = dst_pos + min(XPRESS_HUFF_BLOCK_SIZE, dst_size - dst_pos);
+        while (dst_pos < block_end)
+        {
+            symbol = xpress_huff_decode(&table, next_bits >> (32 - XPRESS_HUFF_MAX_BITS), &bit_length);
+            if (symbol < 0) return STATUS_BAD_COMPRESSION_BUFFER;
+
+            next_bits <<= bit_length;
+            extra_bits -= bit_length;
+            if (extra_bits < 0)
+            {
+                next_bits |= xpress_huff_read_word(src, src_size, src_pos) << -extra_bits;
+                extra_bits += 16;
+                src_pos += sizeof(WORD);
+            }
+
+            if (symbol < 256)
+            {
+                /* literal */
+                dst[dst_pos++] = (UCHAR)symbol;
+                continue;
+            }
+
+            /* end of stream marker once all input is consumed */
+            if (symbol == 256 && src_pos >= src_size) goto out;
+
+            /* match, the low nibble is the length and the high one the offset bit count */
+            symbol -= 256;
+            length = symbol & 0xF;
+            offset_bits = symbol >> 4;
+            if (length == 15)
+            {
+                if (src_pos >= src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                length = src[src_pos++];
+                if (length == 255)
+                {
+                    if (src_pos + sizeof(WORD) > src_size) return STATUS_BAD_COMPRESSION_BUFFER;
+                    length = *(WORD *)(src + src_pos);
+                    src_pos += sizeof(WORD);
+                    if (length < 15) return STATUS_BAD_COMPRESSION_BUFFER;
+                    length -= 15;
+                }
+                length += 15;
+            }
+            length += 3;
+
+            offset = offset_bits ? (next_bits >> (32 - offset_bits)) : 0;
+            offset |= 1 << offset_bits;
+            next_bits <<= offset_bits;
+            extra_bits -= offset_bits;
+            if (extra_bits < 0)
+            {
+                next_bits |= xpress_huff_read_word(src, src_size, src_pos) << -extra_bits;
+                extra_bits += 16;
+                src_pos += sizeof(WORD);
+            }
+
+            if (offset > dst_pos) return STATUS_BAD_COMPRESSION_BUFFER;
+            length = min(length, dst_size - dst_pos);
+            lz_copy_match(dst + dst_pos, offset, length);
+            dst_pos += length;
+        }
+    }
+
+out:
+    if (final_size)
+        *final_size = dst_pos;
+
+    return STATUS_SUCCESS;
+}
+
+
 static NTSTATUS
 RtlpWorkSpaceSizeLZNT1(USHORT Engine,
                        PULONG BufferAndWorkSpaceSize,
@@ -261,7 +844,8 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
    }
    else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
    {
-      *BufferAndWorkSpaceSize = 0x10;
+      /* Same hash chains, only walked further */
+      *BufferAndWorkSpaceSize = 0x8010;
       *FragmentWorkSpaceSize = 0x1000;
       return(STATUS_SUCCESS);
    }
@@ -270,6 +854,22 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
 }
 
 
+static NTSTATUS
+RtlpWorkSpaceSizeXpress(USHORT Engine,
+                        PULONG BufferAndWorkSpaceSize,
+                        PULONG FragmentWorkSpaceSize)
+{
+   if (Engine != COMPRESSION_ENGINE_STANDARD &&
+       Engine != COMPRESSION_ENGINE_MAXIMUM)
+      return(STATUS_NOT_SUPPORTED);
+
+   /* Hash heads and the window's chain links, decompression needs nothing */
+   *BufferAndWorkSpaceSize = (XPRESS_HASH_SIZE + XPRESS_WINDOW_SIZE) * sizeof(ULONG);
+   *FragmentWorkSpaceSize = 0;
+   return(STATUS_SUCCESS);
+}
+
+
 /*
  * @implemented
  */
@@ -284,7 +884,7 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
@@ -297,7 +897,17 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                                      CompressedBufferSize,
                                      UncompressedChunkSize,
                                      FinalCompressedSize,
-                                     WorkSpace));
+                                     WorkSpace,
+                                     Engine));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS)
+      return(RtlpCompressBufferXpress(UncompressedBuffer,
+                                      UncompressedBufferSize,
+                                      CompressedBuffer,
+                                      CompressedBufferSize,
+                                      FinalCompressedSize,
+                                      WorkSpace,
+                                      Engine));
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
@@ -357,6 +967,17 @@ RtlDecompressFragment(IN USHORT format,
             return lznt1_decompress(uncompressed, uncompressed_size, compressed,
                                     compressed_size, offset, final_size, workspace);
 
+        /* XPRESS streams have no independent chunks to start from */
+        case COMPRESSION_FORMAT_XPRESS:
+            if (offset) return STATUS_NOT_SUPPORTED;
+            return xpress_decompress(uncompressed, uncompressed_size, compressed,
+                                     compressed_size, final_size);
+
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            if (offset) return STATUS_NOT_SUPPORTED;
+            return xpress_huff_decompress(uncompressed, uncompressed_size, compressed,
+                                          compressed_size, final_size);
+
         case COMPRESSION_FORMAT_NONE:
         case COMPRESSION_FORMAT_DEFAULT:
             return STATUS_INVALID_PARAMETER;
@@ -417,6 +1038,11 @@ RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
                                     CompressBufferAndWorkSpaceSize,
                                     CompressFragmentWorkSpaceSize));
 
+   if (Format == COMPRESSION_FORMAT_XPRESS)
+      return(RtlpWorkSpaceSizeXpress(Engine,
+                                     CompressBufferAndWorkSpaceSize,
+                                     CompressFragmentWorkSpaceSize));
+
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
@@ -16,6 +16,12 @@
 
 #define MAX_STATIC_CS_DEBUG_OBJECTS 64
 
+/* The top byte of SpinCount is reserved for flags */
+#define RTL_CRITICAL_SECTION_SPIN_MASK 0x00FFFFFF
+
+/* Least number of spins, even when spinning did not pay off recently */
+#define RTL_CRITICAL_SECTION_MIN_SPIN 16
+
 static RTL_CRITICAL_SECTION RtlCriticalSectionLock;
 static LIST_ENTRY RtlCriticalSectionList;
 static BOOLEAN RtlpCritSectInitialized = FALSE;
@@ -29,72 +35,71 @@ extern HANDLE LdrpShutdownThreadId;
 /* FUNCTIONS *****************************************************************/
 
 /*++
- * RtlpCreateCriticalSectionSem
+ * RtlpSpinOnCriticalSection
  *
- *     Checks if an Event has been created for the critical section.
+ *     Spins for a while, hoping the owner releases the critical section.
  *
  * Params:
- *     None
+ *     CriticalSection - Critical section to acquire.
  *
  * Returns:
- *     None. Raises an exception if the system call failed.
+ *     TRUE if the critical section has been acquired, FALSE otherwise.
  *
  * Remarks:
- *     None
+ *     The debug info remembers how long the last successful spins took.
+ *     We spin about twice that long, up to the spin count, and spin less
+ *     after spinning failed, so locks that are held for long go to sleep
+ *     right away. Every 16th contention spins the full spin count, to
+ *     notice when the lock is held for shorter again. Once someone waits
+ *     in the kernel the lock is handed to them on release, so spinning is
+ *     pointless then.
  *
  *--*/
-_At_(CriticalSection->LockSemaphore, _Post_notnull_)
-VOID
-NTAPI
-RtlpCreateCriticalSectionSem(PRTL_CRITICAL_SECTION CriticalSection)
+static
+BOOLEAN
+RtlpSpinOnCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
-    HANDLE hEvent = CriticalSection->LockSemaphore;
-    HANDLE hNewEvent;
-    NTSTATUS Status;
+    PRTL_CRITICAL_SECTION_DEBUG DebugInfo = CriticalSection->DebugInfo;
+    ULONG SpinLimit, Estimate, i;
 
-    /* Check if we have an event */
-    if (!hEvent)
+    SpinLimit = (ULONG)CriticalSection->SpinCount & RTL_CRITICAL_SECTION_SPIN_MASK;
+    Estimate = 0;
+    if (DebugInfo)
     {
-        /* No, so create it */
-        Status = NtCreateEvent(&hNewEvent,
-                               EVENT_ALL_ACCESS,
-                               NULL,
-                               SynchronizationEvent,
-                               FALSE);
-        if (!NT_SUCCESS(Status))
-        {
-            DPRINT1("Failed to Create Event!\n");
+        Estimate = DebugInfo->SpareWORD;
+        if (DebugInfo->ContentionCount % 16)
+            SpinLimit = min(SpinLimit, Estimate * 2 + RTL_CRITICAL_SECTION_MIN_SPIN);
+    }
 
-            /*
-             * Use INVALID_HANDLE_VALUE (-1) to signal that
-             * the global keyed event must be used.
-             */
-            hNewEvent = INVALID_HANDLE_VALUE;
+    for (i = 0; i < SpinLimit; i++)
+    {
+        /* Try to take it if it looks free */
+        if (CriticalSection->LockCount == -1 &&
+            InterlockedCompareExchange(&CriticalSection->LockCount, 0, -1) == -1)
+        {
+            /* Remember how long it took. Races on this are harmless */
+            if (DebugInfo)
+                DebugInfo->SpareWORD = (WORD)min(Estimate + ((LONG)(i - Estimate) / 8), 0xFFFF);
+            return TRUE;
         }
 
-        DPRINT("Created Event: %p \n", hNewEvent);
+        /* Stop if there are waiters */
+        if (CriticalSection->LockCount > 0) break;
 
-        /* Exchange the LockSemaphore field with the new handle, if it is still 0 */
-        if (InterlockedCompareExchangePointer((PVOID*)&CriticalSection->LockSemaphore,
-                                              (PVOID)hNewEvent,
-                                               NULL) != NULL)
-        {
-            /* Someone else just created an event */
-            if (hNewEvent != INVALID_HANDLE_VALUE)
-            {
-                DPRINT("Closing already created event: %p\n", hNewEvent);
-                NtClose(hNewEvent);
-            }
-        }
+        YieldProcessor();
     }
 
-    return;
+    /* Spinning did not pay off, spin less next time */
+    if (DebugInfo)
+        DebugInfo->SpareWORD = (WORD)(Estimate / 2);
+
+    return FALSE;
 }
 
 /*++
  * RtlpWaitForCriticalSection
  *
- *     Slow path of RtlEnterCriticalSection. Waits on an Event Object.
+ *     Slow path of RtlEnterCriticalSection. Waits on the keyed event.
  *
  * Params:
  *     CriticalSection - Critical section to acquire.
@@ -103,7 +108,10 @@ RtlpCreateCriticalSectionSem(PRTL_CRITICAL_SECTION CriticalSection)
  *     STATUS_SUCCESS, or raises an exception if a deadlock is occuring.
  *
  * Remarks:
- *     None
+ *     All critical sections share the global keyed event, keyed by their
+ *     address, so contended critical sections don't need an event each.
+ *     An event that was put in LockSemaphore by someone else is still
+ *     honored.
  *
  *--*/
 NTSTATUS
@@ -113,17 +121,12 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
     NTSTATUS Status;
     EXCEPTION_RECORD ExceptionRecord;
     BOOLEAN LastChance = FALSE;
-
-    /* Do we have an Event yet? */
-    if (!CriticalSection->LockSemaphore)
-    {
-        RtlpCreateCriticalSectionSem(CriticalSection);
-    }
+    HANDLE LockSemaphore = CriticalSection->LockSemaphore;
 
     /* Increase the Debug Entry count */
-    DPRINT("Waiting on Critical Section Event: %p %p\n",
+    DPRINT("Waiting on Critical Section: %p %p\n",
             CriticalSection,
-            CriticalSection->LockSemaphore);
+            LockSemaphore);
 
     if (CriticalSection->DebugInfo)
         CriticalSection->DebugInfo->EntryCount++;
@@ -142,12 +145,8 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 
     for (;;)
     {
-        /* Increase the number of times we've had contention */
-        if (CriticalSection->DebugInfo)
-            CriticalSection->DebugInfo->ContentionCount++;
-
-        /* Check if allocating the event failed */
-        if (CriticalSection->LockSemaphore == INVALID_HANDLE_VALUE)
+        /* Check if we have to use the keyed event */
+        if (!LockSemaphore || LockSemaphore == INVALID_HANDLE_VALUE)
         {
             /* Use the global keyed event (NULL as keyed event handle) */
             Status = NtWaitForKeyedEvent(NULL,
@@ -158,7 +157,7 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
         else
         {
             /* Wait on the Event */
-            Status = NtWaitForSingleObject(CriticalSection->LockSemaphore,
+            Status = NtWaitForSingleObject(LockSemaphore,
                                            FALSE,
                                            &RtlpTimeout);
         }
@@ -195,7 +194,7 @@ RtlpWaitForCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 /*++
  * RtlpUnWaitCriticalSection
  *
- *     Slow path of RtlLeaveCriticalSection. Fires an Event Object.
+ *     Slow path of RtlLeaveCriticalSection. Wakes one waiter.
  *
  * Params:
  *     CriticalSection - Critical section to release.
@@ -212,20 +211,14 @@ NTAPI
 RtlpUnWaitCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
     NTSTATUS Status;
+    HANDLE LockSemaphore = CriticalSection->LockSemaphore;
 
-    /* Do we have an Event yet? */
-    if (!CriticalSection->LockSemaphore)
-    {
-        RtlpCreateCriticalSectionSem(CriticalSection);
-    }
-
-    /* Signal the Event */
-    DPRINT("Signaling Critical Section Event: %p, %p\n",
+    DPRINT("Signaling Critical Section: %p, %p\n",
             CriticalSection,
-            CriticalSection->LockSemaphore);
+            LockSemaphore);
 
-    /* Check if this critical section needs to use the keyed event */
-    if (CriticalSection->LockSemaphore == INVALID_HANDLE_VALUE)
+    /* Check if this critical section uses the keyed event */
+    if (!LockSemaphore || LockSemaphore == INVALID_HANDLE_VALUE)
     {
         /* Release keyed event */
         Status = NtReleaseKeyedEvent(NULL, CriticalSection, FALSE, &RtlpTimeout);
@@ -233,7 +226,7 @@ RtlpUnWaitCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
     else
     {
         /* Set the event */
-        Status = NtSetEvent(CriticalSection->LockSemaphore, NULL);
+        Status = NtSetEvent(LockSemaphore, NULL);
     }
 
     if (!NT_SUCCESS(Status))
@@ -399,7 +392,8 @@ RtlDeleteCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
     DPRINT("Deleting Critical Section: %p\n", CriticalSection);
 
     /* Close the Event Object Handle if it exists */
-    if (CriticalSection->LockSemaphore)
+    if (CriticalSection->LockSemaphore &&
+        CriticalSection->LockSemaphore != INVALID_HANDLE_VALUE)
     {
         /* In case NtClose fails, return the status */
         Status = NtClose(CriticalSection->LockSemaphore);
@@ -461,6 +455,13 @@ RtlSetCriticalSectionSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
 
     /* Set to parameter if MP, or to 0 if this is Uniprocessor */
     CriticalSection->SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ? SpinCount : 0;
+
+    /* Start out spinning about half of it */
+    if (CriticalSection->DebugInfo)
+    {
+        CriticalSection->DebugInfo->SpareWORD =
+            (WORD)(min(CriticalSection->SpinCount & RTL_CRITICAL_SECTION_SPIN_MASK, 0xFFFF) / 2);
+    }
     return OldCount;
 }
 
@@ -486,6 +487,28 @@ RtlEnterCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
     HANDLE Thread = (HANDLE)NtCurrentTeb()->ClientId.UniqueThread;
 
+    /* With a spin count, spin before going to wait */
+    if (CriticalSection->SpinCount & RTL_CRITICAL_SECTION_SPIN_MASK)
+    {
+        /* Take it right away if it is free */
+        if (InterlockedCompareExchange(&CriticalSection->LockCount, 0, -1) == -1)
+            goto Acquired;
+
+        /* Only the owner can see itself as the owner, so this is safe */
+        if (Thread == CriticalSection->OwningThread)
+        {
+            InterlockedIncrement(&CriticalSection->LockCount);
+            CriticalSection->RecursionCount++;
+            return STATUS_SUCCESS;
+        }
+
+        if (CriticalSection->DebugInfo)
+            CriticalSection->DebugInfo->ContentionCount++;
+
+        if (RtlpSpinOnCriticalSection(CriticalSection))
+            goto Acquired;
+    }
+
     /* Try to lock it */
     if (InterlockedIncrement(&CriticalSection->LockCount) != 0)
     {
@@ -509,9 +532,15 @@ RtlEnterCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
                   OwningThread is NULL here! */
 
         /* We don't own it, so we must wait for it */
+        if (CriticalSection->DebugInfo &&
+            !(CriticalSection->SpinCount & RTL_CRITICAL_SECTION_SPIN_MASK))
+        {
+            CriticalSection->DebugInfo->ContentionCount++;
+        }
         RtlpWaitForCriticalSection(CriticalSection);
     }
 
+Acquired:
     /*
      * Lock successful. Changing this information has not to be serialized
      * because only one thread at a time can actually change it (the one who
@@ -598,6 +627,8 @@ RtlInitializeCriticalSectionAndSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
     CritcalSectionDebugData->EntryCount = 0;
     CritcalSectionDebugData->CriticalSection = CriticalSection;
     CritcalSectionDebugData->Flags = 0;
+    CritcalSectionDebugData->SpareWORD =
+        (WORD)(min(CriticalSection->SpinCount & RTL_CRITICAL_SECTION_SPIN_MASK, 0xFFFF) / 2);
     CriticalSection->DebugInfo = CritcalSectionDebugData;
 
     /*
@@ -286,6 +286,32 @@ RtlLookupElementGenericTableFull(IN PRTL_GENERIC_TABLE Table,
     return &((PTABLE_ENTRY_HEADER)*NodeOrParent)->UserData;
 }
 
+/*
+ * Unlike RtlLookupElementGenericTable, this doesn't splay the found entry to
+ * the root, so the table isn't modified: lookups can run concurrently under a
+ * shared lock, as long as inserts and deletes hold it exclusive. Frequently
+ * looked up entries don't get cheaper to find, though.
+ *
+ * @implemented
+ */
+PVOID
+NTAPI
+RtlLookupElementGenericTableWithoutSplaying(IN PRTL_GENERIC_TABLE Table,
+                                            IN PVOID Buffer)
+{
+    PRTL_SPLAY_LINKS NodeOrParent;
+
+    /* Do the lookup, and return the entry as-is if found */
+    if (RtlpFindGenericTableNodeOrParent(Table,
+                                         Buffer,
+                                         &NodeOrParent) != TableFoundNode)
+    {
+        return NULL;
+    }
+
+    return &((PTABLE_ENTRY_HEADER)NodeOrParent)->UserData;
+}
+
 /*
  * @implemented
  */
@@ -1235,6 +1235,11 @@ RtlCreateHeap(ULONG Flags,
     ULONG HeapSegmentFlags = 0;
     NTSTATUS Status;
     ULONG MaxBlockSize;
+    BOOLEAN EnableLowFragHeap;
+
+    /* Remember whether the low fragmentation heap was asked for */
+    EnableLowFragHeap = (Flags & HEAP_CREATE_ENABLE_LFH) != 0;
+    Flags &= ~HEAP_CREATE_ENABLE_LFH;
 
     /* Check for a special heap */
     if (RtlpPageHeapEnabled && !Addr && !Lock)
@@ -1519,6 +1524,9 @@ RtlCreateHeap(ULONG Flags,
         RtlpAddHeapToProcessList(Heap);
 
         // FIXME: What about lookasides?
+
+        /* Enable the low fragmentation heap if requested */
+        if (EnableLowFragHeap) RtlpActivateLowFragHeap(Heap);
     }
 
     return Heap;
@@ -1977,6 +1985,15 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks go to the low fragmentation heap first, if it's enabled */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+        Index < HEAP_LFH_BUCKETS &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        InUseEntry = RtlpLowFragHeapAllocate(Heap, Flags, Size, Index, EntryFlags);
+        if (InUseEntry) return InUseEntry + 1;
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2189,7 +2206,8 @@ BOOLEAN NTAPI RtlFreeHeap(
         /* Check this entry, fail if it's invalid */
         if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
             (((ULONG_PTR)Ptr & 0x7) != 0) ||
-            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+            (HeapEntry->SegmentOffset >= HEAP_SEGMENTS &&
+             !RtlpIsLowFragHeapEntry(Heap, HeapEntry)))
         {
             /* This is an invalid block */
             DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -2206,6 +2224,10 @@ BOOLEAN NTAPI RtlFreeHeap(
     }
     _SEH2_END;
 
+    /* Blocks of the low fragmentation heap are freed without locking */
+    if (HeapEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET)
+        return RtlpLowFragHeapFree(Heap, HeapEntry);
+
     /* Lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2599,6 +2621,10 @@ RtlReAllocateHeap(HANDLE HeapPtr,
         return NULL;
     }
 
+    /* Blocks of the low fragmentation heap are handled by it */
+    if (RtlpIsLowFragHeapEntry(Heap, (PHEAP_ENTRY)Ptr - 1))
+        return RtlpLowFragHeapReAllocate(Heap, Flags, Ptr, Size);
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -3163,6 +3189,13 @@ RtlpValidateHeapEntry(
     if ((ULONG_PTR)HeapEntry & (HEAP_ENTRY_SIZE - 1)) goto invalid_entry;
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
 
+    /* Blocks of the low fragmentation heap live inside back end blocks */
+    if (RtlpIsLowFragHeapEntry(Heap, HeapEntry))
+    {
+        if (!RtlpLowFragHeapValidateEntry(Heap, HeapEntry)) goto invalid_entry;
+        return TRUE;
+    }
+
     BigAllocation = HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC;
     Segment = Heap->Segments[HeapEntry->SegmentOffset];
 
@@ -3927,13 +3960,14 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_LOWFRAGHEAP)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        if (!HeapHandle) return STATUS_INVALID_PARAMETER;
+
+        return RtlpActivateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -55,6 +55,18 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front end heap types */
+#define HEAP_FRONT_LOWFRAGHEAP 2
+
+/* Low fragmentation heap definitions */
+#define HEAP_LFH_BUCKETS          128    /* Served block sizes, in heap entries */
+#define HEAP_LFH_AFFINITY_SLOTS   4
+#define HEAP_LFH_SUBSEGMENT_SIZE  0x4000
+#define HEAP_LFH_MIN_BLOCKS       16
+#define HEAP_LFH_MAX_BLOCKS       1024
+#define HEAP_LFH_SEGMENT_OFFSET   0xFF   /* SegmentOffset of blocks owned by the LFH */
+#define HEAP_LFH_SIGNATURE        0x4846434C
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -327,6 +339,49 @@ typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
     HEAP_ENTRY BusyBlock;
 } HEAP_VIRTUAL_ALLOC_ENTRY, *PHEAP_VIRTUAL_ALLOC_ENTRY;
 
+/* Low fragmentation heap structures */
+typedef union _HEAP_LFH_FREE_STATE
+{
+    struct
+    {
+        USHORT FirstFree;
+        USHORT Depth;
+        ULONG Sequence;
+    };
+    LONGLONG Exchange;
+} HEAP_LFH_FREE_STATE, *PHEAP_LFH_FREE_STATE;
+
+typedef struct _HEAP_LFH_SUBSEGMENT
+{
+    volatile HEAP_LFH_FREE_STATE FreeState;
+    LIST_ENTRY ListEntry;
+    struct _HEAP_LFH_BUCKET *Bucket;
+    ULONG Signature;
+    USHORT BlockUnits;
+    USHORT BlockCount;
+} HEAP_LFH_SUBSEGMENT, *PHEAP_LFH_SUBSEGMENT;
+
+typedef struct _HEAP_LFH_BUCKET
+{
+    LIST_ENTRY SubSegmentList;
+    PHEAP_LFH_SUBSEGMENT volatile AffinitySlots[HEAP_LFH_AFFINITY_SLOTS];
+    ULONG SubSegmentCount;
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+typedef struct _HEAP_LFH
+{
+    PHEAP Heap;
+    HEAP_LFH_BUCKET Buckets[HEAP_LFH_BUCKETS];
+} HEAP_LFH, *PHEAP_LFH;
+
+/* Tells whether a busy entry was handed out by the low fragmentation heap */
+FORCEINLINE BOOLEAN
+RtlpIsLowFragHeapEntry(PHEAP Heap, PHEAP_ENTRY HeapEntry)
+{
+    return (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+            HeapEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET);
+}
+
 /* Global variables */
 extern RTL_CRITICAL_SECTION RtlpProcessHeapsListLock;
 extern BOOLEAN RtlpPageHeapEnabled;
@@ -406,6 +461,31 @@ RtlDebugSizeHeap(HANDLE HeapPtr,
                  ULONG Flags,
                  PVOID Ptr);
 
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+PHEAP_ENTRY NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapValidateEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry);
+
 /* heappage.c */
 
 HANDLE NTAPI
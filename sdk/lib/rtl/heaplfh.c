@@ -0,0 +1,420 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Low Fragmentation Heap front end
+ */
+
+/* Useful references:
+   http://illmatics.com/Understanding_the_LFH.pdf
+   https://msdn.microsoft.com/en-us/library/windows/desktop/aa366750(v=vs.85).aspx
+*/
+
+/* The LFH serves small blocks out of subsegments, which are regular busy
+   blocks of the back end heap carved into blocks of one size. Each size has
+   a bucket, and each bucket has a few affinity slots, picked depending on the
+   calling thread, so that threads allocate from different subsegments.
+
+   Every subsegment keeps its free blocks in an intrusive list, whose head,
+   depth and sequence number are updated with a single compare exchange, so
+   allocating and freeing a block doesn't take the heap lock. The lock is only
+   taken when a slot runs dry and a new subsegment must be picked or carved.
+
+   Subsegments are never given back to the back end while the heap is alive:
+   this is what makes reading a stale slot or a stale free list link safe
+   without further synchronization. They go away with the heap segments.
+
+   The header of a block owned by the LFH looks like a busy back end entry, so
+   that RtlSizeHeap() works unmodified, except for its SegmentOffset, which is
+   HEAP_LFH_SEGMENT_OFFSET, and its PreviousSize, which is the index of the
+   block in its subsegment. */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* FUNCTIONS *****************************************************************/
+
+#define RtlpLowFragHeapSubSegmentHeaderSize() \
+    ROUND_UP(sizeof(HEAP_LFH_SUBSEGMENT), HEAP_ENTRY_SIZE)
+
+FORCEINLINE
+PHEAP_ENTRY
+RtlpLowFragHeapBlock(PHEAP_LFH_SUBSEGMENT SubSegment,
+                     ULONG BlockIndex)
+{
+    return (PHEAP_ENTRY)((ULONG_PTR)SubSegment + RtlpLowFragHeapSubSegmentHeaderSize()) +
+           BlockIndex * SubSegment->BlockUnits;
+}
+
+FORCEINLINE
+PHEAP_LFH_SUBSEGMENT
+RtlpLowFragHeapSubSegment(PHEAP_ENTRY HeapEntry)
+{
+    return (PHEAP_LFH_SUBSEGMENT)((ULONG_PTR)(HeapEntry - (SIZE_T)HeapEntry->PreviousSize * HeapEntry->Size) -
+                                  RtlpLowFragHeapSubSegmentHeaderSize());
+}
+
+FORCEINLINE
+ULONG
+RtlpLowFragHeapAffinitySlot(VOID)
+{
+    /* Thread IDs are multiples of 4 */
+    return ((ULONG)(ULONG_PTR)NtCurrentTeb()->ClientId.UniqueThread >> 2) % HEAP_LFH_AFFINITY_SLOTS;
+}
+
+static
+PHEAP_ENTRY
+RtlpLowFragHeapPop(PHEAP_LFH_SUBSEGMENT SubSegment)
+{
+    HEAP_LFH_FREE_STATE OldState, NewState, State;
+    PHEAP_ENTRY HeapEntry;
+
+    /* Capture the whole state at once */
+    OldState.Exchange = InterlockedCompareExchange64((PLONGLONG)&SubSegment->FreeState.Exchange, 0, 0);
+
+    for (;;)
+    {
+        if (OldState.Depth == 0) return NULL;
+
+        /* The link may be garbage if another thread took the block meanwhile,
+           the sequence number will make the exchange fail in that case */
+        HeapEntry = RtlpLowFragHeapBlock(SubSegment, OldState.FirstFree);
+        NewState.FirstFree = *(volatile USHORT *)(HeapEntry + 1);
+        NewState.Depth = OldState.Depth - 1;
+        NewState.Sequence = OldState.Sequence + 1;
+
+        State.Exchange = InterlockedCompareExchange64((PLONGLONG)&SubSegment->FreeState.Exchange,
+                                                      NewState.Exchange,
+                                                      OldState.Exchange);
+        if (State.Exchange == OldState.Exchange) return HeapEntry;
+
+        OldState = State;
+    }
+}
+
+static
+VOID
+RtlpLowFragHeapPush(PHEAP_LFH_SUBSEGMENT SubSegment,
+                    PHEAP_ENTRY HeapEntry,
+                    USHORT BlockIndex)
+{
+    HEAP_LFH_FREE_STATE OldState, NewState, State;
+
+    OldState.Exchange = InterlockedCompareExchange64((PLONGLONG)&SubSegment->FreeState.Exchange, 0, 0);
+
+    for (;;)
+    {
+        *(volatile USHORT *)(HeapEntry + 1) = OldState.FirstFree;
+        NewState.FirstFree = BlockIndex;
+        NewState.Depth = OldState.Depth + 1;
+        NewState.Sequence = OldState.Sequence + 1;
+
+        State.Exchange = InterlockedCompareExchange64((PLONGLONG)&SubSegment->FreeState.Exchange,
+                                                      NewState.Exchange,
+                                                      OldState.Exchange);
+        if (State.Exchange == OldState.Exchange) return;
+
+        OldState = State;
+    }
+}
+
+static
+PHEAP_LFH_SUBSEGMENT
+RtlpLowFragHeapCreateSubSegment(PHEAP Heap,
+                                PHEAP_LFH_BUCKET Bucket,
+                                USHORT BlockUnits)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY HeapEntry;
+    USHORT BlockCount, i;
+    SIZE_T BlockSize;
+
+    /* Aim at a fixed subsegment size, within sane block counts */
+    BlockSize = (SIZE_T)BlockUnits << HEAP_ENTRY_SHIFT;
+    BlockCount = (USHORT)min(max(HEAP_LFH_SUBSEGMENT_SIZE / BlockSize, HEAP_LFH_MIN_BLOCKS),
+                             HEAP_LFH_MAX_BLOCKS);
+
+    /* Carve it from the back end, the heap lock is held */
+    SubSegment = RtlAllocateHeap(Heap,
+                                 HEAP_NO_SERIALIZE,
+                                 RtlpLowFragHeapSubSegmentHeaderSize() + BlockCount * BlockSize);
+    if (!SubSegment) return NULL;
+
+    SubSegment->Signature = HEAP_LFH_SIGNATURE;
+    SubSegment->Bucket = Bucket;
+    SubSegment->BlockUnits = BlockUnits;
+    SubSegment->BlockCount = BlockCount;
+
+    /* Link all the blocks together, in address order */
+    for (i = 0; i < BlockCount; i++)
+    {
+        HeapEntry = RtlpLowFragHeapBlock(SubSegment, i);
+        HeapEntry->Size = BlockUnits;
+        HeapEntry->Flags = 0;
+        HeapEntry->SmallTagIndex = 0;
+        HeapEntry->PreviousSize = i;
+        HeapEntry->SegmentOffset = HEAP_LFH_SEGMENT_OFFSET;
+        HeapEntry->UnusedBytes = 0;
+        *(PUSHORT)(HeapEntry + 1) = i + 1;
+    }
+
+    SubSegment->FreeState.FirstFree = 0;
+    SubSegment->FreeState.Depth = BlockCount;
+    SubSegment->FreeState.Sequence = 0;
+
+    InsertTailList(&Bucket->SubSegmentList, &SubSegment->ListEntry);
+    Bucket->SubSegmentCount++;
+
+    return SubSegment;
+}
+
+static
+PHEAP_ENTRY
+RtlpLowFragHeapRefill(PHEAP Heap,
+                      PHEAP_LFH_BUCKET Bucket,
+                      ULONG Slot,
+                      USHORT BlockUnits)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY HeapEntry = NULL;
+    PLIST_ENTRY Current;
+
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    /* Somebody else may have refilled this slot meanwhile */
+    SubSegment = Bucket->AffinitySlots[Slot];
+    if (SubSegment) HeapEntry = RtlpLowFragHeapPop(SubSegment);
+
+    /* Otherwise, reuse a subsegment which got some blocks back */
+    for (Current = Bucket->SubSegmentList.Flink;
+         !HeapEntry && Current != &Bucket->SubSegmentList;
+         Current = Current->Flink)
+    {
+        SubSegment = CONTAINING_RECORD(Current, HEAP_LFH_SUBSEGMENT, ListEntry);
+        if (SubSegment->FreeState.Depth == 0) continue;
+
+        HeapEntry = RtlpLowFragHeapPop(SubSegment);
+    }
+
+    /* Carve a new one as the last resort */
+    if (!HeapEntry)
+    {
+        SubSegment = RtlpLowFragHeapCreateSubSegment(Heap, Bucket, BlockUnits);
+        if (SubSegment) HeapEntry = RtlpLowFragHeapPop(SubSegment);
+    }
+
+    /* Further allocations from this slot go to that subsegment */
+    if (HeapEntry)
+        InterlockedExchangePointer((PVOID *)&Bucket->AffinitySlots[Slot], SubSegment);
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    return HeapEntry;
+}
+
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH LowFragHeap;
+    ULONG i;
+
+    /* Already done */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) return STATUS_SUCCESS;
+
+    /* The LFH is for usermode heaps which are serialized and have no debugging options */
+    if (RtlpGetMode() != UserMode ||
+        (Heap->ForceFlags & HEAP_FLAG_PAGE_ALLOCS) ||
+        RtlpHeapIsSpecial(Heap->Flags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)))
+    {
+        DPRINT1("HEAP: Cannot enable the LFH on heap %p (flags %x)\n", Heap, Heap->Flags);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    LowFragHeap = RtlAllocateHeap(Heap, HEAP_ZERO_MEMORY, sizeof(HEAP_LFH));
+    if (!LowFragHeap) return STATUS_NO_MEMORY;
+
+    LowFragHeap->Heap = Heap;
+    for (i = 0; i < HEAP_LFH_BUCKETS; i++)
+        InitializeListHead(&LowFragHeap->Buckets[i].SubSegmentList);
+
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+    {
+        /* Lost a race with another thread */
+        RtlLeaveHeapLock(Heap->LockVariable);
+        RtlFreeHeap(Heap, 0, LowFragHeap);
+        return STATUS_SUCCESS;
+    }
+
+    /* Publish the front end, then its type which the unlocked paths look at */
+    Heap->FrontEndHeap = LowFragHeap;
+    MemoryBarrier();
+    Heap->FrontEndHeapType = HEAP_FRONT_LOWFRAGHEAP;
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    DPRINT("HEAP: LFH enabled on heap %p\n", Heap);
+    return STATUS_SUCCESS;
+}
+
+PHEAP_ENTRY NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags)
+{
+    PHEAP_LFH LowFragHeap = Heap->FrontEndHeap;
+    PHEAP_LFH_BUCKET Bucket;
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY HeapEntry = NULL;
+    ULONG Slot;
+
+    ASSERT(Index < HEAP_LFH_BUCKETS);
+
+    Bucket = &LowFragHeap->Buckets[Index];
+    Slot = RtlpLowFragHeapAffinitySlot();
+
+    /* Fast path: take a block from the subsegment of our slot, without locking */
+    SubSegment = Bucket->AffinitySlots[Slot];
+    if (SubSegment) HeapEntry = RtlpLowFragHeapPop(SubSegment);
+
+    if (!HeapEntry)
+    {
+        HeapEntry = RtlpLowFragHeapRefill(Heap, Bucket, Slot, (USHORT)Index);
+        if (!HeapEntry) return NULL;
+    }
+
+    /* Initialize the header, what's left is fixed for the block lifetime */
+    HeapEntry->Flags = EntryFlags;
+    HeapEntry->UnusedBytes = (UCHAR)((Index << HEAP_ENTRY_SHIFT) - Size);
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(HeapEntry + 1, Size);
+
+    return HeapEntry;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapValidateEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
+        HeapEntry->Size < 2 ||
+        HeapEntry->Size >= HEAP_LFH_BUCKETS)
+    {
+        return FALSE;
+    }
+
+    /* Check the block is where its subsegment expects it */
+    SubSegment = RtlpLowFragHeapSubSegment(HeapEntry);
+    if (((ULONG_PTR)SubSegment & (HEAP_ENTRY_SIZE - 1)) ||
+        SubSegment->Signature != HEAP_LFH_SIGNATURE ||
+        SubSegment->Bucket != &((PHEAP_LFH)Heap->FrontEndHeap)->Buckets[HeapEntry->Size] ||
+        SubSegment->BlockUnits != HeapEntry->Size ||
+        HeapEntry->PreviousSize >= SubSegment->BlockCount)
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SUBSEGMENT SubSegment;
+    BOOLEAN Valid;
+
+    /* Protect with SEH in case the pointer is not valid */
+    _SEH2_TRY
+    {
+        Valid = RtlpLowFragHeapValidateEntry(Heap, HeapEntry);
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Valid = FALSE;
+    }
+    _SEH2_END;
+
+    if (!Valid)
+    {
+        DPRINT1("HEAP: Trying to free an invalid LFH address %p!\n", HeapEntry + 1);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    /* Mark it free so that a double free gets caught, and give it back */
+    SubSegment = RtlpLowFragHeapSubSegment(HeapEntry);
+    HeapEntry->Flags = 0;
+    RtlpLowFragHeapPush(SubSegment, HeapEntry, HeapEntry->PreviousSize);
+
+    return TRUE;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapReAllocate(PHEAP Heap,
+                          ULONG Flags,
+                          PVOID Ptr,
+                          SIZE_T Size)
+{
+    PHEAP_ENTRY HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+    SIZE_T AllocationSize, OldSize;
+    PVOID NewPtr;
+
+    if (!RtlpLowFragHeapValidateEntry(Heap, HeapEntry))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    OldSize = (HeapEntry->Size << HEAP_ENTRY_SHIFT) - HeapEntry->UnusedBytes;
+
+    /* Calculate allocation size the same way RtlAllocateHeap() does */
+    AllocationSize = (Size ? Size : 1);
+    AllocationSize = (AllocationSize + Heap->AlignRound) & Heap->AlignMask;
+
+    /* Still fits in the same block, just update its size */
+    if ((AllocationSize >> HEAP_ENTRY_SHIFT) == HeapEntry->Size)
+    {
+        if ((Flags & HEAP_ZERO_MEMORY) && Size > OldSize)
+            RtlZeroMemory((PCHAR)Ptr + OldSize, Size - OldSize);
+
+        HeapEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+        return Ptr;
+    }
+
+    /* Blocks of the LFH never grow in place */
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_NO_MEMORY);
+        return NULL;
+    }
+
+    /* Move it to a block of the right size, which may come from the back end */
+    NewPtr = RtlAllocateHeap(Heap, Flags & ~HEAP_ZERO_MEMORY, Size);
+    if (!NewPtr) return NULL;
+
+    RtlCopyMemory(NewPtr, Ptr, min(Size, OldSize));
+    if ((Flags & HEAP_ZERO_MEMORY) && Size > OldSize)
+        RtlZeroMemory((PCHAR)NewPtr + OldSize, Size - OldSize);
+
+    RtlpLowFragHeapFree(Heap, HeapEntry);
+
+    return NewPtr;
+}
+
+/* EOF */
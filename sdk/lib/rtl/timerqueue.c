@@ -41,6 +41,7 @@ struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    ULONG heap_index;           /* position in the queue heap, or TIMER_NOT_ARMED */
     ULONG runcount;             /* number of callbacks pending execution */
     WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -55,7 +56,11 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all the timers of the queue */
+    ULONG timer_count;
+    struct queue_timer **heap;  /* armed timers, min-heap on expiration time */
+    ULONG heap_count;
+    ULONG heap_size;            /* always >= timer_count, so arming can't fail */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -63,6 +68,97 @@ struct timer_queue
 
 #define EXPIRE_NEVER (~(ULONGLONG) 0)
 #define TIMER_QUEUE_MAGIC  0x516d6954   /* TimQ */
+#define TIMER_NOT_ARMED (~(ULONG) 0)
+/* Expired timers handled per lock acquisition */
+#define TIMER_EXPIRE_BATCH 64
+
+static inline void heap_set(struct timer_queue *q, ULONG i, struct queue_timer *t)
+{
+    q->heap[i] = t;
+    t->heap_index = i;
+}
+
+static void heap_sift_up(struct timer_queue *q, ULONG i)
+{
+    struct queue_timer *t = q->heap[i];
+
+    while (i > 0)
+    {
+        ULONG parent = (i - 1) / 2;
+        if (q->heap[parent]->expire <= t->expire)
+            break;
+        heap_set(q, i, q->heap[parent]);
+        i = parent;
+    }
+    heap_set(q, i, t);
+}
+
+static void heap_sift_down(struct timer_queue *q, ULONG i)
+{
+    struct queue_timer *t = q->heap[i];
+
+    for (;;)
+    {
+        ULONG child = 2 * i + 1;
+        if (child >= q->heap_count)
+            break;
+        if (child + 1 < q->heap_count &&
+            q->heap[child + 1]->expire < q->heap[child]->expire)
+            ++child;
+        if (t->expire <= q->heap[child]->expire)
+            break;
+        heap_set(q, i, q->heap[child]);
+        i = child;
+    }
+    heap_set(q, i, t);
+}
+
+static void heap_insert(struct timer_queue *q, struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    assert(q->heap_count < q->heap_size);
+    heap_set(q, q->heap_count++, t);
+    heap_sift_up(q, t->heap_index);
+}
+
+static void heap_remove(struct timer_queue *q, struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    ULONG i = t->heap_index;
+    struct queue_timer *last = q->heap[--q->heap_count];
+
+    t->heap_index = TIMER_NOT_ARMED;
+    if (last == t)
+        return;
+
+    heap_set(q, i, last);
+    if (i > 0 && q->heap[(i - 1) / 2]->expire > last->expire)
+        heap_sift_up(q, i);
+    else
+        heap_sift_down(q, i);
+}
+
+static BOOL heap_reserve(struct timer_queue *q, ULONG count)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct queue_timer **heap;
+    ULONG size;
+
+    if (count <= q->heap_size)
+        return TRUE;
+
+    size = max(max(q->heap_size * 2, 16), count);
+    if (q->heap)
+        heap = RtlReAllocateHeap(RtlGetProcessHeap(), 0, q->heap, size * sizeof(*heap));
+    else
+        heap = RtlAllocateHeap(RtlGetProcessHeap(), 0, size * sizeof(*heap));
+    if (!heap)
+        return FALSE;
+
+    q->heap = heap;
+    q->heap_size = size;
+    return TRUE;
+}
 
 static void queue_remove_timer(struct queue_timer *t)
 {
@@ -74,7 +170,10 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
+    if (t->heap_index != TIMER_NOT_ARMED)
+        heap_remove(q, t);
     list_remove(&t->entry);
+    --q->timer_count;
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(RtlGetProcessHeap(), 0, t);
@@ -116,24 +215,21 @@ static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
-
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
+    assert(t->heap_index == TIMER_NOT_ARMED);
 
     t->expire = time;
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* Timers which never expire aren't armed */
+    if (time == EXPIRE_NEVER)
+        return;
+
+    heap_insert(q, t);
+
+    /* If we insert at the head of the heap, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && t->heap_index == 0)
         NtSetEvent(q->event, NULL);
 }
 
@@ -141,53 +237,62 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->heap_index != TIMER_NOT_ARMED)
+        heap_remove(t->q, t);
     queue_add_timer(t, time, set_event);
 }
 
+static void queue_timer_dispatch(struct queue_timer *t)
+{
+    if (t->flags & WT_EXECUTEINTIMERTHREAD)
+        timer_callback_wrapper(t);
+    else
+    {
+        ULONG flags
+            = (t->flags
+               & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
+                  | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
+        NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
+        if (status != STATUS_SUCCESS)
+            timer_cleanup_callback(t);
+    }
+}
+
 static void queue_timer_expire(struct timer_queue *q)
 {
-    struct queue_timer *t = NULL;
+    struct queue_timer *expired[TIMER_EXPIRE_BATCH];
+    struct queue_timer *t;
+    ULONGLONG now, next;
+    ULONG count = 0, i;
 
+    /* Collect all the timers due, then queue their callbacks outside of
+       the lock, so that arming timers isn't held up by the dispatch.  */
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    now = queue_current_time();
+    while (count < TIMER_EXPIRE_BATCH && q->heap_count)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        t = q->heap[0];
+        assert(!t->destroy);
+        if (t->expire > now)
+            break;
+
+        ++t->runcount;
+        if (t->period)
         {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
+            next = t->expire + t->period;
+            /* avoid trigger cascade if overloaded / hibernated */
+            if (next < now)
+                next = now + t->period;
         }
         else
-            t = NULL;
+            next = EXPIRE_NEVER;
+        queue_move_timer(t, next, FALSE);
+        expired[count++] = t;
     }
     RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
-    {
-        if (t->flags & WT_EXECUTEINTIMERTHREAD)
-            timer_callback_wrapper(t);
-        else
-        {
-            ULONG flags
-                = (t->flags
-                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
-                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
-            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
-            if (status != STATUS_SUCCESS)
-                timer_cleanup_callback(t);
-        }
-    }
+    for (i = 0; i < count; i++)
+        queue_timer_dispatch(expired[i]);
 }
 
 static ULONG queue_get_timeout(struct timer_queue *q)
@@ -196,16 +301,12 @@ static ULONG queue_get_timeout(struct timer_queue *q)
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (q->heap_count)
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : (ULONG)(t->expire - time);
-        }
+        ULONGLONG time = queue_current_time();
+        t = q->heap[0];
+        assert(!t->destroy && t->expire != EXPIRE_NEVER);
+        timeout = t->expire < time ? 0 : (ULONG)(t->expire - time);
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -250,6 +351,8 @@ static DWORD WINAPI timer_queue_thread_proc(LPVOID p)
     NtClose(q->event);
     RtlDeleteCriticalSection(&q->cs);
     q->magic = 0;
+    if (q->heap)
+        RtlFreeHeap(RtlGetProcessHeap(), 0, q->heap);
     RtlFreeHeap(RtlGetProcessHeap(), 0, q);
     RtlpExitThreadFunc(STATUS_SUCCESS);
     return 0;
@@ -265,8 +368,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Disarm it, it will never fire again.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -291,6 +393,10 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    q->timer_count = 0;
+    q->heap = NULL;
+    q->heap_count = 0;
+    q->heap_size = 0;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -439,6 +545,7 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
         return STATUS_NO_MEMORY;
 
     t->q = q;
+    t->heap_index = TIMER_NOT_ARMED;
     t->runcount = 0;
     t->callback = Callback;
     t->param = Parameter;
@@ -451,8 +558,15 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
+    /* Room for the timer in the heap is made now, as rearming can't fail */
+    else if (!heap_reserve(q, q->timer_count + 1))
+        status = STATUS_NO_MEMORY;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
+        ++q->timer_count;
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
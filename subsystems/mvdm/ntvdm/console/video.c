@@ -478,6 +478,7 @@ VOID ScreenEventHandler(PWINDOW_BUFFER_SIZE_RECORD ScreenEvent)
 
     /* Force refresh of all the screen */
     NeedsUpdate = TRUE;
+    FramebufferDirty = TRUE;
     UpdateRectangle.Left = 0;
     UpdateRectangle.Top  = 0;
     UpdateRectangle.Right  = CurrResolution.X;
@@ -531,6 +532,9 @@ BOOL VgaAttachToConsole(VOID)
     }
     OldConsoleFramebuffer = NULL;
 
+    /* Refill the framebuffer from the VGA memory */
+    FramebufferDirty = TRUE;
+
     return TRUE;
 }
 
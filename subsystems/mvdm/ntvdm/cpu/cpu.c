@@ -233,6 +233,9 @@ BOOLEAN CpuInitialize(VOID)
                       EmulatorFpu,
                       NULL /* TODO: Use a TLB */);
 
+    /* Let the CPU access plain RAM directly */
+    Fast486SetMemoryMap(&EmulatorContext, MemGetMemoryMap(), TOTAL_PAGES);
+
     /* Initialize the software callback system and register the emulator BOPs */
     // RegisterBop(BOP_DEBUGGER  , EmulatorDebugBreakBop);
     RegisterBop(BOP_UNSIMULATE, CpuUnsimulateBop);
@@ -243,6 +243,12 @@ static PBYTE GraphicsFramebuffer = NULL;
  */
 static BYTE VgaMemory[VGA_NUM_BANKS * SVGA_BANK_SIZE];
 
+/* Blocks of the VGA memory written since the last refresh */
+#define VGA_DIRTY_BLOCK_SHIFT 9
+static BYTE VgaDirtyBlocks[sizeof(VgaMemory) >> VGA_DIRTY_BLOCK_SHIFT];
+static DWORD VgaDirtyFirst = MAXDWORD;
+static DWORD VgaDirtyLast  = 0;
+
 static BYTE VgaLatchRegisters[VGA_NUM_BANKS] = {0, 0, 0, 0};
 
 static BYTE VgaMiscRegister;
@@ -279,6 +285,7 @@ static DWORD StartAddressLatch = 0;
 static DWORD ScanlineSizeLatch = 0;
 
 static BOOLEAN NeedsUpdate = FALSE;
+static BOOLEAN FramebufferDirty = TRUE; // Registers changed, the whole VGA memory must be converted again
 static BOOLEAN ModeChanged = FALSE;
 static BOOLEAN CursorChanged  = FALSE;
 static BOOLEAN PaletteChanged = FALSE;
@@ -705,6 +712,7 @@ Quit:
 
     /* Trigger a full update of the screen */
     NeedsUpdate = TRUE;
+    FramebufferDirty = TRUE;
     UpdateRectangle.Left = 0;
     UpdateRectangle.Top  = 0;
     UpdateRectangle.Right  = CurrResolution.X;
@@ -733,7 +741,53 @@ static inline VOID VgaMarkForUpdate(SHORT Row, SHORT Column)
     NeedsUpdate = TRUE;
 }
 
-static VOID VgaUpdateFramebuffer(VOID)
+static inline VOID VgaMarkMemoryDirty(DWORD Offset, DWORD Size)
+{
+    DWORD Block, LastBlock;
+
+    if (Offset >= sizeof(VgaMemory) || Size == 0) return;
+
+    LastBlock = min(Offset + Size - 1, sizeof(VgaMemory) - 1) >> VGA_DIRTY_BLOCK_SHIFT;
+    for (Block = Offset >> VGA_DIRTY_BLOCK_SHIFT; Block <= LastBlock; Block++)
+    {
+        VgaDirtyBlocks[Block] = TRUE;
+    }
+
+    VgaDirtyFirst = min(VgaDirtyFirst, Offset >> VGA_DIRTY_BLOCK_SHIFT);
+    VgaDirtyLast  = max(VgaDirtyLast, LastBlock);
+}
+
+static inline BOOLEAN VgaIsMemoryDirty(DWORD Start, DWORD End)
+{
+    DWORD Block;
+
+    /* Be conservative if the range wraps around */
+    if (End <= Start) return TRUE;
+
+    Start >>= VGA_DIRTY_BLOCK_SHIFT;
+    End = min((End - 1) >> VGA_DIRTY_BLOCK_SHIFT, ARRAYSIZE(VgaDirtyBlocks) - 1);
+    if (Start > VgaDirtyLast || End < VgaDirtyFirst) return FALSE;
+
+    for (Block = max(Start, VgaDirtyFirst); Block <= min(End, VgaDirtyLast); Block++)
+    {
+        if (VgaDirtyBlocks[Block]) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static inline VOID VgaClearDirtyMemory(VOID)
+{
+    if (VgaDirtyFirst <= VgaDirtyLast)
+    {
+        RtlZeroMemory(&VgaDirtyBlocks[VgaDirtyFirst], VgaDirtyLast - VgaDirtyFirst + 1);
+    }
+
+    VgaDirtyFirst = MAXDWORD;
+    VgaDirtyLast  = 0;
+}
+
+static VOID VgaUpdateFramebuffer(BOOLEAN FullUpdate)
 {
     SHORT i, j, k;
     DWORD AddressSize = VgaGetAddressSize();
@@ -806,6 +860,30 @@ static VOID VgaUpdateFramebuffer(VOID)
                 Address |= InterlaceHighBit;
             }
 
+            /*
+             * Skip the scanline if none of the VGA memory it is built from
+             * was written. Outside of the packed-pixel modes, every pixel
+             * comes from the bytes at (Address + X / 4) or below.
+             */
+            if (!FullUpdate)
+            {
+                DWORD LineStart, LineEnd;
+
+                if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+                {
+                    LineStart = Address;
+                    LineEnd   = Address + CurrResolution.X + 16;
+                }
+                else
+                {
+                    LineStart = WRAP_OFFSET(Address * AddressSize) * VGA_NUM_BANKS;
+                    LineEnd   = (WRAP_OFFSET((Address + (CurrResolution.X >> 2) + 8) * AddressSize) + 1)
+                                * VGA_NUM_BANKS;
+                }
+
+                if (!VgaIsMemoryDirty(LineStart, LineEnd)) goto NextScanline;
+            }
+
             /* Loop through the pixels */
             for (j = 0; j < CurrResolution.X; j++)
             {
@@ -1013,6 +1091,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                 }
             }
 
+NextScanline:
             if ((VgaGcRegisters[VGA_GC_MISC_REG] & VGA_GC_MISC_OE) && (i & 1))
             {
                 /* Clear the high bit */
@@ -1607,6 +1686,55 @@ static VOID WINAPI VgaWritePort(USHORT Port, BYTE Data)
             break;
     }
 
+    /*
+     * Most registers affect how the VGA memory is displayed. The index
+     * registers, the DAC (tracked with PaletteChanged) and the registers
+     * only controlling how the CPU accesses the memory do not, and games
+     * reprogram those all the time while drawing.
+     */
+    switch (Port)
+    {
+        case VGA_SEQ_INDEX:
+        case VGA_GC_INDEX:
+        case VGA_CRTC_INDEX_MONO:
+        case VGA_CRTC_INDEX_COLOR:
+        case VGA_DAC_READ_INDEX:
+        case VGA_DAC_WRITE_INDEX:
+        case VGA_DAC_DATA:
+            break;
+
+        case VGA_SEQ_DATA:
+        {
+            if (VgaSeqIndex != VGA_SEQ_MASK_REG) FramebufferDirty = TRUE;
+            break;
+        }
+
+        case VGA_GC_DATA:
+        {
+            switch (VgaGcIndex)
+            {
+                case VGA_GC_RESET_REG:
+                case VGA_GC_ENABLE_RESET_REG:
+                case VGA_GC_COLOR_COMPARE_REG:
+                case VGA_GC_ROTATE_REG:
+                case VGA_GC_READ_MAP_SEL_REG:
+                case VGA_GC_COLOR_IGNORE_REG:
+                case VGA_GC_BITMASK_REG:
+                    break;
+
+                default:
+                    FramebufferDirty = TRUE;
+                    break;
+            }
+
+            break;
+        }
+
+        default:
+            FramebufferDirty = TRUE;
+            break;
+    }
+
     SvgaHdrCounter = 0;
 }
 
@@ -1626,6 +1754,7 @@ static inline VOID VgaVerticalRetrace(VOID)
     {
         /* Trigger a full update of the screen */
         NeedsUpdate = TRUE;
+        FramebufferDirty = TRUE;
         UpdateRectangle.Left = 0;
         UpdateRectangle.Top  = 0;
         UpdateRectangle.Right  = CurrResolution.X;
@@ -1634,8 +1763,17 @@ static inline VOID VgaVerticalRetrace(VOID)
         PaletteChanged = FALSE;
     }
 
-    /* Update the contents of the framebuffer */
-    VgaUpdateFramebuffer();
+    /*
+     * Update the contents of the framebuffer, unless nothing was written
+     * since the last time: converting the whole VGA memory is expensive.
+     * If only the memory changed, just the scanlines it covers are converted.
+     */
+    if (FramebufferDirty || VgaDirtyFirst <= VgaDirtyLast)
+    {
+        VgaUpdateFramebuffer(FramebufferDirty);
+        FramebufferDirty = FALSE;
+        VgaClearDirtyMemory();
+    }
 
     /* Ignore if there's nothing to update */
     if (!NeedsUpdate) return;
@@ -1700,6 +1838,9 @@ static VOID FASTCALL VgaHorizontalRetrace(ULONGLONG ElapsedTime)
 
     if (ScanlineCounter == VerticalRetraceStart)
     {
+        DWORD OldStartAddress = StartAddressLatch;
+        DWORD OldScanlineSize = ScanlineSizeLatch;
+
         /* Save the scanline size */
         ScanlineSizeLatch = ((DWORD)VgaCrtcRegisters[VGA_CRTC_OFFSET_REG]
                             + (((DWORD)VgaCrtcRegisters[SVGA_CRTC_EXT_DISPLAY_REG] & SVGA_CRTC_EXT_OFFSET_BIT8) << 4)) * 2;
@@ -1713,6 +1854,12 @@ static VOID FASTCALL VgaHorizontalRetrace(ULONGLONG ElapsedTime)
                             + ((VgaCrtcRegisters[SVGA_CRTC_OVERLAY_REG] & SVGA_CRTC_EXT_ADDR_BIT19) << 12)
                             + (VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] & 0x1F) * ScanlineSizeLatch
                             + ((VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] >> 5) & 3);
+
+        /* Scrolling or page flipping moves every scanline */
+        if (StartAddressLatch != OldStartAddress || ScanlineSizeLatch != OldScanlineSize)
+        {
+            FramebufferDirty = TRUE;
+        }
     }
 
     if (ScanlineCounter > VerticalTotal)
@@ -1782,6 +1929,9 @@ COORD VgaGetDisplayResolution(VOID)
 
 VOID VgaRefreshDisplay(VOID)
 {
+    DWORD OldStartAddress = StartAddressLatch;
+    DWORD OldScanlineSize = ScanlineSizeLatch;
+
     /* Save the scanline size */
     ScanlineSizeLatch = ((DWORD)VgaCrtcRegisters[VGA_CRTC_OFFSET_REG]
                         + (((DWORD)VgaCrtcRegisters[SVGA_CRTC_EXT_DISPLAY_REG] & SVGA_CRTC_EXT_OFFSET_BIT8) << 4)) * 2;
@@ -1796,6 +1946,12 @@ VOID VgaRefreshDisplay(VOID)
                         + (VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] & 0x1F) * ScanlineSizeLatch
                         + ((VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] >> 5) & 3);
 
+    /* Scrolling or page flipping moves every scanline */
+    if (StartAddressLatch != OldStartAddress || ScanlineSizeLatch != OldScanlineSize)
+    {
+        FramebufferDirty = TRUE;
+    }
+
     VgaVerticalRetrace();
 }
 
@@ -1999,6 +2155,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         for (i = 0; i < Size; i++)
         {
             VideoAddress = VgaTranslateAddress(Address + i);
+            VgaMarkMemoryDirty(VideoAddress * VGA_NUM_BANKS, VGA_NUM_BANKS);
 
             for (j = 0; j < VGA_NUM_BANKS; j++)
             {
@@ -2040,6 +2197,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         /* Just copy to the video memory */
         VideoAddress = VgaTranslateAddress(Address);
         VideoMemory = &VgaMemory[VideoAddress + (Address & 3)];
+        VgaMarkMemoryDirty(VideoAddress + (Address & 3), Size);
 
         switch (Size)
         {
@@ -2074,6 +2232,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
 VOID VgaClearMemory(VOID)
 {
     RtlZeroMemory(VgaMemory, sizeof(VgaMemory));
+    FramebufferDirty = TRUE;
 }
 
 VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
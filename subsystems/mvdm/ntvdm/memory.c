@@ -40,8 +40,28 @@ static LIST_ENTRY HookList;
 static PMEM_HOOK PageTable[TOTAL_PAGES] = { NULL };
 static BOOLEAN A20Line = FALSE;
 
+/*
+ * Host pointers to the pages the CPU can access without going through
+ * EmulatorReadMemory/EmulatorWriteMemory, NULL for hooked pages.
+ */
+static PUCHAR MemoryMap[TOTAL_PAGES] = { NULL };
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
+static VOID
+MemUpdateMemoryMap(VOID)
+{
+    ULONG i, Page;
+
+    for (i = 0; i < TOTAL_PAGES; i++)
+    {
+        /* If the A20 line is disabled, mask bit 20 */
+        Page = A20Line ? i : (i & ~((1 << 20) >> 12));
+
+        MemoryMap[i] = (PageTable[Page] == NULL) ? (PUCHAR)REAL_TO_PHYS(Page << 12) : NULL;
+    }
+}
+
 static inline VOID
 MemFastMoveMemory(OUT VOID UNALIGNED *Destination,
                   IN const VOID UNALIGNED *Source,
@@ -271,7 +291,10 @@ VOID FASTCALL EmulatorCopyMemory(PFAST486_STATE State, ULONG DestAddress, ULONG
 
 VOID EmulatorSetA20(BOOLEAN Enabled)
 {
+    if (A20Line == Enabled) return;
+
     A20Line = Enabled;
+    MemUpdateMemoryMap();
 }
 
 BOOLEAN EmulatorGetA20(VOID)
@@ -343,6 +366,7 @@ MemInstallFastMemoryHook(PVOID Address,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    MemUpdateMemoryMap();
     return TRUE;
 }
 
@@ -371,6 +395,7 @@ MemRemoveFastMemoryHook(PVOID Address, ULONG Size)
         PageTable[i] = NULL;
     }
 
+    MemUpdateMemoryMap();
     return TRUE;
 }
 
@@ -539,6 +564,7 @@ VDDInstallMemoryHook(IN HANDLE hVdd,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    MemUpdateMemoryMap();
     return TRUE;
 }
 
@@ -595,6 +621,7 @@ VDDDeInstallMemoryHook(IN HANDLE hVdd,
         PageTable[i] = NULL;
     }
 
+    MemUpdateMemoryMap();
     return TRUE;
 }
 
@@ -773,9 +800,17 @@ MemInitialize(VOID)
      * retrieve the exact CS:IP where the problem happens.
      */
     RtlFillMemory(BaseAddress, MAX_ADDRESS, 0xCC);
+
+    MemUpdateMemoryMap();
     return TRUE;
 }
 
+PUCHAR*
+MemGetMemoryMap(VOID)
+{
+    return MemoryMap;
+}
+
 VOID
 MemCleanup(VOID)
 {
@@ -92,4 +92,7 @@ MemQueryMemoryZone
     PBOOLEAN Hooked
 );
 
+PUCHAR*
+MemGetMemoryMap(VOID);
+
 #endif /* _MEMORY_H_ */
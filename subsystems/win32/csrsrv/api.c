@@ -868,7 +868,7 @@ CsrApiRequestThread(IN PVOID Parameter)
  *
  * The CsrApiPortInitialize routine initializes the LPC Port used for
  * communications with the Client/Server Runtime (CSR) and initializes the
- * static thread that will handle connection requests and APIs.
+ * static threads that will handle connection requests and APIs.
  *
  * @param None
  *
@@ -881,7 +881,7 @@ NTSTATUS
 NTAPI
 CsrApiPortInitialize(VOID)
 {
-    ULONG Size;
+    ULONG Size, i;
     OBJECT_ATTRIBUTES ObjectAttributes;
     NTSTATUS Status;
     HANDLE hRequestEvent, hThread;
@@ -934,22 +934,35 @@ CsrApiPortInitialize(VOID)
                                FALSE);
         if (NT_SUCCESS(Status))
         {
-            /* Create the Request Thread */
-            Status = RtlCreateUserThread(NtCurrentProcess(),
-                                         NULL,
-                                         TRUE,
-                                         0,
-                                         0,
-                                         0,
-                                         (PVOID)CsrApiRequestThread,
-                                         (PVOID)hRequestEvent,
-                                         &hThread,
-                                         &ClientId);
-            if (NT_SUCCESS(Status))
+            /* Create the Request Threads, one per processor by default */
+            for (i = 0; i < max(CsrApiRequestThreads, 1); i++)
             {
+                Status = RtlCreateUserThread(NtCurrentProcess(),
+                                             NULL,
+                                             TRUE,
+                                             0,
+                                             0,
+                                             0,
+                                             (PVOID)CsrApiRequestThread,
+                                             (PVOID)hRequestEvent,
+                                             &hThread,
+                                             &ClientId);
+                if (!NT_SUCCESS(Status))
+                {
+                    DPRINT1("CSRSRV: Failed to create request thread %lu (Status=0x%08lx)\n",
+                            i, Status);
+                    break;
+                }
+
                 /* Add this as a static thread to CSRSRV */
                 CsrAddStaticServerThread(hThread, &ClientId, CsrThreadIsServerThread);
+            }
+
+            /* We can run with fewer threads than asked for, but not with none */
+            if (i > 0) Status = STATUS_SUCCESS;
 
+            if (NT_SUCCESS(Status))
+            {
                 /* Get the Thread List Pointers */
                 ListHead = &CsrRootProcess->ThreadList;
                 NextEntry = ListHead->Flink;
@@ -43,6 +43,8 @@ extern HANDLE CsrSmApiPort;
 extern HANDLE CsrSbApiPort;
 #define NUMBER_THREAD_HASH_BUCKETS 257
 extern LIST_ENTRY CsrThreadHashTable[NUMBER_THREAD_HASH_BUCKETS];
+#define NUMBER_PROCESS_HASH_BUCKETS 257
+extern LIST_ENTRY CsrProcessHashTable[NUMBER_PROCESS_HASH_BUCKETS];
 extern PCSR_PROCESS CsrRootProcess;
 extern UNICODE_STRING CsrDirectoryName;
 extern ULONG CsrTotalPerProcessDataLength;
@@ -53,6 +55,7 @@ extern PVOID *CsrSrvSharedStaticServerData;
 extern HANDLE CsrInitializationEvent;
 extern PCSR_SERVER_DLL CsrLoadedServerDll[CSR_SERVER_DLL_MAX];
 extern ULONG CsrMaxApiRequestThreads;
+extern ULONG CsrApiRequestThreads;
 
 /****************************************************/
 extern UNICODE_STRING CsrSbApiPortName;
@@ -32,6 +32,7 @@ HANDLE CsrSmApiPort = NULL;
 HANDLE hSbApiPort = NULL;
 HANDLE CsrApiPort = NULL;
 ULONG CsrMaxApiRequestThreads;
+ULONG CsrApiRequestThreads;
 ULONG CsrTotalPerProcessDataLength;
 ULONG SessionId;
 HANDLE BNOLinksDirectory;
@@ -553,7 +554,13 @@ CsrParseServerCommandLine(IN ULONG ArgumentCount,
     /* Set the Defaults */
     CsrTotalPerProcessDataLength = 0;
     CsrObjectDirectory = NULL;
-    CsrMaxApiRequestThreads = 16;
+
+    /*
+     * Start with one request thread per processor, and allow some more to be
+     * created on demand when all of them are busy.
+     */
+    CsrApiRequestThreads = CsrNtSysInfo.NumberOfProcessors;
+    CsrMaxApiRequestThreads = max(16, 4 * CsrNtSysInfo.NumberOfProcessors);
 
     /* Save our Session ID, and create a Directory for it */
     SessionId = NtCurrentPeb()->SessionId;
@@ -623,8 +630,9 @@ CsrParseServerCommandLine(IN ULONG ArgumentCount,
         }
         else if (_stricmp(ParameterName, "RequestThreads") == 0)
         {
-            /* Ignored */
-            Status = STATUS_SUCCESS;
+            Status = RtlCharToInteger(ParameterValue,
+                                      0,
+                                      &CsrApiRequestThreads);
         }
         else if (_stricmp(ParameterName, "ProfileControl") == 0)
         {
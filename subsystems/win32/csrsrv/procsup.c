@@ -18,8 +18,21 @@
 
 /* GLOBALS ********************************************************************/
 
+/*
+ * Private part of a CSR Process. It is allocated in front of the CSR_PROCESS
+ * structure so that the layout seen by the Server DLLs does not change.
+ */
+typedef struct _CSRP_PROCESS_HEADER
+{
+    LIST_ENTRY HashLinks;
+} CSRP_PROCESS_HEADER, *PCSRP_PROCESS_HEADER;
+
+#define CsrpProcessHeader(p) ((PCSRP_PROCESS_HEADER)(p) - 1)
+#define CsrHashProcess(p) (HandleToUlong(p) % NUMBER_PROCESS_HASH_BUCKETS)
+
 RTL_CRITICAL_SECTION CsrProcessLock;
 PCSR_PROCESS CsrRootProcess = NULL;
+LIST_ENTRY CsrProcessHashTable[NUMBER_PROCESS_HASH_BUCKETS];
 SECURITY_QUALITY_OF_SERVICE CsrSecurityQos =
 {
     sizeof(SECURITY_QUALITY_OF_SERVICE),
@@ -187,17 +200,21 @@ PCSR_PROCESS
 NTAPI
 CsrAllocateProcess(VOID)
 {
+    PCSRP_PROCESS_HEADER ProcessHeader;
     PCSR_PROCESS CsrProcess;
     ULONG TotalSize;
 
     /* Calculate the amount of memory this should take */
-    TotalSize = sizeof(CSR_PROCESS) +
+    TotalSize = sizeof(CSRP_PROCESS_HEADER) +
+                sizeof(CSR_PROCESS) +
                 (CSR_SERVER_DLL_MAX * sizeof(PVOID)) +
                 CsrTotalPerProcessDataLength;
 
-    /* Allocate a Process */
-    CsrProcess = RtlAllocateHeap(CsrHeap, HEAP_ZERO_MEMORY, TotalSize);
-    if (!CsrProcess) return NULL;
+    /* Allocate a Process, the public part follows our header */
+    ProcessHeader = RtlAllocateHeap(CsrHeap, HEAP_ZERO_MEMORY, TotalSize);
+    if (!ProcessHeader) return NULL;
+    InitializeListHead(&ProcessHeader->HashLinks);
+    CsrProcess = (PCSR_PROCESS)(ProcessHeader + 1);
 
     /* Handle the Sequence Number and protect against overflow */
     CsrProcess->SequenceNumber = CsrProcessSequenceCount++;
@@ -260,6 +277,9 @@ CsrInitializeProcessStructure(VOID)
     Status = RtlInitializeCriticalSection(&CsrProcessLock);
     if (!NT_SUCCESS(Status)) return Status;
 
+    /* Initialize the Process Hash List */
+    for (i = 0; i < NUMBER_PROCESS_HASH_BUCKETS; i++) InitializeListHead(&CsrProcessHashTable[i]);
+
     /* Set up the Root Process */
     CsrRootProcess = CsrAllocateProcess();
     if (!CsrRootProcess) return STATUS_NO_MEMORY;
@@ -268,6 +288,8 @@ CsrInitializeProcessStructure(VOID)
     InitializeListHead(&CsrRootProcess->ListLink);
     CsrRootProcess->ProcessHandle = (HANDLE)-1;
     CsrRootProcess->ClientId = NtCurrentTeb()->ClientId;
+    InsertHeadList(&CsrProcessHashTable[CsrHashProcess(CsrRootProcess->ClientId.UniqueProcess)],
+                   &CsrpProcessHeader(CsrRootProcess)->HashLinks);
 
     /* Initialize the Thread Hash List */
     for (i = 0; i < NUMBER_THREAD_HASH_BUCKETS; i++) InitializeListHead(&CsrThreadHashTable[i]);
@@ -295,8 +317,8 @@ VOID
 NTAPI
 CsrDeallocateProcess(IN PCSR_PROCESS CsrProcess)
 {
-    /* Free the process object from the heap */
-    RtlFreeHeap(CsrHeap, 0, CsrProcess);
+    /* Free the process object, along with its header, from the heap */
+    RtlFreeHeap(CsrHeap, 0, CsrpProcessHeader(CsrProcess));
 }
 
 /*++
@@ -322,8 +344,9 @@ CsrRemoveProcess(IN PCSR_PROCESS CsrProcess)
     ULONG i;
     ASSERT(ProcessStructureListLocked());
 
-    /* Remove us from the Process List */
+    /* Remove us from the Process List and the Hash Table */
     RemoveEntryList(&CsrProcess->ListLink);
+    RemoveEntryList(&CsrpProcessHeader(CsrProcess)->HashLinks);
 
     /* Release the lock */
     CsrReleaseProcessLock();
@@ -369,8 +392,10 @@ CsrInsertProcess(IN PCSR_PROCESS ParentProcess OPTIONAL,
     ULONG i;
     ASSERT(ProcessStructureListLocked());
 
-    /* Insert it into the Root List */
+    /* Insert it into the Root List and the Hash Table */
     InsertTailList(&CsrRootProcess->ListLink, &CsrProcess->ListLink);
+    InsertHeadList(&CsrProcessHashTable[CsrHashProcess(CsrProcess->ClientId.UniqueProcess)],
+                   &CsrpProcessHeader(CsrProcess)->HashLinks);
 
     /* Notify the Server DLLs */
     for (i = 0; i < CSR_SERVER_DLL_MAX; i++)
@@ -982,7 +1007,7 @@ NTAPI
 CsrLockProcessByClientId(IN HANDLE Pid,
                          OUT PCSR_PROCESS *CsrProcess)
 {
-    PLIST_ENTRY NextEntry;
+    PLIST_ENTRY ListHead, NextEntry;
     PCSR_PROCESS CurrentProcess = NULL;
     NTSTATUS Status = STATUS_UNSUCCESSFUL;
 
@@ -993,12 +1018,15 @@ CsrLockProcessByClientId(IN HANDLE Pid,
     ASSERT(CsrProcess != NULL);
     *CsrProcess = NULL;
 
-    /* Setup the List Pointers */
-    NextEntry = &CsrRootProcess->ListLink;
-    do
+    /* Only walk the hash bucket of this PID */
+    ListHead = &CsrProcessHashTable[CsrHashProcess(Pid)];
+    NextEntry = ListHead->Flink;
+    while (NextEntry != ListHead)
     {
         /* Get the Process */
-        CurrentProcess = CONTAINING_RECORD(NextEntry, CSR_PROCESS, ListLink);
+        CurrentProcess = (PCSR_PROCESS)(CONTAINING_RECORD(NextEntry,
+                                                          CSRP_PROCESS_HEADER,
+                                                          HashLinks) + 1);
 
         /* Check for PID Match */
         if (CurrentProcess->ClientId.UniqueProcess == Pid)
@@ -1009,7 +1037,7 @@ CsrLockProcessByClientId(IN HANDLE Pid,
 
         /* Move to the next entry */
         NextEntry = NextEntry->Flink;
-    } while (NextEntry != &CsrRootProcess->ListLink);
+    }
 
     /* Check if we didn't find it in the list */
     if (!NT_SUCCESS(Status))
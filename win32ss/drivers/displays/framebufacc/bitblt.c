@@ -0,0 +1,261 @@
+/*
+ * ReactOS Generic Framebuffer acclations display driver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "framebufacc.h"
+
+#define ROP4_SRCCOPY    0xCCCC
+#define ROP4_PATCOPY    0xF0F0
+
+typedef struct _ACCEL_ENUMRECTS
+{
+   ULONG c;
+   RECTL arcl[VIDEO_ACCEL_MAX_COMMANDS];
+} ACCEL_ENUMRECTS;
+
+/*
+ * IntAccelRects
+ *
+ * Sends one accelerator command for each part of prclTrg that is visible
+ * through pco. For copies the clip rectangles are walked in the direction
+ * of the move, so that no part of the source is overwritten before it was
+ * copied.
+ */
+
+static BOOL
+IntAccelRects(
+   IN PPDEV ppdev,
+   IN CLIPOBJ *pco,
+   IN RECTL *prclTrg,
+   IN VIDEO_ACCEL_COMMAND *pTemplate)
+{
+   VIDEO_ACCEL_COMMAND Commands[VIDEO_ACCEL_MAX_COMMANDS];
+   ACCEL_ENUMRECTS EnumRects;
+   RECTL rcl;
+   ULONG i, cCommands = 0, iDirection, ulTemp;
+   LONG dx = 0, dy = 0;
+   BOOL bMore;
+
+   if (pTemplate->Command == VIDEO_ACCEL_RECT_COPY)
+   {
+      dx = pTemplate->SrcX - prclTrg->left;
+      dy = pTemplate->SrcY - prclTrg->top;
+   }
+
+   if (pco == NULL || pco->iDComplexity == DC_TRIVIAL)
+   {
+      EnumRects.c = 1;
+      EnumRects.arcl[0] = *prclTrg;
+      bMore = FALSE;
+   }
+   else if (pco->iDComplexity == DC_RECT)
+   {
+      EnumRects.c = 1;
+      EnumRects.arcl[0] = pco->rclBounds;
+      bMore = FALSE;
+   }
+   else
+   {
+      if (dy < 0)
+         iDirection = (dx < 0) ? CD_LEFTUP : CD_RIGHTUP;
+      else
+         iDirection = (dx < 0) ? CD_LEFTDOWN : CD_RIGHTDOWN;
+
+      CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, iDirection, 0);
+      bMore = TRUE;
+   }
+
+   do
+   {
+      if (bMore)
+      {
+         bMore = CLIPOBJ_bEnum(pco, sizeof(EnumRects), (PULONG)&EnumRects);
+      }
+
+      for (i = 0; i < EnumRects.c; i++)
+      {
+         rcl.left = max(EnumRects.arcl[i].left, prclTrg->left);
+         rcl.top = max(EnumRects.arcl[i].top, prclTrg->top);
+         rcl.right = min(EnumRects.arcl[i].right, prclTrg->right);
+         rcl.bottom = min(EnumRects.arcl[i].bottom, prclTrg->bottom);
+         if (rcl.left >= rcl.right || rcl.top >= rcl.bottom)
+         {
+            continue;
+         }
+
+         Commands[cCommands] = *pTemplate;
+         Commands[cCommands].SrcX = rcl.left + dx;
+         Commands[cCommands].SrcY = rcl.top + dy;
+         Commands[cCommands].DestX = rcl.left;
+         Commands[cCommands].DestY = rcl.top;
+         Commands[cCommands].Width = rcl.right - rcl.left;
+         Commands[cCommands].Height = rcl.bottom - rcl.top;
+
+         if (++cCommands == VIDEO_ACCEL_MAX_COMMANDS)
+         {
+            if (EngDeviceIoControl(ppdev->hDriver, IOCTL_VIDEO_ACCEL_COMMANDS,
+                                   Commands, sizeof(Commands), NULL, 0,
+                                   &ulTemp))
+            {
+               return FALSE;
+            }
+            cCommands = 0;
+         }
+      }
+   }
+   while (bMore);
+
+   if (cCommands != 0 &&
+       EngDeviceIoControl(ppdev->hDriver, IOCTL_VIDEO_ACCEL_COMMANDS,
+                          Commands, cCommands * sizeof(VIDEO_ACCEL_COMMAND),
+                          NULL, 0, &ulTemp))
+   {
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+/*
+ * DrvBitBlt
+ *
+ * Screen to screen copies and solid fills on the primary surface are done
+ * by the accelerator. Everything else is handed to GDI.
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvBitBlt(
+   IN SURFOBJ *psoTrg,
+   IN SURFOBJ *psoSrc,
+   IN SURFOBJ *psoMask,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclTrg,
+   IN POINTL *pptlSrc,
+   IN POINTL *pptlMask,
+   IN BRUSHOBJ *pbo,
+   IN POINTL *pptlBrush,
+   IN ROP4 rop4)
+{
+   PPDEV ppdev = (PPDEV)psoTrg->dhpdev;
+   VIDEO_ACCEL_COMMAND Template;
+
+   if (ppdev != NULL && psoTrg->hsurf == ppdev->hSurfEng && psoMask == NULL)
+   {
+      memset(&Template, 0, sizeof(Template));
+
+      switch (rop4)
+      {
+         case ROP4_SRCCOPY:
+            if ((ppdev->AccelCaps & VIDEO_ACCEL_RECT_COPY) &&
+                psoSrc != NULL && psoSrc->hsurf == ppdev->hSurfEng &&
+                (pxlo == NULL || (pxlo->flXlate & XO_TRIVIAL)))
+            {
+               Template.Command = VIDEO_ACCEL_RECT_COPY;
+               Template.SrcX = pptlSrc->x;
+               Template.SrcY = pptlSrc->y;
+               if (IntAccelRects(ppdev, pco, prclTrg, &Template))
+                  return TRUE;
+            }
+            break;
+
+         case ROP4_PATCOPY:
+            if ((ppdev->AccelCaps & VIDEO_ACCEL_RECT_FILL) &&
+                pbo != NULL && pbo->iSolidColor != 0xFFFFFFFF)
+            {
+               Template.Command = VIDEO_ACCEL_RECT_FILL;
+               Template.Color = pbo->iSolidColor;
+               if (IntAccelRects(ppdev, pco, prclTrg, &Template))
+                  return TRUE;
+            }
+            break;
+      }
+   }
+
+   return EngBitBlt(psoTrg, psoSrc, psoMask, pco, pxlo, prclTrg, pptlSrc,
+                    pptlMask, pbo, pptlBrush, rop4);
+}
+
+/*
+ * DrvCopyBits
+ *
+ * Status
+ *    @implemented
+ */
+
+BOOL APIENTRY
+DrvCopyBits(
+   OUT SURFOBJ *psoDest,
+   IN SURFOBJ *psoSrc,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclDest,
+   IN POINTL *pptlSrc)
+{
+   PPDEV ppdev = (PPDEV)psoDest->dhpdev;
+
+   /* Only screen to screen copies can be accelerated */
+   if (ppdev != NULL && psoDest->hsurf == ppdev->hSurfEng &&
+       psoSrc->hsurf == ppdev->hSurfEng)
+   {
+      return DrvBitBlt(psoDest, psoSrc, NULL, pco, pxlo, prclDest, pptlSrc,
+                       NULL, NULL, NULL, ROP4_SRCCOPY);
+   }
+
+   return EngCopyBits(psoDest, psoSrc, pco, pxlo, prclDest, pptlSrc);
+}
+
+/*
+ * DrvSynchronizeSurface
+ *
+ * The accelerator commands are complete when the IOCTL returns, so the only
+ * thing to do here is to tell the device which parts of the frame buffer
+ * GDI has drawn to since the last flush.
+ *
+ * Status
+ *    @implemented
+ */
+
+VOID APIENTRY
+DrvSynchronizeSurface(
+   IN SURFOBJ *pso,
+   IN RECTL *prcl,
+   IN FLONG fl)
+{
+   PPDEV ppdev = (PPDEV)pso->dhpdev;
+   VIDEO_ACCEL_COMMAND Command;
+   ULONG ulTemp;
+
+   if (!(fl & DSS_FLUSH_EVENT) || prcl == NULL ||
+       !(ppdev->AccelCaps & VIDEO_ACCEL_UPDATE))
+   {
+      return;
+   }
+
+   memset(&Command, 0, sizeof(Command));
+   Command.Command = VIDEO_ACCEL_UPDATE;
+   Command.DestX = prcl->left;
+   Command.DestY = prcl->top;
+   Command.Width = prcl->right - prcl->left;
+   Command.Height = prcl->bottom - prcl->top;
+
+   EngDeviceIoControl(ppdev->hDriver, IOCTL_VIDEO_ACCEL_COMMANDS,
+                      &Command, sizeof(Command), NULL, 0, &ulTemp);
+}
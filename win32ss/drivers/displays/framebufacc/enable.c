@@ -31,7 +31,10 @@ static DRVFN DrvFunctionTable[] =
    {INDEX_DrvGetModes,              (PFN)DrvGetModes},
    {INDEX_DrvSetPalette,            (PFN)DrvSetPalette},
    {INDEX_DrvSetPointerShape,   (PFN)DrvSetPointerShape},
-   {INDEX_DrvMovePointer,       (PFN)DrvMovePointer}
+   {INDEX_DrvMovePointer,       (PFN)DrvMovePointer},
+   {INDEX_DrvBitBlt,                (PFN)DrvBitBlt},
+   {INDEX_DrvCopyBits,              (PFN)DrvCopyBits},
+   {INDEX_DrvSynchronizeSurface,    (PFN)DrvSynchronizeSurface}
 
 };
 
@@ -91,6 +94,7 @@ DrvEnablePDEV(
    PPDEV ppdev;
    GDIINFO GdiInfo;
    DEVINFO DevInfo;
+   VIDEO_ACCEL_CAPS AccelCaps;
    ULONG returnedDataLength = 0;
 
    ppdev = EngAllocMem(FL_ZERO_MEMORY, sizeof(PDEV), ALLOC_TAG);
@@ -107,6 +111,25 @@ DrvEnablePDEV(
       return NULL;
    }
 
+   /* Ask the miniport for 2D acceleration, this also turns it on */
+   if (EngDeviceIoControl(ppdev->hDriver,
+                          IOCTL_VIDEO_QUERY_ACCEL_CAPS,
+                          NULL,
+                          0,
+                          &AccelCaps,
+                          sizeof(VIDEO_ACCEL_CAPS),
+                          &returnedDataLength))
+   {
+      AccelCaps.Flags = 0;
+   }
+   ppdev->AccelCaps = AccelCaps.Flags;
+
+   /* The device needs to be told about what GDI draws by itself */
+   if (ppdev->AccelCaps & VIDEO_ACCEL_UPDATE)
+   {
+      DevInfo.flGraphicsCaps2 |= GCAPS2_SYNCFLUSH;
+   }
+
    /* hw mouse pointer */
 
     ppdev->pPointerAttributes = NULL;
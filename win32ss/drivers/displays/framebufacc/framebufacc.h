@@ -27,6 +27,7 @@
 #include <winddi.h>
 #include <winioctl.h>
 #include <ntddvdeo.h>
+#include <drivers/video/vidaccel.h>
 
 
 //#define EXPERIMENTAL_ACC_SUPPORT
@@ -39,6 +40,9 @@ typedef struct _PDEV
    HSURF hSurfEng;
    ULONG dwHooks;
 
+   /* VIDEO_ACCEL_* operations the miniport can do for us */
+   ULONG AccelCaps;
+
    /* Screen Data */
    ULONG ModeIndex;
    ULONG ScreenWidth;
@@ -168,6 +172,35 @@ DrvMovePointer(
    IN LONG y,
    IN RECTL *prcl);
 
+BOOL APIENTRY
+DrvBitBlt(
+   IN SURFOBJ *psoTrg,
+   IN SURFOBJ *psoSrc,
+   IN SURFOBJ *psoMask,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclTrg,
+   IN POINTL *pptlSrc,
+   IN POINTL *pptlMask,
+   IN BRUSHOBJ *pbo,
+   IN POINTL *pptlBrush,
+   IN ROP4 rop4);
+
+BOOL APIENTRY
+DrvCopyBits(
+   OUT SURFOBJ *psoDest,
+   IN SURFOBJ *psoSrc,
+   IN CLIPOBJ *pco,
+   IN XLATEOBJ *pxlo,
+   IN RECTL *prclDest,
+   IN POINTL *pptlSrc);
+
+VOID APIENTRY
+DrvSynchronizeSurface(
+   IN SURFOBJ *pso,
+   IN RECTL *prcl,
+   IN FLONG fl);
+
 BOOL
 IntInitScreenInfo(
    PPDEV ppdev,
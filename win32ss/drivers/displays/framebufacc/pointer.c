@@ -168,13 +168,6 @@ DrvSetPointerShape(
 
     /* we goto hw mouse pointer then we contnue filling in more info */
 
-    /* calc the mouse point positions */
-    if ((x != -1) || (y != -1))
-    {
-        ppdev->pPointerAttributes->Column -= (SHORT)(ppdev->PointerHotSpot.x);
-        ppdev->pPointerAttributes->Row -= (SHORT)(ppdev->PointerHotSpot.y);
-    }
-
     /* set correct flags if it animated or need be updated anime or no flags at all */
     if (fl & SPS_ANIMATESTART)
     {
@@ -185,9 +178,10 @@ DrvSetPointerShape(
         ppdev->pPointerAttributes->Flags |= VIDEO_MODE_ANIMATE_UPDATE;
     }
 
-    ppdev->pPointerAttributes->Enable = 1;
-    ppdev->pPointerAttributes->Column = (SHORT)(x);
-    ppdev->pPointerAttributes->Row    = (SHORT)(y);
+    /* calc the mouse point positions, (-1,-1) means hidden */
+    ppdev->pPointerAttributes->Enable = (x != -1) || (y != -1);
+    ppdev->pPointerAttributes->Column = (SHORT)(x - ppdev->ScreenOffsetXY.x - ppdev->PointerHotSpot.x);
+    ppdev->pPointerAttributes->Row    = (SHORT)(y - ppdev->ScreenOffsetXY.y - ppdev->PointerHotSpot.y);
 
     /* Set the new mouse pointer shape */
     if (EngDeviceIoControl(ppdev->hDriver, IOCTL_VIDEO_SET_POINTER_ATTR, ppdev->pPointerAttributes,
@@ -219,8 +213,38 @@ BOOL
 CopyMonoPointer(PPDEV ppdev,
                 SURFOBJ *pso)
 {
-    /* FIXME unimplement */
-    return FALSE;
+    PVIDEO_POINTER_ATTRIBUTES pAttr = ppdev->pPointerAttributes;
+    ULONG cx = pso->sizlBitmap.cx;
+    ULONG cy = pso->sizlBitmap.cy / 2;
+    ULONG cjLine = (cx + 7) / 8;
+    ULONG i, iLine;
+    PBYTE pjSrc, pjDst;
+
+    /* The mask holds the AND mask on top of the XOR mask */
+    if ((pso->iBitmapFormat != BMF_1BPP) ||
+        (cx > ppdev->PointerCapabilities.MaxWidth) ||
+        (cy > ppdev->PointerCapabilities.MaxHeight))
+    {
+        return FALSE;
+    }
+
+    pAttr->Flags = VIDEO_MODE_MONO_POINTER;
+    pAttr->Width = cx;
+    pAttr->Height = cy;
+    pAttr->WidthInBytes = cjLine;
+
+    pjDst = pAttr->Pixels;
+    for (i = 0; i < 2; i++)
+    {
+        for (iLine = 0; iLine < cy; iLine++)
+        {
+            pjSrc = (PBYTE)pso->pvScan0 + (LONG)(i * cy + iLine) * pso->lDelta;
+            memcpy(pjDst, pjSrc, cjLine);
+            pjDst += cjLine;
+        }
+    }
+
+    return TRUE;
 }
 
 
@@ -100,10 +100,10 @@ InitSurface(PPDEV ppdev,
 
    /* hw mouse pointer support */
    PointerMaxHeight = ppdev->PointerCapabilities.MaxHeight;
-   PointerMaxWidth = ppdev->PointerCapabilities.MaxWidth * sizeof(ULONG);
+   PointerMaxWidth = (ppdev->PointerCapabilities.MaxWidth + 7) / 8;
    if (ppdev->PointerCapabilities.Flags & VIDEO_MODE_COLOR_POINTER)
    {
-        PointerMaxWidth = (ppdev->PointerCapabilities.MaxWidth + 7) / 8;
+        PointerMaxWidth = ppdev->PointerCapabilities.MaxWidth * sizeof(ULONG);
    }
 
    ppdev->PointerAttributesSize = sizeof(VIDEO_POINTER_ATTRIBUTES) + ((sizeof(UCHAR) * PointerMaxWidth * PointerMaxHeight) << 1);
@@ -196,8 +196,12 @@ DrvEnableSurface(
       return FALSE;
    }
 
-   /* Which api we hooking to */
-   ppdev->dwHooks = HOOK_BITBLT | HOOK_COPYBITS | HOOK_FILLPATH | HOOK_TEXTOUT | HOOK_STROKEPATH | HOOK_LINETO ;
+   /* Which api we hooking to, only blits can go to the accelerator */
+   ppdev->dwHooks = 0;
+   if (ppdev->AccelCaps & (VIDEO_ACCEL_RECT_FILL | VIDEO_ACCEL_RECT_COPY))
+   {
+      ppdev->dwHooks = HOOK_BITBLT | HOOK_COPYBITS;
+   }
 
    /*
     * Associate the surface with our device.
@@ -10,6 +10,7 @@
 #include <dderror.h>
 #include <miniport.h>
 #include <video.h>
+#include <drivers/video/vidaccel.h>
 #include "vmx_regs.h"
 
 typedef struct _HW_DEVICE_EXTENSION
@@ -23,6 +24,8 @@ typedef struct _HW_DEVICE_EXTENSION
     PULONG ValuePort;
     PVOID FrameBufferBase;
     PVOID Fifo;
+    ULONG FifoSize;
+    BOOLEAN FifoEnabled;
     ULONG InterruptPort;
     ULONG InterruptState;
     PENG_EVENT SyncEvent;
@@ -33,4 +36,6 @@ typedef struct _HW_DEVICE_EXTENSION
     USHORT DisplayIndex;
     ULONG YOrigin;
     ULONG XOrigin;
+    VIDEO_POINTER_POSITION CursorPosition;
+    BOOLEAN CursorDefined;
 } HW_DEVICE_EXTENSION, *PHW_DEVICE_EXTENSION;
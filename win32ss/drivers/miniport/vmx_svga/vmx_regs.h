@@ -128,3 +128,32 @@ typedef enum _VMX_SVGA_REGISTERS
     SVGA_REG_DISPLAY_HEIGHT,
     SVGA_REG_TOP,
 } VMX_SVGA_REGISTERS;
+
+//
+// FIFO Registers, in ULONGs from the start of the FIFO memory
+//
+typedef enum _VMX_SVGA_FIFO_REGISTERS
+{
+    SVGA_FIFO_MIN,
+    SVGA_FIFO_MAX,
+    SVGA_FIFO_NEXT_CMD,
+    SVGA_FIFO_STOP,
+    SVGA_FIFO_NUM_REGS
+} VMX_SVGA_FIFO_REGISTERS;
+
+//
+// FIFO Commands
+//
+#define SVGA_CMD_UPDATE             1
+#define SVGA_CMD_RECT_FILL          2
+#define SVGA_CMD_RECT_COPY          3
+#define SVGA_CMD_DEFINE_CURSOR      19
+
+//
+// Hardware Cursor
+//
+#define SVGA_CURSOR_ID              0
+#define SVGA_CURSOR_MAX_WIDTH       64
+#define SVGA_CURSOR_MAX_HEIGHT      64
+#define SVGA_CURSOR_ON_HIDE         0
+#define SVGA_CURSOR_ON_SHOW         1
@@ -39,6 +39,235 @@ VmxWriteUlong(IN PHW_DEVICE_EXTENSION DeviceExtension,
     VideoPortWritePortUlong(DeviceExtension->ValuePort, Value);
 }
 
+VOID
+NTAPI
+VmxSyncFifo(IN PHW_DEVICE_EXTENSION DeviceExtension)
+{
+    /* Ask the host to drain the FIFO and wait until it has done so */
+    VmxWriteUlong(DeviceExtension, SVGA_REG_SYNC, 1);
+    while (VmxReadUlong(DeviceExtension, SVGA_REG_BUSY));
+}
+
+VOID
+NTAPI
+VmxWriteFifo(IN PHW_DEVICE_EXTENSION DeviceExtension,
+             IN ULONG Value)
+{
+    volatile ULONG *Fifo = DeviceExtension->Fifo;
+    ULONG NextCmd = Fifo[SVGA_FIFO_NEXT_CMD];
+
+    /* If the FIFO is full, let the host catch up first */
+    if ((NextCmd + sizeof(ULONG) == Fifo[SVGA_FIFO_STOP]) ||
+        ((Fifo[SVGA_FIFO_STOP] == Fifo[SVGA_FIFO_MIN]) &&
+         (NextCmd + sizeof(ULONG) == Fifo[SVGA_FIFO_MAX])))
+    {
+        VmxSyncFifo(DeviceExtension);
+    }
+
+    /* Store the value and advance the pointer, wrapping at the end */
+    Fifo[NextCmd / sizeof(ULONG)] = Value;
+    NextCmd += sizeof(ULONG);
+    if (NextCmd == Fifo[SVGA_FIFO_MAX]) NextCmd = Fifo[SVGA_FIFO_MIN];
+    Fifo[SVGA_FIFO_NEXT_CMD] = NextCmd;
+}
+
+BOOLEAN
+NTAPI
+VmxInitFifo(IN PHW_DEVICE_EXTENSION DeviceExtension)
+{
+    PHYSICAL_ADDRESS FifoBase;
+    volatile ULONG *Fifo;
+
+    /* Get the location and size of the command FIFO */
+    FifoBase.QuadPart = VmxReadUlong(DeviceExtension, SVGA_REG_MEM_START);
+    DeviceExtension->FifoSize = VmxReadUlong(DeviceExtension, SVGA_REG_MEM_SIZE);
+    if (DeviceExtension->FifoSize < SVGA_FIFO_NUM_REGS * sizeof(ULONG) * 2)
+    {
+        DPRINT1("FIFO too small: %lx\n", DeviceExtension->FifoSize);
+        return FALSE;
+    }
+
+    /* Map it */
+    DeviceExtension->Fifo = VideoPortGetDeviceBase(DeviceExtension,
+                                                   FifoBase,
+                                                   DeviceExtension->FifoSize,
+                                                   VIDEO_MEMORY_SPACE_MEMORY);
+    if (!DeviceExtension->Fifo) return FALSE;
+
+    /* Commands start right after the FIFO registers */
+    Fifo = DeviceExtension->Fifo;
+    Fifo[SVGA_FIFO_MIN] = SVGA_FIFO_NUM_REGS * sizeof(ULONG);
+    Fifo[SVGA_FIFO_MAX] = DeviceExtension->FifoSize & ~(sizeof(ULONG) - 1);
+    Fifo[SVGA_FIFO_NEXT_CMD] = Fifo[SVGA_FIFO_MIN];
+    Fifo[SVGA_FIFO_STOP] = Fifo[SVGA_FIFO_MIN];
+    return TRUE;
+}
+
+VOID
+NTAPI
+VmxEnableFifo(IN PHW_DEVICE_EXTENSION DeviceExtension)
+{
+    /*
+     * Once the FIFO is on, the host stops scanning the frame buffer by
+     * itself and relies on update commands. Only turn it on for display
+     * drivers that asked for acceleration and thus know about this.
+     */
+    if (!DeviceExtension->Fifo || DeviceExtension->FifoEnabled) return;
+
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CONFIG_DONE, 1);
+    DeviceExtension->FifoEnabled = TRUE;
+}
+
+ULONG
+NTAPI
+VmxGetAccelCaps(IN PHW_DEVICE_EXTENSION DeviceExtension)
+{
+    ULONG Flags;
+
+    /* Nothing without a FIFO */
+    if (!DeviceExtension->FifoEnabled) return 0;
+
+    /* Updates always work, the rest depends on the host */
+    Flags = VIDEO_ACCEL_UPDATE;
+    if (DeviceExtension->Capabilities & SVGA_CAP_RECT_FILL) Flags |= VIDEO_ACCEL_RECT_FILL;
+    if (DeviceExtension->Capabilities & SVGA_CAP_RECT_COPY) Flags |= VIDEO_ACCEL_RECT_COPY;
+    return Flags;
+}
+
+VP_STATUS
+NTAPI
+VmxAccelCommands(IN PHW_DEVICE_EXTENSION DeviceExtension,
+                 IN PVIDEO_ACCEL_COMMAND Commands,
+                 IN ULONG Count)
+{
+    ULONG i, Caps;
+
+    /* Validate everything first, so that we never send half a request */
+    Caps = VmxGetAccelCaps(DeviceExtension);
+    for (i = 0; i < Count; i++)
+    {
+        if (!(Commands[i].Command & Caps)) return ERROR_INVALID_PARAMETER;
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        switch (Commands[i].Command)
+        {
+            case VIDEO_ACCEL_UPDATE:
+                VmxWriteFifo(DeviceExtension, SVGA_CMD_UPDATE);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestX);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestY);
+                VmxWriteFifo(DeviceExtension, Commands[i].Width);
+                VmxWriteFifo(DeviceExtension, Commands[i].Height);
+                break;
+
+            case VIDEO_ACCEL_RECT_FILL:
+                VmxWriteFifo(DeviceExtension, SVGA_CMD_RECT_FILL);
+                VmxWriteFifo(DeviceExtension, Commands[i].Color);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestX);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestY);
+                VmxWriteFifo(DeviceExtension, Commands[i].Width);
+                VmxWriteFifo(DeviceExtension, Commands[i].Height);
+                break;
+
+            case VIDEO_ACCEL_RECT_COPY:
+                VmxWriteFifo(DeviceExtension, SVGA_CMD_RECT_COPY);
+                VmxWriteFifo(DeviceExtension, Commands[i].SrcX);
+                VmxWriteFifo(DeviceExtension, Commands[i].SrcY);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestX);
+                VmxWriteFifo(DeviceExtension, Commands[i].DestY);
+                VmxWriteFifo(DeviceExtension, Commands[i].Width);
+                VmxWriteFifo(DeviceExtension, Commands[i].Height);
+                break;
+        }
+    }
+
+    /* The display driver draws into the frame buffer right after this */
+    if (Count) VmxSyncFifo(DeviceExtension);
+    return NO_ERROR;
+}
+
+VP_STATUS
+NTAPI
+VmxSetPointerAttributes(IN PHW_DEVICE_EXTENSION DeviceExtension,
+                        IN PVIDEO_POINTER_ATTRIBUTES Attributes,
+                        IN ULONG Length)
+{
+    ULONG MaskSize, Line, i, j, Dwords;
+    ULONG Scanline[SVGA_CURSOR_MAX_WIDTH / 32];
+
+    /* We only do monochrome pointers through the FIFO */
+    if (!(DeviceExtension->Capabilities & SVGA_CAP_CURSOR) ||
+        !(DeviceExtension->Capabilities & SVGA_CAP_CURSOR_BYPASS) ||
+        !(DeviceExtension->FifoEnabled) ||
+        !(Attributes->Flags & VIDEO_MODE_MONO_POINTER) ||
+        (Attributes->Width > SVGA_CURSOR_MAX_WIDTH) ||
+        (Attributes->Height > SVGA_CURSOR_MAX_HEIGHT) ||
+        (Attributes->WidthInBytes < (Attributes->Width + 7) / 8))
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    /* The AND mask is followed by the XOR mask */
+    MaskSize = Attributes->WidthInBytes * Attributes->Height;
+    if (Length < FIELD_OFFSET(VIDEO_POINTER_ATTRIBUTES, Pixels) + 2 * MaskSize)
+    {
+        return ERROR_INSUFFICIENT_BUFFER;
+    }
+
+    /* Define the cursor, the host wants each scanline padded to a ULONG */
+    Dwords = (Attributes->Width + 31) / 32;
+    VmxWriteFifo(DeviceExtension, SVGA_CMD_DEFINE_CURSOR);
+    VmxWriteFifo(DeviceExtension, SVGA_CURSOR_ID);
+    VmxWriteFifo(DeviceExtension, 0);
+    VmxWriteFifo(DeviceExtension, 0);
+    VmxWriteFifo(DeviceExtension, Attributes->Width);
+    VmxWriteFifo(DeviceExtension, Attributes->Height);
+    VmxWriteFifo(DeviceExtension, 1);
+    VmxWriteFifo(DeviceExtension, 1);
+    for (i = 0; i < 2; i++)
+    {
+        for (Line = 0; Line < Attributes->Height; Line++)
+        {
+            VideoPortZeroMemory(Scanline, sizeof(Scanline));
+            VideoPortMoveMemory(Scanline,
+                                &Attributes->Pixels[i * MaskSize +
+                                                    Line * Attributes->WidthInBytes],
+                                (Attributes->Width + 7) / 8);
+            for (j = 0; j < Dwords; j++) VmxWriteFifo(DeviceExtension, Scanline[j]);
+        }
+    }
+
+    /* Hotspot is already applied to the position by the display driver */
+    DeviceExtension->CursorDefined = TRUE;
+    DeviceExtension->CursorPosition.Column = Attributes->Column;
+    DeviceExtension->CursorPosition.Row = Attributes->Row;
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_ID, SVGA_CURSOR_ID);
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_X, Attributes->Column);
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_Y, Attributes->Row);
+    VmxWriteUlong(DeviceExtension,
+                  SVGA_REG_CURSOR_ON,
+                  Attributes->Enable ? SVGA_CURSOR_ON_SHOW : SVGA_CURSOR_ON_HIDE);
+    return NO_ERROR;
+}
+
+VP_STATUS
+NTAPI
+VmxShowPointer(IN PHW_DEVICE_EXTENSION DeviceExtension,
+               IN BOOLEAN Show)
+{
+    /* Nothing to show until a shape was defined */
+    if (!DeviceExtension->CursorDefined) return ERROR_INVALID_FUNCTION;
+
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_ID, SVGA_CURSOR_ID);
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_X, DeviceExtension->CursorPosition.Column);
+    VmxWriteUlong(DeviceExtension, SVGA_REG_CURSOR_Y, DeviceExtension->CursorPosition.Row);
+    VmxWriteUlong(DeviceExtension,
+                  SVGA_REG_CURSOR_ON,
+                  Show ? SVGA_CURSOR_ON_SHOW : SVGA_CURSOR_ON_HIDE);
+    return NO_ERROR;
+}
+
 ULONG
 NTAPI
 VmxInitModes(IN PHW_DEVICE_EXTENSION DeviceExtension)
@@ -170,8 +399,15 @@ BOOLEAN
 NTAPI
 VmxInitialize(IN PVOID HwDeviceExtension)
 {
-    UNIMPLEMENTED;
-    while (TRUE);
+    PHW_DEVICE_EXTENSION DeviceExtension = HwDeviceExtension;
+
+    /* Without a FIFO we still work as a plain frame buffer */
+    if (!VmxInitFifo(DeviceExtension))
+    {
+        DPRINT1("No command FIFO, acceleration disabled\n");
+        DeviceExtension->Fifo = NULL;
+    }
+
     return TRUE;
 }
 
@@ -180,8 +416,101 @@ NTAPI
 VmxStartIO(IN PVOID HwDeviceExtension,
            IN PVIDEO_REQUEST_PACKET RequestPacket)
 {
-    UNIMPLEMENTED;
-    while (TRUE);
+    PHW_DEVICE_EXTENSION DeviceExtension = HwDeviceExtension;
+    VP_STATUS Status;
+
+    RequestPacket->StatusBlock->Information = 0;
+
+    switch (RequestPacket->IoControlCode)
+    {
+        case IOCTL_VIDEO_QUERY_ACCEL_CAPS:
+            if (RequestPacket->OutputBufferLength < sizeof(VIDEO_ACCEL_CAPS))
+            {
+                Status = ERROR_INSUFFICIENT_BUFFER;
+                break;
+            }
+            VmxEnableFifo(DeviceExtension);
+            ((PVIDEO_ACCEL_CAPS)RequestPacket->OutputBuffer)->Flags =
+                VmxGetAccelCaps(DeviceExtension);
+            RequestPacket->StatusBlock->Information = sizeof(VIDEO_ACCEL_CAPS);
+            Status = NO_ERROR;
+            break;
+
+        case IOCTL_VIDEO_ACCEL_COMMANDS:
+            if ((RequestPacket->InputBufferLength % sizeof(VIDEO_ACCEL_COMMAND)) ||
+                (RequestPacket->InputBufferLength >
+                 VIDEO_ACCEL_MAX_COMMANDS * sizeof(VIDEO_ACCEL_COMMAND)))
+            {
+                Status = ERROR_INVALID_PARAMETER;
+                break;
+            }
+            Status = VmxAccelCommands(DeviceExtension,
+                                      RequestPacket->InputBuffer,
+                                      RequestPacket->InputBufferLength /
+                                      sizeof(VIDEO_ACCEL_COMMAND));
+            break;
+
+        case IOCTL_VIDEO_QUERY_POINTER_CAPABILITIES:
+        {
+            PVIDEO_POINTER_CAPABILITIES PointerCaps;
+
+            if (RequestPacket->OutputBufferLength < sizeof(VIDEO_POINTER_CAPABILITIES))
+            {
+                Status = ERROR_INSUFFICIENT_BUFFER;
+                break;
+            }
+            PointerCaps = RequestPacket->OutputBuffer;
+            VideoPortZeroMemory(PointerCaps, sizeof(VIDEO_POINTER_CAPABILITIES));
+            if ((DeviceExtension->Capabilities & SVGA_CAP_CURSOR) &&
+                (DeviceExtension->Capabilities & SVGA_CAP_CURSOR_BYPASS) &&
+                (DeviceExtension->FifoEnabled))
+            {
+                PointerCaps->Flags = VIDEO_MODE_ASYNC_POINTER | VIDEO_MODE_MONO_POINTER;
+                PointerCaps->MaxWidth = SVGA_CURSOR_MAX_WIDTH;
+                PointerCaps->MaxHeight = SVGA_CURSOR_MAX_HEIGHT;
+            }
+            RequestPacket->StatusBlock->Information = sizeof(VIDEO_POINTER_CAPABILITIES);
+            Status = NO_ERROR;
+            break;
+        }
+
+        case IOCTL_VIDEO_SET_POINTER_ATTR:
+            if (RequestPacket->InputBufferLength < sizeof(VIDEO_POINTER_ATTRIBUTES))
+            {
+                Status = ERROR_INSUFFICIENT_BUFFER;
+                break;
+            }
+            Status = VmxSetPointerAttributes(DeviceExtension,
+                                             RequestPacket->InputBuffer,
+                                             RequestPacket->InputBufferLength);
+            break;
+
+        case IOCTL_VIDEO_SET_POINTER_POSITION:
+            if (RequestPacket->InputBufferLength < sizeof(VIDEO_POINTER_POSITION))
+            {
+                Status = ERROR_INSUFFICIENT_BUFFER;
+                break;
+            }
+            DeviceExtension->CursorPosition =
+                *(PVIDEO_POINTER_POSITION)RequestPacket->InputBuffer;
+            Status = VmxShowPointer(DeviceExtension, TRUE);
+            break;
+
+        case IOCTL_VIDEO_ENABLE_POINTER:
+            Status = VmxShowPointer(DeviceExtension, TRUE);
+            break;
+
+        case IOCTL_VIDEO_DISABLE_POINTER:
+            Status = VmxShowPointer(DeviceExtension, FALSE);
+            break;
+
+        default:
+            DPRINT1("Unhandled IOCTL %lx\n", RequestPacket->IoControlCode);
+            Status = ERROR_INVALID_FUNCTION;
+            break;
+    }
+
+    RequestPacket->StatusBlock->Status = Status;
     return TRUE;
 }
 
@@ -209,16 +209,10 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest, *SourceBits);
-        SourceBits += 1;
-        DestBits += 2;
-      }
+      EXLATEOBJ_vXlateLine8to16(BltInfo->XlateSourceToDest,
+                                (PUSHORT)DestLine,
+                                SourceLine,
+                                BltInfo->DestRect.right - BltInfo->DestRect.left);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -283,17 +277,10 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         DestLine = DestBits;
         for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
         {
-          SourceBits = SourceLine;
-          DestBits = DestLine;
-          for (i = BltInfo->DestRect.left; i <
-            BltInfo->DestRect.right; i++)
-          {
-            *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-              BltInfo->XlateSourceToDest,
-              *((WORD *)SourceBits));
-            SourceBits += 2;
-            DestBits += 2;
-          }
+          EXLATEOBJ_vXlateLine16to16(BltInfo->XlateSourceToDest,
+                                     (PUSHORT)DestLine,
+                                     (PUSHORT)SourceLine,
+                                     BltInfo->DestRect.right - BltInfo->DestRect.left);
           SourceLine += BltInfo->SourceSurface->lDelta;
           DestLine += BltInfo->DestSurface->lDelta;
         }
@@ -315,17 +302,10 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         for (j = BltInfo->DestRect.bottom - 1;
           BltInfo->DestRect.top <= j; j--)
         {
-          SourceBits = SourceLine;
-          DestBits = DestLine;
-          for (i = BltInfo->DestRect.left; i <
-            BltInfo->DestRect.right; i++)
-          {
-            *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-              BltInfo->XlateSourceToDest,
-              *((WORD *)SourceBits));
-            SourceBits += 2;
-            DestBits += 2;
-          }
+          EXLATEOBJ_vXlateLine16to16(BltInfo->XlateSourceToDest,
+                                     (PUSHORT)DestLine,
+                                     (PUSHORT)SourceLine,
+                                     BltInfo->DestRect.right - BltInfo->DestRect.left);
           SourceLine -= BltInfo->SourceSurface->lDelta;
           DestLine -= BltInfo->DestSurface->lDelta;
         }
@@ -370,17 +350,10 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest,
-          *((PDWORD) SourceBits));
-        SourceBits += 4;
-        DestBits += 2;
-      }
+      EXLATEOBJ_vXlateLine32to16(BltInfo->XlateSourceToDest,
+                                 (PUSHORT)DestLine,
+                                 (PULONG)SourceLine,
+                                 BltInfo->DestRect.right - BltInfo->DestRect.left);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -117,16 +117,10 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        xColor = *SourceBits;
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 1;
-        DestBits += 4;
-      }
+      EXLATEOBJ_vXlateLine8to32(BltInfo->XlateSourceToDest,
+                                (PULONG)DestLine,
+                                SourceLine,
+                                BltInfo->DestRect.right - BltInfo->DestRect.left);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -139,16 +133,10 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        xColor = *((PWORD) SourceBits);
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 2;
-        DestBits += 4;
-      }
+      EXLATEOBJ_vXlateLine16to32(BltInfo->XlateSourceToDest,
+                                 (PULONG)DestLine,
+                                 (PUSHORT)SourceLine,
+                                 BltInfo->DestRect.right - BltInfo->DestRect.left);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -218,14 +206,13 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         SourceBits = ((PBYTE)BltInfo->SourceSurface->pvScan0 + (BltInfo->SourcePoint.y * BltInfo->SourceSurface->lDelta) + 4 * BltInfo->SourcePoint.x);
         for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
         {
-          if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
+          if ((BltInfo->DestRect.left < BltInfo->SourcePoint.x) ||
+              (BltInfo->SourceSurface != BltInfo->DestSurface))
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            EXLATEOBJ_vXlateLine32to32(BltInfo->XlateSourceToDest,
+                                       (PULONG)DestBits,
+                                       (PULONG)SourceBits,
+                                       BltInfo->DestRect.right - BltInfo->DestRect.left);
           }
           else
           {
@@ -246,14 +233,13 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         DestBits = (PBYTE)BltInfo->DestSurface->pvScan0 + ((BltInfo->DestRect.bottom - 1) * BltInfo->DestSurface->lDelta) + 4 * BltInfo->DestRect.left;
         for (j = BltInfo->DestRect.bottom - 1; BltInfo->DestRect.top <= j; j--)
         {
-          if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
+          if ((BltInfo->DestRect.left < BltInfo->SourcePoint.x) ||
+              (BltInfo->SourceSurface != BltInfo->DestSurface))
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            EXLATEOBJ_vXlateLine32to32(BltInfo->XlateSourceToDest,
+                                       (PULONG)DestBits,
+                                       (PULONG)SourceBits,
+                                       BltInfo->DestRect.right - BltInfo->DestRect.left);
           }
           else
           {
@@ -341,6 +327,42 @@ Clamp8(ULONG val)
   return (val > 255) ? 255 : (UCHAR)val;
 }
 
+/*
+ * These work on the four channels at once, two of them in every 16 bit half
+ * of a ULONG, and give the same results as the per channel code below:
+ * (x + 1 + (x >> 8)) >> 8 is x / 255 for every product of two bytes.
+ */
+#define ALPHA_MASK_RB 0x00FF00FF
+
+static __inline ULONG
+AlphaScale32(ULONG Pixel, ULONG Alpha)
+{
+  ULONG rb = (Pixel & ALPHA_MASK_RB) * Alpha;
+  ULONG ag = ((Pixel >> 8) & ALPHA_MASK_RB) * Alpha;
+
+  rb = ((rb + 0x00010001 + ((rb >> 8) & ALPHA_MASK_RB)) >> 8) & ALPHA_MASK_RB;
+  ag = (ag + 0x00010001 + ((ag >> 8) & ALPHA_MASK_RB)) & ~ALPHA_MASK_RB;
+  return rb | ag;
+}
+
+static __inline ULONG
+AlphaBlend32(ULONG Dst, ULONG Src, ULONG Alpha)
+{
+  ULONG rb, ag, Carry;
+
+  Dst = AlphaScale32(Dst, 255 - Alpha);
+  rb = (Dst & ALPHA_MASK_RB) + (Src & ALPHA_MASK_RB);
+  ag = ((Dst >> 8) & ALPHA_MASK_RB) + ((Src >> 8) & ALPHA_MASK_RB);
+
+  /* Saturate the channels that went over 255 */
+  Carry = rb & 0x01000100;
+  rb = (rb | (Carry - (Carry >> 8))) & ALPHA_MASK_RB;
+  Carry = ag & 0x01000100;
+  ag = (ag | (Carry - (Carry >> 8))) & ALPHA_MASK_RB;
+
+  return rb | (ag << 8);
+}
+
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -348,6 +370,7 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
 {
   INT Rows, Cols, SrcX, SrcY;
   register PULONG Dst;
+  PULONG Src;
   BLENDFUNCTION BlendFunc;
   register NICEPIXEL32 DstPixel, SrcPixel;
   UCHAR Alpha, SrcBpp;
@@ -383,6 +406,39 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
+  /* The usual case of an unstretched 32bpp source can skip the pixel callbacks */
+  if (SrcBpp == 32 &&
+      DestRect->right - DestRect->left == SourceRect->right - SourceRect->left &&
+      DestRect->bottom - DestRect->top == SourceRect->bottom - SourceRect->top &&
+      (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL) != 0))
+  {
+    Src = (PULONG)((ULONG_PTR)Source->pvScan0 + (SourceRect->top * Source->lDelta) +
+      (SourceRect->left << 2));
+
+    for (Rows = DestRect->top; Rows < DestRect->bottom; Rows++)
+    {
+      for (Cols = 0; Cols < DestRect->right - DestRect->left; Cols++)
+      {
+        SrcPixel.ul = Src[Cols];
+        if (BlendFunc.SourceConstantAlpha != 255)
+          SrcPixel.ul = AlphaScale32(SrcPixel.ul, BlendFunc.SourceConstantAlpha);
+
+        Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
+             SrcPixel.col.alpha : BlendFunc.SourceConstantAlpha;
+
+        /* Opaque pixels replace the destination, empty ones leave it alone */
+        if (Alpha == 255)
+          Dst[Cols] = SrcPixel.ul;
+        else if (Alpha != 0 || SrcPixel.ul != 0)
+          Dst[Cols] = AlphaBlend32(Dst[Cols], SrcPixel.ul, Alpha);
+      }
+      Src = (PULONG)((ULONG_PTR)Src + Source->lDelta);
+      Dst = (PULONG)((ULONG_PTR)Dst + Dest->lDelta);
+    }
+
+    return TRUE;
+  }
+
   Rows = 0;
    SrcY = SourceRect->top;
    while (++Rows <= DestRect->bottom - DestRect->top)
@@ -169,6 +169,8 @@ IntHideMousePointer(
     ptlSave.x = rclDest.left - pt.x;
     ptlSave.y = rclDest.top - pt.y;
 
+    PDEVOBJ_vAddDirtyRect(ppdev, &rclDest);
+
     IntEngBitBlt(psoDest,
                  &pgp->psurfSave->SurfObj,
                  NULL,
@@ -223,6 +225,8 @@ IntShowMousePointer(
     rclPointer.right = min(pgp->Size.cx, psoDest->sizlBitmap.cx - pt.x);
     rclPointer.bottom = min(pgp->Size.cy, psoDest->sizlBitmap.cy - pt.y);
 
+    PDEVOBJ_vAddDirtyRect(ppdev, &rclSurf);
+
     /* Copy the pixels under the cursor to temporary surface. */
     IntEngBitBlt(&pgp->psurfSave->SurfObj,
                  psoDest,
@@ -753,6 +757,8 @@ GreSetPointerShape(
     if (psurfMask)
         SURFACE_ShareUnlockSurface(psurfMask);
 
+    PDEVOBJ_vFlushDirtyRects(pdc->ppdev);
+
     EngReleaseSemaphore(pdc->ppdev->hsemDevLock);
 
     /* Unlock the DC */
@@ -794,6 +800,9 @@ GreMovePointer(
         pdc->ppdev->pfnMovePointer(&pdc->ppdev->pSurface->SurfObj, x, y, prcl);
     }
 
+    /* The pointer moves without any painting, push it out right away */
+    PDEVOBJ_vFlushDirtyRects(pdc->ppdev);
+
     /* Release PDEV lock */
     EngReleaseSemaphore(pdc->ppdev->hsemDevLock);
 
@@ -480,6 +480,9 @@ PDEVOBJ_vSwitchPdev(
     ppdev->pSurface->SurfObj.hdev = (HDEV)ppdev;
     ppdev2->pSurface->SurfObj.hdev = (HDEV)ppdev2;
 
+    /* Pending damage belongs to the old surface, the new one gets repainted */
+    ppdev->cDirtyRects = 0;
+
     /* Exchange devinfo */
     temp.devinfo = ppdev->devinfo;
     ppdev->devinfo = ppdev2->devinfo;
@@ -988,3 +991,103 @@ PDEVOBJ_sizl(PPDEVOBJ ppdev, PSIZEL psizl)
     }
     return psizl;
 }
+
+/*
+ * Drivers that keep the primary surface in system memory and set
+ * GCAPS2_SYNCFLUSH need to know which parts of it changed. Collect the
+ * destination rectangles of the drawing operations here and merge them into
+ * a few dirty rectangles, so that the driver can push them to the screen in
+ * one go when PDEVOBJ_vFlushDirtyRects is called.
+ */
+_Requires_lock_held_(*ppdev->hsemDevLock)
+VOID
+NTAPI
+PDEVOBJ_vAddDirtyRect(
+    _Inout_ PPDEVOBJ ppdev,
+    _In_ const RECTL *prcl)
+{
+    RECTL rcl, rclUnion;
+    SIZEL sizl;
+    ULONG i, iBest = 0;
+    ULONGLONG ullGrowth, ullBest = MAXULONGLONG;
+
+    if (!(ppdev->devinfo.flGraphicsCaps2 & GCAPS2_SYNCFLUSH) ||
+        !ppdev->pfn.SynchronizeSurface)
+    {
+        return;
+    }
+
+    rcl = *prcl;
+    RECTL_vMakeWellOrdered(&rcl);
+    if (!RECTL_bClipRectBySize(&rcl, &rcl, PDEVOBJ_sizl(ppdev, &sizl)))
+        return;
+
+    /* Grow a rectangle that overlaps or touches the new one */
+    for (i = 0; i < ppdev->cDirtyRects; i++)
+    {
+        if (rcl.left <= ppdev->arclDirty[i].right &&
+            rcl.right >= ppdev->arclDirty[i].left &&
+            rcl.top <= ppdev->arclDirty[i].bottom &&
+            rcl.bottom >= ppdev->arclDirty[i].top)
+        {
+            RECTL_bUnionRect(&ppdev->arclDirty[i], &ppdev->arclDirty[i], &rcl);
+            return;
+        }
+    }
+
+    if (ppdev->cDirtyRects < PDEV_MAX_DIRTY_RECTS)
+    {
+        ppdev->arclDirty[ppdev->cDirtyRects++] = rcl;
+        return;
+    }
+
+    /* All slots are used, merge into the one that grows the least */
+    for (i = 0; i < PDEV_MAX_DIRTY_RECTS; i++)
+    {
+        RECTL_bUnionRect(&rclUnion, &ppdev->arclDirty[i], &rcl);
+        ullGrowth = (ULONGLONG)(rclUnion.right - rclUnion.left) *
+                    (rclUnion.bottom - rclUnion.top) -
+                    (ULONGLONG)(ppdev->arclDirty[i].right - ppdev->arclDirty[i].left) *
+                    (ppdev->arclDirty[i].bottom - ppdev->arclDirty[i].top);
+        if (ullGrowth < ullBest)
+        {
+            ullBest = ullGrowth;
+            iBest = i;
+        }
+    }
+
+    RECTL_bUnionRect(&ppdev->arclDirty[iBest], &ppdev->arclDirty[iBest], &rcl);
+}
+
+/*
+ * Hand the collected damage to the driver with DSS_FLUSH_EVENT and start
+ * over. Called once per batch / message loop iteration rather than after
+ * every drawing operation.
+ */
+VOID
+NTAPI
+PDEVOBJ_vFlushDirtyRects(
+    _Inout_ PPDEVOBJ ppdev)
+{
+    ULONG i;
+
+    /* Unlocked peek, a racing add will be picked up by the next flush */
+    if (ppdev->cDirtyRects == 0)
+        return;
+
+    EngAcquireSemaphore(ppdev->hsemDevLock);
+
+    if (ppdev->pSurface && ppdev->pfn.SynchronizeSurface)
+    {
+        for (i = 0; i < ppdev->cDirtyRects; i++)
+        {
+            ppdev->pfn.SynchronizeSurface(&ppdev->pSurface->SurfObj,
+                                          &ppdev->arclDirty[i],
+                                          DSS_FLUSH_EVENT);
+        }
+    }
+
+    ppdev->cDirtyRects = 0;
+
+    EngReleaseSemaphore(ppdev->hsemDevLock);
+}
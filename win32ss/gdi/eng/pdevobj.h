@@ -78,6 +78,9 @@ typedef struct _GRAPHICS_DEVICE
     ULONG            iCurrentMode;
 } GRAPHICS_DEVICE, *PGRAPHICS_DEVICE;
 
+/* Number of separate dirty rectangles kept before they get merged */
+#define PDEV_MAX_DIRTY_RECTS 4
+
 typedef struct _PDEVOBJ
 {
     BASEOBJECT                BaseObject;
@@ -147,6 +150,9 @@ typedef struct _PDEVOBJ
     UINT SafetyRemoveLevel; /* at what level was the cursor removed?
                               0 for not removed */
     UINT SafetyRemoveCount;
+    /* Damage not yet pushed to a GCAPS2_SYNCFLUSH driver */
+    ULONG cDirtyRects;
+    RECTL arclDirty[PDEV_MAX_DIRTY_RECTS];
     struct _EDD_DIRECTDRAW_GLOBAL * pEDDgpl;
 } PDEVOBJ, *PPDEVOBJ;
 
@@ -219,4 +225,16 @@ PDEVOBJ_pdmMatchDevMode(
     PPDEVOBJ ppdev,
     PDEVMODEW pdm);
 
+_Requires_lock_held_(*ppdev->hsemDevLock)
+VOID
+NTAPI
+PDEVOBJ_vAddDirtyRect(
+    _Inout_ PPDEVOBJ ppdev,
+    _In_ const RECTL *prcl);
+
+VOID
+NTAPI
+PDEVOBJ_vFlushDirtyRects(
+    _Inout_ PPDEVOBJ ppdev);
+
 #endif /* !__WIN32K_PDEVOBJ_H */
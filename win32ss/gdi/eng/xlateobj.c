@@ -656,6 +656,161 @@ EXLATEOBJ_vCleanup(
     pexlo->xlo.pulXlate = pexlo->aulXlate;
 }
 
+/*
+ * Scanline translation for the DIB blitters. The conversions that matter
+ * are picked once per line and expanded inline here, instead of an
+ * indirect call through XLATEOBJ_iXlate for every pixel. This is plain
+ * integer code: the kernel mode callers can't use the FPU or SSE state
+ * without saving it first, which would cost more than it saves.
+ */
+
+#define XLATE_LINE(pfnXlate) \
+    for (i = 0; i < cPixels; i++) \
+        pDst[i] = pfnXlate(pexlo, pSrc[i])
+
+#define XLATE_LINE_DEFAULT() \
+    for (i = 0; i < cPixels; i++) \
+        pDst[i] = pexlo->pfnXlate(pexlo, pSrc[i])
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine8to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pDst,
+    _In_reads_(cPixels) const UCHAR *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        XLATE_LINE(EXLATEOBJ_iXlateTrivial);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateTable)
+        XLATE_LINE(EXLATEOBJ_iXlateTable);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine8to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pDst,
+    _In_reads_(cPixels) const UCHAR *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        XLATE_LINE(EXLATEOBJ_iXlateTrivial);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateTable)
+        XLATE_LINE(EXLATEOBJ_iXlateTable);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine16to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pDst,
+    _In_reads_(cPixels) const USHORT *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        RtlMoveMemory(pDst, pSrc, cPixels * sizeof(USHORT));
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate555to565)
+        XLATE_LINE(EXLATEOBJ_iXlate555to565);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate565to555)
+        XLATE_LINE(EXLATEOBJ_iXlate565to555);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+        XLATE_LINE(EXLATEOBJ_iXlateShiftAndMask);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine16to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pDst,
+    _In_reads_(cPixels) const USHORT *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        XLATE_LINE(EXLATEOBJ_iXlateTrivial);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate555toRGB)
+        XLATE_LINE(EXLATEOBJ_iXlate555toRGB);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate555toBGR)
+        XLATE_LINE(EXLATEOBJ_iXlate555toBGR);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate565toRGB)
+        XLATE_LINE(EXLATEOBJ_iXlate565toRGB);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlate565toBGR)
+        XLATE_LINE(EXLATEOBJ_iXlate565toBGR);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+        XLATE_LINE(EXLATEOBJ_iXlateShiftAndMask);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine32to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pDst,
+    _In_reads_(cPixels) const ULONG *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        XLATE_LINE(EXLATEOBJ_iXlateTrivial);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateRGBto555)
+        XLATE_LINE(EXLATEOBJ_iXlateRGBto555);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateBGRto555)
+        XLATE_LINE(EXLATEOBJ_iXlateBGRto555);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateRGBto565)
+        XLATE_LINE(EXLATEOBJ_iXlateRGBto565);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateBGRto565)
+        XLATE_LINE(EXLATEOBJ_iXlateBGRto565);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+        XLATE_LINE(EXLATEOBJ_iXlateShiftAndMask);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine32to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pDst,
+    _In_reads_(cPixels) const ULONG *pSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+    ULONG i;
+
+    if (!pexlo || (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial))
+        RtlMoveMemory(pDst, pSrc, cPixels * sizeof(ULONG));
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateRGBtoBGR)
+        XLATE_LINE(EXLATEOBJ_iXlateRGBtoBGR);
+    else if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+        XLATE_LINE(EXLATEOBJ_iXlateShiftAndMask);
+    else
+        XLATE_LINE_DEFAULT();
+}
+
+#undef XLATE_LINE
+#undef XLATE_LINE_DEFAULT
+
 /** Public DDI Functions ******************************************************/
 
 #undef XLATEOBJ_iXlate
@@ -84,3 +84,52 @@ NTAPI
 EXLATEOBJ_vCleanup(
     _Inout_ PEXLATEOBJ pexlo);
 
+/* Scanline translation, pxlo can be NULL like for XLATEOBJ_iXlate */
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine8to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pusDst,
+    _In_reads_(cPixels) const UCHAR *pjSrc,
+    _In_ ULONG cPixels);
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine8to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const UCHAR *pjSrc,
+    _In_ ULONG cPixels);
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine16to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pusDst,
+    _In_reads_(cPixels) const USHORT *pusSrc,
+    _In_ ULONG cPixels);
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine16to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const USHORT *pusSrc,
+    _In_ ULONG cPixels);
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine32to16(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PUSHORT pusDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
+VOID
+FASTCALL
+EXLATEOBJ_vXlateLine32to32(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
@@ -86,6 +86,7 @@ extern LPKGTEP LpkGetTextExtentExPoint;
 /* MACRO ********************************************************************/
 
 #define ROP_USES_SOURCE(Rop)   (((Rop) << 2 ^ Rop) & 0xCC0000)
+#define ROP_USES_PATTERN(Rop)  (((Rop) << 4 ^ Rop) & 0xF00000)
 #define RCAST(_Type, _Value)   (*((_Type*)&_Value))
 
 
@@ -402,6 +403,8 @@ GdiAllocBatchCommand(
     else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelRgn) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelObj) cjSize = sizeof(GDIBSOBJECT);
+    else if (Cmd == GdiBCSetPixel) cjSize = sizeof(GDIBSSETPIXEL);
+    else if (Cmd == GdiBCBitBlt) cjSize = sizeof(GDIBSBITBLT);
     else cjSize = 0;
 
     /* Unsupported operation */
@@ -446,6 +449,37 @@ GdiAllocBatchCommand(
     return pHdr;
 }
 
+/* Returns the last entry of the batch if it is a Cmd entry for hdc, so that
+   the caller can append to it instead of allocating a new entry */
+FORCEINLINE
+PVOID
+GdiGetLastBatchCommand(
+    HDC hdc,
+    USHORT Cmd)
+{
+    PTEB pTeb;
+    PGDIBATCHHDR pHdr, pLast;
+    ULONG i;
+
+    /* Get a pointer to the TEB */
+    pTeb = NtCurrentTeb();
+
+    /* Check if there is a batch for this DC */
+    if (!pTeb || (pTeb->GdiBatchCount == 0) || (pTeb->GdiTebBatch.HDC != hdc))
+        return NULL;
+
+    /* Walk to the last entry */
+    pHdr = (PVOID)pTeb->GdiTebBatch.Buffer;
+    pLast = pHdr;
+    for (i = 0; i < pTeb->GdiBatchCount; i++)
+    {
+        pLast = pHdr;
+        pHdr = (PVOID)((PUCHAR)pHdr + pHdr->Size);
+    }
+
+    return (pLast->Cmd == Cmd) ? pLast : NULL;
+}
+
 FORCEINLINE
 PDC_ATTR
 GdiGetDcAttr(HDC hdc)
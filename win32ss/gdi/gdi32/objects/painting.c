@@ -171,6 +171,48 @@ SetPixelV(
     _In_ INT y,
     _In_ COLORREF crColor)
 {
+    PDC_ATTR pdcattr;
+
+    /* The previous color is not needed, so the pixel can be batched */
+    if (GDI_HANDLE_GET_TYPE(hdc) == GDILoObjType_LO_DC_TYPE)
+    {
+        /* Get the DC attribute */
+        pdcattr = GdiGetDcAttr(hdc);
+        if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+        {
+            PGDIBSSETPIXEL pgO;
+            PTEB pTeb = NtCurrentTeb();
+
+            /* Append to the run of pixels at the end of the batch, if any */
+            pgO = GdiGetLastBatchCommand(hdc, GdiBCSetPixel);
+            if (pgO &&
+                (pgO->ptlViewportOrg.x == pdcattr->ptlViewportOrg.x) &&
+                (pgO->ptlViewportOrg.y == pdcattr->ptlViewportOrg.y) &&
+                ((pTeb->GdiTebBatch.Offset + sizeof(GDIBSPIXEL)) <= GDIBATCHBUFSIZE))
+            {
+                pgO->aPixel[pgO->Count].x = x;
+                pgO->aPixel[pgO->Count].y = y;
+                pgO->aPixel[pgO->Count].crColor = crColor;
+                pgO->Count++;
+                pTeb->GdiTebBatch.Offset += sizeof(GDIBSPIXEL);
+                ((PGDIBATCHHDR)pgO)->Size += sizeof(GDIBSPIXEL);
+                return TRUE;
+            }
+
+            pgO = GdiAllocBatchCommand(hdc, GdiBCSetPixel);
+            if (pgO)
+            {
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+                pgO->Count = 1;
+                pgO->aPixel[0].x = x;
+                pgO->aPixel[0].y = y;
+                pgO->aPixel[0].crColor = crColor;
+                return TRUE;
+            }
+        }
+    }
+
     return SetPixel(hdc, x, y, crColor) != CLR_INVALID;
 }
 
@@ -479,6 +521,36 @@ BitBlt(
 
     if ( GdiConvertAndCheckDC(hdcDest) == NULL ) return FALSE;
 
+    /* A blit within one DC that uses no brush can be batched */
+    if ((hdcSrc == hdcDest) &&
+        !ROP_USES_PATTERN(dwRop) &&
+        !(dwRop & (CAPTUREBLT | NOMIRRORBITMAP)))
+    {
+        PDC_ATTR pdcattr;
+
+        /* Get the DC attribute */
+        pdcattr = GdiGetDcAttr(hdcDest);
+        if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+        {
+            PGDIBSBITBLT pgO;
+
+            pgO = GdiAllocBatchCommand(hdcDest, GdiBCBitBlt);
+            if (pgO)
+            {
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                pgO->nXDest  = xDest;
+                pgO->nYDest  = yDest;
+                pgO->nWidth  = cx;
+                pgO->nHeight = cy;
+                pgO->nXSrc   = xSrc;
+                pgO->nYSrc   = ySrc;
+                pgO->dwRop   = dwRop;
+                pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+                return TRUE;
+            }
+        }
+    }
+
     return NtGdiBitBlt(hdcDest, xDest, yDest, cx, cy, hdcSrc, xSrc, ySrc, dwRop, 0, 0);
 }
 
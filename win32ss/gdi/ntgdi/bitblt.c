@@ -507,6 +507,93 @@ cleanup:
     return Status;
 }
 
+/* Blits within a single locked DC with a rop that uses no pattern. This is
+   the batched form of NtGdiBitBlt with hdcSrc == hdcDest. */
+BOOL
+FASTCALL
+IntGdiBitBlt(
+    _In_ PDC pdc,
+    _In_ INT nXDest,
+    _In_ INT nYDest,
+    _In_ INT nWidth,
+    _In_ INT nHeight,
+    _In_ INT nXSrc,
+    _In_ INT nYSrc,
+    _In_ DWORD dwRop)
+{
+    SURFACE *psurf;
+    RECTL DestRect, SourceRect;
+    POINTL SourcePoint;
+    EXLATEOBJ exlo;
+    BOOL Status;
+    ROP4 rop4;
+
+    rop4 = WIN32_ROP4_TO_ENG_ROP4(MAKEROP4(dwRop, dwRop));
+    NT_ASSERT(!ROP4_USES_PATTERN(rop4));
+
+    if (pdc->dctype == DC_TYPE_INFO)
+    {
+        return TRUE;
+    }
+
+    DestRect.left   = nXDest;
+    DestRect.top    = nYDest;
+    DestRect.right  = nXDest + nWidth;
+    DestRect.bottom = nYDest + nHeight;
+    IntLPtoDP(pdc, (LPPOINT)&DestRect, 2);
+
+    DestRect.left   += pdc->ptlDCOrig.x;
+    DestRect.top    += pdc->ptlDCOrig.y;
+    DestRect.right  += pdc->ptlDCOrig.x;
+    DestRect.bottom += pdc->ptlDCOrig.y;
+
+    if (pdc->fs & (DC_ACCUM_APP|DC_ACCUM_WMGR))
+    {
+       IntUpdateBoundsRect(pdc, &DestRect);
+    }
+
+    SourcePoint.x = nXSrc;
+    SourcePoint.y = nYSrc;
+    IntLPtoDP(pdc, (LPPOINT)&SourcePoint, 1);
+
+    SourcePoint.x += pdc->ptlDCOrig.x;
+    SourcePoint.y += pdc->ptlDCOrig.y;
+    SourceRect.left = SourcePoint.x;
+    SourceRect.top = SourcePoint.y;
+    SourceRect.right = SourcePoint.x + DestRect.right - DestRect.left;
+    SourceRect.bottom = SourcePoint.y + DestRect.bottom - DestRect.top;
+
+    /* Prepare blit */
+    DC_vPrepareDCsForBlit(pdc, &DestRect, pdc, &SourceRect);
+
+    psurf = pdc->dclevel.pSurface;
+    if (!psurf)
+    {
+        DC_vFinishBlit(pdc, pdc);
+        return FALSE;
+    }
+
+    /* Source and destination share the surface and palette */
+    EXLATEOBJ_vInitXlateFromDCs(&exlo, pdc, pdc);
+
+    Status = IntEngBitBlt(&psurf->SurfObj,
+                          &psurf->SurfObj,
+                          NULL,
+                          (CLIPOBJ *)&pdc->co,
+                          &exlo.xlo,
+                          &DestRect,
+                          &SourcePoint,
+                          NULL,
+                          NULL,
+                          NULL,
+                          rop4);
+
+    EXLATEOBJ_vCleanup(&exlo);
+    DC_vFinishBlit(pdc, pdc);
+
+    return Status;
+}
+
 BOOL
 APIENTRY
 NtGdiPlgBlt(
@@ -1353,36 +1440,20 @@ NtGdiInvertRgn(
     return bResult;
 }
 
-COLORREF
-APIENTRY
-NtGdiSetPixel(
-    _In_ HDC hdc,
+/* Sets a pixel to a color already translated to the target format. Also used
+   by the batch processing, which has the DC locked. */
+BOOL
+FASTCALL
+IntGdiSetPixel(
+    _In_ PDC pdc,
     _In_ INT x,
     _In_ INT y,
-    _In_ COLORREF crColor)
+    _In_ ULONG iSolidColor)
 {
-    PDC pdc;
-    ULONG iOldColor, iSolidColor;
+    ULONG iOldColor;
     BOOL bResult;
     PEBRUSHOBJ pebo;
     ULONG ulDirty;
-    EXLATEOBJ exlo;
-
-    /* Lock the DC */
-    pdc = DC_LockDc(hdc);
-    if (!pdc)
-    {
-        EngSetLastError(ERROR_INVALID_HANDLE);
-        return -1;
-    }
-
-    /* Check if the DC has no surface (empty mem or info DC) */
-    if (pdc->dclevel.pSurface == NULL)
-    {
-        /* Fail! */
-        DC_UnlockDc(pdc);
-        return -1;
-    }
 
     if (pdc->fs & (DC_ACCUM_APP|DC_ACCUM_WMGR))
     {
@@ -1400,9 +1471,6 @@ NtGdiSetPixel(
        IntUpdateBoundsRect(pdc, &rcDst);
     }
 
-    /* Translate the color to the target format */
-    iSolidColor = TranslateCOLORREF(pdc, crColor);
-
     /* Use the DC's text brush, which is always a solid brush */
     pebo = &pdc->eboText;
 
@@ -1420,6 +1488,44 @@ NtGdiSetPixel(
     EBRUSHOBJ_iSetSolidColor(pebo, iOldColor);
     pdc->pdcattr->ulDirty_ = ulDirty;
 
+    return bResult;
+}
+
+COLORREF
+APIENTRY
+NtGdiSetPixel(
+    _In_ HDC hdc,
+    _In_ INT x,
+    _In_ INT y,
+    _In_ COLORREF crColor)
+{
+    PDC pdc;
+    ULONG iSolidColor;
+    BOOL bResult;
+    EXLATEOBJ exlo;
+
+    /* Lock the DC */
+    pdc = DC_LockDc(hdc);
+    if (!pdc)
+    {
+        EngSetLastError(ERROR_INVALID_HANDLE);
+        return -1;
+    }
+
+    /* Check if the DC has no surface (empty mem or info DC) */
+    if (pdc->dclevel.pSurface == NULL)
+    {
+        /* Fail! */
+        DC_UnlockDc(pdc);
+        return -1;
+    }
+
+    /* Translate the color to the target format */
+    iSolidColor = TranslateCOLORREF(pdc, crColor);
+
+    /* Call the internal function */
+    bResult = IntGdiSetPixel(pdc, x, y, iSolidColor);
+
     /// FIXME: we shouldn't dereference pSurface while the PDEV is not locked!
     /* Initialize an XLATEOBJ from the target surface to RGB */
     EXLATEOBJ_vInitialize(&exlo,
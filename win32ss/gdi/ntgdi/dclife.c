@@ -571,6 +571,10 @@ DC_vPrepareDCsForBlit(
                                prcFirst->top,
                                prcFirst->right,
                                prcFirst->bottom) ;
+
+        /* Remember what we are about to paint over */
+        if (pdcFirst == pdcDest)
+            PDEVOBJ_vAddDirtyRect(pdcFirst->ppdev, (const RECTL*)prcFirst);
     }
 
 #if DBG
@@ -601,6 +605,9 @@ DC_vPrepareDCsForBlit(
                                prcSecond->top,
                                prcSecond->right,
                                prcSecond->bottom) ;
+
+        if (pdcSecond == pdcDest && pdcFirst != pdcDest)
+            PDEVOBJ_vAddDirtyRect(pdcSecond->ppdev, (const RECTL*)prcSecond);
     }
 
 #if DBG
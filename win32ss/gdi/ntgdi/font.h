@@ -26,6 +26,10 @@ typedef struct _FONT_ENTRY_COLL_MEM
 typedef struct _FONT_CACHE_ENTRY
 {
     LIST_ENTRY ListEntry;
+    LIST_ENTRY HashEntry;
+    ULONG Hash;
+    SIZE_T Size;
+    LONG RefCount;
     int GlyphIndex;
     FT_Face Face;
     FT_BitmapGlyph BitmapGlyph;
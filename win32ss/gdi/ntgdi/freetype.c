@@ -88,10 +88,14 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is bounded by the memory its bitmaps take, not their count */
+#define MAX_FONT_CACHE_SIZE (2 * 1024 * 1024)
+#define FONT_CACHE_HASH_SIZE 1024
 
 static LIST_ENTRY g_FontCacheListHead;
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_SIZE];
 static UINT g_FontCacheNumEntries;
+static SIZE_T g_FontCacheSize;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -257,12 +261,16 @@ static void
 RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
+    ASSERT(Entry->RefCount == 0);
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
-    ExFreePoolWithTag(Entry, TAG_FONT);
+    RemoveEntryList(&Entry->HashEntry);
+    ASSERT(g_FontCacheNumEntries > 0);
+    ASSERT(g_FontCacheSize >= Entry->Size);
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+    g_FontCacheSize -= Entry->Size;
+    ExFreePoolWithTag(Entry, TAG_FONT);
 }
 
 static void
@@ -660,10 +668,16 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    UINT i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
     g_FontCacheNumEntries = 0;
+    g_FontCacheSize = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -3130,25 +3144,46 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
-FT_BitmapGlyph APIENTRY
-ftGdiGlyphCacheGet(
+/* The transform isn't hashed, glyphs of a face usually share the same one */
+static __inline ULONG
+FontCacheHash(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode)
+{
+    ULONG Hash = (ULONG)((ULONG_PTR)Face >> 4);
+
+    Hash = (Hash * 31) + (ULONG)GlyphIndex;
+    Hash = (Hash * 31) + (ULONG)Height;
+    Hash = (Hash * 31) + (ULONG)RenderMode;
+    return Hash;
+}
+
+static PFONT_CACHE_ENTRY
+ftGdiGlyphCacheFind(
     FT_Face Face,
     INT GlyphIndex,
     INT Height,
     FT_Render_Mode RenderMode,
     PMATRIX pmx)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY CurrentEntry, HashListHead;
     PFONT_CACHE_ENTRY FontEntry;
+    ULONG Hash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    Hash = FontCacheHash(Face, GlyphIndex, Height, RenderMode);
+    HashListHead = &g_FontCacheHashTable[Hash % FONT_CACHE_HASH_SIZE];
+
+    for (CurrentEntry = HashListHead->Flink;
+         CurrentEntry != HashListHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        if ((FontEntry->Face == Face) &&
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
+        if ((FontEntry->Hash == Hash) &&
+            (FontEntry->Face == Face) &&
             (FontEntry->GlyphIndex == GlyphIndex) &&
             (FontEntry->Height == Height) &&
             (FontEntry->RenderMode == RenderMode) &&
@@ -3156,14 +3191,55 @@ ftGdiGlyphCacheGet(
             break;
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == HashListHead)
     {
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
-    return FontEntry->BitmapGlyph;
+    /* Keep the LRU list in order, it's what we evict from */
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
+    return FontEntry;
+}
+
+FT_BitmapGlyph APIENTRY
+ftGdiGlyphCacheGet(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode,
+    PMATRIX pmx)
+{
+    PFONT_CACHE_ENTRY FontEntry;
+
+    FontEntry = ftGdiGlyphCacheFind(Face, GlyphIndex, Height, RenderMode, pmx);
+    return FontEntry ? FontEntry->BitmapGlyph : NULL;
+}
+
+/*
+ * A referenced entry stays in the cache, so its glyph can be drawn with
+ * the FreeType lock released. Taking and dropping the reference needs
+ * the lock.
+ */
+static __inline VOID
+ftGdiGlyphCacheReference(PFONT_CACHE_ENTRY Entry)
+{
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    if (Entry)
+        Entry->RefCount++;
+}
+
+static __inline VOID
+ftGdiGlyphCacheDereference(PFONT_CACHE_ENTRY Entry)
+{
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    if (Entry)
+    {
+        ASSERT(Entry->RefCount > 0);
+        Entry->RefCount--;
+    }
 }
 
 /* no cache */
@@ -3208,8 +3284,8 @@ ftGdiGlyphSet(
     return BitmapGlyph;
 }
 
-FT_BitmapGlyph APIENTRY
-ftGdiGlyphCacheSet(
+static PFONT_CACHE_ENTRY
+ftGdiGlyphCacheAdd(
     FT_Face Face,
     INT GlyphIndex,
     INT Height,
@@ -3219,7 +3295,8 @@ ftGdiGlyphCacheSet(
 {
     FT_Glyph GlyphCopy;
     INT error;
-    PFONT_CACHE_ENTRY NewEntry;
+    PFONT_CACHE_ENTRY NewEntry, FontEntry;
+    PLIST_ENTRY CurrentEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
 
@@ -3268,15 +3345,46 @@ ftGdiGlyphCacheSet(
     NewEntry->Height = Height;
     NewEntry->RenderMode = RenderMode;
     NewEntry->mxWorldToDevice = *pmx;
+    NewEntry->Hash = FontCacheHash(Face, GlyphIndex, Height, RenderMode);
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) +
+                     (SIZE_T)abs(BitmapGlyph->bitmap.pitch) * BitmapGlyph->bitmap.rows;
+    NewEntry->RefCount = 0;
 
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(&g_FontCacheHashTable[NewEntry->Hash % FONT_CACHE_HASH_SIZE],
+                   &NewEntry->HashEntry);
+    g_FontCacheNumEntries++;
+    g_FontCacheSize += NewEntry->Size;
+
+    /* Make room by dropping the least recently used glyphs, but neither
+       the new one nor those still being drawn */
+    CurrentEntry = g_FontCacheListHead.Blink;
+    while ((g_FontCacheSize > MAX_FONT_CACHE_SIZE) &&
+           (CurrentEntry != &g_FontCacheListHead))
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Blink;
+
+        if ((FontEntry != NewEntry) && (FontEntry->RefCount == 0))
+            RemoveCachedEntry(FontEntry);
     }
 
-    return BitmapGlyph;
+    return NewEntry;
+}
+
+FT_BitmapGlyph APIENTRY
+ftGdiGlyphCacheSet(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    PMATRIX pmx,
+    FT_GlyphSlot GlyphSlot,
+    FT_Render_Mode RenderMode)
+{
+    PFONT_CACHE_ENTRY NewEntry;
+
+    NewEntry = ftGdiGlyphCacheAdd(Face, GlyphIndex, Height, pmx, GlyphSlot, RenderMode);
+    return NewEntry ? NewEntry->BitmapGlyph : NULL;
 }
 
 
@@ -5897,8 +6005,10 @@ IntExtTextOutW(
     FLOATOBJ Scale;
     LOGFONTW *plf;
     BOOL EmuBold, EmuItalic;
-    int thickness;
+    int thickness, UnderlinePosition;
     BOOL bResult;
+    PFONT_CACHE_ENTRY CacheEntry;
+    BOOLEAN FaceStateStale = FALSE;
 
     /* Check if String is valid */
     if ((Count > 0xFFFF) || (Count > 0 && String == NULL))
@@ -6319,15 +6429,44 @@ IntExtTextOutW(
     TextLeft = RealXStart;
     TextTop = YStart;
     BackgroundLeft = (RealXStart + 32) >> 6;
+
+    /* This depends on the face size, which may change while we draw */
+    if (!face->units_per_EM)
+    {
+        UnderlinePosition = 0;
+    }
+    else
+    {
+        UnderlinePosition = face->underline_position *
+            face->size->metrics.y_ppem / face->units_per_EM;
+    }
+
     for (i = 0; i < Count; ++i)
     {
         glyph_index = get_glyph_index_flagged(face, String[i], ETO_GLYPH_INDEX, fuOptions);
 
-        if (EmuBold || EmuItalic)
-            realglyph = NULL;
-        else
-            realglyph = ftGdiGlyphCacheGet(face, glyph_index, plf->lfHeight,
-                                           RenderMode, pmxWorldToDevice);
+        CacheEntry = NULL;
+        if (!(EmuBold || EmuItalic))
+        {
+            CacheEntry = ftGdiGlyphCacheFind(face, glyph_index, plf->lfHeight,
+                                             RenderMode, pmxWorldToDevice);
+        }
+        realglyph = CacheEntry ? CacheEntry->BitmapGlyph : NULL;
+
+        /* Other threads may have used the face while we were drawing the
+           previous glyph, put its size back before we need it again */
+        if (FaceStateStale &&
+            (!realglyph || (use_kerning && previous && glyph_index && NULL == Dx)))
+        {
+            if (!TextIntUpdateSize(dc, TextObj, FontGDI, FALSE))
+            {
+                bResult = FALSE;
+                break;
+            }
+            FtSetCoordinateTransform(face, pmxWorldToDevice);
+            FaceStateStale = FALSE;
+        }
+
         if (!realglyph)
         {
             if (EmuItalic)
@@ -6352,12 +6491,13 @@ IntExtTextOutW(
             }
             else
             {
-                realglyph = ftGdiGlyphCacheSet(face,
-                                               glyph_index,
-                                               plf->lfHeight,
-                                               pmxWorldToDevice,
-                                               glyph,
-                                               RenderMode);
+                CacheEntry = ftGdiGlyphCacheAdd(face,
+                                                glyph_index,
+                                                plf->lfHeight,
+                                                pmxWorldToDevice,
+                                                glyph,
+                                                RenderMode);
+                realglyph = CacheEntry ? CacheEntry->BitmapGlyph : NULL;
             }
             if (!realglyph)
             {
@@ -6378,6 +6518,11 @@ IntExtTextOutW(
         DPRINT("TextTop: %lu\n", TextTop);
         DPRINT("Advance: %d\n", realglyph->root.advance.x);
 
+        /* Drawing only needs the glyph, let the other threads use FreeType meanwhile */
+        ftGdiGlyphCacheReference(CacheEntry);
+        IntUnLockFreeType();
+        FaceStateStale = TRUE;
+
         if ((fuOptions & ETO_OPAQUE) && !plf->lfItalic)
         {
             DestRect.left = BackgroundLeft;
@@ -6436,6 +6581,8 @@ IntExtTextOutW(
             {
                 DPRINT1("WARNING: EngCreateBitmap() failed!\n");
                 // FT_Done_Glyph(realglyph);
+                IntLockFreeType();
+                ftGdiGlyphCacheDereference(CacheEntry);
                 bResult = FALSE;
                 break;
             }
@@ -6444,6 +6591,8 @@ IntExtTextOutW(
             {
                 EngDeleteSurface((HSURF)HSourceGlyph);
                 DPRINT1("WARNING: EngLockSurface() failed!\n");
+                IntLockFreeType();
+                ftGdiGlyphCacheDereference(CacheEntry);
                 bResult = FALSE;
                 break;
             }
@@ -6491,6 +6640,9 @@ IntExtTextOutW(
             EngDeleteSurface((HSURF)HSourceGlyph);
         }
 
+        IntLockFreeType();
+        ftGdiGlyphCacheDereference(CacheEntry);
+
         if (DoBreak)
         {
             break;
@@ -6498,25 +6650,16 @@ IntExtTextOutW(
 
         if (plf->lfUnderline)
         {
-            int i, position;
-            if (!face->units_per_EM)
-            {
-                position = 0;
-            }
-            else
-            {
-                position = face->underline_position *
-                    face->size->metrics.y_ppem / face->units_per_EM;
-            }
+            int i;
             for (i = -thickness / 2; i < -thickness / 2 + thickness; ++i)
             {
                 EngLineTo(SurfObj,
                           (CLIPOBJ *)&dc->co,
                           &dc->eboText.BrushObject,
                           (TextLeft >> 6),
-                          TextTop + yoff - position + i,
+                          TextTop + yoff - UnderlinePosition + i,
                           ((TextLeft + (realglyph->root.advance.x >> 10)) >> 6),
-                          TextTop + yoff - position + i,
+                          TextTop + yoff - UnderlinePosition + i,
                           NULL,
                           ROP2_TO_MIX(R2_COPYPEN));
             }
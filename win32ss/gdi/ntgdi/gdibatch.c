@@ -6,6 +6,8 @@
 
 BOOL FASTCALL IntPatBlt( PDC,INT,INT,INT,INT,DWORD,PEBRUSHOBJ);
 BOOL APIENTRY IntExtTextOutW(IN PDC,IN INT,IN INT,IN UINT,IN OPTIONAL PRECTL,IN LPCWSTR,IN INT,IN OPTIONAL LPINT,IN DWORD);
+BOOL FASTCALL IntGdiSetPixel(PDC,INT,INT,ULONG);
+BOOL FASTCALL IntGdiBitBlt(PDC,INT,INT,INT,INT,INT,INT,DWORD);
 
 
 //
@@ -44,22 +46,11 @@ VOID
 FASTCALL
 SynchronizeDriver(FLONG Flags)
 {
-  SURFOBJ *SurfObj;
-  //PPDEVOBJ Device;
-
-  if (Flags & GCAPS2_SYNCFLUSH)
-      Flags = DSS_FLUSH_EVENT;
-  if (Flags & GCAPS2_SYNCTIMER)
-      Flags = DSS_TIMER_EVENT;
-
-  //Device = IntEnumHDev();
-//  UNIMPLEMENTED;
-//ASSERT(FALSE);
-  SurfObj = 0;// EngLockSurface( Device->pSurface );
-  if(!SurfObj) return;
-  DoDeviceSync( SurfObj, NULL, Flags);
-  EngUnlockSurface(SurfObj);
-  return;
+  /* Push the damage collected since the last flush to the display driver */
+  if ((Flags & GCAPS2_SYNCFLUSH) && gppdevPrimary)
+  {
+     PDEVOBJ_vFlushDirtyRects(gppdevPrimary);
+  }
 }
 
 //
@@ -443,6 +434,96 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
         break;
      }
 
+     case GdiBCSetPixel:
+     {
+        PGDIBSSETPIXEL pgO;
+        POINTL ptlViewportOrg;
+        DWORD saveflXform = 0;
+        BOOL bXform = FALSE;
+        ULONG i, Count;
+        if (!dc) break;
+        pgO = (PGDIBSSETPIXEL) pHdr;
+        /* Check if the DC has no surface (empty mem or info DC) */
+        if (dc->dclevel.pSurface == NULL)
+        {
+           /* Nothing to do */
+           break;
+        }
+        /* Never trust the count, the entry size bounds it */
+        Count = pgO->Count;
+        if (Count > (Size - FIELD_OFFSET(GDIBSSETPIXEL, aPixel)) / sizeof(GDIBSPIXEL))
+        {
+           DPRINT1("WARNING! GdiBCSetPixel count %lu too large\n", Count);
+           break;
+        }
+
+        if ( dc->pdcattr->ptlViewportOrg.x != pgO->ptlViewportOrg.x ||
+             dc->pdcattr->ptlViewportOrg.y != pgO->ptlViewportOrg.y )
+        {
+            saveflXform = dc->pdcattr->flXform & (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+            ptlViewportOrg = dc->pdcattr->ptlViewportOrg;
+            dc->pdcattr->ptlViewportOrg = pgO->ptlViewportOrg;
+            dc->pdcattr->flXform |= (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+            bXform = TRUE;
+        }
+
+        for (i = 0; i < Count; i++)
+        {
+            IntGdiSetPixel(dc,
+                           pgO->aPixel[i].x,
+                           pgO->aPixel[i].y,
+                           TranslateCOLORREF(dc, pgO->aPixel[i].crColor));
+        }
+
+        if (bXform)
+        {
+            dc->pdcattr->ptlViewportOrg = ptlViewportOrg;
+            dc->pdcattr->flXform |= saveflXform|(PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+        }
+        break;
+     }
+
+     case GdiBCBitBlt:
+     {
+        PGDIBSBITBLT pgO;
+        POINTL ptlViewportOrg;
+        DWORD saveflXform = 0;
+        BOOL bXform = FALSE;
+        if (!dc) break;
+        pgO = (PGDIBSBITBLT) pHdr;
+        /* Brushes are not snapshot, so the rop must not use one */
+        if (WIN32_ROP4_USES_PATTERN(MAKEROP4(pgO->dwRop, pgO->dwRop)))
+        {
+           break;
+        }
+
+        if ( dc->pdcattr->ptlViewportOrg.x != pgO->ptlViewportOrg.x ||
+             dc->pdcattr->ptlViewportOrg.y != pgO->ptlViewportOrg.y )
+        {
+            saveflXform = dc->pdcattr->flXform & (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+            ptlViewportOrg = dc->pdcattr->ptlViewportOrg;
+            dc->pdcattr->ptlViewportOrg = pgO->ptlViewportOrg;
+            dc->pdcattr->flXform |= (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+            bXform = TRUE;
+        }
+
+        IntGdiBitBlt(dc,
+                     pgO->nXDest,
+                     pgO->nYDest,
+                     pgO->nWidth,
+                     pgO->nHeight,
+                     pgO->nXSrc,
+                     pgO->nYSrc,
+                     pgO->dwRop);
+
+        if (bXform)
+        {
+            dc->pdcattr->ptlViewportOrg = ptlViewportOrg;
+            dc->pdcattr->flXform |= saveflXform|(PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+        }
+        break;
+     }
+
      case GdiBCDelRgn:
         DPRINT("Delete Region Object!\n");
         /* Fall through */
@@ -525,6 +606,8 @@ NtGdiFlushUserBatch(VOID)
        pTeb->GdiTebBatch.Offset = 0;
        pTeb->GdiBatchCount = 0;
        pTeb->GdiTebBatch.HDC = 0;
+
+       SynchronizeDriver(GCAPS2_SYNCFLUSH);
     }
   }
 
@@ -15,6 +15,7 @@
 
 extern ULONG gulFirstFree;
 extern ULONG gulFirstUnused;
+extern LONG glGdiCachedFreeEntries;
 extern PENTRY gpentHmgr;
 
 ULONG gulLogUnique = 0;
@@ -389,7 +390,8 @@ DbgGdiHTIntegrityCheck(VOID)
 		}
 	}
 
-	if (RESERVE_ENTRIES_COUNT + nDeleted + nFree + nUsed != GDI_HANDLE_COUNT)
+	/* Entries kept by processes for their own reuse are on none of the lists */
+	if (RESERVE_ENTRIES_COUNT + nDeleted + nFree + nUsed + glGdiCachedFreeEntries != GDI_HANDLE_COUNT)
 	{
 		r = 0;
 		DPRINT1("Number of all entries incorrect: RESERVE_ENTRIES_COUNT = %lu, nDeleted = %lu, nFree = %lu, nUsed = %lu\n",
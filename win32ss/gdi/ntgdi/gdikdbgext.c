@@ -71,6 +71,10 @@ KdbCommand_Gdi_help(VOID)
              "- baseobject <object> - Displays a BASEOBJECT\n"
 #if DBG_ENABLE_EVENT_LOGGING
              "- eventlist <object> - Displays the eventlist for an object\n"
+#endif
+#if DBG
+             "- userlock [reset] - Displays the USER lock hold times per system call\n"
+             "- deskheap - Displays the desktop heap usage per object type\n"
 #endif
             );
 }
@@ -347,6 +351,16 @@ DbgGdiKdbgCliCallback(
     {
         KdbCommand_Gdi_baseobject(argv[1]);
     }
+#if DBG
+    else if (stricmp(argv[0], "!gdi.userlock") == 0)
+    {
+        UserDbgDumpLockStats(argc > 1 && stricmp(argv[1], "reset") == 0);
+    }
+    else if (stricmp(argv[0], "!gdi.deskheap") == 0)
+    {
+        UserDbgDumpDesktopHeapStats();
+    }
+#endif
 #if DBG_ENABLE_EVENT_LOGGING
     else if (stricmp(argv[0], "!gdi.eventlist") == 0)
     {
@@ -133,6 +133,9 @@ ASSERT_LOCK_ORDER(
 
 #define GDIOBJ_POOL_TAG(type) ('00hG' + (((type) & 0x1f) << 24))
 
+/* Number of freed handle table entries a process keeps for its own reuse */
+#define GDI_PROCESS_FREE_ENTRIES 64
+
 enum
 {
     REF_MASK_REUSE = 0xff000000,
@@ -150,6 +153,9 @@ PENTRY gpentHmgr;
 PULONG gpaulRefCount;
 volatile ULONG gulFirstFree;
 volatile ULONG gulFirstUnused;
+#if DBG
+volatile LONG glGdiCachedFreeEntries;
+#endif
 static PPAGED_LOOKASIDE_LIST gpaLookasideList;
 
 static VOID NTAPI GDIOBJ_vCleanup(PVOID ObjectBody);
@@ -377,39 +383,23 @@ DecrementGdiHandleCount(ULONG ulProcessId)
     if (NT_SUCCESS(Status)) ObDereferenceObject(pep);
 }
 
+/* Pops the first entry of a free list, returns NULL if the list is empty */
 static
 PENTRY
-ENTRY_pentPopFreeEntry(VOID)
+ENTRY_pentPopFromList(volatile ULONG *pulFirstFree)
 {
     ULONG iFirst, iNext, iPrev;
     PENTRY pentFree;
 
-    DPRINT("Enter InterLockedPopFreeEntry\n");
-
     do
     {
         /* Get the index and sequence number of the first free entry */
-        iFirst = InterlockedReadUlong(&gulFirstFree);
+        iFirst = InterlockedReadUlong(pulFirstFree);
 
         /* Check if we have a free entry */
         if (!(iFirst & GDI_HANDLE_INDEX_MASK))
         {
-            /* Increment FirstUnused and get the new index */
-            iFirst = InterlockedIncrement((LONG*)&gulFirstUnused) - 1;
-
-            /* Check if we have unused entries left */
-            if (iFirst >= GDI_HANDLE_COUNT)
-            {
-                DPRINT1("No more GDI handles left!\n");
-#if DBG_ENABLE_GDIOBJ_BACKTRACES
-                DbgDumpGdiHandleTableWithBT();
-#endif
-                InterlockedDecrement((LONG*)&gulFirstUnused);
-                return 0;
-            }
-
-            /* Return the old entry */
-            return &gpentHmgr[iFirst];
+            return NULL;
         }
 
         /* Get a pointer to the first free entry */
@@ -420,12 +410,108 @@ ENTRY_pentPopFreeEntry(VOID)
         iNext |= (iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000;
 
         /* Try to exchange the FirstFree value */
-        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
+        iPrev = InterlockedCompareExchange((LONG*)pulFirstFree,
                                            iNext,
                                            iFirst);
     }
     while (iPrev != iFirst);
 
+    return pentFree;
+}
+
+/* Pushes an already reset entry to a free list */
+static
+VOID
+ENTRY_vPushToList(volatile ULONG *pulFirstFree, PENTRY pentFree)
+{
+    ULONG iToFree, iFirst, iPrev, idxToFree;
+
+    idxToFree = pentFree - gpentHmgr;
+
+    do
+    {
+        /* Get the current first free index and sequence number */
+        iFirst = InterlockedReadUlong(pulFirstFree);
+
+        /* Set the einfo.pobj member to the index of the first free entry */
+        pentFree->einfo.pobj = UlongToPtr(iFirst & GDI_HANDLE_INDEX_MASK);
+
+        /* Combine new index and increased sequence number in iToFree */
+        iToFree = idxToFree | ((iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+
+        /* Try to atomically update the first free entry */
+        iPrev = InterlockedCompareExchange((LONG*)pulFirstFree,
+                                           iToFree,
+                                           iFirst);
+    }
+    while (iPrev != iFirst);
+}
+
+/* Returns the entries a process kept for itself to the global free list */
+static
+VOID
+ENTRY_vFlushProcessFreeEntries(PPROCESSINFO ppi)
+{
+    PENTRY pentFree;
+
+    while ((pentFree = ENTRY_pentPopFromList(&ppi->ulGdiFirstFree)) != NULL)
+    {
+        InterlockedDecrement(&ppi->cGdiFreeEntries);
+#if DBG
+        InterlockedDecrement(&glGdiCachedFreeEntries);
+#endif
+        ENTRY_vPushToList(&gulFirstFree, pentFree);
+    }
+}
+
+static
+PENTRY
+ENTRY_pentPopFreeEntry(VOID)
+{
+    ULONG iFirst;
+    PENTRY pentFree;
+    PPROCESSINFO ppi;
+
+    DPRINT("Enter InterLockedPopFreeEntry\n");
+
+    /* Try the entries the current process freed last, this keeps processes
+       that create and delete objects all the time off the global list */
+    ppi = PsGetCurrentProcessWin32Process();
+    if (ppi && (ppi->cGdiFreeEntries > 0))
+    {
+        pentFree = ENTRY_pentPopFromList(&ppi->ulGdiFirstFree);
+        if (pentFree)
+        {
+            InterlockedDecrement(&ppi->cGdiFreeEntries);
+#if DBG
+            InterlockedDecrement(&glGdiCachedFreeEntries);
+#endif
+            goto done;
+        }
+    }
+
+    pentFree = ENTRY_pentPopFromList(&gulFirstFree);
+    if (!pentFree)
+    {
+        /* Increment FirstUnused and get the new index */
+        iFirst = InterlockedIncrement((LONG*)&gulFirstUnused) - 1;
+
+        /* Check if we have unused entries left */
+        if (iFirst >= GDI_HANDLE_COUNT)
+        {
+            DPRINT1("No more GDI handles left!\n");
+#if DBG_ENABLE_GDIOBJ_BACKTRACES
+            DbgDumpGdiHandleTableWithBT();
+#endif
+            InterlockedDecrement((LONG*)&gulFirstUnused);
+            return 0;
+        }
+
+        /* Return the old entry */
+        return &gpentHmgr[iFirst];
+    }
+
+done:
     /* Sanity check: is entry really free? */
     ASSERT(((ULONG_PTR)pentFree->einfo.pobj & ~GDI_HANDLE_INDEX_MASK) == 0);
 
@@ -438,7 +524,8 @@ static
 VOID
 ENTRY_vPushFreeEntry(PENTRY pentFree)
 {
-    ULONG iToFree, iFirst, iPrev, idxToFree;
+    ULONG idxToFree;
+    PPROCESSINFO ppi;
 
     DPRINT("Enter ENTRY_vPushFreeEntry\n");
 
@@ -454,23 +541,23 @@ ENTRY_vPushFreeEntry(PENTRY pentFree)
     InterlockedExchangeAdd((LONG*)&gpaulRefCount[idxToFree], REF_INC_REUSE);
     pentFree->FullUnique += 0x0100;
 
-    do
+    /* Keep a few entries for the current process, unless it is going away */
+    ppi = PsGetCurrentProcessWin32Process();
+    if (ppi && !(ppi->W32PF_flags & W32PF_TERMINATED))
     {
-        /* Get the current first free index and sequence number */
-        iFirst = InterlockedReadUlong(&gulFirstFree);
-
-        /* Set the einfo.pobj member to the index of the first free entry */
-        pentFree->einfo.pobj = UlongToPtr(iFirst & GDI_HANDLE_INDEX_MASK);
-
-        /* Combine new index and increased sequence number in iToFree */
-        iToFree = idxToFree | ((iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+        if (InterlockedIncrement(&ppi->cGdiFreeEntries) <= GDI_PROCESS_FREE_ENTRIES)
+        {
+#if DBG
+            InterlockedIncrement(&glGdiCachedFreeEntries);
+#endif
+            ENTRY_vPushToList(&ppi->ulGdiFirstFree, pentFree);
+            return;
+        }
 
-        /* Try to atomically update the first free entry */
-        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
-                                           iToFree,
-                                           iFirst);
+        InterlockedDecrement(&ppi->cGdiFreeEntries);
     }
-    while (iPrev != iFirst);
+
+    ENTRY_vPushToList(&gulFirstFree, pentFree);
 }
 
 static
@@ -1573,11 +1660,14 @@ GDI_CleanupForProcess(struct _EPROCESS *Process)
         }
     }
 
+    /* Give back the entries the process kept for itself */
+    ppi = PsGetCurrentProcessWin32Process();
+    ENTRY_vFlushProcessFreeEntries(ppi);
+
 #if DBG
     DbgGdiHTIntegrityCheck();
 #endif
 
-    ppi = PsGetCurrentProcessWin32Process();
     DPRINT("Completed cleanup for process %p\n", Process->UniqueProcessId);
     if (ppi->GDIHandleCount != 0)
     {
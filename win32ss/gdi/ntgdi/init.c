@@ -28,6 +28,9 @@ GdiProcessCreate(PEPROCESS Process)
     InitializeListHead(&ppiCurrent->GDIBrushAttrFreeList);
     InitializeListHead(&ppiCurrent->GDIDcAttrFreeList);
 
+    ppiCurrent->ulGdiFirstFree = 0;
+    ppiCurrent->cGdiFreeEntries = 0;
+
     /* Map the GDI handle table to user land */
     Process->Peb->GdiSharedHandleTable = GDI_MapHandleTable(Process);
     Process->Peb->GdiDCAttributeList = GDI_BATCH_LIMIT;
@@ -5,6 +5,7 @@
 #define WIN32_ROP4_TO_ENG_ROP4(dwRop4) ((dwRop4) >> 16)
 
 #define WIN32_ROP4_USES_SOURCE(Rop)  ((((Rop) & 0xCCCC0000) >> 2) != ((Rop) & 0x33330000))
+#define WIN32_ROP4_USES_PATTERN(Rop) ((((Rop) & 0xF0F00000) >> 4) != ((Rop) & 0x0F0F0000))
 
 /* The range of valid ROP2 values is 1 .. 16 */
 #define FIXUP_ROP2(rop2) ((((rop2) - 1) & 0xF) + 1)
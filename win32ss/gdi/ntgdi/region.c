@@ -413,6 +413,11 @@ typedef struct _SCANLINE_LISTBLOCK
 #define LARGE_COORDINATE  INT_MAX
 #define SMALL_COORDINATE  INT_MIN
 
+/* Number of rects REGION_RegionOp can build on the stack, and the private
+   header type marking a region whose buffer is that scratch buffer */
+#define RGN_SCRATCH_RECTS 32
+#define RDH_SCRATCH       (RDH_RECTANGLES + 1)
+
 static
 BOOL
 REGION_bGrowBufferSize(
@@ -450,8 +455,13 @@ REGION_bGrowBufferSize(
     /* Copy the rects into the new buffer */
     COPY_RECTS(pvBuffer, prgn->Buffer, prgn->rdh.nCount);
 
-    /* Free the old buffer */
-    if (prgn->Buffer != &prgn->rdh.rcBound)
+    /* Free the old buffer, unless it is the embedded rect or the stack
+       scratch buffer of REGION_RegionOp, which is left behind for good */
+    if (prgn->rdh.iType == RDH_SCRATCH)
+    {
+        prgn->rdh.iType = RDH_RECTANGLES;
+    }
+    else if (prgn->Buffer != &prgn->rdh.rcBound)
     {
         ExFreePoolWithTag(prgn->Buffer, TAG_REGION);
     }
@@ -979,6 +989,7 @@ REGION_RegionOp(
     RECTL *r2BandEnd;                  /* End of current band in r2 */
     ULONG top;                         /* Top of non-overlapping band */
     ULONG bot;                         /* Bottom of non-overlapping band */
+    RECTL arclScratch[RGN_SCRATCH_RECTS]; /* Scratch buffer for the result */
 
     /* Initialization:
      *  set r1, r2, r1End and r2End appropriately, preserve the important
@@ -996,21 +1007,13 @@ REGION_RegionOp(
     oldRects = newReg->Buffer;
     newReg->rdh.nCount = 0;
 
-    /* Allocate a reasonable number of rectangles for the new region. The idea
-     * is to allocate enough so the individual functions don't need to
-     * reallocate and copy the array, which is time consuming, yet we don't
-     * have to worry about using too much memory. I hope to be able to
-     * nuke the Xrealloc() at the end of this function eventually. */
-    newReg->rdh.nRgnSize = max(reg1->rdh.nCount + 1, reg2->rdh.nCount) * 2 * sizeof(RECT);
-
-    newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
-                                           newReg->rdh.nRgnSize,
-                                           TAG_REGION);
-    if (newReg->Buffer == NULL)
-    {
-        newReg->rdh.nRgnSize = 0;
-        return FALSE;
-    }
+    /* Build the result in a scratch buffer on the stack. Most operations
+     * produce only a handful of rectangles, so this avoids allocating an
+     * oversized buffer from pool and then shrinking it again. If the result
+     * outgrows the scratch buffer, REGION_bGrowBufferSize moves it to pool. */
+    newReg->Buffer = arclScratch;
+    newReg->rdh.nRgnSize = sizeof(arclScratch);
+    newReg->rdh.iType = RDH_SCRATCH;
 
     /* Initialize ybot and ytop.
      * In the upcoming loop, ybot and ytop serve different functions depending
@@ -1070,7 +1073,7 @@ REGION_RegionOp(
 
             if ((top != bot) && (nonOverlap1Func != NULL))
             {
-                if (!(*nonOverlap1Func)(newReg, r1, r1BandEnd, top, bot)) return FALSE;
+                if (!(*nonOverlap1Func)(newReg, r1, r1BandEnd, top, bot)) goto Failure;
             }
 
             ytop = r2->top;
@@ -1082,7 +1085,7 @@ REGION_RegionOp(
 
             if ((top != bot) && (nonOverlap2Func != NULL))
             {
-                if (!(*nonOverlap2Func)(newReg, r2, r2BandEnd, top, bot) ) return FALSE;
+                if (!(*nonOverlap2Func)(newReg, r2, r2BandEnd, top, bot) ) goto Failure;
             }
 
             ytop = r1->top;
@@ -1107,7 +1110,7 @@ REGION_RegionOp(
         curBand = newReg->rdh.nCount;
         if (ybot > ytop)
         {
-            if (!(*overlapFunc)(newReg, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot)) return FALSE;
+            if (!(*overlapFunc)(newReg, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot)) goto Failure;
         }
 
         if (newReg->rdh.nCount != curBand)
@@ -1147,7 +1150,7 @@ REGION_RegionOp(
                                    r1BandEnd,
                                    max(r1->top,ybot),
                                    r1->bottom))
-                    return FALSE;
+                    goto Failure;
                 r1 = r1BandEnd;
             }
             while (r1 != r1End);
@@ -1168,7 +1171,7 @@ REGION_RegionOp(
                                r2BandEnd,
                                max(r2->top,ybot),
                                r2->bottom))
-                return FALSE;
+                goto Failure;
             r2 = r2BandEnd;
         }
         while (r2 != r2End);
@@ -1179,46 +1182,51 @@ REGION_RegionOp(
         (VOID)REGION_Coalesce(newReg, prevBand, curBand);
     }
 
-    /* A bit of cleanup. To keep regions from growing without bound,
-     * we shrink the array of rectangles to match the new number of
-     * rectangles in the region. This never goes to 0, however...
-     *
-     * Only do this stuff if the number of rectangles allocated is more than
-     * twice the number of rectangles in the region (a simple optimization...). */
-    if ((newReg->rdh.nRgnSize > (2 * newReg->rdh.nCount * sizeof(RECT))) &&
-        (newReg->rdh.nCount > 2))
+    if (newReg->rdh.iType == RDH_SCRATCH)
     {
-        if (REGION_NOT_EMPTY(newReg))
+        /* The result still lives in the scratch buffer, move it to a buffer
+         * of the exact size, or to the embedded rect if there is nothing. */
+        if (newReg->rdh.nCount == 0)
+        {
+            newReg->Buffer = &newReg->rdh.rcBound;
+            newReg->rdh.nRgnSize = sizeof(RECT);
+        }
+        else
         {
-            RECTL *prev_rects = newReg->Buffer;
             newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
                                                    newReg->rdh.nCount * sizeof(RECT),
                                                    TAG_REGION);
-
             if (newReg->Buffer == NULL)
             {
-                newReg->Buffer = prev_rects;
-            }
-            else
-            {
-                newReg->rdh.nRgnSize = newReg->rdh.nCount*sizeof(RECT);
-                COPY_RECTS(newReg->Buffer, prev_rects, newReg->rdh.nCount);
-                if (prev_rects != &newReg->rdh.rcBound)
-                    ExFreePoolWithTag(prev_rects, TAG_REGION);
+                goto Failure;
             }
+
+            newReg->rdh.nRgnSize = newReg->rdh.nCount * sizeof(RECT);
+            COPY_RECTS(newReg->Buffer, arclScratch, newReg->rdh.nCount);
+        }
+    }
+    else if ((newReg->rdh.nRgnSize > (2 * newReg->rdh.nCount * sizeof(RECT))) &&
+             (newReg->rdh.nCount > 2))
+    {
+        /* A bit of cleanup. To keep regions from growing without bound,
+         * we shrink the array of rectangles to match the new number of
+         * rectangles in the region. Only do this if the number of rectangles
+         * allocated is more than twice the number of rectangles in the
+         * region (a simple optimization...). */
+        RECTL *prev_rects = newReg->Buffer;
+        newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
+                                               newReg->rdh.nCount * sizeof(RECT),
+                                               TAG_REGION);
+
+        if (newReg->Buffer == NULL)
+        {
+            newReg->Buffer = prev_rects;
         }
         else
         {
-            /* No point in doing the extra work involved in an Xrealloc if
-             * the region is empty */
-            newReg->rdh.nRgnSize = sizeof(RECT);
-            if (newReg->Buffer != &newReg->rdh.rcBound)
-                ExFreePoolWithTag(newReg->Buffer, TAG_REGION);
-
-            newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
-                                                   sizeof(RECT),
-                                                   TAG_REGION);
-            ASSERT(newReg->Buffer);
+            newReg->rdh.nRgnSize = newReg->rdh.nCount*sizeof(RECT);
+            COPY_RECTS(newReg->Buffer, prev_rects, newReg->rdh.nCount);
+            ExFreePoolWithTag(prev_rects, TAG_REGION);
         }
     }
 
@@ -1227,6 +1235,23 @@ REGION_RegionOp(
     if (oldRects != &newReg->rdh.rcBound)
         ExFreePoolWithTag(oldRects, TAG_REGION);
     return TRUE;
+
+Failure:
+    /* Never leave the region pointing to the scratch buffer. The old rects
+     * are not referenced anymore, even if newReg was one of the sources. */
+    if ((newReg->rdh.iType != RDH_SCRATCH) &&
+        (newReg->Buffer != &newReg->rdh.rcBound))
+    {
+        ExFreePoolWithTag(newReg->Buffer, TAG_REGION);
+    }
+
+    EMPTY_REGION(newReg);
+    newReg->Buffer = &newReg->rdh.rcBound;
+    newReg->rdh.nRgnSize = sizeof(RECT);
+
+    if (oldRects != &newReg->rdh.rcBound)
+        ExFreePoolWithTag(oldRects, TAG_REGION);
+    return FALSE;
 }
 
 /***********************************************************************
@@ -1469,6 +1494,67 @@ REGION_UnionO (
     return TRUE;
 }
 
+/*!
+ *      Union of two regions that don't share any scanline, with all of
+ *      pUpper above pLower. The bands of the result are simply the bands of
+ *      both regions, so the rects are concatenated and only the two bands
+ *      at the seam need to be coalesced.
+ */
+static
+BOOL
+FASTCALL
+REGION_bUnionDisjointBands(
+    PREGION newReg,
+    PREGION pUpper,
+    PREGION pLower)
+{
+    RECTL *pOldRects, *pNewRects, *pLastBand;
+    ULONG cUpper = pUpper->rdh.nCount;
+    ULONG cLower = pLower->rdh.nCount;
+    ULONG cTotal = cUpper + cLower;
+    RECTL rcBound;
+
+    NT_ASSERT(pUpper->rdh.rcBound.bottom <= pLower->rdh.rcBound.top);
+
+    pNewRects = ExAllocatePoolWithTag(PagedPool, cTotal * sizeof(RECTL), TAG_REGION);
+    if (pNewRects == NULL)
+    {
+        return FALSE;
+    }
+
+    COPY_RECTS(pNewRects, pUpper->Buffer, cUpper);
+    COPY_RECTS(pNewRects + cUpper, pLower->Buffer, cLower);
+
+    rcBound.left = min(pUpper->rdh.rcBound.left, pLower->rdh.rcBound.left);
+    rcBound.top = pUpper->rdh.rcBound.top;
+    rcBound.right = max(pUpper->rdh.rcBound.right, pLower->rdh.rcBound.right);
+    rcBound.bottom = pLower->rdh.rcBound.bottom;
+
+    /* newReg may be one of the sources, so only now replace its buffer */
+    pOldRects = newReg->Buffer;
+    newReg->Buffer = pNewRects;
+    newReg->rdh.nCount = cTotal;
+    newReg->rdh.nRgnSize = cTotal * sizeof(RECTL);
+    newReg->rdh.iType = RDH_RECTANGLES;
+    if (pOldRects != &newReg->rdh.rcBound)
+    {
+        ExFreePoolWithTag(pOldRects, TAG_REGION);
+    }
+
+    /* Find the last band of the upper region and coalesce it with the
+       first band of the lower one */
+    pLastBand = pNewRects + cUpper - 1;
+    while ((pLastBand > pNewRects) && ((pLastBand - 1)->top == pLastBand->top))
+    {
+        pLastBand--;
+    }
+
+    (VOID)REGION_Coalesce(newReg, pLastBand - pNewRects, cUpper);
+
+    newReg->rdh.rcBound = rcBound;
+    return TRUE;
+}
+
 /***********************************************************************
  * REGION_UnionRegion
  */
@@ -1539,6 +1625,17 @@ REGION_UnionRegion(
         return ret;
     }
 
+    /* The regions don't overlap vertically, so no band needs merging */
+    if (reg1->rdh.rcBound.bottom <= reg2->rdh.rcBound.top)
+    {
+        return REGION_bUnionDisjointBands(newReg, reg1, reg2);
+    }
+
+    if (reg2->rdh.rcBound.bottom <= reg1->rdh.rcBound.top)
+    {
+        return REGION_bUnionDisjointBands(newReg, reg2, reg1);
+    }
+
     if ((ret = REGION_RegionOp(newReg,
                     reg1,
                     reg2,
@@ -91,6 +91,8 @@ typedef enum _GDIBATCHCMD
     GdiBCSelObj,
     GdiBCDelObj,
     GdiBCDelRgn,
+    GdiBCSetPixel,
+    GdiBCBitBlt,
 } GDIBATCHCMD, *PGDIBATCHCMD;
 
 typedef enum _TRANSFORMTYPE
@@ -552,6 +554,36 @@ typedef struct _GDIBSEXTSELCLPRGN
   RECTL rcl;
 } GDIBSEXTSELCLPRGN, *PGDIBSEXTSELCLPRGN;
 
+typedef struct _GDIBSPIXEL
+{
+  INT x;
+  INT y;
+  COLORREF crColor;
+} GDIBSPIXEL, *PGDIBSPIXEL;
+
+/* A run of SetPixelV calls, consecutive ones are appended to the same entry. */
+typedef struct _GDIBSSETPIXEL
+{
+  GDIBATCHHDR gbHdr;
+  POINTL ptlViewportOrg;
+  ULONG Count;
+  GDIBSPIXEL aPixel[1];
+} GDIBSSETPIXEL, *PGDIBSSETPIXEL;
+
+/* BitBlt within the batch DC, with a rop that uses no pattern. */
+typedef struct _GDIBSBITBLT
+{
+  GDIBATCHHDR gbHdr;
+  int nXDest;
+  int nYDest;
+  int nWidth;
+  int nHeight;
+  int nXSrc;
+  int nYSrc;
+  DWORD dwRop;
+  POINTL ptlViewportOrg;
+} GDIBSBITBLT, *PGDIBSBITBLT;
+
 /* Use with GdiBCSelObj, GdiBCDelObj and GdiBCDelRgn. */
 typedef struct _GDIBSOBJECT
 {
@@ -285,6 +285,32 @@ co_IntCallSentMessageCallback(SENDASYNCPROC CompletionCallback,
    return;
 }
 
+/* lParam buffers up to this size are passed from the stack, not from pool */
+#define WNDPROC_STACK_LPARAM_SIZE 128
+
+/* Messages whose lParam buffer is written back after the window proc ran.
+   Also see g_MsgMemory. */
+static BOOL FASTCALL
+IntWndProcWritesLParam(UINT Message)
+{
+   switch (Message)
+   {
+      case WM_CREATE:
+      case WM_GETMINMAXINFO:
+      case WM_GETTEXT:
+      case WM_NCCALCSIZE:
+      case WM_NCCREATE:
+      case WM_STYLECHANGING:
+      case WM_WINDOWPOSCHANGING:
+      case WM_SIZING:
+      case WM_MOVING:
+      case WM_MEASUREITEM:
+      case WM_NEXTMENU:
+         return TRUE;
+   }
+   return FALSE;
+}
+
 LRESULT APIENTRY
 co_IntCallWindowProc(WNDPROC Proc,
                      BOOLEAN IsAnsiProc,
@@ -294,7 +320,11 @@ co_IntCallWindowProc(WNDPROC Proc,
                      LPARAM lParam,
                      INT lParamBufferSize)
 {
-   WINDOWPROC_CALLBACK_ARGUMENTS StackArguments;
+   union
+   {
+      WINDOWPROC_CALLBACK_ARGUMENTS Arguments;
+      UCHAR Buffer[sizeof(WINDOWPROC_CALLBACK_ARGUMENTS) + WNDPROC_STACK_LPARAM_SIZE];
+   } StackArguments;
    PWINDOWPROC_CALLBACK_ARGUMENTS Arguments;
    NTSTATUS Status;
    PVOID ResultPointer, pActCtx;
@@ -302,6 +332,7 @@ co_IntCallWindowProc(WNDPROC Proc,
    ULONG ResultLength;
    ULONG ArgumentLength;
    LRESULT Result;
+   BOOL WriteBack;
 
    TRACE("co_IntCallWindowProc(Proc %p, IsAnsiProc: %s, Wnd %p, Message %u, wParam %Iu, lParam %Id, lParamBufferSize %d)\n",
        Proc, IsAnsiProc ? "TRUE" : "FALSE", Wnd, Message, wParam, lParam, lParamBufferSize);
@@ -312,20 +343,28 @@ co_IntCallWindowProc(WNDPROC Proc,
    if (lParamBufferSize != -1)
    {
       ArgumentLength = sizeof(WINDOWPROC_CALLBACK_ARGUMENTS) + lParamBufferSize;
-      Arguments = IntCbAllocateMemory(ArgumentLength);
-      if (NULL == Arguments)
+      if (lParamBufferSize <= WNDPROC_STACK_LPARAM_SIZE)
+      {
+         Arguments = &StackArguments.Arguments;
+      }
+      else
       {
-         ERR("Unable to allocate buffer for window proc callback\n");
-         return -1;
+         Arguments = IntCbAllocateMemory(ArgumentLength);
+         if (NULL == Arguments)
+         {
+            ERR("Unable to allocate buffer for window proc callback\n");
+            return -1;
+         }
       }
       RtlMoveMemory((PVOID) ((char *) Arguments + sizeof(WINDOWPROC_CALLBACK_ARGUMENTS)),
                     (PVOID) lParam, lParamBufferSize);
    }
    else
    {
-      Arguments = &StackArguments;
+      Arguments = &StackArguments.Arguments;
       ArgumentLength = sizeof(WINDOWPROC_CALLBACK_ARGUMENTS);
    }
+   WriteBack = (lParamBufferSize != -1 && IntWndProcWritesLParam(Message));
    Arguments->Proc = Proc;
    Arguments->IsAnsiProc = IsAnsiProc;
    Arguments->Wnd = Wnd;
@@ -354,8 +393,10 @@ co_IntCallWindowProc(WNDPROC Proc,
 
    _SEH2_TRY
    {
-      /* Simulate old behaviour: copy into our local buffer */
-      RtlMoveMemory(Arguments, ResultPointer, ArgumentLength);
+      /* Simulate old behaviour: copy into our local buffer. The lParam
+         buffer is only needed for the messages that write it back. */
+      RtlMoveMemory(Arguments, ResultPointer,
+                    WriteBack ? ArgumentLength : sizeof(WINDOWPROC_CALLBACK_ARGUMENTS));
    }
    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
    {
@@ -371,7 +412,7 @@ co_IntCallWindowProc(WNDPROC Proc,
    if (!NT_SUCCESS(Status))
    {
      ERR("Call to user mode failed! 0x%08lx\n",Status);
-      if (lParamBufferSize != -1)
+      if (Arguments != &StackArguments.Arguments)
       {
          IntCbFreeMemory(Arguments);
       }
@@ -379,52 +420,36 @@ co_IntCallWindowProc(WNDPROC Proc,
    }
    Result = Arguments->Result;
 
-   if (lParamBufferSize != -1)
+   if (WriteBack)
    {
       PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
       // Is this message being processed from inside kernel space?
       BOOL InSendMessage = (pti->pcti->CTI_flags & CTI_INSENDMESSAGE);
 
-      TRACE("Copy lParam Message %u lParam %d!\n", Message, lParam);
-      switch (Message)
+      TRACE("Copy lParam, Message %u Size %d lParam %d!\n", Message, lParamBufferSize, lParam);
+      if (InSendMessage)
+         // Copy into kernel space.
+         RtlMoveMemory((PVOID) lParam,
+                       (PVOID) ((char *) Arguments + sizeof(WINDOWPROC_CALLBACK_ARGUMENTS)),
+                        lParamBufferSize);
+      else
       {
-          default:
-            TRACE("Don't copy lParam, Message %u Size %d lParam %d!\n", Message, lParamBufferSize, lParam);
-            break;
-          // Write back to user/kernel space. Also see g_MsgMemory.
-          case WM_CREATE:
-          case WM_GETMINMAXINFO:
-          case WM_GETTEXT:
-          case WM_NCCALCSIZE:
-          case WM_NCCREATE:
-          case WM_STYLECHANGING:
-          case WM_WINDOWPOSCHANGING:
-          case WM_SIZING:
-          case WM_MOVING:
-          case WM_MEASUREITEM:
-          case WM_NEXTMENU:
-            TRACE("Copy lParam, Message %u Size %d lParam %d!\n", Message, lParamBufferSize, lParam);
-            if (InSendMessage)
-               // Copy into kernel space.
-               RtlMoveMemory((PVOID) lParam,
-                             (PVOID) ((char *) Arguments + sizeof(WINDOWPROC_CALLBACK_ARGUMENTS)),
-                              lParamBufferSize);
-            else
-            {
-             _SEH2_TRY
-             { // Copy into user space.
-               RtlMoveMemory((PVOID) lParam,
-                             (PVOID) ((char *) Arguments + sizeof(WINDOWPROC_CALLBACK_ARGUMENTS)),
-                              lParamBufferSize);
-             }
-             _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
-             {
-                ERR("Failed to copy lParam to user space, Message %u!\n", Message);
-             }
-             _SEH2_END;
-            }
-            break;
+       _SEH2_TRY
+       { // Copy into user space.
+         RtlMoveMemory((PVOID) lParam,
+                       (PVOID) ((char *) Arguments + sizeof(WINDOWPROC_CALLBACK_ARGUMENTS)),
+                        lParamBufferSize);
+       }
+       _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+       {
+          ERR("Failed to copy lParam to user space, Message %u!\n", Message);
+       }
+       _SEH2_END;
       }
+   }
+
+   if (Arguments != &StackArguments.Arguments)
+   {
       IntCbFreeMemory(Arguments);
    }
 
@@ -832,31 +857,34 @@ co_IntCallEventProc(HWINEVENTHOOK hook,
                                INT Mod,
                      ULONG_PTR offPfn)
 {
-   LRESULT Result = 0;
-   NTSTATUS Status;
-   PEVENTPROC_CALLBACK_ARGUMENTS Common;
-   ULONG ArgumentLength, ResultLength;
-   PVOID Argument, ResultPointer;
-
-   ArgumentLength = sizeof(EVENTPROC_CALLBACK_ARGUMENTS);
+   EVENTPROC_CALLBACK_ARGUMENTS Common;
+
+   Common.hook = hook;
+   Common.event = event;
+   Common.hwnd = hWnd;
+   Common.idObject = idObject;
+   Common.idChild = idChild;
+   Common.dwEventThread = dwEventThread;
+   Common.dwmsEventTime = dwmsEventTime;
+   Common.Proc = Proc;
+   Common.Mod = Mod;
+   Common.offPfn = offPfn;
+
+   return co_IntCallEventProcs(&Common, 1);
+}
 
-   Argument = IntCbAllocateMemory(ArgumentLength);
-   if (NULL == Argument)
-   {
-      ERR("EventProc callback failed: out of memory\n");
-      return 0;
-   }
-   Common = (PEVENTPROC_CALLBACK_ARGUMENTS) Argument;
-   Common->hook = hook;
-   Common->event = event;
-   Common->hwnd = hWnd;
-   Common->idObject = idObject;
-   Common->idChild = idChild;
-   Common->dwEventThread = dwEventThread;
-   Common->dwmsEventTime = dwmsEventTime;
-   Common->Proc = Proc;
-   Common->Mod = Mod;
-   Common->offPfn = offPfn;
+//
+// Deliver several events in one trip to user mode, user32 calls the
+// procedures in array order. The arguments are copied to the user stack
+// by KeUserModeCallback, so they do not need a callback buffer.
+//
+LRESULT
+APIENTRY
+co_IntCallEventProcs(PEVENTPROC_CALLBACK_ARGUMENTS Events, ULONG Count)
+{
+   NTSTATUS Status;
+   ULONG ResultLength;
+   PVOID ResultPointer;
 
    ResultPointer = NULL;
    ResultLength = sizeof(LRESULT);
@@ -864,21 +892,19 @@ co_IntCallEventProc(HWINEVENTHOOK hook,
    UserLeaveCo();
 
    Status = KeUserModeCallback(USER32_CALLBACK_EVENTPROC,
-                               Argument,
-                               ArgumentLength,
+                               Events,
+                               Count * sizeof(EVENTPROC_CALLBACK_ARGUMENTS),
                                &ResultPointer,
                                &ResultLength);
 
    UserEnterCo();
 
-   IntCbFreeMemory(Argument);
-
    if (!NT_SUCCESS(Status))
    {
-      return 0;
+      ERR("EventProc callback failed: 0x%lx\n", Status);
    }
 
-   return Result;
+   return 0;
 }
 
 //
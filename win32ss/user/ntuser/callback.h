@@ -46,6 +46,9 @@ co_IntCallEventProc(HWINEVENTHOOK hook,
                                INT Mod,
                      ULONG_PTR offPfn);
 
+LRESULT APIENTRY
+co_IntCallEventProcs(PEVENTPROC_CALLBACK_ARGUMENTS Events, ULONG Count);
+
 VOID FASTCALL
 IntCleanupThreadCallbacks(PTHREADINFO W32Thread);
 
@@ -1197,6 +1197,10 @@ NtUserConvertMemHandle(
 
     pMemObj->cbData = cbData;
 
+    /* Clipboard data can be huge. Copy it without holding up every other
+       GUI thread, the extra reference keeps the object alive meanwhile */
+    UserLeave();
+
     /* Copy data */
     _SEH2_TRY
     {
@@ -1205,19 +1209,18 @@ NtUserConvertMemHandle(
     }
     _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
     {
-        pMemObj = NULL;
+        hMem = NULL;
     }
     _SEH2_END;
 
-    /* Release the extra reference (UserCreateObject added 2 references) */
-    UserDereferenceObject(pMemObj);
+    UserEnterExclusive();
 
     /* If we failed to copy data, remove handle */
-    if (!pMemObj)
-    {
-        UserDeleteObject(hMem, TYPE_CLIPDATA);
-        hMem = NULL;
-    }
+    if (!hMem)
+        UserDeleteObject(pMemObj->head.h, TYPE_CLIPDATA);
+
+    /* Release the extra reference (UserCreateObject added 2 references) */
+    UserDereferenceObject(pMemObj);
 
 cleanup:
     UserLeave();
@@ -1235,16 +1238,20 @@ NtUserCreateLocalMemHandle(
     PCLIPBOARDDATA pMemObj;
     NTSTATUS Status = STATUS_SUCCESS;
 
-    UserEnterShared();
+    UserEnterExclusive();
 
     /* Get Clipboard data object */
-    pMemObj = (PCLIPBOARDDATA)UserGetObject(gHandleTable, hMem, TYPE_CLIPDATA);
+    pMemObj = (PCLIPBOARDDATA)UserReferenceObjectByHandle(hMem, TYPE_CLIPDATA);
     if (!pMemObj)
     {
-        Status = STATUS_INVALID_HANDLE;
-        goto cleanup;
+        UserLeave();
+        return STATUS_INVALID_HANDLE;
     }
 
+    /* The data does not change once the object exists. Copy it out without
+       holding the lock, our reference keeps the object alive meanwhile */
+    UserLeave();
+
     /* Don't overrun */
     if (cbData > pMemObj->cbData)
         cbData = pMemObj->cbData;
@@ -1267,7 +1274,8 @@ NtUserCreateLocalMemHandle(
     }
     _SEH2_END;
 
-cleanup:
+    UserEnterExclusive();
+    UserDereferenceObject(pMemObj);
     UserLeave();
 
     return Status;
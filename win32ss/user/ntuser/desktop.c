@@ -25,6 +25,9 @@ IntUnmapDesktopView(IN PDESKTOP pdesk);
 static VOID
 IntFreeDesktopHeap(IN PDESKTOP pdesk);
 
+static VOID
+IntInitDesktopSlabs(IN PDESKTOP pdesk);
+
 /* GLOBALS *******************************************************************/
 
 /* These can be changed via CSRSS startup, these are defaults */
@@ -38,6 +41,47 @@ PTHREADINFO gptiDesktopThread = NULL;
 HCURSOR gDesktopCursor = NULL;
 PKEVENT gpDesktopThreadStartedEvent = NULL;
 
+/* Header in front of every USER object allocated from a desktop heap */
+typedef struct _DESKOBJHEAD
+{
+    /* Slab the object belongs to, NULL if it has its own heap block */
+    struct _DESKTOP_SLAB *pslab;
+    ULONG cbObject;
+    USHORT Type;
+    USHORT Reserved;
+#ifndef _WIN64
+    ULONG Reserved2;
+#endif
+} DESKOBJHEAD, *PDESKOBJHEAD;
+
+C_ASSERT(sizeof(DESKOBJHEAD) % MEMORY_ALLOCATION_ALIGNMENT == 0);
+
+/* A slab is one heap block holding pClass->cSlots objects of the same size.
+   Free slots are linked through their DESKOBJHEAD. */
+typedef struct _DESKTOP_SLAB
+{
+    LIST_ENTRY ListEntry;
+    PDESKTOP_SLAB_CLASS pClass;
+    SINGLE_LIST_ENTRY FreeListHead;
+    ULONG cFree;
+} DESKTOP_SLAB, *PDESKTOP_SLAB;
+
+#define DESKTOP_SLAB_SIZE   4096
+#define DESKTOP_SLAB_HEADER ALIGN_UP_BY(sizeof(DESKTOP_SLAB), MEMORY_ALLOCATION_ALIGNMENT)
+
+static const struct
+{
+    HANDLE_TYPE Type;
+    ULONG cbObject;
+    PCSTR pszName;
+} DesktopSlabTypes[DESKTOP_SLAB_CLASSES] =
+{
+    { TYPE_WINDOW,   sizeof(WND),          "Window" },
+    { TYPE_MENU,     sizeof(MENU),         "Menu" },
+    { TYPE_HOOK,     sizeof(HOOK),         "Hook" },
+    { TYPE_CALLPROC, sizeof(CALLPROCDATA), "CallProc" },
+};
+
 /* OBJECT CALLBACKS **********************************************************/
 
 NTSTATUS
@@ -1768,6 +1812,207 @@ BOOL IntDeRegisterShellHookWindow(HWND hWnd)
     return FALSE;
 }
 
+static VOID
+IntInitDesktopSlabs(IN PDESKTOP pdesk)
+{
+    PDESKTOP_SLAB_CLASS pClass;
+    ULONG i;
+
+    for (i = 0; i < DESKTOP_SLAB_CLASSES; i++)
+    {
+        pClass = &pdesk->aSlabClass[i];
+        InitializeListHead(&pClass->SlabListHead);
+        pClass->pslabEmpty = NULL;
+        pClass->cbObject = DesktopSlabTypes[i].cbObject;
+        pClass->cbSlot = ALIGN_UP_BY(sizeof(DESKOBJHEAD) + pClass->cbObject,
+                                     MEMORY_ALLOCATION_ALIGNMENT);
+        pClass->cSlots = max(4, (DESKTOP_SLAB_SIZE - DESKTOP_SLAB_HEADER) / pClass->cbSlot);
+    }
+}
+
+static PDESKTOP_SLAB
+IntAllocDesktopSlab(IN PDESKTOP pdesk, IN PDESKTOP_SLAB_CLASS pClass)
+{
+    PDESKTOP_SLAB pslab;
+    PUCHAR pSlot;
+    ULONG i;
+
+    pslab = pClass->pslabEmpty;
+    if (pslab != NULL)
+    {
+        pClass->pslabEmpty = NULL;
+    }
+    else
+    {
+        pslab = DesktopHeapAlloc(pdesk, DESKTOP_SLAB_HEADER + pClass->cSlots * pClass->cbSlot);
+        if (pslab == NULL)
+            return NULL;
+
+        pslab->pClass = pClass;
+        pslab->FreeListHead.Next = NULL;
+        pSlot = (PUCHAR)pslab + DESKTOP_SLAB_HEADER + pClass->cSlots * pClass->cbSlot;
+        for (i = 0; i < pClass->cSlots; i++)
+        {
+            pSlot -= pClass->cbSlot;
+            PushEntryList(&pslab->FreeListHead, (PSINGLE_LIST_ENTRY)pSlot);
+        }
+        pslab->cFree = pClass->cSlots;
+        pdesk->cbSlabs += DESKTOP_SLAB_HEADER + pClass->cSlots * pClass->cbSlot;
+    }
+
+    InsertHeadList(&pClass->SlabListHead, &pslab->ListEntry);
+    return pslab;
+}
+
+/*
+ * DesktopObjectAlloc
+ *
+ * Allocates a USER object from the desktop heap. Fixed size objects
+ * (windows without extra bytes, menus, hooks and call procs) come from
+ * slabs of objects of the same size, everything else gets its own heap
+ * block. The memory is not zeroed.
+ */
+PVOID FASTCALL
+DesktopObjectAlloc(IN PDESKTOP pdesk, IN HANDLE_TYPE Type, IN SIZE_T Size)
+{
+    PDESKTOP_SLAB_CLASS pClass = NULL;
+    PDESKTOP_SLAB pslab = NULL;
+    PDESKOBJHEAD pHead;
+    PDESKTOP_HEAP_STATS pStats;
+    ULONG i;
+
+    ASSERT(Type < TYPE_CTYPES);
+
+    for (i = 0; i < DESKTOP_SLAB_CLASSES; i++)
+    {
+        if (DesktopSlabTypes[i].Type == Type && pdesk->aSlabClass[i].cbObject == Size)
+        {
+            pClass = &pdesk->aSlabClass[i];
+            break;
+        }
+    }
+
+    if (pClass != NULL)
+    {
+        if (IsListEmpty(&pClass->SlabListHead))
+            IntAllocDesktopSlab(pdesk, pClass);
+
+        if (!IsListEmpty(&pClass->SlabListHead))
+            pslab = CONTAINING_RECORD(pClass->SlabListHead.Flink, DESKTOP_SLAB, ListEntry);
+    }
+
+    pStats = &pdesk->aHeapStats[Type];
+
+    if (pslab != NULL)
+    {
+        pHead = (PDESKOBJHEAD)PopEntryList(&pslab->FreeListHead);
+        ASSERT(pHead != NULL);
+
+        /* Full slabs are not on any list, they come back when an object is freed */
+        if (--pslab->cFree == 0)
+            RemoveEntryList(&pslab->ListEntry);
+
+        pStats->cSlabObjects++;
+    }
+    else
+    {
+        /* Not a fixed size object, or the heap has no room for a whole slab */
+        pHead = DesktopHeapAlloc(pdesk, sizeof(DESKOBJHEAD) + Size);
+        if (pHead == NULL)
+            return NULL;
+    }
+
+    pHead->pslab = pslab;
+    pHead->cbObject = (ULONG)Size;
+    pHead->Type = (USHORT)Type;
+
+    pStats->cObjects++;
+    pStats->cbObjects += Size;
+
+    return pHead + 1;
+}
+
+VOID FASTCALL
+DesktopObjectFree(IN PDESKTOP pdesk, IN PVOID Object)
+{
+    PDESKOBJHEAD pHead = (PDESKOBJHEAD)Object - 1;
+    PDESKTOP_SLAB pslab = pHead->pslab;
+    PDESKTOP_SLAB_CLASS pClass;
+    PDESKTOP_HEAP_STATS pStats;
+
+    ASSERT(pHead->Type < TYPE_CTYPES);
+    pStats = &pdesk->aHeapStats[pHead->Type];
+    pStats->cObjects--;
+    pStats->cbObjects -= pHead->cbObject;
+
+    if (pslab == NULL)
+    {
+        DesktopHeapFree(pdesk, pHead);
+        return;
+    }
+
+    pStats->cSlabObjects--;
+    pClass = pslab->pClass;
+
+    PushEntryList(&pslab->FreeListHead, (PSINGLE_LIST_ENTRY)pHead);
+    if (pslab->cFree++ == 0)
+    {
+        /* The slab was full, it has room again */
+        InsertTailList(&pClass->SlabListHead, &pslab->ListEntry);
+    }
+    else if (pslab->cFree == pClass->cSlots)
+    {
+        /* Keep one empty slab for the next allocation, give the others back */
+        RemoveEntryList(&pslab->ListEntry);
+        if (pClass->pslabEmpty == NULL)
+        {
+            pClass->pslabEmpty = pslab;
+        }
+        else
+        {
+            pdesk->cbSlabs -= DESKTOP_SLAB_HEADER + pClass->cSlots * pClass->cbSlot;
+            DesktopHeapFree(pdesk, pslab);
+        }
+    }
+}
+
+#if DBG
+VOID
+UserDbgDumpDesktopHeapStats(VOID)
+{
+    PLIST_ENTRY Entry;
+    PDESKTOP pdesk;
+    PDESKTOP_HEAP_STATS pStats;
+    ULONG i;
+
+    if (InputWindowStation == NULL)
+        return;
+
+    for (Entry = InputWindowStation->DesktopListHead.Flink;
+         Entry != &InputWindowStation->DesktopListHead;
+         Entry = Entry->Flink)
+    {
+        pdesk = CONTAINING_RECORD(Entry, DESKTOP, ListEntry);
+
+        DbgPrint("Desktop %p (%S), heap %p, %lu KB in slabs\n",
+                 pdesk,
+                 pdesk->pDeskInfo ? pdesk->pDeskInfo->szDesktopName : L"",
+                 pdesk->pheapDesktop,
+                 (ULONG)(pdesk->cbSlabs / 1024));
+        DbgPrint("  %-10s %10s %10s %12s\n", "Type", "Objects", "In slabs", "Bytes");
+        for (i = 0; i < DESKTOP_SLAB_CLASSES; i++)
+        {
+            pStats = &pdesk->aHeapStats[DesktopSlabTypes[i].Type];
+            DbgPrint("  %-10s %10lu %10lu %12Iu\n",
+                     DesktopSlabTypes[i].pszName,
+                     pStats->cObjects,
+                     pStats->cSlabObjects,
+                     pStats->cbObjects);
+        }
+    }
+}
+#endif
+
 static VOID
 IntFreeDesktopHeap(IN OUT PDESKTOP Desktop)
 {
@@ -2240,6 +2485,8 @@ UserInitializeDesktop(PDESKTOP pdesk, PUNICODE_STRING DesktopName, PWINSTATION_O
         return STATUS_NO_MEMORY;
     }
 
+    IntInitDesktopSlabs(pdesk);
+
     /* Create DESKTOPINFO */
     DesktopInfoSize = sizeof(DESKTOPINFO) + DesktopName->Length + sizeof(WCHAR);
     pdesk->pDeskInfo = RtlAllocateHeap(pdesk->pheapDesktop,
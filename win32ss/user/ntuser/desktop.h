@@ -1,5 +1,32 @@
 #pragma once
 
+/*
+ * Windows, menus, hooks and call procs have a fixed size and make up most
+ * of the desktop heap. They are carved out of larger heap blocks (slabs)
+ * of objects of the same size, so that freeing them does not leave holes
+ * between the variable sized allocations. See DesktopObjectAlloc.
+ */
+#define DESKTOP_SLAB_CLASSES 4
+
+typedef struct _DESKTOP_SLAB_CLASS
+{
+    /* Slabs with at least one free slot */
+    LIST_ENTRY SlabListHead;
+    /* One completely free slab kept around to avoid heap churn */
+    struct _DESKTOP_SLAB *pslabEmpty;
+    ULONG cbObject;
+    ULONG cbSlot;
+    ULONG cSlots;
+} DESKTOP_SLAB_CLASS, *PDESKTOP_SLAB_CLASS;
+
+/* Desktop heap usage of the USER objects of one type */
+typedef struct _DESKTOP_HEAP_STATS
+{
+    ULONG cObjects;
+    ULONG cSlabObjects;
+    SIZE_T cbObjects;
+} DESKTOP_HEAP_STATS, *PDESKTOP_HEAP_STATS;
+
 typedef struct _DESKTOP
 {
     /* Must be the first member */
@@ -24,6 +51,11 @@ typedef struct _DESKTOP
     ULONG_PTR ulHeapSize;
     LIST_ENTRY PtiList;
 
+    /* Fixed size object allocator, see DesktopObjectAlloc */
+    DESKTOP_SLAB_CLASS aSlabClass[DESKTOP_SLAB_CLASSES];
+    SIZE_T cbSlabs;
+    DESKTOP_HEAP_STATS aHeapStats[TYPE_CTYPES];
+
     /* One console input thread per desktop, maintained by CONSRV */
     DWORD dwConsoleThreadId;
 
@@ -351,6 +383,12 @@ DesktopHeapAddressToUser(PVOID lpMem)
     return NULL;
 }
 
+PVOID FASTCALL DesktopObjectAlloc(PDESKTOP, HANDLE_TYPE, SIZE_T);
+VOID FASTCALL DesktopObjectFree(PDESKTOP, PVOID);
+#if DBG
+VOID UserDbgDumpDesktopHeapStats(VOID);
+#endif
+
 PWND FASTCALL IntGetThreadDesktopWindow(PTHREADINFO);
 PWND FASTCALL co_GetDesktopWindow(PWND);
 BOOL FASTCALL IntPaintDesktop(HDC);
@@ -17,6 +17,9 @@ typedef struct _EVENTPACK
   LONG idThread;
 } EVENTPACK, *PEVENTPACK;
 
+/* Maximum number of queued events delivered to user mode in one callback */
+#define EVENT_BATCH_MAX 16
+
 static PEVENTTABLE GlobalEvents = NULL;
 
 /* PRIVATE FUNCTIONS *********************************************************/
@@ -148,30 +151,55 @@ IntRemoveEvent(PVOID Object)
 //
 LRESULT
 APIENTRY
-co_EVENT_CallEvents( DWORD event,
-                     HWND hwnd,
-                     UINT_PTR idObject,
-                     LONG_PTR idChild)
+co_EVENT_CallEvents( PTHREADINFO pti,
+                     PWND Window,
+                     PMSG pMsg,
+                     LONG_PTR ExtraInfo)
 {
+   EVENTPROC_CALLBACK_ARGUMENTS Events[EVENT_BATCH_MAX];
+   PEVENTPROC_CALLBACK_ARGUMENTS Event;
    PEVENTHOOK pEH;
-   LRESULT Result;
-   PEVENTPACK pEP = (PEVENTPACK)idChild;
-
-   pEH = pEP->pEH;
-   TRACE("Dispatch Event 0x%lx, idObject %uI hwnd %p\n", event, idObject, hwnd);
-   Result = co_IntCallEventProc( UserHMGetHandle(pEH),
-                                 event,
-                                 hwnd,
-                                 pEP->idObject,
-                                 pEP->idChild,
-                                 pEP->idThread,
-                                 EngGetTickCount32(),
-                                 pEH->Proc,
-                                 pEH->ihmod,
-                                 pEH->offPfn);
-
-   ExFreePoolWithTag(pEP, TAG_HOOK);
-   return Result;
+   PEVENTPACK pEP;
+   MSG Msg = *pMsg;
+   DWORD dwQEvent;
+   ULONG Count = 0;
+
+   /* Out of context events are posted one by one. Pick up the ones that are
+      queued right behind this one, so that they all go to user mode in a
+      single callback instead of one round trip per event. */
+   for (;;)
+   {
+      pEP = (PEVENTPACK)ExtraInfo;
+      pEH = pEP->pEH;
+      TRACE("Dispatch Event 0x%lx, idObject %d hwnd %p\n", Msg.message, pEP->idObject, Msg.hwnd);
+
+      Event = &Events[Count++];
+      Event->hook = UserHMGetHandle(pEH);
+      Event->event = Msg.message;
+      Event->hwnd = Msg.hwnd;
+      Event->idObject = pEP->idObject;
+      Event->idChild = pEP->idChild;
+      Event->dwEventThread = pEP->idThread;
+      Event->dwmsEventTime = EngGetTickCount32();
+      Event->Proc = pEH->Proc;
+      Event->Mod = pEH->ihmod;
+      Event->offPfn = pEH->offPfn;
+
+      ExFreePoolWithTag(pEP, TAG_HOOK);
+
+      if (Count == EVENT_BATCH_MAX) break;
+
+      /* Only take the next system event if it is a WinEvent too, any
+         activation events in between must be handled in order. */
+      if (!MsqPeekMessage(pti, FALSE, Window, 0, 0, QS_EVENT, &ExtraInfo, &dwQEvent, &Msg) ||
+          dwQEvent != POSTEVENT_NWE)
+      {
+         break;
+      }
+      MsqPeekMessage(pti, TRUE, Window, 0, 0, QS_EVENT, &ExtraInfo, &dwQEvent, &Msg);
+   }
+
+   return co_IntCallEventProcs(Events, Count);
 }
 
 VOID
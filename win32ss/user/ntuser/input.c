@@ -21,6 +21,12 @@ HANDLE ghKeyboardDevice = NULL;
 static DWORD LastInputTick = 0;
 static HANDLE ghMouseDevice;
 
+/* Number of packets read from an input device at once. The class drivers
+   queue the packets that arrive while no read is pending, so a fast device
+   is drained in a few reads and the user lock is taken once per read. */
+#define MOUSE_INPUT_PACKETS 32
+#define KEYBOARD_INPUT_PACKETS 16
+
 /* FUNCTIONS *****************************************************************/
 
 /*
@@ -131,8 +137,9 @@ RawInputThreadMain(VOID)
     PVOID WaitObjects[4], pSignaledObject = NULL;
     KWAIT_BLOCK WaitBlockArray[RTL_NUMBER_OF(WaitObjects)];
     ULONG cWaitObjects = 0, cMaxWaitObjects = 2;
-    MOUSE_INPUT_DATA MouseInput;
-    KEYBOARD_INPUT_DATA KeyInput;
+    MOUSE_INPUT_DATA MouseInput[MOUSE_INPUT_PACKETS];
+    KEYBOARD_INPUT_DATA KeyInput[KEYBOARD_INPUT_PACKETS];
+    ULONG i, cPackets;
     PVOID ShutdownEvent;
     HWINSTA hWinSta;
 
@@ -224,8 +231,8 @@ RawInputThreadMain(VOID)
                                        NULL,
                                        NULL,
                                        &MouIosb,
-                                       &MouseInput,
-                                       sizeof(MOUSE_INPUT_DATA),
+                                       MouseInput,
+                                       sizeof(MouseInput),
                                        &ByteOffset,
                                        NULL);
             }
@@ -244,8 +251,8 @@ RawInputThreadMain(VOID)
                                        NULL,
                                        NULL,
                                        &KbdIosb,
-                                       &KeyInput,
-                                       sizeof(KEYBOARD_INPUT_DATA),
+                                       KeyInput,
+                                       sizeof(KeyInput),
                                        &ByteOffset,
                                        NULL);
 
@@ -298,14 +305,16 @@ RawInputThreadMain(VOID)
         /* Have we successed reading from mouse? */
         if (NT_SUCCESS(MouStatus) && MouStatus != STATUS_PENDING)
         {
-            TRACE("MouseEvent\n");
+            cPackets = (ULONG)(MouIosb.Information / sizeof(MOUSE_INPUT_DATA));
+            TRACE("MouseEvent: %lu packets\n", cPackets);
 
             /* Set LastInputTick */
             IntLastInputTick(TRUE);
 
             /* Process data */
             UserEnterExclusive();
-            UserProcessMouseInput(&MouseInput);
+            for (i = 0; i < cPackets; i++)
+                UserProcessMouseInput(&MouseInput[i]);
             UserLeave();
         }
         else if (MouStatus != STATUS_PENDING)
@@ -314,16 +323,20 @@ RawInputThreadMain(VOID)
         /* Have we successed reading from keyboard? */
         if (NT_SUCCESS(KbdStatus) && KbdStatus != STATUS_PENDING)
         {
-            TRACE("KeyboardEvent: %s %04x\n",
-                  (KeyInput.Flags & KEY_BREAK) ? "up" : "down",
-                  KeyInput.MakeCode);
+            cPackets = (ULONG)(KbdIosb.Information / sizeof(KEYBOARD_INPUT_DATA));
 
             /* Set LastInputTick */
             IntLastInputTick(TRUE);
 
             /* Process data */
             UserEnterExclusive();
-            UserProcessKeyboardInput(&KeyInput);
+            for (i = 0; i < cPackets; i++)
+            {
+                TRACE("KeyboardEvent: %s %04x\n",
+                      (KeyInput[i].Flags & KEY_BREAK) ? "up" : "down",
+                      KeyInput[i].MakeCode);
+                UserProcessKeyboardInput(&KeyInput[i]);
+            }
             UserLeave();
         }
         else if (KbdStatus != STATUS_PENDING)
@@ -483,6 +483,7 @@ InitThreadCallback(PETHREAD Thread)
     ptiCurrent->ppi->W32PF_flags |= W32PF_THREADCONNECTED;
 
     InitializeListHead(&ptiCurrent->WindowListHead);
+    InitializeListHead(&ptiCurrent->PaintListHead);
     InitializeListHead(&ptiCurrent->W32CallbackListHead);
     InitializeListHead(&ptiCurrent->PostedMessagesListHead);
     InitializeListHead(&ptiCurrent->SentMessagesListHead);
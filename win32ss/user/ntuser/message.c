@@ -659,7 +659,7 @@ static LRESULT handle_internal_events( PTHREADINFO pti, PWND pWnd, DWORD dwQEven
     {
        case POSTEVENT_NWE:
        {
-          co_EVENT_CallEvents( pMsg->message, pMsg->hwnd, pMsg->wParam, ExtraInfo);
+          co_EVENT_CallEvents( pti, pWnd, pMsg, ExtraInfo);
        }
        break;
        case POSTEVENT_SAW:
@@ -1061,6 +1061,10 @@ co_IntGetPeekMessage( PMSG pMsg,
     pti = PsGetCurrentThreadWin32Thread();
     pti->pClientInfo->cSpins++; // Bump up the spin count.
 
+    /* Whatever got painted for the last message ends the frame */
+    if (gppdevPrimary)
+        PDEVOBJ_vFlushDirtyRects(gppdevPrimary);
+
     do
     {
         Present = co_IntPeekMessage( pMsg,
@@ -252,7 +252,6 @@ NtUserGetThreadState(
          ret = (DWORD_PTR)IntGetThreadFocusWindow();
          break;
       case THREADSTATE_CAPTUREWINDOW:
-         /* FIXME: Should use UserEnterShared */
          ret = (DWORD_PTR)IntGetCapture();
          break;
       case THREADSTATE_PROGMANWINDOW:
@@ -754,6 +753,13 @@ NTAPI
 UserDbgPreServiceHook(ULONG ulSyscallId, PULONG_PTR pulArguments)
 {
     UserDbgAssertThreadInfo(FALSE);
+
+#if DBG
+    {
+        PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+        if (pti) pti->ulSyscall = (ulSyscallId & SERVICE_NUMBER_MASK) + 1;
+    }
+#endif
 }
 
 ULONG_PTR
@@ -766,6 +772,13 @@ UserDbgPostServiceHook(ULONG ulSyscallId, ULONG_PTR ulResult)
 
     UserDbgAssertThreadInfo(TRUE);
 
+#if DBG
+    {
+        PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+        if (pti) pti->ulSyscall = 0;
+    }
+#endif
+
     return ulResult;
 }
 
@@ -26,6 +26,31 @@ HINSTANCE hModClient = NULL;
 BOOL ClientPfnInit = FALSE;
 ATOM gaGuiConsoleWndClass;
 
+#if DBG
+/*
+ * UserLock hold times, accounted to the system call that acquired the lock.
+ * Time spent holding the lock after returning from a user mode callback is
+ * accounted to "no system call" since the hooks cannot tell which call the
+ * thread went back to.
+ */
+typedef struct _USER_LOCK_STATS
+{
+    ULONG cExclusive;
+    ULONG cShared;
+    LARGE_INTEGER liTotal;
+    LONGLONG llMax;
+} USER_LOCK_STATS, *PUSER_LOCK_STATS;
+
+#define SVC_(name, argcount) "Nt" #name,
+static PCSTR gapszSyscallNames[] = {
+    "(no system call)",
+#include "w32ksvc.h"
+};
+#undef SVC_
+
+static USER_LOCK_STATS gaUserLockStats[ARRAYSIZE(gapszSyscallNames)];
+#endif
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
 static
@@ -238,10 +263,82 @@ VOID FASTCALL CleanupUserImpl(VOID)
     ExDeleteResourceLite(&UserLock);
 }
 
+#if DBG
+static VOID
+UserDbgLockAcquired(BOOLEAN bShared)
+{
+    PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+
+    if (!pti || pti->cUserLockRecursion++ != 0)
+        return;
+
+    pti->ulUserLockSyscall = pti->ulSyscall;
+    pti->bUserLockShared = bShared;
+    pti->llUserLockAcquired = KeQueryPerformanceCounter(NULL).QuadPart;
+}
+
+static VOID
+UserDbgLockReleasing(VOID)
+{
+    PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+    PUSER_LOCK_STATS pStats;
+    LONGLONG llHeld;
+
+    /* The thread info can be created while the lock is held */
+    if (!pti || pti->cUserLockRecursion == 0 || --pti->cUserLockRecursion != 0)
+        return;
+
+    if (pti->ulUserLockSyscall >= ARRAYSIZE(gaUserLockStats))
+        return;
+
+    llHeld = KeQueryPerformanceCounter(NULL).QuadPart - pti->llUserLockAcquired;
+    pStats = &gaUserLockStats[pti->ulUserLockSyscall];
+
+    InterlockedIncrement((PLONG)(pti->bUserLockShared ? &pStats->cShared : &pStats->cExclusive));
+    ExInterlockedAddLargeStatistic(&pStats->liTotal, (ULONG)min(llHeld, MAXULONG));
+
+    /* Shared holders race here, good enough for statistics */
+    if (llHeld > pStats->llMax) pStats->llMax = llHeld;
+}
+
+VOID
+UserDbgDumpLockStats(BOOLEAN bReset)
+{
+    LARGE_INTEGER liFrequency;
+    ULONG i;
+
+    KeQueryPerformanceCounter(&liFrequency);
+
+    DbgPrint("UserLock hold times (us):\n");
+    DbgPrint("%-40s %10s %10s %12s %10s\n", "System call", "Exclusive", "Shared", "Total", "Max");
+    for (i = 0; i < ARRAYSIZE(gaUserLockStats); i++)
+    {
+        PUSER_LOCK_STATS pStats = &gaUserLockStats[i];
+
+        if (pStats->cExclusive == 0 && pStats->cShared == 0)
+            continue;
+
+        DbgPrint("%-40s %10lu %10lu %12I64u %10I64u\n",
+                 gapszSyscallNames[i],
+                 pStats->cExclusive,
+                 pStats->cShared,
+                 pStats->liTotal.QuadPart * 1000000 / liFrequency.QuadPart,
+                 pStats->llMax * 1000000 / liFrequency.QuadPart);
+    }
+
+    if (bReset)
+        RtlZeroMemory(gaUserLockStats, sizeof(gaUserLockStats));
+}
+#else
+#define UserDbgLockAcquired(bShared)
+#define UserDbgLockReleasing()
+#endif
+
 VOID FASTCALL UserEnterShared(VOID)
 {
     KeEnterCriticalRegion();
     ExAcquireResourceSharedLite(&UserLock, TRUE);
+    UserDbgLockAcquired(TRUE);
 }
 
 VOID FASTCALL UserEnterExclusive(VOID)
@@ -250,12 +347,14 @@ VOID FASTCALL UserEnterExclusive(VOID)
     KeEnterCriticalRegion();
     ExAcquireResourceExclusiveLite(&UserLock, TRUE);
     gptiCurrent = PsGetCurrentThreadWin32Thread();
+    UserDbgLockAcquired(FALSE);
 }
 
 VOID FASTCALL UserLeave(VOID)
 {
     ASSERT_NOGDILOCKS();
     ASSERT(UserIsEntered());
+    UserDbgLockReleasing();
     ExReleaseResourceLite(&UserLock);
     KeLeaveCriticalRegion();
 }
@@ -26,6 +26,9 @@ VOID FASTCALL UserEnterExclusive(VOID);
 VOID FASTCALL UserLeave(VOID);
 BOOL FASTCALL UserIsEntered(VOID);
 BOOL FASTCALL UserIsEnteredExclusive(VOID);
+#if DBG
+VOID UserDbgDumpLockStats(BOOLEAN bReset);
+#endif
 DWORD FASTCALL UserGetLanguageToggle(VOID);
 
 _Success_(return != FALSE)
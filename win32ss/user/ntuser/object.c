@@ -17,12 +17,14 @@ _Success_(return!=NULL)
 static PVOID AllocThreadObject(
     _In_ PDESKTOP pDesk,
     _In_ PTHREADINFO pti,
+    _In_ HANDLE_TYPE Type,
     _In_ SIZE_T Size,
     _Out_ PVOID* HandleOwner)
 {
     PTHROBJHEAD ObjHead;
 
     UNREFERENCED_PARAMETER(pDesk);
+    UNREFERENCED_PARAMETER(Type);
 
     ASSERT(Size > sizeof(*ObjHead));
     ASSERT(pti != NULL);
@@ -58,6 +60,7 @@ _Success_(return!=NULL)
 static PVOID AllocDeskThreadObject(
     _In_ PDESKTOP pDesk,
     _In_ PTHREADINFO pti,
+    _In_ HANDLE_TYPE Type,
     _In_ SIZE_T Size,
     _Out_ PVOID* HandleOwner)
 {
@@ -69,7 +72,7 @@ static PVOID AllocDeskThreadObject(
     if (!pDesk)
         pDesk = pti->rpdesk;
 
-    ObjHead = DesktopHeapAlloc(pDesk, Size);
+    ObjHead = DesktopObjectAlloc(pDesk, Type, Size);
     if (!ObjHead)
         return NULL;
 
@@ -93,7 +96,7 @@ static void FreeDeskThreadObject(
     PDESKTOP pDesk = ObjHead->rpdesk;
     PTHREADINFO pti = ObjHead->pti;
 
-    DesktopHeapFree(pDesk, Object);
+    DesktopObjectFree(pDesk, Object);
 
     pti->ppi->UserHandleCount--;
     IntDereferenceThreadInfo(pti);
@@ -103,6 +106,7 @@ _Success_(return!=NULL)
 static PVOID AllocDeskProcObject(
     _In_ PDESKTOP pDesk,
     _In_ PTHREADINFO pti,
+    _In_ HANDLE_TYPE Type,
     _In_ SIZE_T Size,
     _Out_ PVOID* HandleOwner)
 {
@@ -113,7 +117,7 @@ static PVOID AllocDeskProcObject(
     ASSERT(pDesk != NULL);
     ASSERT(pti != NULL);
 
-    ObjHead = DesktopHeapAlloc(pDesk, Size);
+    ObjHead = DesktopObjectAlloc(pDesk, Type, Size);
     if (!ObjHead)
         return NULL;
 
@@ -141,13 +145,14 @@ static void FreeDeskProcObject(
     ppi->UserHandleCount--;
     IntDereferenceProcessInfo(ppi);
 
-    DesktopHeapFree(pDesk, Object);
+    DesktopObjectFree(pDesk, Object);
 }
 
 _Success_(return!=NULL)
 static PVOID AllocProcMarkObject(
     _In_ PDESKTOP pDesk,
     _In_ PTHREADINFO pti,
+    _In_ HANDLE_TYPE Type,
     _In_ SIZE_T Size,
     _Out_ PVOID* HandleOwner)
 {
@@ -155,6 +160,7 @@ static PVOID AllocProcMarkObject(
     PPROCESSINFO ppi = pti->ppi;
 
     UNREFERENCED_PARAMETER(pDesk);
+    UNREFERENCED_PARAMETER(Type);
 
     ASSERT(Size > sizeof(*ObjHead));
 
@@ -187,12 +193,14 @@ _Success_(return!=NULL)
 static PVOID AllocSysObject(
     _In_ PDESKTOP pDesk,
     _In_ PTHREADINFO pti,
+    _In_ HANDLE_TYPE Type,
     _In_ SIZE_T Size,
     _Out_ PVOID* ObjectOwner)
 {
     PVOID Object;
 
     UNREFERENCED_PARAMETER(pDesk);
+    UNREFERENCED_PARAMETER(Type);
     UNREFERENCED_PARAMETER(pti);
 
     ASSERT(Size > sizeof(HEAD));
@@ -215,7 +223,7 @@ static void FreeSysObject(
 
 static const struct
 {
-    PVOID   (*ObjectAlloc)(PDESKTOP, PTHREADINFO, SIZE_T, PVOID*);
+    PVOID   (*ObjectAlloc)(PDESKTOP, PTHREADINFO, HANDLE_TYPE, SIZE_T, PVOID*);
     BOOLEAN (*ObjectDestroy)(PVOID);
     void    (*ObjectFree)(PVOID);
 } ObjectCallbacks[TYPE_CTYPES] =
@@ -307,18 +315,28 @@ void DbgUserDumpHandleTable(VOID)
 
 PUSER_HANDLE_ENTRY handle_to_entry(PUSER_HANDLE_TABLE ht, HANDLE handle )
 {
+   PUSER_HANDLE_ENTRY entry;
    unsigned short generation;
-   int index = (LOWORD(handle) - FIRST_USER_HANDLE) >> 1;
-   if (index < 0 || index >= ht->nb_handles)
+   /* Handles below FIRST_USER_HANDLE wrap around to a huge index */
+   ULONG index = (ULONG)(LOWORD(handle) - FIRST_USER_HANDLE) >> 1;
+
+   if (index >= (ULONG)ht->nb_handles)
       return NULL;
-   if (!ht->handles[index].type)
+   entry = &ht->handles[index];
+   if (!entry->type)
       return NULL;
    generation = HIWORD(handle);
-   if (generation == ht->handles[index].generation || !generation || generation == 0xffff)
-      return &ht->handles[index];
+   if (generation == entry->generation || !generation || generation == 0xffff)
+      return entry;
    return NULL;
 }
 
+/* The full handle of an entry found with handle_to_entry. Same as
+   entry_to_handle, but without turning the entry pointer back into an index:
+   FIRST_USER_HANDLE is even, so the low word only loses its lowest bit. */
+#define ENTRY_FULL_HANDLE(handle, entry) \
+   ((HANDLE)(ULONG_PTR)((LOWORD(handle) & ~1) | ((ULONG)(entry)->generation << 16)))
+
 __inline static HANDLE entry_to_handle(PUSER_HANDLE_TABLE ht, PUSER_HANDLE_ENTRY ptr )
 {
    int index = ptr - ht->handles;
@@ -483,7 +501,7 @@ HANDLE get_user_full_handle(PUSER_HANDLE_TABLE ht,  HANDLE handle )
       return handle;
    if (!(entry = handle_to_entry(ht, handle )))
       return handle;
-   return entry_to_handle( ht, entry );
+   return ENTRY_FULL_HANDLE(handle, entry);
 }
 
 
@@ -494,7 +512,7 @@ void *get_user_object_handle(PUSER_HANDLE_TABLE ht,  HANDLE* handle, HANDLE_TYPE
 
    if (!(entry = handle_to_entry(ht, *handle )) || entry->type != type)
       return NULL;
-   *handle = entry_to_handle( ht, entry );
+   *handle = ENTRY_FULL_HANDLE(*handle, entry);
    return entry->ptr;
 }
 
@@ -550,7 +568,7 @@ UserCreateObject( PUSER_HANDLE_TABLE ht,
 
    /* Allocate the object */
    ASSERT(ObjectCallbacks[type].ObjectAlloc != NULL);
-   Object = ObjectCallbacks[type].ObjectAlloc(pDesktop, pti, size, &ObjectOwner);
+   Object = ObjectCallbacks[type].ObjectAlloc(pDesktop, pti, type, size, &ObjectOwner);
    if (!Object)
    {
        ERR("User object allocation failed. Out of memory!\n");
@@ -758,6 +758,11 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
          MsqIncPaintCountQueue(Wnd->head.pti);
       }
 
+      if (Wnd->hrgnUpdate != NULL || Wnd->state & WNDS_INTERNALPAINT)
+      {
+         IntQueuePaintWindow(Wnd);
+      }
+
    }    // The following flags are used to validate the window.
    else if (Flags & (RDW_VALIDATE|RDW_NOINTERNALPAINT|RDW_NOERASE|RDW_NOFRAME))
    {
@@ -1110,6 +1115,28 @@ IntIsWindowDirty(PWND Wnd)
              Wnd->state & WNDS_INTERNALPAINT ) );
 }
 
+/*
+ * Every window that got an update region or the internal paint flag is put on
+ * its thread's paint list, so IntGetPaintMessage does not have to search the
+ * whole window tree. Entries are dropped lazily once the window has nothing
+ * left to paint, and when it is destroyed.
+ */
+VOID FASTCALL
+IntQueuePaintWindow(PWND Wnd)
+{
+   if (IsListEmpty(&Wnd->PaintListEntry))
+   {
+      InsertTailList(&Wnd->head.pti->PaintListHead, &Wnd->PaintListEntry);
+   }
+}
+
+VOID FASTCALL
+IntDequeuePaintWindow(PWND Wnd)
+{
+   RemoveEntryList(&Wnd->PaintListEntry);
+   InitializeListHead(&Wnd->PaintListEntry);
+}
+
 /*
    Conditions to paint any window:
 
@@ -1118,8 +1145,8 @@ IntIsWindowDirty(PWND Wnd)
    3. Paint count is not zero.
 
  */
-PWND FASTCALL
-IntFindWindowToRepaint(PWND Window, PTHREADINFO Thread)
+static PWND FASTCALL
+IntFindWindowToRepaintInTree(PWND Window, PTHREADINFO Thread)
 {
    PWND hChild;
    PWND TempWindow;
@@ -1150,7 +1177,7 @@ IntFindWindowToRepaint(PWND Window, PTHREADINFO Thread)
       /* find a child of the specified window that needs repainting */
       if (Window->spwndChild)
       {
-         hChild = IntFindWindowToRepaint(Window->spwndChild, Thread);
+         hChild = IntFindWindowToRepaintInTree(Window->spwndChild, Thread);
          if (hChild != NULL)
             return hChild;
       }
@@ -1158,6 +1185,59 @@ IntFindWindowToRepaint(PWND Window, PTHREADINFO Thread)
    return Window;
 }
 
+static PWND FASTCALL
+IntFindWindowToRepaint(PTHREADINFO Thread)
+{
+   PLIST_ENTRY Entry, NextEntry;
+   PWND Window, TempWindow;
+
+   for (Entry = Thread->PaintListHead.Flink;
+        Entry != &Thread->PaintListHead;
+        Entry = NextEntry)
+   {
+      NextEntry = Entry->Flink;
+      Window = CONTAINING_RECORD(Entry, WND, PaintListEntry);
+
+      if (Window->hrgnUpdate == NULL && !(Window->state & WNDS_INTERNALPAINT))
+      {
+         /* Validated since it was queued */
+         IntDequeuePaintWindow(Window);
+         continue;
+      }
+
+      if (!IntIsWindowDirty(Window))
+         continue;
+
+      /* Parents are painted before their children, as the tree walk does. */
+      for (TempWindow = Window->spwndParent;
+           TempWindow != NULL && !UserIsDesktopWindow(TempWindow);
+           TempWindow = TempWindow->spwndParent)
+      {
+         if (IntWndBelongsToThread(TempWindow, Thread) && IntIsWindowDirty(TempWindow))
+            Window = TempWindow;
+      }
+
+      /* Make sure all non-transparent siblings are already drawn. */
+      if (Window->ExStyle & WS_EX_TRANSPARENT)
+      {
+         for (TempWindow = Window->spwndNext; TempWindow != NULL;
+              TempWindow = TempWindow->spwndNext)
+         {
+            if (!(TempWindow->ExStyle & WS_EX_TRANSPARENT) &&
+                 IntWndBelongsToThread(TempWindow, Thread) &&
+                 IntIsWindowDirty(TempWindow))
+            {
+               return TempWindow;
+            }
+         }
+      }
+      return Window;
+   }
+
+   /* Not expected, but do not lose a paint if a window was never queued. */
+   return IntFindWindowToRepaintInTree(UserGetDesktopWindow(), Thread);
+}
+
 //
 // Internal painting of windows.
 //
@@ -1177,7 +1257,7 @@ IntGetPaintMessage(
    MSG *Message,
    BOOL Remove)
 {
-   PWND PaintWnd, StartWnd;
+   PWND PaintWnd;
 
    if ((MsgFilterMin != 0 || MsgFilterMax != 0) &&
          (MsgFilterMin > WM_PAINT || MsgFilterMax < WM_PAINT))
@@ -1188,8 +1268,7 @@ IntGetPaintMessage(
       ERR("WM_PAINT is in a System Thread!\n");
    }
 
-   StartWnd = UserGetDesktopWindow();
-   PaintWnd = IntFindWindowToRepaint(StartWnd, Thread);
+   PaintWnd = IntFindWindowToRepaint(Thread);
 
    Message->hwnd = PaintWnd ? UserHMGetHandle(PaintWnd) : NULL;
 
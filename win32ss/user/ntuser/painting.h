@@ -25,6 +25,8 @@ VOID FASTCALL co_IntPaintWindows(PWND Window, ULONG Flags, BOOL Recurse);
 VOID FASTCALL IntSendSyncPaint(PWND, ULONG);
 VOID FASTCALL co_IntUpdateWindows(PWND, ULONG, BOOL);
 BOOL FASTCALL IntIsWindowDirty(PWND);
+VOID FASTCALL IntQueuePaintWindow(PWND);
+VOID FASTCALL IntDequeuePaintWindow(PWND);
 BOOL FASTCALL IntEndPaint(PWND,PPAINTSTRUCT);
 HDC FASTCALL IntBeginPaint(PWND,PPAINTSTRUCT);
 PCURICON_OBJECT FASTCALL NC_IconForWindow( PWND );
@@ -0,0 +1,270 @@
+/*
+ * COPYRIGHT:        See COPYING in the top level directory
+ * PROJECT:          ReactOS Win32k subsystem
+ * PURPOSE:          Saved bits under CS_SAVEBITS windows
+ * FILE:             win32ss/user/ntuser/spb.c
+ */
+
+#include <win32k.h>
+DBG_DEFAULT_CHANNEL(UserPainting);
+
+/*
+ * When a top level window of a CS_SAVEBITS class (menus, tooltips, ...) is
+ * shown, the screen bits under it are copied to an off-screen bitmap. When
+ * the window is hidden again they are copied back, instead of having every
+ * window it covered repaint itself. Drawing under the window, or another
+ * window moving there, makes that part of the saved bits stale, and it is
+ * repainted the usual way.
+ */
+
+typedef struct _SPB
+{
+    struct _SPB *pspbNext;
+    PWND pwnd;
+    HBITMAP hbm;
+    /* Saved screen rectangle */
+    RECTL rcl;
+    /* The part of rcl the saved bits are still good for */
+    PREGION prgnValid;
+} SPB, *PSPB;
+
+static PSPB gpspbList = NULL;
+
+static PSPB
+SpbFind(PWND pwnd)
+{
+    PSPB pspb;
+
+    for (pspb = gpspbList; pspb != NULL; pspb = pspb->pspbNext)
+    {
+        if (pspb->pwnd == pwnd)
+            return pspb;
+    }
+    return NULL;
+}
+
+static VOID
+SpbDestroy(PSPB pspb)
+{
+    PSPB *ppspb;
+
+    for (ppspb = &gpspbList; *ppspb != NULL; ppspb = &(*ppspb)->pspbNext)
+    {
+        if (*ppspb == pspb)
+        {
+            *ppspb = pspb->pspbNext;
+            break;
+        }
+    }
+
+    pspb->pwnd->state &= ~WNDS_HASSPB;
+    GreDeleteObject(pspb->hbm);
+    REGION_Delete(pspb->prgnValid);
+    ExFreePoolWithTag(pspb, USERTAG_SPB);
+}
+
+/*
+ * SpbCreate
+ *
+ * Called right before pwnd becomes visible at pwnd->rcWindow.
+ */
+VOID FASTCALL
+SpbCreate(PWND pwnd)
+{
+    PWND pwndDesktop = UserGetDesktopWindow();
+    PSPB pspb;
+    RECTL rcl;
+    HDC hdcMem;
+    HBITMAP hbmOld;
+    BOOL bRet;
+
+    if (pwnd->state & WNDS_HASSPB)
+        SpbFree(pwnd);
+
+    if (pwndDesktop == NULL ||
+        pwnd->spwndParent != pwndDesktop ||
+        pwnd->head.rpdesk != gpdeskInputDesktop ||
+        !(pwnd->pcls->style & CS_SAVEBITS) ||
+        (pwnd->ExStyle & WS_EX_LAYERED))
+    {
+        return;
+    }
+
+    if (!RECTL_bIntersectRect(&rcl, &pwnd->rcWindow, &pwndDesktop->rcWindow))
+        return;
+
+    pspb = ExAllocatePoolWithTag(PagedPool, sizeof(SPB), USERTAG_SPB);
+    if (pspb == NULL)
+        return;
+
+    pspb->prgnValid = IntSysCreateRectpRgnIndirect(&rcl);
+    pspb->hbm = NtGdiCreateCompatibleBitmap(ScreenDeviceContext,
+                                            rcl.right - rcl.left,
+                                            rcl.bottom - rcl.top);
+    hdcMem = NtGdiCreateCompatibleDC(ScreenDeviceContext);
+
+    bRet = FALSE;
+    if (pspb->prgnValid != NULL && pspb->hbm != NULL && hdcMem != NULL)
+    {
+        hbmOld = NtGdiSelectBitmap(hdcMem, pspb->hbm);
+        bRet = NtGdiBitBlt(hdcMem,
+                           0, 0,
+                           rcl.right - rcl.left,
+                           rcl.bottom - rcl.top,
+                           ScreenDeviceContext,
+                           rcl.left, rcl.top,
+                           SRCCOPY,
+                           0,
+                           0);
+        NtGdiSelectBitmap(hdcMem, hbmOld);
+    }
+
+    if (hdcMem != NULL)
+        IntGdiDeleteDC(hdcMem, FALSE);
+
+    if (!bRet)
+    {
+        TRACE("Failed to save the bits under %p\n", pwnd);
+        if (pspb->hbm != NULL)
+            GreDeleteObject(pspb->hbm);
+        if (pspb->prgnValid != NULL)
+            REGION_Delete(pspb->prgnValid);
+        ExFreePoolWithTag(pspb, USERTAG_SPB);
+        return;
+    }
+
+    /* The window may outlive the process that showed it */
+    GreSetObjectOwner(pspb->hbm, GDI_OBJ_HMGR_PUBLIC);
+
+    pspb->pwnd = pwnd;
+    pspb->rcl = rcl;
+    pspb->pspbNext = gpspbList;
+    gpspbList = pspb;
+    pwnd->state |= WNDS_HASSPB;
+}
+
+VOID FASTCALL
+SpbFree(PWND pwnd)
+{
+    PSPB pspb = SpbFind(pwnd);
+
+    if (pspb != NULL)
+        SpbDestroy(pspb);
+}
+
+/*
+ * SpbCheckRect
+ *
+ * Something is about to change the screen bits in prcl (all of the screen
+ * if NULL) on behalf of pwnd. Drop that area from the saved bits of every
+ * other window. The window itself and its children draw on top of the bits
+ * saved for it, so they are left alone.
+ */
+VOID FASTCALL
+SpbCheckRect(PWND pwnd, const RECTL *prcl)
+{
+    PSPB pspb, pspbNext;
+    PREGION prgn;
+    RECTL rcl;
+    INT RgnType;
+
+    for (pspb = gpspbList; pspb != NULL; pspb = pspbNext)
+    {
+        pspbNext = pspb->pspbNext;
+
+        if (pwnd != NULL &&
+            (pwnd == pspb->pwnd || IntIsChildWindow(pspb->pwnd, pwnd)))
+        {
+            continue;
+        }
+
+        if (prcl == NULL)
+        {
+            SpbDestroy(pspb);
+            continue;
+        }
+
+        if (!RECTL_bIntersectRect(&rcl, prcl, &pspb->rcl))
+            continue;
+
+        RgnType = ERROR;
+        prgn = IntSysCreateRectpRgnIndirect(&rcl);
+        if (prgn != NULL)
+        {
+            RgnType = IntGdiCombineRgn(pspb->prgnValid, pspb->prgnValid, prgn, RGN_DIFF);
+            REGION_Delete(prgn);
+        }
+
+        if (RgnType == ERROR || RgnType == NULLREGION)
+            SpbDestroy(pspb);
+    }
+}
+
+/*
+ * SpbRestore
+ *
+ * pwnd is being hidden and prgnExposed, relative to pwnd->rcWindow, is
+ * what becomes visible. Copies back the still valid saved bits, removes
+ * them from prgnExposed and frees the saved bits. Returns the complexity
+ * of what is left to repaint.
+ */
+INT FASTCALL
+SpbRestore(PWND pwnd, PREGION prgnExposed)
+{
+    PSPB pspb = SpbFind(pwnd);
+    PREGION prgnRestore;
+    HDC hdcMem;
+    HBITMAP hbmOld;
+    PRECTL prcl;
+    ULONG i;
+    INT RgnType;
+
+    if (pspb == NULL)
+        return REGION_Complexity(prgnExposed);
+
+    REGION_bOffsetRgn(prgnExposed, pwnd->rcWindow.left, pwnd->rcWindow.top);
+
+    prgnRestore = IntSysCreateRectpRgn(0, 0, 0, 0);
+    if (prgnRestore != NULL)
+    {
+        RgnType = IntGdiCombineRgn(prgnRestore, prgnExposed, pspb->prgnValid, RGN_AND);
+        hdcMem = NtGdiCreateCompatibleDC(ScreenDeviceContext);
+
+        if (RgnType != ERROR && RgnType != NULLREGION && hdcMem != NULL)
+        {
+            hbmOld = NtGdiSelectBitmap(hdcMem, pspb->hbm);
+
+            prcl = prgnRestore->Buffer;
+            for (i = 0; i < prgnRestore->rdh.nCount; i++, prcl++)
+            {
+                NtGdiBitBlt(ScreenDeviceContext,
+                            prcl->left, prcl->top,
+                            prcl->right - prcl->left,
+                            prcl->bottom - prcl->top,
+                            hdcMem,
+                            prcl->left - pspb->rcl.left,
+                            prcl->top - pspb->rcl.top,
+                            SRCCOPY,
+                            0,
+                            0);
+            }
+
+            NtGdiSelectBitmap(hdcMem, hbmOld);
+
+            /* What was copied back does not need to be repainted */
+            IntGdiCombineRgn(prgnExposed, prgnExposed, prgnRestore, RGN_DIFF);
+        }
+
+        if (hdcMem != NULL)
+            IntGdiDeleteDC(hdcMem, FALSE);
+        REGION_Delete(prgnRestore);
+    }
+
+    RgnType = REGION_Complexity(prgnExposed);
+    REGION_bOffsetRgn(prgnExposed, -pwnd->rcWindow.left, -pwnd->rcWindow.top);
+
+    SpbDestroy(pspb);
+    return RgnType;
+}
+
+/* EOF */
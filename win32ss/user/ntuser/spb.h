@@ -0,0 +1,15 @@
+/*
+ * COPYRIGHT:        See COPYING in the top level directory
+ * PROJECT:          ReactOS Win32k subsystem
+ * PURPOSE:          Saved bits under CS_SAVEBITS windows interface definition
+ * FILE:             win32ss/user/ntuser/spb.h
+ */
+
+#pragma once
+
+VOID FASTCALL SpbCreate(PWND pwnd);
+VOID FASTCALL SpbFree(PWND pwnd);
+VOID FASTCALL SpbCheckRect(PWND pwnd, const RECTL *prcl);
+INT FASTCALL SpbRestore(PWND pwnd, PREGION prgnExposed);
+
+/* EOF */
@@ -14,7 +14,20 @@ DBG_DEFAULT_CHANNEL(UserTimer);
 /* GLOBALS *******************************************************************/
 
 static LIST_ENTRY TimersListHead;
-static LONG TimeLast = 0;
+
+/* Armed timers, in a binary min-heap ordered by ullDueTime */
+static PTIMER        *TimerHeap = NULL;
+static ULONG          TimerHeapCount = 0;
+static ULONG          TimerHeapSize = 0;
+
+#define TIMER_NOT_QUEUED    ((ULONG)-1)
+
+/* All timers, hashed by window and id for FindTimer */
+#define TIMER_HASH_SIZE     64
+#define TIMER_HASH(pWnd, nID) \
+  ((((ULONG_PTR)(pWnd) >> 4) ^ (ULONG_PTR)(nID)) & (TIMER_HASH_SIZE - 1))
+
+static LIST_ENTRY     TimerHashTable[TIMER_HASH_SIZE];
 
 /* Windows 2000 has room for 32768 window-less timers */
 #define NUM_WINDOW_LESS_TIMERS   32768
@@ -46,10 +59,138 @@ ERESOURCE TimerLock;
 
 
 /* FUNCTIONS *****************************************************************/
+static
+VOID
+FASTCALL
+TimerHeapSet(ULONG Index, PTIMER pTmr)
+{
+  TimerHeap[Index] = pTmr;
+  pTmr->iHeap = Index;
+}
+
+static
+VOID
+FASTCALL
+TimerHeapSiftUp(ULONG Index)
+{
+  PTIMER pTmr = TimerHeap[Index];
+  ULONG Parent;
+
+  while (Index > 0)
+  {
+     Parent = (Index - 1) / 2;
+     if (TimerHeap[Parent]->ullDueTime <= pTmr->ullDueTime) break;
+     TimerHeapSet(Index, TimerHeap[Parent]);
+     Index = Parent;
+  }
+  TimerHeapSet(Index, pTmr);
+}
+
+static
+VOID
+FASTCALL
+TimerHeapSiftDown(ULONG Index)
+{
+  PTIMER pTmr = TimerHeap[Index];
+  ULONG Child;
+
+  while ((Child = 2 * Index + 1) < TimerHeapCount)
+  {
+     if (Child + 1 < TimerHeapCount &&
+         TimerHeap[Child + 1]->ullDueTime < TimerHeap[Child]->ullDueTime)
+        Child++;
+     if (pTmr->ullDueTime <= TimerHeap[Child]->ullDueTime) break;
+     TimerHeapSet(Index, TimerHeap[Child]);
+     Index = Child;
+  }
+  TimerHeapSet(Index, pTmr);
+}
+
+//
+// Queue the timer to expire cmsRate from now, or move it if it is queued.
+// Has to be called with the timer lock held.
+//
+static
+BOOL
+FASTCALL
+ArmTimer(PTIMER pTmr)
+{
+  ULONGLONG OldDueTime = pTmr->ullDueTime;
+  PTIMER *NewHeap;
+  ULONG NewSize;
+
+  pTmr->ullDueTime = KeQueryInterruptTime() + (ULONGLONG)pTmr->cmsRate * 10000;
+
+  if (pTmr->iHeap == TIMER_NOT_QUEUED)
+  {
+     if (TimerHeapCount == TimerHeapSize)
+     {
+        NewSize = TimerHeapSize ? TimerHeapSize * 2 : 64;
+        NewHeap = ExAllocatePoolWithTag(PagedPool, NewSize * sizeof(PTIMER), USERTAG_TIMER);
+        if (!NewHeap) return FALSE;
+        if (TimerHeap)
+        {
+           RtlCopyMemory(NewHeap, TimerHeap, TimerHeapCount * sizeof(PTIMER));
+           ExFreePoolWithTag(TimerHeap, USERTAG_TIMER);
+        }
+        TimerHeap = NewHeap;
+        TimerHeapSize = NewSize;
+     }
+     TimerHeapSet(TimerHeapCount++, pTmr);
+     TimerHeapSiftUp(pTmr->iHeap);
+  }
+  else if (pTmr->ullDueTime < OldDueTime)
+     TimerHeapSiftUp(pTmr->iHeap);
+  else
+     TimerHeapSiftDown(pTmr->iHeap);
+
+  return TRUE;
+}
+
+static
+VOID
+FASTCALL
+DisarmTimer(PTIMER pTmr)
+{
+  ULONG Index = pTmr->iHeap;
+  PTIMER pLast;
+
+  if (Index == TIMER_NOT_QUEUED) return;
+
+  pTmr->iHeap = TIMER_NOT_QUEUED;
+  pLast = TimerHeap[--TimerHeapCount];
+  if (pLast != pTmr)
+  {
+     TimerHeapSet(Index, pLast);
+     TimerHeapSiftUp(Index);
+     TimerHeapSiftDown(pLast->iHeap);
+  }
+}
+
+//
+// Program the master timer for the earliest expiry. If the heap is empty the
+// master timer is left alone, an extra wakeup does no harm.
+//
+static
+VOID
+FASTCALL
+ProgramMasterTimer(VOID)
+{
+  LARGE_INTEGER DueTime;
+  LONGLONG Delta;
+
+  ASSERT(MasterTimer != NULL);
+  if (TimerHeapCount == 0) return;
+
+  Delta = (LONGLONG)(TimerHeap[0]->ullDueTime - KeQueryInterruptTime());
+  DueTime.QuadPart = -max(Delta, 1);
+  KeSetTimer(MasterTimer, DueTime, NULL);
+}
+
 static
 PTIMER
 FASTCALL
-CreateTimer(VOID)
+CreateTimer(PWND Window, UINT_PTR nID)
 {
   HANDLE Handle;
   PTIMER Ret = NULL;
@@ -58,7 +199,11 @@ CreateTimer(VOID)
   if (Ret)
   {
      Ret->head.h = Handle;
+     Ret->pWnd   = Window;
+     Ret->nID    = nID;
+     Ret->iHeap  = TIMER_NOT_QUEUED;
      InsertTailList(&TimersListHead, &Ret->ptmrList);
+     InsertTailList(&TimerHashTable[TIMER_HASH(Window, nID)], &Ret->ptmrHash);
   }
 
   return Ret;
@@ -74,6 +219,8 @@ RemoveTimer(PTIMER pTmr)
   {
      /* Set the flag, it will be removed when ready */
      RemoveEntryList(&pTmr->ptmrList);
+     RemoveEntryList(&pTmr->ptmrHash);
+     DisarmTimer(pTmr);
      if ((pTmr->pWnd == NULL) && (!(pTmr->flags & TMRF_SYSTEM))) // System timers are reusable.
      {
         UINT_PTR IDEvent;
@@ -97,14 +244,15 @@ FindTimer(PWND Window,
           UINT_PTR nID,
           UINT flags)
 {
-  PLIST_ENTRY pLE;
+  PLIST_ENTRY pLE, pHead;
   PTIMER pTmr, RetTmr = NULL;
 
   TimerEnterExclusive();
-  pLE = TimersListHead.Flink;
-  while (pLE != &TimersListHead)
+  pHead = &TimerHashTable[TIMER_HASH(Window, nID)];
+  pLE = pHead->Flink;
+  while (pLE != pHead)
   {
-    pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
+    pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrHash);
 
     if ( pTmr->nID == nID &&
          pTmr->pWnd == Window &&
@@ -182,8 +330,6 @@ IntSetTimer( PWND Window,
 {
   PTIMER pTmr;
   UINT Ret = IDEvent;
-  LARGE_INTEGER DueTime;
-  DueTime.QuadPart = (LONGLONG)(-97656); // 1024hz .9765625 ms set to 10.0 ms
 
 #if 0
   /* Windows NT/2k/XP behaviour */
@@ -213,6 +359,7 @@ IntSetTimer( PWND Window,
   if ((Window) && (IDEvent == 0))
      Ret = 1;
 
+  TimerEnterExclusive();
   pTmr = FindTimer(Window, IDEvent, Type);
 
   if ((!pTmr) && (Window == NULL) && (!(Type & TMRF_SYSTEM)))
@@ -224,6 +371,7 @@ IntSetTimer( PWND Window,
       if (IDEvent == (UINT_PTR) -1)
       {
          IntUnlockWindowlessTimerBitmap();
+         TimerLeave();
          ERR("Unable to find a free window-less timer id\n");
          EngSetLastError(ERROR_NO_SYSTEM_RESOURCES);
          ASSERT(FALSE);
@@ -238,8 +386,12 @@ IntSetTimer( PWND Window,
 
   if (!pTmr)
   {
-     pTmr = CreateTimer();
-     if (!pTmr) return 0;
+     pTmr = CreateTimer(Window, IDEvent);
+     if (!pTmr)
+     {
+        TimerLeave();
+        return 0;
+     }
 
      if (Window && (Type & TMRF_TIFROMWND))
         pTmr->pti = Window->head.pti->pEThread->Tcb.Win32Thread;
@@ -251,24 +403,29 @@ IntSetTimer( PWND Window,
            pTmr->pti = PsGetCurrentThreadWin32Thread();
      }
 
-     pTmr->pWnd    = Window;
-     pTmr->cmsCountdown = Elapse;
      pTmr->cmsRate = Elapse;
      pTmr->pfn     = TimerFunc;
-     pTmr->nID     = IDEvent;
-     pTmr->flags   = Type|TMRF_INIT;
+     pTmr->flags   = Type;
   }
   else
   {
-     pTmr->cmsCountdown = Elapse;
      pTmr->cmsRate = Elapse;
+     pTmr->flags &= ~TMRF_WAITING;
   }
 
-  ASSERT(MasterTimer != NULL);
-  // Start the timer thread!
-  if (TimersListHead.Flink == TimersListHead.Blink) // There is only one timer
-     KeSetTimer(MasterTimer, DueTime, NULL);
+  if (!ArmTimer(pTmr))
+  {
+     RemoveTimer(pTmr);
+     TimerLeave();
+     EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
+     return 0;
+  }
 
+  // Wake the timer thread earlier if this is now the first timer to expire.
+  if (pTmr->iHeap == 0)
+     ProgramMasterTimer();
+
+  TimerLeave();
   return Ret;
 }
 
@@ -445,74 +602,52 @@ VOID
 FASTCALL
 ProcessTimers(VOID)
 {
-  LARGE_INTEGER DueTime;
-  LONG Time;
-  PLIST_ENTRY pLE;
+  ULONGLONG Time;
   PTIMER pTmr;
   LONG TimerCount = 0;
 
   TimerEnterExclusive();
-  pLE = TimersListHead.Flink;
-  Time = EngGetTickCount32();
-
-  DueTime.QuadPart = (LONGLONG)(-97656); // 1024hz .9765625 ms set to 10.0 ms
+  Time = KeQueryInterruptTime();
 
-  while(pLE != &TimersListHead)
+  // Only the timers that are due are looked at, they are at the top of the heap.
+  while (TimerHeapCount != 0 && TimerHeap[0]->ullDueTime <= Time)
   {
-    pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
+    pTmr = TimerHeap[0];
     TimerCount++;
-    if (pTmr->flags & TMRF_WAITING)
-    {
-       pLE = pTmr->ptmrList.Flink;
-       pTmr = CONTAINING_RECORD(pLE, TIMER, ptmrList);
-       continue;
-    }
+    ASSERT(pTmr->pti);
 
-    if (pTmr->flags & TMRF_INIT)
+    // Requeue the timer first, a RIT timer procedure may kill it.
+    if (pTmr->flags & TMRF_ONESHOT)
     {
-       pTmr->flags &= ~TMRF_INIT; // Skip this run.
+       pTmr->flags |= TMRF_WAITING;
+       DisarmTimer(pTmr);
     }
     else
+       ArmTimer(pTmr); // Already queued, can not fail.
+
+    if ((!(pTmr->flags & TMRF_READY)) && (!(pTmr->pti->TIF_flags & TIF_INCLEANUP)))
     {
-       if (pTmr->cmsCountdown < 0)
+       if (pTmr->flags & TMRF_RIT)
        {
-          ASSERT(pTmr->pti);
-          if ((!(pTmr->flags & TMRF_READY)) && (!(pTmr->pti->TIF_flags & TIF_INCLEANUP)))
-          {
-             if (pTmr->flags & TMRF_ONESHOT)
-                pTmr->flags |= TMRF_WAITING;
-
-             if (pTmr->flags & TMRF_RIT)
-             {
-                // Hard coded call here, inside raw input thread.
-                pTmr->pfn(NULL, WM_SYSTIMER, pTmr->nID, (LPARAM)pTmr);
-             }
-             else
-             {
-                pTmr->flags |= TMRF_READY; // Set timer ready to be ran.
-                // Set thread message queue for this timer.
-                if (pTmr->pti)
-                {  // Wakeup thread
-                   pTmr->pti->cTimersReady++;
-                   ASSERT(pTmr->pti->pEventQueueServer != NULL);
-                   MsqWakeQueue(pTmr->pti, QS_TIMER, TRUE);
-                }
-             }
-          }
-          pTmr->cmsCountdown = pTmr->cmsRate;
+          // Hard coded call here, inside raw input thread.
+          pTmr->pfn(NULL, WM_SYSTIMER, pTmr->nID, (LPARAM)pTmr);
        }
        else
-          pTmr->cmsCountdown -= Time - TimeLast;
+       {
+          pTmr->flags |= TMRF_READY; // Set timer ready to be ran.
+          // Set thread message queue for this timer.
+          if (pTmr->pti)
+          {  // Wakeup thread
+             pTmr->pti->cTimersReady++;
+             ASSERT(pTmr->pti->pEventQueueServer != NULL);
+             MsqWakeQueue(pTmr->pti, QS_TIMER, TRUE);
+          }
+       }
     }
-
-    pLE = pLE->Flink;
   }
 
-  // Restart the timer thread!
-  ASSERT(MasterTimer != NULL);
-  KeSetTimer(MasterTimer, DueTime, NULL);
-
-  TimeLast = Time;
+  // Restart the timer thread for the next expiry!
+  ProgramMasterTimer();
 
   TimerLeave();
   TRACE("TimerCount = %d\n", TimerCount);
@@ -593,7 +728,7 @@ NTSTATUS
 NTAPI
 InitTimerImpl(VOID)
 {
-   ULONG BitmapBytes;
+   ULONG BitmapBytes, i;
 
    /* Allocate FAST_MUTEX from non paged pool */
    Mutex = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
@@ -620,6 +755,8 @@ InitTimerImpl(VOID)
 
    ExInitializeResourceLite(&TimerLock);
    InitializeListHead(&TimersListHead);
+   for (i = 0; i < TIMER_HASH_SIZE; i++)
+      InitializeListHead(&TimerHashTable[i]);
 
    return STATUS_SUCCESS;
 }
@@ -4,10 +4,12 @@ typedef struct _TIMER
 {
   HEAD           head;
   LIST_ENTRY     ptmrList;
+  LIST_ENTRY     ptmrHash;     // Entry in the (pWnd, nID) hash bucket.
   PTHREADINFO    pti;
   PWND           pWnd;         // hWnd
   UINT_PTR       nID;          // Specifies a nonzero timer identifier.
-  INT            cmsCountdown; // uElapse
+  ULONGLONG      ullDueTime;   // Interrupt time of the next expiry.
+  ULONG          iHeap;        // Index in the expiry heap, TIMER_NOT_QUEUED if not armed.
   INT            cmsRate;      // uElapse
   FLONG          flags;
   TIMERPROC      pfn;          // lpTimerFunc
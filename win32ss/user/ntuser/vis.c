@@ -9,8 +9,152 @@
 #include <win32k.h>
 DBG_DEFAULT_CHANNEL(UserWinpos);
 
+/*
+ * Small cache of computed visible regions. Every entry is keyed by a hash of
+ * all the window state VIS_ComputeVisibleRegion looks at, so a stale entry
+ * never matches. The window position code additionally flushes the cache
+ * whenever it moves, shows, hides or reshapes a window.
+ * Protected by the user lock.
+ */
+#define VIS_CACHE_ENTRIES 8
+
+#define VIS_CLIENTAREA    0x1
+#define VIS_CLIPCHILDREN  0x2
+#define VIS_CLIPSIBLINGS  0x4
+
+typedef struct _VIS_CACHE_ENTRY
+{
+   PWND Wnd;
+   ULONG Flags;
+   ULONG_PTR Hash;
+   PREGION VisRgn;
+} VIS_CACHE_ENTRY, *PVIS_CACHE_ENTRY;
+
+static VIS_CACHE_ENTRY VisCache[VIS_CACHE_ENTRIES];
+static ULONG VisCacheNext = 0;
+
+#define VIS_HASH(Hash, Value) \
+   ((Hash) = ((Hash) ^ (ULONG_PTR)(Value)) * (ULONG_PTR)0x01000193)
+
+static
+VOID
+VIS_HashRect(
+   PULONG_PTR Hash,
+   const RECTL *Rect)
+{
+   VIS_HASH(*Hash, Rect->left);
+   VIS_HASH(*Hash, Rect->top);
+   VIS_HASH(*Hash, Rect->right);
+   VIS_HASH(*Hash, Rect->bottom);
+}
+
+static
+VOID
+VIS_HashClipWindow(
+   PULONG_PTR Hash,
+   PWND Wnd)
+{
+   VIS_HASH(*Hash, Wnd);
+   VIS_HASH(*Hash, Wnd->style);
+   VIS_HASH(*Hash, Wnd->ExStyle);
+   VIS_HASH(*Hash, Wnd->hrgnClip);
+   VIS_HashRect(Hash, &Wnd->rcWindow);
+}
+
+/*
+ * Walks the same windows as VIS_ComputeVisibleRegion and hashes everything
+ * that affects the result. Returns FALSE if the result must not be cached.
+ */
+static
+BOOL
+VIS_bHashVisibleRegion(
+   PWND Wnd,
+   ULONG Flags,
+   PULONG_PTR Hash)
+{
+   PWND PreviousWindow, CurrentWindow, CurrentSibling;
+
+   *Hash = (ULONG_PTR)0x811C9DC5;
+   VIS_HASH(*Hash, Flags);
+   VIS_HashClipWindow(Hash, Wnd);
+   VIS_HashRect(Hash, &Wnd->rcClient);
+
+   PreviousWindow = Wnd;
+   CurrentWindow = Wnd->spwndParent;
+   while (CurrentWindow)
+   {
+      if (!VerifyWnd(CurrentWindow) || !(CurrentWindow->style & WS_VISIBLE))
+      {
+         return FALSE;
+      }
+
+      VIS_HASH(*Hash, CurrentWindow);
+      VIS_HASH(*Hash, CurrentWindow->style);
+      VIS_HashRect(Hash, &CurrentWindow->rcClient);
+
+      if ((PreviousWindow->style & WS_CLIPSIBLINGS) ||
+          (PreviousWindow == Wnd && (Flags & VIS_CLIPSIBLINGS)))
+      {
+         for (CurrentSibling = CurrentWindow->spwndChild;
+              CurrentSibling != NULL && CurrentSibling != PreviousWindow;
+              CurrentSibling = CurrentSibling->spwndNext)
+         {
+            VIS_HashClipWindow(Hash, CurrentSibling);
+         }
+      }
+
+      PreviousWindow = CurrentWindow;
+      CurrentWindow = CurrentWindow->spwndParent;
+   }
+
+   if (Flags & VIS_CLIPCHILDREN)
+   {
+      for (CurrentWindow = Wnd->spwndChild;
+           CurrentWindow != NULL;
+           CurrentWindow = CurrentWindow->spwndNext)
+      {
+         VIS_HashClipWindow(Hash, CurrentWindow);
+      }
+   }
+
+   return TRUE;
+}
+
+VOID FASTCALL
+VIS_InvalidateCache(VOID)
+{
+   ULONG i;
+
+   for (i = 0; i < VIS_CACHE_ENTRIES; i++)
+   {
+      if (VisCache[i].VisRgn)
+      {
+         REGION_Delete(VisCache[i].VisRgn);
+         VisCache[i].VisRgn = NULL;
+      }
+      VisCache[i].Wnd = NULL;
+   }
+}
+
+static
+PREGION
+VIS_CopyRegion(
+   PREGION SrcRgn)
+{
+   PREGION Rgn = IntSysCreateRectpRgn(0, 0, 0, 0);
+
+   if (Rgn && IntGdiCombineRgn(Rgn, SrcRgn, NULL, RGN_COPY) == ERROR)
+   {
+      REGION_Delete(Rgn);
+      Rgn = NULL;
+   }
+
+   return Rgn;
+}
+
+static
 PREGION FASTCALL
-VIS_ComputeVisibleRegion(
+VIS_ComputeVisibleRegionUncached(
    PWND Wnd,
    BOOLEAN ClientArea,
    BOOLEAN ClipChildren,
@@ -141,6 +285,64 @@ VIS_ComputeVisibleRegion(
    return VisRgn;
 }
 
+PREGION FASTCALL
+VIS_ComputeVisibleRegion(
+   PWND Wnd,
+   BOOLEAN ClientArea,
+   BOOLEAN ClipChildren,
+   BOOLEAN ClipSiblings)
+{
+   PREGION VisRgn;
+   PVIS_CACHE_ENTRY Entry;
+   ULONG_PTR Hash;
+   ULONG Flags, i;
+
+   if (!Wnd || !(Wnd->style & WS_VISIBLE))
+   {
+      return NULL;
+   }
+
+   Flags = (ClientArea ? VIS_CLIENTAREA : 0) |
+           (ClipChildren ? VIS_CLIPCHILDREN : 0) |
+           (ClipSiblings ? VIS_CLIPSIBLINGS : 0);
+
+   if (!VIS_bHashVisibleRegion(Wnd, Flags, &Hash))
+   {
+      return VIS_ComputeVisibleRegionUncached(Wnd, ClientArea, ClipChildren, ClipSiblings);
+   }
+
+   for (i = 0; i < VIS_CACHE_ENTRIES; i++)
+   {
+      Entry = &VisCache[i];
+      if (Entry->VisRgn && Entry->Wnd == Wnd &&
+          Entry->Flags == Flags && Entry->Hash == Hash)
+      {
+         /* Callers own the returned region, so hand out a copy */
+         VisRgn = VIS_CopyRegion(Entry->VisRgn);
+         if (VisRgn)
+            return VisRgn;
+         break;
+      }
+   }
+
+   VisRgn = VIS_ComputeVisibleRegionUncached(Wnd, ClientArea, ClipChildren, ClipSiblings);
+   if (VisRgn)
+   {
+      Entry = &VisCache[VisCacheNext];
+      VisCacheNext = (VisCacheNext + 1) % VIS_CACHE_ENTRIES;
+
+      if (Entry->VisRgn)
+         REGION_Delete(Entry->VisRgn);
+
+      Entry->VisRgn = VIS_CopyRegion(VisRgn);
+      Entry->Wnd = Wnd;
+      Entry->Flags = Flags;
+      Entry->Hash = Hash;
+   }
+
+   return VisRgn;
+}
+
 VOID FASTCALL
 co_VIS_WindowLayoutChanged(
    PWND Wnd,
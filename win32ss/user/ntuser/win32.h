@@ -106,6 +106,7 @@ typedef struct _THREADINFO
     INT                 exitCode;
     HDESK               hdesk;
     UINT                cPaintsReady; /* Count of paints pending. */
+    LIST_ENTRY          PaintListHead; /* Windows with an update region or internal paint. */
     UINT                cTimersReady; /* Count of timers pending. */
     struct tagMENUSTATE* pMenuState;
     DWORD               dwExpWinVer;
@@ -153,6 +154,12 @@ typedef struct _THREADINFO
     ULONG cExclusiveLocks;
 #if DBG
     USHORT acExclusiveLockCount[GDIObjTypeTotal + 1];
+    /* UserLock hold time accounting, see ntuser.c */
+    ULONG ulSyscall;            /* System call being serviced + 1, 0 if none */
+    ULONG ulUserLockSyscall;    /* ulSyscall when the lock was acquired */
+    ULONG cUserLockRecursion;
+    BOOLEAN bUserLockShared;
+    LONGLONG llUserLockAcquired;
 #endif
 #endif // __cplusplus
 } THREADINFO;
@@ -283,6 +290,8 @@ typedef struct _PROCESSINFO
     struct _GDI_POOL* pPoolDcAttr;
     struct _GDI_POOL* pPoolBrushAttr;
     struct _GDI_POOL* pPoolRgnAttr;
+    volatile ULONG ulGdiFirstFree; /* Free handle entries kept for this process */
+    volatile LONG cGdiFreeEntries;
 
 #if DBG
     BYTE DbgChannelLevel[DbgChCount];
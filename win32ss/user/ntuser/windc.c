@@ -358,6 +358,9 @@ UserGetDCEx(PWND Wnd OPTIONAL, HANDLE ClipRegion, ULONG Flags)
       Flags |= DCX_CACHE;
    }
 
+   /* Whatever is drawn with the DC may end up under a CS_SAVEBITS window */
+   SpbCheckRect(Wnd, Wnd ? ((Flags & DCX_WINDOW) ? &Wnd->rcWindow : &Wnd->rcClient) : NULL);
+
    if (Flags & DCX_PARENTCLIP) Flags |= DCX_CACHE;
 
    // When GetDC is called with hWnd nz, DCX_CACHE & _WINDOW are clear w _USESTYLE set.
@@ -570,6 +570,10 @@ LRESULT co_UserFreeWindow(PWND Window,
       don't get into trouble when destroying the thread windows while we're still
       in co_UserFreeWindow() */
    RemoveEntryList(&Window->ThreadListEntry);
+   IntDequeuePaintWindow(Window);
+
+   if (Window->state & WNDS_HASSPB)
+      SpbFree(Window);
 
    BelongsToThreadData = IntWndBelongsToThread(Window, ThreadData);
 
@@ -1696,6 +1700,7 @@ PWND FASTCALL IntCreateWindow(CREATESTRUCTW* Cs,
    pWnd->spwndOwner = OwnerWindow;
    pWnd->fnid = 0;
    pWnd->spwndLastActive = pWnd;
+   InitializeListHead(&pWnd->PaintListEntry);
    // Ramp up compatible version sets.
    if ( dwVer >= WINVER_WIN31 )
    {
@@ -3220,7 +3225,7 @@ NtUserGetAncestor(HWND hWnd, UINT Type)
    DECLARE_RETURN(HWND);
 
    TRACE("Enter NtUserGetAncestor\n");
-   UserEnterExclusive();
+   UserEnterShared();
 
    if (!(Window = UserGetWindowObject(hWnd)))
    {
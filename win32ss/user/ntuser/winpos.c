@@ -257,6 +257,8 @@ PWND FASTCALL IntGetLastTopMostWindow(VOID)
 VOID
 SelectWindowRgn(PWND Window, HRGN hRgnClip)
 {
+    VIS_InvalidateCache();
+
     if (Window->hrgnClip)
     {
         /* Delete no longer needed region handle */
@@ -1886,6 +1888,15 @@ co_WinPosSetWindowPos(
    Window->rcWindow = NewWindowRect;
    Window->rcClient = NewClientRect;
 
+   /* A window appearing, leaving or moving under a CS_SAVEBITS window
+      makes the bits saved under that window stale */
+   if ((WinPos.flags & (SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_SHOWWINDOW | SWP_HIDEWINDOW)) !=
+       (SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER))
+   {
+      SpbCheckRect(Window, &OldWindowRect);
+      SpbCheckRect(Window, &NewWindowRect);
+   }
+
    /* erase parent when hiding or resizing child */
    if (WinPos.flags & SWP_HIDEWINDOW)
    {
@@ -1916,6 +1927,9 @@ co_WinPosSetWindowPos(
          }
       }
 
+      if (!(WinPos.flags & SWP_NOREDRAW))
+         SpbCreate(Window);
+
       Window->style |= WS_VISIBLE; //IntSetStyle( Window, WS_VISIBLE, 0 );
       Window->head.pti->cVisWindows++;
       IntNotifyWinEvent(EVENT_OBJECT_SHOW, Window, OBJID_WINDOW, CHILDID_SELF, WEF_SETBYWNDPTI);
@@ -1928,6 +1942,9 @@ co_WinPosSetWindowPos(
                      NewWindowRect.top - OldWindowRect.top);
    }
 
+   /* The window moved, changed z-order or visibility */
+   VIS_InvalidateCache();
+
    DceResetActiveDCEs(Window); // For WS_VISIBLE changes.
 
    // Change or update, set send non-client paint flag.
@@ -2148,6 +2165,13 @@ co_WinPosSetWindowPos(
              if ( VisAfter != NULL )
                 RgnType = IntGdiCombineRgn(ExposedRgn, ExposedRgn, VisAfter, RGN_DIFF);
 
+             /* Put back the bits saved when the window was shown */
+             if ((WinPos.flags & SWP_HIDEWINDOW) && (Window->state & WNDS_HASSPB) &&
+                 RgnType != ERROR && RgnType != NULLREGION)
+             {
+                RgnType = SpbRestore(Window, ExposedRgn);
+             }
+
              if (RgnType != ERROR && RgnType != NULLREGION)
              {
                 co_VIS_WindowLayoutChanged(Window, ExposedRgn);
@@ -2163,6 +2187,15 @@ co_WinPosSetWindowPos(
       }
    }
 
+   /* The saved bits are only good while the window stays where it was shown */
+   if ((Window->state & WNDS_HASSPB) &&
+       ((WinPos.flags & SWP_HIDEWINDOW) ||
+        (!(WinPos.flags & SWP_SHOWWINDOW) &&
+         (WinPos.flags & (SWP_NOMOVE | SWP_NOSIZE)) != (SWP_NOMOVE | SWP_NOSIZE))))
+   {
+      SpbFree(Window);
+   }
+
    if (!(WinPos.flags & (SWP_NOACTIVATE|SWP_HIDEWINDOW)))
    {
       if ((Window->style & (WS_CHILD | WS_POPUP)) == WS_CHILD)
@@ -2695,6 +2728,7 @@ co_WinPosShowWindow(PWND Wnd, INT Cmd)
       /* if parent is not visible simply toggle WS_VISIBLE and return */
       if (ShowFlag) IntSetStyle( Wnd, WS_VISIBLE, 0 );
       else IntSetStyle( Wnd, 0, WS_VISIBLE );
+      VIS_InvalidateCache();
    }
 
    if ( EventMsg ) IntNotifyWinEvent(EventMsg, Wnd, OBJID_WINDOW, CHILDID_SELF, WEF_SETBYWNDPTI);
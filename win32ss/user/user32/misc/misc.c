@@ -204,23 +204,24 @@ PUSER_HANDLE_ENTRY
 FASTCALL
 GetUser32Handle(HANDLE handle)
 {
-    INT Index;
+    PUSER_HANDLE_ENTRY pEntry;
+    ULONG Index;
     USHORT generation;
 
-    if (!handle) return NULL;
+    /* NULL and other handles below FIRST_USER_HANDLE wrap around to a huge index */
+    Index = (ULONG)(((UINT_PTR)handle & 0xffff) - FIRST_USER_HANDLE) >> 1;
 
-    Index = (((UINT_PTR)handle & 0xffff) - FIRST_USER_HANDLE) >> 1;
-
-    if (Index < 0 || Index >= gHandleTable->nb_handles)
+    if (Index >= (ULONG)gHandleTable->nb_handles)
         return NULL;
 
-    if (!gHandleEntries[Index].type || !gHandleEntries[Index].ptr)
+    pEntry = &gHandleEntries[Index];
+    if (!pEntry->type || !pEntry->ptr)
         return NULL;
 
     generation = (UINT_PTR)handle >> 16;
 
-    if (generation == gHandleEntries[Index].generation || !generation || generation == 0xffff)
-        return &gHandleEntries[Index];
+    if (generation == pEntry->generation || !generation || generation == 0xffff)
+        return pEntry;
 
     return NULL;
 }
@@ -20,6 +20,83 @@ HANDLE WINAPI GdiConvertEnhMetaFile(HANDLE);
 HANDLE WINAPI GdiCreateLocalEnhMetaFile(HANDLE);
 HANDLE WINAPI GdiCreateLocalMetaFilePict(HANDLE);
 
+/* Local copies of clipboard data handed out by GetClipboardData. The same
+   copy is returned until the clipboard changes, then they are all freed.
+   GetClipboardData only works while the clipboard is opened by the calling
+   thread, which serializes the access to the cache. */
+#define CLIPDATA_CACHE_SIZE 8
+
+typedef struct _CLIPDATA_CACHE_ENTRY
+{
+    HANDLE hData;   /* Clipboard data handle in win32k */
+    HANDLE hGlobal; /* Local copy */
+} CLIPDATA_CACHE_ENTRY;
+
+static CLIPDATA_CACHE_ENTRY ClipDataCache[CLIPDATA_CACHE_SIZE];
+static DWORD ClipDataCacheSequence;
+
+static VOID
+IntFlushClipDataCache(VOID)
+{
+    DWORD dwSequence = NtUserGetClipboardSequenceNumber();
+    UINT i;
+
+    if (dwSequence == ClipDataCacheSequence)
+        return;
+
+    for (i = 0; i < CLIPDATA_CACHE_SIZE; i++)
+    {
+        if (ClipDataCache[i].hGlobal)
+            GlobalFree(ClipDataCache[i].hGlobal);
+        ClipDataCache[i].hData = NULL;
+        ClipDataCache[i].hGlobal = NULL;
+    }
+    ClipDataCacheSequence = dwSequence;
+}
+
+static HANDLE
+IntGetCachedClipData(HANDLE hData)
+{
+    UINT i;
+
+    IntFlushClipDataCache();
+
+    for (i = 0; i < CLIPDATA_CACHE_SIZE; i++)
+    {
+        if (ClipDataCache[i].hData == hData)
+        {
+            /* Don't hand out a copy the application freed */
+            if (GlobalFlags(ClipDataCache[i].hGlobal) == GMEM_INVALID_HANDLE)
+            {
+                ClipDataCache[i].hData = NULL;
+                ClipDataCache[i].hGlobal = NULL;
+                return NULL;
+            }
+            return ClipDataCache[i].hGlobal;
+        }
+    }
+
+    return NULL;
+}
+
+static VOID
+IntCacheClipData(HANDLE hData, HANDLE hGlobal)
+{
+    UINT i;
+
+    IntFlushClipDataCache();
+
+    for (i = 0; i < CLIPDATA_CACHE_SIZE; i++)
+    {
+        if (!ClipDataCache[i].hData)
+        {
+            ClipDataCache[i].hData = hData;
+            ClipDataCache[i].hGlobal = hGlobal;
+            return;
+        }
+    }
+}
+
 
 /*
  * @implemented
@@ -220,10 +297,24 @@ GetClipboardData(UINT uFormat)
     {
         HANDLE hGlobal;
 
+        /* Don't copy the same data again and again */
+        if (gcd.uFmtRet == uFormat)
+        {
+            hGlobal = IntGetCachedClipData(hData);
+            if (hGlobal)
+                return hGlobal;
+        }
+
         NtUserCreateLocalMemHandle(hData, NULL, 0, &cbData);
         hGlobal = GlobalAlloc(GMEM_DDESHARE | GMEM_MOVEABLE, cbData);
+        if (!hGlobal)
+            return NULL;
         pData = GlobalLock(hGlobal);
         NtUserCreateLocalMemHandle(hData, pData, cbData, NULL);
+
+        /* The source of a synthesized format is only a temporary copy */
+        if (gcd.uFmtRet == uFormat)
+            IntCacheClipData(hData, hGlobal);
         hData = hGlobal;
     }
 
@@ -278,7 +369,12 @@ GetClipboardData(UINT uFormat)
 
             scd.fGlobalHandle = TRUE;
             hMem = NtUserConvertMemHandle(pData, GlobalSize(hData));
-            NtUserSetClipboardData(uFormat, hMem, &scd);
+            if (hMem && NtUserSetClipboardData(uFormat, hMem, &scd))
+            {
+                /* Next time this format is asked for, it is not synthesized
+                   again, and our copy can be returned as it is */
+                IntCacheClipData(hMem, hData);
+            }
         }
         else if (hData)
             NtUserSetClipboardData(uFormat, hData, &scd);
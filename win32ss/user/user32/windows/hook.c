@@ -786,50 +786,58 @@ User32CallEventProcFromKernel(PVOID Arguments, ULONG ArgumentLength)
   WINEVENTPROC Proc;
   WCHAR module[MAX_PATH];
   DWORD len;
-  HMODULE mod = NULL;
-  BOOL Loaded = FALSE;
+  HMODULE mod;
+  BOOL Loaded;
+  ULONG Count;
 
+  /* win32k may pass several queued events at once, call them in order. */
   Common = (PEVENTPROC_CALLBACK_ARGUMENTS) Arguments;
+  Count = ArgumentLength / sizeof(EVENTPROC_CALLBACK_ARGUMENTS);
 
-  Proc = Common->Proc;
-
-  if (Common->offPfn && Common->Mod)
-  {  // Validate the module again.
-     if (!(len = GetModuleFileNameW((HINSTANCE)Common->Mod, module, MAX_PATH)) || len >= MAX_PATH)
-     {
-        ERR("Error check for module!\n");
-        Common->Mod = 0;
-     }
+  for (; Count > 0; Count--, Common++)
+  {
+     Proc = Common->Proc;
+     mod = NULL;
+     Loaded = FALSE;
 
-     if (Common->Mod && !(mod = GetModuleHandleW(module)))
-     {
-        TRACE("Reloading Event Module.\n");
-        if (!(mod = LoadLibraryExW(module, NULL, LOAD_WITH_ALTERED_SEARCH_PATH)))
+     if (Common->offPfn && Common->Mod)
+     {  // Validate the module again.
+        if (!(len = GetModuleFileNameW((HINSTANCE)Common->Mod, module, MAX_PATH)) || len >= MAX_PATH)
         {
-           ERR("Failed to load Event Module.\n");
+           ERR("Error check for module!\n");
+           Common->Mod = 0;
         }
-        else
+
+        if (Common->Mod && !(mod = GetModuleHandleW(module)))
         {
-           Loaded = TRUE; // Free it only when loaded.
+           TRACE("Reloading Event Module.\n");
+           if (!(mod = LoadLibraryExW(module, NULL, LOAD_WITH_ALTERED_SEARCH_PATH)))
+           {
+              ERR("Failed to load Event Module.\n");
+           }
+           else
+           {
+              Loaded = TRUE; // Free it only when loaded.
+           }
         }
-     }
 
-     if (mod)
-     {
-        TRACE("Loading Event Module. %S\n",module);
-        Proc = (WINEVENTPROC)((char *)mod + Common->offPfn);
+        if (mod)
+        {
+           TRACE("Loading Event Module. %S\n",module);
+           Proc = (WINEVENTPROC)((char *)mod + Common->offPfn);
+        }
      }
-  }
 
-  Proc(Common->hook,
-       Common->event,
-       Common->hwnd,
-       Common->idObject,
-       Common->idChild,
-       Common->dwEventThread,
-       Common->dwmsEventTime);
+     Proc(Common->hook,
+          Common->event,
+          Common->hwnd,
+          Common->idObject,
+          Common->idChild,
+          Common->dwEventThread,
+          Common->dwmsEventTime);
 
-  if (Loaded) FreeLibrary(mod);
+     if (Loaded) FreeLibrary(mod);
+  }
 
   return ZwCallbackReturn(NULL, 0, STATUS_SUCCESS);
 }
@@ -548,6 +548,7 @@ InitFonts(PGUI_CONSOLE_DATA GuiData,
     // Delete all the old fonts first.
     DeleteFonts(GuiData);
     GuiData->Font[FONT_NORMAL] = hFont;
+    GuiInvalidatePaintedCells(GuiData);
 
     /*
      * Now build the other fonts (bold, underlined, mixed).
@@ -1047,6 +1048,11 @@ OnPaletteChanged(PGUI_CONSOLE_DATA GuiData)
 
         /* Realize the (logical) palette */
         RealizePalette(GuiData->hMemDC);
+
+        /* The colours in the framebuffer may have been remapped */
+        EnterCriticalSection(&GuiData->Lock);
+        GuiInvalidatePaintedCells(GuiData);
+        LeaveCriticalSection(&GuiData->Lock);
     }
 }
 
@@ -94,4 +94,14 @@ typedef struct _GUI_CONSOLE_DATA
     BOOL  LineSelection;                    /* TRUE if line-oriented selection (a la *nix terminals), FALSE if block-oriented selection (default on Windows) */
 
     GUI_CONSOLE_INFO GuiInfo;   /* GUI terminal settings */
+
+    /* Cells as last drawn into the framebuffer, see text.c */
+    PCHAR_INFO PaintedCells;
+    COORD      PaintedSize;
+    PCONSOLE_SCREEN_BUFFER PaintedBuffer;
+    HBITMAP    PaintedBitmap;
+    HFONT      PaintedFont;
+    HPALETTE   PaintedPalette;
+    BOOLEAN    PaintedIsCJK;
+    COLORREF   PaintedColors[16];
 } GUI_CONSOLE_DATA, *PGUI_CONSOLE_DATA;
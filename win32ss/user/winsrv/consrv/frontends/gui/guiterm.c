@@ -620,6 +620,7 @@ GuiDeinitFrontEnd(IN OUT PFRONTEND This)
 
     This->Context = NULL;
     DeleteCriticalSection(&GuiData->Lock);
+    if (GuiData->PaintedCells) ConsoleFreeHeap(GuiData->PaintedCells);
     ConsoleFreeHeap(GuiData);
 
     DPRINT("Quit GuiDeinitFrontEnd\n");
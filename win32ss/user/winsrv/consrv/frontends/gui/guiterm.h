@@ -120,5 +120,7 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
                        PGUI_CONSOLE_DATA GuiData,
                        PRECT rcView,
                        PRECT rcFramebuffer);
+VOID
+GuiInvalidatePaintedCells(PGUI_CONSOLE_DATA GuiData);
 
 /* EOF */
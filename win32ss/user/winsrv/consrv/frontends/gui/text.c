@@ -22,6 +22,13 @@
 
 #define IS_WHITESPACE(c)    ((c) == L'\0' || (c) == L' ' || (c) == L'\t')
 
+/* Never a valid attribute: leading and trailing byte at the same time */
+#define PAINTED_CELL_INVALID    0xFFFF
+
+#define IS_CELL_PAINTED(Cell, Painted) \
+    ((Cell)->Char.UnicodeChar == (Painted)->Char.UnicodeChar && \
+     (Cell)->Attributes == (Painted)->Attributes)
+
 /* FUNCTIONS ******************************************************************/
 
 static COLORREF
@@ -360,6 +367,82 @@ GuiPasteToTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     GlobalUnlock(hData);
 }
 
+/*
+ * The framebuffer keeps its contents between two paints, so a cell needs to
+ * be drawn again only if its character or attribute changed since the last
+ * time, or if something else (the caret) was drawn over it. PaintedCells
+ * remembers what every cell of the framebuffer currently shows; it is thrown
+ * away whenever anything that affects the rendering changes.
+ */
+VOID
+GuiInvalidatePaintedCells(PGUI_CONSOLE_DATA GuiData)
+{
+    GuiData->PaintedBuffer = NULL;
+}
+
+static VOID
+InvalidatePaintedCells(PGUI_CONSOLE_DATA GuiData,
+                       ULONG X,
+                       ULONG Y,
+                       ULONG Count)
+{
+    PCHAR_INFO Painted;
+
+    if (GuiData->PaintedBuffer == NULL || Y >= (ULONG)GuiData->PaintedSize.Y)
+        return;
+
+    Painted = &GuiData->PaintedCells[Y * GuiData->PaintedSize.X];
+    for (; Count > 0 && X < (ULONG)GuiData->PaintedSize.X; --Count, ++X)
+        Painted[X].Attributes = PAINTED_CELL_INVALID;
+}
+
+static BOOLEAN
+PreparePaintedCells(PTEXTMODE_SCREEN_BUFFER Buffer,
+                    PGUI_CONSOLE_DATA GuiData)
+{
+    PCONSRV_CONSOLE Console = Buffer->Header.Console;
+    SIZE_T Size;
+
+    if (GuiData->PaintedBuffer  == (PCONSOLE_SCREEN_BUFFER)Buffer &&
+        GuiData->PaintedBitmap  == GuiData->hBitmap &&
+        GuiData->PaintedFont    == GuiData->Font[FONT_NORMAL] &&
+        GuiData->PaintedPalette == Buffer->Header.PaletteHandle &&
+        GuiData->PaintedIsCJK   == Console->IsCJK &&
+        GuiData->PaintedSize.X  == Buffer->ScreenBufferSize.X &&
+        GuiData->PaintedSize.Y  == Buffer->ScreenBufferSize.Y &&
+        RtlEqualMemory(GuiData->PaintedColors, Console->Colors, sizeof(Console->Colors)))
+    {
+        return TRUE;
+    }
+
+    GuiData->PaintedBuffer = NULL;
+
+    if (GuiData->PaintedSize.X != Buffer->ScreenBufferSize.X ||
+        GuiData->PaintedSize.Y != Buffer->ScreenBufferSize.Y ||
+        GuiData->PaintedCells  == NULL)
+    {
+        if (GuiData->PaintedCells) ConsoleFreeHeap(GuiData->PaintedCells);
+        Size = Buffer->ScreenBufferSize.X * Buffer->ScreenBufferSize.Y * sizeof(CHAR_INFO);
+        GuiData->PaintedCells = ConsoleAllocHeap(0, Size);
+        GuiData->PaintedSize.X = GuiData->PaintedSize.Y = 0;
+        if (GuiData->PaintedCells == NULL) return FALSE;
+        GuiData->PaintedSize = Buffer->ScreenBufferSize;
+    }
+
+    /* Nothing drawn so far matches anything */
+    RtlFillMemory(GuiData->PaintedCells,
+                  GuiData->PaintedSize.X * GuiData->PaintedSize.Y * sizeof(CHAR_INFO),
+                  0xFF);
+
+    GuiData->PaintedBuffer  = (PCONSOLE_SCREEN_BUFFER)Buffer;
+    GuiData->PaintedBitmap  = GuiData->hBitmap;
+    GuiData->PaintedFont    = GuiData->Font[FONT_NORMAL];
+    GuiData->PaintedPalette = Buffer->Header.PaletteHandle;
+    GuiData->PaintedIsCJK   = Console->IsCJK;
+    RtlCopyMemory(GuiData->PaintedColors, Console->Colors, sizeof(Console->Colors));
+    return TRUE;
+}
+
 static VOID
 GuiPaintCaret(
     PTEXTMODE_SCREEN_BUFFER Buffer,
@@ -425,6 +508,14 @@ GuiPaintCaret(
 
             SelectObject(GuiData->hMemDC, OldBrush);
             DeleteObject(CursorBrush);
+
+            /* Have the cells under the caret redrawn once it moves or blinks */
+            if (Attribute & COMMON_LVB_LEADING_BYTE)
+                InvalidatePaintedCells(GuiData, CursorX, CursorY, 2);
+            else if (Attribute & COMMON_LVB_TRAILING_BYTE)
+                InvalidatePaintedCells(GuiData, CursorX - 1, CursorY, 2);
+            else
+                InvalidatePaintedCells(GuiData, CursorX, CursorY, 1);
         }
     }
 }
@@ -438,11 +529,11 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     PCONSRV_CONSOLE Console = Buffer->Header.Console;
     ULONG TopLine, BottomLine, LeftColumn, RightColumn;
     ULONG Line, Char, Start;
-    PCHAR_INFO From;
+    PCHAR_INFO From, Painted;
     PWCHAR To;
     WORD LastAttribute, Attribute;
     HFONT OldFont, NewFont;
-    BOOLEAN IsUnderline;
+    BOOLEAN IsUnderline, UseCells;
 
     // ASSERT(Console == GuiData->Console);
 
@@ -481,13 +572,25 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
     NewFont = GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL];
     OldFont = SelectObject(GuiData->hMemDC, NewFont);
 
+    /* Without the painted cells record every cell has to be drawn */
+    UseCells = PreparePaintedCells(Buffer, GuiData);
+
     if (Console->IsCJK)
     {
         for (Line = TopLine; Line <= BottomLine; Line++)
         {
-            for (Char = LeftColumn; Char <= RightColumn; Char++)
+            From    = ConioCoordToPointer(Buffer, LeftColumn, Line);
+            Painted = (UseCells ? &GuiData->PaintedCells[Line * GuiData->PaintedSize.X + LeftColumn] : NULL);
+
+            for (Char = LeftColumn; Char <= RightColumn; Char++, From++, Painted++)
             {
-                From = ConioCoordToPointer(Buffer, Char, Line);
+                if (UseCells)
+                {
+                    if (IS_CELL_PAINTED(From, Painted))
+                        continue;
+                    *Painted = *From;
+                }
+
                 Attribute = From->Attributes;
                 SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(Attribute)));
                 SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(Attribute)));
@@ -517,51 +620,59 @@ GuiPaintTextModeBuffer(PTEXTMODE_SCREEN_BUFFER Buffer,
         for (Line = TopLine; Line <= BottomLine; Line++)
         {
             WCHAR LineBuffer[80];   // Buffer containing a part or all the line to be displayed
-            From  = ConioCoordToPointer(Buffer, LeftColumn, Line);  // Get the first code of the line
-            Start = LeftColumn;
-            To    = LineBuffer;
+            From    = ConioCoordToPointer(Buffer, LeftColumn, Line);  // Get the first code of the line
+            Painted = (UseCells ? &GuiData->PaintedCells[Line * GuiData->PaintedSize.X + LeftColumn] : NULL);
+            Char    = LeftColumn;
 
-            for (Char = LeftColumn; Char <= RightColumn; Char++)
+            while (Char <= RightColumn)
             {
+                /* Skip what the framebuffer already shows */
+                if (UseCells && IS_CELL_PAINTED(From, Painted))
+                {
+                    Char++; From++; Painted++;
+                    continue;
+                }
+
                 /*
-                 * We flush the buffer if the new attribute is different
-                 * from the current one, or if the buffer is full.
+                 * Collect changed cells with the same attribute, until the
+                 * buffer is full or we reach a cell that is already painted.
                  */
-                if (From->Attributes != LastAttribute || (Char - Start == sizeof(LineBuffer) / sizeof(WCHAR)))
+                Start     = Char;
+                To        = LineBuffer;
+                Attribute = From->Attributes;
+                do
                 {
-                    TextOutW(GuiData->hMemDC,
-                             Start * GuiData->CharWidth,
-                             Line  * GuiData->CharHeight,
-                             LineBuffer,
-                             Char - Start);
-                    Start = Char;
-                    To    = LineBuffer;
-                    Attribute = From->Attributes;
-                    if (Attribute != LastAttribute)
+                    if (UseCells) *Painted = *From;
+                    *(To++) = From->Char.UnicodeChar;
+                    Char++; From++; Painted++;
+                }
+                while (Char <= RightColumn &&
+                       From->Attributes == Attribute &&
+                       Char - Start < ARRAYSIZE(LineBuffer) &&
+                       !(UseCells && IS_CELL_PAINTED(From, Painted)));
+
+                if (Attribute != LastAttribute)
+                {
+                    LastAttribute = Attribute;
+                    SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(LastAttribute)));
+                    SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(LastAttribute)));
+
+                    /* Change underline state if needed */
+                    if (!!(LastAttribute & COMMON_LVB_UNDERSCORE) != IsUnderline)
                     {
-                        LastAttribute = Attribute;
-                        SetTextColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, TextAttribFromAttrib(LastAttribute)));
-                        SetBkColor(GuiData->hMemDC, PaletteRGBFromAttrib(Console, BkgdAttribFromAttrib(LastAttribute)));
-
-                        /* Change underline state if needed */
-                        if (!!(LastAttribute & COMMON_LVB_UNDERSCORE) != IsUnderline)
-                        {
-                            IsUnderline = !!(LastAttribute & COMMON_LVB_UNDERSCORE);
-                            /* Select the new font */
-                            NewFont = GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL];
-                            SelectObject(GuiData->hMemDC, NewFont);
-                        }
+                        IsUnderline = !!(LastAttribute & COMMON_LVB_UNDERSCORE);
+                        /* Select the new font */
+                        NewFont = GuiData->Font[IsUnderline ? FONT_BOLD : FONT_NORMAL];
+                        SelectObject(GuiData->hMemDC, NewFont);
                     }
                 }
 
-                *(To++) = (From++)->Char.UnicodeChar;
+                TextOutW(GuiData->hMemDC,
+                         Start * GuiData->CharWidth,
+                         Line  * GuiData->CharHeight,
+                         LineBuffer,
+                         Char - Start);
             }
-
-            TextOutW(GuiData->hMemDC,
-                     Start * GuiData->CharWidth,
-                     Line  * GuiData->CharHeight,
-                     LineBuffer,
-                     RightColumn - Start + 1);
         }
     }
 
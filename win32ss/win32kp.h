@@ -89,6 +89,7 @@ typedef struct _DC *PDC;
 #include "user/ntuser/userfuncs.h"
 #include "user/ntuser/scroll.h"
 #include "user/ntuser/winpos.h"
+#include "user/ntuser/spb.h"
 #include "user/ntuser/callback.h"
 #include "user/ntuser/mmcopy.h"
 #include "user/ntuser/ghost.h"